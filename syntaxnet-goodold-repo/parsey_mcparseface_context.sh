@@ -199,4 +199,11 @@ input {
     file_pattern: '-'
   }
 }
+input {
+  name: 'tagged-queue'
+  record_format: 'sentence-queue'
+  Part {
+    file_pattern: 'tagger-to-parser'
+  }
+}
 EOF
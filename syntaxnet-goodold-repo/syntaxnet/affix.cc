@@ -18,8 +18,11 @@ limitations under the License.
 #include <ctype.h>
 #include <string.h>
 #include <functional>
+#include <limits>
 #include <string>
+#include <utility>
 
+#include "syntaxnet/shared_segments.h"
 #include "syntaxnet/shared_store.h"
 #include "syntaxnet/task_context.h"
 #include "syntaxnet/term_frequency_map.h"
@@ -31,25 +34,51 @@ limitations under the License.
 #include "util/utf8/unicodetext.h"
 
 namespace syntaxnet {
+namespace {
 
-// Initial number of buckets in term and affix hash maps. This must be a power
-// of two.
-static const int kInitialBuckets = 1024;
+// Initial number of slots in affix hash tables. This must be a power of two.
+const int kInitialSlots = 1024;
 
-// Fill factor for term and affix hash maps.
-static const int kFillFactor = 2;
+// Minimum ratio of hash table slots to affixes.
+const int kFillFactor = 2;
 
-int TermHash(const string &term) {
+// Marker for the hash table slots without affixes.
+const int32 kEmptySlot = -1;
+
+// Magic number at the start of mapped files, "SNAFMAP1" in little endian.
+const uint64 kMappedMagic = 0x3150414d46414e53ULL;
+
+uint32 TermHash(StringPiece term) {
   return utils::Hash32(term.data(), term.size(), 0xDECAF);
 }
 
-// Copies a substring of a Unicode text to a string.
-static void UnicodeSubstring(const UnicodeText::const_iterator &start,
-                             const UnicodeText::const_iterator &end,
-                             string *result) {
-  result->clear();
-  result->append(start.utf8_data(), end.utf8_data() - start.utf8_data());
-}
+}  // namespace
+
+// A mapped file holds the following sections, in native byte order:
+//   - the header,
+//   - Entry entries[num_affixes], by affix id,
+//   - int32 slots[num_slots], the hash table of affix ids,
+//   - char pool[pool_size], the concatenated affix forms.
+struct AffixTable::MappedHeader {
+  uint64 magic;
+  uint32 type;
+  int32 max_length;
+  uint32 num_affixes;
+  uint32 num_slots;
+  uint64 pool_size;
+
+  // Size of the record file saved along with the mapped file, to detect
+  // record files that were replaced.
+  uint64 source_size;
+
+  // Returns the expected size of the file.
+  uint64 FileSize() const {
+    return sizeof(MappedHeader) + num_affixes * sizeof(Entry) +
+           num_slots * sizeof(int32) + pool_size;
+  }
+};
+
+const char AffixTable::kMappedSuffix[] = ".mapped";
 
 AffixTable::AffixTable(Type type, int max_length) {
   type_ = type;
@@ -57,16 +86,19 @@ AffixTable::AffixTable(Type type, int max_length) {
   Resize(0);
 }
 
-AffixTable::~AffixTable() { Reset(0); }
+AffixTable::~AffixTable() {}
 
 void AffixTable::Reset(int max_length) {
   // Save new maximum affix length.
   max_length_ = max_length;
 
   // Delete all data.
-  for (size_t i = 0; i < affixes_.size(); ++i) delete affixes_[i];
-  affixes_.clear();
-  buckets_.clear();
+  region_.reset();
+  num_affixes_ = 0;
+  num_slots_ = 0;
+  entries_.clear();
+  slots_.clear();
+  pool_.clear();
   Resize(0);
 }
 
@@ -74,17 +106,17 @@ void AffixTable::Read(const AffixTableEntry &table_entry) {
   CHECK_EQ(table_entry.type(), type_ == PREFIX ? "PREFIX" : "SUFFIX");
   CHECK_GE(table_entry.max_length(), 0);
   Reset(table_entry.max_length());
+  Resize(table_entry.affix_size());
 
   // First, create all affixes.
   for (int affix_id = 0; affix_id < table_entry.affix_size(); ++affix_id) {
     const auto &affix_entry = table_entry.affix(affix_id);
     CHECK_GE(affix_entry.length(), 0);
     CHECK_LE(affix_entry.length(), max_length_);
-    CHECK(FindAffix(affix_entry.form()) == nullptr);  // forbid duplicates
-    Affix *affix = AddNewAffix(affix_entry.form(), affix_entry.length());
-    CHECK_EQ(affix->id(), affix_id);
+    CHECK_EQ(AffixId(affix_entry.form()), -1);  // forbid duplicates
+    CHECK_EQ(AddNewAffix(affix_entry.form(), affix_entry.length()), affix_id);
   }
-  CHECK_EQ(affixes_.size(), table_entry.affix_size());
+  CHECK_EQ(num_affixes_, table_entry.affix_size());
 
   // Next, link the shorter affixes.
   for (int affix_id = 0; affix_id < table_entry.affix_size(); ++affix_id) {
@@ -95,11 +127,11 @@ void AffixTable::Read(const AffixTableEntry &table_entry) {
     }
     CHECK_GT(affix_entry.length(), 1);
     CHECK_GE(affix_entry.shorter_id(), 0);
-    CHECK_LT(affix_entry.shorter_id(), affixes_.size());
-    Affix *affix = affixes_[affix_id];
-    Affix *shorter = affixes_[affix_entry.shorter_id()];
-    CHECK_EQ(affix->length(), shorter->length() + 1);
-    affix->set_shorter(shorter);
+    CHECK_LT(affix_entry.shorter_id(), num_affixes_);
+    Entry &affix = entries_[affix_id];
+    const Entry &shorter = entries_[affix_entry.shorter_id()];
+    CHECK_EQ(affix.length, shorter.length + 1);
+    affix.shorter_id = affix_entry.shorter_id();
   }
 }
 
@@ -113,12 +145,11 @@ void AffixTable::Write(AffixTableEntry *table_entry) const {
   table_entry->Clear();
   table_entry->set_type(type_ == PREFIX ? "PREFIX" : "SUFFIX");
   table_entry->set_max_length(max_length_);
-  for (const Affix *affix : affixes_) {
+  for (int id = 0; id < num_affixes_; ++id) {
     auto *affix_entry = table_entry->add_affix();
-    affix_entry->set_form(affix->form());
-    affix_entry->set_length(affix->length());
-    affix_entry->set_shorter_id(
-        affix->shorter() == nullptr ? -1 : affix->shorter()->id());
+    affix_entry->set_form(Form(id).ToString());
+    affix_entry->set_length(entries()[id].length);
+    affix_entry->set_shorter_id(entries()[id].shorter_id);
   }
 }
 
@@ -128,7 +159,117 @@ void AffixTable::Write(ProtoRecordWriter *writer) const {
   writer->Write(table_entry);
 }
 
-Affix *AffixTable::AddAffixesForWord(const char *word, size_t size) {
+void AffixTable::Load(const string &filename) {
+  // Prefer the mapped file, if any, and then a shared segment.
+  if (LoadMapped(filename)) return;
+  if (LoadShared(filename)) return;
+  ProtoRecordReader reader(filename);
+  Read(&reader);
+}
+
+bool AffixTable::LoadMapped(const string &filename) {
+  tensorflow::Env *env = tensorflow::Env::Default();
+  const string mapped_filename =
+      tensorflow::strings::StrCat(filename, kMappedSuffix);
+  if (!env->FileExists(mapped_filename)) return false;
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region;
+  TF_CHECK_OK(env->NewReadOnlyMemoryRegionFromFile(mapped_filename, &region));
+  uint64 source_size = 0;
+  TF_CHECK_OK(env->GetFileSize(filename, &source_size));
+  return UseRegion(std::move(region), mapped_filename, source_size);
+}
+
+bool AffixTable::LoadShared(const string &filename) {
+  if (!SharedSegments::Enabled()) return false;
+  uint64 source_size = 0;
+  TF_CHECK_OK(tensorflow::Env::Default()->GetFileSize(filename, &source_size));
+  const string name = SharedSegments::NameForFile(
+      type_ == PREFIX ? "prefix-table" : "suffix-table", filename);
+  const Type type = type_;
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region =
+      SharedSegments::Map(name, [&filename, type,
+                                 source_size](const string &path) {
+        AffixTable table(type, 0);
+        ProtoRecordReader reader(filename);
+        table.Read(&reader);
+        table.WriteMapped(path, source_size);
+      });
+  return UseRegion(std::move(region), name, source_size);
+}
+
+bool AffixTable::UseRegion(
+    std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region,
+    const string &name, uint64 source_size) {
+  CHECK_GE(region->length(), sizeof(MappedHeader))
+      << "Truncated mapped affix table " << name;
+  const auto *header = static_cast<const MappedHeader *>(region->data());
+  CHECK_EQ(kMappedMagic, header->magic) << "Not a mapped affix table: " << name;
+  CHECK_EQ(header->FileSize(), region->length())
+      << "Truncated mapped affix table " << name;
+  CHECK_EQ(header->type, static_cast<uint32>(type_)) << "Wrong affix table type in " << name;
+
+  // Fall back to the record file if it was replaced after saving both.
+  if (source_size != header->source_size) {
+    LOG(WARNING) << "Ignoring " << name << ", which does not match its record "
+                 << "file";
+    return false;
+  }
+
+  Reset(header->max_length);
+  num_affixes_ = header->num_affixes;
+  num_slots_ = header->num_slots;
+  mapped_entries_ = reinterpret_cast<const Entry *>(header + 1);
+  mapped_slots_ =
+      reinterpret_cast<const int32 *>(mapped_entries_ + num_affixes_);
+  mapped_pool_ = reinterpret_cast<const char *>(mapped_slots_ + num_slots_);
+  region_ = std::move(region);
+  LOG(INFO) << "Mapped " << num_affixes_ << " affixes from " << name << ".";
+  return true;
+}
+
+void AffixTable::SaveMapped(const string &filename) const {
+  {
+    ProtoRecordWriter writer(filename);
+    Write(&writer);
+  }
+  uint64 source_size = 0;
+  TF_CHECK_OK(tensorflow::Env::Default()->GetFileSize(filename, &source_size));
+  WriteMapped(tensorflow::strings::StrCat(filename, kMappedSuffix),
+              source_size);
+}
+
+void AffixTable::WriteMapped(const string &filename,
+                             uint64 source_size) const {
+  MappedHeader header;
+  header.magic = kMappedMagic;
+  header.type = type_;
+  header.max_length = max_length_;
+  header.num_affixes = num_affixes_;
+  header.num_slots = num_slots_;
+  header.pool_size = 0;
+  for (int id = 0; id < num_affixes_; ++id) {
+    header.pool_size += entries()[id].size;
+  }
+  header.source_size = source_size;
+
+  // The owned data is already laid out like the mapped sections.
+  std::unique_ptr<tensorflow::WritableFile> file;
+  TF_CHECK_OK(tensorflow::Env::Default()->NewWritableFile(filename, &file));
+  TF_CHECK_OK(file->Append(
+      StringPiece(reinterpret_cast<const char *>(&header), sizeof(header))));
+  TF_CHECK_OK(file->Append(
+      StringPiece(reinterpret_cast<const char *>(entries()),
+                  num_affixes_ * sizeof(Entry))));
+  TF_CHECK_OK(file->Append(StringPiece(
+      reinterpret_cast<const char *>(slots()), num_slots_ * sizeof(int32))));
+  TF_CHECK_OK(file->Append(StringPiece(pool(), header.pool_size)));
+  TF_CHECK_OK(file->Close()) << "for file " << filename;
+  LOG(INFO) << "Saved " << num_affixes_ << " affixes to " << filename << ".";
+}
+
+int AffixTable::AddAffixesForWord(const char *word, size_t size) {
+  CHECK(region_ == nullptr) << "Mapped affix tables are read-only";
+
   // The affix length is measured in characters and not bytes so we need to
   // determine the length in characters.
   UnicodeText text;
@@ -138,7 +279,7 @@ Affix *AffixTable::AddAffixesForWord(const char *word, size_t size) {
   // Determine longest affix.
   int affix_len = length;
   if (affix_len > max_length_) affix_len = max_length_;
-  if (affix_len == 0) return nullptr;
+  if (affix_len == 0) return -1;
 
   // Find start and end of longest affix.
   UnicodeText::const_iterator start, end;
@@ -151,27 +292,25 @@ Affix *AffixTable::AddAffixesForWord(const char *word, size_t size) {
   }
 
   // Try to find successively shorter affixes.
-  Affix *top = nullptr;
-  Affix *ancestor = nullptr;
-  string s;
+  int top = -1;
+  int ancestor = -1;
   while (affix_len > 0) {
     // Try to find affix in table.
-    UnicodeSubstring(start, end, &s);
-    Affix *affix = FindAffix(s);
-    if (affix == nullptr) {
-      // Affix not found, add new one to table.
-      affix = AddNewAffix(s, affix_len);
-
-      // Update ancestor chain.
-      if (ancestor != nullptr) ancestor->set_shorter(affix);
-      ancestor = affix;
-      if (top == nullptr) top = affix;
-    } else {
-      // Affix found. Update ancestor if needed and return match.
-      if (ancestor != nullptr) ancestor->set_shorter(affix);
-      if (top == nullptr) top = affix;
-      break;
-    }
+    const StringPiece form(start.utf8_data(),
+                           end.utf8_data() - start.utf8_data());
+    int affix = AffixId(form);
+    const bool found = affix != -1;
+
+    // Add new affix to table if not found.
+    if (!found) affix = AddNewAffix(form, affix_len);
+
+    // Update ancestor chain.
+    if (ancestor != -1) entries_[ancestor].shorter_id = affix;
+    ancestor = affix;
+    if (top == -1) top = affix;
+
+    // Shorter affixes of affixes found are in the table already.
+    if (found) break;
 
     // Next affix.
     if (type_ == PREFIX) {
@@ -186,78 +325,127 @@ Affix *AffixTable::AddAffixesForWord(const char *word, size_t size) {
   return top;
 }
 
-Affix *AffixTable::GetAffix(int id) const {
-  if (id < 0 || id >= static_cast<int>(affixes_.size())) {
-    return nullptr;
-  } else {
-    return affixes_[id];
-  }
-}
-
 string AffixTable::AffixForm(int id) const {
-  Affix *affix = GetAffix(id);
-  if (affix == nullptr) {
+  if (id < 0 || id >= num_affixes_) {
     return "";
   } else {
-    return affix->form();
+    return Form(id).ToString();
   }
 }
 
-int AffixTable::AffixId(const string &form) const {
-  Affix *affix = FindAffix(form);
-  if (affix == nullptr) {
-    return -1;
-  } else {
-    return affix->id();
+int AffixTable::AffixId(StringPiece form) const {
+  // Compute hash value for the form and probe linearly from its slot.
+  const uint32 hash = TermHash(form);
+  const uint32 mask = num_slots_ - 1;
+  const int32 *table = slots();
+  for (uint32 slot = hash & mask;; slot = (slot + 1) & mask) {
+    const int32 id = table[slot];
+    if (id == kEmptySlot) return -1;
+    if (entries()[id].hash == hash && Form(id) == form) return id;
   }
 }
 
-Affix *AffixTable::AddNewAffix(const string &form, int length) {
-  int hash = TermHash(form);
-  int id = affixes_.size();
-  if (id > static_cast<int>(buckets_.size()) * kFillFactor) Resize(id);
-  int b = hash & (buckets_.size() - 1);
+void AffixTable::AffixIds(StringPiece word, int max_length,
+                          vector<int> *affix_ids) const {
+  affix_ids->assign(max_length, -1);
+  if (max_length > max_length_) max_length = max_length_;
 
-  // Create new affix object.
-  Affix *affix = new Affix(id, form.c_str(), length);
-  affixes_.push_back(affix);
-
-  // Insert affix in bucket chain.
-  affix->next_ = buckets_[b];
-  buckets_[b] = affix;
+  // Find the byte offsets delimiting the affixes of each length.
+  UnicodeText text;
+  text.PointToUTF8(word.data(), word.size());
+  vector<StringPiece> affixes;
+  if (type_ == PREFIX) {
+    for (auto it = text.begin(); it != text.end() &&
+                                 static_cast<int>(affixes.size()) < max_length;) {
+      ++it;
+      affixes.emplace_back(word.data(), it.utf8_data() - word.data());
+    }
+  } else {
+    const char *end = word.data() + word.size();
+    for (auto it = text.end(); it != text.begin() &&
+                               static_cast<int>(affixes.size()) < max_length;) {
+      --it;
+      affixes.emplace_back(it.utf8_data(), end - it.utf8_data());
+    }
+  }
 
-  return affix;
+  // Look up the longest affix in the table, and follow the chain of shorter
+  // affixes from it.
+  for (int length = affixes.size(); length > 0; --length) {
+    int id = AffixId(affixes[length - 1]);
+    if (id == -1) continue;
+    while (id != -1) {
+      (*affix_ids)[entries()[id].length - 1] = id;
+      id = entries()[id].shorter_id;
+    }
+    break;
+  }
 }
 
-Affix *AffixTable::FindAffix(const string &form) const {
-  // Compute hash value for word.
-  int hash = TermHash(form);
+void AffixTable::Merge(const AffixTable &other) {
+  CHECK(region_ == nullptr) << "Mapped affix tables are read-only";
+  CHECK_EQ(type_, other.type_);
+  CHECK_EQ(max_length_, other.max_length_);
+
+  // First, add the affixes missing from this table, mapping the ids of the
+  // other table to ids in this one.
+  vector<int> ids(other.size());
+  const int num_existing = num_affixes_;
+  for (int other_id = 0; other_id < other.size(); ++other_id) {
+    const StringPiece form = other.Form(other_id);
+    const int id = AffixId(form);
+    ids[other_id] =
+        id != -1 ? id : AddNewAffix(form, other.AffixLength(other_id));
+  }
 
-  // Try to find affix in hash table.
-  Affix *affix = buckets_[hash & (buckets_.size() - 1)];
-  while (affix != nullptr) {
-    if (strcmp(affix->form_.c_str(), form.c_str()) == 0) return affix;
-    affix = affix->next_;
+  // Next, link the new affixes. The existing ones are linked already.
+  for (int other_id = 0; other_id < other.size(); ++other_id) {
+    const int id = ids[other_id];
+    const int shorter_id = other.ShorterAffixId(other_id);
+    if (id < num_existing || shorter_id == -1) continue;
+    entries_[id].shorter_id = ids[shorter_id];
   }
-  return nullptr;
+}
+
+int AffixTable::AddNewAffix(StringPiece form, int length) {
+  const int id = num_affixes_;
+  if ((id + 1) * kFillFactor > num_slots_) Resize(id + 1);
+
+  // Append the affix form to the pool.
+  CHECK_LE(pool_.size() + form.size(), std::numeric_limits<uint32>::max());  // overflow
+  Entry entry;
+  entry.offset = pool_.size();
+  entry.size = form.size();
+  entry.hash = TermHash(form);
+  entry.length = length;
+  entry.shorter_id = -1;
+  pool_.append(form.data(), form.size());
+  entries_.push_back(entry);
+  ++num_affixes_;
+
+  // Insert the affix in the first free slot from its hash.
+  const uint32 mask = num_slots_ - 1;
+  uint32 slot = entry.hash & mask;
+  while (slots_[slot] != kEmptySlot) slot = (slot + 1) & mask;
+  slots_[slot] = id;
+
+  return id;
 }
 
 void AffixTable::Resize(int size_hint) {
-  // Compute new size for bucket array.
-  int new_size = kInitialBuckets;
-  while (new_size < size_hint) new_size *= 2;
-  int mask = new_size - 1;
-
-  // Distribute affixes in new buckets.
-  buckets_.resize(new_size);
-  for (size_t i = 0; i < buckets_.size(); ++i) {
-    buckets_[i] = nullptr;
-  }
-  for (size_t i = 0; i < affixes_.size(); ++i) {
-    Affix *affix = affixes_[i];
-    int b = TermHash(affix->form_) & mask;
-    affix->next_ = buckets_[b];
-    buckets_[b] = affix;
+  // Compute new size for the hash table.
+  int new_size = kInitialSlots;
+  while (new_size < size_hint * kFillFactor) new_size *= 2;
+  if (new_size <= num_slots_) return;
+  num_slots_ = new_size;
+  const uint32 mask = num_slots_ - 1;
+
+  // Distribute affixes in new slots.
+  slots_.assign(num_slots_, kEmptySlot);
+  for (int id = 0; id < num_affixes_; ++id) {
+    uint32 slot = entries_[id].hash & mask;
+    while (slots_[slot] != kEmptySlot) slot = (slot + 1) & mask;
+    slots_[slot] = id;
   }
 }
 
@@ -17,6 +17,7 @@ limitations under the License.
 #define SYNTAXNET_AFFIX_H_
 
 #include <stddef.h>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -29,64 +30,27 @@ limitations under the License.
 #include "syntaxnet/term_frequency_map.h"
 #include "syntaxnet/workspace.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace syntaxnet {
 
-// An affix represents a prefix or suffix of a word of a certain length. Each
-// affix has a unique id and a textual form. An affix also has a pointer to the
-// affix that is one character shorter. This creates a chain of affixes that are
-// successively shorter.
-class Affix {
- private:
-  friend class AffixTable;
-  Affix(int id, const char *form, int length)
-      : id_(id),
-        length_(length),
-        form_(form),
-        shorter_(nullptr),
-        next_(nullptr) {}
-
- public:
-  // Returns unique id of affix.
-  int id() const { return id_; }
-
-  // Returns the textual representation of the affix.
-  string form() const { return form_; }
-
-  // Returns the length of the affix.
-  int length() const { return length_; }
-
-  // Gets/sets the affix that is one character shorter.
-  Affix *shorter() const { return shorter_; }
-  void set_shorter(Affix *next) { shorter_ = next; }
-
- private:
-  // Affix id.
-  int id_;
-
-  // Length (in characters) of affix.
-  int length_;
-
-  // Text form of affix.
-  string form_;
-
-  // Pointer to affix that is one character shorter.
-  Affix *shorter_;
-
-  // Next affix in bucket chain.
-  Affix *next_;
-
-  TF_DISALLOW_COPY_AND_ASSIGN(Affix);
-};
-
 // An affix table holds all prefixes/suffixes of all the words added to the
-// table up to a maximum length. The affixes are chained together to enable
-// fast lookup of all affixes for a word.
+// table up to a maximum length. Each affix has a unique id, a textual form, a
+// length in characters and the id of the affix that is one character shorter,
+// which chains the affixes of a word together.
+//
+// The table is stored flat: affix entries in one array, their forms in one
+// string pool, and an open-addressed hash table of affix ids probed linearly.
+// The same layout is saved in the mapped format, which tables can be read from
+// through a read-only memory mapping, like mapped term frequency maps.
 class AffixTable {
  public:
   // Affix table type.
   enum Type { PREFIX, SUFFIX };
 
+  // Suffix of the mapped file saved next to a table by SaveMapped().
+  static const char kMappedSuffix[];
+
   AffixTable(Type type, int max_length);
   ~AffixTable();
 
@@ -106,50 +70,129 @@ class AffixTable {
   // Serializes this to the given records.
   void Write(ProtoRecordWriter *writer) const;
 
+  // Loads the table from the given record file. The mapped file saved next to
+  // it by SaveMapped() is mapped instead if there is one, and otherwise a
+  // shared segment if those are enabled, see SharedSegments.
+  void Load(const string &filename);
+
+  // Saves the table to the given record file, and next to it in the mapped
+  // format.
+  void SaveMapped(const string &filename) const;
+
   // Adds all prefixes/suffixes of the word up to the maximum length to the
-  // table. The longest affix is returned. The pointers in the affix can be
-  // used for getting shorter affixes.
-  Affix *AddAffixesForWord(const char *word, size_t size);
+  // table. Returns the id of the longest affix, or -1 if the word is empty.
+  // Shorter affixes can be found through ShorterAffixId().
+  int AddAffixesForWord(const char *word, size_t size);
 
-  // Gets the affix information for the affix with a certain id. Returns NULL if
-  // there is no affix in the table with this id.
-  Affix *GetAffix(int id) const;
+  // Adds the affixes of another table of the same type that are not in this
+  // table yet, in the order of their ids in the other table, and links them to
+  // their shorter affixes. Merging the tables built over consecutive parts of
+  // a corpus gives the table built over the whole corpus, ids included.
+  void Merge(const AffixTable &other);
 
   // Gets affix form from id. If the affix does not exist in the table, an empty
   // string is returned.
   string AffixForm(int id) const;
 
+  // Returns the length in characters of the affix with the given id.
+  int AffixLength(int id) const { return entries()[id].length; }
+
+  // Returns the id of the affix that is one character shorter than the affix
+  // with the given id, or -1 for affixes of length 1.
+  int ShorterAffixId(int id) const { return entries()[id].shorter_id; }
+
   // Gets affix id for affix. If the affix does not exist in the table, -1 is
   // returned.
-  int AffixId(const string &form) const;
+  int AffixId(StringPiece form) const;
+
+  // Looks up the affixes of all lengths of a word in one pass. Sets affix_ids
+  // to max_length ids, the k-th being the id of the affix of length k + 1, or
+  // -1 if the table has no such affix or the word is shorter.
+  void AffixIds(StringPiece word, int max_length,
+                vector<int> *affix_ids) const;
 
   // Returns size of the affix table.
-  int size() const { return affixes_.size(); }
+  int size() const { return num_affixes_; }
 
   // Returns the maximum affix length.
   int max_length() const { return max_length_; }
 
  private:
-  // Adds a new affix to table.
-  Affix *AddNewAffix(const string &form, int length);
-
-  // Finds existing affix in table.
-  Affix *FindAffix(const string &form) const;
-
-  // Resizes bucket array.
+  // An affix in the flat table. The form is the bytes [offset, offset + size)
+  // of the string pool.
+  struct Entry {
+    uint32 offset;
+    uint32 size;
+    uint32 hash;
+    int32 length;
+    int32 shorter_id;
+  };
+
+  // Layout of mapped files.
+  struct MappedHeader;
+
+  // Returns the form of the affix with the given id.
+  StringPiece Form(int id) const {
+    const Entry &entry = entries()[id];
+    return StringPiece(pool() + entry.offset, entry.size);
+  }
+
+  // Adds a new affix to table and returns its id.
+  int AddNewAffix(StringPiece form, int length);
+
+  // Resizes the hash table to fit at least the given number of affixes.
   void Resize(int size_hint);
 
+  // Maps the mapped file saved next to the given record file. Returns false if
+  // there is no such file, or if it does not match the record file.
+  bool LoadMapped(const string &filename);
+
+  // Maps the shared segment holding the given record file in the mapped
+  // format, creating it if necessary. Returns false if shared segments are
+  // disabled.
+  bool LoadShared(const string &filename);
+
+  // Maps the given region, described by 'name', as the table saved from a
+  // record file of the given size. Returns false if it does not match.
+  bool UseRegion(std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region,
+                 const string &name, uint64 source_size);
+
+  // Writes the table in the mapped format, for a record file of the given
+  // size.
+  void WriteMapped(const string &filename, uint64 source_size) const;
+
+  // Accessors for the table data, which is either owned or mapped.
+  const Entry *entries() const {
+    return region_ != nullptr ? mapped_entries_ : entries_.data();
+  }
+  const int32 *slots() const {
+    return region_ != nullptr ? mapped_slots_ : slots_.data();
+  }
+  const char *pool() const {
+    return region_ != nullptr ? mapped_pool_ : pool_.data();
+  }
+
   // Affix type (prefix or suffix).
   Type type_;
 
   // Maximum length of affix.
   int max_length_;
 
-  // Index from affix ids to affix items.
-  vector<Affix *> affixes_;
-
-  // Buckets for word-to-affix hash map.
-  vector<Affix *> buckets_;
+  // Number of affixes and of hash table slots, a power of two.
+  int num_affixes_ = 0;
+  int num_slots_ = 0;
+
+  // Owned table data: affixes by id, hash table of affix ids with -1 for
+  // empty slots, and the pool of affix forms.
+  vector<Entry> entries_;
+  vector<int32> slots_;
+  string pool_;
+
+  // Memory region and table data of a mapped table, or nullptr.
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region_;
+  const Entry *mapped_entries_ = nullptr;
+  const int32 *mapped_slots_ = nullptr;
+  const char *mapped_pool_ = nullptr;
 
   TF_DISALLOW_COPY_AND_ASSIGN(AffixTable);
 };
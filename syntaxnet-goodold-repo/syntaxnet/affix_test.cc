@@ -0,0 +1,185 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/affix.h"
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/shared_segments.h"
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+class AffixTableTest : public ::testing::Test {
+ protected:
+  // Adds the affixes of the given word to the table.
+  static int Add(const string &word, AffixTable *table) {
+    return table->AddAffixesForWord(word.data(), word.size());
+  }
+
+  // Fills the table with the affixes of the words word1 to word<num_words>.
+  static void Fill(int num_words, AffixTable *table) {
+    for (int i = 1; i <= num_words; ++i) {
+      Add(tensorflow::strings::StrCat("word", i), table);
+    }
+  }
+
+  // Expects that both tables hold the same affixes with the same ids.
+  static void ExpectSameAffixes(const AffixTable &expected,
+                                const AffixTable &actual) {
+    EXPECT_EQ(expected.max_length(), actual.max_length());
+    ASSERT_EQ(expected.size(), actual.size());
+    for (int id = 0; id < expected.size(); ++id) {
+      const string form = expected.AffixForm(id);
+      EXPECT_EQ(form, actual.AffixForm(id));
+      EXPECT_EQ(id, actual.AffixId(form));
+      EXPECT_EQ(expected.AffixLength(id), actual.AffixLength(id));
+      EXPECT_EQ(expected.ShorterAffixId(id), actual.ShorterAffixId(id));
+    }
+  }
+
+  // Returns a path in the test temporary directory.
+  string TempPath(const string &name) const {
+    return utils::JoinPath({tensorflow::testing::TmpDir(), name});
+  }
+};
+
+TEST_F(AffixTableTest, AffixesAreChainedByLength) {
+  AffixTable suffixes(AffixTable::SUFFIX, 3);
+  const int ing = Add("singing", &suffixes);
+  EXPECT_EQ("ing", suffixes.AffixForm(ing));
+  EXPECT_EQ(3, suffixes.AffixLength(ing));
+  const int ng = suffixes.ShorterAffixId(ing);
+  EXPECT_EQ("ng", suffixes.AffixForm(ng));
+  const int g = suffixes.ShorterAffixId(ng);
+  EXPECT_EQ("g", suffixes.AffixForm(g));
+  EXPECT_EQ(-1, suffixes.ShorterAffixId(g));
+
+  // Words sharing shorter affixes reuse them.
+  const int ong = Add("song", &suffixes);
+  EXPECT_EQ(ng, suffixes.ShorterAffixId(ong));
+  EXPECT_EQ(4, suffixes.size());
+  EXPECT_EQ(-1, Add("", &suffixes));
+  EXPECT_EQ(-1, suffixes.AffixId("ang"));
+  EXPECT_EQ("", suffixes.AffixForm(4));
+}
+
+TEST_F(AffixTableTest, AffixIdsAreLookedUpInOnePass) {
+  AffixTable prefixes(AffixTable::PREFIX, 3);
+  Add("\xc3\xa9t\xc3\xa9", &prefixes);  // "été"
+  Add("un", &prefixes);
+
+  std::vector<int> ids;
+  prefixes.AffixIds("\xc3\xa9t\xc3\xa9s", 4, &ids);
+  ASSERT_EQ(4, ids.size());
+  EXPECT_EQ(prefixes.AffixId("\xc3\xa9"), ids[0]);
+  EXPECT_EQ(prefixes.AffixId("\xc3\xa9t"), ids[1]);
+  EXPECT_EQ(prefixes.AffixId("\xc3\xa9t\xc3\xa9"), ids[2]);
+  EXPECT_EQ(-1, ids[3]);
+
+  prefixes.AffixIds("until", 3, &ids);
+  EXPECT_THAT(ids, ::testing::ElementsAre(prefixes.AffixId("u"),
+                                          prefixes.AffixId("un"), -1));
+  prefixes.AffixIds("x", 2, &ids);
+  EXPECT_THAT(ids, ::testing::ElementsAre(-1, -1));
+
+  AffixTable suffixes(AffixTable::SUFFIX, 2);
+  Add("caf\xc3\xa9", &suffixes);  // "café"
+  suffixes.AffixIds("th\xc3\xa9", 2, &ids);
+  EXPECT_THAT(ids, ::testing::ElementsAre(suffixes.AffixId("\xc3\xa9"), -1));
+}
+
+TEST_F(AffixTableTest, MergedTablesMatchTableOverWholeCorpus) {
+  const std::vector<string> words = {"singing", "song", "sing", "a",
+                                     "going",   "gone", "song", "king",
+                                     "ring",    "long", "ng",   "kings"};
+  for (const auto type : {AffixTable::PREFIX, AffixTable::SUFFIX}) {
+    AffixTable whole(type, 3);
+    for (const string &word : words) Add(word, &whole);
+
+    // Affixes are added longest first, so the parts collect affixes in the
+    // same relative order as the whole table.
+    AffixTable merged(type, 3);
+    for (int first = 0; first < words.size(); first += 5) {
+      AffixTable part(type, 3);
+      for (int i = first; i < words.size() && i < first + 5; ++i) {
+        Add(words[i], &part);
+      }
+      merged.Merge(part);
+    }
+    ExpectSameAffixes(whole, merged);
+  }
+}
+
+TEST_F(AffixTableTest, ReadTableMatchesWrittenTable) {
+  AffixTable table(AffixTable::SUFFIX, 4);
+  Fill(2000, &table);
+  AffixTableEntry entry;
+  table.Write(&entry);
+  AffixTable read(AffixTable::SUFFIX, 1);
+  read.Read(entry);
+  ExpectSameAffixes(table, read);
+}
+
+TEST_F(AffixTableTest, MappedTableMatchesRecordTable) {
+  AffixTable table(AffixTable::PREFIX, 5);
+  Fill(2000, &table);
+  const string path = TempPath("mapped-prefixes");
+  table.SaveMapped(path);
+  EXPECT_TRUE(tensorflow::Env::Default()->FileExists(
+      path + AffixTable::kMappedSuffix));
+
+  AffixTable mapped(AffixTable::PREFIX, 1);
+  mapped.Load(path);
+  ExpectSameAffixes(table, mapped);
+  std::vector<int> ids;
+  mapped.AffixIds("word1234", 5, &ids);
+  EXPECT_EQ(mapped.AffixId("word1"), ids[4]);
+}
+
+TEST_F(AffixTableTest, RecordTablesAreMappedFromSharedSegments) {
+  AffixTable table(AffixTable::SUFFIX, 3);
+  Fill(100, &table);
+  const string path = TempPath("shared-suffixes");
+  {
+    ProtoRecordWriter writer(path);
+    table.Write(&writer);
+  }
+
+  const string directory = TempPath("shared-affix-segments");
+  TF_CHECK_OK(tensorflow::Env::Default()->CreateDir(directory));
+  setenv(SharedSegments::kDirectoryVariable, directory.c_str(), 1);
+  AffixTable shared(AffixTable::SUFFIX, 1);
+  shared.Load(path);
+  AffixTable shared_again(AffixTable::SUFFIX, 1);
+  shared_again.Load(path);
+  unsetenv(SharedSegments::kDirectoryVariable);
+
+  std::vector<string> segments;
+  TF_CHECK_OK(tensorflow::Env::Default()->GetChildren(directory, &segments));
+  EXPECT_EQ(1, segments.size());
+  ExpectSameAffixes(table, shared);
+  ExpectSameAffixes(table, shared_again);
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,93 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/allocation_counter.h"
+
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+#include "tensorflow/core/lib/strings/stringprintf.h"
+
+namespace syntaxnet {
+namespace {
+
+// Counts of the process. Relaxed atomics suffice, since the counts are only
+// read by the thread that made the measured allocations.
+std::atomic<int64> num_allocations(0);
+std::atomic<int64> num_bytes(0);
+
+// Counts an allocation and allocates it with malloc(), returning null if it
+// fails.
+void *CountedMalloc(size_t size) {
+  num_allocations.fetch_add(1, std::memory_order_relaxed);
+  num_bytes.fetch_add(size, std::memory_order_relaxed);
+  return malloc(size == 0 ? 1 : size);
+}
+
+// Like CountedMalloc(), but aborts if the allocation fails, since the build
+// has no exceptions to throw std::bad_alloc with.
+void *CountedNew(size_t size) {
+  void *ptr = CountedMalloc(size);
+  if (ptr == nullptr) abort();
+  return ptr;
+}
+
+}  // namespace
+
+AllocationCounts CurrentAllocationCounts() {
+  AllocationCounts counts;
+  counts.allocations = num_allocations.load(std::memory_order_relaxed);
+  counts.bytes = num_bytes.load(std::memory_order_relaxed);
+  return counts;
+}
+
+void AllocationCounter::Start() {
+  if (running_) return;
+  start_ = CurrentAllocationCounts();
+  running_ = true;
+}
+
+void AllocationCounter::Stop() {
+  if (!running_) return;
+  const AllocationCounts now = CurrentAllocationCounts();
+  counts_.allocations += now.allocations - start_.allocations;
+  counts_.bytes += now.bytes - start_.bytes;
+  running_ = false;
+}
+
+string AllocationCounter::PerUnitLabel(int64 units, const string &unit) const {
+  const double per_unit = units > 0 ? 1.0 / units : 0.0;
+  return tensorflow::strings::Printf(
+      "%.1f allocs/%s %.0f bytes/%s", counts_.allocations * per_unit,
+      unit.c_str(), counts_.bytes * per_unit, unit.c_str());
+}
+
+}  // namespace syntaxnet
+
+void *operator new(size_t size) { return syntaxnet::CountedNew(size); }
+void *operator new[](size_t size) { return syntaxnet::CountedNew(size); }
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return syntaxnet::CountedMalloc(size);
+}
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return syntaxnet::CountedMalloc(size);
+}
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete[](void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, const std::nothrow_t &) noexcept { free(ptr); }
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  free(ptr);
+}
@@ -0,0 +1,74 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Counting of the heap allocations of a process, for benchmarks that track
+// allocations along with throughput. Linking the allocation_counter library
+// replaces the global operator new and delete with versions that count each
+// allocation and its requested bytes before calling malloc() and free(), so
+// it is only meant for benchmark binaries. Protocol buffers, strings and
+// containers all allocate through operator new. Tensors, which the CPU
+// allocator of TensorFlow takes from aligned malloc() directly, are not
+// counted.
+
+#ifndef SYNTAXNET_ALLOCATION_COUNTER_H_
+#define SYNTAXNET_ALLOCATION_COUNTER_H_
+
+#include <string>
+
+#include "syntaxnet/utils.h"
+
+namespace syntaxnet {
+
+// Numbers of heap allocations and of the bytes they requested.
+struct AllocationCounts {
+  int64 allocations = 0;
+  int64 bytes = 0;
+};
+
+// Returns the counts of all threads of the process since it started.
+AllocationCounts CurrentAllocationCounts();
+
+// Accumulates the allocations of the process between calls of Start() and
+// Stop(), e.g. around the timed parts of a benchmark. Allocations of other
+// threads are counted too, so measured code should run on its own.
+class AllocationCounter {
+ public:
+  AllocationCounter() {}
+
+  // Starts or stops counting. Counting starts stopped.
+  void Start();
+  void Stop();
+
+  // Returns the counts of the stopped counter.
+  const AllocationCounts &counts() const { return counts_; }
+
+  // Returns a benchmark label with the counts per unit, e.g.
+  // "12.5 allocs/sentence 830 bytes/sentence".
+  string PerUnitLabel(int64 units, const string &unit) const;
+
+ private:
+  // Counts of the process when counting last started.
+  AllocationCounts start_;
+
+  // Counts accumulated between the calls of Start() and Stop() so far.
+  AllocationCounts counts_;
+  bool running_ = false;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AllocationCounter);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_ALLOCATION_COUNTER_H_
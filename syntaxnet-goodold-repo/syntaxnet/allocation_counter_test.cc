@@ -0,0 +1,53 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/allocation_counter.h"
+
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+TEST(AllocationCounterTest, CountsAllocationsAndBytes) {
+  AllocationCounter counter;
+  counter.Start();
+  std::unique_ptr<int64> value(new int64(1));
+  std::vector<char> chars(100);
+  std::unique_ptr<int> nothrow(new (std::nothrow) int(2));
+  counter.Stop();
+  EXPECT_EQ(3, counter.counts().allocations);
+  EXPECT_EQ(sizeof(int64) + 100 + sizeof(int), counter.counts().bytes);
+}
+
+TEST(AllocationCounterTest, OnlyCountsWhileStarted) {
+  AllocationCounter counter;
+  std::vector<int> before(10);
+  counter.Start();
+  std::vector<int> during(20);
+  counter.Stop();
+  std::vector<int> after(30);
+  counter.Start();
+  std::vector<int> again(40);
+  counter.Stop();
+  EXPECT_EQ(2, counter.counts().allocations);
+  EXPECT_EQ(60 * sizeof(int), counter.counts().bytes);
+  EXPECT_EQ("0.5 allocs/sentence 60 bytes/sentence",
+            counter.PerUnitLabel(4, "sentence"));
+}
+
+}  // namespace syntaxnet
@@ -27,11 +27,20 @@ limitations under the License.
 //  - A SHIFT action is encoded as 0.
 //  - A LEFT_ARC action is encoded as an odd number starting from 1.
 //  - A RIGHT_ARC action is encoded as an even number starting from 2.
+//
+// With the 'use_label_constraints' task parameter, the arcs between tokens
+// whose tags were seen with some labels in the training corpus are only
+// allowed with these labels; see ArcLabelConstraints and LexiconBuilder.
 
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "syntaxnet/parser_state.h"
 #include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/shared_store.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/term_frequency_map.h"
 #include "syntaxnet/utils.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 
@@ -92,6 +101,56 @@ class ArcStandardTransitionState : public ParserTransitionState {
 
 class ArcStandardTransitionSystem : public ParserTransitionSystem {
  public:
+  ~ArcStandardTransitionSystem() override { SharedStore::Release(tag_map_); }
+
+  // Determines the locations of the label constraints and of the maps of the
+  // tags and labels they are indexed by, if the labels are constrained.
+  void Setup(TaskContext *context) override {
+    use_label_constraints_ = context->Get("use_label_constraints", false);
+    if (!use_label_constraints_) return;
+    input_tag_map_ = context->GetInput("tag-map", "text", "");
+    input_label_map_ = context->GetInput("label-map", "text", "");
+    input_label_constraints_ =
+        context->GetInput("label-constraints", "text", "");
+  }
+
+  // Reads the label constraints and indexes them by tag and label ids. Tag
+  // pairs whose labels are all unknown are left unconstrained.
+  void Init(TaskContext *context) override {
+    if (!use_label_constraints_) return;
+    const string tag_map_path = TaskContext::InputFile(*input_tag_map_);
+    tag_map_ = SharedStoreUtils::GetWithDefaultName<TermFrequencyMap>(
+        tag_map_path, 0, 0);
+    const string label_map_path = TaskContext::InputFile(*input_label_map_);
+    const TermFrequencyMap *label_map =
+        SharedStoreUtils::GetWithDefaultName<TermFrequencyMap>(label_map_path,
+                                                               0, 0);
+    const ArcLabelConstraints constraints(
+        TaskContext::InputFile(*input_label_constraints_));
+    num_tags_ = tag_map_->Size();
+    num_labels_ = label_map->Size();
+    allowed_labels_.clear();
+    for (const auto &it : constraints.labels()) {
+      const int head_tag = it.first.first == ArcLabelConstraints::kRootTag
+                               ? num_tags_
+                               : tag_map_->LookupIndex(it.first.first, -1);
+      const int dependent_tag = tag_map_->LookupIndex(it.first.second, -1);
+      if (head_tag < 0 || dependent_tag < 0) continue;
+      std::vector<uint8> allowed(num_labels_, 0);
+      bool any_allowed = false;
+      for (const string &label : it.second) {
+        const int id = label_map->LookupIndex(label, -1);
+        if (id < 0) continue;
+        allowed[id] = 1;
+        any_allowed = true;
+      }
+      if (any_allowed) {
+        allowed_labels_[TagPairKey(head_tag, dependent_tag)].swap(allowed);
+      }
+    }
+    SharedStore::Release(label_map);
+  }
+
   // Action types for the arc-standard transition system.
   enum ParserActionType {
     SHIFT = 0,
@@ -135,7 +194,16 @@ class ArcStandardTransitionSystem : public ParserTransitionSystem {
     // If there are further tokens available in the input then Shift.
     if (!state.EndOfInput()) return ShiftAction();
 
-    // Do a "reduce".
+    // Do a "reduce", with the first allowed label if label 2 is not.
+    const uint8 *labels =
+        state.StackSize() > 1
+            ? AllowedLabels(state, state.Stack(1), state.Stack(0))
+            : nullptr;
+    if (!IsAllowedLabel(labels, 2)) {
+      for (int label = 0; label < num_labels_; ++label) {
+        if (labels[label]) return RightArcAction(label);
+      }
+    }
     return RightArcAction(2);
   }
 
@@ -198,14 +266,86 @@ class ArcStandardTransitionSystem : public ParserTransitionSystem {
       case SHIFT:
         return IsAllowedShift(state);
       case LEFT_ARC:
-        return IsAllowedLeftArc(state);
+        return IsAllowedLeftArc(state) &&
+               IsAllowedLabel(
+                   AllowedLabels(state, state.Stack(0), state.Stack(1)),
+                   Label(action));
       case RIGHT_ARC:
-        return IsAllowedRightArc(state);
+        return IsAllowedRightArc(state) &&
+               IsAllowedLabel(
+                   AllowedLabels(state, state.Stack(1), state.Stack(0)),
+                   Label(action));
     }
 
     return false;
   }
 
+  // Fills in the allowed flags of all actions from the three action types,
+  // which are interleaved as shift, then left-arc and right-arc per label,
+  // and from the labels allowed between the two tokens on top of the stack.
+  void GetAllowedActions(const ParserState &state,
+                         std::vector<uint8> *allowed) const override {
+    const int num_actions = allowed->size();
+    if (num_actions == 0) return;
+    uint8 *flags = allowed->data();
+    const uint8 left_arc = IsAllowedLeftArc(state);
+    const uint8 right_arc = IsAllowedRightArc(state);
+    flags[SHIFT] = IsAllowedShift(state);
+    for (int action = 1; action + 1 < num_actions; action += 2) {
+      flags[action] = left_arc;
+      flags[action + 1] = right_arc;
+    }
+    if (num_actions % 2 == 0) flags[num_actions - 1] = left_arc;
+    if (allowed_labels_.empty()) return;
+    if (left_arc) {
+      const uint8 *labels =
+          AllowedLabels(state, state.Stack(0), state.Stack(1));
+      if (labels != nullptr) {
+        for (int action = 1; action < num_actions; action += 2) {
+          flags[action] = IsAllowedLabel(labels, Label(action));
+        }
+      }
+    }
+    if (right_arc) {
+      const uint8 *labels =
+          AllowedLabels(state, state.Stack(1), state.Stack(0));
+      if (labels != nullptr) {
+        for (int action = 2; action < num_actions; action += 2) {
+          flags[action] = IsAllowedLabel(labels, Label(action));
+        }
+      }
+    }
+  }
+
+  // Returns the allowed flags of the labels of arcs from the head to the
+  // dependent token, or null if all labels are allowed.
+  const uint8 *AllowedLabels(const ParserState &state, int head,
+                             int dependent) const {
+    if (allowed_labels_.empty()) return nullptr;
+    const int head_tag = head == -1 ? num_tags_ : TagId(state, head);
+    const int dependent_tag = TagId(state, dependent);
+    if (head_tag < 0 || dependent_tag < 0) return nullptr;
+    const auto it = allowed_labels_.find(TagPairKey(head_tag, dependent_tag));
+    return it == allowed_labels_.end() ? nullptr : it->second.data();
+  }
+
+  // Returns whether the label is allowed by the flags from AllowedLabels().
+  bool IsAllowedLabel(const uint8 *labels, int label) const {
+    return labels == nullptr ||
+           (label >= 0 && label < num_labels_ && labels[label]);
+  }
+
+  // Returns the id of the tag of a token, or -1 if it is unknown.
+  int TagId(const ParserState &state, int index) const {
+    return tag_map_->LookupIndex(state.GetToken(index).tag(), -1);
+  }
+
+  // Returns the key of a pair of head and dependent tag ids, where the head
+  // tag id of the root is num_tags_.
+  int64 TagPairKey(int head_tag, int dependent_tag) const {
+    return static_cast<int64>(head_tag) * (num_tags_ + 1) + dependent_tag;
+  }
+
   // Returns true if a shift is allowed in the given parser state.
   bool IsAllowedShift(const ParserState &state) const {
     // We can shift if there are more input tokens.
@@ -242,6 +382,18 @@ class ArcStandardTransitionSystem : public ParserTransitionSystem {
     }
   }
 
+  // Performs the actions of a batch of states without virtual calls, so the
+  // transitions and the final state checks inline into one loop.
+  void PerformActions(const ParserAction *actions, ParserState *const *states,
+                      int num_states, uint8 *is_final) const override {
+    for (int i = 0; i < num_states; ++i) {
+      ParserState *state = states[i];
+      ArcStandardTransitionSystem::PerformActionWithoutHistory(actions[i],
+                                                               state);
+      is_final[i] = ArcStandardTransitionSystem::IsFinalState(*state);
+    }
+  }
+
   // Makes a shift by pushing the next input token on the stack and moving to
   // the next position.
   void PerformShift(ParserState *state) const {
@@ -298,6 +450,26 @@ class ArcStandardTransitionSystem : public ParserTransitionSystem {
   ParserTransitionState *NewTransitionState(bool training_mode) const override {
     return new ArcStandardTransitionState();
   }
+
+ private:
+  // Whether the labels of arcs are constrained by the tags of their tokens.
+  bool use_label_constraints_ = false;
+
+  // Inputs of the tag map, the label map and the label constraints.
+  TaskInput *input_tag_map_ = nullptr;
+  TaskInput *input_label_map_ = nullptr;
+  TaskInput *input_label_constraints_ = nullptr;
+
+  // Tag map, for the tag ids of the tokens.
+  const TermFrequencyMap *tag_map_ = nullptr;
+
+  // Number of tags and labels in the maps.
+  int num_tags_ = 0;
+  int num_labels_ = 0;
+
+  // Allowed flags of the labels by pair of head and dependent tags, see
+  // TagPairKey(). Empty if the labels are not constrained.
+  std::unordered_map<int64, std::vector<uint8>> allowed_labels_;
 };
 
 REGISTER_TRANSITION_SYSTEM("arc-standard", ArcStandardTransitionSystem);
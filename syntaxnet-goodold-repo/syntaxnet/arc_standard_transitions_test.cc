@@ -13,8 +13,10 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <math.h>
 #include <memory>
 #include <string>
+#include <vector>
 #include "syntaxnet/parser_state.h"
 #include "syntaxnet/parser_transitions.h"
 #include "syntaxnet/populate_test_inputs.h"
@@ -40,9 +42,15 @@ class ArcStandardTransitionTest : public ::testing::Test {
   // Creates a label map and a tag map for testing based on the given
   // document and initializes the transition system appropriately.
   void SetUpForDocument(const Sentence &document) {
+    SetUpForDocument(document, PopulateTestInputs::Defaults(document));
+  }
+
+  // As above, but creates the inputs with the given creators.
+  void SetUpForDocument(const Sentence &document,
+                        const PopulateTestInputs::CreatorMap &creators) {
     input_label_map_ = context_.GetInput("label-map", "text", "");
     transition_system_->Setup(&context_);
-    PopulateTestInputs::Defaults(document).Populate(&context_);
+    creators.Populate(&context_);
     label_map_.Load(TaskContext::InputFile(*input_label_map_),
                     0 /* minimum frequency */,
                     -1 /* maximum number of terms */);
@@ -114,4 +122,197 @@ TEST_F(ArcStandardTransitionTest, SingleSentenceDocumentTest) {
   DefaultParse(&document);
 }
 
+TEST_F(ArcStandardTransitionTest, ClonesDoNotShareModifications) {
+  string document_text;
+  Sentence document;
+  TF_CHECK_OK(ReadFileToString(
+      tensorflow::Env::Default(),
+      "syntaxnet/testdata/document",
+      &document_text));
+  CHECK(TextFormat::ParseFromString(document_text, &document));
+  SetUpForDocument(document);
+
+  // Follows the gold path, advancing a clone of the state at every step and
+  // checking that the original state is not affected by the clone.
+  std::unique_ptr<ParserState> state(NewClonedState(&document));
+  while (!transition_system_->IsFinalState(*state)) {
+    const string before = state->ToString();
+    std::vector<int> stack;
+    for (int i = 0; i < state->StackSize(); ++i) {
+      stack.push_back(state->Stack(i));
+    }
+    std::vector<int> heads;
+    for (int i = 0; i < document.token_size(); ++i) {
+      heads.push_back(state->Head(i));
+    }
+    std::unique_ptr<ParserState> clone(state->Clone());
+    const ParserAction action = transition_system_->GetNextGoldAction(*clone);
+    transition_system_->PerformActionWithoutHistory(action, clone.get());
+    EXPECT_EQ(before, state->ToString());
+    ASSERT_EQ(stack.size(), state->StackSize());
+    for (int i = 0; i < state->StackSize(); ++i) {
+      EXPECT_EQ(stack[i], state->Stack(i));
+    }
+    for (int i = 0; i < document.token_size(); ++i) {
+      EXPECT_EQ(heads[i], state->Head(i));
+    }
+    state = std::move(clone);
+  }
+  for (int i = 0; i < document.token_size(); ++i) {
+    EXPECT_EQ(state->GoldHead(i), state->Head(i));
+  }
+}
+
+TEST_F(ArcStandardTransitionTest, AllowedActionsMatchIsAllowedAction) {
+  string document_text;
+  Sentence document;
+  TF_CHECK_OK(ReadFileToString(
+      tensorflow::Env::Default(),
+      "syntaxnet/testdata/document",
+      &document_text));
+  CHECK(TextFormat::ParseFromString(document_text, &document));
+  SetUpForDocument(document);
+
+  // Follows the gold path and checks the batched allowed flags and the masked
+  // argmax against per-action calls at every step.
+  const int num_actions = transition_system_->NumActions(label_map_.Size());
+  std::vector<float> scores(num_actions);
+  std::vector<uint8> allowed(num_actions);
+  std::unique_ptr<ParserState> state(NewClonedState(&document));
+  while (!transition_system_->IsFinalState(*state)) {
+    transition_system_->GetAllowedActions(*state, &allowed);
+    for (int action = 0; action < num_actions; ++action) {
+      EXPECT_EQ(transition_system_->IsAllowedAction(action, *state),
+                allowed[action] != 0);
+      scores[action] = (action * 7) % 5;
+    }
+    int expected_action = 0;
+    float expected_score = -INFINITY;
+    for (int action = 0; action < num_actions; ++action) {
+      if (scores[action] > expected_score &&
+          transition_system_->IsAllowedAction(action, *state)) {
+        expected_action = action;
+        expected_score = scores[action];
+      }
+    }
+    EXPECT_EQ(expected_action,
+              transition_system_->BestAllowedAction(*state, scores.data(),
+                                                    num_actions, &allowed));
+    transition_system_->PerformActionWithoutHistory(
+        transition_system_->GetNextGoldAction(*state), state.get());
+  }
+}
+
+TEST_F(ArcStandardTransitionTest, PerformActionsMatchesPerformAction) {
+  string document_text;
+  Sentence document;
+  TF_CHECK_OK(ReadFileToString(
+      tensorflow::Env::Default(),
+      "syntaxnet/testdata/document",
+      &document_text));
+  CHECK(TextFormat::ParseFromString(document_text, &document));
+  SetUpForDocument(document);
+
+  // Builds a batch of states at successive points of the gold path, and
+  // advances it both in one batch and one state at a time.
+  std::vector<std::unique_ptr<ParserState>> batched;
+  std::vector<std::unique_ptr<ParserState>> expected;
+  std::unique_ptr<ParserState> state(NewClonedState(&document));
+  while (!transition_system_->IsFinalState(*state)) {
+    batched.emplace_back(state->Clone());
+    expected.emplace_back(state->Clone());
+    transition_system_->PerformAction(
+        transition_system_->GetNextGoldAction(*state), state.get());
+  }
+  while (!batched.empty()) {
+    std::vector<ParserAction> actions;
+    std::vector<ParserState *> states;
+    for (const auto &batched_state : batched) {
+      actions.push_back(transition_system_->GetNextGoldAction(*batched_state));
+      states.push_back(batched_state.get());
+    }
+    std::vector<uint8> is_final(batched.size());
+    transition_system_->PerformActions(actions.data(), states.data(),
+                                       states.size(), is_final.data());
+    std::vector<std::unique_ptr<ParserState>> unfinished_batched;
+    std::vector<std::unique_ptr<ParserState>> unfinished_expected;
+    for (size_t i = 0; i < batched.size(); ++i) {
+      transition_system_->PerformAction(actions[i], expected[i].get());
+      EXPECT_EQ(expected[i]->ToString(), batched[i]->ToString());
+      for (int t = 0; t < document.token_size(); ++t) {
+        EXPECT_EQ(expected[i]->Head(t), batched[i]->Head(t));
+        EXPECT_EQ(expected[i]->Label(t), batched[i]->Label(t));
+      }
+      EXPECT_EQ(transition_system_->IsFinalState(*expected[i]),
+                is_final[i] != 0);
+      if (!is_final[i]) {
+        unfinished_batched.push_back(std::move(batched[i]));
+        unfinished_expected.push_back(std::move(expected[i]));
+      }
+    }
+    batched.swap(unfinished_batched);
+    expected.swap(unfinished_expected);
+  }
+}
+
+TEST_F(ArcStandardTransitionTest, LabelConstraintsAllowOnlySeenLabels) {
+  string document_text;
+  Sentence document;
+  TF_CHECK_OK(ReadFileToString(
+      tensorflow::Env::Default(),
+      "syntaxnet/testdata/document",
+      &document_text));
+  CHECK(TextFormat::ParseFromString(document_text, &document));
+
+  // Allows only the gold labels between the tags of the document.
+  auto tag = [&document](int index) {
+    return index == -1 ? string(ArcLabelConstraints::kRootTag)
+                       : document.token(index).tag();
+  };
+  ArcLabelConstraints constraints;
+  for (int i = 0; i < document.token_size(); ++i) {
+    constraints.Add(tag(document.token(i).head()), tag(i),
+                    document.token(i).label());
+  }
+  context_.SetParameter("use_label_constraints", "true");
+  auto creators = PopulateTestInputs::Defaults(document);
+  creators.Add("label-constraints", "text", "",
+               [&constraints](const string &filename) {
+                 constraints.Save(filename);
+               });
+  SetUpForDocument(document, creators);
+  GoldParse(&document);
+  DefaultParse(&document);
+
+  // Follows the gold path and checks that the allowed arcs between the top
+  // tokens of the stack have labels seen between their tags.
+  const int num_actions = transition_system_->NumActions(label_map_.Size());
+  std::vector<uint8> allowed(num_actions);
+  int num_pruned = 0;
+  std::unique_ptr<ParserState> state(NewClonedState(&document));
+  while (!transition_system_->IsFinalState(*state)) {
+    transition_system_->GetAllowedActions(*state, &allowed);
+    for (int action = 1; action < num_actions; ++action) {
+      const bool left_arc = action % 2 == 1;
+      const bool arc_allowed = state->StackSize() > (left_arc ? 2 : 1);
+      if (!arc_allowed) {
+        EXPECT_FALSE(allowed[action]);
+        continue;
+      }
+      const int head = state->Stack(left_arc ? 0 : 1);
+      const int dependent = state->Stack(left_arc ? 1 : 0);
+      const auto it =
+          constraints.labels().find(std::make_pair(tag(head), tag(dependent)));
+      const bool expected =
+          it == constraints.labels().end() ||
+          it->second.count(label_map_.GetTerm((action - 1) >> 1)) > 0;
+      EXPECT_EQ(expected, allowed[action] != 0);
+      if (!expected) ++num_pruned;
+    }
+    transition_system_->PerformActionWithoutHistory(
+        transition_system_->GetNextGoldAction(*state), state.get());
+  }
+  EXPECT_GT(num_pruned, 0);
+}
+
 }  // namespace syntaxnet
@@ -35,6 +35,7 @@ using tensorflow::int64;
 using tensorflow::uint64;
 using tensorflow::uint32;
 using tensorflow::uint32;
+using tensorflow::uint8;
 using tensorflow::protobuf::TextFormat;
 using tensorflow::mutex_lock;
 using tensorflow::mutex;
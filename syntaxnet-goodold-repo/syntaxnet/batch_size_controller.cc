@@ -0,0 +1,75 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/batch_size_controller.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace syntaxnet {
+namespace {
+
+// Weight of the previous steps relative to the last one at each update.
+const double kDecay = 0.8;
+
+// Variance of the recent batch sizes below which they count as the same.
+const double kMinSizeVariance = 0.25;
+
+}  // namespace
+
+BatchSizeController::BatchSizeController(int max_batch_size,
+                                         int64 target_micros)
+    : max_batch_size_(std::max(max_batch_size, 1)),
+      target_micros_(target_micros),
+      batch_size_(max_batch_size_) {}
+
+int BatchSizeController::Update(int batch_size, int64 step_micros,
+                                int backlog) {
+  if (batch_size <= 0 || step_micros <= 0) return batch_size_;
+  const double size = batch_size;
+  const double micros = step_micros;
+  sum_weights_ = kDecay * sum_weights_ + 1;
+  sum_sizes_ = kDecay * sum_sizes_ + size;
+  sum_micros_ = kDecay * sum_micros_ + micros;
+  sum_size_squares_ = kDecay * sum_size_squares_ + size * size;
+  sum_size_micros_ = kDecay * sum_size_micros_ + size * micros;
+
+  const double mean_size = sum_sizes_ / sum_weights_;
+  const double mean_micros = sum_micros_ / sum_weights_;
+  const double size_variance =
+      sum_size_squares_ / sum_weights_ - mean_size * mean_size;
+  double slope = 0;
+  if (size_variance >= kMinSizeVariance) {
+    slope = (sum_size_micros_ / sum_weights_ - mean_size * mean_micros) /
+            size_variance;
+  }
+  if (slope * mean_size <= 0 || slope * mean_size > mean_micros) {
+    // Steps of the same size, or too noisy to tell the fixed cost apart.
+    slope = mean_micros / mean_size;
+  }
+  micros_per_sentence_ = slope;
+  fixed_micros_ = mean_micros - slope * mean_size;
+
+  const double affordable =
+      std::floor((target_micros_ - fixed_micros_) / micros_per_sentence_);
+  int next = affordable < max_batch_size_ ? static_cast<int>(affordable)
+                                          : max_batch_size_;
+  next = std::min(next, 2 * batch_size_);
+  if (backlog >= 0) next = std::min(next, batch_size + backlog);
+  batch_size_ = std::min(std::max(next, 1), max_batch_size_);
+  return batch_size_;
+}
+
+}  // namespace syntaxnet
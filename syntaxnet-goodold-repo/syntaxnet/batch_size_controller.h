@@ -0,0 +1,76 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Feedback controller for the number of sentences a reader parses at a time.
+
+#ifndef SYNTAXNET_BATCH_SIZE_CONTROLLER_H_
+#define SYNTAXNET_BATCH_SIZE_CONTROLLER_H_
+
+#include "syntaxnet/utils.h"
+
+namespace syntaxnet {
+
+// Chooses the batch size of the next step of a reader from the measured cost of
+// its past steps, the number of sentences waiting to enter the batch and a
+// target wall time per step.
+//
+// The cost of a step is modeled as a fixed cost plus a cost per sentence in the
+// batch, fitted by least squares to the recent steps, with the weight of each
+// step decaying geometrically. While all recent steps had the same batch size,
+// the fixed cost is taken to be 0, which overestimates the cost per sentence.
+// The next batch size is the largest one whose predicted cost meets the target,
+// at most twice the current one, and no larger than the sentences in the batch
+// and waiting for it, so that the limit follows the traffic down and climbs
+// straight back up when a backlog builds.
+class BatchSizeController {
+ public:
+  // Controls batch sizes in [1, max_batch_size], starting at max_batch_size.
+  BatchSizeController(int max_batch_size, int64 target_micros);
+
+  // Records a step that parsed batch_size sentences in step_micros, with
+  // backlog sentences waiting to enter the batch, or -1 if the number is
+  // unknown, e.g. for a corpus file, and returns the new batch size.
+  int Update(int batch_size, int64 step_micros, int backlog);
+
+  // Returns the current batch size.
+  int batch_size() const { return batch_size_; }
+
+  // Returns the fitted fixed cost and cost per sentence of a step.
+  double fixed_micros() const { return fixed_micros_; }
+  double micros_per_sentence() const { return micros_per_sentence_; }
+
+ private:
+  const int max_batch_size_;
+  const double target_micros_;
+  int batch_size_;
+
+  // Decayed sums of the weights, batch sizes and costs of the steps, and of
+  // their squares and products.
+  double sum_weights_ = 0;
+  double sum_sizes_ = 0;
+  double sum_micros_ = 0;
+  double sum_size_squares_ = 0;
+  double sum_size_micros_ = 0;
+
+  // Current cost model.
+  double fixed_micros_ = 0;
+  double micros_per_sentence_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BatchSizeController);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_BATCH_SIZE_CONTROLLER_H_
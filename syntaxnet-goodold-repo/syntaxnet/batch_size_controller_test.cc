@@ -0,0 +1,67 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/batch_size_controller.h"
+
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+// Cost of a step in the tests: 1ms plus 0.1ms per sentence.
+int64 StepMicros(int batch_size) { return 1000 + 100 * batch_size; }
+
+TEST(BatchSizeControllerTest, ConvergesToTheTarget) {
+  BatchSizeController controller(64, 3000);
+  EXPECT_EQ(64, controller.batch_size());
+  for (int step = 0; step < 10; ++step) {
+    const int batch_size = controller.batch_size();
+    controller.Update(batch_size, StepMicros(batch_size), -1);
+  }
+  EXPECT_NEAR(20, controller.batch_size(), 1);
+  EXPECT_NEAR(1000, controller.fixed_micros(), 10);
+  EXPECT_NEAR(100, controller.micros_per_sentence(), 1);
+}
+
+TEST(BatchSizeControllerTest, GrowsAtMostTwofoldPerStep) {
+  BatchSizeController controller(64, 100000);
+  controller.Update(64, 10000, -1);
+  EXPECT_EQ(64, controller.batch_size());
+  controller.Update(64, 1000000, -1);
+  const int shrunk = controller.batch_size();
+  EXPECT_LT(shrunk, 32);
+  controller.Update(shrunk, 10, -1);
+  EXPECT_LE(controller.batch_size(), 2 * shrunk);
+}
+
+TEST(BatchSizeControllerTest, FollowsTheBacklog) {
+  BatchSizeController controller(64, 3000);
+  controller.Update(4, StepMicros(4), 2);
+  EXPECT_EQ(6, controller.batch_size());
+  controller.Update(6, StepMicros(6), 0);
+  EXPECT_EQ(6, controller.batch_size());
+  controller.Update(6, StepMicros(6), 100);
+  EXPECT_EQ(12, controller.batch_size());
+}
+
+TEST(BatchSizeControllerTest, KeepsOneSentenceOverBudget) {
+  BatchSizeController controller(8, 500);
+  controller.Update(8, StepMicros(8), -1);
+  controller.Update(controller.batch_size(), StepMicros(1), -1);
+  EXPECT_EQ(1, controller.batch_size());
+}
+
+}  // namespace syntaxnet
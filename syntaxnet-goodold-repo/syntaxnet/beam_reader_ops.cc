@@ -15,6 +15,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <deque>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -22,21 +23,29 @@ limitations under the License.
 #include <vector>
 
 #include "syntaxnet/base.h"
+#include "syntaxnet/document_batch.h"
+#include "syntaxnet/kbest_syntax.pb.h"
+#include "syntaxnet/network_scorer.h"
 #include "syntaxnet/parser_state.h"
 #include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/reader_stats.h"
 #include "syntaxnet/sentence.pb.h"
 #include "syntaxnet/sentence_batch.h"
+#include "syntaxnet/sentence_tracing.h"
 #include "syntaxnet/shared_store.h"
 #include "syntaxnet/sparse.pb.h"
 #include "syntaxnet/task_context.h"
 #include "syntaxnet/task_spec.pb.h"
+#include "syntaxnet/top_allowed_actions.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/gtl/top_n.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 using tensorflow::DEVICE_CPU;
 using tensorflow::DT_BOOL;
@@ -60,30 +69,90 @@ namespace syntaxnet {
 // performed and the beam slot they were performed in) are recorded.
 struct ParserStateWithHistory {
  public:
+  // A step of the history of a parser state. Steps are immutable and shared
+  // between all states that branched off from the same path.
+  struct Step {
+    Step(int32 slot, int32 action, float score,
+         std::shared_ptr<const Step> previous)
+        : slot(slot), action(action), score(score),
+          previous(std::move(previous)) {}
+
+    const int32 slot;
+    const int32 action;
+    const float score;
+    const std::shared_ptr<const Step> previous;
+  };
+
   // New state with an empty history.
   explicit ParserStateWithHistory(const ParserState &s) : state(s.Clone()) {}
 
-  // New state obtained by cloning the given state and applying the given
-  // action. The given beam slot and action are appended to the history.
-  ParserStateWithHistory(const ParserStateWithHistory &next,
-                         const ParserTransitionSystem &transitions, int32 slot,
+  // New state obtained by applying the given action to the given state. The
+  // state itself is only created by Materialize(), so that candidates which
+  // are pruned from the beam never need to be built. Until then, the previous
+  // state must stay alive.
+  ParserStateWithHistory(const ParserStateWithHistory &previous, int32 slot,
                          int32 action, float score)
-      : state(next.state->Clone()),
-        slot_history(next.slot_history),
-        action_history(next.action_history),
-        score_history(next.score_history) {
-    transitions.PerformAction(action, state.get());
-    slot_history.push_back(slot);
-    action_history.push_back(action);
-    score_history.push_back(score);
+      : previous_(&previous), slot_(slot), action_(action), score_(score) {}
+
+  // Builds the parser state by cloning the previous state and applying the
+  // action, and appends the beam slot and action to the history if
+  // record_history is true. Does nothing if the state has already been built.
+  // If the action kept the next input token, the input features of the state
+  // are those of the previous state, which are kept for the extraction.
+  void Materialize(const ParserTransitionSystem &transitions, bool is_gold,
+                   bool record_history) {
+    if (state != nullptr) return;
+    state.reset(previous_->state->Clone());
+    transitions.PerformAction(action_, state.get());
+    state->set_is_gold(is_gold);
+    if (state->Next() == previous_->state->Next()) {
+      input_source = previous_->features;
+    }
+    if (record_history) {
+      history = std::make_shared<const Step>(slot_, action_, score_,
+                                             previous_->history);
+      history_size = previous_->history_size + 1;
+    }
+    previous_ = nullptr;
+  }
+
+  // Returns the recorded history, oldest step first.
+  void GetHistory(std::vector<int32> *slots, std::vector<int32> *actions,
+                  std::vector<float> *scores) const {
+    slots->resize(history_size);
+    actions->resize(history_size);
+    scores->resize(history_size);
+    int i = history_size;
+    for (const Step *step = history.get(); step != nullptr;
+         step = step->previous.get()) {
+      --i;
+      (*slots)[i] = step->slot;
+      (*actions)[i] = step->action;
+      (*scores)[i] = step->score;
+    }
   }
 
   std::unique_ptr<ParserState> state;
-  std::vector<int32> slot_history;
-  std::vector<int32> action_history;
-  std::vector<float> score_history;
+  std::shared_ptr<const Step> history;
+  int history_size = 0;
+
+  // Sparse features of the state once extracted, which the successors that
+  // keep its next input token share their input features with.
+  typedef std::vector<std::vector<SparseFeatures>> Features;
+  std::shared_ptr<const Features> features;
+
+  // Features of the state this state was advanced from, if they can provide
+  // the input features of this state, until its features are extracted.
+  std::shared_ptr<const Features> input_source;
 
  private:
+  // State this state is obtained from, and the transition leading here, while
+  // the state has not been materialized.
+  const ParserStateWithHistory *previous_ = nullptr;
+  int32 slot_ = -1;
+  int32 action_ = -1;
+  float score_ = 0.0;
+
   TF_DISALLOW_COPY_AND_ASSIGN(ParserStateWithHistory);
 };
 
@@ -112,6 +181,29 @@ struct BatchStateOptions {
 
   // Parameter for deciding which tokens to score.
   string scoring_type;
+
+  // Whether to record the path histories and the score offsets of all steps,
+  // which BeamParserOutput needs to compute the training cost. Otherwise,
+  // only the offsets of the current step are kept, and memory does not grow
+  // with the number of steps.
+  bool record_history = true;
+
+  // If positive, successors scoring more than this below the best successor
+  // of a beam are pruned, so that the beam shrinks, down to a single state,
+  // when its best path stands out. Gold successors are still kept while the
+  // gold path has to stay in the beam.
+  float beam_prune_margin = 0.0;
+
+  // Whether a beam which is not recording history finishes at once when it is
+  // down to a single state with only forced transitions left, performing them
+  // without scoring them.
+  bool early_termination = false;
+
+  // If positive, a beam which is not recording history advances with at most
+  // this many states per step for this many steps of a sentence, and then
+  // finishes greedily from its best state, which bounds the number of
+  // states scored for long sentences.
+  int beam_step_budget = 0;
 };
 
 // Encapsulates the environment needed to parse with a beam, keeping a
@@ -151,6 +243,7 @@ class BeamState {
       AdvanceSentence();
     }
     slots_.clear();
+    steps_ = 0;
     if (gold_ == nullptr) {
       state_ = DEAD;  // EOF has been reached.
     } else {
@@ -175,9 +268,9 @@ class BeamState {
   }
 
   // This method updates the beam. For all elements of the beam, all
-  // allowed transitions are scored and insterted into a new beam. The
-  // beam size is capped by discarding the lowest scoring slots at any
-  // given time. There is one exception to this process: the gold path
+  // allowed transitions are scored, and the best scoring successors are
+  // selected into a new beam of bounded size before any of their parser
+  // states are built. There is one exception to this process: the gold path
   // is forced to remain in the beam at all times, even if it scores
   // low. This is to ensure that the gold path can be used for
   // training at the moment it would otherwise fall off (and be absent
@@ -189,7 +282,11 @@ class BeamState {
     // When to stop advancing depends on the 'continue_until_all_final' arg.
     if (!IsAlive() || gold_ == nullptr) return;
 
+    ScopedStageTimer timer(kBeamAdvance);
+    SentenceSpan span("decode_step", gold_->sentence());
     AdvanceGold();
+    const int beam_size = StepBeamSize();
+    ++steps_;
 
     const int score_rows = scores.dimension(0);
     const int num_actions = scores.dimension(1);
@@ -200,6 +297,17 @@ class BeamState {
 
     CHECK_EQ(state_, ALIVE);
 
+    // Scores the best allowed successors of each slot, only keeping the best
+    // ones overall and the gold one. No slot can contribute more successors
+    // than the beam holds, so only its best beam_size actions are pushed, plus
+    // one for gold slots since the gold successor loses its ties.
+    tensorflow::gtl::TopN<Successor, SuccessorGreater> best(beam_size);
+    std::vector<uint8> allowed(num_actions);
+    std::vector<int> top_actions(beam_size + 1);
+    std::vector<float> top_scores(beam_size + 1);
+    Successor gold;
+    bool has_gold = false;
+    int order = 0;
     int slot = 0;
     for (AgendaItem &item : previous_slots) {
       {
@@ -209,38 +317,129 @@ class BeamState {
         VLOG(2) << "Parser state cumulative score: " << item.first.first << " "
                 << (item.first.second < 0 ? "golden" : "");
       }
+      const bool item_is_gold = item.second->state->is_gold();
+      Successor successor;
+      successor.item = &item;
+      successor.slot = slot;
       if (!transition_system_->IsFinalState(*item.second->state)) {
-        // Not a final state.
-        for (int action = 0; action < num_actions; ++action) {
-          // Is action allowed?
-          if (!transition_system_->IsAllowedAction(action,
-                                                   *item.second->state)) {
-            continue;
+        // Not a final state. Successors are ordered by slot, then action.
+        CHECK_LT(slot, score_rows);
+        const float *slot_scores = scores.data() + slot * num_actions;
+        transition_system_->GetAllowedActions(*item.second->state, &allowed);
+        const int num_top = TopAllowedActions(
+            slot_scores, allowed.data(), num_actions,
+            beam_size + (item_is_gold ? 1 : 0), false,
+            top_actions.data(), top_scores.data());
+        for (int i = 0; i < num_top; ++i) {
+          const int action = top_actions[i];
+          const bool is_gold = item_is_gold && action == gold_action_;
+          successor.delta_score = top_scores[i];
+          successor.key = KeyType(item.first.first + successor.delta_score,
+                                  -static_cast<int>(is_gold));
+          successor.action = action;
+          successor.order = order + action;
+          if (is_gold) {
+            gold = successor;
+            has_gold = true;
           }
-          CHECK_LT(slot, score_rows);
-          MaybeInsertWithNewAction(item, slot, scores(slot, action), action);
-          PruneBeam();
+          best.push(successor);
         }
+
+        // The gold successor is kept even if it is not among the best.
+        if (item_is_gold && !has_gold && gold_action_ >= 0 &&
+            gold_action_ < num_actions && allowed[gold_action_]) {
+          gold = successor;
+          gold.delta_score = slot_scores[gold_action_];
+          gold.key = KeyType(item.first.first + gold.delta_score, -1);
+          gold.action = gold_action_;
+          gold.order = order + gold_action_;
+          has_gold = true;
+        }
+        order += num_actions;
       } else {
         // Final state: no need to advance.
-        MaybeInsert(&item);
-        PruneBeam();
+        successor.delta_score = 0.0;
+        successor.key = item.first;
+        successor.action = -1;
+        successor.order = order++;
+        if (item_is_gold) {
+          gold = successor;
+          has_gold = true;
+        }
+        best.push(successor);
       }
       ++slot;
     }
+
+    // If the gold successor did not make it, it replaces the lowest scoring
+    // one, and this is the last step for this beam.
+    std::unique_ptr<std::vector<Successor>> selected(best.Extract());
+    if (has_gold && !options_.continue_until_all_final &&
+        std::none_of(selected->begin(), selected->end(),
+                     [&gold](const Successor &s) {
+                       return s.order == gold.order;
+                     })) {
+      state_ = DYING;
+      selected->back() = gold;
+    }
+    if (options_.beam_prune_margin > 0.0) Prune(selected.get());
+
+    // Builds the parser states of the selected successors.
+    for (const Successor &successor : *selected) {
+      AgendaItem *item = successor.item;
+      if (successor.action < 0) {
+        slots_.emplace(successor.key, std::move(item->second));
+      } else {
+        auto inserted = slots_.emplace(
+            successor.key,
+            std::unique_ptr<ParserStateWithHistory>(new ParserStateWithHistory(
+                *item->second, successor.slot, successor.action,
+                successor.delta_score)));
+        inserted->second->Materialize(*transition_system_,
+                                      successor.key.second < 0,
+                                      options_.record_history);
+      }
+    }
+    if (options_.early_termination && !options_.record_history) {
+      FinishForcedPath();
+    }
+    ReaderStats::Get()->AddBeam(slots_.size());
     UpdateAllFinal();
   }
 
-  void PopulateFeatureOutputs(
-      std::vector<std::vector<std::vector<SparseFeatures>>> *features) {
-    for (const AgendaItem &item : slots_) {
+  // Appends the parser states in the beam to states, in slot order, together
+  // with the beam they belong to.
+  void AppendStates(
+      std::vector<std::pair<const BeamState *, ParserStateWithHistory *>>
+          *states) {
+    for (AgendaItem &item : slots_) {
       VLOG(2) << "State: " << item.second->state->ToString();
-      std::vector<std::vector<SparseFeatures>> f =
-          features_->ExtractSparseFeatures(*workspace_, *item.second->state);
-      for (size_t i = 0; i < f.size(); ++i) (*features)[i].push_back(f[i]);
+      states->emplace_back(this, item.second.get());
     }
   }
 
+  // Returns the features of one of the parser states in the beam, extracting
+  // them on first use. States carried over unchanged keep their features, and
+  // states advanced without moving the next input token copy their input
+  // features from the state they were advanced from. Only touches the given
+  // state, so different states can be extracted concurrently.
+  const ParserStateWithHistory::Features &ExtractFeatures(
+      ParserStateWithHistory *item) const {
+    if (item->features == nullptr) {
+      if (item->input_source != nullptr) {
+        item->features = std::make_shared<ParserStateWithHistory::Features>(
+            features_->ExtractSparseFeaturesReusingInput(
+                *workspace_, *item->state, *input_features_,
+                *item->input_source));
+        item->input_source.reset();
+      } else {
+        item->features = std::make_shared<ParserStateWithHistory::Features>(
+            features_->ExtractSparseFeatures(*workspace_, *item->state));
+      }
+    }
+    return *item->features;
+  }
+
   int BeamSize() const { return slots_.size(); }
 
   bool IsAlive() const { return state_ == ALIVE; }
@@ -261,17 +460,21 @@ class BeamState {
   // Label map.
   const TermFrequencyMap *label_map_ = nullptr;
 
+  // Storage of the gold state and the states cloned from it.
+  ParserStateArena *state_arena_ = nullptr;
+
   // Transition system.
   const ParserTransitionSystem *transition_system_ = nullptr;
 
-  // Feature extractor.
+  // Feature extractor, and which of its features are input features.
   const ParserEmbeddingFeatureExtractor *features_ = nullptr;
+  const vector<vector<bool>> *input_features_ = nullptr;
 
   // Feature workspace set.
   WorkspaceSet *workspace_ = nullptr;
 
   // Internal workspace registry for use in feature extraction.
-  WorkspaceRegistry *workspace_registry_ = nullptr;
+  const WorkspaceRegistry *workspace_registry_ = nullptr;
 
   // ParserState used to get gold actions.
   std::unique_ptr<ParserState> gold_;
@@ -279,12 +482,20 @@ class BeamState {
  private:
   // Creates a new ParserState if there's another sentence to be read.
   void AdvanceSentence() {
-    gold_.reset();
-    if (sentence_batch_->AdvanceSentence(beam_id_)) {
-      gold_.reset(new ParserState(sentence_batch_->sentence(beam_id_),
-                                  transition_system_->NewTransitionState(true),
-                                  label_map_));
+    state_arena_->Release(std::move(gold_));
+    bool advanced;
+    {
+      ScopedStageTimer timer(kSentenceRead);
+      advanced = sentence_batch_->AdvanceSentence(beam_id_);
+    }
+    if (advanced) {
+      ReaderStats::Get()->AddSentence();
+      gold_ = state_arena_->NewState(
+          sentence_batch_->sentence(beam_id_),
+          transition_system_->NewTransitionState(true), label_map_);
       workspace_->Reset(*workspace_registry_);
+      ScopedStageTimer timer(kPreprocess);
+      SentenceSpan span("preprocess", gold_->sentence());
       features_->Preprocess(workspace_, gold_.get());
     }
   }
@@ -301,61 +512,84 @@ class BeamState {
     }
   }
 
-  // Removes the first non-gold beam element if the beam is larger than
-  // the maximum beam size. If the gold element was at the bottom of the
-  // beam, sets the beam state to DYING, otherwise leaves the state alone.
-  void PruneBeam() {
-    if (static_cast<int>(slots_.size()) > options_.max_beam_size) {
-      auto bottom = slots_.begin();
-      if (!options_.continue_until_all_final &&
-          bottom->second->state->is_gold()) {
-        state_ = DYING;
-        ++bottom;
-      }
-      slots_.erase(bottom);
-    }
-  }
-
-  // Inserts an item in the beam if
-  //   - the item is gold,
-  //   - the beam is not full, or
-  //   - the item's new score is greater than the lowest score in the beam after
-  //     the score has been incremented by given delta_score.
-  // Inserted items have slot, delta_score and action appended to their history.
-  void MaybeInsertWithNewAction(const AgendaItem &item, const int slot,
-                                const double delta_score, const int action) {
-    const double score = item.first.first + delta_score;
-    const bool is_gold =
-        item.second->state->is_gold() && action == gold_action_;
-    if (is_gold || static_cast<int>(slots_.size()) < options_.max_beam_size ||
-        score > slots_.begin()->first.first) {
-      const KeyType key{score, -static_cast<int>(is_gold)};
-      slots_.emplace(key, std::unique_ptr<ParserStateWithHistory>(
-                              new ParserStateWithHistory(
-                                  *item.second, *transition_system_, slot,
-                                  action, delta_score)))
-          ->second->state->set_is_gold(is_gold);
-    }
-  }
-
-  // Inserts an item in the beam if
-  //   - the item is gold,
-  //   - the beam is not full, or
-  //   - the item's new score is greater than the lowest score in the beam.
-  // The history of inserted items is left untouched.
-  void MaybeInsert(AgendaItem *item) {
-    const bool is_gold = item->second->state->is_gold();
-    const double score = item->first.first;
-    if (is_gold || static_cast<int>(slots_.size()) < options_.max_beam_size ||
-        score > slots_.begin()->first.first) {
-      slots_.emplace(item->first, std::move(item->second));
+  // If the beam is down to a single state that only has forced transitions
+  // left, i.e. a single allowed action at each step until it is final,
+  // performs them all, so that the state needs no more scoring. With a single
+  // state, the scores of the forced transitions cannot change the result.
+  void FinishForcedPath() {
+    if (slots_.size() != 1) return;
+    ParserState *state = slots_.begin()->second->state.get();
+    if (transition_system_->IsFinalState(*state) ||
+        !transition_system_->IsDeterministicState(*state)) {
+      return;
+    }
+    std::unique_ptr<ParserState> path(state->Clone());
+    while (!transition_system_->IsFinalState(*path)) {
+      if (!transition_system_->IsDeterministicState(*path)) return;
+      transition_system_->PerformAction(
+          transition_system_->GetDefaultAction(*path), path.get());
+    }
+    slots_.begin()->second->state = std::move(path);
+    slots_.begin()->second->features.reset();
+    slots_.begin()->second->input_source.reset();
+  }
+
+  // A successor of a state in the beam considered by Advance(). Candidates
+  // for final states carry the state itself over and have no action.
+  struct Successor {
+    KeyType key;
+    AgendaItem *item = nullptr;
+    int slot = -1;
+    int action = -1;
+    double delta_score = 0.0;
+
+    // Position in which successors were generated, used to break ties.
+    int order = 0;
+  };
+
+  // Orders successors by key, then by generation order.
+  struct SuccessorGreater {
+    bool operator()(const Successor &a, const Successor &b) const {
+      if (a.key != b.key) return a.key > b.key;
+      return a.order < b.order;
+    }
+  };
+
+  // Returns the number of states the beam may hold after the next step: the
+  // maximum beam size, or a single state once the step budget of the
+  // sentence is spent.
+  int StepBeamSize() const {
+    if (options_.beam_step_budget > 0 && !options_.record_history &&
+        steps_ >= options_.beam_step_budget) {
+      return 1;
     }
+    return options_.max_beam_size;
+  }
+
+  // Removes the selected successors, best first, scoring more than the prune
+  // margin below the best one. Gold successors are kept when the gold path
+  // has to stay in the beam.
+  void Prune(std::vector<Successor> *selected) const {
+    if (selected->empty()) return;
+    const double threshold =
+        selected->front().key.first - options_.beam_prune_margin;
+    const bool keep_gold = !options_.continue_until_all_final;
+    selected->erase(
+        std::remove_if(selected->begin(), selected->end(),
+                       [threshold, keep_gold](const Successor &s) {
+                         return s.key.first < threshold &&
+                                !(keep_gold && s.key.second < 0);
+                       }),
+        selected->end());
   }
 
   // Limits the number of slots on the beam.
   const BatchStateOptions &options_;
 
   int gold_action_ = -1;
+
+  // Number of steps the beam has advanced since the last reset.
+  int steps_ = 0;
   State state_ = ALIVE;
   bool all_final_ = false;
   TF_DISALLOW_COPY_AND_ASSIGN(BeamState);
@@ -367,15 +601,25 @@ class BeamState {
 class BatchState {
  public:
   explicit BatchState(const BatchStateOptions &options)
-      : options_(options), features_(options.arg_prefix) {}
+      : options_(options) {}
 
-  ~BatchState() { SharedStore::Release(label_map_); }
+  ~BatchState() {
+    SharedStore::Release(label_map_);
+    SharedParserFeatures::Release(shared_features_);
+  }
 
   void Init(TaskContext *task_context) {
     // Create sentence batch.
+    const int lookahead = task_context->Get(
+        tensorflow::strings::StrCat(options_.arg_prefix, "_sentence_lookahead"),
+        0);
     sentence_batch_.reset(
-        new SentenceBatch(BatchSize(), options_.corpus_name));
+        new SentenceBatch(BatchSize(), options_.corpus_name, lookahead));
     sentence_batch_->Init(task_context);
+    sentence_batch_->set_max_tokens(task_context->Get(
+        tensorflow::strings::StrCat(options_.arg_prefix,
+                                    "_max_tokens_per_batch"),
+        0));
 
     // Create transition system.
     transition_system_.reset(ParserTransitionSystem::Create(task_context->Get(
@@ -391,24 +635,30 @@ class BatchState {
         label_map_path, 0, 0);
 
     // Setup features.
-    features_.Setup(task_context);
-    features_.Init(task_context);
-    features_.RequestWorkspaces(&workspace_registry_);
+    shared_features_ = SharedParserFeatures::Get(options_.arg_prefix,
+                                                 task_context);
+    features_ = &shared_features_->features();
+    input_features_ = features_->InputFeatures();
 
     // Create workspaces.
     workspaces_.resize(BatchSize());
 
-    // Create beams.
+    // Create beams, each with its own arena so that they can be advanced
+    // concurrently.
     beams_.clear();
+    state_arenas_.clear();
     for (int beam_id = 0; beam_id < BatchSize(); ++beam_id) {
+      state_arenas_.emplace_back();
       beams_.emplace_back(options_);
       beams_[beam_id].beam_id_ = beam_id;
       beams_[beam_id].sentence_batch_ = sentence_batch_.get();
       beams_[beam_id].transition_system_ = transition_system_.get();
       beams_[beam_id].label_map_ = label_map_;
-      beams_[beam_id].features_ = &features_;
+      beams_[beam_id].state_arena_ = &state_arenas_[beam_id];
+      beams_[beam_id].features_ = features_;
+      beams_[beam_id].input_features_ = &input_features_;
       beams_[beam_id].workspace_ = &workspaces_[beam_id];
-      beams_[beam_id].workspace_registry_ = &workspace_registry_;
+      beams_[beam_id].workspace_registry_ = &shared_features_->registry();
     }
   }
 
@@ -443,7 +693,22 @@ class BatchState {
     beams_[beam_id].Advance(beam_scores);
   }
 
+  // Advances all beams with the given scores, as AdvanceBeam() does, on the
+  // device thread pool. Beams of different sentences share no state, and each
+  // allocates its parser states from its own arena, so the result does not
+  // depend on the order in which they are advanced.
+  void AdvanceBeams(OpKernelContext *context,
+                    const TTypes<float>::ConstMatrix &scores) {
+    ForEachBeam(context, [this, &scores](int beam_id) {
+      AdvanceBeam(beam_id, scores);
+    });
+  }
+
   void UpdateOffsets() {
+    if (!options_.record_history) {
+      beam_offsets_.clear();
+      step_offsets_.resize(1);
+    }
     beam_offsets_.emplace_back(BatchSize() + 1, 0);
     std::vector<int> &offsets = beam_offsets_.back();
     for (int beam_id = 0; beam_id < BatchSize(); ++beam_id) {
@@ -458,39 +723,60 @@ class BatchState {
   }
 
   tensorflow::Status PopulateFeatureOutputs(OpKernelContext *context) {
+    ScopedStageTimer timer(kFeatureExtraction);
     const int feature_size = FeatureSize();
-    std::vector<std::vector<std::vector<SparseFeatures>>> features(
-        feature_size);
+    std::vector<std::pair<const BeamState *, ParserStateWithHistory *>> states;
+    int num_live_beams = 0;
     for (int beam_id = 0; beam_id < BatchSize(); ++beam_id) {
       if (!beams_[beam_id].IsDead()) {
-        beams_[beam_id].PopulateFeatureOutputs(&features);
+        beams_[beam_id].AppendStates(&states);
+        ++num_live_beams;
       }
     }
-    CHECK_EQ(features.size(), feature_size);
-    Tensor *output;
+    ReaderStats::Get()->AddBatch(num_live_beams, BatchSize());
     const int total_slots = beam_offsets_.back().back();
+    CHECK_EQ(total_slots, states.size());
+    std::vector<Tensor *> outputs(feature_size);
     for (int i = 0; i < feature_size; ++i) {
-      std::vector<std::vector<SparseFeatures>> &f = features[i];
-      CHECK_EQ(total_slots, f.size());
-      if (total_slots == 0) {
-        TF_RETURN_IF_ERROR(
-            context->allocate_output(i, TensorShape({0, 0}), &output));
-      } else {
-        const int size = f[0].size();
-        TF_RETURN_IF_ERROR(context->allocate_output(
-            i, TensorShape({total_slots, size}), &output));
-        for (int j = 0; j < total_slots; ++j) {
-          CHECK_EQ(size, f[j].size());
+      const TensorShape shape =
+          total_slots == 0 ? TensorShape({0, 0})
+                           : TensorShape({total_slots, features_->FeatureSize(i)});
+      TF_RETURN_IF_ERROR(context->allocate_output(i, shape, &outputs[i]));
+    }
+
+    // Extracts and serializes the features of all slots of all beams on the
+    // device thread pool. Each slot only reads its own parser state and the
+    // workspaces of its beam and writes its own output rows, so the output
+    // does not depend on the order in which slots are processed.
+    std::vector<char> has_weights(total_slots, false);
+    auto work = [this, feature_size, &states, &outputs, &has_weights](
+        int64 start, int64 limit) {
+      for (int64 j = start; j < limit; ++j) {
+        const std::vector<std::vector<SparseFeatures>> &f =
+            states[j].first->ExtractFeatures(states[j].second);
+        CHECK_EQ(feature_size, f.size());
+        for (int i = 0; i < feature_size; ++i) {
+          const int size = features_->FeatureSize(i);
+          CHECK_EQ(size, f[i].size());
+          auto output = outputs[i]->matrix<string>();
           for (int k = 0; k < size; ++k) {
-            if (!options_.allow_feature_weights && f[j][k].weight_size() > 0) {
-              return FailedPrecondition(
-                  "Feature weights are not allowed when allow_feature_weights "
-                  "is set to false.");
-            }
-            output->matrix<string>()(j, k) = f[j][k].SerializeAsString();
+            if (f[i][k].weight_size() > 0) has_weights[j] = true;
+            output(j, k) = f[i][k].SerializeAsString();
           }
         }
       }
+    };
+    const auto &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    tensorflow::Shard(worker_threads.num_threads, worker_threads.workers,
+                      total_slots, kFeatureExtractionCost, work);
+
+    if (!options_.allow_feature_weights &&
+        std::find(has_weights.begin(), has_weights.end(), true) !=
+            has_weights.end()) {
+      return FailedPrecondition(
+          "Feature weights are not allowed when allow_feature_weights "
+          "is set to false.");
     }
     return tensorflow::Status::OK();
   }
@@ -501,7 +787,68 @@ class BatchState {
     return step_offsets_[step] + beam_offsets_[step][beam_id];
   }
 
-  int FeatureSize() const { return features_.embedding_dims().size(); }
+  // Parses the sentences of all beams until every beam is final or max_steps
+  // steps have been taken, scoring the states of the live beams with the given
+  // network. Only the beams themselves are kept, so no offsets are recorded.
+  tensorflow::Status Decode(OpKernelContext *context,
+                            const NetworkScorer &network, int max_steps) {
+    for (int step = 0; step < max_steps; ++step) {
+      std::vector<std::pair<const BeamState *, ParserStateWithHistory *>>
+          states;
+      std::vector<int> offsets(BatchSize() + 1, 0);
+      for (int beam_id = 0; beam_id < BatchSize(); ++beam_id) {
+        if (beams_[beam_id].IsAlive()) beams_[beam_id].AppendStates(&states);
+        offsets[beam_id + 1] = states.size();
+      }
+      if (states.empty()) break;
+
+      // Embeds the features of all slots of all live beams on the device
+      // thread pool, each slot writing its own row.
+      const int64 total_slots = states.size();
+      const int64 embedding_size = network.embedding_size();
+      Tensor scores;
+      TF_RETURN_IF_ERROR(context->allocate_temp(
+          DT_FLOAT, TensorShape({total_slots, embedding_size}), &scores));
+      float *rows = scores.matrix<float>().data();
+      tensorflow::Status status;
+      mutex status_mu;
+      auto work = [&](int64 start, int64 limit) {
+        for (int64 j = start; j < limit; ++j) {
+          tensorflow::Status s = network.Embed(
+              states[j].first->ExtractFeatures(states[j].second),
+              rows + j * embedding_size);
+          if (!s.ok()) {
+            mutex_lock lock(status_mu);
+            status.Update(s);
+          }
+        }
+      };
+      const auto &worker_threads =
+          *context->device()->tensorflow_cpu_worker_threads();
+      tensorflow::Shard(worker_threads.num_threads, worker_threads.workers,
+                        total_slots, NetworkScorer::kEmbeddingCost, work);
+      TF_RETURN_IF_ERROR(status);
+      TF_RETURN_IF_ERROR(network.ComputeScores(context, &scores));
+
+      const Tensor &computed = scores;
+      const TTypes<float>::ConstMatrix score_matrix = computed.matrix<float>();
+      ForEachBeam(context, [this, &offsets, &score_matrix](int beam_id) {
+        if (!beams_[beam_id].IsAlive()) return;
+        Eigen::array<Eigen::DenseIndex, 2> slice_offsets = {offsets[beam_id],
+                                                            0};
+        Eigen::array<Eigen::DenseIndex, 2> extents = {
+            offsets[beam_id + 1] - offsets[beam_id], NumActions()};
+        BeamState::ScoreMatrixType beam_scores =
+            score_matrix.slice(slice_offsets, extents);
+        beams_[beam_id].Advance(beam_scores);
+      });
+    }
+    return tensorflow::Status::OK();
+  }
+
+  int FeatureSize() const { return features_->embedding_dims().size(); }
+
+  const ParserEmbeddingFeatureExtractor &Features() const { return *features_; }
 
   int NumActions() const {
     return transition_system_->NumActions(label_map_->Size());
@@ -509,13 +856,39 @@ class BatchState {
 
   int BatchSize() const { return options_.batch_size; }
 
+  // Feeds a sentence to a batch state without corpus. Takes ownership.
+  void Feed(Sentence *sentence) { sentence_batch_->Feed(sentence); }
+
+  // Number of fed sentences no beam has started on yet.
+  int NumFed() const { return sentence_batch_->num_fed(); }
+
   const BeamState &Beam(const int i) const { return beams_[i]; }
 
   int Epoch() const { return epoch_; }
 
   const string &ScoringType() const { return options_.scoring_type; }
 
+  bool RecordsHistory() const { return options_.record_history; }
+
  private:
+  // Rough cost in cycles of extracting the features of one parser state.
+  static const int64 kFeatureExtractionCost = 50000;
+
+  // Rough cost in cycles of advancing one beam.
+  static const int64 kBeamAdvanceCost = 200000;
+
+  // Calls fn for every beam id on the device thread pool.
+  void ForEachBeam(OpKernelContext *context,
+                   const std::function<void(int)> &fn) {
+    auto work = [&fn](int64 start, int64 limit) {
+      for (int64 beam_id = start; beam_id < limit; ++beam_id) fn(beam_id);
+    };
+    const auto &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    tensorflow::Shard(worker_threads.num_threads, worker_threads.workers,
+                      BatchSize(), kBeamAdvanceCost, work);
+  }
+
   const BatchStateOptions options_;
 
   // How many times the document source has been rewound.
@@ -530,14 +903,21 @@ class BatchState {
   // Label map for transition system..
   const TermFrequencyMap *label_map_;
 
-  // Typed feature extractor for embeddings.
-  ParserEmbeddingFeatureExtractor features_;
+  // Typed feature extractor for embeddings, and the shared features it belongs
+  // to, which also hold the workspace registry for feature extraction.
+  const SharedParserFeatures *shared_features_ = nullptr;
+  const ParserEmbeddingFeatureExtractor *features_ = nullptr;
+
+  // Which of the features are input features, see InputFeatures().
+  vector<vector<bool>> input_features_;
 
   // Batch: WorkspaceSet objects.
   std::vector<WorkspaceSet> workspaces_;
 
-  // Internal workspace registry for use in feature extraction.
-  WorkspaceRegistry workspace_registry_;
+  // Storage of the parser states of each beam. Arenas are not thread-safe, so
+  // each beam has its own to be advanced concurrently with the others.
+  // Declared before the beams, which use them.
+  std::deque<ParserStateArena> state_arenas_;
 
   std::deque<BeamState> beams_;
   std::vector<std::vector<int>> beam_offsets_;
@@ -547,11 +927,34 @@ class BatchState {
   TF_DISALLOW_COPY_AND_ASSIGN(BatchState);
 };
 
+// Reads the adaptive beam options from the <arg_prefix>_beam_prune_margin
+// (0), <arg_prefix>_beam_early_termination (false) and
+// <arg_prefix>_beam_step_budget (0) task parameters; see BatchStateOptions.
+void SetAdaptiveBeamOptions(const TaskContext &task_context,
+                            BatchStateOptions *options) {
+  options->beam_prune_margin = task_context.Get(
+      tensorflow::strings::StrCat(options->arg_prefix, "_beam_prune_margin"),
+      0.0);
+  options->early_termination = task_context.Get(
+      tensorflow::strings::StrCat(options->arg_prefix,
+                                  "_beam_early_termination"),
+      false);
+  options->beam_step_budget = task_context.Get(
+      tensorflow::strings::StrCat(options->arg_prefix, "_beam_step_budget"),
+      0);
+}
+
 // Creates a BeamState and hooks it up with a parser. This Op needs to
 // remain alive for the duration of the parse.
+// Reads sentences and creates a beam parser. The sentences are read from a
+// task input, or, if fed is true, from the documents input of the op. With a
+// positive <arg_prefix>_max_tokens_per_batch task parameter, beams whose next
+// sentence does not fit in that many tokens next to the sentences of the other
+// beams stay dead until the next reset; see SentenceBatch.
 class BeamParseReader : public OpKernel {
  public:
-  explicit BeamParseReader(OpKernelConstruction *context) : OpKernel(context) {
+  explicit BeamParseReader(OpKernelConstruction *context, bool fed = false)
+      : OpKernel(context), fed_(fed) {
     string file_path;
     int feature_size;
     BatchStateOptions options;
@@ -563,8 +966,12 @@ class BeamParseReader : public OpKernel {
                    context->GetAttr("batch_size", &options.batch_size));
     OP_REQUIRES_OK(context,
                    context->GetAttr("arg_prefix", &options.arg_prefix));
-    OP_REQUIRES_OK(context,
-                   context->GetAttr("corpus_name", &options.corpus_name));
+    if (fed_) {
+      OP_REQUIRES_OK(context, context->GetAttr("batch_handle", &batch_handle_));
+    } else {
+      OP_REQUIRES_OK(context,
+                     context->GetAttr("corpus_name", &options.corpus_name));
+    }
     OP_REQUIRES_OK(context, context->GetAttr("allow_feature_weights",
                                              &options.allow_feature_weights));
     OP_REQUIRES_OK(context,
@@ -573,6 +980,9 @@ class BeamParseReader : public OpKernel {
     OP_REQUIRES_OK(context,
                    context->GetAttr("always_start_new_sentences",
                                     &options.always_start_new_sentences));
+    bool inference;
+    OP_REQUIRES_OK(context, context->GetAttr("inference", &inference));
+    options.record_history = !inference;
 
     // Reads task context from file.
     string data;
@@ -587,6 +997,7 @@ class BeamParseReader : public OpKernel {
         InvalidArgument("Batch size ", options.batch_size, " too small."));
     options.scoring_type = task_context.Get(
         tensorflow::strings::StrCat(options.arg_prefix, "_scoring"), "");
+    SetAdaptiveBeamOptions(task_context, &options);
 
     // Create batch state.
     batch_state_.reset(new BatchState(options));
@@ -602,11 +1013,32 @@ class BeamParseReader : public OpKernel {
     std::vector<DataType> output_types(feature_size, DT_STRING);
     output_types.push_back(DT_INT64);
     output_types.push_back(DT_INT32);
-    OP_REQUIRES_OK(context, context->MatchSignature({}, output_types));
+    std::vector<DataType> input_types;
+    if (fed_) input_types.push_back(DT_STRING);
+    OP_REQUIRES_OK(context, context->MatchSignature(input_types, output_types));
   }
 
   void Compute(OpKernelContext *context) override {
     mutex_lock lock(mu_);
+    ScopedStageTimer timer(kReaderStep);
+
+    // Queue up fed documents for the beams to start on.
+    if (fed_) {
+      vector<Sentence> documents;
+      OP_REQUIRES_OK(context, InputDocumentBatch(context, 0, batch_handle_,
+                                                 &documents));
+      OP_REQUIRES(context,
+                  batch_state_->NumFed() + documents.size() <=
+                      batch_state_->BatchSize(),
+                  InvalidArgument("Cannot feed ", documents.size(),
+                                  " documents to a batch of size ",
+                                  batch_state_->BatchSize()));
+      for (Sentence &document : documents) {
+        Sentence *fed = new Sentence();
+        fed->Swap(&document);
+        batch_state_->Feed(fed);
+      }
+    }
 
     // Write features.
     batch_state_->ResetBeams();
@@ -630,6 +1062,11 @@ class BeamParseReader : public OpKernel {
   // mutex to synchronize access to Compute.
   mutex mu_;
 
+  // Whether the sentences are fed through the documents input, and whether
+  // that input is the handle of a document batch.
+  const bool fed_;
+  bool batch_handle_ = false;
+
   // The object whose handle will be passed among the Ops.
   std::unique_ptr<BatchState> batch_state_;
 
@@ -639,6 +1076,16 @@ class BeamParseReader : public OpKernel {
 REGISTER_KERNEL_BUILDER(Name("BeamParseReader").Device(DEVICE_CPU),
                         BeamParseReader);
 
+// BeamParseReader reading the documents fed through its input.
+class FeedBeamParseReader : public BeamParseReader {
+ public:
+  explicit FeedBeamParseReader(OpKernelConstruction *context)
+      : BeamParseReader(context, true) {}
+};
+
+REGISTER_KERNEL_BUILDER(Name("FeedBeamParseReader").Device(DEVICE_CPU),
+                        FeedBeamParseReader);
+
 // Updates the beam based on incoming scores and outputs new feature vectors
 // based on the updated beam.
 class BeamParser : public OpKernel {
@@ -656,6 +1103,7 @@ class BeamParser : public OpKernel {
   }
 
   void Compute(OpKernelContext *context) override {
+    ScopedStageTimer timer(kReaderStep);
     BatchState *batch_state =
         reinterpret_cast<BatchState *>(context->input(0).scalar<int64>()());
 
@@ -667,9 +1115,7 @@ class BeamParser : public OpKernel {
     // scores that should be used for advancing, but beam_offsets_[beam_id] only
     // exists for beams that have a sentence loaded.
     const int batch_size = batch_state->BatchSize();
-    for (int beam_id = 0; beam_id < batch_size; ++beam_id) {
-      batch_state->AdvanceBeam(beam_id, scores);
-    }
+    batch_state->AdvanceBeams(context, scores);
     batch_state->UpdateOffsets();
 
     // Forward the beam state unmodified.
@@ -712,6 +1158,9 @@ class BeamParserOutput : public OpKernel {
   void Compute(OpKernelContext *context) override {
     BatchState *batch_state =
         reinterpret_cast<BatchState *>(context->input(0).scalar<int64>()());
+    OP_REQUIRES(context, batch_state->RecordsHistory(),
+                FailedPrecondition(
+                    "BeamParserOutput needs a reader without inference=true"));
 
     const int num_actions = batch_state->NumActions();
     const int batch_size = batch_state->BatchSize();
@@ -760,12 +1209,14 @@ class BeamParserOutput : public OpKernel {
         path_scores.push_back(item.first.first);
         VLOG(2) << "PATH SCORE @ beam_id:" << beam_id << " slot:" << slot
                 << " : " << item.first.first << " " << item.first.second;
-        VLOG(2) << "SLOT HISTORY: "
-                << utils::Join(item.second->slot_history, " ");
-        VLOG(2) << "SCORE HISTORY: "
-                << utils::Join(item.second->score_history, " ");
-        VLOG(2) << "ACTION HISTORY: "
-                << utils::Join(item.second->action_history, " ");
+        std::vector<int32> slot_history;
+        std::vector<int32> action_history;
+        std::vector<float> score_history;
+        item.second->GetHistory(&slot_history, &action_history,
+                                &score_history);
+        VLOG(2) << "SLOT HISTORY: " << utils::Join(slot_history, " ");
+        VLOG(2) << "SCORE HISTORY: " << utils::Join(score_history, " ");
+        VLOG(2) << "ACTION HISTORY: " << utils::Join(action_history, " ");
 
         // Record where the gold path ended up.
         if (item.second->state->is_gold()) {
@@ -773,10 +1224,10 @@ class BeamParserOutput : public OpKernel {
           gold_slot[beam_id] = slot;
         }
 
-        for (size_t step = 0; step < item.second->slot_history.size(); ++step) {
+        for (size_t step = 0; step < slot_history.size(); ++step) {
           const int step_beam_offset = batch_state->GetOffset(step, beam_id);
-          const int slot_index = item.second->slot_history[step];
-          const int action_index = item.second->action_history[step];
+          const int slot_index = slot_history[step];
+          const int action_index = action_history[step];
           indices.push_back(num_actions * (step_beam_offset + slot_index) +
                             action_index);
           path_ids.push_back(path_id);
@@ -826,6 +1277,86 @@ class BeamParserOutput : public OpKernel {
 REGISTER_KERNEL_BUILDER(Name("BeamParserOutput").Device(DEVICE_CPU),
                         BeamParserOutput);
 
+// Tallies the # of correct and incorrect tokens for a given ParserState.
+void ComputeTokenAccuracy(const ParserState &state, const string &scoring_type,
+                          int *num_tokens, int *num_correct) {
+  for (int i = 0; i < state.sentence().token_size(); ++i) {
+    const Token &token = state.GetToken(i);
+    if (utils::PunctuationUtil::ScoreToken(token.word(), token.tag(),
+                                           scoring_type)) {
+      ++*num_tokens;
+      if (state.IsTokenCorrect(i)) ++*num_correct;
+    }
+  }
+}
+
+// Adds the analyses of the num_alternatives best paths of a final beam to the
+// KBestSyntaxAnalyses extension of its parsed document, best first, with the
+// path scores. Each analysis is read from the parse state at the end of the
+// path, which the beam keeps anyway, so no state is rebuilt or cloned.
+void AddAlternativeParses(const BeamState &beam, int num_alternatives,
+                          Sentence *document) {
+  KBestSyntaxAnalysesForSentence *analyses =
+      document->MutableExtension(KBestSyntaxAnalyses::extension)
+          ->add_sentence();
+  analyses->set_start(0);
+  analyses->set_end(document->token_size() - 1);
+  Sentence scratch = *document;
+  int count = 0;
+  for (auto it = beam.slots_.rbegin();
+       it != beam.slots_.rend() && count < num_alternatives; ++it, ++count) {
+    it->second->state->AddParseToDocument(&scratch);
+    AlternativeTokenAnalysis *analysis = analyses->add_token_analysis();
+    analysis->set_score(it->first.first);
+    for (const Token &token : scratch.token()) {
+      analysis->add_head(token.has_head() ? token.head() : -1);
+      analysis->add_label(token.label());
+      analysis->add_tag(token.tag());
+      analysis->add_category(token.category());
+    }
+  }
+}
+
+// Outputs the eval metrics and the parsed documents of the best paths of the
+// final beams, starting at the given output index. If num_alternatives is
+// positive, the documents also list that many best parses.
+tensorflow::Status OutputBestParses(OpKernelContext *context,
+                                    const BatchState &batch_state,
+                                    int output_index, int num_alternatives) {
+  int num_tokens = 0;
+  int num_correct = 0;
+  const int batch_size = batch_state.BatchSize();
+  vector<Sentence> documents;
+  for (int beam_id = 0; beam_id < batch_size; ++beam_id) {
+    if (batch_state.Beam(beam_id).gold_ != nullptr &&
+        batch_state.Beam(beam_id).AllFinal()) {
+      const auto &item = *batch_state.Beam(beam_id).slots_.rbegin();
+      ComputeTokenAccuracy(*item.second->state, batch_state.ScoringType(),
+                           &num_tokens, &num_correct);
+      documents.push_back(item.second->state->sentence());
+      item.second->state->AddParseToDocument(&documents.back());
+      if (num_alternatives > 0) {
+        AddAlternativeParses(batch_state.Beam(beam_id), num_alternatives,
+                             &documents.back());
+      }
+    }
+  }
+  Tensor *output;
+  TF_RETURN_IF_ERROR(
+      context->allocate_output(output_index, TensorShape({2}), &output));
+  auto eval_metrics = output->vec<int32>();
+  eval_metrics(0) = num_tokens;
+  eval_metrics(1) = num_correct;
+
+  const int output_size = documents.size();
+  TF_RETURN_IF_ERROR(context->allocate_output(
+      output_index + 1, TensorShape({output_size}), &output));
+  for (int i = 0; i < output_size; ++i) {
+    output->vec<string>()(i) = documents[i].SerializeAsString();
+  }
+  return tensorflow::Status::OK();
+}
+
 // Computes eval metrics for the best path in the input beams.
 class BeamEvalOutput : public OpKernel {
  public:
@@ -833,56 +1364,20 @@ class BeamEvalOutput : public OpKernel {
     // Set expected signature.
     OP_REQUIRES_OK(context,
                    context->MatchSignature({DT_INT64}, {DT_INT32, DT_STRING}));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("num_alternatives", &num_alternatives_));
   }
 
   void Compute(OpKernelContext *context) override {
-    int num_tokens = 0;
-    int num_correct = 0;
-    int all_final = 0;
     BatchState *batch_state =
         reinterpret_cast<BatchState *>(context->input(0).scalar<int64>()());
-    const int batch_size = batch_state->BatchSize();
-    vector<Sentence> documents;
-    for (int beam_id = 0; beam_id < batch_size; ++beam_id) {
-      if (batch_state->Beam(beam_id).gold_ != nullptr &&
-          batch_state->Beam(beam_id).AllFinal()) {
-        ++all_final;
-        const auto &item = *batch_state->Beam(beam_id).slots_.rbegin();
-        ComputeTokenAccuracy(*item.second->state, batch_state->ScoringType(),
-                             &num_tokens, &num_correct);
-        documents.push_back(item.second->state->sentence());
-        item.second->state->AddParseToDocument(&documents.back());
-      }
-    }
-    Tensor *output;
-    OP_REQUIRES_OK(context,
-                   context->allocate_output(0, TensorShape({2}), &output));
-    auto eval_metrics = output->vec<int32>();
-    eval_metrics(0) = num_tokens;
-    eval_metrics(1) = num_correct;
-
-    const int output_size = documents.size();
-    OP_REQUIRES_OK(context, context->allocate_output(
-                                1, TensorShape({output_size}), &output));
-    for (int i = 0; i < output_size; ++i) {
-      output->vec<string>()(i) = documents[i].SerializeAsString();
-    }
+    OP_REQUIRES_OK(context, OutputBestParses(context, *batch_state, 0,
+                                             num_alternatives_));
   }
 
  private:
-  // Tallies the # of correct and incorrect tokens for a given ParserState.
-  void ComputeTokenAccuracy(const ParserState &state,
-                            const string &scoring_type,
-                            int *num_tokens, int *num_correct) {
-    for (int i = 0; i < state.sentence().token_size(); ++i) {
-      const Token &token = state.GetToken(i);
-      if (utils::PunctuationUtil::ScoreToken(token.word(), token.tag(),
-                                             scoring_type)) {
-        ++*num_tokens;
-        if (state.IsTokenCorrect(i)) ++*num_correct;
-      }
-    }
-  }
+  // Number of best parses listed in each document.
+  int num_alternatives_ = 0;
 
   TF_DISALLOW_COPY_AND_ASSIGN(BeamEvalOutput);
 };
@@ -890,4 +1385,107 @@ class BeamEvalOutput : public OpKernel {
 REGISTER_KERNEL_BUILDER(Name("BeamEvalOutput").Device(DEVICE_CPU),
                         BeamEvalOutput);
 
+// Parses batches of sentences to the end with a beam, scoring the parser
+// states with the feed-forward network whose parameters are the inputs. Only
+// the beams are kept from one parsing step to the next, without the score
+// matrices and offsets that BeamParseReader records for training, and each
+// run outputs the best parses of its batch, as BeamEvalOutput would. The
+// network is evaluated by the registered NetworkScorer named by the
+// <arg_prefix>_network_scorer task parameter.
+class BeamParseDecoder : public OpKernel {
+ public:
+  explicit BeamParseDecoder(OpKernelConstruction *context)
+      : OpKernel(context) {
+    string file_path;
+    int feature_size;
+    BatchStateOptions options;
+    OP_REQUIRES_OK(context, context->GetAttr("task_context", &file_path));
+    OP_REQUIRES_OK(context, context->GetAttr("feature_size", &feature_size));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("beam_size", &options.max_beam_size));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("batch_size", &options.batch_size));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("arg_prefix", &options.arg_prefix));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("corpus_name", &options.corpus_name));
+    OP_REQUIRES_OK(context, context->GetAttr("max_steps", &max_steps_));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("num_alternatives", &num_alternatives_));
+    options.allow_feature_weights = true;
+    options.continue_until_all_final = true;
+    options.always_start_new_sentences = true;
+    options.record_history = false;
+
+    // Reads task context from file.
+    string data;
+    OP_REQUIRES_OK(context, ReadFileToString(tensorflow::Env::Default(),
+                                             file_path, &data));
+    TaskContext task_context;
+    OP_REQUIRES(context,
+                TextFormat::ParseFromString(data, task_context.mutable_spec()),
+                InvalidArgument("Could not parse task context at ", file_path));
+    OP_REQUIRES(
+        context, options.batch_size > 0,
+        InvalidArgument("Batch size ", options.batch_size, " too small."));
+    options.scoring_type = task_context.Get(
+        tensorflow::strings::StrCat(options.arg_prefix, "_scoring"), "");
+    SetAdaptiveBeamOptions(task_context, &options);
+    network_scorer_ = task_context.Get(
+        tensorflow::strings::StrCat(options.arg_prefix, "_network_scorer"),
+        "feed-forward");
+
+    // Create batch state.
+    batch_state_.reset(new BatchState(options));
+    batch_state_->Init(&task_context);
+
+    // Check number of feature groups matches the task context.
+    const int required_size = batch_state_->FeatureSize();
+    OP_REQUIRES(
+        context, feature_size == required_size,
+        InvalidArgument("Task context requires feature_size=", required_size));
+  }
+
+  void Compute(OpKernelContext *context) override {
+    mutex_lock lock(mu_);
+    std::unique_ptr<NetworkScorer> network(
+        NetworkScorer::Create(network_scorer_));
+    OP_REQUIRES_OK(context, network->Init(context, batch_state_->Features()));
+
+    // Starts the beams on the next sentences and parses them to the end.
+    batch_state_->ResetBeams();
+    OP_REQUIRES_OK(context,
+                   batch_state_->Decode(context, *network, max_steps_));
+
+    // Output number of epochs, eval metrics and documents.
+    Tensor *output;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({}), &output));
+    output->scalar<int32>()() = batch_state_->Epoch();
+    OP_REQUIRES_OK(context, OutputBestParses(context, *batch_state_, 1,
+                                             num_alternatives_));
+  }
+
+ private:
+  // mutex to synchronize access to Compute.
+  mutex mu_;
+
+  // Maximum number of parsing steps per batch.
+  int max_steps_ = 0;
+
+  // Number of best parses listed in each document.
+  int num_alternatives_ = 0;
+
+  // Registered type of the network scorer.
+  string network_scorer_;
+
+  // Beams of the sentences being parsed.
+  std::unique_ptr<BatchState> batch_state_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BeamParseDecoder);
+};
+
+REGISTER_KERNEL_BUILDER(Name("BeamParseDecoder").Device(DEVICE_CPU),
+                        BeamParseDecoder);
+
 }  // namespace syntaxnet
@@ -25,6 +25,8 @@ from tensorflow.python.framework import test_util
 from tensorflow.python.platform import googletest
 from tensorflow.python.platform import tf_logging as logging
 
+from syntaxnet import kbest_syntax_pb2
+from syntaxnet import sentence_pb2
 from syntaxnet import structured_graph_builder
 from syntaxnet.ops import gen_parser_ops
 
@@ -225,6 +227,208 @@ class ParsingReaderOpsTest(test_util.TensorFlowTestCase):
         iterations=1, beam_size=130, max_steps=1, batch_size=22)
     self.assertArrayNear(all_path_scores[0], beam_path_scores[0], 1e-6)
 
+  def testFeedBeamParseReader(self):
+    """Ensures that fed documents are parsed within the same run."""
+    batch_size = 3
+    with self.test_session(graph=tf.Graph()) as sess:
+      serialized, _ = gen_parser_ops.document_source(
+          self._task_context, batch_size=batch_size,
+          corpus_name='training-corpus')
+      corpus_documents = sess.run(serialized)
+    self.assertEqual(batch_size, len(corpus_documents))
+
+    with self.test_session(graph=tf.Graph()) as sess:
+      documents = tf.placeholder(tf.string, shape=[None])
+      feature_sizes, domain_sizes, embedding_dims, num_actions = sess.run(
+          gen_parser_ops.feature_size(task_context=self._task_context))
+      builder = structured_graph_builder.StructuredGraphBuilder(
+          num_actions,
+          feature_sizes,
+          domain_sizes,
+          [8, 8, 8],
+          [],
+          seed=1,
+          beam_size=2)
+      builder.AddEvaluation(self._task_context,
+                            batch_size,
+                            evaluation_max_steps=300,
+                            documents=documents)
+      sess.run(builder.inits.values())
+      for num_documents in [batch_size, 1]:
+        tf_documents = sess.run(
+            builder.evaluation['documents'],
+            feed_dict={documents: corpus_documents[:num_documents]})
+        self.assertEqual(num_documents, len(tf_documents))
+
+
+  def testBeamParseDecoderMatchesEvaluation(self):
+    """Ensures that the fused decoder parses as the while loop does."""
+    batch_size = 3
+    with self.test_session(graph=tf.Graph()) as sess:
+      feature_sizes, domain_sizes, embedding_dims, num_actions = sess.run(
+          gen_parser_ops.feature_size(task_context=self._task_context))
+
+      def MakeBuilder():
+        # Large initial weights keep path scores from being near ties.
+        return structured_graph_builder.StructuredGraphBuilder(
+            num_actions,
+            feature_sizes,
+            domain_sizes,
+            [8, 8, 8],
+            [],
+            seed=1,
+            beam_size=2,
+            softmax_init=0.5)
+      builder = MakeBuilder()
+      builder.AddEvaluation(self._task_context,
+                            batch_size,
+                            evaluation_max_steps=300,
+                            corpus_name='training-corpus')
+      fused = MakeBuilder()
+      with tf.variable_scope('fused'):
+        fused.AddFusedEvaluation(self._task_context,
+                                 batch_size,
+                                 evaluation_max_steps=300,
+                                 corpus_name='training-corpus')
+      sess.run(builder.inits.values())
+      sess.run(fused.inits.values())
+      # Gives both networks the same parameters.
+      sess.run([tf.assign(fused.params[name], builder.params[name])
+                for name in fused.params])
+
+      def ParseEpoch(nodes):
+        documents = []
+        metrics = [0, 0]
+        num_epochs = None
+        while True:
+          tf_epochs, tf_metrics, tf_documents = sess.run(
+              [nodes['epochs'], nodes['eval_metrics'], nodes['documents']])
+          documents.extend(tf_documents)
+          metrics = [metrics[0] + tf_metrics[0], metrics[1] + tf_metrics[1]]
+          if num_epochs is None:
+            num_epochs = tf_epochs
+          elif num_epochs < tf_epochs:
+            return documents, metrics
+
+      documents, metrics = ParseEpoch(fused.evaluation)
+      self.assertGreater(len(documents), 0)
+      self.assertEqual((documents, metrics), ParseEpoch(builder.evaluation))
+
+  def WriteTaskContext(self, filename, parameters):
+    """Writes a copy of the task context with additional parameters."""
+    task_context = os.path.join(FLAGS.test_tmpdir, filename)
+    with open(self._task_context, 'r') as fin:
+      with open(task_context, 'w') as fout:
+        fout.write(fin.read())
+        for name, value in parameters:
+          fout.write('Parameter {\n  name: "%s"\n  value: "%s"\n}\n' %
+                     (name, value))
+    return task_context
+
+  def ParseFusedBatch(self, task_context):
+    """Returns the documents of a fused evaluation of a batch of three."""
+    with self.test_session(graph=tf.Graph()) as sess:
+      feature_sizes, domain_sizes, _, num_actions = sess.run(
+          gen_parser_ops.feature_size(task_context=task_context))
+      builder = structured_graph_builder.StructuredGraphBuilder(
+          num_actions,
+          feature_sizes,
+          domain_sizes,
+          [8, 8, 8],
+          [],
+          seed=1,
+          beam_size=4,
+          softmax_init=0.5)
+      builder.AddFusedEvaluation(task_context,
+                                 3,
+                                 evaluation_max_steps=300,
+                                 corpus_name='training-corpus')
+      sess.run(builder.inits.values())
+      return sess.run(builder.evaluation['documents'])
+
+  def testAdaptiveBeamMatchesFullBeam(self):
+    """Ensures that pruning nothing and finishing forced paths keeps parses."""
+    adaptive_context = self.WriteTaskContext(
+        'adaptive.pbtxt', [('brain_parser_beam_prune_margin', '1e9'),
+                           ('brain_parser_beam_early_termination', 'true')])
+    documents = self.ParseFusedBatch(self._task_context)
+    self.assertEqual(3, len(documents))
+    self.assertEqual(list(documents),
+                     list(self.ParseFusedBatch(adaptive_context)))
+
+  def testStepBudgetFinishesGreedily(self):
+    """Ensures that sentences over their step budget still parse fully."""
+    documents = self.ParseFusedBatch(self._task_context)
+    unspent_context = self.WriteTaskContext(
+        'unspent_budget.pbtxt', [('brain_parser_beam_step_budget', '1000')])
+    self.assertEqual(list(documents),
+                     list(self.ParseFusedBatch(unspent_context)))
+    spent_context = self.WriteTaskContext(
+        'spent_budget.pbtxt', [('brain_parser_beam_step_budget', '2')])
+    greedy_documents = self.ParseFusedBatch(spent_context)
+    self.assertEqual(3, len(greedy_documents))
+    for document, greedy_document in zip(documents, greedy_documents):
+      expected = sentence_pb2.Sentence()
+      expected.ParseFromString(document)
+      greedy = sentence_pb2.Sentence()
+      greedy.ParseFromString(greedy_document)
+      self.assertEqual(expected.text, greedy.text)
+      self.assertEqual(len(expected.token), len(greedy.token))
+      for token in greedy.token:
+        self.assertTrue(token.HasField('head'))
+
+  def testInferenceReaderHasNoTrainingOutput(self):
+    """Ensures that training outputs need the histories of a training reader."""
+    with self.test_session(graph=tf.Graph()) as sess:
+      _, state, _ = gen_parser_ops.beam_parse_reader(
+          task_context=self._task_context,
+          feature_size=self._num_features,
+          beam_size=2,
+          corpus_name='training-corpus',
+          inference=True)
+      output = gen_parser_ops.beam_parser_output(state)
+      with self.assertRaisesOpError('inference'):
+        sess.run(output)
+
+  def testAlternativeParses(self):
+    """Ensures that documents list the best parses of their beams."""
+    with self.test_session(graph=tf.Graph()) as sess:
+      feature_sizes, domain_sizes, embedding_dims, num_actions = sess.run(
+          gen_parser_ops.feature_size(task_context=self._task_context))
+      builder = structured_graph_builder.StructuredGraphBuilder(
+          num_actions,
+          feature_sizes,
+          domain_sizes,
+          [8, 8, 8],
+          [],
+          seed=1,
+          beam_size=4,
+          softmax_init=0.5)
+      builder.AddEvaluation(self._task_context,
+                            3,
+                            corpus_name='training-corpus',
+                            num_alternatives=2)
+      sess.run(builder.inits.values())
+      tf_documents = sess.run(builder.evaluation['documents'])
+    self.assertEqual(3, len(tf_documents))
+    for serialized in tf_documents:
+      document = sentence_pb2.Sentence()
+      document.ParseFromString(serialized)
+      kbest = document.Extensions[
+          kbest_syntax_pb2.KBestSyntaxAnalyses.extension]
+      self.assertEqual(1, len(kbest.sentence))
+      self.assertEqual(0, kbest.sentence[0].start)
+      self.assertEqual(len(document.token) - 1, kbest.sentence[0].end)
+      analyses = kbest.sentence[0].token_analysis
+      self.assertIn(len(analyses), [1, 2])
+      scores = [analysis.score for analysis in analyses]
+      self.assertEqual(sorted(scores, reverse=True), scores)
+
+      # The first analysis is the parse of the document itself.
+      for i, token in enumerate(document.token):
+        self.assertEqual(token.head if token.HasField('head') else -1,
+                         analyses[0].head[i])
+        self.assertEqual(token.label, analyses[0].label[i])
 
 if __name__ == '__main__':
   googletest.main()
@@ -0,0 +1,169 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Benchmarks models exported by parser_eval.py --export_path, or bundles of
+// them, on a sample of a corpus, like tensorflow/tools/benchmark/benchmark_model
+// does for frozen graphs with fixed inputs. For each model, the sentences are
+// parsed in batches through a ParsingSession, which runs the reader ops of the
+// model, after a few warmup batches. The tool logs the sentences and tokens
+// parsed per second and the 50th and 99th percentile of the latency of the
+// sentences, i.e. of the batches they were parsed in, then traces a few more
+// batches and logs the time spent in each op with a StatSummarizer.
+//
+// Since greedy and beam parsers are exported separately, comparing them, or
+// builds and machines, takes one command like
+//
+//   benchmark_parser_main --export_path=/tmp/greedy,/tmp/beam \
+//       --corpus=dev.conll --max_sentences=1000 --batch_size=1 \
+//       --benchmark_name=parser --output_prefix=/tmp/benchmark_
+//
+// which with --benchmark_name and --output_prefix also writes the wall time and
+// sentences per second of each model in the format of TestReporter, under the
+// benchmark name followed by the base name of the export if there are several.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/parsing_session.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/session_benchmark.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/util/command_line_flags.h"
+#include "tensorflow/core/util/reporter.h"
+#include "tensorflow/core/util/stat_summarizer.h"
+
+using syntaxnet::ParsingSession;
+using syntaxnet::Sentence;
+using tensorflow::Status;
+using tensorflow::int32;
+
+namespace {
+
+// Settings shared by the benchmarks of all models.
+struct BenchmarkOptions {
+  syntaxnet::SessionBenchmarkOptions run;
+  int32 trace_batches = 10;
+  string benchmark_name;
+  string output_prefix;
+};
+
+// Benchmarks the model exported to export_path on the sentences.
+Status Benchmark(const string &export_path, const string &benchmark_name,
+                 const std::vector<Sentence> &sentences,
+                 const BenchmarkOptions &options) {
+  std::unique_ptr<ParsingSession> session;
+  TF_RETURN_IF_ERROR(ParsingSession::Create(export_path, &session));
+  syntaxnet::SessionBenchmarkResult result;
+  TF_RETURN_IF_ERROR(syntaxnet::RunSessionBenchmark(session.get(), sentences,
+                                                    options.run, &result));
+  const double wall_time = result.wall_time;
+  const double sentences_per_second = result.sentences_per_second();
+  LOG(INFO) << export_path << ": parsed " << result.num_sentences
+            << " sentences and " << result.num_tokens << " tokens in "
+            << wall_time << " s, " << sentences_per_second << " sentences/s, "
+            << result.tokens_per_second() << " tokens/s, latency p50 "
+            << result.p50_latency_micros / 1000 << " ms, p99 "
+            << result.p99_latency_micros / 1000 << " ms";
+
+  if (options.trace_batches > 0) {
+    tensorflow::StatSummarizer stats(session->graph_def());
+    size_t start = 0;
+    for (int i = 0; i < options.trace_batches; ++i) {
+      int num_parsed = 0;
+      TF_RETURN_IF_ERROR(syntaxnet::ParseSentenceBatch(
+          session.get(), sentences, start, options.run.batch_size, &stats,
+          &num_parsed));
+      start = (start + num_parsed) % sentences.size();
+    }
+    LOG(INFO) << export_path << ": op stats of " << stats.num_runs()
+              << " traced steps";
+    stats.PrintStepStats();
+  }
+
+  if (!benchmark_name.empty() && !options.output_prefix.empty()) {
+    tensorflow::TestReporter reporter(options.output_prefix, benchmark_name);
+    TF_RETURN_IF_ERROR(reporter.Initialize());
+    TF_RETURN_IF_ERROR(reporter.Benchmark(result.num_sentences, -1.0,
+                                          wall_time, sentences_per_second));
+    TF_RETURN_IF_ERROR(reporter.Close());
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  string export_paths;
+  string corpus;
+  string input_format = "conll-sentence";
+  int32 max_sentences = 1000;
+  BenchmarkOptions options;
+  const bool parsed_flags_ok = tensorflow::ParseFlags(
+      &argc, argv,
+      {tensorflow::Flag("export_path", &export_paths),
+       tensorflow::Flag("corpus", &corpus),
+       tensorflow::Flag("input_format", &input_format),
+       tensorflow::Flag("max_sentences", &max_sentences),
+       tensorflow::Flag("batch_size", &options.run.batch_size),
+       tensorflow::Flag("warmup_batches", &options.run.warmup_batches),
+       tensorflow::Flag("num_passes", &options.run.num_passes),
+       tensorflow::Flag("trace_batches", &options.trace_batches),
+       tensorflow::Flag("benchmark_name", &options.benchmark_name),
+       tensorflow::Flag("output_prefix", &options.output_prefix)});
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parsed_flags_ok || export_paths.empty() || corpus.empty() ||
+      options.run.batch_size < 1 || options.run.num_passes < 1) {
+    LOG(ERROR) << "Usage: " << argv[0] << " --export_path=<dir>[,<dir>...] "
+               << "--corpus=<file> [--input_format=conll-sentence] "
+               << "[--max_sentences=1000] [--batch_size=1] "
+               << "[--warmup_batches=5] [--num_passes=1] "
+               << "[--trace_batches=10] [--benchmark_name=<name>] "
+               << "[--output_prefix=<prefix>]";
+    return 1;
+  }
+
+  // Reads the sample once, so that all models parse the same sentences.
+  std::vector<Sentence> sentences;
+  syntaxnet::ReadSentenceSample(corpus, input_format, max_sentences,
+                                &sentences);
+  if (sentences.empty()) {
+    LOG(ERROR) << "No sentences in " << corpus;
+    return 1;
+  }
+
+  // Benchmarks the models one after the other, since their sessions would
+  // share the document queues.
+  const std::vector<string> paths = syntaxnet::utils::Split(export_paths, ',');
+  for (const string &path : paths) {
+    string benchmark_name = options.benchmark_name;
+    if (paths.size() > 1 && !benchmark_name.empty()) {
+      tensorflow::strings::StrAppend(&benchmark_name, "_",
+                                     tensorflow::io::Basename(path));
+    }
+    const Status status = Benchmark(path, benchmark_name, sentences, options);
+    if (!status.ok()) {
+      LOG(ERROR) << "Benchmarking " << path << " failed with " << status;
+      return 1;
+    }
+  }
+  return 0;
+}
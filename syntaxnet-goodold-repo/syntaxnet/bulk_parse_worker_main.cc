@@ -0,0 +1,190 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Parses shards of sentence record files for bulk_parser.py, with a model
+// exported by parser_eval.py --export_path, or a bundle of it, loaded once.
+//
+// Reads a shard per line of stdin, as tab separated input file, part, number
+// of parts and output file, and parses the sentences of that part of the
+// input file, see SentenceRecordReader::GetShard(), into a sentence record
+// file at the output path. Then writes a line to stdout, "OK" and the number
+// of parsed sentences, or "ERROR" and the error message, tab separated.
+//
+// The parses are written to a temporary file next to the output first, and
+// moved to the output once complete, so that outputs only ever hold whole
+// shards, even when two workers parse the same shard at once.
+//
+// The output files are compressed with --compression, "none", "zlib" or
+// "snappy", see sentence_records.h.
+//
+// Usage: bulk_parse_worker_main --export_path=<dir or bundle>
+//            [--batch_size=1024] [--worker_id=<id>] [--compression=none]
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/parsing_session.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/sentence_records.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+using syntaxnet::ParsingSession;
+using syntaxnet::Sentence;
+using syntaxnet::SentenceRecordReader;
+using syntaxnet::SentenceRecordWriter;
+using tensorflow::Status;
+
+namespace {
+
+// Deletes the record file and its index.
+void DeleteRecordFile(const string &filename) {
+  tensorflow::Env *env = tensorflow::Env::Default();
+  env->DeleteFile(filename + SentenceRecordWriter::kIndexSuffix);
+  env->DeleteFile(filename);
+}
+
+// Parses the sentences [begin, end) of the reader in batches into the writer.
+Status ParseSentences(ParsingSession *session, SentenceRecordReader *reader,
+                      int64 begin, int64 end, int batch_size,
+                      SentenceRecordWriter *writer) {
+  std::vector<Sentence> batch;
+  std::vector<Sentence> parses;
+  for (int64 i = begin; i < end; i += batch_size) {
+    batch.resize(std::min<int64>(batch_size, end - i));
+    for (size_t j = 0; j < batch.size(); ++j) {
+      TF_RETURN_IF_ERROR(reader->Read(i + j, &batch[j]));
+    }
+    TF_RETURN_IF_ERROR(session->Parse(batch, &parses));
+    for (const Sentence &parse : parses) writer->Write(parse);
+  }
+  return Status::OK();
+}
+
+// Moves the record file at from and its index, unless it is compressed and
+// has none, to the record file at to.
+Status MoveRecordFile(const string &from, const string &to) {
+  tensorflow::Env *env = tensorflow::Env::Default();
+  if (env->FileExists(from + SentenceRecordWriter::kIndexSuffix)) {
+    TF_RETURN_IF_ERROR(
+        env->RenameFile(from + SentenceRecordWriter::kIndexSuffix,
+                        to + SentenceRecordWriter::kIndexSuffix));
+  }
+  return env->RenameFile(from, to);
+}
+
+// Parses the given part of the input file into the output file, writing
+// through a temporary file named after the worker.
+Status ParseShard(ParsingSession *session, const string &input_file, int part,
+                  int num_parts, const string &output_file, int batch_size,
+                  SentenceRecordWriter::Compression compression,
+                  const string &worker_id, int64 *num_sentences) {
+  if (num_parts < 1 || part < 0 || part >= num_parts) {
+    return tensorflow::errors::InvalidArgument("Bad part ", part, " of ",
+                                               num_parts);
+  }
+  tensorflow::Env *env = tensorflow::Env::Default();
+  if (!env->FileExists(input_file)) {
+    return tensorflow::errors::NotFound("No input file ", input_file);
+  }
+  SentenceRecordReader reader(input_file);
+  int64 begin, end;
+  reader.GetShard(part, num_parts, &begin, &end);
+
+  const string temp_file =
+      tensorflow::strings::StrCat(output_file, ".tmp-", worker_id);
+  SentenceRecordWriter writer(temp_file, compression);
+  const Status status =
+      ParseSentences(session, &reader, begin, end, batch_size, &writer);
+  writer.Close();
+  *num_sentences = writer.num_sentences();
+
+  // Another copy of the shard may have been moved to the output meanwhile,
+  // in which case this one is dropped.
+  if (!status.ok() || env->FileExists(output_file)) {
+    DeleteRecordFile(temp_file);
+    return status;
+  }
+  return MoveRecordFile(temp_file, output_file);
+}
+
+// Parses the shard of a line of stdin, see above.
+Status ParseShardLine(ParsingSession *session, const string &line,
+                      int batch_size,
+                      SentenceRecordWriter::Compression compression,
+                      const string &worker_id, int64 *num_sentences) {
+  const std::vector<string> fields = tensorflow::str_util::Split(line, '\t');
+  tensorflow::int32 part, num_parts;
+  if (fields.size() != 4 ||
+      !tensorflow::strings::safe_strto32(fields[1], &part) ||
+      !tensorflow::strings::safe_strto32(fields[2], &num_parts)) {
+    return tensorflow::errors::InvalidArgument("Bad shard: ", line);
+  }
+  return ParseShard(session, fields[0], part, num_parts, fields[3], batch_size,
+                    compression, worker_id, num_sentences);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  string export_path;
+  tensorflow::int32 batch_size = 1024;
+  string worker_id = "0";
+  string compression_name = "none";
+  const bool parsed_flags_ok = tensorflow::ParseFlags(
+      &argc, argv, {tensorflow::Flag("export_path", &export_path),
+                    tensorflow::Flag("batch_size", &batch_size),
+                    tensorflow::Flag("worker_id", &worker_id),
+                    tensorflow::Flag("compression", &compression_name)});
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  SentenceRecordWriter::Compression compression;
+  if (!parsed_flags_ok || export_path.empty() || batch_size < 1 ||
+      !SentenceRecordWriter::ParseCompression(compression_name,
+                                              &compression)) {
+    LOG(ERROR) << "Usage: " << argv[0] << " --export_path=<dir> "
+               << "[--batch_size=1024] [--worker_id=<id>] "
+               << "[--compression=none|zlib|snappy]";
+    return 1;
+  }
+
+  std::unique_ptr<ParsingSession> session;
+  TF_CHECK_OK(ParsingSession::Create(export_path, &session));
+
+  string line;
+  while (std::getline(std::cin, line)) {
+    int64 num_sentences = 0;
+    const Status status = ParseShardLine(session.get(), line, batch_size,
+                                         compression, worker_id,
+                                         &num_sentences);
+    if (status.ok()) {
+      std::cout << "OK\t" << num_sentences << std::endl;
+    } else {
+      string message = status.ToString();
+      std::replace(message.begin(), message.end(), '\n', ' ');
+      std::cout << "ERROR\t" << message << std::endl;
+    }
+  }
+  return 0;
+}
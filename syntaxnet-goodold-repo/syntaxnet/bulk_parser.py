@@ -0,0 +1,382 @@
+# Copyright 2016 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+"""Parses sharded sentence record files on a cluster of workers.
+
+The cluster has one coordinator task and any number of worker tasks, each
+running this program with its --job_name and --task_index. The coordinator
+splits the input files into shards and hands them out through a queue on its
+server as workers become free, so that fast workers take more shards. Each
+worker parses its shards with a bulk_parse_worker_main process holding the
+exported model, and reports back through a second queue.
+
+Shards are written atomically, see bulk_parse_worker_main.cc. Failed shards
+are retried on any worker up to --max_attempts times, and shards running much
+longer than the others, e.g. on a slow or dead worker, get a backup copy on
+another worker, of which the first to finish wins. Shards whose output exists
+are skipped, so a stopped job can be resumed by running it again.
+
+Example usage:
+  bulk_parser --job_name=coordinator --coordinator_host=host0:2222 \
+      --worker_hosts=host1:2222,host2:2222 --input='/data/crawl-*.rec' \
+      --output_dir=/data/parsed
+  bulk_parser --job_name=worker --task_index=0 --coordinator_host=host0:2222 \
+      --worker_hosts=host1:2222,host2:2222 --export_path=/models/export
+"""
+
+import os
+import os.path
+import subprocess
+import time
+
+import tensorflow as tf
+
+from tensorflow.python.platform import gfile
+from tensorflow.python.platform import tf_logging as logging
+
+flags = tf.app.flags
+FLAGS = flags.FLAGS
+
+flags.DEFINE_string('job_name', 'worker',
+                    'Job of this task, either "coordinator" or "worker".')
+flags.DEFINE_integer('task_index', 0, 'Index of this task within its job.')
+flags.DEFINE_string('coordinator_host', '',
+                    'host:port of the coordinator.')
+flags.DEFINE_string('worker_hosts', '',
+                    'Comma separated list of host:port of the workers.')
+flags.DEFINE_string('input', '',
+                    'Comma separated list of sentence record files and file '
+                    'patterns to parse, read by the coordinator.')
+flags.DEFINE_integer('parts_per_file', 1,
+                     'Number of shards each input file is split into.')
+flags.DEFINE_string('output_dir', '',
+                    'Directory of the parsed shards, named after their input '
+                    'files, which must have distinct names.')
+flags.DEFINE_integer('max_attempts', 3,
+                     'Number of times a shard is parsed before giving up on '
+                     'it.')
+flags.DEFINE_float('straggler_factor', 3.0,
+                   'Shards running this many times longer than the median '
+                   'shard get a backup copy.')
+flags.DEFINE_integer('min_straggler_secs', 600,
+                     'Shards running less than this many seconds get no backup '
+                     'copy.')
+flags.DEFINE_string('export_path', '',
+                    'Model exported by parser_eval.py --export_path, or a '
+                    'bundle of it, with which the workers parse.')
+flags.DEFINE_integer('batch_size', 1024,
+                     'Number of sentences the workers parse at a time.')
+flags.DEFINE_string('compression', 'none',
+                    'Compression of the output files, none, zlib or snappy, '
+                    'see sentence_records.h.')
+flags.DEFINE_string('worker_binary', '',
+                    'Path to bulk_parse_worker_main, by default next to this '
+                    'program.')
+
+# Shared names of the queues of the coordinator.
+SHARD_QUEUE = 'bulk_parse_shards'
+REPORT_QUEUE = 'bulk_parse_reports'
+
+# Kinds of the reports of the workers about the shards they parse.
+STARTED = 'STARTED'
+DONE = 'DONE'
+FAILED = 'FAILED'
+
+# Name of the file listing the shards that failed every attempt.
+FAILED_SHARDS = 'failed-shards'
+
+
+def ListShards(patterns, parts_per_file, output_dir):
+  """Returns the shards of the input files, as worker input lines.
+
+  Args:
+    patterns: comma separated list of files and file patterns.
+    parts_per_file: number of shards each file is split into.
+    output_dir: directory of the outputs of the shards.
+
+  Returns:
+    for each shard, tab separated input file, part, number of parts and
+    output file, see bulk_parse_worker_main.cc.
+  """
+  shards = []
+  for pattern in patterns.split(','):
+    for input_file in sorted(gfile.Glob(pattern)):
+      for part in range(parts_per_file):
+        output_file = os.path.basename(input_file)
+        if parts_per_file > 1:
+          output_file += '-%05d-of-%05d' % (part, parts_per_file)
+        shards.append('\t'.join([input_file, str(part), str(parts_per_file),
+                                 os.path.join(output_dir, output_file)]))
+  return shards
+
+
+def ShardOutput(shard):
+  return shard.split('\t')[3]
+
+
+class ShardScheduler(object):
+  """Hands out shards in order, retrying failures and backing up stragglers.
+
+  A shard runs from the time a worker starts it. Failed shards are handed out
+  again until max_attempts of them failed. When no shard is left to hand out,
+  the shard running longest gets a backup copy if it runs longer than both
+  min_straggler_secs and straggler_factor times the median duration of the
+  finished shards. Shards run at most twice at once, and the first copy to
+  finish completes the shard.
+  """
+
+  def __init__(self, shards, max_attempts=3, straggler_factor=3.0,
+               min_straggler_secs=600, clock=time.time):
+    self._pending = list(shards)
+    self._max_attempts = max_attempts
+    self._straggler_factor = straggler_factor
+    self._min_straggler_secs = min_straggler_secs
+    self._clock = clock
+    self._num_shards = len(shards)
+    # Start times of the running copies of each shard, and the number of
+    # copies handed out but not started yet.
+    self._running = {}
+    self._waiting = {}
+    self._attempts = {}
+    self._durations = []
+    self.done = set()
+    self.failed = {}
+
+  def Finished(self):
+    """Returns whether every shard is done or failed every attempt."""
+    return len(self.done) + len(self.failed) == self._num_shards
+
+  def Next(self):
+    """Returns the next shard to hand out, or None if there is none now."""
+    if self._pending:
+      shard = self._pending.pop(0)
+    else:
+      shard = self._Straggler()
+      if shard is None:
+        return None
+    self._waiting[shard] = self._waiting.get(shard, 0) + 1
+    return shard
+
+  def Started(self, shard):
+    if shard in self.done or shard in self.failed:
+      return
+    self._waiting[shard] = max(self._waiting.get(shard, 0) - 1, 0)
+    self._running.setdefault(shard, []).append(self._clock())
+
+  def Done(self, shard):
+    """Completes the shard, returns False if another copy completed it."""
+    if shard in self.done:
+      return False
+    self.done.add(shard)
+    starts = self._running.pop(shard, [])
+    if starts:
+      self._durations.append(self._clock() - min(starts))
+    self._waiting.pop(shard, None)
+    self.failed.pop(shard, None)
+    return True
+
+  def Failed(self, shard, error):
+    """Records a failed copy of the shard, handing it out again if needed."""
+    if shard in self.done or shard in self.failed:
+      return
+    logging.warning('Shard %s failed: %s', shard, error)
+    starts = self._running.get(shard, [])
+    if starts:
+      starts.pop(0)
+    self._attempts[shard] = self._attempts.get(shard, 0) + 1
+    if starts or self._waiting.get(shard, 0):
+      return
+    self._running.pop(shard, None)
+    if self._attempts[shard] >= self._max_attempts:
+      self.failed[shard] = error
+    else:
+      self._pending.append(shard)
+
+  def _Straggler(self):
+    """Returns the shard to back up, or None."""
+    if not self._durations:
+      return None
+    durations = sorted(self._durations)
+    threshold = max(self._min_straggler_secs,
+                    self._straggler_factor * durations[len(durations) // 2])
+    now = self._clock()
+    straggler = None
+    longest = threshold
+    for shard, starts in self._running.items():
+      if len(starts) + self._waiting.get(shard, 0) != 1:
+        continue
+      if now - starts[0] > longest:
+        straggler, longest = shard, now - starts[0]
+    return straggler
+
+
+def ClusterSpec():
+  return tf.train.ClusterSpec({'coordinator': [FLAGS.coordinator_host],
+                               'worker': FLAGS.worker_hosts.split(',')})
+
+
+def Queues():
+  """Returns the shard and report queues, held by the coordinator."""
+  with tf.device('/job:coordinator/task:0'):
+    shard_queue = tf.FIFOQueue(-1, [tf.string], shapes=[[]],
+                               shared_name=SHARD_QUEUE, name='shards')
+    report_queue = tf.FIFOQueue(-1, [tf.string], shapes=[[]],
+                                shared_name=REPORT_QUEUE, name='reports')
+  return shard_queue, report_queue
+
+
+def RunCoordinator(server, num_workers):
+  """Hands out the shards of the input until all of them are done."""
+  shards = ListShards(FLAGS.input, FLAGS.parts_per_file, FLAGS.output_dir)
+  todo = [shard for shard in shards if not gfile.Exists(ShardOutput(shard))]
+  logging.info('Parsing %d shards, %d are already parsed.', len(todo),
+               len(shards) - len(todo))
+  if not gfile.IsDirectory(FLAGS.output_dir):
+    gfile.MakeDirs(FLAGS.output_dir)
+  scheduler = ShardScheduler(todo, FLAGS.max_attempts, FLAGS.straggler_factor,
+                             FLAGS.min_straggler_secs)
+
+  shard_queue, report_queue = Queues()
+  shard = tf.placeholder(tf.string, [])
+  enqueue_shard = shard_queue.enqueue([shard])
+  num_queued = shard_queue.size()
+  dequeue_report = report_queue.dequeue()
+  close = shard_queue.close(cancel_pending_enqueues=True)
+  poll_options = tf.RunOptions(timeout_in_ms=1000)
+  num_sentences = 0
+  t = time.time()
+  with tf.Session(server.target) as sess:
+    while not scheduler.Finished():
+      # Keeps a shard queued per worker, so that stragglers are only backed
+      # up when workers are free.
+      while sess.run(num_queued) < num_workers:
+        next_shard = scheduler.Next()
+        if next_shard is None:
+          break
+        sess.run(enqueue_shard, feed_dict={shard: next_shard})
+      try:
+        report = sess.run(dequeue_report, options=poll_options)
+      except tf.errors.DeadlineExceededError:
+        continue
+      kind, worker, reported_shard, detail = report.split('\n')
+      if kind == STARTED:
+        scheduler.Started(reported_shard)
+      elif kind == DONE:
+        if scheduler.Done(reported_shard):
+          num_sentences += int(detail)
+          logging.info('Worker %s parsed %s, %d/%d shards done, %d sentences'
+                       ' in %.2f seconds.', worker, ShardOutput(reported_shard),
+                       len(scheduler.done), len(todo), num_sentences,
+                       time.time() - t)
+      else:
+        scheduler.Failed(reported_shard, 'worker %s: %s' % (worker, detail))
+    sess.run(close)
+
+  if scheduler.failed:
+    with gfile.FastGFile(os.path.join(FLAGS.output_dir, FAILED_SHARDS),
+                         'w') as fout:
+      for failed_shard, error in sorted(scheduler.failed.items()):
+        fout.write('%s\t%s\n' % (failed_shard, error))
+    logging.error('%d shards failed, see %s.', len(scheduler.failed),
+                  os.path.join(FLAGS.output_dir, FAILED_SHARDS))
+    return 1
+  return 0
+
+
+class WorkerProcess(object):
+  """A bulk_parse_worker_main process, restarted when it dies."""
+
+  def __init__(self, args):
+    self._args = args
+    self._process = None
+
+  def Parse(self, shard):
+    """Parses the shard, returns an error message or None on success."""
+    if self._process is None:
+      self._process = subprocess.Popen(self._args, stdin=subprocess.PIPE,
+                                       stdout=subprocess.PIPE)
+    try:
+      self._process.stdin.write(shard + '\n')
+      self._process.stdin.flush()
+      result = self._process.stdout.readline()
+    except IOError as e:
+      result = ''
+      logging.error('Worker process failed: %s', e)
+    if not result:
+      self._process.wait()
+      self._process = None
+      return None, 'worker process exited while parsing'
+    status, detail = result.rstrip('\n').split('\t', 1)
+    return (detail, None) if status == 'OK' else (None, detail)
+
+  def Close(self):
+    if self._process is not None:
+      self._process.stdin.close()
+      self._process.wait()
+
+
+def RunWorker(server):
+  """Parses the shards handed out by the coordinator until there are none."""
+  worker = '%s:%d' % (FLAGS.job_name, FLAGS.task_index)
+  shard_queue, report_queue = Queues()
+  dequeue_shard = shard_queue.dequeue()
+  report = tf.placeholder(tf.string, [])
+  enqueue_report = report_queue.enqueue([report])
+  binary = FLAGS.worker_binary or os.path.join(
+      os.path.dirname(os.path.abspath(__file__)), 'bulk_parse_worker_main')
+  process = WorkerProcess([binary, '--export_path=%s' % FLAGS.export_path,
+                           '--batch_size=%d' % FLAGS.batch_size,
+                           '--worker_id=%d' % FLAGS.task_index,
+                           '--compression=%s' % FLAGS.compression])
+
+  def Report(sess, kind, shard, detail=''):
+    sess.run(enqueue_report,
+             feed_dict={report: '\n'.join([kind, worker, shard, detail])})
+
+  with tf.Session(server.target) as sess:
+    while True:
+      try:
+        shard = sess.run(dequeue_shard)
+      except (tf.errors.OutOfRangeError, tf.errors.CancelledError,
+              tf.errors.UnavailableError):
+        break
+      Report(sess, STARTED, shard)
+      num_sentences, error = process.Parse(shard)
+      if error is None:
+        Report(sess, DONE, shard, num_sentences)
+      else:
+        Report(sess, FAILED, shard, error)
+  process.Close()
+  logging.info('No shards left, exiting.')
+  return 0
+
+
+def main(unused_argv):
+  logging.set_verbosity(logging.INFO)
+  if not FLAGS.coordinator_host or not FLAGS.worker_hosts:
+    raise ValueError('--coordinator_host and --worker_hosts are required')
+  server = tf.train.Server(ClusterSpec(), job_name=FLAGS.job_name,
+                           task_index=FLAGS.task_index)
+  if FLAGS.job_name == 'coordinator':
+    if not FLAGS.input or not FLAGS.output_dir:
+      raise ValueError('The coordinator requires --input and --output_dir')
+    return RunCoordinator(server, len(FLAGS.worker_hosts.split(',')))
+  if not FLAGS.export_path:
+    raise ValueError('Workers require --export_path')
+  return RunWorker(server)
+
+
+if __name__ == '__main__':
+  tf.app.run()
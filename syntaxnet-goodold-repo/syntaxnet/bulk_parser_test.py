@@ -0,0 +1,137 @@
+# Copyright 2016 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+"""Tests for the shard scheduling of bulk_parser."""
+
+
+# disable=no-name-in-module,unused-import,g-bad-import-order,maybe-no-member
+import os.path
+
+import tensorflow as tf
+
+from tensorflow.python.framework import test_util
+from tensorflow.python.platform import googletest
+
+from syntaxnet import bulk_parser
+
+FLAGS = tf.app.flags.FLAGS
+
+
+class FakeClock(object):
+
+  def __init__(self):
+    self.now = 0.0
+
+  def __call__(self):
+    return self.now
+
+
+class BulkParserTest(test_util.TensorFlowTestCase):
+
+  def setUp(self):
+    self.clock = FakeClock()
+
+  def MakeScheduler(self, shards, max_attempts=3):
+    return bulk_parser.ShardScheduler(shards, max_attempts=max_attempts,
+                                      straggler_factor=3.0,
+                                      min_straggler_secs=10,
+                                      clock=self.clock)
+
+  def testListShards(self):
+    input_dir = os.path.join(FLAGS.test_tmpdir, 'bulk-input')
+    if not os.path.isdir(input_dir):
+      os.makedirs(input_dir)
+    for name in ['b.rec', 'a.rec']:
+      with open(os.path.join(input_dir, name), 'w') as f:
+        f.write('')
+    pattern = os.path.join(input_dir, '*.rec')
+    self.assertEqual(
+        bulk_parser.ListShards(pattern, 1, '/out'),
+        [os.path.join(input_dir, 'a.rec') + '\t0\t1\t/out/a.rec',
+         os.path.join(input_dir, 'b.rec') + '\t0\t1\t/out/b.rec'])
+    shards = bulk_parser.ListShards(pattern, 2, '/out')
+    self.assertEqual([bulk_parser.ShardOutput(shard) for shard in shards],
+                     ['/out/a.rec-00000-of-00002', '/out/a.rec-00001-of-00002',
+                      '/out/b.rec-00000-of-00002', '/out/b.rec-00001-of-00002'])
+    self.assertEqual(shards[1].split('\t')[1:3], ['1', '2'])
+
+  def testHandsOutShardsInOrder(self):
+    scheduler = self.MakeScheduler(['a', 'b'])
+    self.assertEqual(scheduler.Next(), 'a')
+    self.assertEqual(scheduler.Next(), 'b')
+    self.assertIsNone(scheduler.Next())
+    scheduler.Started('a')
+    scheduler.Started('b')
+    self.assertTrue(scheduler.Done('b'))
+    self.assertFalse(scheduler.Finished())
+    self.assertTrue(scheduler.Done('a'))
+    self.assertTrue(scheduler.Finished())
+    self.assertFalse(scheduler.failed)
+
+  def testRetriesFailedShards(self):
+    scheduler = self.MakeScheduler(['a', 'b'], max_attempts=2)
+    for shard in ['a', 'b']:
+      scheduler.Next()
+      scheduler.Started(shard)
+    scheduler.Failed('a', 'error 1')
+    scheduler.Done('b')
+    self.assertEqual(scheduler.Next(), 'a')
+    scheduler.Started('a')
+    scheduler.Failed('a', 'error 2')
+    self.assertIsNone(scheduler.Next())
+    self.assertTrue(scheduler.Finished())
+    self.assertEqual(scheduler.done, set(['b']))
+    self.assertEqual(scheduler.failed, {'a': 'error 2'})
+
+  def testBacksUpStragglers(self):
+    scheduler = self.MakeScheduler(['a', 'b', 'c'])
+    for shard in ['a', 'b', 'c']:
+      scheduler.Next()
+      scheduler.Started(shard)
+    self.clock.now = 5.0
+    scheduler.Done('a')
+    scheduler.Done('b')
+
+    # c runs longer than min_straggler_secs but not three times the median.
+    self.clock.now = 12.0
+    self.assertIsNone(scheduler.Next())
+    self.clock.now = 20.0
+    self.assertEqual(scheduler.Next(), 'c')
+    self.assertIsNone(scheduler.Next())
+
+    # The backup finishes first, and the original is not counted again.
+    scheduler.Started('c')
+    self.assertTrue(scheduler.Done('c'))
+    self.assertFalse(scheduler.Done('c'))
+    self.assertTrue(scheduler.Finished())
+
+  def testFailedBackupLeavesOriginalRunning(self):
+    scheduler = self.MakeScheduler(['a', 'b'], max_attempts=1)
+    for shard in ['a', 'b']:
+      scheduler.Next()
+      scheduler.Started(shard)
+    self.clock.now = 1.0
+    scheduler.Done('a')
+    self.clock.now = 20.0
+    self.assertEqual(scheduler.Next(), 'b')
+    scheduler.Started('b')
+    scheduler.Failed('b', 'backup failed')
+    self.assertFalse(scheduler.failed)
+    self.assertTrue(scheduler.Done('b'))
+    self.assertTrue(scheduler.Finished())
+
+
+if __name__ == '__main__':
+  googletest.main()
@@ -843,4 +843,86 @@ DEFINE_CHAR_PROPERTY(punctuation_or_symbol, prop) {
   prop->AddCharProperty("token_suffix_symbol");
 }
 
+//======================================================================
+// Char classes
+//
+
+namespace {
+
+// Computes the class mask of a char from the char properties.
+int ComputeCharClasses(int c) {
+  int classes = 0;
+  if (is_punctuation_or_symbol(c)) classes |= kPunctuationOrSymbolClass;
+  if (is_open_quote(c)) classes |= kOpenQuoteClass;
+  if (is_close_quote(c)) classes |= kCloseQuoteClass;
+  if (c >= '0' && c <= '9') classes |= kAsciiDigitClass;
+  if (c >= 'A' && c <= 'Z') classes |= kAsciiUppercaseClass;
+  if (c >= 'a' && c <= 'z') classes |= kAsciiLowercaseClass;
+  if (c == '-') classes |= kHyphenClass;
+  return classes;
+}
+
+// Class masks of all chars of the Basic Multilingual Plane. Surrogates are not
+// valid chars, and have no class.
+class BmpCharClassTable {
+ public:
+  static const int kSize = 0x10000;
+
+  BmpCharClassTable() {
+    for (int c = 0; c < kSize; ++c) {
+      classes_[c] = UniLib::IsValidCodepoint(c) ? ComputeCharClasses(c) : 0;
+    }
+  }
+
+  int Get(int c) const { return classes_[c]; }
+
+  static const BmpCharClassTable &Instance() {
+    static const BmpCharClassTable *table = new BmpCharClassTable();
+    return *table;
+  }
+
+ private:
+  uint8 classes_[kSize];
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BmpCharClassTable);
+};
+
+}  // namespace
+
+int GetCharClasses(int c) {
+  if (c >= 0 && c < BmpCharClassTable::kSize) {
+    return BmpCharClassTable::Instance().Get(c);
+  }
+  return UniLib::IsValidCodepoint(c) ? ComputeCharClasses(c) : 0;
+}
+
+CharClasses ClassifyChars(const char *str, int len) {
+  const BmpCharClassTable &table = BmpCharClassTable::Instance();
+  CharClasses result;
+  int i = 0;
+  while (i < len) {
+    const unsigned char byte = str[i];
+    int classes = 0;
+    if (byte < 0x80) {
+      classes = table.Get(byte);
+      ++i;
+    } else {
+      const int char_len = UniLib::OneCharLen(str + i);
+      Rune r;
+      int consumed;
+      if (char_len <= len - i &&
+          isvalidcharntorune(str + i, char_len, &r, &consumed) &&
+          UniLib::IsValidCodepoint(r)) {
+        classes = GetCharClasses(r);
+        i += char_len;
+      } else {
+        ++i;
+      }
+    }
+    result.any |= classes;
+    result.all &= classes;
+  }
+  return result;
+}
+
 }  // namespace syntaxnet
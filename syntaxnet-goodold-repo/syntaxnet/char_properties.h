@@ -357,6 +357,39 @@ DECLARE_CHAR_PROPERTY(directional_formatting_code);
 // just those listed in our code. See the definitions in char_properties.cc.
 DECLARE_CHAR_PROPERTY(punctuation_or_symbol);
 
+
+// Classes of characters tested by the lexical category features, as bits of
+// one mask per character. The digit, case and hyphen classes only hold for
+// ASCII characters.
+enum CharClass {
+  kPunctuationOrSymbolClass = 1 << 0,
+  kOpenQuoteClass = 1 << 1,
+  kCloseQuoteClass = 1 << 2,
+  kAsciiDigitClass = 1 << 3,
+  kAsciiUppercaseClass = 1 << 4,
+  kAsciiLowercaseClass = 1 << 5,
+  kHyphenClass = 1 << 6,
+};
+
+// Classes of the characters of a string.
+struct CharClasses {
+  // Classes of at least one character.
+  int any = 0;
+
+  // Classes of every character. All classes hold for every character of an
+  // empty string.
+  int all = ~0;
+};
+
+// Returns the class mask of a single Unicode char. Chars of the Basic
+// Multilingual Plane are looked up in a table built on first use.
+int GetCharClasses(int c);
+
+// Classifies all UTF-8 chars of str[0, len) in a single pass. ASCII chars are
+// looked up without decoding. Each byte of an invalid UTF-8 sequence counts as
+// a char with no class.
+CharClasses ClassifyChars(const char *str, int len);
+
 }  // namespace syntaxnet
 
 #endif  // SYNTAXNET_CHAR_PROPERTIES_H_
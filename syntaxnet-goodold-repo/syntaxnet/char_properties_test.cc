@@ -361,4 +361,48 @@ TEST_F(CharPropertiesTest, Separator) {
   ExpectCharPropertyContainsCollectedSet("separator");
 }
 
+// ====================================================================
+// Char classes
+//
+
+TEST(CharClassesTest, TableMatchesCharProperties) {
+  for (char32 c = 0; c < 0x10000; ++c) {
+    if (!UniLib::IsValidCodepoint(c)) continue;
+    const int classes = GetCharClasses(c);
+    EXPECT_EQ(is_punctuation_or_symbol(c),
+              (classes & kPunctuationOrSymbolClass) != 0) << "for " << c;
+    EXPECT_EQ(is_open_quote(c), (classes & kOpenQuoteClass) != 0)
+        << "for " << c;
+    EXPECT_EQ(is_close_quote(c), (classes & kCloseQuoteClass) != 0)
+        << "for " << c;
+  }
+  EXPECT_EQ(kAsciiDigitClass, GetCharClasses('7'));
+  EXPECT_EQ(kAsciiUppercaseClass, GetCharClasses('Q'));
+  EXPECT_EQ(kAsciiLowercaseClass, GetCharClasses('q'));
+  EXPECT_EQ(kPunctuationOrSymbolClass | kHyphenClass, GetCharClasses('-'));
+  EXPECT_EQ(0, GetCharClasses(0xD800));
+}
+
+TEST(CharClassesTest, ClassifyChars) {
+  const CharClasses empty = ClassifyChars("", 0);
+  EXPECT_EQ(0, empty.any);
+  EXPECT_EQ(~0, empty.all);
+
+  // A-1 and a left double quotation mark, which can also close a quote.
+  const string word = "A-1\xE2\x80\x9C";
+  const CharClasses classes = ClassifyChars(word.data(), word.size());
+  EXPECT_EQ(kPunctuationOrSymbolClass | kOpenQuoteClass | kCloseQuoteClass |
+                kAsciiDigitClass | kAsciiUppercaseClass | kHyphenClass,
+            classes.any);
+  EXPECT_EQ(0, classes.all);
+
+  const string digits = "2016";
+  EXPECT_EQ(kAsciiDigitClass,
+            ClassifyChars(digits.data(), digits.size()).all);
+
+  // A truncated sequence is a char without class for each of its bytes.
+  const string truncated = "\xE2\x80";
+  EXPECT_EQ(0, ClassifyChars(truncated.data(), truncated.size()).any);
+}
+
 }  // namespace syntaxnet
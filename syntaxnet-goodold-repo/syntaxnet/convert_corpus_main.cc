@@ -0,0 +1,114 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Converts a corpus between document formats, e.g. from conll-sentence to
+// sentence-record, through the formats registered with
+// REGISTER_DOCUMENT_FORMAT. The input is read like a task input, so it can be
+// a comma-separated list of files and file patterns, and "-" reads standard
+// input or writes standard output.
+//
+// With --reader_threads, that many threads read and parse input files in
+// parallel, and sentences are still written in input order. With --num_shards,
+// the output is written to that many shards <output>-<i>-of-<n>, which receive
+// batches of --batch_size sentences in turn and are each converted and written
+// by a thread of their own. Sentences are streamed through queues of at most
+// --queue_size batches per shard, so memory does not grow with the corpus.
+//
+// Usage: convert_corpus_main --input=<files> --output=<file>
+//            [--input_format=conll-sentence] [--output_format=sentence-record]
+//            [--reader_threads=0] [--num_shards=1] [--batch_size=256]
+//            [--queue_size=4]
+
+#include <string>
+#include <vector>
+
+#include "syntaxnet/proto_io.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/task_spec.pb.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+using syntaxnet::Sentence;
+using syntaxnet::ShardedTextWriter;
+using syntaxnet::TaskContext;
+using syntaxnet::TaskInput;
+using syntaxnet::TextReader;
+
+int main(int argc, char **argv) {
+  string input;
+  string output;
+  string input_format = "conll-sentence";
+  string output_format = "sentence-record";
+  int reader_threads = 0;
+  int num_shards = 1;
+  int batch_size = 256;
+  int queue_size = 4;
+  const bool parsed_flags_ok = tensorflow::ParseFlags(
+      &argc, argv, {tensorflow::Flag("input", &input),
+                    tensorflow::Flag("output", &output),
+                    tensorflow::Flag("input_format", &input_format),
+                    tensorflow::Flag("output_format", &output_format),
+                    tensorflow::Flag("reader_threads", &reader_threads),
+                    tensorflow::Flag("num_shards", &num_shards),
+                    tensorflow::Flag("batch_size", &batch_size),
+                    tensorflow::Flag("queue_size", &queue_size)});
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parsed_flags_ok || input.empty() || output.empty() ||
+      num_shards < 1 || batch_size < 1 || (num_shards > 1 && output == "-")) {
+    LOG(ERROR) << "Usage: " << argv[0] << " --input=<files> --output=<file> "
+               << "[--input_format=conll-sentence] "
+               << "[--output_format=sentence-record] [--reader_threads=0] "
+               << "[--num_shards=1] [--batch_size=256] [--queue_size=4]";
+    return 1;
+  }
+
+  TaskContext context;
+  context.SetParameter("text_reader_threads",
+                       tensorflow::strings::StrCat(reader_threads));
+  TaskInput corpus;
+  corpus.set_name("corpus");
+  corpus.add_record_format(input_format);
+  for (const string &pattern : tensorflow::str_util::Split(input, ',')) {
+    corpus.add_part()->set_file_pattern(pattern);
+  }
+  TaskInput converted;
+  converted.set_name("converted");
+  converted.add_record_format(output_format);
+  converted.add_part()->set_file_pattern(output);
+
+  TextReader reader(corpus, &context);
+  int64 num_sentences = 0;
+  {
+    ShardedTextWriter writer(converted, &context, num_shards, queue_size);
+    std::vector<Sentence> batch;
+    batch.reserve(batch_size);
+    Sentence *sentence;
+    while ((sentence = reader.Read()) != nullptr) {
+      batch.emplace_back();
+      batch.back().Swap(sentence);
+      delete sentence;
+      ++num_sentences;
+      if (static_cast<int>(batch.size()) == batch_size) writer.Write(&batch);
+    }
+    if (!batch.empty()) writer.Write(&batch);
+  }
+  LOG(INFO) << "Converted " << num_sentences << " sentences from "
+            << input_format << " to " << output_format << " in " << output;
+  return 0;
+}
@@ -0,0 +1,208 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/cpu_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define SYNTAXNET_CPU_DISPATCH 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+namespace syntaxnet {
+namespace {
+
+void AddScaled(const float *values, float weight, int64 size, float *sums) {
+  for (int64 i = 0; i < size; ++i) sums[i] += weight * values[i];
+}
+
+void AddScaledHalf(const Eigen::half *values, float weight, int64 size,
+                   float *sums) {
+  for (int64 i = 0; i < size; ++i) {
+    sums[i] += weight * static_cast<float>(values[i]);
+  }
+}
+
+void MultiplyPanel(const float *inputs, int64 input_stride, int num_rows,
+                   int64 input_size, const float *panel, float *products) {
+  const int width = kCpuKernelPanelWidth;
+  std::fill(products, products + num_rows * width, 0.0f);
+  for (int64 k = 0; k < input_size; ++k) {
+    const float *weights = panel + k * width;
+    for (int r = 0; r < num_rows; ++r) {
+      const float input = inputs[r * input_stride + k];
+      float *sums = products + r * width;
+      for (int j = 0; j < width; ++j) sums[j] += input * weights[j];
+    }
+  }
+}
+
+float SumShiftedExp(const float *values, int64 size, float shift) {
+  float sum = 0.0f;
+  for (int64 i = 0; i < size; ++i) sum += std::exp(values[i] - shift);
+  return sum;
+}
+
+const CpuKernels kBaselineKernels = {CpuKernelLevel::kBaseline, AddScaled,
+                                     AddScaledHalf, MultiplyPanel,
+                                     SumShiftedExp};
+
+#if defined(SYNTAXNET_CPU_DISPATCH)
+
+// Compiles a function for AVX2 with FMA and F16C, whatever the flags of the
+// build. It must only run once CpuSupportsAvx2() returned true.
+#define SYNTAXNET_AVX2 __attribute__((target("avx2,fma,f16c")))
+
+// Returns whether the CPU has AVX2, FMA and F16C, and the operating system
+// saves the AVX registers on context switches.
+bool CpuSupportsAvx2() {
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) return false;
+  const unsigned int features = bit_FMA | bit_OSXSAVE | bit_AVX | bit_F16C;
+  if ((ecx & features) != features) return false;
+  unsigned int xcr0, xcr0_high;
+  __asm__("xgetbv" : "=a"(xcr0), "=d"(xcr0_high) : "c"(0));
+  const unsigned int sse_and_avx_state = 0x6;
+  if ((xcr0 & sse_and_avx_state) != sse_and_avx_state) return false;
+  if (__get_cpuid_max(0, nullptr) < 7) return false;
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  return (ebx & bit_AVX2) != 0;
+}
+
+SYNTAXNET_AVX2 void AddScaledAvx2(const float *values, float weight,
+                                  int64 size, float *sums) {
+  const __m256 scale = _mm256_set1_ps(weight);
+  int64 i = 0;
+  for (; i + 8 <= size; i += 8) {
+    _mm256_storeu_ps(sums + i,
+                     _mm256_fmadd_ps(scale, _mm256_loadu_ps(values + i),
+                                     _mm256_loadu_ps(sums + i)));
+  }
+  for (; i < size; ++i) sums[i] += weight * values[i];
+}
+
+SYNTAXNET_AVX2 void AddScaledHalfAvx2(const Eigen::half *values, float weight,
+                                      int64 size, float *sums) {
+  const __m256 scale = _mm256_set1_ps(weight);
+  int64 i = 0;
+  for (; i + 8 <= size; i += 8) {
+    const __m256 converted = _mm256_cvtph_ps(
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(values + i)));
+    _mm256_storeu_ps(sums + i, _mm256_fmadd_ps(scale, converted,
+                                               _mm256_loadu_ps(sums + i)));
+  }
+  for (; i < size; ++i) sums[i] += weight * static_cast<float>(values[i]);
+}
+
+SYNTAXNET_AVX2 void MultiplyPanelAvx2(const float *inputs, int64 input_stride,
+                                      int num_rows, int64 input_size,
+                                      const float *panel, float *products) {
+  const int width = kCpuKernelPanelWidth;
+  __m256 sums[kCpuKernelMaxPanelRows];
+  for (int r = 0; r < num_rows; ++r) sums[r] = _mm256_setzero_ps();
+  for (int64 k = 0; k < input_size; ++k) {
+    const __m256 weights = _mm256_loadu_ps(panel + k * width);
+    for (int r = 0; r < num_rows; ++r) {
+      sums[r] = _mm256_fmadd_ps(_mm256_set1_ps(inputs[r * input_stride + k]),
+                                weights, sums[r]);
+    }
+  }
+  for (int r = 0; r < num_rows; ++r) {
+    _mm256_storeu_ps(products + r * width, sums[r]);
+  }
+}
+
+// Returns exp(x) of eight values of at most zero, with the range reduction and
+// polynomial of the Cephes expf(). Values below -87 give exp(-87).
+SYNTAXNET_AVX2 __m256 ExpOfNonPositiveAvx2(__m256 x) {
+  x = _mm256_max_ps(x, _mm256_set1_ps(-87.0f));
+
+  // exp(x) = 2^n exp(r), with n the nearest integer to x / log(2) and
+  // r = x - n log(2) in [-log(2) / 2, log(2) / 2], log(2) being split in two
+  // to keep r exact.
+  const __m256 n = _mm256_round_ps(
+      _mm256_mul_ps(x, _mm256_set1_ps(1.44269504088896341f)),
+      _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 r = _mm256_fnmadd_ps(n, _mm256_set1_ps(0.693359375f), x);
+  r = _mm256_fnmadd_ps(n, _mm256_set1_ps(-2.12194440e-4f), r);
+  __m256 p = _mm256_set1_ps(1.9875691500e-4f);
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.3981999507e-3f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(8.3334519073e-3f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(4.1665795894e-2f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(1.6666665459e-1f));
+  p = _mm256_fmadd_ps(p, r, _mm256_set1_ps(5.0000001201e-1f));
+  p = _mm256_fmadd_ps(p, _mm256_mul_ps(r, r), r);
+  p = _mm256_add_ps(p, _mm256_set1_ps(1.0f));
+
+  // 2^n, built from its exponent bits.
+  const __m256i exponent = _mm256_slli_epi32(
+      _mm256_add_epi32(_mm256_cvtps_epi32(n), _mm256_set1_epi32(127)), 23);
+  return _mm256_mul_ps(p, _mm256_castsi256_ps(exponent));
+}
+
+SYNTAXNET_AVX2 float SumShiftedExpAvx2(const float *values, int64 size,
+                                       float shift) {
+  const __m256 shifts = _mm256_set1_ps(shift);
+  __m256 sums = _mm256_setzero_ps();
+  int64 i = 0;
+  for (; i + 8 <= size; i += 8) {
+    sums = _mm256_add_ps(sums, ExpOfNonPositiveAvx2(_mm256_sub_ps(
+                                   _mm256_loadu_ps(values + i), shifts)));
+  }
+  float lanes[8];
+  _mm256_storeu_ps(lanes, sums);
+  float sum = 0.0f;
+  for (float lane : lanes) sum += lane;
+  for (; i < size; ++i) sum += std::exp(values[i] - shift);
+  return sum;
+}
+
+const CpuKernels kAvx2Kernels = {CpuKernelLevel::kAvx2, AddScaledAvx2,
+                                 AddScaledHalfAvx2, MultiplyPanelAvx2,
+                                 SumShiftedExpAvx2};
+
+#endif  // SYNTAXNET_CPU_DISPATCH
+
+}  // namespace
+
+const CpuKernels *GetCpuKernelsForLevel(CpuKernelLevel level) {
+  switch (level) {
+    case CpuKernelLevel::kBaseline:
+      return &kBaselineKernels;
+    case CpuKernelLevel::kAvx2:
+#if defined(SYNTAXNET_CPU_DISPATCH)
+      return CpuSupportsAvx2() ? &kAvx2Kernels : nullptr;
+#else
+      return nullptr;
+#endif
+  }
+  return nullptr;
+}
+
+const CpuKernels &GetCpuKernels() {
+  // The CPU is only queried once, when the kernels are first needed.
+  static const CpuKernels *kernels = [] {
+    const CpuKernels *avx2 = GetCpuKernelsForLevel(CpuKernelLevel::kAvx2);
+    return avx2 != nullptr ? avx2 : &kBaselineKernels;
+  }();
+  return *kernels;
+}
+
+}  // namespace syntaxnet
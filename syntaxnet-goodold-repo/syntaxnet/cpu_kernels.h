@@ -0,0 +1,81 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Vector loops of the hot parser kernels, with runtime CPU dispatch. Each loop
+// is compiled for the baseline instruction set of the build and, with GCC or
+// Clang on x86-64, also for AVX2 with FMA and F16C, which the process picks
+// once if the CPU supports it. A binary built for the oldest hosts of a fleet
+// thus still runs these loops at full width on newer ones. Builds that enable
+// AVX2 and FMA anyway, e.g. with -mavx2 -mfma, have both versions use them.
+//
+// The matrix products and softmax of the TensorFlow ops go through Eigen,
+// whose instruction set is fixed when it is compiled, and are not dispatched.
+
+#ifndef SYNTAXNET_CPU_KERNELS_H_
+#define SYNTAXNET_CPU_KERNELS_H_
+
+#include "syntaxnet/utils.h"
+
+namespace Eigen {
+struct half;
+}  // namespace Eigen
+
+namespace syntaxnet {
+
+// Instruction sets the kernels are compiled for, from the most portable.
+enum class CpuKernelLevel { kBaseline, kAvx2 };
+
+// One version of the kernels.
+struct CpuKernels {
+  // Level the kernels are compiled for.
+  CpuKernelLevel level;
+
+  // Adds weight * values[i] to sums[i] for i in [0, size).
+  void (*add_scaled)(const float *values, float weight, int64 size,
+                     float *sums);
+
+  // Same, converting half precision values to float.
+  void (*add_scaled_half)(const Eigen::half *values, float weight, int64 size,
+                          float *sums);
+
+  // Multiplies num_rows <= kCpuKernelMaxPanelRows rows of inputs, input_size
+  // wide and input_stride apart, by a panel of weights holding the
+  // kCpuKernelPanelWidth weights of each input in turn, and stores the
+  // kCpuKernelPanelWidth products of each row one after the other.
+  void (*multiply_panel)(const float *inputs, int64 input_stride,
+                         int num_rows, int64 input_size, const float *panel,
+                         float *products);
+
+  // Returns the sum of exp(values[i] - shift) for i in [0, size), where shift
+  // is at least every value, as for the normalizer of a softmax.
+  float (*sum_shifted_exp)(const float *values, int64 size, float shift);
+};
+
+// Width of the panels of CpuKernels::multiply_panel, that of an AVX register.
+static const int kCpuKernelPanelWidth = 8;
+
+// Maximum number of rows CpuKernels::multiply_panel multiplies at once.
+static const int kCpuKernelMaxPanelRows = 4;
+
+// Returns the best kernels the build has for the CPU running the process.
+const CpuKernels &GetCpuKernels();
+
+// Returns the kernels compiled for the given level, or null if the build has
+// none or the CPU does not support them. For tests and benchmarks.
+const CpuKernels *GetCpuKernelsForLevel(CpuKernelLevel level);
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_CPU_KERNELS_H_
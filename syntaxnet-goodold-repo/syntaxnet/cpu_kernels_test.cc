@@ -0,0 +1,121 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/cpu_kernels.h"
+
+#include <cmath>
+#include <vector>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+namespace {
+
+// Returns the kernels of every level the build and CPU have.
+std::vector<const CpuKernels *> AvailableKernels() {
+  std::vector<const CpuKernels *> kernels;
+  for (CpuKernelLevel level :
+       {CpuKernelLevel::kBaseline, CpuKernelLevel::kAvx2}) {
+    const CpuKernels *level_kernels = GetCpuKernelsForLevel(level);
+    if (level_kernels != nullptr) kernels.push_back(level_kernels);
+  }
+  return kernels;
+}
+
+// Returns size values in [-scale, scale).
+std::vector<float> Values(int size, float scale) {
+  std::vector<float> values(size);
+  for (int i = 0; i < size; ++i) {
+    values[i] = scale * (((i * 37) % 101) / 50.5f - 1.0f);
+  }
+  return values;
+}
+
+TEST(CpuKernelsTest, DispatchesToAnAvailableLevel) {
+  ASSERT_NE(nullptr, GetCpuKernelsForLevel(CpuKernelLevel::kBaseline));
+  const CpuKernels &kernels = GetCpuKernels();
+  EXPECT_EQ(&kernels, GetCpuKernelsForLevel(kernels.level));
+  if (GetCpuKernelsForLevel(CpuKernelLevel::kAvx2) != nullptr) {
+    EXPECT_EQ(CpuKernelLevel::kAvx2, kernels.level);
+  }
+}
+
+TEST(CpuKernelsTest, AddScaledMatchesLoop) {
+  // Sizes below, at and past a vector register, with a remainder.
+  for (const CpuKernels *kernels : AvailableKernels()) {
+    for (int size : {3, 8, 29}) {
+      const std::vector<float> values = Values(size, 2.0f);
+      std::vector<float> sums = Values(size, 1.0f);
+      std::vector<float> expected = sums;
+      for (int i = 0; i < size; ++i) expected[i] += 0.5f * values[i];
+      kernels->add_scaled(values.data(), 0.5f, size, sums.data());
+      for (int i = 0; i < size; ++i) EXPECT_NEAR(expected[i], sums[i], 1e-6);
+
+      std::vector<Eigen::half> halves(size);
+      for (int i = 0; i < size; ++i) halves[i] = Eigen::half(values[i]);
+      sums = Values(size, 1.0f);
+      expected = sums;
+      for (int i = 0; i < size; ++i) {
+        expected[i] += -2.0f * static_cast<float>(halves[i]);
+      }
+      kernels->add_scaled_half(halves.data(), -2.0f, size, sums.data());
+      for (int i = 0; i < size; ++i) EXPECT_NEAR(expected[i], sums[i], 1e-6);
+    }
+  }
+}
+
+TEST(CpuKernelsTest, MultiplyPanelMatchesLoop) {
+  const int width = kCpuKernelPanelWidth;
+  const int input_size = 13;
+  const int input_stride = 16;
+  const std::vector<float> inputs =
+      Values(kCpuKernelMaxPanelRows * input_stride, 1.0f);
+  const std::vector<float> panel = Values(input_size * width, 3.0f);
+  for (const CpuKernels *kernels : AvailableKernels()) {
+    for (int num_rows = 1; num_rows <= kCpuKernelMaxPanelRows; ++num_rows) {
+      std::vector<float> products(num_rows * width, -1.0f);
+      kernels->multiply_panel(inputs.data(), input_stride, num_rows,
+                              input_size, panel.data(), products.data());
+      for (int r = 0; r < num_rows; ++r) {
+        for (int j = 0; j < width; ++j) {
+          float expected = 0.0f;
+          for (int k = 0; k < input_size; ++k) {
+            expected += inputs[r * input_stride + k] * panel[k * width + j];
+          }
+          EXPECT_NEAR(expected, products[r * width + j], 1e-5);
+        }
+      }
+    }
+  }
+}
+
+TEST(CpuKernelsTest, SumShiftedExpMatchesLoop) {
+  // Includes values far enough below the shift to underflow.
+  std::vector<float> values = Values(37, 20.0f);
+  values.push_back(-200.0f);
+  for (const CpuKernels *kernels : AvailableKernels()) {
+    for (float shift : {20.0f, 25.0f}) {
+      double expected = 0.0;
+      for (float value : values) expected += std::exp(value - shift);
+      const float sum =
+          kernels->sum_shifted_exp(values.data(), values.size(), shift);
+      EXPECT_NEAR(1.0, sum / expected, 1e-6);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace syntaxnet
@@ -0,0 +1,101 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/document_batch.h"
+
+#include <atomic>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+using tensorflow::Status;
+using tensorflow::Tensor;
+using tensorflow::TensorShape;
+using tensorflow::errors::InvalidArgument;
+
+namespace syntaxnet {
+
+const char DocumentBatch::kContainer[] = "syntaxnet_document_batches";
+
+string DocumentBatch::DebugString() {
+  return tensorflow::strings::StrCat("DocumentBatch of ", documents_.size(),
+                                     " documents");
+}
+
+Status OutputDocumentBatch(tensorflow::OpKernelContext *context,
+                           int output_index, bool as_handle,
+                           vector<Sentence> *documents) {
+  Tensor *output;
+  if (!as_handle) {
+    const int64 size = documents->size();
+    TF_RETURN_IF_ERROR(
+        context->allocate_output(output_index, TensorShape({size}), &output));
+    for (int64 i = 0; i < size; ++i) {
+      output->vec<string>()(i) = (*documents)[i].SerializeAsString();
+    }
+    documents->clear();
+    return Status::OK();
+  }
+
+  // Batch names are unique within the process, so that batches output by
+  // concurrent steps do not collide.
+  static std::atomic<int64> next_batch_id(0);
+  const string name = tensorflow::strings::StrCat(
+      context->op_kernel().name(), "/", next_batch_id++);
+  DocumentBatch *batch = new DocumentBatch();
+  batch->documents()->swap(*documents);
+  TF_RETURN_IF_ERROR(context->resource_manager()->Create(
+      DocumentBatch::kContainer, name, batch));
+  TF_RETURN_IF_ERROR(
+      context->allocate_output(output_index, TensorShape({2}), &output));
+  output->vec<string>()(0) = DocumentBatch::kContainer;
+  output->vec<string>()(1) = name;
+  return Status::OK();
+}
+
+Status InputDocumentBatch(tensorflow::OpKernelContext *context,
+                          int input_index, bool as_handle,
+                          vector<Sentence> *documents) {
+  const auto input = context->input(input_index).vec<string>();
+  documents->clear();
+  if (!as_handle) {
+    documents->resize(input.size());
+    for (int i = 0; i < input.size(); ++i) {
+      if (!(*documents)[i].ParseFromString(input(i))) {
+        return InvalidArgument("failed to parse sentence");
+      }
+    }
+    return Status::OK();
+  }
+
+  if (input.size() != 2) {
+    return InvalidArgument("Document batch handle must have 2 elements, got ",
+                           input.size());
+  }
+  tensorflow::ResourceMgr *resource_manager = context->resource_manager();
+  DocumentBatch *batch;
+  Status status = resource_manager->Lookup(input(0), input(1), &batch);
+  if (!status.ok()) {
+    return InvalidArgument("No document batch ", input(1),
+                           ", it may have been read already: ",
+                           status.error_message());
+  }
+  documents->swap(*batch->documents());
+  batch->Unref();
+  return resource_manager->Delete<DocumentBatch>(input(0), input(1));
+}
+
+}  // namespace syntaxnet
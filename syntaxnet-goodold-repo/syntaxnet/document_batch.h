@@ -0,0 +1,76 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// In-memory batches of documents, passed between ops within a graph as
+// handles to resources of the resource manager. Ops with the "batch_handle"
+// attribute set output such a handle in place of a vector of serialized
+// Sentence protos, or read one, so that a pipeline like DocumentSource ->
+// WellFormedProjectivizeFilter -> DocumentSink parses and serializes each
+// document only where it enters or leaves the graph.
+//
+// A handle is a string vector with the container and the name of the batch.
+// The op reading a handle takes the documents and deletes the batch, so every
+// handle must be read by exactly one op.
+
+#ifndef SYNTAXNET_DOCUMENT_BATCH_H_
+#define SYNTAXNET_DOCUMENT_BATCH_H_
+
+#include <string>
+#include <vector>
+
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace syntaxnet {
+
+// A batch of documents owned by a resource manager.
+class DocumentBatch : public tensorflow::ResourceBase {
+ public:
+  // Container of the resource manager holding the batches.
+  static const char kContainer[];
+
+  DocumentBatch() {}
+
+  // Documents of the batch.
+  vector<Sentence> *documents() { return &documents_; }
+
+  string DebugString() override;
+
+ private:
+  vector<Sentence> documents_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(DocumentBatch);
+};
+
+// Outputs the documents, leaving the vector empty. If as_handle is true, they
+// are moved to a new batch of the resource manager of the op and its handle is
+// output, otherwise they are output as serialized protos.
+tensorflow::Status OutputDocumentBatch(tensorflow::OpKernelContext *context,
+                                       int output_index, bool as_handle,
+                                       vector<Sentence> *documents);
+
+// Reads the documents of an input into the vector. If as_handle is true, the
+// input is the handle of a batch, whose documents are taken and which is
+// deleted, otherwise it is a vector of serialized protos.
+tensorflow::Status InputDocumentBatch(tensorflow::OpKernelContext *context,
+                                      int input_index, bool as_handle,
+                                      vector<Sentence> *documents);
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_DOCUMENT_BATCH_H_
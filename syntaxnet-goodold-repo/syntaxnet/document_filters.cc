@@ -22,14 +22,19 @@ limitations under the License.
 #include <vector>
 
 #include "syntaxnet/base.h"
+#include "syntaxnet/document_batch.h"
+#include "syntaxnet/document_queue.h"
 #include "syntaxnet/feature_extractor.h"
+#include "syntaxnet/proto_io.h"
 #include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/sentence_tracing.h"
 #include "syntaxnet/utils.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 using tensorflow::DEVICE_CPU;
 using tensorflow::OpKernel;
@@ -53,19 +58,6 @@ void GetTaskContext(OpKernelConstruction *context, TaskContext *task_context) {
               InvalidArgument("Could not parse task context at ", file_path));
 }
 
-// Outputs the given batch of sentences as a tensor and deletes them.
-void OutputDocuments(OpKernelContext *context,
-                     vector<Sentence *> *document_batch) {
-  const int64 size = document_batch->size();
-  Tensor *output;
-  OP_REQUIRES_OK(context,
-                 context->allocate_output(0, TensorShape({size}), &output));
-  for (int64 i = 0; i < size; ++i) {
-    output->vec<string>()(i) = (*document_batch)[i]->SerializeAsString();
-  }
-  utils::STLDeleteElements(document_batch);
-}
-
 }  // namespace
 
 class DocumentSource : public OpKernel {
@@ -77,27 +69,81 @@ class DocumentSource : public OpKernel {
     OP_REQUIRES_OK(context, context->GetAttr("batch_size", &batch_size_));
     OP_REQUIRES(context, batch_size_ > 0,
                 InvalidArgument("invalid batch_size provided"));
-    corpus_.reset(
-        new TextReader(*task_context_.GetInput(corpus_name), &task_context_));
+    OP_REQUIRES_OK(context, context->GetAttr("batch_handle", &batch_handle_));
+    const TaskInput &input = *task_context_.GetInput(corpus_name);
+    if (DocumentQueue::IsQueueInput(input)) {
+      queue_ = DocumentQueue::ForInput(input);
+    } else {
+      corpus_.reset(new TextReader(input, &task_context_));
+    }
+    use_arena_ =
+        !batch_handle_ && corpus_ != nullptr && !corpus_->parses_ahead();
   }
 
   void Compute(OpKernelContext *context) override {
-    mutex_lock lock(mu_);
-    Sentence *document;
-    vector<Sentence *> document_batch;
-    while ((document = corpus_->Read()) != nullptr) {
-      document_batch.push_back(document);
-      if (static_cast<int>(document_batch.size()) == batch_size_) {
-        OutputDocuments(context, &document_batch);
-        OutputLast(context, false);
-        return;
+    if (use_arena_) {
+      ComputeOnArena(context);
+      return;
+    }
+    vector<Sentence> document_batch;
+    document_batch.reserve(batch_size_);
+    bool last = true;
+    {
+      // Only reading is serialized, so that concurrent steps overlap in
+      // outputting their batches.
+      mutex_lock lock(mu_);
+      Sentence *document;
+      while ((document = Read()) != nullptr) {
+        document_batch.emplace_back();
+        document_batch.back().Swap(document);
+        delete document;
+        if (static_cast<int>(document_batch.size()) == batch_size_) {
+          last = false;
+          break;
+        }
       }
     }
-    OutputDocuments(context, &document_batch);
-    OutputLast(context, true);
+    OP_REQUIRES_OK(context, OutputDocumentBatch(context, 0, batch_handle_,
+                                                &document_batch));
+    OutputLast(context, last);
   }
 
  private:
+  // Reads a batch of corpus documents onto an arena and outputs them
+  // serialized. The documents and their tokens are then freed at once with
+  // the arena, rather than one allocation at a time.
+  void ComputeOnArena(OpKernelContext *context) {
+    tensorflow::protobuf::Arena arena;
+    vector<Sentence *> document_batch;
+    document_batch.reserve(batch_size_);
+    bool last = true;
+    {
+      mutex_lock lock(mu_);
+      Sentence *document;
+      while ((document = corpus_->Read(&arena)) != nullptr) {
+        document_batch.push_back(document);
+        if (static_cast<int>(document_batch.size()) == batch_size_) {
+          last = false;
+          break;
+        }
+      }
+    }
+    Tensor *output;
+    const int64 size = document_batch.size();
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({size}), &output));
+    for (int64 i = 0; i < size; ++i) {
+      output->vec<string>()(i) = document_batch[i]->SerializeAsString();
+    }
+    OutputLast(context, last);
+  }
+
+  // Reads the next document from the corpus or queue. Returns nullptr at the
+  // end of the corpus, or if the queue is empty.
+  Sentence *Read() {
+    return queue_ != nullptr ? queue_->Pop() : corpus_->Read();
+  }
+
   void OutputLast(OpKernelContext *context, bool last) {
     Tensor *output;
     OP_REQUIRES_OK(context,
@@ -108,12 +154,24 @@ class DocumentSource : public OpKernel {
   // Task context used to configure this op.
   TaskContext task_context_;
 
-  // mutex to synchronize access to Compute.
+  // mutex to synchronize reading documents.
   mutex mu_;
 
   std::unique_ptr<TextReader> corpus_;
+
+  // Queue to read from instead of the corpus, if non-null. Not owned.
+  DocumentQueue *queue_ = nullptr;
+
   string documents_path_;
   int batch_size_;
+
+  // Whether to output the handle of a document batch.
+  bool batch_handle_ = false;
+
+  // Whether batches are read onto an arena. Only serialized batches of a
+  // corpus read in the calling thread are, since a batch handle keeps its
+  // documents, and sentences parsed ahead are already on the heap.
+  bool use_arena_ = false;
 };
 
 REGISTER_KERNEL_BUILDER(Name("DocumentSource").Device(DEVICE_CPU),
@@ -125,18 +183,53 @@ class DocumentSink : public OpKernel {
     GetTaskContext(context, &task_context_);
     string corpus_name;
     OP_REQUIRES_OK(context, context->GetAttr("corpus_name", &corpus_name));
-    writer_.reset(
-        new TextWriter(*task_context_.GetInput(corpus_name), &task_context_));
+    OP_REQUIRES_OK(context, context->GetAttr("batch_handle", &batch_handle_));
+    int num_shards, writer_queue_size;
+    OP_REQUIRES_OK(context, context->GetAttr("num_shards", &num_shards));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("writer_queue_size", &writer_queue_size));
+    const TaskInput &input = *task_context_.GetInput(corpus_name);
+    if (DocumentQueue::IsQueueInput(input)) {
+      queue_ = DocumentQueue::ForInput(input);
+    } else {
+      OP_REQUIRES(
+          context, num_shards == 1 || TaskContext::InputFile(input) != "-",
+          InvalidArgument("Cannot shard standard output"));
+      async_ = writer_queue_size > 0;
+      writer_.reset(new ShardedTextWriter(input, &task_context_, num_shards,
+                                          writer_queue_size));
+    }
   }
 
   void Compute(OpKernelContext *context) override {
+    // Serialized documents are parsed on the writer threads when writing
+    // asynchronously, so their output is not traced.
+    if (async_ && !batch_handle_) {
+      auto serialized = context->input(0).vec<string>();
+      vector<string> documents(serialized.data(),
+                               serialized.data() + serialized.size());
+      writer_->WriteSerialized(&documents);
+      return;
+    }
+    vector<Sentence> documents;
+    OP_REQUIRES_OK(context, InputDocumentBatch(context, 0, batch_handle_,
+                                               &documents));
+    string trace_ids;
+    for (const Sentence &document : documents) {
+      AddTraceId(document, &trace_ids);
+    }
+    SentenceSpan span("output", trace_ids);
+    if (writer_ != nullptr) {
+      writer_->Write(&documents);
+      return;
+    }
+
+    // Keeps the documents of a batch together in the queue.
     mutex_lock lock(mu_);
-    auto documents = context->input(0).vec<string>();
-    for (int i = 0; i < documents.size(); ++i) {
-      Sentence document;
-      OP_REQUIRES(context, document.ParseFromString(documents(i)),
-                  InvalidArgument("failed to parse sentence"));
-      writer_->Write(document);
+    for (Sentence &document : documents) {
+      Sentence *queued = new Sentence;
+      queued->Swap(&document);
+      queue_->Push(queued);
     }
   }
 
@@ -144,69 +237,284 @@ class DocumentSink : public OpKernel {
   // Task context used to configure this op.
   TaskContext task_context_;
 
-  // mutex to synchronize access to Compute.
+  // mutex to synchronize writing documents to the queue.
   mutex mu_;
 
   string documents_path_;
-  std::unique_ptr<TextWriter> writer_;
+  std::unique_ptr<ShardedTextWriter> writer_;
+
+  // Whether the writer writes on background threads.
+  bool async_ = false;
+
+  // Queue to write to instead of the writer, if non-null. Not owned.
+  DocumentQueue *queue_ = nullptr;
+
+  // Whether the input is the handle of a document batch.
+  bool batch_handle_ = false;
 };
 
 REGISTER_KERNEL_BUILDER(Name("DocumentSink").Device(DEVICE_CPU),
                         DocumentSink);
 
-// Sentence filter for filtering out documents where the parse trees are not
-// well-formed, i.e. they contain cycles.
-class WellFormedFilter : public OpKernel {
+namespace {
+
+// Returns true if the heads of the document form a forest, i.e. every head is
+// within the document and there are no cycles.
+bool IsWellFormed(const Sentence &doc) {
+  const int num_tokens = doc.token_size();
+  vector<int> visited(num_tokens, -1);
+  for (int i = 0; i < num_tokens; ++i) {
+    // Already visited node.
+    if (visited[i] != -1) continue;
+    int t = i;
+    while (t != -1) {
+      if (t < -1 || t >= num_tokens) {
+        LOG(ERROR) << "Head out of range in document " << doc.DebugString();
+        return false;
+      }
+      if (visited[t] == -1) {
+        // If it is not visited yet, mark it.
+        visited[t] = i;
+      } else if (visited[t] < i) {
+        // If the index number is smaller than index and not -1, the token has
+        // already been visited.
+        break;
+      } else {
+        // Loop detected.
+        LOG(ERROR) << "Loop detected in document " << doc.DebugString();
+        return false;
+      }
+      t = doc.token(t).head();
+    }
+  }
+  return true;
+}
+
+// Returns the depth of a token in a well-formed tree, i.e. the number of tokens
+// on its path to the root, memoized in depths.
+int Depth(const vector<int> &heads, int token, vector<int> *depths) {
+  if (token == -1) return 0;
+  int &depth = (*depths)[token];
+  if (depth == 0) depth = Depth(heads, heads[token], depths) + 1;
+  return depth;
+}
+
+// Makes the dependency tree of a well-formed document projective by lifting
+// the deepest non-projective arc until there are none left, and sets
+// *modified to true if an arc was lifted. If discard_non_projective is true,
+// instead returns false for non-projective trees without modifying them.
+bool Projectivize(bool discard_non_projective, Sentence *doc, bool *modified) {
+  const int num_tokens = doc->token_size();
+
+  // Heads of the tokens, read from the document once and written back if any
+  // arc is lifted.
+  vector<int> heads(num_tokens);
+  for (int i = 0; i < num_tokens; ++i) heads[i] = doc->token(i).head();
+
+  // Left and right boundaries for arcs. The left and right ends of an arc are
+  // bounded by the arcs that pass over it. If an arc exceeds these bounds it
+  // will cross an arc passing over it, making it a non-projective arc.
+  vector<int> left(num_tokens);
+  vector<int> right(num_tokens);
+
+  // Depths of the tokens in the tree, computed on demand, or 0 if unknown.
+  vector<int> depths(num_tokens);
+
+  // Lift the deepest non-projective arc until the document is projective.
+  bool lifted = false;
+  while (true) {
+    // Initialize boundaries to the whole document for all arcs.
+    std::fill(left.begin(), left.end(), -1);
+    std::fill(right.begin(), right.end(), num_tokens - 1);
+
+    // Find left and right bounds for each token.
+    for (int i = 0; i < num_tokens; ++i) {
+      // Find left and right end of arc.
+      const int l = std::min(i, heads[i]);
+      const int r = std::max(i, heads[i]);
+
+      // Bound all tokens under the arc.
+      for (int j = l + 1; j < r; ++j) {
+        if (left[j] < l) left[j] = l;
+        if (right[j] > r) right[j] = r;
+      }
+    }
+
+    // Find deepest non-projective arc.
+    int deepest_arc = -1;
+    int max_depth = -1;
+    std::fill(depths.begin(), depths.end(), 0);
+
+    // The non-projective arcs are those that exceed their bounds.
+    for (int i = 0; i < num_tokens; ++i) {
+      if (heads[i] == -1) continue;  // any crossing arc must be deeper
+
+      const int l = std::min(i, heads[i]);
+      const int r = std::max(i, heads[i]);
+
+      const int left_bound = std::max(left[l], left[r]);
+      const int right_bound = std::min(right[l], right[r]);
+
+      if (l < left_bound || r > right_bound) {
+        // Found non-projective arc.
+        if (discard_non_projective) return false;
+
+        // Pick the deepest as the best candidate for lifting.
+        const int depth = Depth(heads, i, &depths);
+        if (depth > max_depth) {
+          deepest_arc = i;
+          max_depth = depth;
+        }
+      }
+    }
+
+    // If there are no more non-projective arcs we are done.
+    if (deepest_arc == -1) break;
+
+    // Lift non-projective arc.
+    heads[deepest_arc] = heads[heads[deepest_arc]];
+    lifted = true;
+  }
+
+  if (lifted) {
+    for (int i = 0; i < num_tokens; ++i) {
+      if (doc->token(i).head() != heads[i]) {
+        doc->mutable_token(i)->set_head(heads[i]);
+      }
+    }
+    *modified = true;
+  }
+  return true;
+}
+
+}  // namespace
+
+// Base class of filters that check, and possibly modify, the documents of a
+// batch independently of each other. Each document is parsed once, and the
+// batch is split across the worker threads. Documents kept unchanged are output
+// as they were input, without serializing them again. With batch_handle, the
+// documents of a document batch are filtered in place instead.
+class DocumentFilter : public OpKernel {
  public:
-  explicit WellFormedFilter(OpKernelConstruction *context) : OpKernel(context) {
-    GetTaskContext(context, &task_context_);
-    OP_REQUIRES_OK(context, context->GetAttr("keep_malformed_documents",
-                                             &keep_malformed_));
+  explicit DocumentFilter(OpKernelConstruction *context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("batch_handle", &batch_handle_));
   }
 
   void Compute(OpKernelContext *context) override {
-    auto documents = context->input(0).vec<string>();
-    vector<Sentence *> output_documents;
-    for (int i = 0; i < documents.size(); ++i) {
-      Sentence *document = new Sentence;
-      OP_REQUIRES(context, document->ParseFromString(documents(i)),
+    if (batch_handle_) {
+      FilterBatch(context);
+      return;
+    }
+    const auto documents = context->input(0).vec<string>();
+    const int64 num_documents = documents.size();
+
+    // Whether each document could be parsed, is kept and was modified, and
+    // the serialization of the modified documents.
+    vector<char> parsed(num_documents, false);
+    vector<char> kept(num_documents, false);
+    vector<char> modified(num_documents, false);
+    vector<string> outputs(num_documents);
+    auto work = [&](int64 begin, int64 end) {
+      Sentence document;
+      for (int64 i = begin; i < end; ++i) {
+        if (!document.ParseFromString(documents(i))) continue;
+        parsed[i] = true;
+        bool changed = false;
+        SentenceSpan span(type_string(), document);
+        kept[i] = Filter(&document, &changed);
+        if (kept[i] && changed) {
+          modified[i] = true;
+          outputs[i] = document.SerializeAsString();
+        }
+      }
+    };
+    const auto &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    tensorflow::Shard(worker_threads.num_threads, worker_threads.workers,
+                      num_documents, kFilterCost, work);
+
+    int64 num_kept = 0;
+    for (int64 i = 0; i < num_documents; ++i) {
+      OP_REQUIRES(context, parsed[i],
                   InvalidArgument("failed to parse sentence"));
-      if (ShouldKeep(*document)) {
-        output_documents.push_back(document);
+      if (kept[i]) ++num_kept;
+    }
+    Tensor *output;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({num_kept}),
+                                            &output));
+    auto filtered = output->vec<string>();
+    int64 index = 0;
+    for (int64 i = 0; i < num_documents; ++i) {
+      if (!kept[i]) continue;
+      if (modified[i]) {
+        filtered(index++).swap(outputs[i]);
       } else {
-        delete document;
+        filtered(index++) = documents(i);
       }
     }
-    OutputDocuments(context, &output_documents);
   }
 
+ protected:
+  // Returns whether to keep the document, and sets *modified to true if the
+  // document was changed. Called concurrently on different documents.
+  virtual bool Filter(Sentence *document, bool *modified) const = 0;
+
+  // Rough cost in cycles of parsing and filtering one document, for sharding
+  // the batch.
+  static const int64 kFilterCost = 100000;
+
  private:
-  bool ShouldKeep(const Sentence &doc)  {
-    vector<int> visited(doc.token_size(), -1);
-    for (int i = 0; i < doc.token_size(); ++i) {
-      // Already visited node.
-      if (visited[i] != -1) continue;
-      int t = i;
-      while (t != -1) {
-        if (visited[t] == -1) {
-          // If it is not visited yet, mark it.
-          visited[t] = i;
-        } else if (visited[t] < i) {
-          // If the index number is smaller than index and not -1, the token has
-          // already been visited.
-          break;
-        } else {
-          // Loop detected.
-          LOG(ERROR) << "Loop detected in document " << doc.DebugString();
-          return keep_malformed_;
-        }
-        t = doc.token(t).head();
+  // Filters the documents of the input batch, and outputs the kept ones as a
+  // new batch.
+  void FilterBatch(OpKernelContext *context) {
+    vector<Sentence> documents;
+    OP_REQUIRES_OK(context, InputDocumentBatch(context, 0, true, &documents));
+    const int64 num_documents = documents.size();
+    vector<char> kept(num_documents, false);
+    auto work = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        bool modified = false;
+        SentenceSpan span(type_string(), documents[i]);
+        kept[i] = Filter(&documents[i], &modified);
       }
+    };
+    const auto &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    tensorflow::Shard(worker_threads.num_threads, worker_threads.workers,
+                      num_documents, kFilterCost, work);
+
+    int64 num_kept = 0;
+    for (int64 i = 0; i < num_documents; ++i) {
+      if (!kept[i]) continue;
+      if (num_kept != i) documents[num_kept].Swap(&documents[i]);
+      ++num_kept;
     }
-    return true;
+    documents.resize(num_kept);
+    OP_REQUIRES_OK(context, OutputDocumentBatch(context, 0, true, &documents));
+  }
+
+  // Whether the input and output are handles of document batches.
+  bool batch_handle_ = false;
+};
+
+
+// Sentence filter for filtering out documents where the parse trees are not
+// well-formed, i.e. they contain cycles or heads outside the document.
+class WellFormedFilter : public DocumentFilter {
+ public:
+  explicit WellFormedFilter(OpKernelConstruction *context)
+      : DocumentFilter(context) {
+    GetTaskContext(context, &task_context_);
+    OP_REQUIRES_OK(context, context->GetAttr("keep_malformed_documents",
+                                             &keep_malformed_));
   }
 
  private:
+  bool Filter(Sentence *document, bool *modified) const override {
+    return IsWellFormed(*document) || keep_malformed_;
+  }
+
   // Task context used to configure this op.
   TaskContext task_context_;
 
@@ -224,114 +532,61 @@ REGISTER_KERNEL_BUILDER(Name("WellFormedFilter").Device(DEVICE_CPU),
 // Task arguments:
 //   bool discard_non_projective (false) : If true, discards documents with
 //     non-projective trees instead of projectivizing them.
-class ProjectivizeFilter : public OpKernel {
+class ProjectivizeFilter : public DocumentFilter {
  public:
   explicit ProjectivizeFilter(OpKernelConstruction *context)
-      : OpKernel(context) {
+      : DocumentFilter(context) {
     GetTaskContext(context, &task_context_);
     OP_REQUIRES_OK(context, context->GetAttr("discard_non_projective",
                                              &discard_non_projective_));
   }
 
-  void Compute(OpKernelContext *context) override {
-    auto documents = context->input(0).vec<string>();
-    vector<Sentence *> output_documents;
-    for (int i = 0; i < documents.size(); ++i) {
-      Sentence *document = new Sentence;
-      OP_REQUIRES(context, document->ParseFromString(documents(i)),
-                  InvalidArgument("failed to parse sentence"));
-      if (Process(document)) {
-        output_documents.push_back(document);
-      } else {
-        delete document;
-      }
-    }
-    OutputDocuments(context, &output_documents);
+ private:
+  bool Filter(Sentence *document, bool *modified) const override {
+    return Projectivize(discard_non_projective_, document, modified);
   }
 
-  bool Process(Sentence *doc) {
-    const int num_tokens = doc->token_size();
-
-    // Left and right boundaries for arcs. The left and right ends of an arc are
-    // bounded by the arcs that pass over it. If an arc exceeds these bounds it
-    // will cross an arc passing over it, making it a non-projective arc.
-    vector<int> left(num_tokens);
-    vector<int> right(num_tokens);
-
-    // Lift the shortest non-projective arc until the document is projective.
-    while (true) {
-      // Initialize boundaries to the whole document for all arcs.
-      for (int i = 0; i < num_tokens; ++i) {
-        left[i] = -1;
-        right[i] = num_tokens - 1;
-      }
-
-      // Find left and right bounds for each token.
-      for (int i = 0; i < num_tokens; ++i) {
-        int head_index = doc->token(i).head();
-
-        // Find left and right end of arc.
-        int l = std::min(i, head_index);
-        int r = std::max(i, head_index);
-
-        // Bound all tokens under the arc.
-        for (int j = l + 1; j < r; ++j) {
-          if (left[j] < l) left[j] = l;
-          if (right[j] > r) right[j] = r;
-        }
-      }
+  // Task context used to configure this op.
+  TaskContext task_context_;
 
-      // Find deepest non-projective arc.
-      int deepest_arc = -1;
-      int max_depth = -1;
-
-      // The non-projective arcs are those that exceed their bounds.
-      for (int i = 0; i < num_tokens; ++i) {
-        int head_index = doc->token(i).head();
-        if (head_index == -1) continue;  // any crossing arc must be deeper
-
-        int l = std::min(i, head_index);
-        int r = std::max(i, head_index);
-
-        int left_bound = std::max(left[l], left[r]);
-        int right_bound = std::min(right[l], right[r]);
-
-        if (l < left_bound || r > right_bound) {
-          // Found non-projective arc.
-          if (discard_non_projective_) return false;
-
-          // Pick the deepest as the best candidate for lifting.
-          int depth = 0;
-          int j = i;
-          while (j != -1) {
-            ++depth;
-            j = doc->token(j).head();
-          }
-          if (depth > max_depth) {
-            deepest_arc = i;
-            max_depth = depth;
-          }
-        }
-      }
+  // Whether or not to throw away non-projective documents.
+  bool discard_non_projective_;
+};
 
-      // If there are no more non-projective arcs we are done.
-      if (deepest_arc == -1) return true;
+REGISTER_KERNEL_BUILDER(Name("ProjectivizeFilter").Device(DEVICE_CPU),
+                        ProjectivizeFilter);
 
-      // Lift non-projective arc.
-      int lifted_head = doc->token(doc->token(deepest_arc).head()).head();
-      doc->mutable_token(deepest_arc)->set_head(lifted_head);
-    }
+// Sentence filter doing the work of WellFormedFilter followed by
+// ProjectivizeFilter, parsing each document once. Malformed documents that are
+// kept are output unchanged, since they cannot be projectivized.
+class WellFormedProjectivizeFilter : public DocumentFilter {
+ public:
+  explicit WellFormedProjectivizeFilter(OpKernelConstruction *context)
+      : DocumentFilter(context) {
+    GetTaskContext(context, &task_context_);
+    OP_REQUIRES_OK(context, context->GetAttr("keep_malformed_documents",
+                                             &keep_malformed_));
+    OP_REQUIRES_OK(context, context->GetAttr("discard_non_projective",
+                                             &discard_non_projective_));
   }
 
  private:
+  bool Filter(Sentence *document, bool *modified) const override {
+    if (!IsWellFormed(*document)) return keep_malformed_;
+    return Projectivize(discard_non_projective_, document, modified);
+  }
+
   // Task context used to configure this op.
   TaskContext task_context_;
 
+  bool keep_malformed_;
+
   // Whether or not to throw away non-projective documents.
   bool discard_non_projective_;
 };
 
-REGISTER_KERNEL_BUILDER(Name("ProjectivizeFilter").Device(DEVICE_CPU),
-                        ProjectivizeFilter);
+REGISTER_KERNEL_BUILDER(
+    Name("WellFormedProjectivizeFilter").Device(DEVICE_CPU),
+    WellFormedProjectivizeFilter);
 
 }  // namespace syntaxnet
@@ -0,0 +1,184 @@
+# coding=utf-8
+# Copyright 2016 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests for the document filter ops."""
+
+
+# disable=no-name-in-module,unused-import,g-bad-import-order,maybe-no-member
+import os.path
+
+import tensorflow as tf
+
+import syntaxnet.load_parser_ops
+
+from tensorflow.python.framework import test_util
+from tensorflow.python.platform import googletest
+
+from syntaxnet import sentence_pb2
+from syntaxnet import task_spec_pb2
+from syntaxnet.ops import gen_parser_ops
+
+FLAGS = tf.app.flags.FLAGS
+
+
+class DocumentFiltersTest(test_util.TensorFlowTestCase):
+
+  def setUp(self):
+    if not hasattr(FLAGS, 'test_srcdir'):
+      FLAGS.test_srcdir = ''
+    if not hasattr(FLAGS, 'test_tmpdir'):
+      FLAGS.test_tmpdir = tf.test.get_temp_dir()
+    self.context_file = os.path.join(FLAGS.test_tmpdir, 'context.pbtxt')
+    with open(self.context_file, 'w') as f:
+      f.write('')
+
+    # A projective tree, a non-projective tree whose arc from 'c' to 'a'
+    # crosses the arc from 'd' to 'b', and a tree with a cycle.
+    self.documents = [self.MakeDocument([1, -1, 1]),
+                      self.MakeDocument([2, 3, -1, 2]),
+                      self.MakeDocument([1, 0, -1])]
+
+  def MakeDocument(self, heads):
+    document = sentence_pb2.Sentence()
+    for i, head in enumerate(heads):
+      token = document.token.add()
+      token.word = chr(ord('a') + i)
+      token.start = 2 * i
+      token.end = 2 * i
+      token.head = head
+    document.text = ' '.join(token.word for token in document.token)
+    return document
+
+  def Filter(self, op, **kwargs):
+    with self.test_session() as sess:
+      filtered = sess.run(op(
+          [d.SerializeToString() for d in self.documents],
+          task_context=self.context_file, **kwargs))
+    heads = []
+    for serialized in filtered:
+      document = sentence_pb2.Sentence()
+      document.ParseFromString(serialized)
+      heads.append([token.head for token in document.token])
+    return heads
+
+  def testWellFormedFilter(self):
+    self.assertEqual(self.Filter(gen_parser_ops.well_formed_filter),
+                     [[1, -1, 1], [2, 3, -1, 2]])
+    self.assertEqual(
+        len(self.Filter(gen_parser_ops.well_formed_filter,
+                        keep_malformed_documents=True)), 3)
+
+  def testProjectivizeFilter(self):
+    del self.documents[2]
+    self.assertEqual(self.Filter(gen_parser_ops.projectivize_filter),
+                     [[1, -1, 1], [2, 2, -1, 2]])
+    self.assertEqual(self.Filter(gen_parser_ops.projectivize_filter,
+                                 discard_non_projective=True),
+                     [[1, -1, 1]])
+
+  def testWellFormedProjectivizeFilter(self):
+    op = gen_parser_ops.well_formed_projectivize_filter
+    self.assertEqual(self.Filter(op), [[1, -1, 1], [2, 2, -1, 2]])
+    self.assertEqual(self.Filter(op, discard_non_projective=True),
+                     [[1, -1, 1]])
+    self.assertEqual(self.Filter(op, keep_malformed_documents=True),
+                     [[1, -1, 1], [2, 2, -1, 2], [1, 0, -1]])
+
+  def testUnchangedDocumentsAreOutputAsInput(self):
+    with self.test_session() as sess:
+      serialized = self.documents[0].SerializeToString()
+      filtered = sess.run(gen_parser_ops.well_formed_projectivize_filter(
+          [serialized], task_context=self.context_file))
+    self.assertEqual(list(filtered), [serialized])
+
+
+  def testBatchHandlePipeline(self):
+    corpus_file = os.path.join(FLAGS.test_tmpdir, 'documents.conll')
+    output_file = os.path.join(FLAGS.test_tmpdir, 'filtered.conll')
+    with open(corpus_file, 'w') as f:
+      for document in self.documents:
+        for i, token in enumerate(document.token):
+          f.write('%d\t%s\t_\t_\tNN\t_\t%d\tdep\t_\t_\n' %
+                  (i + 1, token.word, token.head + 1))
+        f.write('\n')
+    context = task_spec_pb2.TaskSpec()
+    for name, path in (('documents', corpus_file), ('filtered', output_file)):
+      inp = context.input.add()
+      inp.name = name
+      inp.record_format.append('conll-sentence')
+      inp.part.add().file_pattern = path
+    with open(self.context_file, 'w') as f:
+      f.write(str(context))
+
+    with self.test_session() as sess:
+      source, last = gen_parser_ops.document_source(
+          self.context_file, batch_size=2, batch_handle=True)
+      sink = gen_parser_ops.document_sink(
+          gen_parser_ops.well_formed_projectivize_filter(
+              source, task_context=self.context_file, batch_handle=True),
+          task_context=self.context_file, corpus_name='filtered',
+          batch_handle=True)
+      while True:
+        tf_last, _ = sess.run([last, sink])
+        if tf_last:
+          break
+
+    with self.test_session() as sess:
+      documents, _ = gen_parser_ops.document_source(
+          self.context_file, corpus_name='filtered', batch_size=10)
+      heads = []
+      for serialized in sess.run(documents):
+        document = sentence_pb2.Sentence()
+        document.ParseFromString(serialized)
+        heads.append([token.head for token in document.token])
+    self.assertEqual(heads, [[1, -1, 1], [2, 2, -1, 2]])
+
+  def testShardedAsynchronousSink(self):
+    output_file = os.path.join(FLAGS.test_tmpdir, 'sharded.conll')
+    context = task_spec_pb2.TaskSpec()
+    inp = context.input.add()
+    inp.name = 'sharded'
+    inp.record_format.append('conll-sentence')
+    inp.part.add().file_pattern = output_file
+    with open(self.context_file, 'w') as f:
+      f.write(str(context))
+
+    # Writes one document per step. Closing the session deletes the sink,
+    # which waits for its writer threads.
+    graph = tf.Graph()
+    with graph.as_default():
+      documents = tf.placeholder(tf.string, [None])
+      sink = gen_parser_ops.document_sink(
+          documents, task_context=self.context_file, corpus_name='sharded',
+          num_shards=2, writer_queue_size=2)
+    sess = tf.Session(graph=graph)
+    for document in self.documents:
+      sess.run(sink, feed_dict={documents: [document.SerializeToString()]})
+    sess.close()
+    del sess
+
+    # The batches went to the shards in turn.
+    def ReadHeads(path):
+      with open(path) as f:
+        return [[int(line.split('\t')[6]) - 1 for line in block.split('\n')]
+                for block in f.read().strip().split('\n\n')]
+
+    self.assertEqual(ReadHeads(output_file + '-00000-of-00002'),
+                     [[1, -1, 1], [1, 0, -1]])
+    self.assertEqual(ReadHeads(output_file + '-00001-of-00002'),
+                     [[2, 3, -1, 2]])
+
+if __name__ == '__main__':
+  googletest.main()
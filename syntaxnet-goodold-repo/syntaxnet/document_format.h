@@ -26,6 +26,7 @@ limitations under the License.
 #include "syntaxnet/sentence.pb.h"
 #include "syntaxnet/task_context.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
+#include "tensorflow/core/platform/protobuf.h"
 
 namespace syntaxnet {
 
@@ -33,6 +34,11 @@ namespace syntaxnet {
 // more documents. The record format is used for selecting the document format
 // component. A document format component can be registered with the
 // REGISTER_DOCUMENT_FORMAT macro.
+//
+// Converted documents are allocated on the heap and owned by the caller, or,
+// if an arena is set, on the arena, which owns them. Documents of a batch that
+// are all dropped at once are then freed at once, instead of one allocation
+// per document and token.
 class DocumentFormat : public RegisterableClass<DocumentFormat> {
  public:
   DocumentFormat() {}
@@ -53,7 +59,27 @@ class DocumentFormat : public RegisterableClass<DocumentFormat> {
   virtual void ConvertToString(const Sentence &document,
                                string *key, string *value) = 0;
 
+  // Sets the arena of the documents converted next, or allocates them on the
+  // heap again if the arena is null. The arena is not owned.
+  void set_arena(tensorflow::protobuf::Arena *arena) { arena_ = arena; }
+  tensorflow::protobuf::Arena *arena() const { return arena_; }
+
+ protected:
+  // Returns a new document, allocated on the arena if one is set.
+  Sentence *NewDocument() {
+    return tensorflow::protobuf::Arena::CreateMessage<Sentence>(arena_);
+  }
+
+  // Deletes a document returned by NewDocument() that was not output, unless
+  // it is owned by the arena.
+  void DeleteDocument(Sentence *document) {
+    if (arena_ == nullptr) delete document;
+  }
+
  private:
+  // Arena of the converted documents, or null to allocate them on the heap.
+  tensorflow::protobuf::Arena *arena_ = nullptr;
+
   TF_DISALLOW_COPY_AND_ASSIGN(DocumentFormat);
 };
 
@@ -0,0 +1,80 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/document_queue.h"
+
+#include <unordered_map>
+#include <utility>
+
+#include "syntaxnet/task_context.h"
+
+namespace syntaxnet {
+namespace {
+
+// Registry of all document queues, indexed by name.
+typedef std::unordered_map<string, DocumentQueue *> DocumentQueueMap;
+
+DocumentQueueMap *document_queue_map() {
+  static DocumentQueueMap *queues = new DocumentQueueMap;
+  return queues;
+}
+
+mutex document_queue_map_mutex(tensorflow::LINKER_INITIALIZED);
+
+}  // namespace
+
+const char DocumentQueue::kRecordFormat[] = "sentence-queue";
+
+DocumentQueue *DocumentQueue::Get(const string &name) {
+  mutex_lock l(document_queue_map_mutex);
+  DocumentQueue *&queue = (*document_queue_map())[name];
+  if (queue == nullptr) queue = new DocumentQueue();
+  return queue;
+}
+
+bool DocumentQueue::IsQueueInput(const TaskInput &input) {
+  return input.record_format_size() == 1 &&
+         input.record_format(0) == kRecordFormat;
+}
+
+DocumentQueue *DocumentQueue::ForInput(const TaskInput &input) {
+  CHECK(IsQueueInput(input)) << "Not a document queue: " << input.DebugString();
+  return Get(TaskContext::InputFile(input));
+}
+
+void DocumentQueue::Push(Sentence *document) {
+  Entry entry;
+  entry.document.reset(document);
+  if (document->has_trace_id()) {
+    entry.wait.reset(new SentenceSpan("queue_wait", *document));
+  }
+  mutex_lock l(mu_);
+  documents_.push_back(std::move(entry));
+}
+
+Sentence *DocumentQueue::Pop() {
+  mutex_lock l(mu_);
+  if (documents_.empty()) return nullptr;
+  Sentence *document = documents_.front().document.release();
+  documents_.pop_front();
+  return document;
+}
+
+int DocumentQueue::size() const {
+  mutex_lock l(mu_);
+  return documents_.size();
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,86 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// In-memory document queues for chaining readers within one process.
+
+#ifndef SYNTAXNET_DOCUMENT_QUEUE_H_
+#define SYNTAXNET_DOCUMENT_QUEUE_H_
+
+#include <deque>
+#include <memory>
+#include <string>
+
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/sentence_tracing.h"
+#include "syntaxnet/task_spec.pb.h"
+#include "syntaxnet/utils.h"
+
+namespace syntaxnet {
+
+// A named, thread-safe FIFO of documents. A task input with the record format
+// "sentence-queue" refers to the queue named by its file pattern, so a
+// DocumentSink writing to such an input hands its documents directly to the
+// SentenceBatch or DocumentSource reading from it, without converting them to
+// and from a text format. This is used to run e.g. the tagger and the parser
+// in a single process.
+class DocumentQueue {
+ public:
+  // Record format of task inputs backed by a document queue.
+  static const char kRecordFormat[];
+
+  // Returns the queue with the given name, creating it if necessary. Queues are
+  // never deleted, since readers and writers can come and go independently.
+  static DocumentQueue *Get(const string &name);
+
+  // Returns true if the task input refers to a document queue.
+  static bool IsQueueInput(const TaskInput &input);
+
+  // Returns the queue the task input refers to. The input must be a queue
+  // input.
+  static DocumentQueue *ForInput(const TaskInput &input);
+
+  // Appends a document to the queue. Takes ownership of the document. The
+  // time a traced document waits in the queue is recorded as a "queue_wait"
+  // span.
+  void Push(Sentence *document);
+
+  // Removes and returns the document at the front of the queue, or nullptr if
+  // the queue is empty. The caller takes ownership of the document.
+  Sentence *Pop();
+
+  // Returns the number of queued documents.
+  int size() const;
+
+ private:
+  DocumentQueue() {}
+
+  // Mutex guarding the queued documents.
+  mutable mutex mu_;
+
+  // A queued document, and the span of its wait if it is traced.
+  struct Entry {
+    std::unique_ptr<Sentence> document;
+    std::unique_ptr<SentenceSpan> wait;
+  };
+
+  // Queued documents, oldest first.
+  std::deque<Entry> documents_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(DocumentQueue);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_DOCUMENT_QUEUE_H_
@@ -0,0 +1,62 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/document_queue.h"
+
+#include <memory>
+
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/task_spec.pb.h"
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+namespace syntaxnet {
+
+TEST(DocumentQueueTest, PopsInPushOrder) {
+  DocumentQueue *queue = DocumentQueue::Get("push-order");
+  for (const string &docid : {"a", "b", "c"}) {
+    Sentence *document = new Sentence();
+    document->set_docid(docid);
+    queue->Push(document);
+  }
+  EXPECT_EQ(3, queue->size());
+  for (const string &docid : {"a", "b", "c"}) {
+    std::unique_ptr<Sentence> document(queue->Pop());
+    ASSERT_TRUE(document != nullptr);
+    EXPECT_EQ(docid, document->docid());
+  }
+  EXPECT_TRUE(queue->Pop() == nullptr);
+  EXPECT_EQ(0, queue->size());
+}
+
+TEST(DocumentQueueTest, QueuesAreSharedByName) {
+  EXPECT_EQ(DocumentQueue::Get("shared"), DocumentQueue::Get("shared"));
+  EXPECT_NE(DocumentQueue::Get("shared"), DocumentQueue::Get("other"));
+}
+
+TEST(DocumentQueueTest, RecognizesQueueInputs) {
+  TaskInput input;
+  input.set_name("tagged-queue");
+  input.add_record_format("sentence-queue");
+  input.add_part()->set_file_pattern("tagger-to-parser");
+  EXPECT_TRUE(DocumentQueue::IsQueueInput(input));
+  EXPECT_EQ(DocumentQueue::Get("tagger-to-parser"),
+            DocumentQueue::ForInput(input));
+
+  input.set_record_format(0, "conll-sentence");
+  EXPECT_FALSE(DocumentQueue::IsQueueInput(input));
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,360 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Fused embedding lookups of packed feature groups.
+
+#include <algorithm>
+#include <vector>
+
+#include "syntaxnet/cpu_kernels.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+using tensorflow::DEVICE_CPU;
+using tensorflow::DeviceBase;
+using tensorflow::OpInputList;
+using tensorflow::OpKernel;
+using tensorflow::OpKernelConstruction;
+using tensorflow::OpKernelContext;
+using tensorflow::Shard;
+using tensorflow::Tensor;
+using tensorflow::TensorShape;
+using tensorflow::TensorShapeUtils;
+using tensorflow::errors::InvalidArgument;
+
+namespace syntaxnet {
+namespace {
+
+// Adds weight times an embedding row to sums with the given CPU kernels.
+void AddScaledRow(const CpuKernels &kernels, const float *row, float weight,
+                  int64 size, float *sums) {
+  kernels.add_scaled(row, weight, size, sums);
+}
+
+void AddScaledRow(const CpuKernels &kernels, const Eigen::half *row,
+                  float weight, int64 size, float *sums) {
+  kernels.add_scaled_half(row, weight, size, sums);
+}
+
+}  // namespace
+
+// Sums the embeddings of the packed features of every feature group directly
+// into their slots of the concatenated embedding layer. The embedding matrices
+// hold T, which is converted to float as rows are summed, so that half
+// precision matrices are read at half the memory traffic.
+template <typename T>
+class EmbedFeatures : public OpKernel {
+ public:
+  explicit EmbedFeatures(OpKernelConstruction *context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("feature_size", &feature_size_));
+    OP_REQUIRES_OK(context, context->GetAttr("num_features", &num_features_));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("allow_weights", &allow_weights_));
+    OP_REQUIRES(context,
+                static_cast<int>(num_features_.size()) == feature_size_,
+                InvalidArgument("num_features must have feature_size values"));
+  }
+
+  void Compute(OpKernelContext *context) override {
+    OpInputList indices, ids, weights, matrices;
+    OP_REQUIRES_OK(context, context->input_list("feature_indices", &indices));
+    OP_REQUIRES_OK(context, context->input_list("feature_ids", &ids));
+    OP_REQUIRES_OK(context, context->input_list("feature_weights", &weights));
+    OP_REQUIRES_OK(context,
+                   context->input_list("embedding_matrices", &matrices));
+    const Tensor *batch_size_tensor;
+    OP_REQUIRES_OK(context,
+                   context->input("feature_batch_size", &batch_size_tensor));
+    const int batch_size = batch_size_tensor->scalar<int32>()();
+
+    // Offsets of the feature groups in the output rows.
+    std::vector<int64> offsets(feature_size_);
+    int64 row_size = 0;
+    for (int i = 0; i < feature_size_; ++i) {
+      OP_REQUIRES(context, TensorShapeUtils::IsMatrix(matrices[i].shape()),
+                  InvalidArgument("Embedding matrix ", i, " is not a matrix"));
+      offsets[i] = row_size;
+      row_size += num_features_[i] * matrices[i].dim_size(1);
+    }
+
+    Tensor *output;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({batch_size, row_size}), &output));
+    auto output_matrix = output->matrix<float>();
+    output_matrix.setZero();
+    float *output_data = output_matrix.data();
+    const CpuKernels &kernels = GetCpuKernels();
+
+    for (int i = 0; i < feature_size_; ++i) {
+      const auto group_indices = indices[i].flat<int32>();
+      const auto group_ids = ids[i].flat<int64>();
+      const auto group_weights = weights[i].flat<float>();
+      OP_REQUIRES(context, group_ids.size() == group_indices.size() &&
+                               group_weights.size() == group_indices.size(),
+                  InvalidArgument("Feature group ", i,
+                                  " has inconsistent sizes"));
+      const int num_features = num_features_[i];
+      const int64 num_ids = matrices[i].dim_size(0);
+      const int64 dim = matrices[i].dim_size(1);
+      const T *embeddings = matrices[i].flat<T>().data();
+      for (int j = 0; j < group_indices.size(); ++j) {
+        const int32 index = group_indices(j);
+        const int64 id = group_ids(j);
+        OP_REQUIRES(context, index >= 0 && index < batch_size * num_features,
+                    InvalidArgument("Feature index ", index,
+                                    " out of range in group ", i));
+        OP_REQUIRES(context, id >= 0 && id < num_ids,
+                    InvalidArgument("Feature id ", id,
+                                    " out of range in group ", i));
+        const float weight = allow_weights_ ? group_weights(j) : 1.0f;
+        const T *embedding = embeddings + id * dim;
+        float *slot = output_data + (index / num_features) * row_size +
+                      offsets[i] + (index % num_features) * dim;
+        AddScaledRow(kernels, embedding, weight, dim, slot);
+      }
+    }
+  }
+
+ private:
+  // Number of feature groups.
+  int feature_size_;
+
+  // Number of features of each feature group.
+  std::vector<int32> num_features_;
+
+  // Whether embeddings are scaled by the feature weights.
+  bool allow_weights_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("EmbedFeatures").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    EmbedFeatures<float>);
+REGISTER_KERNEL_BUILDER(
+    Name("EmbedFeatures").Device(DEVICE_CPU).TypeConstraint<Eigen::half>("T"),
+    EmbedFeatures<Eigen::half>);
+
+// Computes the first hidden layer input of the concatenated embeddings of
+// packed features by summing rows of precomputed tables, falling back to
+// multiplying embeddings with the layer weights for ids past the tables.
+class PrecomputedEmbedFeatures : public OpKernel {
+ public:
+  explicit PrecomputedEmbedFeatures(OpKernelConstruction *context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("feature_size", &feature_size_));
+    OP_REQUIRES_OK(context, context->GetAttr("num_features", &num_features_));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("allow_weights", &allow_weights_));
+    OP_REQUIRES(context,
+                static_cast<int>(num_features_.size()) == feature_size_,
+                InvalidArgument("num_features must have feature_size values"));
+  }
+
+  void Compute(OpKernelContext *context) override {
+    OpInputList indices, ids, weights, tables, matrices;
+    OP_REQUIRES_OK(context, context->input_list("feature_indices", &indices));
+    OP_REQUIRES_OK(context, context->input_list("feature_ids", &ids));
+    OP_REQUIRES_OK(context, context->input_list("feature_weights", &weights));
+    OP_REQUIRES_OK(context,
+                   context->input_list("precomputed_tables", &tables));
+    OP_REQUIRES_OK(context,
+                   context->input_list("embedding_matrices", &matrices));
+    const Tensor *layer_weights;
+    OP_REQUIRES_OK(context, context->input("layer_weights", &layer_weights));
+    const Tensor *batch_size_tensor;
+    OP_REQUIRES_OK(context,
+                   context->input("feature_batch_size", &batch_size_tensor));
+    const int batch_size = batch_size_tensor->scalar<int32>()();
+    OP_REQUIRES(context, TensorShapeUtils::IsMatrix(layer_weights->shape()),
+                InvalidArgument("Layer weights are not a matrix"));
+    const int64 hidden_size = layer_weights->dim_size(1);
+    const float *layer_data = layer_weights->flat<float>().data();
+
+    Tensor *output;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({batch_size, hidden_size}), &output));
+    auto output_matrix = output->matrix<float>();
+    output_matrix.setZero();
+    float *output_data = output_matrix.data();
+    const CpuKernels &kernels = GetCpuKernels();
+
+    // Offset of the layer weights of the current feature group.
+    int64 offset = 0;
+    for (int i = 0; i < feature_size_; ++i) {
+      const auto group_indices = indices[i].flat<int32>();
+      const auto group_ids = ids[i].flat<int64>();
+      const auto group_weights = weights[i].flat<float>();
+      OP_REQUIRES(context, group_ids.size() == group_indices.size() &&
+                               group_weights.size() == group_indices.size(),
+                  InvalidArgument("Feature group ", i,
+                                  " has inconsistent sizes"));
+      OP_REQUIRES(context, TensorShapeUtils::IsMatrix(matrices[i].shape()) &&
+                               TensorShapeUtils::IsMatrix(tables[i].shape()) &&
+                               tables[i].dim_size(1) == hidden_size,
+                  InvalidArgument("Bad table or embedding matrix ", i));
+      const int num_features = num_features_[i];
+      const int64 num_ids = matrices[i].dim_size(0);
+      const int64 dim = matrices[i].dim_size(1);
+      const int64 num_rows = tables[i].dim_size(0) / num_features;
+      OP_REQUIRES(context, offset + num_features * dim <=
+                               layer_weights->dim_size(0),
+                  InvalidArgument("Too few layer weights for group ", i));
+      const float *table = tables[i].flat<float>().data();
+      const float *embeddings = matrices[i].flat<float>().data();
+      for (int j = 0; j < group_indices.size(); ++j) {
+        const int32 index = group_indices(j);
+        const int64 id = group_ids(j);
+        OP_REQUIRES(context, index >= 0 && index < batch_size * num_features,
+                    InvalidArgument("Feature index ", index,
+                                    " out of range in group ", i));
+        OP_REQUIRES(context, id >= 0 && id < num_ids,
+                    InvalidArgument("Feature id ", id,
+                                    " out of range in group ", i));
+        const float weight = allow_weights_ ? group_weights(j) : 1.0f;
+        const int slot = index % num_features;
+        float *row = output_data + (index / num_features) * hidden_size;
+        if (id < num_rows) {
+          const float *table_row = table + (id * num_features + slot) *
+                                               hidden_size;
+          kernels.add_scaled(table_row, weight, hidden_size, row);
+        } else {
+          const float *embedding = embeddings + id * dim;
+          const float *slot_weights =
+              layer_data + (offset + slot * dim) * hidden_size;
+          for (int64 d = 0; d < dim; ++d) {
+            const float value = weight * embedding[d];
+            kernels.add_scaled(slot_weights + d * hidden_size, value,
+                               hidden_size, row);
+          }
+        }
+      }
+      offset += num_features * dim;
+    }
+  }
+
+ private:
+  // Number of feature groups.
+  int feature_size_;
+
+  // Number of features of each feature group.
+  std::vector<int32> num_features_;
+
+  // Whether embeddings are scaled by the feature weights.
+  bool allow_weights_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("PrecomputedEmbedFeatures").Device(DEVICE_CPU),
+                        PrecomputedEmbedFeatures);
+
+// Sums the embeddings of the ids of each segment, optionally scaled by their
+// weights, which is what an unsorted segment sum of the weighted rows gathered
+// by the ids computes, without materializing the gathered rows. The entries
+// are bucketed by segment, and the segments are sharded over the worker
+// threads, so that every output row is written by a single thread.
+template <typename T, typename Tid>
+class EmbeddingBag : public OpKernel {
+ public:
+  explicit EmbeddingBag(OpKernelConstruction *context) : OpKernel(context) {
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("allow_weights", &allow_weights_));
+  }
+
+  void Compute(OpKernelContext *context) override {
+    const Tensor &params = context->input(0);
+    const auto indices = context->input(1).flat<int32>();
+    const auto ids = context->input(2).flat<Tid>();
+    const auto weights = context->input(3).flat<float>();
+    const Tensor &num_segments_tensor = context->input(4);
+    OP_REQUIRES(context, TensorShapeUtils::IsMatrix(params.shape()),
+                InvalidArgument("params is not a matrix"));
+    OP_REQUIRES(context,
+                TensorShapeUtils::IsScalar(num_segments_tensor.shape()),
+                InvalidArgument("num_segments is not a scalar"));
+    const int64 num_segments = num_segments_tensor.scalar<int32>()();
+    const int64 n = indices.size();
+    OP_REQUIRES(context, num_segments >= 0,
+                InvalidArgument("num_segments is negative"));
+    OP_REQUIRES(context, ids.size() == n &&
+                             (!allow_weights_ || weights.size() == n),
+                InvalidArgument("indices, ids and weights differ in size"));
+
+    // Entries of segment s are order[begins[s]] to order[begins[s + 1] - 1],
+    // in input order.
+    const int64 num_ids = params.dim_size(0);
+    std::vector<int64> begins(num_segments + 1, 0);
+    for (int64 j = 0; j < n; ++j) {
+      OP_REQUIRES(context, indices(j) >= 0 && indices(j) < num_segments,
+                  InvalidArgument("Segment ", indices(j), " out of range"));
+      OP_REQUIRES(context, ids(j) >= 0 && ids(j) < num_ids,
+                  InvalidArgument("Id ", ids(j), " out of range"));
+      ++begins[indices(j) + 1];
+    }
+    for (int64 s = 0; s < num_segments; ++s) begins[s + 1] += begins[s];
+    std::vector<int64> order(n);
+    std::vector<int64> next(begins.begin(), begins.end() - 1);
+    for (int64 j = 0; j < n; ++j) order[next[indices(j)]++] = j;
+
+    const int64 dim = params.dim_size(1);
+    Tensor *output;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({num_segments, dim}), &output));
+    auto output_matrix = output->matrix<float>();
+    output_matrix.setZero();
+    float *output_data = output_matrix.data();
+    const CpuKernels &kernels = GetCpuKernels();
+    const T *embeddings = params.flat<T>().data();
+    const bool allow_weights = allow_weights_;
+    auto sum = [&](int64 start, int64 limit) {
+      for (int64 s = start; s < limit; ++s) {
+        float *row = output_data + s * dim;
+        for (int64 k = begins[s]; k < begins[s + 1]; ++k) {
+          const int64 j = order[k];
+          const float weight = allow_weights ? weights(j) : 1.0f;
+          const T *embedding = embeddings + ids(j) * dim;
+          AddScaledRow(kernels, embedding, weight, dim, row);
+        }
+      }
+    };
+    const DeviceBase::CpuWorkerThreads &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    const int64 cost_per_segment =
+        std::max<int64>(1, n / std::max<int64>(num_segments, 1)) * dim;
+    Shard(worker_threads.num_threads, worker_threads.workers, num_segments,
+          cost_per_segment, sum);
+  }
+
+ private:
+  // Whether embeddings are scaled by the feature weights.
+  bool allow_weights_;
+};
+
+#define REGISTER_EMBEDDING_BAG(T, Tid)                         \
+  REGISTER_KERNEL_BUILDER(Name("EmbeddingBag")                 \
+                              .Device(DEVICE_CPU)              \
+                              .TypeConstraint<T>("T")          \
+                              .TypeConstraint<Tid>("Tid"),     \
+                          EmbeddingBag<T, Tid>);
+REGISTER_EMBEDDING_BAG(float, int32);
+REGISTER_EMBEDDING_BAG(float, int64);
+REGISTER_EMBEDDING_BAG(Eigen::half, int32);
+REGISTER_EMBEDDING_BAG(Eigen::half, int64);
+#undef REGISTER_EMBEDDING_BAG
+
+}  // namespace syntaxnet
@@ -15,11 +15,17 @@ limitations under the License.
 
 #include "syntaxnet/embedding_feature_extractor.h"
 
+#include <algorithm>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "syntaxnet/feature_extractor.h"
+#include "syntaxnet/feature_profiler.h"
+#include "syntaxnet/mapped_file.h"
 #include "syntaxnet/parser_features.h"
 #include "syntaxnet/task_context.h"
+#include "syntaxnet/task_spec.pb.h"
 #include "syntaxnet/utils.h"
 
 namespace syntaxnet {
@@ -41,9 +47,50 @@ void GenericEmbeddingFeatureExtractor::Setup(TaskContext *context) {
   for (const string &dim : utils::Split(embedding_dims, ';')) {
     embedding_dims_.push_back(utils::ParseUsing<int>(dim, utils::ParseInt32));
   }
+
+  // Profiling of the features is process-wide, and only turned on here.
+  const int profile_period = context->Get("feature_profile_period", 0);
+  if (profile_period > 0) {
+    FeatureProfiler::Get()->set_sample_period(profile_period);
+  }
+
+  if (context->Get(GetParamName("embedding_row_order"), false)) {
+    context->GetInput(RowOrderInputName(), "text", "");
+  }
 }
 
 void GenericEmbeddingFeatureExtractor::Init(TaskContext *context) {
+  embedding_rows_.clear();
+  hot_rows_.clear();
+  if (!context->Get(GetParamName("embedding_row_order"), false)) return;
+  const string filename =
+      TaskContext::InputFile(*context->GetInput(RowOrderInputName()));
+  const MappedFile file(filename);
+  vector<string> lines = utils::Split(file.contents().ToString(), '\n');
+  if (!lines.empty() && lines.back().empty()) lines.pop_back();
+  CHECK_EQ(static_cast<int>(lines.size()), NumEmbeddings())
+      << "Expected a row order for each embedding space in " << filename;
+  embedding_rows_.resize(NumEmbeddings());
+  hot_rows_.resize(NumEmbeddings());
+  for (int i = 0; i < NumEmbeddings(); ++i) {
+    const vector<string> fields = utils::SplitOne(lines[i], '\t');
+    hot_rows_[i] = utils::ParseUsing<int>(fields[0], utils::ParseInt32);
+    CHECK(hot_rows_[i] >= 0 && hot_rows_[i] <= EmbeddingSize(i))
+        << "Invalid number of hot rows of embedding space " << i;
+    if (fields.size() < 2 || fields[1].empty()) continue;
+    const vector<string> ids = utils::Split(fields[1], ' ');
+    CHECK_LE(static_cast<int>(ids.size()), EmbeddingSize(i))
+        << "Too many rows for embedding space " << i;
+    vector<int32> &rows = embedding_rows_[i];
+    rows.assign(ids.size(), -1);
+    for (size_t row = 0; row < ids.size(); ++row) {
+      const int id = utils::ParseUsing<int>(ids[row], utils::ParseInt32);
+      CHECK(id >= 0 && id < static_cast<int>(rows.size()) && rows[id] < 0)
+          << "The row order of embedding space " << i
+          << " is not a permutation of its first " << rows.size() << " ids";
+      rows[id] = row;
+    }
+  }
 }
 
 vector<vector<SparseFeatures>> GenericEmbeddingFeatureExtractor::ConvertExample(
@@ -62,7 +109,7 @@ vector<vector<SparseFeatures>> GenericEmbeddingFeatureExtractor::ConvertExample(
       const int64 id = is_continuous ? FloatFeatureValue(value).id : value;
       const int base = feature_type.base();
       if (id >= 0) {
-        sparse_features[i][base].add_id(id);
+        sparse_features[i][base].add_id(EmbeddingRow(i, id));
         if (is_continuous) {
           sparse_features[i][base].add_weight(FloatFeatureValue(value).weight);
         }
@@ -77,4 +124,171 @@ vector<vector<SparseFeatures>> GenericEmbeddingFeatureExtractor::ConvertExample(
   return sparse_features;
 }
 
+void GenericEmbeddingFeatureExtractor::UpdateExample(
+    SparseFeaturesMemo *memo) const {
+  const vector<FeatureVector> &feature_vectors = memo->values;
+  memo->features.resize(feature_vectors.size());
+  memo->changed.resize(feature_vectors.size());
+  for (size_t i = 0; i < feature_vectors.size(); ++i) {
+    // Collects the ids and weights of each feature in this feature space. All
+    // features are rebuilt if the memo holds none for this space yet.
+    const int num_features = generic_feature_extractor(i).feature_types();
+    vector<SparseFeatures> &sparse_features = memo->features[i];
+    vector<bool> &changed = memo->changed[i];
+    const bool rebuild = static_cast<int>(sparse_features.size()) != num_features;
+    if (rebuild) sparse_features = vector<SparseFeatures>(num_features);
+    changed.assign(num_features, rebuild);
+    memo->ids.resize(num_features);
+    memo->weights.resize(num_features);
+    for (int base = 0; base < num_features; ++base) {
+      memo->ids[base].clear();
+      memo->weights[base].clear();
+    }
+    vector<const FeatureType *> types(num_features, nullptr);
+    for (int j = 0; j < feature_vectors[i].size(); ++j) {
+      const FeatureType &feature_type = *feature_vectors[i].type(j);
+      const FeatureValue value = feature_vectors[i].value(j);
+      const bool is_continuous = feature_type.name().find("continuous") == 0;
+      const int64 id = is_continuous ? FloatFeatureValue(value).id : value;
+      const int base = feature_type.base();
+      if (id >= 0) {
+        types[base] = &feature_type;
+        memo->ids[base].push_back(id);
+        if (is_continuous) {
+          memo->weights[base].push_back(FloatFeatureValue(value).weight);
+        }
+      }
+    }
+
+    // Rebuilds the features whose ids or weights changed. The features hold
+    // the embedding rows of the ids.
+    auto same_row = [this, i](int64 id, int64 row) {
+      return EmbeddingRow(i, id) == row;
+    };
+    for (int base = 0; base < num_features; ++base) {
+      SparseFeatures &features = sparse_features[base];
+      const vector<int64> &ids = memo->ids[base];
+      const vector<float> &weights = memo->weights[base];
+      if (!rebuild && features.id_size() == static_cast<int>(ids.size()) &&
+          features.weight_size() == static_cast<int>(weights.size()) &&
+          std::equal(ids.begin(), ids.end(), features.id().begin(),
+                     same_row) &&
+          std::equal(weights.begin(), weights.end(),
+                     features.weight().begin())) {
+        continue;
+      }
+      changed[base] = true;
+      features.Clear();
+      for (size_t k = 0; k < ids.size(); ++k) {
+        features.add_id(EmbeddingRow(i, ids[k]));
+        if (!weights.empty()) features.add_weight(weights[k]);
+        if (add_strings_) {
+          features.add_description(tensorflow::strings::StrCat(
+              types[base]->name(), "=",
+              types[base]->GetFeatureValueName(ids[k])));
+        }
+      }
+    }
+  }
+}
+
+vector<vector<bool>> ParserEmbeddingFeatureExtractor::InputFeatures() const {
+  vector<vector<bool>> input_features(NumEmbeddings());
+  for (int i = 0; i < NumEmbeddings(); ++i) {
+    for (const ParserFeatureFunction *function :
+         feature_extractor(i).functions()) {
+      vector<FeatureType *> types;
+      function->GetFeatureTypes(&types);
+      input_features[i].insert(input_features[i].end(), types.size(),
+                               IsInputFeature(*function));
+    }
+  }
+  return input_features;
+}
+
+vector<vector<SparseFeatures>>
+ParserEmbeddingFeatureExtractor::ExtractSparseFeaturesReusingInput(
+    const WorkspaceSet &workspaces, const ParserState &state,
+    const vector<vector<bool>> &input_features,
+    const vector<vector<SparseFeatures>> &input_source) const {
+  vector<FeatureVector> feature_vectors(NumEmbeddings());
+  for (int i = 0; i < NumEmbeddings(); ++i) {
+    feature_extractor(i).ExtractNonInputFeatures(workspaces, state,
+                                                 &feature_vectors[i]);
+  }
+  vector<vector<SparseFeatures>> sparse_features =
+      ConvertExample(feature_vectors);
+  for (int i = 0; i < NumEmbeddings(); ++i) {
+    for (size_t base = 0; base < input_features[i].size(); ++base) {
+      if (input_features[i][base]) {
+        sparse_features[i][base] = input_source[i][base];
+      }
+    }
+  }
+  return sparse_features;
+}
+
+int ParserEmbeddingFeatureExtractor::InputLookahead() const {
+  int lookahead = 0;
+  for (int i = 0; i < NumEmbeddings(); ++i) {
+    for (const ParserFeatureFunction *function :
+         feature_extractor(i).functions()) {
+      lookahead = std::max(lookahead, syntaxnet::InputLookahead(*function));
+    }
+  }
+  return lookahead;
+}
+
+namespace {
+
+// Guards the map of shared parser features. Features are created under the
+// lock, but they may use the SharedStore, which has a lock of its own.
+mutex shared_parser_features_mutex(tensorflow::LINKER_INITIALIZED);
+
+// Shared parser features by name.
+std::unordered_map<string, SharedParserFeatures *> *SharedParserFeaturesMap() {
+  static auto *features =
+      new std::unordered_map<string, SharedParserFeatures *>();
+  return features;
+}
+
+}  // namespace
+
+SharedParserFeatures::SharedParserFeatures(const string &name,
+                                           const string &arg_prefix,
+                                           const TaskContext &context)
+    : name_(name), features_(arg_prefix) {
+  *context_.mutable_spec() = context.spec();
+  features_.Setup(&context_);
+  features_.Init(&context_);
+  features_.RequestWorkspaces(&registry_);
+}
+
+const SharedParserFeatures *SharedParserFeatures::Get(const string &arg_prefix,
+                                                      TaskContext *context) {
+  // The task spec holds the FML, the other parameters and the resources that
+  // the features are built from.
+  const string name = tensorflow::strings::StrCat(
+      arg_prefix, "\n", context->spec().SerializeAsString());
+  mutex_lock lock(shared_parser_features_mutex);
+  SharedParserFeatures *&shared = (*SharedParserFeaturesMap())[name];
+  if (shared == nullptr) {
+    shared = new SharedParserFeatures(name, arg_prefix, *context);
+  }
+  ++shared->refcount_;
+  *context->mutable_spec() = shared->context_.spec();
+  return shared;
+}
+
+void SharedParserFeatures::Release(const SharedParserFeatures *features) {
+  if (features == nullptr) return;
+  mutex_lock lock(shared_parser_features_mutex);
+  auto it = SharedParserFeaturesMap()->find(features->name_);
+  CHECK(it != SharedParserFeaturesMap()->end() && it->second == features);
+  if (--it->second->refcount_ == 0) {
+    delete it->second;
+    SharedParserFeaturesMap()->erase(it);
+  }
+}
+
 }  // namespace syntaxnet
@@ -33,6 +33,31 @@ limitations under the License.
 
 namespace syntaxnet {
 
+// Sparse features extracted from the same object over several steps, e.g. from
+// a parser state as it advances. A transition leaves most feature values of a
+// parser state untouched, so the sparse features are updated in place and only
+// rebuilt where the extracted values changed.
+struct SparseFeaturesMemo {
+  // Clears the memo, so that the next update rebuilds all features.
+  void Clear() {
+    features.clear();
+    changed.clear();
+  }
+
+  // Sparse features of the last update, per feature space and feature.
+  vector<vector<SparseFeatures>> features;
+
+  // Whether each feature changed in the last update.
+  vector<vector<bool>> changed;
+
+  // Scratch space for the extracted feature values of each feature space.
+  vector<FeatureVector> values;
+
+  // Scratch space for the ids and weights of the features of a feature space.
+  vector<vector<int64>> ids;
+  vector<vector<float>> weights;
+};
+
 // An EmbeddingFeatureExtractor manages the extraction of features for
 // embedding-based models. It wraps a sequence of underlying classes of feature
 // extractors, along with associated predicate maps. Each class of feature
@@ -44,6 +69,13 @@ namespace syntaxnet {
 //
 // The predicate maps must be initialized before use: they can be loaded using
 // Read() or updated via UpdateMapsForExample.
+//
+// With the <prefix>_embedding_row_order task parameter, the ids of each
+// embedding space are mapped to the rows of a reordered embedding matrix,
+// read from the <prefix>-embedding-row-order input. Line i of that file holds
+// the number of hot rows of embedding space i, a tab, and the ids of its first
+// rows in row order, separated by spaces; ids past the listed ones keep their
+// rows. reorder_embeddings.py writes it along with the reordered model.
 class GenericEmbeddingFeatureExtractor {
  public:
   virtual ~GenericEmbeddingFeatureExtractor() {}
@@ -53,7 +85,8 @@ class GenericEmbeddingFeatureExtractor {
   virtual const string ArgPrefix() const = 0;
 
   // Sets up predicate maps and embedding space names that are common for all
-  // embedding based feature extractors.
+  // embedding based feature extractors. Init() reads the embedding row order,
+  // and is called after the underlying feature extractors are initialized.
   virtual void Setup(TaskContext *context);
   virtual void Init(TaskContext *context);
 
@@ -77,6 +110,13 @@ class GenericEmbeddingFeatureExtractor {
   // Returns the dimensionality of the embedding space.
   int EmbeddingDims(int index) const { return embedding_dims_[index]; }
 
+  // Returns the number of leading rows of the embedding matrix at a given
+  // index that hold the most looked up ids, or 0 if the rows are not
+  // reordered. Scorers may keep these rows apart from the others.
+  int HotRows(int index) const {
+    return hot_rows_.empty() ? 0 : hot_rows_[index];
+  }
+
   // Accessor for embedding dims (dimensions of the embedding spaces).
   const vector<int> &embedding_dims() const { return embedding_dims_; }
 
@@ -102,7 +142,24 @@ class GenericEmbeddingFeatureExtractor {
   vector<vector<SparseFeatures>> ConvertExample(
       const vector<FeatureVector> &feature_vectors) const;
 
+  // Converts extracted features like ConvertExample(), but updates the sparse
+  // features of the memo in place, and flags the features that changed.
+  void UpdateExample(SparseFeaturesMemo *memo) const;
+
+  // Returns the embedding row of an id of the embedding space at a given
+  // index, which is the id itself unless the rows are reordered.
+  int64 EmbeddingRow(int index, int64 id) const {
+    if (embedding_rows_.empty()) return id;
+    const vector<int32> &rows = embedding_rows_[index];
+    return id < static_cast<int64>(rows.size()) ? rows[id] : id;
+  }
+
  private:
+  // Name of the input holding the embedding row order.
+  string RowOrderInputName() const {
+    return tensorflow::strings::StrCat(ArgPrefix(), "-embedding-row-order");
+  }
+
   // Embedding space names for parameter sharing.
   vector<string> embedding_names_;
 
@@ -117,6 +174,11 @@ class GenericEmbeddingFeatureExtractor {
 
   // Whether or not to add string descriptions to converted examples.
   bool add_strings_;
+
+  // Row of each reordered id and number of hot rows of each embedding space,
+  // if the embedding rows are reordered. Empty otherwise.
+  vector<vector<int32>> embedding_rows_;
+  vector<int> hot_rows_;
 };
 
 // Templated, object-specific implementation of the
@@ -141,10 +203,10 @@ class EmbeddingFeatureExtractor : public GenericEmbeddingFeatureExtractor {
 
   // Initializes resources needed by the feature extractors.
   void Init(TaskContext *context) override {
-    GenericEmbeddingFeatureExtractor::Init(context);
     for (auto &feature_extractor : feature_extractors_) {
       feature_extractor.Init(context);
     }
+    GenericEmbeddingFeatureExtractor::Init(context);
   }
 
   // Requests workspaces from the registry. Must be called after Init(), and
@@ -175,6 +237,18 @@ class EmbeddingFeatureExtractor : public GenericEmbeddingFeatureExtractor {
     return ConvertExample(features);
   }
 
+  // Like ExtractSparseFeatures(), but updates the sparse features the memo holds
+  // for a previous step on the same object. Features whose values did not
+  // change keep their SparseFeatures and are flagged as unchanged.
+  void UpdateSparseFeatures(const WorkspaceSet &workspaces, const OBJ &obj,
+                            ARGS... args, SparseFeaturesMemo *memo) const {
+    if (memo->values.size() != feature_extractors_.size()) {
+      memo->values = vector<FeatureVector>(feature_extractors_.size());
+    }
+    ExtractFeatures(workspaces, obj, args..., &memo->values);
+    UpdateExample(memo);
+  }
+
   // Extracts features using the extractors. Note that features must already
   // be initialized to the correct number of feature extractors. No predicate
   // mapping is applied.
@@ -199,17 +273,45 @@ class EmbeddingFeatureExtractor : public GenericEmbeddingFeatureExtractor {
     return feature_extractors_[idx];
   }
 
+  // Provides typed access to the feature extractors.
+  const EXTRACTOR &feature_extractor(int idx) const {
+    DCHECK_LT(idx, feature_extractors_.size());
+    DCHECK_GE(idx, 0);
+    return feature_extractors_[idx];
+  }
+
  private:
   // Templated feature extractor class.
   vector<EXTRACTOR> feature_extractors_;
 };
 
 class ParserEmbeddingFeatureExtractor
-    : public EmbeddingFeatureExtractor<ParserFeatureExtractor, ParserState> {
+    : public EmbeddingFeatureExtractor<CompiledParserFeatureExtractor,
+                                       ParserState> {
  public:
   explicit ParserEmbeddingFeatureExtractor(const string &arg_prefix)
       : arg_prefix_(arg_prefix) {}
 
+  // Returns, for each feature of each embedding space, whether it is an input
+  // feature as defined by IsInputFeature(). Must not be called before Init().
+  vector<vector<bool>> InputFeatures() const;
+
+  // Extracts the sparse features of a parser state like
+  // ExtractSparseFeatures(), except for the input features flagged by
+  // input_features, as returned by InputFeatures(). These only depend on the
+  // sentence and the next input token, and are copied from input_source, the
+  // sparse features of a state of the same sentence with the same next input
+  // token, e.g. the state the parser state was advanced from by an arc.
+  vector<vector<SparseFeatures>> ExtractSparseFeaturesReusingInput(
+      const WorkspaceSet &workspaces, const ParserState &state,
+      const vector<vector<bool>> &input_features,
+      const vector<vector<SparseFeatures>> &input_source) const;
+
+  // Returns how many tokens past the next input token the features read, the
+  // largest InputLookahead() of the features. Must not be called before
+  // Init().
+  int InputLookahead() const;
+
  private:
   const string ArgPrefix() const override { return arg_prefix_; }
 
@@ -217,6 +319,51 @@ class ParserEmbeddingFeatureExtractor
   string arg_prefix_;
 };
 
+// Parser embedding features that are set up and initialized on a task context,
+// along with the registry of the workspaces they requested. All ops of the
+// process that use the same features on the same task context share one
+// instance through the SharedStore, instead of each parsing the FML and
+// building the feature functions again. Like objects of the SharedStore,
+// shared instances are immutable and reference counted.
+class SharedParserFeatures {
+ public:
+  // Returns the shared features for the given prefix and task context,
+  // creating them on first use. The context is replaced by the one the shared
+  // features were set up on, since setting up features may add inputs to it.
+  // The result must be released with Release().
+  static const SharedParserFeatures *Get(const string &arg_prefix,
+                                         TaskContext *context);
+
+  // Releases features acquired by Get(), deleting them when no op uses them
+  // anymore. Does nothing if the features are null.
+  static void Release(const SharedParserFeatures *features);
+
+  // Accessors for the features and their workspace registry.
+  const ParserEmbeddingFeatureExtractor &features() const { return features_; }
+  const WorkspaceRegistry &registry() const { return registry_; }
+
+ private:
+  // Sets up and initializes the features on the given context.
+  SharedParserFeatures(const string &name, const string &arg_prefix,
+                       const TaskContext &context);
+
+  // Name of the features, which identifies their prefix and task context.
+  const string name_;
+
+  // Number of Get() calls not matched by a Release(). Guarded by the lock of
+  // the shared features.
+  int refcount_ = 0;
+
+  // The task context, after setting up the features.
+  TaskContext context_;
+
+  // The initialized features, and the workspaces they requested.
+  ParserEmbeddingFeatureExtractor features_;
+  WorkspaceRegistry registry_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedParserFeatures);
+};
+
 }  // namespace syntaxnet
 
 #endif  // SYNTAXNET_EMBEDDING_FEATURE_EXTRACTOR_H_
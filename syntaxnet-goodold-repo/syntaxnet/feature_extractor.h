@@ -41,6 +41,7 @@ limitations under the License.
 #include <vector>
 
 #include "syntaxnet/feature_extractor.pb.h"
+#include "syntaxnet/feature_profiler.h"
 #include "syntaxnet/feature_types.h"
 #include "syntaxnet/proto_io.h"
 #include "syntaxnet/registry.h"
@@ -561,6 +562,11 @@ class FeatureExtractor : public GenericFeatureExtractor {
   void Init(TaskContext *context) {
     for (Function *function : functions_) function->Init(context);
     this->InitializeFeatureTypes();
+    FeatureProfiler *profiler = FeatureProfiler::Get();
+    profile_ids_.clear();
+    for (Function *function : functions_) {
+      profile_ids_.push_back(profiler->Register(function->name()));
+    }
   }
 
   // Requests workspaces from the registry. Must be called after Init(), and
@@ -575,6 +581,16 @@ class FeatureExtractor : public GenericFeatureExtractor {
   // Preprocesses the object using feature functions for the phase.  Must be
   // called before any calls to ExtractFeatures() on that object and phase.
   void Preprocess(WorkspaceSet *workspaces, OBJ *object) const {
+    FeatureProfiler *profiler = FeatureProfiler::Get();
+    if (profiler->Sample()) {
+      for (int i = 0; i < functions_.size(); ++i) {
+        const int64 start = FeatureProfiler::NowNanos();
+        functions_[i]->Preprocess(workspaces, object);
+        profiler->AddPreprocess(profile_ids_[i],
+                                FeatureProfiler::NowNanos() - start);
+      }
+      return;
+    }
     for (Function *function : functions_) {
       function->Preprocess(workspaces, object);
     }
@@ -587,12 +603,28 @@ class FeatureExtractor : public GenericFeatureExtractor {
                        ARGS... args, FeatureVector *result) const {
     result->reserve(this->feature_types());
 
-    // Extract features.
+    // Extract features, timing each function in sampled calls.
+    FeatureProfiler *profiler = FeatureProfiler::Get();
+    if (profiler->Sample()) {
+      for (int i = 0; i < functions_.size(); ++i) {
+        const int num_values = result->size();
+        const int64 start = FeatureProfiler::NowNanos();
+        functions_[i]->Evaluate(workspaces, object, args..., result);
+        profiler->AddEvaluate(profile_ids_[i],
+                              FeatureProfiler::NowNanos() - start,
+                              result->size() - num_values);
+      }
+      return;
+    }
     for (int i = 0; i < functions_.size(); ++i) {
       functions_[i]->Evaluate(workspaces, object, args..., result);
     }
   }
 
+  // Returns the top-level feature functions. Invalid before Setup() has been
+  // called.
+  const vector<Function *> &functions() const { return functions_; }
+
  private:
   // Creates and initializes all feature functions in the feature extractor.
   void InitializeFeatureFunctions() override {
@@ -614,6 +646,9 @@ class FeatureExtractor : public GenericFeatureExtractor {
   // Top-level feature functions (and variables) in the feature extractor.
   // Owned.
   vector<Function *> functions_;
+
+  // Ids of the top-level feature functions in the feature profiler.
+  vector<int> profile_ids_;
 };
 
 #define REGISTER_FEATURE_FUNCTION(base, name, component) \
@@ -0,0 +1,108 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/feature_profiler.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+
+namespace syntaxnet {
+namespace {
+
+// Returns the mean of a total over a number of calls, or 0 if there are none.
+double Mean(int64 total, int64 calls) {
+  return calls > 0 ? static_cast<double>(total) / calls : 0.0;
+}
+
+}  // namespace
+
+FeatureProfiler *FeatureProfiler::Get() {
+  static FeatureProfiler *profiler = new FeatureProfiler();
+  return profiler;
+}
+
+int FeatureProfiler::Register(const string &name) {
+  mutex_lock lock(mu_);
+  auto it = ids_.find(name);
+  if (it != ids_.end()) return it->second;
+  const int id = costs_.size();
+  costs_.emplace_back();
+  costs_.back().name = name;
+  ids_[name] = id;
+  return id;
+}
+
+void FeatureProfiler::AddPreprocess(int id, int64 nanos) {
+  mutex_lock lock(mu_);
+  Costs &costs = costs_[id];
+  ++costs.preprocess_calls;
+  costs.preprocess_nanos += nanos;
+}
+
+void FeatureProfiler::AddEvaluate(int id, int64 nanos, int num_values) {
+  mutex_lock lock(mu_);
+  Costs &costs = costs_[id];
+  ++costs.evaluate_calls;
+  costs.evaluate_nanos += nanos;
+  costs.num_values += num_values;
+}
+
+string FeatureProfiler::Report() const {
+  mutex_lock lock(mu_);
+  std::vector<const Costs *> sorted;
+  int64 total_nanos = 0;
+  for (const Costs &costs : costs_) {
+    sorted.push_back(&costs);
+    total_nanos += costs.preprocess_nanos + costs.evaluate_nanos;
+  }
+  std::sort(sorted.begin(), sorted.end(), [](const Costs *a, const Costs *b) {
+    return a->preprocess_nanos + a->evaluate_nanos >
+           b->preprocess_nanos + b->evaluate_nanos;
+  });
+
+  // Times are per sampled call, and shares are of the total sampled time.
+  string report = tensorflow::strings::StrCat(
+      "Feature costs, 1 in ", sample_period(), " extractor calls sampled:\n");
+  tensorflow::strings::StrAppend(
+      &report, tensorflow::strings::Printf(
+                   "%7s %12s %12s %12s  %s\n", "share", "preproc ns",
+                   "eval ns", "values/eval", "feature"));
+  for (const Costs *costs : sorted) {
+    const int64 nanos = costs->preprocess_nanos + costs->evaluate_nanos;
+    tensorflow::strings::StrAppend(
+        &report,
+        tensorflow::strings::Printf(
+            "%6.2f%% %12.1f %12.1f %12.2f  %s\n",
+            100.0 * Mean(nanos, total_nanos),
+            Mean(costs->preprocess_nanos, costs->preprocess_calls),
+            Mean(costs->evaluate_nanos, costs->evaluate_calls),
+            Mean(costs->num_values, costs->evaluate_calls),
+            costs->name.c_str()));
+  }
+  return report;
+}
+
+void FeatureProfiler::Clear() {
+  mutex_lock lock(mu_);
+  for (Costs &costs : costs_) {
+    const string name = costs.name;
+    costs = Costs();
+    costs.name = name;
+  }
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,110 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Process-wide cost attribution of the feature expressions of the feature
+// extractors, for telling which features of a feature set are expensive.
+//
+// Profiling is off by default. With a sample period of n, one in n calls of
+// FeatureExtractor::Preprocess() and ExtractFeatures() times each top-level
+// feature function separately and counts the feature values it adds. The
+// times are attributed to the FML expressions of the functions, so that the
+// same expression in several extractors is reported once.
+
+#ifndef SYNTAXNET_FEATURE_PROFILER_H_
+#define SYNTAXNET_FEATURE_PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "syntaxnet/utils.h"
+
+namespace syntaxnet {
+
+class FeatureProfiler {
+ public:
+  // Returns the profiler of this process.
+  static FeatureProfiler *Get();
+
+  // Sets the sample period, or turns profiling off if it is 0.
+  void set_sample_period(int period) { sample_period_ = period; }
+  int sample_period() const { return sample_period_; }
+
+  // Returns true if the calling extractor call should be timed. Cheap when
+  // profiling is off.
+  bool Sample() {
+    const int period = sample_period_.load(std::memory_order_relaxed);
+    return period > 0 &&
+           num_calls_.fetch_add(1, std::memory_order_relaxed) % period == 0;
+  }
+
+  // Returns the id of a feature expression, registering it on first use.
+  int Register(const string &name);
+
+  // Records the time of a sampled Preprocess() call of a feature.
+  void AddPreprocess(int id, int64 nanos);
+
+  // Records the time of a sampled Evaluate() call of a feature and the number
+  // of feature values it added.
+  void AddEvaluate(int id, int64 nanos, int num_values);
+
+  // Returns a report of the sampled times, one line per feature expression
+  // from the most to the least expensive.
+  string Report() const;
+
+  // Clears the sampled times. Registered features are kept.
+  void Clear();
+
+  // Returns the time in nanoseconds on a monotonic clock. Feature functions
+  // typically take well under a microsecond, so Env::NowMicros() is too
+  // coarse to time them.
+  static int64 NowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+ private:
+  // Sampled costs of a feature expression.
+  struct Costs {
+    string name;
+    int64 preprocess_calls = 0;
+    int64 preprocess_nanos = 0;
+    int64 evaluate_calls = 0;
+    int64 evaluate_nanos = 0;
+    int64 num_values = 0;
+  };
+
+  FeatureProfiler() {}
+
+  // Sample period, 0 if profiling is off, and number of sampling decisions.
+  std::atomic<int> sample_period_{0};
+  std::atomic<int64> num_calls_{0};
+
+  // Guards the members below.
+  mutable mutex mu_;
+
+  // Costs of the features by id, and the ids by name.
+  std::vector<Costs> costs_;
+  std::unordered_map<string, int> ids_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FeatureProfiler);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_FEATURE_PROFILER_H_
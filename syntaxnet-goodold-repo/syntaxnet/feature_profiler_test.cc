@@ -0,0 +1,65 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/feature_profiler.h"
+
+#include <string>
+
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+namespace {
+
+TEST(FeatureProfilerTest, SamplesOneInPeriodCalls) {
+  FeatureProfiler *profiler = FeatureProfiler::Get();
+  profiler->set_sample_period(0);
+  EXPECT_FALSE(profiler->Sample());
+
+  profiler->set_sample_period(4);
+  int num_sampled = 0;
+  for (int i = 0; i < 40; ++i) num_sampled += profiler->Sample();
+  EXPECT_EQ(10, num_sampled);
+  profiler->set_sample_period(0);
+}
+
+TEST(FeatureProfilerTest, ReportsMostExpensiveFeaturesFirst) {
+  FeatureProfiler *profiler = FeatureProfiler::Get();
+  const int cheap = profiler->Register("input.tag");
+  const int expensive = profiler->Register("input.char-ngram");
+  EXPECT_EQ(cheap, profiler->Register("input.tag"));
+  EXPECT_NE(cheap, expensive);
+  profiler->AddEvaluate(cheap, 100, 1);
+  profiler->AddPreprocess(expensive, 500);
+  profiler->AddEvaluate(expensive, 300, 6);
+  profiler->AddEvaluate(expensive, 100, 2);
+
+  const string report = profiler->Report();
+  EXPECT_THAT(report, ::testing::HasSubstr(
+                          " 88.89%        500.0        200.0         4.00  "
+                          "input.char-ngram\n"));
+  EXPECT_THAT(report, ::testing::HasSubstr(
+                          " 11.11%          0.0        100.0         1.00  "
+                          "input.tag\n"));
+  EXPECT_LT(report.find("input.char-ngram"), report.find("input.tag"));
+
+  profiler->Clear();
+  EXPECT_THAT(profiler->Report(),
+              ::testing::HasSubstr("  0.00%          0.0          0.0"));
+}
+
+}  // namespace
+}  // namespace syntaxnet
@@ -0,0 +1,392 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "syntaxnet/feed_forward_network.h"
+
+#include <algorithm>
+
+#include "syntaxnet/cpu_kernels.h"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+using tensorflow::DT_FLOAT;
+using tensorflow::OpKernelContext;
+using tensorflow::Tensor;
+using tensorflow::TensorShape;
+using tensorflow::TensorShapeUtils;
+using tensorflow::errors::InvalidArgument;
+
+namespace syntaxnet {
+
+REGISTER_NETWORK_SCORER("feed-forward", FeedForwardNetwork);
+REGISTER_NETWORK_SCORER("packed-feed-forward", PackedFeedForwardNetwork);
+
+tensorflow::Status FeedForwardNetwork::Init(
+    OpKernelContext *context, const ParserEmbeddingFeatureExtractor &features) {
+  TF_RETURN_IF_ERROR(context->input_list("embedding_matrices", &matrices_));
+  TF_RETURN_IF_ERROR(context->input_list("layer_weights", &weights_));
+  TF_RETURN_IF_ERROR(context->input_list("layer_biases", &biases_));
+  if (matrices_.size() != features.NumEmbeddings()) {
+    return InvalidArgument("Expected ", features.NumEmbeddings(),
+                           " embedding matrices, got ", matrices_.size());
+  }
+  if (weights_.size() == 0 || weights_.size() != biases_.size()) {
+    return InvalidArgument("Every layer needs weights and a bias");
+  }
+  embedding_dims_ = features.embedding_dims();
+  embedding_size_ = 0;
+  hot_rows_.assign(matrices_.size(), 0);
+  hot_matrices_.assign(matrices_.size(), Tensor());
+  for (int i = 0; i < matrices_.size(); ++i) {
+    if (!TensorShapeUtils::IsMatrix(matrices_[i].shape()) ||
+        matrices_[i].dim_size(1) != embedding_dims_[i]) {
+      return InvalidArgument("Embedding matrix ", i, " must have ",
+                             embedding_dims_[i], " columns");
+    }
+    embedding_size_ += features.FeatureSize(i) * embedding_dims_[i];
+
+    // Copies the hot rows of reordered matrices into a block of their own.
+    hot_rows_[i] = std::min<int64>(features.HotRows(i),
+                                   matrices_[i].dim_size(0));
+    if (hot_rows_[i] > 0) {
+      TF_RETURN_IF_ERROR(context->allocate_temp(
+          DT_FLOAT, TensorShape({hot_rows_[i], embedding_dims_[i]}),
+          &hot_matrices_[i]));
+      const float *rows = matrices_[i].matrix<float>().data();
+      std::copy(rows, rows + hot_rows_[i] * embedding_dims_[i],
+                hot_matrices_[i].matrix<float>().data());
+    }
+  }
+  int64 input_size = embedding_size_;
+  for (int i = 0; i < weights_.size(); ++i) {
+    if (!TensorShapeUtils::IsMatrix(weights_[i].shape()) ||
+        weights_[i].dim_size(0) != input_size) {
+      return InvalidArgument("Weights of layer ", i, " must have ", input_size,
+                             " rows");
+    }
+    input_size = weights_[i].dim_size(1);
+    if (!TensorShapeUtils::IsVector(biases_[i].shape()) ||
+        biases_[i].dim_size(0) != input_size) {
+      return InvalidArgument("Bias of layer ", i, " must have ", input_size,
+                             " values");
+    }
+  }
+  return tensorflow::Status::OK();
+}
+
+tensorflow::Status FeedForwardNetwork::SplitFirstLayer(
+    OpKernelContext *context, const vector<vector<bool>> &input_features) {
+  if (input_features.size() != embedding_dims_.size()) {
+    return InvalidArgument("Expected ", embedding_dims_.size(),
+                           " feature groups, got ", input_features.size());
+  }
+  input_features_ = input_features;
+  parts_[0].size = parts_[1].size = 0;
+  for (size_t i = 0; i < input_features.size(); ++i) {
+    for (bool input : input_features[i]) {
+      parts_[input].size += embedding_dims_[i];
+    }
+  }
+  if (parts_[0].size + parts_[1].size != embedding_size_) {
+    return InvalidArgument("Expected a flag for each feature");
+  }
+
+  // Gathers the rows of the first layer weights of the features of each part,
+  // in feature order.
+  const int64 hidden = hidden_size();
+  for (Part &part : parts_) {
+    TF_RETURN_IF_ERROR(context->allocate_temp(
+        DT_FLOAT, TensorShape({part.size, hidden}), &part.weights));
+  }
+  const float *rows = weights_[0].matrix<float>().data();
+  int64 offsets[2] = {0, 0};
+  for (size_t i = 0; i < input_features.size(); ++i) {
+    const int64 block = embedding_dims_[i] * hidden;
+    for (bool input : input_features[i]) {
+      std::copy(rows, rows + block,
+                parts_[input].weights.matrix<float>().data() + offsets[input]);
+      offsets[input] += block;
+      rows += block;
+    }
+  }
+  return tensorflow::Status::OK();
+}
+
+tensorflow::Status FeedForwardNetwork::Embed(
+    const vector<vector<SparseFeatures>> &features, float *row) const {
+  return EmbedFeatures(features, nullptr, false, row);
+}
+
+tensorflow::Status FeedForwardNetwork::EmbedPart(
+    const vector<vector<SparseFeatures>> &features, bool input,
+    float *row) const {
+  return EmbedFeatures(features, &input_features_, input, row);
+}
+
+tensorflow::Status FeedForwardNetwork::EmbedFeatures(
+    const vector<vector<SparseFeatures>> &features,
+    const vector<vector<bool>> *mask, bool value, float *row) const {
+  if (features.size() != embedding_dims_.size()) {
+    return InvalidArgument("Expected ", embedding_dims_.size(),
+                           " feature groups, got ", features.size());
+  }
+  std::fill(row, row + (mask == nullptr ? embedding_size_ : part_size(value)),
+            0.0f);
+  const CpuKernels &kernels = GetCpuKernels();
+  float *output = row;
+  for (size_t i = 0; i < features.size(); ++i) {
+    auto matrix = matrices_[i].matrix<float>();
+    const int64 num_ids = matrix.dimension(0);
+    const int dims = embedding_dims_[i];
+    const int64 hot_rows = hot_rows_[i];
+    const float *hot =
+        hot_rows > 0 ? hot_matrices_[i].matrix<float>().data() : nullptr;
+    for (size_t k = 0; k < features[i].size(); ++k) {
+      if (mask != nullptr && (*mask)[i][k] != value) continue;
+      const SparseFeatures &f = features[i][k];
+      if (f.weight_size() != 0 && f.weight_size() != f.id_size()) {
+        return InvalidArgument("Incorrect number of weights: ",
+                               f.DebugString());
+      }
+      for (int j = 0; j < f.id_size(); ++j) {
+        const int64 id = f.id(j);
+        if (id < 0 || id >= num_ids) {
+          return InvalidArgument("Feature id ", id, " of group ", i,
+                                 " is out of range");
+        }
+        const float weight = f.weight_size() > 0 ? f.weight(j) : 1.0f;
+        const float *embedding =
+            (id < hot_rows ? hot : matrix.data()) + id * dims;
+        kernels.add_scaled(embedding, weight, dims, output);
+      }
+      output += dims;
+    }
+  }
+  return tensorflow::Status::OK();
+}
+
+tensorflow::Status FeedForwardNetwork::MultiplyPart(OpKernelContext *context,
+                                                    bool input,
+                                                    const Tensor &part,
+                                                    Tensor *products) const {
+  const int64 batch_size = part.dim_size(0);
+  TF_RETURN_IF_ERROR(context->allocate_temp(
+      DT_FLOAT, TensorShape({batch_size, hidden_size()}), products));
+  auto sums = products->matrix<float>();
+  if (part_size(input) == 0) {
+    sums.setZero();
+    return tensorflow::Status::OK();
+  }
+  const Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1> product_dims = {
+      {Eigen::IndexPair<Eigen::DenseIndex>(1, 0)}};
+  sums.device(context->eigen_device<Eigen::ThreadPoolDevice>()) =
+      part.matrix<float>().contract(parts_[input].weights.matrix<float>(),
+                                    product_dims);
+  return tensorflow::Status::OK();
+}
+
+tensorflow::Status FeedForwardNetwork::ComputeScores(OpKernelContext *context,
+                                                     Tensor *layer) const {
+  for (int i = 0; i < weights_.size(); ++i) {
+    TF_RETURN_IF_ERROR(ComputeLayer(context, i, true, layer));
+  }
+  return tensorflow::Status::OK();
+}
+
+tensorflow::Status FeedForwardNetwork::ComputeScoresFromProducts(
+    OpKernelContext *context, Tensor *layer) const {
+  for (int i = 0; i < weights_.size(); ++i) {
+    TF_RETURN_IF_ERROR(ComputeLayer(context, i, i > 0, layer));
+  }
+  return tensorflow::Status::OK();
+}
+
+tensorflow::Status FeedForwardNetwork::ComputeLayer(OpKernelContext *context,
+                                                    int i, bool multiply,
+                                                    Tensor *layer) const {
+  const int64 batch_size = layer->dim_size(0);
+  const auto &device = context->eigen_device<Eigen::ThreadPoolDevice>();
+  const Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1> product_dims = {
+      {Eigen::IndexPair<Eigen::DenseIndex>(1, 0)}};
+  const int64 output_size = weights_[i].dim_size(1);
+  const Eigen::DSizes<Eigen::DenseIndex, 2> bias_shape(1, output_size);
+  const Eigen::DSizes<Eigen::DenseIndex, 2> broadcast(batch_size, 1);
+  auto bias = biases_[i].vec<float>();
+  Tensor output;
+  if (multiply) {
+    TF_RETURN_IF_ERROR(context->allocate_temp(
+        DT_FLOAT, TensorShape({batch_size, output_size}), &output));
+    auto input = layer->matrix<float>();
+    auto layer_weights = weights_[i].matrix<float>();
+    output.matrix<float>().device(device) =
+        input.contract(layer_weights, product_dims) +
+        bias.reshape(bias_shape).broadcast(broadcast);
+  } else {
+    output = *layer;
+    auto sums = output.matrix<float>();
+    sums.device(device) = sums + bias.reshape(bias_shape).broadcast(broadcast);
+  }
+
+  // All layers but the softmax layer are ReLU layers.
+  auto sums = output.matrix<float>();
+  if (i + 1 < weights_.size()) sums.device(device) = sums.cwiseMax(0.0f);
+  *layer = output;
+  return tensorflow::Status::OK();
+}
+
+static_assert(PackedFeedForwardNetwork::kPanelWidth == kCpuKernelPanelWidth,
+              "Panels must have the width of the panel kernel");
+static_assert(PackedFeedForwardNetwork::kRowBlock <= kCpuKernelMaxPanelRows,
+              "Row blocks must fit the panel kernel");
+
+tensorflow::Status PackedFeedForwardNetwork::Init(
+    OpKernelContext *context, const ParserEmbeddingFeatureExtractor &features) {
+  TF_RETURN_IF_ERROR(FeedForwardNetwork::Init(context, features));
+  layers_.resize(weights_.size());
+  max_padded_size_ = 0;
+  for (int i = 0; i < weights_.size(); ++i) {
+    PackedLayer &layer = layers_[i];
+    auto weights = weights_[i].matrix<float>();
+    layer.input_size = weights.dimension(0);
+    layer.output_size = weights.dimension(1);
+    const int64 num_panels =
+        (layer.output_size + kPanelWidth - 1) / kPanelWidth;
+    layer.padded_size = num_panels * kPanelWidth;
+    layer.panels.assign(layer.input_size * layer.padded_size, 0.0f);
+    for (int64 p = 0; p < num_panels; ++p) {
+      float *panel = layer.panels.data() + p * layer.input_size * kPanelWidth;
+      int64 width = layer.output_size - p * kPanelWidth;
+      if (width > kPanelWidth) width = kPanelWidth;
+      for (int64 k = 0; k < layer.input_size; ++k) {
+        for (int64 j = 0; j < width; ++j) {
+          panel[k * kPanelWidth + j] = weights(k, p * kPanelWidth + j);
+        }
+      }
+    }
+    auto bias = biases_[i].vec<float>();
+    layer.bias.assign(layer.padded_size, 0.0f);
+    std::copy(bias.data(), bias.data() + layer.output_size,
+              layer.bias.begin());
+    max_padded_size_ = std::max(max_padded_size_, layer.padded_size);
+  }
+  return tensorflow::Status::OK();
+}
+
+tensorflow::Status PackedFeedForwardNetwork::ComputeScores(
+    OpKernelContext *context, Tensor *layer) const {
+  return ComputeLayers(context, true, layer);
+}
+
+tensorflow::Status PackedFeedForwardNetwork::ComputeScoresFromProducts(
+    OpKernelContext *context, Tensor *layer) const {
+  return ComputeLayers(context, false, layer);
+}
+
+tensorflow::Status PackedFeedForwardNetwork::ComputeLayers(
+    OpKernelContext *context, bool multiply_first, Tensor *layer) const {
+  const int64 batch_size = layer->dim_size(0);
+  const int64 input_stride = layer->dim_size(1);
+  const int64 expected_size = multiply_first ? layers_[0].input_size
+                                             : layers_[0].output_size;
+  if (input_stride != expected_size) {
+    return InvalidArgument("Expected layer of width ", expected_size, ", got ",
+                           input_stride);
+  }
+  const int64 num_actions = layers_.back().output_size;
+  Tensor scores;
+  TF_RETURN_IF_ERROR(context->allocate_temp(
+      DT_FLOAT, TensorShape({batch_size, num_actions}), &scores));
+  const float *inputs = layer->matrix<float>().data();
+  float *outputs = scores.matrix<float>().data();
+  auto compute = [&](int64 start, int64 limit) {
+    std::vector<float> scratch(2 * kRowBlock * max_padded_size_);
+    for (int64 block = start; block < limit; ++block) {
+      const int64 row = block * kRowBlock;
+      const int num_rows =
+          batch_size - row < kRowBlock ? batch_size - row : kRowBlock;
+      ComputeRowBlock(inputs + row * input_stride, input_stride, num_rows,
+                      multiply_first, scratch.data(),
+                      outputs + row * num_actions);
+    }
+  };
+  int64 block_cost = 0;
+  for (const PackedLayer &packed : layers_) {
+    block_cost += kRowBlock * packed.input_size * packed.padded_size;
+  }
+  const auto &worker_threads =
+      *context->device()->tensorflow_cpu_worker_threads();
+  tensorflow::Shard(worker_threads.num_threads, worker_threads.workers,
+                    (batch_size + kRowBlock - 1) / kRowBlock, block_cost,
+                    compute);
+  *layer = scores;
+  return tensorflow::Status::OK();
+}
+
+void PackedFeedForwardNetwork::ComputeRowBlock(const float *inputs,
+                                               int64 input_stride,
+                                               int num_rows,
+                                               bool multiply_first,
+                                               float *scratch,
+                                               float *scores) const {
+  float *buffers[2] = {scratch, scratch + kRowBlock * max_padded_size_};
+  const CpuKernels &kernels = GetCpuKernels();
+  const float *input = inputs;
+  for (size_t i = 0; i < layers_.size(); ++i) {
+    const PackedLayer &layer = layers_[i];
+    float *output = buffers[i % 2];
+
+    // All layers but the softmax layer are ReLU layers.
+    const bool relu = i + 1 < layers_.size();
+    if (i > 0 || multiply_first) {
+      float products[kRowBlock * kPanelWidth];
+      for (int64 column = 0; column < layer.padded_size;
+           column += kPanelWidth) {
+        kernels.multiply_panel(input, input_stride, num_rows,
+                               layer.input_size,
+                               layer.panels.data() + column * layer.input_size,
+                               products);
+        for (int r = 0; r < num_rows; ++r) {
+          float *row = output + r * layer.padded_size + column;
+          for (int j = 0; j < kPanelWidth; ++j) {
+            const float sum =
+                products[r * kPanelWidth + j] + layer.bias[column + j];
+            row[j] = relu ? std::max(sum, 0.0f) : sum;
+          }
+        }
+      }
+    } else {
+      // The input already holds the first layer products.
+      for (int r = 0; r < num_rows; ++r) {
+        float *row = output + r * layer.padded_size;
+        for (int64 j = 0; j < layer.output_size; ++j) {
+          const float sum = input[r * input_stride + j] + layer.bias[j];
+          row[j] = relu ? std::max(sum, 0.0f) : sum;
+        }
+      }
+    }
+    input = output;
+    input_stride = layer.padded_size;
+  }
+  const int64 num_actions = layers_.back().output_size;
+  for (int r = 0; r < num_rows; ++r) {
+    std::copy(input + r * input_stride, input + r * input_stride + num_actions,
+              scores + r * num_actions);
+  }
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,191 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// In-kernel evaluation of the feed-forward network built by GreedyParser, the
+// default network scorer of the decoding ops that take all parser transitions
+// of a batch in one step. The parameters are the "embedding_matrices",
+// "layer_weights" and "layer_biases" input lists of the op: one embedding
+// matrix per feature group, then the weights and bias of each ReLU layer
+// followed by those of the softmax layer.
+
+#ifndef SYNTAXNET_FEED_FORWARD_NETWORK_H_
+#define SYNTAXNET_FEED_FORWARD_NETWORK_H_
+
+#include <vector>
+
+#include "syntaxnet/embedding_feature_extractor.h"
+#include "syntaxnet/network_scorer.h"
+#include "syntaxnet/sparse.pb.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace syntaxnet {
+
+// Network scorer for the feed-forward network built by GreedyParser,
+// registered as "feed-forward".
+class FeedForwardNetwork : public NetworkScorer {
+ public:
+  FeedForwardNetwork() {}
+
+  // Reads the network parameters from the inputs of the op, and checks that
+  // they fit the given features and each other.
+  tensorflow::Status Init(
+      tensorflow::OpKernelContext *context,
+      const ParserEmbeddingFeatureExtractor &features) override;
+
+  // NetworkScorer methods, see network_scorer.h.
+  tensorflow::Status Embed(const vector<vector<SparseFeatures>> &features,
+                           float *row) const override;
+  tensorflow::Status ComputeScores(tensorflow::OpKernelContext *context,
+                                   tensorflow::Tensor *layer) const override;
+  int64 embedding_size() const override { return embedding_size_; }
+
+  // The first layer of the network can be split into the parts of the input
+  // and of the other features.
+  bool SupportsParts() const override { return true; }
+  tensorflow::Status SplitFirstLayer(
+      tensorflow::OpKernelContext *context,
+      const vector<vector<bool>> &input_features) override;
+  tensorflow::Status EmbedPart(const vector<vector<SparseFeatures>> &features,
+                               bool input, float *row) const override;
+  tensorflow::Status MultiplyPart(tensorflow::OpKernelContext *context,
+                                  bool input, const tensorflow::Tensor &part,
+                                  tensorflow::Tensor *products) const override;
+  tensorflow::Status ComputeScoresFromProducts(
+      tensorflow::OpKernelContext *context,
+      tensorflow::Tensor *layer) const override;
+  int64 part_size(bool input) const override { return parts_[input].size; }
+  int64 hidden_size() const override { return weights_[0].dim_size(1); }
+
+ protected:
+  // Parameters of the network.
+  tensorflow::OpInputList matrices_;
+  tensorflow::OpInputList weights_;
+  tensorflow::OpInputList biases_;
+
+ private:
+  // A part of the embedding layer after SplitFirstLayer().
+  struct Part {
+    // Width of the part.
+    int64 size = 0;
+
+    // First layer weights of the part, [size, hidden_size()].
+    tensorflow::Tensor weights;
+  };
+
+  // Sums the embeddings of one parser state, of the features whose flag in
+  // the mask is the given value, or of all features if the mask is null.
+  tensorflow::Status EmbedFeatures(
+      const vector<vector<SparseFeatures>> &features,
+      const vector<vector<bool>> *mask, bool value, float *row) const;
+
+  // Replaces the input of layer i with its output. Multiplies the input by
+  // the weights of the layer unless it already holds the products.
+  tensorflow::Status ComputeLayer(tensorflow::OpKernelContext *context, int i,
+                                  bool multiply,
+                                  tensorflow::Tensor *layer) const;
+
+  // Embedding dimension of each feature group, and width of the embedding
+  // layer.
+  std::vector<int> embedding_dims_;
+  int64 embedding_size_ = 0;
+
+  // Number of hot rows of each embedding matrix, see
+  // GenericEmbeddingFeatureExtractor::HotRows(), and a copy of these rows in
+  // a block of their own, so that the rows most features read stay together
+  // in cache while the cold rows are read from the matrix.
+  std::vector<int64> hot_rows_;
+  std::vector<tensorflow::Tensor> hot_matrices_;
+
+  // Flags of the input features, and the other and the input part of the
+  // embedding layer, after SplitFirstLayer().
+  vector<vector<bool>> input_features_;
+  Part parts_[2];
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FeedForwardNetwork);
+};
+
+// Feed-forward network scorer for the small batches of serving, registered as
+// "packed-feed-forward". Init() packs the weights of each layer into panels of
+// kPanelWidth output columns, stored input by input, and the scores of a few
+// rows at a time are computed through all layers in one fused loop, with the
+// bias and the ReLU applied as each panel is done. The panels are multiplied
+// with AVX2 and FMA instructions when the CPU has them, see cpu_kernels.h.
+// Embedding and the split first layer are the same as in FeedForwardNetwork.
+class PackedFeedForwardNetwork : public FeedForwardNetwork {
+ public:
+  PackedFeedForwardNetwork() {}
+
+  // Reads the network parameters and packs the weights.
+  tensorflow::Status Init(
+      tensorflow::OpKernelContext *context,
+      const ParserEmbeddingFeatureExtractor &features) override;
+
+  tensorflow::Status ComputeScores(tensorflow::OpKernelContext *context,
+                                   tensorflow::Tensor *layer) const override;
+  tensorflow::Status ComputeScoresFromProducts(
+      tensorflow::OpKernelContext *context,
+      tensorflow::Tensor *layer) const override;
+
+  // Number of output columns of a panel, the width of an AVX register.
+  static const int kPanelWidth = 8;
+
+  // Number of rows computed together, sharing each load of the weights.
+  static const int kRowBlock = 4;
+
+ private:
+  // Packed weights and bias of a layer.
+  struct PackedLayer {
+    // Widths of the input and the output of the layer, and the output width
+    // rounded up to whole panels.
+    int64 input_size = 0;
+    int64 output_size = 0;
+    int64 padded_size = 0;
+
+    // Panel p holds the weights of output columns [p * kPanelWidth,
+    // (p + 1) * kPanelWidth) for each input in turn, zero-padded.
+    std::vector<float> panels;
+
+    // Bias, zero-padded to padded_size.
+    std::vector<float> bias;
+  };
+
+  // Replaces the input layer with the scores, multiplying it by the first
+  // layer weights unless it already holds the products.
+  tensorflow::Status ComputeLayers(tensorflow::OpKernelContext *context,
+                                   bool multiply_first,
+                                   tensorflow::Tensor *layer) const;
+
+  // Computes the scores of up to kRowBlock rows of the input layer, given
+  // input_stride floats apart, through all layers. The scratch space holds
+  // two blocks of rows of the widest layer.
+  void ComputeRowBlock(const float *inputs, int64 input_stride, int num_rows,
+                       bool multiply_first, float *scratch,
+                       float *scores) const;
+
+  // Packed layers of the network.
+  std::vector<PackedLayer> layers_;
+
+  // Width of the widest padded layer.
+  int64 max_padded_size_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PackedFeedForwardNetwork);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_FEED_FORWARD_NETWORK_H_
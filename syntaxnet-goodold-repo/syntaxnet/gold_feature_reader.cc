@@ -0,0 +1,247 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Reader op streaming shards of precomputed gold features, see
+// gold_features.h.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/gold_features.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/mutex.h"
+
+using tensorflow::DEVICE_CPU;
+using tensorflow::DT_FLOAT;
+using tensorflow::DT_INT32;
+using tensorflow::DT_INT64;
+using tensorflow::DataType;
+using tensorflow::OpKernel;
+using tensorflow::OpKernelConstruction;
+using tensorflow::OpKernelContext;
+using tensorflow::Tensor;
+using tensorflow::TensorShape;
+using tensorflow::errors::InvalidArgument;
+
+namespace syntaxnet {
+
+// Emits batches of the parser states of gold feature shards in the outputs of
+// PackedGoldParseReader. Each epoch reads the shards in a new random order,
+// through a buffer of shuffle_buffer records from which each record of a batch
+// is drawn at random. The last batch of an epoch may be smaller than
+// batch_size, and num_epochs is incremented by the first batch of an epoch.
+class GoldFeatureReader : public OpKernel {
+ public:
+  explicit GoldFeatureReader(OpKernelConstruction *context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("files", &files_));
+    OP_REQUIRES_OK(context, context->GetAttr("feature_size", &feature_size_));
+    OP_REQUIRES_OK(context, context->GetAttr("batch_size", &batch_size_));
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("shuffle_buffer", &shuffle_buffer_));
+    int seed;
+    OP_REQUIRES_OK(context, context->GetAttr("seed", &seed));
+    OP_REQUIRES(context, !files_.empty(),
+                InvalidArgument("No gold feature shards"));
+    OP_REQUIRES(context, batch_size_ > 0,
+                InvalidArgument("batch_size must be positive"));
+    shuffle_buffer_ = std::max(shuffle_buffer_, 1);
+    philox_.reset(new tensorflow::random::PhiloxRandom(seed));
+    random_.reset(new tensorflow::random::SimplePhilox(philox_.get()));
+
+    std::vector<DataType> output_types;
+    output_types.insert(output_types.end(), feature_size_, DT_INT32);
+    output_types.insert(output_types.end(), feature_size_, DT_INT64);
+    output_types.insert(output_types.end(), feature_size_, DT_FLOAT);
+    output_types.push_back(DT_INT32);
+    output_types.push_back(DT_INT32);
+    output_types.push_back(DT_INT32);
+    OP_REQUIRES_OK(context, context->MatchSignature({}, output_types));
+  }
+
+  void Compute(OpKernelContext *context) override {
+    mutex_lock lock(mu_);
+
+    // Draws the records of the batch, starting a new epoch if the last one
+    // ended with the previous batch.
+    batch_.resize(batch_size_);
+    int batch_size = 0;
+    while (batch_size < batch_size_) {
+      if (NextRecord(&batch_[batch_size])) {
+        ++batch_size;
+      } else if (batch_size == 0) {
+        StartEpoch();
+        OP_REQUIRES(context, NextRecord(&batch_[0]),
+                    InvalidArgument("Gold feature shards are empty"));
+        ++batch_size;
+      } else {
+        break;
+      }
+    }
+
+    // Decodes the batch, checking that the feature groups match.
+    if (features_.size() < static_cast<size_t>(batch_size)) {
+      features_.resize(batch_size);
+    }
+    std::vector<int64> num_ids(feature_size_, 0);
+    for (int index = 0; index < batch_size; ++index) {
+      GoldFeatures &features = features_[index];
+      OP_REQUIRES_OK(context, DecodeGoldFeatures(batch_[index], &features));
+      const int num_groups = features.num_features.size();
+      OP_REQUIRES(context, num_groups == feature_size_,
+                  InvalidArgument("Gold features have ", num_groups,
+                                  " feature groups, expected ", feature_size_));
+      if (num_features_.empty()) num_features_ = features.num_features;
+      OP_REQUIRES(context, features.num_features == num_features_,
+                  InvalidArgument("Gold features have inconsistent numbers "
+                                  "of features"));
+      for (int group = 0; group < feature_size_; ++group) {
+        num_ids[group] += features.ids[group].size();
+      }
+    }
+
+    for (int group = 0; group < feature_size_; ++group) {
+      Tensor *indices_t;
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  group, TensorShape({num_ids[group]}),
+                                  &indices_t));
+      Tensor *ids_t;
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  feature_size_ + group,
+                                  TensorShape({num_ids[group]}), &ids_t));
+      Tensor *weights_t;
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  2 * feature_size_ + group,
+                                  TensorShape({num_ids[group]}), &weights_t));
+      auto indices = indices_t->vec<int32>();
+      auto ids = ids_t->vec<int64>();
+      auto weights = weights_t->vec<float>();
+      const int num_features = num_features_[group];
+      int64 c = 0;
+      for (int index = 0; index < batch_size; ++index) {
+        const GoldFeatures &features = features_[index];
+        for (size_t j = 0; j < features.ids[group].size(); ++j) {
+          indices(c) = index * num_features + features.features[group][j];
+          ids(c) = features.ids[group][j];
+          weights(c) = features.weights[group][j];
+          ++c;
+        }
+      }
+    }
+
+    Tensor *batch_size_t;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                3 * feature_size_, TensorShape({}),
+                                &batch_size_t));
+    batch_size_t->scalar<int32>()() = batch_size;
+    Tensor *epochs_t;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                3 * feature_size_ + 1, TensorShape({}),
+                                &epochs_t));
+    epochs_t->scalar<int32>()() = num_epochs_;
+    Tensor *gold_actions_t;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                3 * feature_size_ + 2,
+                                TensorShape({batch_size}), &gold_actions_t));
+    auto gold_actions = gold_actions_t->vec<int32>();
+    for (int index = 0; index < batch_size; ++index) {
+      gold_actions(index) = features_[index].gold_action;
+    }
+  }
+
+ private:
+  // Starts reading the shards again in a new random order.
+  void StartEpoch() {
+    ++num_epochs_;
+    LOG(INFO) << "Starting epoch " << num_epochs_;
+    shard_order_.resize(files_.size());
+    for (size_t i = 0; i < files_.size(); ++i) shard_order_[i] = i;
+    for (int i = shard_order_.size() - 1; i > 0; --i) {
+      std::swap(shard_order_[i], shard_order_[random_->Uniform(i + 1)]);
+    }
+    next_shard_ = 0;
+    shard_.reset();
+  }
+
+  // Moves a random record of the shuffle buffer to *record, after topping up
+  // the buffer from the shards. Returns false once the epoch is exhausted.
+  bool NextRecord(string *record) {
+    while (buffer_.size() < static_cast<size_t>(shuffle_buffer_)) {
+      if (shard_ == nullptr) {
+        if (next_shard_ >= shard_order_.size()) break;
+        shard_.reset(
+            new GoldFeatureShardReader(files_[shard_order_[next_shard_++]]));
+      }
+      buffer_.emplace_back();
+      if (!shard_->Read(&buffer_.back())) {
+        buffer_.pop_back();
+        shard_.reset();
+      }
+    }
+    if (buffer_.empty()) return false;
+    std::swap(buffer_[random_->Uniform(buffer_.size())], buffer_.back());
+    record->swap(buffer_.back());
+    buffer_.pop_back();
+    return true;
+  }
+
+  // Shards to read, number of feature groups and batch size.
+  std::vector<string> files_;
+  int feature_size_ = 0;
+  int batch_size_ = 0;
+
+  // Maximum number of records to draw batches from.
+  int shuffle_buffer_ = 0;
+
+  // Guards the reading state.
+  mutex mu_;
+
+  // Number of epochs started.
+  int num_epochs_ = 0;
+
+  // Order of the shards in the current epoch, the position of the next one to
+  // open, and the reader of the current one, if any.
+  std::vector<int> shard_order_;
+  size_t next_shard_ = 0;
+  std::unique_ptr<GoldFeatureShardReader> shard_;
+
+  // Records read from the shards and not drawn yet.
+  std::vector<string> buffer_;
+
+  // Random generator for the shard order and the draws.
+  std::unique_ptr<tensorflow::random::PhiloxRandom> philox_;
+  std::unique_ptr<tensorflow::random::SimplePhilox> random_;
+
+  // Number of features of each feature group, from the first record.
+  std::vector<int32> num_features_;
+
+  // Scratch records and decoded features of a batch.
+  std::vector<string> batch_;
+  std::vector<GoldFeatures> features_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(GoldFeatureReader);
+};
+
+REGISTER_KERNEL_BUILDER(Name("GoldFeatureReader").Device(DEVICE_CPU),
+                        GoldFeatureReader);
+
+}  // namespace syntaxnet
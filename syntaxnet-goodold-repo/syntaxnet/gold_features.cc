@@ -0,0 +1,157 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/gold_features.h"
+
+#include <string.h>
+
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+
+namespace syntaxnet {
+
+void EncodeGoldFeatures(int gold_action,
+                        const vector<vector<SparseFeatures>> &features,
+                        string *record) {
+  record->clear();
+  tensorflow::core::PutVarint32(record, gold_action);
+  tensorflow::core::PutVarint32(record, features.size());
+  for (const vector<SparseFeatures> &group : features) {
+    tensorflow::core::PutVarint32(record, group.size());
+    for (const SparseFeatures &f : group) {
+      CHECK(f.weight_size() == 0 || f.weight_size() == f.id_size())
+          << "Incorrect number of weights: " << f.DebugString();
+      const bool has_weights = f.weight_size() > 0;
+      tensorflow::core::PutVarint32(record, f.id_size() << 1 | has_weights);
+      for (const uint64 id : f.id()) {
+        tensorflow::core::PutVarint64(record, id);
+      }
+      for (const float weight : f.weight()) {
+        uint32 bits;
+        memcpy(&bits, &weight, sizeof(bits));
+        tensorflow::core::PutFixed32(record, bits);
+      }
+    }
+  }
+}
+
+tensorflow::Status DecodeGoldFeatures(tensorflow::StringPiece record,
+                                      GoldFeatures *features) {
+  uint32 value;
+  uint32 num_groups;
+  if (!tensorflow::core::GetVarint32(&record, &value) ||
+      !tensorflow::core::GetVarint32(&record, &num_groups)) {
+    return tensorflow::errors::DataLoss("Truncated gold features");
+  }
+  features->gold_action = value;
+  features->num_features.resize(num_groups);
+  features->features.resize(num_groups);
+  features->ids.resize(num_groups);
+  features->weights.resize(num_groups);
+  for (uint32 group = 0; group < num_groups; ++group) {
+    uint32 num_features;
+    if (!tensorflow::core::GetVarint32(&record, &num_features)) {
+      return tensorflow::errors::DataLoss("Truncated gold features");
+    }
+    features->num_features[group] = num_features;
+    vector<int32> &feature_indices = features->features[group];
+    vector<int64> &ids = features->ids[group];
+    vector<float> &weights = features->weights[group];
+    feature_indices.clear();
+    ids.clear();
+    weights.clear();
+    for (uint32 k = 0; k < num_features; ++k) {
+      if (!tensorflow::core::GetVarint32(&record, &value)) {
+        return tensorflow::errors::DataLoss("Truncated gold features");
+      }
+      const uint32 num_ids = value >> 1;
+      const bool has_weights = value & 1;
+      for (uint32 j = 0; j < num_ids; ++j) {
+        uint64 id;
+        if (!tensorflow::core::GetVarint64(&record, &id)) {
+          return tensorflow::errors::DataLoss("Truncated gold features");
+        }
+        feature_indices.push_back(k);
+        ids.push_back(id);
+      }
+      if (has_weights) {
+        if (record.size() < num_ids * sizeof(uint32)) {
+          return tensorflow::errors::DataLoss("Truncated gold features");
+        }
+        for (uint32 j = 0; j < num_ids; ++j) {
+          const uint32 bits = tensorflow::core::DecodeFixed32(record.data());
+          float weight;
+          memcpy(&weight, &bits, sizeof(weight));
+          weights.push_back(weight);
+          record.remove_prefix(sizeof(uint32));
+        }
+      } else {
+        weights.insert(weights.end(), num_ids, 1.0f);
+      }
+    }
+  }
+  if (!record.empty()) {
+    return tensorflow::errors::DataLoss("Trailing bytes in gold features");
+  }
+  return tensorflow::Status::OK();
+}
+
+GoldFeatureWriter::GoldFeatureWriter(const string &prefix, int num_shards) {
+  CHECK_GT(num_shards, 0);
+  tensorflow::Env *env = tensorflow::Env::Default();
+  for (int shard = 0; shard < num_shards; ++shard) {
+    filenames_.push_back(tensorflow::strings::Printf(
+        "%s-%05d-of-%05d", prefix.c_str(), shard, num_shards));
+    files_.emplace_back();
+    TF_CHECK_OK(env->NewWritableFile(filenames_.back(), &files_.back()));
+    writers_.emplace_back(
+        new tensorflow::io::RecordWriter(files_.back().get()));
+  }
+}
+
+GoldFeatureWriter::~GoldFeatureWriter() {
+  if (!files_.empty()) Close();
+}
+
+void GoldFeatureWriter::Write(int gold_action,
+                              const vector<vector<SparseFeatures>> &features) {
+  CHECK(!writers_.empty()) << "Writing to closed shards";
+  EncodeGoldFeatures(gold_action, features, &record_);
+  TF_CHECK_OK(writers_[num_records_ % writers_.size()]->WriteRecord(record_));
+  ++num_records_;
+}
+
+void GoldFeatureWriter::Close() {
+  writers_.clear();
+  for (auto &file : files_) TF_CHECK_OK(file->Close());
+  files_.clear();
+}
+
+GoldFeatureShardReader::GoldFeatureShardReader(const string &filename)
+    : filename_(filename) {
+  TF_CHECK_OK(
+      tensorflow::Env::Default()->NewRandomAccessFile(filename, &file_));
+  reader_.reset(new tensorflow::io::RecordReader(file_.get()));
+}
+
+bool GoldFeatureShardReader::Read(string *record) {
+  const tensorflow::Status status = reader_->ReadRecord(&offset_, record);
+  if (tensorflow::errors::IsOutOfRange(status)) return false;
+  CHECK(status.ok()) << "Reading " << filename_ << ": " << status;
+  return true;
+}
+
+}  // namespace syntaxnet
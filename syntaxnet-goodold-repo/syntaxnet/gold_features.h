@@ -0,0 +1,130 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Shards of precomputed gold features for greedy training.
+//
+// The static oracle of a transition system is deterministic, so the features
+// and gold action of every parser state the GoldParseReader visits are the same
+// in every epoch. gold_features_main runs the oracle once over a corpus and
+// writes one record per parser state, round-robin over a number of shards, in
+// the framing of tensorflow::io::RecordWriter. The GoldFeatureReader op then
+// streams the shards in a shuffled order through a shuffle buffer, emitting
+// the outputs of PackedGoldParseReader without any feature extraction.
+//
+// A record holds, as varints unless stated otherwise:
+//   - the gold action,
+//   - the number of feature groups,
+//   - for each feature group, the number of features, followed for each
+//     feature by (number of ids << 1 | has weights), the ids and, if it has
+//     weights, a little-endian float per id.
+
+#ifndef SYNTAXNET_GOLD_FEATURES_H_
+#define SYNTAXNET_GOLD_FEATURES_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/sparse.pb.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace syntaxnet {
+
+// Features and gold action of one parser state, decoded from a record.
+struct GoldFeatures {
+  int32 gold_action = 0;
+
+  // Per feature group, the number of features, and for each id the index of
+  // the feature it belongs to, the id and its weight.
+  vector<int32> num_features;
+  vector<vector<int32>> features;
+  vector<vector<int64>> ids;
+  vector<vector<float>> weights;
+};
+
+// Encodes the gold action and sparse features of a parser state as a record.
+void EncodeGoldFeatures(int gold_action,
+                        const vector<vector<SparseFeatures>> &features,
+                        string *record);
+
+// Decodes a record written by EncodeGoldFeatures(), reusing the vectors of
+// *features.
+tensorflow::Status DecodeGoldFeatures(tensorflow::StringPiece record,
+                                      GoldFeatures *features);
+
+// Writes records round-robin to num_shards files named
+// <prefix>-<shard>-of-<num_shards>.
+class GoldFeatureWriter {
+ public:
+  GoldFeatureWriter(const string &prefix, int num_shards);
+
+  // Closes the shards if they were not closed yet.
+  ~GoldFeatureWriter();
+
+  // Appends the features of a parser state to the next shard.
+  void Write(int gold_action, const vector<vector<SparseFeatures>> &features);
+
+  // Closes all shards.
+  void Close();
+
+  // Returns the names of the shards.
+  const vector<string> &filenames() const { return filenames_; }
+
+  // Returns the number of records written.
+  int64 num_records() const { return num_records_; }
+
+ private:
+  // Shard files and their writers, empty once closed.
+  vector<string> filenames_;
+  vector<std::unique_ptr<tensorflow::WritableFile>> files_;
+  vector<std::unique_ptr<tensorflow::io::RecordWriter>> writers_;
+
+  // Number of records written, which also selects the next shard.
+  int64 num_records_ = 0;
+
+  // Buffer for encoding records.
+  string record_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(GoldFeatureWriter);
+};
+
+// Reads the records of one shard in order.
+class GoldFeatureShardReader {
+ public:
+  explicit GoldFeatureShardReader(const string &filename);
+
+  // Reads the next record into *record. Returns false at the end of the shard.
+  bool Read(string *record);
+
+ private:
+  // Name of the shard, for error messages.
+  string filename_;
+
+  // Shard file and reader, and the offset of the next record.
+  std::unique_ptr<tensorflow::RandomAccessFile> file_;
+  std::unique_ptr<tensorflow::io::RecordReader> reader_;
+  uint64 offset_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(GoldFeatureShardReader);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_GOLD_FEATURES_H_
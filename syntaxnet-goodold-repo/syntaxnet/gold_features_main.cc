@@ -0,0 +1,122 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Runs the static oracle of a transition system once over a corpus and writes
+// the features and gold action of every parser state it visits to shards of
+// gold features, see gold_features.h. The features and transition system are
+// set up from the task context as the GoldParseReader op sets them up, so the
+// GoldFeatureReader op reading the shards emits the same features.
+//
+// Usage: gold_features_main --task_context=<file> --output=<prefix>
+//            [--corpus_name=training-corpus] [--arg_prefix=brain_parser]
+//            [--num_shards=10]
+
+#include <memory>
+#include <string>
+
+#include "syntaxnet/embedding_feature_extractor.h"
+#include "syntaxnet/gold_features.h"
+#include "syntaxnet/parser_state.h"
+#include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/proto_io.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/term_frequency_map.h"
+#include "syntaxnet/utils.h"
+#include "syntaxnet/workspace.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+using syntaxnet::GoldFeatureWriter;
+using syntaxnet::ParserEmbeddingFeatureExtractor;
+using syntaxnet::ParserState;
+using syntaxnet::ParserTransitionSystem;
+using syntaxnet::Sentence;
+using syntaxnet::SharedParserFeatures;
+using syntaxnet::TaskContext;
+using syntaxnet::TermFrequencyMap;
+using syntaxnet::TextReader;
+using syntaxnet::WorkspaceSet;
+
+int main(int argc, char **argv) {
+  string task_context_path;
+  string output;
+  string corpus_name = "training-corpus";
+  string arg_prefix = "brain_parser";
+  int32 num_shards = 10;
+  const bool parsed_flags_ok = tensorflow::ParseFlags(
+      &argc, argv, {tensorflow::Flag("task_context", &task_context_path),
+                    tensorflow::Flag("output", &output),
+                    tensorflow::Flag("corpus_name", &corpus_name),
+                    tensorflow::Flag("arg_prefix", &arg_prefix),
+                    tensorflow::Flag("num_shards", &num_shards)});
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parsed_flags_ok || task_context_path.empty() || output.empty() ||
+      num_shards < 1) {
+    LOG(ERROR) << "Usage: " << argv[0] << " --task_context=<file> "
+               << "--output=<prefix> [--corpus_name=training-corpus] "
+               << "[--arg_prefix=brain_parser] [--num_shards=10]";
+    return 1;
+  }
+
+  TaskContext task_context;
+  string data;
+  TF_CHECK_OK(tensorflow::ReadFileToString(tensorflow::Env::Default(),
+                                           task_context_path, &data));
+  CHECK(tensorflow::protobuf::TextFormat::ParseFromString(
+      data, task_context.mutable_spec()))
+      << "Could not parse task context at " << task_context_path;
+
+  const SharedParserFeatures *shared_features =
+      SharedParserFeatures::Get(arg_prefix, &task_context);
+  const ParserEmbeddingFeatureExtractor &features = shared_features->features();
+  std::unique_ptr<ParserTransitionSystem> transition_system(
+      ParserTransitionSystem::Create(task_context.Get(
+          features.GetParamName("transition_system"), "arc-standard")));
+  transition_system->Setup(&task_context);
+  transition_system->Init(&task_context);
+  TermFrequencyMap label_map;
+  label_map.Load(TaskContext::InputFile(*task_context.GetInput("label-map")), 0,
+                 0);
+
+  TextReader reader(*task_context.GetInput(corpus_name), &task_context);
+  GoldFeatureWriter writer(output, num_shards);
+  WorkspaceSet workspaces;
+  int64 num_sentences = 0;
+  while (true) {
+    std::unique_ptr<Sentence> sentence(reader.Read());
+    if (sentence == nullptr) break;
+    ParserState state(sentence.get(),
+                      transition_system->NewTransitionState(true), &label_map);
+    workspaces.Reset(shared_features->registry());
+    features.Preprocess(&workspaces, &state);
+    while (!transition_system->IsFinalState(state)) {
+      const int gold_action = transition_system->GetNextGoldAction(state);
+      writer.Write(gold_action,
+                   features.ExtractSparseFeatures(workspaces, state));
+      transition_system->PerformAction(gold_action, &state);
+    }
+    ++num_sentences;
+  }
+  writer.Close();
+  SharedParserFeatures::Release(shared_features);
+  LOG(INFO) << "Wrote the gold features of " << writer.num_records()
+            << " parser states of " << num_sentences << " sentences to "
+            << num_shards << " shards at " << output;
+  return 0;
+}
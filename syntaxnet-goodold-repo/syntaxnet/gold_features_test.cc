@@ -0,0 +1,90 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/gold_features.h"
+
+#include <string>
+#include <vector>
+
+#include "syntaxnet/sparse.pb.h"
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+namespace {
+
+// Returns features of two groups, where the first has a weighted feature with
+// two ids and an empty feature, and the second a feature with i as its id.
+vector<vector<SparseFeatures>> MakeFeatures(int i) {
+  vector<vector<SparseFeatures>> features(2);
+  features[0].resize(2);
+  features[0][0].add_id(7);
+  features[0][0].add_weight(0.5);
+  features[0][0].add_id(1ULL << 40);
+  features[0][0].add_weight(0.25);
+  features[1].resize(1);
+  features[1][0].add_id(i);
+  return features;
+}
+
+TEST(GoldFeaturesTest, RecordsRoundTrip) {
+  string record;
+  EncodeGoldFeatures(3, MakeFeatures(5), &record);
+  GoldFeatures features;
+  ASSERT_TRUE(DecodeGoldFeatures(record, &features).ok());
+  EXPECT_EQ(3, features.gold_action);
+  EXPECT_THAT(features.num_features, ::testing::ElementsAre(2, 1));
+  EXPECT_THAT(features.features[0], ::testing::ElementsAre(0, 0));
+  EXPECT_THAT(features.ids[0], ::testing::ElementsAre(7, 1LL << 40));
+  EXPECT_THAT(features.weights[0], ::testing::ElementsAre(0.5, 0.25));
+  EXPECT_THAT(features.features[1], ::testing::ElementsAre(0));
+  EXPECT_THAT(features.ids[1], ::testing::ElementsAre(5));
+  EXPECT_THAT(features.weights[1], ::testing::ElementsAre(1.0));
+
+  // Truncated records are rejected.
+  record.resize(record.size() - 1);
+  EXPECT_FALSE(DecodeGoldFeatures(record, &features).ok());
+}
+
+TEST(GoldFeaturesTest, RecordsAreWrittenRoundRobin) {
+  const string prefix =
+      utils::JoinPath({tensorflow::testing::TmpDir(), "gold-features"});
+  GoldFeatureWriter writer(prefix, 3);
+  for (int i = 0; i < 7; ++i) writer.Write(i, MakeFeatures(i));
+  writer.Close();
+  EXPECT_EQ(7, writer.num_records());
+  ASSERT_EQ(3, writer.filenames().size());
+  EXPECT_EQ(prefix + "-00001-of-00003", writer.filenames()[1]);
+
+  // Shard s holds the records s, s + 3, ...
+  for (int shard = 0; shard < 3; ++shard) {
+    GoldFeatureShardReader reader(writer.filenames()[shard]);
+    string record;
+    GoldFeatures features;
+    for (int i = shard; i < 7; i += 3) {
+      ASSERT_TRUE(reader.Read(&record));
+      ASSERT_TRUE(DecodeGoldFeatures(record, &features).ok());
+      EXPECT_EQ(i, features.gold_action);
+      EXPECT_THAT(features.ids[1], ::testing::ElementsAre(i));
+    }
+    EXPECT_FALSE(reader.Read(&record));
+  }
+}
+
+}  // namespace
+}  // namespace syntaxnet
@@ -0,0 +1,247 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Reader op emitting the gold parser states of whole sentences at once, for
+// networks that score all the steps of a sentence together, like the LSTM
+// tagger of lstm_graph_builder.py.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/base.h"
+#include "syntaxnet/embedding_feature_extractor.h"
+#include "syntaxnet/parser_state.h"
+#include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/sentence_batch.h"
+#include "syntaxnet/shared_store.h"
+#include "syntaxnet/sparse.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/term_frequency_map.h"
+#include "syntaxnet/utils.h"
+#include "syntaxnet/workspace.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+using tensorflow::DEVICE_CPU;
+using tensorflow::DT_INT32;
+using tensorflow::DT_STRING;
+using tensorflow::DataType;
+using tensorflow::OpKernel;
+using tensorflow::OpKernelConstruction;
+using tensorflow::OpKernelContext;
+using tensorflow::Tensor;
+using tensorflow::TensorShape;
+using tensorflow::errors::InvalidArgument;
+
+namespace syntaxnet {
+
+// Runs the static oracle of the transition system over batch_size sentences at
+// a time and emits the features of up to max_length consecutive gold parser
+// states of each, e.g. of every token of a sentence for the tagger. Row
+// b * max_length + t of the features of a group holds step t of batch slot b;
+// the rows of steps past the length of a slot hold no feature ids. A sentence
+// with more than max_length steps continues in the same slot in the next
+// batch. Once the corpus is exhausted, the reader rewinds it and increments
+// num_epochs.
+class GoldSequenceReader : public OpKernel {
+ public:
+  explicit GoldSequenceReader(OpKernelConstruction *context)
+      : OpKernel(context) {
+    string file_path, corpus_name, arg_prefix;
+    OP_REQUIRES_OK(context, context->GetAttr("task_context", &file_path));
+    OP_REQUIRES_OK(context, context->GetAttr("feature_size", &feature_size_));
+    OP_REQUIRES_OK(context, context->GetAttr("batch_size", &batch_size_));
+    OP_REQUIRES_OK(context, context->GetAttr("max_length", &max_length_));
+    OP_REQUIRES_OK(context, context->GetAttr("corpus_name", &corpus_name));
+    OP_REQUIRES_OK(context, context->GetAttr("arg_prefix", &arg_prefix));
+    OP_REQUIRES(context, batch_size_ > 0 && max_length_ > 0,
+                InvalidArgument("batch_size and max_length must be positive"));
+
+    // Reads task context from file.
+    string data;
+    OP_REQUIRES_OK(context, ReadFileToString(tensorflow::Env::Default(),
+                                             file_path, &data));
+    OP_REQUIRES(context,
+                TextFormat::ParseFromString(data, task_context_.mutable_spec()),
+                InvalidArgument("Could not parse task context at ", file_path));
+
+    sentence_batch_.reset(new SentenceBatch(batch_size_, corpus_name));
+    sentence_batch_->Init(&task_context_);
+
+    // Sets up the features and transition system as ParsingReader does.
+    states_.resize(batch_size_);
+    workspaces_.resize(batch_size_);
+    shared_features_ = SharedParserFeatures::Get(arg_prefix, &task_context_);
+    features_ = &shared_features_->features();
+    transition_system_.reset(ParserTransitionSystem::Create(task_context_.Get(
+        features_->GetParamName("transition_system"), "arc-standard")));
+    transition_system_->Setup(&task_context_);
+    transition_system_->Init(&task_context_);
+    string label_map_path =
+        TaskContext::InputFile(*task_context_.GetInput("label-map"));
+    label_map_ = SharedStoreUtils::GetWithDefaultName<TermFrequencyMap>(
+        label_map_path, 0, 0);
+
+    const int required_size = features_->embedding_dims().size();
+    OP_REQUIRES(
+        context, feature_size_ == required_size,
+        InvalidArgument("Task context requires feature_size=", required_size));
+    std::vector<DataType> output_types(feature_size_, DT_STRING);
+    output_types.push_back(DT_INT32);
+    output_types.push_back(DT_INT32);
+    output_types.push_back(DT_INT32);
+    OP_REQUIRES_OK(context, context->MatchSignature({}, output_types));
+  }
+
+  ~GoldSequenceReader() override {
+    states_.clear();
+    SharedStore::Release(label_map_);
+    SharedParserFeatures::Release(shared_features_);
+  }
+
+  void Compute(OpKernelContext *context) override {
+    mutex_lock lock(mu_);
+
+    // Moves slots whose sentences are done to the next sentences, rewinding
+    // the corpus once no slot has a sentence left.
+    for (int i = 0; i < batch_size_; ++i) {
+      if (states_[i] == nullptr ||
+          transition_system_->IsFinalState(*states_[i])) {
+        AdvanceSentence(i);
+      }
+    }
+    if (sentence_batch_->size() == 0) {
+      ++num_epochs_;
+      LOG(INFO) << "Starting epoch " << num_epochs_;
+      sentence_batch_->Rewind();
+      for (int i = 0; i < batch_size_; ++i) AdvanceSentence(i);
+    }
+
+    const int64 num_rows = static_cast<int64>(batch_size_) * max_length_;
+    std::vector<Tensor *> feature_outputs(feature_size_);
+    for (int i = 0; i < feature_size_; ++i) {
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  i, TensorShape({num_rows,
+                                                  features_->FeatureSize(i)}),
+                                  &feature_outputs[i]));
+    }
+    Tensor *epoch_output;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                feature_size_, TensorShape({}), &epoch_output));
+    epoch_output->scalar<int32>()() = num_epochs_;
+    Tensor *actions_output;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                feature_size_ + 1,
+                                TensorShape({batch_size_, max_length_}),
+                                &actions_output));
+    Tensor *lengths_output;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(feature_size_ + 2,
+                                            TensorShape({batch_size_}),
+                                            &lengths_output));
+    auto gold_actions = actions_output->matrix<int32>();
+    auto lengths = lengths_output->vec<int32>();
+    gold_actions.setZero();
+
+    // Slots only touch their own state, workspaces and output rows, so they
+    // advance in parallel. Padding rows keep the empty strings the outputs
+    // are allocated with.
+    const auto &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    tensorflow::Shard(
+        worker_threads.num_threads, worker_threads.workers, batch_size_,
+        kFeatureExtractionCost * max_length_,
+        [this, &feature_outputs, &gold_actions, &lengths](int64 start,
+                                                          int64 limit) {
+          for (int64 i = start; i < limit; ++i) {
+            lengths(i) = 0;
+            ParserState *state = states_[i].get();
+            if (state == nullptr) continue;
+            int t = 0;
+            for (; t < max_length_ && !transition_system_->IsFinalState(*state);
+                 ++t) {
+              const vector<vector<SparseFeatures>> features =
+                  features_->ExtractSparseFeatures(workspaces_[i], *state);
+              for (int k = 0; k < feature_size_; ++k) {
+                auto output = feature_outputs[k]->matrix<string>();
+                for (size_t j = 0; j < features[k].size(); ++j) {
+                  output(i * max_length_ + t, j) =
+                      features[k][j].SerializeAsString();
+                }
+              }
+              const int gold_action =
+                  transition_system_->GetNextGoldAction(*state);
+              gold_actions(i, t) = gold_action;
+              transition_system_->PerformAction(gold_action, state);
+            }
+            lengths(i) = t;
+          }
+        });
+  }
+
+ private:
+  // Rough cost in cycles of extracting the features of one parser state.
+  static const int64 kFeatureExtractionCost = 50000;
+
+  // Reads the next sentence into slot i and creates its parser state, or
+  // leaves the slot empty at the end of the corpus.
+  void AdvanceSentence(int i) {
+    states_[i].reset();
+    if (!sentence_batch_->AdvanceSentence(i)) return;
+    states_[i].reset(new ParserState(
+        sentence_batch_->sentence(i),
+        transition_system_->NewTransitionState(true), label_map_));
+    workspaces_[i].Reset(shared_features_->registry());
+    features_->Preprocess(&workspaces_[i], states_[i].get());
+  }
+
+  // Number of feature groups, sentences per batch and steps per sentence.
+  int feature_size_;
+  int batch_size_;
+  int max_length_;
+
+  // Task context used to configure this op.
+  TaskContext task_context_;
+
+  // Serializes Compute().
+  mutex mu_;
+
+  // Batch of sentences, with the parser state and workspaces of each slot.
+  std::unique_ptr<SentenceBatch> sentence_batch_;
+  std::vector<std::unique_ptr<ParserState>> states_;
+  std::vector<WorkspaceSet> workspaces_;
+
+  // Number of times the corpus has been rewound.
+  int num_epochs_ = 0;
+
+  // Features, transition system and label map, as in ParsingReader.
+  const SharedParserFeatures *shared_features_ = nullptr;
+  const ParserEmbeddingFeatureExtractor *features_ = nullptr;
+  std::unique_ptr<ParserTransitionSystem> transition_system_;
+  const TermFrequencyMap *label_map_ = nullptr;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(GoldSequenceReader);
+};
+
+REGISTER_KERNEL_BUILDER(Name("GoldSequenceReader").Device(DEVICE_CPU),
+                        GoldSequenceReader);
+
+}  // namespace syntaxnet
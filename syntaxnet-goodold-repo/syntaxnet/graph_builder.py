@@ -15,17 +15,60 @@
 
 """Builds parser models."""
 
+import collections
+import os.path
+
+import numpy as np
 import tensorflow as tf
 
+from google.protobuf import text_format
+
 import syntaxnet.load_parser_ops
 
+from tensorflow.python.framework import ops
+from tensorflow.python.framework import random_seed
 from tensorflow.python.ops import control_flow_ops as cf
+from tensorflow.python.ops import gen_array_ops
 from tensorflow.python.ops import state_ops
+from tensorflow.python.platform import gfile
 from tensorflow.python.platform import tf_logging as logging
 
+from syntaxnet import task_spec_pb2
 from syntaxnet.ops import gen_parser_ops
 
 
+# Number of action types of the arc-standard transition system, SHIFT,
+# LEFT_ARC and RIGHT_ARC, as returned by its NumActionTypes().
+ARC_STANDARD_ACTION_TYPES = 3
+
+
+def NumTagActions(task_context, arg_prefix):
+  """Returns the number of tags of a joint tagger-morpher, or 0.
+
+  The actions of the tagger-morpher transition system pair a tag with a
+  morphological analysis, and the tags are the terms of its tag map.
+
+  Args:
+    task_context: path to the task context.
+    arg_prefix: prefix for context parameters.
+
+  Returns:
+    The number of terms in the tag map if the transition system of the task
+    is 'tagger-morpher', and 0 otherwise.
+  """
+  context = task_spec_pb2.TaskSpec()
+  with gfile.FastGFile(task_context) as fin:
+    text_format.Merge(fin.read(), context)
+  parameters = dict((p.name, p.value) for p in context.parameter)
+  if parameters.get(arg_prefix + '_transition_system') != 'tagger-morpher':
+    return 0
+  for resource in context.input:
+    if resource.name == 'tag-map':
+      with gfile.FastGFile(resource.part[0].file_pattern) as fin:
+        return int(fin.readline())
+  raise ValueError('The tagger-morpher needs a tag-map input.')
+
+
 def BatchedSparseToDense(sparse_indices, output_size):
   """Batch compatible sparse to dense conversion.
 
@@ -42,14 +85,23 @@ def BatchedSparseToDense(sparse_indices, output_size):
   return tf.nn.embedding_lookup(eye, sparse_indices)
 
 
+# Features of one feature group as returned by the packed parsing readers:
+# 'indices', 'ids' and 'weights' are as returned by UnpackSparseFeatures, and
+# 'size' is the number of feature entries they index into.
+PackedFeatures = collections.namedtuple('PackedFeatures',
+                                        ['indices', 'ids', 'weights', 'size'])
+
+
 def EmbeddingLookupFeatures(params, sparse_features, allow_weights):
   """Computes embeddings for each entry of sparse features sparse_features.
 
   Args:
-    params: list of 2D tensors containing vector embeddings
+    params: list of 2D tensors containing vector embeddings, in float or half
+      precision. Half precision rows are converted to float as looked up.
     sparse_features: 1D tensor of strings. Each entry is a string encoding of
       dist_belief.SparseFeatures, and represents a variable length list of
-      feature ids, and optionally, corresponding weights values.
+      feature ids, and optionally, corresponding weights values. Can also be a
+      PackedFeatures tuple holding the same features already unpacked.
     allow_weights: boolean to control whether the weights returned from the
       SparseFeatures are used to multiply the embeddings.
 
@@ -62,18 +114,178 @@ def EmbeddingLookupFeatures(params, sparse_features, allow_weights):
   """
   if not isinstance(params, list):
     params = [params]
+  indices, ids, weights, size = _UnpackFeatures(sparse_features, allow_weights)
+  if len(params) == 1:
+    # Gathers, weighs and sums the embeddings in one op.
+    return gen_parser_ops.embedding_bag(params[0], indices, ids, weights, size,
+                                        allow_weights=allow_weights)
   # Lookup embeddings.
-  sparse_features = tf.convert_to_tensor(sparse_features)
-  indices, ids, weights = gen_parser_ops.unpack_sparse_features(sparse_features)
   embeddings = tf.nn.embedding_lookup(params, ids)
+  if embeddings.dtype != tf.float32:
+    embeddings = tf.cast(embeddings, tf.float32)
+  return _SumEmbeddings(embeddings, indices, weights, size, allow_weights)
+
 
+def _UnpackFeatures(sparse_features, allow_weights):
+  """Returns the indices, ids, weights and size of sparse or packed features.
+
+  Unweighted sparse features are unpacked with int32 ids and without weights.
+  """
+  if isinstance(sparse_features, PackedFeatures):
+    return sparse_features
+  sparse_features = tf.convert_to_tensor(sparse_features)
+  indices, ids, weights = gen_parser_ops.unpack_sparse_features(
+      sparse_features,
+      out_type=tf.int64 if allow_weights else tf.int32,
+      with_weights=allow_weights)
+  return indices, ids, weights, tf.size(sparse_features)
+
+
+def _SumEmbeddings(embeddings, indices, weights, size, allow_weights):
+  """Sums the looked up embeddings of each feature entry."""
   if allow_weights:
     # Multiply by weights, reshaping to allow broadcast.
     broadcast_weights_shape = tf.concat(0, [tf.shape(weights), [1]])
     embeddings *= tf.reshape(weights, broadcast_weights_shape)
 
   # Sum embeddings by index.
-  return tf.unsorted_segment_sum(embeddings, indices, tf.size(sparse_features))
+  return tf.unsorted_segment_sum(embeddings, indices, size)
+
+
+def _QuantizationOps():
+  """Loads the quantized ops and kernels, and returns their module."""
+  # pylint: disable=g-import-not-at-top
+  from tensorflow.contrib import quantization
+  from tensorflow.contrib.quantization import load_quantized_ops_so
+  from tensorflow.contrib.quantization.kernels import load_quantized_kernels_so
+  load_quantized_ops_so.Load()
+  load_quantized_kernels_so.Load()
+  return quantization
+
+
+def QuantizeArray(value):
+  """Quantizes a float array into eight bits.
+
+  The range always includes zero, so that zero rows and biases stay exact.
+
+  Args:
+    value: numpy array of floats.
+
+  Returns:
+    A (quantized, min_value, max_value) tuple, where quantized is a uint8
+    array with 0 for min_value and 255 for max_value, as read by Dequantize in
+    its default MIN_COMBINED mode.
+  """
+  min_value = min(float(np.min(value)), 0.0) if value.size else 0.0
+  max_value = max(float(np.max(value)), 0.0) if value.size else 0.0
+  if max_value - min_value < 1e-6:
+    max_value = min_value + 1e-6
+  scale = 255.0 / (max_value - min_value)
+  quantized = np.round((value - min_value) * scale)
+  return np.clip(quantized, 0, 255).astype(np.uint8), min_value, max_value
+
+
+def QuantizedEmbeddingLookupFeatures(params, min_value, max_value,
+                                     sparse_features, allow_weights):
+  """Computes embeddings of sparse features from a quantized matrix.
+
+  Only the looked up rows are dequantized, so the matrix itself stays at one
+  byte per entry.
+
+  Args:
+    params: 2D uint8 tensor of quantized embeddings, as returned by
+      QuantizeArray.
+    min_value: float value of the quantized entries equal to 0.
+    max_value: float value of the quantized entries equal to 255.
+    sparse_features: sparse or packed features, as taken by
+      EmbeddingLookupFeatures.
+    allow_weights: whether the feature weights multiply the embeddings.
+
+  Returns:
+    A float tensor holding the combined embedding of each feature entry.
+  """
+  quantization = _QuantizationOps()
+  indices, ids, weights, size = _UnpackFeatures(sparse_features, allow_weights)
+  embeddings = quantization.dequantize(
+      tf.bitcast(tf.gather(params, ids), tf.quint8), min_value, max_value)
+  return _SumEmbeddings(embeddings, indices, weights, size, allow_weights)
+
+
+@ops.RegisterGradient('EmbedFeatures')
+def _EmbedFeaturesGrad(op, grad):
+  """Returns sparse gradients for the embedding matrices of EmbedFeatures."""
+  feature_size = op.get_attr('feature_size')
+  num_features = op.get_attr('num_features')
+  indices = op.inputs[:feature_size]
+  ids = op.inputs[feature_size:2 * feature_size]
+  weights = op.inputs[2 * feature_size:3 * feature_size]
+  matrices = op.inputs[3 * feature_size:4 * feature_size]
+  matrix_grads = []
+  offset = 0
+  for i in range(feature_size):
+    embedding_size = matrices[i].get_shape()[1].value
+    width = num_features[i] * embedding_size
+    # Gradient of every feature entry, one row per feature slot.
+    slot_grads = tf.reshape(tf.slice(grad, [0, offset], [-1, width]),
+                            [-1, embedding_size])
+    values = tf.gather(slot_grads, indices[i])
+    if op.get_attr('allow_weights'):
+      values *= tf.expand_dims(weights[i], 1)
+    matrix_grads.append(tf.IndexedSlices(values, ids[i],
+                                         tf.shape(matrices[i])))
+    offset += width
+  return [None] * (3 * feature_size) + matrix_grads + [None]
+
+
+@ops.RegisterGradient('EmbeddingBag')
+def _EmbeddingBagGrad(op, grad):
+  """Returns sparse gradients for the embedding matrix of EmbeddingBag."""
+  params, indices, ids, weights, _ = op.inputs
+  values = tf.gather(grad, indices)
+  if op.get_attr('allow_weights'):
+    values *= tf.expand_dims(weights, 1)
+  if params.dtype != tf.float32:
+    values = tf.cast(values, params.dtype)
+  return [tf.IndexedSlices(values, ids, tf.shape(params)), None, None, None,
+          None]
+
+
+def PrecomputeEmbeddingTables(matrices, layer_weights, num_features,
+                              max_ids=0):
+  """Multiplies embeddings with the first layer weights of each feature.
+
+  Args:
+    matrices: list of embedding matrices, one per feature group.
+    layer_weights: [embedding size, hidden layer size] first layer weights,
+      with the rows of the features of each group in the order of the
+      concatenated embedding layer.
+    num_features: number of features in each feature group.
+    max_ids: if positive, only the first max_ids ids of each group, the most
+      frequent ones, get precomputed rows.
+
+  Returns:
+    A list of tables, one per feature group, as taken by
+    PrecomputedEmbedFeatures: row id * num_features[i] + k of table i is the
+    embedding of id times the layer weights of feature k of group i.
+  """
+  tables = []
+  offset = 0
+  hidden_size = layer_weights.get_shape()[1].value
+  for matrix, n in zip(matrices, num_features):
+    num_ids, embedding_size = matrix.get_shape().as_list()
+    rows = min(num_ids, max_ids) if max_ids > 0 else num_ids
+    width = n * embedding_size
+    # Lays out the weights of feature k in columns [k * hidden_size,
+    # (k + 1) * hidden_size) of a single [embedding_size, n * hidden_size]
+    # matrix, so that one matmul computes all features of the group.
+    slot_weights = tf.reshape(tf.slice(layer_weights, [offset, 0], [width, -1]),
+                              [n, embedding_size, hidden_size])
+    slot_weights = tf.reshape(tf.transpose(slot_weights, [1, 0, 2]),
+                              [embedding_size, n * hidden_size])
+    table = tf.matmul(tf.slice(matrix, [0, 0], [rows, -1]), slot_weights)
+    tables.append(tf.reshape(table, [rows * n, hidden_size]))
+    offset += width
+  return tables
 
 
 class GreedyParser(object):
@@ -129,6 +341,11 @@ class GreedyParser(object):
                allow_feature_weights=False,
                only_train='',
                arg_prefix=None,
+               packed_features=False,
+               num_tag_actions=0,
+               factored_arc_actions=False,
+               sparse_cost=True,
+               sparse_averaging=False,
                **unused_kwargs):
     """Initialize the graph builder with parameters defining the network.
 
@@ -162,6 +379,28 @@ class GreedyParser(object):
       only_train: the comma separated set of parameter names to train. If empty,
         all model parameters will be trained.
       arg_prefix: prefix for context parameters.
+      packed_features: whether the greedy readers should return packed feature
+        tensors rather than serialized SparseFeatures protos.
+      num_tag_actions: if positive, each action pairs one of num_tag_actions
+        POS tags with one of num_actions / num_tag_actions morphological
+        analyses, as in the tagger-morpher transition system. The tags and
+        the analyses are then scored by two softmax heads over the same hidden
+        layers, and the score of an action is the sum of the log-probabilities
+        of its tag and its analysis.
+      factored_arc_actions: whether the actions are those of the arc-standard
+        transition system, a SHIFT followed by a LEFT_ARC and a RIGHT_ARC for
+        each label, scored by a softmax head over the action types and one
+        over the labels. The score of an arc is then the sum of the
+        log-probabilities of its type and its label, which takes about half
+        the outputs of a softmax over all actions.
+      sparse_cost: whether the cross entropy is computed from the gold action
+        ids by the sparse softmax cross entropy kernel, rather than from
+        one-hot [batch_size, num_actions] gold distributions.
+      sparse_averaging: whether the moving averages of the embedding matrices
+        are updated lazily. A training step then only updates the averages of
+        the rows it trains, and the other rows catch up when the averages are
+        synced by sync_averages, which must run before the averages are read
+        or saved. Requires asynchronous updates.
     """
     self._num_actions = num_actions
     self._num_features = num_features
@@ -181,6 +420,22 @@ class GreedyParser(object):
     self._relu_init = relu_init
     self._softmax_init = softmax_init
     self._arg_prefix = arg_prefix
+    self._packed_features = packed_features
+    self._num_tag_actions = num_tag_actions
+    self._sparse_cost = sparse_cost
+    self._sparse_averaging = sparse_averaging
+    self._factored_arc_actions = factored_arc_actions
+    if num_tag_actions:
+      assert not factored_arc_actions
+      assert num_actions % num_tag_actions == 0
+      self._num_softmax_outputs = (num_tag_actions +
+                                   num_actions // num_tag_actions)
+    elif factored_arc_actions:
+      assert num_actions % 2 == 1
+      self._num_softmax_outputs = (ARC_STANDARD_ACTION_TYPES +
+                                   (num_actions - 1) // 2)
+    else:
+      self._num_softmax_outputs = num_actions
     # Parameters of the network with respect to which training is done.
     self.params = {}
     # Other variables, with respect to which no training is done, but which we
@@ -195,8 +450,46 @@ class GreedyParser(object):
     # Nodes to compute moving averages of parameters, called every train step.
     self._averaging = {}
     self._averaging_decay = averaging_decay
+    # Lazily averaged parameters, as (param, average, synced) variables by
+    # parameter name, see LazyMovingAverage, and the op syncing all their
+    # averages once training has been added.
+    self._lazy_averages = {}
+    self.sync_averages = None
     # Pretrained embeddings that can be used instead of constant initializers.
     self._pretrained_embeddings = {}
+    # Number of ids with precomputed first layer rows in evaluation networks,
+    # 0 for all ids, or None to not precompute them.
+    self._precomputed_ids = None
+    # Largest number of ids of a precomputed feature group, or None for no
+    # limit. Larger groups are embedded and multiplied densely.
+    self._max_precomputed_domain = None
+    # Whether evaluation networks run on eight bit parameters.
+    self._quantized = False
+    # Quantized parameters, as (values, min, max) variables by parameter name,
+    # and all variables needed to restore a quantized model.
+    self.quantized_params = {}
+    self.quantized_variables = {}
+    # Directory of the memory mapped embedding matrices read by evaluation
+    # networks, or None to read them from variables.
+    self._mapped_embeddings_dir = None
+    self.mapped_params = {}
+    # Whether evaluation networks read half precision embedding matrices, and
+    # those matrices by parameter name.
+    self._half_embeddings = False
+    self.half_params = {}
+    # Size from which networks copy their embedding matrices and layer
+    # weights to huge pages, or 0 to read them from the variables, and the
+    # copies by parameter name.
+    self._huge_page_min_bytes = 0
+    self.huge_page_params = {}
+    # Device holding the parameters and running evaluation networks, or None
+    # to leave them to the default placement.
+    self._network_device = None
+    # Arguments of the SyncReplicasOptimizer wrapping the training optimizers,
+    # or None to apply the updates of each replica asynchronously, and the
+    # wrapping optimizer once training has been added.
+    self._sync_replicas = None
+    self.sync_optimizer = None
     # After the following 'with' statement, we'll be able to re-enter the
     # 'params' scope by re-using the self._param_scope member variable. See for
     # instance _AddParam.
@@ -215,7 +508,8 @@ class GreedyParser(object):
                 dtype,
                 name,
                 initializer=None,
-                return_average=False):
+                return_average=False,
+                sparse_average=False):
     """Add a model parameter w.r.t. we expect to compute gradients.
 
     _AddParam creates both regular parameters (usually for training) and
@@ -228,6 +522,8 @@ class GreedyParser(object):
       name: string, name of the parameter in the TF graph
       initializer: optional initializer for the paramter
       return_average: if False, return parameter otherwise return moving average
+      sparse_average: whether the moving average is updated lazily with
+        sparse_averaging, for parameters trained by sparse gradients
 
     Returns:
       parameter or averaged parameter
@@ -241,17 +537,27 @@ class GreedyParser(object):
         param = self.params[name]
         if initializer is not None:
           self.inits[name] = state_ops.init_variable(param, initializer)
-        if self._averaging_decay == 1:
-          logging.info('Using vanilla averaging of parameters.')
-          ema = tf.train.ExponentialMovingAverage(decay=(step / (step + 1.0)),
-                                                  num_updates=None)
+        if sparse_average and self._sparse_averaging:
+          # The averages are updated by _Minimize, from the same decays an
+          # ExponentialMovingAverage would use.
+          average = self._AddVariable(shape, dtype, name + '_avg_var',
+                                      tf.zeros_initializer)
+          synced = self._AddVariable(shape[:1], tf.float64,
+                                     name + '_avg_synced',
+                                     tf.zeros_initializer)
+          self._lazy_averages[name] = (param, average, synced)
         else:
-          ema = tf.train.ExponentialMovingAverage(decay=self._averaging_decay,
-                                                  num_updates=step)
-        self._averaging[name + '_avg_update'] = ema.apply([param])
-        self.variables[name + '_avg_var'] = ema.average(param)
-        self.inits[name + '_avg_init'] = state_ops.init_variable(
-            ema.average(param), tf.zeros_initializer)
+          if self._averaging_decay == 1:
+            logging.info('Using vanilla averaging of parameters.')
+            ema = tf.train.ExponentialMovingAverage(
+                decay=(step / (step + 1.0)), num_updates=None)
+          else:
+            ema = tf.train.ExponentialMovingAverage(
+                decay=self._averaging_decay, num_updates=step)
+          self._averaging[name + '_avg_update'] = ema.apply([param])
+          self.variables[name + '_avg_var'] = ema.average(param)
+          self.inits[name + '_avg_init'] = state_ops.init_variable(
+              ema.average(param), tf.zeros_initializer)
     return (self.variables[name + '_avg_var'] if return_average else
             self.params[name])
 
@@ -290,20 +596,565 @@ class GreedyParser(object):
                     index,
                     return_average=False):
     """Adds an embedding matrix and passes the `features` vector through it."""
-    embedding_matrix = self._AddParam(
-        [num_ids, embedding_size],
-        tf.float32,
-        'embedding_matrix_%d' % index,
-        self._EmbeddingMatrixInitializer(index, embedding_size),
-        return_average=return_average)
+    embedding_matrix = self._AddEmbeddingMatrix(index,
+                                                return_average=return_average)
+    if not isinstance(features, PackedFeatures):
+      features = tf.reshape(features, [-1], name='feature_%d' % index)
     embedding = EmbeddingLookupFeatures(embedding_matrix,
-                                        tf.reshape(features,
-                                                   [-1],
-                                                   name='feature_%d' % index),
+                                        features,
                                         self._allow_feature_weights)
     return tf.reshape(embedding, [-1, num_features * embedding_size])
 
-  def _BuildNetwork(self, feature_endpoints, return_average=False):
+  def _AddEmbeddingMatrix(self, index, return_average=False):
+    """Adds the embedding matrix of a feature group."""
+    shape = [self._num_feature_ids[index], self._embedding_sizes[index]]
+    name = 'embedding_matrix_%d' % index
+    if self._half_embeddings:
+      if self._mapped_embeddings_dir is not None:
+        raise ValueError('Mapped embeddings are float matrices')
+      return self._HugePageParam(self._AddHalfParam(shape, name), name)
+    if self._mapped_embeddings_dir is not None:
+      return self._AddMappedParam(shape, name)
+    return self._HugePageParam(
+        self._AddParam(shape,
+                       tf.float32,
+                       name,
+                       self._EmbeddingMatrixInitializer(index, shape[1]),
+                       return_average=return_average,
+                       sparse_average=True), name)
+
+  def _AddEmbeddingMatrices(self, return_average=False):
+    """Adds the embedding matrices of all feature groups."""
+    return [self._AddEmbeddingMatrix(i, return_average=return_average)
+            for i in range(self._feature_size)]
+
+  def UseMappedEmbeddings(self, embeddings_dir):
+    """Makes evaluation networks read embedding matrices from mapped files.
+
+    Only applies to networks added afterwards. Their embedding matrices are
+    not variables restored by the saver, but constants mapped read-only from
+    the files written by WriteMappedEmbeddings, which lookups read in place.
+    Only the pages of the rows actually looked up are read from disk and
+    become resident, and processes mapping the same files share them.
+
+    Args:
+      embeddings_dir: local directory holding the mapped matrices.
+    """
+    self._mapped_embeddings_dir = embeddings_dir
+
+  def UseHalfEmbeddings(self):
+    """Makes evaluation networks read half precision embedding matrices.
+
+    Only applies to networks added afterwards. Their embedding matrices are
+    the float16 half_params, set from float parameters by AssignHalfParams,
+    and are converted to float row by row as features are embedded, which
+    halves their size and the memory traffic of the lookups. The other
+    parameters stay float. Precomputed, mapped and fused evaluation networks
+    need float embedding matrices.
+    """
+    self._half_embeddings = True
+
+  def UseHugePages(self, min_bytes=32 << 20):
+    """Makes networks read large parameters from copies on huge pages.
+
+    Only applies to networks added afterwards. Their embedding matrices and
+    layer weights of at least min_bytes are copied to 2MB huge pages when the
+    network first runs, so that random row lookups over hundreds of megabytes
+    do not miss the TLB on nearly every row. The copies are not updated, so
+    this is only for networks of restored parameters that no longer train.
+    Mapped embedding matrices stay in their files.
+
+    Args:
+      min_bytes: size of the smallest parameter to copy.
+    """
+    self._huge_page_min_bytes = min_bytes
+
+  def _HugePageParam(self, param, name):
+    """Returns the parameter, read from huge pages if they are used."""
+    if not self._huge_page_min_bytes:
+      return param
+    key = (name, param.name)
+    if key not in self.huge_page_params:
+      with tf.name_scope(self._param_scope):
+        self.huge_page_params[key] = gen_parser_ops.huge_page_copy(
+            param, min_bytes=self._huge_page_min_bytes,
+            name=name + '_huge_pages')
+    return self.huge_page_params[key]
+
+  def UseNetworkDevice(self, device):
+    """Places evaluation networks and their parameters on a device.
+
+    Only applies to evaluation networks added afterwards. The readers stay on
+    the host, and their features are copied to the device from pinned host
+    memory. The embedding matrices stay resident on the device, and are
+    looked up there with a gather, so that only the feature ids and the
+    transition scores cross the bus. TF only has host kernels to sum the
+    embeddings of several ids, so every feature must have exactly one id,
+    which is checked on the host. Precomputed and quantized networks run on
+    host kernels and are left unplaced.
+
+    Args:
+      device: device name, e.g. '/gpu:0'. Sessions need soft placement, since
+        integer parameters like the step have no GPU kernels.
+    """
+    self._network_device = device
+
+  def _AddDeviceEmbedding(self, features, num_features, embedding_size, index,
+                          return_average=False):
+    """Looks up single id features in a matrix on the network device.
+
+    Args:
+      features: sparse or packed features of one feature group.
+      num_features: number of features in the group.
+      embedding_size: embedding dimension of the group.
+      index: index of the feature group.
+      return_average: whether to use moving averages as model parameters.
+
+    Returns:
+      The [batch size, num_features * embedding_size] embeddings of the group.
+    """
+    embedding_matrix = self._AddEmbeddingMatrix(index,
+                                                return_average=return_average)
+    with tf.device('/cpu:0'):
+      if not isinstance(features, PackedFeatures):
+        features = tf.reshape(features, [-1], name='feature_%d' % index)
+      _, ids, weights, size = _UnpackFeatures(features,
+                                              self._allow_feature_weights)
+      ids = cf.with_dependencies(
+          [tf.assert_equal(tf.size(ids), size,
+                           message='Features on device need one id each')],
+          ids)
+    embedding = tf.gather(embedding_matrix, ids)
+    if embedding.dtype != tf.float32:
+      embedding = tf.cast(embedding, tf.float32)
+    if self._allow_feature_weights:
+      embedding *= tf.expand_dims(weights, 1)
+    return tf.reshape(embedding, [-1, num_features * embedding_size])
+
+  def _AddHalfParam(self, shape, name):
+    """Adds the half precision values of a model parameter."""
+    if name not in self.half_params:
+      with tf.name_scope(self._param_scope):
+        self.half_params[name] = self._AddVariable(shape, tf.float16,
+                                                   name + '_half',
+                                                   tf.zeros_initializer)
+    return self.half_params[name]
+
+  def AssignHalfParams(self, sess, values):
+    """Rounds float parameter values into the half precision parameters.
+
+    Args:
+      sess: session holding the half precision parameters.
+      values: dictionary of float numpy arrays by parameter name, which must
+        hold all half_params.
+    """
+    for name, variable in self.half_params.items():
+      value = values[name].astype(np.float16)
+      placeholder = tf.placeholder(tf.float16, value.shape)
+      sess.run(tf.assign(variable, placeholder),
+               feed_dict={placeholder: value})
+
+  def _AddMappedParam(self, shape, name):
+    """Adds a float parameter mapped from a file of its raw values."""
+    if name not in self.mapped_params:
+      with tf.name_scope(self._param_scope):
+        self.mapped_params[name] = gen_array_ops.immutable_const(
+            dtype=tf.float32,
+            shape=shape,
+            memory_region_name=os.path.join(self._mapped_embeddings_dir, name),
+            name=name + '_mapped')
+    return self.mapped_params[name]
+
+  def WriteMappedEmbeddings(self, sess, embeddings_dir):
+    """Writes the embedding matrices read by UseMappedEmbeddings.
+
+    Each matrix is written as its raw float values in row major order, in a
+    file named after the parameter. The values are the moving averages if
+    evaluation networks use them.
+
+    Args:
+      sess: session holding the restored float parameters.
+      embeddings_dir: local directory to write the matrices to.
+    """
+    names = ['embedding_matrix_%d' % i for i in range(self._feature_size)]
+    params = [self.variables[name + '_avg_var'] if self._use_averaging else
+              self.params[name] for name in names]
+    for name, value in zip(names, sess.run(params)):
+      with open(os.path.join(embeddings_dir, name), 'wb') as f:
+        f.write(np.ascontiguousarray(value, dtype=np.float32).tobytes())
+
+  def _UnzipPackedFeatures(self, features):
+    """Returns the indices, ids, weights and batch size of packed features."""
+    indices, ids, weights, sizes = zip(*features)
+    batch_size = tf.div(sizes[0], int(self._num_features[0]))
+    return list(indices), list(ids), list(weights), batch_size
+
+  def _AddPackedEmbeddings(self, features, return_average=False):
+    """Adds the embedding matrices and embeds packed features in one op."""
+    matrices = self._AddEmbeddingMatrices(return_average=return_average)
+    indices, ids, weights, batch_size = self._UnzipPackedFeatures(features)
+    return gen_parser_ops.embed_features(
+        indices, ids, weights, matrices, batch_size,
+        num_features=[int(n) for n in self._num_features],
+        allow_weights=self._allow_feature_weights,
+        name='embeddings')
+
+  def _AddPrecomputedLayerInput(self, features, layer_weights,
+                                return_average=False):
+    """Computes the first layer input of packed features from tables.
+
+    Feature groups with more ids than the largest precomputed domain, like
+    words, get no tables. They are embedded and multiplied by their rows of
+    the layer weights in a single dense product, which is added to the sum of
+    table rows of the other groups.
+
+    Args:
+      features: packed features of all feature groups.
+      layer_weights: weights of the first hidden layer.
+      return_average: whether to use moving averages as model parameters.
+
+    Returns:
+      A (layer_input, precompute) pair, where running precompute fills the
+      tables with the products of the current parameters.
+
+    Raises:
+      ValueError: if the embedding matrices are in half precision.
+    """
+    if self._half_embeddings:
+      raise ValueError('Precomputed embeddings need float embedding matrices')
+    matrices = self._AddEmbeddingMatrices(return_average=return_average)
+    num_features = [int(n) for n in self._num_features]
+    indices, ids, weights, batch_size = self._UnzipPackedFeatures(features)
+    precomputed = [self._max_precomputed_domain is None or
+                   int(n) <= self._max_precomputed_domain
+                   for n in self._num_feature_ids]
+
+    # Rows of the layer weights of each feature group.
+    group_weights = []
+    offset = 0
+    for matrix, n in zip(matrices, num_features):
+      width = n * matrix.get_shape()[1].value
+      group_weights.append(tf.slice(layer_weights, [offset, 0], [width, -1]))
+      offset += width
+
+    def _Groups(values, selected):
+      return [v for v, p in zip(values, precomputed) if p == selected]
+
+    def _GroupWeights(selected):
+      if all(p == selected for p in precomputed):
+        return layer_weights
+      return tf.concat(0, _Groups(group_weights, selected))
+
+    layer_inputs = []
+    assignments = []
+    if any(precomputed):
+      table_weights = _GroupWeights(True)
+      table_matrices = _Groups(matrices, True)
+      table_features = _Groups(num_features, True)
+      products = PrecomputeEmbeddingTables(
+          table_matrices, table_weights, table_features,
+          self._precomputed_ids)
+      tables = []
+      for i, product in zip(_Groups(range(len(matrices)), True), products):
+        table = self._AddVariable(product.get_shape().as_list(), tf.float32,
+                                  'precomputed_embeddings_%d' % i,
+                                  tf.zeros_initializer)
+        tables.append(table)
+        assignments.append(tf.assign(table, product))
+      layer_inputs.append(gen_parser_ops.precomputed_embed_features(
+          _Groups(indices, True), _Groups(ids, True), _Groups(weights, True),
+          tables, table_matrices, table_weights, batch_size,
+          num_features=table_features,
+          allow_weights=self._allow_feature_weights))
+    if not all(precomputed):
+      embeddings = gen_parser_ops.embed_features(
+          _Groups(indices, False), _Groups(ids, False),
+          _Groups(weights, False), _Groups(matrices, False), batch_size,
+          num_features=_Groups(num_features, False),
+          allow_weights=self._allow_feature_weights,
+          name='dense_embeddings')
+      layer_inputs.append(tf.matmul(embeddings, _GroupWeights(False)))
+    return (tf.add_n(layer_inputs),
+            tf.group(*assignments, name='precompute_embeddings'))
+
+  def UsePrecomputedEmbeddings(self, max_ids=0, max_domain_size=None):
+    """Makes evaluation networks precompute their first hidden layer.
+
+    Each embedded feature only feeds the first hidden layer, so its product
+    with the layer weights can be precomputed for every id, and the layer input
+    computed as a sum of table rows. Only applies to evaluation networks added
+    afterwards that read packed features. Their 'precompute_embeddings' node
+    must be run after the parameters are restored, and again whenever they
+    change.
+
+    Args:
+      max_ids: if positive, only the first max_ids ids of each feature group
+        get precomputed rows, which bounds the size of the tables. Feature ids
+        are sorted by decreasing frequency, so these are the most frequent.
+      max_domain_size: if set, only feature groups with at most this many ids,
+        like tags and labels, get tables. Larger groups, like words, are
+        embedded and multiplied by the layer weights as a dense matrix.
+    """
+    self._precomputed_ids = max_ids
+    self._max_precomputed_domain = max_domain_size
+
+  def UseQuantizedInference(self):
+    """Makes evaluation networks run on eight bit parameters.
+
+    Only applies to evaluation networks added afterwards. Their parameters are
+    the quantized_params, set from float parameters by AssignQuantizedParams,
+    and their layer input range must be calibrated by running the
+    'calibrate_quantization' node over representative input before the
+    quantized model is saved.
+    """
+    self._quantized = True
+
+  def UseSyncReplicas(self, replicas_to_aggregate, total_num_replicas,
+                      replica_id):
+    """Makes training aggregate the gradients of several replicas.
+
+    Only applies to training added afterwards. Its optimizer is wrapped in a
+    tf.train.SyncReplicasOptimizer, available as 'sync_optimizer', whose chief
+    queue runner and init tokens op must be run by the chief replica.
+
+    Args:
+      replicas_to_aggregate: number of replicas whose gradients are summed
+        into each update.
+      total_num_replicas: number of replicas running, which may include
+        backup replicas.
+      replica_id: index of this replica, in [0, total_num_replicas).
+    """
+    self._sync_replicas = {'replicas_to_aggregate': replicas_to_aggregate,
+                           'total_num_replicas': total_num_replicas,
+                           'replica_id': replica_id}
+
+  def _Minimize(self, optimizer, cost, var_list):
+    """Returns the op minimizing cost with optimizer, and adds its slots.
+
+    Also wraps the optimizer for synchronous replicas, see UseSyncReplicas.
+
+    Args:
+      optimizer: momentum optimizer.
+      cost: cost to minimize.
+      var_list: variables to train.
+
+    Returns:
+      The training op.
+    """
+    existing_variables = set(tf.all_variables())
+    if self._sync_replicas is None:
+      train_op = self._ApplyGradients(
+          optimizer, optimizer.compute_gradients(cost, var_list=var_list))
+    else:
+      if self._lazy_averages:
+        raise ValueError('Sparse averaging requires asynchronous updates')
+      optimizer = tf.train.SyncReplicasOptimizer(optimizer,
+                                                 **self._sync_replicas)
+      self.sync_optimizer = optimizer
+      global_step = self._AddVariable([], tf.int32, 'global_step',
+                                      tf.zeros_initializer)
+      existing_variables.add(global_step)
+      train_op = optimizer.minimize(cost, var_list=var_list,
+                                    global_step=global_step)
+    for param in var_list:
+      slot = optimizer.get_slot(param, 'momentum')
+      self.inits[slot.name] = state_ops.init_variable(slot,
+                                                      tf.zeros_initializer)
+      self.variables[slot.name] = slot
+      existing_variables.add(slot)
+    # Other variables of the optimizer, like the local steps of synchronous
+    # replicas, are initialized to their initial values.
+    for variable in tf.all_variables():
+      if variable not in existing_variables:
+        self.inits[variable.op.name] = variable.initializer
+    return train_op
+
+  def _ApplyGradients(self, optimizer, grads_and_vars):
+    """Returns the op applying the gradients and updating the lazy averages.
+
+    The lazy averages of the trained rows are caught up to the previous step
+    before the update, while the rows still hold the values of the steps since
+    their last sync, and updated with the decay of the current step after it.
+    Also adds sync_averages, catching up all the rows.
+
+    Args:
+      optimizer: momentum optimizer.
+      grads_and_vars: gradients and variables to apply them to.
+
+    Returns:
+      The training op.
+    """
+    if not self._lazy_averages or not self._use_averaging:
+      return optimizer.apply_gradients(grads_and_vars)
+    log_decay = self._AddVariable([], tf.float64, 'averaging_log_decay',
+                                  tf.zeros_initializer)
+    names = {param: name
+             for name, (param, _, _) in self._lazy_averages.iteritems()}
+
+    def Sync(lazy_average, rows, sync_log_decay):
+      param, average, synced = lazy_average
+      return gen_parser_ops.lazy_moving_average(average, synced, param, rows,
+                                                sync_log_decay,
+                                                use_locking=self._use_locking)
+
+    with tf.name_scope('lazy_averaging'):
+      # Sparse gradients train the rows they index, once each after summing
+      # duplicate indices.
+      trained_rows = []
+      for grad, param in grads_and_vars:
+        if grad is None or param not in names:
+          continue
+        if isinstance(grad, tf.IndexedSlices):
+          rows = tf.unique(grad.indices)[0]
+        else:
+          rows = tf.range(tf.shape(param)[0])
+        trained_rows.append((self._lazy_averages[names[param]], rows))
+      catch_ups = [Sync(lazy_average, rows, log_decay)
+                   for lazy_average, rows in trained_rows]
+      with tf.control_dependencies(catch_ups):
+        train_op = optimizer.apply_gradients(grads_and_vars)
+
+      # The decay of an ExponentialMovingAverage at the incremented step.
+      with tf.control_dependencies([train_op]):
+        step = tf.cast(self.GetStep(), tf.float64)
+        if self._averaging_decay == 1:
+          decay = step / (step + 1.0)
+        else:
+          decay = tf.minimum(tf.constant(self._averaging_decay, tf.float64),
+                             (1.0 + step) / (10.0 + step))
+        step_log_decay = log_decay + tf.log(decay)
+      updates = [Sync(lazy_average, rows, step_log_decay)
+                 for lazy_average, rows in trained_rows]
+      with tf.control_dependencies(updates):
+        train_op = tf.group(tf.assign(log_decay, step_log_decay))
+
+      syncs = [Sync(lazy_average, tf.range(tf.shape(lazy_average[0])[0]),
+                    log_decay)
+               for lazy_average in self._lazy_averages.values()]
+      self.sync_averages = tf.group(*syncs, name='sync_averages')
+    return train_op
+
+  def _AddQuantizedVariable(self, shape, dtype, name, initializer):
+    with tf.name_scope(self._param_scope):
+      self.quantized_variables[name] = self._AddVariable(shape, dtype, name,
+                                                         initializer)
+    return self.quantized_variables[name]
+
+  def _AddQuantizedParam(self, shape, name):
+    """Adds the quantized values and range of a model parameter."""
+    if name not in self.quantized_params:
+      self.quantized_params[name] = (
+          self._AddQuantizedVariable(shape, tf.uint8, name + '_quantized',
+                                     tf.zeros_initializer),
+          self._AddQuantizedVariable([], tf.float32, name + '_min',
+                                     tf.zeros_initializer),
+          self._AddQuantizedVariable([], tf.float32, name + '_max',
+                                     tf.constant_initializer(1.0)))
+    return self.quantized_params[name]
+
+  def _AddDequantizedParam(self, shape, name):
+    quantized, min_value, max_value = self._AddQuantizedParam(shape, name)
+    return _QuantizationOps().dequantize(tf.bitcast(quantized, tf.quint8),
+                                         min_value, max_value)
+
+  def AssignQuantizedParams(self, sess, values):
+    """Quantizes float parameter values into the quantized parameters.
+
+    Args:
+      sess: session holding the quantized parameters.
+      values: dictionary of float numpy arrays by parameter name, which must
+        hold all quantized_params.
+    """
+    for name, variables in self.quantized_params.items():
+      quantized, min_value, max_value = QuantizeArray(values[name])
+      placeholder = tf.placeholder(tf.uint8, quantized.shape)
+      sess.run([tf.assign(variables[0], placeholder),
+                tf.assign(variables[1], min_value),
+                tf.assign(variables[2], max_value)],
+               feed_dict={placeholder: quantized})
+
+  def _BuildQuantizedNetwork(self, feature_endpoints):
+    """Builds a feed-forward network on eight bit parameters.
+
+    Embeddings are dequantized as they are looked up. The hidden layers run on
+    eight bit activations and weights with 32 bit accumulation, each in one
+    fused op that adds the bias and applies the ReLU before requantizing, and
+    the softmax layer on dequantized activations, so that the transition scores
+    keep their resolution.
+
+    Args:
+      feature_endpoints: tensors with input features to the network
+
+    Returns:
+      logits: output of the final layer before computing softmax
+      calibrate_quantization: op widening the calibrated range of the
+        embedding layer to that of the current input
+    """
+    assert len(feature_endpoints) == self._feature_size
+    quantization = _QuantizationOps()
+    nodes = {}
+
+    # Create embedding layer.
+    embeddings = []
+    for i in range(self._feature_size):
+      matrix, min_value, max_value = self._AddQuantizedParam(
+          [self._num_feature_ids[i], self._embedding_sizes[i]],
+          'embedding_matrix_%d' % i)
+      features = feature_endpoints[i]
+      if not isinstance(features, PackedFeatures):
+        features = tf.reshape(features, [-1], name='feature_%d' % i)
+      embedding = QuantizedEmbeddingLookupFeatures(matrix, min_value,
+                                                   max_value, features,
+                                                   self._allow_feature_weights)
+      embeddings.append(tf.reshape(
+          embedding, [-1, self._num_features[i] * self._embedding_sizes[i]]))
+    last_layer = tf.concat(1, embeddings)
+    last_layer_size = self.embedding_size
+
+    # The embedding layer has no fixed range, so it is quantized into one
+    # calibrated over representative input.
+    input_min = self._AddQuantizedVariable([], tf.float32, 'layer_input_min',
+                                           tf.zeros_initializer)
+    input_max = self._AddQuantizedVariable([], tf.float32, 'layer_input_max',
+                                           tf.zeros_initializer)
+    nodes['calibrate_quantization'] = tf.group(
+        tf.assign(input_min,
+                  tf.minimum(input_min, tf.reduce_min(last_layer))),
+        tf.assign(input_max,
+                  tf.maximum(input_max, tf.reduce_max(last_layer))),
+        name='calibrate_quantization')
+
+    # Create ReLU layers.
+    if self._hidden_layer_sizes:
+      activations, activations_min, activations_max = quantization.quantize_v2(
+          last_layer, input_min, input_max, tf.quint8)
+    for i, hidden_layer_size in enumerate(self._hidden_layer_sizes):
+      weights, weights_min, weights_max = self._AddQuantizedParam(
+          [last_layer_size, hidden_layer_size], 'weights_%d' % i)
+      bias, bias_min, bias_max = self._AddQuantizedParam(
+          [hidden_layer_size], 'bias_%d' % i)
+      activations, activations_min, activations_max = (
+          quantization.quantized_mat_mul_with_bias_and_relu(
+              activations, tf.bitcast(weights, tf.quint8),
+              tf.bitcast(bias, tf.quint8), activations_min, activations_max,
+              weights_min, weights_max, bias_min, bias_max,
+              name='layer_%d' % i))
+      last_layer_size = hidden_layer_size
+    if self._hidden_layer_sizes:
+      last_layer = quantization.dequantize(activations, activations_min,
+                                           activations_max)
+
+    # Create softmax layer.
+    softmax_weight = self._AddDequantizedParam(
+        [last_layer_size, self._num_softmax_outputs], 'softmax_weight')
+    softmax_bias = self._AddDequantizedParam([self._num_softmax_outputs],
+                                             'softmax_bias')
+    nodes['logits'] = self._AddSoftmaxLayer(last_layer, softmax_weight,
+                                            softmax_bias)
+    return nodes
+
+  def _BuildNetwork(self, feature_endpoints, return_average=False,
+                    precompute_embeddings=False, on_device=False):
     """Builds a feed-forward part of the net given features as input.
 
     The network topology is already defined in the constructor, so multiple
@@ -314,98 +1165,304 @@ class GreedyParser(object):
     Args:
       feature_endpoints: tensors with input features to the network
       return_average: whether to use moving averages as model parameters
+      precompute_embeddings: whether to compute the first hidden layer from
+        precomputed tables, if the features are packed
+      on_device: whether the embeddings are looked up on the network device,
+        see UseNetworkDevice
 
     Returns:
       logits: output of the final layer before computing softmax
+      precompute_embeddings: if the tables are used, the op filling them
     """
     assert len(feature_endpoints) == self._feature_size
+    nodes = {}
+    precompute_embeddings = (precompute_embeddings and
+                             self._hidden_layer_sizes and
+                             isinstance(feature_endpoints[0], PackedFeatures))
 
     # Create embedding layer.
-    embeddings = []
-    for i in range(self._feature_size):
-      embeddings.append(self._AddEmbedding(feature_endpoints[i],
-                                           self._num_features[i],
-                                           self._num_feature_ids[i],
-                                           self._embedding_sizes[i],
-                                           i,
-                                           return_average=return_average))
+    if precompute_embeddings:
+      last_layer = None
+    elif on_device:
+      last_layer = tf.concat(1, [
+          self._AddDeviceEmbedding(feature_endpoints[i],
+                                   self._num_features[i],
+                                   self._embedding_sizes[i],
+                                   i,
+                                   return_average=return_average)
+          for i in range(self._feature_size)])
+    elif isinstance(feature_endpoints[0], PackedFeatures):
+      last_layer = self._AddPackedEmbeddings(feature_endpoints,
+                                             return_average=return_average)
+    else:
+      embeddings = []
+      for i in range(self._feature_size):
+        embeddings.append(self._AddEmbedding(feature_endpoints[i],
+                                             self._num_features[i],
+                                             self._num_feature_ids[i],
+                                             self._embedding_sizes[i],
+                                             i,
+                                             return_average=return_average))
+      last_layer = tf.concat(1, embeddings)
 
-    last_layer = tf.concat(1, embeddings)
-    last_layer_size = self.embedding_size
+    layer_weights, layer_biases = self._AddLayerParams(
+        return_average=return_average)
 
     # Create ReLU layers.
+    for i in range(len(self._hidden_layer_sizes)):
+      weights = layer_weights[i]
+      bias = layer_biases[i]
+      if i == 0 and precompute_embeddings:
+        layer_input, nodes['precompute_embeddings'] = (
+            self._AddPrecomputedLayerInput(feature_endpoints, weights,
+                                           return_average=return_average))
+        last_layer = tf.nn.relu(tf.nn.bias_add(layer_input, bias),
+                                name='layer_%d' % i)
+      else:
+        last_layer = tf.nn.relu_layer(last_layer,
+                                      weights,
+                                      bias,
+                                      name='layer_%d' % i)
+
+    # Create softmax layer.
+    nodes['logits'] = self._AddSoftmaxLayer(last_layer, layer_weights[-1],
+                                            layer_biases[-1])
+    return nodes
+
+  def _AddSoftmaxLayer(self, last_layer, weights, bias):
+    """Returns the logits of the actions, computed from the last layer.
+
+    With num_tag_actions, the softmax layer holds the tag head and the analysis
+    head side by side, so both are computed by a single product. The logit of
+    an action is the sum of the log-probabilities of its tag and its analysis.
+    Their softmax is the product of the two distributions, so the cross
+    entropy of an action is the sum of those of its tag and its analysis.
+    With factored_arc_actions, the layer likewise holds the action type head
+    and the label head, and the logit of an arc sums the log-probabilities of
+    its type and its label, while that of SHIFT is the log-probability of its
+    type.
+
+    Args:
+      last_layer: output of the last hidden layer, or the embedding layer
+      weights: weights of the softmax layer
+      bias: bias of the softmax layer
+
+    Returns:
+      [batch size, num_actions] tensor of logits.
+    """
+    if self._factored_arc_actions:
+      return self._AddFactoredArcLogits(
+          tf.nn.xw_plus_b(last_layer, weights, bias, name='heads'))
+    if not self._num_tag_actions:
+      return tf.nn.xw_plus_b(last_layer, weights, bias, name='logits')
+    heads = tf.nn.xw_plus_b(last_layer, weights, bias, name='heads')
+    num_morph_actions = self._num_softmax_outputs - self._num_tag_actions
+    tag_scores = tf.nn.log_softmax(
+        tf.slice(heads, [0, 0], [-1, self._num_tag_actions]))
+    morph_scores = tf.nn.log_softmax(
+        tf.slice(heads, [0, self._num_tag_actions], [-1, num_morph_actions]))
+    return tf.reshape(tf.expand_dims(tag_scores, 2) +
+                      tf.expand_dims(morph_scores, 1),
+                      [-1, self._num_actions], name='logits')
+
+  def _AddFactoredArcLogits(self, heads):
+    """Returns the arc-standard action logits from the type and label heads.
+
+    Args:
+      heads: [batch size, 3 + number of labels] tensor holding the logits of
+          SHIFT, LEFT_ARC and RIGHT_ARC, followed by those of the labels
+
+    Returns:
+      [batch size, num_actions] tensor of logits, ordered as the actions of
+      the arc-standard transition system.
+    """
+    num_labels = self._num_softmax_outputs - ARC_STANDARD_ACTION_TYPES
+    type_scores = tf.nn.log_softmax(
+        tf.slice(heads, [0, 0], [-1, ARC_STANDARD_ACTION_TYPES]))
+    label_scores = tf.nn.log_softmax(
+        tf.slice(heads, [0, ARC_STANDARD_ACTION_TYPES], [-1, num_labels]))
+
+    # Action 1 + 2 * label is the LEFT_ARC and 2 + 2 * label the RIGHT_ARC of
+    # the label, so the arcs are the label-major outer sum of the arc types
+    # and the labels.
+    arc_scores = tf.reshape(
+        tf.expand_dims(label_scores, 2) +
+        tf.expand_dims(tf.slice(type_scores, [0, 1], [-1, 2]), 1),
+        [-1, 2 * num_labels])
+    return tf.concat(1, [tf.slice(type_scores, [0, 0], [-1, 1]), arc_scores],
+                     name='logits')
+
+  def _AddLayerParams(self, return_average=False):
+    """Adds the weights and biases of the ReLU layers and the softmax layer.
+
+    Args:
+      return_average: whether to return moving averages of the parameters
+
+    Returns:
+      weights: list of the weights of each layer, softmax layer last
+      biases: list of the biases of each layer, softmax layer last
+    """
+    weights = []
+    biases = []
+    last_layer_size = self.embedding_size
     for i, hidden_layer_size in enumerate(self._hidden_layer_sizes):
-      weights = self._AddParam(
+      weights.append(self._HugePageParam(self._AddParam(
           [last_layer_size, hidden_layer_size],
           tf.float32,
           'weights_%d' % i,
           self._ReluWeightInitializer(),
-          return_average=return_average)
-      bias = self._AddParam([hidden_layer_size],
-                            tf.float32,
-                            'bias_%d' % i,
-                            self._relu_bias_init,
-                            return_average=return_average)
-      last_layer = tf.nn.relu_layer(last_layer,
-                                    weights,
-                                    bias,
-                                    name='layer_%d' % i)
+          return_average=return_average), 'weights_%d' % i))
+      biases.append(self._AddParam([hidden_layer_size],
+                                   tf.float32,
+                                   'bias_%d' % i,
+                                   self._relu_bias_init,
+                                   return_average=return_average))
       last_layer_size = hidden_layer_size
-
-    # Create softmax layer.
-    softmax_weight = self._AddParam(
-        [last_layer_size, self._num_actions],
+    weights.append(self._HugePageParam(self._AddParam(
+        [last_layer_size, self._num_softmax_outputs],
         tf.float32,
         'softmax_weight',
         tf.random_normal_initializer(stddev=self._softmax_init,
                                      seed=self._seed),
-        return_average=return_average)
-    softmax_bias = self._AddParam(
-        [self._num_actions],
+        return_average=return_average), 'softmax_weight'))
+    biases.append(self._AddParam(
+        [self._num_softmax_outputs],
         tf.float32,
         'softmax_bias',
         tf.zeros_initializer,
-        return_average=return_average)
-    logits = tf.nn.xw_plus_b(last_layer,
-                             softmax_weight,
-                             softmax_bias,
-                             name='logits')
-    return {'logits': logits}
-
-  def _AddGoldReader(self, task_context, batch_size, corpus_name):
-    features, epochs, gold_actions = (
-        gen_parser_ops.gold_parse_reader(task_context,
-                                         self._feature_size,
-                                         batch_size,
-                                         corpus_name=corpus_name,
-                                         arg_prefix=self._arg_prefix))
+        return_average=return_average))
+    return weights, biases
+
+  def _PackFeatures(self, indices, ids, weights, batch_size):
+    """Groups the outputs of a packed reader into PackedFeatures tuples."""
+    return [PackedFeatures(indices[i], ids[i], weights[i],
+                           batch_size * self._num_features[i])
+            for i in range(self._feature_size)]
+
+  def _AddGoldReader(self, task_context, batch_size, corpus_name,
+                     gold_feature_files=None):
+    if gold_feature_files:
+      if not self._packed_features:
+        raise ValueError('Gold feature shards require packed features.')
+      indices, ids, weights, feature_batch_size, epochs, gold_actions = (
+          gen_parser_ops.gold_feature_reader(gold_feature_files,
+                                             self._feature_size,
+                                             batch_size))
+      features = self._PackFeatures(indices, ids, weights, feature_batch_size)
+    elif self._packed_features:
+      indices, ids, weights, feature_batch_size, epochs, gold_actions = (
+          gen_parser_ops.packed_gold_parse_reader(task_context,
+                                                  self._feature_size,
+                                                  batch_size,
+                                                  corpus_name=corpus_name,
+                                                  arg_prefix=self._arg_prefix))
+      features = self._PackFeatures(indices, ids, weights, feature_batch_size)
+    else:
+      features, epochs, gold_actions = (
+          gen_parser_ops.gold_parse_reader(task_context,
+                                           self._feature_size,
+                                           batch_size,
+                                           corpus_name=corpus_name,
+                                           arg_prefix=self._arg_prefix))
     return {'gold_actions': tf.identity(gold_actions,
                                         name='gold_actions'),
             'epochs': tf.identity(epochs,
                                   name='epochs'),
             'feature_endpoints': features}
 
+  def _AddDelayedFeatures(self, features, initial_values):
+    """Delays reader outputs by one step through variables of any shape.
+
+    Args:
+      features: feature outputs of a reader.
+      initial_values: empty values of the features before the first step.
+
+    Returns:
+      The variables holding the features of the previous step, and the
+      (variable, feature) pairs to assign once the variables have been read.
+    """
+    delayed = []
+    for i, (feature, initial_value) in enumerate(zip(features,
+                                                     initial_values)):
+      name = 'delayed_feature_%d' % i
+      variable = tf.Variable(initial_value, trainable=False, name=name,
+                             validate_shape=False)
+      self.inits[variable.op.name] = variable.initializer
+      delayed.append(variable)
+    return delayed, zip(delayed, features)
+
   def _AddDecodedReader(self, task_context, batch_size, transition_scores,
-                        corpus_name):
-    features, epochs, eval_metrics, documents = (
-        gen_parser_ops.decoded_parse_reader(transition_scores,
-                                            task_context,
-                                            self._feature_size,
-                                            batch_size,
-                                            corpus_name=corpus_name,
-                                            arg_prefix=self._arg_prefix))
+                        corpus_name, in_order=True, max_batch_latency_ms=0,
+                        skip_deterministic_states=False, ping_pong=False,
+                        parse_cache_bytes=0, model_id='', slim_output=False):
+    delayed_features = []
+    if self._packed_features:
+      (indices, ids, weights, feature_batch_size, epochs, eval_metrics,
+       documents, heads, labels,
+       document_starts) = gen_parser_ops.packed_decoded_parse_reader(
+           transition_scores,
+           task_context,
+           self._feature_size,
+           batch_size,
+           corpus_name=corpus_name,
+           arg_prefix=self._arg_prefix,
+           in_order=in_order,
+           max_batch_latency_ms=max_batch_latency_ms,
+           skip_deterministic_states=skip_deterministic_states,
+           ping_pong=ping_pong,
+           parse_cache_bytes=parse_cache_bytes,
+           model_id=model_id,
+           slim_output=slim_output)
+      if ping_pong:
+        n = self._feature_size
+        empty = ([tf.constant([], tf.int32)] * n +
+                 [tf.constant([], tf.int64)] * n +
+                 [tf.constant([], tf.float32)] * n + [tf.constant(0)])
+        delayed, delayed_features = self._AddDelayedFeatures(
+            indices + ids + weights + [feature_batch_size], empty)
+        indices, ids, weights = delayed[:n], delayed[n:2 * n], delayed[2 * n:-1]
+        feature_batch_size = delayed[-1]
+      features = self._PackFeatures(indices, ids, weights, feature_batch_size)
+    else:
+      (features, epochs, eval_metrics, documents, heads, labels,
+       document_starts) = gen_parser_ops.decoded_parse_reader(
+           transition_scores,
+           task_context,
+           self._feature_size,
+           batch_size,
+           corpus_name=corpus_name,
+           arg_prefix=self._arg_prefix,
+           in_order=in_order,
+           max_batch_latency_ms=max_batch_latency_ms,
+           skip_deterministic_states=skip_deterministic_states,
+           ping_pong=ping_pong,
+           parse_cache_bytes=parse_cache_bytes,
+           model_id=model_id,
+           slim_output=slim_output)
+      if ping_pong:
+        empty = [tf.constant([], tf.string, shape=[0, int(n)])
+                 for n in self._num_features]
+        features, delayed_features = self._AddDelayedFeatures(features, empty)
     return {'eval_metrics': eval_metrics,
             'epochs': tf.identity(epochs,
                                   name='epochs'),
             'feature_endpoints': features,
-            'documents': documents}
+            'delayed_features': delayed_features,
+            'documents': documents,
+            'heads': heads,
+            'labels': labels,
+            'document_starts': document_starts}
 
   def _AddCostFunction(self, batch_size, gold_actions, logits):
     """Cross entropy plus L2 loss on weights and biases of the hidden layers."""
-    dense_golden = BatchedSparseToDense(gold_actions, self._num_actions)
-    cross_entropy = tf.div(
-        tf.reduce_sum(tf.nn.softmax_cross_entropy_with_logits(
-            logits, dense_golden)), batch_size)
+    if self._sparse_cost:
+      cross_entropies = tf.nn.sparse_softmax_cross_entropy_with_logits(
+          logits, gold_actions)
+    else:
+      dense_golden = BatchedSparseToDense(gold_actions, self._num_actions)
+      cross_entropies = tf.nn.softmax_cross_entropy_with_logits(
+          logits, dense_golden)
+    cross_entropy = tf.div(tf.reduce_sum(cross_entropies), batch_size)
     regularized_params = [tf.nn.l2_loss(p)
                           for k, p in self.params.items()
                           if k.startswith('weights') or k.startswith('bias')]
@@ -416,15 +1473,44 @@ class GreedyParser(object):
                     task_context,
                     batch_size,
                     evaluation_max_steps=300,
-                    corpus_name='documents'):
+                    corpus_name='documents',
+                    in_order=True,
+                    max_batch_latency_ms=0,
+                    skip_deterministic_states=False,
+                    ping_pong=False,
+                    parse_cache_bytes=0,
+                    model_id='',
+                    slim_output=False):
     """Builds the forward network only without the training operation.
 
+    With ping_pong=True, the reader alternates between two halves of the batch
+    and the network scores the features the reader emitted in the previous
+    step, which are kept in variables, so that the reader and the network run
+    concurrently within a step on different halves. The 'eval_metrics' and
+    'documents' of a step are then those of the half the reader advanced.
+
     Args:
       task_context: file path from which to read the task context.
       batch_size: batch size to request from reader op.
       evaluation_max_steps: max number of parsing actions during evaluation,
           only used in beam parsing.
       corpus_name: name of the task input to read parses from.
+      in_order: whether to return documents in input order, rather than as
+          soon as they are parsed.
+      max_batch_latency_ms: if positive, target wall time of an evaluation
+          step, met by parsing fewer than batch_size sentences at a time.
+      skip_deterministic_states: whether to advance parser states with a
+          single allowed action without scoring them.
+      ping_pong: whether to overlap feature extraction for one half of the
+          batch with the scoring of the other half.
+      parse_cache_bytes: if positive, size of a cache of parsed documents
+          shared by the decoding readers of the process, from which repeated
+          sentences are output without being parsed again.
+      model_id: identifies the parameters of this parser in the parse cache,
+          e.g. the path of the model they are restored from.
+      slim_output: whether to return the parses as 'heads', 'labels' and
+          'document_starts' rather than as serialized 'documents', which then
+          hold the docids.
 
     Returns:
       Dictionary of named eval nodes.
@@ -438,16 +1524,88 @@ class GreedyParser(object):
     with tf.name_scope('evaluation'):
       nodes = self.evaluation
       nodes['transition_scores'] = self._AddVariable(
-          [batch_size, self._num_actions], tf.float32, 'transition_scores',
-          tf.constant_initializer(-1.0))
-      nodes.update(self._AddDecodedReader(task_context, batch_size, nodes[
-          'transition_scores'], corpus_name))
-      nodes.update(self._BuildNetwork(nodes['feature_endpoints'],
-                                      return_average=self._use_averaging))
+          [0 if ping_pong else batch_size, self._num_actions], tf.float32,
+          'transition_scores', tf.constant_initializer(-1.0))
+      nodes.update(self._AddDecodedReader(
+          task_context, batch_size, nodes['transition_scores'], corpus_name,
+          in_order=in_order, max_batch_latency_ms=max_batch_latency_ms,
+          skip_deterministic_states=skip_deterministic_states,
+          ping_pong=ping_pong, parse_cache_bytes=parse_cache_bytes,
+          model_id=model_id, slim_output=slim_output))
+      if self._quantized:
+        nodes.update(self._BuildQuantizedNetwork(nodes['feature_endpoints']))
+      elif (self._network_device is not None and
+            self._precomputed_ids is None):
+        with tf.device(self._network_device):
+          nodes.update(self._BuildNetwork(
+              nodes['feature_endpoints'],
+              return_average=self._use_averaging,
+              on_device=True))
+      else:
+        nodes.update(self._BuildNetwork(
+            nodes['feature_endpoints'],
+            return_average=self._use_averaging,
+            precompute_embeddings=self._precomputed_ids is not None))
+      if ping_pong:
+        # The reader must read the scores, and the network the features,
+        # before they are replaced by those for the next step. The scores are
+        # assigned even when empty, since the reader expects one row per
+        # state it emitted features for.
+        with tf.control_dependencies([nodes['eval_metrics']]):
+          updates = [_AssignTransitionScores()]
+        with tf.control_dependencies([nodes['logits']]):
+          updates.extend(tf.assign(variable, feature, validate_shape=False)
+                         for variable, feature in nodes['delayed_features'])
+      else:
+        updates = [tf.cond(tf.greater(tf.size(nodes['logits']), 0),
+                           _AssignTransitionScores, _Pass)]
       nodes['eval_metrics'] = cf.with_dependencies(
-          [tf.cond(tf.greater(tf.size(nodes['logits']), 0),
-                   _AssignTransitionScores, _Pass)],
-          nodes['eval_metrics'], name='eval_metrics')
+          updates, nodes['eval_metrics'], name='eval_metrics')
+    return nodes
+
+  def AddFusedEvaluation(self,
+                         task_context,
+                         batch_size,
+                         corpus_name='documents'):
+    """Builds an evaluation network that parses whole batches in one op.
+
+    The GreedyParseDecoder op evaluates the network on the parameters of this
+    parser itself, taking all transitions of a batch of sentences in a single
+    step instead of one step per transition. The 'epochs', 'eval_metrics' and
+    'documents' nodes are as in AddEvaluation, except that documents are
+    always returned in input order.
+
+    Args:
+      task_context: file path from which to read the task context.
+      batch_size: number of sentences to parse in one step.
+      corpus_name: name of the task input to read parses from.
+
+    Returns:
+      Dictionary of named eval nodes.
+
+    Raises:
+      ValueError: if the actions are scored by two softmax heads, or the
+        embedding matrices are in half precision.
+    """
+    if self._num_tag_actions or self._factored_arc_actions:
+      raise ValueError('Fused decoding needs a single softmax head')
+    if self._half_embeddings:
+      raise ValueError('Fused decoding needs float embedding matrices')
+    with tf.name_scope('evaluation'):
+      nodes = self.evaluation
+      matrices = self._AddEmbeddingMatrices(
+          return_average=self._use_averaging)
+      weights, biases = self._AddLayerParams(
+          return_average=self._use_averaging)
+      epochs, nodes['eval_metrics'], nodes['documents'] = (
+          gen_parser_ops.greedy_parse_decoder(
+              matrices, weights, biases,
+              task_context=task_context,
+              feature_size=self._feature_size,
+              batch_size=batch_size,
+              corpus_name=corpus_name,
+              arg_prefix=self._arg_prefix))
+      nodes['epochs'] = tf.identity(epochs, name='epochs')
     return nodes
 
   def _IncrementCounter(self, counter):
@@ -477,10 +1635,13 @@ class GreedyParser(object):
 
     def _Initializer(shape, dtype=tf.float32):
       unused_dtype = dtype
+      seed1, seed2 = random_seed.get_seed(self._seed)
       t = gen_parser_ops.word_embedding_initializer(
           vectors=embeddings_path,
           task_context=task_context,
-          embedding_init=self._embedding_init)
+          embedding_init=self._embedding_init,
+          seed=seed1,
+          seed2=seed2)
 
       t.set_shape(shape)
       return t
@@ -493,7 +1654,8 @@ class GreedyParser(object):
                   learning_rate=0.1,
                   decay_steps=4000,
                   momentum=0.9,
-                  corpus_name='documents'):
+                  corpus_name='documents',
+                  gold_feature_files=None):
     """Builds a trainer to minimize the cross entropy cost function.
 
     Args:
@@ -503,13 +1665,17 @@ class GreedyParser(object):
       decay_steps: decay learning rate by 0.96 every this many steps
       momentum: momentum parameter used when training with momentum
       corpus_name: name of the task input to read parses from
+      gold_feature_files: if set, shards written by gold_features_main for
+          the corpus, read in a shuffled order instead of running the oracle
+          of the transition system; requires packed features
 
     Returns:
       Dictionary of named training nodes.
     """
     with tf.name_scope('training'):
       nodes = self.training
-      nodes.update(self._AddGoldReader(task_context, batch_size, corpus_name))
+      nodes.update(self._AddGoldReader(task_context, batch_size, corpus_name,
+                                       gold_feature_files))
       nodes.update(self._BuildNetwork(nodes['feature_endpoints'],
                                       return_average=False))
       nodes.update(self._AddCostFunction(batch_size, nodes['gold_actions'],
@@ -522,15 +1688,13 @@ class GreedyParser(object):
       else:
         trainable_params = self.params.values()
       lr = self._AddLearningRate(learning_rate, decay_steps)
+      # The embedding gradients repeat the ids of frequent words and tags, so
+      # they are summed into a single update of each distinct row.
       optimizer = tf.train.MomentumOptimizer(lr,
                                              momentum,
-                                             use_locking=self._use_locking)
-      train_op = optimizer.minimize(nodes['cost'], var_list=trainable_params)
-      for param in trainable_params:
-        slot = optimizer.get_slot(param, 'momentum')
-        self.inits[slot.name] = state_ops.init_variable(slot,
-                                                        tf.zeros_initializer)
-        self.variables[slot.name] = slot
+                                             use_locking=self._use_locking,
+                                             sum_duplicate_indices=True)
+      train_op = self._Minimize(optimizer, nodes['cost'], trainable_params)
       numerical_checks = [
           tf.check_numerics(param,
                             message='Parameter is not finite.')
@@ -550,6 +1714,9 @@ class GreedyParser(object):
   def AddSaver(self, slim_model=False):
     """Adds ops to save and restore model parameters.
 
+    Quantized evaluation networks only save and restore the quantized
+    variables.
+
     Args:
       slim_model: whether only averaged variables are saved.
 
@@ -561,9 +1728,13 @@ class GreedyParser(object):
     with tf.name_scope(None):
       variables_to_save = self.params.copy()
       variables_to_save.update(self.variables)
-      if slim_model:
+      if self._quantized:
+        variables_to_save = self.quantized_variables.copy()
+      elif slim_model:
         for key in variables_to_save.keys():
           if not key.endswith('avg_var'):
             del variables_to_save[key]
+        variables_to_save.update((name + '_half', variable)
+                                 for name, variable in self.half_params.items())
       self.saver = tf.train.Saver(variables_to_save)
     return self.saver
@@ -18,15 +18,19 @@
 
 # disable=no-name-in-module,unused-import,g-bad-import-order,maybe-no-member
 import os.path
+import threading
 
+import numpy as np
 import tensorflow as tf
 
+from google.protobuf import text_format
 from tensorflow.python.framework import test_util
 from tensorflow.python.ops import variables
 from tensorflow.python.platform import googletest
 
 from syntaxnet import graph_builder
 from syntaxnet import sparse_pb2
+from syntaxnet import task_spec_pb2
 from syntaxnet.ops import gen_parser_ops
 
 FLAGS = tf.app.flags.FLAGS
@@ -74,6 +78,35 @@ class GraphBuilderTest(test_util.TensorFlowTestCase):
   def NodeFound(self, name):
     return self.FindNode(name) is not None
 
+  def WriteTaskContext(self, name, parameters):
+    """Writes the test task context with extra parameters, returns its path."""
+    context = task_spec_pb2.TaskSpec()
+    with open(self._task_context, 'r') as fin:
+      text_format.Merge(fin.read(), context)
+    for parameter_name, value in parameters:
+      parameter = context.parameter.add()
+      parameter.name = parameter_name
+      parameter.value = value
+    task_context = os.path.join(FLAGS.test_tmpdir, name)
+    with open(task_context, 'w') as fout:
+      fout.write(str(context))
+    return task_context
+
+  def ParseEpoch(self, sess, nodes):
+    """Returns the documents and summed metrics of one evaluation epoch."""
+    documents = []
+    metrics = [0, 0]
+    num_epochs = None
+    while True:
+      tf_epochs, tf_metrics, tf_documents = sess.run(
+          [nodes['epochs'], nodes['eval_metrics'], nodes['documents']])
+      documents.extend(tf_documents)
+      metrics = [metrics[0] + tf_metrics[0], metrics[1] + tf_metrics[1]]
+      if num_epochs is None:
+        num_epochs = tf_epochs
+      elif num_epochs < tf_epochs:
+        return documents, metrics
+
   def testScope(self):
     # Set up the network topology
     graph = tf.Graph()
@@ -297,6 +330,560 @@ class GraphBuilderTest(test_util.TensorFlowTestCase):
                                                          True).eval()
       self.assertAllClose([[0.0, 0.0], [10.5, 13.0]], embeddings)
 
+      # Unweighted features are looked up by int32 ids, ignoring the weights.
+      embeddings = graph_builder.EmbeddingLookupFeatures(params, var,
+                                                         False).eval()
+      self.assertAllClose([[0.0, 0.0], [6.0, 8.0]], embeddings)
+
+  def testUnpackSparseFeaturesCompactly(self):
+    with self.test_session():
+      unweighted = sparse_pb2.SparseFeatures()
+      unweighted.id.append(7)
+      features = [self.MakeSparseFeatures([3, 2], [0.5, 2.0]),
+                  unweighted.SerializeToString()]
+      indices, ids, weights = gen_parser_ops.unpack_sparse_features(
+          features, out_type=tf.int32, with_weights=False)
+      self.assertEqual(tf.int32, ids.dtype)
+      self.assertAllEqual([0, 0, 1], indices.eval())
+      self.assertAllEqual([3, 2, 7], ids.eval())
+      self.assertEqual(0, weights.eval().size)
+
+      _, ids, weights = gen_parser_ops.unpack_sparse_features(features)
+      self.assertEqual(tf.int64, ids.dtype)
+      self.assertAllClose([0.5, 2.0, 1.0], weights.eval())
+
+  def testEmbeddingBagMatchesSegmentSum(self):
+    rng = np.random.RandomState(7)
+    num_segments = 300
+    indices = rng.randint(0, num_segments, 5000).astype(np.int32)
+    ids = rng.randint(0, 40, 5000)
+    weights = rng.rand(5000).astype(np.float32)
+    with self.test_session():
+      params = tf.constant(rng.rand(40, 8).astype(np.float32))
+      for allow_weights in (True, False):
+        bag = gen_parser_ops.embedding_bag(params, indices, ids, weights,
+                                           num_segments,
+                                           allow_weights=allow_weights)
+        rows = tf.gather(params, ids)
+        if allow_weights:
+          rows *= tf.expand_dims(weights, 1)
+        expected = tf.unsorted_segment_sum(rows, indices, num_segments)
+        self.assertAllClose(expected.eval(), bag.eval(), atol=1e-5)
+        grad = rng.rand(num_segments, 8).astype(np.float32)
+        bag_grad = tf.convert_to_tensor(tf.gradients(bag, params, grad)[0])
+        expected_grad = tf.convert_to_tensor(
+            tf.gradients(expected, params, grad)[0])
+        self.assertAllClose(expected_grad.eval(), bag_grad.eval(), atol=1e-4)
+
+      # Half precision embeddings are summed in float.
+      bag = gen_parser_ops.embedding_bag(tf.cast(params, tf.float16),
+                                         indices, ids.astype(np.int32),
+                                         weights, num_segments,
+                                         allow_weights=False)
+      self.assertEqual(tf.float32, bag.dtype)
+      self.assertAllClose(expected.eval(), bag.eval(), atol=0.05)
+
+  def testFusedEvaluationMatchesEvaluation(self):
+    batch_size = 10
+    graph = tf.Graph()
+    with graph.as_default():
+      # Large initial weights keep transition scores from being near ties.
+      parser = self.MakeBuilder(use_averaging=False, relu_init=0.5,
+                                softmax_init=0.5)
+      parser.AddEvaluation(self._task_context,
+                           batch_size,
+                           corpus_name='tuning-corpus')
+      fused = self.MakeBuilder(use_averaging=False)
+      with tf.variable_scope('fused'):
+        fused.AddFusedEvaluation(self._task_context,
+                                 batch_size,
+                                 corpus_name='tuning-corpus')
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      sess.run(fused.inits.values())
+      # Gives both networks the same parameters.
+      sess.run([tf.assign(fused.params[name], parser.params[name])
+                for name in fused.params])
+      documents, metrics = self.ParseEpoch(sess, fused.evaluation)
+      self.assertGreater(len(documents), 0)
+      self.assertEqual((documents, metrics),
+                       self.ParseEpoch(sess, parser.evaluation))
+
+  def testPingPongEvaluationMatchesEvaluation(self):
+    batch_size = 10
+    graph = tf.Graph()
+    with graph.as_default():
+      parser = self.MakeBuilder(use_averaging=False, relu_init=0.5,
+                                softmax_init=0.5)
+      parser.AddEvaluation(self._task_context,
+                           batch_size,
+                           corpus_name='tuning-corpus')
+      ping_pong = self.MakeBuilder(use_averaging=False)
+      with tf.variable_scope('ping_pong'):
+        ping_pong.AddEvaluation(self._task_context,
+                                batch_size,
+                                corpus_name='tuning-corpus',
+                                ping_pong=True)
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      sess.run(ping_pong.inits.values())
+      sess.run([tf.assign(ping_pong.params[name], parser.params[name])
+                for name in ping_pong.params])
+      documents, metrics = self.ParseEpoch(sess, ping_pong.evaluation)
+      self.assertGreater(len(documents), 0)
+      self.assertEqual((documents, metrics),
+                       self.ParseEpoch(sess, parser.evaluation))
+
+  def testNetworkDeviceEvaluationMatchesEvaluation(self):
+    batch_size = 10
+    graph = tf.Graph()
+    with graph.as_default():
+      parser = self.MakeBuilder(use_averaging=False, relu_init=0.5,
+                                softmax_init=0.5)
+      parser.AddEvaluation(self._task_context,
+                           batch_size,
+                           corpus_name='tuning-corpus')
+      on_device = self.MakeBuilder(use_averaging=False)
+      on_device.UseNetworkDevice('/cpu:0')
+      with tf.variable_scope('on_device'):
+        on_device.AddEvaluation(self._task_context,
+                                batch_size,
+                                corpus_name='tuning-corpus')
+    # The device network gathers the embeddings without summing them.
+    ops = [op.type for op in graph.get_operations()
+           if op.name.startswith('on_device')]
+    self.assertIn('Gather', ops)
+    self.assertNotIn('UnsortedSegmentSum', ops)
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      sess.run(on_device.inits.values())
+      sess.run([tf.assign(on_device.params[name], parser.params[name])
+                for name in on_device.params])
+      documents, metrics = self.ParseEpoch(sess, on_device.evaluation)
+      self.assertGreater(len(documents), 0)
+      self.assertEqual((documents, metrics),
+                       self.ParseEpoch(sess, parser.evaluation))
+
+  def testPackedFusedEvaluationMatchesFusedEvaluation(self):
+    packed_context = self.WriteTaskContext(
+        'packed-context.pbtxt',
+        [('brain_parser_network_scorer', 'packed-feed-forward')])
+    batch_size = 10
+    graph = tf.Graph()
+    with graph.as_default():
+      fused = self.MakeBuilder(use_averaging=False, relu_init=0.5,
+                               softmax_init=0.5)
+      fused.AddFusedEvaluation(self._task_context,
+                               batch_size,
+                               corpus_name='tuning-corpus')
+      packed = self.MakeBuilder(use_averaging=False)
+      with tf.variable_scope('packed'):
+        packed.AddFusedEvaluation(packed_context,
+                                  batch_size,
+                                  corpus_name='tuning-corpus')
+    with self.test_session(graph=graph) as sess:
+      sess.run(fused.inits.values())
+      sess.run(packed.inits.values())
+      sess.run([tf.assign(packed.params[name], fused.params[name])
+                for name in packed.params])
+      documents, metrics = self.ParseEpoch(sess, packed.evaluation)
+      self.assertGreater(len(documents), 0)
+      self.assertEqual((documents, metrics),
+                       self.ParseEpoch(sess, fused.evaluation))
+
+  def testConcurrentFusedEvaluationSteps(self):
+    batch_size = 3
+    graph = tf.Graph()
+    with graph.as_default():
+      fused = self.MakeBuilder(use_averaging=False)
+      fused.AddFusedEvaluation(self._task_context,
+                               batch_size,
+                               corpus_name='tuning-corpus')
+    with self.test_session(graph=graph) as sess:
+      sess.run(fused.inits.values())
+      expected, _ = self.ParseEpoch(sess, fused.evaluation)
+
+      # Steps running side by side parse each sentence of the second epoch
+      # once. The first epoch ended with the epoch count at 1.
+      documents = []
+      lock = threading.Lock()
+
+      def ParseBatches():
+        while True:
+          tf_epochs, tf_documents = sess.run(
+              [fused.evaluation['epochs'], fused.evaluation['documents']])
+          if tf_epochs > 1:
+            return
+          with lock:
+            documents.extend(tf_documents)
+
+      threads = [threading.Thread(target=ParseBatches) for _ in range(4)]
+      for thread in threads:
+        thread.start()
+      for thread in threads:
+        thread.join()
+      self.assertEqual(sorted(expected), sorted(documents))
+
+  def testFusedTaggingWithInputFeaturesMatchesEvaluation(self):
+    # Tagger features that only look at the input let the fused decoder score
+    # all tokens of a batch up front.
+    task_context = self.WriteTaskContext('tagger-context.pbtxt', [
+        ('brain_tagger_transition_system', 'tagger'),
+        ('brain_tagger_features',
+         'input.token.word input(1).token.word;input(2).token.word;'
+         'input(3).token.word'),
+        ('brain_tagger_embedding_names', 'words;words2;words3'),
+        ('brain_tagger_embedding_dims', '8;8;8')])
+    with self.test_session() as sess:
+      num_features, num_feature_ids, _, num_actions = sess.run(
+          gen_parser_ops.feature_size(task_context=task_context,
+                                      arg_prefix='brain_tagger'))
+
+    def MakeTagger(**kw_args):
+      return graph_builder.GreedyParser(
+          num_actions, num_features, num_feature_ids,
+          embedding_sizes=[8, 8, 8], hidden_layer_sizes=[32], seed=42,
+          gate_gradients=True, use_averaging=False, arg_prefix='brain_tagger',
+          **kw_args)
+
+    batch_size = 10
+    graph = tf.Graph()
+    with graph.as_default():
+      tagger = MakeTagger(relu_init=0.5, softmax_init=0.5)
+      tagger.AddEvaluation(task_context, batch_size,
+                           corpus_name='tuning-corpus')
+      fused = MakeTagger()
+      with tf.variable_scope('fused'):
+        fused.AddFusedEvaluation(task_context, batch_size,
+                                 corpus_name='tuning-corpus')
+    with self.test_session(graph=graph) as sess:
+      sess.run(tagger.inits.values())
+      sess.run(fused.inits.values())
+      sess.run([tf.assign(fused.params[name], tagger.params[name])
+                for name in fused.params])
+      documents, metrics = self.ParseEpoch(sess, fused.evaluation)
+      self.assertGreater(len(documents), 0)
+      self.assertEqual((documents, metrics),
+                       self.ParseEpoch(sess, tagger.evaluation))
+
+  def testQuantizeArray(self):
+    quantized, min_value, max_value = graph_builder.QuantizeArray(
+        np.array([[0.5, 1.0], [2.0, 1.5]]))
+    self.assertEqual(np.uint8, quantized.dtype)
+    # The range is widened to include zero.
+    self.assertAllEqual([[64, 128], [255, 191]], quantized)
+    self.assertEqual(0.0, min_value)
+    self.assertEqual(2.0, max_value)
+
+  def testQuantizedEmbeddingOp(self):
+    graph = tf.Graph()
+    with self.test_session(graph=graph):
+      quantized, min_value, max_value = graph_builder.QuantizeArray(
+          np.array([[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]]))
+      var = variables.Variable([self.MakeSparseFeatures([], []),
+                                self.MakeSparseFeatures([0, 2],
+                                                        [0.5, 2.0])])
+      var.initializer.run()
+      embeddings = graph_builder.QuantizedEmbeddingLookupFeatures(
+          tf.constant(quantized), min_value, max_value, var, True).eval()
+      self.assertAllClose([[0.0, 0.0], [10.5, 13.0]], embeddings, atol=0.1)
+
+  def testQuantizedEvaluation(self):
+    batch_size = 10
+    graph = tf.Graph()
+    with graph.as_default():
+      parser = self.MakeBuilder(use_averaging=False)
+      parser.AddEvaluation(self._task_context,
+                           batch_size,
+                           corpus_name='tuning-corpus')
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      values = dict(zip(parser.params.keys(),
+                        sess.run(parser.params.values())))
+
+    graph = tf.Graph()
+    with graph.as_default():
+      parser = self.MakeBuilder()
+      parser.UseQuantizedInference()
+      parser.AddEvaluation(self._task_context,
+                           batch_size,
+                           corpus_name='tuning-corpus')
+      # The quantized network holds no float parameters.
+      self.assertFalse(parser.params)
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      parser.AssignQuantizedParams(sess, values)
+      tokens = 0
+      correct_heads = 0
+      for _ in range(100):
+        eval_metrics, _ = sess.run(
+            [parser.evaluation['eval_metrics'],
+             parser.evaluation['calibrate_quantization']])
+        tokens += eval_metrics[0]
+        correct_heads += eval_metrics[1]
+      self.assertGreater(tokens, 0)
+      self.assertGreaterEqual(tokens, correct_heads)
+      input_min, input_max = sess.run(
+          [parser.quantized_variables['layer_input_min'],
+           parser.quantized_variables['layer_input_max']])
+      self.assertLess(input_min, input_max)
+
+  def testHalfEmbeddingsEvaluation(self):
+    batch_size = 10
+    graph = tf.Graph()
+    with graph.as_default():
+      parser = self.MakeBuilder(use_averaging=False)
+      parser.AddEvaluation(self._task_context,
+                           batch_size,
+                           corpus_name='tuning-corpus')
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      values = dict(zip(parser.params.keys(),
+                        sess.run(parser.params.values())))
+
+    graph = tf.Graph()
+    with graph.as_default():
+      parser = self.MakeBuilder(use_averaging=False)
+      parser.UseHalfEmbeddings()
+      parser.AddEvaluation(self._task_context,
+                           batch_size,
+                           corpus_name='tuning-corpus')
+      # Only the embedding matrices are in half precision.
+      self.assertEqual(len(self._num_features), len(parser.half_params))
+      for name in parser.half_params:
+        self.assertNotIn(name, parser.params)
+      self.assertIn('weights_0', parser.params)
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      parser.AssignHalfParams(sess, values)
+      sess.run([tf.assign(parser.params[name], values[name])
+                for name in parser.params])
+      tokens = 0
+      correct_heads = 0
+      for _ in range(20):
+        eval_metrics = sess.run(parser.evaluation['eval_metrics'])
+        tokens += eval_metrics[0]
+        correct_heads += eval_metrics[1]
+      self.assertGreater(tokens, 0)
+      self.assertGreaterEqual(tokens, correct_heads)
+
+  def testEmbedFeaturesMatchesEmbeddingLookups(self):
+    graph = tf.Graph()
+    with self.test_session(graph=graph) as sess:
+      params = [tf.constant([[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]]),
+                tf.constant([[1.0, -1.0, 0.5], [2.0, 0.0, 1.0]])]
+      # Two parser states, with two features of the first group and one of
+      # the second.
+      features = [
+          graph_builder.PackedFeatures(tf.constant([0, 0, 1, 3]),
+                                       tf.constant([1, 2, 0, 2], tf.int64),
+                                       tf.constant([1.0, 0.5, 2.0, 1.0]), 4),
+          graph_builder.PackedFeatures(tf.constant([0, 1, 1]),
+                                       tf.constant([1, 0, 1], tf.int64),
+                                       tf.constant([1.0, 1.0, 3.0]), 2)]
+      lookups = tf.concat(1, [
+          tf.reshape(graph_builder.EmbeddingLookupFeatures(params[0],
+                                                           features[0], True),
+                     [-1, 4]),
+          tf.reshape(graph_builder.EmbeddingLookupFeatures(params[1],
+                                                           features[1], True),
+                     [-1, 3])])
+      indices, ids, weights, _ = zip(*features)
+      fused = gen_parser_ops.embed_features(
+          list(indices), list(ids), list(weights), params, 2,
+          num_features=[2, 1])
+      self.assertAllClose(lookups.eval(), fused.eval())
+      half = gen_parser_ops.embed_features(
+          list(indices), list(ids), list(weights),
+          [tf.cast(p, tf.float16) for p in params], 2, num_features=[2, 1])
+      self.assertAllClose(lookups.eval(), half.eval())
+
+      scale = tf.constant([[1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0],
+                           [-1.0, 0.5, 2.0, 1.0, 0.0, 3.0, 1.0]])
+      lookup_grads = tf.gradients(tf.reduce_sum(lookups * scale), params)
+      fused_grads = tf.gradients(tf.reduce_sum(fused * scale), params)
+      for lookup_grad, fused_grad in zip(lookup_grads, fused_grads):
+        self.assertAllClose(sess.run(tf.convert_to_tensor(lookup_grad)),
+                            sess.run(tf.convert_to_tensor(fused_grad)))
+
+  def testPrecomputedEmbedFeaturesMatchesMatMul(self):
+    graph = tf.Graph()
+    with self.test_session(graph=graph):
+      params = [tf.constant([[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]]),
+                tf.constant([[1.0, -1.0, 0.5], [2.0, 0.0, 1.0]])]
+      layer_weights = tf.constant([[(4 * r + c) / 10.0 for c in range(4)]
+                                   for r in range(7)])
+      indices = [tf.constant([0, 0, 1, 3]), tf.constant([0, 1, 1])]
+      ids = [tf.constant([1, 2, 0, 2], tf.int64),
+             tf.constant([1, 0, 1], tf.int64)]
+      weights = [tf.constant([1.0, 0.5, 2.0, 1.0]),
+                 tf.constant([1.0, 1.0, 3.0])]
+      expected = tf.matmul(
+          gen_parser_ops.embed_features(indices, ids, weights, params, 2,
+                                        num_features=[2, 1]),
+          layer_weights).eval()
+
+      # Ids past the tables fall back to multiplying their embeddings.
+      for max_ids in (0, 1, 2):
+        tables = graph_builder.PrecomputeEmbeddingTables(
+            params, layer_weights, [2, 1], max_ids)
+        layer_input = gen_parser_ops.precomputed_embed_features(
+            indices, ids, weights, tables, params, layer_weights, 2,
+            num_features=[2, 1])
+        self.assertAllClose(expected, layer_input.eval())
+
+  def testPrecomputedEvaluationWithDenseGroupsMatchesEvaluation(self):
+    # Only the smallest feature groups get tables, the others are embedded.
+    max_domain_size = min(self._num_feature_ids)
+    self.assertLess(max_domain_size, max(self._num_feature_ids))
+    batch_size = 10
+    graph = tf.Graph()
+    with graph.as_default():
+      parser = self.MakeBuilder(use_averaging=False, relu_init=0.5,
+                                softmax_init=0.5)
+      parser.AddEvaluation(self._task_context,
+                           batch_size,
+                           corpus_name='tuning-corpus')
+      precomputed = self.MakeBuilder(use_averaging=False,
+                                     packed_features=True)
+      precomputed.UsePrecomputedEmbeddings(max_domain_size=max_domain_size)
+      with tf.variable_scope('precomputed'):
+        precomputed.AddEvaluation(self._task_context,
+                                  batch_size,
+                                  corpus_name='tuning-corpus')
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      sess.run(precomputed.inits.values())
+      sess.run([tf.assign(precomputed.params[name], parser.params[name])
+                for name in precomputed.params])
+      sess.run(precomputed.evaluation['precompute_embeddings'])
+      documents, metrics = self.ParseEpoch(sess, precomputed.evaluation)
+      self.assertGreater(len(documents), 0)
+      self.assertEqual((documents, metrics),
+                       self.ParseEpoch(sess, parser.evaluation))
+
+  def testMappedEmbeddingsMatchEvaluation(self):
+    batch_size = 10
+    embeddings_dir = os.path.join(FLAGS.test_tmpdir, 'mapped_embeddings')
+    if not os.path.exists(embeddings_dir):
+      os.mkdir(embeddings_dir)
+    graph = tf.Graph()
+    with graph.as_default():
+      parser = self.MakeBuilder(use_averaging=False, relu_init=0.5,
+                                softmax_init=0.5)
+      parser.AddEvaluation(self._task_context,
+                           batch_size,
+                           corpus_name='tuning-corpus')
+      mapped = self.MakeBuilder(use_averaging=False)
+      mapped.UseMappedEmbeddings(embeddings_dir)
+      with tf.variable_scope('mapped'):
+        mapped.AddEvaluation(self._task_context,
+                             batch_size,
+                             corpus_name='tuning-corpus')
+      # The embedding matrices are not variables of the mapped network.
+      self.assertFalse([name for name in mapped.params
+                        if name.startswith('embedding_matrix')])
+      self.assertEqual(len(self._num_features), len(mapped.mapped_params))
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      sess.run(mapped.inits.values())
+      parser.WriteMappedEmbeddings(sess, embeddings_dir)
+      sess.run([tf.assign(mapped.params[name], parser.params[name])
+                for name in mapped.params])
+      documents, metrics = self.ParseEpoch(sess, mapped.evaluation)
+      self.assertGreater(len(documents), 0)
+      self.assertEqual((documents, metrics),
+                       self.ParseEpoch(sess, parser.evaluation))
+
+  def testHugePagesEvaluationMatchesEvaluation(self):
+    batch_size = 10
+    graph = tf.Graph()
+    with graph.as_default():
+      parser = self.MakeBuilder(use_averaging=False, relu_init=0.5,
+                                softmax_init=0.5)
+      parser.AddEvaluation(self._task_context,
+                           batch_size,
+                           corpus_name='tuning-corpus')
+      huge = self.MakeBuilder(use_averaging=False)
+      huge.UseHugePages(min_bytes=1)
+      with tf.variable_scope('huge'):
+        huge.AddEvaluation(self._task_context,
+                           batch_size,
+                           corpus_name='tuning-corpus')
+      # The embedding matrices, and the weights of the two hidden layers and
+      # of the softmax layer.
+      self.assertEqual(len(self._num_features) + 3,
+                       len(huge.huge_page_params))
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      sess.run(huge.inits.values())
+      # The parameters are copied when the network first runs.
+      sess.run([tf.assign(huge.params[name], parser.params[name])
+                for name in huge.params])
+      documents, metrics = self.ParseEpoch(sess, huge.evaluation)
+      self.assertGreater(len(documents), 0)
+      self.assertEqual((documents, metrics),
+                       self.ParseEpoch(sess, parser.evaluation))
+      num_regions, num_bytes, huge_page_bytes = sess.run(
+          gen_parser_ops.huge_page_stats())
+      self.assertGreaterEqual(num_regions, len(huge.huge_page_params))
+      self.assertLessEqual(huge_page_bytes, num_bytes)
+
+  def testSparseCostMatchesDenseCost(self):
+    logits = np.random.RandomState(0).randn(4, self._num_actions)
+    gold_actions = [0, self._num_actions - 1, 1, 0]
+    graph = tf.Graph()
+    with graph.as_default():
+      sparse = self.MakeBuilder()._AddCostFunction(
+          4, tf.constant(gold_actions), tf.constant(logits, tf.float32))
+      dense = self.MakeBuilder(sparse_cost=False)._AddCostFunction(
+          4, tf.constant(gold_actions), tf.constant(logits, tf.float32))
+    with self.test_session(graph=graph) as sess:
+      sparse_cost, dense_cost = sess.run([sparse['cost'], dense['cost']])
+      self.assertAllClose(dense_cost, sparse_cost)
+
+  def testFactoredArcLogits(self):
+    heads = np.random.RandomState(0).randn(4, 3 + (self._num_actions - 1) // 2)
+    graph = tf.Graph()
+    with graph.as_default():
+      logits = self.MakeBuilder(factored_arc_actions=True)._AddSoftmaxLayer(
+          tf.constant(heads, tf.float32), tf.eye(heads.shape[1]),
+          tf.zeros([heads.shape[1]]))
+    with self.test_session(graph=graph) as sess:
+      tf_logits = sess.run(logits)
+    self.assertEqual((4, self._num_actions), tf_logits.shape)
+
+    # The actions are a distribution, with arcs scored by type and label.
+    def LogSoftmax(x):
+      return x - np.log(np.exp(x).sum(axis=1, keepdims=True))
+    type_scores = LogSoftmax(heads[:, :3])
+    label_scores = LogSoftmax(heads[:, 3:])
+    self.assertAllClose(np.ones(4), np.exp(tf_logits).sum(axis=1))
+    self.assertAllClose(type_scores[:, 0], tf_logits[:, 0])
+    for label in range(label_scores.shape[1]):
+      self.assertAllClose(type_scores[:, 1] + label_scores[:, label],
+                          tf_logits[:, 1 + 2 * label])
+      self.assertAllClose(type_scores[:, 2] + label_scores[:, label],
+                          tf_logits[:, 2 + 2 * label])
+
+  def testFactoredArcTraining(self):
+    batch_size = 10
+    graph = tf.Graph()
+    with graph.as_default():
+      parser = self.MakeBuilder(use_averaging=False, factored_arc_actions=True)
+      parser.AddTraining(self._task_context, batch_size,
+                         corpus_name='training-corpus')
+      parser.AddEvaluation(self._task_context, batch_size,
+                           corpus_name='tuning-corpus')
+    self.assertEqual([32, 3 + (self._num_actions - 1) // 2],
+                     parser.params['softmax_weight'].get_shape().as_list())
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      for _ in range(5):
+        sess.run(parser.training['train_op'])
+      documents, _ = self.ParseEpoch(sess, parser.evaluation)
+      self.assertGreater(len(documents), 0)
+
   def testOnlyTrainSomeParameters(self):
     batch_size = 10
     graph = tf.Graph()
@@ -320,6 +907,30 @@ class GraphBuilderTest(test_util.TensorFlowTestCase):
       self.assertAllEqual(weight, weight0)
       self.assertGreater(abs(bias - bias0).sum(), 0, 1e-5)
 
+  def testSparseAveragingMatchesMovingAverage(self):
+    graph = tf.Graph()
+    with graph.as_default():
+      parser = self.MakeBuilder(sparse_averaging=True)
+      parser.AddTraining(self._task_context,
+                         batch_size=10,
+                         corpus_name='training-corpus')
+    with self.test_session(graph=graph) as sess:
+      sess.run(parser.inits.values())
+      embedding = parser.params['embedding_matrix_0']
+      average = parser.variables['embedding_matrix_0_avg_var']
+      expected = np.zeros(embedding.get_shape().as_list())
+      for _ in range(5):
+        sess.run(parser.training['train_op'])
+        tf_embedding, tf_step = sess.run([embedding, parser.GetStep()])
+        decay = min(0.9999, (1.0 + tf_step) / (10.0 + tf_step))
+        expected = decay * expected + (1 - decay) * tf_embedding
+
+      # Rows that are not trained by the last steps are only caught up by
+      # syncing the averages.
+      self.assertGreater(abs(sess.run(average) - expected).max(), 1e-3)
+      sess.run(parser.sync_averages)
+      self.assertAllClose(expected, sess.run(average), atol=1e-6)
+
 
 if __name__ == '__main__':
   googletest.main()
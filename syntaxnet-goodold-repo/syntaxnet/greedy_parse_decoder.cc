@@ -0,0 +1,524 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Greedy decoding of whole sentences in a single op, with the feed-forward
+// network evaluated in place of a separate TensorFlow graph step per parser
+// transition.
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/base.h"
+#include "syntaxnet/embedding_feature_extractor.h"
+#include "syntaxnet/network_scorer.h"
+#include "syntaxnet/parser_features.h"
+#include "syntaxnet/parser_state.h"
+#include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/sentence_batch.h"
+#include "syntaxnet/sentence_tracing.h"
+#include "syntaxnet/shared_store.h"
+#include "syntaxnet/sparse.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+using tensorflow::DEVICE_CPU;
+using tensorflow::DT_FLOAT;
+using tensorflow::OpKernel;
+using tensorflow::OpKernelConstruction;
+using tensorflow::OpKernelContext;
+using tensorflow::Tensor;
+using tensorflow::TensorShape;
+using tensorflow::errors::InvalidArgument;
+
+namespace syntaxnet {
+
+// Parses batches of sentences to the end with the greedy feed-forward network
+// whose parameters are the inputs, as a GreedyParser evaluation network would
+// with one DecodedParseReader step per transition. Each step reads up to
+// batch_size sentences, extracts the features of all unfinished states, runs
+// the embedding layer, the ReLU layers and the softmax layer, and performs the
+// best allowed transitions, until all states are final. Documents are output
+// in input order, along with the evaluation metrics of DecodedParseReader.
+//
+// Input features, like the character features of a segmenter, only depend on
+// the sentence and the next input token. Their part of the first layer is
+// computed once per step for every input position of every sentence, in one
+// batched product, and only the other features are embedded and multiplied
+// at each transition. When all features are input features, as for a tagger
+// without predicted tag features, the transition scores themselves only depend
+// on the next input token. They are then computed for all input positions at
+// once, and each transition merely looks up the scores of its position.
+//
+// The network is evaluated by the registered NetworkScorer named by the
+// <arg_prefix>_network_scorer task parameter, FeedForwardNetwork by default.
+// The input products are only computed ahead with scorers that support
+// splitting the first layer.
+//
+// When the corpus is exhausted, a step outputs no documents and the epoch
+// count is incremented, and the next step starts over.
+//
+// Only reading the sentences of a step is serialized. Each step then parses
+// its own batch, so concurrent steps, e.g. of several inference requests run
+// against one graph, overlap.
+class GreedyParseDecoder : public OpKernel {
+ public:
+  explicit GreedyParseDecoder(OpKernelConstruction *context)
+      : OpKernel(context) {
+    string file_path, corpus_name;
+    OP_REQUIRES_OK(context, context->GetAttr("task_context", &file_path));
+    OP_REQUIRES_OK(context, context->GetAttr("feature_size", &feature_size_));
+    OP_REQUIRES_OK(context, context->GetAttr("batch_size", &batch_size_));
+    OP_REQUIRES_OK(context, context->GetAttr("corpus_name", &corpus_name));
+    OP_REQUIRES_OK(context, context->GetAttr("arg_prefix", &arg_prefix_));
+
+    // Reads task context from file.
+    string data;
+    OP_REQUIRES_OK(context, ReadFileToString(tensorflow::Env::Default(),
+                                             file_path, &data));
+    OP_REQUIRES(context,
+                TextFormat::ParseFromString(data, task_context_.mutable_spec()),
+                InvalidArgument("Could not parse task context at ", file_path));
+
+    // Set up the batch reader.
+    const int lookahead = task_context_.Get(
+        tensorflow::strings::StrCat(arg_prefix_, "_sentence_lookahead"), 0);
+    sentence_batch_.reset(new SentenceBatch(1, corpus_name, lookahead));
+    sentence_batch_->Init(&task_context_);
+
+    // Set up the parsing features and transition system.
+    shared_features_ = SharedParserFeatures::Get(arg_prefix_, &task_context_);
+    features_ = &shared_features_->features();
+    transition_system_.reset(ParserTransitionSystem::Create(task_context_.Get(
+        features_->GetParamName("transition_system"), "arc-standard")));
+    transition_system_->Setup(&task_context_);
+    transition_system_->Init(&task_context_);
+    string label_map_path =
+        TaskContext::InputFile(*task_context_.GetInput("label-map"));
+    label_map_ = SharedStoreUtils::GetWithDefaultName<TermFrequencyMap>(
+        label_map_path, 0, 0);
+    scoring_type_ = task_context_.Get(
+        tensorflow::strings::StrCat(arg_prefix_, "_scoring"), "");
+    network_scorer_ = task_context_.Get(
+        tensorflow::strings::StrCat(arg_prefix_, "_network_scorer"),
+        "feed-forward");
+
+    // Finds the features whose first layer products can be computed ahead.
+    input_features_ = features_->InputFeatures();
+    for (const vector<bool> &group : input_features_) {
+      for (bool input : group) {
+        has_input_features_ |= input;
+        all_input_features_ &= input;
+      }
+    }
+    all_input_features_ &= has_input_features_;
+
+    // Checks number of feature groups matches the task context.
+    const int required_size = features_->embedding_dims().size();
+    OP_REQUIRES(
+        context, feature_size_ == required_size,
+        InvalidArgument("Task context requires feature_size=", required_size));
+  }
+
+  ~GreedyParseDecoder() override {
+    SharedStore::Release(label_map_);
+    SharedParserFeatures::Release(shared_features_);
+  }
+
+  void Compute(OpKernelContext *context) override {
+    std::unique_ptr<NetworkScorer> network(
+        NetworkScorer::Create(network_scorer_));
+    OP_REQUIRES_OK(context, network->Init(context, *features_));
+    const bool split = has_input_features_ && network->SupportsParts();
+    const bool precompute = all_input_features_ && split;
+    if (split) {
+      OP_REQUIRES_OK(context,
+                     network->SplitFirstLayer(context, input_features_));
+    }
+
+    // Reads the next batch of sentences, rewinding at the end of the corpus.
+    std::unique_ptr<Batch> batch;
+    int num_epochs;
+    {
+      mutex_lock lock(mu_);
+      if (free_batches_.empty()) {
+        batch.reset(new Batch());
+      } else {
+        batch = std::move(free_batches_.back());
+        free_batches_.pop_back();
+      }
+      ReadSentences(batch.get());
+      if (batch->sentences.empty()) {
+        ++num_epochs_;
+        LOG(INFO) << "Starting epoch " << num_epochs_;
+        sentence_batch_->Rewind();
+      }
+      num_epochs = num_epochs_;
+    }
+    InitStates(batch.get());
+    const int num_sentences = batch->sentences.size();
+
+    // Takes the best allowed transition of every unfinished state until all
+    // are final, dropping finished states from the network batch.
+    std::vector<int> active;
+    for (int i = 0; i < num_sentences; ++i) {
+      if (!transition_system_->IsFinalState(*batch->states[i])) {
+        active.push_back(i);
+      }
+    }
+    Tensor input_products;
+    if (split) {
+      OP_REQUIRES_OK(context, ComputeInputProducts(context, active, *network,
+                                                   batch.get(),
+                                                   &input_products));
+    }
+    if (precompute) {
+      OP_REQUIRES_OK(context, network->ComputeScoresFromProducts(
+                                  context, &input_products));
+    }
+    while (!active.empty()) {
+      Tensor scores;
+      if (!precompute) {
+        OP_REQUIRES_OK(context, ComputeScores(context, active, *network, split,
+                                              input_products, batch.get(),
+                                              &scores));
+      }
+      auto scores_matrix =
+          (precompute ? input_products : scores).matrix<float>();
+      const int num_actions = scores_matrix.dimension(1);
+      const int num_active = active.size();
+      batch->active_states.resize(num_active);
+      batch->best_actions.resize(num_active);
+      batch->is_final.resize(num_active);
+      for (int index = 0; index < num_active; ++index) {
+        ParserState *state = batch->states[active[index]].get();
+        const int64 row = precompute
+                              ? batch->input_offsets[active[index]] +
+                                    state->Next()
+                              : index;
+        batch->active_states[index] = state;
+        batch->best_actions[index] = transition_system_->BestAllowedAction(
+            *state, scores_matrix.data() + row * num_actions, num_actions,
+            &batch->allowed_actions);
+      }
+      string trace_ids;
+      for (const ParserState *state : batch->active_states) {
+        AddTraceId(state->sentence(), &trace_ids);
+      }
+      SentenceSpan span("decode_step", trace_ids);
+      transition_system_->PerformActions(
+          batch->best_actions.data(), batch->active_states.data(), num_active,
+          batch->is_final.data());
+      int num_unfinished = 0;
+      for (int index = 0; index < num_active; ++index) {
+        if (!batch->is_final[index]) active[num_unfinished++] = active[index];
+      }
+      active.resize(num_unfinished);
+    }
+
+    // Outputs the epoch count, the evaluation metrics and the parsed documents
+    // in input order.
+    Tensor *epoch_output;
+    OP_REQUIRES_OK(context, context->allocate_output(0, TensorShape({}),
+                                                     &epoch_output));
+    epoch_output->scalar<int32>()() = num_epochs;
+    std::vector<int> order(num_sentences);
+    for (int i = 0; i < num_sentences; ++i) order[i] = i;
+    std::sort(order.begin(), order.end(), [&batch](int a, int b) {
+      return batch->sequences[a] < batch->sequences[b];
+    });
+    int num_tokens = 0;
+    int num_correct = 0;
+    Tensor *documents_output;
+    OP_REQUIRES_OK(
+        context,
+        context->allocate_output(
+            2, TensorShape({static_cast<int64>(num_sentences)}),
+            &documents_output));
+    auto documents = documents_output->vec<string>();
+    for (int index = 0; index < num_sentences; ++index) {
+      const ParserState &state = *batch->states[order[index]];
+      for (int i = 0; i < state.sentence().token_size(); ++i) {
+        const Token &token = state.GetToken(i);
+        if (utils::PunctuationUtil::ScoreToken(token.word(), token.tag(),
+                                               scoring_type_)) {
+          ++num_tokens;
+          if (state.IsTokenCorrect(i)) ++num_correct;
+        }
+      }
+      Sentence document = state.sentence();
+      state.AddParseToDocument(&document);
+      documents(index) = document.SerializeAsString();
+    }
+    Tensor *metrics_output;
+    OP_REQUIRES_OK(context, context->allocate_output(1, TensorShape({2}),
+                                                     &metrics_output));
+    auto eval_metrics = metrics_output->vec<int32>();
+    eval_metrics(0) = num_tokens;
+    eval_metrics(1) = num_correct;
+
+    // Keeps the storage of the batch for a later step.
+    for (auto &state : batch->states) {
+      batch->state_arena.Release(std::move(state));
+    }
+    mutex_lock lock(mu_);
+    free_batches_.push_back(std::move(batch));
+  }
+
+ private:
+  // The sentences of one step, and the parser states, workspaces and scratch
+  // space used to parse them. Batches are kept across steps to reuse their
+  // storage.
+  struct Batch {
+    // Sentences of the batch, and their zero-based positions in the input.
+    std::vector<std::unique_ptr<Sentence>> sentences;
+    std::vector<int64> sequences;
+
+    // Storage of the parser states. Declared before the states, which use it.
+    ParserStateArena state_arena;
+
+    // Parser states, workspaces and sparse features of the last transition of
+    // the sentences.
+    std::vector<std::unique_ptr<ParserState>> states;
+    std::vector<WorkspaceSet> workspaces;
+    std::vector<SparseFeaturesMemo> feature_memos;
+
+    // Offset of the input products of each sentence, see
+    // ComputeInputProducts().
+    std::vector<int64> input_offsets;
+
+    // Scratch buffer for the allowed actions of a state.
+    std::vector<uint8> allowed_actions;
+
+    // Scratch buffers for the transitions of the unfinished states.
+    std::vector<ParserState *> active_states;
+    std::vector<ParserAction> best_actions;
+    std::vector<uint8> is_final;
+  };
+
+  // Reads up to batch_size sentences into the batch, or none at the end of
+  // the corpus. Must be called with mu_ held.
+  void ReadSentences(Batch *batch) {
+    batch->sentences.clear();
+    batch->sequences.clear();
+    while (static_cast<int>(batch->sentences.size()) < batch_size_ &&
+           sentence_batch_->AdvanceSentence(0)) {
+      batch->sentences.emplace_back(new Sentence());
+      batch->sentences.back()->Swap(sentence_batch_->sentence(0));
+      batch->sequences.push_back(sentence_batch_->sequence(0));
+    }
+  }
+
+  // Creates and preprocesses the parser states of the sentences of the batch.
+  void InitStates(Batch *batch) const {
+    const int num_sentences = batch->sentences.size();
+    batch->states.resize(num_sentences);
+    if (static_cast<int>(batch->workspaces.size()) < num_sentences) {
+      batch->workspaces.resize(num_sentences);
+      batch->feature_memos.resize(num_sentences);
+    }
+    batch->input_offsets.resize(num_sentences);
+    for (int i = 0; i < num_sentences; ++i) {
+      batch->states[i] = batch->state_arena.NewState(
+          batch->sentences[i].get(),
+          transition_system_->NewTransitionState(true), label_map_);
+      batch->workspaces[i].Reset(shared_features_->registry());
+      SentenceSpan span("preprocess", *batch->sentences[i]);
+      features_->Preprocess(&batch->workspaces[i], batch->states[i].get());
+      batch->feature_memos[i].Clear();
+    }
+  }
+
+  // Computes the first layer products of the input features of the states of
+  // the given sentences at every input position from their next input token
+  // on. The row of sentence i at position j is batch->input_offsets[i] + j.
+  tensorflow::Status ComputeInputProducts(OpKernelContext *context,
+                                          const std::vector<int> &slots,
+                                          const NetworkScorer &network,
+                                          Batch *batch,
+                                          Tensor *products) const {
+    int64 num_rows = 0;
+    for (int slot : slots) {
+      const ParserState &state = *batch->states[slot];
+      batch->input_offsets[slot] = num_rows - state.Next();
+      num_rows += state.NumTokens() - state.Next() + 1;
+    }
+
+    // Clones advanced through the input, one per sentence. They are created
+    // and destroyed here, since the state arena is not thread-safe.
+    std::vector<std::unique_ptr<ParserState>> scanners;
+    for (int slot : slots) scanners.emplace_back(batch->states[slot]->Clone());
+    const int64 part_size = network.part_size(true);
+    Tensor part;
+    TF_RETURN_IF_ERROR(context->allocate_temp(
+        DT_FLOAT, TensorShape({num_rows, part_size}), &part));
+    float *rows = part.matrix<float>().data();
+    tensorflow::Status status;
+    mutex status_mu;
+    auto embed = [&](int64 start, int64 limit) {
+      for (int64 index = start; index < limit; ++index) {
+        const int slot = slots[index];
+        ParserState *scanner = scanners[index].get();
+        float *row =
+            rows + (batch->input_offsets[slot] + scanner->Next()) * part_size;
+        while (true) {
+          tensorflow::Status s = network.EmbedPart(
+              features_->ExtractSparseFeatures(batch->workspaces[slot],
+                                               *scanner),
+              true, row);
+          if (!s.ok()) {
+            mutex_lock lock(status_mu);
+            status.Update(s);
+          }
+          if (scanner->EndOfInput()) break;
+          scanner->Advance();
+          row += part_size;
+        }
+      }
+    };
+    const auto &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    const int64 rows_per_slot = slots.empty() ? 0 : num_rows / slots.size();
+    tensorflow::Shard(worker_threads.num_threads, worker_threads.workers,
+                      slots.size(),
+                      NetworkScorer::kEmbeddingCost * rows_per_slot,
+                      embed);
+    TF_RETURN_IF_ERROR(status);
+    return network.MultiplyPart(context, true, part, products);
+  }
+
+  // Computes the transition scores of the states of the given sentences, one
+  // row per sentence. If the first layer is split, only the other features
+  // are embedded, and the input products of the next input token of each
+  // state are added.
+  tensorflow::Status ComputeScores(OpKernelContext *context,
+                                   const std::vector<int> &slots,
+                                   const NetworkScorer &network, bool split,
+                                   const Tensor &input_products, Batch *batch,
+                                   Tensor *scores) const {
+    const int64 batch_size = slots.size();
+    const int64 embedding_size = split
+                                     ? network.part_size(false)
+                                     : network.embedding_size();
+    TF_RETURN_IF_ERROR(context->allocate_temp(
+        DT_FLOAT, TensorShape({batch_size, embedding_size}), scores));
+    float *rows = scores->matrix<float>().data();
+    tensorflow::Status status;
+    mutex status_mu;
+    auto embed = [&](int64 start, int64 limit) {
+      for (int64 index = start; index < limit; ++index) {
+        const int slot = slots[index];
+        SparseFeaturesMemo *memo = &batch->feature_memos[slot];
+        features_->UpdateSparseFeatures(batch->workspaces[slot],
+                                        *batch->states[slot], memo);
+        float *row = rows + index * embedding_size;
+        tensorflow::Status s =
+            split
+                ? network.EmbedPart(memo->features, false, row)
+                : network.Embed(memo->features, row);
+        if (!s.ok()) {
+          mutex_lock lock(status_mu);
+          status.Update(s);
+        }
+      }
+    };
+    const auto &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    tensorflow::Shard(worker_threads.num_threads, worker_threads.workers,
+                      batch_size, NetworkScorer::kEmbeddingCost, embed);
+    TF_RETURN_IF_ERROR(status);
+    if (!split) return network.ComputeScores(context, scores);
+
+    Tensor products;
+    TF_RETURN_IF_ERROR(
+        network.MultiplyPart(context, false, *scores, &products));
+    const int64 hidden_size = network.hidden_size();
+    const float *inputs = input_products.matrix<float>().data();
+    float *sums = products.matrix<float>().data();
+    for (int64 index = 0; index < batch_size; ++index) {
+      const int slot = slots[index];
+      const float *input =
+          inputs + (batch->input_offsets[slot] + batch->states[slot]->Next()) *
+                       hidden_size;
+      float *sum = sums + index * hidden_size;
+      for (int64 h = 0; h < hidden_size; ++h) sum[h] += input[h];
+    }
+    *scores = products;
+    return network.ComputeScoresFromProducts(context, scores);
+  }
+
+  // Task context used to configure this op.
+  TaskContext task_context_;
+
+  // Prefix for context parameters.
+  string arg_prefix_;
+
+  // mutex to synchronize reading the sentences of a step.
+  mutex mu_;
+
+  // How many times the document source has been rewinded.
+  int num_epochs_ = 0;
+
+  // Maximum number of sentences parsed in one step.
+  int batch_size_ = 1;
+
+  // Number of feature groups.
+  int feature_size_ = -1;
+
+  // Parameter for deciding which tokens to score.
+  string scoring_type_;
+
+  // Registered type of the network scorer.
+  string network_scorer_;
+
+  // Reader of the sentences, one at a time.
+  std::unique_ptr<SentenceBatch> sentence_batch_;
+
+  // Batches of finished steps, kept to reuse their storage.
+  std::vector<std::unique_ptr<Batch>> free_batches_;
+
+  // Dependency label map used in transition system.
+  const TermFrequencyMap *label_map_;
+
+  // Transition system.
+  std::unique_ptr<ParserTransitionSystem> transition_system_;
+
+  // Typed feature extractor for embeddings, and the shared features it belongs
+  // to, which also hold the workspace registry for feature extraction.
+  const SharedParserFeatures *shared_features_ = nullptr;
+  const ParserEmbeddingFeatureExtractor *features_ = nullptr;
+
+  // Whether each feature of each feature group is an input feature, whether
+  // any is, and whether all are.
+  vector<vector<bool>> input_features_;
+  bool has_input_features_ = false;
+  bool all_input_features_ = true;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(GreedyParseDecoder);
+};
+
+REGISTER_KERNEL_BUILDER(Name("GreedyParseDecoder").Device(DEVICE_CPU),
+                        GreedyParseDecoder);
+
+}  // namespace syntaxnet
@@ -0,0 +1,147 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/huge_page_allocator.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mem.h"
+
+namespace syntaxnet {
+
+const size_t HugePageAllocator::kHugePageSize;
+
+HugePageAllocator *HugePageAllocator::Get() {
+  static HugePageAllocator *allocator = new HugePageAllocator();
+  return allocator;
+}
+
+void *HugePageAllocator::AllocateRaw(size_t alignment, size_t num_bytes) {
+  const size_t size = std::max<size_t>(
+      (num_bytes + kHugePageSize - 1) / kHugePageSize * kHugePageSize,
+      kHugePageSize);
+  Region region = {size, false, false};
+  char *start = nullptr;
+#if defined(__linux__)
+#if defined(MAP_HUGETLB)
+  // Fails right away unless enough hugetlbfs pages are free.
+  void *hugetlb = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  if (hugetlb != MAP_FAILED) {
+    start = static_cast<char *>(hugetlb);
+    region.hugetlb = true;
+  }
+#endif
+  if (start == nullptr) {
+    // Maps a huge page more than needed and trims the mapping to a huge page
+    // boundary, so that the kernel can back every page of the region.
+    void *mapping = mmap(nullptr, size + kHugePageSize, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      LOG(WARNING) << "Could not map " << size << " bytes for huge pages";
+      return nullptr;
+    }
+    char *begin = static_cast<char *>(mapping);
+    start = reinterpret_cast<char *>(
+        (reinterpret_cast<uintptr_t>(begin) + kHugePageSize - 1) /
+        kHugePageSize * kHugePageSize);
+    if (start > begin) munmap(begin, start - begin);
+    char *end = begin + size + kHugePageSize;
+    if (end > start + size) munmap(start + size, end - (start + size));
+#if defined(MADV_HUGEPAGE)
+    // Kernels without transparent huge pages refuse, and the region stays on
+    // normal pages.
+    madvise(start, size, MADV_HUGEPAGE);
+#endif
+  }
+  region.mapped = true;
+#else
+  start = static_cast<char *>(tensorflow::port::aligned_malloc(
+      num_bytes, std::max(alignment, kAllocatorAlignment)));
+  if (start == nullptr) return nullptr;
+#endif
+  tensorflow::mutex_lock lock(mu_);
+  regions_[start] = region;
+  return start;
+}
+
+void HugePageAllocator::DeallocateRaw(void *ptr) {
+  if (ptr == nullptr) return;
+  Region region;
+  {
+    tensorflow::mutex_lock lock(mu_);
+    auto it = regions_.find(static_cast<const char *>(ptr));
+    CHECK(it != regions_.end()) << "Not a huge page region: " << ptr;
+    region = it->second;
+    regions_.erase(it);
+  }
+#if defined(__linux__)
+  if (region.mapped) {
+    munmap(ptr, region.size);
+    return;
+  }
+#endif
+  tensorflow::port::aligned_free(ptr);
+}
+
+HugePageStats HugePageAllocator::GetHugePageStats() {
+  HugePageStats stats;
+  std::map<const char *, Region> regions;
+  {
+    tensorflow::mutex_lock lock(mu_);
+    regions = regions_;
+  }
+  for (const auto &region : regions) {
+    ++stats.num_regions;
+    stats.bytes += region.second.size;
+    if (region.second.hugetlb) stats.huge_page_bytes += region.second.size;
+  }
+
+  // Adds the transparent huge pages of the mappings overlapping the other
+  // regions, as the kernel reports them for each mapping. A mapping the
+  // kernel merged with a neighbour counts for at most its overlap.
+  std::ifstream smaps("/proc/self/smaps");
+  string line;
+  int64 overlap = 0;
+  while (std::getline(smaps, line)) {
+    unsigned long begin, end;  // NOLINT
+    long long kilobytes;       // NOLINT
+    if (sscanf(line.c_str(), "%lx-%lx ", &begin, &end) == 2) {
+      overlap = 0;
+      for (const auto &region : regions) {
+        if (region.second.hugetlb || !region.second.mapped) continue;
+        const uintptr_t start = reinterpret_cast<uintptr_t>(region.first);
+        const uintptr_t limit = start + region.second.size;
+        const uintptr_t low = std::max<uintptr_t>(start, begin);
+        const uintptr_t high = std::min<uintptr_t>(limit, end);
+        if (low < high) overlap += high - low;
+      }
+    } else if (overlap > 0 &&
+               sscanf(line.c_str(), "AnonHugePages: %lld kB", &kilobytes) ==
+                   1) {
+      stats.huge_page_bytes += std::min<int64>(kilobytes << 10, overlap);
+    }
+  }
+  return stats;
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,91 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Allocation of large tensors on 2MB huge pages, so that random row lookups
+// in embedding matrices of hundreds of megabytes do not miss the TLB on
+// nearly every row, as they do on 4KB pages.
+
+#ifndef SYNTAXNET_HUGE_PAGE_ALLOCATOR_H_
+#define SYNTAXNET_HUGE_PAGE_ALLOCATOR_H_
+
+#include <map>
+#include <string>
+
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace syntaxnet {
+
+// Memory of the huge page allocator.
+struct HugePageStats {
+  // Number and total size of the regions allocated.
+  int64 num_regions = 0;
+  int64 bytes = 0;
+
+  // How many of these bytes are backed by huge pages.
+  int64 huge_page_bytes = 0;
+};
+
+// Allocator mapping each allocation to a region of its own, in whole huge
+// pages and aligned to them. Regions come from reserved hugetlbfs pages if the
+// host has enough of them, see /proc/sys/vm/nr_hugepages, and are otherwise
+// anonymous memory advised to the kernel for transparent huge pages, which it
+// backs with huge pages as they are first touched if it has free ones. Only
+// on Linux; elsewhere the memory is allocated as usual.
+//
+// Every allocation takes at least a huge page, so this is only meant for the
+// few large tensors of a model, see the HugePageCopy op.
+class HugePageAllocator : public tensorflow::Allocator {
+ public:
+  // Size of the huge pages.
+  static const size_t kHugePageSize = 2 << 20;
+
+  // Returns the allocator of the process.
+  static HugePageAllocator *Get();
+
+  // Allocator methods.
+  string Name() override { return "syntaxnet_huge_page"; }
+  void *AllocateRaw(size_t alignment, size_t num_bytes) override;
+  void DeallocateRaw(void *ptr) override;
+
+  // Returns the regions allocated so far and still in use, and how much of
+  // them the kernel backs with huge pages, per /proc/self/smaps.
+  HugePageStats GetHugePageStats();
+
+ private:
+  HugePageAllocator() {}
+
+  // A region of the allocator.
+  struct Region {
+    size_t size;
+
+    // Whether the region has reserved hugetlbfs pages rather than transparent
+    // huge pages or, without them, heap memory.
+    bool hugetlb;
+    bool mapped;
+  };
+
+  tensorflow::mutex mu_;
+
+  // Regions in use, by start address.
+  std::map<const char *, Region> regions_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(HugePageAllocator);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_HUGE_PAGE_ALLOCATOR_H_
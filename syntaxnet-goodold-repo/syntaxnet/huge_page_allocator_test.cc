@@ -0,0 +1,66 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/huge_page_allocator.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+namespace {
+
+const size_t kHugePageSize = HugePageAllocator::kHugePageSize;
+
+TEST(HugePageAllocatorTest, AllocatesWholeAlignedHugePages) {
+  HugePageAllocator *allocator = HugePageAllocator::Get();
+  const HugePageStats before = allocator->GetHugePageStats();
+  char *small = static_cast<char *>(allocator->AllocateRaw(32, 100));
+  char *large =
+      static_cast<char *>(allocator->AllocateRaw(32, 2 * kHugePageSize + 1));
+  ASSERT_NE(nullptr, small);
+  ASSERT_NE(nullptr, large);
+  memset(small, 1, 100);
+  memset(large, 2, 2 * kHugePageSize + 1);
+
+  const HugePageStats stats = allocator->GetHugePageStats();
+  EXPECT_EQ(before.num_regions + 2, stats.num_regions);
+  EXPECT_EQ(before.bytes + 4 * kHugePageSize, stats.bytes);
+  EXPECT_GE(stats.huge_page_bytes, 0);
+  EXPECT_LE(stats.huge_page_bytes, stats.bytes);
+#if defined(__linux__)
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(small) % kHugePageSize);
+  EXPECT_EQ(0, reinterpret_cast<uintptr_t>(large) % kHugePageSize);
+#endif
+
+  allocator->DeallocateRaw(small);
+  allocator->DeallocateRaw(large);
+  EXPECT_EQ(before.num_regions, allocator->GetHugePageStats().num_regions);
+}
+
+TEST(HugePageAllocatorTest, BacksTensors) {
+  tensorflow::Tensor tensor(HugePageAllocator::Get(), tensorflow::DT_FLOAT,
+                            tensorflow::TensorShape({1024, 1024}));
+  ASSERT_TRUE(tensor.IsInitialized());
+  auto values = tensor.flat<float>();
+  values.setConstant(3.0f);
+  EXPECT_EQ(3.0f, values(1024 * 1024 - 1));
+}
+
+}  // namespace
+}  // namespace syntaxnet
@@ -0,0 +1,114 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Ops moving large parameters to huge pages, see huge_page_allocator.h.
+
+#include <string.h>
+
+#include "syntaxnet/huge_page_allocator.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/platform/mutex.h"
+
+using tensorflow::DEVICE_CPU;
+using tensorflow::OpKernel;
+using tensorflow::OpKernelConstruction;
+using tensorflow::OpKernelContext;
+using tensorflow::Tensor;
+using tensorflow::TensorShape;
+using tensorflow::errors::InvalidArgument;
+using tensorflow::errors::ResourceExhausted;
+using tensorflow::mutex_lock;
+
+namespace syntaxnet {
+
+// Copies its input to huge pages when it first runs, if it is large enough,
+// and outputs that copy from then on.
+class HugePageCopy : public OpKernel {
+ public:
+  explicit HugePageCopy(OpKernelConstruction *context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("min_bytes", &min_bytes_));
+  }
+
+  void Compute(OpKernelContext *context) override {
+    const Tensor &input = context->input(0);
+    if (static_cast<int64>(input.TotalBytes()) < min_bytes_ ||
+        !tensorflow::DataTypeCanUseMemcpy(input.dtype())) {
+      context->set_output(0, input);
+      return;
+    }
+    mutex_lock lock(mu_);
+    if (!copy_.IsInitialized()) {
+      Tensor copy(HugePageAllocator::Get(), input.dtype(), input.shape());
+      OP_REQUIRES(context, copy.IsInitialized(),
+                  ResourceExhausted("Could not allocate ", input.TotalBytes(),
+                                    " bytes on huge pages"));
+      const tensorflow::StringPiece from = input.tensor_data();
+      memcpy(const_cast<char *>(copy.tensor_data().data()), from.data(),
+             from.size());
+      copy_ = copy;
+      const HugePageStats stats = HugePageAllocator::Get()->GetHugePageStats();
+      LOG(INFO) << "Copied " << from.size() << " bytes of " << name()
+                << " to huge pages; " << stats.huge_page_bytes << " of "
+                << stats.bytes << " bytes in " << stats.num_regions
+                << " regions are backed by huge pages";
+    }
+    OP_REQUIRES(context, copy_.shape() == input.shape(),
+                InvalidArgument("The shape of ", name(), " changed from ",
+                                copy_.shape().DebugString(), " to ",
+                                input.shape().DebugString()));
+    context->set_output(0, copy_);
+  }
+
+ private:
+  // Inputs smaller than this are passed through.
+  int64 min_bytes_;
+
+  tensorflow::mutex mu_;
+
+  // Copy of the first large input, once made.
+  Tensor copy_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(HugePageCopy);
+};
+
+REGISTER_KERNEL_BUILDER(Name("HugePageCopy").Device(DEVICE_CPU),
+                        HugePageCopy);
+
+// Outputs the regions and huge page coverage of the huge page allocator.
+class HugePageStatsOp : public OpKernel {
+ public:
+  explicit HugePageStatsOp(OpKernelConstruction *context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext *context) override {
+    const HugePageStats stats = HugePageAllocator::Get()->GetHugePageStats();
+    Tensor *output;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({3}), &output));
+    auto values = output->vec<int64>();
+    values(0) = stats.num_regions;
+    values(1) = stats.bytes;
+    values(2) = stats.huge_page_bytes;
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("HugePageStats").Device(DEVICE_CPU),
+                        HugePageStatsOp);
+
+}  // namespace syntaxnet
@@ -0,0 +1,109 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/incremental_parser.h"
+
+#include <utility>
+
+#include "syntaxnet/parser_features.h"
+#include "syntaxnet/shared_store.h"
+#include "syntaxnet/term_frequency_map.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace syntaxnet {
+
+tensorflow::Status IncrementalParser::Create(
+    const string &arg_prefix, const TaskContext &context, ScoreFunction score,
+    std::unique_ptr<IncrementalParser> *parser) {
+  const string transition_system = context.Get(
+      tensorflow::strings::StrCat(arg_prefix, "_transition_system"),
+      "arc-standard");
+  if (transition_system != "arc-standard") {
+    return tensorflow::errors::InvalidArgument(
+        "Incremental parsing does not support the ", transition_system,
+        " transition system");
+  }
+  parser->reset(new IncrementalParser(arg_prefix, context, std::move(score)));
+  return tensorflow::Status::OK();
+}
+
+IncrementalParser::IncrementalParser(const string &arg_prefix,
+                                     const TaskContext &context,
+                                     ScoreFunction score)
+    : score_(std::move(score)) {
+  *context_.mutable_spec() = context.spec();
+  shared_features_ = SharedParserFeatures::Get(arg_prefix, &context_);
+  features_ = &shared_features_->features();
+  transition_system_.reset(ParserTransitionSystem::Create("arc-standard"));
+  transition_system_->Setup(&context_);
+  transition_system_->Init(&context_);
+  const string label_map_path =
+      TaskContext::InputFile(*context_.GetInput("label-map"));
+  label_map_ = SharedStoreUtils::GetWithDefaultName<TermFrequencyMap>(
+      label_map_path, 0, 0);
+  lookahead_ = features_->InputLookahead();
+  Reset();
+}
+
+IncrementalParser::~IncrementalParser() {
+  state_.reset();
+  SharedStore::Release(label_map_);
+  SharedParserFeatures::Release(shared_features_);
+}
+
+void IncrementalParser::Reset() {
+  state_.reset();
+  sentence_.Clear();
+  state_.reset(new ParserState(
+      &sentence_, transition_system_->NewTransitionState(false), label_map_));
+}
+
+tensorflow::Status IncrementalParser::AddToken(const Token &token) {
+  *sentence_.add_token() = token;
+  state_->ExtendInput();
+  return Advance(false);
+}
+
+tensorflow::Status IncrementalParser::Close(Sentence *parse) {
+  TF_RETURN_IF_ERROR(Advance(true));
+  *parse = sentence_;
+  state_->AddParseToDocument(parse);
+  return tensorflow::Status::OK();
+}
+
+tensorflow::Status IncrementalParser::Advance(bool closed) {
+  if (!closed && (lookahead_ == kUnboundedLookahead ||
+                  state_->Next() + lookahead_ >= state_->NumTokens())) {
+    return tensorflow::Status::OK();
+  }
+
+  // Sentence features preprocess all the tokens at once, so the tokens are
+  // preprocessed again when new ones have arrived.
+  workspaces_.Reset(shared_features_->registry());
+  features_->Preprocess(&workspaces_, state_.get());
+  while (!transition_system_->IsFinalState(*state_)) {
+    if (!closed && state_->Next() + lookahead_ >= state_->NumTokens()) break;
+    scores_.clear();
+    TF_RETURN_IF_ERROR(score_(
+        features_->ExtractSparseFeatures(workspaces_, *state_), &scores_));
+    const ParserAction action = transition_system_->BestAllowedAction(
+        *state_, scores_.data(), scores_.size(), &allowed_actions_);
+    transition_system_->PerformAction(action, state_.get());
+  }
+  return tensorflow::Status::OK();
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,125 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Incremental parsing of a sentence whose tokens arrive one at a time, e.g.
+// from speech recognition or a streaming tokenizer.
+//
+// The parser takes the transitions of a greedy parse as soon as the features
+// of the state only read tokens that have arrived, as bounded by the
+// lookahead of the features past the next input token. Each new token lets
+// the parser shift up to that token, and closing the sentence takes the
+// remaining transitions, as a parse of the whole sentence would. The result
+// is the same as the parse of the complete sentence by the same network.
+//
+// The transition scores are computed by a ScoreFunction from the sparse
+// features of each state, e.g. by evaluating the network of the model.
+
+#ifndef SYNTAXNET_INCREMENTAL_PARSER_H_
+#define SYNTAXNET_INCREMENTAL_PARSER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/embedding_feature_extractor.h"
+#include "syntaxnet/parser_state.h"
+#include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/sparse.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/utils.h"
+#include "syntaxnet/workspace.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace syntaxnet {
+
+class TermFrequencyMap;
+
+class IncrementalParser {
+ public:
+  // Computes the scores of the transitions of a state from its sparse
+  // features, one vector per embedding space.
+  typedef std::function<tensorflow::Status(
+      const vector<vector<SparseFeatures>> &features, vector<float> *scores)>
+      ScoreFunction;
+
+  // Creates a parser with the features and the transition system of the
+  // given argument prefix in the task context, as the decoding ops do. Only
+  // the arc-standard transition system is supported, since the transition
+  // states of the others depend on the whole sentence.
+  static tensorflow::Status Create(const string &arg_prefix,
+                                   const TaskContext &context,
+                                   ScoreFunction score,
+                                   std::unique_ptr<IncrementalParser> *parser);
+
+  ~IncrementalParser();
+
+  // Starts parsing a new sentence with no tokens.
+  void Reset();
+
+  // Appends a token to the sentence, and takes the transitions it allows.
+  tensorflow::Status AddToken(const Token &token);
+
+  // Takes the remaining transitions of the sentence, and outputs it with its
+  // parse. The parser must be reset before the next sentence.
+  tensorflow::Status Close(Sentence *parse);
+
+  // Returns how many tokens past the next input token the features read, or
+  // kUnboundedLookahead if only closed sentences can be parsed.
+  int lookahead() const { return lookahead_; }
+
+  // Accessors for the tokens so far and the partial parse.
+  const Sentence &sentence() const { return sentence_; }
+  const ParserState &state() const { return *state_; }
+
+ private:
+  IncrementalParser(const string &arg_prefix, const TaskContext &context,
+                    ScoreFunction score);
+
+  // Takes transitions until the state is final or, unless the sentence is
+  // closed, until the features would read a token that has not arrived.
+  tensorflow::Status Advance(bool closed);
+
+  // The task context, as changed by setting up the features.
+  TaskContext context_;
+
+  // Features, transition system and label map of the parser.
+  const SharedParserFeatures *shared_features_ = nullptr;
+  const ParserEmbeddingFeatureExtractor *features_ = nullptr;
+  std::unique_ptr<ParserTransitionSystem> transition_system_;
+  const TermFrequencyMap *label_map_ = nullptr;
+
+  // Scores the transitions.
+  ScoreFunction score_;
+
+  // Lookahead of the features.
+  int lookahead_ = 0;
+
+  // Tokens so far, and the parser state and workspaces of the sentence.
+  Sentence sentence_;
+  std::unique_ptr<ParserState> state_;
+  WorkspaceSet workspaces_;
+
+  // Scratch space for the scores and the allowed actions of a state.
+  vector<float> scores_;
+  std::vector<uint8> allowed_actions_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(IncrementalParser);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_INCREMENTAL_PARSER_H_
@@ -0,0 +1,177 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/incremental_parser.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/embedding_feature_extractor.h"
+#include "syntaxnet/parser_state.h"
+#include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/populate_test_inputs.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/sparse.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/term_frequency_map.h"
+#include "syntaxnet/utils.h"
+#include "syntaxnet/workspace.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+namespace {
+
+// Number of labels of the test sentence, and of arc-standard actions.
+const int kNumLabels = 6;
+const int kNumActions = 1 + 2 * kNumLabels;
+
+// Scores the actions by fingerprints of the feature ids, so that the parse is
+// an arbitrary but deterministic function of the features. Counts the calls.
+tensorflow::Status FakeScores(int *num_calls,
+                              const vector<vector<SparseFeatures>> &features,
+                              vector<float> *scores) {
+  ++*num_calls;
+  string ids;
+  for (const vector<SparseFeatures> &group : features) {
+    for (const SparseFeatures &feature : group) {
+      for (uint64 id : feature.id()) {
+        tensorflow::strings::StrAppend(&ids, id, ",");
+      }
+    }
+  }
+  for (int action = 0; action < kNumActions; ++action) {
+    scores->push_back(
+        tensorflow::Fingerprint64(tensorflow::strings::StrCat(action, ids)) %
+        1000);
+  }
+  return tensorflow::Status::OK();
+}
+
+class IncrementalParserTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    CHECK(TextFormat::ParseFromString(
+        "token { word: 'I' label: 'nsubj' } "
+        "token { word: 'saw' label: 'ROOT' } "
+        "token { word: 'a' label: 'det' } "
+        "token { word: 'man' label: 'dobj' } "
+        "token { word: 'with' label: 'prep' } "
+        "token { word: 'a' label: 'det' } "
+        "token { word: 'telescope' label: 'pobj' } ",
+        &sentence_));
+    context_.SetParameter("test_features",
+                          "input.token.word input(1).token.word "
+                          "stack.token.word stack(1).token.word");
+    context_.SetParameter("test_embedding_names", "words");
+    context_.SetParameter("test_embedding_dims", "8");
+    context_.GetInput("word-map");
+    context_.GetInput("label-map");
+    PopulateTestInputs::Defaults(sentence_).Populate(&context_);
+  }
+
+  // Returns the parse of the whole sentence by the greedy parser with the fake
+  // scores, as the decoding ops would compute it.
+  Sentence ParseWholeSentence() {
+    const SharedParserFeatures *shared =
+        SharedParserFeatures::Get("test", &context_);
+    std::unique_ptr<ParserTransitionSystem> transitions(
+        ParserTransitionSystem::Create("arc-standard"));
+    TermFrequencyMap label_map(
+        TaskContext::InputFile(*context_.GetInput("label-map")), 0, 0);
+    Sentence sentence = sentence_;
+    ParserState state(&sentence, transitions->NewTransitionState(false),
+                      &label_map);
+    WorkspaceSet workspaces;
+    workspaces.Reset(shared->registry());
+    shared->features().Preprocess(&workspaces, &state);
+    int num_calls = 0;
+    vector<float> scores;
+    std::vector<uint8> allowed;
+    while (!transitions->IsFinalState(state)) {
+      scores.clear();
+      TF_CHECK_OK(FakeScores(
+          &num_calls,
+          shared->features().ExtractSparseFeatures(workspaces, state),
+          &scores));
+      transitions->PerformAction(
+          transitions->BestAllowedAction(state, scores.data(), scores.size(),
+                                         &allowed),
+          &state);
+    }
+    Sentence parse = sentence;
+    state.AddParseToDocument(&parse);
+    SharedParserFeatures::Release(shared);
+    return parse;
+  }
+
+  Sentence sentence_;
+  TaskContext context_;
+};
+
+TEST_F(IncrementalParserTest, ParsesAsTokensArrive) {
+  int num_calls = 0;
+  std::unique_ptr<IncrementalParser> parser;
+  ASSERT_TRUE(IncrementalParser::Create(
+                  "test", context_,
+                  [&num_calls](const vector<vector<SparseFeatures>> &features,
+                               vector<float> *scores) {
+                    return FakeScores(&num_calls, features, scores);
+                  },
+                  &parser)
+                  .ok());
+  EXPECT_EQ(1, parser->lookahead());
+
+  // Each token lets the parser shift the token before it, whose features
+  // read the new token as input(1).
+  for (int i = 0; i < sentence_.token_size(); ++i) {
+    ASSERT_TRUE(parser->AddToken(sentence_.token(i)).ok());
+    EXPECT_EQ(i, parser->state().Next());
+    EXPECT_EQ(i + 1, parser->state().NumTokens());
+  }
+  EXPECT_GT(num_calls, 0);
+
+  Sentence parse;
+  ASSERT_TRUE(parser->Close(&parse).ok());
+  EXPECT_EQ(ParseWholeSentence().DebugString(), parse.DebugString());
+
+  // The parser is reused for the next sentence.
+  parser->Reset();
+  ASSERT_TRUE(parser->AddToken(sentence_.token(0)).ok());
+  ASSERT_TRUE(parser->Close(&parse).ok());
+  ASSERT_EQ(1, parse.token_size());
+  EXPECT_EQ(-1, parse.token(0).head());
+}
+
+TEST_F(IncrementalParserTest, RejectsOtherTransitionSystems) {
+  context_.SetParameter("test_transition_system", "arc-eager");
+  std::unique_ptr<IncrementalParser> parser;
+  EXPECT_FALSE(IncrementalParser::Create(
+                   "test", context_,
+                   [](const vector<vector<SparseFeatures>> &features,
+                      vector<float> *scores) {
+                     return tensorflow::Status::OK();
+                   },
+                   &parser)
+                   .ok());
+}
+
+}  // namespace
+}  // namespace syntaxnet
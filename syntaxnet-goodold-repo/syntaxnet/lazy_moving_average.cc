@@ -0,0 +1,121 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Moving averages of parameters updated lazily, one row at a time.
+
+#include <cmath>
+
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+using tensorflow::DEVICE_CPU;
+using tensorflow::OpKernel;
+using tensorflow::OpKernelConstruction;
+using tensorflow::OpKernelContext;
+using tensorflow::Shard;
+using tensorflow::Tensor;
+using tensorflow::TensorShapeUtils;
+using tensorflow::errors::InvalidArgument;
+using tensorflow::mutex_lock;
+
+namespace syntaxnet {
+
+// Catches the given rows of a moving average up to a cumulative log decay.
+// Between syncs, the rows of the parameter do not change, so the steps of the
+// exponential moving average since the last sync of a row reduce to one step
+// whose decay is the product of their decays, the exponential of the
+// difference of the cumulative log decays.
+template <typename Tid>
+class LazyMovingAverage : public OpKernel {
+ public:
+  explicit LazyMovingAverage(OpKernelConstruction *context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("use_locking", &use_locking_));
+  }
+
+  void Compute(OpKernelContext *context) override {
+    if (use_locking_) {
+      mutex_lock lock(*context->input_ref_mutex(0));
+      Update(context);
+    } else {
+      Update(context);
+    }
+    context->forward_ref_input_to_ref_output(0, 0);
+  }
+
+ private:
+  // Catches the rows up, with the lock of the average held if use_locking_.
+  void Update(OpKernelContext *context) {
+    Tensor average = context->mutable_input(0, use_locking_);
+    Tensor synced = context->mutable_input(1, false);
+    const Tensor &param = context->input(2);
+    const auto ids = context->input(3).flat<Tid>();
+    const double log_decay = context->input(4).scalar<double>()();
+    OP_REQUIRES(context, average.IsInitialized() && synced.IsInitialized(),
+                InvalidArgument("Average is not initialized"));
+    OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(average.shape()),
+                InvalidArgument("Average must be at least 1 dimensional"));
+    OP_REQUIRES(context, average.shape().IsSameSize(param.shape()),
+                InvalidArgument("Average and param have different shapes"));
+    const int64 num_rows = average.dim_size(0);
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(synced.shape()) &&
+                             synced.dim_size(0) == num_rows,
+                InvalidArgument("Synced must have a value per row"));
+    for (int64 i = 0; i < ids.size(); ++i) {
+      OP_REQUIRES(context, ids(i) >= 0 && ids(i) < num_rows,
+                  InvalidArgument("Row ", ids(i), " out of range"));
+    }
+
+    const int64 row_size = num_rows == 0 ? 0 : average.NumElements() / num_rows;
+    float *average_data = average.flat<float>().data();
+    double *synced_data = synced.flat<double>().data();
+    const float *param_data = param.flat<float>().data();
+    auto work = [&](int64 begin, int64 end) {
+      for (int64 i = begin; i < end; ++i) {
+        const int64 row = ids(i);
+        if (synced_data[row] == log_decay) continue;
+        const float decay = std::exp(log_decay - synced_data[row]);
+        float *average_row = average_data + row * row_size;
+        const float *param_row = param_data + row * row_size;
+        for (int64 k = 0; k < row_size; ++k) {
+          average_row[k] -= (1.0f - decay) * (average_row[k] - param_row[k]);
+        }
+        synced_data[row] = log_decay;
+      }
+    };
+    const auto &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads.num_threads, worker_threads.workers, ids.size(),
+          3 * row_size, work);
+  }
+
+  // Whether the average is updated under its lock.
+  bool use_locking_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("LazyMovingAverage")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<tensorflow::int32>("Tid"),
+                        LazyMovingAverage<tensorflow::int32>);
+REGISTER_KERNEL_BUILDER(Name("LazyMovingAverage")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<tensorflow::int64>("Tid"),
+                        LazyMovingAverage<tensorflow::int64>);
+
+}  // namespace syntaxnet
@@ -14,10 +14,14 @@ limitations under the License.
 ==============================================================================*/
 
 #include <stddef.h>
+#include <algorithm>
+#include <memory>
 #include <string>
+#include <utility>
 
 #include "syntaxnet/affix.h"
 #include "syntaxnet/dictionary.pb.h"
+#include "syntaxnet/embedding_feature_extractor.h"
 #include "syntaxnet/feature_extractor.h"
 #include "syntaxnet/segmenter_utils.h"
 #include "syntaxnet/sentence.pb.h"
@@ -26,7 +30,9 @@ limitations under the License.
 #include "syntaxnet/utils.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 // A task that collects term statistics over a corpus and saves a set of
 // term maps; these saved mappings are used to map strings to ints in both the
@@ -50,6 +56,31 @@ namespace syntaxnet {
 //   The maximum prefix length for lexicon words.
 // int lexicon_max_suffix_length (3):
 //   The maximum suffix length for lexicon words.
+// int lexicon_parallel_documents (0):
+//   If positive, the corpus is read this many documents at a time and the
+//   terms of each batch are collected in parallel on the worker threads of the
+//   device, then merged in corpus order. The saved files are the same as when
+//   collecting the terms sequentially while reading, which is the default.
+//
+// bool lexicon_incremental (false):
+//   If true, the counts of the corpus are added to the term maps, affix
+//   tables, tag-to-category map and label constraints already saved at the
+//   outputs, which are loaded first. Terms and affixes already in the saved
+//   files keep their ids, and new ones are added after them, so that models
+//   trained on the saved lexicon keep working, see
+//   TermFrequencyMap::LoadForUpdate(). Outputs that do not exist yet start
+//   out empty. Saved affix tables must have the configured maximum lengths.
+//
+// If the task context has a 'label-constraints' input, the labels of the arcs
+// seen between each pair of head and dependent tags are saved to it, see
+// ArcLabelConstraints.
+//
+// If the task context has a 'lexicon-shards' input, the files of the corpus
+// counted into the lexicon are listed in it, one per line. Incremental builds
+// then only count the files of the corpus that are not listed yet, and leave
+// the lexicon as it is if there are none, so that the corpus input can keep
+// matching all shards as new ones are added. Without it, incremental builds
+// count the whole corpus input, which should then hold only the new shards.
 class LexiconBuilder : public OpKernel {
  public:
   explicit LexiconBuilder(OpKernelConstruction *context) : OpKernel(context) {
@@ -66,38 +97,138 @@ class LexiconBuilder : public OpKernel {
     OP_REQUIRES(context,
                 TextFormat::ParseFromString(data, task_context_.mutable_spec()),
                 InvalidArgument("Could not parse task context at ", file_path));
+    for (const TaskInput &input : task_context_.spec().input()) {
+      if (input.name() == "label-constraints") label_constraints_ = true;
+      if (input.name() == "lexicon-shards") shard_list_ = true;
+    }
   }
 
   // Counts term frequencies.
   void Compute(OpKernelContext *context) override {
-    // Term frequency maps to be populated by the corpus.
-    TermFrequencyMap words;
-    TermFrequencyMap lcwords;
-    TermFrequencyMap tags;
-    TermFrequencyMap categories;
-    TermFrequencyMap labels;
-    TermFrequencyMap chars;
-
-    // Affix tables to be populated by the corpus.
-    AffixTable prefixes(AffixTable::PREFIX, max_prefix_length_);
-    AffixTable suffixes(AffixTable::SUFFIX, max_suffix_length_);
-
-    // Tag-to-category mapping.
-    TagToCategoryMap tag_to_category;
+    // Term maps to be populated by the corpus, starting from the saved ones
+    // when updating them.
+    Lexicon lexicon(max_prefix_length_, max_suffix_length_,
+                    label_constraints_);
+    const bool incremental = task_context_.Get("lexicon_incremental", false);
+    if (incremental) LoadLexicon(&lexicon);
+
+    // Selects the files of the corpus to count: all of them, or when updating
+    // a lexicon with a shard list, those that are not counted in it yet.
+    TaskInput corpus_input = *task_context_.GetInput(corpus_name_);
+    vector<string> counted_shards;
+    if (shard_list_) {
+      const vector<string> shards = TextReader::InputFiles(corpus_input);
+      if (incremental) counted_shards = ReadShardList();
+      corpus_input.clear_part();
+      for (const string &shard : shards) {
+        if (std::find(counted_shards.begin(), counted_shards.end(), shard) ==
+            counted_shards.end()) {
+          corpus_input.add_part()->set_file_pattern(shard);
+        }
+      }
+      if (corpus_input.part_size() == 0) {
+        LOG(INFO) << "No new corpus shards to add to the lexicon";
+        return;
+      }
+      LOG(INFO) << "Counting " << corpus_input.part_size()
+                << " new corpus shards, " << counted_shards.size()
+                << " are already counted";
+    }
 
     // Make a pass over the corpus.
-    int64 num_tokens = 0;
+    const int parallel_documents =
+        task_context_.Get("lexicon_parallel_documents", 0);
     int64 num_documents = 0;
     Sentence *document;
-    TextReader corpus(*task_context_.GetInput(corpus_name_), &task_context_);
-    while ((document = corpus.Read()) != nullptr) {
-      // Gather token information.
-      for (int t = 0; t < document->token_size(); ++t) {
-        // Get token and lowercased word.
-        const Token &token = document->token(t);
-        string word = token.word();
-        utils::NormalizeDigits(&word);
-        string lcword = tensorflow::str_util::Lowercase(word);
+    TextReader corpus(corpus_input, &task_context_);
+    if (parallel_documents <= 0) {
+      while ((document = corpus.Read()) != nullptr) {
+        lexicon.Add(*document);
+        delete document;
+        ++num_documents;
+      }
+    } else {
+      vector<std::unique_ptr<Sentence>> documents;
+      bool done = false;
+      while (!done) {
+        documents.clear();
+        while (documents.size() < static_cast<size_t>(parallel_documents)) {
+          if ((document = corpus.Read()) == nullptr) {
+            done = true;
+            break;
+          }
+          documents.emplace_back(document);
+        }
+        AddInParallel(context, documents, &lexicon);
+        num_documents += documents.size();
+      }
+    }
+    LOG(INFO) << "Term maps collected over " << lexicon.num_tokens
+              << " tokens from " << num_documents << " documents";
+
+    // Write mappings to disk, along with their mapped versions.
+    lexicon.words.SaveMapped(
+        TaskContext::InputFile(*task_context_.GetInput("word-map")));
+    lexicon.lcwords.SaveMapped(
+        TaskContext::InputFile(*task_context_.GetInput("lcword-map")));
+    lexicon.tags.SaveMapped(
+        TaskContext::InputFile(*task_context_.GetInput("tag-map")));
+    lexicon.categories.SaveMapped(
+        TaskContext::InputFile(*task_context_.GetInput("category-map")));
+    lexicon.labels.SaveMapped(
+        TaskContext::InputFile(*task_context_.GetInput("label-map")));
+    lexicon.chars.SaveMapped(
+        TaskContext::InputFile(*task_context_.GetInput("char-map")));
+
+    // Write affixes to disk.
+    WriteAffixTable(lexicon.prefixes,
+                    TaskContext::InputFile(
+                        *task_context_.GetInput("prefix-table")));
+    WriteAffixTable(lexicon.suffixes,
+                    TaskContext::InputFile(
+                        *task_context_.GetInput("suffix-table")));
+
+    // Write tag-to-category mapping to disk.
+    lexicon.tag_to_category.Save(
+        TaskContext::InputFile(*task_context_.GetInput("tag-to-category")));
+
+    // Write the labels seen between pairs of tags to disk, if requested.
+    if (label_constraints_) {
+      lexicon.label_constraints.Save(TaskContext::InputFile(
+          *task_context_.GetInput("label-constraints")));
+    }
+
+    // Lists the counted shards last, once the lexicon they are counted in is
+    // saved.
+    if (shard_list_) {
+      for (const TaskInput::Part &part : corpus_input.part()) {
+        counted_shards.push_back(part.file_pattern());
+      }
+      WriteShardList(counted_shards);
+    }
+  }
+
+ private:
+  // Term maps collected over a part of the corpus. Merging the lexicons of
+  // consecutive parts in order gives the lexicon of the whole corpus; saved
+  // maps are sorted by frequency and affix ids follow the first occurrence of
+  // the affixes, so the saved files do not depend on how the corpus was split.
+  struct Lexicon {
+    Lexicon(int max_prefix_length, int max_suffix_length,
+            bool collect_label_constraints)
+        : prefixes(AffixTable::PREFIX, max_prefix_length),
+          suffixes(AffixTable::SUFFIX, max_suffix_length),
+          collect_label_constraints(collect_label_constraints) {}
+
+    // Adds the tokens of a document.
+    void Add(const Sentence &document) {
+      string word;
+      string lcword;
+      for (int t = 0; t < document.token_size(); ++t) {
+        // Get token and lowercased word, reusing the buffers of the last one.
+        const Token &token = document.token(t);
+        utils::NormalizeDigits(token.word(), &word);
+        utils::Lowercase(word, &lcword);
 
         // Make sure the token does not contain a newline.
         CHECK(lcword.find('\n') == string::npos);
@@ -116,6 +247,18 @@ class LexiconBuilder : public OpKernel {
         // Add mapping from tag to category.
         tag_to_category.SetCategory(token.tag(), token.category());
 
+        // Add the label of the arc from the head of the token.
+        if (collect_label_constraints && !token.label().empty()) {
+          const int head = token.head();
+          if (head == -1) {
+            label_constraints.Add(ArcLabelConstraints::kRootTag, token.tag(),
+                                  token.label());
+          } else if (head >= 0 && head < document.token_size()) {
+            label_constraints.Add(document.token(head).tag(), token.tag(),
+                                  token.label());
+          }
+        }
+
         // Add characters.
         vector<tensorflow::StringPiece> char_sp;
         SegmenterUtils::GetUTF8Chars(word, &char_sp);
@@ -127,34 +270,144 @@ class LexiconBuilder : public OpKernel {
         // Update the number of processed tokens.
         ++num_tokens;
       }
+    }
 
-      delete document;
-      ++num_documents;
+    // Adds the term maps of the lexicon of the following part of the corpus.
+    void Merge(const Lexicon &other) {
+      words.Merge(other.words);
+      lcwords.Merge(other.lcwords);
+      tags.Merge(other.tags);
+      categories.Merge(other.categories);
+      labels.Merge(other.labels);
+      chars.Merge(other.chars);
+      prefixes.Merge(other.prefixes);
+      suffixes.Merge(other.suffixes);
+      tag_to_category.Merge(other.tag_to_category);
+      label_constraints.Merge(other.label_constraints);
+      num_tokens += other.num_tokens;
     }
-    LOG(INFO) << "Term maps collected over " << num_tokens << " tokens from "
-              << num_documents << " documents";
-
-    // Write mappings to disk.
-    words.Save(TaskContext::InputFile(*task_context_.GetInput("word-map")));
-    lcwords.Save(TaskContext::InputFile(*task_context_.GetInput("lcword-map")));
-    tags.Save(TaskContext::InputFile(*task_context_.GetInput("tag-map")));
-    categories.Save(
-        TaskContext::InputFile(*task_context_.GetInput("category-map")));
-    labels.Save(TaskContext::InputFile(*task_context_.GetInput("label-map")));
-    chars.Save(TaskContext::InputFile(*task_context_.GetInput("char-map")));
 
-    // Write affixes to disk.
-    WriteAffixTable(prefixes, TaskContext::InputFile(
-                                  *task_context_.GetInput("prefix-table")));
-    WriteAffixTable(suffixes, TaskContext::InputFile(
-                                  *task_context_.GetInput("suffix-table")));
+    // Term frequency maps.
+    TermFrequencyMap words;
+    TermFrequencyMap lcwords;
+    TermFrequencyMap tags;
+    TermFrequencyMap categories;
+    TermFrequencyMap labels;
+    TermFrequencyMap chars;
 
-    // Write tag-to-category mapping to disk.
-    tag_to_category.Save(
-        TaskContext::InputFile(*task_context_.GetInput("tag-to-category")));
+    // Affix tables.
+    AffixTable prefixes;
+    AffixTable suffixes;
+
+    // Tag-to-category mapping.
+    TagToCategoryMap tag_to_category;
+
+    // Whether to collect the labels seen between pairs of tags, and the
+    // collected labels.
+    bool collect_label_constraints;
+    ArcLabelConstraints label_constraints;
+
+    // Number of processed tokens.
+    int64 num_tokens = 0;
+  };
+
+  // Adds documents to the lexicon. The documents are split into consecutive
+  // shards, one per worker thread, whose lexicons are collected in parallel
+  // and then merged in order.
+  void AddInParallel(OpKernelContext *context,
+                     const vector<std::unique_ptr<Sentence>> &documents,
+                     Lexicon *lexicon) const {
+    if (documents.empty()) return;
+    const auto &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    const int num_shards = std::min<int64>(
+        std::max(worker_threads.num_threads, 1), documents.size());
+    vector<std::unique_ptr<Lexicon>> shards(num_shards);
+    auto work = [&](int64 begin, int64 end) {
+      for (int64 s = begin; s < end; ++s) {
+        shards[s].reset(new Lexicon(max_prefix_length_, max_suffix_length_,
+                                    label_constraints_));
+        const int64 first = s * documents.size() / num_shards;
+        const int64 last = (s + 1) * documents.size() / num_shards;
+        for (int64 d = first; d < last; ++d) shards[s]->Add(*documents[d]);
+      }
+    };
+    tensorflow::Shard(worker_threads.num_threads, worker_threads.workers,
+                      num_shards, kShardCost * documents.size() / num_shards,
+                      work);
+    for (const auto &shard : shards) lexicon->Merge(*shard);
   }
 
- private:
+  // Loads the saved lexicon to add counts to it. Outputs that do not exist yet
+  // are left empty.
+  void LoadLexicon(Lexicon *lexicon) {
+    tensorflow::Env *env = tensorflow::Env::Default();
+    auto saved_file = [this, env](const string &name, string *file) {
+      *file = TaskContext::InputFile(*task_context_.GetInput(name));
+      return env->FileExists(*file);
+    };
+    string file;
+    for (const auto &term_map :
+         {std::make_pair("word-map", &lexicon->words),
+          std::make_pair("lcword-map", &lexicon->lcwords),
+          std::make_pair("tag-map", &lexicon->tags),
+          std::make_pair("category-map", &lexicon->categories),
+          std::make_pair("label-map", &lexicon->labels),
+          std::make_pair("char-map", &lexicon->chars)}) {
+      if (saved_file(term_map.first, &file)) {
+        term_map.second->LoadForUpdate(file);
+      }
+    }
+    for (const auto &affixes :
+         {std::make_pair("prefix-table", &lexicon->prefixes),
+          std::make_pair("suffix-table", &lexicon->suffixes)}) {
+      if (saved_file(affixes.first, &file)) {
+        const int max_length = affixes.second->max_length();
+        ProtoRecordReader reader(file);
+        affixes.second->Read(&reader);
+        CHECK_EQ(max_length, affixes.second->max_length())
+            << "Saved " << affixes.first << " has another maximum length";
+      }
+    }
+    if (saved_file("tag-to-category", &file)) {
+      lexicon->tag_to_category.Merge(TagToCategoryMap(file));
+    }
+    if (label_constraints_ && saved_file("label-constraints", &file)) {
+      lexicon->label_constraints.Merge(ArcLabelConstraints(file));
+    }
+  }
+
+  // Returns the corpus files listed in the lexicon-shards input, or none if
+  // it does not exist yet.
+  vector<string> ReadShardList() {
+    const string file =
+        TaskContext::InputFile(*task_context_.GetInput("lexicon-shards"));
+    tensorflow::Env *env = tensorflow::Env::Default();
+    vector<string> shards;
+    if (!env->FileExists(file)) return shards;
+    string data;
+    TF_CHECK_OK(ReadFileToString(env, file, &data));
+    for (const string &shard : utils::Split(data, '\n')) {
+      if (!shard.empty()) shards.push_back(shard);
+    }
+    return shards;
+  }
+
+  // Writes the corpus files to the lexicon-shards input, one per line.
+  void WriteShardList(const vector<string> &shards) {
+    string data;
+    for (const string &shard : shards) {
+      tensorflow::strings::StrAppend(&data, shard, "\n");
+    }
+    TF_CHECK_OK(tensorflow::WriteStringToFile(
+        tensorflow::Env::Default(),
+        TaskContext::InputFile(*task_context_.GetInput("lexicon-shards")),
+        data));
+  }
+
+  // Rough cost in cycles of collecting the terms of one document.
+  static const int64 kShardCost = 1000000;
+
   // Returns true if the word contains spaces.
   static bool HasSpaces(const string &word) {
     for (char c : word) {
@@ -163,11 +416,10 @@ class LexiconBuilder : public OpKernel {
     return false;
   }
 
-  // Writes an affix table to a task output.
+  // Writes an affix table to a task output, along with its mapped file.
   static void WriteAffixTable(const AffixTable &affixes,
                               const string &output_file) {
-    ProtoRecordWriter writer(output_file);
-    affixes.Write(&writer);
+    affixes.SaveMapped(output_file);
   }
 
   // Name of the context input to compute lexicons.
@@ -179,6 +431,13 @@ class LexiconBuilder : public OpKernel {
   // Max length for suffix table.
   int max_suffix_length_;
 
+  // Whether the task context has a label-constraints input to save.
+  bool label_constraints_ = false;
+
+  // Whether the task context has a lexicon-shards input listing the counted
+  // corpus files.
+  bool shard_list_ = false;
+
   // Task context used to configure this op.
   TaskContext task_context_;
 };
@@ -208,13 +467,21 @@ class FeatureSize : public OpKernel {
         label_map_path, 0, 0);
   }
 
-  ~FeatureSize() override { SharedStore::Release(label_map_); }
+  ~FeatureSize() override {
+    SharedStore::Release(label_map_);
+    SharedParserFeatures::Release(shared_features_);
+  }
 
   void Compute(OpKernelContext *context) override {
-    // Computes feature sizes.
-    ParserEmbeddingFeatureExtractor features(arg_prefix_);
-    features.Setup(&task_context_);
-    features.Init(&task_context_);
+    mutex_lock lock(mu_);
+
+    // Computes feature sizes. The features are set up on the first run, when
+    // the lexicon they read has been built, and kept for other ops to share.
+    if (shared_features_ == nullptr) {
+      shared_features_ = SharedParserFeatures::Get(arg_prefix_, &task_context_);
+    }
+    const ParserEmbeddingFeatureExtractor &features =
+        shared_features_->features();
     const int num_embeddings = features.NumEmbeddings();
     Tensor *feature_sizes = nullptr;
     Tensor *domain_sizes = nullptr;
@@ -250,8 +517,14 @@ class FeatureSize : public OpKernel {
   // Dependency label map used in transition system.
   const TermFrequencyMap *label_map_;
 
+  // Features of the task, shared with the other ops using them.
+  const SharedParserFeatures *shared_features_ = nullptr;
+
   // Prefix for context parameters.
   string arg_prefix_;
+
+  // mutex to synchronize access to Compute.
+  mutex mu_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("FeatureSize").Device(DEVICE_CPU), FeatureSize);
@@ -90,9 +90,23 @@ class LexiconBuilderTest(test_util.TensorFlowTestCase):
     inp.record_format.append(record_format)
     inp.part.add().file_pattern = file_pattern
 
-  def WriteContext(self, corpus_format):
+  def WriteContext(self, corpus_format, parallel_documents=0,
+                   incremental=False, corpus_pattern=None):
     context = task_spec_pb2.TaskSpec()
-    self.AddInput('documents', self.corpus_file, corpus_format, context)
+    if parallel_documents:
+      param = context.parameter.add()
+      param.name = 'lexicon_parallel_documents'
+      param.value = str(parallel_documents)
+    if incremental:
+      param = context.parameter.add()
+      param.name = 'lexicon_incremental'
+      param.value = 'true'
+    if corpus_pattern:
+      self.AddInput('lexicon-shards',
+                    os.path.join(FLAGS.test_tmpdir, 'lexicon-shards'), '',
+                    context)
+    self.AddInput('documents', corpus_pattern or self.corpus_file,
+                  corpus_format, context)
     for name in ('word-map', 'lcword-map', 'tag-map',
                  'category-map', 'label-map', 'prefix-table',
                  'suffix-table', 'tag-to-category', 'char-map'):
@@ -144,6 +158,10 @@ class LexiconBuilderTest(test_util.TensorFlowTestCase):
           loaded_map[entries[0]] = entries[1]
     return loaded_map
 
+  def LoadMapEntries(self, map_name):
+    with file(os.path.join(FLAGS.test_tmpdir, map_name), 'r') as f:
+      return [tuple(line.split()) for line in f.readlines()[1:]]
+
   def ValidateCharMap(self):
     char_map = self.LoadMap('char-map')
     self.assertEqual(len(char_map), len(CHARS.split(' ')))
@@ -171,6 +189,75 @@ class LexiconBuilderTest(test_util.TensorFlowTestCase):
     self.ValidateCharMap()
     self.ValidateWordMap()
 
+  def ReadLexiconFiles(self):
+    contents = {}
+    for name in ('word-map', 'lcword-map', 'tag-map', 'category-map',
+                 'label-map', 'prefix-table', 'suffix-table', 'tag-to-category',
+                 'char-map'):
+      with open(os.path.join(FLAGS.test_tmpdir, name), 'rb') as f:
+        contents[name] = f.read()
+    return contents
+
+  def testCoNLLFormatInParallel(self):
+    with open(self.corpus_file, 'w') as f:
+      f.write((CONLL_DOC1 + u'\n\n' + CONLL_DOC2 + u'\n\n' + CONLL_DOC1 +
+               u'\n').replace(' ', '\t').encode('utf-8'))
+    self.WriteContext('conll-sentence')
+    self.BuildLexicon()
+    sequential = self.ReadLexiconFiles()
+    for parallel_documents in (1, 2, 5):
+      self.WriteContext('conll-sentence', parallel_documents)
+      self.BuildLexicon()
+      self.assertEqual(sequential, self.ReadLexiconFiles())
+    self.ValidateTagToCategoryMap()
+    self.ValidateCharMap()
+    self.ValidateWordMap()
+
+  def testIncrementalUpdateKeepsIds(self):
+    for name in ('word-map', 'lcword-map', 'tag-map', 'category-map',
+                 'label-map', 'prefix-table', 'suffix-table', 'tag-to-category',
+                 'char-map', 'lexicon-shards'):
+      path = os.path.join(FLAGS.test_tmpdir, name)
+      if os.path.exists(path):
+        os.remove(path)
+    corpus_pattern = self.corpus_file + '-*'
+    for i, doc in enumerate((CONLL_DOC1, CONLL_DOC2)):
+      with open('%s-%d' % (self.corpus_file, i), 'w') as f:
+        f.write((doc + u'\n').replace(' ', '\t').encode('utf-8'))
+
+    # The lexicon of both shards, counted at once.
+    self.WriteContext('conll-sentence', corpus_pattern=corpus_pattern)
+    self.BuildLexicon()
+    full_words = self.LoadMapEntries('word-map')
+    full_tags = self.LoadMapEntries('tag-map')
+
+    # The lexicon of the first shard, then updated with the second one.
+    os.remove(os.path.join(FLAGS.test_tmpdir, 'lexicon-shards'))
+    os.rename('%s-1' % self.corpus_file, '%s.new' % self.corpus_file)
+    self.WriteContext('conll-sentence', incremental=True,
+                      corpus_pattern=corpus_pattern)
+    self.BuildLexicon()
+    first_words = self.LoadMapEntries('word-map')
+    first_tags = self.LoadMapEntries('tag-map')
+    os.rename('%s.new' % self.corpus_file, '%s-1' % self.corpus_file)
+    self.BuildLexicon()
+    updated = self.ReadLexiconFiles()
+    words = self.LoadMapEntries('word-map')
+    tags = self.LoadMapEntries('tag-map')
+
+    # The terms of the first shard keep their ids, with the counts of both.
+    self.assertEqual([term for term, _ in first_words],
+                     [term for term, _ in words[:len(first_words)]])
+    self.assertEqual([term for term, _ in first_tags],
+                     [term for term, _ in tags[:len(first_tags)]])
+    self.assertEqual(dict(full_words), dict(words))
+    self.assertEqual(dict(full_tags), dict(tags))
+    self.ValidateTagToCategoryMap()
+
+    # Counted shards are not counted again.
+    self.BuildLexicon()
+    self.assertEqual(updated, self.ReadLexiconFiles())
+
   def testCoNLLFormatExtraNewlinesAndComments(self):
     self.WriteContext('conll-sentence')
     with open(self.corpus_file, 'w') as f:
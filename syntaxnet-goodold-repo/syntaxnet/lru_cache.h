@@ -0,0 +1,97 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// A thread-safe, string-keyed cache of bounded size.
+
+#ifndef SYNTAXNET_LRU_CACHE_H_
+#define SYNTAXNET_LRU_CACHE_H_
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "syntaxnet/utils.h"
+
+namespace syntaxnet {
+
+// Caches values by string key, evicting the least recently used entry when
+// full. This is used to skip the lookups of very frequent tokens.
+template <class V>
+class LruCache {
+ public:
+  // Creates a cache holding at most the given number of entries.
+  explicit LruCache(int capacity) : capacity_(capacity) {
+    CHECK_GT(capacity_, 0);
+  }
+
+  // Looks up the value for the key, marking it as most recently used. Returns
+  // false if the key is not cached.
+  bool Lookup(StringPiece key, V *value) {
+    mutex_lock lock(mu_);
+    auto it = index_.find(key);
+    if (it == index_.end()) return false;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    *value = it->second->second;
+    return true;
+  }
+
+  // Caches the value for the key, evicting the least recently used entry if the
+  // cache is full.
+  void Insert(StringPiece key, const V &value) {
+    mutex_lock lock(mu_);
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      it->second->second = value;
+      entries_.splice(entries_.begin(), entries_, it->second);
+      return;
+    }
+    if (static_cast<int>(index_.size()) == capacity_) {
+      index_.erase(entries_.back().first);
+      entries_.pop_back();
+    }
+    entries_.emplace_front(key.ToString(), value);
+    index_[entries_.front().first] = entries_.begin();
+  }
+
+  // Returns the number of cached entries.
+  int size() const {
+    mutex_lock lock(mu_);
+    return index_.size();
+  }
+
+ private:
+  typedef std::list<pair<string, V>> Entries;
+
+  // Maximum number of entries.
+  const int capacity_;
+
+  // Mutex guarding the entries.
+  mutable mutex mu_;
+
+  // Cached entries, most recently used first.
+  Entries entries_;
+
+  // Index of the entries, keyed on the strings of the entries.
+  std::unordered_map<StringPiece, typename Entries::iterator,
+                     StringPiece::Hasher>
+      index_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(LruCache);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_LRU_CACHE_H_
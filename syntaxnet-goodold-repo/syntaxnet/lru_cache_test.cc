@@ -0,0 +1,64 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/lru_cache.h"
+
+#include <string>
+
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+TEST(LruCacheTest, CachesInsertedValues) {
+  LruCache<int> cache(2);
+  int value = 0;
+  EXPECT_FALSE(cache.Lookup("a", &value));
+  cache.Insert("a", 1);
+  cache.Insert("b", 2);
+  EXPECT_TRUE(cache.Lookup("a", &value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(cache.Lookup("b", &value));
+  EXPECT_EQ(2, value);
+  EXPECT_EQ(2, cache.size());
+}
+
+TEST(LruCacheTest, EvictsLeastRecentlyUsedEntries) {
+  LruCache<int> cache(2);
+  int value = 0;
+  cache.Insert("a", 1);
+  cache.Insert("b", 2);
+  EXPECT_TRUE(cache.Lookup("a", &value));
+  cache.Insert("c", 3);
+  EXPECT_EQ(2, cache.size());
+  EXPECT_FALSE(cache.Lookup("b", &value));
+  EXPECT_TRUE(cache.Lookup("a", &value));
+  EXPECT_TRUE(cache.Lookup("c", &value));
+}
+
+TEST(LruCacheTest, ReinsertingUpdatesValues) {
+  LruCache<int> cache(2);
+  int value = 0;
+  cache.Insert("a", 1);
+  cache.Insert("b", 2);
+  cache.Insert("a", 3);
+  cache.Insert("c", 4);
+  EXPECT_FALSE(cache.Lookup("b", &value));
+  EXPECT_TRUE(cache.Lookup("a", &value));
+  EXPECT_EQ(3, value);
+}
+
+}  // namespace syntaxnet
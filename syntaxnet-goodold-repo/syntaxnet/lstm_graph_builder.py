@@ -0,0 +1,201 @@
+# Copyright 2016 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+"""Build taggers scoring whole sentences with a bidirectional LSTM."""
+
+import tensorflow as tf
+
+from tensorflow.contrib.rnn.python.ops import lstm_ops
+
+from syntaxnet import graph_builder
+from syntaxnet.ops import gen_parser_ops
+
+
+class LSTMTagger(graph_builder.GreedyParser):
+  """Extends the GreedyParser with a fused BiLSTM over whole sentences.
+
+  The GoldSequenceReader emits the features of all the steps of a batch of
+  sentences at once, e.g. of every token for the tagger transition system.
+  Their embeddings run through one FusedLSTM op forward and one backward over
+  the reversed sentences, and the concatenated outputs of each step are
+  scored by a softmax layer, so a batch takes a few large kernels rather than
+  one network step per token. The features should only depend on the input,
+  not on the actions of earlier steps, since all steps follow gold actions.
+
+  The constructor takes two additional keyword arguments.
+  lstm_size: the number of units of each LSTM direction.
+  max_length: the number of steps of a sentence scored together; longer
+    sentences are scored in chunks of that many steps.
+
+  The hidden_layer_sizes of the GreedyParser are not used.
+  """
+
+  def __init__(self, *args, **kwargs):
+    self._lstm_size = kwargs.pop('lstm_size', 128)
+    self._max_length = kwargs.pop('max_length', 64)
+    super(LSTMTagger, self).__init__(*args, **kwargs)
+
+  def _AddSequenceReader(self, task_context, batch_size, corpus_name):
+    features, epochs, gold_actions, lengths = (
+        gen_parser_ops.gold_sequence_reader(task_context,
+                                            self._feature_size,
+                                            batch_size,
+                                            self._max_length,
+                                            corpus_name=corpus_name,
+                                            arg_prefix=self._arg_prefix))
+    return {'gold_actions': tf.identity(gold_actions, name='gold_actions'),
+            'epochs': tf.identity(epochs, name='epochs'),
+            'lengths': tf.identity(lengths, name='lengths'),
+            'feature_endpoints': features}
+
+  def _AddLSTM(self, inputs, lengths, name, return_average=False):
+    """Runs a FusedLSTM over the [batch, max_length, input size] inputs.
+
+    Returns:
+      the [batch, max_length, lstm_size] outputs, zero past the longest of
+      the lengths.
+    """
+    input_size = inputs.get_shape()[2].value
+    weights = self._AddParam(
+        [input_size + self._lstm_size, 4 * self._lstm_size],
+        tf.float32,
+        name + '_weights',
+        tf.random_normal_initializer(stddev=1.0 / input_size**.5,
+                                     seed=self._seed),
+        return_average=return_average)
+    bias = self._AddParam([4 * self._lstm_size],
+                          tf.float32,
+                          name + '_bias',
+                          tf.zeros_initializer,
+                          return_average=return_average)
+    steps = tf.unpack(tf.transpose(inputs, [1, 0, 2]))
+    seq_len_max = tf.cast(tf.reduce_max(lengths), tf.int64)
+    # pylint: disable=protected-access
+    outputs = lstm_ops._fused_lstm(seq_len_max, steps, weights, bias)[-1]
+    # pylint: enable=protected-access
+    return tf.transpose(tf.pack(outputs), [1, 0, 2])
+
+  def _BuildSequenceNetwork(self, feature_endpoints, batch_size, lengths,
+                            return_average=False):
+    """Returns the [batch * max_length, num_actions] logits of every step."""
+    embeddings = []
+    for i in range(self._feature_size):
+      embeddings.append(self._AddEmbedding(feature_endpoints[i],
+                                           self._num_features[i],
+                                           self._num_feature_ids[i],
+                                           self._embedding_sizes[i],
+                                           i,
+                                           return_average=return_average))
+    inputs = tf.reshape(tf.concat(1, embeddings),
+                        [batch_size, self._max_length, self.embedding_size])
+
+    # The backward LSTM reads each sentence reversed up to its length, so in
+    # both directions the padding past a length only follows the steps of the
+    # sentence, and only affects the outputs past the length, which the cost
+    # and the metrics mask out.
+    seq_lengths = tf.cast(lengths, tf.int64)
+    forward = self._AddLSTM(inputs, lengths, 'lstm_forward',
+                            return_average=return_average)
+    backward = tf.reverse_sequence(
+        self._AddLSTM(tf.reverse_sequence(inputs, seq_lengths, 1, 0), lengths,
+                      'lstm_backward', return_average=return_average),
+        seq_lengths, 1, 0)
+    outputs = tf.reshape(tf.concat(2, [forward, backward]),
+                         [-1, 2 * self._lstm_size])
+
+    softmax_weight = self._AddParam(
+        [2 * self._lstm_size, self._num_actions],
+        tf.float32,
+        'softmax_weight',
+        tf.random_normal_initializer(stddev=self._softmax_init,
+                                     seed=self._seed),
+        return_average=return_average)
+    softmax_bias = self._AddParam([self._num_actions],
+                                  tf.float32,
+                                  'softmax_bias',
+                                  tf.zeros_initializer,
+                                  return_average=return_average)
+    return {'logits': tf.nn.xw_plus_b(outputs, softmax_weight, softmax_bias,
+                                      name='logits')}
+
+  def _StepMask(self, lengths):
+    """Returns 1.0 for the steps within lengths and 0.0 past them, flattened."""
+    steps = tf.expand_dims(tf.range(self._max_length), 0)
+    mask = tf.less(steps, tf.expand_dims(lengths, 1))
+    return tf.reshape(tf.cast(mask, tf.float32), [-1])
+
+  def AddTraining(self,
+                  task_context,
+                  batch_size,
+                  learning_rate=0.1,
+                  decay_steps=4000,
+                  momentum=0.9,
+                  corpus_name='documents'):
+    """Builds a trainer minimizing the cross entropy of every gold step."""
+    with tf.name_scope('training'):
+      nodes = self.training
+      nodes.update(self._AddSequenceReader(task_context, batch_size,
+                                           corpus_name))
+      nodes.update(self._BuildSequenceNetwork(nodes['feature_endpoints'],
+                                              batch_size, nodes['lengths']))
+      mask = self._StepMask(nodes['lengths'])
+      cross_entropies = tf.nn.sparse_softmax_cross_entropy_with_logits(
+          nodes['logits'], tf.reshape(nodes['gold_actions'], [-1]))
+      nodes['cost'] = tf.div(tf.reduce_sum(cross_entropies * mask),
+                             tf.maximum(tf.reduce_sum(mask), 1.0),
+                             name='cost')
+      trainable_params = self.params.values()
+      lr = self._AddLearningRate(learning_rate, decay_steps)
+      optimizer = tf.train.MomentumOptimizer(lr,
+                                             momentum,
+                                             use_locking=self._use_locking,
+                                             sum_duplicate_indices=True)
+      train_ops = [self._Minimize(optimizer, nodes['cost'], trainable_params)]
+      if self._check_parameters:
+        train_ops.append(tf.group(*[
+            tf.check_numerics(param, message='Parameter is not finite.')
+            for param in trainable_params]))
+      if self._use_averaging:
+        train_ops.append(tf.group(*self._averaging.values()))
+      nodes['train_op'] = tf.group(*train_ops, name='train_op')
+    return nodes
+
+  def AddEvaluation(self,
+                    task_context,
+                    batch_size,
+                    corpus_name='documents',
+                    **unused_kwargs):
+    """Builds the forward network, counting the steps tagged correctly.
+
+    Returns:
+      Dictionary of named eval nodes, with 'eval_metrics' holding the number
+      of steps and the number of correctly predicted gold actions.
+    """
+    with tf.name_scope('evaluation'):
+      nodes = self.evaluation
+      nodes.update(self._AddSequenceReader(task_context, batch_size,
+                                           corpus_name))
+      nodes.update(self._BuildSequenceNetwork(
+          nodes['feature_endpoints'], batch_size, nodes['lengths'],
+          return_average=self._use_averaging))
+      mask = self._StepMask(nodes['lengths'])
+      correct = tf.cast(tf.equal(tf.cast(tf.argmax(nodes['logits'], 1),
+                                         tf.int32),
+                                 tf.reshape(nodes['gold_actions'], [-1])),
+                        tf.float32)
+      nodes['eval_metrics'] = tf.cast(
+          tf.pack([tf.reduce_sum(mask), tf.reduce_sum(correct * mask)]),
+          tf.int32, name='eval_metrics')
+    return nodes
@@ -0,0 +1,55 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/mapped_file.h"
+
+#include <string.h>
+
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace syntaxnet {
+
+MappedFile::MappedFile(const string &filename) {
+  tensorflow::Env *env = tensorflow::Env::Default();
+  if (env->NewReadOnlyMemoryRegionFromFile(filename, &region_).ok()) {
+    contents_.set(region_->data(), region_->length());
+    VLOG(1) << "Mapped " << contents_.size() << " bytes of " << filename;
+  } else {
+    region_.reset();
+    TF_CHECK_OK(tensorflow::ReadFileToString(env, filename, &buffer_));
+    contents_ = buffer_;
+  }
+}
+
+tensorflow::Status MappedFile::ReadLine(string *line) {
+  line->clear();
+  if (offset_ >= contents_.size()) {
+    return tensorflow::errors::OutOfRange("End of file reached");
+  }
+  const char *start = contents_.data() + offset_;
+  const void *newline = memchr(start, '\n', contents_.size() - offset_);
+  const size_t end =
+      newline == nullptr
+          ? contents_.size()
+          : static_cast<const char *>(newline) - contents_.data();
+  line->reserve(end - offset_);
+  for (size_t i = offset_; i < end; ++i) {
+    if (contents_[i] != '\r') line->push_back(contents_[i]);
+  }
+  offset_ = end + 1;
+  return tensorflow::Status::OK();
+}
+
+}  // namespace syntaxnet
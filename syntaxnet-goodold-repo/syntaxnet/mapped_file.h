@@ -0,0 +1,69 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Read-only resource files consumed in place from a memory mapping.
+
+#ifndef SYNTAXNET_MAPPED_FILE_H_
+#define SYNTAXNET_MAPPED_FILE_H_
+
+#include <memory>
+#include <string>
+
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace syntaxnet {
+
+// The contents of a resource file like a lexicon or a row order. The file is
+// mapped read-only through Env::NewReadOnlyMemoryRegionFromFile(), so that the
+// processes loading the same file share its pages in the page cache, and
+// loading it on a host where it is cached does not read or copy it. Files the
+// file system cannot map, e.g. remote or empty ones, are read into memory.
+class MappedFile {
+ public:
+  // Maps or reads the file with the given name. CHECK-fails if the file cannot
+  // be read.
+  explicit MappedFile(const string &filename);
+
+  // Returns the contents of the file, which live as long as this.
+  tensorflow::StringPiece contents() const { return contents_; }
+
+  // Returns true if the contents are mapped rather than a private copy.
+  bool mapped() const { return region_ != nullptr; }
+
+  // Reads the next line into "line", without its '\n' and any '\r'
+  // characters, like InputBuffer::ReadLine(). Returns OUT_OF_RANGE after the
+  // last line.
+  tensorflow::Status ReadLine(string *line);
+
+ private:
+  // Mapping of the file, or null if the file was read into buffer_.
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region_;
+  string buffer_;
+
+  // Contents of the file, in region_ or in buffer_.
+  tensorflow::StringPiece contents_;
+
+  // Offset of the next line in the contents.
+  size_t offset_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_MAPPED_FILE_H_
@@ -0,0 +1,75 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/mapped_file.h"
+
+#include <string>
+
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+// Writes the given contents to a file under the test temporary directory and
+// returns its path.
+string WriteFile(const string &name, const string &contents) {
+  const string path = utils::JoinPath({tensorflow::testing::TmpDir(), name});
+  TF_CHECK_OK(tensorflow::WriteStringToFile(tensorflow::Env::Default(), path,
+                                            contents));
+  return path;
+}
+
+TEST(MappedFileTest, MapsContents) {
+  const MappedFile file(WriteFile("contents", "a b\nc"));
+  EXPECT_TRUE(file.mapped());
+  EXPECT_EQ("a b\nc", file.contents().ToString());
+}
+
+TEST(MappedFileTest, ReadsEmptyFile) {
+  MappedFile file(WriteFile("empty", ""));
+  EXPECT_EQ("", file.contents().ToString());
+  string line = "x";
+  EXPECT_TRUE(tensorflow::errors::IsOutOfRange(file.ReadLine(&line)));
+  EXPECT_EQ("", line);
+}
+
+TEST(MappedFileTest, ReadsLinesLikeInputBuffer) {
+  MappedFile file(WriteFile("lines", "first\r\n\nthird\nlast"));
+  string line;
+  EXPECT_TRUE(file.ReadLine(&line).ok());
+  EXPECT_EQ("first", line);
+  EXPECT_TRUE(file.ReadLine(&line).ok());
+  EXPECT_EQ("", line);
+  EXPECT_TRUE(file.ReadLine(&line).ok());
+  EXPECT_EQ("third", line);
+  EXPECT_TRUE(file.ReadLine(&line).ok());
+  EXPECT_EQ("last", line);
+  EXPECT_TRUE(tensorflow::errors::IsOutOfRange(file.ReadLine(&line)));
+}
+
+TEST(MappedFileTest, TrailingNewlineEndsTheLastLine) {
+  MappedFile file(WriteFile("newline", "only\n"));
+  string line;
+  EXPECT_TRUE(file.ReadLine(&line).ok());
+  EXPECT_EQ("only", line);
+  EXPECT_TRUE(tensorflow::errors::IsOutOfRange(file.ReadLine(&line)));
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,232 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/memory_report.h"
+
+#if defined(__GNUG__)
+#include <cxxabi.h>
+#endif
+
+#include <stdlib.h>
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <utility>
+
+#include "syntaxnet/embedding_feature_extractor.h"
+#include "syntaxnet/parser_state.h"
+#include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/sentence_batch.h"
+#include "syntaxnet/shared_store.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/term_frequency_map.h"
+#include "syntaxnet/workspace.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/util/tensor_slice_reader.h"
+
+namespace syntaxnet {
+namespace {
+
+// Returns the readable form of a mangled type name.
+string DemangledTypeName(const string &mangled) {
+#if defined(__GNUG__)
+  int status = 0;
+  char *demangled =
+      abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+  if (status == 0 && demangled != nullptr) {
+    const string result(demangled);
+    free(demangled);
+    return result;
+  }
+#endif
+  return mangled;
+}
+
+// Returns the type and name of each object in the SharedStore.
+std::set<std::pair<string, string>> SharedObjectKeys() {
+  std::set<std::pair<string, string>> keys;
+  for (const SharedStore::ObjectInfo &object : SharedStore::Objects()) {
+    keys.emplace(object.type, object.name);
+  }
+  return keys;
+}
+
+// Adds the objects in the SharedStore whose keys are not in *keys to the
+// report and to *keys, and returns their total bytes.
+int64 AddNewSharedObjects(std::set<std::pair<string, string>> *keys,
+                          MemoryReport *report) {
+  int64 bytes = 0;
+  for (const SharedStore::ObjectInfo &object : SharedStore::Objects()) {
+    if (!keys->emplace(object.type, object.name).second) continue;
+    report->Add("shared",
+                tensorflow::strings::StrCat(DemangledTypeName(object.type),
+                                            " ", object.name),
+                object.bytes);
+    bytes += object.bytes;
+  }
+  return bytes;
+}
+
+// Adds the variables of the checkpoint at model_path to the report.
+tensorflow::Status AddVariables(const string &model_path,
+                                MemoryReport *report) {
+  tensorflow::checkpoint::TensorSliceReader reader(model_path);
+  TF_RETURN_IF_ERROR(reader.status());
+  for (const auto &variable : reader.GetVariableToShapeMap()) {
+    tensorflow::TensorShape shape;
+    tensorflow::DataType type;
+    if (!reader.HasTensor(variable.first, &shape, &type)) continue;
+    report->Add("variable",
+                tensorflow::strings::StrCat(variable.first, " ",
+                                            shape.DebugString()),
+                shape.num_elements() * tensorflow::DataTypeSize(type));
+  }
+  return tensorflow::Status::OK();
+}
+
+}  // namespace
+
+void MemoryReport::Add(const string &kind, const string &name, int64 bytes) {
+  items_.push_back({kind, name, bytes});
+}
+
+int64 MemoryReport::TotalBytes() const {
+  int64 total = 0;
+  for (const MemoryReportItem &item : items_) total += item.bytes;
+  return total;
+}
+
+string MemoryReport::ToString() const {
+  // The kinds keep the order they were first added in.
+  std::vector<string> kinds;
+  for (const MemoryReportItem &item : items_) {
+    if (std::find(kinds.begin(), kinds.end(), item.kind) == kinds.end()) {
+      kinds.push_back(item.kind);
+    }
+  }
+  string result;
+  for (const string &kind : kinds) {
+    std::vector<const MemoryReportItem *> items;
+    int64 kind_bytes = 0;
+    for (const MemoryReportItem &item : items_) {
+      if (item.kind != kind) continue;
+      items.push_back(&item);
+      kind_bytes += item.bytes;
+    }
+    std::stable_sort(
+        items.begin(), items.end(),
+        [](const MemoryReportItem *a, const MemoryReportItem *b) {
+          return a->bytes > b->bytes;
+        });
+    tensorflow::strings::Appendf(&result, "%s: %lld bytes\n", kind.c_str(),
+                                 kind_bytes);
+    for (const MemoryReportItem *item : items) {
+      tensorflow::strings::Appendf(&result, "  %14lld  %s\n", item->bytes,
+                                   item->name.c_str());
+    }
+  }
+  tensorflow::strings::Appendf(&result, "total: %lld bytes\n", TotalBytes());
+  return result;
+}
+
+tensorflow::Status ReportModelMemory(const string &task_context_path,
+                                     const string &arg_prefix,
+                                     const string &model_path,
+                                     const string &corpus_name,
+                                     int batch_size, MemoryReport *report) {
+  if (!model_path.empty()) {
+    TF_RETURN_IF_ERROR(AddVariables(model_path, report));
+  }
+
+  TaskContext context;
+  string data;
+  TF_RETURN_IF_ERROR(tensorflow::ReadFileToString(
+      tensorflow::Env::Default(), task_context_path, &data));
+  if (!TextFormat::ParseFromString(data, context.mutable_spec())) {
+    return tensorflow::errors::InvalidArgument(
+        "Could not parse task context at ", task_context_path);
+  }
+
+  // The features and the transition system are reported without the shared
+  // objects they load, which are reported on their own.
+  std::set<std::pair<string, string>> shared_keys = SharedObjectKeys();
+  int64 heap_bytes = utils::HeapBytesInUse();
+  const SharedParserFeatures *shared_features =
+      SharedParserFeatures::Get(arg_prefix, &context);
+  const ParserEmbeddingFeatureExtractor &features = shared_features->features();
+  int64 bytes = utils::HeapBytesInUse() - heap_bytes;
+  report->Add("features", arg_prefix,
+              bytes - AddNewSharedObjects(&shared_keys, report));
+
+  heap_bytes = utils::HeapBytesInUse();
+  const string transition_system_name = context.Get(
+      features.GetParamName("transition_system"), "arc-standard");
+  std::unique_ptr<ParserTransitionSystem> transition_system(
+      ParserTransitionSystem::Create(transition_system_name));
+  transition_system->Setup(&context);
+  transition_system->Init(&context);
+  const string label_map_path =
+      TaskContext::InputFile(*context.GetInput("label-map"));
+  const TermFrequencyMap *label_map =
+      SharedStoreUtils::GetWithDefaultName<TermFrequencyMap>(label_map_path,
+                                                             0, 0);
+  bytes = utils::HeapBytesInUse() - heap_bytes;
+  report->Add("transition system", transition_system_name,
+              bytes - AddNewSharedObjects(&shared_keys, report));
+
+  if (!corpus_name.empty()) {
+    heap_bytes = utils::HeapBytesInUse();
+    SentenceBatch sentence_batch(batch_size, corpus_name);
+    sentence_batch.Init(&context);
+    std::vector<bool> has_sentence(batch_size);
+    int num_sentences = 0;
+    for (int i = 0; i < batch_size; ++i) {
+      has_sentence[i] = sentence_batch.AdvanceSentence(i);
+      if (has_sentence[i]) ++num_sentences;
+    }
+    report->Add("batch",
+                tensorflow::strings::StrCat(num_sentences, " sentences of ",
+                                            corpus_name),
+                utils::HeapBytesInUse() - heap_bytes);
+
+    heap_bytes = utils::HeapBytesInUse();
+    std::vector<std::unique_ptr<ParserState>> states(batch_size);
+    std::vector<WorkspaceSet> workspaces(batch_size);
+    for (int i = 0; i < batch_size; ++i) {
+      if (!has_sentence[i]) continue;
+      states[i].reset(new ParserState(
+          sentence_batch.sentence(i),
+          transition_system->NewTransitionState(true), label_map));
+      workspaces[i].Reset(shared_features->registry());
+      features.Preprocess(&workspaces[i], states[i].get());
+    }
+    report->Add("batch",
+                tensorflow::strings::StrCat(num_sentences,
+                                            " parser states and workspaces"),
+                utils::HeapBytesInUse() - heap_bytes);
+  }
+
+  transition_system.reset();
+  SharedStore::Release(label_map);
+  SharedParserFeatures::Release(shared_features);
+  return tensorflow::Status::OK();
+}
+
+}  // namespace syntaxnet
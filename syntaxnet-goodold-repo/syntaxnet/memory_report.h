@@ -0,0 +1,85 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Reports of the memory the resources of a model take, for planning how many
+// models fit on a host: the term maps, affix tables and other objects that
+// ops share through the SharedStore, the feature extractors and transition
+// system of a task context, the variables of the model, and the sentences,
+// parser states and workspaces of a batch.
+//
+// Sizes other than those of variables are the growth of the heap while the
+// resources are created, see utils::HeapBytesInUse(), so reports are only
+// meaningful with the heap allocator of glibc and when no other threads
+// allocate meanwhile. Static tables, like those of CharProperty, are created
+// before main() and not reported.
+
+#ifndef SYNTAXNET_MEMORY_REPORT_H_
+#define SYNTAXNET_MEMORY_REPORT_H_
+
+#include <string>
+#include <vector>
+
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace syntaxnet {
+
+// Memory of one resource.
+struct MemoryReportItem {
+  // Kind of the resource, e.g. "shared" or "variable", and its name.
+  string kind;
+  string name;
+  int64 bytes;
+};
+
+class MemoryReport {
+ public:
+  MemoryReport() {}
+
+  void Add(const string &kind, const string &name, int64 bytes);
+
+  const std::vector<MemoryReportItem> &items() const { return items_; }
+
+  // Returns the total bytes of the items.
+  int64 TotalBytes() const;
+
+  // Returns a table of the items by kind, with the largest first, and the
+  // total bytes of each kind and of the report.
+  string ToString() const;
+
+ private:
+  std::vector<MemoryReportItem> items_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MemoryReport);
+};
+
+// Adds the memory of the resources of a model to the report:
+//   - the features and transition system of arg_prefix set up on the task
+//     context at task_context_path, along with the SharedStore objects they
+//     load,
+//   - if model_path is not empty, the variables of the checkpoint at
+//     model_path,
+//   - if corpus_name is not empty, the first batch_size sentences of that
+//     input of the task context, and their parser states and workspaces.
+// The resources are released before returning.
+tensorflow::Status ReportModelMemory(const string &task_context_path,
+                                     const string &arg_prefix,
+                                     const string &model_path,
+                                     const string &corpus_name,
+                                     int batch_size, MemoryReport *report);
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_MEMORY_REPORT_H_
@@ -0,0 +1,56 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Prints how much memory the resources of a model take, see memory_report.h.
+//
+// Usage: memory_report_main --task_context=<file> [--arg_prefix=brain_parser]
+//            [--model_path=<checkpoint>] [--input=<corpus name>]
+//            [--batch_size=32]
+
+#include <iostream>
+#include <string>
+
+#include "syntaxnet/memory_report.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+int main(int argc, char **argv) {
+  string task_context;
+  string arg_prefix = "brain_parser";
+  string model_path;
+  string input;
+  tensorflow::int32 batch_size = 32;
+  const bool parsed_flags_ok = tensorflow::ParseFlags(
+      &argc, argv, {tensorflow::Flag("task_context", &task_context),
+                    tensorflow::Flag("arg_prefix", &arg_prefix),
+                    tensorflow::Flag("model_path", &model_path),
+                    tensorflow::Flag("input", &input),
+                    tensorflow::Flag("batch_size", &batch_size)});
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parsed_flags_ok || task_context.empty() || batch_size < 1) {
+    LOG(ERROR) << "Usage: " << argv[0] << " --task_context=<file> "
+               << "[--arg_prefix=brain_parser] [--model_path=<checkpoint>] "
+               << "[--input=<corpus name>] [--batch_size=32]";
+    return 1;
+  }
+
+  syntaxnet::MemoryReport report;
+  TF_CHECK_OK(syntaxnet::ReportModelMemory(task_context, arg_prefix,
+                                           model_path, input, batch_size,
+                                           &report));
+  std::cout << report.ToString();
+  return 0;
+}
@@ -0,0 +1,47 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/memory_report.h"
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+TEST(MemoryReportTest, ToStringGroupsKindsLargestFirst) {
+  MemoryReport report;
+  report.Add("shared", "word map", 100);
+  report.Add("variable", "weights_0 [10,20]", 800);
+  report.Add("shared", "affix table", 300);
+  EXPECT_EQ(1200, report.TotalBytes());
+  EXPECT_EQ(
+      "shared: 400 bytes\n"
+      "             300  affix table\n"
+      "             100  word map\n"
+      "variable: 800 bytes\n"
+      "             800  weights_0 [10,20]\n"
+      "total: 1200 bytes\n",
+      report.ToString());
+}
+
+TEST(MemoryReportTest, MissingTaskContext) {
+  MemoryReport report;
+  EXPECT_FALSE(ReportModelMemory("/nonexistent/context", "brain_parser", "",
+                                 "", 1, &report)
+                   .ok());
+  EXPECT_TRUE(report.items().empty());
+}
+
+}  // namespace syntaxnet
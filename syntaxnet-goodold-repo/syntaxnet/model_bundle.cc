@@ -0,0 +1,381 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/model_bundle.h"
+
+#include <ctype.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "syntaxnet/task_spec.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor.pb.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/util/memmapped_file_system.h"
+#include "tensorflow/core/util/memmapped_file_system_writer.h"
+
+namespace syntaxnet {
+
+using tensorflow::Env;
+using tensorflow::MemmappedFileSystem;
+using tensorflow::MemmappedFileSystemWriter;
+using tensorflow::RandomAccessFile;
+using tensorflow::ReadOnlyMemoryRegion;
+using tensorflow::Status;
+using tensorflow::Tensor;
+using tensorflow::strings::StrCat;
+
+const char kModelBundleContext[] = "context.pbtxt";
+const char kModelBundleGraph[] = "graph.pb";
+
+namespace {
+
+// Scheme of the file system serving the elements of bundles.
+const char kModelBundlePrefix[] = "modelbundle://";
+
+// Returns the name of an element in the memmapped package.
+string RegionName(const string &element) {
+  return StrCat(MemmappedFileSystem::kMemmappedPackagePrefix, element);
+}
+
+// Replaces the characters that element names may not contain with '_'.
+string SanitizeElementName(const string &name) {
+  string result = name;
+  for (char &c : result) {
+    if (!isalnum(static_cast<unsigned char>(c)) && c != '.') c = '_';
+  }
+  return result;
+}
+
+// Splits a path of the bundle file system into the bundle path and the element
+// name, which cannot contain slashes.
+Status SplitBundlePath(const string &path, string *bundle_path,
+                       string *element) {
+  const size_t start = strlen(kModelBundlePrefix);
+  const size_t slash = path.rfind('/');
+  if (!StringPiece(path).starts_with(kModelBundlePrefix) ||
+      slash == string::npos || slash <= start || slash + 1 == path.size()) {
+    return tensorflow::errors::InvalidArgument("Not a model bundle path: ",
+                                               path);
+  }
+  *bundle_path = path.substr(start, slash - start);
+  *element = path.substr(slash + 1);
+  return Status::OK();
+}
+
+// Saves the contents of a file as an element of the bundle.
+Status SaveContents(const string &contents, const string &element,
+                    MemmappedFileSystemWriter *writer) {
+  // The writer rejects empty tensors, but an empty message makes an empty
+  // element as well.
+  if (contents.empty()) {
+    return writer->SaveProtobuf(TaskSpec(), RegionName(element));
+  }
+  Tensor tensor(tensorflow::DT_UINT8,
+                tensorflow::TensorShape({static_cast<int64>(contents.size())}));
+  memcpy(tensor.flat<uint8>().data(), contents.data(), contents.size());
+  return writer->SaveTensor(tensor, RegionName(element));
+}
+
+// File over a string, for the task context with resolved inputs.
+class StringFile : public RandomAccessFile {
+ public:
+  explicit StringFile(const string &contents) : contents_(contents) {}
+
+  Status Read(uint64 offset, size_t n, StringPiece *result,
+              char *scratch) const override {
+    if (offset >= contents_.size()) {
+      *result = StringPiece();
+      return tensorflow::errors::OutOfRange("Read past the end of the file");
+    }
+    *result = StringPiece(contents_.data() + offset,
+                          std::min<uint64>(n, contents_.size() - offset));
+    if (result->size() < n) {
+      return tensorflow::errors::OutOfRange("Read fewer bytes than requested");
+    }
+    return Status::OK();
+  }
+
+ private:
+  const string contents_;
+};
+
+// Read-only file system over the elements of bundles. Bundles are mapped on
+// first use and stay mapped for the lifetime of the process, since the
+// memory regions of ImmutableConst nodes point into them.
+class ModelBundleFileSystem : public tensorflow::FileSystem {
+ public:
+  ModelBundleFileSystem() {}
+
+  Status NewRandomAccessFile(
+      const string &fname, std::unique_ptr<RandomAccessFile> *result) override {
+    string element;
+    MemmappedFileSystem *bundle;
+    TF_RETURN_IF_ERROR(OpenElement(fname, &bundle, &element));
+    if (element == kModelBundleContext) {
+      string contents;
+      TF_RETURN_IF_ERROR(ReadContext(fname, bundle, &contents));
+      result->reset(new StringFile(contents));
+      return Status::OK();
+    }
+    return bundle->NewRandomAccessFile(RegionName(element), result);
+  }
+
+  Status NewReadOnlyMemoryRegionFromFile(
+      const string &fname,
+      std::unique_ptr<ReadOnlyMemoryRegion> *result) override {
+    string element;
+    MemmappedFileSystem *bundle;
+    TF_RETURN_IF_ERROR(OpenElement(fname, &bundle, &element));
+    return bundle->NewReadOnlyMemoryRegionFromFile(RegionName(element),
+                                                   result);
+  }
+
+  bool FileExists(const string &fname) override {
+    string element;
+    MemmappedFileSystem *bundle;
+    return OpenElement(fname, &bundle, &element).ok() &&
+           bundle->FileExists(RegionName(element));
+  }
+
+  Status GetFileSize(const string &fname, uint64 *file_size) override {
+    string element;
+    MemmappedFileSystem *bundle;
+    TF_RETURN_IF_ERROR(OpenElement(fname, &bundle, &element));
+    if (element == kModelBundleContext) {
+      string contents;
+      TF_RETURN_IF_ERROR(ReadContext(fname, bundle, &contents));
+      *file_size = contents.size();
+      return Status::OK();
+    }
+    return bundle->GetFileSize(RegionName(element), file_size);
+  }
+
+  Status Stat(const string &fname,
+              tensorflow::FileStatistics *stat) override {
+    uint64 size;
+    TF_RETURN_IF_ERROR(GetFileSize(fname, &size));
+    stat->length = size;
+    return Status::OK();
+  }
+
+  Status NewWritableFile(
+      const string &fname,
+      std::unique_ptr<tensorflow::WritableFile> *result) override {
+    return ReadOnly();
+  }
+  Status NewAppendableFile(
+      const string &fname,
+      std::unique_ptr<tensorflow::WritableFile> *result) override {
+    return ReadOnly();
+  }
+  Status GetChildren(const string &dir, std::vector<string> *result) override {
+    return tensorflow::errors::Unimplemented(
+        "Model bundles cannot be listed");
+  }
+  Status DeleteFile(const string &fname) override { return ReadOnly(); }
+  Status CreateDir(const string &dirname) override { return ReadOnly(); }
+  Status DeleteDir(const string &dirname) override { return ReadOnly(); }
+  Status RenameFile(const string &src, const string &target) override {
+    return ReadOnly();
+  }
+
+ private:
+  static Status ReadOnly() {
+    return tensorflow::errors::Unimplemented("Model bundles are read only");
+  }
+
+  // Maps the bundle of the given path if needed and returns it along with the
+  // element name.
+  Status OpenElement(const string &fname, MemmappedFileSystem **bundle,
+                     string *element) {
+    string bundle_path;
+    TF_RETURN_IF_ERROR(SplitBundlePath(fname, &bundle_path, element));
+    mutex_lock lock(mu_);
+    std::unique_ptr<MemmappedFileSystem> &mapped = bundles_[bundle_path];
+    if (mapped == nullptr) {
+      std::unique_ptr<MemmappedFileSystem> file_system(
+          new MemmappedFileSystem());
+      TF_RETURN_IF_ERROR(
+          file_system->InitializeFromFile(Env::Default(), bundle_path));
+      mapped = std::move(file_system);
+    }
+    *bundle = mapped.get();
+    return Status::OK();
+  }
+
+  // Reads the task context of a bundle, with the file patterns that name
+  // elements of the bundle replaced by their paths.
+  static Status ReadContext(const string &fname, MemmappedFileSystem *bundle,
+                            string *contents) {
+    const string region = RegionName(kModelBundleContext);
+    uint64 size;
+    TF_RETURN_IF_ERROR(bundle->GetFileSize(region, &size));
+    std::unique_ptr<RandomAccessFile> file;
+    TF_RETURN_IF_ERROR(bundle->NewRandomAccessFile(region, &file));
+    string scratch(size, '\0');
+    StringPiece data;
+    TF_RETURN_IF_ERROR(file->Read(0, size, &data, &scratch[0]));
+    TaskSpec spec;
+    if (!TextFormat::ParseFromString(data.ToString(), &spec)) {
+      return tensorflow::errors::DataLoss("Could not parse task context at ",
+                                          fname);
+    }
+    const string prefix = fname.substr(0, fname.rfind('/') + 1);
+    for (TaskInput &input : *spec.mutable_input()) {
+      for (TaskInput::Part &part : *input.mutable_part()) {
+        if (bundle->FileExists(RegionName(part.file_pattern()))) {
+          part.set_file_pattern(StrCat(prefix, part.file_pattern()));
+        }
+      }
+    }
+    TextFormat::PrintToString(spec, contents);
+    return Status::OK();
+  }
+
+  // Mapped bundles by path.
+  mutex mu_;
+  std::unordered_map<string, std::unique_ptr<MemmappedFileSystem>> bundles_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ModelBundleFileSystem);
+};
+
+REGISTER_FILE_SYSTEM("modelbundle", ModelBundleFileSystem);
+
+}  // namespace
+
+string ModelBundleElementPath(const string &bundle_path,
+                              const string &element) {
+  return StrCat(kModelBundlePrefix, bundle_path, "/", element);
+}
+
+Status WriteModelBundle(const string &export_path, const string &bundle_path,
+                        int min_mapped_bytes) {
+  Env *env = Env::Default();
+  const string context_path =
+      tensorflow::io::JoinPath(export_path, "context.pbtxt");
+  string data;
+  TF_RETURN_IF_ERROR(ReadFileToString(env, context_path, &data));
+  TaskSpec spec;
+  if (!TextFormat::ParseFromString(data, &spec)) {
+    return tensorflow::errors::InvalidArgument(
+        "Could not parse task context at ", context_path);
+  }
+  tensorflow::GraphDef graph_def;
+  TF_RETURN_IF_ERROR(ReadBinaryProto(
+      env, tensorflow::io::JoinPath(export_path, "frozen_graph.pb"),
+      &graph_def));
+
+  MemmappedFileSystemWriter writer;
+  TF_RETURN_IF_ERROR(writer.InitializeToFile(env, bundle_path));
+  std::unordered_set<string> elements = {kModelBundleContext,
+                                         kModelBundleGraph};
+  auto unique_element = [&elements](string name) {
+    while (!elements.insert(name).second) name += '_';
+    return name;
+  };
+
+  // Bundles the files of the inputs without record format. Corpora and
+  // document queues are left to the task context.
+  int num_files = 0;
+  for (TaskInput &input : *spec.mutable_input()) {
+    if (input.record_format_size() > 0) continue;
+    for (int i = 0; i < input.part_size(); ++i) {
+      TaskInput::Part *part = input.mutable_part(i);
+      if (part->file_pattern().empty() || part->file_pattern() == "-") {
+        continue;
+      }
+      string contents;
+      TF_RETURN_IF_ERROR(ReadFileToString(env, part->file_pattern(),
+                                          &contents));
+      const string element = unique_element(
+          StrCat("input.", SanitizeElementName(input.name()), ".", i));
+      TF_RETURN_IF_ERROR(SaveContents(contents, element, &writer));
+      part->set_file_pattern(element);
+      ++num_files;
+    }
+  }
+
+  // Maps the large constants, and points the ops at the bundled context.
+  int num_mapped = 0;
+  for (tensorflow::NodeDef &node : *graph_def.mutable_node()) {
+    auto *attr = node.mutable_attr();
+    if (attr->count("task_context") > 0) {
+      (*attr)["task_context"].set_s(kModelBundleContext);
+    }
+    if (node.op() != "Const") continue;
+    Tensor value;
+    if (!value.FromProto(attr->at("value").tensor())) {
+      return tensorflow::errors::InvalidArgument(
+          "Could not parse the value of ", node.name());
+    }
+    if (value.dtype() == tensorflow::DT_STRING ||
+        value.TotalBytes() < min_mapped_bytes) {
+      continue;
+    }
+    const string element =
+        unique_element(StrCat("param.", SanitizeElementName(node.name())));
+    TF_RETURN_IF_ERROR(writer.SaveTensor(value, RegionName(element)));
+    node.set_op("ImmutableConst");
+    attr->clear();
+    (*attr)["dtype"].set_type(value.dtype());
+    value.shape().AsProto((*attr)["shape"].mutable_shape());
+    (*attr)["memory_region_name"].set_s(RegionName(element));
+    ++num_mapped;
+  }
+
+  TF_RETURN_IF_ERROR(
+      writer.SaveProtobuf(graph_def, RegionName(kModelBundleGraph)));
+  string context;
+  TextFormat::PrintToString(spec, &context);
+  TF_RETURN_IF_ERROR(SaveContents(context, kModelBundleContext, &writer));
+  TF_RETURN_IF_ERROR(writer.FlushAndClose());
+  LOG(INFO) << "Wrote " << num_files << " files and " << num_mapped
+            << " parameters to " << bundle_path;
+  return Status::OK();
+}
+
+Status ReadModelBundleGraph(const string &bundle_path,
+                            tensorflow::GraphDef *graph_def) {
+  TF_RETURN_IF_ERROR(ReadBinaryProto(
+      Env::Default(), ModelBundleElementPath(bundle_path, kModelBundleGraph),
+      graph_def));
+  const string context_path =
+      ModelBundleElementPath(bundle_path, kModelBundleContext);
+  for (tensorflow::NodeDef &node : *graph_def->mutable_node()) {
+    auto *attr = node.mutable_attr();
+    auto it = attr->find("task_context");
+    if (it != attr->end() && it->second.s() == kModelBundleContext) {
+      it->second.set_s(context_path);
+    }
+    it = attr->find("memory_region_name");
+    if (node.op() == "ImmutableConst" && it != attr->end()) {
+      StringPiece element(it->second.s());
+      if (element.Consume(MemmappedFileSystem::kMemmappedPackagePrefix)) {
+        it->second.set_s(
+            ModelBundleElementPath(bundle_path, element.ToString()));
+      }
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace syntaxnet
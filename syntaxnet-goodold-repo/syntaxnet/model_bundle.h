@@ -0,0 +1,67 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Single-file model bundles, holding the frozen graph of an exported model,
+// its parameters, its task context and the lexicons the context refers to in
+// the memmapped package format of TensorFlow.
+//
+// The elements of a bundle are served by a file system registered for the
+// "modelbundle" scheme, under paths of the form
+//   modelbundle://<bundle path>/<element name>
+// Parameters are memory mapped by ImmutableConst nodes, and lexicons are read
+// from the mapped file, so loading a bundle neither parses a checkpoint nor
+// copies the lexicon files.
+
+#ifndef SYNTAXNET_MODEL_BUNDLE_H_
+#define SYNTAXNET_MODEL_BUNDLE_H_
+
+#include <string>
+
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace syntaxnet {
+
+// Element names of the task context and of the graph in a bundle.
+extern const char kModelBundleContext[];
+extern const char kModelBundleGraph[];
+
+// Returns the path of an element of the bundle at bundle_path.
+string ModelBundleElementPath(const string &bundle_path,
+                              const string &element);
+
+// Writes the model exported to export_path by parser_eval.py --export_path
+// to a bundle at bundle_path. The bundle holds
+//   - the frozen graph of the export, with every constant of at least
+//     min_mapped_bytes replaced by an ImmutableConst node mapping its value,
+//   - every file of a task context input without record format, i.e. the
+//     lexicons and other resources, as opposed to corpora and queues,
+//   - the task context, with the file patterns of these inputs replaced by
+//     their element names.
+tensorflow::Status WriteModelBundle(const string &export_path,
+                                    const string &bundle_path,
+                                    int min_mapped_bytes);
+
+// Reads the graph of the bundle at bundle_path, with its ImmutableConst nodes
+// and the task contexts of its ops referring to elements of the bundle. The
+// task context element is served with the file patterns of the bundled inputs
+// resolved to their elements.
+tensorflow::Status ReadModelBundleGraph(const string &bundle_path,
+                                        tensorflow::GraphDef *graph_def);
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_MODEL_BUNDLE_H_
@@ -0,0 +1,47 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Packs a model exported by parser_eval.py --export_path into a single model
+// bundle, which parsing_session_main and ParsingSession load in place of the
+// export directory.
+//
+// Usage: model_bundle_main --export_path=<dir> --bundle_path=<file>
+//            [--min_mapped_bytes=<n>]
+
+#include <string>
+
+#include "syntaxnet/model_bundle.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+int main(int argc, char **argv) {
+  string export_path;
+  string bundle_path;
+  tensorflow::int32 min_mapped_bytes = 1024;
+  const bool parsed_flags_ok = tensorflow::ParseFlags(
+      &argc, argv, {tensorflow::Flag("export_path", &export_path),
+                    tensorflow::Flag("bundle_path", &bundle_path),
+                    tensorflow::Flag("min_mapped_bytes", &min_mapped_bytes)});
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parsed_flags_ok || export_path.empty() || bundle_path.empty()) {
+    LOG(ERROR) << "Usage: " << argv[0] << " --export_path=<dir> "
+               << "--bundle_path=<file> [--min_mapped_bytes=1024]";
+    return 1;
+  }
+  TF_CHECK_OK(syntaxnet::WriteModelBundle(export_path, bundle_path,
+                                          min_mapped_bytes));
+  return 0;
+}
@@ -0,0 +1,175 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/model_bundle.h"
+
+#include <string.h>
+#include <memory>
+#include <string>
+
+#include "syntaxnet/task_spec.pb.h"
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+using tensorflow::Env;
+using tensorflow::NodeDef;
+using tensorflow::Tensor;
+
+class ModelBundleTest : public ::testing::Test {
+ protected:
+  // Writes an export directory with a lexicon, an empty resource, a corpus, a
+  // large and a small constant, and an op reading the task context, and packs
+  // it into a bundle.
+  void SetUp() override {
+    Env *env = Env::Default();
+    const string export_path = TempPath("bundle-export");
+    if (!env->FileExists(export_path)) TF_CHECK_OK(env->CreateDir(export_path));
+    TaskSpec spec;
+    TaskInput *word_map = spec.add_input();
+    word_map->set_name("word-map");
+    word_map->add_part()->set_file_pattern(TempPath("bundle-word-map"));
+    TF_CHECK_OK(WriteStringToFile(env, TempPath("bundle-word-map"), kWordMap));
+    TaskInput *empty = spec.add_input();
+    empty->set_name("empty-table");
+    empty->add_part()->set_file_pattern(TempPath("bundle-empty-table"));
+    TF_CHECK_OK(WriteStringToFile(env, TempPath("bundle-empty-table"), ""));
+    TaskInput *corpus = spec.add_input();
+    corpus->set_name("corpus");
+    corpus->add_record_format("conll-sentence");
+    corpus->add_part()->set_file_pattern("/does/not/exist");
+    TF_CHECK_OK(WriteStringToFile(
+        env, utils::JoinPath({export_path, "context.pbtxt"}),
+        spec.DebugString()));
+
+    tensorflow::GraphDef graph_def;
+    weights_ = Tensor(tensorflow::DT_FLOAT, tensorflow::TensorShape({16, 16}));
+    for (int i = 0; i < 256; ++i) weights_.flat<float>()(i) = 0.5f * i;
+    AddConst("parser/weights", weights_, &graph_def);
+    Tensor bias(tensorflow::DT_FLOAT, tensorflow::TensorShape({2}));
+    bias.flat<float>().setZero();
+    AddConst("parser/bias", bias, &graph_def);
+    NodeDef *reader = graph_def.add_node();
+    reader->set_name("parser/reader");
+    reader->set_op("FeatureSize");
+    (*reader->mutable_attr())["task_context"].set_s(
+        utils::JoinPath({export_path, "context.pbtxt"}));
+    TF_CHECK_OK(WriteStringToFile(
+        env, utils::JoinPath({export_path, "frozen_graph.pb"}),
+        graph_def.SerializeAsString()));
+
+    // Bundles stay mapped once read, so every test writes its own.
+    bundle_path_ = TempPath(tensorflow::strings::StrCat(
+        ::testing::UnitTest::GetInstance()->current_test_info()->name(),
+        ".bundle"));
+    TF_CHECK_OK(WriteModelBundle(export_path, bundle_path_, 1024));
+  }
+
+  // Adds a Const node with the given value.
+  static void AddConst(const string &name, const Tensor &value,
+                       tensorflow::GraphDef *graph_def) {
+    NodeDef *node = graph_def->add_node();
+    node->set_name(name);
+    node->set_op("Const");
+    (*node->mutable_attr())["dtype"].set_type(value.dtype());
+    value.AsProtoTensorContent(
+        (*node->mutable_attr())["value"].mutable_tensor());
+  }
+
+  // Returns a path in the test temporary directory.
+  static string TempPath(const string &name) {
+    return utils::JoinPath({tensorflow::testing::TmpDir(), name});
+  }
+
+  // Returns the node of the given name.
+  static const NodeDef &GetNode(const tensorflow::GraphDef &graph_def,
+                                const string &name) {
+    for (const NodeDef &node : graph_def.node()) {
+      if (node.name() == name) return node;
+    }
+    LOG(FATAL) << "No node " << name;
+  }
+
+  static constexpr char kWordMap[] = "2\nthe 3\ncat 1\n";
+
+  string bundle_path_;
+  Tensor weights_;
+};
+
+constexpr char ModelBundleTest::kWordMap[];
+
+TEST_F(ModelBundleTest, ContextResolvesBundledInputs) {
+  Env *env = Env::Default();
+  string data;
+  TF_CHECK_OK(ReadFileToString(
+      env, ModelBundleElementPath(bundle_path_, kModelBundleContext), &data));
+  TaskSpec spec;
+  ASSERT_TRUE(TextFormat::ParseFromString(data, &spec));
+  ASSERT_EQ(3, spec.input_size());
+
+  const string &word_map = spec.input(0).part(0).file_pattern();
+  EXPECT_EQ(ModelBundleElementPath(bundle_path_, "input.word_map.0"),
+            word_map);
+  TF_CHECK_OK(ReadFileToString(env, word_map, &data));
+  EXPECT_EQ(kWordMap, data);
+
+  const string &empty = spec.input(1).part(0).file_pattern();
+  EXPECT_EQ(ModelBundleElementPath(bundle_path_, "input.empty_table.0"),
+            empty);
+  TF_CHECK_OK(ReadFileToString(env, empty, &data));
+  EXPECT_EQ("", data);
+
+  EXPECT_EQ("/does/not/exist", spec.input(2).part(0).file_pattern());
+}
+
+TEST_F(ModelBundleTest, GraphMapsLargeConstants) {
+  tensorflow::GraphDef graph_def;
+  TF_CHECK_OK(ReadModelBundleGraph(bundle_path_, &graph_def));
+
+  const NodeDef &weights = GetNode(graph_def, "parser/weights");
+  EXPECT_EQ("ImmutableConst", weights.op());
+  const string &region = weights.attr().at("memory_region_name").s();
+  EXPECT_EQ(ModelBundleElementPath(bundle_path_, "param.parser_weights"),
+            region);
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> mapped;
+  TF_CHECK_OK(Env::Default()->NewReadOnlyMemoryRegionFromFile(region, &mapped));
+  ASSERT_EQ(weights_.TotalBytes(), mapped->length());
+  EXPECT_EQ(0, memcmp(weights_.tensor_data().data(), mapped->data(),
+                      mapped->length()));
+
+  EXPECT_EQ("Const", GetNode(graph_def, "parser/bias").op());
+  EXPECT_EQ(ModelBundleElementPath(bundle_path_, kModelBundleContext),
+            GetNode(graph_def, "parser/reader").attr().at("task_context").s());
+}
+
+TEST(ModelBundlePathTest, RejectsMalformedPaths) {
+  Env *env = Env::Default();
+  string data;
+  EXPECT_FALSE(ReadFileToString(env, "modelbundle://no-element", &data).ok());
+  EXPECT_FALSE(
+      ReadFileToString(env, "modelbundle:///does/not/exist/graph.pb", &data)
+          .ok());
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,211 @@
+# Copyright 2016 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+"""Estimates the compute and memory traffic of a parser before training it.
+
+Builds the network of the model configured by a task context and the layer
+flags, without training or restoring it, and adds up the flops of its ops with
+the statistics functions TensorFlow registers for them, as the graph_metrics
+tool does. The bytes moved per step are those of the embedding rows each
+state looks up, and of the dense weights each step of a batch reads once.
+
+With --input, also counts the steps the transition system takes on the
+sentences of that corpus by following their gold transitions, which the
+parser takes as many of as any other sequence for most transition systems, to
+give the costs per sentence and per token.
+
+Example usage:
+  model_cost --task_context=context.pbtxt --arg_prefix=brain_parser \
+      --hidden_layer_sizes=512,512 --input=tuning-corpus
+"""
+
+
+import tensorflow as tf
+
+from tensorflow.python.framework import ops
+from tensorflow.python.platform import tf_logging as logging
+
+from syntaxnet import graph_builder
+from syntaxnet import sentence_pb2
+from syntaxnet.ops import gen_parser_ops
+
+flags = tf.app.flags
+FLAGS = flags.FLAGS
+
+flags.DEFINE_string('task_context', '',
+                    'Path to a task context with inputs and parameters for '
+                    'feature extractors.')
+flags.DEFINE_string('arg_prefix', 'brain_parser',
+                    'Prefix for context parameters.')
+flags.DEFINE_string('graph_builder', 'greedy',
+                    'Which graph builder the model uses, either greedy or '
+                    'structured.')
+flags.DEFINE_string('hidden_layer_sizes', '200,200',
+                    'Comma separated list of hidden layer sizes.')
+flags.DEFINE_integer('batch_size', 32,
+                     'Number of sentences parsed in parallel, over which each '
+                     'step reads the dense weights once.')
+flags.DEFINE_integer('beam_size', 8,
+                     'Number of slots for beam parsing of the structured '
+                     'graph builder.')
+flags.DEFINE_bool('factored_arc_actions', False,
+                  'Whether the arc-standard actions are scored by a softmax '
+                  'over the action types and one over the labels.')
+flags.DEFINE_bool('half_embeddings', False,
+                  'Whether the embedding matrices are in half precision.')
+flags.DEFINE_string('input', '',
+                    'If set, the corpus on which to count the steps per '
+                    'sentence.')
+
+# Bytes of the values of the parameters.
+FLOAT_BYTES = 4
+HALF_BYTES = 2
+
+
+def NetworkCost(num_actions, num_features, num_feature_ids, embedding_sizes,
+                hidden_layer_sizes, num_states, num_tag_actions=0,
+                factored_arc_actions=False):
+  """Returns the costs of one step of the network on a batch of states.
+
+  Args:
+    num_actions: number of actions of the transition system.
+    num_features: number of features of each feature group.
+    num_feature_ids: number of ids of each feature group.
+    embedding_sizes: embedding dimension of each feature group.
+    hidden_layer_sizes: sizes of the hidden layers.
+    num_states: number of parser states the step scores.
+    num_tag_actions: see graph_builder.NumTagActions().
+    factored_arc_actions: whether the arc actions are factored.
+
+  Returns:
+    dict of the 'flops' of the step, the 'weight_parameters' its products
+    read, and the 'embedding_values' it looks up.
+  """
+  with tf.Graph().as_default() as graph:
+    parser = graph_builder.GreedyParser(
+        num_actions, num_features, num_feature_ids, embedding_sizes,
+        hidden_layer_sizes, num_tag_actions=num_tag_actions,
+        factored_arc_actions=factored_arc_actions)
+    features = [tf.placeholder(tf.string, [num_states * num_features[i]])
+                for i in range(len(num_features))]
+    parser._BuildNetwork(features)  # pylint: disable=protected-access
+
+    # The reshapes of the network have batch-major outputs whose first
+    # dimension becomes known once the embeddings have a static shape, which
+    # the statistics functions require. Ops are in topological order.
+    costs = {'flops': ops.OpStats('flops'),
+             'weight_parameters': ops.OpStats('weight_parameters')}
+    for op in graph.get_operations():
+      ops.set_shapes_for_outputs(op)
+      if op.type == 'Reshape' and op.outputs[0].get_shape().ndims == 2:
+        op.outputs[0].set_shape([num_states, None])
+      for statistic_type in costs:
+        costs[statistic_type] += ops.get_stats_for_node_def(
+            graph, op.node_def, statistic_type)
+  result = dict((statistic_type, stats.value or 0)
+                for statistic_type, stats in costs.items())
+  result['embedding_values'] = num_states * sum(
+      n * d for n, d in zip(num_features, embedding_sizes))
+  return result
+
+
+def CountSteps(task_context, corpus_name, arg_prefix, feature_size):
+  """Returns the sentences, tokens and transition steps of a corpus.
+
+  Args:
+    task_context: path to the task context.
+    corpus_name: name of the corpus in the task context.
+    arg_prefix: prefix for context parameters.
+    feature_size: number of feature groups of the parser.
+
+  Returns:
+    the number of sentences and tokens of the corpus, and of parser states
+    the gold transitions of its sentences go through before a final state.
+  """
+  num_sentences = 0
+  num_tokens = 0
+  num_steps = 0
+  with tf.Graph().as_default(), tf.Session() as sess:
+    documents, last = gen_parser_ops.document_source(
+        task_context=task_context, corpus_name=corpus_name, batch_size=32)
+    sentence = sentence_pb2.Sentence()
+    while True:
+      tf_documents, tf_last = sess.run([documents, last])
+      for document in tf_documents:
+        sentence.ParseFromString(document)
+        num_sentences += 1
+        num_tokens += len(sentence.token)
+      if tf_last:
+        break
+
+    # With a single slot, the reader emits the features of one state per run,
+    # and counts an epoch when it starts the corpus, first on the first run.
+    _, epochs, _ = gen_parser_ops.gold_parse_reader(
+        task_context, feature_size, 1, corpus_name=corpus_name,
+        arg_prefix=arg_prefix)
+    while sess.run(epochs) == 1:
+      num_steps += 1
+  return num_sentences, num_tokens, num_steps
+
+
+def main(unused_argv):
+  logging.set_verbosity(logging.INFO)
+  with tf.Session() as sess:
+    num_features, num_feature_ids, embedding_sizes, num_actions = sess.run(
+        gen_parser_ops.feature_size(task_context=FLAGS.task_context,
+                                    arg_prefix=FLAGS.arg_prefix))
+  num_tag_actions = graph_builder.NumTagActions(FLAGS.task_context,
+                                                FLAGS.arg_prefix)
+  hidden_layer_sizes = map(int, FLAGS.hidden_layer_sizes.split(','))
+  beam_size = FLAGS.beam_size if FLAGS.graph_builder == 'structured' else 1
+  num_states = FLAGS.batch_size * beam_size
+  cost = NetworkCost(num_actions, num_features, num_feature_ids,
+                     embedding_sizes, hidden_layer_sizes, num_states,
+                     num_tag_actions=num_tag_actions,
+                     factored_arc_actions=FLAGS.factored_arc_actions)
+
+  # Costs of scoring one parser state, with the dense weights read once per
+  # step for all states of the batch.
+  flops = float(cost['flops']) / num_states
+  embedding_bytes = float(cost['embedding_values']) / num_states * (
+      HALF_BYTES if FLAGS.half_embeddings else FLOAT_BYTES)
+  weight_bytes = float(cost['weight_parameters']) * FLOAT_BYTES / num_states
+  print 'Feature groups: %s' % ', '.join(
+      '%d x %d (%d ids)' % group
+      for group in zip(num_features, embedding_sizes, num_feature_ids))
+  print 'Hidden layers: %s, actions: %d' % (FLAGS.hidden_layer_sizes,
+                                            num_actions)
+  print 'Embedding parameters: %d' % sum(
+      n * d for n, d in zip(num_feature_ids, embedding_sizes))
+  print 'Dense parameters: %d' % cost['weight_parameters']
+  print 'Per state: %.0f flops, %.0f embedding bytes, %.0f weight bytes' % (
+      flops, embedding_bytes, weight_bytes)
+
+  if FLAGS.input:
+    num_sentences, num_tokens, num_steps = CountSteps(
+        FLAGS.task_context, FLAGS.input, FLAGS.arg_prefix, len(num_features))
+    steps_per_sentence = float(num_steps) / max(num_sentences, 1)
+    steps_per_token = float(num_steps) / max(num_tokens, 1)
+    print 'Steps: %.2f per sentence, %.2f per token on %d sentences' % (
+        steps_per_sentence, steps_per_token, num_sentences)
+    for unit, steps in [('sentence', steps_per_sentence),
+                        ('token', steps_per_token)]:
+      states = steps * beam_size
+      print 'Per %s: %.0f flops, %.0f bytes' % (
+          unit, states * flops, states * (embedding_bytes + weight_bytes))
+
+
+if __name__ == '__main__':
+  tf.app.run()
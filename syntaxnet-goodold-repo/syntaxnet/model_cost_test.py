@@ -0,0 +1,81 @@
+# Copyright 2016 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+"""Tests for model_cost."""
+
+
+# disable=no-name-in-module,unused-import,g-bad-import-order,maybe-no-member
+import os.path
+
+import tensorflow as tf
+
+from tensorflow.python.framework import test_util
+from tensorflow.python.platform import googletest
+
+from syntaxnet import model_cost
+from syntaxnet.ops import gen_parser_ops
+
+FLAGS = tf.app.flags.FLAGS
+if not hasattr(FLAGS, 'test_srcdir'):
+  FLAGS.test_srcdir = ''
+if not hasattr(FLAGS, 'test_tmpdir'):
+  FLAGS.test_tmpdir = tf.test.get_temp_dir()
+
+
+class ModelCostTest(test_util.TensorFlowTestCase):
+
+  def setUp(self):
+    # Creates a task context with the correct testing paths.
+    initial_task_context = os.path.join(
+        FLAGS.test_srcdir,
+        'syntaxnet/'
+        'testdata/context.pbtxt')
+    self._task_context = os.path.join(FLAGS.test_tmpdir, 'context.pbtxt')
+    with open(initial_task_context, 'r') as fin:
+      with open(self._task_context, 'w') as fout:
+        fout.write(fin.read().replace('SRCDIR', FLAGS.test_srcdir)
+                   .replace('OUTPATH', FLAGS.test_tmpdir))
+
+    # Creates necessary term maps.
+    with self.test_session():
+      gen_parser_ops.lexicon_builder(task_context=self._task_context,
+                                     corpus_name='training-corpus').run()
+
+  def testNetworkCost(self):
+    cost = model_cost.NetworkCost(num_actions=5,
+                                  num_features=[6, 4],
+                                  num_feature_ids=[100, 20],
+                                  embedding_sizes=[8, 2],
+                                  hidden_layer_sizes=[16, 12],
+                                  num_states=3)
+
+    # Each layer multiplies its input by its weights and adds its biases.
+    layers = [6 * 8 + 4 * 2, 16, 12, 5]
+    products = sum(a * b for a, b in zip(layers, layers[1:]))
+    self.assertEqual(cost['flops'], 3 * (2 * products + 16 + 12 + 5))
+    self.assertEqual(cost['weight_parameters'], products + 16 + 12 + 5)
+    self.assertEqual(cost['embedding_values'], 3 * (6 * 8 + 4 * 2))
+
+  def testCountSteps(self):
+    num_sentences, num_tokens, num_steps = model_cost.CountSteps(
+        self._task_context, 'training-corpus', 'brain_parser', 3)
+    self.assertGreater(num_sentences, 0)
+
+    # The arc-standard system shifts every token and reduces all but one.
+    self.assertEqual(num_steps, 2 * num_tokens - num_sentences)
+
+
+if __name__ == '__main__':
+  googletest.main()
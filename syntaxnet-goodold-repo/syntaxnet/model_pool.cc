@@ -0,0 +1,211 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/model_pool.h"
+
+#include "syntaxnet/document_queue.h"
+#include "syntaxnet/model_bundle.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/task_spec.pb.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace syntaxnet {
+
+using tensorflow::Status;
+
+namespace {
+
+// Reads the names of the document queues used by the model exported to
+// export_path from its task context.
+Status ReadQueueNames(const string &export_path, std::vector<string> *names) {
+  tensorflow::Env *env = tensorflow::Env::Default();
+  const string context_path =
+      env->IsDirectory(export_path).ok()
+          ? tensorflow::io::JoinPath(export_path, "context.pbtxt")
+          : ModelBundleElementPath(export_path, kModelBundleContext);
+  string data;
+  TF_RETURN_IF_ERROR(ReadFileToString(env, context_path, &data));
+  TaskSpec spec;
+  if (!TextFormat::ParseFromString(data, &spec)) {
+    return tensorflow::errors::InvalidArgument(
+        "Could not parse task context at ", context_path);
+  }
+  names->clear();
+  for (const TaskInput &input : spec.input()) {
+    if (DocumentQueue::IsQueueInput(input)) {
+      names->push_back(TaskContext::InputFile(input));
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+ModelPool::ModelPool(int64 max_bytes) : max_bytes_(max_bytes) {}
+
+void ModelPool::set_session_options(
+    const tensorflow::SessionOptions &options) {
+  mutex_lock lock(mu_);
+  session_options_ = options;
+}
+
+Status ModelPool::AddModel(const string &name, const string &export_path) {
+  mutex_lock lock(mu_);
+  if (FindModel(name) != nullptr) {
+    return tensorflow::errors::AlreadyExists("Model ", name,
+                                             " is already in the pool");
+  }
+  std::unique_ptr<Model> &model = models_[name];
+  model.reset(new Model());
+  model->export_path = export_path;
+  return Status::OK();
+}
+
+Status ModelPool::Parse(const string &name,
+                        const std::vector<Sentence> &sentences,
+                        std::vector<Sentence> *parses) {
+  std::shared_ptr<ParsingSession> session;
+  TF_RETURN_IF_ERROR(GetSession(name, &session));
+  return session->Parse(sentences, parses);
+}
+
+Status ModelPool::GetSession(const string &name,
+                             std::shared_ptr<ParsingSession> *session) {
+  Model *model;
+  {
+    mutex_lock lock(mu_);
+    model = FindModel(name);
+    if (model == nullptr) {
+      return tensorflow::errors::NotFound("Unknown model ", name);
+    }
+    if (model->session != nullptr) {
+      Touch(model);
+      *session = model->session;
+      return Status::OK();
+    }
+  }
+
+  // Loads the model without holding the lock of the pool, so that the other
+  // models are served in the meantime.
+  mutex_lock load_lock(model->load_mu);
+  int64 bytes = 0;
+  TF_RETURN_IF_ERROR(ExportBytes(model->export_path, &bytes));
+  std::vector<string> queues;
+  TF_RETURN_IF_ERROR(ReadQueueNames(model->export_path, &queues));
+  std::shared_ptr<ParsingSession> loaded;
+  tensorflow::SessionOptions session_options;
+  {
+    mutex_lock lock(mu_);
+    if (model->session != nullptr) {  // loaded by another call meanwhile
+      Touch(model);
+      *session = model->session;
+      return Status::OK();
+    }
+
+    // Creating a session clears its queues, so they are claimed first.
+    for (const string &queue : queues) {
+      auto it = queue_models_.find(queue);
+      if (it != queue_models_.end() && it->second != name) {
+        return tensorflow::errors::FailedPrecondition(
+            "Models ", it->second, " and ", name, " both use the queue ",
+            queue, "; export them with distinct --serving_queue_prefix");
+      }
+    }
+    for (const string &queue : queues) queue_models_[queue] = name;
+    loaded = model->unloaded.lock();
+    session_options = session_options_;
+  }
+  if (loaded == nullptr) {
+    std::unique_ptr<ParsingSession> created;
+    TF_RETURN_IF_ERROR(ParsingSession::Create(model->export_path,
+                                              &session_options, &created));
+    loaded.reset(created.release());
+    LOG(INFO) << "Loaded model " << name << " from " << model->export_path;
+  }
+
+  mutex_lock lock(mu_);
+  model->session = loaded;
+  model->unloaded.reset();
+  model->bytes = bytes;
+  loaded_.push_front(name);
+  model->position = loaded_.begin();
+  bytes_ += bytes;
+  Evict(name);
+  *session = loaded;
+  return Status::OK();
+}
+
+bool ModelPool::IsLoaded(const string &name) const {
+  mutex_lock lock(mu_);
+  const Model *model = FindModel(name);
+  return model != nullptr && model->session != nullptr;
+}
+
+int ModelPool::num_loaded() const {
+  mutex_lock lock(mu_);
+  return loaded_.size();
+}
+
+int64 ModelPool::bytes() const {
+  mutex_lock lock(mu_);
+  return bytes_;
+}
+
+Status ModelPool::ExportBytes(const string &export_path, int64 *bytes) {
+  tensorflow::Env *env = tensorflow::Env::Default();
+  std::vector<string> files;
+  if (env->IsDirectory(export_path).ok()) {
+    std::vector<string> children;
+    TF_RETURN_IF_ERROR(env->GetChildren(export_path, &children));
+    for (const string &child : children) {
+      files.push_back(tensorflow::io::JoinPath(export_path, child));
+    }
+  } else {
+    files.push_back(export_path);
+  }
+  *bytes = 0;
+  for (const string &file : files) {
+    if (env->IsDirectory(file).ok()) continue;
+    tensorflow::uint64 size;
+    TF_RETURN_IF_ERROR(env->GetFileSize(file, &size));
+    *bytes += size;
+  }
+  return Status::OK();
+}
+
+ModelPool::Model *ModelPool::FindModel(const string &name) const {
+  auto it = models_.find(name);
+  return it != models_.end() ? it->second.get() : nullptr;
+}
+
+void ModelPool::Touch(Model *model) {
+  loaded_.splice(loaded_.begin(), loaded_, model->position);
+}
+
+void ModelPool::Evict(const string &name) {
+  if (max_bytes_ <= 0) return;
+  while (bytes_ > max_bytes_ && loaded_.back() != name) {
+    Model *model = FindModel(loaded_.back());
+    LOG(INFO) << "Unloading model " << loaded_.back();
+    model->unloaded = model->session;
+    model->session.reset();
+    bytes_ -= model->bytes;
+    loaded_.pop_back();
+  }
+}
+
+}  // namespace syntaxnet
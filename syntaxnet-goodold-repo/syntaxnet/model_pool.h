@@ -0,0 +1,149 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Pool of exported models served from one process.
+//
+// Serving many models, like the per-language parsey_universal models, with a
+// process each wastes most of the memory when the traffic is skewed. A pool
+// holds the ParsingSessions of several exported models, loads each model on
+// its first request and unloads the least recently used models when the
+// loaded ones exceed a memory budget. The sessions of a pool are created with
+// the same options, so that they share the global TensorFlow thread pools, and
+// the resources of the reader ops, like lexicons, are shared through the
+// SharedStore by the models that use the same ones.
+
+#ifndef SYNTAXNET_MODEL_POOL_H_
+#define SYNTAXNET_MODEL_POOL_H_
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "syntaxnet/parsing_session.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace syntaxnet {
+
+// Serves the models added to it by name. The memory used by a model is taken
+// to be the size of its export directory or bundle, which holds its graph and
+// parameters. A budget of 0 keeps all models loaded once requested.
+//
+// Since the document queues of the models are global, the models of a pool
+// must use distinct queues, see parser_eval.py --serving_queue_prefix. A model
+// unloaded while a Parse() call still uses its session stays alive until the
+// call returns, and is taken back if requested again in the meantime.
+//
+// All methods are thread-safe. Calls for different models run concurrently,
+// and calls for the same model are serialized by its session.
+class ModelPool {
+ public:
+  // Creates an empty pool whose loaded models use at most max_bytes, except
+  // that the most recently requested model is always kept.
+  explicit ModelPool(int64 max_bytes);
+
+  // Sets the options of the sessions of models loaded after this call. By
+  // default the sessions share the global thread pools, and the serving_*
+  // options of the task contexts of the models are ignored.
+  void set_session_options(const tensorflow::SessionOptions &options);
+
+  // Adds a model exported to export_path under the given name, without loading
+  // it. Fails if the name is already used.
+  tensorflow::Status AddModel(const string &name, const string &export_path);
+
+  // Tags and parses the given sentences with the named model, loading it if
+  // needed, see ParsingSession::Parse().
+  tensorflow::Status Parse(const string &name,
+                           const std::vector<Sentence> &sentences,
+                           std::vector<Sentence> *parses);
+
+  // Returns the session of the named model in *session, loading it if needed,
+  // and marks the model as the most recently used.
+  tensorflow::Status GetSession(const string &name,
+                                std::shared_ptr<ParsingSession> *session);
+
+  // Returns true if the named model is loaded.
+  bool IsLoaded(const string &name) const;
+
+  // Returns the number of loaded models and the memory they use.
+  int num_loaded() const;
+  int64 bytes() const;
+
+  // Computes the memory used by the model exported to export_path.
+  static tensorflow::Status ExportBytes(const string &export_path,
+                                        int64 *bytes);
+
+ private:
+  // A model added to the pool.
+  struct Model {
+    string export_path;
+
+    // Session of the model if loaded, with its position in the LRU list, and
+    // the memory it uses.
+    std::shared_ptr<ParsingSession> session;
+    std::list<string>::iterator position;
+    int64 bytes = 0;
+
+    // Session of the model if unloaded but still in use.
+    std::weak_ptr<ParsingSession> unloaded;
+
+    // Serializes the loading of the model, so that it is only loaded once.
+    mutex load_mu;
+  };
+
+  // The methods below require mu_ to be held.
+
+  // Returns the model with the given name, or null.
+  Model *FindModel(const string &name) const;
+
+  // Marks a loaded model as the most recently used.
+  void Touch(Model *model);
+
+  // Unloads the least recently used models other than the named one while the
+  // loaded models exceed the budget.
+  void Evict(const string &name);
+
+  // Memory budget of the loaded models.
+  const int64 max_bytes_;
+
+  // Guards the members below.
+  mutable mutex mu_;
+
+  // Options of the sessions of the models.
+  tensorflow::SessionOptions session_options_;
+
+  // Models by name.
+  std::unordered_map<string, std::unique_ptr<Model>> models_;
+
+  // Names of the loaded models, from the most to the least recently used.
+  std::list<string> loaded_;
+
+  // Memory used by the loaded models.
+  int64 bytes_ = 0;
+
+  // Names of the models by the document queues they use.
+  std::unordered_map<string, string> queue_models_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ModelPool);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_MODEL_POOL_H_
@@ -0,0 +1,152 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/model_pool.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "syntaxnet/parsing_session.h"
+#include "syntaxnet/task_spec.pb.h"
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/protobuf/saver.pb.h"
+
+namespace syntaxnet {
+namespace {
+
+using tensorflow::Env;
+using tensorflow::NodeDef;
+
+// Writes an export directory of a model doing nothing, whose queues are named
+// after the given prefix, and returns its path.
+string WriteExport(const string &name, const string &queue_prefix) {
+  Env *env = Env::Default();
+  const string export_path =
+      utils::JoinPath({tensorflow::testing::TmpDir(), name});
+  if (!env->FileExists(export_path)) TF_CHECK_OK(env->CreateDir(export_path));
+
+  TaskSpec spec;
+  for (const string &queue : {"serving-input", "serving-output"}) {
+    TaskInput *input = spec.add_input();
+    input->set_name(queue);
+    input->add_record_format("sentence-queue");
+    input->add_part()->set_file_pattern(queue_prefix + queue);
+  }
+  for (const auto &parameter : std::vector<std::pair<string, string>>{
+           {"serving_input", "serving-input"},
+           {"serving_output", "serving-output"},
+           {"serving_steps", "step"}}) {
+    TaskSpec::Parameter *added = spec.add_parameter();
+    added->set_name(parameter.first);
+    added->set_value(parameter.second);
+  }
+  TF_CHECK_OK(WriteStringToFile(
+      env, utils::JoinPath({export_path, "context.pbtxt"}),
+      spec.DebugString()));
+
+  // The restore op and the step do nothing.
+  tensorflow::GraphDef graph_def;
+  NodeDef *filename = graph_def.add_node();
+  filename->set_name("filename");
+  filename->set_op("Placeholder");
+  (*filename->mutable_attr())["dtype"].set_type(tensorflow::DT_STRING);
+  for (const string &op : {"restore", "step"}) {
+    NodeDef *node = graph_def.add_node();
+    node->set_name(op);
+    node->set_op("NoOp");
+  }
+  TF_CHECK_OK(WriteStringToFile(env,
+                                utils::JoinPath({export_path, "graph.pb"}),
+                                graph_def.SerializeAsString()));
+  tensorflow::SaverDef saver_def;
+  saver_def.set_filename_tensor_name("filename:0");
+  saver_def.set_restore_op_name("restore");
+  TF_CHECK_OK(WriteStringToFile(env,
+                                utils::JoinPath({export_path, "saver.pb"}),
+                                saver_def.SerializeAsString()));
+  return export_path;
+}
+
+TEST(ModelPoolTest, LoadsModelsOnDemand) {
+  ModelPool pool(0);
+  ASSERT_TRUE(pool.AddModel("a", WriteExport("pool-lazy-a", "lazy-a-")).ok());
+  EXPECT_FALSE(pool.AddModel("a", WriteExport("pool-lazy-b", "lazy-b-")).ok());
+  EXPECT_FALSE(pool.IsLoaded("a"));
+  EXPECT_EQ(0, pool.num_loaded());
+
+  std::vector<Sentence> parses;
+  ASSERT_TRUE(pool.Parse("a", {}, &parses).ok());
+  EXPECT_TRUE(pool.IsLoaded("a"));
+  std::shared_ptr<ParsingSession> first, second;
+  ASSERT_TRUE(pool.GetSession("a", &first).ok());
+  ASSERT_TRUE(pool.GetSession("a", &second).ok());
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(1, pool.num_loaded());
+  EXPECT_EQ(tensorflow::error::NOT_FOUND,
+            pool.GetSession("b", &first).code());
+}
+
+TEST(ModelPoolTest, UnloadsLeastRecentlyUsedModels) {
+  const string a = WriteExport("pool-lru-a", "lru-a-");
+  const string b = WriteExport("pool-lru-b", "lru-b-");
+  const string c = WriteExport("pool-lru-c", "lru-c-");
+  int64 bytes = 0;
+  ASSERT_TRUE(ModelPool::ExportBytes(a, &bytes).ok());
+  EXPECT_GT(bytes, 0);
+
+  // The budget holds two of the models.
+  ModelPool pool(2 * bytes);
+  ASSERT_TRUE(pool.AddModel("a", a).ok());
+  ASSERT_TRUE(pool.AddModel("b", b).ok());
+  ASSERT_TRUE(pool.AddModel("c", c).ok());
+  std::shared_ptr<ParsingSession> session_a, session;
+  ASSERT_TRUE(pool.GetSession("a", &session_a).ok());
+  ASSERT_TRUE(pool.GetSession("b", &session).ok());
+  ASSERT_TRUE(pool.GetSession("a", &session).ok());
+  ASSERT_TRUE(pool.GetSession("c", &session).ok());
+  EXPECT_TRUE(pool.IsLoaded("a"));
+  EXPECT_FALSE(pool.IsLoaded("b"));
+  EXPECT_TRUE(pool.IsLoaded("c"));
+  EXPECT_EQ(2, pool.num_loaded());
+  EXPECT_EQ(2 * bytes, pool.bytes());
+
+  // A model unloaded while in use is taken back when requested again.
+  ASSERT_TRUE(pool.GetSession("b", &session).ok());
+  EXPECT_FALSE(pool.IsLoaded("a"));
+  ASSERT_TRUE(pool.GetSession("a", &session).ok());
+  EXPECT_EQ(session_a, session);
+}
+
+TEST(ModelPoolTest, RejectsModelsSharingQueues) {
+  ModelPool pool(0);
+  ASSERT_TRUE(pool.AddModel("a", WriteExport("pool-queue-a", "queue-")).ok());
+  ASSERT_TRUE(pool.AddModel("b", WriteExport("pool-queue-b", "queue-")).ok());
+  std::shared_ptr<ParsingSession> session;
+  ASSERT_TRUE(pool.GetSession("a", &session).ok());
+  EXPECT_EQ(tensorflow::error::FAILED_PRECONDITION,
+            pool.GetSession("b", &session).code());
+  EXPECT_FALSE(pool.IsLoaded("b"));
+}
+
+}  // namespace
+}  // namespace syntaxnet
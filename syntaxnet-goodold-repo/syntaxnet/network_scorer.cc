@@ -0,0 +1,49 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/network_scorer.h"
+
+using tensorflow::OpKernelContext;
+using tensorflow::Tensor;
+using tensorflow::errors::Unimplemented;
+
+namespace syntaxnet {
+
+// Network scorer registry.
+REGISTER_CLASS_REGISTRY("network scorer", NetworkScorer);
+
+tensorflow::Status NetworkScorer::SplitFirstLayer(
+    OpKernelContext *context, const vector<vector<bool>> &input_features) {
+  return Unimplemented("Network scorer does not split the embedding layer");
+}
+
+tensorflow::Status NetworkScorer::EmbedPart(
+    const vector<vector<SparseFeatures>> &features, bool input,
+    float *row) const {
+  return Unimplemented("Network scorer does not split the embedding layer");
+}
+
+tensorflow::Status NetworkScorer::MultiplyPart(OpKernelContext *context,
+                                               bool input, const Tensor &part,
+                                               Tensor *products) const {
+  return Unimplemented("Network scorer does not split the embedding layer");
+}
+
+tensorflow::Status NetworkScorer::ComputeScoresFromProducts(
+    OpKernelContext *context, Tensor *layer) const {
+  return Unimplemented("Network scorer does not split the embedding layer");
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,118 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Interface of the networks that decoding ops evaluate in-kernel to score the
+// parser transitions of a batch, in place of separate TensorFlow graph steps.
+// Scorers are registered by name, and the decoders pick one with the
+// "<arg_prefix>_network_scorer" task parameter, so that specialized scorers can
+// be plugged in without changing the graph that feeds the network parameters.
+
+#ifndef SYNTAXNET_NETWORK_SCORER_H_
+#define SYNTAXNET_NETWORK_SCORER_H_
+
+#include <vector>
+
+#include "syntaxnet/embedding_feature_extractor.h"
+#include "syntaxnet/registry.h"
+#include "syntaxnet/sparse.pb.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace syntaxnet {
+
+// A network scorer embeds the sparse features of parser states into rows of an
+// embedding layer, and turns a batch of rows into transition scores. Scorers
+// can also support splitting the embedding layer into the part of the input
+// features and the part of the others, whose first layer products are then
+// computed apart. Scorers are created for each run of the op, and can be
+// registered with the REGISTER_NETWORK_SCORER macro.
+class NetworkScorer : public RegisterableClass<NetworkScorer> {
+ public:
+  NetworkScorer() {}
+  virtual ~NetworkScorer() {}
+
+  // Reads the network parameters from the inputs of the op, and checks that
+  // they fit the given features.
+  virtual tensorflow::Status Init(
+      tensorflow::OpKernelContext *context,
+      const ParserEmbeddingFeatureExtractor &features) = 0;
+
+  // Sums the embeddings of the features of one parser state, as extracted by
+  // the feature extractor, into a row of embedding_size() floats.
+  virtual tensorflow::Status Embed(
+      const vector<vector<SparseFeatures>> &features, float *row) const = 0;
+
+  // Replaces a [batch size, embedding_size()] embedding layer with the
+  // [batch size, number of actions] transition scores computed from it.
+  virtual tensorflow::Status ComputeScores(
+      tensorflow::OpKernelContext *context,
+      tensorflow::Tensor *layer) const = 0;
+
+  // Width of the embedding layer.
+  virtual int64 embedding_size() const = 0;
+
+  // Returns whether the scorer implements the methods below. The decoders
+  // only split the embedding layer of scorers that do.
+  virtual bool SupportsParts() const { return false; }
+
+  // Splits the first layer into a part for the features flagged in
+  // input_features, per feature space and feature, and a part for the others.
+  // Must be called after Init(), and before the methods below.
+  virtual tensorflow::Status SplitFirstLayer(
+      tensorflow::OpKernelContext *context,
+      const vector<vector<bool>> &input_features);
+
+  // Sums the embeddings of the input features, or of the other features, of
+  // one parser state into a row of part_size(input) floats.
+  virtual tensorflow::Status EmbedPart(
+      const vector<vector<SparseFeatures>> &features, bool input,
+      float *row) const;
+
+  // Multiplies a [batch size, part_size(input)] part of the embedding layer
+  // by the corresponding first layer weights. Adding the products of both
+  // parts gives the first layer activations of the whole embedding layer,
+  // before the bias.
+  virtual tensorflow::Status MultiplyPart(tensorflow::OpKernelContext *context,
+                                          bool input,
+                                          const tensorflow::Tensor &part,
+                                          tensorflow::Tensor *products) const;
+
+  // Like ComputeScores(), but takes the summed first layer products of the
+  // parts of the embedding layer, of width hidden_size().
+  virtual tensorflow::Status ComputeScoresFromProducts(
+      tensorflow::OpKernelContext *context, tensorflow::Tensor *layer) const;
+
+  // Width of the input or the other part of the embedding layer.
+  virtual int64 part_size(bool input) const { return 0; }
+
+  // Width of the first layer.
+  virtual int64 hidden_size() const { return 0; }
+
+  // Rough cost in cycles of extracting and embedding the features of one
+  // parser state, for sharding Embed() calls.
+  static const int64 kEmbeddingCost = 100000;
+
+ private:
+  TF_DISALLOW_COPY_AND_ASSIGN(NetworkScorer);
+};
+
+#define REGISTER_NETWORK_SCORER(type, component) \
+  REGISTER_CLASS_COMPONENT(NetworkScorer, type, component)
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_NETWORK_SCORER_H_
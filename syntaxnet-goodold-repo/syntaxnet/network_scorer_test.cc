@@ -0,0 +1,78 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/network_scorer.h"
+
+#include <memory>
+
+#include "syntaxnet/feed_forward_network.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+// Scorer that only implements the required methods.
+class ConstantScorer : public NetworkScorer {
+ public:
+  tensorflow::Status Init(
+      tensorflow::OpKernelContext *context,
+      const ParserEmbeddingFeatureExtractor &features) override {
+    return tensorflow::Status::OK();
+  }
+
+  tensorflow::Status Embed(const vector<vector<SparseFeatures>> &features,
+                           float *row) const override {
+    *row = 1.0f;
+    return tensorflow::Status::OK();
+  }
+
+  tensorflow::Status ComputeScores(tensorflow::OpKernelContext *context,
+                                   tensorflow::Tensor *layer) const override {
+    return tensorflow::Status::OK();
+  }
+
+  int64 embedding_size() const override { return 1; }
+};
+
+REGISTER_NETWORK_SCORER("constant", ConstantScorer);
+
+TEST(NetworkScorerTest, CreatesRegisteredScorers) {
+  std::unique_ptr<NetworkScorer> feed_forward(
+      NetworkScorer::Create("feed-forward"));
+  EXPECT_NE(nullptr, dynamic_cast<FeedForwardNetwork *>(feed_forward.get()));
+  EXPECT_TRUE(feed_forward->SupportsParts());
+
+  std::unique_ptr<NetworkScorer> packed(
+      NetworkScorer::Create("packed-feed-forward"));
+  EXPECT_NE(nullptr,
+            dynamic_cast<PackedFeedForwardNetwork *>(packed.get()));
+  EXPECT_TRUE(packed->SupportsParts());
+
+  std::unique_ptr<NetworkScorer> constant(NetworkScorer::Create("constant"));
+  EXPECT_NE(nullptr, dynamic_cast<ConstantScorer *>(constant.get()));
+  EXPECT_EQ(1, constant->embedding_size());
+}
+
+TEST(NetworkScorerTest, PartsAreUnimplementedByDefault) {
+  std::unique_ptr<NetworkScorer> scorer(NetworkScorer::Create("constant"));
+  EXPECT_FALSE(scorer->SupportsParts());
+  float row = 0.0f;
+  tensorflow::Status status = scorer->EmbedPart({}, true, &row);
+  EXPECT_TRUE(tensorflow::errors::IsUnimplemented(status));
+  EXPECT_EQ(0.0f, row);
+}
+
+}  // namespace syntaxnet
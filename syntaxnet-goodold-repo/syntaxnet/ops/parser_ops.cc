@@ -43,17 +43,63 @@ corpus_name: name of task input in the task context to read parses from.
 arg_prefix: prefix for context parameters.
 )doc");
 
+REGISTER_OP("GoldSequenceReader")
+    .Output("features: feature_size * string")
+    .Output("num_epochs: int32")
+    .Output("gold_actions: int32")
+    .Output("lengths: int32")
+    .Attr("task_context: string")
+    .Attr("feature_size: int")
+    .Attr("batch_size: int")
+    .Attr("max_length: int")
+    .Attr("corpus_name: string='documents'")
+    .Attr("arg_prefix: string='brain_parser'")
+    .SetIsStateful()
+    .Doc(R"doc(
+Reads sentences and returns the features and gold actions of all their steps.
+
+Runs the gold actions of batch_size sentences at a time for up to max_length
+steps each, e.g. tagging every token, so that a network can score the steps
+of a sentence together. A sentence with more steps continues in the same
+batch slot in the next batch.
+
+features: [batch_size * max_length, number of features] features of each
+          step, encoded as dist_belief.SparseFeatures protocol buffers. Row
+          b * max_length + t holds step t of slot b; rows past the length of
+          a slot hold no feature ids.
+num_epochs: number of times this reader went over the training corpus.
+gold_actions: [batch_size, max_length] gold action of each step, 0 past the
+              length of a slot.
+lengths: [batch_size] number of steps of each slot, 0 for empty slots.
+task_context: file path at which to read the task context.
+feature_size: number of feature outputs emitted by this reader.
+batch_size: number of sentences to read at a time.
+max_length: largest number of steps emitted per sentence and batch.
+corpus_name: name of task input in the task context to read parses from.
+arg_prefix: prefix for context parameters.
+)doc");
+
 REGISTER_OP("DecodedParseReader")
     .Input("transition_scores: float")
     .Output("features: feature_size * string")
     .Output("num_epochs: int32")
     .Output("eval_metrics: int32")
     .Output("documents: string")
+    .Output("heads: int32")
+    .Output("labels: int32")
+    .Output("document_starts: int32")
     .Attr("task_context: string")
     .Attr("feature_size: int")
     .Attr("batch_size: int")
     .Attr("corpus_name: string='documents'")
     .Attr("arg_prefix: string='brain_parser'")
+    .Attr("in_order: bool=true")
+    .Attr("max_batch_latency_ms: int=0")
+    .Attr("skip_deterministic_states: bool=false")
+    .Attr("ping_pong: bool=false")
+    .Attr("parse_cache_bytes: int=0")
+    .Attr("model_id: string=''")
+    .Attr("slim_output: bool=false")
     .SetIsStateful()
     .Doc(R"doc(
 Reads sentences and parses them taking parsing transitions based on the
@@ -64,11 +110,231 @@ features: features firing at the current parser state encoded as
           dist_belief.SparseFeatures protocol buffers.
 num_epochs: number of times this reader went over the training corpus.
 eval_metrics: token counts used to compute evaluation metrics.
+documents: parsed documents, or their docids if slim_output is true.
+heads: if slim_output is true, the head of each token of the documents, or -1
+       for root tokens.
+labels: if slim_output is true, the label of each token of the documents, as an
+        index into the label map of the task context, or -1 for the root label.
+document_starts: if slim_output is true, the offset into heads and labels of
+                 the first token of each document, followed by the number of
+                 tokens.
 task_context: file path at which to read the task context.
 feature_size: number of feature outputs emitted by this reader.
 batch_size: number of sentences to parse at a time.
 corpus_name: name of task input in the task context to read parses from.
 arg_prefix: prefix for context parameters.
+in_order: whether to output documents in input order. If false, documents are
+          output as soon as they are parsed, and documents without a docid
+          get their zero-based position in the input as docid.
+max_batch_latency_ms: if positive, target wall time between two steps of this
+                      reader. The number of sentences parsed at a time is then
+                      adapted to meet it, up to batch_size, from the measured
+                      cost of the past steps and the number of sentences
+                      waiting in the input.
+skip_deterministic_states: whether to perform the default action of parser
+                           states with a single allowed action without emitting
+                           their features, so that they need no scores.
+ping_pong: whether to alternate between two halves of batch_size / 2 and
+           batch_size - batch_size / 2 sentences, emitting the features of one
+           half per step. The transition scores of a step are then those of
+           the features emitted two steps earlier, possibly none, so that the
+           network can score one half while the reader advances the other.
+           Incompatible with max_batch_latency_ms.
+parse_cache_bytes: if positive, approximate size of a cache of parsed documents
+                   shared by the readers of the process that use the same
+                   size. Sentences whose input tokens were parsed before by
+                   the same model are output from the cache without being
+                   parsed, and are left out of eval_metrics.
+model_id: identifies the model parameters in the keys of the parse cache,
+          along with the task context and arg_prefix.
+slim_output: whether to output the parses as heads and labels rather than as
+             serialized documents, which is much cheaper for callers that only
+             need the dependency trees.
+)doc");
+
+REGISTER_OP("PackedGoldParseReader")
+    .Output("feature_indices: feature_size * int32")
+    .Output("feature_ids: feature_size * int64")
+    .Output("feature_weights: feature_size * float")
+    .Output("feature_batch_size: int32")
+    .Output("num_epochs: int32")
+    .Output("gold_actions: int32")
+    .Attr("task_context: string")
+    .Attr("feature_size: int")
+    .Attr("batch_size: int")
+    .Attr("corpus_name: string='documents'")
+    .Attr("arg_prefix: string='brain_parser'")
+    .SetIsStateful()
+    .Doc(R"doc(
+Same as GoldParseReader, but returns the features packed into flat tensors
+instead of serialized dist_belief.SparseFeatures protocol buffers.
+
+feature_indices: for each feature group, the index of each feature id into the
+                 flattened [feature_batch_size, number of features] matrix
+                 of features, as returned by UnpackSparseFeatures.
+feature_ids: for each feature group, the feature ids.
+feature_weights: for each feature group, the feature weights, or 1 for
+                 unweighted features.
+feature_batch_size: number of parser states the features were extracted from.
+num_epochs: number of times this reader went over the training corpus.
+gold_actions: action to perform at the current parser state.
+task_context: file path at which to read the task context.
+feature_size: number of feature groups emitted by this reader.
+batch_size: number of sentences to parse at a time.
+corpus_name: name of task input in the task context to read parses from.
+arg_prefix: prefix for context parameters.
+)doc");
+
+REGISTER_OP("GoldFeatureReader")
+    .Output("feature_indices: feature_size * int32")
+    .Output("feature_ids: feature_size * int64")
+    .Output("feature_weights: feature_size * float")
+    .Output("feature_batch_size: int32")
+    .Output("num_epochs: int32")
+    .Output("gold_actions: int32")
+    .Attr("files: list(string)")
+    .Attr("feature_size: int")
+    .Attr("batch_size: int")
+    .Attr("shuffle_buffer: int=10000")
+    .Attr("seed: int=0")
+    .SetIsStateful()
+    .Doc(R"doc(
+Same as PackedGoldParseReader, but reads the features and gold actions of the
+parser states from shards written by gold_features_main, in a shuffled order,
+instead of running the oracle of the transition system.
+
+feature_indices: for each feature group, the index of each feature id into the
+                 flattened [feature_batch_size, number of features] matrix
+                 of features, as returned by UnpackSparseFeatures.
+feature_ids: for each feature group, the feature ids.
+feature_weights: for each feature group, the feature weights, or 1 for
+                 unweighted features.
+feature_batch_size: number of parser states in the batch.
+num_epochs: number of times this reader went over the shards.
+gold_actions: gold action of each parser state.
+files: gold feature shards to read.
+feature_size: number of feature groups in the shards.
+batch_size: maximum number of parser states in a batch. The last batch of an
+            epoch may be smaller.
+shuffle_buffer: number of parser states read ahead, from which each parser
+                state of a batch is drawn at random.
+seed: seed of the shard order and the draws.
+)doc");
+
+REGISTER_OP("PackedDecodedParseReader")
+    .Input("transition_scores: float")
+    .Output("feature_indices: feature_size * int32")
+    .Output("feature_ids: feature_size * int64")
+    .Output("feature_weights: feature_size * float")
+    .Output("feature_batch_size: int32")
+    .Output("num_epochs: int32")
+    .Output("eval_metrics: int32")
+    .Output("documents: string")
+    .Output("heads: int32")
+    .Output("labels: int32")
+    .Output("document_starts: int32")
+    .Attr("task_context: string")
+    .Attr("feature_size: int")
+    .Attr("batch_size: int")
+    .Attr("corpus_name: string='documents'")
+    .Attr("arg_prefix: string='brain_parser'")
+    .Attr("in_order: bool=true")
+    .Attr("max_batch_latency_ms: int=0")
+    .Attr("skip_deterministic_states: bool=false")
+    .Attr("ping_pong: bool=false")
+    .Attr("parse_cache_bytes: int=0")
+    .Attr("model_id: string=''")
+    .Attr("slim_output: bool=false")
+    .SetIsStateful()
+    .Doc(R"doc(
+Same as DecodedParseReader, but returns the features packed into flat tensors
+instead of serialized dist_belief.SparseFeatures protocol buffers.
+
+transition_scores: scores for every transition from the current parser state.
+feature_indices: for each feature group, the index of each feature id into the
+                 flattened [feature_batch_size, number of features] matrix
+                 of features, as returned by UnpackSparseFeatures.
+feature_ids: for each feature group, the feature ids.
+feature_weights: for each feature group, the feature weights, or 1 for
+                 unweighted features.
+feature_batch_size: number of parser states the features were extracted from.
+num_epochs: number of times this reader went over the training corpus.
+eval_metrics: token counts used to compute evaluation metrics.
+documents: parsed documents, or their docids if slim_output is true.
+heads: if slim_output is true, the head of each token of the documents, or -1
+       for root tokens.
+labels: if slim_output is true, the label of each token of the documents, as an
+        index into the label map of the task context, or -1 for the root label.
+document_starts: if slim_output is true, the offset into heads and labels of
+                 the first token of each document, followed by the number of
+                 tokens.
+task_context: file path at which to read the task context.
+feature_size: number of feature groups emitted by this reader.
+batch_size: number of sentences to parse at a time.
+corpus_name: name of task input in the task context to read parses from.
+arg_prefix: prefix for context parameters.
+in_order: whether to output documents in input order. If false, documents are
+          output as soon as they are parsed, and documents without a docid
+          get their zero-based position in the input as docid.
+max_batch_latency_ms: if positive, target wall time between two steps of this
+                      reader. The number of sentences parsed at a time is then
+                      adapted to meet it, up to batch_size, from the measured
+                      cost of the past steps and the number of sentences
+                      waiting in the input.
+skip_deterministic_states: whether to perform the default action of parser
+                           states with a single allowed action without emitting
+                           their features, so that they need no scores.
+ping_pong: whether to alternate between two halves of batch_size / 2 and
+           batch_size - batch_size / 2 sentences, emitting the features of one
+           half per step. The transition scores of a step are then those of
+           the features emitted two steps earlier, possibly none, so that the
+           network can score one half while the reader advances the other.
+           Incompatible with max_batch_latency_ms.
+parse_cache_bytes: if positive, approximate size of a cache of parsed documents
+                   shared by the readers of the process that use the same
+                   size. Sentences whose input tokens were parsed before by
+                   the same model are output from the cache without being
+                   parsed, and are left out of eval_metrics.
+model_id: identifies the model parameters in the keys of the parse cache,
+          along with the task context and arg_prefix.
+slim_output: whether to output the parses as heads and labels rather than as
+             serialized documents, which is much cheaper for callers that only
+             need the dependency trees.
+)doc");
+
+REGISTER_OP("GreedyParseDecoder")
+    .Input("embedding_matrices: feature_size * float")
+    .Input("layer_weights: num_layers * float")
+    .Input("layer_biases: num_layers * float")
+    .Output("num_epochs: int32")
+    .Output("eval_metrics: int32")
+    .Output("documents: string")
+    .Attr("task_context: string")
+    .Attr("feature_size: int")
+    .Attr("num_layers: int >= 1")
+    .Attr("batch_size: int")
+    .Attr("corpus_name: string='documents'")
+    .Attr("arg_prefix: string='brain_parser'")
+    .SetIsStateful()
+    .Doc(R"doc(
+Reads sentences and parses them to the end with a greedy feed-forward network
+evaluated inside the op, taking all parsing transitions of a batch in one step.
+The network is evaluated by the network scorer named by the
+<arg_prefix>_network_scorer task parameter, "feed-forward" by default.
+
+embedding_matrices: for each feature group, the embedding matrix.
+layer_weights: weights of each ReLU layer, followed by the softmax weights.
+layer_biases: bias of each ReLU layer, followed by the softmax bias.
+num_epochs: number of times this reader went over the corpus. Incremented by a
+            step that outputs no documents.
+eval_metrics: token counts used to compute evaluation metrics.
+documents: parsed documents, in input order.
+task_context: file path at which to read the task context.
+feature_size: number of feature groups.
+num_layers: number of layers, including the softmax layer.
+batch_size: number of sentences to parse at a time.
+corpus_name: name of task input in the task context to read parses from.
+arg_prefix: prefix for context parameters.
 )doc");
 
 REGISTER_OP("BeamParseReader")
@@ -84,6 +350,7 @@ REGISTER_OP("BeamParseReader")
     .Attr("arg_prefix: string='brain_parser'")
     .Attr("continue_until_all_final: bool=false")
     .Attr("always_start_new_sentences: bool=false")
+    .Attr("inference: bool=false")
     .SetIsStateful()
     .Doc(R"doc(
 Reads sentences and creates a beam parser.
@@ -102,6 +369,52 @@ continue_until_all_final: whether to continue parsing after the gold path falls
                           off the beam.
 always_start_new_sentences: whether to skip to the beginning of a new sentence
                             after each training step.
+inference: whether the beams are only decoded. The path histories and score
+           offsets that BeamParserOutput needs are then not recorded, so
+           memory does not grow with the number of parsing steps.
+)doc");
+
+REGISTER_OP("FeedBeamParseReader")
+    .Input("documents: string")
+    .Output("features: feature_size * string")
+    .Output("beam_state: int64")
+    .Output("num_epochs: int32")
+    .Attr("task_context: string")
+    .Attr("feature_size: int")
+    .Attr("beam_size: int")
+    .Attr("batch_size: int=1")
+    .Attr("allow_feature_weights: bool=true")
+    .Attr("arg_prefix: string='brain_parser'")
+    .Attr("continue_until_all_final: bool=false")
+    .Attr("always_start_new_sentences: bool=false")
+    .Attr("inference: bool=false")
+    .Attr("batch_handle: bool=false")
+    .SetIsStateful()
+    .Doc(R"doc(
+Same as BeamParseReader, but reads the sentences fed through its input instead
+of a corpus. Fed sentences are started on by beams that are free to start a new
+sentence, so with always_start_new_sentences, an evaluation step over the beam
+returns their parses right away.
+
+documents: serialized Sentence protos to parse, at most batch_size including
+           fed sentences that no beam has started on yet, or the handle of a
+           document batch if batch_handle is set.
+features: features firing at the initial parser state encoded as
+          dist_belief.SparseFeatures protocol buffers.
+beam_state: beam state handle.
+task_context: file path at which to read the task context.
+feature_size: number of feature outputs emitted by this reader.
+beam_size: limit on the beam size.
+allow_feature_weights: whether the op is expected to output weighted features.
+                       If false, it will check that no weights are specified.
+arg_prefix: prefix for context parameters.
+continue_until_all_final: whether to continue parsing after the gold path falls
+                          off the beam.
+always_start_new_sentences: whether to skip to the beginning of a new sentence
+                            after each training step.
+inference: whether the beams are only decoded. The path histories and score
+           offsets that BeamParserOutput needs are then not recorded, so
+           memory does not grow with the number of parsing steps.
 )doc");
 
 REGISTER_OP("BeamParser")
@@ -151,6 +464,7 @@ REGISTER_OP("BeamEvalOutput")
     .Input("beam_state: int64")
     .Output("eval_metrics: int32")
     .Output("documents: string")
+    .Attr("num_alternatives: int=0")
     .SetIsStateful()
     .Doc(R"doc(
 Computes eval metrics for the best paths in the input beams.
@@ -158,6 +472,50 @@ Computes eval metrics for the best paths in the input beams.
 beam_state: beam state handle.
 eval_metrics: token counts used to compute evaluation metrics.
 documents: parsed documents.
+num_alternatives: if positive, each document also lists up to this many best
+                  parses of the beam with their scores, best first, in its
+                  KBestSyntaxAnalyses extension.
+)doc");
+
+REGISTER_OP("BeamParseDecoder")
+    .Input("embedding_matrices: feature_size * float")
+    .Input("layer_weights: num_layers * float")
+    .Input("layer_biases: num_layers * float")
+    .Output("num_epochs: int32")
+    .Output("eval_metrics: int32")
+    .Output("documents: string")
+    .Attr("task_context: string")
+    .Attr("feature_size: int")
+    .Attr("num_layers: int >= 1")
+    .Attr("beam_size: int")
+    .Attr("batch_size: int=1")
+    .Attr("max_steps: int=300")
+    .Attr("num_alternatives: int=0")
+    .Attr("corpus_name: string='documents'")
+    .Attr("arg_prefix: string='brain_parser'")
+    .SetIsStateful()
+    .Doc(R"doc(
+Reads sentences and parses them to the end with a beam, scoring parser states
+with a feed-forward network evaluated inside the op, in one step per batch.
+The network is evaluated by the network scorer named by the
+<arg_prefix>_network_scorer task parameter, "feed-forward" by default.
+
+embedding_matrices: for each feature group, the embedding matrix.
+layer_weights: weights of each ReLU layer, followed by the softmax weights.
+layer_biases: bias of each ReLU layer, followed by the softmax bias.
+num_epochs: number of times this reader went over the corpus.
+eval_metrics: token counts used to compute evaluation metrics.
+documents: best parses of the sentences of the batch.
+task_context: file path at which to read the task context.
+feature_size: number of feature groups.
+num_layers: number of layers, including the softmax layer.
+beam_size: limit on the beam size.
+batch_size: number of sentences to parse at a time.
+max_steps: maximum number of parsing steps per batch.
+num_alternatives: if positive, each document also lists up to this many best
+                  parses with their scores, as in BeamEvalOutput.
+corpus_name: name of task input in the task context to read parses from.
+arg_prefix: prefix for context parameters.
 )doc");
 
 REGISTER_OP("LexiconBuilder")
@@ -195,8 +553,10 @@ arg_prefix: prefix for context parameters.
 REGISTER_OP("UnpackSparseFeatures")
     .Input("sf: string")
     .Output("indices: int32")
-    .Output("ids: int64")
+    .Output("ids: out_type")
     .Output("weights: float")
+    .Attr("out_type: {int32, int64} = DT_INT64")
+    .Attr("with_weights: bool = true")
     .Doc(R"doc(
 Converts a vector of strings with SparseFeatures to tensors.
 
@@ -211,7 +571,199 @@ sf: vector of string, where each element is the string encoding of
     SpareFeatures proto.
 indices: vector of indices inside sf
 ids: vector of id extracted from the SparseFeatures proto.
-weights: vector of weight extracted from the SparseFeatures proto.
+weights: vector of weight extracted from the SparseFeatures proto, or an empty
+         vector without with_weights.
+out_type: type of the ids. int32 halves their size, and fails on ids that do
+          not fit.
+with_weights: whether to decode the weights. Unweighted features can leave
+              them out.
+)doc");
+
+REGISTER_OP("EmbedFeatures")
+    .Input("feature_indices: feature_size * int32")
+    .Input("feature_ids: feature_size * int64")
+    .Input("feature_weights: feature_size * float")
+    .Input("embedding_matrices: feature_size * T")
+    .Input("feature_batch_size: int32")
+    .Output("embeddings: float")
+    .Attr("feature_size: int")
+    .Attr("num_features: list(int)")
+    .Attr("allow_weights: bool=true")
+    .Attr("T: {float, half} = DT_FLOAT")
+    .Doc(R"doc(
+Looks up and concatenates the embeddings of packed features in one op.
+
+Output row r holds, for each feature group i and each of its features k, the
+sum of the embeddings of the ids of the k-th feature of parser state r, looked
+up in the i-th embedding matrix and optionally scaled by their weights. This
+is what a concatenation of EmbeddingLookupFeatures over all feature groups
+computes, without its intermediate tensors.
+
+feature_indices: for each feature group, the index of each feature id into the
+                 flattened [feature_batch_size, num_features[i]] matrix of
+                 features, as returned by the packed parsing readers.
+feature_ids: for each feature group, the feature ids.
+feature_weights: for each feature group, the feature weights.
+embedding_matrices: for each feature group, the embedding matrix, in float or
+                    half precision. Half precision rows are converted to float
+                    as they are summed.
+feature_batch_size: number of parser states the features were extracted from.
+embeddings: [feature_batch_size, sum of num_features[i] * embedding size of
+            group i] concatenated embeddings.
+feature_size: number of feature groups.
+num_features: number of features in each feature group.
+allow_weights: whether to scale the embeddings by the feature weights.
+T: type of the embedding matrices.
+)doc");
+
+REGISTER_OP("EmbeddingBag")
+    .Input("params: T")
+    .Input("indices: int32")
+    .Input("ids: Tid")
+    .Input("weights: float")
+    .Input("num_segments: int32")
+    .Output("embeddings: float")
+    .Attr("allow_weights: bool=true")
+    .Attr("T: {float, half} = DT_FLOAT")
+    .Attr("Tid: {int32, int64} = DT_INT64")
+    .Doc(R"doc(
+Sums the embeddings of the ids of each segment in one op.
+
+Output row s is the sum of the rows params[ids[j]] over all j with
+indices[j] = s, optionally scaled by weights[j]. This is what an unsorted
+segment sum of the gathered and weighted rows computes, without its
+intermediate tensors, and with the segments summed in parallel.
+
+params: embedding matrix, in float or half precision.
+indices: segment of each id, e.g. as returned by UnpackSparseFeatures.
+ids: ids of the embeddings to sum.
+weights: weight of each id, or empty without allow_weights.
+num_segments: number of output rows.
+embeddings: [num_segments, embedding size] sums of embeddings.
+allow_weights: whether to scale the embeddings by the weights.
+)doc");
+
+REGISTER_OP("LazyMovingAverage")
+    .Input("average: Ref(float)")
+    .Input("synced: Ref(double)")
+    .Input("param: float")
+    .Input("ids: Tid")
+    .Input("log_decay: double")
+    .Output("average_out: Ref(float)")
+    .Attr("Tid: {int32, int64} = DT_INT32")
+    .Attr("use_locking: bool=false")
+    .Doc(R"doc(
+Catches rows of an exponential moving average of a parameter up to a step.
+
+The average is only updated when its rows are synced, so that a step only
+updates the averages of the rows it changes, e.g. those of an embedding matrix
+with gradients. The rows of the parameter must not have changed since their
+last sync, so that the steps since then, each updating a row by
+  average = decay * average + (1 - decay) * param,
+add up to one update with the product of their decays. The decays are given
+as cumulative sums of their logarithms over the steps: each row is updated
+with decay exp(log_decay - synced[row]), and synced[row] is set to log_decay.
+
+average: moving average of param, updated in place.
+synced: for each row of the average, the cumulative log decay it is synced to.
+param: the averaged parameter, with the shape of the average.
+ids: rows to sync, without duplicates.
+log_decay: cumulative log decay of the step to sync the rows to.
+average_out: the updated average.
+use_locking: whether to update the average under its lock.
+)doc");
+
+REGISTER_OP("HugePageCopy")
+    .Input("input: T")
+    .Output("output: T")
+    .Attr("T: type")
+    .Attr("min_bytes: int = 33554432")
+    .SetIsStateful()
+    .Doc(R"doc(
+Copies a large parameter to huge pages, against the TLB misses of its lookups.
+
+When it first runs, copies its input to memory on 2MB huge pages if it takes
+at least min_bytes, and outputs that copy from then on without copying again,
+so the input must not change afterwards, as for the restored parameters of an
+evaluation network. Smaller inputs are passed through.
+
+input: the parameter.
+output: the parameter, or its copy on huge pages.
+min_bytes: size from which parameters are copied.
+)doc");
+
+REGISTER_OP("HugePageStats")
+    .Output("stats: int64")
+    .SetIsStateful()
+    .Doc(R"doc(
+Reports the memory that HugePageCopy copied parameters to.
+
+stats: the number of copies still in use, their total bytes, and how many of
+  these bytes the kernel backs with huge pages.
+)doc");
+
+REGISTER_OP("PrecomputedEmbedFeatures")
+    .Input("feature_indices: feature_size * int32")
+    .Input("feature_ids: feature_size * int64")
+    .Input("feature_weights: feature_size * float")
+    .Input("precomputed_tables: feature_size * float")
+    .Input("embedding_matrices: feature_size * float")
+    .Input("layer_weights: float")
+    .Input("feature_batch_size: int32")
+    .Output("layer_input: float")
+    .Attr("feature_size: int")
+    .Attr("num_features: list(int)")
+    .Attr("allow_weights: bool=true")
+    .Doc(R"doc(
+Computes the product of the embeddings of packed features, as concatenated by
+EmbedFeatures, with the weights of the first hidden layer, by summing rows of
+precomputed tables instead of multiplying.
+
+The table of feature group i holds one row for each of its first ids and each
+of its features: row id * num_features[i] + k is the embedding of id times the
+layer weights of feature k of the group. Ids past the table are multiplied
+with the layer weights as they are looked up.
+
+feature_indices: for each feature group, the index of each feature id into the
+                 flattened [feature_batch_size, num_features[i]] matrix of
+                 features, as returned by the packed parsing readers.
+feature_ids: for each feature group, the feature ids.
+feature_weights: for each feature group, the feature weights.
+precomputed_tables: for each feature group, the precomputed table.
+embedding_matrices: for each feature group, the embedding matrix.
+layer_weights: [embedding size, hidden layer size] first layer weights.
+feature_batch_size: number of parser states the features were extracted from.
+layer_input: [feature_batch_size, hidden layer size] first layer input, before
+             adding the bias.
+feature_size: number of feature groups.
+num_features: number of features in each feature group.
+allow_weights: whether to scale the embeddings by the feature weights.
+)doc");
+
+REGISTER_OP("TopAllowedActions")
+    .Input("logits: float")
+    .Input("allowed: bool")
+    .Output("actions: int32")
+    .Output("scores: float")
+    .Attr("k: int >= 1 = 1")
+    .Attr("log_normalize: bool = true")
+    .Doc(R"doc(
+Selects the k best allowed actions of each parser state from its logits.
+
+This replaces a softmax over all actions followed by a masked argmax or top-k
+at inference time, since neither needs the normalized distribution: the best
+actions are selected from the logits in one pass, and their log-softmax scores
+are computed without materializing the softmax.
+
+logits: [batch_size, num_actions] scores of the actions of each parser state.
+allowed: [batch_size, num_actions] whether each action is allowed in each
+         parser state, as given by the transition system.
+actions: [batch_size, k] best allowed actions of each state, best first, with
+         ties going to the lowest action, padded with -1 if fewer than k
+         actions are allowed.
+scores: [batch_size, k] scores of the actions, padded with -inf.
+k: number of actions to select per state, 1 for greedy decoding.
+log_normalize: whether to output log-softmax scores rather than the logits.
 )doc");
 
 REGISTER_OP("WordEmbeddingInitializer")
@@ -219,6 +771,9 @@ REGISTER_OP("WordEmbeddingInitializer")
     .Attr("vectors: string")
     .Attr("task_context: string")
     .Attr("embedding_init: float = 1.0")
+    .Attr("seed: int = 0")
+    .Attr("seed2: int = 0")
+    .SetIsStateful()
     .Doc(R"doc(
 Reads word embeddings from an sstable of dist_belief.TokenEmbedding protos for
 every word specified in a text vocabulary file.
@@ -226,6 +781,42 @@ every word specified in a text vocabulary file.
 word_embeddings: a tensor containing word embeddings from the specified sstable.
 vectors: path to recordio of word embedding vectors.
 task_context: file path at which to read the task context.
+embedding_init: words without a vector get random normal embeddings with a
+  standard deviation of embedding_init / sqrt(embedding size).
+seed: if either seed or seed2 are set to be non-zero, the random number
+  generator is seeded by the given seed.  Otherwise, it is seeded by a
+  random seed.
+seed2: a second seed to avoid seed collision.
+)doc");
+
+REGISTER_OP("ReaderStatsSummary")
+    .Output("summary: string")
+    .Attr("clear: bool=false")
+    .SetIsStateful()
+    .Doc(R"doc(
+Returns the latency and throughput statistics of the reader ops in this process.
+
+summary: serialized Summary proto with histograms of the per-call latency in
+  microseconds of each reader stage, of the batch occupancy and of the beam
+  sizes after pruning, and the number of sentences read per second of reader
+  steps.
+clear: whether to start collecting new histograms afterwards.
+)doc");
+
+REGISTER_OP("FeatureProfileReport")
+    .Output("report: string")
+    .Attr("clear: bool=false")
+    .SetIsStateful()
+    .Doc(R"doc(
+Returns the costs of the feature expressions sampled in this process.
+
+Features are only profiled if the feature_profile_period parameter of a task
+context whose features were set up is positive, see feature_profiler.h.
+
+report: table of the share of the sampled time, the mean time per sampled
+  Preprocess and Evaluate call and the mean number of values per Evaluate
+  call of each feature expression, most expensive first.
+clear: whether to clear the sampled costs afterwards.
 )doc");
 
 REGISTER_OP("DocumentSource")
@@ -234,23 +825,48 @@ REGISTER_OP("DocumentSource")
     .Attr("task_context: string")
     .Attr("corpus_name: string='documents'")
     .Attr("batch_size: int")
+    .Attr("batch_handle: bool = False")
     .SetIsStateful()
     .Doc(R"doc(
 Reads documents from documents_path and outputs them.
 
-documents: a vector of documents as serialized protos.
+If the corpus has the 'sentence-queue' record format, documents are instead
+taken from the in-memory queue named by its file pattern, and 'last' is set
+once the queue is empty.
+
+documents: a vector of documents as serialized protos, or the handle of a
+  document batch if batch_handle is set.
 last: whether this is the last batch of documents from this document path.
 batch_size: how many documents to read at once.
+batch_handle: whether to output the documents as an in-memory document batch,
+  to be read by exactly one op with batch_handle set, instead of serializing
+  them.
 )doc");
 
 REGISTER_OP("DocumentSink")
     .Input("documents: string")
     .Attr("task_context: string")
     .Attr("corpus_name: string='documents'")
+    .Attr("batch_handle: bool = False")
+    .Attr("num_shards: int = 1")
+    .Attr("writer_queue_size: int = 0")
     .Doc(R"doc(
 Write documents to documents_path.
 
+If the corpus has the 'sentence-queue' record format, documents are instead
+appended to the in-memory queue named by its file pattern, from which readers
+in the same process can consume them without a text round trip. With the
+'sentence-record' record format, documents are written as binary records.
+
 documents: documents to write.
+batch_handle: whether documents is the handle of a document batch.
+num_shards: number of files to write. With more than one, each batch goes to
+            the next of the files <file pattern>-00000-of-<num_shards> and so
+            on, which the file pattern <file pattern>-* reads back.
+writer_queue_size: if positive, each file is written on a thread of its own
+                   from a queue of at most this many batches, and serialized
+                   documents are parsed there. A step then only waits when the
+                   queue for its batch is full.
 )doc");
 
 REGISTER_OP("WellFormedFilter")
@@ -259,6 +875,7 @@ REGISTER_OP("WellFormedFilter")
     .Attr("task_context: string")
     .Attr("corpus_name: string='documents'")
     .Attr("keep_malformed_documents: bool = False")
+    .Attr("batch_handle: bool = False")
     .Doc(R"doc(
 )doc");
 
@@ -268,7 +885,34 @@ REGISTER_OP("ProjectivizeFilter")
     .Attr("task_context: string")
     .Attr("corpus_name: string='documents'")
     .Attr("discard_non_projective: bool = False")
+    .Attr("batch_handle: bool = False")
     .Doc(R"doc(
 )doc");
 
+REGISTER_OP("WellFormedProjectivizeFilter")
+    .Input("documents: string")
+    .Output("filtered: string")
+    .Attr("task_context: string")
+    .Attr("corpus_name: string='documents'")
+    .Attr("keep_malformed_documents: bool = False")
+    .Attr("discard_non_projective: bool = False")
+    .Attr("batch_handle: bool = False")
+    .Doc(R"doc(
+Filters documents as WellFormedFilter followed by ProjectivizeFilter would,
+parsing each document once.
+
+Malformed documents that are kept are output unchanged.
+
+documents: a vector of documents as serialized protos.
+filtered: the kept documents, with projective trees.
+task_context: file path at which to read the task context.
+corpus_name: name of the corpus in the task context.
+keep_malformed_documents: whether to keep documents with cycles or heads
+  outside the document.
+discard_non_projective: whether to discard non-projective documents instead of
+  projectivizing them.
+batch_handle: whether documents and filtered are handles of document batches.
+  All three filters read and output the same kind of documents.
+)doc");
+
 }  // namespace syntaxnet
@@ -0,0 +1,128 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/parse_cache.h"
+
+#include <string.h>
+
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace syntaxnet {
+namespace {
+
+// Guards the map of shared caches.
+mutex shared_parse_caches_mutex(tensorflow::LINKER_INITIALIZED);
+
+// Shared caches by size.
+std::unordered_map<int64, ParseCache *> *SharedParseCaches() {
+  static auto *caches = new std::unordered_map<int64, ParseCache *>();
+  return caches;
+}
+
+}  // namespace
+
+ParseCache::ParseCache(int64 max_bytes) : max_bytes_(max_bytes) {}
+
+ParseCache *ParseCache::Get(int64 max_bytes) {
+  mutex_lock lock(shared_parse_caches_mutex);
+  ParseCache *&shared = (*SharedParseCaches())[max_bytes];
+  if (shared == nullptr) shared = new ParseCache(max_bytes);
+  ++shared->refcount_;
+  return shared;
+}
+
+void ParseCache::Release(ParseCache *cache) {
+  if (cache == nullptr) return;
+  mutex_lock lock(shared_parse_caches_mutex);
+  auto it = SharedParseCaches()->find(cache->max_bytes_);
+  CHECK(it != SharedParseCaches()->end() && it->second == cache);
+  if (--cache->refcount_ == 0) {
+    delete cache;
+    SharedParseCaches()->erase(it);
+  }
+}
+
+uint64 ParseCache::ModelKey(const string &model) {
+  return tensorflow::Fingerprint64(model);
+}
+
+uint64 ParseCache::Key(uint64 model_key, const Sentence &sentence) {
+  string data(sizeof(model_key), '\0');
+  memcpy(&data[0], &model_key, sizeof(model_key));
+  for (const Token &token : sentence.token()) {
+    // Tokens are length-prefixed, so that different token lists never have
+    // the same encoding.
+    const uint32 size = token.ByteSize();
+    data.append(reinterpret_cast<const char *>(&size), sizeof(size));
+    token.AppendToString(&data);
+  }
+  return tensorflow::Fingerprint64(data);
+}
+
+bool ParseCache::Lookup(uint64 key, Sentence *document) {
+  mutex_lock lock(mu_);
+  auto it = index_.find(key);
+  if (it == index_.end()) {
+    ++num_misses_;
+    return false;
+  }
+  ++num_hits_;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  *document->mutable_token() = it->second->tokens;
+  return true;
+}
+
+void ParseCache::Insert(uint64 key, const Sentence &document) {
+  int64 bytes = sizeof(Entry);
+  for (const Token &token : document.token()) {
+    bytes += sizeof(Token) + token.ByteSize();
+  }
+  if (bytes > max_bytes_) return;
+  mutex_lock lock(mu_);
+  if (index_.count(key) > 0) return;
+  while (bytes_ + bytes > max_bytes_) EvictLast();
+  entries_.emplace_front();
+  Entry &entry = entries_.front();
+  entry.key = key;
+  entry.tokens = document.token();
+  entry.bytes = bytes;
+  index_[key] = entries_.begin();
+  bytes_ += bytes;
+}
+
+void ParseCache::EvictLast() {
+  const Entry &entry = entries_.back();
+  bytes_ -= entry.bytes;
+  index_.erase(entry.key);
+  entries_.pop_back();
+}
+
+int64 ParseCache::bytes() const {
+  mutex_lock lock(mu_);
+  return bytes_;
+}
+
+int64 ParseCache::num_hits() const {
+  mutex_lock lock(mu_);
+  return num_hits_;
+}
+
+int64 ParseCache::num_misses() const {
+  mutex_lock lock(mu_);
+  return num_misses_;
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,115 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Cache of the parses of recently decoded sentences.
+//
+// Large corpora repeat many sentences verbatim, like boilerplate and titles.
+// The greedy decoding readers can look up each sentence they read in a cache
+// of the tokens of the documents they output, keyed by a fingerprint of the
+// input tokens and of the model, and output a cached parse without decoding
+// the sentence again. A cache is bounded by the approximate size of the tokens
+// it holds, evicting the least recently used parses, and is shared by the ops
+// of the process that ask for the same size.
+
+#ifndef SYNTAXNET_PARSE_CACHE_H_
+#define SYNTAXNET_PARSE_CACHE_H_
+
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/protobuf.h"
+
+namespace syntaxnet {
+
+class ParseCache {
+ public:
+  // Creates an empty cache of at most max_bytes of parses.
+  explicit ParseCache(int64 max_bytes);
+
+  // Returns the shared cache of the given size, creating it on first use. The
+  // result must be released with Release().
+  static ParseCache *Get(int64 max_bytes);
+
+  // Releases a cache acquired by Get(), deleting it when no op uses it
+  // anymore. Does nothing if the cache is null.
+  static void Release(ParseCache *cache);
+
+  // Returns the fingerprint identifying a model, e.g. from its task context
+  // and the name of its parameters.
+  static uint64 ModelKey(const string &model);
+
+  // Returns the key of the parse of the sentence by the given model. The key
+  // covers all fields of the input tokens, not just their words, since the
+  // features of a model may read input tags or labels.
+  static uint64 Key(uint64 model_key, const Sentence &sentence);
+
+  // If a parse is cached under key, replaces the tokens of *document with its
+  // tokens, marks it as most recently used and returns true.
+  bool Lookup(uint64 key, Sentence *document);
+
+  // Caches the tokens of a parsed document under key, evicting the least
+  // recently used parses as needed. Parses larger than the whole cache are
+  // not cached.
+  void Insert(uint64 key, const Sentence &document);
+
+  // Accessors for the approximate size of the cached parses and the hit and
+  // miss counts of Lookup().
+  int64 bytes() const;
+  int64 num_hits() const;
+  int64 num_misses() const;
+
+ private:
+  // A cached parse, with its key and its approximate size.
+  struct Entry {
+    uint64 key = 0;
+    tensorflow::protobuf::RepeatedPtrField<Token> tokens;
+    int64 bytes = 0;
+  };
+
+  // Removes the least recently used parse.
+  void EvictLast();
+
+  // Maximum size of the cached parses.
+  const int64 max_bytes_;
+
+  // Number of Get() calls not matched by a Release(). Guarded by the lock of
+  // the shared caches.
+  int refcount_ = 0;
+
+  // Guards the members below.
+  mutable mutex mu_;
+
+  // Parses from the most to the least recently used, and their positions in
+  // that list by key.
+  std::list<Entry> entries_;
+  std::unordered_map<uint64, std::list<Entry>::iterator> index_;
+
+  // Approximate size of the cached parses.
+  int64 bytes_ = 0;
+
+  // Hit and miss counts of Lookup().
+  int64 num_hits_ = 0;
+  int64 num_misses_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ParseCache);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_PARSE_CACHE_H_
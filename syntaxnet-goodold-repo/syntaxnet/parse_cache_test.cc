@@ -0,0 +1,116 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/parse_cache.h"
+
+#include <string>
+
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+namespace {
+
+// Returns a sentence with the given words.
+Sentence MakeSentence(const vector<string> &words) {
+  Sentence sentence;
+  for (const string &word : words) sentence.add_token()->set_word(word);
+  return sentence;
+}
+
+// Returns the sentence parsed as a chain of tokens with the given tag.
+Sentence Parse(const Sentence &sentence, const string &tag) {
+  Sentence document = sentence;
+  for (int i = 0; i < document.token_size(); ++i) {
+    document.mutable_token(i)->set_tag(tag);
+    document.mutable_token(i)->set_head(i - 1);
+  }
+  return document;
+}
+
+TEST(ParseCacheTest, ReturnsCachedTokens) {
+  ParseCache cache(1 << 20);
+  const uint64 model = ParseCache::ModelKey("model");
+  const Sentence sentence = MakeSentence({"a", "b"});
+  Sentence document = sentence;
+  EXPECT_FALSE(cache.Lookup(ParseCache::Key(model, sentence), &document));
+  cache.Insert(ParseCache::Key(model, sentence), Parse(sentence, "X"));
+
+  document = sentence;
+  document.set_docid("doc");
+  ASSERT_TRUE(cache.Lookup(ParseCache::Key(model, sentence), &document));
+  EXPECT_EQ("doc", document.docid());
+  ASSERT_EQ(2, document.token_size());
+  EXPECT_EQ("X", document.token(1).tag());
+  EXPECT_EQ(0, document.token(1).head());
+  EXPECT_EQ(1, cache.num_hits());
+  EXPECT_EQ(1, cache.num_misses());
+}
+
+TEST(ParseCacheTest, KeysDependOnModelAndTokens) {
+  const uint64 model = ParseCache::ModelKey("model");
+  const Sentence sentence = MakeSentence({"a", "b"});
+  const uint64 key = ParseCache::Key(model, sentence);
+  EXPECT_EQ(key, ParseCache::Key(model, MakeSentence({"a", "b"})));
+  EXPECT_NE(key, ParseCache::Key(ParseCache::ModelKey("other"), sentence));
+  EXPECT_NE(key, ParseCache::Key(model, MakeSentence({"ab"})));
+  EXPECT_NE(key, ParseCache::Key(model, Parse(sentence, "X")));
+}
+
+TEST(ParseCacheTest, EvictsLeastRecentlyUsed) {
+  const uint64 model = ParseCache::ModelKey("model");
+  const Sentence a = MakeSentence({"a"});
+  const Sentence b = MakeSentence({"b"});
+  const Sentence c = MakeSentence({"c"});
+
+  // Measures the size of one parse, and makes room for two.
+  ParseCache sizer(1 << 20);
+  sizer.Insert(0, Parse(a, "X"));
+  ParseCache cache(2 * sizer.bytes());
+
+  cache.Insert(ParseCache::Key(model, a), Parse(a, "X"));
+  cache.Insert(ParseCache::Key(model, b), Parse(b, "X"));
+  Sentence document;
+  EXPECT_TRUE(cache.Lookup(ParseCache::Key(model, a), &document));
+  cache.Insert(ParseCache::Key(model, c), Parse(c, "X"));
+  EXPECT_EQ(2 * sizer.bytes(), cache.bytes());
+  EXPECT_TRUE(cache.Lookup(ParseCache::Key(model, a), &document));
+  EXPECT_FALSE(cache.Lookup(ParseCache::Key(model, b), &document));
+  EXPECT_TRUE(cache.Lookup(ParseCache::Key(model, c), &document));
+
+  // Parses larger than the cache are dropped.
+  const Sentence long_sentence =
+      MakeSentence({"a", "b", "c", "d", "e", "f", "g", "h"});
+  cache.Insert(ParseCache::Key(model, long_sentence),
+               Parse(long_sentence, "X"));
+  EXPECT_TRUE(cache.Lookup(ParseCache::Key(model, a), &document));
+}
+
+TEST(ParseCacheTest, SharesCachesOfTheSameSize) {
+  ParseCache *cache = ParseCache::Get(1000);
+  ParseCache *same = ParseCache::Get(1000);
+  ParseCache *other = ParseCache::Get(2000);
+  EXPECT_EQ(cache, same);
+  EXPECT_NE(cache, other);
+  ParseCache::Release(cache);
+  ParseCache::Release(same);
+  ParseCache::Release(other);
+}
+
+}  // namespace
+}  // namespace syntaxnet
@@ -0,0 +1,514 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Throughput benchmarks of the parser pipeline, from reading CoNLL sentences
+// to greedy and beam decoding, over a fixed synthetic corpus with sentences of
+// 10, 25 or 50 tokens. Throughput is reported in tokens per second, except for
+// UnpackSparseFeatures which reports parser states per second. Run with
+//
+//   parser_benchmark --benchmarks=all
+//
+// or a regular expression matching the benchmark names.
+//
+// The benchmarks of the stages of the hot path, from reading sentences to
+// extracting features, also count the heap allocations of their timed parts,
+// see allocation_counter.h, and report them per sentence in their labels.
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/allocation_counter.h"
+#include "syntaxnet/embedding_feature_extractor.h"
+#include "syntaxnet/parser_state.h"
+#include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/proto_io.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/sparse.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/task_spec.pb.h"
+#include "syntaxnet/term_frequency_map.h"
+#include "syntaxnet/utils.h"
+#include "syntaxnet/workspace.h"
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/graph.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace syntaxnet {
+namespace {
+
+using tensorflow::Graph;
+using tensorflow::NodeBuilder;
+using tensorflow::Tensor;
+using tensorflow::TensorShape;
+using tensorflow::strings::StrAppend;
+using tensorflow::strings::StrCat;
+
+// Number of sentences of each length in the synthetic corpus. All benchmarked
+// batch sizes divide it.
+const int kCorpusSize = 256;
+
+// Sizes of the synthetic vocabularies.
+const int kNumWords = 5000;
+const int kNumTags = 45;
+const int kNumLabels = 40;
+
+// Width of the hidden layer of the decoded networks, and beam size of the beam
+// decoder.
+const int kHiddenSize = 128;
+const int kBeamSize = 8;
+
+// Parser features of the default model, as in context.pbtxt.
+const char kWordFeatures[] =
+    "input.word input(1).word input(2).word input(3).word stack.word "
+    "stack(1).word stack(2).word stack(3).word stack.child(1).word "
+    "stack.child(1).sibling(-1).word stack.child(-1).word "
+    "stack.child(-1).sibling(1).word stack(1).child(1).word "
+    "stack(1).child(1).sibling(-1).word stack(1).child(-1).word "
+    "stack(1).child(-1).sibling(1).word stack.child(2).word "
+    "stack.child(-2).word stack(1).child(2).word stack(1).child(-2).word";
+const char kTagFeatures[] =
+    "input.tag input(1).tag input(2).tag input(3).tag stack.tag stack(1).tag "
+    "stack(2).tag stack(3).tag stack.child(1).tag "
+    "stack.child(1).sibling(-1).tag stack.child(-1).tag "
+    "stack.child(-1).sibling(1).tag stack(1).child(1).tag "
+    "stack(1).child(1).sibling(-1).tag stack(1).child(-1).tag "
+    "stack(1).child(-1).sibling(1).tag stack.child(2).tag stack.child(-2).tag "
+    "stack(1).child(2).tag stack(1).child(-2).tag";
+const char kLabelFeatures[] =
+    "stack.child(1).label stack.child(1).sibling(-1).label "
+    "stack.child(-1).label stack.child(-1).sibling(1).label "
+    "stack(1).child(1).label stack(1).child(1).sibling(-1).label "
+    "stack(1).child(-1).label stack(1).child(-1).sibling(1).label "
+    "stack.child(2).label stack.child(-2).label stack(1).child(2).label "
+    "stack(1).child(-2).label";
+
+// Returns a path in the test temporary directory.
+string TempPath(const string &name) {
+  return utils::JoinPath({tensorflow::testing::TmpDir(), name});
+}
+
+// Returns the 0-based head of the token at the given index in a synthetic
+// sentence of the given length, or -1 for the root. Pairs of tokens form
+// chunks headed by their second token, and the chunk heads form a chain to the
+// last one, which is the root, so that trees are projective and have both
+// left and right arcs.
+int SyntheticHead(int index, int length) {
+  if (index % 2 == 0) return index + 1 < length ? index + 1 : -1;
+  if (index + 2 < length) return index + 2;
+  return index + 1 < length ? index + 1 : -1;
+}
+
+// Adds a task input reading a single file.
+void AddInput(const string &name, const string &file_pattern,
+              const string &record_format, TaskSpec *spec) {
+  TaskInput *input = spec->add_input();
+  input->set_name(name);
+  if (record_format.empty()) {
+    input->add_file_format("text");
+  } else {
+    input->add_record_format(record_format);
+  }
+  input->add_part()->set_file_pattern(file_pattern);
+}
+
+// Adds a task parameter.
+void AddParameter(const string &name, const string &value, TaskSpec *spec) {
+  TaskSpec::Parameter *parameter = spec->add_parameter();
+  parameter->set_name(name);
+  parameter->set_value(value);
+}
+
+// Synthetic corpus of sentences of one length in CoNLL format, with its
+// lexicon and a task context reading them with the default parser features.
+class SyntheticCorpus {
+ public:
+  // Returns the corpus of sentences of the given length, which is written on
+  // first use.
+  static SyntheticCorpus *Get(int length) {
+    static std::map<int, std::unique_ptr<SyntheticCorpus>> *corpora =
+        new std::map<int, std::unique_ptr<SyntheticCorpus>>();
+    std::unique_ptr<SyntheticCorpus> &corpus = (*corpora)[length];
+    if (corpus == nullptr) corpus.reset(new SyntheticCorpus(length));
+    return corpus.get();
+  }
+
+  // Accessors.
+  int length() const { return length_; }
+  const string &context_path() const { return context_path_; }
+  TaskContext *context() { return &context_; }
+  const vector<std::unique_ptr<Sentence>> &sentences() const {
+    return sentences_;
+  }
+
+ private:
+  explicit SyntheticCorpus(int length) : length_(length) {
+    tensorflow::Env *env = tensorflow::Env::Default();
+    const string prefix = StrCat("parser-benchmark-", length, "-");
+    TermFrequencyMap words, tags, labels;
+    string conll;
+    for (int s = 0; s < kCorpusSize; ++s) {
+      for (int i = 0; i < length; ++i) {
+        const int word_id = (s * 7919 + i * 104729) % kNumWords;
+        const string word = StrCat("w", word_id);
+        const string tag = StrCat("t", word_id % kNumTags);
+        const int head = SyntheticHead(i, length);
+        const string label =
+            head == -1 ? "ROOT" : StrCat("l", (s + i * 31) % kNumLabels);
+        words.Increment(word);
+        tags.Increment(tag);
+        labels.Increment(label);
+        StrAppend(&conll, i + 1, "\t", word, "\t_\t", tag, "\t", tag, "\t_\t",
+                  head + 1, "\t", label, "\t_\t_\n");
+      }
+      conll += "\n";
+    }
+    words.Save(TempPath(prefix + "word-map"));
+    tags.Save(TempPath(prefix + "tag-map"));
+    labels.Save(TempPath(prefix + "label-map"));
+    TF_CHECK_OK(
+        WriteStringToFile(env, TempPath(prefix + "corpus.conll"), conll));
+
+    TaskSpec spec;
+    AddParameter("brain_parser_features",
+                 StrCat(kWordFeatures, ";", kTagFeatures, ";", kLabelFeatures),
+                 &spec);
+    AddParameter("brain_parser_embedding_dims", "64;32;32", &spec);
+    AddParameter("brain_parser_embedding_names", "words;tags;labels", &spec);
+    AddParameter("brain_parser_transition_system", "arc-standard", &spec);
+    AddInput("word-map", TempPath(prefix + "word-map"), "", &spec);
+    AddInput("tag-map", TempPath(prefix + "tag-map"), "", &spec);
+    AddInput("label-map", TempPath(prefix + "label-map"), "", &spec);
+    AddInput("documents", TempPath(prefix + "corpus.conll"), "conll-sentence",
+             &spec);
+    context_path_ = TempPath(prefix + "context.pbtxt");
+    TF_CHECK_OK(WriteStringToFile(env, context_path_, spec.DebugString()));
+    *context_.mutable_spec() = spec;
+
+    TextReader reader(*context_.GetInput("documents"), &context_);
+    Sentence *sentence;
+    while ((sentence = reader.Read()) != nullptr) {
+      sentences_.emplace_back(sentence);
+    }
+    CHECK_EQ(kCorpusSize, sentences_.size());
+  }
+
+  const int length_;
+  string context_path_;
+  TaskContext context_;
+  vector<std::unique_ptr<Sentence>> sentences_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SyntheticCorpus);
+};
+
+// Parser features and transition system of a corpus, set up as the reader ops
+// set them up.
+class ParserSetup {
+ public:
+  explicit ParserSetup(SyntheticCorpus *corpus) : features_("brain_parser") {
+    TaskContext *context = corpus->context();
+    features_.Setup(context);
+    transition_system_.reset(ParserTransitionSystem::Create("arc-standard"));
+    transition_system_->Setup(context);
+    features_.Init(context);
+    features_.RequestWorkspaces(&registry_);
+    transition_system_->Init(context);
+    label_map_.Load(TaskContext::InputFile(*context->GetInput("label-map")), 0,
+                    0);
+  }
+
+  // Returns a new parser state for the sentence, preprocessed into the
+  // workspaces.
+  ParserState *NewState(Sentence *sentence, WorkspaceSet *workspaces) const {
+    ParserState *state = new ParserState(
+        sentence, transition_system_->NewTransitionState(true), &label_map_);
+    workspaces->Reset(registry_);
+    features_.Preprocess(workspaces, state);
+    return state;
+  }
+
+  // Number of transitions, i.e. width of the output layer of the networks.
+  int NumActions() const {
+    return transition_system_->NumActions(label_map_.Size());
+  }
+
+  // Accessors.
+  const ParserEmbeddingFeatureExtractor &features() const { return features_; }
+  const ParserTransitionSystem &transition_system() const {
+    return *transition_system_;
+  }
+
+ private:
+  ParserEmbeddingFeatureExtractor features_;
+  std::unique_ptr<ParserTransitionSystem> transition_system_;
+  TermFrequencyMap label_map_;
+  WorkspaceRegistry registry_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ParserSetup);
+};
+
+// Returns a tensor of the given shape with random values.
+Tensor RandomTensor(const TensorShape &shape) {
+  Tensor tensor(tensorflow::DT_FLOAT, shape);
+  tensor.flat<float>().setRandom();
+  return tensor;
+}
+
+// Returns a graph with a decoder op parsing the corpus with a network of one
+// hidden layer and random parameters. Sets beam_size for the beam decoder.
+Graph *DecoderGraph(const string &op, int batch_size, int beam_size,
+                    SyntheticCorpus *corpus) {
+  const ParserSetup parser(corpus);
+  const ParserEmbeddingFeatureExtractor &features = parser.features();
+  Graph *graph = new Graph(tensorflow::OpRegistry::Global());
+  std::vector<NodeBuilder::NodeOut> matrices;
+  int64 embedding_size = 0;
+  for (int i = 0; i < features.NumEmbeddings(); ++i) {
+    matrices.emplace_back(tensorflow::test::graph::Constant(
+        graph, RandomTensor({features.EmbeddingSize(i),
+                             features.EmbeddingDims(i)})));
+    embedding_size += features.FeatureSize(i) * features.EmbeddingDims(i);
+  }
+  const std::vector<NodeBuilder::NodeOut> weights = {
+      tensorflow::test::graph::Constant(
+          graph, RandomTensor({embedding_size, kHiddenSize})),
+      tensorflow::test::graph::Constant(
+          graph, RandomTensor({kHiddenSize, parser.NumActions()}))};
+  const std::vector<NodeBuilder::NodeOut> biases = {
+      tensorflow::test::graph::Constant(graph, RandomTensor({kHiddenSize})),
+      tensorflow::test::graph::Constant(graph,
+                                        RandomTensor({parser.NumActions()}))};
+  NodeBuilder builder(graph->NewName("decoder"), op);
+  builder.Input(matrices)
+      .Input(weights)
+      .Input(biases)
+      .Attr("task_context", corpus->context_path())
+      .Attr("feature_size", features.NumEmbeddings())
+      .Attr("num_layers", static_cast<int>(weights.size()))
+      .Attr("batch_size", batch_size);
+  if (beam_size > 0) builder.Attr("beam_size", beam_size);
+  TF_CHECK_OK(builder.Finalize(graph, nullptr));
+  return graph;
+}
+
+// Reports the tokens parsed by a decoder in the given number of steps. Every
+// pass over the corpus ends with a step that parses nothing.
+void DecodedTokensProcessed(int iters, int batch_size, int length) {
+  CHECK_EQ(0, kCorpusSize % batch_size);
+  const int64 steps_per_epoch = kCorpusSize / batch_size + 1;
+  tensorflow::testing::ItemsProcessed(static_cast<int64>(iters) *
+                                      kCorpusSize * length / steps_per_epoch);
+}
+
+TEST(ParserBenchmarkTest, GoldParsesOfSyntheticCorpusAreReachable) {
+  SyntheticCorpus *corpus = SyntheticCorpus::Get(10);
+  const ParserSetup parser(corpus);
+  for (const auto &sentence : corpus->sentences()) {
+    ASSERT_EQ(10, sentence->token_size());
+    WorkspaceSet workspaces;
+    std::unique_ptr<ParserState> state(
+        parser.NewState(sentence.get(), &workspaces));
+    while (!parser.transition_system().IsFinalState(*state)) {
+      parser.transition_system().PerformAction(
+          parser.transition_system().GetNextGoldAction(*state), state.get());
+    }
+    for (int i = 0; i < sentence->token_size(); ++i) {
+      EXPECT_TRUE(state->IsTokenCorrect(i));
+    }
+  }
+}
+
+// Reads and parses CoNLL sentences, rewinding at the end of the corpus.
+void BM_ReadConll(int iters, int length) {
+  tensorflow::testing::StopTiming();
+  SyntheticCorpus *corpus = SyntheticCorpus::Get(length);
+  TextReader reader(*corpus->context()->GetInput("documents"),
+                    corpus->context());
+  int64 num_tokens = 0;
+  AllocationCounter allocations;
+  tensorflow::testing::StartTiming();
+  allocations.Start();
+  for (int i = 0; i < iters; ++i) {
+    std::unique_ptr<Sentence> sentence(reader.Read());
+    if (sentence == nullptr) {
+      reader.Reset();
+      sentence.reset(reader.Read());
+    }
+    num_tokens += sentence->token_size();
+  }
+  allocations.Stop();
+  tensorflow::testing::ItemsProcessed(num_tokens);
+  tensorflow::testing::SetLabel(allocations.PerUnitLabel(iters, "sentence"));
+}
+BENCHMARK(BM_ReadConll)->Arg(10)->Arg(25)->Arg(50);
+
+// Creates parser states and preprocesses their sentences for the features.
+void BM_Preprocess(int iters, int length) {
+  tensorflow::testing::StopTiming();
+  SyntheticCorpus *corpus = SyntheticCorpus::Get(length);
+  const ParserSetup parser(corpus);
+  WorkspaceSet workspaces;
+  AllocationCounter allocations;
+  tensorflow::testing::StartTiming();
+  allocations.Start();
+  for (int i = 0; i < iters; ++i) {
+    Sentence *sentence = corpus->sentences()[i % kCorpusSize].get();
+    std::unique_ptr<ParserState> state(parser.NewState(sentence, &workspaces));
+  }
+  allocations.Stop();
+  tensorflow::testing::ItemsProcessed(static_cast<int64>(iters) * length);
+  tensorflow::testing::SetLabel(allocations.PerUnitLabel(iters, "sentence"));
+}
+BENCHMARK(BM_Preprocess)->Arg(10)->Arg(25)->Arg(50);
+
+// Advances parser states along the gold parse of a sentence, cloning the state
+// before every transition as beam search does.
+void BM_GoldTransitions(int iters, int length) {
+  tensorflow::testing::StopTiming();
+  SyntheticCorpus *corpus = SyntheticCorpus::Get(length);
+  const ParserSetup parser(corpus);
+  const ParserTransitionSystem &transition_system = parser.transition_system();
+  WorkspaceSet workspaces;
+  AllocationCounter allocations;
+  for (int i = 0; i < iters; ++i) {
+    Sentence *sentence = corpus->sentences()[i % kCorpusSize].get();
+    std::unique_ptr<ParserState> state(parser.NewState(sentence, &workspaces));
+    tensorflow::testing::StartTiming();
+    allocations.Start();
+    while (!transition_system.IsFinalState(*state)) {
+      const int action = transition_system.GetNextGoldAction(*state);
+      state.reset(state->Clone());
+      transition_system.PerformAction(action, state.get());
+    }
+    state.reset();
+    allocations.Stop();
+    tensorflow::testing::StopTiming();
+  }
+  tensorflow::testing::ItemsProcessed(static_cast<int64>(iters) * length);
+  tensorflow::testing::SetLabel(allocations.PerUnitLabel(iters, "sentence"));
+}
+BENCHMARK(BM_GoldTransitions)->Arg(10)->Arg(25)->Arg(50);
+
+// Extracts the sparse features of every state along the gold parse of a
+// sentence, as the training reader does.
+void BM_ExtractSparseFeatures(int iters, int length) {
+  tensorflow::testing::StopTiming();
+  SyntheticCorpus *corpus = SyntheticCorpus::Get(length);
+  const ParserSetup parser(corpus);
+  const ParserTransitionSystem &transition_system = parser.transition_system();
+  WorkspaceSet workspaces;
+  AllocationCounter allocations;
+  for (int i = 0; i < iters; ++i) {
+    Sentence *sentence = corpus->sentences()[i % kCorpusSize].get();
+    std::unique_ptr<ParserState> state(parser.NewState(sentence, &workspaces));
+    tensorflow::testing::StartTiming();
+    allocations.Start();
+    while (!transition_system.IsFinalState(*state)) {
+      parser.features().ExtractSparseFeatures(workspaces, *state);
+      transition_system.PerformAction(
+          transition_system.GetNextGoldAction(*state), state.get());
+    }
+    allocations.Stop();
+    tensorflow::testing::StopTiming();
+  }
+  tensorflow::testing::ItemsProcessed(static_cast<int64>(iters) * length);
+  tensorflow::testing::SetLabel(allocations.PerUnitLabel(iters, "sentence"));
+}
+BENCHMARK(BM_ExtractSparseFeatures)->Arg(10)->Arg(25)->Arg(50);
+
+// Unpacks the serialized word features of a batch of parser states, taken at
+// different positions along the gold parses.
+void BM_UnpackSparseFeatures(int iters, int batch_size) {
+  tensorflow::testing::StopTiming();
+  SyntheticCorpus *corpus = SyntheticCorpus::Get(25);
+  const ParserSetup parser(corpus);
+  const int num_features = parser.features().FeatureSize(0);
+  Tensor features(tensorflow::DT_STRING,
+                  TensorShape({batch_size * num_features}));
+  WorkspaceSet workspaces;
+  for (int i = 0; i < batch_size; ++i) {
+    Sentence *sentence = corpus->sentences()[i % kCorpusSize].get();
+    std::unique_ptr<ParserState> state(parser.NewState(sentence, &workspaces));
+    for (int step = 0; step < i % (2 * corpus->length()); ++step) {
+      if (parser.transition_system().IsFinalState(*state)) break;
+      parser.transition_system().PerformAction(
+          parser.transition_system().GetNextGoldAction(*state), state.get());
+    }
+    const vector<vector<SparseFeatures>> extracted =
+        parser.features().ExtractSparseFeatures(workspaces, *state);
+    for (int j = 0; j < num_features; ++j) {
+      features.vec<string>()(i * num_features + j) =
+          extracted[0][j].SerializeAsString();
+    }
+  }
+  Graph *graph = new Graph(tensorflow::OpRegistry::Global());
+  TF_CHECK_OK(NodeBuilder(graph->NewName("unpack"), "UnpackSparseFeatures")
+                  .Input(tensorflow::test::graph::Constant(graph, features))
+                  .Finalize(graph, nullptr));
+  tensorflow::test::Benchmark("cpu", graph).Run(iters);
+  tensorflow::testing::ItemsProcessed(static_cast<int64>(iters) * batch_size);
+}
+BENCHMARK(BM_UnpackSparseFeatures)->Arg(1)->Arg(8)->Arg(32)->Arg(128);
+
+// Parses batches of sentences with the greedy decoder.
+void BM_GreedyParseDecoder(int iters, int batch_size, int length) {
+  tensorflow::testing::StopTiming();
+  Graph *graph = DecoderGraph("GreedyParseDecoder", batch_size, 0,
+                              SyntheticCorpus::Get(length));
+  tensorflow::test::Benchmark("cpu", graph).Run(iters);
+  DecodedTokensProcessed(iters, batch_size, length);
+}
+BENCHMARK(BM_GreedyParseDecoder)
+    ->ArgPair(1, 10)
+    ->ArgPair(1, 25)
+    ->ArgPair(1, 50)
+    ->ArgPair(8, 10)
+    ->ArgPair(8, 25)
+    ->ArgPair(8, 50)
+    ->ArgPair(32, 10)
+    ->ArgPair(32, 25)
+    ->ArgPair(32, 50)
+    ->ArgPair(128, 10)
+    ->ArgPair(128, 25)
+    ->ArgPair(128, 50);
+
+// Parses batches of sentences with the beam decoder.
+void BM_BeamParseDecoder(int iters, int batch_size, int length) {
+  tensorflow::testing::StopTiming();
+  Graph *graph = DecoderGraph("BeamParseDecoder", batch_size, kBeamSize,
+                              SyntheticCorpus::Get(length));
+  tensorflow::test::Benchmark("cpu", graph).Run(iters);
+  DecodedTokensProcessed(iters, batch_size, length);
+}
+BENCHMARK(BM_BeamParseDecoder)
+    ->ArgPair(1, 10)
+    ->ArgPair(1, 25)
+    ->ArgPair(1, 50)
+    ->ArgPair(8, 10)
+    ->ArgPair(8, 25)
+    ->ArgPair(8, 50)
+    ->ArgPair(32, 10)
+    ->ArgPair(32, 25)
+    ->ArgPair(32, 50);
+
+}  // namespace
+}  // namespace syntaxnet
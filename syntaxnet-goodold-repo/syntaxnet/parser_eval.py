@@ -23,6 +23,7 @@ import time
 import tempfile
 import tensorflow as tf
 
+from tensorflow.python.framework import graph_util
 from tensorflow.python.platform import gfile
 from tensorflow.python.platform import tf_logging as logging
 
@@ -53,12 +54,110 @@ flags.DEFINE_string('output', 'stdout',
                     'Name of the context input to write data to.')
 flags.DEFINE_string('hidden_layer_sizes', '200,200',
                     'Comma separated list of hidden layer sizes.')
+flags.DEFINE_bool('packed_features', False,
+                  'Whether the greedy readers return packed feature tensors '
+                  'instead of serialized SparseFeatures protos.')
+flags.DEFINE_bool('factored_arc_actions', False,
+                  'Whether the arc-standard actions are scored by a softmax '
+                  'over the action types and one over the labels.')
+flags.DEFINE_bool('precompute_embeddings', False,
+                  'Whether to compute the first hidden layer of packed '
+                  'features from tables of embeddings times layer weights, '
+                  'which the export also saves.')
+flags.DEFINE_integer('precomputed_ids', 0,
+                     'If positive, the number of most frequent ids of each '
+                     'feature group with precomputed rows.')
+flags.DEFINE_integer('max_precomputed_domain', 0,
+                     'If positive, only feature groups with at most this many '
+                     'ids are precomputed, and larger ones like words are '
+                     'embedded and multiplied densely.')
+flags.DEFINE_bool('quantized', False,
+                  'Whether to run the greedy parser on the eight bit '
+                  'parameters of a model written by quantize_model.')
+flags.DEFINE_string('network_device', '',
+                    'If set, e.g. /gpu:0, the device holding the parameters '
+                    'and running the network of the greedy parser, with the '
+                    'embedding matrices resident there. Every feature must '
+                    'have exactly one id.')
+flags.DEFINE_bool('half_embeddings', False,
+                  'Whether the evaluation network reads the half precision '
+                  'embedding matrices of a model written by quantize_model '
+                  '--half_embeddings.')
+flags.DEFINE_integer('huge_page_min_bytes', 0,
+                     'If positive, the evaluation network copies its '
+                     'embedding matrices and layer weights of at least this '
+                     'many bytes to 2MB huge pages once restored, against '
+                     'the TLB misses of their lookups.')
+flags.DEFINE_string('mapped_embeddings_dir', '',
+                    'If set, a local directory from which the evaluation '
+                    'network maps its embedding matrices read-only instead of '
+                    'restoring them, so that only looked up rows are loaded.')
+flags.DEFINE_bool('write_mapped_embeddings', False,
+                  'Whether to write the embedding matrices of the model to '
+                  '--mapped_embeddings_dir instead of evaluating.')
+flags.DEFINE_bool('fused_decoding', False,
+                  'Whether the parser takes all transitions of a batch of '
+                  'sentences in a single step.')
+flags.DEFINE_bool('skip_deterministic_states', False,
+                  'Whether the greedy parser takes the only allowed action '
+                  'of a parser state without scoring it.')
+flags.DEFINE_bool('ping_pong', False,
+                  'Whether the greedy parser extracts the features of one half '
+                  'of the batch while the network scores the other half.')
+flags.DEFINE_integer('parse_cache_bytes', 0,
+                     'If positive, size of a cache of the parses of the greedy '
+                     'parser, from which repeated sentences are output '
+                     'without being parsed again.')
 flags.DEFINE_integer('batch_size', 32,
                      'Number of sentences to process in parallel.')
 flags.DEFINE_integer('beam_size', 8, 'Number of slots for beam parsing.')
 flags.DEFINE_integer('max_steps', 1000, 'Max number of steps to take.')
+flags.DEFINE_integer('num_alternatives', 0,
+                     'If positive, the structured parser also writes this '
+                     'many best parses of each sentence into its k-best '
+                     'syntax analyses.')
 flags.DEFINE_bool('slim_model', False,
                   'Whether to expect only averaged variables.')
+flags.DEFINE_string('tagger_model_path', '',
+                    'If set, also runs a tagger with these parameters in the '
+                    'same session, and feeds its output to the parser.')
+flags.DEFINE_string('tagger_arg_prefix', 'brain_tagger',
+                    'Prefix for context parameters of the pipelined tagger.')
+flags.DEFINE_string('tagger_hidden_layer_sizes', '64',
+                    'Comma separated list of hidden layer sizes of the '
+                    'pipelined tagger.')
+flags.DEFINE_string('pipeline_corpus', 'tagged-queue',
+                    'Name of the sentence-queue context input connecting the '
+                    'pipelined tagger to the parser.')
+flags.DEFINE_integer('shared_token_values_size', 0,
+                     'If positive, the pipelined tagger and parser share the '
+                     'token values of their features that look up the words '
+                     'of a sentence in the same lexicon, for this many '
+                     'sentences and features.')
+flags.DEFINE_string('reader_stats_dir', '',
+                    'If set, writes histograms of the latency of each stage '
+                    'of the reader ops there as TensorBoard summaries.')
+flags.DEFINE_integer('feature_profile_period', 0,
+                     'If positive, times the feature expressions in one in '
+                     'this many feature extractor calls, and logs the costs '
+                     'of each expression at the end.')
+flags.DEFINE_string('export_path', '',
+                    'If set, writes the evaluation graph, its parameters and '
+                    'task context to this directory for the C++ '
+                    'ParsingSession instead of evaluating.')
+flags.DEFINE_string('serving_queue_prefix', '',
+                    'Prefix of the names of the document queues of the '
+                    'exported model, which must differ between the models '
+                    'served from one process by a ModelPool.')
+flags.DEFINE_bool('cpu_memory_pool', False,
+                  'Whether the session allocates CPU tensors from a pooled '
+                  'best-fit with coalescing allocator instead of malloc.')
+flags.DEFINE_string('cpu_affinity', '',
+                    'If set, CPUs like "0-7,16-23" that the threads of the '
+                    'session are pinned to, in pools of its own.')
+flags.DEFINE_bool('work_stealing_thread_pools', False,
+                  'Whether the thread pools of the session give each thread '
+                  'its own task queue and let idle threads steal tasks.')
 
 
 def RewriteContext(task_context):
@@ -66,27 +165,48 @@ def RewriteContext(task_context):
   with gfile.FastGFile(task_context) as fin:
     text_format.Merge(fin.read(), context)
   for resource in context.input:
+    if list(resource.record_format) == ['sentence-queue']:
+      continue
     for part in resource.part:
       if part.file_pattern != '-':
         part.file_pattern = os.path.join(FLAGS.resource_dir, part.file_pattern)
+  for name in ['feature_profile_period', 'shared_token_values_size']:
+    if getattr(FLAGS, name) > 0:
+      parameter = context.parameter.add()
+      parameter.name = name
+      parameter.value = str(getattr(FLAGS, name))
   with tempfile.NamedTemporaryFile(delete=False) as fout:
     fout.write(str(context))
     return fout.name
 
 
-def Eval(sess):
-  """Builds and evaluates a network."""
-  task_context = FLAGS.task_context
-  if FLAGS.resource_dir:
-    task_context = RewriteContext(task_context)
+def BuildParser(sess, task_context, arg_prefix, hidden_layer_sizes,
+                model_path, input_corpus, output_corpus,
+                mapped_embeddings_dir=None):
+  """Builds an evaluation network whose output documents are sunk in-graph.
+
+  Args:
+    sess: tensorflow session to use.
+    task_context: path to the task context.
+    arg_prefix: prefix for context parameters.
+    hidden_layer_sizes: comma separated list of hidden layer sizes.
+    model_path: path to the model parameters to restore.
+    input_corpus: name of the context input to read documents from.
+    output_corpus: name of the context input to write documents to.
+    mapped_embeddings_dir: if set, directory of the memory mapped embedding
+      matrices of the model.
+
+  Returns:
+    A (parser, sink) pair, where running sink also writes out the documents
+    completed by the current evaluation step.
+  """
   feature_sizes, domain_sizes, embedding_dims, num_actions = sess.run(
       gen_parser_ops.feature_size(task_context=task_context,
-                                  arg_prefix=FLAGS.arg_prefix))
-
-  t = time.time()
-  hidden_layer_sizes = map(int, FLAGS.hidden_layer_sizes.split(','))
+                                  arg_prefix=arg_prefix))
+  hidden_layer_sizes = map(int, hidden_layer_sizes.split(','))
   logging.info('Building training network with parameters: feature_sizes: %s '
                'domain_sizes: %s', feature_sizes, domain_sizes)
+  num_tag_actions = graph_builder.NumTagActions(task_context, arg_prefix)
   if FLAGS.graph_builder == 'greedy':
     parser = graph_builder.GreedyParser(num_actions,
                                         feature_sizes,
@@ -94,7 +214,17 @@ def Eval(sess):
                                         embedding_dims,
                                         hidden_layer_sizes,
                                         gate_gradients=True,
-                                        arg_prefix=FLAGS.arg_prefix)
+                                        arg_prefix=arg_prefix,
+                                        packed_features=FLAGS.packed_features,
+                                        num_tag_actions=num_tag_actions,
+                                        factored_arc_actions=(
+                                            FLAGS.factored_arc_actions))
+    if FLAGS.precompute_embeddings:
+      parser.UsePrecomputedEmbeddings(
+          FLAGS.precomputed_ids,
+          max_domain_size=FLAGS.max_precomputed_domain or None)
+    if FLAGS.quantized:
+      parser.UseQuantizedInference()
   else:
     parser = structured_graph_builder.StructuredGraphBuilder(
         num_actions,
@@ -103,38 +233,142 @@ def Eval(sess):
         embedding_dims,
         hidden_layer_sizes,
         gate_gradients=True,
-        arg_prefix=FLAGS.arg_prefix,
+        arg_prefix=arg_prefix,
         beam_size=FLAGS.beam_size,
-        max_steps=FLAGS.max_steps)
-  parser.AddEvaluation(task_context,
-                       FLAGS.batch_size,
-                       corpus_name=FLAGS.input,
-                       evaluation_max_steps=FLAGS.max_steps)
+        max_steps=FLAGS.max_steps,
+        num_tag_actions=num_tag_actions,
+        factored_arc_actions=FLAGS.factored_arc_actions)
+  if mapped_embeddings_dir:
+    parser.UseMappedEmbeddings(mapped_embeddings_dir)
+  if FLAGS.half_embeddings:
+    parser.UseHalfEmbeddings()
+  if FLAGS.huge_page_min_bytes > 0:
+    parser.UseHugePages(FLAGS.huge_page_min_bytes)
+  if FLAGS.network_device and FLAGS.graph_builder == 'greedy':
+    parser.UseNetworkDevice(FLAGS.network_device)
+  kwargs = {}
+  if FLAGS.graph_builder == 'structured':
+    kwargs['num_alternatives'] = FLAGS.num_alternatives
+  else:
+    kwargs['skip_deterministic_states'] = FLAGS.skip_deterministic_states
+    kwargs['ping_pong'] = FLAGS.ping_pong
+    kwargs['parse_cache_bytes'] = FLAGS.parse_cache_bytes
+    kwargs['model_id'] = model_path
+  if FLAGS.fused_decoding and FLAGS.graph_builder == 'greedy':
+    parser.AddFusedEvaluation(task_context,
+                              FLAGS.batch_size,
+                              corpus_name=input_corpus)
+  elif FLAGS.fused_decoding:
+    parser.AddFusedEvaluation(task_context,
+                              FLAGS.batch_size,
+                              corpus_name=input_corpus,
+                              evaluation_max_steps=FLAGS.max_steps,
+                              **kwargs)
+  else:
+    parser.AddEvaluation(task_context,
+                         FLAGS.batch_size,
+                         corpus_name=input_corpus,
+                         evaluation_max_steps=FLAGS.max_steps,
+                         **kwargs)
 
   parser.AddSaver(FLAGS.slim_model)
   sess.run(parser.inits.values())
-  parser.saver.restore(sess, FLAGS.model_path)
+  parser.saver.restore(sess, model_path)
+  if 'precompute_embeddings' in parser.evaluation:
+    sess.run(parser.evaluation['precompute_embeddings'])
 
-  sink_documents = tf.placeholder(tf.string)
-  sink = gen_parser_ops.document_sink(sink_documents,
+  sink = gen_parser_ops.document_sink(parser.evaluation['documents'],
                                       task_context=task_context,
-                                      corpus_name=FLAGS.output)
+                                      corpus_name=output_corpus)
+  return parser, sink
+
+
+def WriteReaderStats(sess):
+  """Writes the statistics of the reader ops, if FLAGS.reader_stats_dir is set.
+
+  Args:
+    sess: tensorflow session to use.
+  """
+  if not FLAGS.reader_stats_dir:
+    return
+  writer = tf.train.SummaryWriter(FLAGS.reader_stats_dir)
+  writer.add_summary(sess.run(gen_parser_ops.reader_stats_summary()))
+  writer.close()
+  logging.info('Wrote reader statistics to %s', FLAGS.reader_stats_dir)
+
+
+def LogFeatureProfile(sess):
+  """Logs the costs of the features, if FLAGS.feature_profile_period is set.
+
+  Args:
+    sess: tensorflow session to use.
+  """
+  if FLAGS.feature_profile_period <= 0:
+    return
+  logging.info('%s', sess.run(gen_parser_ops.feature_profile_report()))
+
+
+def LogHugePageStats(sess):
+  """Logs the huge page coverage, if FLAGS.huge_page_min_bytes is set.
+
+  Args:
+    sess: tensorflow session to use.
+  """
+  if FLAGS.huge_page_min_bytes <= 0:
+    return
+  num_regions, num_bytes, huge_page_bytes = sess.run(
+      gen_parser_ops.huge_page_stats())
+  logging.info('Huge pages back %d of %d bytes of %d parameter copies '
+               '(%.1f%%)', huge_page_bytes, num_bytes, num_regions,
+               100.0 * huge_page_bytes / max(num_bytes, 1))
+
+
+def WriteMappedEmbeddings(sess, task_context):
+  """Writes the embedding matrices of FLAGS.model_path to be mapped."""
+  parser, _ = BuildParser(sess, task_context, FLAGS.arg_prefix,
+                          FLAGS.hidden_layer_sizes, FLAGS.model_path,
+                          FLAGS.input, FLAGS.output)
+  parser.WriteMappedEmbeddings(sess, FLAGS.mapped_embeddings_dir)
+  logging.info('Wrote embedding matrices to %s', FLAGS.mapped_embeddings_dir)
+
+
+def Eval(sess):
+  """Builds and evaluates a network."""
+  task_context = FLAGS.task_context
+  if (FLAGS.resource_dir or FLAGS.feature_profile_period > 0 or
+      FLAGS.shared_token_values_size > 0):
+    task_context = RewriteContext(task_context)
+  if FLAGS.export_path:
+    Export(sess, task_context)
+    return
+  if FLAGS.tagger_model_path:
+    EvalPipeline(sess, task_context)
+    return
+
+  if FLAGS.write_mapped_embeddings:
+    WriteMappedEmbeddings(sess, task_context)
+    return
+
+  parser, sink = BuildParser(sess, task_context, FLAGS.arg_prefix,
+                             FLAGS.hidden_layer_sizes, FLAGS.model_path,
+                             FLAGS.input, FLAGS.output,
+                             FLAGS.mapped_embeddings_dir or None)
   t = time.time()
   num_epochs = None
   num_tokens = 0
   num_correct = 0
   num_documents = 0
   while True:
-    tf_eval_epochs, tf_eval_metrics, tf_documents = sess.run([
+    tf_eval_epochs, tf_eval_metrics, tf_documents, _ = sess.run([
         parser.evaluation['epochs'],
         parser.evaluation['eval_metrics'],
         parser.evaluation['documents'],
+        sink,
     ])
 
     if len(tf_documents):
       logging.info('Processed %d documents', len(tf_documents))
       num_documents += len(tf_documents)
-      sess.run(sink, feed_dict={sink_documents: tf_documents})
 
     num_tokens += tf_eval_metrics[0]
     num_correct += tf_eval_metrics[1]
@@ -150,11 +384,158 @@ def Eval(sess):
     logging.info('total tokens: %d', num_tokens)
     logging.info('Seconds elapsed in evaluation: %.2f, '
                  'eval metric: %.2f%%', time.time() - t, eval_metric)
+  WriteReaderStats(sess)
+  LogFeatureProfile(sess)
+  LogHugePageStats(sess)
+
+
+def EvalPipeline(sess, task_context):
+  """Runs a tagger and a parser in one session, chained by a document queue.
+
+  The tagger reads from FLAGS.input and writes its annotated documents to the
+  FLAGS.pipeline_corpus queue, from which the parser reads them directly,
+  writing its output to FLAGS.output.
+
+  Args:
+    sess: tensorflow session to use.
+    task_context: path to the task context.
+  """
+  with tf.variable_scope('tagger'):
+    tagger, tagger_sink = BuildParser(
+        sess, task_context, FLAGS.tagger_arg_prefix,
+        FLAGS.tagger_hidden_layer_sizes, FLAGS.tagger_model_path, FLAGS.input,
+        FLAGS.pipeline_corpus)
+  with tf.variable_scope('parser'):
+    parser, parser_sink = BuildParser(
+        sess, task_context, FLAGS.arg_prefix, FLAGS.hidden_layer_sizes,
+        FLAGS.model_path, FLAGS.pipeline_corpus, FLAGS.output)
+
+  t = time.time()
+  tagger_epochs = None
+  tagger_done = False
+  parser_epochs = None
+  num_documents = 0
+  while True:
+    if not tagger_done:
+      tf_tagger_epochs, _ = sess.run([tagger.evaluation['epochs'],
+                                      tagger_sink])
+      if tagger_epochs is None:
+        tagger_epochs = tf_tagger_epochs
+      elif tagger_epochs < tf_tagger_epochs:
+        tagger_done = True
+
+    # The parser starts a new epoch whenever it runs out of queued documents,
+    # so only the first epoch change after the tagger is done marks the end.
+    tf_parser_epochs, tf_documents, _ = sess.run([
+        parser.evaluation['epochs'],
+        parser.evaluation['documents'],
+        parser_sink,
+    ])
+    num_documents += len(tf_documents)
+    if not tagger_done or parser_epochs is None:
+      parser_epochs = tf_parser_epochs
+    elif parser_epochs < tf_parser_epochs:
+      break
+
+  logging.info('Total processed documents: %d', num_documents)
+  logging.info('Seconds elapsed in pipeline: %.2f', time.time() - t)
+  WriteReaderStats(sess)
+  LogFeatureProfile(sess)
+  LogHugePageStats(sess)
+
+
+def Export(sess, task_context):
+  """Exports the evaluation graph for serving with the C++ ParsingSession.
+
+  The exported graph reads sentences from the 'serving-input' queue and writes
+  them to the 'serving-output' queue, running the tagger first if
+  FLAGS.tagger_model_path is set. The queues are named after
+  FLAGS.serving_queue_prefix. See parsing_session.h for the layout of the
+  export directory.
+
+  Args:
+    sess: tensorflow session to use.
+    task_context: path to the task context.
+  """
+  export_path = os.path.abspath(FLAGS.export_path)
+  if not gfile.IsDirectory(export_path):
+    gfile.MakeDirs(export_path)
+
+  # Adds the queues to feed and read sentences through to the task context.
+  context = task_spec_pb2.TaskSpec()
+  with gfile.FastGFile(task_context) as fin:
+    text_format.Merge(fin.read(), context)
+  queues = ['serving-input', 'serving-output']
+  if FLAGS.tagger_model_path:
+    queues.append(FLAGS.pipeline_corpus)
+  existing = set(resource.name for resource in context.input)
+  for name in queues:
+    if name not in existing:
+      queue = context.input.add()
+      queue.name = name
+      queue.record_format.append('sentence-queue')
+      queue.part.add().file_pattern = FLAGS.serving_queue_prefix + name
+  steps = ['parser_step']
+  if FLAGS.tagger_model_path:
+    steps.insert(0, 'tagger_step')
+  for name, value in [('serving_input', 'serving-input'),
+                      ('serving_output', 'serving-output'),
+                      ('serving_steps', ','.join(steps)),
+                      ('serving_cpu_memory_pool',
+                       str(FLAGS.cpu_memory_pool).lower()),
+                      ('serving_cpu_affinity', FLAGS.cpu_affinity),
+                      ('serving_work_stealing_thread_pools',
+                       str(FLAGS.work_stealing_thread_pools).lower())]:
+    parameter = context.parameter.add()
+    parameter.name = name
+    parameter.value = value
+  exported_context = os.path.join(export_path, 'context.pbtxt')
+  with gfile.FastGFile(exported_context, 'w') as fout:
+    fout.write(str(context))
+
+  # Builds the graph on the exported context, so that the reader ops refer to
+  # it, and restores the model parameters.
+  if FLAGS.tagger_model_path:
+    with tf.variable_scope('tagger'):
+      _, tagger_sink = BuildParser(
+          sess, exported_context, FLAGS.tagger_arg_prefix,
+          FLAGS.tagger_hidden_layer_sizes, FLAGS.tagger_model_path,
+          'serving-input', FLAGS.pipeline_corpus)
+    tf.group(tagger_sink, name='tagger_step')
+    parser_input = FLAGS.pipeline_corpus
+  else:
+    parser_input = 'serving-input'
+  with tf.variable_scope('parser'):
+    _, parser_sink = BuildParser(
+        sess, exported_context, FLAGS.arg_prefix, FLAGS.hidden_layer_sizes,
+        FLAGS.model_path, parser_input, 'serving-output')
+  tf.group(parser_sink, name='parser_step')
+
+  # Saves all parameters with a single saver the C++ session can restore.
+  saver = tf.train.Saver()
+  saver.save(sess, os.path.join(export_path, 'model'))
+  with gfile.FastGFile(os.path.join(export_path, 'saver.pb'), 'wb') as fout:
+    fout.write(saver.as_saver_def().SerializeToString())
+  tf.train.write_graph(sess.graph.as_graph_def(), export_path, 'graph.pb',
+                       as_text=False)
+
+  # Also writes the graph with the parameters frozen into constants, which
+  # model_bundle_main packs into a single memory mapped file with the lexicons.
+  frozen_graph = graph_util.convert_variables_to_constants(
+      sess, sess.graph.as_graph_def(), steps)
+  tf.train.write_graph(frozen_graph, export_path, 'frozen_graph.pb',
+                       as_text=False)
+  logging.info('Exported model to %s', export_path)
 
 
 def main(unused_argv):
   logging.set_verbosity(logging.INFO)
-  with tf.Session() as sess:
+  config = tf.ConfigProto(
+      use_cpu_memory_pool=FLAGS.cpu_memory_pool,
+      cpu_affinity=FLAGS.cpu_affinity,
+      use_work_stealing_thread_pools=FLAGS.work_stealing_thread_pools,
+      allow_soft_placement=bool(FLAGS.network_device))
+  with tf.Session(config=config) as sess:
     Eval(sess)
 
 
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "syntaxnet/parser_features.h"
 
+#include <algorithm>
+#include <iterator>
 #include <string>
 
 #include "syntaxnet/registry.h"
@@ -152,6 +154,11 @@ class LabelFeatureFunction : public BasicParserSentenceFeatureFunction<Label> {
   // Valid focus values range from -1 to sentence->size() - 1, inclusively.
   FeatureValue Compute(const WorkspaceSet &workspaces, const ParserState &state,
                        int focus, const FeatureVector *result) const override {
+    return LabelValue(state, focus);
+  }
+
+  // Returns the label value for the focus token, without virtual calls.
+  FeatureValue LabelValue(const ParserState &state, int focus) const {
     if (focus == -1) return RootValue();
     if (focus < -1 || focus >= state.sentence().token_size()) {
       return feature_.NumValues();
@@ -166,6 +173,10 @@ REGISTER_PARSER_IDX_FEATURE_FUNCTION("label", LabelFeatureFunction);
 typedef BasicParserSentenceFeatureFunction<Word> WordFeatureFunction;
 REGISTER_PARSER_IDX_FEATURE_FUNCTION("word", WordFeatureFunction);
 
+typedef BasicParserSentenceFeatureFunction<HashedWord>
+    HashedWordFeatureFunction;
+REGISTER_PARSER_IDX_FEATURE_FUNCTION("hashed-word", HashedWordFeatureFunction);
+
 typedef BasicParserSentenceFeatureFunction<Char> CharFeatureFunction;
 REGISTER_PARSER_IDX_FEATURE_FUNCTION("char", CharFeatureFunction);
 
@@ -228,4 +239,230 @@ class ParserTokenFeatureFunction : public NestedFeatureFunction<
 REGISTER_PARSER_IDX_FEATURE_FUNCTION("token",
                                      ParserTokenFeatureFunction);
 
+namespace {
+
+// Returns whether a nested parser index feature only reads the sentence at or
+// around the focus. The sentence features nested in "token" all do.
+bool IsSentenceIndexFeature(const FeatureFunctionDescriptor &descriptor) {
+  static const char *const kSentenceIndexFeatures[] = {
+      "offset", "word",   "char",   "tag",    "digit",
+      "hyphen", "capitalization", "punctuation-amount", "quote",
+      "prefix", "suffix"};
+  if (descriptor.type() == "token") return true;
+  if (std::find(std::begin(kSentenceIndexFeatures),
+                std::end(kSentenceIndexFeatures),
+                descriptor.type()) == std::end(kSentenceIndexFeatures)) {
+    return false;
+  }
+  for (const FeatureFunctionDescriptor &nested : descriptor.feature()) {
+    if (!IsSentenceIndexFeature(nested)) return false;
+  }
+  return true;
+}
+
+// Returns how many tokens past the next input token a sentence feature
+// focused at the given offset from it may read. Only offsets move the focus.
+int SentenceLookahead(const FeatureFunctionDescriptor &descriptor, int focus) {
+  if (descriptor.type() == "offset") focus += descriptor.argument();
+  int lookahead = focus;
+  for (const FeatureFunctionDescriptor &nested : descriptor.feature()) {
+    lookahead = std::max(lookahead, SentenceLookahead(nested, focus));
+  }
+  return lookahead;
+}
+
+// Returns how many tokens past the next input token a parser feature focused
+// at the given offset from it may read, as for InputLookahead().
+int NestedLookahead(const FeatureFunctionDescriptor &descriptor, int focus) {
+  const string &type = descriptor.type();
+  if (type == "token") {
+    int lookahead = focus;
+    for (const FeatureFunctionDescriptor &nested : descriptor.feature()) {
+      lookahead = std::max(lookahead, SentenceLookahead(nested, focus));
+    }
+    return lookahead;
+  }
+  if (type == "input") {
+    focus = descriptor.argument();
+  } else if (type == "stack") {
+    focus = -1;
+  } else if (type == "offset") {
+    focus += descriptor.argument();
+  } else if (type == "head" || type == "child" || type == "sibling") {
+    focus = 0;
+  } else if (type != "label" && type != "hashed-word" &&
+             !IsSentenceIndexFeature(descriptor)) {
+    return kUnboundedLookahead;
+  }
+  int lookahead = focus;
+  for (const FeatureFunctionDescriptor &nested : descriptor.feature()) {
+    lookahead = std::max(lookahead, NestedLookahead(nested, focus));
+  }
+  return lookahead;
+}
+
+}  // namespace
+
+int InputLookahead(const ParserFeatureFunction &function) {
+  return std::max(0, NestedLookahead(*function.descriptor(), 0));
+}
+
+bool IsInputFeature(const ParserFeatureFunction &function) {
+  const FeatureFunctionDescriptor &descriptor = *function.descriptor();
+  if (descriptor.type() != "input") return false;
+  for (const FeatureFunctionDescriptor &nested : descriptor.feature()) {
+    if (!IsSentenceIndexFeature(nested)) return false;
+  }
+  return true;
+}
+
+void CompiledParserFeatureExtractor::RequestWorkspaces(
+    WorkspaceRegistry *registry) {
+  ParserFeatureExtractor::RequestWorkspaces(registry);
+  steps_.clear();
+  non_input_steps_.clear();
+  num_compiled_features_ = 0;
+  for (const ParserFeatureFunction *function : functions()) {
+    const size_t begin = steps_.size();
+    if (CompileChain(function)) {
+      ++num_compiled_features_;
+    } else {
+      steps_.push_back({Step::EVALUATE, function, -1, 0, nullptr});
+    }
+    if (!IsInputFeature(*function)) {
+      non_input_steps_.insert(non_input_steps_.end(), steps_.begin() + begin,
+                              steps_.end());
+    }
+  }
+  VLOG(1) << "Compiled " << num_compiled_features_ << " of "
+          << functions().size() << " parser features";
+}
+
+bool CompiledParserFeatureExtractor::CompileChain(
+    const ParserFeatureFunction *function) {
+  // Locate the initial focus.
+  vector<Step> steps;
+  const vector<ParserIndexFeatureFunction *> *nested;
+  if (const auto *input = dynamic_cast<const InputParserLocator *>(function)) {
+    steps.push_back({Step::INPUT, input, -1, 0, nullptr});
+    nested = &input->nested();
+  } else if (const auto *stack =
+                 dynamic_cast<const StackParserLocator *>(function)) {
+    steps.push_back({Step::STACK, stack, -1, 0, nullptr});
+    nested = &stack->nested();
+  } else {
+    return false;
+  }
+
+  // Follow the locators with a single nested feature.
+  while (nested->size() == 1) {
+    const ParserIndexFeatureFunction *index_function = nested->front();
+    if (const auto *head =
+            dynamic_cast<const HeadFeatureLocator *>(index_function)) {
+      steps.push_back({Step::HEAD, head, -1, 0, nullptr});
+      nested = &head->nested();
+    } else if (const auto *child =
+                   dynamic_cast<const ChildFeatureLocator *>(index_function)) {
+      steps.push_back({Step::CHILD, child, -1, 0, nullptr});
+      nested = &child->nested();
+    } else if (const auto *sibling = dynamic_cast<const SiblingFeatureLocator *>(
+                   index_function)) {
+      steps.push_back({Step::SIBLING, sibling, -1, 0, nullptr});
+      nested = &sibling->nested();
+    } else {
+      break;
+    }
+  }
+  if (nested->size() != 1) return false;
+
+  // Add the feature at the focus. Token lookup features are read from their
+  // workspaces, as TokenLookupFeature::Compute() does.
+  const ParserIndexFeatureFunction *leaf = nested->front();
+  const auto *token = dynamic_cast<const ParserTokenFeatureFunction *>(leaf);
+  const TokenLookupFeature *lookup =
+      token != nullptr && token->nested().size() == 1
+          ? dynamic_cast<const TokenLookupFeature *>(token->nested().front())
+          : nullptr;
+  if (dynamic_cast<const LabelFeatureFunction *>(leaf) != nullptr) {
+    steps.push_back({Step::LABEL, leaf, -1, 0, leaf->GetFeatureType()});
+  } else if (lookup != nullptr) {
+    steps.push_back({Step::TOKEN, lookup, lookup->Workspace(),
+                     lookup->NumValues(), lookup->GetFeatureType()});
+  } else {
+    steps.push_back({Step::EVALUATE_AT, leaf, -1, 0, nullptr});
+  }
+  steps_.insert(steps_.end(), steps.begin(), steps.end());
+  return true;
+}
+
+void CompiledParserFeatureExtractor::ExtractFeatures(
+    const WorkspaceSet &workspaces, const ParserState &state,
+    FeatureVector *result) const {
+  result->reserve(feature_types());
+  RunSteps(steps_, workspaces, state, result);
+}
+
+void CompiledParserFeatureExtractor::ExtractNonInputFeatures(
+    const WorkspaceSet &workspaces, const ParserState &state,
+    FeatureVector *result) const {
+  result->reserve(feature_types());
+  RunSteps(non_input_steps_, workspaces, state, result);
+}
+
+void CompiledParserFeatureExtractor::RunSteps(const vector<Step> &steps,
+                                              const WorkspaceSet &workspaces,
+                                              const ParserState &state,
+                                              FeatureVector *result) const {
+  int focus = -2;
+  FeatureValue value;
+  for (const Step &step : steps) {
+    switch (step.code) {
+      case Step::EVALUATE:
+        static_cast<const ParserFeatureFunction *>(step.function)
+            ->Evaluate(workspaces, state, result);
+        break;
+      case Step::INPUT:
+        focus = static_cast<const InputParserLocator *>(step.function)
+                    ->GetFocus(workspaces, state);
+        break;
+      case Step::STACK:
+        focus = static_cast<const StackParserLocator *>(step.function)
+                    ->GetFocus(workspaces, state);
+        break;
+      case Step::HEAD:
+        static_cast<const HeadFeatureLocator *>(step.function)
+            ->UpdateArgs(workspaces, state, &focus);
+        break;
+      case Step::CHILD:
+        static_cast<const ChildFeatureLocator *>(step.function)
+            ->UpdateArgs(workspaces, state, &focus);
+        break;
+      case Step::SIBLING:
+        static_cast<const SiblingFeatureLocator *>(step.function)
+            ->UpdateArgs(workspaces, state, &focus);
+        break;
+      case Step::LABEL:
+        value = static_cast<const LabelFeatureFunction *>(step.function)
+                    ->LabelValue(state, focus);
+        if (value != GenericFeatureFunction::kNone) {
+          result->add(step.type, value);
+        }
+        break;
+      case Step::TOKEN:
+        value = focus < 0 || focus >= state.sentence().token_size()
+                    ? step.outside
+                    : workspaces.Get<VectorIntWorkspace>(step.workspace)
+                          .element(focus);
+        if (value != GenericFeatureFunction::kNone) {
+          result->add(step.type, value);
+        }
+        break;
+      case Step::EVALUATE_AT:
+        static_cast<const ParserIndexFeatureFunction *>(step.function)
+            ->Evaluate(workspaces, state, focus, result);
+        break;
+    }
+  }
+}
+
 }  // namespace syntaxnet
@@ -18,6 +18,7 @@ limitations under the License.
 #ifndef SYNTAXNET_PARSER_FEATURES_H_
 #define SYNTAXNET_PARSER_FEATURES_H_
 
+#include <limits>
 #include <string>
 
 #include "syntaxnet/feature_extractor.h"
@@ -145,6 +146,96 @@ class BasicParserSentenceFeatureFunction :
   }
 };
 
+// Returns whether a top-level parser feature is a chain like input(1).char or
+// input.offset(-2).token.word, whose values only depend on the sentence and
+// the next input token of the parser state, and not on the stack or the arcs.
+bool IsInputFeature(const ParserFeatureFunction &function);
+
+// Lookahead of features that may read any token of the sentence.
+constexpr int kUnboundedLookahead = std::numeric_limits<int>::max();
+
+// Returns how many tokens past the next input token of the parser state a
+// top-level parser feature may read, e.g. 2 for input(1).offset(1).word and
+// 0 for stack.child(1).tag, or kUnboundedLookahead for features like
+// last-word. Arcs are assumed to only involve the tokens up to the next input
+// token, as in the arc-standard and arc-eager systems.
+int InputLookahead(const ParserFeatureFunction &function);
+
+// Parser feature extractor that evaluates the usual chains of locators ending
+// in a label or token feature, like stack.child(1).sibling(-1).label or
+// input(1).token.tag, as flat sequences of steps instead of nested virtual
+// calls. Other top-level features are evaluated as in ParserFeatureExtractor.
+// The extracted features are the same, in the same order.
+class CompiledParserFeatureExtractor : public ParserFeatureExtractor {
+ public:
+  // Requests workspaces from the registry, and compiles the features, since
+  // the steps read the workspaces of token features directly.
+  void RequestWorkspaces(WorkspaceRegistry *registry);
+
+  // Extracts features from a parser state. Must not be called before
+  // RequestWorkspaces().
+  void ExtractFeatures(const WorkspaceSet &workspaces, const ParserState &state,
+                       FeatureVector *result) const;
+
+  // Extracts only the features that are not input features as defined by
+  // IsInputFeature(). Must not be called before RequestWorkspaces().
+  void ExtractNonInputFeatures(const WorkspaceSet &workspaces,
+                               const ParserState &state,
+                               FeatureVector *result) const;
+
+  // Returns the number of top-level features compiled into steps.
+  int num_compiled_features() const { return num_compiled_features_; }
+
+ private:
+  // A step in the evaluation of the features. A compiled feature is a locator
+  // step setting the focus, any number of locator steps updating it, and a
+  // step adding the feature for the focus. Uncompiled features are a single
+  // EVALUATE step.
+  struct Step {
+    enum Code {
+      EVALUATE,     // evaluates a top-level feature function
+      INPUT,        // sets the focus to an input token
+      STACK,        // sets the focus to a stack token
+      HEAD,         // moves the focus to a head
+      CHILD,        // moves the focus to a child
+      SIBLING,      // moves the focus to a sibling
+      LABEL,        // adds the label of the focus
+      TOKEN,        // adds the precomputed token feature of the focus
+      EVALUATE_AT,  // evaluates a feature function at the focus
+    };
+
+    Code code;
+
+    // Feature function evaluated by the step. Not owned.
+    const GenericFeatureFunction *function;
+
+    // For TOKEN steps, the workspace of the token feature and its value for
+    // foci outside the sentence.
+    int workspace;
+    FeatureValue outside;
+
+    // For LABEL and TOKEN steps, the type of the added features. Not owned.
+    FeatureType *type;
+  };
+
+  // Compiles the given top-level feature into steps. Returns false if it is
+  // not a chain of locators ending in a feature at the focus.
+  bool CompileChain(const ParserFeatureFunction *function);
+
+  // Runs the given steps of the features.
+  void RunSteps(const vector<Step> &steps, const WorkspaceSet &workspaces,
+                const ParserState &state, FeatureVector *result) const;
+
+  // Steps of all features, in order.
+  vector<Step> steps_;
+
+  // Steps of the features that are not input features, in order.
+  vector<Step> non_input_steps_;
+
+  // Number of top-level features evaluated as chains.
+  int num_compiled_features_ = 0;
+};
+
 }  // namespace syntaxnet
 
 #endif  // SYNTAXNET_PARSER_FEATURES_H_
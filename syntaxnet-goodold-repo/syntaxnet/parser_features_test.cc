@@ -17,10 +17,12 @@ limitations under the License.
 
 #include <string>
 
+#include "syntaxnet/embedding_feature_extractor.h"
 #include "syntaxnet/feature_extractor.h"
 #include "syntaxnet/parser_state.h"
 #include "syntaxnet/populate_test_inputs.h"
 #include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/sparse.pb.h"
 #include "syntaxnet/task_context.h"
 #include "syntaxnet/task_spec.pb.h"
 #include "syntaxnet/term_frequency_map.h"
@@ -141,4 +143,194 @@ TEST_F(ParserFeatureFunctionTest, LabelFeatureFunction) {
   EXPECT_EQ("<ROOT>", ExtractFeature("stack.label"));
 }
 
+TEST_F(ParserFeatureFunctionTest, CompiledFeaturesMatchNestedFeatures) {
+  // Construct a partial dependency tree and a stack.
+  state_->AddArc(0, 1, 4);
+  state_->AddArc(2, 3, 2);
+  state_->AddArc(3, 1, 3);
+  state_->AddArc(5, 6, 2);
+  state_->Push(-1);
+  state_->Push(1);
+  state_->Push(6);
+
+  // Extracts the same features with both extractors.
+  const string kFeatures =
+      "stack.child(1).label stack.child(1).sibling(-1).label "
+      "stack(1).child(-1).label stack(1).child(-1).sibling(1).label "
+      "stack(2).label input.token.tag input(1).token.word stack.token.tag "
+      "stack(1).child(1).token.word stack(3).token.tag input(9).token.word "
+      "stack.head(1).token.tag input.tag stack(1).child(-2).tag";
+  ParserFeatureExtractor nested;
+  CompiledParserFeatureExtractor compiled;
+  nested.Parse(kFeatures);
+  compiled.Parse(kFeatures);
+  nested.Setup(&context_);
+  compiled.Setup(&context_);
+  creators_.Populate(&context_);
+  nested.Init(&context_);
+  compiled.Init(&context_);
+  nested.RequestWorkspaces(&registry_);
+  compiled.RequestWorkspaces(&registry_);
+  workspaces_.Reset(registry_);
+  nested.Preprocess(&workspaces_, state_.get());
+  compiled.Preprocess(&workspaces_, state_.get());
+  FeatureVector expected;
+  FeatureVector actual;
+  nested.ExtractFeatures(workspaces_, *state_, &expected);
+  compiled.ExtractFeatures(workspaces_, *state_, &actual);
+
+  EXPECT_EQ(14, compiled.num_compiled_features());
+  ASSERT_EQ(expected.size(), actual.size());
+  for (int i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected.type(i)->name(), actual.type(i)->name());
+    EXPECT_EQ(expected.value(i), actual.value(i));
+  }
+}
+
+TEST_F(ParserFeatureFunctionTest, InputFeaturesDependOnlyOnInput) {
+  ParserFeatureExtractor extractor;
+  extractor.Parse(
+      "input.token.word input(1).tag input.offset(-1).char input "
+      "input.label stack.tag input.head.tag input.offset(1).label");
+  extractor.Setup(&context_);
+  const vector<bool> expected = {true,  true,  true,  true,
+                                 false, false, false, false};
+  ASSERT_EQ(expected.size(), extractor.functions().size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i], IsInputFeature(*extractor.functions()[i]))
+        << extractor.functions()[i]->name();
+  }
+}
+
+TEST_F(ParserFeatureFunctionTest, InputLookaheadCoversOffsets) {
+  ParserFeatureExtractor extractor;
+  extractor.Parse(
+      "input.token.word input(2).tag input(1).offset(1).word "
+      "input.token.offset(3).word stack.child(1).tag stack.offset(2).word "
+      "input.head.label stack(1).token.word");
+  extractor.Setup(&context_);
+  const vector<int> expected = {0, 2, 2, 3, 0, 1, 0, 0};
+  ASSERT_EQ(expected.size(), extractor.functions().size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    EXPECT_EQ(expected[i], InputLookahead(*extractor.functions()[i]))
+        << extractor.functions()[i]->name();
+  }
+}
+
+TEST_F(ParserFeatureFunctionTest, UpdatedSparseFeaturesMatchExtracted) {
+  context_.SetParameter("test_features",
+                        "input.token.word stack.token.word;stack.label");
+  context_.SetParameter("test_embedding_names", "words;labels");
+  context_.SetParameter("test_embedding_dims", "8;8");
+  ParserEmbeddingFeatureExtractor features("test");
+  features.Setup(&context_);
+  creators_.Populate(&context_);
+  features.Init(&context_);
+  features.RequestWorkspaces(&registry_);
+  workspaces_.Reset(registry_);
+  features.Preprocess(&workspaces_, state_.get());
+
+  // Advances the state and checks that the memo always holds the features
+  // extracted from scratch, and flags exactly the features that changed.
+  SparseFeaturesMemo memo;
+  vector<vector<SparseFeatures>> previous;
+  for (int step = 0; step < 4; ++step) {
+    features.UpdateSparseFeatures(workspaces_, *state_, &memo);
+    const vector<vector<SparseFeatures>> expected =
+        features.ExtractSparseFeatures(workspaces_, *state_);
+    ASSERT_EQ(expected.size(), memo.features.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_EQ(expected[i].size(), memo.features[i].size());
+      for (size_t j = 0; j < expected[i].size(); ++j) {
+        const string serialized = expected[i][j].SerializeAsString();
+        EXPECT_EQ(serialized, memo.features[i][j].SerializeAsString());
+        if (step > 0) {
+          EXPECT_EQ(serialized != previous[i][j].SerializeAsString(),
+                    memo.changed[i][j]);
+        } else {
+          EXPECT_TRUE(memo.changed[i][j]);
+        }
+      }
+    }
+    previous = expected;
+    if (step < 2) {
+      state_->Push(state_->Next());
+      state_->Advance();
+    } else {
+      state_->AddArc(state_->Pop(), state_->Top(), 2);
+    }
+  }
+
+  // A cleared memo rebuilds all features.
+  memo.Clear();
+  features.UpdateSparseFeatures(workspaces_, *state_, &memo);
+  for (const vector<bool> &changed : memo.changed) {
+    for (bool feature_changed : changed) EXPECT_TRUE(feature_changed);
+  }
+}
+
+TEST_F(ParserFeatureFunctionTest, ReusedInputFeaturesMatchExtracted) {
+  context_.SetParameter("test_features",
+                        "input.token.word stack.token.word input(1).tag;"
+                        "stack.label");
+  context_.SetParameter("test_embedding_names", "words;labels");
+  context_.SetParameter("test_embedding_dims", "8;8");
+  ParserEmbeddingFeatureExtractor features("test");
+  features.Setup(&context_);
+  creators_.Populate(&context_);
+  features.Init(&context_);
+  features.RequestWorkspaces(&registry_);
+  workspaces_.Reset(registry_);
+  features.Preprocess(&workspaces_, state_.get());
+  const vector<vector<bool>> input_features = features.InputFeatures();
+
+  // Shifts twice, then adds an arc, which keeps the next input token, and
+  // checks that the features with the input features of the state before the
+  // arc are the features extracted from scratch.
+  state_->Push(state_->Next());
+  state_->Advance();
+  state_->Push(state_->Next());
+  state_->Advance();
+  const vector<vector<SparseFeatures>> parent =
+      features.ExtractSparseFeatures(workspaces_, *state_);
+  state_->AddArc(state_->Pop(), state_->Top(), 2);
+  const vector<vector<SparseFeatures>> expected =
+      features.ExtractSparseFeatures(workspaces_, *state_);
+  const vector<vector<SparseFeatures>> reused =
+      features.ExtractSparseFeaturesReusingInput(workspaces_, *state_,
+                                                 input_features, parent);
+  ASSERT_EQ(expected.size(), reused.size());
+  for (size_t i = 0; i < expected.size(); ++i) {
+    ASSERT_EQ(expected[i].size(), reused[i].size());
+    for (size_t j = 0; j < expected[i].size(); ++j) {
+      EXPECT_EQ(expected[i][j].SerializeAsString(),
+                reused[i][j].SerializeAsString());
+    }
+  }
+}
+
+TEST_F(ParserFeatureFunctionTest, SharedFeaturesAreReusedForSameContext) {
+  context_.SetParameter("test_features", "input.token.word;stack.label");
+  context_.SetParameter("test_embedding_names", "words;labels");
+  context_.SetParameter("test_embedding_dims", "8;8");
+  creators_.Populate(&context_);
+  TaskContext same_context = context_;
+  TaskContext other_context = context_;
+  other_context.SetParameter("test_features", "input.token.word;input.label");
+  const SharedParserFeatures *shared =
+      SharedParserFeatures::Get("test", &context_);
+  const SharedParserFeatures *same =
+      SharedParserFeatures::Get("test", &same_context);
+  const SharedParserFeatures *other =
+      SharedParserFeatures::Get("test", &other_context);
+  EXPECT_EQ(shared, same);
+  EXPECT_NE(shared, other);
+  EXPECT_EQ(context_.spec().DebugString(), same_context.spec().DebugString());
+  EXPECT_EQ(2, shared->features().NumEmbeddings());
+  EXPECT_EQ(1, shared->features().FeatureSize(0));
+  SharedParserFeatures::Release(shared);
+  SharedParserFeatures::Release(same);
+  SharedParserFeatures::Release(other);
+}
+
 }  // namespace syntaxnet
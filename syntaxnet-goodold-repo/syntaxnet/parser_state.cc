@@ -27,29 +27,77 @@ const char ParserState::kRootLabel[] = "ROOT";
 ParserState::ParserState(Sentence *sentence,
                          ParserTransitionState *transition_state,
                          const TermFrequencyMap *label_map)
-    : sentence_(sentence),
-      num_tokens_(sentence->token_size()),
-      transition_state_(transition_state),
-      label_map_(label_map),
-      root_label_(kDefaultRootLabel),
-      next_(0) {
-  // Initialize the stack. Some transition systems could also push the
-  // artificial root on the stack, so we make room for that as well.
-  stack_.reserve(num_tokens_ + 1);
+    : ParserState(sentence, transition_state, label_map, nullptr) {}
+
+ParserState::ParserState(Sentence *sentence,
+                         ParserTransitionState *transition_state,
+                         const TermFrequencyMap *label_map,
+                         ParserStateArena *arena)
+    : arena_(arena) {
+  Init(sentence, transition_state, label_map);
+}
+
+ParserState::~ParserState() { Clear(); }
+
+void ParserState::Init(Sentence *sentence,
+                       ParserTransitionState *transition_state,
+                       const TermFrequencyMap *label_map) {
+  sentence_ = sentence;
+  num_tokens_ = sentence->token_size();
+  alternative_ = -1;
+  transition_state_ = transition_state;
+  label_map_ = label_map;
+  root_label_ = kDefaultRootLabel;
+  next_ = 0;
+  score_ = 0.0;
+  is_gold_ = false;
 
   // Allocate space for head indices and labels. Initialize the head for all
   // tokens to be the artificial root node, i.e. token -1.
-  head_.resize(num_tokens_, -1);
-  label_.resize(num_tokens_, RootLabel());
+  tree_ = arena_ != nullptr ? arena_->NewTree() : new Tree();
+  tree_->refs = 1;
+  tree_->head.assign(num_tokens_, -1);
+  tree_->label.assign(num_tokens_, RootLabel());
 
   // Transition system-specific preprocessing.
   if (transition_state_ != nullptr) transition_state_->Init(this);
 }
 
-ParserState::~ParserState() { delete transition_state_; }
+void ParserState::Clear() {
+  Unref(stack_);
+  stack_ = nullptr;
+  stack_size_ = 0;
+  Unref(tree_);
+  tree_ = nullptr;
+  delete transition_state_;
+  transition_state_ = nullptr;
+}
+
+void ParserState::Unref(StackNode *node) {
+  // Frees the elements from the top down, as long as they are not shared.
+  while (node != nullptr && --node->refs == 0) {
+    StackNode *below = node->below;
+    if (arena_ != nullptr) {
+      arena_->FreeStackNode(node);
+    } else {
+      delete node;
+    }
+    node = below;
+  }
+}
+
+void ParserState::Unref(Tree *tree) {
+  if (tree == nullptr || --tree->refs > 0) return;
+  if (arena_ != nullptr) {
+    arena_->FreeTree(tree);
+  } else {
+    delete tree;
+  }
+}
 
 ParserState *ParserState::Clone() const {
   ParserState *new_state = new ParserState();
+  new_state->arena_ = arena_;
   new_state->sentence_ = sentence_;
   new_state->num_tokens_ = num_tokens_;
   new_state->alternative_ = alternative_;
@@ -58,9 +106,11 @@ ParserState *ParserState::Clone() const {
   new_state->label_map_ = label_map_;
   new_state->root_label_ = root_label_;
   new_state->next_ = next_;
-  new_state->stack_.assign(stack_.begin(), stack_.end());
-  new_state->head_.assign(head_.begin(), head_.end());
-  new_state->label_.assign(label_.begin(), label_.end());
+  new_state->stack_ = stack_;
+  if (stack_ != nullptr) ++stack_->refs;
+  new_state->stack_size_ = stack_size_;
+  new_state->tree_ = tree_;
+  ++tree_->refs;
   new_state->score_ = score_;
   new_state->is_gold_ = is_gold_;
   return new_state;
@@ -86,43 +136,66 @@ void ParserState::Advance() {
 
 bool ParserState::EndOfInput() const { return next_ == num_tokens_; }
 
+void ParserState::ExtendInput() {
+  const int num_tokens = sentence_->token_size();
+  DCHECK_GE(num_tokens, num_tokens_);
+  if (num_tokens == num_tokens_) return;
+  UnshareTree();
+  tree_->head.resize(num_tokens, -1);
+  tree_->label.resize(num_tokens, RootLabel());
+  num_tokens_ = num_tokens;
+}
+
 void ParserState::Push(int index) {
-  DCHECK_LE(stack_.size(), num_tokens_);
-  stack_.push_back(index);
+  DCHECK_LE(stack_size_, num_tokens_);
+
+  // The new element takes over the reference to the old top element.
+  StackNode *node =
+      arena_ != nullptr ? arena_->NewStackNode() : new StackNode();
+  node->index = index;
+  node->refs = 1;
+  node->below = stack_;
+  stack_ = node;
+  ++stack_size_;
 }
 
 int ParserState::Pop() {
   DCHECK(!StackEmpty());
-  const int result = stack_.back();
-  stack_.pop_back();
+  StackNode *top = stack_;
+  const int result = top->index;
+  stack_ = top->below;
+  if (stack_ != nullptr) ++stack_->refs;
+  Unref(top);
+  --stack_size_;
   return result;
 }
 
 int ParserState::Top() const {
   DCHECK(!StackEmpty());
-  return stack_.back();
+  return stack_->index;
 }
 
 int ParserState::Stack(int position) const {
-  if (position < 0) return -2;
-  const int index = stack_.size() - 1 - position;
-  return (index < 0) ? -2 : stack_[index];
+  if (position < 0 || position >= stack_size_) return -2;
+  const StackNode *node = stack_;
+  while (position-- > 0) node = node->below;
+  return node->index;
 }
 
-int ParserState::StackSize() const { return stack_.size(); }
+int ParserState::StackSize() const { return stack_size_; }
 
-bool ParserState::StackEmpty() const { return stack_.empty(); }
+bool ParserState::StackEmpty() const { return stack_size_ == 0; }
 
 int ParserState::Head(int index) const {
   DCHECK_GE(index, -1);
   DCHECK_LT(index, num_tokens_);
-  return index == -1 ? -1 : head_[index];
+  return index == -1 ? -1 : tree_->head[index];
 }
 
 int ParserState::Label(int index) const {
   DCHECK_GE(index, -1);
   DCHECK_LT(index, num_tokens_);
-  return index == -1 ? RootLabel() : label_[index];
+  return index == -1 ? RootLabel() : tree_->label[index];
 }
 
 int ParserState::Parent(int index, int n) const {
@@ -198,8 +271,21 @@ int ParserState::RightSibling(int index, int n) const {
 void ParserState::AddArc(int index, int head, int label) {
   DCHECK_GE(index, 0);
   DCHECK_LT(index, num_tokens_);
-  head_[index] = head;
-  label_[index] = label;
+
+  UnshareTree();
+  tree_->head[index] = head;
+  tree_->label[index] = label;
+}
+
+void ParserState::UnshareTree() {
+  if (tree_->refs > 1) {
+    Tree *tree = arena_ != nullptr ? arena_->NewTree() : new Tree();
+    tree->refs = 1;
+    tree->head.assign(tree_->head.begin(), tree_->head.end());
+    tree->label.assign(tree_->label.begin(), tree_->label.end());
+    --tree_->refs;
+    tree_ = tree;
+  }
 }
 
 int ParserState::GoldHead(int index) const {
@@ -245,4 +331,65 @@ string ParserState::ToString() const {
   return transition_state_->ToString(*this);
 }
 
+ParserStateArena::~ParserStateArena() {
+  // Deletes the released states before the storage they no longer refer to.
+  free_states_.clear();
+}
+
+std::unique_ptr<ParserState> ParserStateArena::NewState(
+    Sentence *sentence, ParserTransitionState *transition_state,
+    const TermFrequencyMap *label_map) {
+  if (free_states_.empty()) {
+    ++num_allocations_;
+    return std::unique_ptr<ParserState>(
+        new ParserState(sentence, transition_state, label_map, this));
+  }
+  std::unique_ptr<ParserState> state = std::move(free_states_.back());
+  free_states_.pop_back();
+  state->Init(sentence, transition_state, label_map);
+  return state;
+}
+
+void ParserStateArena::Release(std::unique_ptr<ParserState> state) {
+  if (state == nullptr) return;
+  DCHECK_EQ(this, state->arena_);
+  state->Clear();
+  free_states_.push_back(std::move(state));
+}
+
+ParserState::StackNode *ParserStateArena::NewStackNode() {
+  if (free_stack_nodes_ == nullptr) {
+    ++num_allocations_;
+    stack_blocks_.emplace_back(new ParserState::StackNode[kStackBlockSize]);
+    ParserState::StackNode *block = stack_blocks_.back().get();
+    for (int i = 0; i < kStackBlockSize; ++i) {
+      block[i].below = i + 1 < kStackBlockSize ? &block[i + 1] : nullptr;
+    }
+    free_stack_nodes_ = block;
+  }
+  ParserState::StackNode *node = free_stack_nodes_;
+  free_stack_nodes_ = node->below;
+  return node;
+}
+
+void ParserStateArena::FreeStackNode(ParserState::StackNode *node) {
+  node->below = free_stack_nodes_;
+  free_stack_nodes_ = node;
+}
+
+ParserState::Tree *ParserStateArena::NewTree() {
+  if (free_trees_.empty()) {
+    ++num_allocations_;
+    trees_.emplace_back(new ParserState::Tree());
+    return trees_.back().get();
+  }
+  ParserState::Tree *tree = free_trees_.back();
+  free_trees_.pop_back();
+  return tree;
+}
+
+void ParserStateArena::FreeTree(ParserState::Tree *tree) {
+  free_trees_.push_back(tree);
+}
+
 }  // namespace syntaxnet
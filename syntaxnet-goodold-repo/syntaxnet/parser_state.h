@@ -18,7 +18,9 @@ limitations under the License.
 #ifndef SYNTAXNET_PARSER_STATE_H_
 #define SYNTAXNET_PARSER_STATE_H_
 
+#include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "syntaxnet/utils.h"
@@ -28,6 +30,7 @@ limitations under the License.
 
 namespace syntaxnet {
 
+class ParserStateArena;
 class TermFrequencyMap;
 
 // A ParserState object represents the state of the parser during the parsing of
@@ -37,6 +40,16 @@ class TermFrequencyMap;
 // to the dependency tree of the sentence. The parser state also records the
 // (partial) parse tree for the sentence by recording the head of each token and
 // the label of this relation. The state is used for both training and parsing.
+//
+// Cloning is cheap: the stack is a persistent linked list whose tail is shared
+// with the state it was cloned from, and the head and label arrays are shared
+// until one of the states adds an arc. This makes it affordable to clone a
+// state for every candidate transition during beam search. The stack and the
+// arrays are reference counted without synchronization, so states sharing
+// storage must be cloned and modified on one thread at a time.
+//
+// The storage of a state comes from the ParserStateArena passed at
+// construction, if any, and is shared with the clones of the state.
 class ParserState {
  public:
   // String representation of the root label.
@@ -55,6 +68,12 @@ class ParserState {
               ParserTransitionState *transition_state,
               const TermFrequencyMap *label_map);
 
+  // As above, but allocates the stack and the dependency tree from the given
+  // arena, which must outlive the state and its clones.
+  ParserState(Sentence *sentence,
+              ParserTransitionState *transition_state,
+              const TermFrequencyMap *label_map, ParserStateArena *arena);
+
   // Deletes the parser state.
   ~ParserState();
 
@@ -80,6 +99,12 @@ class ParserState {
   // Returns true if all tokens have been processed.
   bool EndOfInput() const;
 
+  // Extends the input to the tokens appended to the sentence since the state
+  // was created, for parsing a sentence while its tokens arrive. The new
+  // tokens have no arcs yet. Only valid for transition systems whose
+  // transition state does not depend on the number of tokens.
+  void ExtendInput();
+
   // Pushes an element to the stack.
   void Push(int index);
 
@@ -180,9 +205,49 @@ class ParserState {
   void set_is_gold(bool is_gold) { is_gold_ = is_gold; }
 
  private:
+  friend class ParserStateArena;
+
+  // Element of the parse stack. Elements are immutable and shared between
+  // cloned states. Each element holds a reference to the element below it.
+  struct StackNode {
+    int index;
+    int refs;
+    StackNode *below;
+  };
+
+  // Head positions and dependency labels of the (partial) dependency tree.
+  // Shared with clones until modified.
+  struct Tree {
+    int refs;
+    vector<int> head;
+    vector<int> label;
+  };
+
   // Empty constructor used for the cloning operation.
   ParserState() {}
 
+  // Initializes the state for a sentence, as the constructor does.
+  void Init(Sentence *sentence, ParserTransitionState *transition_state,
+            const TermFrequencyMap *label_map);
+
+  // Drops the stack, the dependency tree and the transition state.
+  void Clear();
+
+  // Drops a reference to a stack element, and frees the elements no longer
+  // referenced.
+  void Unref(StackNode *node);
+
+  // Drops a reference to a dependency tree, and frees it if it is no longer
+  // referenced.
+  void Unref(Tree *tree);
+
+  // Copies the dependency tree if it is still shared with another state, so
+  // that it can be modified.
+  void UnshareTree();
+
+  // Arena holding the storage of the state, or null for the heap. Not owned.
+  ParserStateArena *arena_ = nullptr;
+
   // Default value for the root token.
   const Token kRootToken;
 
@@ -209,15 +274,15 @@ class ParserState {
   // Index of the next input token.
   int next_;
 
-  // Parse stack of partially processed tokens.
-  vector<int> stack_;
+  // Parse stack of partially processed tokens, from the top down. Holds a
+  // reference to the top element.
+  StackNode *stack_ = nullptr;
 
-  // List of head positions for the (partial) dependency tree.
-  vector<int> head_;
+  // Number of elements on the stack.
+  int stack_size_ = 0;
 
-  // List of dependency relation labels describing the (partial) dependency
-  // tree.
-  vector<int> label_;
+  // The (partial) dependency tree. Holds a reference.
+  Tree *tree_ = nullptr;
 
   // Score of the parser state.
   double score_ = 0.0;
@@ -228,6 +293,67 @@ class ParserState {
   TF_DISALLOW_COPY_AND_ASSIGN(ParserState);
 };
 
+// Recycles parser states and their storage, so that a reader parsing a stream
+// of sentences stops allocating once its batch reached its largest size. The
+// stack elements and dependency trees of the states created by the arena, and
+// of their clones, are allocated from the arena and returned to it when no
+// longer used. States released to the arena are reused by NewState(). The
+// arena is not thread-safe, and must outlive all states using it.
+class ParserStateArena {
+ public:
+  ParserStateArena() {}
+  ~ParserStateArena();
+
+  // Returns a parser state for the sentence, reusing a released state if there
+  // is one. The arguments are as for the ParserState constructor.
+  std::unique_ptr<ParserState> NewState(Sentence *sentence,
+                                        ParserTransitionState *transition_state,
+                                        const TermFrequencyMap *label_map);
+
+  // Releases a state for reuse by NewState(). Does nothing if the state is
+  // null. The state must have been created by this arena.
+  void Release(std::unique_ptr<ParserState> state);
+
+  // Returns the number of heap allocations made by the arena so far.
+  int64 num_allocations() const { return num_allocations_; }
+
+ private:
+  friend class ParserState;
+
+  // Number of stack elements allocated at once.
+  static const int kStackBlockSize = 1024;
+
+  // Returns an uninitialized stack element.
+  ParserState::StackNode *NewStackNode();
+
+  // Returns a stack element no longer referenced to the arena.
+  void FreeStackNode(ParserState::StackNode *node);
+
+  // Returns an uninitialized dependency tree. Its arrays keep the contents and
+  // capacity they had when freed.
+  ParserState::Tree *NewTree();
+
+  // Returns a dependency tree no longer referenced to the arena.
+  void FreeTree(ParserState::Tree *tree);
+
+  // Blocks of stack elements, and the free elements linked through their below
+  // pointers.
+  vector<std::unique_ptr<ParserState::StackNode[]>> stack_blocks_;
+  ParserState::StackNode *free_stack_nodes_ = nullptr;
+
+  // All dependency trees, and the free ones.
+  vector<std::unique_ptr<ParserState::Tree>> trees_;
+  vector<ParserState::Tree *> free_trees_;
+
+  // Released parser states.
+  vector<std::unique_ptr<ParserState>> free_states_;
+
+  // Number of heap allocations made so far.
+  int64 num_allocations_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ParserStateArena);
+};
+
 }  // namespace syntaxnet
 
 #endif  // SYNTAXNET_PARSER_STATE_H_
@@ -0,0 +1,142 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/parser_state.h"
+
+#include <memory>
+#include <vector>
+
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/term_frequency_map.h"
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+namespace syntaxnet {
+namespace {
+
+class ParserStateTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    CHECK(TextFormat::ParseFromString(
+        "token { word: 'I' start: 0 end: 0 } "
+        "token { word: 'saw' start: 2 end: 4 } "
+        "token { word: 'a' start: 6 end: 6 } "
+        "token { word: 'man' start: 8 end: 10 }",
+        &sentence_));
+    label_map_.Increment("det");
+    label_map_.Increment("dobj");
+    label_map_.Increment("nsubj");
+  }
+
+  // Parses the sentence with a fixed sequence of transitions, and checks the
+  // resulting tree.
+  void Parse(ParserState *state) {
+    state->Push(-1);
+    for (int i = 0; i < 2; ++i) {
+      state->Push(state->Next());
+      state->Advance();
+    }
+    state->AddArc(state->Stack(1), state->Stack(0), 2);
+    const int top = state->Pop();
+    state->Pop();
+    state->Push(top);
+    for (int i = 0; i < 2; ++i) {
+      state->Push(state->Next());
+      state->Advance();
+    }
+    state->AddArc(state->Stack(1), state->Stack(0), 0);
+    const int noun = state->Pop();
+    state->Pop();
+    state->AddArc(noun, state->Top(), 1);
+    EXPECT_EQ(2, state->StackSize());
+    EXPECT_EQ(1, state->Top());
+    EXPECT_EQ(1, state->Head(0));
+    EXPECT_EQ(3, state->Head(2));
+    EXPECT_EQ(1, state->Head(3));
+    EXPECT_EQ(-1, state->Head(1));
+    EXPECT_EQ(1, state->Label(3));
+  }
+
+  Sentence sentence_;
+  TermFrequencyMap label_map_;
+};
+
+TEST_F(ParserStateTest, ArenaStatesParseLikeHeapStates) {
+  ParserState heap_state(&sentence_, nullptr, &label_map_);
+  Parse(&heap_state);
+
+  ParserStateArena arena;
+  std::unique_ptr<ParserState> state =
+      arena.NewState(&sentence_, nullptr, &label_map_);
+  Parse(state.get());
+  arena.Release(std::move(state));
+
+  // A recycled state starts from an empty stack and tree.
+  state = arena.NewState(&sentence_, nullptr, &label_map_);
+  EXPECT_EQ(0, state->StackSize());
+  EXPECT_EQ(0, state->Next());
+  for (int i = 0; i < sentence_.token_size(); ++i) {
+    EXPECT_EQ(-1, state->Head(i));
+    EXPECT_EQ(state->RootLabel(), state->Label(i));
+  }
+  Parse(state.get());
+}
+
+TEST_F(ParserStateTest, ClonesDoNotShareModifications) {
+  ParserStateArena arena;
+  std::unique_ptr<ParserState> state =
+      arena.NewState(&sentence_, nullptr, &label_map_);
+  state->Push(-1);
+  state->Push(0);
+  state->Advance();
+  std::unique_ptr<ParserState> clone(state->Clone());
+  clone->Push(1);
+  clone->AddArc(0, 1, 2);
+  EXPECT_EQ(2, state->StackSize());
+  EXPECT_EQ(0, state->Top());
+  EXPECT_EQ(-1, state->Head(0));
+  EXPECT_EQ(3, clone->StackSize());
+  EXPECT_EQ(1, clone->Head(0));
+
+  // The clone keeps the shared stack elements alive.
+  state->Pop();
+  state->Pop();
+  arena.Release(std::move(state));
+  EXPECT_EQ(1, clone->Stack(0));
+  EXPECT_EQ(0, clone->Stack(1));
+  EXPECT_EQ(-1, clone->Stack(2));
+}
+
+TEST_F(ParserStateTest, SteadyStateMakesNoAllocations) {
+  ParserStateArena arena;
+  int64 num_allocations = 0;
+  for (int iteration = 0; iteration < 3; ++iteration) {
+    std::unique_ptr<ParserState> state =
+        arena.NewState(&sentence_, nullptr, &label_map_);
+    std::unique_ptr<ParserState> clone(state->Clone());
+    Parse(state.get());
+    Parse(clone.get());
+    clone.reset();
+    arena.Release(std::move(state));
+    if (iteration == 0) {
+      num_allocations = arena.num_allocations();
+    } else {
+      EXPECT_EQ(num_allocations, arena.num_allocations());
+    }
+  }
+}
+
+}  // namespace
+}  // namespace syntaxnet
@@ -19,8 +19,10 @@
 
 import os
 import os.path
+import threading
 import time
 
+from six.moves import queue
 import tensorflow as tf
 
 from tensorflow.python.platform import gfile
@@ -29,6 +31,7 @@ from tensorflow.python.platform import tf_logging as logging
 from google.protobuf import text_format
 
 from syntaxnet import graph_builder
+from syntaxnet import lstm_graph_builder
 from syntaxnet import structured_graph_builder
 from syntaxnet.ops import gen_parser_ops
 from syntaxnet import task_spec_pb2
@@ -56,7 +59,30 @@ flags.DEFINE_bool('projectivize_training_set', False, '')
 flags.DEFINE_string('hidden_layer_sizes', '200,200',
                     'Comma separated list of hidden layer sizes.')
 flags.DEFINE_string('graph_builder', 'greedy',
-                    'Graph builder to use, either "greedy" or "structured".')
+                    'Graph builder to use, either "greedy", "structured" or '
+                    '"lstm".')
+flags.DEFINE_bool('packed_features', False,
+                  'Whether the greedy readers return packed feature tensors '
+                  'instead of serialized SparseFeatures protos.')
+flags.DEFINE_string('gold_features', '',
+                    'File pattern of gold feature shards written by '
+                    'gold_features_main for the training corpus, from which '
+                    'the greedy parser is trained with packed features.')
+flags.DEFINE_bool('factored_arc_actions', False,
+                  'Whether the arc-standard actions are scored by a softmax '
+                  'over the action types and one over the labels.')
+flags.DEFINE_bool('sparse_cost', True,
+                  'Whether the greedy cost is computed from the gold action '
+                  'ids rather than from one-hot gold distributions.')
+flags.DEFINE_bool('sparse_averaging', False,
+                  'Whether the moving averages of the embedding matrices only '
+                  'update the rows trained by each step, catching the others '
+                  'up before evaluations and checkpoints.')
+flags.DEFINE_integer('lstm_size', 128,
+                     'Number of units of each direction of the lstm network.')
+flags.DEFINE_integer('max_sentence_length', 64,
+                     'Number of steps of a sentence the lstm network scores '
+                     'together.')
 flags.DEFINE_integer('batch_size', 32,
                      'Number of sentences to process in parallel.')
 flags.DEFINE_integer('beam_size', 10, 'Number of slots for beam parsing.')
@@ -67,6 +93,23 @@ flags.DEFINE_integer('report_every', 100,
                      'Report cost and training accuracy every this many steps.')
 flags.DEFINE_integer('checkpoint_every', 5000,
                      'Measure tuning UAS and checkpoint every this many steps.')
+flags.DEFINE_string('async_eval', '',
+                    'If "thread", the chief writes a checkpoint every '
+                    'checkpoint_every steps and evaluates it on a thread of '
+                    'its own while training continues. If "process", the '
+                    'checkpoints are evaluated by a parser_trainer with the '
+                    'same flags and --evaluate_checkpoints. Empty to pause '
+                    'training for each evaluation.')
+flags.DEFINE_bool('evaluate_checkpoints', False,
+                  'Whether to evaluate the checkpoints of a trainer running '
+                  'with --async_eval=process instead of training, until the '
+                  'trainer is done.')
+flags.DEFINE_integer('eval_poll_secs', 10,
+                     'Seconds between checks for new checkpoints when '
+                     'evaluating asynchronously.')
+flags.DEFINE_bool('export_meta_graph', False,
+                  'Whether to write the training graph as a MetaGraph for '
+                  'parser_trainer_main to train instead of training.')
 flags.DEFINE_bool('slim_model', False,
                   'Whether to remove non-averaged variables, for compactness.')
 flags.DEFINE_float('learning_rate', 0.1, 'Initial learning rate parameter.')
@@ -82,6 +125,25 @@ flags.DEFINE_string('pretrained_params_names', None,
 flags.DEFINE_float('averaging_decay', 0.9999,
                    'Decay for exponential moving average when computing'
                    'averaged parameters, set to 1 to do vanilla averaging.')
+flags.DEFINE_string('ps_hosts', '',
+                    'Comma separated list of host:port of the parameter '
+                    'servers for distributed training.')
+flags.DEFINE_string('worker_hosts', '',
+                    'Comma separated list of host:port of the workers for '
+                    'distributed training, which is local if empty.')
+flags.DEFINE_string('job_name', 'worker',
+                    'Job of this task in distributed training, either "ps" '
+                    'or "worker".')
+flags.DEFINE_integer('task_index', 0,
+                     'Index of this task within its job. Worker i trains on '
+                     'every i-th sentence of the training corpus and worker '
+                     '0 evaluates and checkpoints.')
+flags.DEFINE_bool('sync_replicas', False,
+                  'Whether the workers aggregate their gradients into '
+                  'synchronous updates rather than updating asynchronously.')
+flags.DEFINE_integer('replicas_to_aggregate', None,
+                     'Number of worker gradients aggregated into each '
+                     'synchronous update, defaults to the number of workers.')
 
 
 def StageName():
@@ -92,6 +154,21 @@ def OutputPath(path):
   return os.path.join(FLAGS.output_path, StageName(), FLAGS.params, path)
 
 
+def WorkerHosts():
+  return FLAGS.worker_hosts.split(',') if FLAGS.worker_hosts else []
+
+
+def IsChief():
+  return FLAGS.task_index == 0
+
+
+def ContextPath():
+  """Returns the rewritten context, which is per worker when distributed."""
+  if WorkerHosts():
+    return OutputPath('context-worker-%d' % FLAGS.task_index)
+  return OutputPath('context')
+
+
 def RewriteContext():
   context = task_spec_pb2.TaskSpec()
   with gfile.FastGFile(FLAGS.task_context) as fin:
@@ -101,19 +178,73 @@ def RewriteContext():
       del resource.part[:]
       part = resource.part.add()
       part.file_pattern = os.path.join(OutputPath(resource.name))
-  with gfile.FastGFile(OutputPath('context'), 'w') as fout:
+
+  # Each worker reads its own shard of the training corpus.
+  num_workers = len(WorkerHosts())
+  if num_workers:
+    for name, value in [('%s_num_shards' % FLAGS.training_corpus, num_workers),
+                        ('%s_shard' % FLAGS.training_corpus,
+                         FLAGS.task_index)]:
+      param = context.parameter.add()
+      param.name = name
+      param.value = str(value)
+  with gfile.FastGFile(ContextPath(), 'w') as fout:
     fout.write(str(context))
 
 
+class StatusWriter(object):
+  """Writes status messages to the status files from a background thread.
+
+  Writes to network file systems can take long, and must not stall training.
+  At most max_queue messages wait to be written, and further ones are dropped.
+  """
+
+  def __init__(self, max_queue=10):
+    self._queue = queue.Queue(max_queue)
+    self._thread = threading.Thread(target=self._Run)
+    self._thread.daemon = True
+    self._thread.start()
+
+  def Write(self, message):
+    try:
+      self._queue.put_nowait(message)
+    except queue.Full:
+      logging.warning('Status writes are falling behind, dropped: %s', message)
+
+  def Close(self):
+    """Waits for the queued messages to be written."""
+    self._queue.join()
+
+  def _Run(self):
+    status = os.path.join(os.getenv('GOOGLE_STATUS_DIR') or '/tmp', 'STATUS')
+    while True:
+      message = self._queue.get()
+      try:
+        with gfile.FastGFile(status, 'w') as fout:
+          fout.write(message)
+        with gfile.FastGFile(OutputPath('status'), 'a') as fout:
+          fout.write(message + '\n')
+      except (IOError, OSError) as e:
+        logging.error('Could not write status: %s', e)
+      finally:
+        self._queue.task_done()
+
+
+# Set up by main().
+_status_writer = None
+
+
 def WriteStatus(num_steps, eval_metric, best_eval_metric):
-  status = os.path.join(os.getenv('GOOGLE_STATUS_DIR') or '/tmp', 'STATUS')
-  message = ('Parameters: %s | Steps: %d | Tuning score: %.2f%% | '
-             'Best tuning score: %.2f%%' % (FLAGS.params, num_steps,
-                                            eval_metric, best_eval_metric))
-  with gfile.FastGFile(status, 'w') as fout:
-    fout.write(message)
-  with gfile.FastGFile(OutputPath('status'), 'a') as fout:
-    fout.write(message + '\n')
+  _status_writer.Write(
+      'Parameters: %s | Steps: %d | Tuning score: %.2f%% | '
+      'Best tuning score: %.2f%%' % (FLAGS.params, num_steps, eval_metric,
+                                     best_eval_metric))
+
+
+def SyncAverages(sess, parser):
+  """Catches up the lazily updated moving averages, see --sparse_averaging."""
+  if parser.sync_averages is not None:
+    sess.run(parser.sync_averages)
 
 
 def Eval(sess, parser, num_steps, best_eval_metric):
@@ -130,6 +261,7 @@ def Eval(sess, parser, num_steps, best_eval_metric):
     new best eval metric
   """
   logging.info('Evaluating training network.')
+  SyncAverages(sess, parser)
   t = time.time()
   num_epochs = None
   num_tokens = 0
@@ -159,21 +291,28 @@ def Eval(sess, parser, num_steps, best_eval_metric):
   return max(eval_metric, best_eval_metric)
 
 
-def Train(sess, num_actions, feature_sizes, domain_sizes, embedding_dims):
-  """Builds and trains the network.
+def BuildParser(num_actions, feature_sizes, domain_sizes, embedding_dims,
+                training):
+  """Builds the network, for training by this worker or only for evaluation.
 
   Args:
-    sess: tensorflow session to use.
     num_actions: number of possible golden actions.
     feature_sizes: size of each feature vector.
     domain_sizes: number of possible feature ids in each feature vector.
     embedding_dims: embedding dimension to use for each feature group.
+    training: whether the network is trained in this graph, rather than
+        restored from the checkpoints of a trainer for evaluation.
+
+  Returns:
+    the graph builder, with evaluation ops if this graph evaluates.
   """
-  t = time.time()
   hidden_layer_sizes = map(int, FLAGS.hidden_layer_sizes.split(','))
-  logging.info('Building training network with parameters: feature_sizes: %s '
-               'domain_sizes: %s', feature_sizes, domain_sizes)
+  logging.info('Building %s network with parameters: feature_sizes: %s '
+               'domain_sizes: %s', 'training' if training else 'evaluation',
+               feature_sizes, domain_sizes)
 
+  task_context = ContextPath()
+  num_tag_actions = graph_builder.NumTagActions(task_context, FLAGS.arg_prefix)
   if FLAGS.graph_builder == 'greedy':
     parser = graph_builder.GreedyParser(num_actions,
                                         feature_sizes,
@@ -183,7 +322,28 @@ def Train(sess, num_actions, feature_sizes, domain_sizes, embedding_dims):
                                         seed=int(FLAGS.seed),
                                         gate_gradients=True,
                                         averaging_decay=FLAGS.averaging_decay,
-                                        arg_prefix=FLAGS.arg_prefix)
+                                        sparse_averaging=(
+                                            FLAGS.sparse_averaging),
+                                        arg_prefix=FLAGS.arg_prefix,
+                                        packed_features=FLAGS.packed_features,
+                                        num_tag_actions=num_tag_actions,
+                                        factored_arc_actions=(
+                                            FLAGS.factored_arc_actions),
+                                        sparse_cost=FLAGS.sparse_cost)
+  elif FLAGS.graph_builder == 'lstm':
+    parser = lstm_graph_builder.LSTMTagger(
+        num_actions,
+        feature_sizes,
+        domain_sizes,
+        embedding_dims,
+        hidden_layer_sizes,
+        seed=int(FLAGS.seed),
+        gate_gradients=True,
+        averaging_decay=FLAGS.averaging_decay,
+        sparse_averaging=FLAGS.sparse_averaging,
+        arg_prefix=FLAGS.arg_prefix,
+        lstm_size=FLAGS.lstm_size,
+        max_length=FLAGS.max_sentence_length)
   else:
     parser = structured_graph_builder.StructuredGraphBuilder(
         num_actions,
@@ -194,40 +354,149 @@ def Train(sess, num_actions, feature_sizes, domain_sizes, embedding_dims):
         seed=int(FLAGS.seed),
         gate_gradients=True,
         averaging_decay=FLAGS.averaging_decay,
+        sparse_averaging=FLAGS.sparse_averaging,
         arg_prefix=FLAGS.arg_prefix,
         beam_size=FLAGS.beam_size,
-        max_steps=FLAGS.max_steps)
+        max_steps=FLAGS.max_steps,
+        num_tag_actions=num_tag_actions,
+        factored_arc_actions=FLAGS.factored_arc_actions)
 
-  task_context = OutputPath('context')
-  if FLAGS.word_embeddings is not None:
+  num_workers = len(WorkerHosts())
+  if training and FLAGS.sync_replicas:
+    parser.UseSyncReplicas(FLAGS.replicas_to_aggregate or num_workers,
+                           num_workers, FLAGS.task_index)
+
+  if training and FLAGS.word_embeddings is not None:
     parser.AddPretrainedEmbeddings(0, FLAGS.word_embeddings, task_context)
 
+  # The training ops of an evaluation graph are never run, but they create
+  # the averaged variables restored from the checkpoints.
   corpus_name = ('projectivized-training-corpus' if
                  FLAGS.projectivize_training_set else FLAGS.training_corpus)
+  kwargs = {}
+  if training and FLAGS.gold_features:
+    files = sorted(gfile.Glob(FLAGS.gold_features))
+    if num_workers:
+      files = files[FLAGS.task_index::num_workers]
+    kwargs['gold_feature_files'] = files
   parser.AddTraining(task_context,
                      FLAGS.batch_size,
                      learning_rate=FLAGS.learning_rate,
                      momentum=FLAGS.momentum,
                      decay_steps=FLAGS.decay_steps,
-                     corpus_name=corpus_name)
-  parser.AddEvaluation(task_context,
-                       FLAGS.batch_size,
-                       corpus_name=FLAGS.tuning_corpus)
+                     corpus_name=corpus_name,
+                     **kwargs)
+  if not training or (IsChief() and not FLAGS.async_eval):
+    parser.AddEvaluation(task_context,
+                         FLAGS.batch_size,
+                         corpus_name=FLAGS.tuning_corpus)
   parser.AddSaver(FLAGS.slim_model)
+  return parser
+
+
+# Name of the state file listing the checkpoints for asynchronous evaluation.
+CHECKPOINT_STATE = 'checkpoint-state'
+
+
+def TrainingDonePath():
+  return OutputPath('training-done')
+
+
+def WriteCheckpoint(sess, parser, num_steps):
+  """Saves a checkpoint of the given step for asynchronous evaluation."""
+  logging.info('Writing checkpoint of step %d.', num_steps)
+  SyncAverages(sess, parser)
+  parser.saver.save(sess, OutputPath('checkpoint-model'),
+                    global_step=num_steps,
+                    latest_filename=CHECKPOINT_STATE)
+
+
+def EvaluateCheckpoints(num_actions, feature_sizes, domain_sizes,
+                        embedding_dims, training_done):
+  """Evaluates the latest checkpoints of a trainer until it is done.
+
+  The network is built in a graph of its own, so that this can run on a
+  thread of the trainer. Checkpoints written while one is evaluated are
+  skipped but the latest, so the evaluation never falls behind training by
+  more than one checkpoint.
+
+  Args:
+    num_actions: number of possible golden actions.
+    feature_sizes: size of each feature vector.
+    domain_sizes: number of possible feature ids in each feature vector.
+    embedding_dims: embedding dimension to use for each feature group.
+    training_done: function returning whether the trainer has written its
+        last checkpoint.
+  """
+  with tf.Graph().as_default():
+    parser = BuildParser(num_actions, feature_sizes, domain_sizes,
+                         embedding_dims, training=False)
+    sess = tf.Session()
+    sess.run(parser.inits.values())
+    best_eval_metric = 0.0
+    evaluated = None
+    while True:
+      # Checked first, so that the last checkpoint is seen before stopping.
+      done = training_done()
+      state = tf.train.get_checkpoint_state(OutputPath(''),
+                                            latest_filename=CHECKPOINT_STATE)
+      if state is not None and state.model_checkpoint_path != evaluated:
+        evaluated = state.model_checkpoint_path
+        num_steps = int(evaluated.rsplit('-', 1)[1])
+        parser.saver.restore(sess, evaluated)
+        best_eval_metric = Eval(sess, parser, num_steps, best_eval_metric)
+      elif done:
+        break
+      else:
+        time.sleep(FLAGS.eval_poll_secs)
+    sess.close()
+
+
+def Train(server, num_actions, feature_sizes, domain_sizes, embedding_dims):
+  """Builds and trains the network.
+
+  Args:
+    server: tf.train.Server of this worker, or None to train locally.
+    num_actions: number of possible golden actions.
+    feature_sizes: size of each feature vector.
+    domain_sizes: number of possible feature ids in each feature vector.
+    embedding_dims: embedding dimension to use for each feature group.
+  """
+  t = time.time()
+  parser = BuildParser(num_actions, feature_sizes, domain_sizes,
+                       embedding_dims, training=True)
 
   # Save graph.
-  if FLAGS.output_path:
+  if FLAGS.output_path and IsChief():
     with gfile.FastGFile(OutputPath('graph'), 'w') as f:
-      f.write(sess.graph_def.SerializeToString())
+      f.write(tf.get_default_graph().as_graph_def().SerializeToString())
 
   logging.info('Initializing...')
+  if server is None:
+    sess = tf.Session(FLAGS.tf_master)
+    sess.run(parser.inits.values())
+  else:
+    # The chief initializes the variables on the parameter servers, which the
+    # other workers wait for.
+    if parser.sync_optimizer is not None and IsChief():
+      chief_queue_runner = parser.sync_optimizer.get_chief_queue_runner()
+      init_tokens_op = parser.sync_optimizer.get_init_tokens_op()
+    supervisor = tf.train.Supervisor(
+        is_chief=IsChief(),
+        init_op=tf.group(*parser.inits.values()),
+        summary_op=None,
+        saver=None,
+        global_step=None)
+    sess = supervisor.prepare_or_wait_for_session(server.target)
+    if parser.sync_optimizer is not None and IsChief():
+      supervisor.start_queue_runners(sess, [chief_queue_runner])
+      sess.run(init_tokens_op)
   num_epochs = 0
   cost_sum = 0.0
   num_steps = 0
   best_eval_metric = 0.0
-  sess.run(parser.inits.values())
 
-  if FLAGS.pretrained_params is not None:
+  if FLAGS.pretrained_params is not None and IsChief():
     logging.info('Loading pretrained params from %s', FLAGS.pretrained_params)
     feed_dict = {'save/Const:0': FLAGS.pretrained_params}
     targets = []
@@ -238,6 +507,19 @@ def Train(sess, num_actions, feature_sizes, domain_sizes, embedding_dims):
         targets.append(node.name)
     sess.run(targets, feed_dict=feed_dict)
 
+  evaluator = None
+  if FLAGS.async_eval and IsChief():
+    if gfile.Exists(TrainingDonePath()):
+      gfile.Remove(TrainingDonePath())
+    if FLAGS.async_eval == 'thread':
+      training_done = threading.Event()
+      evaluator = threading.Thread(
+          target=EvaluateCheckpoints,
+          args=(num_actions, feature_sizes, domain_sizes, embedding_dims,
+                training_done.is_set))
+      evaluator.daemon = True
+      evaluator.start()
+
   logging.info('Training...')
   while num_epochs < FLAGS.num_epochs:
     tf_epochs, tf_cost, _ = sess.run([parser.training[
@@ -250,53 +532,138 @@ def Train(sess, num_actions, feature_sizes, domain_sizes, embedding_dims):
                    'seconds elapsed: %.2f, avg cost: %.2f, ', num_epochs,
                    num_steps, time.time() - t, cost_sum / FLAGS.report_every)
       cost_sum = 0.0
-    if num_steps % FLAGS.checkpoint_every == 0:
-      best_eval_metric = Eval(sess, parser, num_steps, best_eval_metric)
+    if num_steps % FLAGS.checkpoint_every == 0 and IsChief():
+      if FLAGS.async_eval:
+        WriteCheckpoint(sess, parser, num_steps)
+      else:
+        best_eval_metric = Eval(sess, parser, num_steps, best_eval_metric)
+
+  # The last steps are checkpointed too, and evaluated before returning.
+  if FLAGS.async_eval and IsChief():
+    if num_steps % FLAGS.checkpoint_every != 0:
+      WriteCheckpoint(sess, parser, num_steps)
+    if evaluator is not None:
+      training_done.set()
+      evaluator.join()
+    else:
+      with gfile.FastGFile(TrainingDonePath(), 'w') as fout:
+        fout.write(str(num_steps))
+
+
+# Name of the MetaGraph written by --export_meta_graph.
+TRAINER_META_GRAPH = 'trainer-graph.meta'
+
+
+def ExportMetaGraph(num_actions, feature_sizes, domain_sizes, embedding_dims):
+  """Writes the training graph as a MetaGraph for parser_trainer_main.
+
+  The MetaGraph holds the saver and collections naming the nodes the C++
+  trainer runs, so that it trains, evaluates and checkpoints as Train() does.
+
+  Args:
+    num_actions: number of possible golden actions.
+    feature_sizes: size of each feature vector.
+    domain_sizes: number of possible feature ids in each feature vector.
+    embedding_dims: embedding dimension to use for each feature group.
+  """
+  parser = BuildParser(num_actions, feature_sizes, domain_sizes,
+                       embedding_dims, training=True)
+  nodes = [('init_op', tf.group(*parser.inits.values(), name='init_op')),
+           ('train_op', parser.training['train_op']),
+           ('training_epochs', parser.training['epochs']),
+           ('training_cost', parser.training['cost']),
+           ('sync_averages', parser.sync_averages or tf.no_op()),
+           ('evaluation_epochs', parser.evaluation['epochs']),
+           ('eval_metrics', parser.evaluation['eval_metrics'])]
+  for name, node in nodes:
+    tf.add_to_collection('syntaxnet_' + name, node)
+  parser.saver.export_meta_graph(OutputPath(TRAINER_META_GRAPH))
+  logging.info('Wrote training graph to %s', OutputPath(TRAINER_META_GRAPH))
 
 
 def main(unused_argv):
   logging.set_verbosity(logging.INFO)
+  server = None
+  if FLAGS.export_meta_graph and (WorkerHosts() or FLAGS.async_eval):
+    raise ValueError('--export_meta_graph only supports local training with '
+                     'synchronous evaluation')
+  if WorkerHosts() and not FLAGS.evaluate_checkpoints:
+    # The lexicon and projectivized corpus would be written by every worker,
+    # so they have to be prepared by a local run beforehand.
+    if FLAGS.compute_lexicon or FLAGS.projectivize_training_set:
+      raise ValueError('--compute_lexicon and --projectivize_training_set '
+                       'are not supported in distributed training')
+    cluster = tf.train.ClusterSpec({'ps': FLAGS.ps_hosts.split(','),
+                                    'worker': WorkerHosts()})
+    server = tf.train.Server(cluster, job_name=FLAGS.job_name,
+                             task_index=FLAGS.task_index)
+    if FLAGS.job_name == 'ps':
+      server.join()
+      return
+
   if not gfile.IsDirectory(OutputPath('')):
     gfile.MakeDirs(OutputPath(''))
 
   # Rewrite context.
   RewriteContext()
 
-  # Creates necessary term maps.
-  if FLAGS.compute_lexicon:
+  # Creates necessary term maps, unless only the checkpoints of a trainer
+  # which does so are evaluated.
+  if FLAGS.compute_lexicon and not FLAGS.evaluate_checkpoints:
     logging.info('Computing lexicon...')
     with tf.Session(FLAGS.tf_master) as sess:
-      gen_parser_ops.lexicon_builder(task_context=OutputPath('context'),
+      gen_parser_ops.lexicon_builder(task_context=ContextPath(),
                                      corpus_name=FLAGS.training_corpus).run()
   with tf.Session(FLAGS.tf_master) as sess:
     feature_sizes, domain_sizes, embedding_dims, num_actions = sess.run(
-        gen_parser_ops.feature_size(task_context=OutputPath('context'),
+        gen_parser_ops.feature_size(task_context=ContextPath(),
                                     arg_prefix=FLAGS.arg_prefix))
 
   # Well formed and projectivize.
-  if FLAGS.projectivize_training_set:
+  if FLAGS.projectivize_training_set and not FLAGS.evaluate_checkpoints:
     logging.info('Preprocessing...')
     with tf.Session(FLAGS.tf_master) as sess:
       source, last = gen_parser_ops.document_source(
-          task_context=OutputPath('context'),
+          task_context=ContextPath(),
           batch_size=FLAGS.batch_size,
-          corpus_name=FLAGS.training_corpus)
+          corpus_name=FLAGS.training_corpus,
+          batch_handle=True)
       sink = gen_parser_ops.document_sink(
-          task_context=OutputPath('context'),
+          task_context=ContextPath(),
           corpus_name='projectivized-training-corpus',
-          documents=gen_parser_ops.projectivize_filter(
-              gen_parser_ops.well_formed_filter(source,
-                                                task_context=OutputPath(
-                                                    'context')),
-              task_context=OutputPath('context')))
+          documents=gen_parser_ops.well_formed_projectivize_filter(
+              source, task_context=ContextPath(), batch_handle=True),
+          batch_handle=True)
       while True:
         tf_last, _ = sess.run([last, sink])
         if tf_last:
           break
 
+  global _status_writer
+  _status_writer = StatusWriter()
+
+  if FLAGS.evaluate_checkpoints:
+    logging.info('Evaluating checkpoints...')
+    EvaluateCheckpoints(num_actions, feature_sizes, domain_sizes,
+                        embedding_dims,
+                        lambda: gfile.Exists(TrainingDonePath()))
+    _status_writer.Close()
+    return
+
+  if FLAGS.export_meta_graph:
+    ExportMetaGraph(num_actions, feature_sizes, domain_sizes, embedding_dims)
+    _status_writer.Close()
+    return
+
   logging.info('Training...')
-  with tf.Session(FLAGS.tf_master) as sess:
-    Train(sess, num_actions, feature_sizes, domain_sizes, embedding_dims)
+  if server is None:
+    Train(None, num_actions, feature_sizes, domain_sizes, embedding_dims)
+  else:
+    with tf.device(tf.train.replica_device_setter(
+        worker_device='/job:worker/task:%d' % FLAGS.task_index,
+        cluster=cluster)):
+      Train(server, num_actions, feature_sizes, domain_sizes, embedding_dims)
+  _status_writer.Close()
 
 
 if __name__ == '__main__':
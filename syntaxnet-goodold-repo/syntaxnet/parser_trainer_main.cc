@@ -0,0 +1,248 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Trains a parser from the training graph written by parser_trainer.py
+// --export_meta_graph, running the training steps, the evaluations on the
+// tuning corpus and the checkpoints from C++, so that no Python runs between
+// the steps. As parser_trainer.py does, it evaluates and writes latest-model
+// every checkpoint_every steps and after the last one, and keeps the best
+// evaluated model as model, next to the meta graph.
+//
+// Usage: parser_trainer_main --meta_graph=<file> [--num_epochs=10]
+//            [--report_every=100] [--checkpoint_every=5000]
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/protobuf/meta_graph.pb.h"
+#include "tensorflow/core/protobuf/saver.pb.h"
+#include "tensorflow/core/public/session.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+using tensorflow::Status;
+using tensorflow::Tensor;
+
+namespace {
+
+// Collections holding the nodes that parser_trainer.py exports along with the
+// training graph, one node each.
+const char kInitOp[] = "syntaxnet_init_op";
+const char kTrainOp[] = "syntaxnet_train_op";
+const char kTrainingEpochs[] = "syntaxnet_training_epochs";
+const char kTrainingCost[] = "syntaxnet_training_cost";
+const char kSyncAverages[] = "syntaxnet_sync_averages";
+const char kEvaluationEpochs[] = "syntaxnet_evaluation_epochs";
+const char kEvalMetrics[] = "syntaxnet_eval_metrics";
+
+// Sets *name to the name of the node in the collection with the given key.
+Status GetCollectionNode(const tensorflow::MetaGraphDef &meta_graph,
+                         const string &key, string *name) {
+  const auto it = meta_graph.collection_def().find(key);
+  if (it == meta_graph.collection_def().end() ||
+      it->second.node_list().value_size() != 1) {
+    return tensorflow::errors::InvalidArgument(
+        "Meta graph has no node in collection ", key);
+  }
+  *name = it->second.node_list().value(0);
+  return Status::OK();
+}
+
+class Trainer {
+ public:
+  // Creates a session on the meta graph at meta_graph_path and initializes
+  // the variables. The models are saved in the directory of the meta graph.
+  Status Init(const string &meta_graph_path) {
+    tensorflow::MetaGraphDef meta_graph;
+    TF_RETURN_IF_ERROR(tensorflow::ReadBinaryProto(
+        tensorflow::Env::Default(), meta_graph_path, &meta_graph));
+    TF_RETURN_IF_ERROR(GetCollectionNode(meta_graph, kInitOp, &init_op_));
+    TF_RETURN_IF_ERROR(GetCollectionNode(meta_graph, kTrainOp, &train_op_));
+    TF_RETURN_IF_ERROR(
+        GetCollectionNode(meta_graph, kTrainingEpochs, &training_epochs_));
+    TF_RETURN_IF_ERROR(
+        GetCollectionNode(meta_graph, kTrainingCost, &training_cost_));
+    TF_RETURN_IF_ERROR(
+        GetCollectionNode(meta_graph, kSyncAverages, &sync_averages_));
+    TF_RETURN_IF_ERROR(
+        GetCollectionNode(meta_graph, kEvaluationEpochs, &evaluation_epochs_));
+    TF_RETURN_IF_ERROR(
+        GetCollectionNode(meta_graph, kEvalMetrics, &eval_metrics_));
+    if (!meta_graph.has_saver_def()) {
+      return tensorflow::errors::InvalidArgument("Meta graph has no saver");
+    }
+    saver_def_ = meta_graph.saver_def();
+    model_dir_ = tensorflow::io::Dirname(meta_graph_path).ToString();
+
+    session_.reset(tensorflow::NewSession(tensorflow::SessionOptions()));
+    TF_RETURN_IF_ERROR(session_->Create(meta_graph.graph_def()));
+    return session_->Run({}, {}, {init_op_}, nullptr);
+  }
+
+  ~Trainer() {
+    if (session_ != nullptr) session_->Close();
+  }
+
+  // Trains until the training reader has read num_epochs epochs.
+  Status Train(int num_epochs, int report_every, int checkpoint_every) {
+    const tensorflow::uint64 start_micros =
+        tensorflow::Env::Default()->NowMicros();
+    int64 num_steps = 0;
+    double cost_sum = 0.0;
+    double best_eval_metric = 0.0;
+    int epochs = 0;
+    std::vector<Tensor> outputs;
+    LOG(INFO) << "Training...";
+    while (epochs < num_epochs) {
+      TF_RETURN_IF_ERROR(session_->Run({}, {training_epochs_, training_cost_},
+                                       {train_op_}, &outputs));
+      epochs = outputs[0].scalar<int32>()();
+      cost_sum += outputs[1].scalar<float>()();
+      ++num_steps;
+      if (num_steps % report_every == 0) {
+        LOG(INFO) << tensorflow::strings::Printf(
+            "Epochs: %d, num steps: %lld, seconds elapsed: %.2f, "
+            "avg cost: %.2f",
+            epochs, num_steps,
+            (tensorflow::Env::Default()->NowMicros() - start_micros) / 1e6,
+            cost_sum / report_every);
+        cost_sum = 0.0;
+      }
+      if (num_steps % checkpoint_every == 0) {
+        TF_RETURN_IF_ERROR(Checkpoint(num_steps, &best_eval_metric));
+      }
+    }
+
+    // The last steps are evaluated and saved too.
+    if (num_steps % checkpoint_every != 0) {
+      TF_RETURN_IF_ERROR(Checkpoint(num_steps, &best_eval_metric));
+    }
+    return Status::OK();
+  }
+
+ private:
+  // Evaluates the network for one epoch of the tuning corpus, saves it as
+  // latest-model, and as model if it is the best so far. The lazily updated
+  // moving averages are caught up first.
+  Status Checkpoint(int64 num_steps, double *best_eval_metric) {
+    LOG(INFO) << "Evaluating training network.";
+    TF_RETURN_IF_ERROR(session_->Run({}, {}, {sync_averages_}, nullptr));
+    const tensorflow::uint64 start_micros =
+        tensorflow::Env::Default()->NowMicros();
+    int first_epochs = -1;
+    int64 num_tokens = 0;
+    int64 num_correct = 0;
+    std::vector<Tensor> outputs;
+    while (true) {
+      TF_RETURN_IF_ERROR(session_->Run({}, {evaluation_epochs_, eval_metrics_},
+                                       {}, &outputs));
+      const int epochs = outputs[0].scalar<int32>()();
+      const auto metrics = outputs[1].vec<int32>();
+      num_tokens += metrics(0);
+      num_correct += metrics(1);
+      if (first_epochs < 0) {
+        first_epochs = epochs;
+      } else if (first_epochs < epochs) {
+        break;
+      }
+    }
+    const double eval_metric =
+        num_tokens == 0 ? 0.0 : 100.0 * num_correct / num_tokens;
+    LOG(INFO) << tensorflow::strings::Printf(
+        "Seconds elapsed in evaluation: %.2f, eval metric: %.2f%%",
+        (tensorflow::Env::Default()->NowMicros() - start_micros) / 1e6,
+        eval_metric);
+
+    LOG(INFO) << "Writing out trained parameters.";
+    TF_RETURN_IF_ERROR(Save("latest-model"));
+    if (eval_metric > *best_eval_metric) {
+      TF_RETURN_IF_ERROR(Save("model"));
+      *best_eval_metric = eval_metric;
+    }
+    return WriteStatus(tensorflow::strings::Printf(
+        "Steps: %lld | Tuning score: %.2f%% | Best tuning score: %.2f%%\n",
+        num_steps, eval_metric, *best_eval_metric));
+  }
+
+  // Saves the variables to the file with the given name in model_dir_.
+  Status Save(const string &name) {
+    Tensor filename(tensorflow::DT_STRING, tensorflow::TensorShape({}));
+    filename.scalar<string>()() = tensorflow::io::JoinPath(model_dir_, name);
+    std::vector<Tensor> outputs;
+    return session_->Run({{saver_def_.filename_tensor_name(), filename}},
+                         {saver_def_.save_tensor_name()}, {}, &outputs);
+  }
+
+  // Appends a line to the status file in model_dir_.
+  Status WriteStatus(const string &line) {
+    std::unique_ptr<tensorflow::WritableFile> file;
+    TF_RETURN_IF_ERROR(tensorflow::Env::Default()->NewAppendableFile(
+        tensorflow::io::JoinPath(model_dir_, "status"), &file));
+    TF_RETURN_IF_ERROR(file->Append(line));
+    return file->Close();
+  }
+
+  std::unique_ptr<tensorflow::Session> session_;
+
+  // Names of the exported nodes.
+  string init_op_;
+  string train_op_;
+  string training_epochs_;
+  string training_cost_;
+  string sync_averages_;
+  string evaluation_epochs_;
+  string eval_metrics_;
+
+  // Saver of the variables, and the directory the models are saved in.
+  tensorflow::SaverDef saver_def_;
+  string model_dir_;
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  string meta_graph;
+  tensorflow::int32 num_epochs = 10;
+  tensorflow::int32 report_every = 100;
+  tensorflow::int32 checkpoint_every = 5000;
+  const bool parsed_flags_ok = tensorflow::ParseFlags(
+      &argc, argv, {tensorflow::Flag("meta_graph", &meta_graph),
+                    tensorflow::Flag("num_epochs", &num_epochs),
+                    tensorflow::Flag("report_every", &report_every),
+                    tensorflow::Flag("checkpoint_every", &checkpoint_every)});
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parsed_flags_ok || meta_graph.empty() || report_every < 1 ||
+      checkpoint_every < 1) {
+    LOG(ERROR) << "Usage: " << argv[0] << " --meta_graph=<file> "
+               << "[--num_epochs=10] [--report_every=100] "
+               << "[--checkpoint_every=5000]";
+    return 1;
+  }
+
+  Trainer trainer;
+  TF_CHECK_OK(trainer.Init(meta_graph));
+  TF_CHECK_OK(trainer.Train(num_epochs, report_every, checkpoint_every));
+  return 0;
+}
@@ -113,4 +113,58 @@ embedding_matrix_0,embedding_matrix_1,embedding_matrix_2,bias_0,weights_0 \
   --logtostderr \
   > $TMP_DIR/struct-beam8-out
 
+# Evaluates the checkpoints on a thread of the trainer, which keeps the best.
+ASYNC_PARAMS=128-0.08-3600-0.9-async
+
+"$BINDIR/parser_trainer" \
+  --arg_prefix=brain_parser \
+  --batch_size=32 \
+  --decay_steps=3600 \
+  --graph_builder=greedy \
+  --hidden_layer_sizes=128 \
+  --learning_rate=0.08 \
+  --momentum=0.9 \
+  --output_path=$TMP_DIR \
+  --task_context=$TMP_DIR/context \
+  --training_corpus=training-corpus \
+  --tuning_corpus=tuning-corpus \
+  --params=$ASYNC_PARAMS \
+  --num_epochs=2 \
+  --report_every=100 \
+  --checkpoint_every=100 \
+  --async_eval=thread \
+  --eval_poll_secs=1 \
+  --logtostderr
+
+test -f $TMP_DIR/brain_parser/greedy/$ASYNC_PARAMS/model
+test -f $TMP_DIR/brain_parser/greedy/$ASYNC_PARAMS/status
+
+# Trains from the exported training graph with the C++ trainer.
+CC_PARAMS=128-0.08-3600-0.9-cc
+
+"$BINDIR/parser_trainer" \
+  --arg_prefix=brain_parser \
+  --batch_size=32 \
+  --decay_steps=3600 \
+  --graph_builder=greedy \
+  --hidden_layer_sizes=128 \
+  --learning_rate=0.08 \
+  --momentum=0.9 \
+  --output_path=$TMP_DIR \
+  --task_context=$TMP_DIR/context \
+  --training_corpus=training-corpus \
+  --tuning_corpus=tuning-corpus \
+  --params=$CC_PARAMS \
+  --export_meta_graph \
+  --logtostderr
+
+"$BINDIR/parser_trainer_main" \
+  --meta_graph=$TMP_DIR/brain_parser/greedy/$CC_PARAMS/trainer-graph.meta \
+  --num_epochs=2 \
+  --report_every=100 \
+  --checkpoint_every=100
+
+test -f $TMP_DIR/brain_parser/greedy/$CC_PARAMS/model
+test -f $TMP_DIR/brain_parser/greedy/$CC_PARAMS/status
+
 echo "PASS"
@@ -15,6 +15,8 @@ limitations under the License.
 
 #include "syntaxnet/parser_transitions.h"
 
+#include <cmath>
+
 #include "syntaxnet/parser_state.h"
 
 namespace syntaxnet {
@@ -27,4 +29,42 @@ void ParserTransitionSystem::PerformAction(ParserAction action,
   PerformActionWithoutHistory(action, state);
 }
 
+void ParserTransitionSystem::PerformActions(const ParserAction *actions,
+                                            ParserState *const *states,
+                                            int num_states,
+                                            uint8 *is_final) const {
+  for (int i = 0; i < num_states; ++i) {
+    PerformAction(actions[i], states[i]);
+    is_final[i] = IsFinalState(*states[i]);
+  }
+}
+
+void ParserTransitionSystem::GetAllowedActions(
+    const ParserState &state, std::vector<uint8> *allowed) const {
+  for (size_t action = 0; action < allowed->size(); ++action) {
+    (*allowed)[action] = IsAllowedAction(action, state);
+  }
+}
+
+ParserAction ParserTransitionSystem::BestAllowedAction(
+    const ParserState &state, const float *scores, int num_actions,
+    std::vector<uint8> *allowed) const {
+  allowed->resize(num_actions);
+  GetAllowedActions(state, allowed);
+
+  // Masks out disallowed actions with a select instead of a branch, so the
+  // scan over the row is a plain compare-and-keep loop.
+  const uint8 *mask = allowed->data();
+  ParserAction best_action = 0;
+  float best_score = -INFINITY;
+  for (int action = 0; action < num_actions; ++action) {
+    const float score = mask[action] ? scores[action] : -INFINITY;
+    if (score > best_score) {
+      best_action = action;
+      best_score = score;
+    }
+  }
+  return best_action;
+}
+
 }  // namespace syntaxnet
@@ -133,6 +133,20 @@ class ParserTransitionSystem
   virtual bool IsAllowedAction(ParserAction action,
                                const ParserState &state) const = 0;
 
+  // Sets (*allowed)[action] to 1 if the action is allowed in the given parser
+  // state and to 0 otherwise, for every action below allowed->size(). The
+  // default implementation calls IsAllowedAction() for every action; transition
+  // systems whose constraints only depend on the action type should override it.
+  virtual void GetAllowedActions(const ParserState &state,
+                                 std::vector<uint8> *allowed) const;
+
+  // Returns the allowed action with the highest of the num_actions scores, or
+  // action 0 if no action has an allowed score above -infinity. Ties go to the
+  // lowest action. The allowed buffer is scratch space for GetAllowedActions().
+  ParserAction BestAllowedAction(const ParserState &state, const float *scores,
+                                 int num_actions,
+                                 std::vector<uint8> *allowed) const;
+
   // Performs the specified action on a given parser state. The action is not
   // saved in the state's history.
   virtual void PerformActionWithoutHistory(ParserAction action,
@@ -142,6 +156,15 @@ class ParserTransitionSystem
   // in the state's history.
   void PerformAction(ParserAction action, ParserState *state) const;
 
+  // Performs actions[i] on *states[i] for each of the num_states states, as
+  // PerformAction() does, and sets is_final[i] to whether the state is final
+  // afterwards. The default implementation makes two virtual calls per state;
+  // transition systems on the decoding hot path override it with one loop over
+  // the batch.
+  virtual void PerformActions(const ParserAction *actions,
+                              ParserState *const *states, int num_states,
+                              uint8 *is_final) const;
+
   // Returns true if a given state is deterministic.
   virtual bool IsDeterministicState(const ParserState &state) const = 0;
 
@@ -0,0 +1,209 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/parsing_session.h"
+
+#include <unordered_map>
+
+#include "syntaxnet/model_bundle.h"
+#include "syntaxnet/task_spec.pb.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/protobuf/saver.pb.h"
+
+namespace syntaxnet {
+
+using tensorflow::Status;
+using tensorflow::Tensor;
+using tensorflow::io::JoinPath;
+
+Status ParsingSession::Create(const string &export_path,
+                              std::unique_ptr<ParsingSession> *session) {
+  return Create(export_path, nullptr, session);
+}
+
+Status ParsingSession::Create(
+    const string &export_path,
+    const tensorflow::SessionOptions *session_options,
+    std::unique_ptr<ParsingSession> *session) {
+  std::unique_ptr<ParsingSession> result(new ParsingSession());
+  tensorflow::Env *env = tensorflow::Env::Default();
+
+  // Reads the task context, which names the queues and the step nodes.
+  const bool is_bundle = !env->IsDirectory(export_path).ok();
+  TaskContext &context = result->task_context_;
+  TF_RETURN_IF_ERROR(ReadTaskContext(export_path, &context));
+  for (const string &name : {"serving_input", "serving_output"}) {
+    const TaskInput *input = context.GetInput(context.Get(name, ""));
+    if (!DocumentQueue::IsQueueInput(*input)) {
+      return tensorflow::errors::InvalidArgument(
+          "The ", name, " of the task context of ", export_path,
+          " is not a document queue");
+    }
+  }
+  result->input_ = DocumentQueue::ForInput(
+      *context.GetInput(context.Get("serving_input", "")));
+  result->output_ = DocumentQueue::ForInput(
+      *context.GetInput(context.Get("serving_output", "")));
+  result->step_targets_ =
+      utils::Split(context.Get("serving_steps", "parser_step"), ',');
+  result->max_steps_per_sentence_ =
+      context.Get("serving_max_steps_per_sentence", 1000);
+
+  // Creates the session. The graph of a bundle maps its parameters, otherwise
+  // they are restored from the checkpoint.
+  tensorflow::GraphDef &graph_def = result->graph_def_;
+  tensorflow::SessionOptions context_options;
+  if (session_options == nullptr) {
+    SetServingOptions(context, &context_options);
+    session_options = &context_options;
+  }
+  result->session_.reset(tensorflow::NewSession(*session_options));
+  if (is_bundle) {
+    TF_RETURN_IF_ERROR(ReadModelBundleGraph(export_path, &graph_def));
+    TF_RETURN_IF_ERROR(result->session_->Create(graph_def));
+  } else {
+    TF_RETURN_IF_ERROR(ReadBinaryProto(
+        env, JoinPath(export_path, "graph.pb"), &graph_def));
+    tensorflow::SaverDef saver_def;
+    TF_RETURN_IF_ERROR(ReadBinaryProto(
+        env, JoinPath(export_path, "saver.pb"), &saver_def));
+    TF_RETURN_IF_ERROR(result->session_->Create(graph_def));
+    Tensor checkpoint(tensorflow::DT_STRING, tensorflow::TensorShape({}));
+    checkpoint.scalar<string>()() = JoinPath(export_path, "model");
+    std::vector<Tensor> outputs;
+    TF_RETURN_IF_ERROR(result->session_->Run(
+        {{saver_def.filename_tensor_name(), checkpoint}}, {},
+        {saver_def.restore_op_name()}, &outputs));
+  }
+
+  // Prepares the steps once, since they are run many times per call.
+  TF_RETURN_IF_ERROR(result->session_->MakeCallable(
+      {}, {}, result->step_targets_, &result->step_handle_));
+
+  // Drops anything a previous session on the same queues left behind.
+  result->ClearQueues();
+  *session = std::move(result);
+  return Status::OK();
+}
+
+Status ParsingSession::ReadTaskContext(const string &export_path,
+                                       TaskContext *context) {
+  tensorflow::Env *env = tensorflow::Env::Default();
+  const string context_path =
+      env->IsDirectory(export_path).ok()
+          ? JoinPath(export_path, "context.pbtxt")
+          : ModelBundleElementPath(export_path, kModelBundleContext);
+  string data;
+  TF_RETURN_IF_ERROR(ReadFileToString(env, context_path, &data));
+  if (!TextFormat::ParseFromString(data, context->mutable_spec())) {
+    return tensorflow::errors::InvalidArgument(
+        "Could not parse task context at ", context_path);
+  }
+  return Status::OK();
+}
+
+void ParsingSession::SetServingOptions(const TaskContext &context,
+                                       tensorflow::SessionOptions *options) {
+  tensorflow::ConfigProto &config = options->config;
+  config.set_use_cpu_memory_pool(context.Get("serving_cpu_memory_pool", false));
+  config.set_cpu_affinity(context.Get("serving_cpu_affinity", ""));
+  config.set_use_work_stealing_thread_pools(
+      context.Get("serving_work_stealing_thread_pools", false));
+  config.set_intra_op_parallelism_threads(
+      context.Get("serving_intra_op_threads", 0));
+  config.set_inter_op_parallelism_threads(
+      context.Get("serving_inter_op_threads", 0));
+}
+
+ParsingSession::~ParsingSession() {
+  if (session_ != nullptr) session_->Close();
+}
+
+Status ParsingSession::Parse(const std::vector<Sentence> &sentences,
+                             std::vector<Sentence> *parses) {
+  return Parse(sentences, parses, nullptr);
+}
+
+Status ParsingSession::Parse(const std::vector<Sentence> &sentences,
+                             std::vector<Sentence> *parses,
+                             tensorflow::StatSummarizer *stats) {
+  mutex_lock lock(mu_);
+  parses->clear();
+  parses->resize(sentences.size());
+
+  // Gives every sentence a document id that is unique across calls, since the
+  // readers use them to track sentences, and remembers where it goes.
+  const string prefix = tensorflow::strings::StrCat(num_calls_++, ":");
+  std::unordered_map<string, int> positions;
+  for (size_t i = 0; i < sentences.size(); ++i) {
+    Sentence *sentence = new Sentence(sentences[i]);
+    sentence->set_docid(tensorflow::strings::StrCat(prefix, i));
+    positions[sentence->docid()] = i;
+    input_->Push(sentence);
+  }
+
+  // Runs steps until all sentences have come out of the pipeline.
+  int remaining = sentences.size();
+  const int64 max_steps =
+      static_cast<int64>(max_steps_per_sentence_) * (remaining + 1);
+  std::vector<Tensor> outputs;
+  tensorflow::RunOptions trace_options;
+  trace_options.set_trace_level(tensorflow::RunOptions::FULL_TRACE);
+  for (int64 step = 0; remaining > 0; ++step) {
+    if (step == max_steps) {
+      ClearQueues();
+      return tensorflow::errors::Internal(
+          "Sentences did not complete after ", max_steps, " steps");
+    }
+    Status status;
+    if (stats == nullptr) {
+      status = session_->RunCallable(step_handle_, {}, &outputs);
+    } else {
+      tensorflow::RunMetadata metadata;
+      status = session_->Run(trace_options, {}, {}, step_targets_, &outputs,
+                             &metadata);
+      if (status.ok()) stats->ProcessStepStats(metadata.step_stats());
+    }
+    if (!status.ok()) {
+      ClearQueues();
+      return status;
+    }
+    for (Sentence *popped = output_->Pop(); popped != nullptr;
+         popped = output_->Pop()) {
+      std::unique_ptr<Sentence> document(popped);
+      auto it = positions.find(document->docid());
+      if (it == positions.end()) continue;  // left by an earlier failed call
+      const int position = it->second;
+      document->set_docid(sentences[position].docid());
+      (*parses)[position].Swap(document.get());
+      positions.erase(it);
+      --remaining;
+    }
+  }
+  return Status::OK();
+}
+
+void ParsingSession::ClearQueues() {
+  for (DocumentQueue *queue : {input_, output_}) {
+    while (Sentence *document = queue->Pop()) delete document;
+  }
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,144 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// C++ entry point for running an exported tagger and parser pipeline.
+
+#ifndef SYNTAXNET_PARSING_SESSION_H_
+#define SYNTAXNET_PARSING_SESSION_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/document_queue.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/public/session.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/util/stat_summarizer.h"
+
+namespace syntaxnet {
+
+// Runs the evaluation graph written by parser_eval.py --export_path in a
+// TensorFlow session, without a Python driver. The export directory holds
+//   - graph.pb: the GraphDef of the tagger and/or parser,
+//   - saver.pb: the SaverDef used to restore the model parameters,
+//   - model: the checkpoint with the model parameters,
+//   - context.pbtxt: the task context referenced by the reader ops,
+//   - frozen_graph.pb: the graph with the parameters as constants, from which
+//     model_bundle_main writes a model bundle (see model_bundle.h).
+// A session can also be created from such a bundle, which maps the parameters
+// and lexicons instead of restoring a checkpoint.
+// The task context names the sentence-queue inputs that sentences are fed
+// through (serving_input and serving_output parameters) and the comma
+// separated graph nodes to run for each step (serving_steps). With
+// serving_cpu_memory_pool, the session allocates CPU tensors from a pool
+// instead of with malloc. With serving_cpu_affinity, the session runs on
+// threads of its own pinned to the given CPUs, like "0-7,16-23", and with
+// serving_work_stealing_thread_pools its thread pools steal work. The
+// serving_intra_op_threads and serving_inter_op_threads parameters set the
+// sizes of its thread pools, see tune_parser_main.cc for choosing them.
+//
+// Parse() is thread-safe. Since the reader ops in the graph are stateful,
+// concurrent calls are serialized. A process can only hold one session per
+// exported model, since the model's document queues are global. To serve
+// several models in one process, see model_pool.h.
+class ParsingSession {
+ public:
+  // Creates a session for the model exported to export_path and restores the
+  // model parameters. export_path is either an export directory or a bundle.
+  static tensorflow::Status Create(const string &export_path,
+                                   std::unique_ptr<ParsingSession> *session);
+
+  // As above, but creates the TensorFlow session with the given options
+  // instead of the serving_* options of the task context, if not null.
+  static tensorflow::Status Create(
+      const string &export_path,
+      const tensorflow::SessionOptions *session_options,
+      std::unique_ptr<ParsingSession> *session);
+
+  // Reads the task context of the model exported to export_path.
+  static tensorflow::Status ReadTaskContext(const string &export_path,
+                                            TaskContext *context);
+
+  // Sets the options of the TensorFlow session from the serving_* parameters
+  // of the task context.
+  static void SetServingOptions(const TaskContext &context,
+                                tensorflow::SessionOptions *options);
+
+  ~ParsingSession();
+
+  // Tags and parses the given sentences. The results are returned in the same
+  // order as the input. Document ids are preserved but need not be unique.
+  tensorflow::Status Parse(const std::vector<Sentence> &sentences,
+                           std::vector<Sentence> *parses);
+
+  // As above, but if stats is not null, traces every step and adds its step
+  // stats to stats, which must summarize graph_def(). Tracing slows the steps
+  // down, so timings should be taken without it.
+  tensorflow::Status Parse(const std::vector<Sentence> &sentences,
+                           std::vector<Sentence> *parses,
+                           tensorflow::StatSummarizer *stats);
+
+  // Returns the graph the session runs.
+  const tensorflow::GraphDef &graph_def() const { return graph_def_; }
+
+  // Returns the task context of the exported model.
+  const TaskContext &task_context() const { return task_context_; }
+
+ private:
+  ParsingSession() {}
+
+  // Removes all documents left in the queues by a failed Parse() call.
+  void ClearQueues();
+
+  // Task context of the exported model.
+  TaskContext task_context_;
+
+  // Graph of the session, kept for summarizing the stats of its steps.
+  tensorflow::GraphDef graph_def_;
+
+  // TensorFlow session holding the graph and its parameters.
+  std::unique_ptr<tensorflow::Session> session_;
+
+  // Graph nodes to run for each step.
+  std::vector<string> step_targets_;
+
+  // Handle of the session callable running the step targets.
+  int64 step_handle_ = 0;
+
+  // Queues the input documents are pushed to and the parsed documents are
+  // popped from. Not owned.
+  DocumentQueue *input_ = nullptr;
+  DocumentQueue *output_ = nullptr;
+
+  // Maximum number of steps per sentence before Parse() gives up.
+  int max_steps_per_sentence_ = 1000;
+
+  // Number of Parse() calls so far, used to make document ids unique.
+  int64 num_calls_ = 0;
+
+  // Mutex serializing Parse() calls.
+  mutex mu_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ParsingSession);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_PARSING_SESSION_H_
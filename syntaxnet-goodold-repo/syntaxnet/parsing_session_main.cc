@@ -0,0 +1,101 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Tags and parses text from stdin with a model exported by
+// parser_eval.py --export_path, or a bundle of it, writing CoNLL to stdout.
+//
+// Usage: parsing_session_main --export_path=<dir or bundle>
+//            [--input_format=<format>] [--batch_size=<n>]
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/document_format.h"
+#include "syntaxnet/parsing_session.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+using syntaxnet::DocumentFormat;
+using syntaxnet::ParsingSession;
+using syntaxnet::Sentence;
+
+namespace {
+
+// Parses a batch of sentences and writes them out in the output format.
+void ParseAndWrite(ParsingSession *session, DocumentFormat *output_format,
+                   std::vector<Sentence> *batch) {
+  std::vector<Sentence> parses;
+  TF_CHECK_OK(session->Parse(*batch, &parses));
+  for (const Sentence &parse : parses) {
+    string key, value;
+    output_format->ConvertToString(parse, &key, &value);
+    std::cout << value;
+  }
+  std::cout.flush();
+  batch->clear();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  string export_path;
+  string input_format = "english-text";
+  string output_format_name = "conll-sentence";
+  tensorflow::int32 batch_size = 1;
+  const bool parsed_flags_ok = tensorflow::ParseFlags(
+      &argc, argv, {tensorflow::Flag("export_path", &export_path),
+                    tensorflow::Flag("input_format", &input_format),
+                    tensorflow::Flag("output_format", &output_format_name),
+                    tensorflow::Flag("batch_size", &batch_size)});
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parsed_flags_ok || export_path.empty() || batch_size < 1) {
+    LOG(ERROR) << "Usage: " << argv[0] << " --export_path=<dir> "
+               << "[--input_format=english-text] "
+               << "[--output_format=conll-sentence] [--batch_size=1]";
+    return 1;
+  }
+
+  std::unique_ptr<ParsingSession> session;
+  TF_CHECK_OK(ParsingSession::Create(export_path, &session));
+
+  syntaxnet::TaskContext context;
+  std::unique_ptr<DocumentFormat> reader(DocumentFormat::Create(input_format));
+  reader->Setup(&context);
+  std::unique_ptr<DocumentFormat> writer(
+      DocumentFormat::Create(output_format_name));
+  writer->Setup(&context);
+
+  std::vector<Sentence> batch;
+  string line;
+  while (std::getline(std::cin, line)) {
+    std::vector<Sentence *> sentences;
+    reader->ConvertFromString("", line, &sentences);
+    for (Sentence *sentence : sentences) {
+      batch.push_back(*sentence);
+      delete sentence;
+    }
+    if (static_cast<int>(batch.size()) >= batch_size) {
+      ParseAndWrite(session.get(), writer.get(), &batch);
+    }
+  }
+  if (!batch.empty()) ParseAndWrite(session.get(), writer.get(), &batch);
+  return 0;
+}
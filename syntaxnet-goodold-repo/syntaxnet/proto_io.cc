@@ -0,0 +1,304 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/proto_io.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/lib/io/match.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+
+namespace syntaxnet {
+
+vector<string> TextReader::InputFiles(const TaskInput &input) {
+  // Expands the file patterns of all parts. Standard input and names without
+  // wildcards are read as they are.
+  vector<string> filenames;
+  for (const TaskInput::Part &part : input.part()) {
+    const string &pattern = part.file_pattern();
+    if (pattern == "-" || pattern.find_first_of("*?[") == string::npos) {
+      filenames.push_back(pattern);
+      continue;
+    }
+    vector<string> matches;
+    TF_CHECK_OK(tensorflow::io::GetMatchingFiles(tensorflow::Env::Default(),
+                                                 pattern, &matches));
+    CHECK(!matches.empty()) << "No files match " << pattern;
+    std::sort(matches.begin(), matches.end());
+    filenames.insert(filenames.end(), matches.begin(), matches.end());
+  }
+  return filenames;
+}
+
+TextReader::TextReader(const TaskInput &input, TaskContext *context) {
+  CHECK_EQ(input.record_format_size(), 1)
+      << "TextReader only supports inputs with one record format: "
+      << input.DebugString();
+  CHECK_GT(input.part_size(), 0)
+      << "TextReader needs at least one part: " << input.DebugString();
+  filenames_ = InputFiles(input);
+
+  num_threads_ = std::min<int>(context->Get("text_reader_threads", 0),
+                               filenames_.size());
+  buffer_size_ = std::max(context->Get("text_reader_buffer_size", 256), 1);
+  deterministic_ = context->Get("text_reader_deterministic", true);
+  block_size_ = context->Get("text_reader_block_size", 1 * 1024 * 1024);
+  CHECK_GT(block_size_, 0) << "text_reader_block_size must be positive";
+  if (context->Get("text_reader_readahead", false)) {
+    // One read in flight per file being parsed.
+    readahead_pool_.reset(new tensorflow::thread::ThreadPool(
+        tensorflow::Env::Default(), "text_readahead",
+        std::max(num_threads_, 1)));
+  }
+
+  // Sets up the formats here, since the context need not outlive the reader.
+  for (int i = 0; i < std::max(num_threads_, 1); ++i) {
+    formats_.emplace_back(DocumentFormat::Create(input.record_format(0)));
+    formats_.back()->Setup(context);
+  }
+  Reset();
+}
+
+TextReader::~TextReader() { StopThreads(); }
+
+Sentence *TextReader::Read(tensorflow::protobuf::Arena *arena) {
+  if (num_threads_ > 0) {
+    Sentence *sentence = ReadBuffered();
+    if (arena == nullptr || sentence == nullptr) return sentence;
+    Sentence *copy =
+        tensorflow::protobuf::Arena::CreateMessage<Sentence>(arena);
+    copy->CopyFrom(*sentence);
+    delete sentence;
+    return copy;
+  }
+  while (current_file_ < static_cast<int>(filenames_.size())) {
+    if (current_reader_ == nullptr) {
+      current_reader_.reset(
+          new TextFileReader(filenames_[current_file_], formats_[0].get(),
+                             block_size_, readahead_pool_.get()));
+    }
+    Sentence *sentence = current_reader_->Read(arena);
+    if (sentence != nullptr) return sentence;
+    current_reader_.reset();
+    ++current_file_;
+  }
+  return nullptr;
+}
+
+void TextReader::Reset() {
+  if (num_threads_ > 0) {
+    StopThreads();
+    StartThreads();
+  } else {
+    current_file_ = 0;
+    current_reader_.reset();
+  }
+}
+
+void TextReader::StartThreads() {
+  shards_ = vector<Shard>(filenames_.size());
+  next_shard_ = 0;
+  current_shard_ = 0;
+  stop_ = false;
+  for (int i = 0; i < num_threads_; ++i) {
+    DocumentFormat *format = formats_[i].get();
+    threads_.emplace_back(tensorflow::Env::Default()->StartThread(
+        tensorflow::ThreadOptions(), "text_reader",
+        [this, format]() { ReadShards(format); }));
+  }
+}
+
+void TextReader::StopThreads() {
+  {
+    mutex_lock lock(mu_);
+    stop_ = true;
+  }
+  changed_.notify_all();
+
+  // Deleting a thread joins it.
+  threads_.clear();
+  shards_.clear();
+}
+
+void TextReader::ReadShards(DocumentFormat *format) {
+  while (true) {
+    int index;
+    std::unique_ptr<TextFileReader> reader;
+    {
+      mutex_lock lock(mu_);
+      if (stop_ || next_shard_ == static_cast<int>(shards_.size())) return;
+      index = next_shard_++;
+      reader.reset(new TextFileReader(filenames_[index], format, block_size_,
+                                      readahead_pool_.get()));
+    }
+
+    // Parses the file outside the lock, and waits for the buffer to drain
+    // when it is full.
+    Shard *shard = &shards_[index];
+    while (true) {
+      std::unique_ptr<Sentence> sentence(reader->Read());
+      mutex_lock lock(mu_);
+      while (!stop_ &&
+             static_cast<int>(shard->sentences.size()) >= buffer_size_) {
+        changed_.wait(lock);
+      }
+      if (stop_) return;
+      if (sentence == nullptr) {
+        shard->done = true;
+        changed_.notify_all();
+        break;
+      }
+      shard->sentences.push_back(std::move(sentence));
+      changed_.notify_all();
+    }
+  }
+}
+
+Sentence *TextReader::ReadBuffered() {
+  mutex_lock lock(mu_);
+  while (true) {
+    // Skips the shards that have been fully returned.
+    while (current_shard_ < static_cast<int>(shards_.size()) &&
+           shards_[current_shard_].done &&
+           shards_[current_shard_].sentences.empty()) {
+      ++current_shard_;
+    }
+    if (current_shard_ == static_cast<int>(shards_.size())) return nullptr;
+
+    // Takes a sentence from the first shard, or in non-deterministic mode from
+    // any shard that has one.
+    const int last_shard = deterministic_ ? current_shard_ + 1 : next_shard_;
+    for (int i = current_shard_; i < last_shard; ++i) {
+      Shard &shard = shards_[i];
+      if (!shard.sentences.empty()) {
+        Sentence *sentence = shard.sentences.front().release();
+        shard.sentences.pop_front();
+        changed_.notify_all();
+        return sentence;
+      }
+    }
+    changed_.wait(lock);
+  }
+}
+
+ShardedTextWriter::ShardedTextWriter(const TaskInput &input,
+                                     TaskContext *context, int num_shards,
+                                     int queue_size)
+    : queue_size_(queue_size) {
+  CHECK_GT(num_shards, 0);
+  const string filename = TaskContext::InputFile(input);
+  CHECK(num_shards == 1 || filename != "-")
+      << "Standard output cannot be sharded: " << input.DebugString();
+  for (int i = 0; i < num_shards; ++i) {
+    TaskInput shard_input = input;
+    if (num_shards > 1) {
+      shard_input.mutable_part(0)->set_file_pattern(
+          ShardName(filename, i, num_shards));
+    }
+    shards_.emplace_back(new Shard());
+    Shard *shard = shards_.back().get();
+    shard->writer.reset(new TextWriter(shard_input, context));
+    if (queue_size_ > 0) {
+      shard->thread.reset(tensorflow::Env::Default()->StartThread(
+          tensorflow::ThreadOptions(), "text_writer",
+          [shard]() { WriteQueue(shard); }));
+    }
+  }
+}
+
+ShardedTextWriter::~ShardedTextWriter() {
+  for (const auto &shard : shards_) {
+    {
+      mutex_lock lock(shard->mu);
+      shard->stop = true;
+    }
+    shard->changed.notify_all();
+
+    // Deleting the thread joins it once it has written the queue.
+    shard->thread.reset();
+  }
+}
+
+string ShardedTextWriter::ShardName(const string &filename, int shard,
+                                    int num_shards) {
+  return tensorflow::strings::Printf("%s-%05d-of-%05d", filename.c_str(),
+                                     shard, num_shards);
+}
+
+void ShardedTextWriter::Write(vector<Sentence> *documents) {
+  Batch batch;
+  batch.documents.swap(*documents);
+  WriteBatch(&batch);
+}
+
+void ShardedTextWriter::WriteSerialized(vector<string> *documents) {
+  Batch batch;
+  batch.serialized.swap(*documents);
+  WriteBatch(&batch);
+}
+
+void ShardedTextWriter::WriteBatch(Batch *batch) {
+  Shard *shard;
+  {
+    mutex_lock lock(mu_);
+    shard = shards_[next_shard_].get();
+    next_shard_ = (next_shard_ + 1) % shards_.size();
+  }
+  mutex_lock lock(shard->mu);
+  if (queue_size_ == 0) {
+    WriteDocuments(*batch, shard->writer.get());
+    return;
+  }
+  while (static_cast<int>(shard->queue.size()) >= queue_size_) {
+    shard->changed.wait(lock);
+  }
+  shard->queue.emplace_back();
+  shard->queue.back().documents.swap(batch->documents);
+  shard->queue.back().serialized.swap(batch->serialized);
+  shard->changed.notify_all();
+}
+
+void ShardedTextWriter::WriteQueue(Shard *shard) {
+  while (true) {
+    Batch batch;
+    {
+      mutex_lock lock(shard->mu);
+      while (!shard->stop && shard->queue.empty()) shard->changed.wait(lock);
+      if (shard->queue.empty()) return;
+      batch.documents.swap(shard->queue.front().documents);
+      batch.serialized.swap(shard->queue.front().serialized);
+      shard->queue.pop_front();
+      shard->changed.notify_all();
+    }
+
+    // Only this thread uses the writer of the shard in asynchronous mode.
+    WriteDocuments(batch, shard->writer.get());
+  }
+}
+
+void ShardedTextWriter::WriteDocuments(const Batch &batch,
+                                       TextWriter *writer) {
+  for (const Sentence &document : batch.documents) writer->Write(document);
+  Sentence document;
+  for (const string &serialized : batch.serialized) {
+    if (!document.ParseFromString(serialized)) {
+      LOG(ERROR) << "Could not parse a document to write, skipping it";
+      continue;
+    }
+    writer->Write(document);
+  }
+}
+
+}  // namespace syntaxnet
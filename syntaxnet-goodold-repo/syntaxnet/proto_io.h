@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef SYNTAXNET_PROTO_IO_H_
 #define SYNTAXNET_PROTO_IO_H_
 
+#include <deque>
 #include <iostream>
 #include <memory>
 #include <string>
@@ -32,6 +33,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
 #include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/record_writer.h"
@@ -48,10 +50,15 @@ class ProtoRecordReader {
     reader_.reset(new tensorflow::io::RecordReader(file_.get()));
   }
 
+  // Reads the records in place if the file can be mapped into memory.
   explicit ProtoRecordReader(const string &filename) {
-    TF_CHECK_OK(
-        tensorflow::Env::Default()->NewRandomAccessFile(filename, &file_));
-    reader_.reset(new tensorflow::io::RecordReader(file_.get()));
+    tensorflow::Env *env = tensorflow::Env::Default();
+    if (env->NewReadOnlyMemoryRegionFromFile(filename, &region_).ok()) {
+      reader_.reset(new tensorflow::io::RecordReader(region_.get()));
+    } else {
+      TF_CHECK_OK(env->NewRandomAccessFile(filename, &file_));
+      reader_.reset(new tensorflow::io::RecordReader(file_.get()));
+    }
   }
 
   ~ProtoRecordReader() {
@@ -60,10 +67,10 @@ class ProtoRecordReader {
 
   template <typename T>
   tensorflow::Status Read(T *proto) {
-    string buffer;
+    tensorflow::StringPiece buffer;
     tensorflow::Status status = reader_->ReadRecord(&offset_, &buffer);
     if (status.ok()) {
-      CHECK(proto->ParseFromString(buffer));
+      CHECK(proto->ParseFromArray(buffer.data(), buffer.size()));
       return tensorflow::Status::OK();
     } else {
       return status;
@@ -74,6 +81,7 @@ class ProtoRecordReader {
   uint64 offset_ = 0;
   std::unique_ptr<tensorflow::io::RecordReader> reader_;
   std::unique_ptr<tensorflow::RandomAccessFile> file_;
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region_;
 };
 
 // A convenience wrapper to write protos with a RecordReader.
@@ -141,32 +149,46 @@ class StdIn : public tensorflow::RandomAccessFile {
   TF_DISALLOW_COPY_AND_ASSIGN(StdIn);
 };
 
-// Reads sentence protos from a text file.
-class TextReader {
+// Reads sentence protos from one text file, or from standard input if the
+// file name is "-".
+class TextFileReader {
  public:
-  explicit TextReader(const TaskInput &input, TaskContext *context) {
-    CHECK_EQ(input.record_format_size(), 1)
-        << "TextReader only supports inputs with one record format: "
-        << input.DebugString();
-    CHECK_EQ(input.part_size(), 1)
-        << "TextReader only supports inputs with one part: "
-        << input.DebugString();
-    filename_ = TaskContext::InputFile(input);
-    format_.reset(DocumentFormat::Create(input.record_format(0)));
-    format_->Setup(context);
-    Reset();
+  // Reads the file with the given format, which is not owned and must outlive
+  // the reader. Files other than standard input are read in blocks of
+  // "block_size" bytes, and if a readahead pool is given, the next block is
+  // read in the pool while the current one is parsed, which hides the latency
+  // of remote file systems. The pool is not owned and must outlive the reader.
+  TextFileReader(const string &filename, DocumentFormat *format,
+                 int block_size = 1 * 1024 * 1024,
+                 tensorflow::thread::ThreadPool *readahead_pool = nullptr)
+      : filename_(filename), format_(format) {
+    if (filename_ == "-") {
+      static const int kInputBufferSize = 8 * 1024; /* bytes */
+      file_.reset(new StdIn());
+      buffer_.reset(
+          new tensorflow::io::InputBuffer(file_.get(), kInputBufferSize));
+    } else {
+      TF_CHECK_OK(
+          tensorflow::Env::Default()->NewRandomAccessFile(filename_, &file_));
+      buffer_.reset(new tensorflow::io::InputBuffer(file_.get(), block_size,
+                                                    readahead_pool));
+    }
   }
 
-  Sentence *Read() {
+  // Returns the next sentence, or nullptr at the end of the file. The caller
+  // takes ownership of the sentence, unless it is allocated on the given
+  // arena, which then owns it.
+  Sentence *Read(tensorflow::protobuf::Arena *arena = nullptr) {
     // Skips emtpy sentences, e.g., blank lines at the beginning of a file or
     // commented out blocks.
     vector<Sentence *> sentences;
-    string key, value;
-    while (sentences.empty() && format_->ReadRecord(buffer_.get(), &value)) {
-      key = tensorflow::strings::StrCat(filename_, ":", sentence_count_);
-      format_->ConvertFromString(key, value, &sentences);
+    format_->set_arena(arena);
+    while (sentences.empty() && format_->ReadRecord(buffer_.get(), &value_)) {
+      key_ = tensorflow::strings::StrCat(filename_, ":", sentence_count_);
+      format_->ConvertFromString(key_, value_, &sentences);
       CHECK_LE(sentences.size(), 1);
     }
+    format_->set_arena(nullptr);
     if (sentences.empty()) {
       // End of file reached.
       return nullptr;
@@ -176,28 +198,112 @@ class TextReader {
     }
   }
 
-  void Reset() {
-    sentence_count_ = 0;
-    if (filename_ == "-") {
-      static const int kInputBufferSize = 8 * 1024; /* bytes */
-      file_.reset(new StdIn());
-      buffer_.reset(
-          new tensorflow::io::InputBuffer(file_.get(), kInputBufferSize));
-    } else {
-      static const int kInputBufferSize = 1 * 1024 * 1024; /* bytes */
-      TF_CHECK_OK(
-          tensorflow::Env::Default()->NewRandomAccessFile(filename_, &file_));
-      buffer_.reset(
-          new tensorflow::io::InputBuffer(file_.get(), kInputBufferSize));
-    }
-  }
-
  private:
   string filename_;
+  DocumentFormat *format_;
   int sentence_count_ = 0;
+  string key_;
+  string value_;
   std::unique_ptr<tensorflow::RandomAccessFile> file_;  // must outlive buffer_
   std::unique_ptr<tensorflow::io::InputBuffer> buffer_;
-  std::unique_ptr<DocumentFormat> format_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(TextFileReader);
+};
+
+// Reads sentence protos from the text files of a task input. Each part of the
+// input is a file name or a file pattern, and the matching files are read in
+// order. If the "text_reader_threads" parameter is positive, that many threads
+// read and parse files ahead of time, keeping up to "text_reader_buffer_size"
+// sentences of each file in memory. Sentences are then returned in input order,
+// unless "text_reader_deterministic" is false, in which case they are returned
+// as soon as any thread has parsed them. Files are read in blocks of
+// "text_reader_block_size" bytes, and if "text_reader_readahead" is true, the
+// next block of each file is read ahead while the current one is parsed.
+class TextReader {
+ public:
+  TextReader(const TaskInput &input, TaskContext *context);
+  ~TextReader();
+
+  // Returns the files the reader of the input reads, in input order.
+  static vector<string> InputFiles(const TaskInput &input);
+
+  // Returns the next sentence, or nullptr at the end of the input. The caller
+  // takes ownership of the sentence, unless it is allocated on the given
+  // arena, which then owns it. Sentences parsed ahead by reader threads are on
+  // the heap and are copied onto the arena, see parses_ahead().
+  Sentence *Read(tensorflow::protobuf::Arena *arena = nullptr);
+
+  // Whether reader threads parse the sentences ahead of Read(), in which case
+  // reading them onto an arena costs a copy instead of saving allocations.
+  bool parses_ahead() const { return num_threads_ > 0; }
+
+  // Restarts reading from the first file.
+  void Reset();
+
+ private:
+  // A file being read by a thread. Parsed sentences are buffered in order.
+  struct Shard {
+    std::deque<std::unique_ptr<Sentence>> sentences;
+    bool done = false;
+  };
+
+  // Starts and stops the reader threads.
+  void StartThreads();
+  void StopThreads();
+
+  // Body of a reader thread. Reads one file at a time, in file order, until
+  // all files have been claimed or the reader is stopped.
+  void ReadShards(DocumentFormat *format);
+
+  // Returns the next buffered sentence, waiting for the reader threads if
+  // needed, or nullptr once all files have been read.
+  Sentence *ReadBuffered();
+
+  // Files to read, in input order.
+  vector<string> filenames_;
+
+  // Document formats, one per reader thread, or a single one when reading in
+  // the calling thread.
+  vector<std::unique_ptr<DocumentFormat>> formats_;
+
+  // Number of reader threads, or 0 to read in the calling thread.
+  int num_threads_ = 0;
+
+  // Maximum number of buffered sentences per file.
+  int buffer_size_ = 256;
+
+  // Whether sentences are returned in input order.
+  bool deterministic_ = true;
+
+  // Size of the blocks read from files, and the pool reading the next blocks
+  // ahead, or null to read them when needed. Declared before the file readers,
+  // which use it.
+  int block_size_ = 1 * 1024 * 1024;
+  std::unique_ptr<tensorflow::thread::ThreadPool> readahead_pool_;
+
+  // When reading in the calling thread, the index of the file being read and
+  // its reader.
+  int current_file_ = 0;
+  std::unique_ptr<TextFileReader> current_reader_;
+
+  // Mutex guarding the shards, and condition signaled whenever a shard or the
+  // stop flag changes.
+  mutex mu_;
+  tensorflow::condition_variable changed_;
+
+  // Shards of all files, the index of the next file to claim, and the index of
+  // the first shard that has not been fully returned.
+  vector<Shard> shards_;
+  int next_shard_ = 0;
+  int current_shard_ = 0;
+
+  // Whether the reader threads should exit.
+  bool stop_ = false;
+
+  // Reader threads.
+  vector<std::unique_ptr<tensorflow::Thread>> threads_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(TextReader);
 };
 
 // Writes sentence protos to a text conll file.
@@ -226,21 +332,95 @@ class TextWriter {
   }
 
   void Write(const Sentence &sentence) {
-    string key, value;
-    format_->ConvertToString(sentence, &key, &value);
+    format_->ConvertToString(sentence, &key_, &value_);
     if (file_) {
-      TF_CHECK_OK(file_->Append(value));
+      TF_CHECK_OK(file_->Append(value_));
     } else {
-      std::cout << value;
+      std::cout << value_;
     }
   }
 
  private:
+  // Buffers for the converted sentences, reused across writes.
+  string key_;
+  string value_;
+
   string filename_;
   std::unique_ptr<DocumentFormat> format_;
   std::unique_ptr<tensorflow::WritableFile> file_;
 };
 
+// Writes batches of documents to the shards of a task input, each through a
+// TextWriter of its own. With more than one shard, shard i of n is the file
+// ShardName(<file pattern>, i, n), so that the pattern "<file pattern>-*" reads
+// the shards back in order, and batches go to the shards in turn.
+//
+// With a positive queue size, each shard is written by a thread of its own
+// from a queue of at most that many batches. Writing a batch then only waits
+// when the queue of its shard is full, and serialized documents are parsed on
+// the writer thread. The batches of a shard are written in order either way.
+// The writer is thread-safe.
+class ShardedTextWriter {
+ public:
+  ShardedTextWriter(const TaskInput &input, TaskContext *context,
+                    int num_shards, int queue_size);
+
+  // Writes the queued batches and closes the shards.
+  ~ShardedTextWriter();
+
+  // Writes a batch of documents, or of serialized documents, to the next
+  // shard. Leaves the vector empty.
+  void Write(vector<Sentence> *documents);
+  void WriteSerialized(vector<string> *documents);
+
+  // Returns the name of shard i of n of a file, e.g. "file-00001-of-00004".
+  static string ShardName(const string &filename, int shard, int num_shards);
+
+ private:
+  // A batch of documents, given as protos or serialized.
+  struct Batch {
+    vector<Sentence> documents;
+    vector<string> serialized;
+  };
+
+  // A shard being written, with its queue of batches in asynchronous mode.
+  struct Shard {
+    std::unique_ptr<TextWriter> writer;
+
+    // Mutex guarding the queue and the writer, and condition signaled whenever
+    // the queue or the stop flag changes.
+    mutex mu;
+    tensorflow::condition_variable changed;
+    std::deque<Batch> queue;
+    bool stop = false;
+
+    // Writer thread, or nullptr in synchronous mode.
+    std::unique_ptr<tensorflow::Thread> thread;
+  };
+
+  // Writes the batch to the next shard, directly or through its queue.
+  void WriteBatch(Batch *batch);
+
+  // Body of the writer thread of a shard. Writes queued batches until the
+  // shard is stopped and its queue is empty.
+  static void WriteQueue(Shard *shard);
+
+  // Writes the documents of a batch with the writer.
+  static void WriteDocuments(const Batch &batch, TextWriter *writer);
+
+  // Maximum number of queued batches per shard, or 0 to write synchronously.
+  int queue_size_;
+
+  // Mutex guarding the index of the next shard to write to.
+  mutex mu_;
+  int next_shard_ = 0;
+
+  // Shards of the output.
+  vector<std::unique_ptr<Shard>> shards_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ShardedTextWriter);
+};
+
 }  // namespace syntaxnet
 
 #endif  // SYNTAXNET_PROTO_IO_H_
@@ -0,0 +1,175 @@
+# Copyright 2016 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+"""A program to quantize a trained greedy tagger or parser to eight bits.
+
+Restores the float parameters of a model, quantizes them, calibrates the range
+of the quantized embedding layer over a development corpus and saves the
+quantized model, which parser_eval runs with --quantized. The accuracy of the
+float and quantized models on the development corpus is logged for comparison.
+
+With --half_embeddings, only the embedding matrices are rounded to half
+precision instead, and the other parameters stay float. The model is saved as
+a slim model, which parser_eval runs with --half_embeddings --slim_model.
+"""
+
+
+import time
+
+import tensorflow as tf
+
+from tensorflow.python.platform import tf_logging as logging
+
+from syntaxnet import graph_builder
+from syntaxnet.ops import gen_parser_ops
+
+flags = tf.app.flags
+FLAGS = flags.FLAGS
+
+
+flags.DEFINE_string('task_context', '',
+                    'Path to a task context with inputs and parameters for '
+                    'feature extractors.')
+flags.DEFINE_string('model_path', '', 'Path to the float model parameters.')
+flags.DEFINE_string('output_model_path', '',
+                    'Path to write the quantized model parameters to.')
+flags.DEFINE_string('arg_prefix', None, 'Prefix for context parameters.')
+flags.DEFINE_string('input', 'tuning-corpus',
+                    'Name of the context input to calibrate and evaluate on.')
+flags.DEFINE_string('hidden_layer_sizes', '200,200',
+                    'Comma separated list of hidden layer sizes.')
+flags.DEFINE_bool('packed_features', False,
+                  'Whether the greedy readers return packed feature tensors '
+                  'instead of serialized SparseFeatures protos.')
+flags.DEFINE_integer('batch_size', 32,
+                     'Number of sentences to process in parallel.')
+flags.DEFINE_bool('slim_model', False,
+                  'Whether to expect only averaged variables.')
+flags.DEFINE_bool('half_embeddings', False,
+                  'Whether to store the embedding matrices in half precision '
+                  'instead of quantizing all parameters to eight bits.')
+
+
+def BuildParser(sess, quantized, half_embeddings=False, slim_model=None):
+  """Builds an evaluation network on float, quantized or half parameters."""
+  feature_sizes, domain_sizes, embedding_dims, num_actions = sess.run(
+      gen_parser_ops.feature_size(task_context=FLAGS.task_context,
+                                  arg_prefix=FLAGS.arg_prefix))
+  hidden_layer_sizes = map(int, FLAGS.hidden_layer_sizes.split(','))
+  parser = graph_builder.GreedyParser(num_actions,
+                                      feature_sizes,
+                                      domain_sizes,
+                                      embedding_dims,
+                                      hidden_layer_sizes,
+                                      gate_gradients=True,
+                                      arg_prefix=FLAGS.arg_prefix,
+                                      packed_features=FLAGS.packed_features)
+  if quantized:
+    parser.UseQuantizedInference()
+  if half_embeddings:
+    parser.UseHalfEmbeddings()
+  parser.AddEvaluation(FLAGS.task_context,
+                       FLAGS.batch_size,
+                       corpus_name=FLAGS.input)
+  parser.AddSaver(FLAGS.slim_model if slim_model is None else slim_model)
+  sess.run(parser.inits.values())
+  return parser
+
+
+def Evaluate(sess, parser, name, extra_fetches=None):
+  """Runs one epoch of evaluation and logs its accuracy.
+
+  Args:
+    sess: tensorflow session to use.
+    parser: graph builder holding the evaluation network.
+    name: name of the model in the log.
+    extra_fetches: optional list of nodes run along with every step.
+  """
+  t = time.time()
+  num_epochs = None
+  num_tokens = 0
+  num_correct = 0
+  while True:
+    tf_eval_epochs, tf_eval_metrics = sess.run(
+        [parser.evaluation['epochs'],
+         parser.evaluation['eval_metrics']] + (extra_fetches or []))[:2]
+    num_tokens += tf_eval_metrics[0]
+    num_correct += tf_eval_metrics[1]
+    if num_epochs is None:
+      num_epochs = tf_eval_epochs
+    elif num_epochs < tf_eval_epochs:
+      break
+  if num_tokens > 0:
+    logging.info('%s model: seconds elapsed: %.2f, eval metric: %.2f%%', name,
+                 time.time() - t, 100.0 * num_correct / num_tokens)
+
+
+def Quantize():
+  """Quantizes FLAGS.model_path into FLAGS.output_model_path."""
+  with tf.Graph().as_default(), tf.Session() as sess:
+    parser = BuildParser(sess, False)
+    parser.saver.restore(sess, FLAGS.model_path)
+    Evaluate(sess, parser, 'Float')
+    # The slim model only holds the averaged parameters, which are those used
+    # for evaluation.
+    names = [name for name in parser.params
+             if name + '_avg_var' in parser.variables]
+    values = sess.run([parser.variables[name + '_avg_var'] for name in names])
+    values = dict(zip(names, values))
+
+  if FLAGS.half_embeddings:
+    HalveEmbeddings(values)
+    return
+
+  with tf.Graph().as_default(), tf.Session() as sess:
+    parser = BuildParser(sess, True)
+    parser.AssignQuantizedParams(sess, values)
+    # With unweighted features the embedding layer only holds embedding
+    # values, so a calibration pass whose decisions are made with an
+    # uncalibrated range still records the range of the decoded corpus.
+    Evaluate(sess, parser, 'Uncalibrated quantized',
+             [parser.evaluation['calibrate_quantization']])
+    Evaluate(sess, parser, 'Quantized')
+    parser.saver.save(sess, FLAGS.output_model_path)
+    logging.info('Wrote quantized model to %s', FLAGS.output_model_path)
+
+
+def HalveEmbeddings(values):
+  """Saves a slim model with half precision embedding matrices.
+
+  Args:
+    values: dictionary of the averaged float parameter values by name.
+  """
+  with tf.Graph().as_default(), tf.Session() as sess:
+    parser = BuildParser(sess, False, half_embeddings=True, slim_model=True)
+    parser.AssignHalfParams(sess, values)
+    for name in parser.params:
+      variable = parser.variables[name + '_avg_var']
+      placeholder = tf.placeholder(tf.float32, values[name].shape)
+      sess.run(tf.assign(variable, placeholder),
+               feed_dict={placeholder: values[name]})
+    Evaluate(sess, parser, 'Half embeddings')
+    parser.saver.save(sess, FLAGS.output_model_path)
+    logging.info('Wrote model with half embeddings to %s',
+                 FLAGS.output_model_path)
+
+
+def main(unused_argv):
+  logging.set_verbosity(logging.INFO)
+  Quantize()
+
+
+if __name__ == '__main__':
+  tf.app.run()
@@ -14,33 +14,48 @@ limitations under the License.
 ==============================================================================*/
 
 #include <math.h>
+#include <algorithm>
 #include <deque>
+#include <functional>
 #include <memory>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
 #include "syntaxnet/base.h"
+#include "syntaxnet/batch_size_controller.h"
 #include "syntaxnet/feature_extractor.h"
+#include "syntaxnet/feature_profiler.h"
+#include "syntaxnet/parse_cache.h"
 #include "syntaxnet/parser_state.h"
 #include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/reader_stats.h"
 #include "syntaxnet/sentence.pb.h"
 #include "syntaxnet/sentence_batch.h"
+#include "syntaxnet/sentence_tracing.h"
 #include "syntaxnet/shared_store.h"
 #include "syntaxnet/sparse.pb.h"
 #include "syntaxnet/task_context.h"
 #include "syntaxnet/task_spec.pb.h"
+#include "third_party/eigen3/Eigen/Core"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/gtl/flat_hash_map.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
+#include "tensorflow/core/lib/io/record_reader.h"
 #include "tensorflow/core/lib/io/table.h"
 #include "tensorflow/core/lib/io/table_options.h"
-#include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/random_distributions.h"
+#include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/util/guarded_philox_random.h"
+#include "tensorflow/core/util/work_sharder.h"
 
+using tensorflow::AllocatorAttributes;
 using tensorflow::DEVICE_CPU;
 using tensorflow::DT_FLOAT;
 using tensorflow::DT_INT32;
@@ -57,13 +72,25 @@ using tensorflow::errors::InvalidArgument;
 
 namespace syntaxnet {
 
+// Base class of the greedy parsing readers. The features of the current parser
+// states are emitted either as serialized SparseFeatures protos, one string
+// tensor per feature group, or, if packed_features is true, as flat id, weight
+// and index tensors per feature group, in the format of UnpackSparseFeatures.
+// The packed format saves a proto encode/decode pair per feature and batch
+// slot. With a positive <arg_prefix>_max_tokens_per_batch task parameter, the
+// sentences in the batch hold at most that many tokens in total, and slots
+// left empty by the budget are refilled as soon as sentences finish; see
+// SentenceBatch.
 class ParsingReader : public OpKernel {
  public:
-  explicit ParsingReader(OpKernelConstruction *context) : OpKernel(context) {
+  ParsingReader(OpKernelConstruction *context, bool packed_features)
+      : OpKernel(context), packed_features_(packed_features) {
     string file_path, corpus_name;
     OP_REQUIRES_OK(context, context->GetAttr("task_context", &file_path));
     OP_REQUIRES_OK(context, context->GetAttr("feature_size", &feature_size_));
     OP_REQUIRES_OK(context, context->GetAttr("batch_size", &max_batch_size_));
+    max_active_slots_ = max_batch_size_;
+    slot_end_ = max_batch_size_;
     OP_REQUIRES_OK(context, context->GetAttr("corpus_name", &corpus_name));
     OP_REQUIRES_OK(context, context->GetAttr("arg_prefix", &arg_prefix_));
 
@@ -76,20 +103,24 @@ class ParsingReader : public OpKernel {
                 InvalidArgument("Could not parse task context at ", file_path));
 
     // Set up the batch reader.
+    const int lookahead = task_context_.Get(
+        tensorflow::strings::StrCat(arg_prefix_, "_sentence_lookahead"), 0);
     sentence_batch_.reset(
-        new SentenceBatch(max_batch_size_, corpus_name));
+        new SentenceBatch(max_batch_size_, corpus_name, lookahead));
     sentence_batch_->Init(&task_context_);
+    sentence_batch_->set_max_tokens(task_context_.Get(
+        tensorflow::strings::StrCat(arg_prefix_, "_max_tokens_per_batch"), 0));
 
     // Set up the parsing features and transition system.
     states_.resize(max_batch_size_);
     workspaces_.resize(max_batch_size_);
-    features_.reset(new ParserEmbeddingFeatureExtractor(arg_prefix_));
-    features_->Setup(&task_context_);
+    feature_memos_.resize(max_batch_size_);
+    serialized_features_.resize(max_batch_size_);
+    shared_features_ = SharedParserFeatures::Get(arg_prefix_, &task_context_);
+    features_ = &shared_features_->features();
     transition_system_.reset(ParserTransitionSystem::Create(task_context_.Get(
         features_->GetParamName("transition_system"), "arc-standard")));
     transition_system_->Setup(&task_context_);
-    features_->Init(&task_context_);
-    features_->RequestWorkspaces(&workspace_registry_);
     transition_system_->Init(&task_context_);
     string label_map_path =
         TaskContext::InputFile(*task_context_.GetInput("label-map"));
@@ -103,81 +134,95 @@ class ParsingReader : public OpKernel {
         InvalidArgument("Task context requires feature_size=", required_size));
   }
 
-  ~ParsingReader() override { SharedStore::Release(label_map_); }
+  ~ParsingReader() override {
+    SharedStore::Release(label_map_);
+    SharedParserFeatures::Release(shared_features_);
+  }
 
-  // Creates a new ParserState if there's another sentence to be read.
+  // Creates a new ParserState if there's another sentence to be read. Sentences
+  // consumed by SkipSentence() are passed over.
   virtual void AdvanceSentence(int index) {
-    states_[index].reset();
-    if (sentence_batch_->AdvanceSentence(index)) {
-      states_[index].reset(new ParserState(
+    state_arena_.Release(std::move(states_[index]));
+    bool advanced;
+    do {
+      ScopedStageTimer timer(kSentenceRead);
+      advanced = sentence_batch_->AdvanceSentence(index);
+      if (advanced) ReaderStats::Get()->AddSentence();
+    } while (advanced && SkipSentence(index));
+    if (advanced) {
+      states_[index] = state_arena_.NewState(
           sentence_batch_->sentence(index),
-          transition_system_->NewTransitionState(true), label_map_));
-      workspaces_[index].Reset(workspace_registry_);
+          transition_system_->NewTransitionState(true), label_map_);
+      workspaces_[index].Reset(shared_features_->registry());
+      ScopedStageTimer timer(kPreprocess);
+      SentenceSpan span("preprocess", states_[index]->sentence());
       features_->Preprocess(&workspaces_[index], states_[index].get());
     }
+    feature_memos_[index].Clear();
   }
 
   void Compute(OpKernelContext *context) override {
     mutex_lock lock(mu_);
+    ScopedStageTimer timer(kReaderStep);
+
+    // Switches to the other half of the batch slots when ping-ponging.
+    if (ping_pong_) {
+      half_ = 1 - half_;
+      const int middle = max_batch_size_ / 2;
+      slot_begin_ = half_ == 0 ? 0 : middle;
+      slot_end_ = half_ == 0 ? middle : max_batch_size_;
+    }
 
     // Advances states to the next positions.
     PerformActions(context);
 
     // Advances any final states to the next sentences.
-    for (int i = 0; i < max_batch_size_; ++i) {
-      if (state(i) == nullptr) continue;
-
-      // Switches to the next sentence if we're at a final state.
-      while (transition_system_->IsFinalState(*state(i))) {
-        VLOG(2) << "Advancing sentence " << i;
-        AdvanceSentence(i);
-        if (state(i) == nullptr) break;  // EOF has been reached
+    for (int i = slot_begin_; i < slot_end_; ++i) AdvanceFinalState(i);
+
+    // Refills empty slots up to the active slot limit, if there is one, and
+    // within the token budget of the batch, if it has one.
+    if (limit_active_slots_ || sentence_batch_->max_tokens() > 0) {
+      for (int i = slot_begin_;
+           i < slot_end_ && sentence_batch_->size() < max_active_slots_;
+           ++i) {
+        if (state(i) == nullptr) {
+          AdvanceSentence(i);
+          if (skip_deterministic_states_) AdvanceFinalState(i);
+        }
       }
     }
 
     // Rewinds if no states remain in the batch (we need to re-wind the corpus).
+    // This fills the slots of both halves, since the other one is empty too.
     if (sentence_batch_->size() == 0) {
       ++num_epochs_;
       LOG(INFO) << "Starting epoch " << num_epochs_;
       sentence_batch_->Rewind();
-      for (int i = 0; i < max_batch_size_; ++i) AdvanceSentence(i);
-    }
-
-    // Create the outputs for each feature space.
-    vector<Tensor *> feature_outputs(features_->NumEmbeddings());
-    for (size_t i = 0; i < feature_outputs.size(); ++i) {
-      OP_REQUIRES_OK(context, context->allocate_output(
-                                  i, TensorShape({sentence_batch_->size(),
-                                                  features_->FeatureSize(i)}),
-                                  &feature_outputs[i]));
+      for (int i = 0; i < max_active_slots_; ++i) {
+        AdvanceSentence(i);
+        if (skip_deterministic_states_) AdvanceFinalState(i);
+      }
     }
 
-    // Populate feature outputs.
-    for (int i = 0, index = 0; i < max_batch_size_; ++i) {
-      if (states_[i] == nullptr) continue;
-
-      // Extract features from the current parser state, and fill up the
-      // available batch slots.
-      std::vector<std::vector<SparseFeatures>> features =
-          features_->ExtractSparseFeatures(workspaces_[i], *states_[i]);
-
-      for (size_t feature_space = 0; feature_space < features.size();
-           ++feature_space) {
-        int feature_size = features[feature_space].size();
-        CHECK(feature_size == features_->FeatureSize(feature_space));
-        auto features_output = feature_outputs[feature_space]->matrix<string>();
-        for (int k = 0; k < feature_size; ++k) {
-          features_output(index, k) =
-              features[feature_space][k].SerializeAsString();
-        }
+    // Create and populate the outputs for each feature space.
+    const std::vector<int> slots = ActiveSlots();
+    ReaderStats::Get()->AddBatch(
+        slots.size(), std::min(max_active_slots_, slot_end_ - slot_begin_));
+    {
+      ScopedStageTimer timer(kFeatureExtraction);
+      if (packed_features_) {
+        AddPackedFeatureOutputs(context, slots);
+      } else {
+        AddSerializedFeatureOutputs(context, slots);
       }
-      ++index;
     }
+    num_emitted_[half_] = slots.size();
 
     // Return the number of epochs.
     Tensor *epoch_output;
-    OP_REQUIRES_OK(context, context->allocate_output(
-                                feature_size_, TensorShape({}), &epoch_output));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(num_feature_outputs(),
+                                            TensorShape({}), &epoch_output));
     auto num_epochs = epoch_output->scalar<int32>();
     num_epochs() = num_epochs_;
 
@@ -193,18 +238,78 @@ class ParsingReader : public OpKernel {
   // Adds outputs specific to this reader starting at additional_output_index().
   virtual void AddAdditionalOutputs(OpKernelContext *context) const = 0;
 
+  // Called when the default action of a deterministic state takes the state in
+  // slot i to a final state, see set_skip_deterministic_states().
+  virtual void FinishState(int i) {}
+
+  // Called when slot i has read a new sentence, before a parser state is
+  // created for it. Returns true if the sentence needs no parsing, e.g.
+  // because its parse is cached, in which case the slot reads the next one.
+  virtual bool SkipSentence(int i) { return false; }
+
   // Returns the output type specification of the this base class.
   std::vector<DataType> default_outputs() const {
-    std::vector<DataType> output_types(feature_size_, DT_STRING);
+    std::vector<DataType> output_types;
+    if (packed_features_) {
+      output_types.insert(output_types.end(), feature_size_, DT_INT32);
+      output_types.insert(output_types.end(), feature_size_, DT_INT64);
+      output_types.insert(output_types.end(), feature_size_, DT_FLOAT);
+      output_types.push_back(DT_INT32);
+    } else {
+      output_types.insert(output_types.end(), feature_size_, DT_STRING);
+    }
     output_types.push_back(DT_INT32);
     return output_types;
   }
 
+  // Limits the number of sentences parsed at a time to at most max_batch_size.
+  // Slots over the limit are freed as their sentences finish, and empty slots
+  // are refilled as long as the batch is below the limit.
+  void set_max_active_slots(int max_active_slots) {
+    max_active_slots_ = std::min(std::max(max_active_slots, 1),
+                                 max_batch_size_);
+    limit_active_slots_ = true;
+  }
+
+  // Performs the only allowed action of deterministic states, like a shift on
+  // a stack with fewer than two tokens, before extracting features, so that
+  // they do not take up a batch slot of the network.
+  void set_skip_deterministic_states(bool skip_deterministic_states) {
+    skip_deterministic_states_ = skip_deterministic_states;
+  }
+
+  // Splits the batch slots into two halves and alternates between them, so
+  // that each step takes the actions of the states of one half, scored from
+  // the features this reader emitted two steps earlier, and emits the
+  // features of that half only. The network can then score the features of
+  // one half while this reader extracts those of the other.
+  void set_ping_pong(bool ping_pong) {
+    ping_pong_ = ping_pong;
+    half_ = 1;
+  }
+
   // Accessors.
   int max_batch_size() const { return max_batch_size_; }
+  bool ping_pong() const { return ping_pong_; }
+  int slot_begin() const { return slot_begin_; }
+  int slot_end() const { return slot_end_; }
+
+  // Number of states of the current half whose features were emitted the last
+  // time it was processed, i.e. the number of rows of scores expected.
+  int num_scored() const { return num_emitted_[half_]; }
+  int max_active_slots() const { return max_active_slots_; }
   int batch_size() const { return sentence_batch_->size(); }
-  int additional_output_index() const { return feature_size_ + 1; }
+  int backlog() const { return sentence_batch_->backlog(); }
+  int additional_output_index() const { return num_feature_outputs() + 1; }
   ParserState *state(int i) const { return states_[i].get(); }
+  const Sentence &sentence(int i) const {
+    return *sentence_batch_->sentence(i);
+  }
+  Sentence *mutable_sentence(int i) const {
+    return sentence_batch_->sentence(i);
+  }
+  int64 sequence(int i) const { return sentence_batch_->sequence(i); }
+  const TermFrequencyMap &label_map() const { return *label_map_; }
   const ParserTransitionSystem &transition_system() const {
     return *transition_system_;
   }
@@ -215,6 +320,202 @@ class ParsingReader : public OpKernel {
   const string &arg_prefix() const { return arg_prefix_; }
 
  private:
+  // Switches the state in slot i to the next sentence while it is final, or
+  // frees the slot if more slots are active than allowed. When skipping
+  // deterministic states, their default actions are performed first.
+  void AdvanceFinalState(int i) {
+    while (state(i) != nullptr) {
+      if (skip_deterministic_states_) PerformDeterministicActions(i);
+      if (!transition_system_->IsFinalState(*state(i))) break;
+      if (sentence_batch_->size() > max_active_slots_) {
+        VLOG(2) << "Releasing slot " << i;
+        state_arena_.Release(std::move(states_[i]));
+        sentence_batch_->Release(i);
+        break;
+      }
+      VLOG(2) << "Advancing sentence " << i;
+      AdvanceSentence(i);  // leaves the slot empty once EOF has been reached
+    }
+  }
+
+  // Performs the default action of the state in slot i as long as it is the
+  // only allowed one.
+  void PerformDeterministicActions(int i) {
+    ParserState *state = states_[i].get();
+    while (!transition_system_->IsFinalState(*state) &&
+           transition_system_->IsDeterministicState(*state)) {
+      transition_system_->PerformAction(
+          transition_system_->GetDefaultAction(*state), state);
+      if (transition_system_->IsFinalState(*state)) FinishState(i);
+    }
+  }
+
+  // Returns the batch slots of the current half holding a parser state, in
+  // output order.
+  std::vector<int> ActiveSlots() const {
+    std::vector<int> slots;
+    for (int i = slot_begin_; i < slot_end_; ++i) {
+      if (states_[i] != nullptr) slots.push_back(i);
+    }
+    return slots;
+  }
+
+  // Runs work over [0, total) on the device thread pool. Feature extraction
+  // only reads the parser states and workspaces, so slots can be processed in
+  // parallel as long as each writes its own outputs.
+  static void ParallelFor(OpKernelContext *context, int64 total,
+                          std::function<void(int64, int64)> work) {
+    const auto &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    tensorflow::Shard(worker_threads.num_threads, worker_threads.workers,
+                      total, kFeatureExtractionCost, work);
+  }
+
+  // Rough cost in cycles of extracting the features of one parser state.
+  static const int64 kFeatureExtractionCost = 50000;
+
+  // Number of outputs holding the features, preceding the epoch output.
+  int num_feature_outputs() const {
+    return packed_features_ ? 3 * feature_size_ + 1 : feature_size_;
+  }
+
+  // Updates the sparse features of the state in slot i from the last step.
+  // Features whose values did not change are reused as they are.
+  const std::vector<std::vector<SparseFeatures>> &UpdateFeatures(int i) {
+    SparseFeaturesMemo *memo = &feature_memos_[i];
+    features_->UpdateSparseFeatures(workspaces_[i], *states_[i], memo);
+    return memo->features;
+  }
+
+  // Outputs the features of each feature space as a [batch_size, feature_size]
+  // matrix of serialized SparseFeatures protos. Features that did not change
+  // since the last step reuse their serialization.
+  void AddSerializedFeatureOutputs(OpKernelContext *context,
+                                   const std::vector<int> &slots) {
+    vector<Tensor *> feature_outputs(features_->NumEmbeddings());
+    for (size_t i = 0; i < feature_outputs.size(); ++i) {
+      OP_REQUIRES_OK(context,
+                     context->allocate_output(
+                         i, TensorShape({static_cast<int64>(slots.size()),
+                                         features_->FeatureSize(i)}),
+                         &feature_outputs[i]));
+    }
+
+    // Extract features from the current parser states, and fill up the
+    // available batch slots.
+    ParallelFor(context, slots.size(), [this, &slots, &feature_outputs](
+                                           int64 start, int64 limit) {
+      for (int64 index = start; index < limit; ++index) {
+        const int i = slots[index];
+        const std::vector<std::vector<SparseFeatures>> &features =
+            UpdateFeatures(i);
+        const std::vector<std::vector<bool>> &changed =
+            feature_memos_[i].changed;
+        std::vector<std::vector<string>> &serialized = serialized_features_[i];
+        serialized.resize(features.size());
+
+        for (size_t feature_space = 0; feature_space < features.size();
+             ++feature_space) {
+          int feature_size = features[feature_space].size();
+          CHECK(feature_size == features_->FeatureSize(feature_space));
+          serialized[feature_space].resize(feature_size);
+          auto features_output =
+              feature_outputs[feature_space]->matrix<string>();
+          for (int k = 0; k < feature_size; ++k) {
+            if (changed[feature_space][k]) {
+              serialized[feature_space][k] =
+                  features[feature_space][k].SerializeAsString();
+            }
+            features_output(index, k) = serialized[feature_space][k];
+          }
+        }
+      }
+    });
+  }
+
+  // Outputs the features of each feature space as three vectors holding the
+  // index into the flattened [batch_size, feature_size] feature matrix, the id
+  // and the weight of each feature id, followed by the batch size.
+  //
+  // The vectors are allocated as GPU compatible, so that in a process with
+  // GPUs they come from the pool of pinned host memory, which is reused across
+  // steps and which copies to a network on a GPU read by DMA without staging
+  // them through pageable memory. Without GPUs they are ordinary host memory.
+  void AddPackedFeatureOutputs(OpKernelContext *context,
+                               const std::vector<int> &slots) {
+    const int num_spaces = features_->NumEmbeddings();
+
+    // Extracts all features first, since the output sizes depend on the number
+    // of ids firing in each feature space.
+    std::vector<const std::vector<std::vector<SparseFeatures>> *> features(
+        slots.size());
+    ParallelFor(context, slots.size(),
+                [this, &slots, &features](int64 start, int64 limit) {
+                  for (int64 index = start; index < limit; ++index) {
+                    features[index] = &UpdateFeatures(slots[index]);
+                  }
+                });
+    std::vector<int64> num_ids(num_spaces, 0);
+    for (const auto *slot_features : features) {
+      for (int feature_space = 0; feature_space < num_spaces; ++feature_space) {
+        CHECK((*slot_features)[feature_space].size() ==
+              features_->FeatureSize(feature_space));
+        for (const SparseFeatures &f : (*slot_features)[feature_space]) {
+          num_ids[feature_space] += f.id_size();
+        }
+      }
+    }
+
+    AllocatorAttributes pinned;
+    pinned.set_gpu_compatible(true);
+    for (int feature_space = 0; feature_space < num_spaces; ++feature_space) {
+      Tensor *indices_t;
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  feature_space,
+                                  TensorShape({num_ids[feature_space]}),
+                                  &indices_t, pinned));
+      Tensor *ids_t;
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  num_spaces + feature_space,
+                                  TensorShape({num_ids[feature_space]}),
+                                  &ids_t, pinned));
+      Tensor *weights_t;
+      OP_REQUIRES_OK(context, context->allocate_output(
+                                  2 * num_spaces + feature_space,
+                                  TensorShape({num_ids[feature_space]}),
+                                  &weights_t, pinned));
+      auto indices = indices_t->vec<int32>();
+      auto ids = ids_t->vec<int64>();
+      auto weights = weights_t->vec<float>();
+      const int feature_size = features_->FeatureSize(feature_space);
+      int c = 0;
+      for (size_t index = 0; index < features.size(); ++index) {
+        for (int k = 0; k < feature_size; ++k) {
+          const SparseFeatures &f = (*features[index])[feature_space][k];
+          OP_REQUIRES(context,
+                      f.weight_size() == 0 || f.weight_size() == f.id_size(),
+                      InvalidArgument("Incorrect number of weights: ",
+                                      f.DebugString()));
+          for (int j = 0; j < f.id_size(); ++j) {
+            indices(c) = index * feature_size + k;
+            ids(c) = f.id(j);
+            weights(c) = f.weight_size() > 0 ? f.weight(j) : 1.0f;
+            ++c;
+          }
+        }
+      }
+    }
+
+    Tensor *batch_size_output;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                3 * num_spaces, TensorShape({}),
+                                &batch_size_output));
+    batch_size_output->scalar<int32>()() = features.size();
+  }
+
+  // Whether to output packed features rather than serialized protos.
+  const bool packed_features_;
+
   // Task context used to configure this op.
   TaskContext task_context_;
 
@@ -230,12 +531,36 @@ class ParsingReader : public OpKernel {
   // How many sentences this op can be processing at any given time.
   int max_batch_size_ = 1;
 
+  // How many sentences this op is currently allowed to process at a time.
+  int max_active_slots_ = 1;
+
+  // Whether the active slot limit has been set, so that empty slots need to
+  // be refilled when it is raised.
+  bool limit_active_slots_ = false;
+
+  // Whether deterministic states are advanced without being scored.
+  bool skip_deterministic_states_ = false;
+
+  // Whether the halves of the batch slots are processed in alternate steps,
+  // the current half, and the range of its slots, which spans all slots
+  // unless ping-ponging.
+  bool ping_pong_ = false;
+  int half_ = 0;
+  int slot_begin_ = 0;
+  int slot_end_ = 0;
+
+  // Number of states whose features were last emitted, by half.
+  int num_emitted_[2] = {0, 0};
+
   // Number of feature groups in the brain parser features.
   int feature_size_ = -1;
 
   // Batch of sentences, and the corresponding parser states.
   std::unique_ptr<SentenceBatch> sentence_batch_;
 
+  // Storage of the parser states. Declared before the states, which use it.
+  ParserStateArena state_arena_;
+
   // Batch: ParserState objects.
   std::vector<std::unique_ptr<ParserState>> states_;
 
@@ -248,19 +573,24 @@ class ParsingReader : public OpKernel {
   // Transition system.
   std::unique_ptr<ParserTransitionSystem> transition_system_;
 
-  // Typed feature extractor for embeddings.
-  std::unique_ptr<ParserEmbeddingFeatureExtractor> features_;
+  // Typed feature extractor for embeddings, and the shared features it belongs
+  // to, which also hold the workspace registry for feature extraction.
+  const SharedParserFeatures *shared_features_ = nullptr;
+  const ParserEmbeddingFeatureExtractor *features_ = nullptr;
 
-  // Internal workspace registry for use in feature extraction.
-  WorkspaceRegistry workspace_registry_;
+  // Batch: sparse features of the last step, and their serializations when
+  // outputting serialized features.
+  std::vector<SparseFeaturesMemo> feature_memos_;
+  std::vector<std::vector<std::vector<string>>> serialized_features_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(ParsingReader);
 };
 
 class GoldParseReader : public ParsingReader {
  public:
-  explicit GoldParseReader(OpKernelConstruction *context)
-      : ParsingReader(context) {
+  explicit GoldParseReader(OpKernelConstruction *context,
+                           bool packed_features = false)
+      : ParsingReader(context, packed_features) {
     // Sets up number and type of inputs and outputs.
     std::vector<DataType> output_types = default_outputs();
     output_types.push_back(DT_INT32);
@@ -302,6 +632,16 @@ class GoldParseReader : public ParsingReader {
 REGISTER_KERNEL_BUILDER(Name("GoldParseReader").Device(DEVICE_CPU),
                         GoldParseReader);
 
+// GoldParseReader emitting packed rather than serialized features.
+class PackedGoldParseReader : public GoldParseReader {
+ public:
+  explicit PackedGoldParseReader(OpKernelConstruction *context)
+      : GoldParseReader(context, true) {}
+};
+
+REGISTER_KERNEL_BUILDER(Name("PackedGoldParseReader").Device(DEVICE_CPU),
+                        PackedGoldParseReader);
+
 // DecodedParseReader parses sentences using transition scores computed
 // by a TensorFlow network. This op additionally computes a token correctness
 // evaluation metric which can be used to select hyperparameter settings and
@@ -317,27 +657,111 @@ REGISTER_KERNEL_BUILDER(Name("GoldParseReader").Device(DEVICE_CPU),
 //   - 'conllx': skips tokens with only punctuation in the surface form.
 //   - 'ignore_parens': same as conllx, but skipping parentheses as well.
 //   - '': scores all tokens.
+//
+// Parsed documents are returned in input order by default, so a long sentence
+// holds back all sentences read after it. With in_order=false, each document
+// is returned as soon as it is parsed, and documents without a docid get their
+// zero-based position in the input as docid, so callers can match them to
+// their requests. With max_batch_latency_ms > 0, the reader additionally
+// adapts the number of sentences parsed at a time, up to batch_size, to keep
+// the wall time between two consecutive steps below the given target, using a
+// cost model of its steps and the backlog of its input; see
+// BatchSizeController. With
+// skip_deterministic_states=true, states with a single allowed action are
+// advanced with the default action of the transition system and left out of
+// the features, so only states with a choice are scored by the network. With
+// ping_pong=true, the batch is split into two halves of sentences processed
+// in alternate steps, and each step takes the scores of the features emitted
+// two steps earlier, so that the network can score one half while the reader
+// advances the other; see AddEvaluation in graph_builder.py. With
+// parse_cache_bytes > 0, parsed documents are cached by their input tokens and
+// model_id in a ParseCache shared by the readers of the process, and repeated
+// sentences are output from the cache without being parsed again. Cached
+// sentences are not counted in the evaluation metrics. With slim_output=true,
+// the parses are returned as flat head and label id tensors instead of
+// serialized documents, which then only hold the docids.
 class DecodedParseReader : public ParsingReader {
  public:
-  explicit DecodedParseReader(OpKernelConstruction *context)
-      : ParsingReader(context) {
+  explicit DecodedParseReader(OpKernelConstruction *context,
+                              bool packed_features = false)
+      : ParsingReader(context, packed_features) {
     // Sets up number and type of inputs and outputs.
     std::vector<DataType> output_types = default_outputs();
     output_types.push_back(DT_INT32);
     output_types.push_back(DT_STRING);
+    output_types.push_back(DT_INT32);
+    output_types.push_back(DT_INT32);
+    output_types.push_back(DT_INT32);
     OP_REQUIRES_OK(context, context->MatchSignature({DT_FLOAT}, output_types));
 
     // Gets scoring parameters.
     scoring_type_ = task_context().Get(
         tensorflow::strings::StrCat(arg_prefix(), "_scoring"), "");
+
+    // Gets batching parameters.
+    OP_REQUIRES_OK(context, context->GetAttr("in_order", &in_order_));
+    OP_REQUIRES_OK(context, context->GetAttr("slim_output", &slim_output_));
+    OP_REQUIRES_OK(context, context->GetAttr("max_batch_latency_ms",
+                                             &max_batch_latency_ms_));
+    OP_REQUIRES(context, max_batch_latency_ms_ >= 0,
+                InvalidArgument("max_batch_latency_ms must be non-negative"));
+    if (max_batch_latency_ms_ > 0) {
+      batch_size_controller_.reset(new BatchSizeController(
+          max_batch_size(), 1000LL * max_batch_latency_ms_));
+    }
+    bool skip_deterministic_states;
+    OP_REQUIRES_OK(context, context->GetAttr("skip_deterministic_states",
+                                             &skip_deterministic_states));
+    set_skip_deterministic_states(skip_deterministic_states);
+    bool ping_pong;
+    OP_REQUIRES_OK(context, context->GetAttr("ping_pong", &ping_pong));
+    OP_REQUIRES(context, !ping_pong || max_batch_size() >= 2,
+                InvalidArgument("ping_pong requires batch_size >= 2"));
+    OP_REQUIRES(context, !ping_pong || max_batch_latency_ms_ == 0,
+                InvalidArgument(
+                    "ping_pong is incompatible with max_batch_latency_ms"));
+    set_ping_pong(ping_pong);
+
+    // Sets up the parse cache. The model is identified by the task context,
+    // which holds the features and resources, and by the model id.
+    int parse_cache_bytes;
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("parse_cache_bytes", &parse_cache_bytes));
+    string model_id;
+    OP_REQUIRES_OK(context, context->GetAttr("model_id", &model_id));
+    if (parse_cache_bytes > 0) {
+      parse_cache_ = ParseCache::Get(parse_cache_bytes);
+      model_key_ = ParseCache::ModelKey(tensorflow::strings::StrCat(
+          arg_prefix(), "\n", task_context().spec().SerializeAsString(),
+          "\n", model_id));
+      cache_keys_.resize(max_batch_size());
+    }
   }
 
+  ~DecodedParseReader() override { ParseCache::Release(parse_cache_); }
+
  private:
-  void AdvanceSentence(int index) override {
-    ParsingReader::AdvanceSentence(index);
-    if (state(index)) {
-      docids_.push_front(state(index)->sentence().docid());
-    }
+  // A document to output, and whether its sentence has been completely
+  // processed. Holds the serialized document, or for slim outputs its docid
+  // and the head and label id of each token.
+  struct OutputDocument {
+    string serialized;
+    std::vector<int32> heads;
+    std::vector<int32> labels;
+    bool ready = false;
+  };
+
+  // Feeds the wall time of the last step, the number of sentences it parsed
+  // and the backlog of the input to the batch size controller, and limits the
+  // active slots to the batch size it returns.
+  void AdaptActiveSlots() {
+    const int64 now = tensorflow::Env::Default()->NowMicros();
+    const int64 step_micros = now - last_step_micros_;
+    const bool first_step = last_step_micros_ == 0;
+    last_step_micros_ = now;
+    if (first_step) return;
+    set_max_active_slots(
+        batch_size_controller_->Update(batch_size(), step_micros, backlog()));
   }
 
   // Tallies the # of correct and incorrect tokens for a given ParserState.
@@ -355,34 +779,129 @@ class DecodedParseReader : public ParsingReader {
   // Performs the allowed action with the highest score on the given state.
   // Also records the accuracy whenver a terminal action is taken.
   void PerformActions(OpKernelContext *context) override {
-    auto scores_matrix = context->input(0).matrix<float>();
+    if (max_batch_latency_ms_ > 0) AdaptActiveSlots();
     num_tokens_ = 0;
     num_correct_ = 0;
-    for (int i = 0, batch_index = 0; i < max_batch_size(); ++i) {
+
+    // When ping-ponging, the scores are those of the features last emitted
+    // for the current half, if there were any.
+    if (ping_pong()) {
+      if (num_scored() == 0) return;
+      OP_REQUIRES(context, context->input(0).dims() == 2 &&
+                               context->input(0).dim_size(0) == num_scored(),
+                  InvalidArgument("Expected scores for ", num_scored(),
+                                  " states, got shape ",
+                                  context->input(0).shape().DebugString()));
+    }
+    auto scores_matrix = context->input(0).matrix<float>();
+    const int num_actions = scores_matrix.dimension(1);
+    active_slots_.clear();
+    active_states_.clear();
+    best_actions_.clear();
+    for (int i = slot_begin(); i < slot_end(); ++i) {
       ParserState *state = this->state(i);
       if (state != nullptr) {
-        int best_action = 0;
-        float best_score = -INFINITY;
-        for (int action = 0; action < scores_matrix.dimension(1); ++action) {
-          float score = scores_matrix(batch_index, action);
-          if (score > best_score &&
-              transition_system().IsAllowedAction(action, *state)) {
-            best_action = action;
-            best_score = score;
-          }
-        }
-        transition_system().PerformAction(best_action, state);
-
-        // Update the # of scored correct tokens if this is the last state
-        // in the sentence and save the annotated document.
-        if (transition_system().IsFinalState(*state)) {
-          ComputeTokenAccuracy(*state);
-          sentence_map_[state->sentence().docid()] = state->sentence();
-          state->AddParseToDocument(&sentence_map_[state->sentence().docid()]);
-        }
-        ++batch_index;
+        const int batch_index = active_states_.size();
+        active_slots_.push_back(i);
+        active_states_.push_back(state);
+        best_actions_.push_back(transition_system().BestAllowedAction(
+            *state, scores_matrix.data() + batch_index * num_actions,
+            num_actions, &allowed_actions_));
       }
     }
+    is_final_.resize(active_states_.size());
+    string trace_ids;
+    for (const ParserState *state : active_states_) {
+      AddTraceId(state->sentence(), &trace_ids);
+    }
+    SentenceSpan span("decode_step", trace_ids);
+    transition_system().PerformActions(best_actions_.data(),
+                                       active_states_.data(),
+                                       active_states_.size(), is_final_.data());
+    for (size_t index = 0; index < active_slots_.size(); ++index) {
+      if (is_final_[index]) FinishState(active_slots_[index]);
+    }
+  }
+
+  // Updates the # of scored correct tokens with the final state in slot i and
+  // saves the annotated document, caching its parse. The parse is added to the
+  // batch's own copy of the sentence, which is not read again before the slot
+  // advances. Slim outputs take the parse from the state instead, and only
+  // annotate the sentence for the cache.
+  void FinishState(int i) override {
+    const ParserState &state = *this->state(i);
+    ComputeTokenAccuracy(state);
+    Sentence *document = state.mutable_sentence();
+    if (!slim_output_ || parse_cache_ != nullptr) {
+      state.AddParseToDocument(document);
+    }
+    if (parse_cache_ != nullptr) {
+      parse_cache_->Insert(cache_keys_[i], *document);
+    }
+    OutputDocument *output = SaveDocument(i, document);
+    if (slim_output_) {
+      output->heads.resize(state.NumTokens());
+      output->labels.resize(state.NumTokens());
+      for (int t = 0; t < state.NumTokens(); ++t) {
+        output->heads[t] = state.Head(t);
+        output->labels[t] =
+            state.Head(t) == -1 ? state.RootLabel() : state.Label(t);
+      }
+    }
+  }
+
+  // Outputs the sentence in slot i from the parse cache if it is cached, and
+  // otherwise remembers its key for caching its parse. A lookup that misses
+  // leaves the sentence unchanged.
+  bool SkipSentence(int i) override {
+    if (parse_cache_ == nullptr) return false;
+    cache_keys_[i] = ParseCache::Key(model_key_, sentence(i));
+    Sentence *document = mutable_sentence(i);
+    if (!parse_cache_->Lookup(cache_keys_[i], document)) return false;
+    OutputDocument *output = SaveDocument(i, document);
+    if (slim_output_) {
+      // Root tokens have the root label, as from FinishState().
+      output->heads.reserve(document->token_size());
+      output->labels.reserve(document->token_size());
+      for (const Token &token : document->token()) {
+        const bool is_root = token.head() == -1;
+        output->heads.push_back(is_root ? -1 : token.head());
+        output->labels.push_back(
+            is_root ? ParserState::kDefaultRootLabel
+                    : label_map().LookupIndex(token.label(),
+                                              ParserState::kDefaultRootLabel));
+      }
+    }
+    return true;
+  }
+
+  // Saves the annotated document of the sentence in slot i for output, and
+  // returns its output, serialized or, for slim outputs, holding its docid. In
+  // order, the output waits for its input position until all earlier
+  // documents are done.
+  OutputDocument *SaveDocument(int i, Sentence *document) {
+    OutputDocument *output;
+    if (in_order_) {
+      const int64 offset = sequence(i) - next_sequence_;
+      DCHECK_GE(offset, 0);
+      if (offset >= static_cast<int64>(pending_.size())) {
+        pending_.resize(offset + 1);
+      }
+      output = &pending_[offset];
+    } else {
+      if (document->docid().empty()) {
+        document->set_docid(tensorflow::strings::StrCat(sequence(i)));
+      }
+      finished_.emplace_back();
+      output = &finished_.back();
+    }
+    if (slim_output_) {
+      output->serialized = document->docid();
+    } else {
+      document->SerializeToString(&output->serialized);
+    }
+    output->ready = true;
+    return output;
   }
 
   // Adds the evaluation metrics and annotated documents as additional outputs,
@@ -397,27 +916,67 @@ class DecodedParseReader : public ParsingReader {
     eval_metrics(1) = num_correct_;
 
     // Output annotated documents for each state. To preserve order, repeatedly
-    // pull from the back of the docids queue as long as the sentences have been
-    // completely processed. If the next document has not been completely
-    // processed yet, then the docid will not be found in 'sentence_map_'.
-    vector<Sentence> sentences;
-    while (!docids_.empty() &&
-           sentence_map_.find(docids_.back()) != sentence_map_.end()) {
-      sentences.emplace_back(sentence_map_[docids_.back()]);
-      sentence_map_.erase(docids_.back());
-      docids_.pop_back();
+    // pull the document at the next input position as long as the sentences
+    // have been completely processed, i.e. as long as the front of 'pending_'
+    // is ready. Out of order, all documents finished in this step are output.
+    vector<OutputDocument> documents;
+    documents.swap(finished_);
+    while (!pending_.empty() && pending_.front().ready) {
+      documents.emplace_back(std::move(pending_.front()));
+      pending_.pop_front();
+      ++next_sequence_;
     }
     Tensor *annotated_output;
     OP_REQUIRES_OK(context,
                    context->allocate_output(
                        additional_output_index() + 1,
-                       TensorShape({static_cast<int64>(sentences.size())}),
+                       TensorShape({static_cast<int64>(documents.size())}),
                        &annotated_output));
 
     auto document_output = annotated_output->vec<string>();
-    for (size_t i = 0; i < sentences.size(); ++i) {
-      document_output(i) = sentences[i].SerializeAsString();
+    for (size_t i = 0; i < documents.size(); ++i) {
+      document_output(i).swap(documents[i].serialized);
     }
+    AddSlimOutputs(context, documents);
+  }
+
+  // Outputs the concatenated heads and labels of the documents, and the offset
+  // of the first token of each document followed by the number of tokens.
+  // These outputs are empty unless slim_output is true.
+  void AddSlimOutputs(OpKernelContext *context,
+                      const vector<OutputDocument> &documents) const {
+    int64 num_tokens = 0;
+    for (const OutputDocument &document : documents) {
+      num_tokens += document.heads.size();
+    }
+    const int first_output = additional_output_index() + 2;
+    Tensor *heads_output;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                first_output, TensorShape({num_tokens}),
+                                &heads_output));
+    Tensor *labels_output;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                first_output + 1, TensorShape({num_tokens}),
+                                &labels_output));
+    Tensor *starts_output;
+    const int64 num_starts = slim_output_ ? documents.size() + 1 : 0;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                first_output + 2, TensorShape({num_starts}),
+                                &starts_output));
+    if (!slim_output_) return;
+    int32 *heads = heads_output->vec<int32>().data();
+    int32 *labels = labels_output->vec<int32>().data();
+    auto starts = starts_output->vec<int32>();
+    int32 start = 0;
+    for (size_t i = 0; i < documents.size(); ++i) {
+      starts(i) = start;
+      const OutputDocument &document = documents[i];
+      std::copy(document.heads.begin(), document.heads.end(), heads + start);
+      std::copy(document.labels.begin(), document.labels.end(),
+                labels + start);
+      start += document.heads.size();
+    }
+    starts(documents.size()) = start;
   }
 
   // State for eval metric computation.
@@ -427,8 +986,44 @@ class DecodedParseReader : public ParsingReader {
   // Parameter for deciding which tokens to score.
   string scoring_type_;
 
-  mutable std::deque<string> docids_;
-  mutable map<string, Sentence> sentence_map_;
+  // Documents waiting for their turn in input order, indexed by input position
+  // minus the input position of the next document to output.
+  mutable std::deque<OutputDocument> pending_;
+  mutable int64 next_sequence_ = 0;
+
+  // Whether to output documents in input order.
+  bool in_order_ = true;
+
+  // Documents finished in the current step, when output out of order.
+  mutable vector<OutputDocument> finished_;
+
+  // Whether to output flat heads and labels instead of serialized documents.
+  bool slim_output_ = false;
+
+  // Target wall time of a step, or 0 to always parse batch_size sentences.
+  int max_batch_latency_ms_ = 0;
+
+  // Wall time at the start of the last step, or 0 before the first step.
+  int64 last_step_micros_ = 0;
+
+  // Chooses the number of active slots when max_batch_latency_ms_ is positive.
+  std::unique_ptr<BatchSizeController> batch_size_controller_;
+
+  // Scratch buffer for the allowed actions of a state.
+  std::vector<uint8> allowed_actions_;
+
+  // Scratch buffers for the slots, states, transitions and final flags of the
+  // states taking a transition.
+  std::vector<int> active_slots_;
+  std::vector<ParserState *> active_states_;
+  std::vector<ParserAction> best_actions_;
+  std::vector<uint8> is_final_;
+
+  // Shared cache of parsed documents, if any, the key of the model, and the
+  // cache keys of the sentences in the batch slots.
+  ParseCache *parse_cache_ = nullptr;
+  uint64 model_key_ = 0;
+  std::vector<uint64> cache_keys_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(DecodedParseReader);
 };
@@ -436,6 +1031,76 @@ class DecodedParseReader : public ParsingReader {
 REGISTER_KERNEL_BUILDER(Name("DecodedParseReader").Device(DEVICE_CPU),
                         DecodedParseReader);
 
+// DecodedParseReader emitting packed rather than serialized features.
+class PackedDecodedParseReader : public DecodedParseReader {
+ public:
+  explicit PackedDecodedParseReader(OpKernelConstruction *context)
+      : DecodedParseReader(context, true) {}
+};
+
+REGISTER_KERNEL_BUILDER(Name("PackedDecodedParseReader").Device(DEVICE_CPU),
+                        PackedDecodedParseReader);
+
+// Serves the reads of a sequential reader, such as a RecordReader, from a
+// buffer filled by large reads of the underlying file. Records can then be
+// read from remote file systems without first copying the file locally.
+class SequentialReadBuffer : public tensorflow::RandomAccessFile {
+ public:
+  SequentialReadBuffer(std::unique_ptr<tensorflow::RandomAccessFile> file,
+                       size_t buffer_size)
+      : file_(std::move(file)), buffer_size_(buffer_size) {}
+
+  tensorflow::Status Read(uint64 offset, size_t n,
+                          tensorflow::StringPiece *result,
+                          char *scratch) const override {
+    mutex_lock lock(mu_);
+    if (offset < buffer_offset_ ||
+        offset + n > buffer_offset_ + buffer_.size()) {
+      if (n > buffer_size_) return file_->Read(offset, n, result, scratch);
+      TF_RETURN_IF_ERROR(Fill(offset));
+    }
+    const uint64 start = offset - buffer_offset_;
+    const size_t available =
+        start < buffer_.size() ? std::min<size_t>(n, buffer_.size() - start)
+                               : 0;
+    memcpy(scratch, buffer_.data() + start, available);
+    *result = tensorflow::StringPiece(scratch, available);
+    if (available < n) {
+      return tensorflow::errors::OutOfRange("Read past the end of file");
+    }
+    return tensorflow::Status::OK();
+  }
+
+ private:
+  // Reads up to buffer_size_ bytes at the given offset into the buffer.
+  tensorflow::Status Fill(uint64 offset) const {
+    buffer_.resize(buffer_size_);
+    tensorflow::StringPiece data;
+    const tensorflow::Status status =
+        file_->Read(offset, buffer_size_, &data, &buffer_[0]);
+    if (!status.ok() && status.code() != OUT_OF_RANGE) {
+      buffer_.clear();
+      return status;
+    }
+    if (data.data() != buffer_.data()) {
+      memmove(&buffer_[0], data.data(), data.size());
+    }
+    buffer_.resize(data.size());
+    buffer_offset_ = offset;
+    return tensorflow::Status::OK();
+  }
+
+  std::unique_ptr<tensorflow::RandomAccessFile> file_;
+  const size_t buffer_size_;
+
+  // Contents of the file from buffer_offset_ on.
+  mutable mutex mu_;
+  mutable string buffer_;
+  mutable uint64 buffer_offset_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SequentialReadBuffer);
+};
+
 class WordEmbeddingInitializer : public OpKernel {
  public:
   explicit WordEmbeddingInitializer(OpKernelConstruction *context)
@@ -450,6 +1115,7 @@ class WordEmbeddingInitializer : public OpKernel {
     OP_REQUIRES_OK(context, context->GetAttr("vectors", &vectors_path_));
     OP_REQUIRES_OK(context,
                    context->GetAttr("embedding_init", &embedding_init_));
+    OP_REQUIRES_OK(context, generator_.Init(context));
 
     // Sets up number and type of inputs and outputs.
     OP_REQUIRES_OK(context, context->MatchSignature({}, {DT_FLOAT}));
@@ -460,86 +1126,157 @@ class WordEmbeddingInitializer : public OpKernel {
     string path = TaskContext::InputFile(*task_context_.GetInput("word-map"));
     const TermFrequencyMap *word_map =
         SharedStoreUtils::GetWithDefaultName<TermFrequencyMap>(path, 0, 0);
-    unordered_map<string, int64> vocab;
+    std::vector<string> terms(word_map->Size());
+    tensorflow::gtl::FlatHashMap<tensorflow::StringPiece, int64,
+                                 tensorflow::StringPiece::Hasher>
+        vocab(word_map->Size());
     for (int i = 0; i < word_map->Size(); ++i) {
-      vocab[word_map->GetTerm(i)] = i;
+      terms[i] = word_map->GetTerm(i);
+      vocab[terms[i]] = i;
+    }
+    const int num_words = word_map->Size();
+    SharedStore::Release(word_map);
+
+    // Creates a reader of the vectors recordio that reads the records in
+    // place if the file can be mapped, and otherwise reads it in large chunks.
+    std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region;
+    std::unique_ptr<tensorflow::RandomAccessFile> buffer;
+    std::unique_ptr<tensorflow::io::RecordReader> reader;
+    tensorflow::Env *env = tensorflow::Env::Default();
+    if (env->NewReadOnlyMemoryRegionFromFile(vectors_path_, &region).ok()) {
+      reader.reset(new tensorflow::io::RecordReader(region.get()));
+    } else {
+      std::unique_ptr<tensorflow::RandomAccessFile> file;
+      OP_REQUIRES_OK(context, env->NewRandomAccessFile(vectors_path_, &file));
+      buffer.reset(new SequentialReadBuffer(std::move(file), kReadBufferSize));
+      reader.reset(new tensorflow::io::RecordReader(buffer.get()));
     }
 
-    // Creates a reader pointing to a local copy of the vectors recordio.
-    string tmp_vectors_path;
-    OP_REQUIRES_OK(context, CopyToTmpPath(vectors_path_, &tmp_vectors_path));
-    ProtoRecordReader reader(tmp_vectors_path);
-
-    // Loads the embedding vectors into a matrix.
+    // Loads the embedding vectors into a matrix. Only the records of words in
+    // the vocabulary, and the first one for the embedding size, are parsed.
     Tensor *embedding_matrix = nullptr;
     TokenEmbedding embedding;
-    while (reader.Read(&embedding) == tensorflow::Status::OK()) {
+    tensorflow::StringPiece record;
+    uint64 offset = 0;
+    while (true) {
+      const tensorflow::Status status = reader->ReadRecord(&offset, &record);
+      if (status.code() == OUT_OF_RANGE) break;
+      OP_REQUIRES_OK(context, status);
+      tensorflow::StringPiece token;
+      if (embedding_matrix != nullptr && ReadToken(record, &token) &&
+          vocab.find(token) == vocab.end()) {
+        continue;
+      }
+      OP_REQUIRES(
+          context, embedding.ParseFromArray(record.data(), record.size()),
+          InvalidArgument("Could not parse embedding at offset ", offset,
+                          " of ", vectors_path_));
       if (embedding_matrix == nullptr) {
         const int embedding_size = embedding.vector().values_size();
         OP_REQUIRES_OK(
             context, context->allocate_output(
-                         0, TensorShape({word_map->Size() + 3, embedding_size}),
+                         0, TensorShape({num_words + 3, embedding_size}),
                          &embedding_matrix));
-        embedding_matrix->matrix<float>()
-            .setRandom<Eigen::internal::NormalRandomGenerator<float>>();
-        embedding_matrix->matrix<float>() =
-            embedding_matrix->matrix<float>() * static_cast<float>(
-                embedding_init_ / sqrt(embedding_size));
+        FillNormal(context, embedding_init_ / sqrt(embedding_size),
+                   embedding_matrix);
       }
-      if (vocab.find(embedding.token()) != vocab.end()) {
-        SetNormalizedRow(embedding.vector(), vocab[embedding.token()],
-                         embedding_matrix);
+      const auto it = vocab.find(embedding.token());
+      if (it != vocab.end()) {
+        OP_REQUIRES(context, embedding.vector().values_size() ==
+                                 embedding_matrix->dim_size(1),
+                    InvalidArgument("Embedding of ", embedding.token(),
+                                    " does not have ",
+                                    embedding_matrix->dim_size(1), " values"));
+        SetNormalizedRow(embedding.vector(), it->second, embedding_matrix);
       }
     }
   }
 
  private:
+  // Size of the reads of the vectors file.
+  static const size_t kReadBufferSize = 16 << 20;
+
+  // Finds the token of a serialized TokenEmbedding without parsing the rest of
+  // it. Returns false if the record could not be scanned for it.
+  static bool ReadToken(tensorflow::StringPiece record,
+                        tensorflow::StringPiece *token) {
+    tensorflow::protobuf::io::CodedInputStream input(
+        reinterpret_cast<const uint8 *>(record.data()), record.size());
+    while (true) {
+      const uint32 tag = input.ReadTag();
+      if (tag == 0) return false;
+      const int field_number = tag >> 3;
+      tensorflow::protobuf::uint32 length;
+      tensorflow::protobuf::uint32 fixed32;
+      tensorflow::protobuf::uint64 value;
+      switch (tag & 7) {
+        case 0:  // varint
+          if (!input.ReadVarint64(&value)) return false;
+          break;
+        case 1:  // fixed64
+          if (!input.ReadLittleEndian64(&value)) return false;
+          break;
+        case 2:  // length-delimited
+          if (!input.ReadVarint32(&length)) return false;
+          if (field_number == TokenEmbedding::kTokenFieldNumber) {
+            const int position = input.CurrentPosition();
+            if (position + length > record.size()) return false;
+            *token = tensorflow::StringPiece(record.data() + position, length);
+            return true;
+          }
+          if (!input.Skip(length)) return false;
+          break;
+        case 5:  // fixed32
+          if (!input.ReadLittleEndian32(&fixed32)) return false;
+          break;
+        default:  // groups and unknown wire types
+          return false;
+      }
+    }
+  }
+
+  // Fills the matrix with samples of a normal distribution with zero mean and
+  // the given standard deviation. The groups of samples of one Philox draw
+  // are sharded across the worker threads, and each shard skips the generator
+  // ahead to its first group, so the samples do not depend on the sharding.
+  void FillNormal(OpKernelContext *context, float stddev, Tensor *matrix) {
+    typedef tensorflow::random::PhiloxRandom Generator;
+    typedef tensorflow::random::NormalDistribution<Generator, float>
+        Distribution;
+    const int64 kGroupSize = Distribution::kResultElementCount;
+    float *data = matrix->flat<float>().data();
+    const int64 size = matrix->NumElements();
+    const int64 num_groups = (size + kGroupSize - 1) / kGroupSize;
+    const Generator base_generator = generator_.ReserveSamples128(num_groups);
+    auto fill = [&](int64 begin, int64 end) {
+      Generator generator = base_generator;
+      generator.Skip(begin);
+      Distribution distribution;
+      for (int64 group = begin; group < end; ++group) {
+        const auto samples = distribution(&generator);
+        const int64 offset = group * kGroupSize;
+        const int64 count = std::min(kGroupSize, size - offset);
+        for (int64 i = 0; i < count; ++i) {
+          data[offset + i] = samples[i] * stddev;
+        }
+      }
+    };
+    const auto &worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    tensorflow::Shard(
+        worker_threads.num_threads, worker_threads.workers, num_groups,
+        kGroupSize * (Generator::kElementCost + Distribution::kElementCost),
+        fill);
+  }
+
   // Sets embedding_matrix[row] to a normalized version of the given vector.
   void SetNormalizedRow(const TokenEmbedding::Vector &vector, const int row,
                         Tensor *embedding_matrix) {
-    float norm = 0.0f;
-    for (int col = 0; col < vector.values_size(); ++col) {
-      float val = vector.values(col);
-      norm += val * val;
-    }
-    norm = sqrt(norm);
-    for (int col = 0; col < vector.values_size(); ++col) {
-      embedding_matrix->matrix<float>()(row, col) = vector.values(col) / norm;
-    }
-  }
-
-  // Copies the file at source_path to a temporary file and sets tmp_path to the
-  // temporary file's location. This is helpful since reading from non local
-  // files with a record reader can be very slow.
-  static tensorflow::Status CopyToTmpPath(const string &source_path,
-                                          string *tmp_path) {
-    // Opens source file.
-    std::unique_ptr<tensorflow::RandomAccessFile> source_file;
-    TF_RETURN_IF_ERROR(tensorflow::Env::Default()->NewRandomAccessFile(
-        source_path, &source_file));
-
-    // Creates destination file.
-    std::unique_ptr<tensorflow::WritableFile> target_file;
-    *tmp_path = tensorflow::strings::Printf(
-        "/tmp/%d.%lld", getpid(), tensorflow::Env::Default()->NowMicros());
-    TF_RETURN_IF_ERROR(
-        tensorflow::Env::Default()->NewWritableFile(*tmp_path, &target_file));
-
-    // Performs copy.
-    tensorflow::Status s;
-    const size_t kBytesToRead = 10 << 20;  // 10MB at a time.
-    string scratch;
-    scratch.resize(kBytesToRead);
-    for (uint64 offset = 0; s.ok(); offset += kBytesToRead) {
-      tensorflow::StringPiece data;
-      s.Update(source_file->Read(offset, kBytesToRead, &data, &scratch[0]));
-      target_file->Append(data);
-    }
-    if (s.code() == OUT_OF_RANGE) {
-      return tensorflow::Status::OK();
-    } else {
-      return s;
-    }
+    auto matrix = embedding_matrix->matrix<float>();
+    Eigen::Map<const Eigen::VectorXf> values(vector.values().data(),
+                                             vector.values_size());
+    Eigen::Map<Eigen::VectorXf>(&matrix(row, 0), values.size()) =
+        values / values.norm();
   }
 
   // Task context used to configure this op.
@@ -552,9 +1289,62 @@ class WordEmbeddingInitializer : public OpKernel {
 
   // Path to recordio with word embedding vectors.
   string vectors_path_;
+
+  // Generator of the random embeddings, seeded by the seed attributes.
+  tensorflow::GuardedPhiloxRandom generator_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("WordEmbeddingInitializer").Device(DEVICE_CPU),
                         WordEmbeddingInitializer);
 
+// Outputs the statistics of the reader ops as a serialized Summary.
+class ReaderStatsSummary : public OpKernel {
+ public:
+  explicit ReaderStatsSummary(OpKernelConstruction *context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("clear", &clear_));
+  }
+
+  void Compute(OpKernelContext *context) override {
+    tensorflow::Summary summary;
+    ReaderStats::Get()->AddToSummary(&summary);
+    if (clear_) ReaderStats::Get()->Clear();
+    Tensor *output;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({}), &output));
+    output->scalar<string>()() = summary.SerializeAsString();
+  }
+
+ private:
+  // Whether to clear the histograms after reading them.
+  bool clear_ = false;
+};
+
+REGISTER_KERNEL_BUILDER(Name("ReaderStatsSummary").Device(DEVICE_CPU),
+                        ReaderStatsSummary);
+
+// Outputs the report of the feature profiler.
+class FeatureProfileReport : public OpKernel {
+ public:
+  explicit FeatureProfileReport(OpKernelConstruction *context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("clear", &clear_));
+  }
+
+  void Compute(OpKernelContext *context) override {
+    Tensor *output;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({}), &output));
+    output->scalar<string>()() = FeatureProfiler::Get()->Report();
+    if (clear_) FeatureProfiler::Get()->Clear();
+  }
+
+ private:
+  // Whether to clear the sampled costs after reading them.
+  bool clear_ = false;
+};
+
+REGISTER_KERNEL_BUILDER(Name("FeatureProfileReport").Device(DEVICE_CPU),
+                        FeatureProfileReport);
+
 }  // namespace syntaxnet
@@ -21,6 +21,7 @@ import os.path
 import numpy as np
 import tensorflow as tf
 
+from tensorflow.core.framework import summary_pb2
 from tensorflow.python.framework import test_util
 from tensorflow.python.ops import control_flow_ops as cf
 from tensorflow.python.platform import googletest
@@ -28,6 +29,7 @@ from tensorflow.python.platform import tf_logging as logging
 
 from syntaxnet import dictionary_pb2
 from syntaxnet import graph_builder
+from syntaxnet import sentence_pb2
 from syntaxnet import sparse_pb2
 from syntaxnet.ops import gen_parser_ops
 
@@ -168,6 +170,261 @@ class ParsingReaderOpsTest(test_util.TensorFlowTestCase):
       logging.info('Result: %s', res)
       self.assertEqual(res[0], 2)
 
+  def testPackedParsingReaderOp(self):
+    # Runs a serializing and a packing reader side by side, and checks that
+    # they return the same features.
+    feature_size = 3
+    batch_size = 10
+    with self.test_session() as sess:
+      features, epochs, gold_actions = gen_parser_ops.gold_parse_reader(
+          self._task_context,
+          feature_size,
+          batch_size,
+          corpus_name='training-corpus')
+      unpacked = [gen_parser_ops.unpack_sparse_features(tf.reshape(f, [-1]))
+                  for f in features]
+      (indices, ids, weights, packed_batch_size, packed_epochs,
+       packed_gold_actions) = gen_parser_ops.packed_gold_parse_reader(
+           self._task_context,
+           feature_size,
+           batch_size,
+           corpus_name='training-corpus')
+      while True:
+        (tf_unpacked, tf_gold_actions, tf_epochs, tf_indices, tf_ids,
+         tf_weights, tf_packed_batch_size, tf_packed_gold_actions,
+         tf_packed_epochs) = sess.run(
+             [unpacked, gold_actions, epochs, indices, ids, weights,
+              packed_batch_size, packed_gold_actions, packed_epochs])
+        self.assertEqual(tf_epochs, tf_packed_epochs)
+        self.assertAllEqual(tf_gold_actions, tf_packed_gold_actions)
+        self.assertEqual(len(tf_gold_actions), tf_packed_batch_size)
+        for i in range(feature_size):
+          self.assertAllEqual(tf_unpacked[i][0], tf_indices[i])
+          self.assertAllEqual(tf_unpacked[i][1], tf_ids[i])
+          self.assertAllClose(tf_unpacked[i][2], tf_weights[i])
+        if tf_epochs > 1:
+          break
+
+  def testGoldSequenceReader(self):
+    # Checks that the sequence reader follows the same gold actions as the
+    # gold parse reader over an epoch, with sentences continued over batches.
+    feature_size = 3
+    with self.test_session() as sess:
+      _, epochs, gold_actions = gen_parser_ops.gold_parse_reader(
+          self._task_context,
+          feature_size,
+          1,
+          corpus_name='training-corpus')
+      expected = []
+      while True:
+        tf_epochs, tf_gold_actions = sess.run([epochs, gold_actions])
+        if tf_epochs > 0:
+          break
+        expected.extend(tf_gold_actions)
+
+      max_length = 5
+      features, epochs, gold_actions, lengths = (
+          gen_parser_ops.gold_sequence_reader(self._task_context,
+                                              feature_size,
+                                              1,
+                                              max_length,
+                                              corpus_name='training-corpus'))
+      actual = []
+      while True:
+        tf_features, tf_epochs, tf_gold_actions, tf_lengths = sess.run(
+            [features, epochs, gold_actions, lengths])
+        if tf_epochs > 0:
+          break
+        self.assertEqual(tf_gold_actions.shape, (1, max_length))
+        self.assertLessEqual(tf_lengths[0], max_length)
+        for f in tf_features:
+          self.assertEqual(len(f), max_length)
+          for row in f[tf_lengths[0]:]:
+            self.assertTrue(all(not x for x in row))
+        actual.extend(tf_gold_actions[0, :tf_lengths[0]])
+      self.assertAllEqual(expected, actual)
+
+  def testEmbeddingRowOrder(self):
+    # Reverses the rows of the tag embeddings, and checks that a reader on the
+    # reordered context returns the rows of the ids of a reader on the original
+    # one.
+    num_tags = self._num_feature_ids[1]
+    row_order = os.path.join(FLAGS.test_tmpdir, 'embedding-row-order')
+    with open(row_order, 'w') as fout:
+      fout.write('0\t\n')
+      fout.write('2\t%s\n' % ' '.join(str(num_tags - 1 - i)
+                                       for i in range(num_tags)))
+      fout.write('0\t\n')
+    task_context = os.path.join(FLAGS.test_tmpdir, 'row-order-context.pbtxt')
+    with open(self._task_context, 'r') as fin:
+      with open(task_context, 'w') as fout:
+        fout.write(fin.read())
+        fout.write('Parameter {\n'
+                   '  name: "brain_parser_embedding_row_order"\n'
+                   '  value: "true"\n'
+                   '}\n'
+                   'input {\n'
+                   '  name: "brain_parser-embedding-row-order"\n'
+                   '  file_format: "text"\n'
+                   '  Part {\n'
+                   '    file_pattern: "%s"\n'
+                   '  }\n'
+                   '}\n' % row_order)
+    with self.test_session() as sess:
+      features, epochs, _ = gen_parser_ops.gold_parse_reader(
+          self._task_context, 3, 10, corpus_name='training-corpus')
+      reordered, _, _ = gen_parser_ops.gold_parse_reader(
+          task_context, 3, 10, corpus_name='training-corpus')
+      ids = [gen_parser_ops.unpack_sparse_features(f)[1]
+             for f in features + reordered]
+      while True:
+        tf_epochs, tf_ids = sess.run([epochs, ids])
+        self.assertAllEqual(tf_ids[0], tf_ids[3])
+        self.assertAllEqual(num_tags - 1 - tf_ids[1], tf_ids[4])
+        self.assertAllEqual(tf_ids[2], tf_ids[5])
+        if tf_epochs > 1:
+          break
+
+  def ParseEpoch(self, task_context, **kwargs):
+    """Parses one epoch of the corpus with uniform scores.
+
+    Args:
+      task_context: file path from which to read the task context.
+      **kwargs: additional attributes of the DecodedParseReader.
+
+    Returns:
+      The parsed documents, in output order. The last documents of the epoch
+      are returned by the step starting the next one. With slim_output, each
+      document is the tuple of its docid and the heads and labels of its
+      tokens.
+    """
+    batch_size = 4
+    documents = []
+    with self.test_session(graph=tf.Graph()) as sess:
+      transition_scores = tf.placeholder(tf.float32,
+                                         shape=[None, self._num_actions])
+      (features, epochs, _, tf_documents, heads, labels,
+       starts) = gen_parser_ops.decoded_parse_reader(
+           transition_scores, task_context, 3, batch_size,
+           corpus_name='training-corpus', **kwargs)
+      tf_epochs = 0
+      # When ping-ponging, the scores of a step are those of the features
+      # emitted two steps earlier.
+      num_scored = [0] * (2 if kwargs.get('ping_pong') else 1)
+      while tf_epochs < 2:
+        (tf_features, tf_epochs, new_documents, tf_heads, tf_labels,
+         tf_starts) = sess.run(
+             [features[0], epochs, tf_documents, heads, labels, starts],
+             feed_dict={transition_scores: np.zeros([num_scored.pop(0),
+                                                     self._num_actions])})
+        self.assertLessEqual(len(tf_features), batch_size)
+        num_scored.append(len(tf_features))
+        if kwargs.get('slim_output'):
+          self.assertEqual(len(tf_starts), len(new_documents) + 1)
+          for i, docid in enumerate(new_documents):
+            begin, end = tf_starts[i], tf_starts[i + 1]
+            documents.append((docid, list(tf_heads[begin:end]),
+                              list(tf_labels[begin:end])))
+        else:
+          self.assertEqual(len(tf_starts), 0)
+          documents.extend(new_documents)
+    return documents
+
+  def testSlimDecodedParseReader(self):
+    # Checks that the heads and labels output instead of the documents are
+    # those of the documents, with label ids from the label map.
+    with open(os.path.join(FLAGS.test_tmpdir, 'label-map'), 'r') as fin:
+      label_ids = {line.split()[0]: i
+                   for i, line in enumerate(fin.readlines()[1:])}
+    label_ids['ROOT'] = -1
+    expected = []
+    for serialized in self.ParseEpoch(self._task_context):
+      document = sentence_pb2.Sentence()
+      document.ParseFromString(serialized)
+      expected.append((document.docid,
+                       [token.head for token in document.token],
+                       [label_ids[token.label] for token in document.token]))
+    self.assertTrue(expected)
+    self.assertEqual(expected,
+                     self.ParseEpoch(self._task_context, slim_output=True))
+    self.assertEqual(expected,
+                     self.ParseEpoch(self._task_context, slim_output=True,
+                                     parse_cache_bytes=1 << 20))
+
+  def testOutOfOrderDecodedParseReader(self):
+    # Checks that the parses are the same in and out of order.
+    in_order = self.ParseEpoch(self._task_context)
+    out_of_order = self.ParseEpoch(self._task_context, in_order=False,
+                                   max_batch_latency_ms=1)
+    self.assertTrue(in_order)
+    self.assertItemsEqual(in_order, out_of_order)
+
+  def testPingPongDecodedParseReader(self):
+    # Checks that alternating between two halves of the batch gives the same
+    # parses in the same order.
+    self.assertEqual(self.ParseEpoch(self._task_context),
+                     self.ParseEpoch(self._task_context, ping_pong=True))
+
+  def testSkipDeterministicStates(self):
+    # Checks that taking the only allowed action without scoring it gives the
+    # same parses as choosing it from uniform scores.
+    self.assertEqual(self.ParseEpoch(self._task_context),
+                     self.ParseEpoch(self._task_context,
+                                     skip_deterministic_states=True))
+
+  def testParseCache(self):
+    # Checks that outputting repeated sentences from the parse cache gives the
+    # same parses in the same order.
+    self.assertEqual(self.ParseEpoch(self._task_context),
+                     self.ParseEpoch(self._task_context,
+                                     parse_cache_bytes=1 << 20))
+
+  def testSentenceLookahead(self):
+    # Checks that reading ahead and sorting sentences by length does not change
+    # the parses or their output order.
+    task_context = os.path.join(FLAGS.test_tmpdir, 'lookahead-context.pbtxt')
+    with open(self._task_context, 'r') as fin:
+      with open(task_context, 'w') as fout:
+        fout.write(fin.read())
+        fout.write('Parameter {\n'
+                   '  name: "brain_parser_sentence_lookahead"\n'
+                   '  value: "7"\n'
+                   '}\n')
+    self.assertEqual(self.ParseEpoch(self._task_context),
+                     self.ParseEpoch(task_context))
+
+  def testTokenBudget(self):
+    # Checks that holding sentences back to stay within a token budget does not
+    # change the parses or their output order.
+    task_context = os.path.join(FLAGS.test_tmpdir, 'budget-context.pbtxt')
+    with open(self._task_context, 'r') as fin:
+      with open(task_context, 'w') as fout:
+        fout.write(fin.read())
+        fout.write('Parameter {\n'
+                   '  name: "brain_parser_max_tokens_per_batch"\n'
+                   '  value: "40"\n'
+                   '}\n')
+    self.assertEqual(self.ParseEpoch(self._task_context),
+                     self.ParseEpoch(task_context))
+
+  def testReaderStatsSummary(self):
+    with self.test_session() as sess:
+      sess.run(gen_parser_ops.reader_stats_summary(clear=True))
+      _, epochs, _ = gen_parser_ops.gold_parse_reader(
+          self._task_context, 3, 10, corpus_name='training-corpus')
+      for _ in range(5):
+        sess.run(epochs)
+      summary = summary_pb2.Summary()
+      summary.ParseFromString(sess.run(gen_parser_ops.reader_stats_summary()))
+    values = dict((value.tag, value) for value in summary.value)
+    for stage in ['step', 'read_sentence', 'preprocess', 'extract_features']:
+      self.assertGreater(values['reader/%s_micros' % stage].histo.num, 0)
+    self.assertEqual(values['reader/step_micros'].histo.num, 5)
+    self.assertEqual(values['reader/batch_occupancy'].histo.num, 5)
+    self.assertLessEqual(values['reader/batch_occupancy'].histo.max, 1.0)
+    self.assertEqual(values['reader/beam_size'].histo.num, 0)
+    self.assertGreater(values['reader/sentences_per_second'].simple_value, 0)
+
   def testWordEmbeddingInitializer(self):
     def _TokenEmbedding(token, embedding):
       e = dictionary_pb2.TokenEmbedding()
@@ -193,6 +450,51 @@ class ParsingReaderOpsTest(test_util.TensorFlowTestCase):
                   [5. / (25 + 36) ** .5, 6. / (25 + 36) ** .5]]),
         embeddings[:3,])
 
+  def testWordEmbeddingInitializerSkipsUnknownWords(self):
+    records_path = os.path.join(FLAGS.test_tmpdir, 'unknown-00000-of-00001')
+    writer = tf.python_io.TFRecordWriter(records_path)
+    for token, values in [('<unknown-word>', [7, 8]), ('.', [1, 2]),
+                          ('<other-word>', [9, 10]), (',', [3, 4])]:
+      e = dictionary_pb2.TokenEmbedding()
+      e.token = token
+      e.vector.values.extend(values)
+      writer.write(e.SerializeToString())
+    del writer
+
+    with self.test_session():
+      embeddings = gen_parser_ops.word_embedding_initializer(
+          vectors=records_path,
+          task_context=self._task_context).eval()
+    self.assertAllClose(
+        np.array([[1. / (1 + 4) ** .5, 2. / (1 + 4) ** .5],
+                  [3. / (9 + 16) ** .5, 4. / (9 + 16) ** .5]]),
+        embeddings[:2,])
+
+  def testWordEmbeddingInitializerSeedsRandomEmbeddings(self):
+    records_path = os.path.join(FLAGS.test_tmpdir, 'seeded-00000-of-00001')
+    writer = tf.python_io.TFRecordWriter(records_path)
+    e = dictionary_pb2.TokenEmbedding()
+    e.token = '.'
+    e.vector.values.extend([1] * 64)
+    writer.write(e.SerializeToString())
+    del writer
+
+    def _Embeddings(seed):
+      with self.test_session():
+        return gen_parser_ops.word_embedding_initializer(
+            vectors=records_path,
+            task_context=self._task_context,
+            embedding_init=2.0,
+            seed=seed).eval()
+
+    embeddings = _Embeddings(1)
+    self.assertAllEqual(embeddings, _Embeddings(1))
+    self.assertFalse(np.array_equal(embeddings, _Embeddings(2)))
+
+    # The rows of words without a vector have a standard deviation of
+    # embedding_init / sqrt(embedding size).
+    self.assertNear(np.std(embeddings[1:,]), 2.0 / 64 ** .5, 0.05)
+
 
 if __name__ == '__main__':
   googletest.main()
@@ -0,0 +1,115 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/reader_stats.h"
+
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/util/sampling_tracer.h"
+
+using tensorflow::monitoring::Counter;
+using tensorflow::monitoring::MetricDef;
+using tensorflow::monitoring::MetricKind;
+
+namespace syntaxnet {
+
+ReaderStats *ReaderStats::Get() {
+  static ReaderStats *stats = new ReaderStats();
+  return stats;
+}
+
+ReaderStats::ReaderStats()
+    : stage_micros_(Counter<1>::New(MetricDef<MetricKind::CUMULATIVE, int64, 1>(
+          "/syntaxnet/reader/stage_micros",
+          "Total time spent in each stage of the reader ops.", "stage"))),
+      stage_calls_(Counter<1>::New(MetricDef<MetricKind::CUMULATIVE, int64, 1>(
+          "/syntaxnet/reader/stage_calls",
+          "Number of calls of each stage of the reader ops.", "stage"))),
+      sentences_(Counter<0>::New(MetricDef<MetricKind::CUMULATIVE, int64, 0>(
+          "/syntaxnet/reader/sentences",
+          "Number of sentences read by the reader ops."))) {}
+
+const char *ReaderStats::StageName(ReaderStage stage) {
+  switch (stage) {
+    case kReaderStep:
+      return "step";
+    case kSentenceRead:
+      return "read_sentence";
+    case kPreprocess:
+      return "preprocess";
+    case kFeatureExtraction:
+      return "extract_features";
+    case kBeamAdvance:
+      return "advance_beam";
+    default:
+      return "unknown";
+  }
+}
+
+void ReaderStats::AddStageTime(ReaderStage stage, int64 micros) {
+  stage_micros_->GetCell(StageName(stage))->IncrementBy(micros);
+  stage_calls_->GetCell(StageName(stage))->IncrementBy(1);
+  tensorflow::SamplingTracer::RecordStage(StageName(stage), micros);
+  mutex_lock lock(mu_);
+  stage_histograms_[stage].Add(micros);
+  if (stage == kReaderStep) step_micros_ += micros;
+}
+
+void ReaderStats::AddSentence() {
+  sentences_->GetCell()->IncrementBy(1);
+  mutex_lock lock(mu_);
+  ++num_sentences_;
+}
+
+void ReaderStats::AddBatch(int num_sentences, int batch_size) {
+  if (batch_size <= 0) return;
+  mutex_lock lock(mu_);
+  occupancy_histogram_.Add(static_cast<double>(num_sentences) / batch_size);
+}
+
+void ReaderStats::AddBeam(int beam_size) {
+  mutex_lock lock(mu_);
+  beam_histogram_.Add(beam_size);
+}
+
+void ReaderStats::AddToSummary(tensorflow::Summary *summary) const {
+  mutex_lock lock(mu_);
+  for (int stage = 0; stage < kNumReaderStages; ++stage) {
+    tensorflow::Summary::Value *value = summary->add_value();
+    value->set_tag(tensorflow::strings::StrCat(
+        "reader/", StageName(static_cast<ReaderStage>(stage)), "_micros"));
+    stage_histograms_[stage].EncodeToProto(value->mutable_histo(), false);
+  }
+  tensorflow::Summary::Value *occupancy = summary->add_value();
+  occupancy->set_tag("reader/batch_occupancy");
+  occupancy_histogram_.EncodeToProto(occupancy->mutable_histo(), false);
+  tensorflow::Summary::Value *beam = summary->add_value();
+  beam->set_tag("reader/beam_size");
+  beam_histogram_.EncodeToProto(beam->mutable_histo(), false);
+  tensorflow::Summary::Value *throughput = summary->add_value();
+  throughput->set_tag("reader/sentences_per_second");
+  throughput->set_simple_value(
+      step_micros_ == 0 ? 0.0 : 1e6 * num_sentences_ / step_micros_);
+}
+
+void ReaderStats::Clear() {
+  mutex_lock lock(mu_);
+  for (auto &histogram : stage_histograms_) histogram.Clear();
+  occupancy_histogram_.Clear();
+  beam_histogram_.Clear();
+  num_sentences_ = 0;
+  step_micros_ = 0;
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,118 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Process-wide latency and throughput statistics of the reader ops, for
+// telling which stage of reading, preprocessing, feature extraction or beam
+// search a slowdown comes from. Cumulative times and call counts per stage
+// and the number of sentences read are exported as monitoring counters.
+// Histograms of the latency of each stage, of the batch occupancy and of the
+// beam sizes after pruning are returned as a Summary by the ReaderStatsSummary
+// op, for TensorBoard.
+//
+// In steps sampled by the tracer of the session (see
+// tensorflow/core/util/sampling_tracer.h), the time of each stage is also
+// recorded as a stage of the reader node, for its latency percentiles.
+
+#ifndef SYNTAXNET_READER_STATS_H_
+#define SYNTAXNET_READER_STATS_H_
+
+#include <memory>
+
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/summary.pb.h"
+#include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace syntaxnet {
+
+// Timed stages of the reader ops.
+enum ReaderStage {
+  kReaderStep,         // one Compute() call of a reader op
+  kSentenceRead,       // reading the next sentence of a batch slot
+  kPreprocess,         // preprocessing a sentence for the features
+  kFeatureExtraction,  // extracting the features of a whole batch
+  kBeamAdvance,        // scoring and pruning the successors of a beam
+  kNumReaderStages
+};
+
+class ReaderStats {
+ public:
+  // Returns the statistics of this process.
+  static ReaderStats *Get();
+
+  // Records one call of a stage that took the given time.
+  void AddStageTime(ReaderStage stage, int64 micros);
+
+  // Records that a sentence was read.
+  void AddSentence();
+
+  // Records the number of sentences in a batch of the given size at a step.
+  void AddBatch(int num_sentences, int batch_size);
+
+  // Records the number of states in a beam after pruning.
+  void AddBeam(int beam_size);
+
+  // Adds the histograms, and the number of sentences read per second of
+  // reader steps, to the summary. Tags start with "reader/".
+  void AddToSummary(tensorflow::Summary *summary) const;
+
+  // Starts collecting new histograms. The exported counters are cumulative
+  // and are not reset.
+  void Clear();
+
+  // Returns the name of a stage, used in tags and counter labels.
+  static const char *StageName(ReaderStage stage);
+
+ private:
+  ReaderStats();
+
+  // Exported counters.
+  std::unique_ptr<tensorflow::monitoring::Counter<1>> stage_micros_;
+  std::unique_ptr<tensorflow::monitoring::Counter<1>> stage_calls_;
+  std::unique_ptr<tensorflow::monitoring::Counter<0>> sentences_;
+
+  // Histograms and totals since the last Clear().
+  mutable mutex mu_;
+  tensorflow::histogram::Histogram stage_histograms_[kNumReaderStages];
+  tensorflow::histogram::Histogram occupancy_histogram_;
+  tensorflow::histogram::Histogram beam_histogram_;
+  int64 num_sentences_ = 0;
+  int64 step_micros_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ReaderStats);
+};
+
+// Records the time from construction to destruction as a call of a stage.
+class ScopedStageTimer {
+ public:
+  explicit ScopedStageTimer(ReaderStage stage)
+      : stage_(stage), start_(tensorflow::Env::Default()->NowMicros()) {}
+
+  ~ScopedStageTimer() {
+    ReaderStats::Get()->AddStageTime(
+        stage_, tensorflow::Env::Default()->NowMicros() - start_);
+  }
+
+ private:
+  const ReaderStage stage_;
+  const uint64 start_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ScopedStageTimer);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_READER_STATS_H_
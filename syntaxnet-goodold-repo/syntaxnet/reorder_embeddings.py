@@ -0,0 +1,231 @@
+# Copyright 2016 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+"""A program to lay out the embedding rows of a greedy model by frequency.
+
+Counts how often the gold parser states of a corpus look up each id of each
+embedding space, and saves the model with the rows of each embedding matrix
+ordered from the most to the least looked up id. Term maps already number
+terms by frequency, but special values like <UNKNOWN> and <OUTSIDE> follow the
+vocabulary, so they move to the first rows along with the frequent terms.
+
+Along with the model, the row order which the feature extractors map ids
+through and a copy of the task context that reads it are written. The
+reordered model must be evaluated or exported on that task context. The
+accuracy of the original and the reordered model is logged for comparison.
+
+With a positive --hot_coverage, the smallest number of leading rows covering
+that fraction of the lookups of an embedding space is recorded as its hot
+rows, which the C++ feed-forward network scorers keep in a block of their own.
+"""
+
+
+import os.path
+
+import numpy as np
+import tensorflow as tf
+
+from google.protobuf import text_format
+
+from tensorflow.python.platform import gfile
+from tensorflow.python.platform import tf_logging as logging
+
+from syntaxnet import graph_builder
+from syntaxnet import task_spec_pb2
+from syntaxnet.ops import gen_parser_ops
+
+flags = tf.app.flags
+FLAGS = flags.FLAGS
+
+
+flags.DEFINE_string('task_context', '',
+                    'Path to a task context with inputs and parameters for '
+                    'feature extractors.')
+flags.DEFINE_string('model_path', '', 'Path to the model parameters.')
+flags.DEFINE_string('output_model_path', '',
+                    'Path to write the reordered model parameters to.')
+flags.DEFINE_string('output_task_context', '',
+                    'Path to write the task context of the reordered model '
+                    'to.')
+flags.DEFINE_string('output_row_order', '',
+                    'Path to write the embedding row order to.')
+flags.DEFINE_string('arg_prefix', 'brain_parser',
+                    'Prefix for context parameters.')
+flags.DEFINE_string('input', 'tuning-corpus',
+                    'Name of the context input to count lookups and evaluate '
+                    'on.')
+flags.DEFINE_string('hidden_layer_sizes', '200,200',
+                    'Comma separated list of hidden layer sizes.')
+flags.DEFINE_integer('batch_size', 32,
+                     'Number of sentences to process in parallel.')
+flags.DEFINE_bool('slim_model', False,
+                  'Whether to expect only averaged variables.')
+flags.DEFINE_float('hot_coverage', 0.9,
+                   'Fraction of the lookups of each embedding space that its '
+                   'hot rows cover, or 0 to record no hot rows.')
+
+
+def BuildParser(sess, task_context):
+  """Builds an evaluation network on the given task context."""
+  feature_sizes, domain_sizes, embedding_dims, num_actions = sess.run(
+      gen_parser_ops.feature_size(task_context=task_context,
+                                  arg_prefix=FLAGS.arg_prefix))
+  hidden_layer_sizes = map(int, FLAGS.hidden_layer_sizes.split(','))
+  parser = graph_builder.GreedyParser(num_actions,
+                                      feature_sizes,
+                                      domain_sizes,
+                                      embedding_dims,
+                                      hidden_layer_sizes,
+                                      gate_gradients=True,
+                                      arg_prefix=FLAGS.arg_prefix)
+  parser.AddEvaluation(task_context,
+                       FLAGS.batch_size,
+                       corpus_name=FLAGS.input)
+  parser.AddSaver(FLAGS.slim_model)
+  sess.run(parser.inits.values())
+  return parser, domain_sizes
+
+
+def Evaluate(sess, parser):
+  """Runs one epoch of evaluation and returns its accuracy in percent."""
+  num_epochs = None
+  num_tokens = 0
+  num_correct = 0
+  while True:
+    tf_eval_epochs, tf_eval_metrics = sess.run(
+        [parser.evaluation['epochs'], parser.evaluation['eval_metrics']])
+    num_tokens += tf_eval_metrics[0]
+    num_correct += tf_eval_metrics[1]
+    if num_epochs is None:
+      num_epochs = tf_eval_epochs
+    elif num_epochs < tf_eval_epochs:
+      break
+  return 100.0 * num_correct / max(num_tokens, 1)
+
+
+def CountLookups(domain_sizes):
+  """Returns how often the gold states of FLAGS.input look up each id.
+
+  Args:
+    domain_sizes: number of ids of each embedding space.
+
+  Returns:
+    A list of int64 arrays with the lookups of each id, one per space.
+  """
+  counts = [np.zeros(size, dtype=np.int64) for size in domain_sizes]
+  with tf.Graph().as_default(), tf.Session() as sess:
+    features, epochs, _ = gen_parser_ops.gold_parse_reader(
+        FLAGS.task_context,
+        len(domain_sizes),
+        FLAGS.batch_size,
+        corpus_name=FLAGS.input,
+        arg_prefix=FLAGS.arg_prefix)
+    ids = [gen_parser_ops.unpack_sparse_features(f)[1] for f in features]
+    num_epochs = None
+    while True:
+      tf_epochs, tf_ids = sess.run([epochs, ids])
+      if num_epochs is None:
+        num_epochs = tf_epochs
+      elif num_epochs < tf_epochs:
+        break
+      for count, space_ids in zip(counts, tf_ids):
+        count += np.bincount(space_ids, minlength=len(count))
+  return counts
+
+
+def RowOrder(count):
+  """Returns the ids of a space in row order, and its number of hot rows.
+
+  Ids looked up equally often keep their order, so ids never looked up stay
+  in term map order after the others.
+
+  Args:
+    count: lookups of each id of the space.
+  """
+  order = np.argsort(-count, kind='mergesort')
+  total = count.sum()
+  if FLAGS.hot_coverage <= 0 or total == 0:
+    return order, 0
+  covered = np.cumsum(count[order])
+  hot_rows = np.searchsorted(covered, FLAGS.hot_coverage * total) + 1
+  return order, int(min(hot_rows, len(order)))
+
+
+def WriteTaskContext(row_order_path):
+  """Writes a copy of FLAGS.task_context that reads the row order."""
+  context = task_spec_pb2.TaskSpec()
+  with gfile.FastGFile(FLAGS.task_context) as fin:
+    text_format.Merge(fin.read(), context)
+  parameter = context.parameter.add()
+  parameter.name = FLAGS.arg_prefix + '_embedding_row_order'
+  parameter.value = 'true'
+  resource = context.input.add()
+  resource.name = FLAGS.arg_prefix + '-embedding-row-order'
+  resource.file_format.append('text')
+  resource.part.add().file_pattern = row_order_path
+  with gfile.FastGFile(FLAGS.output_task_context, 'w') as fout:
+    fout.write(str(context))
+
+
+def Reorder():
+  """Reorders FLAGS.model_path into FLAGS.output_model_path."""
+  with tf.Graph().as_default(), tf.Session() as sess:
+    parser, domain_sizes = BuildParser(sess, FLAGS.task_context)
+    parser.saver.restore(sess, FLAGS.model_path)
+    logging.info('Original model: eval metric: %.2f%%', Evaluate(sess, parser))
+    counts = CountLookups(domain_sizes)
+
+    row_order_path = os.path.abspath(FLAGS.output_row_order)
+    with gfile.FastGFile(row_order_path, 'w') as fout:
+      for index, count in enumerate(counts):
+        order, hot_rows = RowOrder(count)
+        identity = np.array_equal(order, np.arange(len(order)))
+        fout.write('%d\t%s\n' % (hot_rows, '' if identity else
+                                 ' '.join(str(i) for i in order)))
+        logging.info('Embedding space %d: %d of %d rows cover %.2f%% of %d '
+                     'lookups', index, hot_rows, len(order),
+                     100.0 * count[order[:hot_rows]].sum() /
+                     max(count.sum(), 1), count.sum())
+
+        # Both the parameters and their moving averages are reordered, so
+        # that the saved model holds the reordered rows either way.
+        name = 'embedding_matrix_%d' % index
+        for variable in [parser.params[name],
+                         parser.variables.get(name + '_avg_var')]:
+          if variable is None:
+            continue
+          value = sess.run(variable)
+          placeholder = tf.placeholder(tf.float32, value.shape)
+          sess.run(tf.assign(variable, placeholder),
+                   feed_dict={placeholder: value[order]})
+    parser.saver.save(sess, FLAGS.output_model_path)
+  WriteTaskContext(row_order_path)
+
+  with tf.Graph().as_default(), tf.Session() as sess:
+    parser, _ = BuildParser(sess, FLAGS.output_task_context)
+    parser.saver.restore(sess, FLAGS.output_model_path)
+    logging.info('Reordered model: eval metric: %.2f%%',
+                 Evaluate(sess, parser))
+  logging.info('Wrote reordered model to %s and its task context to %s',
+               FLAGS.output_model_path, FLAGS.output_task_context)
+
+
+def main(unused_argv):
+  logging.set_verbosity(logging.INFO)
+  Reorder()
+
+
+if __name__ == '__main__':
+  tf.app.run()
@@ -39,13 +39,7 @@ const std::unordered_set<int> SegmenterUtils::kBreakChars({
 
 void SegmenterUtils::GetUTF8Chars(const string &text,
                                   vector<tensorflow::StringPiece> *chars) {
-  const char *start = text.c_str();
-  const char *end = text.c_str() + text.size();
-  while (start < end) {
-    int char_length = UniLib::OneCharLen(start);
-    chars->emplace_back(start, char_length);
-    start += char_length;
-  }
+  UniLib::SplitIntoChars(text, chars);
 }
 
 void SegmenterUtils::SetCharsAsTokens(
@@ -0,0 +1,97 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/selective_registration.h"
+
+#include <set>
+#include <utility>
+
+#include "tensorflow/core/framework/graph_def_util.h"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace syntaxnet {
+namespace {
+
+// Ops and kernel classes of the nodes DirectSession adds to a graph to feed
+// and fetch tensors, which are not in the exported graphs.
+const std::pair<const char *, const char *> kSessionKernels[] = {
+    {"_Recv", "RecvOp"}, {"_Send", "SendOp"},
+};
+
+// Returns the given string as a C++ string literal.
+string Quote(const string &text) {
+  return tensorflow::strings::StrCat("\"", tensorflow::str_util::CEscape(text),
+                                     "\"");
+}
+
+}  // namespace
+
+tensorflow::Status SelectiveRegistrationHeader(
+    const std::vector<tensorflow::GraphDef> &graphs, string *header) {
+  std::set<string> ops;
+  std::set<string> kernel_classes;
+  for (const auto &op_and_class : kSessionKernels) {
+    ops.insert(op_and_class.first);
+    kernel_classes.insert(op_and_class.second);
+  }
+  for (tensorflow::GraphDef graph : graphs) {
+    // Kernels are matched on the attrs of a node, including the ones the
+    // exported graph leaves at their defaults.
+    TF_RETURN_IF_ERROR(tensorflow::AddDefaultAttrsToGraphDef(
+        &graph, *tensorflow::OpRegistry::Global(), 0));
+    for (const tensorflow::NodeDef &node : graph.node()) {
+      string kernel_class;
+      TF_RETURN_IF_ERROR(tensorflow::FindKernelDef(
+          tensorflow::DeviceType(tensorflow::DEVICE_CPU), node, nullptr,
+          &kernel_class));
+      ops.insert(node.op());
+      kernel_classes.insert(kernel_class);
+    }
+  }
+
+  // Op names are compared by a constexpr function, so that the registrations
+  // of other ops, and the code only they refer to, are dropped at link time.
+  string &out = *header;
+  out = "// Generated by selective_registration_main. Do not edit.\n\n";
+  tensorflow::strings::StrAppend(
+      &out, "#ifndef OPS_TO_REGISTER\n#define OPS_TO_REGISTER\n\n",
+      "namespace {\n",
+      "constexpr bool OpNameEquals(const char *a, const char *b) {\n",
+      "  return *a == *b && (*a == '\\0' || OpNameEquals(a + 1, b + 1));\n",
+      "}\n", "}  // namespace\n\n",
+      "constexpr inline bool ShouldRegisterOp(const char op[]) {\n",
+      "  return false");
+  for (const string &op : ops) {
+    tensorflow::strings::StrAppend(&out, "\n      || OpNameEquals(op, ",
+                                   Quote(op), ")");
+  }
+  tensorflow::strings::StrAppend(&out, ";\n}\n\n",
+                                 "const char kNecessaryOpKernelClasses[] =\n",
+                                 "    \",\"");
+  for (const string &kernel_class : kernel_classes) {
+    tensorflow::strings::StrAppend(&out, "\n    ", Quote(kernel_class),
+                                   " \",\"");
+  }
+  tensorflow::strings::StrAppend(
+      &out, ";\n\nconst bool kRequiresSymbolicGradients = false;\n\n",
+      "#endif  // OPS_TO_REGISTER\n");
+  return tensorflow::Status::OK();
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,42 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Headers for the selective registration of the ops and kernels of exported
+// models, for mobile builds that only link what a set of models runs.
+
+#ifndef SYNTAXNET_SELECTIVE_REGISTRATION_H_
+#define SYNTAXNET_SELECTIVE_REGISTRATION_H_
+
+#include <string>
+#include <vector>
+
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace syntaxnet {
+
+// Writes to "header" an ops_to_register.h, see
+// tensorflow/core/framework/selective_registration.h, that registers the ops
+// of the nodes of the given graphs and the CPU kernels that run them, along
+// with the kernels DirectSession adds to feed and fetch tensors, and no
+// gradients. The ops and kernels of the graphs must be linked into the
+// calling binary, so that their kernel classes can be looked up.
+tensorflow::Status SelectiveRegistrationHeader(
+    const std::vector<tensorflow::GraphDef> &graphs, string *header);
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_SELECTIVE_REGISTRATION_H_
@@ -0,0 +1,70 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Writes the ops_to_register.h header of a selective registration build that
+// runs the given model bundles or frozen binary GraphDefs, see
+// parser_mobile_library() in syntaxnet.bzl.
+//
+// Usage: selective_registration_main --output=<file>
+//            [--model_bundles=<file>,...] [--graphs=<file>,...]
+
+#include <string>
+#include <vector>
+
+#include "syntaxnet/model_bundle.h"
+#include "syntaxnet/selective_registration.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+int main(int argc, char **argv) {
+  string output;
+  string model_bundles;
+  string graphs;
+  const bool parsed_flags_ok = tensorflow::ParseFlags(
+      &argc, argv, {tensorflow::Flag("output", &output),
+                    tensorflow::Flag("model_bundles", &model_bundles),
+                    tensorflow::Flag("graphs", &graphs)});
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  if (!parsed_flags_ok || output.empty() ||
+      (model_bundles.empty() && graphs.empty())) {
+    LOG(ERROR) << "Usage: " << argv[0] << " --output=<file> "
+               << "[--model_bundles=<file>,...] [--graphs=<file>,...]";
+    return 1;
+  }
+
+  tensorflow::Env *env = tensorflow::Env::Default();
+  std::vector<tensorflow::GraphDef> graph_defs;
+  for (const string &path :
+       tensorflow::str_util::Split(model_bundles, ',',
+                                   tensorflow::str_util::SkipEmpty())) {
+    graph_defs.emplace_back();
+    TF_CHECK_OK(syntaxnet::ReadModelBundleGraph(path, &graph_defs.back()));
+  }
+  for (const string &path : tensorflow::str_util::Split(
+           graphs, ',', tensorflow::str_util::SkipEmpty())) {
+    graph_defs.emplace_back();
+    TF_CHECK_OK(
+        tensorflow::ReadBinaryProto(env, path, &graph_defs.back()));
+  }
+  string header;
+  TF_CHECK_OK(syntaxnet::SelectiveRegistrationHeader(graph_defs, &header));
+  TF_CHECK_OK(tensorflow::WriteStringToFile(env, output, header));
+  return 0;
+}
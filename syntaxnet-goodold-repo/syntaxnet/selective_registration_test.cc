@@ -0,0 +1,79 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/selective_registration.h"
+
+#include <string>
+#include <vector>
+
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+// Returns a graph of a float constant and its identity.
+tensorflow::GraphDef IdentityGraph() {
+  tensorflow::Tensor value(tensorflow::DT_FLOAT, tensorflow::TensorShape({}));
+  value.scalar<float>()() = 1.0f;
+  tensorflow::GraphDef graph;
+  TF_CHECK_OK(tensorflow::NodeDefBuilder("constant", "Const")
+                  .Attr("dtype", tensorflow::DT_FLOAT)
+                  .Attr("value", value)
+                  .Finalize(graph.add_node()));
+  TF_CHECK_OK(tensorflow::NodeDefBuilder("identity", "Identity")
+                  .Input("constant", 0, tensorflow::DT_FLOAT)
+                  .Finalize(graph.add_node()));
+  return graph;
+}
+
+TEST(SelectiveRegistrationTest, RegistersTheOpsAndKernelsOfTheGraphs) {
+  string header;
+  ASSERT_TRUE(SelectiveRegistrationHeader({IdentityGraph()}, &header).ok());
+  EXPECT_THAT(header, HasSubstr("OpNameEquals(op, \"Const\")"));
+  EXPECT_THAT(header, HasSubstr("OpNameEquals(op, \"Identity\")"));
+  EXPECT_THAT(header, HasSubstr("\"ConstantOp\" \",\""));
+  EXPECT_THAT(header, HasSubstr("\"IdentityOp\" \",\""));
+  EXPECT_THAT(header, Not(HasSubstr("\"MatMul\"")));
+  EXPECT_THAT(header, HasSubstr("kRequiresSymbolicGradients = false"));
+}
+
+TEST(SelectiveRegistrationTest, RegistersFeedAndFetchKernels) {
+  string header;
+  ASSERT_TRUE(SelectiveRegistrationHeader({}, &header).ok());
+  EXPECT_THAT(header, HasSubstr("OpNameEquals(op, \"_Recv\")"));
+  EXPECT_THAT(header, HasSubstr("OpNameEquals(op, \"_Send\")"));
+  EXPECT_THAT(header, HasSubstr("\"RecvOp\" \",\""));
+  EXPECT_THAT(header, HasSubstr("\"SendOp\" \",\""));
+}
+
+TEST(SelectiveRegistrationTest, FailsOnOpsWithoutKernels) {
+  tensorflow::GraphDef graph;
+  graph.add_node()->set_op("NoSuchOp");
+  string header;
+  EXPECT_FALSE(SelectiveRegistrationHeader({graph}, &header).ok());
+}
+
+}  // namespace syntaxnet
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "syntaxnet/sentence_batch.h"
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -24,21 +25,175 @@ limitations under the License.
 namespace syntaxnet {
 
 void SentenceBatch::Init(TaskContext *context) {
-  reader_.reset(new TextReader(*context->GetInput(input_name_), context));
   size_ = 0;
+  if (input_name_.empty()) return;  // sentences are fed
+  const TaskInput &input = *context->GetInput(input_name_);
+  if (DocumentQueue::IsQueueInput(input)) {
+    queue_ = DocumentQueue::ForInput(input);
+  } else {
+    reader_.reset(new TextReader(input, context));
+    num_shards_ = context->Get(input_name_ + "_num_shards", 1);
+    shard_ = context->Get(input_name_ + "_shard", 0);
+    CHECK_GT(num_shards_, 0) << "Invalid number of shards of " << input_name_;
+    CHECK(shard_ >= 0 && shard_ < num_shards_)
+        << "Invalid shard " << shard_ << " of " << input_name_;
+    cache_ = context->Get("sentence_batch_cache", false);
+    const int seed = context->Get("sentence_batch_shuffle_seed", 0);
+    shuffle_cache_ = cache_ && seed > 0;
+    shuffle_size_ =
+        std::max(context->Get("sentence_batch_shuffle_buffer", 0), 0);
+    philox_.reset(new tensorflow::random::PhiloxRandom(seed));
+    random_.reset(new tensorflow::random::SimplePhilox(philox_.get()));
+    cache_offsets_.push_back(0);
+  }
+}
+
+void SentenceBatch::Rewind() {
+  if (cached_) {
+    // Fisher-Yates shuffle of the replay order.
+    if (shuffle_cache_) {
+      for (int i = cache_order_.size() - 1; i > 0; --i) {
+        std::swap(cache_order_[i], cache_order_[random_->Uniform(i + 1)]);
+      }
+    }
+    cache_position_ = 0;
+    shuffle_buffer_.clear();
+    shuffle_done_ = false;
+  } else if (reader_ != nullptr) {
+    // Reads the corpus again, dropping the cache of a partial epoch.
+    cache_pool_.clear();
+    cache_offsets_.resize(1);
+    shuffle_buffer_.clear();
+    shuffle_done_ = false;
+    corpus_position_ = 0;
+    reader_->Reset();
+  }
+}
+
+void SentenceBatch::Feed(Sentence *sentence) {
+  CHECK(input_name_.empty()) << "Cannot feed a batch reading " << input_name_;
+  fed_.emplace_back(sentence);
+}
+
+int SentenceBatch::backlog() const {
+  if (reader_ != nullptr || cached_) return -1;
+  const int waiting = queue_ != nullptr ? queue_->size() : fed_.size();
+  return waiting + buffer_.size() + (pending_ != nullptr ? 1 : 0);
+}
+
+Sentence *SentenceBatch::ReadCorpusSentence() {
+  if (cached_) {
+    if (cache_position_ == cache_order_.size()) return nullptr;
+    const int i = cache_order_[cache_position_++];
+    Sentence *sentence = new Sentence();
+    CHECK(sentence->ParseFromArray(
+        cache_pool_.data() + cache_offsets_[i],
+        cache_offsets_[i + 1] - cache_offsets_[i]));
+    return sentence;
+  }
+  Sentence *sentence = reader_->Read();
+  while (sentence != nullptr && corpus_position_++ % num_shards_ != shard_) {
+    delete sentence;
+    sentence = reader_->Read();
+  }
+  if (cache_) {
+    if (sentence != nullptr) {
+      sentence->AppendToString(&cache_pool_);
+      cache_offsets_.push_back(cache_pool_.size());
+    } else {
+      // The corpus is complete, so it is replayed from now on.
+      cached_ = true;
+      const int num_cached = cache_offsets_.size() - 1;
+      for (int i = 0; i < num_cached; ++i) cache_order_.push_back(i);
+      cache_position_ = num_cached;
+      reader_.reset();
+      LOG(INFO) << "Cached " << num_cached << " sentences in "
+                << cache_pool_.size() << " bytes";
+    }
+  }
+  return sentence;
+}
+
+Sentence *SentenceBatch::ReadShuffledSentence() {
+  while (!shuffle_done_ && shuffle_buffer_.size() < shuffle_size_) {
+    Sentence *sentence = ReadCorpusSentence();
+    if (sentence == nullptr) {
+      shuffle_done_ = true;
+      break;
+    }
+    shuffle_buffer_.emplace_back(sentence);
+  }
+  if (shuffle_buffer_.empty()) return nullptr;
+  const int i = random_->Uniform(shuffle_buffer_.size());
+  std::swap(shuffle_buffer_[i], shuffle_buffer_.back());
+  Sentence *sentence = shuffle_buffer_.back().release();
+  shuffle_buffer_.pop_back();
+  return sentence;
+}
+
+Sentence *SentenceBatch::ReadSentence() {
+  if (reader_ != nullptr || cached_) {
+    return shuffle_size_ > 0 ? ReadShuffledSentence() : ReadCorpusSentence();
+  }
+  if (queue_ != nullptr) return queue_->Pop();
+  if (fed_.empty()) return nullptr;
+  Sentence *sentence = fed_.front().release();
+  fed_.pop_front();
+  return sentence;
+}
+
+void SentenceBatch::FillBuffer() {
+  while (static_cast<int>(buffer_.size()) < lookahead_) {
+    Sentence *sentence = ReadSentence();
+    if (sentence == nullptr) break;
+    buffer_.emplace_back(num_read_++, std::unique_ptr<Sentence>(sentence));
+  }
+
+  // Sorts so that the longest sentence is at the back, and sentences of equal
+  // length are taken in input order.
+  std::sort(buffer_.begin(), buffer_.end(),
+            [](const std::pair<int64, std::unique_ptr<Sentence>> &a,
+               const std::pair<int64, std::unique_ptr<Sentence>> &b) {
+              const int a_size = a.second->token_size();
+              const int b_size = b.second->token_size();
+              return a_size != b_size ? a_size < b_size : a.first > b.first;
+            });
 }
 
 bool SentenceBatch::AdvanceSentence(int index) {
-  if (sentences_[index] == nullptr) ++size_;
-  sentences_[index].reset();
-  std::unique_ptr<Sentence> sentence(reader_->Read());
-  if (sentence == nullptr) {
-    --size_;
+  Release(index);
+  std::unique_ptr<Sentence> sentence;
+  int64 sequence = -1;
+  if (pending_ != nullptr) {
+    sentence = std::move(pending_);
+    sequence = pending_sequence_;
+  } else if (lookahead_ > 0) {
+    if (buffer_.empty()) FillBuffer();
+    if (!buffer_.empty()) {
+      sequence = buffer_.back().first;
+      sentence = std::move(buffer_.back().second);
+      buffer_.pop_back();
+    }
+  } else {
+    sentence.reset(ReadSentence());
+    if (sentence != nullptr) sequence = num_read_++;
+  }
+  if (sentence == nullptr) return false;
+
+  // Holds the sentence back if it does not fit in the token budget.
+  if (max_tokens_ > 0 && size_ > 0 &&
+      num_tokens_ + sentence->token_size() > max_tokens_) {
+    pending_ = std::move(sentence);
+    pending_sequence_ = sequence;
     return false;
   }
 
   // Preprocess the new sentence for the parser state.
+  ++size_;
+  slot_tokens_[index] = sentence->token_size();
+  num_tokens_ += slot_tokens_[index];
   sentences_[index] = std::move(sentence);
+  sequences_[index] = sequence;
   return true;
 }
 
@@ -16,10 +16,13 @@ limitations under the License.
 #ifndef SYNTAXNET_SENTENCE_BATCH_H_
 #define SYNTAXNET_SENTENCE_BATCH_H_
 
+#include <deque>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "syntaxnet/document_queue.h"
 #include "syntaxnet/embedding_feature_extractor.h"
 #include "syntaxnet/feature_extractor.h"
 #include "syntaxnet/parser_state.h"
@@ -29,34 +32,128 @@ limitations under the License.
 #include "syntaxnet/task_context.h"
 #include "syntaxnet/task_spec.pb.h"
 #include "syntaxnet/term_frequency_map.h"
+#include "tensorflow/core/lib/random/philox_random.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
 
 namespace syntaxnet {
 
 // Helper class to manage generating batches of preprocessed ParserState objects
-// by reading in multiple sentences in parallel.
+// by reading in multiple sentences in parallel. Sentences are read from a
+// corpus file, or from an in-memory DocumentQueue if the input has the
+// "sentence-queue" record format. A batch with an empty input name reads the
+// sentences handed to Feed() instead, e.g. by ops taking documents as input.
+//
+// With a positive lookahead, sentences are read ahead in blocks of lookahead
+// sentences, and each block enters the batch longest sentence first. Sentences
+// of similar length then run side by side, and the long sentences of a block
+// are started before its short ones rather than holding up the end of it.
+//
+// With a token budget, see set_max_tokens(), a sentence only enters a
+// non-empty batch if the batch then holds at most that many tokens in total.
+// Otherwise the slot is left empty and the sentence waits until enough tokens
+// have been released, so the work per step is bounded by the budget rather
+// than by the number of slots.
+//
+// Non-flag task parameters:
+// bool sentence_batch_cache (false):
+//   If true, the sentences of a corpus are kept in memory, serialized into one
+//   pool, as they are read in the first epoch. Once the corpus has been read to
+//   the end, rewinding replays the pool instead of reading and parsing the
+//   corpus again.
+// int sentence_batch_shuffle_buffer (0):
+//   If positive, corpus sentences are read ahead into a buffer of this many
+//   sentences, from which the next sentence is drawn at random, like a
+//   RandomShuffleQueue with as many elements left after each dequeue. Combined
+//   with text_reader_threads, reading and parsing run ahead on background
+//   threads while sentences are shuffled locally in every epoch.
+// int sentence_batch_shuffle_seed (0):
+//   Seed of the shuffle buffer. If positive, each replayed epoch of a cached
+//   corpus also visits the cached sentences in a new random order.
+// int <input name>_num_shards (1), int <input name>_shard (0):
+//   If a corpus input is split into several shards, e.g. one per worker of
+//   distributed training, the batch only reads the sentences of the given
+//   shard, i.e. every num_shards-th sentence of the corpus starting from the
+//   shard'th one. Only the sentences of the shard are cached and shuffled.
 class SentenceBatch {
  public:
-  SentenceBatch(int batch_size, string input_name)
+  SentenceBatch(int batch_size, string input_name, int lookahead = 0)
       : batch_size_(batch_size),
         input_name_(input_name),
-        sentences_(batch_size) {}
+        lookahead_(lookahead),
+        sentences_(batch_size),
+        sequences_(batch_size, -1),
+        slot_tokens_(batch_size, 0) {}
 
-  // Initializes all resources and opens the corpus file.
+  // Initializes all resources and opens the corpus file or queue.
   void Init(TaskContext *context);
 
   // Advances the index'th sentence in the batch to the next sentence. This will
   // create and preprocess a new ParserState for that element. Returns false if
-  // EOF is reached (if EOF, also sets the state to be nullptr.)
+  // EOF is reached (if EOF, also sets the state to be nullptr.) or if the next
+  // sentence does not fit in the token budget, leaving the slot empty.
   bool AdvanceSentence(int index);
 
-  // Rewinds the corpus reader.
-  void Rewind() { reader_->Reset(); }
+  // Limits the total number of tokens of the sentences in the batch to
+  // max_tokens, or lifts the limit if max_tokens is 0. A sentence longer than
+  // the budget still enters an empty batch.
+  void set_max_tokens(int max_tokens) { max_tokens_ = max_tokens; }
+  int max_tokens() const { return max_tokens_; }
+
+  // Returns the total number of tokens of the sentences in the batch.
+  int num_tokens() const { return num_tokens_; }
+
+  // Rewinds the corpus reader, or the cached corpus once it has been read to
+  // the end. Queues and fed sentences cannot be rewound; their next documents
+  // simply start the next epoch.
+  void Rewind();
+
+  // Appends a sentence to the sentences to read next. Only valid for batches
+  // with an empty input name. Takes ownership of the sentence.
+  void Feed(Sentence *sentence);
+
+  // Returns the number of fed sentences not read yet.
+  int num_fed() const { return fed_.size(); }
+
+  // Returns the number of sentences waiting to enter the batch, read ahead,
+  // held back by the token budget or still in the queue or fed, or -1 for a
+  // corpus, which always has more.
+  int backlog() const;
+
+  // Drops the index'th sentence without reading the next one, leaving the slot
+  // empty until it is advanced again.
+  void Release(int index) {
+    if (sentences_[index] != nullptr) --size_;
+    num_tokens_ -= slot_tokens_[index];
+    slot_tokens_[index] = 0;
+    sentences_[index].reset();
+    sequences_[index] = -1;
+  }
 
   int size() const { return size_; }
 
   Sentence *sentence(int index) { return sentences_[index].get(); }
 
+  // Returns the zero-based position in the input of the index'th sentence,
+  // counting across epochs. Sentences may enter the batch out of input order
+  // when reading ahead.
+  int64 sequence(int index) const { return sequences_[index]; }
+
  private:
+  // Returns the next sentence of the input, or nullptr if there is none. The
+  // caller takes ownership of the sentence.
+  Sentence *ReadSentence();
+
+  // Returns the next sentence of the corpus reader, caching it if enabled, or
+  // of the cached corpus once it is complete.
+  Sentence *ReadCorpusSentence();
+
+  // Returns a random sentence of the shuffle buffer after filling it up with
+  // corpus sentences, or nullptr at the end of the epoch.
+  Sentence *ReadShuffledSentence();
+
+  // Reads up to lookahead_ sentences into the empty look-ahead buffer.
+  void FillBuffer();
+
   // Running tally of non-nullptr states in the batch.
   int size_;
 
@@ -69,8 +166,77 @@ class SentenceBatch {
   // Reader for the corpus.
   std::unique_ptr<TextReader> reader_;
 
+  // Shard of the corpus to read, and the position in the corpus of the next
+  // sentence of the reader in the current epoch.
+  int shard_ = 0;
+  int num_shards_ = 1;
+  int64 corpus_position_ = 0;
+
+  // Whether corpus sentences are cached, and whether the cache holds the whole
+  // corpus and replaces the reader.
+  bool cache_ = false;
+  bool cached_ = false;
+
+  // Cached sentences, serialized back to back in a pool. The i'th sentence is
+  // [cache_offsets_[i], cache_offsets_[i + 1]) of the pool.
+  string cache_pool_;
+  std::vector<size_t> cache_offsets_;
+
+  // Order in which the cached sentences are replayed, and the position in it
+  // of the next sentence.
+  std::vector<int> cache_order_;
+  size_t cache_position_ = 0;
+
+  // Whether replayed epochs of the cached corpus are shuffled.
+  bool shuffle_cache_ = false;
+
+  // Maximum number of sentences in the shuffle buffer, or 0 to read corpus
+  // sentences in order.
+  size_t shuffle_size_ = 0;
+
+  // Sentences read ahead for shuffling, and whether the current epoch of the
+  // corpus has been read to the end.
+  std::vector<std::unique_ptr<Sentence>> shuffle_buffer_;
+  bool shuffle_done_ = false;
+
+  // Generator for shuffling.
+  std::unique_ptr<tensorflow::random::PhiloxRandom> philox_;
+  std::unique_ptr<tensorflow::random::SimplePhilox> random_;
+
+  // Queue to read from instead of the corpus reader, if non-null. Not owned.
+  DocumentQueue *queue_ = nullptr;
+
+  // Sentences fed to a batch without input, oldest first.
+  std::deque<std::unique_ptr<Sentence>> fed_;
+
+  // Number of sentences to read ahead and sort by length, or 0 to read the
+  // sentences in input order.
+  int lookahead_;
+
+  // Sentences read ahead along with their input positions, in order of
+  // increasing token count. Sentences are taken from the back.
+  std::vector<std::pair<int64, std::unique_ptr<Sentence>>> buffer_;
+
+  // Number of sentences read from the input so far.
+  int64 num_read_ = 0;
+
+  // Maximum number of tokens in the batch, or 0 for no limit, and the number
+  // of tokens of the sentences in the batch.
+  int max_tokens_ = 0;
+  int num_tokens_ = 0;
+
+  // Sentence held back by the token budget, if any, and its input position.
+  std::unique_ptr<Sentence> pending_;
+  int64 pending_sequence_ = -1;
+
   // Batch: Sentence objects.
   std::vector<std::unique_ptr<Sentence>> sentences_;
+
+  // Batch: input positions of the sentences.
+  std::vector<int64> sequences_;
+
+  // Batch: token counts of the sentences when they entered the batch.
+  std::vector<int> slot_tokens_;
 };
 
 }  // namespace syntaxnet
@@ -0,0 +1,170 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/sentence_batch.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+class SentenceBatchTest : public ::testing::Test {
+ protected:
+  // Writes a tokenized text corpus of num_sentences sentences, the i'th
+  // holding the single word "word<i>", and sets it as the "corpus" input.
+  void WriteCorpus(int num_sentences) {
+    path_ = utils::JoinPath({tensorflow::testing::TmpDir(), "corpus"});
+    string text;
+    for (int i = 0; i < num_sentences; ++i) {
+      tensorflow::strings::StrAppend(&text, "word", i, "\n");
+    }
+    TF_CHECK_OK(tensorflow::WriteStringToFile(tensorflow::Env::Default(),
+                                              path_, text));
+    TaskInput *input = context_.GetInput("corpus");
+    input->add_record_format("tokenized-text");
+    input->add_part()->set_file_pattern(path_);
+  }
+
+  // Reads the words of the sentences of one epoch through the batch, and
+  // rewinds it.
+  static std::vector<string> ReadEpoch(SentenceBatch *batch) {
+    std::vector<string> words;
+    while (batch->AdvanceSentence(0)) {
+      words.push_back(batch->sentence(0)->token(0).word());
+    }
+    batch->Rewind();
+    return words;
+  }
+
+  string path_;
+  TaskContext context_;
+};
+
+TEST_F(SentenceBatchTest, CachedCorpusIsReplayed) {
+  WriteCorpus(10);
+  context_.SetParameter("sentence_batch_cache", "true");
+  SentenceBatch batch(1, "corpus");
+  batch.Init(&context_);
+  const std::vector<string> first = ReadEpoch(&batch);
+  ASSERT_EQ(10, first.size());
+  EXPECT_EQ("word3", first[3]);
+
+  // Later epochs no longer read the corpus.
+  TF_CHECK_OK(tensorflow::Env::Default()->DeleteFile(path_));
+  EXPECT_EQ(first, ReadEpoch(&batch));
+  EXPECT_EQ(first, ReadEpoch(&batch));
+}
+
+TEST_F(SentenceBatchTest, CachedCorpusIsReshuffled) {
+  WriteCorpus(50);
+  context_.SetParameter("sentence_batch_cache", "true");
+  context_.SetParameter("sentence_batch_shuffle_seed", "7");
+  SentenceBatch batch(1, "corpus");
+  batch.Init(&context_);
+  const std::vector<string> first = ReadEpoch(&batch);
+  const std::vector<string> second = ReadEpoch(&batch);
+  const std::vector<string> third = ReadEpoch(&batch);
+  EXPECT_NE(first, second);
+  EXPECT_NE(second, third);
+  std::vector<string> sorted = first;
+  std::vector<string> sorted_third = third;
+  std::sort(sorted.begin(), sorted.end());
+  std::sort(sorted_third.begin(), sorted_third.end());
+  EXPECT_EQ(sorted, sorted_third);
+}
+
+TEST_F(SentenceBatchTest, ShuffleBufferPermutesEachEpoch) {
+  WriteCorpus(50);
+  context_.SetParameter("sentence_batch_shuffle_buffer", "8");
+  context_.SetParameter("text_reader_threads", "1");
+  SentenceBatch batch(1, "corpus");
+  batch.Init(&context_);
+  std::vector<string> expected;
+  for (int i = 0; i < 50; ++i) {
+    expected.push_back(tensorflow::strings::StrCat("word", i));
+  }
+  std::sort(expected.begin(), expected.end());
+  for (int epoch = 0; epoch < 2; ++epoch) {
+    std::vector<string> words = ReadEpoch(&batch);
+    EXPECT_NE("word0 word1 word2 word3 word4",
+              tensorflow::str_util::Join(
+                  std::vector<string>(words.begin(), words.begin() + 5), " "));
+    std::sort(words.begin(), words.end());
+    EXPECT_EQ(expected, words);
+  }
+}
+
+TEST_F(SentenceBatchTest, ShardReadsEveryNthSentence) {
+  WriteCorpus(10);
+  context_.SetParameter("corpus_num_shards", "3");
+  context_.SetParameter("corpus_shard", "1");
+  context_.SetParameter("text_reader_threads", "1");
+  SentenceBatch batch(1, "corpus");
+  batch.Init(&context_);
+  const std::vector<string> expected = {"word1", "word4", "word7"};
+  EXPECT_EQ(expected, ReadEpoch(&batch));
+  EXPECT_EQ(expected, ReadEpoch(&batch));
+}
+
+TEST_F(SentenceBatchTest, TokenBudgetHoldsBackSentences) {
+  SentenceBatch batch(3, "");
+  batch.Init(&context_);
+  batch.set_max_tokens(5);
+  for (const int num_tokens : {2, 2, 3, 1, 7}) {
+    Sentence *sentence = new Sentence();
+    for (int i = 0; i < num_tokens; ++i) sentence->add_token()->set_word("a");
+    batch.Feed(sentence);
+  }
+
+  // The third sentence does not fit next to the first two.
+  EXPECT_TRUE(batch.AdvanceSentence(0));
+  EXPECT_TRUE(batch.AdvanceSentence(1));
+  EXPECT_FALSE(batch.AdvanceSentence(2));
+  EXPECT_EQ(nullptr, batch.sentence(2));
+  EXPECT_EQ(4, batch.num_tokens());
+  EXPECT_EQ(3, batch.backlog());
+
+  // It enters once the first one is done.
+  EXPECT_TRUE(batch.AdvanceSentence(0));
+  EXPECT_EQ(2, batch.sequence(0));
+  EXPECT_EQ(5, batch.num_tokens());
+  EXPECT_FALSE(batch.AdvanceSentence(2));
+  batch.Release(1);
+  EXPECT_TRUE(batch.AdvanceSentence(2));
+  EXPECT_EQ(3, batch.sequence(2));
+  EXPECT_EQ(4, batch.num_tokens());
+
+  // A sentence over the budget only enters an empty batch.
+  EXPECT_FALSE(batch.AdvanceSentence(1));
+  batch.Release(0);
+  batch.Release(2);
+  EXPECT_TRUE(batch.AdvanceSentence(1));
+  EXPECT_EQ(7, batch.num_tokens());
+  EXPECT_EQ(1, batch.size());
+}
+
+}  // namespace syntaxnet
@@ -16,6 +16,8 @@ limitations under the License.
 #include "syntaxnet/sentence_features.h"
 #include "syntaxnet/char_properties.h"
 #include "syntaxnet/registry.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "util/utf8/unicodetext.h"
 #include "util/utf8/unilib.h"
 #include "util/utf8/unilib_utf8_utils.h"
@@ -57,6 +59,61 @@ string TermFrequencyMapFeature::WorkspaceName() const {
                                              min_freq_, max_num_terms_);
 }
 
+string TermFrequencyMapFeature::LexiconKey() const {
+  return SharedStoreUtils::CreateDefaultName(file_name_, min_freq_,
+                                             max_num_terms_);
+}
+
+HashedWord::~HashedWord() {
+  if (term_map_ != nullptr) {
+    SharedStore::Release(term_map_);
+    term_map_ = nullptr;
+  }
+}
+
+void HashedWord::Setup(TaskContext *context) {
+  TokenLookupFeature::Setup(context);
+  context->GetInput("word-map", "text", "");
+}
+
+void HashedWord::Init(TaskContext *context) {
+  num_buckets_ = GetIntParameter("buckets", 100000);
+  CHECK_GT(num_buckets_, 0) << "Hashed words need at least one bucket";
+  max_num_terms_ = GetIntParameter("exact-terms", 0);
+  min_freq_ = GetIntParameter("min-freq", 0);
+  if (max_num_terms_ > 0) {
+    const string file_name =
+        context->InputFile(*context->GetInput("word-map"));
+    term_map_ = SharedStoreUtils::GetWithDefaultName<TermFrequencyMap>(
+        file_name, min_freq_, max_num_terms_);
+  }
+  TokenLookupFeature::Init(context);
+}
+
+FeatureValue HashedWord::ComputeValue(const Token &token) const {
+  const string &word = token.word();
+  if (term_map_ != nullptr) {
+    const int index = term_map_->LookupIndex(word, -1);
+    if (index >= 0) return index;
+  }
+  return NumExactTerms() + tensorflow::Fingerprint64(word) % num_buckets_;
+}
+
+string HashedWord::GetFeatureValueName(FeatureValue value) const {
+  if (value >= 0 && value < NumExactTerms()) return term_map_->GetTerm(value);
+  if (value >= NumExactTerms() && value < NumValues()) {
+    return tensorflow::strings::StrCat("<BUCKET_", value - NumExactTerms(),
+                                       ">");
+  }
+  LOG(ERROR) << "Invalid feature value: " << value;
+  return "<INVALID>";
+}
+
+string HashedWord::WorkspaceName() const {
+  return SharedStoreUtils::CreateDefaultName("hashed-word", num_buckets_,
+                                             min_freq_, max_num_terms_);
+}
+
 TermFrequencyMapSetFeature::~TermFrequencyMapSetFeature() {
   if (term_map_ != nullptr) {
     SharedStore::Release(term_map_);
@@ -82,37 +139,59 @@ string TermFrequencyMapSetFeature::WorkspaceName() const {
       "term-frequency-map-set", input_name_, min_freq_, max_num_terms_);
 }
 
-namespace {
-void GetUTF8Chars(const string &word, vector<tensorflow::StringPiece> *chars) {
-  UnicodeText text;
-  text.PointToUTF8(word.c_str(), word.size());
-  for (UnicodeText::const_iterator it = text.begin(); it != text.end(); ++it) {
-    chars->push_back(tensorflow::StringPiece(it.utf8_data(), it.utf8_length()));
-  }
+
+const char NormalizedTokensWorkspace::kWorkspaceName[] = "normalized-tokens";
+
+NormalizedTokensWorkspace::NormalizedTokensWorkspace(const Sentence &sentence) {
+  Normalize(sentence);
 }
 
-int UTF8FirstLetterNumBytes(const char *utf8_str) {
-  if (*utf8_str == '\0') return 0;
-  return UniLib::OneCharLen(utf8_str);
+const NormalizedTokensWorkspace &NormalizedTokensWorkspace::GetOrCreate(
+    int index, const Sentence &sentence, WorkspaceSet *workspaces) {
+  if (!workspaces->Has<NormalizedTokensWorkspace>(index)) {
+    NormalizedTokensWorkspace *workspace =
+        workspaces->Reclaim<NormalizedTokensWorkspace>(index);
+    if (workspace == nullptr) {
+      workspace = new NormalizedTokensWorkspace(sentence);
+    } else {
+      workspace->Normalize(sentence);
+    }
+    workspaces->Set<NormalizedTokensWorkspace>(index, workspace);
+  }
+  return workspaces->Get<NormalizedTokensWorkspace>(index);
 }
 
-}  // namespace
+void NormalizedTokensWorkspace::Normalize(const Sentence &sentence) {
+  tokens_.resize(sentence.token_size());
+  for (int i = 0; i < sentence.token_size(); ++i) {
+    const string &word = sentence.token(i).word();
+    NormalizedToken &token = tokens_[i];
+    utils::Lowercase(word, &token.lowercase_word);
+    token.chars.clear();
+    UniLib::SplitIntoChars(word, &token.chars);
+  }
+}
 
 void CharNgram::GetTokenIndices(const Token &token, vector<int> *values) const {
   values->clear();
-  vector<tensorflow::StringPiece> char_sp;
-  if (use_terminators_) char_sp.push_back("^");
-  GetUTF8Chars(token.word(), &char_sp);
-  if (use_terminators_) char_sp.push_back("$");
-  for (int start = 0; start < char_sp.size(); ++start) {
-    string char_ngram;
-    for (int index = 0;
-         index < max_char_ngram_length_ && start + index < char_sp.size();
-         ++index) {
-      tensorflow::StringPiece c = char_sp[start + index];
-      if (c == " ") break;  // Never add char ngrams containing spaces.
-      tensorflow::strings::StrAppend(&char_ngram, c);
-      int value = LookupIndex(char_ngram);
+
+  // The ngrams are looked up as pieces of the word, padded with the
+  // terminators if used, so that no string is built per ngram.
+  const string padded =
+      use_terminators_ ? tensorflow::strings::StrCat("^", token.word(), "$")
+                       : string();
+  const string &word = use_terminators_ ? padded : token.word();
+  UnicodeText text;
+  text.PointToUTF8(word.data(), word.size());
+  for (UnicodeText::const_iterator start = text.begin(); start != text.end();
+       ++start) {
+    UnicodeText::const_iterator end = start;
+    for (int length = 0; length < max_char_ngram_length_ && end != text.end();
+         ++length) {
+      if (*end == ' ') break;  // Never add char ngrams containing spaces.
+      ++end;
+      const int value = LookupIndex(tensorflow::StringPiece(
+          start.utf8_data(), end.utf8_data() - start.utf8_data()));
       if (value != -1) {  // Skip unknown values.
         values->push_back(value);
       }
@@ -146,7 +225,8 @@ string Hyphen::GetFeatureValueName(FeatureValue value) const {
 
 FeatureValue Hyphen::ComputeValue(const Token &token) const {
   const string &word = token.word();
-  return (word.find('-') < word.length() ? HAS_HYPHEN : NO_HYPHEN);
+  const CharClasses classes = ClassifyChars(word.data(), word.size());
+  return (classes.any & kHyphenClass) ? HAS_HYPHEN : NO_HYPHEN;
 }
 
 void Capitalization::Setup(TaskContext *context) {
@@ -157,8 +237,8 @@ void Capitalization::Setup(TaskContext *context) {
 void Capitalization::Preprocess(WorkspaceSet *workspaces,
                                 Sentence *sentence) const {
   if (workspaces->Has<VectorIntWorkspace>(Workspace())) return;
-  VectorIntWorkspace *workspace =
-      new VectorIntWorkspace(sentence->token_size());
+  VectorIntWorkspace *workspace = VectorIntWorkspace::Reclaim(
+      workspaces, Workspace(), sentence->token_size());
   for (int i = 0; i < sentence->token_size(); ++i) {
     const int value = ComputeValueWithFocus(sentence->token(i), i);
     workspace->set_element(i, value);
@@ -192,12 +272,9 @@ FeatureValue Capitalization::ComputeValueWithFocus(const Token &token,
   if (utf8_) {
     LOG(FATAL) << "Not implemented.";
   } else {
-    const char *str = word.c_str();
-    for (int i = 0; i < word.length(); ++i) {
-      const char c = str[i];
-      has_upper = (has_upper || (c >= 'A' && c <= 'Z'));
-      has_lower = (has_lower || (c >= 'a' && c <= 'z'));
-    }
+    const CharClasses classes = ClassifyChars(word.data(), word.size());
+    has_upper = (classes.any & kAsciiUppercaseClass) != 0;
+    has_lower = (classes.any & kAsciiLowercaseClass) != 0;
   }
 
   // Compute simple values.
@@ -225,21 +302,10 @@ string PunctuationAmount::GetFeatureValueName(FeatureValue value) const {
 
 FeatureValue PunctuationAmount::ComputeValue(const Token &token) const {
   const string &word = token.word();
-  bool has_punctuation = false;
-  bool all_punctuation = true;
-
-  const char *start = word.c_str();
-  const char *end = word.c_str() + word.size();
-  while (start < end) {
-    int char_length = UTF8FirstLetterNumBytes(start);
-    bool char_is_punct = is_punctuation_or_symbol(start, char_length);
-    all_punctuation &= char_is_punct;
-    has_punctuation |= char_is_punct;
-    if (!all_punctuation && has_punctuation) return SOME_PUNCTUATION;
-    start += char_length;
-  }
-  if (!all_punctuation) return NO_PUNCTUATION;
-  return ALL_PUNCTUATION;
+  const CharClasses classes = ClassifyChars(word.data(), word.size());
+  if (classes.all & kPunctuationOrSymbolClass) return ALL_PUNCTUATION;
+  if (classes.any & kPunctuationOrSymbolClass) return SOME_PUNCTUATION;
+  return NO_PUNCTUATION;
 }
 
 string Quote::GetFeatureValueName(FeatureValue value) const {
@@ -263,9 +329,9 @@ FeatureValue Quote::ComputeValue(const Token &token) const {
   if (word == "``") return OPEN_QUOTE;
   if (word == "''") return CLOSE_QUOTE;
   if (word.length() == 1) {
-    int char_len = UTF8FirstLetterNumBytes(word.c_str());
-    bool is_open = is_open_quote(word.c_str(), char_len);
-    bool is_close = is_close_quote(word.c_str(), char_len);
+    const int classes = ClassifyChars(word.data(), 1).any;
+    const bool is_open = (classes & kOpenQuoteClass) != 0;
+    const bool is_close = (classes & kCloseQuoteClass) != 0;
     if (is_open && !is_close) return OPEN_QUOTE;
     if (is_close && !is_open) return CLOSE_QUOTE;
     if (is_open && is_close) return UNKNOWN_QUOTE;
@@ -275,8 +341,8 @@ FeatureValue Quote::ComputeValue(const Token &token) const {
 
 void Quote::Preprocess(WorkspaceSet *workspaces, Sentence *sentence) const {
   if (workspaces->Has<VectorIntWorkspace>(Workspace())) return;
-  VectorIntWorkspace *workspace =
-      new VectorIntWorkspace(sentence->token_size());
+  VectorIntWorkspace *workspace = VectorIntWorkspace::Reclaim(
+      workspaces, Workspace(), sentence->token_size());
 
   // For double quote ", it is unknown whether they are open or closed without
   // looking at the prior tokens in the sentence.  in_quote is true iff an odd
@@ -309,16 +375,10 @@ string Digit::GetFeatureValueName(FeatureValue value) const {
 
 FeatureValue Digit::ComputeValue(const Token &token) const {
   const string &word = token.word();
-  bool has_digit = isdigit(word[0]);
-  bool all_digit = has_digit;
-  for (size_t i = 1; i < word.length(); ++i) {
-    bool char_is_digit = isdigit(word[i]);
-    all_digit = all_digit && char_is_digit;
-    has_digit = has_digit || char_is_digit;
-    if (!all_digit && has_digit) return SOME_DIGIT;
-  }
-  if (!all_digit) return NO_DIGIT;
-  return ALL_DIGIT;
+  const CharClasses classes = ClassifyChars(word.data(), word.size());
+  if (!(classes.any & kAsciiDigitClass)) return NO_DIGIT;
+  if (classes.all & kAsciiDigitClass) return ALL_DIGIT;
+  return SOME_DIGIT;
 }
 
 AffixTableFeature::AffixTableFeature(AffixTable::Type type)
@@ -345,10 +405,7 @@ string AffixTableFeature::WorkspaceName() const {
 static AffixTable *CreateAffixTable(const string &filename,
                                     AffixTable::Type type) {
   AffixTable *affix_table = new AffixTable(type, 1);
-  std::unique_ptr<tensorflow::RandomAccessFile> file;
-  TF_CHECK_OK(tensorflow::Env::Default()->NewRandomAccessFile(filename, &file));
-  ProtoRecordReader reader(file.release());
-  affix_table->Read(&reader);
+  affix_table->Load(filename);
   return affix_table;
 }
 
@@ -360,12 +417,12 @@ void AffixTableFeature::Setup(TaskContext *context) {
 }
 
 void AffixTableFeature::Init(TaskContext *context) {
-  string filename = context->InputFile(*context->GetInput(input_name_));
+  file_name_ = context->InputFile(*context->GetInput(input_name_));
 
   // Get the shared AffixTable object.
   std::function<AffixTable *()> closure =
-      std::bind(CreateAffixTable, filename, type_);
-  affix_table_ = SharedStore::ClosureGetOrDie(filename, &closure);
+      std::bind(CreateAffixTable, file_name_, type_);
+  affix_table_ = SharedStore::ClosureGetOrDie(file_name_, &closure);
   CHECK_GE(affix_table_->max_length(), affix_length_)
       << "Affixes of length " << affix_length_ << " needed, but the affix "
       <<"table only provides affixes of length <= "
@@ -386,7 +443,26 @@ FeatureValue AffixTableFeature::ComputeValue(const Token &token) const {
     start = end = text.end();
     for (int i = 0; i < affix_length_; ++i) --start;
   }
-  string affix(start.utf8_data(), end.utf8_data() - start.utf8_data());
+  const StringPiece affix(start.utf8_data(),
+                          end.utf8_data() - start.utf8_data());
+  int affix_id = affix_table_->AffixId(affix);
+  return affix_id == -1 ? UnknownValue() : affix_id;
+}
+
+FeatureValue AffixTableFeature::ComputeNormalizedValue(
+    const Token &token, const NormalizedToken &normalized) const {
+  const vector<StringPiece> &chars = normalized.chars;
+  if (affix_length_ > static_cast<int>(chars.size()) || affix_length_ == 0) {
+    return ComputeValue(token);
+  }
+  const StringPiece &first = type_ == AffixTable::PREFIX
+                                 ? chars.front()
+                                 : chars[chars.size() - affix_length_];
+  const StringPiece &last = type_ == AffixTable::PREFIX
+                                ? chars[affix_length_ - 1]
+                                : chars.back();
+  const StringPiece affix(first.data(),
+                          last.data() + last.size() - first.data());
   int affix_id = affix_table_->AffixId(affix);
   return affix_id == -1 ? UnknownValue() : affix_id;
 }
@@ -405,6 +481,7 @@ REGISTER_CLASS_REGISTRY("sentence+index feature function", SentenceFeature);
 
 // Register the features defined in the header.
 REGISTER_SENTENCE_IDX_FEATURE("word", Word);
+REGISTER_SENTENCE_IDX_FEATURE("hashed-word", HashedWord);
 REGISTER_SENTENCE_IDX_FEATURE("char", Char);
 REGISTER_SENTENCE_IDX_FEATURE("lcword", LowercaseWord);
 REGISTER_SENTENCE_IDX_FEATURE("tag", Tag);
@@ -20,11 +20,15 @@ limitations under the License.
 #ifndef SYNTAXNET_SENTENCE_FEATURES_H_
 #define SYNTAXNET_SENTENCE_FEATURES_H_
 
+#include <memory>
+
 #include "syntaxnet/affix.h"
 #include "syntaxnet/feature_extractor.h"
 #include "syntaxnet/feature_types.h"
+#include "syntaxnet/lru_cache.h"
 #include "syntaxnet/segmenter_utils.h"
 #include "syntaxnet/shared_store.h"
+#include "syntaxnet/shared_token_values.h"
 #include "syntaxnet/task_context.h"
 #include "syntaxnet/workspace.h"
 
@@ -39,17 +43,101 @@ typedef FeatureFunction<Sentence, int> SentenceFeature;
 template <class DER>
 using Locator = FeatureLocator<DER, Sentence, int>;
 
+// Normalized forms of a token, computed once per sentence and shared by all the
+// features of the sentence that use them.
+struct NormalizedToken {
+  // Lowercased word.
+  string lowercase_word;
+
+  // UTF-8 characters of the word. These point into the word of the token,
+  // which feature preprocessing does not modify.
+  vector<StringPiece> chars;
+};
+
+// A workspace holding the normalized forms of the tokens of a sentence.
+class NormalizedTokensWorkspace : public Workspace {
+ public:
+  // Name of the shared workspace.
+  static const char kWorkspaceName[];
+
+  // Normalizes the tokens of the sentence.
+  explicit NormalizedTokensWorkspace(const Sentence &sentence);
+
+  // Returns the name of this type of workspace.
+  static string TypeName() { return "NormalizedTokens"; }
+
+  // Returns the workspace with the given index for the sentence, normalizing
+  // the sentence first if needed.
+  static const NormalizedTokensWorkspace &GetOrCreate(
+      int index, const Sentence &sentence, WorkspaceSet *workspaces);
+
+  // Returns the normalized forms of the i'th token.
+  const NormalizedToken &token(int i) const { return tokens_[i]; }
+
+  int size() const { return tokens_.size(); }
+
+ private:
+  // Normalizes the tokens of the sentence, reusing the storage of the tokens
+  // normalized before.
+  void Normalize(const Sentence &sentence);
+
+  // Normalized forms of the tokens.
+  vector<NormalizedToken> tokens_;
+};
+
 class TokenLookupFeature : public SentenceFeature {
  public:
+  ~TokenLookupFeature() override { SharedTokenValues::Release(shared_); }
+
+  // Creates the feature type, and the lookup cache if the task parameter
+  // "token_lookup_cache_size" is positive and the feature value only depends
+  // on the word. If the task parameter "shared_token_values_size" is positive
+  // and the values are shareable, they are also shared per sentence with the
+  // other readers of the process, e.g. between a pipelined tagger and parser.
   void Init(TaskContext *context) override {
     set_feature_type(new ResourceBasedFeatureType<TokenLookupFeature>(
         name(), this, {{NumValues(), "<OUTSIDE>"}}));
+    const int cache_size = context->Get("token_lookup_cache_size", 0);
+    if (cache_size > 0 && ValueDependsOnWordOnly()) {
+      cache_.reset(new LruCache<FeatureValue>(cache_size));
+    }
+    const int shared_size = context->Get("shared_token_values_size", 0);
+    if (shared_size > 0 && ValuesAreShareable() && !LexiconKey().empty()) {
+      shared_ = SharedTokenValues::Get(shared_size);
+      shared_key_ = SharedTokenValues::FeatureKey(
+          tensorflow::strings::StrCat(FunctionName(), "\n", LexiconKey()));
+    }
   }
 
   // Given a position in a sentence and workspaces, looks up the corresponding
   // feature value. The index is relative to the start of the sentence.
   virtual FeatureValue ComputeValue(const Token &token) const = 0;
 
+  // Looks up the feature value from the token and its normalized forms.
+  // Features overriding this also override UsesNormalizedTokens().
+  virtual FeatureValue ComputeNormalizedValue(
+      const Token &token, const NormalizedToken &normalized) const {
+    return ComputeValue(token);
+  }
+
+  // Returns true if the feature computes its values with
+  // ComputeNormalizedValue().
+  virtual bool UsesNormalizedTokens() const { return false; }
+
+  // Returns true if the feature value is a function of the word of the token,
+  // so that values can be cached by word. Features that do more than one map
+  // lookup per token should override this.
+  virtual bool ValueDependsOnWordOnly() const { return false; }
+
+  // Returns true if the values of the tokens of a sentence are a function of
+  // their words, so that they can be shared with the features of other readers
+  // that look them up in the same lexicon.
+  virtual bool ValuesAreShareable() const { return ValueDependsOnWordOnly(); }
+
+  // Returns the identity of the lexicon the values are looked up in, e.g. its
+  // file, or an empty string if the values are never shared.
+  virtual string LexiconKey() const { return ""; }
+
   // Number of unique values.
   virtual int64 NumValues() const = 0;
 
@@ -59,22 +147,58 @@ class TokenLookupFeature : public SentenceFeature {
   // Name of the shared workspace.
   virtual string WorkspaceName() const = 0;
 
-  // Runs ComputeValue for each token in the sentence.
+  // Runs ComputeValue for each token in the sentence, unless another reader
+  // has shared the values for the same words. Tokens are normalized when the
+  // first value not in the lookup cache is computed.
   void Preprocess(WorkspaceSet *workspaces,
                   Sentence *sentence) const override {
     if (workspaces->Has<VectorIntWorkspace>(workspace_)) return;
-    VectorIntWorkspace *workspace = new VectorIntWorkspace(
-        sentence->token_size());
+    VectorIntWorkspace *workspace = VectorIntWorkspace::Reclaim(
+        workspaces, workspace_, sentence->token_size());
+    uint64 shared_key = 0;
+    if (shared_ != nullptr) {
+      shared_key = SharedTokenValues::Key(
+          shared_key_, WordsKeyWorkspace::GetOrCreate(words_key_workspace_,
+                                                      *sentence, workspaces));
+      if (shared_->Lookup(shared_key, workspace)) {
+        workspaces->Set<VectorIntWorkspace>(workspace_, workspace);
+        return;
+      }
+    }
+    const NormalizedTokensWorkspace *normalized = nullptr;
     for (int i = 0; i < sentence->token_size(); ++i) {
-      const int value = ComputeValue(sentence->token(i));
+      const Token &token = sentence->token(i);
+      FeatureValue value;
+      if (cache_ == nullptr || !cache_->Lookup(token.word(), &value)) {
+        if (normalized_workspace_ == -1) {
+          value = ComputeValue(token);
+        } else {
+          if (normalized == nullptr) {
+            normalized = &NormalizedTokensWorkspace::GetOrCreate(
+                normalized_workspace_, *sentence, workspaces);
+          }
+          value = ComputeNormalizedValue(token, normalized->token(i));
+        }
+        if (cache_ != nullptr) cache_->Insert(token.word(), value);
+      }
       workspace->set_element(i, value);
     }
+    if (shared_ != nullptr) shared_->Insert(shared_key, *workspace);
     workspaces->Set<VectorIntWorkspace>(workspace_, workspace);
   }
 
-  // Requests a vector of int's to store in the workspace registry.
+  // Requests a vector of int's to store in the workspace registry, the
+  // normalized tokens if used, and the words key if the values are shared.
   void RequestWorkspaces(WorkspaceRegistry *registry) override {
     workspace_ = registry->Request<VectorIntWorkspace>(WorkspaceName());
+    if (UsesNormalizedTokens()) {
+      normalized_workspace_ = registry->Request<NormalizedTokensWorkspace>(
+          NormalizedTokensWorkspace::kWorkspaceName);
+    }
+    if (shared_ != nullptr) {
+      words_key_workspace_ = registry->Request<WordsKeyWorkspace>(
+          WordsKeyWorkspace::kWorkspaceName);
+    }
   }
 
   // Returns the precomputed value, or NumValues() for features outside
@@ -90,12 +214,26 @@ class TokenLookupFeature : public SentenceFeature {
 
  private:
   int workspace_;
+
+  // Workspace of the normalized tokens, or -1 if not used.
+  int normalized_workspace_ = -1;
+
+  // Cache of feature values by word, or null.
+  std::unique_ptr<LruCache<FeatureValue>> cache_;
+
+  // Values shared with the other readers of the process, or null, and the key
+  // of this feature and its lexicon there.
+  SharedTokenValues *shared_ = nullptr;
+  uint64 shared_key_ = 0;
+
+  // Workspace of the words key of the sentence, if the values are shared.
+  int words_key_workspace_ = -1;
 };
 
 // A multi purpose specialization of the feature. Processes the tokens in a
-// Sentence by looking up a value set for each token and storing that in
-// a VectorVectorInt workspace. Given a set of base values of size Size(),
-// reserves an extra value for unknown tokens.
+// Sentence by looking up a value set for each token and storing the sets of
+// all tokens in a CompactVectorVectorInt workspace. Given a set of base values
+// of size Size(), reserves an extra value for unknown tokens.
 class TokenLookupSetFeature : public SentenceFeature {
  public:
   void Init(TaskContext *context) override {
@@ -118,44 +256,35 @@ class TokenLookupSetFeature : public SentenceFeature {
   // Name of the shared workspace.
   virtual string WorkspaceName() const = 0;
 
-  // TokenLookupSetFeatures use VectorVectorIntWorkspaces by default.
+  // TokenLookupSetFeatures use CompactVectorVectorIntWorkspaces by default.
   void RequestWorkspaces(WorkspaceRegistry *registry) override {
-    workspace_ = registry->Request<VectorVectorIntWorkspace>(WorkspaceName());
+    workspace_ =
+        registry->Request<CompactVectorVectorIntWorkspace>(WorkspaceName());
   }
 
   // Default preprocessing: looks up a value set for each token in the Sentence.
   void Preprocess(WorkspaceSet *workspaces, Sentence *sentence) const override {
-    // Default preprocessing: lookup a value set for each token in the Sentence.
-    if (workspaces->Has<VectorVectorIntWorkspace>(workspace_)) return;
-    VectorVectorIntWorkspace *workspace =
-        new VectorVectorIntWorkspace(sentence->token_size());
+    if (workspaces->Has<CompactVectorVectorIntWorkspace>(workspace_)) return;
+    CompactVectorVectorIntWorkspace *workspace =
+        CompactVectorVectorIntWorkspace::Reclaim(workspaces, workspace_);
+    vector<int> values;
     for (int i = 0; i < sentence->token_size(); ++i) {
-      LookupToken(*workspaces, *sentence, i, workspace->mutable_elements(i));
+      values.clear();
+      LookupToken(*workspaces, *sentence, i, &values);
+      workspace->Append(values);
     }
-    workspaces->Set<VectorVectorIntWorkspace>(workspace_, workspace);
-  }
-
-  // Returns a pre-computed token value from the cache. This assumes the cache
-  // is populated.
-  const vector<int> &GetCachedValueSet(const WorkspaceSet &workspaces,
-                                       const Sentence &sentence,
-                                       int focus) const {
-    // Do bounds checking on focus.
-    CHECK_GE(focus, 0);
-    CHECK_LT(focus, sentence.token_size());
-
-    // Return value from cache.
-    return workspaces.Get<VectorVectorIntWorkspace>(workspace_).elements(focus);
+    workspaces->Set<CompactVectorVectorIntWorkspace>(workspace_, workspace);
   }
 
   // Adds any precomputed features at the given focus, if present.
   void Evaluate(const WorkspaceSet &workspaces, const Sentence &sentence,
                 int focus, FeatureVector *result) const override {
     if (focus >= 0 && focus < sentence.token_size()) {
-      const vector<int> &elements =
-          GetCachedValueSet(workspaces, sentence, focus);
-      for (auto &value : elements) {
-        result->add(this->feature_type(), value);
+      const CompactVectorVectorIntWorkspace &workspace =
+          workspaces.Get<CompactVectorVectorIntWorkspace>(workspace_);
+      for (const int *value = workspace.begin(focus);
+           value != workspace.end(focus); ++value) {
+        result->add(this->feature_type(), *value);
       }
     }
   }
@@ -197,6 +326,9 @@ class TermFrequencyMapFeature : public TokenLookupFeature {
   // Name of the shared workspace.
   string WorkspaceName() const override;
 
+  // The term map is identified by its file and its limits.
+  string LexiconKey() const override;
+
  protected:
   const TermFrequencyMap &term_map() const { return *term_map_; }
 
@@ -254,7 +386,7 @@ class TermFrequencyMapSetFeature : public TokenLookupSetFeature {
 
   // Returns the term index or the unknown value. Used inside GetTokenIndex()
   // specializations for convenience.
-  int LookupIndex(const string &term) const {
+  int LookupIndex(tensorflow::StringPiece term) const {
     return term_map_->LookupIndex(term, -1);
   }
 
@@ -300,9 +432,58 @@ class Word : public TermFrequencyMapFeature {
   Word() : TermFrequencyMapFeature("word-map") {}
 
   FeatureValue ComputeValue(const Token &token) const override {
-    string form = token.word();
-    return term_map().LookupIndex(form, UnknownValue());
+    return term_map().LookupIndex(token.word(), UnknownValue());
   }
+
+  // A single lookup is cheaper than the lookup cache, but the values of whole
+  // sentences are still worth sharing.
+  bool ValuesAreShareable() const override { return true; }
+};
+
+// Lookup feature that maps words to hash buckets with the fingerprint used by
+// the StringToHashBucketFast op, so that no map of all the words is held. With
+// the "exact-terms" option, the most frequent words of the "word-map" keep
+// their own ids, and only the other words are hashed. Options:
+//   buckets (default 100000): number of hash buckets.
+//   exact-terms (default 0): number of words of the word map to look up.
+//   min-freq (default 0): minimum frequency of the words looked up.
+class HashedWord : public TokenLookupFeature {
+ public:
+  ~HashedWord() override;
+
+  // Requests the word map, which is only read with exact terms.
+  void Setup(TaskContext *context) override;
+
+  // Loads the exact terms of the word map, if any.
+  void Init(TaskContext *context) override;
+
+  // Looks up the word in the exact terms, then hashes it.
+  FeatureValue ComputeValue(const Token &token) const override;
+
+  // Number of unique values: the exact terms, then the buckets.
+  int64 NumValues() const override { return NumExactTerms() + num_buckets_; }
+
+  // Returns the word of exact terms and the bucket of hashed words.
+  string GetFeatureValueName(FeatureValue value) const override;
+
+  // Name of the shared workspace.
+  string WorkspaceName() const override;
+
+ private:
+  // Returns the number of words looked up in the word map.
+  int NumExactTerms() const {
+    return term_map_ == nullptr ? 0 : term_map_->Size();
+  }
+
+  // Exact terms, or null if all words are hashed. Not owned.
+  const TermFrequencyMap *term_map_ = nullptr;
+
+  // Number of hash buckets.
+  int num_buckets_ = 0;
+
+  // Options of the exact terms.
+  int max_num_terms_ = 0;
+  int min_freq_ = 0;
 };
 
 class Char : public TermFrequencyMapFeature {
@@ -343,6 +524,15 @@ class LowercaseWord : public TermFrequencyMapFeature {
     const string lcword = utils::Lowercase(token.word());
     return term_map().LookupIndex(lcword, UnknownValue());
   }
+
+  FeatureValue ComputeNormalizedValue(
+      const Token &token, const NormalizedToken &normalized) const override {
+    return term_map().LookupIndex(normalized.lowercase_word, UnknownValue());
+  }
+
+  bool UsesNormalizedTokens() const override { return true; }
+
+  bool ValueDependsOnWordOnly() const override { return true; }
 };
 
 class Tag : public TermFrequencyMapFeature {
@@ -590,9 +780,20 @@ class AffixTableFeature : public TokenLookupFeature {
   // Looks up the affix for a given word.
   FeatureValue ComputeValue(const Token &token) const override;
 
+  // Looks up the affix from the characters of the word.
+  FeatureValue ComputeNormalizedValue(
+      const Token &token, const NormalizedToken &normalized) const override;
+
+  bool UsesNormalizedTokens() const override { return true; }
+
+  bool ValueDependsOnWordOnly() const override { return true; }
+
   // Returns the string associated with a value.
   string GetFeatureValueName(FeatureValue value) const override;
 
+  // The affix table is identified by its file.
+  string LexiconKey() const override { return file_name_; }
+
  private:
   // Size parameter for the affix table.
   int affix_length_;
@@ -600,6 +801,9 @@ class AffixTableFeature : public TokenLookupFeature {
   // Name of the input for the table.
   string input_name_;
 
+  // Filename of the table.
+  string file_name_;
+
   // The type of the affix table.
   const AffixTable::Type type_;
 
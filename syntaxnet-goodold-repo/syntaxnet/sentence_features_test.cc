@@ -18,6 +18,7 @@ limitations under the License.
 #include <string>
 #include <vector>
 
+#include "syntaxnet/affix.h"
 #include "syntaxnet/feature_extractor.h"
 #include "syntaxnet/populate_test_inputs.h"
 #include "syntaxnet/sentence.pb.h"
@@ -26,6 +27,8 @@ limitations under the License.
 #include "syntaxnet/utils.h"
 #include "syntaxnet/workspace.h"
 #include <gmock/gmock.h>
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/fingerprint.h"
 #include "tensorflow/core/platform/test.h"
 
 using testing::UnorderedElementsAreArray;
@@ -164,6 +167,27 @@ TEST_F(CommonSentenceFeaturesTest, TagFeaturePassesArgs) {
   EXPECT_EQ(2, extractor_->feature_type(0)->GetDomainSize());
 }
 
+TEST_F(CommonSentenceFeaturesTest, HashedWordFeature) {
+  PrepareFeature("hashed-word(buckets=10)");
+  EXPECT_EQ("<OUTSIDE>", ExtractFeature(-1));
+  EXPECT_EQ(tensorflow::strings::StrCat(
+                "<BUCKET_", tensorflow::Fingerprint64("saw") % 10, ">"),
+            ExtractFeature(1));
+  EXPECT_EQ(ExtractFeature(2), ExtractFeature(5));
+
+  // 10 buckets and <OUTSIDE>.
+  EXPECT_EQ(11, extractor_->feature_type(0)->GetDomainSize());
+}
+
+TEST_F(CommonSentenceFeaturesTest, HashedWordFeatureKeepsExactTerms) {
+  PrepareFeature("hashed-word(buckets=10,exact-terms=1)");
+  EXPECT_EQ("a", ExtractFeature(2));  // 'a' is the most frequent word
+  EXPECT_EQ(tensorflow::strings::StrCat(
+                "<BUCKET_", tensorflow::Fingerprint64("man") % 10, ">"),
+            ExtractFeature(3));
+  EXPECT_EQ(12, extractor_->feature_type(0)->GetDomainSize());
+}
+
 TEST_F(CommonSentenceFeaturesTest, OffsetPlusTag) {
   PrepareFeature("offset(-1).tag(min-freq=2)");
   EXPECT_EQ("<OUTSIDE>", ExtractFeature(-1));
@@ -234,6 +258,59 @@ TEST_F(CommonSentenceFeaturesTest, CapitalizationProcessesCorrectly) {
                         LOWERCASE, LOWERCASE, NON_ALPHABETIC});
 }
 
+TEST_F(CommonSentenceFeaturesTest, LookupCacheKeepsFeatureValues) {
+  TermFrequencyMap lcword_map;
+  lcword_map.Increment("i");
+  lcword_map.Increment("a");
+  creators_.Add(
+      "lc-word-map", "text", "",
+      [&lcword_map](const string &path) { lcword_map.Save(path); });
+  AffixTable suffixes(AffixTable::SUFFIX, 3);
+  for (const Token &token : sentence_.token()) {
+    suffixes.AddAffixesForWord(token.word().data(), token.word().size());
+  }
+  creators_.Add(
+      "suffix-table", "recordio", "affix-table",
+      [&suffixes](const string &path) { suffixes.SaveMapped(path); });
+
+  // Words repeated in the sentence are looked up in the cache.
+  context_.SetParameter("token_lookup_cache_size", "8");
+  PrepareFeature("lcword suffix(length=2)");
+  EXPECT_EQ("i,<UNKNOWN>", utils::Join(ExtractMultiFeature(0), ","));
+  EXPECT_EQ("<UNKNOWN>,aw", utils::Join(ExtractMultiFeature(1), ","));
+  EXPECT_EQ("a,<UNKNOWN>", utils::Join(ExtractMultiFeature(2), ","));
+  EXPECT_EQ("<UNKNOWN>,an", utils::Join(ExtractMultiFeature(3), ","));
+  EXPECT_EQ("a,<UNKNOWN>", utils::Join(ExtractMultiFeature(5), ","));
+  EXPECT_EQ("<UNKNOWN>,pe", utils::Join(ExtractMultiFeature(6), ","));
+}
+
+TEST_F(CommonSentenceFeaturesTest, SharesTokenValuesAcrossExtractors) {
+  SharedTokenValues *shared = SharedTokenValues::Get(8);
+  context_.SetParameter("shared_token_values_size", "8");
+  PrepareFeature("word");
+  EXPECT_EQ(1, shared->size());
+  EXPECT_EQ(0, shared->num_hits());
+
+  // Another extractor with the same feature and lexicon takes the values of
+  // the same words from the first one, even from another sentence object.
+  const Sentence copy = sentence_;
+  sentence_.mutable_token(1)->set_tag("NN");
+  PrepareFeature("input.word");
+  EXPECT_EQ(1, shared->num_hits());
+  EXPECT_EQ("saw", ExtractFeature(1));
+  EXPECT_EQ("telescope", ExtractFeature(6));
+  sentence_ = copy;
+
+  // Other words are computed again.
+  sentence_.mutable_token(1)->set_word("sees");
+  PrepareFeature("word");
+  EXPECT_EQ(1, shared->num_hits());
+  EXPECT_EQ(2, shared->size());
+  EXPECT_EQ("<UNKNOWN>", ExtractFeature(1));
+  sentence_ = copy;
+  SharedTokenValues::Release(shared);
+}
+
 class CharFeatureTest : public SentenceFeaturesTest {
  protected:
   CharFeatureTest()
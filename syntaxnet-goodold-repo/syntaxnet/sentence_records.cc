@@ -0,0 +1,274 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/sentence_records.h"
+
+#include <algorithm>
+
+#include "syntaxnet/document_format.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/lib/io/inputbuffer.h"
+
+namespace syntaxnet {
+namespace {
+
+// Sizes of the record framing: the header holds the length of the record and
+// its checksum, and the footer the checksum of the record.
+const int kHeaderSize = sizeof(uint64) + sizeof(uint32);
+const int kFooterSize = sizeof(uint32);
+
+// Returns the checksum of the given bytes, as stored in records.
+uint32 MaskedCrc(const char *data, size_t size) {
+  return tensorflow::crc32c::Mask(tensorflow::crc32c::Value(data, size));
+}
+
+}  // namespace
+
+const char SentenceRecordWriter::kIndexSuffix[] = ".index";
+
+bool SentenceRecordWriter::ParseCompression(const string &name,
+                                            Compression *compression) {
+  if (name == "none") {
+    *compression = NO_COMPRESSION;
+  } else if (name == "zlib") {
+    *compression = ZLIB_COMPRESSION;
+  } else if (name == "snappy") {
+    *compression = SNAPPY_COMPRESSION;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+SentenceRecordWriter::SentenceRecordWriter(const string &filename,
+                                           Compression compression)
+    : filename_(filename) {
+  TF_CHECK_OK(tensorflow::Env::Default()->NewWritableFile(filename, &file_));
+  if (compression == NO_COMPRESSION) {
+    writer_.reset(new tensorflow::io::RecordWriter(file_.get()));
+  } else {
+    tensorflow::io::BlockRecordWriterOptions options;
+    options.compression_type =
+        compression == SNAPPY_COMPRESSION
+            ? tensorflow::io::BlockRecordWriterOptions::SNAPPY_COMPRESSION
+            : tensorflow::io::BlockRecordWriterOptions::ZLIB_COMPRESSION;
+    block_writer_.reset(
+        new tensorflow::io::BlockRecordWriter(file_.get(), options));
+  }
+}
+
+SentenceRecordWriter::~SentenceRecordWriter() {
+  if (file_ != nullptr) Close();
+}
+
+void SentenceRecordWriter::Write(const Sentence &sentence) {
+  CHECK(file_ != nullptr) << "Writing to a closed file " << filename_;
+  const string record = sentence.SerializeAsString();
+  ++num_sentences_;
+  if (block_writer_ != nullptr) {
+    TF_CHECK_OK(block_writer_->WriteRecord(record));
+    return;
+  }
+  TF_CHECK_OK(writer_->WriteRecord(record));
+  offsets_.push_back(offset_);
+  offset_ += kHeaderSize + record.size() + kFooterSize;
+}
+
+void SentenceRecordWriter::Close() {
+  const bool compressed = block_writer_ != nullptr;
+  if (compressed) TF_CHECK_OK(block_writer_->Close());
+  block_writer_.reset();
+  writer_.reset();
+  TF_CHECK_OK(file_->Close());
+  file_.reset();
+  if (compressed) return;
+
+  string index;
+  index.resize(offsets_.size() * sizeof(uint64));
+  for (size_t i = 0; i < offsets_.size(); ++i) {
+    tensorflow::core::EncodeFixed64(&index[i * sizeof(uint64)], offsets_[i]);
+  }
+  TF_CHECK_OK(tensorflow::WriteStringToFile(
+      tensorflow::Env::Default(), filename_ + kIndexSuffix, index));
+}
+
+SentenceRecordReader::SentenceRecordReader(
+    const string &filename, tensorflow::thread::ThreadPool *pool) {
+  tensorflow::Env *env = tensorflow::Env::Default();
+  TF_CHECK_OK(env->NewRandomAccessFile(filename, &file_));
+  uint64 file_size;
+  TF_CHECK_OK(env->GetFileSize(filename, &file_size));
+  tensorflow::io::BlockRecordReaderOptions options;
+  options.pool = pool;
+  const tensorflow::Status status = tensorflow::io::BlockRecordReader::Open(
+      file_.get(), file_size, options, &block_reader_);
+  if (status.ok()) {
+    for (int64 b = 0; b < block_reader_->num_blocks(); ++b) {
+      block_starts_.push_back(size_);
+      size_ += block_reader_->num_block_records(b);
+    }
+    return;
+  }
+
+  // Files that are not block record files are uncompressed record files.
+  CHECK(tensorflow::errors::IsDataLoss(status)) << status;
+  if (env->NewReadOnlyMemoryRegionFromFile(filename, &region_).ok()) {
+    file_.reset();
+    reader_.reset(new tensorflow::io::RecordReader(region_.get()));
+  } else {
+    reader_.reset(new tensorflow::io::RecordReader(file_.get()));
+  }
+  if (!LoadIndex(filename)) BuildIndex();
+  size_ = offsets_.size();
+}
+
+tensorflow::Status SentenceRecordReader::Read(int64 index,
+                                              Sentence *sentence) {
+  if (index < 0 || index >= size()) {
+    return tensorflow::errors::OutOfRange("No sentence ", index, " in ",
+                                          size(), " sentences");
+  }
+  tensorflow::StringPiece record;
+  if (block_reader_ != nullptr) {
+    TF_RETURN_IF_ERROR(ReadBlockRecord(index, &record));
+  } else {
+    uint64 offset = offsets_[index];
+    TF_RETURN_IF_ERROR(reader_->ReadRecord(&offset, &record));
+  }
+  if (!sentence->ParseFromArray(record.data(), record.size())) {
+    return tensorflow::errors::DataLoss("Could not parse sentence ", index);
+  }
+  return tensorflow::Status::OK();
+}
+
+tensorflow::Status SentenceRecordReader::ReadBlockRecord(
+    int64 index, tensorflow::StringPiece *record) {
+  // Seeks to the block of the record unless it is ahead in the current one.
+  const int64 block =
+      std::upper_bound(block_starts_.begin(), block_starts_.end(), index) -
+      block_starts_.begin() - 1;
+  if (index < next_record_ || block_starts_[block] > next_record_) {
+    block_reader_->SeekToBlock(block);
+    next_record_ = block_starts_[block];
+  }
+  while (next_record_ <= index) {
+    const tensorflow::Status status = block_reader_->ReadRecord(record);
+    if (!status.ok()) {
+      // Starts over from the block of the next record read.
+      next_record_ = size_;
+      return status;
+    }
+    ++next_record_;
+  }
+  return tensorflow::Status::OK();
+}
+
+void SentenceRecordReader::GetShard(int shard, int num_shards, int64 *begin,
+                                    int64 *end) const {
+  CHECK_GE(shard, 0);
+  CHECK_LT(shard, num_shards);
+  *begin = size() * shard / num_shards;
+  *end = size() * (shard + 1) / num_shards;
+}
+
+bool SentenceRecordReader::LoadIndex(const string &filename) {
+  const string index_filename = filename + SentenceRecordWriter::kIndexSuffix;
+  tensorflow::Env *env = tensorflow::Env::Default();
+  if (!env->FileExists(index_filename)) return false;
+  string index;
+  TF_CHECK_OK(tensorflow::ReadFileToString(env, index_filename, &index));
+  CHECK_EQ(index.size() % sizeof(uint64), 0)
+      << "Index " << index_filename << " is truncated";
+  offsets_.resize(index.size() / sizeof(uint64));
+  for (size_t i = 0; i < offsets_.size(); ++i) {
+    offsets_[i] = tensorflow::core::DecodeFixed64(&index[i * sizeof(uint64)]);
+  }
+  return true;
+}
+
+void SentenceRecordReader::BuildIndex() {
+  uint64 offset = 0;
+  tensorflow::StringPiece record;
+  while (true) {
+    const uint64 record_offset = offset;
+    const tensorflow::Status status = reader_->ReadRecord(&offset, &record);
+    if (tensorflow::errors::IsOutOfRange(status)) break;
+    TF_CHECK_OK(status);
+    offsets_.push_back(record_offset);
+  }
+}
+
+// Document format for sentence record files. Records are read and written in
+// the framing of tensorflow::io::RecordWriter.
+class SentenceRecordFormat : public DocumentFormat {
+ public:
+  SentenceRecordFormat() {}
+
+  // Reads and checks the next record.
+  bool ReadRecord(tensorflow::io::InputBuffer *buffer,
+                  string *record) override {
+    tensorflow::Status status = buffer->ReadNBytes(kHeaderSize, &header_);
+    if (tensorflow::errors::IsOutOfRange(status) && header_.empty()) {
+      return false;
+    }
+    TF_CHECK_OK(status);
+    const uint64 size = tensorflow::core::DecodeFixed64(header_.data());
+    CHECK_EQ(MaskedCrc(header_.data(), sizeof(uint64)),
+             tensorflow::core::DecodeFixed32(header_.data() + sizeof(uint64)))
+        << "Corrupted record header";
+    TF_CHECK_OK(buffer->ReadNBytes(size + kFooterSize, record));
+    CHECK_EQ(MaskedCrc(record->data(), size),
+             tensorflow::core::DecodeFixed32(record->data() + size))
+        << "Corrupted record";
+    record->resize(size);
+    return true;
+  }
+
+  void ConvertFromString(const string &key, const string &value,
+                         vector<Sentence *> *sentences) override {
+    Sentence *sentence = NewDocument();
+    CHECK(sentence->ParseFromString(value))
+        << "Could not parse sentence record " << key;
+    sentences->push_back(sentence);
+  }
+
+  // Converts the sentence to a framed record.
+  void ConvertToString(const Sentence &sentence, string *key,
+                       string *value) override {
+    *key = sentence.docid();
+    const string record = sentence.SerializeAsString();
+    value->resize(kHeaderSize + record.size() + kFooterSize);
+    char *header = &(*value)[0];
+    tensorflow::core::EncodeFixed64(header, record.size());
+    tensorflow::core::EncodeFixed32(header + sizeof(uint64),
+                                    MaskedCrc(header, sizeof(uint64)));
+    value->replace(kHeaderSize, record.size(), record);
+    tensorflow::core::EncodeFixed32(
+        &(*value)[kHeaderSize + record.size()],
+        MaskedCrc(record.data(), record.size()));
+  }
+
+ private:
+  // Buffer for record headers.
+  string header_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SentenceRecordFormat);
+};
+
+REGISTER_DOCUMENT_FORMAT("sentence-record", SentenceRecordFormat);
+
+}  // namespace syntaxnet
@@ -0,0 +1,158 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Corpora of serialized sentence protos.
+//
+// A sentence record file holds one Sentence proto per record, framed like the
+// records of tensorflow::io::RecordWriter. Reading it back skips tokenizing and
+// parsing text, so multi-epoch training can convert a text corpus once and then
+// read the records. Next to the record file, an index file holds the offset of
+// every record as a little-endian fixed64, for random access and for splitting
+// a corpus into shards without scanning it.
+//
+// Record files are read as task inputs with the "sentence-record" document
+// format, which also writes the records through TextWriter, although without
+// their index.
+//
+// A record file can instead be compressed with zlib or snappy, in which case
+// it is a block record file, see tensorflow/core/lib/io/block_records.h, which
+// holds its own index of blocks and has no index file. Its blocks can be
+// decompressed in parallel, and snappy costs much less CPU than zlib for large
+// parse outputs. Compressed files are only read by SentenceRecordReader.
+
+#ifndef SYNTAXNET_SENTENCE_RECORDS_H_
+#define SYNTAXNET_SENTENCE_RECORDS_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/block_records.h"
+#include "tensorflow/core/lib/io/record_reader.h"
+#include "tensorflow/core/lib/io/record_writer.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace syntaxnet {
+
+// Writes sentences to a record file, and their index next to it on Close().
+class SentenceRecordWriter {
+ public:
+  // Suffix of the index file saved next to a record file.
+  static const char kIndexSuffix[];
+
+  // Compression of the record file.
+  enum Compression { NO_COMPRESSION, ZLIB_COMPRESSION, SNAPPY_COMPRESSION };
+
+  // Parses a compression name, "none", "zlib" or "snappy". Returns false if
+  // the name is unknown.
+  static bool ParseCompression(const string &name, Compression *compression);
+
+  explicit SentenceRecordWriter(const string &filename,
+                                Compression compression = NO_COMPRESSION);
+
+  // Closes the writer if it was not closed yet.
+  ~SentenceRecordWriter();
+
+  // Appends a sentence to the record file.
+  void Write(const Sentence &sentence);
+
+  // Closes the record file and writes its index, if it is not compressed.
+  void Close();
+
+  // Returns the number of sentences written.
+  int64 num_sentences() const { return num_sentences_; }
+
+ private:
+  // Name of the record file.
+  string filename_;
+
+  // Record file and its writer, or its block writer if it is compressed, or
+  // nullptr once closed.
+  std::unique_ptr<tensorflow::WritableFile> file_;
+  std::unique_ptr<tensorflow::io::RecordWriter> writer_;
+  std::unique_ptr<tensorflow::io::BlockRecordWriter> block_writer_;
+
+  // Offsets of the written uncompressed records, and the offset of the next
+  // one.
+  vector<uint64> offsets_;
+  uint64 offset_ = 0;
+
+  int64 num_sentences_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SentenceRecordWriter);
+};
+
+// Reads sentences from a record file at random through its index. If the
+// record file has no index, it is built by scanning the records. Compressed
+// record files are read fastest in order, as reading a sentence elsewhere
+// decompresses its block up to it.
+class SentenceRecordReader {
+ public:
+  // Blocks of compressed files are decompressed ahead in the given pool if
+  // not null, which must outlive the reader.
+  explicit SentenceRecordReader(const string &filename,
+                                tensorflow::thread::ThreadPool *pool = nullptr);
+
+  // Returns the number of sentences in the file.
+  int64 size() const { return size_; }
+
+  // Reads the sentence with the given index, in [0, size()).
+  tensorflow::Status Read(int64 index, Sentence *sentence);
+
+  // Returns the range [*begin, *end) of the sentence indices in the given
+  // shard, when the file is split into num_shards contiguous shards of nearly
+  // equal size.
+  void GetShard(int shard, int num_shards, int64 *begin, int64 *end) const;
+
+ private:
+  // Loads the index saved next to the record file. Returns false if there is
+  // no index.
+  bool LoadIndex(const string &filename);
+
+  // Builds the index by scanning the record file.
+  void BuildIndex();
+
+  // Reads the record with the given index of a compressed file.
+  tensorflow::Status ReadBlockRecord(int64 index,
+                                     tensorflow::StringPiece *record);
+
+  // Record file, or its mapping if it could be mapped, and reader, or block
+  // reader if it is compressed.
+  std::unique_ptr<tensorflow::RandomAccessFile> file_;
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region_;
+  std::unique_ptr<tensorflow::io::RecordReader> reader_;
+  std::unique_ptr<tensorflow::io::BlockRecordReader> block_reader_;
+
+  // Offsets of the records of an uncompressed file.
+  vector<uint64> offsets_;
+
+  // Indices of the first records of the blocks of a compressed file, and of
+  // the record read next by the block reader.
+  vector<int64> block_starts_;
+  int64 next_record_ = 0;
+
+  // Number of sentences in the file.
+  int64 size_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SentenceRecordReader);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_SENTENCE_RECORDS_H_
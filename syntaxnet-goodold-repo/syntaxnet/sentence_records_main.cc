@@ -0,0 +1,82 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Converts a text corpus to a sentence record file and its index, see
+// sentence_records.h. The input is read like a task input, so it can be a
+// comma-separated list of files and file patterns. With --compression=zlib or
+// snappy, the output is a compressed record file without an index file.
+//
+// Usage: sentence_records_main --input=<files> --output=<file>
+//            [--input_format=conll-sentence] [--compression=none]
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/proto_io.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/sentence_records.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+using syntaxnet::Sentence;
+using syntaxnet::SentenceRecordWriter;
+using syntaxnet::TaskContext;
+using syntaxnet::TaskInput;
+using syntaxnet::TextReader;
+
+int main(int argc, char **argv) {
+  string input;
+  string output;
+  string input_format = "conll-sentence";
+  string compression_name = "none";
+  const bool parsed_flags_ok = tensorflow::ParseFlags(
+      &argc, argv, {tensorflow::Flag("input", &input),
+                    tensorflow::Flag("output", &output),
+                    tensorflow::Flag("input_format", &input_format),
+                    tensorflow::Flag("compression", &compression_name)});
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  SentenceRecordWriter::Compression compression;
+  if (!parsed_flags_ok || input.empty() || output.empty() ||
+      !SentenceRecordWriter::ParseCompression(compression_name,
+                                              &compression)) {
+    LOG(ERROR) << "Usage: " << argv[0] << " --input=<files> --output=<file> "
+               << "[--input_format=conll-sentence] "
+               << "[--compression=none|zlib|snappy]";
+    return 1;
+  }
+
+  TaskContext context;
+  TaskInput corpus;
+  corpus.set_name("corpus");
+  corpus.add_record_format(input_format);
+  for (const string &pattern : tensorflow::str_util::Split(input, ',')) {
+    corpus.add_part()->set_file_pattern(pattern);
+  }
+  TextReader reader(corpus, &context);
+  SentenceRecordWriter writer(output, compression);
+  Sentence *sentence;
+  while ((sentence = reader.Read()) != nullptr) {
+    writer.Write(*sentence);
+    delete sentence;
+  }
+  writer.Close();
+  LOG(INFO) << "Wrote " << writer.num_sentences() << " sentences to "
+            << output;
+  return 0;
+}
@@ -0,0 +1,196 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/sentence_records.h"
+
+#include <memory>
+#include <string>
+
+#include "syntaxnet/proto_io.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/snappy.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+class SentenceRecordsTest : public ::testing::Test {
+ protected:
+  // Returns a sentence with i tokens.
+  static Sentence MakeSentence(int i) {
+    Sentence sentence;
+    sentence.set_docid(tensorflow::strings::StrCat("doc", i));
+    for (int t = 0; t < i; ++t) {
+      Token *token = sentence.add_token();
+      token->set_word(tensorflow::strings::StrCat("word", t));
+      token->set_start(0);
+      token->set_end(0);
+    }
+    return sentence;
+  }
+
+  // Writes sentences with [0, num_sentences) tokens to a record file.
+  static void WriteSentences(int num_sentences, const string &filename,
+                             SentenceRecordWriter::Compression compression =
+                                 SentenceRecordWriter::NO_COMPRESSION) {
+    SentenceRecordWriter writer(filename, compression);
+    for (int i = 0; i < num_sentences; ++i) writer.Write(MakeSentence(i));
+    writer.Close();
+    EXPECT_EQ(num_sentences, writer.num_sentences());
+  }
+
+  // Returns a path in the test temporary directory.
+  string TempPath(const string &name) const {
+    return utils::JoinPath({tensorflow::testing::TmpDir(), name});
+  }
+};
+
+TEST_F(SentenceRecordsTest, SentencesAreReadAtRandom) {
+  const string path = TempPath("random-records");
+  WriteSentences(20, path);
+  EXPECT_TRUE(tensorflow::Env::Default()->FileExists(
+      path + SentenceRecordWriter::kIndexSuffix));
+
+  SentenceRecordReader reader(path);
+  ASSERT_EQ(20, reader.size());
+  Sentence sentence;
+  for (const int i : {13, 0, 19, 7, 7}) {
+    TF_CHECK_OK(reader.Read(i, &sentence));
+    EXPECT_EQ(MakeSentence(i).SerializeAsString(),
+              sentence.SerializeAsString());
+  }
+  EXPECT_FALSE(reader.Read(20, &sentence).ok());
+
+  int64 begin, end;
+  reader.GetShard(0, 3, &begin, &end);
+  EXPECT_EQ(0, begin);
+  EXPECT_EQ(6, end);
+  reader.GetShard(2, 3, &begin, &end);
+  EXPECT_EQ(13, begin);
+  EXPECT_EQ(20, end);
+}
+
+TEST_F(SentenceRecordsTest, MissingIndexIsBuilt) {
+  const string path = TempPath("unindexed-records");
+  WriteSentences(5, path);
+  TF_CHECK_OK(tensorflow::Env::Default()->DeleteFile(
+      path + SentenceRecordWriter::kIndexSuffix));
+
+  SentenceRecordReader reader(path);
+  ASSERT_EQ(5, reader.size());
+  Sentence sentence;
+  TF_CHECK_OK(reader.Read(4, &sentence));
+  EXPECT_EQ("doc4", sentence.docid());
+  EXPECT_EQ(4, sentence.token_size());
+}
+
+TEST_F(SentenceRecordsTest, CompressedSentencesAreRead) {
+  string compressed;
+  const bool snappy_supported =
+      tensorflow::port::Snappy_Compress("aaaaaaaa", 8, &compressed);
+  SentenceRecordWriter::Compression compression;
+  ASSERT_TRUE(SentenceRecordWriter::ParseCompression("zlib", &compression));
+  EXPECT_EQ(SentenceRecordWriter::ZLIB_COMPRESSION, compression);
+  EXPECT_FALSE(SentenceRecordWriter::ParseCompression("lz4", &compression));
+
+  for (const string &name : {"zlib", "snappy"}) {
+    if (name == "snappy" && !snappy_supported) continue;
+    ASSERT_TRUE(SentenceRecordWriter::ParseCompression(name, &compression));
+    const string path = TempPath(name + "-records");
+
+    // Enough sentences for several blocks, read in order by the shards of a
+    // parallel reader and at random.
+    WriteSentences(600, path, compression);
+    EXPECT_FALSE(tensorflow::Env::Default()->FileExists(
+        path + SentenceRecordWriter::kIndexSuffix));
+    tensorflow::thread::ThreadPool pool(tensorflow::Env::Default(), "records",
+                                        2);
+    SentenceRecordReader reader(path, &pool);
+    ASSERT_EQ(600, reader.size());
+    Sentence sentence;
+    int64 begin, end;
+    reader.GetShard(1, 2, &begin, &end);
+    for (int64 i = begin; i < end; ++i) {
+      TF_CHECK_OK(reader.Read(i, &sentence));
+      ASSERT_EQ(MakeSentence(i).SerializeAsString(),
+                sentence.SerializeAsString());
+    }
+    for (const int i : {599, 13, 0, 400, 7, 7}) {
+      TF_CHECK_OK(reader.Read(i, &sentence));
+      EXPECT_EQ(MakeSentence(i).SerializeAsString(),
+                sentence.SerializeAsString());
+    }
+    EXPECT_FALSE(reader.Read(600, &sentence).ok());
+  }
+}
+
+TEST_F(SentenceRecordsTest, RecordsAreReadAndWrittenAsTaskInputs) {
+  TaskContext context;
+  TaskInput input;
+  input.set_name("records");
+  input.add_record_format("sentence-record");
+  input.add_part()->set_file_pattern(TempPath("input-records"));
+  {
+    TextWriter writer(input, &context);
+    for (int i = 0; i < 5; ++i) writer.Write(MakeSentence(i));
+  }
+
+  // Records written by the document format read back through the index
+  // built for them, and through the document format.
+  SentenceRecordReader records(TempPath("input-records"));
+  EXPECT_EQ(5, records.size());
+  TextReader reader(input, &context);
+  for (int i = 0; i < 5; ++i) {
+    std::unique_ptr<Sentence> sentence(reader.Read());
+    ASSERT_TRUE(sentence != nullptr);
+    EXPECT_EQ(MakeSentence(i).SerializeAsString(),
+              sentence->SerializeAsString());
+  }
+  EXPECT_TRUE(reader.Read() == nullptr);
+}
+
+TEST_F(SentenceRecordsTest, RecordsAreReadOntoArenas) {
+  TaskContext context;
+  TaskInput input;
+  input.set_name("records");
+  input.add_record_format("sentence-record");
+  input.add_part()->set_file_pattern(TempPath("arena-records"));
+  {
+    TextWriter writer(input, &context);
+    for (int i = 0; i < 3; ++i) writer.Write(MakeSentence(i));
+  }
+
+  // The sentences are owned by the arena, and freed with it.
+  tensorflow::protobuf::Arena arena;
+  TextReader reader(input, &context);
+  EXPECT_FALSE(reader.parses_ahead());
+  for (int i = 0; i < 3; ++i) {
+    Sentence *sentence = reader.Read(&arena);
+    ASSERT_TRUE(sentence != nullptr);
+    EXPECT_EQ(&arena, sentence->GetArena());
+    EXPECT_EQ(MakeSentence(i).SerializeAsString(),
+              sentence->SerializeAsString());
+  }
+  EXPECT_TRUE(reader.Read(&arena) == nullptr);
+}
+
+}  // namespace syntaxnet
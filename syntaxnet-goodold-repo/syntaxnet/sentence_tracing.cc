@@ -0,0 +1,51 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/sentence_tracing.h"
+
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace syntaxnet {
+
+void AddTraceId(const Sentence &sentence, string *trace_ids) {
+  if (!sentence.has_trace_id()) return;
+  if (!trace_ids->empty()) trace_ids->push_back(',');
+  trace_ids->append(sentence.trace_id());
+}
+
+string SentenceSpanName(tensorflow::StringPiece stage,
+                        const string &trace_ids) {
+  return tensorflow::strings::StrCat("syntaxnet:", stage, "#trace_id=",
+                                     trace_ids);
+}
+
+SentenceSpan::SentenceSpan(tensorflow::StringPiece stage,
+                           const Sentence &sentence) {
+  if (sentence.has_trace_id()) Start(stage, sentence.trace_id());
+}
+
+SentenceSpan::SentenceSpan(tensorflow::StringPiece stage,
+                           const string &trace_ids) {
+  if (!trace_ids.empty()) Start(stage, trace_ids);
+}
+
+void SentenceSpan::Start(tensorflow::StringPiece stage,
+                         const string &trace_ids) {
+  traced_ = true;
+  trace_.reset(new tensorflow::port::Tracing::TraceMe(
+      SentenceSpanName(stage, trace_ids)));
+}
+
+}  // namespace syntaxnet
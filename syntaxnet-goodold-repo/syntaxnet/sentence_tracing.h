@@ -0,0 +1,71 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Trace spans of the sentences of a request. A client sets the trace_id of
+// the sentences it sends, and the ops record the time each traced sentence
+// spends waiting in a document queue, being preprocessed for the features,
+// in each decoding step, in filters and being output, as activities of the
+// tracing engine registered with tensorflow::port::Tracing. A span covering
+// several traced sentences, e.g. a decoding step of a batch, names all their
+// trace ids. There is nothing to record for batches without traced
+// sentences, which only cost the check of their trace ids.
+
+#ifndef SYNTAXNET_SENTENCE_TRACING_H_
+#define SYNTAXNET_SENTENCE_TRACING_H_
+
+#include <memory>
+#include <string>
+
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/tracing.h"
+
+namespace syntaxnet {
+
+// Appends the trace id of the sentence, if it has one, to the comma-separated
+// list of trace ids in *trace_ids.
+void AddTraceId(const Sentence &sentence, string *trace_ids);
+
+// Returns the name of the span of a stage for the given trace ids.
+string SentenceSpanName(tensorflow::StringPiece stage, const string &trace_ids);
+
+// Records the time from construction to destruction as a span of a stage of
+// traced sentences.
+class SentenceSpan {
+ public:
+  // Starts a span for the sentence, if it has a trace id.
+  SentenceSpan(tensorflow::StringPiece stage, const Sentence &sentence);
+
+  // Starts a span for the given comma-separated trace ids, if there are any.
+  SentenceSpan(tensorflow::StringPiece stage, const string &trace_ids);
+
+  // Returns true if the span is traced.
+  bool traced() const { return traced_; }
+
+ private:
+  void Start(tensorflow::StringPiece stage, const string &trace_ids);
+
+  bool traced_ = false;
+
+  // Activity of the tracing engine, if one is enabled.
+  std::unique_ptr<tensorflow::port::Tracing::TraceMe> trace_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SentenceSpan);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_SENTENCE_TRACING_H_
@@ -0,0 +1,123 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/sentence_tracing.h"
+
+#include <memory>
+#include <vector>
+
+#include "syntaxnet/document_queue.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+namespace syntaxnet {
+namespace {
+
+using tensorflow::port::Tracing;
+
+// Records the labels of the spans that started and stopped.
+class RecordingEngine : public Tracing::Engine {
+ public:
+  bool IsEnabled() const override { return true; }
+
+  std::vector<string> started;
+  std::vector<string> stopped;
+
+ private:
+  class RecordingTracer : public Tracer {
+   public:
+    RecordingTracer(RecordingEngine *engine, StringPiece label)
+        : engine_(engine), label_(label.ToString()) {
+      engine_->started.push_back(label_);
+    }
+    ~RecordingTracer() override { engine_->stopped.push_back(label_); }
+
+   private:
+    RecordingEngine *engine_;
+    const string label_;
+  };
+
+  Annotation *PushAnnotation(StringPiece name) override { return nullptr; }
+
+  Tracer *StartTracing(StringPiece label) override {
+    return new RecordingTracer(this, label);
+  }
+};
+
+class SentenceTracingTest : public ::testing::Test {
+ protected:
+  void SetUp() override { Tracing::RegisterEngine(&engine_); }
+  void TearDown() override { Tracing::RegisterEngine(nullptr); }
+
+  RecordingEngine engine_;
+};
+
+TEST_F(SentenceTracingTest, TracesSentencesWithTraceIds) {
+  Sentence traced;
+  traced.set_trace_id("request-1");
+  {
+    SentenceSpan span("preprocess", traced);
+    EXPECT_TRUE(span.traced());
+    EXPECT_THAT(engine_.started,
+                ::testing::ElementsAre(
+                    "syntaxnet:preprocess#trace_id=request-1"));
+    EXPECT_TRUE(engine_.stopped.empty());
+  }
+  EXPECT_THAT(engine_.stopped, ::testing::ElementsAre(
+                                   "syntaxnet:preprocess#trace_id=request-1"));
+
+  Sentence untraced;
+  SentenceSpan span("preprocess", untraced);
+  EXPECT_FALSE(span.traced());
+  EXPECT_EQ(1, engine_.started.size());
+}
+
+TEST_F(SentenceTracingTest, NamesAllTraceIdsOfABatch) {
+  std::vector<Sentence> batch(3);
+  batch[0].set_trace_id("a");
+  batch[2].set_trace_id("b");
+  string trace_ids;
+  for (const Sentence &sentence : batch) AddTraceId(sentence, &trace_ids);
+  EXPECT_EQ("a,b", trace_ids);
+  { SentenceSpan span("decode_step", trace_ids); }
+  EXPECT_THAT(engine_.started,
+              ::testing::ElementsAre("syntaxnet:decode_step#trace_id=a,b"));
+
+  string untraced_ids;
+  AddTraceId(Sentence(), &untraced_ids);
+  SentenceSpan span("decode_step", untraced_ids);
+  EXPECT_FALSE(span.traced());
+}
+
+TEST_F(SentenceTracingTest, TracesQueueWaits) {
+  DocumentQueue *queue = DocumentQueue::Get("traced-queue");
+  Sentence *document = new Sentence();
+  document->set_trace_id("request-2");
+  queue->Push(document);
+  queue->Push(new Sentence());
+  EXPECT_THAT(engine_.started, ::testing::ElementsAre(
+                                   "syntaxnet:queue_wait#trace_id=request-2"));
+  EXPECT_TRUE(engine_.stopped.empty());
+  std::unique_ptr<Sentence> popped(queue->Pop());
+  EXPECT_EQ("request-2", popped->trace_id());
+  EXPECT_THAT(engine_.stopped, ::testing::ElementsAre(
+                                   "syntaxnet:queue_wait#trace_id=request-2"));
+  popped.reset(queue->Pop());
+  EXPECT_EQ(1, engine_.stopped.size());
+}
+
+}  // namespace
+}  // namespace syntaxnet
@@ -0,0 +1,122 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/session_benchmark.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "syntaxnet/document_format.h"
+#include "syntaxnet/proto_io.h"
+#include "syntaxnet/task_context.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace syntaxnet {
+
+void ReadSentenceSample(const string &corpus, const string &input_format,
+                        int max_sentences, std::vector<Sentence> *sentences) {
+  TaskContext context;
+  std::unique_ptr<DocumentFormat> format(DocumentFormat::Create(input_format));
+  format->Setup(&context);
+  TextFileReader reader(corpus, format.get());
+  while (max_sentences <= 0 ||
+         static_cast<int>(sentences->size()) < max_sentences) {
+    std::unique_ptr<Sentence> sentence(reader.Read());
+    if (sentence == nullptr) break;
+    sentences->push_back(*sentence);
+  }
+}
+
+double Percentile(const std::vector<int64> &sorted, double percentile) {
+  if (sorted.empty()) return 0;
+  const size_t index = std::min<size_t>(
+      sorted.size() - 1, static_cast<size_t>(percentile / 100 * sorted.size()));
+  return sorted[index];
+}
+
+tensorflow::Status ParseSentenceBatch(ParsingSession *session,
+                                      const std::vector<Sentence> &sentences,
+                                      size_t start, int batch_size,
+                                      tensorflow::StatSummarizer *stats,
+                                      int *num_parsed) {
+  const size_t end = std::min(sentences.size(), start + batch_size);
+  const std::vector<Sentence> batch(sentences.begin() + start,
+                                    sentences.begin() + end);
+  std::vector<Sentence> parses;
+  *num_parsed = batch.size();
+  return session->Parse(batch, &parses, stats);
+}
+
+tensorflow::Status RunSessionBenchmark(ParsingSession *session,
+                                       const std::vector<Sentence> &sentences,
+                                       const SessionBenchmarkOptions &options,
+                                       SessionBenchmarkResult *result) {
+  tensorflow::Env *env = tensorflow::Env::Default();
+  int num_parsed = 0;
+  size_t start = 0;
+  for (int i = 0; i < options.warmup_batches; ++i) {
+    TF_RETURN_IF_ERROR(ParseSentenceBatch(session, sentences, start,
+                                          options.batch_size, nullptr,
+                                          &num_parsed));
+    start = (start + num_parsed) % sentences.size();
+  }
+
+  std::vector<int64> latencies;
+  *result = SessionBenchmarkResult();
+  const int64 start_micros = env->NowMicros();
+  for (int pass = 0; pass < options.num_passes; ++pass) {
+    for (start = 0; start < sentences.size(); start += num_parsed) {
+      const int64 batch_start_micros = env->NowMicros();
+      TF_RETURN_IF_ERROR(ParseSentenceBatch(session, sentences, start,
+                                            options.batch_size, nullptr,
+                                            &num_parsed));
+      const int64 batch_micros = env->NowMicros() - batch_start_micros;
+      for (int i = 0; i < num_parsed; ++i) {
+        latencies.push_back(batch_micros);
+        result->num_tokens += sentences[start + i].token_size();
+      }
+    }
+  }
+  result->wall_time = (env->NowMicros() - start_micros) / 1e6;
+  std::sort(latencies.begin(), latencies.end());
+  result->num_sentences = latencies.size();
+  result->p50_latency_micros = Percentile(latencies, 50);
+  result->p99_latency_micros = Percentile(latencies, 99);
+  return tensorflow::Status::OK();
+}
+
+std::vector<int> ParetoFrontier(
+    const std::vector<SessionBenchmarkResult> &results) {
+  // Sorted by decreasing throughput, and then by increasing latency, a result
+  // is on the frontier iff its latency is below that of all results before it.
+  std::vector<int> order(results.size());
+  for (size_t i = 0; i < results.size(); ++i) order[i] = i;
+  std::stable_sort(order.begin(), order.end(), [&results](int a, int b) {
+    const double a_throughput = results[a].sentences_per_second();
+    const double b_throughput = results[b].sentences_per_second();
+    if (a_throughput != b_throughput) return a_throughput > b_throughput;
+    return results[a].p99_latency_micros < results[b].p99_latency_micros;
+  });
+  std::vector<int> frontier;
+  for (int index : order) {
+    if (frontier.empty() || results[index].p99_latency_micros <
+                                results[frontier.back()].p99_latency_micros) {
+      frontier.push_back(index);
+    }
+  }
+  return frontier;
+}
+
+}  // namespace syntaxnet
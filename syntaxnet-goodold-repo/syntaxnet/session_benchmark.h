@@ -0,0 +1,89 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Throughput and latency benchmarks of ParsingSessions on a sample of
+// sentences, shared by benchmark_parser_main and tune_parser_main.
+
+#ifndef SYNTAXNET_SESSION_BENCHMARK_H_
+#define SYNTAXNET_SESSION_BENCHMARK_H_
+
+#include <string>
+#include <vector>
+
+#include "syntaxnet/parsing_session.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/status.h"
+
+namespace syntaxnet {
+
+// Settings of a benchmark run.
+struct SessionBenchmarkOptions {
+  int batch_size = 1;
+  int warmup_batches = 5;
+  int num_passes = 1;
+};
+
+// Measurements of a benchmark run. The latency of a sentence is that of the
+// batch it was parsed in.
+struct SessionBenchmarkResult {
+  int64 num_sentences = 0;
+  int64 num_tokens = 0;
+  double wall_time = 0;
+  double p50_latency_micros = 0;
+  double p99_latency_micros = 0;
+
+  double sentences_per_second() const {
+    return wall_time > 0 ? num_sentences / wall_time : 0;
+  }
+  double tokens_per_second() const {
+    return wall_time > 0 ? num_tokens / wall_time : 0;
+  }
+};
+
+// Reads up to max_sentences sentences of the corpus in the given format, or all
+// of them if max_sentences is not positive, into *sentences.
+void ReadSentenceSample(const string &corpus, const string &input_format,
+                        int max_sentences, std::vector<Sentence> *sentences);
+
+// Returns the given percentile of sorted values, or 0 if there are none.
+double Percentile(const std::vector<int64> &sorted, double percentile);
+
+// Parses the batch of the sentences that starts at the given index, setting
+// *num_parsed to its number of sentences. Traces the steps into stats if it
+// is not null, see ParsingSession::Parse().
+tensorflow::Status ParseSentenceBatch(ParsingSession *session,
+                                      const std::vector<Sentence> &sentences,
+                                      size_t start, int batch_size,
+                                      tensorflow::StatSummarizer *stats,
+                                      int *num_parsed);
+
+// Parses a few warmup batches of the sentences, then all of them num_passes
+// times in batches, and sets *result to the measurements of the latter.
+tensorflow::Status RunSessionBenchmark(ParsingSession *session,
+                                       const std::vector<Sentence> &sentences,
+                                       const SessionBenchmarkOptions &options,
+                                       SessionBenchmarkResult *result);
+
+// Returns the indices of the results on the Pareto frontier of throughput
+// against p99 latency, i.e. those no other result beats in one without
+// losing in the other, by decreasing throughput. Of results that measure
+// the same, only the first is kept.
+std::vector<int> ParetoFrontier(
+    const std::vector<SessionBenchmarkResult> &results);
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_SESSION_BENCHMARK_H_
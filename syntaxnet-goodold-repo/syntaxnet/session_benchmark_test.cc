@@ -0,0 +1,62 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/session_benchmark.h"
+
+#include <vector>
+
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+namespace syntaxnet {
+namespace {
+
+SessionBenchmarkResult Result(int64 num_sentences, double p99_latency_micros) {
+  SessionBenchmarkResult result;
+  result.num_sentences = num_sentences;
+  result.wall_time = 1.0;
+  result.p99_latency_micros = p99_latency_micros;
+  return result;
+}
+
+TEST(SessionBenchmarkTest, Percentile) {
+  const std::vector<int64> sorted = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+  EXPECT_EQ(6, Percentile(sorted, 50));
+  EXPECT_EQ(10, Percentile(sorted, 99));
+  EXPECT_EQ(10, Percentile(sorted, 100));
+  EXPECT_EQ(0, Percentile({}, 99));
+}
+
+TEST(SessionBenchmarkTest, ParetoFrontierDropsDominatedResults) {
+  const std::vector<SessionBenchmarkResult> results = {
+      Result(100, 1000),  // on the frontier
+      Result(400, 8000),  // on the frontier
+      Result(200, 9000),  // slower and later than 1
+      Result(300, 2000),  // on the frontier
+      Result(300, 3000),  // as fast as 3 but later
+      Result(50, 1000),   // as early as 0 but slower
+  };
+  EXPECT_THAT(ParetoFrontier(results), ::testing::ElementsAre(1, 3, 0));
+}
+
+TEST(SessionBenchmarkTest, ParetoFrontierKeepsFirstOfEqualResults) {
+  const std::vector<SessionBenchmarkResult> results = {
+      Result(100, 1000), Result(100, 1000)};
+  EXPECT_THAT(ParetoFrontier(results), ::testing::ElementsAre(0));
+  EXPECT_TRUE(ParetoFrontier({}).empty());
+}
+
+}  // namespace
+}  // namespace syntaxnet
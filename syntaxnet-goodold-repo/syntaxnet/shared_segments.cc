@@ -0,0 +1,69 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/shared_segments.h"
+
+#include <stdlib.h>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/file_statistics.h"
+
+namespace syntaxnet {
+
+const char SharedSegments::kDirectoryVariable[] = "SYNTAXNET_SHARED_SEGMENTS";
+
+bool SharedSegments::Enabled() {
+  const char *directory = getenv(kDirectoryVariable);
+  return directory != nullptr && *directory != '\0';
+}
+
+std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> SharedSegments::Map(
+    const string &name, const Writer &writer) {
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region;
+  if (!Enabled()) return region;
+  const string path = utils::JoinPath(
+      {getenv(kDirectoryVariable),
+       tensorflow::strings::StrCat(
+           "syntaxnet-",
+           tensorflow::strings::Hex(tensorflow::Hash64(name),
+                                    tensorflow::strings::ZERO_PAD_16))});
+
+  // Writes the segment under a temporary name and renames it into place, so
+  // that other processes never map a partial segment. Processes racing to
+  // create the same segment write identical contents, so either copy wins.
+  tensorflow::Env *env = tensorflow::Env::Default();
+  if (!env->FileExists(path)) {
+    const string temp_path = tensorflow::strings::StrCat(
+        path, ".", tensorflow::strings::Hex(tensorflow::random::New64()));
+    writer(temp_path);
+    TF_CHECK_OK(env->RenameFile(temp_path, path));
+    LOG(INFO) << "Created shared segment " << name << " at " << path;
+  }
+  TF_CHECK_OK(env->NewReadOnlyMemoryRegionFromFile(path, &region));
+  VLOG(1) << "Mapped shared segment " << name << " from " << path;
+  return region;
+}
+
+string SharedSegments::NameForFile(const string &kind, const string &path) {
+  tensorflow::FileStatistics stat;
+  TF_CHECK_OK(tensorflow::Env::Default()->Stat(path, &stat));
+  return tensorflow::strings::StrCat(kind, ":", path, ":", stat.length, ":",
+                                     stat.mtime_nsec);
+}
+
+}  // namespace syntaxnet
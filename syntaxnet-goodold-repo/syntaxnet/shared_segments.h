@@ -0,0 +1,66 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Read-only memory segments shared by the processes on a host.
+
+#ifndef SYNTAXNET_SHARED_SEGMENTS_H_
+#define SYNTAXNET_SHARED_SEGMENTS_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/platform/env.h"
+
+namespace syntaxnet {
+
+// Resources with a flat, pointer-free representation can be written once into
+// a named segment, which all processes on the host then map read-only instead
+// of building a copy each. This complements SharedStore, which shares objects
+// within a process only.
+//
+// Segments are files in the directory named by the SYNTAXNET_SHARED_SEGMENTS
+// environment variable, typically on a tmpfs like /dev/shm, so that the
+// processes mapping a segment share its pages. Sharing is disabled if the
+// variable is not set. Segments are never deleted by the processes using them.
+class SharedSegments {
+ public:
+  // Environment variable naming the segment directory.
+  static const char kDirectoryVariable[];
+
+  // Writes the contents of a segment to the file at the given path.
+  typedef std::function<void(const string &path)> Writer;
+
+  // Returns true if sharing segments is enabled.
+  static bool Enabled();
+
+  // Maps the segment with the given name, writing it first with the writer if
+  // no process has done so yet. Names should identify the contents, see
+  // NameForFile(). Returns null if sharing is disabled.
+  static std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> Map(
+      const string &name, const Writer &writer);
+
+  // Returns a segment name for a resource of the given kind built from the
+  // given file, identifying the file by path, size and modification time.
+  static string NameForFile(const string &kind, const string &path);
+
+ private:
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedSegments);
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_SHARED_SEGMENTS_H_
@@ -0,0 +1,92 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/shared_segments.h"
+
+#include <stdlib.h>
+#include <memory>
+#include <string>
+
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+class SharedSegmentsTest : public ::testing::Test {
+ protected:
+  void TearDown() override { unsetenv(SharedSegments::kDirectoryVariable); }
+
+  // Enables segments in a fresh directory under the test temporary directory.
+  void EnableSegments(const string &name) {
+    const string directory =
+        utils::JoinPath({tensorflow::testing::TmpDir(), name});
+    TF_CHECK_OK(tensorflow::Env::Default()->CreateDir(directory));
+    setenv(SharedSegments::kDirectoryVariable, directory.c_str(), 1);
+  }
+
+  // Returns a writer writing the given contents and counting its calls.
+  SharedSegments::Writer CountingWriter(const string &contents,
+                                        int *num_calls) {
+    return [contents, num_calls](const string &path) {
+      ++*num_calls;
+      TF_CHECK_OK(tensorflow::WriteStringToFile(tensorflow::Env::Default(),
+                                                path, contents));
+    };
+  }
+};
+
+TEST_F(SharedSegmentsTest, DisabledWithoutDirectory) {
+  unsetenv(SharedSegments::kDirectoryVariable);
+  EXPECT_FALSE(SharedSegments::Enabled());
+  int num_calls = 0;
+  EXPECT_TRUE(SharedSegments::Map("segment", CountingWriter("a", &num_calls)) ==
+              nullptr);
+  EXPECT_EQ(0, num_calls);
+}
+
+TEST_F(SharedSegmentsTest, WritesEachSegmentOnce) {
+  EnableSegments("write-once");
+  EXPECT_TRUE(SharedSegments::Enabled());
+  int num_calls = 0;
+  auto first = SharedSegments::Map("first", CountingWriter("1", &num_calls));
+  auto again = SharedSegments::Map("first", CountingWriter("x", &num_calls));
+  auto second = SharedSegments::Map("second", CountingWriter("22", &num_calls));
+  EXPECT_EQ(2, num_calls);
+  ASSERT_TRUE(first != nullptr && again != nullptr && second != nullptr);
+  EXPECT_EQ("1", string(static_cast<const char *>(first->data()),
+                        first->length()));
+  EXPECT_EQ("1", string(static_cast<const char *>(again->data()),
+                        again->length()));
+  EXPECT_EQ("22", string(static_cast<const char *>(second->data()),
+                         second->length()));
+}
+
+TEST_F(SharedSegmentsTest, NamesForFilesDependOnContents) {
+  const string path =
+      utils::JoinPath({tensorflow::testing::TmpDir(), "segment-source"});
+  tensorflow::Env *env = tensorflow::Env::Default();
+  TF_CHECK_OK(tensorflow::WriteStringToFile(env, path, "short"));
+  const string name = SharedSegments::NameForFile("kind", path);
+  EXPECT_EQ(name, SharedSegments::NameForFile("kind", path));
+  EXPECT_NE(name, SharedSegments::NameForFile("other-kind", path));
+  TF_CHECK_OK(tensorflow::WriteStringToFile(env, path, "longer"));
+  EXPECT_NE(name, SharedSegments::NameForFile("kind", path));
+}
+
+}  // namespace syntaxnet
@@ -16,6 +16,7 @@ limitations under the License.
 #include "syntaxnet/shared_store.h"
 
 #include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/lib/strings/stringprintf.h"
 
@@ -61,6 +62,18 @@ void SharedStore::Clear() {
   shared_object_map()->clear();
 }
 
+std::vector<SharedStore::ObjectInfo> SharedStore::Objects() {
+  mutex_lock l(shared_object_map_mutex_);
+  std::vector<ObjectInfo> objects;
+  objects.reserve(shared_object_map()->size());
+  for (const auto &entry : *shared_object_map()) {
+    const SharedObject &object = entry.second;
+    objects.push_back(
+        {object.type, object.name, object.refcount, object.bytes});
+  }
+  return objects;
+}
+
 string SharedStoreUtils::CreateDefaultName() { return string(); }
 
 string SharedStoreUtils::ToString(const string &input) {
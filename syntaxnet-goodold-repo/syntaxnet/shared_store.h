@@ -23,6 +23,7 @@ limitations under the License.
 #include <typeindex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "syntaxnet/utils.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
@@ -63,15 +64,42 @@ class SharedStore {
   // Delete all objects in the shared store.
   static void Clear();
 
+  // An object in the shared store, for memory reports.
+  struct ObjectInfo {
+    // Mangled name of the type of the object, and its name in the store.
+    string type;
+    string name;
+
+    // Number of references to the object.
+    int refcount;
+
+    // Growth of the heap while the object was created, an estimate of its
+    // size if no other thread allocated meanwhile. 0 if the heap size is
+    // unknown, see utils::HeapBytesInUse().
+    int64 bytes;
+  };
+
+  // Returns the objects in the shared store, in no particular order.
+  static std::vector<ObjectInfo> Objects();
+
  private:
   // A shared object.
   struct SharedObject {
     void *object;
     std::function<void()> delete_callback;
     int refcount;
-
-    SharedObject(void *o, std::function<void()> d)
-        : object(o), delete_callback(d), refcount(1) {}
+    const char *type;
+    string name;
+    int64 bytes;
+
+    SharedObject(void *o, std::function<void()> d, const char *t,
+                 const string &n, int64 b)
+        : object(o),
+          delete_callback(d),
+          refcount(1),
+          type(t),
+          name(n),
+          bytes(b) {}
   };
 
   // A map from keys to shared objects.
@@ -88,9 +116,11 @@ class SharedStore {
   template <typename T>
   static void DeleteObject(T *object);
 
-  // Add an object to the shared object map. Return the object.
+  // Add an object with the given name, whose creation grew the heap by the
+  // given bytes, to the shared object map. Return the object.
   template <typename T>
-  static T *StoreObject(const string &key, T *object);
+  static T *StoreObject(const string &key, const string &name, T *object,
+                        int64 bytes);
 
   // Increment the reference count of an object in the map. Return the object.
   template <typename T>
@@ -115,10 +145,11 @@ void SharedStore::DeleteObject(T *object) {
 }
 
 template <typename T>
-T *SharedStore::StoreObject(const string &key, T *object) {
+T *SharedStore::StoreObject(const string &key, const string &name, T *object,
+                            int64 bytes) {
   std::function<void()> delete_cb =
       std::bind(SharedStore::DeleteObject<T>, object);
-  SharedObject so(object, delete_cb);
+  SharedObject so(object, delete_cb, typeid(T).name(), name, bytes);
   shared_object_map()->insert(std::make_pair(key, so));
   return object;
 }
@@ -135,9 +166,13 @@ const T *SharedStore::Get(const string &name,
   mutex_lock l(shared_object_map_mutex_);
   const string key = GetSharedKey<T>(name);
   SharedObjectMap::iterator it = shared_object_map()->find(key);
-  return (it == shared_object_map()->end()) ?
-      StoreObject<T>(key, new T(std::forward<Args>(args)...)) :
-      IncrementRefCountOfObject<T>(it);
+  if (it != shared_object_map()->end()) {
+    return IncrementRefCountOfObject<T>(it);
+  }
+  const int64 heap_bytes = utils::HeapBytesInUse();
+  T *object = new T(std::forward<Args>(args)...);
+  return StoreObject<T>(key, name, object,
+                        utils::HeapBytesInUse() - heap_bytes);
 }
 
 template <typename T>
@@ -148,7 +183,9 @@ const T *SharedStore::ClosureGet(const string &name,
   SharedObjectMap::iterator it = shared_object_map()->find(key);
   if (it == shared_object_map()->end()) {
     // Creates a new object by calling the closure.
+    const int64 heap_bytes = utils::HeapBytesInUse();
     T *object = (*closure)();
+    const int64 bytes = utils::HeapBytesInUse() - heap_bytes;
     if (object == nullptr) {
       LOG(ERROR) << "Closure returned a null pointer";
     } else {
@@ -165,7 +202,7 @@ const T *SharedStore::ClosureGet(const string &name,
         }
       }
     }
-    return StoreObject<T>(key, object);
+    return StoreObject<T>(key, name, object, bytes);
   } else {
     return IncrementRefCountOfObject<T>(it);
   }
@@ -16,6 +16,8 @@ limitations under the License.
 #include "syntaxnet/shared_store.h"
 
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "syntaxnet/utils.h"
 #include <gmock/gmock.h>
@@ -211,6 +213,27 @@ TEST_F(SharedStoreTest, Clear) {
   EXPECT_EQ(2, CountCalls::destructor_calls);
 }
 
+// Verify that the objects are listed with their references and sizes.
+TEST_F(SharedStoreTest, Objects) {
+  SharedStore::Get<Slow>("first");
+  SharedStore::Get<Slow>("first");
+  SharedStore::Get<NoArgs>("second");
+  std::vector<SharedStore::ObjectInfo> objects = SharedStore::Objects();
+  ASSERT_EQ(2, objects.size());
+  if (objects[0].name != "first") std::swap(objects[0], objects[1]);
+  EXPECT_EQ("first", objects[0].name);
+  EXPECT_EQ(typeid(Slow).name(), objects[0].type);
+  EXPECT_EQ(2, objects[0].refcount);
+  EXPECT_EQ("second", objects[1].name);
+  EXPECT_EQ(1, objects[1].refcount);
+
+  // The 50MB string of Slow grows the heap, where its size is known.
+  if (utils::HeapBytesInUse() > 0) {
+    EXPECT_GE(objects[0].bytes, 50 << 20);
+    EXPECT_LT(objects[1].bytes, 1 << 20);
+  }
+}
+
 void GetSharedObject(PointerSet *ps) {
   // Gets a shared object whose constructor takes a long time.
   const Slow *ob = SharedStore::Get<Slow>("first");
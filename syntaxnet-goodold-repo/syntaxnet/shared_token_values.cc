@@ -0,0 +1,154 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/shared_token_values.h"
+
+#include <string.h>
+
+#include <iterator>
+
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace syntaxnet {
+namespace {
+
+// Guards the map of shared stores.
+mutex shared_token_values_mutex(tensorflow::LINKER_INITIALIZED);
+
+// Shared stores by size.
+std::unordered_map<int, SharedTokenValues *> *SharedStores() {
+  static auto *stores = new std::unordered_map<int, SharedTokenValues *>();
+  return stores;
+}
+
+}  // namespace
+
+SharedTokenValues::SharedTokenValues(int max_entries)
+    : max_entries_(max_entries) {
+  CHECK_GT(max_entries_, 0);
+}
+
+SharedTokenValues *SharedTokenValues::Get(int max_entries) {
+  mutex_lock lock(shared_token_values_mutex);
+  SharedTokenValues *&shared = (*SharedStores())[max_entries];
+  if (shared == nullptr) shared = new SharedTokenValues(max_entries);
+  ++shared->refcount_;
+  return shared;
+}
+
+void SharedTokenValues::Release(SharedTokenValues *values) {
+  if (values == nullptr) return;
+  mutex_lock lock(shared_token_values_mutex);
+  auto it = SharedStores()->find(values->max_entries_);
+  CHECK(it != SharedStores()->end() && it->second == values);
+  if (--values->refcount_ == 0) {
+    delete values;
+    SharedStores()->erase(it);
+  }
+}
+
+uint64 SharedTokenValues::FeatureKey(const string &feature) {
+  return tensorflow::Fingerprint64(feature);
+}
+
+uint64 SharedTokenValues::WordsKey(const Sentence &sentence) {
+  string data;
+  for (const Token &token : sentence.token()) {
+    // Words are length-prefixed, so that different word lists never have the
+    // same encoding.
+    const uint32 size = token.word().size();
+    data.append(reinterpret_cast<const char *>(&size), sizeof(size));
+    data.append(token.word());
+  }
+  return tensorflow::Fingerprint64(data);
+}
+
+uint64 SharedTokenValues::Key(uint64 feature_key, uint64 words_key) {
+  char data[2 * sizeof(uint64)];
+  memcpy(data, &feature_key, sizeof(feature_key));
+  memcpy(data + sizeof(feature_key), &words_key, sizeof(words_key));
+  return tensorflow::Fingerprint64(string(data, sizeof(data)));
+}
+
+bool SharedTokenValues::Lookup(uint64 key, VectorIntWorkspace *workspace) {
+  mutex_lock lock(mu_);
+  auto it = index_.find(key);
+  if (it == index_.end() ||
+      static_cast<int>(it->second->values.size()) != workspace->size()) {
+    ++num_misses_;
+    return false;
+  }
+  ++num_hits_;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  const std::vector<int> &values = it->second->values;
+  for (int i = 0; i < workspace->size(); ++i) {
+    workspace->set_element(i, values[i]);
+  }
+  return true;
+}
+
+void SharedTokenValues::Insert(uint64 key,
+                               const VectorIntWorkspace &workspace) {
+  mutex_lock lock(mu_);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    entries_.splice(entries_.begin(), entries_, it->second);
+  } else {
+    if (static_cast<int>(index_.size()) == max_entries_) {
+      // Reuses the storage of the evicted values.
+      entries_.splice(entries_.begin(), entries_, std::prev(entries_.end()));
+      index_.erase(entries_.front().key);
+    } else {
+      entries_.emplace_front();
+    }
+    entries_.front().key = key;
+    index_[key] = entries_.begin();
+  }
+  std::vector<int> &values = entries_.front().values;
+  values.resize(workspace.size());
+  for (int i = 0; i < workspace.size(); ++i) values[i] = workspace.element(i);
+}
+
+int SharedTokenValues::size() const {
+  mutex_lock lock(mu_);
+  return index_.size();
+}
+
+int64 SharedTokenValues::num_hits() const {
+  mutex_lock lock(mu_);
+  return num_hits_;
+}
+
+int64 SharedTokenValues::num_misses() const {
+  mutex_lock lock(mu_);
+  return num_misses_;
+}
+
+const char WordsKeyWorkspace::kWorkspaceName[] = "words-key";
+
+uint64 WordsKeyWorkspace::GetOrCreate(int index, const Sentence &sentence,
+                                      WorkspaceSet *workspaces) {
+  if (!workspaces->Has<WordsKeyWorkspace>(index)) {
+    WordsKeyWorkspace *workspace =
+        workspaces->Reclaim<WordsKeyWorkspace>(index);
+    if (workspace == nullptr) workspace = new WordsKeyWorkspace();
+    workspace->key_ = SharedTokenValues::WordsKey(sentence);
+    workspaces->Set<WordsKeyWorkspace>(index, workspace);
+  }
+  return workspaces->Get<WordsKeyWorkspace>(index).key_;
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,132 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Per-token feature values shared by the readers of a process.
+//
+// When a tagger and a parser run in one process, e.g. chained by a document
+// queue, they both preprocess the same sentences, and features like the word,
+// the lowercased word and the affixes compute the same token values when they
+// look them up in the same lexicon. Such features can store the values they
+// compute for a sentence under a key of the words of the sentence and of the
+// feature and its lexicon, so that the features of the next reader take them
+// from here instead of computing them again. The values are kept for a bounded
+// number of sentences, evicting the least recently used ones, and are shared
+// by the features of the process that ask for the same size.
+
+#ifndef SYNTAXNET_SHARED_TOKEN_VALUES_H_
+#define SYNTAXNET_SHARED_TOKEN_VALUES_H_
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/utils.h"
+#include "syntaxnet/workspace.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace syntaxnet {
+
+class SharedTokenValues {
+ public:
+  // Creates an empty store of the values of at most max_entries sentences and
+  // features.
+  explicit SharedTokenValues(int max_entries);
+
+  // Returns the shared store of the given size, creating it on first use. The
+  // result must be released with Release().
+  static SharedTokenValues *Get(int max_entries);
+
+  // Releases a store acquired by Get(), deleting it when no feature uses it
+  // anymore. Does nothing if the store is null.
+  static void Release(SharedTokenValues *values);
+
+  // Returns the fingerprint identifying a feature, e.g. from its type, its
+  // parameters and the file of its lexicon.
+  static uint64 FeatureKey(const string &feature);
+
+  // Returns the fingerprint of the words of a sentence.
+  static uint64 WordsKey(const Sentence &sentence);
+
+  // Returns the key of the values of a feature for a sentence.
+  static uint64 Key(uint64 feature_key, uint64 words_key);
+
+  // If values of the size of *workspace are stored under key, copies them to
+  // the workspace, marks them as most recently used and returns true.
+  bool Lookup(uint64 key, VectorIntWorkspace *workspace);
+
+  // Stores the values of a workspace under key, evicting the least recently
+  // used values if the store is full.
+  void Insert(uint64 key, const VectorIntWorkspace &workspace);
+
+  // Accessors for the number of stored value vectors and the hit and miss
+  // counts of Lookup().
+  int size() const;
+  int64 num_hits() const;
+  int64 num_misses() const;
+
+ private:
+  // Values stored under a key.
+  struct Entry {
+    uint64 key = 0;
+    std::vector<int> values;
+  };
+
+  // Maximum number of stored value vectors.
+  const int max_entries_;
+
+  // Number of Get() calls not matched by a Release(). Guarded by the lock of
+  // the shared stores.
+  int refcount_ = 0;
+
+  // Guards the members below.
+  mutable mutex mu_;
+
+  // Values from the most to the least recently used, and their positions in
+  // that list by key.
+  std::list<Entry> entries_;
+  std::unordered_map<uint64, std::list<Entry>::iterator> index_;
+
+  // Hit and miss counts of Lookup().
+  int64 num_hits_ = 0;
+  int64 num_misses_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedTokenValues);
+};
+
+// A workspace holding the words key of a sentence, computed once for all the
+// features of the sentence that share their values.
+class WordsKeyWorkspace : public Workspace {
+ public:
+  // Name of the shared workspace.
+  static const char kWorkspaceName[];
+
+  // Returns the name of this type of workspace.
+  static string TypeName() { return "WordsKey"; }
+
+  // Returns the words key of the sentence, from the workspace with the given
+  // index if it is set, or computing and setting it otherwise.
+  static uint64 GetOrCreate(int index, const Sentence &sentence,
+                            WorkspaceSet *workspaces);
+
+ private:
+  // Words key of the sentence.
+  uint64 key_ = 0;
+};
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_SHARED_TOKEN_VALUES_H_
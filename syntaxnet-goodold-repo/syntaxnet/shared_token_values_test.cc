@@ -0,0 +1,101 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/shared_token_values.h"
+
+#include <string>
+
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/utils.h"
+#include "syntaxnet/workspace.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+namespace {
+
+// Returns a sentence with the given words.
+Sentence MakeSentence(const vector<string> &words) {
+  Sentence sentence;
+  for (const string &word : words) sentence.add_token()->set_word(word);
+  return sentence;
+}
+
+TEST(SharedTokenValuesTest, ReturnsStoredValues) {
+  SharedTokenValues values(4);
+  const uint64 key = SharedTokenValues::Key(
+      SharedTokenValues::FeatureKey("word\nword-map"),
+      SharedTokenValues::WordsKey(MakeSentence({"a", "b"})));
+  VectorIntWorkspace workspace(2);
+  EXPECT_FALSE(values.Lookup(key, &workspace));
+  values.Insert(key, VectorIntWorkspace(vector<int>{3, 5}));
+
+  ASSERT_TRUE(values.Lookup(key, &workspace));
+  EXPECT_EQ(3, workspace.element(0));
+  EXPECT_EQ(5, workspace.element(1));
+
+  // Values of another number of tokens are never returned.
+  VectorIntWorkspace longer(3);
+  EXPECT_FALSE(values.Lookup(key, &longer));
+  EXPECT_EQ(1, values.num_hits());
+  EXPECT_EQ(2, values.num_misses());
+}
+
+TEST(SharedTokenValuesTest, KeysDependOnFeatureAndWords) {
+  const uint64 feature = SharedTokenValues::FeatureKey("word\nword-map");
+  const Sentence sentence = MakeSentence({"a", "b"});
+  const uint64 key =
+      SharedTokenValues::Key(feature, SharedTokenValues::WordsKey(sentence));
+  Sentence tagged = sentence;
+  tagged.mutable_token(0)->set_tag("X");
+  EXPECT_EQ(key, SharedTokenValues::Key(
+                     feature, SharedTokenValues::WordsKey(tagged)));
+  EXPECT_NE(key, SharedTokenValues::Key(
+                     SharedTokenValues::FeatureKey("word\nother-map"),
+                     SharedTokenValues::WordsKey(sentence)));
+  EXPECT_NE(key, SharedTokenValues::Key(
+                     feature,
+                     SharedTokenValues::WordsKey(MakeSentence({"ab"}))));
+}
+
+TEST(SharedTokenValuesTest, EvictsLeastRecentlyUsed) {
+  SharedTokenValues values(2);
+  VectorIntWorkspace workspace(1);
+  values.Insert(1, VectorIntWorkspace(vector<int>{1}));
+  values.Insert(2, VectorIntWorkspace(vector<int>{2}));
+  ASSERT_TRUE(values.Lookup(1, &workspace));
+  values.Insert(3, VectorIntWorkspace(vector<int>{3}));
+  EXPECT_EQ(2, values.size());
+  EXPECT_TRUE(values.Lookup(1, &workspace));
+  EXPECT_FALSE(values.Lookup(2, &workspace));
+  ASSERT_TRUE(values.Lookup(3, &workspace));
+  EXPECT_EQ(3, workspace.element(0));
+}
+
+TEST(SharedTokenValuesTest, SharesStoresOfTheSameSize) {
+  SharedTokenValues *first = SharedTokenValues::Get(16);
+  SharedTokenValues *second = SharedTokenValues::Get(16);
+  SharedTokenValues *other = SharedTokenValues::Get(32);
+  EXPECT_EQ(first, second);
+  EXPECT_NE(first, other);
+  SharedTokenValues::Release(first);
+  SharedTokenValues::Release(second);
+  SharedTokenValues::Release(other);
+  SharedTokenValues::Release(nullptr);
+}
+
+}  // namespace
+}  // namespace syntaxnet
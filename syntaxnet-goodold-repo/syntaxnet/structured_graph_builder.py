@@ -25,6 +25,7 @@ from syntaxnet import graph_builder
 from syntaxnet.ops import gen_parser_ops
 
 tf.NoGradient('BeamParseReader')
+tf.NoGradient('FeedBeamParseReader')
 tf.NoGradient('BeamParser')
 tf.NoGradient('BeamParserOutput')
 
@@ -78,18 +79,31 @@ class StructuredGraphBuilder(graph_builder.GreedyParser):
                      batch_size,
                      corpus_name,
                      until_all_final=False,
-                     always_start_new_sentences=False):
-    """Adds an op capable of reading sentences and parsing them with a beam."""
-    features, state, epochs = gen_parser_ops.beam_parse_reader(
+                     always_start_new_sentences=False,
+                     documents=None,
+                     inference=False):
+    """Adds an op capable of reading sentences and parsing them with a beam.
+
+    If documents is given, the sentences are read from that tensor of
+    serialized Sentence protos instead of the corpus. With inference, the
+    reader does not record the path histories needed for training.
+    """
+    kwargs = dict(
         task_context=task_context,
         feature_size=self._feature_size,
         beam_size=self._beam_size,
         batch_size=batch_size,
-        corpus_name=corpus_name,
         allow_feature_weights=self._allow_feature_weights,
         arg_prefix=self._arg_prefix,
         continue_until_all_final=until_all_final,
-        always_start_new_sentences=always_start_new_sentences)
+        always_start_new_sentences=always_start_new_sentences,
+        inference=inference)
+    if documents is None:
+      features, state, epochs = gen_parser_ops.beam_parse_reader(
+          corpus_name=corpus_name, **kwargs)
+    else:
+      features, state, epochs = gen_parser_ops.feed_beam_parse_reader(
+          documents, **kwargs)
     return {'state': state, 'features': features, 'epochs': epochs}
 
   def _BuildSequence(self,
@@ -113,9 +127,12 @@ class StructuredGraphBuilder(graph_builder.GreedyParser):
       return tf.logical_and(args[1] < max_steps, tf.reduce_any(args[3]))
 
     step = tf.constant(0, tf.int32, [])
+    # The scores of every step have the same shape, so preallocating them for
+    # max_steps lets the concat below return them without a copy.
     scores_array = tensor_array_ops.TensorArray(dtype=tf.float32,
                                                 size=0,
-                                                dynamic_size=True)
+                                                dynamic_size=True,
+                                                capacity=max_steps)
     alive = tf.constant(True, tf.bool, [batch_size])
     alive_steps = tf.constant(0, tf.int32, [batch_size])
     t = tf.while_loop(
@@ -191,14 +208,10 @@ class StructuredGraphBuilder(graph_builder.GreedyParser):
 
       optimizer = tf.train.MomentumOptimizer(n['learning_rate'],
                                              momentum,
-                                             use_locking=self._use_locking)
-      train_op = optimizer.minimize(n['cost'],
-                                    var_list=trainable_params.values())
-      for param in trainable_params.values():
-        slot = optimizer.get_slot(param, 'momentum')
-        self.inits[slot.name] = state_ops.init_variable(slot,
-                                                        tf.zeros_initializer)
-        self.variables[slot.name] = slot
+                                             use_locking=self._use_locking,
+                                             sum_duplicate_indices=True)
+      train_op = self._Minimize(optimizer, n['cost'],
+                                trainable_params.values())
 
       def NumericalChecks():
         return tf.group(*[
@@ -222,19 +235,94 @@ class StructuredGraphBuilder(graph_builder.GreedyParser):
                     task_context,
                     batch_size,
                     evaluation_max_steps=300,
-                    corpus_name=None):
+                    corpus_name=None,
+                    documents=None,
+                    num_alternatives=0):
+    """Builds the forward network only without the training operation.
+
+    Args:
+      task_context: file path from which to read the task context.
+      batch_size: number of examples per batch.
+      evaluation_max_steps: max number of parsing actions during evaluation.
+      corpus_name: name of the task input in the task context to read parses
+          from.
+      documents: optional tensor of serialized Sentence protos to parse
+          instead of the corpus, at most batch_size per run. Each run then
+          returns the parses of the documents fed to it.
+      num_alternatives: if positive, each output document also lists up to
+          this many best parses of its beam in its KBestSyntaxAnalyses
+          extension.
+
+    Returns:
+      Dictionary of named eval nodes.
+    """
     with tf.name_scope('evaluation'):
       n = self.evaluation
       n.update(self._AddBeamReader(task_context,
                                    batch_size,
                                    corpus_name,
                                    until_all_final=True,
-                                   always_start_new_sentences=True))
+                                   always_start_new_sentences=True,
+                                   documents=documents,
+                                   inference=True))
       self._BuildNetwork(
           list(n['features']),
           return_average=self._use_averaging)
       n.update(self._BuildSequence(batch_size, evaluation_max_steps, n[
           'features'], n['state'], use_average=self._use_averaging))
       n['eval_metrics'], n['documents'] = (
-          gen_parser_ops.beam_eval_output(n['state']))
+          gen_parser_ops.beam_eval_output(n['state'],
+                                          num_alternatives=num_alternatives))
+    return n
+
+  def AddFusedEvaluation(self,
+                         task_context,
+                         batch_size,
+                         evaluation_max_steps=300,
+                         corpus_name='documents',
+                         num_alternatives=0):
+    """Builds an evaluation network that parses whole batches in one op.
+
+    The BeamParseDecoder op scores the beams with the network of this parser
+    itself and runs all beam parsing steps of a batch in a single step, in
+    place of the while loop of AddEvaluation and the scores it accumulates.
+    The 'epochs', 'eval_metrics' and 'documents' nodes are as in AddEvaluation.
+
+    Args:
+      task_context: file path from which to read the task context.
+      batch_size: number of sentences to parse in one step.
+      evaluation_max_steps: max number of parsing actions during evaluation.
+      corpus_name: name of the task input to read parses from.
+      num_alternatives: if positive, each output document also lists up to
+          this many best parses, as in AddEvaluation.
+
+    Returns:
+      Dictionary of named eval nodes.
+
+    Raises:
+      ValueError: if the actions are scored by two softmax heads, or the
+        embedding matrices are in half precision.
+    """
+    if self._num_tag_actions or self._factored_arc_actions:
+      raise ValueError('Fused decoding needs a single softmax head')
+    if self._half_embeddings:
+      raise ValueError('Fused decoding needs float embedding matrices')
+    with tf.name_scope('evaluation'):
+      n = self.evaluation
+      matrices = self._AddEmbeddingMatrices(
+          return_average=self._use_averaging)
+      weights, biases = self._AddLayerParams(
+          return_average=self._use_averaging)
+      epochs, n['eval_metrics'], n['documents'] = (
+          gen_parser_ops.beam_parse_decoder(
+              matrices, weights, biases,
+              task_context=task_context,
+              feature_size=self._feature_size,
+              beam_size=self._beam_size,
+              batch_size=batch_size,
+              max_steps=evaluation_max_steps,
+              num_alternatives=num_alternatives,
+              corpus_name=corpus_name,
+              arg_prefix=self._arg_prefix))
+      n['epochs'] = tf.identity(epochs, name='epochs')
     return n
@@ -107,3 +107,103 @@ def tf_gen_op_wrapper_py(name, out=None, hidden=[], visibility=None, deps=[],
                     deps=[
                         "@org_tensorflow//tensorflow/python:framework_for_generated_wrappers",
                     ],)
+
+# SyntaxNet kernels a mobile parsing library compiles, and the libraries they
+# use. Training-only kernels like the lexicon builder are left out.
+_MOBILE_KERNEL_SRCS = [
+    "beam_reader_ops.cc",
+    "document_filters.cc",
+    "embed_features.cc",
+    "greedy_parse_decoder.cc",
+    "reader_ops.cc",
+    "top_allowed_actions_op.cc",
+    "unpack_sparse_features.cc",
+]
+
+_MOBILE_KERNEL_DEPS = [
+    ":batch_size_controller",
+    ":document_batch",
+    ":document_format",
+    ":document_queue",
+    ":feature_profiler",
+    ":feed_forward_network",
+    ":gold_features",
+    ":kbest_syntax_proto",
+    ":network_scorer",
+    ":parse_cache",
+    ":parser_transitions",
+    ":proto_io",
+    ":reader_stats",
+    ":sentence_batch",
+    ":sentence_proto",
+    ":sparse_proto",
+    ":task_context",
+    ":task_spec_proto",
+    ":text_formats",
+    ":top_allowed_actions",
+    ":utils",
+]
+
+# Builds a parsing library for Android that registers only the ops and CPU
+# kernels the given model bundles, written by model_bundle_main, run. The
+# library holds ParsingSession, the model bundle file system and the SyntaxNet
+# and TensorFlow kernels, compiled with -DSELECTIVE_REGISTRATION against the
+# ops_to_register.h header selective_registration_main writes for the
+# bundles, so that the linker drops every other op, kernel and gradient. Set
+# "quantized" for bundles of models quantized by quantize_model.py. Like the
+# other Android libraries, the library must be built with the Android
+# crosstool, e.g.
+#   bazel build -c opt syntaxnet:<name> \
+#     --crosstool_top=//external:android/crosstool --cpu=armeabi-v7a \
+#     --host_crosstool_top=@bazel_tools//tools/cpp:toolchain
+def parser_mobile_library(name, model_bundles, quantized=False,
+                          visibility=None):
+  header = name + "/ops_to_register.h"
+  native.genrule(
+      name = name + "_ops_to_register",
+      srcs = model_bundles,
+      outs = [header],
+      tools = [":selective_registration_main"],
+      cmd = ("$(location :selective_registration_main) --output=$@ " +
+             "--model_bundles=$$(echo $(SRCS) | tr ' ' ',')"),
+  )
+
+  quantized_srcs = []
+  quantized_deps = []
+  if quantized:
+    quantized_srcs = [
+        "@org_tensorflow//tensorflow/contrib/quantization:android_ops",
+        "@org_tensorflow//tensorflow/contrib/quantization/kernels:android_ops",
+    ]
+    quantized_deps = ["@gemmlowp//:eight_bit_int_gemm"]
+
+  native.cc_library(
+      name = name,
+      srcs = [
+          header,
+          "model_bundle.cc",
+          "model_bundle.h",
+          "ops/parser_ops.cc",
+          "parsing_session.cc",
+          "parsing_session.h",
+          "@org_tensorflow//tensorflow/core:android_op_registrations_and_gradients",
+          "@org_tensorflow//tensorflow/core/kernels:android_all_ops",
+      ] + _MOBILE_KERNEL_SRCS + quantized_srcs,
+      copts = tf_copts() + [
+          "-Os",
+          "-DSELECTIVE_REGISTRATION",
+          "-I$(GENDIR)/" + PACKAGE_NAME + "/" + name,
+      ],
+      linkopts = ["-lz"],
+      tags = [
+          "manual",
+          "notap",
+      ],
+      visibility = visibility,
+      deps = _MOBILE_KERNEL_DEPS + quantized_deps + [
+          "@org_tensorflow//tensorflow/core:android_tensorflow_lib_selective_registration",
+          "@org_tensorflow//tensorflow/core:protos_cc",
+          "@org_tensorflow//third_party/eigen3",
+      ],
+      alwayslink = 1,
+  )
@@ -0,0 +1,407 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Joint tagger and morpher transition system.
+//
+// This transition system has one type of actions:
+//  - The SHIFT action pushes the next input token to the stack and
+//    advances to the next input token, assigning both a part-of-speech tag and
+//    a morphological analysis to the token that was shifted.
+//
+// The transition system operates with parser actions encoded as integers:
+//  - A SHIFT action is encoded as tag * number of analyses + analysis.
+//
+// A sentence is thus tagged and analyzed in a single pass, with one network
+// run per token. The scores of the actions are meant to be the sums of the
+// log-probabilities of the tag and of the analysis, as computed by two softmax
+// heads over shared hidden layers, so that the best action pairs the best tag
+// with the best analysis.
+
+#include <algorithm>
+#include <string>
+
+#include "syntaxnet/morphology_label_set.h"
+#include "syntaxnet/parser_features.h"
+#include "syntaxnet/parser_state.h"
+#include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/sentence_features.h"
+#include "syntaxnet/shared_store.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/term_frequency_map.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+
+namespace syntaxnet {
+
+class TaggerMorpherTransitionState : public ParserTransitionState {
+ public:
+  TaggerMorpherTransitionState(const TermFrequencyMap *tag_map,
+                               const TagToCategoryMap *tag_to_category,
+                               const MorphologyLabelSet *label_set)
+      : tag_map_(tag_map),
+        tag_to_category_(tag_to_category),
+        label_set_(label_set) {}
+
+  explicit TaggerMorpherTransitionState(
+      const TaggerMorpherTransitionState *state)
+      : TaggerMorpherTransitionState(state->tag_map_, state->tag_to_category_,
+                                     state->label_set_) {
+    tag_ = state->tag_;
+    gold_tag_ = state->gold_tag_;
+    morph_ = state->morph_;
+    gold_morph_ = state->gold_morph_;
+  }
+
+  // Clones the transition state by returning a new object.
+  ParserTransitionState *Clone() const override {
+    return new TaggerMorpherTransitionState(this);
+  }
+
+  // Reads gold tags and analyses for each token.
+  void Init(ParserState *state) override {
+    const int num_tokens = state->sentence().token_size();
+    tag_.assign(num_tokens, -1);
+    gold_tag_.assign(num_tokens, -1);
+    morph_.assign(num_tokens, -1);
+    gold_morph_.assign(num_tokens, -1);
+    for (int pos = 0; pos < num_tokens; ++pos) {
+      const Token &token = state->GetToken(pos);
+      gold_tag_[pos] = tag_map_->LookupIndex(token.tag(), -1);
+
+      // As in the morpher, tokens may lack an analysis or have one missing
+      // from the label set at test time.
+      gold_morph_[pos] = label_set_->LookupExisting(
+          token.GetExtension(TokenMorphology::morphology));
+    }
+  }
+
+  // Returns the tag assigned to a given token.
+  int Tag(int index) const {
+    DCHECK_GE(index, 0);
+    DCHECK_LT(index, tag_.size());
+    return tag_[index];
+  }
+
+  // Returns the analysis assigned to a given token.
+  int Morph(int index) const {
+    DCHECK_GE(index, 0);
+    DCHECK_LT(index, morph_.size());
+    return morph_[index];
+  }
+
+  // Sets the tag and the analysis of the token at index.
+  void Set(int index, int tag, int morph) {
+    DCHECK_GE(index, 0);
+    DCHECK_LT(index, tag_.size());
+    tag_[index] = tag;
+    morph_[index] = morph;
+  }
+
+  // Returns the gold tag for a given token.
+  int GoldTag(int index) const {
+    DCHECK_GE(index, 0);
+    DCHECK_LT(index, gold_tag_.size());
+    return gold_tag_[index];
+  }
+
+  // Returns the gold analysis for a given token.
+  int GoldMorph(int index) const {
+    DCHECK_GE(index, 0);
+    DCHECK_LT(index, gold_morph_.size());
+    return gold_morph_[index];
+  }
+
+  // Returns the string representation of a POS tag, or an empty string
+  // if the tag is invalid.
+  string TagAsString(int tag) const {
+    if (tag >= 0 && tag < tag_map_->Size()) return tag_map_->GetTerm(tag);
+    return "";
+  }
+
+  // Returns the proto corresponding to an analysis, or an empty proto if the
+  // analysis is not found.
+  const TokenMorphology &MorphAsProto(int morph) const {
+    if (morph >= 0 && morph < label_set_->Size()) {
+      return label_set_->Lookup(morph);
+    }
+    return TokenMorphology::default_instance();
+  }
+
+  // Adds the tags, categories and analyses to the document.
+  void AddParseToDocument(const ParserState &state, bool rewrite_root_labels,
+                          Sentence *sentence) const override {
+    for (size_t i = 0; i < tag_.size(); ++i) {
+      Token *token = sentence->mutable_token(i);
+      token->set_tag(TagAsString(Tag(i)));
+      if (tag_to_category_) {
+        token->set_category(tag_to_category_->GetCategory(token->tag()));
+      }
+      *token->MutableExtension(TokenMorphology::morphology) =
+          MorphAsProto(Morph(i));
+    }
+  }
+
+  // A token is correct if both its tag and its analysis are.
+  bool IsTokenCorrect(const ParserState &state, int index) const override {
+    return GoldTag(index) == Tag(index) && GoldMorph(index) == Morph(index);
+  }
+
+  // Returns a human readable string representation of this state.
+  string ToString(const ParserState &state) const override {
+    string str;
+    for (int i = 0; i < state.Next(); ++i) {
+      if (i > 0) str.append(" ");
+      tensorflow::strings::StrAppend(
+          &str, state.GetToken(i).word(), "[", TagAsString(Tag(i)), "|",
+          MorphAsProto(Morph(i)).ShortDebugString(), "]");
+    }
+    for (int i = state.Next(); i < state.NumTokens(); ++i) {
+      tensorflow::strings::StrAppend(&str, " ", state.GetToken(i).word());
+    }
+    return str;
+  }
+
+ private:
+  // Currently assigned POS tags and analyses for each token in this sentence.
+  vector<int> tag_;
+  vector<int> morph_;
+
+  // Gold POS tags and analyses from the input document.
+  vector<int> gold_tag_;
+  vector<int> gold_morph_;
+
+  // Maps between integer and string or proto representations of the tags and
+  // analyses. Not owned.
+  const TermFrequencyMap *tag_map_ = nullptr;
+  const TagToCategoryMap *tag_to_category_ = nullptr;
+  const MorphologyLabelSet *label_set_ = nullptr;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(TaggerMorpherTransitionState);
+};
+
+class TaggerMorpherTransitionSystem : public ParserTransitionSystem {
+ public:
+  ~TaggerMorpherTransitionSystem() override {
+    SharedStore::Release(tag_map_);
+    SharedStore::Release(tag_to_category_);
+    SharedStore::Release(label_set_);
+  }
+
+  // Determines the locations of the tag map and the label set.
+  void Setup(TaskContext *context) override {
+    input_tag_map_ = context->GetInput("tag-map", "text", "");
+    join_category_to_pos_ = context->GetBoolParameter("join_category_to_pos");
+    input_tag_to_category_ = context->GetInput("tag-to-category", "text", "");
+    input_label_set_ = context->GetInput("morph-label-set");
+  }
+
+  // Reads the tag map, the tag to category map and the label set.
+  void Init(TaskContext *context) override {
+    const string tag_map_path = TaskContext::InputFile(*input_tag_map_);
+    tag_map_ = SharedStoreUtils::GetWithDefaultName<TermFrequencyMap>(
+        tag_map_path, 0, 0);
+    if (!join_category_to_pos_) {
+      const string tag_to_category_path =
+          TaskContext::InputFile(*input_tag_to_category_);
+      tag_to_category_ = SharedStoreUtils::GetWithDefaultName<TagToCategoryMap>(
+          tag_to_category_path);
+    }
+    const string label_set_path = TaskContext::InputFile(*input_label_set_);
+    label_set_ = SharedStoreUtils::GetWithDefaultName<MorphologyLabelSet>(
+        label_set_path);
+  }
+
+  // Encodes a SHIFT action assigning a tag and an analysis.
+  ParserAction ShiftAction(int tag, int morph) const {
+    return tag * label_set_->Size() + morph;
+  }
+
+  // Decodes the tag and the analysis of a SHIFT action.
+  int ActionTag(ParserAction action) const {
+    return action / label_set_->Size();
+  }
+  int ActionMorph(ParserAction action) const {
+    return action % label_set_->Size();
+  }
+
+  // The transition system doesn't look at the dependency tree, so it allows
+  // non-projective trees.
+  bool AllowsNonProjective() const override { return true; }
+
+  // Returns the number of action types.
+  int NumActionTypes() const override { return 1; }
+
+  // Returns the number of possible actions, one per tag and analysis.
+  int NumActions(int num_labels) const override {
+    return tag_map_->Size() * label_set_->Size();
+  }
+
+  // The default action for a given state is assigning the most frequent tag
+  // and the first analysis.
+  ParserAction GetDefaultAction(const ParserState &state) const override {
+    return ShiftAction(0, 0);
+  }
+
+  // Returns the next gold action for a given state according to the
+  // underlying annotated sentence. Unknown gold tags or analyses, which only
+  // occur at test time, are replaced by the first one, so that the action
+  // still encodes the other.
+  ParserAction GetNextGoldAction(const ParserState &state) const override {
+    if (!state.EndOfInput()) {
+      const TaggerMorpherTransitionState &transition_state =
+          TransitionState(state);
+      return ShiftAction(std::max(transition_state.GoldTag(state.Next()), 0),
+                         std::max(transition_state.GoldMorph(state.Next()), 0));
+    }
+    return ShiftAction(0, 0);
+  }
+
+  // Checks if the action is allowed in a given parser state.
+  bool IsAllowedAction(ParserAction action,
+                       const ParserState &state) const override {
+    return !state.EndOfInput();
+  }
+
+  // Makes a shift by pushing the next input token on the stack and moving to
+  // the next position.
+  void PerformActionWithoutHistory(ParserAction action,
+                                   ParserState *state) const override {
+    DCHECK(!state->EndOfInput());
+    if (!state->EndOfInput()) {
+      MutableTransitionState(state)->Set(state->Next(), ActionTag(action),
+                                         ActionMorph(action));
+      state->Push(state->Next());
+      state->Advance();
+    }
+  }
+
+  // We are in a final state when we reached the end of the input.
+  bool IsFinalState(const ParserState &state) const override {
+    return state.EndOfInput();
+  }
+
+  // Returns a string representation of a parser action.
+  string ActionAsString(ParserAction action,
+                        const ParserState &state) const override {
+    return tensorflow::strings::StrCat(
+        "SHIFT(", tag_map_->GetTerm(ActionTag(action)), ", ",
+        label_set_->Lookup(ActionMorph(action)).ShortDebugString(), ")");
+  }
+
+  // No state is deterministic in this transition system.
+  bool IsDeterministicState(const ParserState &state) const override {
+    return false;
+  }
+
+  // Returns a new transition state to be used to enhance the parser state.
+  ParserTransitionState *NewTransitionState(bool training_mode) const override {
+    return new TaggerMorpherTransitionState(tag_map_, tag_to_category_,
+                                            label_set_);
+  }
+
+  // Downcasts the const ParserTransitionState in ParserState to a const
+  // TaggerMorpherTransitionState.
+  static const TaggerMorpherTransitionState &TransitionState(
+      const ParserState &state) {
+    return *static_cast<const TaggerMorpherTransitionState *>(
+        state.transition_state());
+  }
+
+  // Downcasts the ParserTransitionState in ParserState to a
+  // TaggerMorpherTransitionState.
+  static TaggerMorpherTransitionState *MutableTransitionState(
+      ParserState *state) {
+    return static_cast<TaggerMorpherTransitionState *>(
+        state->mutable_transition_state());
+  }
+
+ private:
+  // Inputs for the tag map, the tag to category map and the label set. Not
+  // owned.
+  TaskInput *input_tag_map_ = nullptr;
+  TaskInput *input_tag_to_category_ = nullptr;
+  TaskInput *input_label_set_ = nullptr;
+
+  // Tag map, tag to category map and label set. Owned through SharedStore.
+  const TermFrequencyMap *tag_map_ = nullptr;
+  const TagToCategoryMap *tag_to_category_ = nullptr;
+  const MorphologyLabelSet *label_set_ = nullptr;
+
+  bool join_category_to_pos_ = false;
+};
+
+REGISTER_TRANSITION_SYSTEM("tagger-morpher", TaggerMorpherTransitionSystem);
+
+// Feature function for retrieving the tag assigned to a token by the joint
+// tagger and morpher transition system.
+class PredictedJointTagFeatureFunction
+    : public BasicParserSentenceFeatureFunction<Tag> {
+ public:
+  PredictedJointTagFeatureFunction() {}
+
+  // Reads the assigned tag at the focus index. Returns -1 if the focus is not
+  // within the sentence.
+  FeatureValue Compute(const WorkspaceSet &workspaces, const ParserState &state,
+                       int focus, const FeatureVector *result) const override {
+    if (focus < 0 || focus >= state.sentence().token_size()) return -1;
+    return TaggerMorpherTransitionSystem::TransitionState(state).Tag(focus);
+  }
+
+ private:
+  TF_DISALLOW_COPY_AND_ASSIGN(PredictedJointTagFeatureFunction);
+};
+
+REGISTER_PARSER_IDX_FEATURE_FUNCTION("pred-joint-tag",
+                                     PredictedJointTagFeatureFunction);
+
+// Feature function for retrieving the analysis assigned to a token by the joint
+// tagger and morpher transition system.
+class PredictedJointMorphTagFeatureFunction
+    : public ParserIndexFeatureFunction {
+ public:
+  PredictedJointMorphTagFeatureFunction() {}
+
+  // Determines the label set location.
+  void Setup(TaskContext *context) override {
+    context->GetInput("morph-label-set", "recordio", "token-morphology");
+  }
+
+  // Reads the label set.
+  void Init(TaskContext *context) override {
+    const string fname =
+        TaskContext::InputFile(*context->GetInput("morph-label-set"));
+    label_set_ = SharedStore::Get<MorphologyLabelSet>(fname, fname);
+    set_feature_type(new FullLabelFeatureType(name(), label_set_));
+  }
+
+  // Reads the assigned analysis at the focus index. Returns -1 if the focus is
+  // not within the sentence.
+  FeatureValue Compute(const WorkspaceSet &workspaces, const ParserState &state,
+                       int focus, const FeatureVector *result) const override {
+    if (focus < 0 || focus >= state.sentence().token_size()) return -1;
+    return TaggerMorpherTransitionSystem::TransitionState(state).Morph(focus);
+  }
+
+ private:
+  // Label set of the analyses. Owned through SharedStore.
+  const MorphologyLabelSet *label_set_ = nullptr;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PredictedJointMorphTagFeatureFunction);
+};
+
+REGISTER_PARSER_IDX_FEATURE_FUNCTION("pred-joint-morph-tag",
+                                     PredictedJointMorphTagFeatureFunction);
+
+}  // namespace syntaxnet
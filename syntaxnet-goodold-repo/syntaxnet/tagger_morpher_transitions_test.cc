@@ -0,0 +1,134 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <memory>
+#include <string>
+
+#include "syntaxnet/morphology_label_set.h"
+#include "syntaxnet/parser_state.h"
+#include "syntaxnet/parser_transitions.h"
+#include "syntaxnet/populate_test_inputs.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/task_spec.pb.h"
+#include "syntaxnet/term_frequency_map.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+class TaggerMorpherTransitionTest : public ::testing::Test {
+ public:
+  TaggerMorpherTransitionTest()
+      : transition_system_(ParserTransitionSystem::Create("tagger-morpher")) {}
+
+ protected:
+  // Reads the test document and gives its tokens alternating analyses.
+  void SetUp() override {
+    string document_text;
+    TF_CHECK_OK(ReadFileToString(tensorflow::Env::Default(),
+                                 "syntaxnet/testdata/document",
+                                 &document_text));
+    CHECK(TextFormat::ParseFromString(document_text, &document_));
+    for (int i = 0; i < document_.token_size(); ++i) {
+      TokenMorphology *morphology =
+          document_.mutable_token(i)->MutableExtension(
+              TokenMorphology::morphology);
+      TokenMorphology::Attribute *attribute = morphology->add_attribute();
+      attribute->set_name("Number");
+      attribute->set_value(i % 2 == 0 ? "Sing" : "Plur");
+    }
+  }
+
+  // Creates the tag map, the label map and the label set of the document, and
+  // initializes the transition system.
+  void SetUpForDocument() {
+    input_label_map_ = context_.GetInput("label-map", "text", "");
+    TaskInput *label_set_input = context_.GetInput("morph-label-set");
+    const string label_set_path = utils::JoinPath(
+        {tensorflow::testing::TmpDir(), "tagger-morpher-label-set"});
+    label_set_input->add_part()->set_file_pattern(label_set_path);
+    MorphologyLabelSet label_set;
+    for (const Token &token : document_.token()) {
+      label_set.Add(token.GetExtension(TokenMorphology::morphology));
+    }
+    label_set.Write(label_set_path);
+    num_analyses_ = label_set.Size();
+    transition_system_->Setup(&context_);
+    PopulateTestInputs::Defaults(document_).Populate(&context_);
+    label_map_.Load(TaskContext::InputFile(*input_label_map_),
+                    0 /* minimum frequency */,
+                    -1 /* maximum number of terms */);
+    transition_system_->Init(&context_);
+  }
+
+  // Returns a new parser state for the document.
+  ParserState *NewState(Sentence *sentence) {
+    ParserState state(sentence, transition_system_->NewTransitionState(
+                                    true /* training mode */),
+                      &label_map_);
+    return state.Clone();
+  }
+
+  Sentence document_;
+  int num_analyses_ = 0;
+  TaskContext context_;
+  TaskInput *input_label_map_ = nullptr;
+  TermFrequencyMap label_map_;
+  std::unique_ptr<ParserTransitionSystem> transition_system_;
+};
+
+TEST_F(TaggerMorpherTransitionTest, GoldParseAssignsTagsAndAnalyses) {
+  SetUpForDocument();
+  EXPECT_EQ(2, num_analyses_);
+  Sentence sentence = document_;
+  std::unique_ptr<ParserState> state(NewState(&sentence));
+  while (!transition_system_->IsFinalState(*state)) {
+    const ParserAction action = transition_system_->GetNextGoldAction(*state);
+    EXPECT_TRUE(transition_system_->IsAllowedAction(action, *state));
+    EXPECT_EQ(state->Next() % 2, action % num_analyses_);
+    transition_system_->PerformActionWithoutHistory(action, state.get());
+  }
+
+  // Parsing with the gold actions reproduces the tags and analyses.
+  Sentence parsed = document_;
+  state->AddParseToDocument(&parsed);
+  for (int i = 0; i < document_.token_size(); ++i) {
+    EXPECT_TRUE(state->IsTokenCorrect(i));
+    EXPECT_EQ(document_.token(i).tag(), parsed.token(i).tag());
+    EXPECT_EQ(document_.token(i)
+                  .GetExtension(TokenMorphology::morphology)
+                  .DebugString(),
+              parsed.token(i)
+                  .GetExtension(TokenMorphology::morphology)
+                  .DebugString());
+  }
+}
+
+TEST_F(TaggerMorpherTransitionTest, DefaultParseReachesFinalState) {
+  SetUpForDocument();
+  Sentence sentence = document_;
+  std::unique_ptr<ParserState> state(NewState(&sentence));
+  while (!transition_system_->IsFinalState(*state)) {
+    const ParserAction action = transition_system_->GetDefaultAction(*state);
+    EXPECT_TRUE(transition_system_->IsAllowedAction(action, *state));
+    transition_system_->PerformActionWithoutHistory(action, state.get());
+  }
+  EXPECT_EQ(document_.token_size(), state->Next());
+}
+
+}  // namespace syntaxnet
@@ -18,36 +18,178 @@ limitations under the License.
 #include <stddef.h>
 #include <algorithm>
 #include <limits>
+#include <numeric>
 
+#include "syntaxnet/mapped_file.h"
+#include "syntaxnet/shared_segments.h"
 #include "tensorflow/core/lib/core/status.h"
-#include "tensorflow/core/lib/io/inputbuffer.h"
+#include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 
 namespace syntaxnet {
+namespace {
 
-int TermFrequencyMap::Increment(const string &term) {
+// Magic number at the start of mapped files, "SNTFMAP1" in little endian.
+const uint64 kMappedMagic = 0x3150414d46544e53ULL;
+
+// Average number of terms per perfect hash bucket.
+const int kTermsPerBucket = 4;
+
+// Limits on the search for a perfect hash function. The last buckets placed
+// need about num_terms tries to hit one of the few free slots, so the number of
+// displacements tried grows with the number of terms.
+const uint64 kDisplacementsPerTerm = 64;
+const uint64 kMinDisplacements = 1 << 16;
+const int kMaxHashSeeds = 16;
+
+// Marker for the slots of the perfect hash without terms.
+const uint32 kEmptySlot = std::numeric_limits<uint32>::max();
+
+// Returns the slot of a term with the given hash, displaced by the given
+// displacement, in a table of the given size. The displaced hash is remixed
+// with the 64-bit MurmurHash3 finalizer, so that terms of a bucket land in
+// independent slots for each displacement.
+inline uint32 PerfectHashSlot(uint64 hash, uint32 displacement, uint64 size) {
+  uint64 x = hash ^ (displacement * 0x9e3779b97f4a7c15ULL);
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x % size;
+}
+
+// Builds a minimal perfect hash of the given unique terms by hashing and
+// displacing: the terms are hashed into buckets, and each bucket, largest
+// first, gets the smallest displacement placing all its terms into free slots.
+// Returns false if some bucket could not be placed with this seed.
+bool BuildPerfectHash(const vector<StringPiece> &terms, uint64 seed,
+                      vector<uint32> *displacements, vector<uint32> *slots) {
+  const uint64 num_terms = terms.size();
+  const uint64 num_buckets = displacements->size();
+  vector<vector<pair<uint64, uint32>>> buckets(num_buckets);
+  for (uint32 i = 0; i < num_terms; ++i) {
+    const uint64 hash =
+        tensorflow::Hash64(terms[i].data(), terms[i].size(), seed);
+    buckets[hash % num_buckets].emplace_back(hash, i);
+  }
+  vector<uint32> order(num_buckets);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&buckets](uint32 a, uint32 b) {
+    return buckets[a].size() > buckets[b].size();
+  });
+
+  const uint64 max_displacement =
+      std::min<uint64>(std::max(kMinDisplacements,
+                                kDisplacementsPerTerm * num_terms),
+                       std::numeric_limits<uint32>::max());
+  slots->assign(num_terms, kEmptySlot);
+  vector<uint32> bucket_slots;
+  for (const uint32 bucket : order) {
+    if (buckets[bucket].empty()) break;
+    bool placed = false;
+    for (uint32 displacement = 0; !placed && displacement < max_displacement;
+         ++displacement) {
+      bucket_slots.clear();
+      placed = true;
+      for (const auto &term : buckets[bucket]) {
+        const uint32 slot =
+            PerfectHashSlot(term.first, displacement, num_terms);
+        if ((*slots)[slot] != kEmptySlot ||
+            std::find(bucket_slots.begin(), bucket_slots.end(), slot) !=
+                bucket_slots.end()) {
+          placed = false;
+          break;
+        }
+        bucket_slots.push_back(slot);
+      }
+      if (placed) {
+        for (size_t k = 0; k < bucket_slots.size(); ++k) {
+          (*slots)[bucket_slots[k]] = buckets[bucket][k].second;
+        }
+        (*displacements)[bucket] = displacement;
+      }
+    }
+    if (!placed) return false;
+  }
+  return true;
+}
+
+// Appends the contents of a vector to a file.
+template <typename T>
+void AppendVector(const vector<T> &data, tensorflow::WritableFile *file) {
+  TF_CHECK_OK(file->Append(StringPiece(
+      reinterpret_cast<const char *>(data.data()), data.size() * sizeof(T))));
+}
+
+}  // namespace
+
+// A mapped file holds the following sections, in native byte order:
+//   - the header,
+//   - int64 frequencies[num_terms], in descending order,
+//   - uint32 offsets[num_terms + 1], delimiting term i as the bytes
+//     [offsets[i], offsets[i + 1]) of the pool,
+//   - uint32 displacements[num_buckets], per bucket of the perfect hash,
+//   - uint32 slots[num_terms], the index of the term in each hash slot,
+//   - char pool[pool_size], the concatenated terms.
+struct TermFrequencyMap::MappedHeader {
+  uint64 magic;
+  uint64 num_terms;
+  uint64 num_buckets;
+  uint64 hash_seed;
+  uint64 pool_size;
+
+  // Size of the text file saved along with the mapped file, to detect text
+  // files that were replaced.
+  uint64 text_size;
+
+  // Returns the expected size of the file.
+  uint64 FileSize() const {
+    return sizeof(MappedHeader) + num_terms * sizeof(int64) +
+           (2 * num_terms + 1 + num_buckets) * sizeof(uint32) + pool_size;
+  }
+};
+
+const char TermFrequencyMap::kMappedSuffix[] = ".mapped";
+
+int TermFrequencyMap::Increment(const string &term, int64 count) {
+  CHECK(region_ == nullptr) << "Cannot modify a mapped term frequency map";
   CHECK_EQ(term_index_.size(), term_data_.size());
   const TermIndex::const_iterator it = term_index_.find(term);
   if (term_index_.find(term) != term_index_.end()) {
     // Increment the existing term.
     pair<string, int64> &data = term_data_[it->second];
     CHECK_EQ(term, data.first);
-    ++(data.second);
+    data.second += count;
     return it->second;
   } else {
     // Add a new term.
     const int index = term_index_.size();
     CHECK_LT(index, std::numeric_limits<int32>::max());  // overflow
-    term_index_[term] = index;
-    term_data_.push_back(pair<string, int64>(term, 1));
+    term_data_.push_back(pair<string, int64>(term, count));
+    term_index_[term_data_.back().first] = index;
     return index;
   }
 }
 
+void TermFrequencyMap::Merge(const TermFrequencyMap &other) {
+  CHECK(other.region_ == nullptr) << "Cannot merge a mapped term frequency map";
+  for (const auto &data : other.term_data_) Increment(data.first, data.second);
+}
+
 void TermFrequencyMap::Clear() {
   term_index_.clear();
   term_data_.clear();
+  region_.reset();
+  mapped_size_ = 0;
+  num_kept_terms_ = 0;
+  header_ = nullptr;
+  frequencies_ = nullptr;
+  offsets_ = nullptr;
+  displacements_ = nullptr;
+  slots_ = nullptr;
+  pool_ = nullptr;
 }
 
 void TermFrequencyMap::Load(const string &filename, int min_frequency,
@@ -57,11 +199,22 @@ void TermFrequencyMap::Load(const string &filename, int min_frequency,
   // If max_num_terms is non-positive, replace it with INT_MAX.
   if (max_num_terms <= 0) max_num_terms = std::numeric_limits<int>::max();
 
+  // Prefer the mapped file, if any, and then a shared segment.
+  if (LoadMapped(filename, min_frequency, max_num_terms)) return;
+  if (LoadShared(filename, min_frequency, max_num_terms)) return;
+  LoadText(filename, min_frequency, max_num_terms);
+}
+
+void TermFrequencyMap::LoadForUpdate(const string &filename) {
+  Clear();
+  LoadText(filename, 0, std::numeric_limits<int>::max());
+  num_kept_terms_ = term_data_.size();
+}
+
+void TermFrequencyMap::LoadText(const string &filename, int min_frequency,
+                                int max_num_terms) {
   // Read the first line (total # of terms in the mapping).
-  std::unique_ptr<tensorflow::RandomAccessFile> file;
-  TF_CHECK_OK(tensorflow::Env::Default()->NewRandomAccessFile(filename, &file));
-  static const int kInputBufferSize = 1 * 1024 * 1024; /* bytes */
-  tensorflow::io::InputBuffer input(file.get(), kInputBufferSize);
+  MappedFile input(filename);
   string line;
   TF_CHECK_OK(input.ReadLine(&line));
   int32 total = -1;
@@ -69,7 +222,6 @@ void TermFrequencyMap::Load(const string &filename, int min_frequency,
   CHECK_GE(total, 0);
 
   // Read the mapping.
-  int64 last_frequency = -1;
   for (int i = 0; i < total && i < max_num_terms; ++i) {
     TF_CHECK_OK(input.ReadLine(&line));
     vector<string> elements = utils::Split(line, ' ');
@@ -81,12 +233,9 @@ void TermFrequencyMap::Load(const string &filename, int min_frequency,
     CHECK_GT(frequency, 0);
     const string &term = elements[0];
 
-    // Check frequency sorting (descending order).
-    if (i > 0) CHECK_GE(last_frequency, frequency);
-    last_frequency = frequency;
-
-    // Ignore low-frequency items.
-    if (frequency < min_frequency) continue;
+    // Stop at the first low-frequency item, so that the indices of the loaded
+    // terms are their positions in the file.
+    if (frequency < min_frequency) break;
 
     // Check uniqueness of the mapped terms.
     CHECK(term_index_.find(term) == term_index_.end())
@@ -94,14 +243,93 @@ void TermFrequencyMap::Load(const string &filename, int min_frequency,
 
     // Assign the next available index.
     const int index = term_index_.size();
-    term_index_[term] = index;
     term_data_.push_back(pair<string, int64>(term, frequency));
+    term_index_[term_data_.back().first] = index;
   }
   CHECK_EQ(term_index_.size(), term_data_.size());
   LOG(INFO) << "Loaded " << term_index_.size() << " terms from " << filename
             << ".";
 }
 
+bool TermFrequencyMap::LoadMapped(const string &filename, int min_frequency,
+                                  int max_num_terms) {
+  tensorflow::Env *env = tensorflow::Env::Default();
+  const string mapped_filename =
+      tensorflow::strings::StrCat(filename, kMappedSuffix);
+  if (!env->FileExists(mapped_filename)) return false;
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region;
+  TF_CHECK_OK(env->NewReadOnlyMemoryRegionFromFile(mapped_filename, &region));
+  uint64 text_size = 0;
+  TF_CHECK_OK(env->GetFileSize(filename, &text_size));
+  return UseRegion(std::move(region), mapped_filename, text_size,
+                   min_frequency, max_num_terms);
+}
+
+bool TermFrequencyMap::LoadShared(const string &filename, int min_frequency,
+                                  int max_num_terms) {
+  if (!SharedSegments::Enabled()) return false;
+  uint64 text_size = 0;
+  TF_CHECK_OK(tensorflow::Env::Default()->GetFileSize(filename, &text_size));
+  const string name =
+      SharedSegments::NameForFile("term-frequency-map", filename);
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region =
+      SharedSegments::Map(name, [&filename, text_size](const string &path) {
+        // Writes all terms, so that the segment serves any frequency cutoff.
+        TermFrequencyMap map;
+        map.LoadText(filename, 0, std::numeric_limits<int>::max());
+        map.WriteMapped(path, text_size);
+      });
+  return UseRegion(std::move(region), name, text_size, min_frequency,
+                   max_num_terms);
+}
+
+bool TermFrequencyMap::UseRegion(
+    std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region,
+    const string &name, uint64 text_size, int min_frequency,
+    int max_num_terms) {
+  CHECK_GE(region->length(), sizeof(MappedHeader))
+      << "Truncated mapped term frequency map " << name;
+  const auto *header = static_cast<const MappedHeader *>(region->data());
+  CHECK_EQ(kMappedMagic, header->magic)
+      << "Not a mapped term frequency map: " << name;
+  CHECK_EQ(header->FileSize(), region->length())
+      << "Truncated mapped term frequency map " << name;
+
+  // Fall back to the text file if it was replaced after saving both.
+  if (text_size != header->text_size) {
+    LOG(WARNING) << "Ignoring " << name << ", which does not match its text "
+                 << "file";
+    return false;
+  }
+
+  header_ = header;
+  frequencies_ = reinterpret_cast<const int64 *>(header + 1);
+  offsets_ = reinterpret_cast<const uint32 *>(frequencies_ + header->num_terms);
+  displacements_ = offsets_ + header->num_terms + 1;
+  slots_ = displacements_ + header->num_buckets;
+  pool_ = reinterpret_cast<const char *>(slots_ + header->num_terms);
+  region_ = std::move(region);
+
+  // The loaded terms are a prefix of the terms, as for text files.
+  while (mapped_size_ < header->num_terms && mapped_size_ < max_num_terms &&
+         frequencies_[mapped_size_] >= min_frequency) {
+    ++mapped_size_;
+  }
+  LOG(INFO) << "Mapped " << mapped_size_ << " terms from " << name << ".";
+  return true;
+}
+
+int TermFrequencyMap::LookupMappedIndex(StringPiece term, int unknown) const {
+  if (header_->num_terms == 0) return unknown;
+  const uint64 hash =
+      tensorflow::Hash64(term.data(), term.size(), header_->hash_seed);
+  const uint32 slot = PerfectHashSlot(
+      hash, displacements_[hash % header_->num_buckets], header_->num_terms);
+  const int index = slots_[slot];
+  return index < mapped_size_ && GetMappedTerm(index) == term ? index
+                                                              : unknown;
+}
+
 struct TermFrequencyMap::SortByFrequencyThenTerm {
   // Return a > b to sort in descending order of frequency; otherwise,
   // lexicographic sort on term.
@@ -111,39 +339,116 @@ struct TermFrequencyMap::SortByFrequencyThenTerm {
   }
 };
 
+vector<pair<string, int64>> TermFrequencyMap::SortedData() const {
+  if (region_ != nullptr) {
+    vector<pair<string, int64>> data;
+    for (int i = 0; i < mapped_size_; ++i) {
+      data.emplace_back(GetTerm(i), frequencies_[i]);
+    }
+    return data;
+  }
+
+  // Copy and sort the term data, after the terms whose indices are kept.
+  vector<pair<string, int64>> sorted_data(term_data_.begin(),
+                                          term_data_.end());
+  std::sort(sorted_data.begin() + num_kept_terms_, sorted_data.end(),
+            SortByFrequencyThenTerm());
+  return sorted_data;
+}
+
 void TermFrequencyMap::Save(const string &filename) const {
   CHECK_EQ(term_index_.size(), term_data_.size());
+  const vector<pair<string, int64>> sorted_data = SortedData();
 
-  // Copy and sort the term data.
-  vector<pair<string, int64>> sorted_data(term_data_);
-  std::sort(sorted_data.begin(), sorted_data.end(), SortByFrequencyThenTerm());
+  // Remove the mapped file of an earlier save.
+  tensorflow::Env *env = tensorflow::Env::Default();
+  const string mapped_filename =
+      tensorflow::strings::StrCat(filename, kMappedSuffix);
+  if (env->FileExists(mapped_filename)) {
+    TF_CHECK_OK(env->DeleteFile(mapped_filename));
+  }
 
   // Write the number of terms.
   std::unique_ptr<tensorflow::WritableFile> file;
-  TF_CHECK_OK(tensorflow::Env::Default()->NewWritableFile(filename, &file));
-  CHECK_LE(term_index_.size(), std::numeric_limits<int32>::max());  // overflow
-  const int32 num_terms = term_index_.size();
+  TF_CHECK_OK(env->NewWritableFile(filename, &file));
+  CHECK_LE(sorted_data.size(), std::numeric_limits<int32>::max());  // overflow
+  const int32 num_terms = sorted_data.size();
   const string header = tensorflow::strings::StrCat(num_terms, "\n");
   TF_CHECK_OK(file->Append(header));
 
   // Write each term and frequency.
   for (size_t i = 0; i < sorted_data.size(); ++i) {
-    if (i > 0) CHECK_GE(sorted_data[i - 1].second, sorted_data[i].second);
+    if (i > static_cast<size_t>(num_kept_terms_)) {
+      CHECK_GE(sorted_data[i - 1].second, sorted_data[i].second);
+    }
     const string line = tensorflow::strings::StrCat(
         sorted_data[i].first, " ", sorted_data[i].second, "\n");
     TF_CHECK_OK(file->Append(line));
   }
   TF_CHECK_OK(file->Close()) << "for file " << filename;
-  LOG(INFO) << "Saved " << term_index_.size() << " terms to " << filename
-            << ".";
+  LOG(INFO) << "Saved " << num_terms << " terms to " << filename << ".";
+}
+
+void TermFrequencyMap::SaveMapped(const string &filename) const {
+  Save(filename);
+  uint64 text_size = 0;
+  TF_CHECK_OK(tensorflow::Env::Default()->GetFileSize(filename, &text_size));
+  WriteMapped(tensorflow::strings::StrCat(filename, kMappedSuffix), text_size);
+}
+
+void TermFrequencyMap::WriteMapped(const string &filename,
+                                   uint64 text_size) const {
+  const vector<pair<string, int64>> sorted_data = SortedData();
+
+  // Lay out the terms and their frequencies.
+  MappedHeader header;
+  header.magic = kMappedMagic;
+  header.num_terms = sorted_data.size();
+  header.num_buckets = header.num_terms / kTermsPerBucket + 1;
+  vector<int64> frequencies;
+  vector<uint32> offsets = {0};
+  string pool;
+  vector<StringPiece> terms;
+  for (const auto &data : sorted_data) {
+    frequencies.push_back(data.second);
+    pool.append(data.first);
+    CHECK_LE(pool.size(), std::numeric_limits<uint32>::max());  // overflow
+    offsets.push_back(pool.size());
+  }
+  for (size_t i = 0; i < sorted_data.size(); ++i) {
+    terms.emplace_back(pool.data() + offsets[i], offsets[i + 1] - offsets[i]);
+  }
+  header.pool_size = pool.size();
+
+  // Find a perfect hash of the terms.
+  vector<uint32> displacements(header.num_buckets, 0);
+  vector<uint32> slots;
+  bool found = false;
+  for (header.hash_seed = 0; header.hash_seed < kMaxHashSeeds;
+       ++header.hash_seed) {
+    found = BuildPerfectHash(terms, header.hash_seed, &displacements, &slots);
+    if (found) break;
+  }
+  CHECK(found) << "Could not find a perfect hash for " << filename;
+
+  // Write the sections.
+  header.text_size = text_size;
+  std::unique_ptr<tensorflow::WritableFile> file;
+  TF_CHECK_OK(tensorflow::Env::Default()->NewWritableFile(filename, &file));
+  TF_CHECK_OK(file->Append(
+      StringPiece(reinterpret_cast<const char *>(&header), sizeof(header))));
+  AppendVector(frequencies, file.get());
+  AppendVector(offsets, file.get());
+  AppendVector(displacements, file.get());
+  AppendVector(slots, file.get());
+  TF_CHECK_OK(file->Append(pool));
+  TF_CHECK_OK(file->Close()) << "for file " << filename;
+  LOG(INFO) << "Saved " << header.num_terms << " terms to " << filename << ".";
 }
 
 TagToCategoryMap::TagToCategoryMap(const string &filename) {
   // Load the mapping.
-  std::unique_ptr<tensorflow::RandomAccessFile> file;
-  TF_CHECK_OK(tensorflow::Env::Default()->NewRandomAccessFile(filename, &file));
-  static const int kInputBufferSize = 1 * 1024 * 1024; /* bytes */
-  tensorflow::io::InputBuffer input(file.get(), kInputBufferSize);
+  MappedFile input(filename);
   string line;
   while (input.ReadLine(&line) == tensorflow::Status::OK()) {
     vector<string> pair = utils::Split(line, '\t');
@@ -171,6 +476,12 @@ void TagToCategoryMap::SetCategory(const string &tag, const string &category) {
   }
 }
 
+void TagToCategoryMap::Merge(const TagToCategoryMap &other) {
+  for (const auto &it : other.tag_to_category_) {
+    SetCategory(it.first, it.second);
+  }
+}
+
 void TagToCategoryMap::Save(const string &filename) const {
   // Write tag and category on each line.
   std::unique_ptr<tensorflow::WritableFile> file;
@@ -183,4 +494,41 @@ void TagToCategoryMap::Save(const string &filename) const {
   TF_CHECK_OK(file->Close()) << "for file " << filename;
 }
 
+const char ArcLabelConstraints::kRootTag[] = "<ROOT>";
+
+ArcLabelConstraints::ArcLabelConstraints(const string &filename) {
+  MappedFile input(filename);
+  string line;
+  while (input.ReadLine(&line) == tensorflow::Status::OK()) {
+    if (line.empty()) continue;
+    vector<string> arc = utils::Split(line, '\t');
+    CHECK_EQ(arc.size(), 3) << line;
+    Add(arc[0], arc[1], arc[2]);
+  }
+}
+
+void ArcLabelConstraints::Add(const string &head_tag,
+                              const string &dependent_tag,
+                              const string &label) {
+  labels_[std::make_pair(head_tag, dependent_tag)].insert(label);
+}
+
+void ArcLabelConstraints::Merge(const ArcLabelConstraints &other) {
+  for (const auto &it : other.labels_) {
+    labels_[it.first].insert(it.second.begin(), it.second.end());
+  }
+}
+
+void ArcLabelConstraints::Save(const string &filename) const {
+  std::unique_ptr<tensorflow::WritableFile> file;
+  TF_CHECK_OK(tensorflow::Env::Default()->NewWritableFile(filename, &file));
+  for (const auto &it : labels_) {
+    for (const string &label : it.second) {
+      TF_CHECK_OK(file->Append(tensorflow::strings::StrCat(
+          it.first.first, "\t", it.first.second, "\t", label, "\n")));
+    }
+  }
+  TF_CHECK_OK(file->Close()) << "for file " << filename;
+}
+
 }  // namespace syntaxnet
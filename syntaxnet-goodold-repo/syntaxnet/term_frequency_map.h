@@ -17,19 +17,34 @@ limitations under the License.
 #define SYNTAXNET_TERM_FREQUENCY_MAP_H_
 
 #include <stddef.h>
+#include <deque>
+#include <map>
 #include <memory>
+#include <set>
 #include <string>
-#include <unordered_map>
 #include <utility>
 #include <vector>
 
 #include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/gtl/flat_hash_map.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace syntaxnet {
 
 // A mapping from strings to frequencies with save and load functionality.
+//
+// Besides the text format, a map can be saved in a binary format that is read
+// through a read-only memory mapping, see SaveMapped(). Processes loading the
+// same mapped file share its pages, and loading does not parse or copy the
+// terms. Terms are then looked up through a minimal perfect hash. Load()
+// prefers the mapped file next to a text file, if any. Otherwise, if shared
+// segments are enabled, the first process loading a text file writes its
+// mapped format to a shared segment for all to map, see SharedSegments.
 class TermFrequencyMap {
  public:
+  // Suffix of the mapped file saved next to a text file by SaveMapped().
+  static const char kMappedSuffix[];
+
   // Creates an empty frequency map.
   TermFrequencyMap() {}
 
@@ -39,51 +54,140 @@ class TermFrequencyMap {
   }
 
   // Returns the number of terms with positive frequency.
-  int Size() const { return term_index_.size(); }
+  int Size() const {
+    return region_ != nullptr ? mapped_size_ : term_index_.size();
+  }
 
   // Returns the index associated with the given term.  If the term does not
   // exist, the unknown index is returned instead.
-  int LookupIndex(const string &term, int unknown) const {
+  int LookupIndex(StringPiece term, int unknown) const {
+    if (region_ != nullptr) return LookupMappedIndex(term, unknown);
     const TermIndex::const_iterator it = term_index_.find(term);
     return (it != term_index_.end() ? it->second : unknown);
   }
 
   // Returns the term associated with the given index.
-  const string &GetTerm(int index) const { return term_data_[index].first; }
+  string GetTerm(int index) const {
+    if (region_ != nullptr) return GetMappedTerm(index).ToString();
+    return term_data_[index].first;
+  }
 
   // Increases the frequency of the given term by 1, creating a new entry if
-  // necessary, and returns the index of the term.
-  int Increment(const string &term);
+  // necessary, and returns the index of the term. Mapped maps cannot be
+  // modified.
+  int Increment(const string &term) { return Increment(term, 1); }
+
+  // Increases the frequency of the given term by a count, otherwise like
+  // Increment() above.
+  int Increment(const string &term, int64 count);
+
+  // Adds the frequencies of another map to this one. Terms new to this map are
+  // added in the order of the other map.
+  void Merge(const TermFrequencyMap &other);
 
   // Clears all frequencies.
   void Clear();
 
   // Loads a frequency mapping from the given file, which must have been created
-  // by an earlier call to Save().  After loading, the term indices are
-  // guaranteed to be ordered in descending order of frequency (breaking ties
-  // arbitrarily).  However, any new terms inserted after loading do not
-  // maintain this sorting invariant.
+  // by an earlier call to Save(). The term indices are the positions of the
+  // terms in the file, which lists them in descending order of frequency
+  // (breaking ties arbitrarily), or for maps updated after LoadForUpdate(), in
+  // that order within the terms of each update. Any new terms inserted after
+  // loading are appended.
   //
-  // Only loads terms with frequency >= min_frequency.  If max_num_terms <= 0,
-  // then all qualifying terms are loaded; otherwise, max_num_terms terms with
-  // maximal frequency are loaded (breaking ties arbitrarily).
+  // Only loads the terms before the first one with a frequency below
+  // min_frequency, and if max_num_terms > 0, at most max_num_terms terms. For
+  // sorted files these are the terms with maximal frequency, and in any case
+  // the loaded terms keep their indices.
+  //
+  // If SaveMapped() saved a mapped file next to the given file, that file is
+  // mapped instead, with the same term indices. The same holds for shared
+  // segments.
   void Load(const string &filename, int min_frequency, int max_num_terms);
 
-  // Saves a frequency mapping to the given file.
+  // Loads all terms of the given text file, ignoring any mapped file, to add
+  // frequencies to them. Unlike after Load(), saves then keep the indices of
+  // the loaded terms: they list the loaded terms in index order, followed by
+  // the terms added since by descending frequency, so that models using the
+  // loaded map keep working with the saved one.
+  void LoadForUpdate(const string &filename);
+
+  // Saves a frequency mapping to the given file. Removes any mapped file next
+  // to it, which would be out of date.
   void Save(const string &filename) const;
 
+  // Saves a frequency mapping to the given file in the text format, and next
+  // to it in the mapped format.
+  void SaveMapped(const string &filename) const;
+
  private:
-  // Hashtable for term-to-index mapping.
-  typedef std::unordered_map<string, int> TermIndex;
+  // Hashtable for term-to-index mapping. The keys point into term_data_.
+  typedef tensorflow::gtl::FlatHashMap<StringPiece, int, StringPiece::Hasher>
+      TermIndex;
+
+  // Layout of mapped files.
+  struct MappedHeader;
 
   // Sorting functor for term data.
   struct SortByFrequencyThenTerm;
 
+  // Returns the term data in the order of the saved files.
+  vector<pair<string, int64>> SortedData() const;
+
+  // Loads the given text file.
+  void LoadText(const string &filename, int min_frequency, int max_num_terms);
+
+  // Maps the mapped file saved next to the given text file. Returns false if
+  // there is no such file, or if it does not match the text file.
+  bool LoadMapped(const string &filename, int min_frequency,
+                  int max_num_terms);
+
+  // Maps the shared segment holding the given text file in the mapped format,
+  // creating it if necessary. Returns false if shared segments are disabled.
+  bool LoadShared(const string &filename, int min_frequency,
+                  int max_num_terms);
+
+  // Uses the given region, described by 'name', as the mapped map of a text
+  // file of the given size. Returns false if the region does not match it.
+  bool UseRegion(std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region,
+                 const string &name, uint64 text_size, int min_frequency,
+                 int max_num_terms);
+
+  // Writes the map in the mapped format, for the text file of the given size.
+  void WriteMapped(const string &filename, uint64 text_size) const;
+
+  // Looks up a term in a mapped map.
+  int LookupMappedIndex(StringPiece term, int unknown) const;
+
+  // Returns a term of a mapped map.
+  StringPiece GetMappedTerm(int index) const {
+    return StringPiece(pool_ + offsets_[index],
+                       offsets_[index + 1] - offsets_[index]);
+  }
+
   // Mapping from terms to indices.
   TermIndex term_index_;
 
-  // Mapping from indices to term and frequency.
-  vector<pair<string, int64>> term_data_;
+  // Mapping from indices to term and frequency. A deque keeps the terms in
+  // place as terms are added.
+  std::deque<pair<string, int64>> term_data_;
+
+  // Memory region of a mapped map, or nullptr if the map was not mapped.
+  std::unique_ptr<tensorflow::ReadOnlyMemoryRegion> region_;
+
+  // Number of loaded terms of a mapped map, a prefix of all mapped terms.
+  int mapped_size_ = 0;
+
+  // Number of leading terms whose indices saves keep, see LoadForUpdate().
+  int num_kept_terms_ = 0;
+
+  // Sections of the mapped file, see MappedHeader.
+  const MappedHeader *header_ = nullptr;
+  const int64 *frequencies_ = nullptr;
+  const uint32 *offsets_ = nullptr;
+  const uint32 *displacements_ = nullptr;
+  const uint32 *slots_ = nullptr;
+  const char *pool_ = nullptr;
 
   TF_DISALLOW_COPY_AND_ASSIGN(TermFrequencyMap);
 };
@@ -100,6 +204,10 @@ class TagToCategoryMap {
   // Sets the category for the given tag.
   void SetCategory(const string &tag, const string &category);
 
+  // Sets the categories of all tags of another map, which must agree with the
+  // categories set in this one.
+  void Merge(const TagToCategoryMap &other);
+
   // Returns the category associated with the given tag.
   const string &GetCategory(const string &tag) const;
 
@@ -112,6 +220,43 @@ class TagToCategoryMap {
   TF_DISALLOW_COPY_AND_ASSIGN(TagToCategoryMap);
 };
 
+// The labels of the arcs seen between each pair of head and dependent tags,
+// collected from a training corpus to rule out the arcs of other labels. The
+// head tag of root tokens is kRootTag.
+class ArcLabelConstraints {
+ public:
+  // Labels by head tag and dependent tag.
+  typedef map<std::pair<string, string>, std::set<string>> LabelMap;
+
+  // Head tag of the arcs from the root.
+  static const char kRootTag[];
+
+  ArcLabelConstraints() {}
+  ~ArcLabelConstraints() {}
+
+  // Loads the constraints from a text file.
+  explicit ArcLabelConstraints(const string &filename);
+
+  // Adds an arc with the given label between tokens with the given tags.
+  void Add(const string &head_tag, const string &dependent_tag,
+           const string &label);
+
+  // Adds the arcs of another set of constraints.
+  void Merge(const ArcLabelConstraints &other);
+
+  // Returns the labels seen by pair of head and dependent tags.
+  const LabelMap &labels() const { return labels_; }
+
+  // Saves the constraints to the given file, with the head tag, dependent tag
+  // and label of an arc per line.
+  void Save(const string &filename) const;
+
+ private:
+  LabelMap labels_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ArcLabelConstraints);
+};
+
 }  // namespace syntaxnet
 
 #endif  // SYNTAXNET_TERM_FREQUENCY_MAP_H_
@@ -0,0 +1,186 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/term_frequency_map.h"
+
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/shared_segments.h"
+#include "syntaxnet/utils.h"
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+class TermFrequencyMapTest : public ::testing::Test {
+ protected:
+  // Fills the map with terms of frequency [1, num_terms], term i having
+  // frequency i.
+  void Fill(int num_terms, TermFrequencyMap *map) {
+    for (int i = 1; i <= num_terms; ++i) {
+      const string term = tensorflow::strings::StrCat("term", i);
+      for (int j = 0; j < i; ++j) map->Increment(term);
+    }
+  }
+
+  // Returns a path in the test temporary directory.
+  string TempPath(const string &name) const {
+    return utils::JoinPath({tensorflow::testing::TmpDir(), name});
+  }
+};
+
+TEST_F(TermFrequencyMapTest, MappedMapMatchesTextMap) {
+  TermFrequencyMap map;
+  Fill(1000, &map);
+  const string mapped_path = TempPath("mapped-map");
+  const string text_path = TempPath("text-map");
+  map.SaveMapped(mapped_path);
+  map.Save(text_path);
+  EXPECT_TRUE(tensorflow::Env::Default()->FileExists(
+      mapped_path + TermFrequencyMap::kMappedSuffix));
+  EXPECT_FALSE(tensorflow::Env::Default()->FileExists(
+      text_path + TermFrequencyMap::kMappedSuffix));
+
+  for (const int min_frequency : {0, 10}) {
+    for (const int max_num_terms : {0, 500}) {
+      TermFrequencyMap mapped(mapped_path, min_frequency, max_num_terms);
+      TermFrequencyMap text(text_path, min_frequency, max_num_terms);
+      ASSERT_EQ(text.Size(), mapped.Size());
+      for (int i = 0; i < text.Size(); ++i) {
+        EXPECT_EQ(text.GetTerm(i), mapped.GetTerm(i));
+        EXPECT_EQ(i, mapped.LookupIndex(text.GetTerm(i), -1));
+      }
+      for (int i = 1; i <= 1000; ++i) {
+        const string term = tensorflow::strings::StrCat("term", i);
+        EXPECT_EQ(text.LookupIndex(term, -1), mapped.LookupIndex(term, -1));
+      }
+      EXPECT_EQ(-1, mapped.LookupIndex("unknown", -1));
+      EXPECT_EQ(-1, mapped.LookupIndex("", -1));
+    }
+  }
+}
+
+TEST_F(TermFrequencyMapTest, SavingTextRemovesMappedFile) {
+  TermFrequencyMap map;
+  Fill(10, &map);
+  const string path = TempPath("resaved-map");
+  map.SaveMapped(path);
+  map.Increment("new-term");
+  map.Save(path);
+  EXPECT_FALSE(tensorflow::Env::Default()->FileExists(
+      path + TermFrequencyMap::kMappedSuffix));
+  TermFrequencyMap loaded(path, 0, 0);
+  EXPECT_EQ(11, loaded.Size());
+  EXPECT_NE(-1, loaded.LookupIndex("new-term", -1));
+}
+
+TEST_F(TermFrequencyMapTest, MergedMapsSaveLikeMapOverAllTerms) {
+  // Counts term<i % 7> for i in [0, 100), in whole and in three parts.
+  TermFrequencyMap whole;
+  TermFrequencyMap parts[3];
+  for (int i = 0; i < 100; ++i) {
+    const string term = tensorflow::strings::StrCat("term", i % 7);
+    whole.Increment(term);
+    parts[i * 3 / 100].Increment(term);
+  }
+  TermFrequencyMap merged;
+  for (const auto &part : parts) merged.Merge(part);
+  merged.Increment("term3", 5);
+  whole.Increment("term3", 5);
+  EXPECT_EQ(7, merged.Size());
+
+  string whole_text, merged_text;
+  whole.Save(TempPath("whole-map"));
+  merged.Save(TempPath("merged-map"));
+  TF_CHECK_OK(tensorflow::ReadFileToString(
+      tensorflow::Env::Default(), TempPath("whole-map"), &whole_text));
+  TF_CHECK_OK(tensorflow::ReadFileToString(
+      tensorflow::Env::Default(), TempPath("merged-map"), &merged_text));
+  EXPECT_EQ(whole_text, merged_text);
+}
+
+TEST_F(TermFrequencyMapTest, UpdatedMapsKeepTermIndices) {
+  TermFrequencyMap map;
+  Fill(5, &map);
+  const string path = TempPath("updated-map");
+  map.Save(path);
+  TermFrequencyMap loaded(path, 0, 0);
+
+  // Makes the least frequent term the most frequent one and adds new terms.
+  TermFrequencyMap updated;
+  updated.LoadForUpdate(path);
+  updated.Increment("term1", 100);
+  updated.Increment("new1");
+  updated.Increment("new2", 2);
+  updated.Save(path);
+
+  TermFrequencyMap reloaded(path, 0, 0);
+  ASSERT_EQ(7, reloaded.Size());
+  for (int i = 0; i < loaded.Size(); ++i) {
+    EXPECT_EQ(loaded.GetTerm(i), reloaded.GetTerm(i));
+  }
+  string text;
+  TF_CHECK_OK(
+      tensorflow::ReadFileToString(tensorflow::Env::Default(), path, &text));
+  EXPECT_THAT(text, ::testing::HasSubstr("\nterm1 101\n"));
+  EXPECT_EQ(5, reloaded.LookupIndex("new2", -1));
+  EXPECT_EQ(6, reloaded.LookupIndex("new1", -1));
+
+  // The cutoff keeps the loaded terms before the first infrequent one.
+  TermFrequencyMap frequent(path, 3, 0);
+  EXPECT_EQ(3, frequent.Size());
+}
+
+TEST_F(TermFrequencyMapTest, TextMapsAreMappedFromSharedSegments) {
+  TermFrequencyMap map;
+  Fill(100, &map);
+  const string path = TempPath("shared-map");
+  map.Save(path);
+  TermFrequencyMap text(path, 10, 0);
+
+  const string directory = TempPath("shared-map-segments");
+  TF_CHECK_OK(tensorflow::Env::Default()->CreateDir(directory));
+  setenv(SharedSegments::kDirectoryVariable, directory.c_str(), 1);
+  TermFrequencyMap shared(path, 10, 0);
+  TermFrequencyMap all_shared(path, 0, 0);
+  unsetenv(SharedSegments::kDirectoryVariable);
+
+  std::vector<string> segments;
+  TF_CHECK_OK(tensorflow::Env::Default()->GetChildren(directory, &segments));
+  EXPECT_EQ(1, segments.size());
+  EXPECT_EQ(100, all_shared.Size());
+  ASSERT_EQ(text.Size(), shared.Size());
+  for (int i = 0; i < text.Size(); ++i) {
+    EXPECT_EQ(text.GetTerm(i), shared.GetTerm(i));
+    EXPECT_EQ(i, shared.LookupIndex(text.GetTerm(i), -1));
+  }
+}
+
+TEST_F(TermFrequencyMapTest, EmptyMappedMap) {
+  TermFrequencyMap map;
+  const string path = TempPath("empty-map");
+  map.SaveMapped(path);
+  TermFrequencyMap loaded(path, 0, 0);
+  EXPECT_EQ(0, loaded.Size());
+  EXPECT_EQ(-1, loaded.LookupIndex("term", -1));
+}
+
+}  // namespace syntaxnet
@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <map>
 #include <memory>
 #include <string>
 #include <vector>
@@ -22,6 +24,7 @@ limitations under the License.
 #include "syntaxnet/segmenter_utils.h"
 #include "syntaxnet/utils.h"
 #include "tensorflow/core/lib/io/inputbuffer.h"
+#include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/regexp.h"
@@ -70,55 +73,66 @@ class CoNLLSyntaxFormat : public DocumentFormat {
   }
 
   // Reads up to the first empty line and returns false end of file is reached.
+  // The line buffer is kept across calls, so that reading a corpus does not
+  // allocate a line per token.
   bool ReadRecord(tensorflow::io::InputBuffer *buffer,
                   string *record) override {
-    string line;
     record->clear();
-    tensorflow::Status status = buffer->ReadLine(&line);
-    while (!line.empty() && status.ok()) {
-      tensorflow::strings::StrAppend(record, line, "\n");
-      status = buffer->ReadLine(&line);
+    tensorflow::Status status = buffer->ReadLine(&line_);
+    while (!line_.empty() && status.ok()) {
+      record->append(line_);
+      record->push_back('\n');
+      status = buffer->ReadLine(&line_);
     }
     return status.ok() || !record->empty();
   }
 
+  // Parses the tokens of a sentence. Lines and fields are split as string
+  // pieces into the record, and only copied into the token protos.
   void ConvertFromString(const string &key, const string &value,
                          vector<Sentence *> *sentences) override {
     // Create new sentence.
-    Sentence *sentence = new Sentence();
+    Sentence *sentence = NewDocument();
 
     // Each line corresponds to one token.
     string text;
-    vector<string> lines = utils::Split(value, '\n');
 
     // Extension: we collect comments
     string comments;
 
     // Add each token to the sentence.
-    vector<string> fields;
+    vector<tensorflow::StringPiece> &fields = fields_;
     int expected_id = 1;
-    for (size_t i = 0; i < lines.size(); ++i) {
-      // Split line into tab-separated fields.
-      fields.clear();
-      fields = utils::Split(lines[i], '\t');
-      if (fields.empty()) continue;
+    tensorflow::StringPiece lines(value);
+    while (!lines.empty()) {
+      // Split off the next line.
+      const size_t end_of_line = lines.find('\n');
+      const tensorflow::StringPiece line = lines.substr(0, end_of_line);
+      lines.remove_prefix(end_of_line == tensorflow::StringPiece::npos
+                              ? lines.size()
+                              : end_of_line + 1);
+      if (line.empty()) continue;
 
       // Skip comment lines.
       // Extension: append comment
-      if (fields[0][0] == '#') {
-        comments.append(fields[0]);
+      if (line[0] == '#') {
+        const tensorflow::StringPiece comment = line.substr(0, line.find('\t'));
+        comments.append(comment.data(), comment.size());
         comments.append("\n");
         continue;
       }
 
+      // Split line into tab-separated fields.
+      SplitFields(line, &fields);
+
       // Skip CoNLLU lines for multiword tokens which are indicated by
       // hyphenated line numbers, e.g., "2-4".
       // http://universaldependencies.github.io/docs/format.html
-      if (RE2::FullMatch(fields[0], "[0-9]+-[0-9]+")) continue;
+      if (IsRange(fields[0])) continue;
 
       // Clear all optional fields equal to '_'.
       for (size_t j = 2; j < fields.size(); ++j) {
-        if (fields[j].length() == 1 && fields[j][0] == '_') fields[j].clear();
+        if (fields[j].size() == 1 && fields[j][0] == '_') fields[j].clear();
       }
 
       // Check that the line is valid.
@@ -126,34 +140,34 @@ class CoNLLSyntaxFormat : public DocumentFormat {
           << "Every line has to have at least 8 tab separated fields.";
 
       // Check that the ids follow the expected format.
-      const int id = utils::ParseUsing<int>(fields[0], 0, utils::ParseInt32);
+      const int id = ParseInt(fields[0]);
       CHECK_EQ(expected_id++, id)
           << "Token ids start at 1 for each new sentence and increase by 1 "
           << "on each new token. Sentences are separated by an empty line.";
 
       // Get relevant fields.
-      const string &word = fields[1];
-      const string &cpostag = fields[3];
-      const string &tag = fields[4];
-      const string &attributes = fields[5];
-      const int head = utils::ParseUsing<int>(fields[6], 0, utils::ParseInt32);
-      const string &label = fields[7];
+      const tensorflow::StringPiece word = fields[1];
+      const tensorflow::StringPiece cpostag = fields[3];
+      const tensorflow::StringPiece tag = fields[4];
+      const tensorflow::StringPiece attributes = fields[5];
+      const int head = ParseInt(fields[6]);
+      const tensorflow::StringPiece label = fields[7];
 
       // Add token to sentence text.
       if (!text.empty()) text.append(" ");
       const int start = text.size();
       const int end = start + word.size() - 1;
-      text.append(word);
+      text.append(word.data(), word.size());
 
       // Add token to sentence.
       Token *token = sentence->add_token();
-      token->set_word(word);
+      token->set_word(word.data(), word.size());
       token->set_start(start);
       token->set_end(end);
       if (head > 0) token->set_head(head - 1);
-      if (!tag.empty()) token->set_tag(tag);
-      if (!cpostag.empty()) token->set_category(cpostag);
-      if (!label.empty()) token->set_label(label);
+      if (!tag.empty()) token->set_tag(tag.data(), tag.size());
+      if (!cpostag.empty()) token->set_category(cpostag.data(), cpostag.size());
+      if (!label.empty()) token->set_label(label.data(), label.size());
       if (!attributes.empty()) AddMorphAttributes(attributes, token);
       if (join_category_to_pos_) JoinCategoryToPos(token);
       if (add_pos_as_attribute_) AddPosAsAttribute(token);
@@ -199,7 +213,7 @@ class CoNLLSyntaxFormat : public DocumentFormat {
     } else {
       // If the sentence was empty (e.g., blank lines at the beginning of a
       // file), then don't save it.
-      delete sentence;
+      DeleteDocument(sentence);
     }
   }
 
@@ -213,43 +227,95 @@ class CoNLLSyntaxFormat : public DocumentFormat {
       *value = tensorflow::strings::StrCat(sentence.GetExtension(note), "\n");
     } else {
 
-    vector<string> lines;
+    // Appends the fields straight to the value. Tokens are only copied when
+    // they need rewriting.
+    value->clear();
+    Token rewritten;
     for (int i = 0; i < sentence.token_size(); ++i) {
-      Token token = sentence.token(i);
-      if (join_category_to_pos_) SplitCategoryFromPos(&token);
-      if (add_pos_as_attribute_) RemovePosFromAttributes(&token);
-      vector<string> fields(10);
-      fields[0] = tensorflow::strings::Printf("%d", i + 1);
-      fields[1] = UnderscoreIfEmpty(token.word());
-      fields[2] = "_";
-      fields[3] = UnderscoreIfEmpty(token.category());
-      fields[4] = UnderscoreIfEmpty(token.tag());
-      fields[5] = GetMorphAttributes(token);
-      fields[6] = tensorflow::strings::Printf("%d", token.head() + 1);
-      fields[7] = UnderscoreIfEmpty(token.label());
-      fields[8] = "_";
-      fields[9] = "_";
-      lines.push_back(utils::Join(fields, "\t"));
+      const Token *token = &sentence.token(i);
+      if (join_category_to_pos_ || add_pos_as_attribute_) {
+        rewritten = *token;
+        if (join_category_to_pos_) SplitCategoryFromPos(&rewritten);
+        if (add_pos_as_attribute_) RemovePosFromAttributes(&rewritten);
+        token = &rewritten;
+      }
+      AppendInt(i + 1, value);
+      AppendField(token->word(), value);
+      value->append("\t_");
+      AppendField(token->category(), value);
+      AppendField(token->tag(), value);
+      value->push_back('\t');
+      AppendMorphAttributes(*token, value);
+      value->push_back('\t');
+      AppendInt(token->head() + 1, value);
+      AppendField(token->label(), value);
+      value->append("\t_\t_\n");
     }
-    *value = tensorflow::strings::StrCat(utils::Join(lines, "\n"), "\n\n");
+    value->append(sentence.token_size() == 0 ? "\n\n" : "\n");
 
     }//Extension
   }
 
  private:
-  // Replaces empty fields with an undescore.
-  string UnderscoreIfEmpty(const string &field) {
-    return field.empty() ? "_" : field;
+  // Appends a tab and the field, or an underscore if the field is empty.
+  static void AppendField(const string &field, string *output) {
+    output->push_back('\t');
+    if (field.empty()) {
+      output->push_back('_');
+    } else {
+      output->append(field);
+    }
+  }
+
+  // Appends an integer in decimal.
+  static void AppendInt(int32 value, string *output) {
+    char buffer[tensorflow::strings::kFastToBufferSize];
+    output->append(buffer,
+                   tensorflow::strings::FastInt32ToBufferLeft(value, buffer));
+  }
+
+  // Splits a line into tab-separated fields. The fields point into the line.
+  static void SplitFields(tensorflow::StringPiece line,
+                          vector<tensorflow::StringPiece> *fields) {
+    fields->clear();
+    while (true) {
+      const size_t tab = line.find('\t');
+      if (tab == tensorflow::StringPiece::npos) break;
+      fields->push_back(line.substr(0, tab));
+      line.remove_prefix(tab + 1);
+    }
+    fields->push_back(line);
+  }
+
+  static bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+  // Returns true if the field is a range of token ids, e.g., "2-4".
+  static bool IsRange(tensorflow::StringPiece field) {
+    size_t i = 0;
+    while (i < field.size() && IsDigit(field[i])) ++i;
+    if (i == 0 || i == field.size() || field[i] != '-') return false;
+    const size_t dash = i++;
+    while (i < field.size() && IsDigit(field[i])) ++i;
+    return i > dash + 1 && i == field.size();
+  }
+
+  // Parses an integer field, which is 0 if empty.
+  static int ParseInt(tensorflow::StringPiece field) {
+    if (field.empty()) return 0;
+    int32 value;
+    CHECK(tensorflow::strings::safe_strto32(field, &value))
+        << "Failed to convert: " << field;
+    return value;
   }
 
   // Creates a TokenMorphology object out of a list of attribute values of the
   // form: a1=v1|a2=v2|... or v1|v2|...
-  void AddMorphAttributes(const string &attributes, Token *token) {
+  void AddMorphAttributes(tensorflow::StringPiece attributes, Token *token) {
     TokenMorphology *morph =
         token->MutableExtension(TokenMorphology::morphology);
-    vector<string> att_vals = utils::Split(attributes, '|');
-    for (int i = 0; i < att_vals.size(); ++i) {
-      vector<string> att_val = utils::SplitOne(att_vals[i], '=');
+    for (const string &att_val_string : utils::Split(attributes.ToString(),
+                                                     '|')) {
+      vector<string> att_val = utils::SplitOne(att_val_string, '=');
 
       // Format is either:
       //   1) a1=v1|a2=v2..., e.g., Czech CoNLL data, or,
@@ -275,19 +341,24 @@ class CoNLLSyntaxFormat : public DocumentFormat {
 
   // Creates a list of attribute values of the form a1=v1|a2=v2|... or v1|v2|...
   // from a TokenMorphology object.
-  string GetMorphAttributes(const Token &token) {
+  // Appends the morphological attributes of the token, or an underscore if it
+  // has none.
+  static void AppendMorphAttributes(const Token &token, string *output) {
     const TokenMorphology &morph =
         token.GetExtension(TokenMorphology::morphology);
-    if (morph.attribute_size() == 0) return "_";
-    string attributes;
-    for (const TokenMorphology::Attribute &attribute : morph.attribute()) {
-      if (!attributes.empty()) tensorflow::strings::StrAppend(&attributes, "|");
-      tensorflow::strings::StrAppend(&attributes, attribute.name());
+    if (morph.attribute_size() == 0) {
+      output->push_back('_');
+      return;
+    }
+    for (int i = 0; i < morph.attribute_size(); ++i) {
+      const TokenMorphology::Attribute &attribute = morph.attribute(i);
+      if (i > 0) output->push_back('|');
+      output->append(attribute.name());
       if (attribute.value() != "on") {
-        tensorflow::strings::StrAppend(&attributes, "=", attribute.value());
+        output->push_back('=');
+        output->append(attribute.value());
       }
     }
-    return attributes;
   }
 
   void JoinCategoryToPos(Token *token) {
@@ -328,6 +399,10 @@ class CoNLLSyntaxFormat : public DocumentFormat {
   bool join_category_to_pos_ = false;
   bool add_pos_as_attribute_ = false;
 
+  // Buffers reused across records.
+  string line_;
+  vector<tensorflow::StringPiece> fields_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(CoNLLSyntaxFormat);
 };
 
@@ -348,7 +423,7 @@ class TokenizedTextFormat : public DocumentFormat {
 
   void ConvertFromString(const string &key, const string &value,
                          vector<Sentence *> *sentences) override {
-    Sentence *sentence = new Sentence();
+    Sentence *sentence = NewDocument();
     string text;
     for (const string &word : utils::Split(value, ' ')) {
       if (word.empty()) continue;
@@ -383,7 +458,7 @@ class TokenizedTextFormat : public DocumentFormat {
     } else {
       // If the sentence was empty (e.g., blank lines at the beginning of a
       // file), then don't save it.
-      delete sentence;
+      DeleteDocument(sentence);
     }
   }
 
@@ -412,71 +487,217 @@ class TokenizedTextFormat : public DocumentFormat {
 
 REGISTER_DOCUMENT_FORMAT("tokenized-text", TokenizedTextFormat);
 
-// Reader for un-tokenized text. This reader expects every sentence to be on a
-// single line. For each line in the input, a sentence proto will be created,
-// where tokens are utf8 characters of that line.
-//
+// Text reader that splits each line into sentences and each sentence into
+// characters. Sentences end after a run of sentence-final punctuation and any
+// closing quotes or brackets. A full-width terminator ends a sentence by
+// itself, while an ASCII one has to be followed by whitespace or the end of
+// the line, so that e.g. decimal points do not split. Sentences longer than
+// untokenized_max_tokens characters are cut into chunks of at most that many,
+// after their last whitespace where there is one; 0 turns the limit off. The
+// trailing whitespace of a sentence is kept in it, so that the texts of the
+// sentences of a line add up to the line.
 class UntokenizedTextFormat : public TokenizedTextFormat {
  public:
   UntokenizedTextFormat() {}
 
+  void Setup(TaskContext *context) override {
+    max_tokens_ = std::max(context->Get("untokenized_max_tokens", 100), 0);
+  }
+
   void ConvertFromString(const string &key, const string &value,
                          vector<Sentence *> *sentences) override {
-    Sentence *sentence = new Sentence();
     vector<tensorflow::StringPiece> chars;
     SegmenterUtils::GetUTF8Chars(value, &chars);
-    int start = 0;
-    for (auto utf8char : chars) {
-      Token *token = sentence->add_token();
-      token->set_word(utf8char.ToString());
-      token->set_start(start);
-      start += utf8char.size();
-      token->set_end(start - 1);
+    const int num_chars = chars.size();
+    int begin = 0;
+    int i = 0;
+    while (i < num_chars) {
+      if (!IsTerminal(chars[i])) {
+        ++i;
+        continue;
+      }
+      const bool full_width = chars[i].size() > 1;
+      while (i < num_chars && IsTerminal(chars[i])) ++i;
+      while (i < num_chars && IsClosing(chars[i])) ++i;
+      if (!full_width && i < num_chars && !IsBreak(chars[i])) continue;
+      while (i < num_chars && IsBreak(chars[i])) ++i;
+      AddSentences(key, value, chars, begin, i, sentences);
+      begin = i;
     }
+    AddSentences(key, value, chars, begin, num_chars, sentences);
+  }
 
-    if (sentence->token_size() > 100) {
-      // If token_size() is larger than 100, we skip this sentence by
-      // replacing the tokens with a dummy
-      sentence->clear_token();
+ private:
+  // Returns true if a character is sentence-final punctuation.
+  static bool IsTerminal(tensorflow::StringPiece c) {
+    if (c.size() == 1) return c[0] == '.' || c[0] == '!' || c[0] == '?';
+    return c == "。" || c == "！" || c == "？" || c == "｡";
+  }
+
+  // Returns true if a character closes a quote or a bracket.
+  static bool IsClosing(tensorflow::StringPiece c) {
+    if (c.size() == 1) {
+      return c[0] == '"' || c[0] == '\'' || c[0] == ')' || c[0] == ']' ||
+             c[0] == '}';
+    }
+    return c == "”" || c == "’" || c == "」" || c == "』" || c == "）" ||
+           c == "》" || c == "】";
+  }
+
+  // Returns true if a character is whitespace, checking ASCII without
+  // decoding it.
+  static bool IsBreak(tensorflow::StringPiece c) {
+    if (c.size() == 1) {
+      return c[0] == ' ' || c[0] == '\t' || c[0] == '\n' || c[0] == '\r';
+    }
+    return SegmenterUtils::IsBreakChar(c.ToString());
+  }
+
+  // Adds the characters [begin, end) of a line as sentences of at most
+  // max_tokens_ characters.
+  void AddSentences(const string &key, const string &value,
+                    const vector<tensorflow::StringPiece> &chars, int begin,
+                    int end, vector<Sentence *> *sentences) {
+    while (begin < end) {
+      int chunk_end = end;
+      if (max_tokens_ > 0 && end - begin > max_tokens_) {
+        chunk_end = begin + max_tokens_;
+        while (chunk_end > begin && !IsBreak(chars[chunk_end - 1])) {
+          --chunk_end;
+        }
+        if (chunk_end == begin) chunk_end = begin + max_tokens_;
+      }
+      AddSentence(key, value, chars, begin, chunk_end, sentences);
+      begin = chunk_end;
+    }
+  }
+
+  // Adds the characters [begin, end) of a line as one sentence, with token
+  // offsets into its own text.
+  void AddSentence(const string &key, const string &value,
+                   const vector<tensorflow::StringPiece> &chars, int begin,
+                   int end, vector<Sentence *> *sentences) {
+    const int offset = chars[begin].data() - value.data();
+    const int size = chars[end - 1].data() + chars[end - 1].size() -
+                     chars[begin].data();
+    Sentence *sentence = NewDocument();
+    sentence->set_docid(key);
+    sentence->set_text(value.substr(offset, size));
+    for (int i = begin; i < end; ++i) {
+      const int start = chars[i].data() - value.data() - offset;
       Token *token = sentence->add_token();
-      token->set_word("#DUMMY#");
-      token->set_start(0);
-      token->set_end(6);
-      sentence->set_docid(key);
-      sentence->set_text("#DUMMY#");
-      sentence->SetExtension(note,
-          tensorflow::strings::StrCat(
-          "#skip because token_size() > 100\n#", value, "\n"));
-      sentences->push_back(sentence);
-    } else if (sentence->token_size() > 0) {
-      sentence->set_docid(key);
-      sentence->set_text(value);
-      sentences->push_back(sentence);
-    } else {
-      // If the sentence was empty (e.g., blank lines at the beginning of a
-      // file), then don't save it.
-      delete sentence;
+      token->set_word(chars[i].data(), chars[i].size());
+      token->set_start(start);
+      token->set_end(start + chars[i].size() - 1);
     }
+    sentences->push_back(sentence);
   }
 
- private:
+  // Maximum number of characters of a sentence, or 0 for no limit.
+  int max_tokens_ = 100;
+
   TF_DISALLOW_COPY_AND_ASSIGN(UntokenizedTextFormat);
 };
 
 REGISTER_DOCUMENT_FORMAT("untokenized-text", UntokenizedTextFormat);
 
+// Replaces all occurrences of a set of literal strings in a single scan of
+// the text, with a trie of the strings built once. When several strings match
+// at a position, the longest one is replaced, and a string listed twice keeps
+// its first replacement.
+class LiteralRewriter {
+ public:
+  explicit LiteralRewriter(const vector<pair<string, string>> &rules) {
+    nodes_.emplace_back();
+    for (const pair<string, string> &rule : rules) {
+      int node = 0;
+      for (const char c : rule.first) {
+        auto it = nodes_[node].children.find(c);
+        if (it == nodes_[node].children.end()) {
+          it = nodes_[node].children.emplace(c, nodes_.size()).first;
+          nodes_.emplace_back();
+        }
+        node = it->second;
+      }
+      if (nodes_[node].replacement < 0) {
+        nodes_[node].replacement = replacements_.size();
+        replacements_.push_back(rule.second);
+      }
+    }
+  }
+
+  // Writes the rewritten text to output.
+  void Rewrite(const string &text, string *output) const {
+    output->clear();
+    output->reserve(text.size());
+    size_t i = 0;
+    while (i < text.size()) {
+      int node = 0;
+      int replacement = -1;
+      size_t match_end = i;
+      for (size_t j = i; j < text.size(); ++j) {
+        const auto it = nodes_[node].children.find(text[j]);
+        if (it == nodes_[node].children.end()) break;
+        node = it->second;
+        if (nodes_[node].replacement >= 0) {
+          replacement = nodes_[node].replacement;
+          match_end = j + 1;
+        }
+      }
+      if (replacement < 0) {
+        output->push_back(text[i++]);
+      } else {
+        output->append(replacements_[replacement]);
+        i = match_end;
+      }
+    }
+  }
+
+ private:
+  struct Node {
+    std::map<char, int> children;
+    int replacement = -1;
+  };
+
+  // Trie of the strings, rooted at the first node, and their replacements.
+  vector<Node> nodes_;
+  vector<string> replacements_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(LiteralRewriter);
+};
+
 // Text reader that attmpts to perform Penn Treebank tokenization on arbitrary
 // raw text. Adapted from https://www.cis.upenn.edu/~treebank/tokenizer.sed
 // by Robert MacIntyre, University of Pennsylvania, late 1995.
 // Expected input: raw text with one sentence per line.
 //
+// The character normalization rules are literal, and are all applied in one
+// pass. The tokenization rules are applied in turn, since they look at context
+// that earlier ones rewrite, but are compiled only once.
 class EnglishTextFormat : public TokenizedTextFormat {
  public:
-  EnglishTextFormat() {}
+  EnglishTextFormat() : preproc_(PreprocRules()) {
+    for (const pair<string, string> &rule : TokenizationRules()) {
+      rules_.emplace_back(std::unique_ptr<RE2>(new RE2(rule.first)),
+                          rule.second);
+    }
+  }
 
   void ConvertFromString(const string &key, const string &value,
                          vector<Sentence *> *sentences) override {
-    vector<pair<string, string>> preproc_rules = {
+    string rewritten;
+    preproc_.Rewrite(value, &rewritten);
+    for (const auto &rule : rules_) {
+      RE2::GlobalReplace(&rewritten, *rule.first, rule.second);
+    }
+    TokenizedTextFormat::ConvertFromString(key, rewritten, sentences);
+  }
+
+ private:
+  // Literal character normalizations. No replacement creates an occurrence of
+  // a string listed after it, so one pass rewrites as applying them in turn.
+  static vector<pair<string, string>> PreprocRules() {
+    return {
         // Punctuation.
         {"’", "'"},
         {"…", "..."},
@@ -492,7 +713,7 @@ class EnglishTextFormat : public TokenizedTextFormat {
         {"＆", "&"},
 
         // Brackets.
-        {"\\[", "("},
+        {"[", "("},
         {"]", ")"},
         {"{", "("},
         {"}", ")"},
@@ -529,9 +750,13 @@ class EnglishTextFormat : public TokenizedTextFormat {
         {"★", ""},
         {"＊", ""},
         {"♦", ""},
+
     };
+  }
 
-    vector<pair<string, string>> rules = {
+  // Tokenization rules, as regular expressions and their rewrites.
+  static vector<pair<string, string>> TokenizationRules() {
+    return {
         // attempt to get correct directional quotes
         {R"re(^")re", "`` "},
         {R"re(([ \([{<])")re", "\\1 `` "},
@@ -597,19 +822,13 @@ class EnglishTextFormat : public TokenizedTextFormat {
         // clean out extra spaces
         {"  *", " "},
         {"^ *", ""},
-    };
 
-    string rewritten = value;
-    for (const pair<string, string> &rule : preproc_rules) {
-      RE2::GlobalReplace(&rewritten, rule.first, rule.second);
-    }
-    for (const pair<string, string> &rule : rules) {
-      RE2::GlobalReplace(&rewritten, rule.first, rule.second);
-    }
-    TokenizedTextFormat::ConvertFromString(key, rewritten, sentences);
+    };
   }
 
- private:
+  LiteralRewriter preproc_;
+  vector<pair<std::unique_ptr<RE2>, string>> rules_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(EnglishTextFormat);
 };
 
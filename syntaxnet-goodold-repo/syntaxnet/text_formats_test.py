@@ -24,6 +24,7 @@ import tensorflow as tf
 
 import syntaxnet.load_parser_ops
 
+from google.protobuf import text_format
 from tensorflow.python.framework import test_util
 from tensorflow.python.platform import googletest
 from tensorflow.python.platform import tf_logging as logging
@@ -51,9 +52,13 @@ class TextFormatsTest(test_util.TensorFlowTestCase):
     inp.record_format.append(record_format)
     inp.part.add().file_pattern = file_pattern
 
-  def WriteContext(self, corpus_format):
+  def WriteContext(self, corpus_format, parameters=()):
     context = task_spec_pb2.TaskSpec()
     self.AddInput('documents', self.corpus_file, corpus_format, context)
+    for name, value in parameters:
+      param = context.parameter.add()
+      param.name = name
+      param.value = value
     for name in ('word-map', 'lcword-map', 'tag-map',
                  'category-map', 'label-map', 'prefix-table',
                  'suffix-table', 'tag-to-category'):
@@ -106,6 +111,35 @@ class TextFormatsTest(test_util.TensorFlowTestCase):
     self.CheckUntokenizedDoc('Hello ', ['H', 'e', 'l', 'l', 'o', ' '],
                              [0, 1, 2, 3, 4, 5], [0, 1, 2, 3, 4, 5])
 
+  def ReadUntokenizedTexts(self, text, max_tokens):
+    self.WriteContext('untokenized-text',
+                      [('untokenized_max_tokens', str(max_tokens))])
+    with open(self.corpus_file, 'w') as f:
+      f.write(text)
+    sentence, _ = gen_parser_ops.document_source(
+        self.context_file, batch_size=1)
+    texts = []
+    with self.test_session() as sess:
+      while True:
+        sentence_doc = self.ReadNextDocument(sess, sentence)
+        if sentence_doc is None:
+          return texts
+        self.assertEqual(sentence_doc.token[0].start, 0)
+        self.assertEqual(sentence_doc.token[-1].end,
+                         len(sentence_doc.text.encode('utf-8')) - 1)
+        texts.append(sentence_doc.text.encode('utf-8'))
+
+  def testUntokenizedSentenceSplitting(self):
+    self.assertEqual(
+        self.ReadUntokenizedTexts('Hi there. "Is pi 3.14?" Yes!\n', 0),
+        ['Hi there. ', '"Is pi 3.14?" ', 'Yes!'])
+    self.assertEqual(self.ReadUntokenizedTexts('一个测试。另一个！', 0),
+                     ['一个测试。', '另一个！'])
+    self.assertEqual(self.ReadUntokenizedTexts('ab cd efgh', 4),
+                     ['ab ', 'cd ', 'efgh'])
+    self.assertEqual(self.ReadUntokenizedTexts('abcdefghij', 4),
+                     ['abcd', 'efgh', 'ij'])
+
   def testSimple(self):
     self.CheckTokenization('Hello, world!', 'Hello , world !')
     self.CheckTokenization('"Hello"', "`` Hello ''")
@@ -122,10 +156,129 @@ class TextFormatsTest(test_util.TensorFlowTestCase):
     self.CheckTokenization('Gotta go', 'Got ta go')
     self.CheckTokenization('50-year-old', '50-year-old')
 
+  def testNormalizedPunctuation(self):
+    self.CheckTokenization('“Hello” — world…', "`` Hello '' -- world ...")
+    self.CheckTokenization('（Hi|there）', '-LRB- Hithere -RRB-')
+    self.CheckTokenization('Yes---no', 'Yes -- no')
+
   def testUrl(self):
     self.CheckTokenization('http://www.google.com/news is down',
                            'http : //www.google.com/news is down')
 
+  def testConllSentence(self):
+    self.WriteContext('conll-sentence')
+    with open(self.corpus_file, 'w') as f:
+      f.write('# sent_id = 1\n'
+              '1\tI\t_\tPRON\tPRP\tCase=Nom|Number=Sing\t2\tnsubj\t_\t_\n'
+              '2-3\tdon\'t\t_\t_\t_\t_\t_\t_\t_\t_\n'
+              '2\tdo\t_\tVERB\tVBP\t_\t0\tROOT\t_\t_\n'
+              '3\tn\'t\t_\tPART\tRB\tNeg\t2\tneg\t_\t_\n'
+              '\n'
+              '1\tHi\t_\t_\tUH\t_\t0\t_\t_\t_\n'
+              '\n')
+    sentence, _ = gen_parser_ops.document_source(
+        self.context_file, batch_size=1)
+    with self.test_session() as sess:
+      first = self.ReadNextDocument(sess, sentence)
+      self.assertEqual(first.text, "I do n't")
+      self.assertEqual([t.word for t in first.token], ['I', 'do', "n't"])
+      self.assertEqual([t.tag for t in first.token], ['PRP', 'VBP', 'RB'])
+      self.assertEqual([t.category for t in first.token],
+                       ['PRON', 'VERB', 'PART'])
+      self.assertEqual([t.label for t in first.token],
+                       ['nsubj', 'ROOT', 'neg'])
+      self.assertEqual([t.head for t in first.token], [1, -1, 1])
+      self.assertEqual([t.start for t in first.token], [0, 2, 5])
+      self.assertEqual([t.end for t in first.token], [0, 3, 7])
+      morph = first.token[0].Extensions[sentence_pb2.TokenMorphology.morphology]
+      self.assertEqual([(a.name, a.value) for a in morph.attribute],
+                       [('Case', 'Nom'), ('Number', 'Sing')])
+      morph = first.token[2].Extensions[sentence_pb2.TokenMorphology.morphology]
+      self.assertEqual([(a.name, a.value) for a in morph.attribute],
+                       [('Neg', 'on')])
+
+      second = self.ReadNextDocument(sess, sentence)
+      self.assertEqual([t.word for t in second.token], ['Hi'])
+      self.assertFalse(second.token[0].HasField('category'))
+      self.assertFalse(second.token[0].HasField('label'))
+
+  def testConllSentenceWriter(self):
+    self.WriteContext('conll-sentence')
+    output_file = os.path.join(FLAGS.test_tmpdir, 'written.conll')
+    context = task_spec_pb2.TaskSpec()
+    with open(self.context_file) as f:
+      text_format.Merge(f.read(), context)
+    self.AddInput('written', output_file, 'conll-sentence', context)
+    with open(self.context_file, 'w') as f:
+      f.write(str(context))
+    written = ('1\tI\t_\tPRON\tPRP\tCase=Nom|Number=Sing\t2\tnsubj\t_\t_\n'
+               '2\tdo\t_\tVERB\tVBP\t_\t0\tROOT\t_\t_\n'
+               '3\tn\'t\t_\tPART\tRB\tNeg\t2\tneg\t_\t_\n'
+               '\n'
+               '1\tHi\t_\t_\tUH\t_\t0\t_\t_\t_\n'
+               '\n')
+    with open(self.corpus_file, 'w') as f:
+      f.write(written)
+
+    # Closing the session deletes the sink, which closes the file.
+    graph = tf.Graph()
+    with graph.as_default():
+      documents, last = gen_parser_ops.document_source(
+          self.context_file, batch_size=10)
+      sink = gen_parser_ops.document_sink(
+          documents, task_context=self.context_file, corpus_name='written')
+    sess = tf.Session(graph=graph)
+    sess.run([sink, last])
+    sess.close()
+    del sess
+    with open(output_file) as f:
+      self.assertEqual(f.read(), written)
+
+  def ReadAllWords(self):
+    sentence, _ = gen_parser_ops.document_source(
+        self.context_file, batch_size=1)
+    words = []
+    with self.test_session() as sess:
+      while True:
+        sentence_doc = self.ReadNextDocument(sess, sentence)
+        if sentence_doc is None:
+          return words
+        words.append(sentence_doc.token[0].word)
+
+  def testShardedConllCorpus(self):
+    # Writes three shards of four sentences each, read through a file pattern
+    # and a second part.
+    expected = []
+    for shard in range(3):
+      with open('%s-%d' % (self.corpus_file, shard), 'w') as f:
+        for i in range(4):
+          word = 'w%d%d' % (shard, i)
+          f.write('1\t%s\t_\t_\tNN\t_\t0\tROOT\t_\t_\n\n' % word)
+          expected.append(word)
+    for threads, deterministic, readahead in ((0, 'true', 'false'),
+                                              (0, 'true', 'true'),
+                                              (2, 'true', 'true'),
+                                              (2, 'false', 'false')):
+      context = task_spec_pb2.TaskSpec()
+      self.AddInput('documents', self.corpus_file + '-[01]', 'conll-sentence',
+                    context)
+      context.input[0].part.add().file_pattern = self.corpus_file + '-2'
+      for name, value in (('text_reader_threads', str(threads)),
+                          ('text_reader_buffer_size', '1'),
+                          ('text_reader_deterministic', deterministic),
+                          ('text_reader_block_size', '16'),
+                          ('text_reader_readahead', readahead)):
+        param = context.parameter.add()
+        param.name = name
+        param.value = value
+      with open(self.context_file, 'w') as f:
+        f.write(str(context))
+      words = self.ReadAllWords()
+      if deterministic == 'true':
+        self.assertEqual(words, expected)
+      else:
+        self.assertItemsEqual(words, expected)
+
 
 if __name__ == '__main__':
   googletest.main()
@@ -0,0 +1,55 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/top_allowed_actions.h"
+
+#include <cmath>
+
+#include "syntaxnet/cpu_kernels.h"
+
+namespace syntaxnet {
+
+int TopAllowedActions(const float *scores, const uint8 *allowed,
+                      int num_actions, int k, bool log_normalize,
+                      int *actions, float *top_scores) {
+  // Keeps the best actions so far sorted in actions[0, count), inserting a
+  // new one after those with equal scores, so that ties keep the lowest
+  // action. k is a beam size at most, so insertion beats a heap.
+  int count = 0;
+  float max_score = -INFINITY;
+  for (int action = 0; action < num_actions; ++action) {
+    const float score = scores[action];
+    if (score > max_score) max_score = score;
+    if (!allowed[action]) continue;
+    if (count == k && !(score > top_scores[k - 1])) continue;
+    int position = count < k ? count++ : k - 1;
+    for (; position > 0 && score > top_scores[position - 1]; --position) {
+      actions[position] = actions[position - 1];
+      top_scores[position] = top_scores[position - 1];
+    }
+    actions[position] = action;
+    top_scores[position] = score;
+  }
+
+  if (log_normalize && count > 0) {
+    const float sum =
+        GetCpuKernels().sum_shifted_exp(scores, num_actions, max_score);
+    const float log_normalizer = max_score + std::log(sum);
+    for (int i = 0; i < count; ++i) top_scores[i] -= log_normalizer;
+  }
+  return count;
+}
+
+}  // namespace syntaxnet
@@ -0,0 +1,43 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Selection of the best allowed parser actions from the scores of a network.
+
+#ifndef SYNTAXNET_TOP_ALLOWED_ACTIONS_H_
+#define SYNTAXNET_TOP_ALLOWED_ACTIONS_H_
+
+#include "syntaxnet/utils.h"
+
+namespace syntaxnet {
+
+// Finds the k allowed actions with the highest of the num_actions scores,
+// where allowed[action] is nonzero for the allowed actions, as filled in by
+// ParserTransitionSystem::GetAllowedActions(). Writes them to actions, best
+// first with ties going to the lowest action, and their scores to
+// top_scores, and returns their number, which is less than k if fewer actions
+// are allowed.
+//
+// With log_normalize, the scores written are those of a log-softmax over all
+// num_actions, i.e. the log-probabilities of the actions under the network.
+// They are computed from the maximum found while selecting and one more pass
+// for the normalizer, without materializing the softmax. Without it, the
+// scores are copied as they are, which is all a greedy or beam decoder needs.
+int TopAllowedActions(const float *scores, const uint8 *allowed,
+                      int num_actions, int k, bool log_normalize,
+                      int *actions, float *top_scores);
+
+}  // namespace syntaxnet
+
+#endif  // SYNTAXNET_TOP_ALLOWED_ACTIONS_H_
@@ -0,0 +1,94 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Masked top-k selection of parser actions for inference graphs.
+
+#include <cmath>
+
+#include "syntaxnet/top_allowed_actions.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+
+using tensorflow::DEVICE_CPU;
+using tensorflow::OpKernel;
+using tensorflow::OpKernelConstruction;
+using tensorflow::OpKernelContext;
+using tensorflow::Tensor;
+using tensorflow::TensorShape;
+using tensorflow::TensorShapeUtils;
+using tensorflow::errors::InvalidArgument;
+
+namespace syntaxnet {
+
+class TopAllowedActionsOp : public OpKernel {
+ public:
+  explicit TopAllowedActionsOp(OpKernelConstruction *context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("k", &k_));
+    OP_REQUIRES_OK(context, context->GetAttr("log_normalize", &log_normalize_));
+  }
+
+  void Compute(OpKernelContext *context) override {
+    const Tensor &logits = context->input(0);
+    const Tensor &allowed = context->input(1);
+    OP_REQUIRES(context, TensorShapeUtils::IsMatrix(logits.shape()),
+                InvalidArgument("logits must be a matrix"));
+    OP_REQUIRES(context, allowed.shape() == logits.shape(),
+                InvalidArgument("allowed must have the shape of logits"));
+    const int batch_size = logits.dim_size(0);
+    const int num_actions = logits.dim_size(1);
+
+    Tensor *actions;
+    Tensor *scores;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({batch_size, k_}), &actions));
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                1, TensorShape({batch_size, k_}), &scores));
+    const float *logits_data = logits.matrix<float>().data();
+    const bool *allowed_data = allowed.matrix<bool>().data();
+    int32 *actions_data = actions->matrix<int32>().data();
+    float *scores_data = scores->matrix<float>().data();
+    static_assert(sizeof(bool) == sizeof(uint8), "bool is not one byte");
+    for (int i = 0; i < batch_size; ++i) {
+      const int offset = i * num_actions;
+      int32 *row_actions = actions_data + i * k_;
+      float *row_scores = scores_data + i * k_;
+      const int count = TopAllowedActions(
+          logits_data + offset,
+          reinterpret_cast<const uint8 *>(allowed_data + offset), num_actions,
+          k_, log_normalize_, row_actions, row_scores);
+      for (int j = count; j < k_; ++j) {
+        row_actions[j] = -1;
+        row_scores[j] = -INFINITY;
+      }
+    }
+  }
+
+ private:
+  // Number of actions to select per parser state.
+  int k_;
+
+  // Whether to output log-softmax scores.
+  bool log_normalize_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(TopAllowedActionsOp);
+};
+
+REGISTER_KERNEL_BUILDER(Name("TopAllowedActions").Device(DEVICE_CPU),
+                        TopAllowedActionsOp);
+
+}  // namespace syntaxnet
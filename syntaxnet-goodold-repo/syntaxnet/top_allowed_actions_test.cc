@@ -0,0 +1,67 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/top_allowed_actions.h"
+
+#include <cmath>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+const float kScores[] = {1.0, 3.0, 2.0, 3.0, 0.5};
+
+TEST(TopAllowedActionsTest, SelectsBestAllowedActionsFirst) {
+  const uint8 allowed[] = {1, 1, 1, 1, 1};
+  int actions[3];
+  float scores[3];
+  EXPECT_EQ(3, TopAllowedActions(kScores, allowed, 5, 3, false, actions,
+                                 scores));
+  EXPECT_EQ(1, actions[0]);
+  EXPECT_EQ(3, actions[1]);
+  EXPECT_EQ(2, actions[2]);
+  EXPECT_EQ(3.0, scores[0]);
+  EXPECT_EQ(3.0, scores[1]);
+  EXPECT_EQ(2.0, scores[2]);
+}
+
+TEST(TopAllowedActionsTest, SkipsDisallowedActions) {
+  const uint8 allowed[] = {1, 0, 0, 1, 1};
+  int actions[5];
+  float scores[5];
+  EXPECT_EQ(3, TopAllowedActions(kScores, allowed, 5, 5, false, actions,
+                                 scores));
+  EXPECT_EQ(3, actions[0]);
+  EXPECT_EQ(0, actions[1]);
+  EXPECT_EQ(4, actions[2]);
+
+  const uint8 none_allowed[] = {0, 0, 0, 0, 0};
+  EXPECT_EQ(0, TopAllowedActions(kScores, none_allowed, 5, 1, false, actions,
+                                 scores));
+}
+
+TEST(TopAllowedActionsTest, LogNormalizesOverAllActions) {
+  const uint8 allowed[] = {1, 0, 1, 0, 0};
+  int action;
+  float score;
+  EXPECT_EQ(1, TopAllowedActions(kScores, allowed, 5, 1, true, &action,
+                                 &score));
+  EXPECT_EQ(2, action);
+  double sum = 0;
+  for (float value : kScores) sum += std::exp(value);
+  EXPECT_NEAR(2.0 - std::log(sum), score, 1e-5);
+}
+
+}  // namespace syntaxnet
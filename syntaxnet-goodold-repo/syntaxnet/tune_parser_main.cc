@@ -0,0 +1,215 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Tunes the batch size and the thread pool sizes of a parser deployment. The
+// model exported by parser_eval.py --export_path, or its bundle, is
+// benchmarked on a sample of a corpus for every combination of the given batch
+// sizes and intra- and inter-op thread counts, as benchmark_parser_main does,
+// and the settings on the Pareto frontier of throughput against p99 latency
+// are logged, from the highest throughput down. With --max_p99_micros, only
+// settings within that p99 latency are reported, and larger batches of a
+// thread setting are not tried once a batch size exceeds it.
+//
+//   tune_parser_main --export_path=/tmp/parser --corpus=dev.conll \
+//       --batch_sizes=1,8,32,128 --intra_op_threads=1,2,4,8 \
+//       --inter_op_threads=1,2 --output=/tmp/frontier.tsv
+//
+// writes the frontier as tab-separated values with a header line. The thread
+// counts are named after the serving_intra_op_threads and
+// serving_inter_op_threads task context parameters that deploy them, see
+// parsing_session.h. The other serving_* parameters of the task context, like
+// the CPU affinity, apply to all settings.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syntaxnet/parsing_session.h"
+#include "syntaxnet/sentence.pb.h"
+#include "syntaxnet/session_benchmark.h"
+#include "syntaxnet/task_context.h"
+#include "syntaxnet/utils.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/init_main.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/util/command_line_flags.h"
+
+using syntaxnet::ParsingSession;
+using syntaxnet::SessionBenchmarkResult;
+using tensorflow::Status;
+using tensorflow::int32;
+
+namespace {
+
+// One combination of the tuned settings.
+struct Setting {
+  int batch_size;
+  int intra_op_threads;
+  int inter_op_threads;
+};
+
+// Parses a comma-separated list of positive integers.
+Status ParseIntList(const string &name, const string &value,
+                    std::vector<int> *values) {
+  values->clear();
+  for (const string &part : syntaxnet::utils::Split(value, ',')) {
+    int32 parsed;
+    if (!tensorflow::strings::safe_strto32(part, &parsed) || parsed < 1) {
+      return tensorflow::errors::InvalidArgument(
+          "--", name, " must list positive integers, not ", value);
+    }
+    values->push_back(parsed);
+  }
+  if (values->empty()) {
+    return tensorflow::errors::InvalidArgument("--", name, " is empty");
+  }
+  return Status::OK();
+}
+
+// Returns a line of the frontier table for a setting and its result.
+string FrontierLine(const Setting &setting,
+                    const SessionBenchmarkResult &result) {
+  return tensorflow::strings::Printf(
+      "%d\t%d\t%d\t%.2f\t%.2f\t%.3f\t%.3f\n", setting.batch_size,
+      setting.intra_op_threads, setting.inter_op_threads,
+      result.sentences_per_second(), result.tokens_per_second(),
+      result.p50_latency_micros / 1000, result.p99_latency_micros / 1000);
+}
+
+const char kFrontierHeader[] =
+    "batch_size\tserving_intra_op_threads\tserving_inter_op_threads\t"
+    "sentences_per_second\ttokens_per_second\tp50_ms\tp99_ms\n";
+
+// Benchmarks the model at export_path with every setting of the grid, and
+// writes the frontier to output if it is not empty.
+Status Tune(const string &export_path, const std::vector<int> &batch_sizes,
+            const std::vector<int> &intra_op_threads,
+            const std::vector<int> &inter_op_threads, int max_p99_micros,
+            const std::vector<syntaxnet::Sentence> &sentences,
+            syntaxnet::SessionBenchmarkOptions options, const string &output) {
+  syntaxnet::TaskContext context;
+  TF_RETURN_IF_ERROR(ParsingSession::ReadTaskContext(export_path, &context));
+  std::vector<Setting> settings;
+  std::vector<SessionBenchmarkResult> results;
+  for (int intra : intra_op_threads) {
+    for (int inter : inter_op_threads) {
+      // Sessions are created one at a time, since they share the document
+      // queues of the model.
+      tensorflow::SessionOptions session_options;
+      ParsingSession::SetServingOptions(context, &session_options);
+      session_options.config.set_intra_op_parallelism_threads(intra);
+      session_options.config.set_inter_op_parallelism_threads(inter);
+      std::unique_ptr<ParsingSession> session;
+      TF_RETURN_IF_ERROR(
+          ParsingSession::Create(export_path, &session_options, &session));
+      for (int batch_size : batch_sizes) {
+        const Setting setting = {batch_size, intra, inter};
+        options.batch_size = batch_size;
+        SessionBenchmarkResult result;
+        TF_RETURN_IF_ERROR(syntaxnet::RunSessionBenchmark(
+            session.get(), sentences, options, &result));
+        LOG(INFO) << "batch_size " << batch_size << ", intra_op_threads "
+                  << intra << ", inter_op_threads " << inter << ": "
+                  << result.sentences_per_second() << " sentences/s, "
+                  << "latency p50 " << result.p50_latency_micros / 1000
+                  << " ms, p99 " << result.p99_latency_micros / 1000 << " ms";
+        if (max_p99_micros > 0 && result.p99_latency_micros > max_p99_micros) {
+          break;
+        }
+        settings.push_back(setting);
+        results.push_back(result);
+      }
+    }
+  }
+
+  string table = kFrontierHeader;
+  for (int index : syntaxnet::ParetoFrontier(results)) {
+    table += FrontierLine(settings[index], results[index]);
+  }
+  LOG(INFO) << "Pareto frontier of throughput against p99 latency:\n" << table;
+  if (output.empty()) return Status::OK();
+  return tensorflow::WriteStringToFile(tensorflow::Env::Default(), output,
+                                       table);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  string export_path;
+  string corpus;
+  string input_format = "conll-sentence";
+  int32 max_sentences = 1000;
+  string batch_sizes = "1,8,32,128";
+  string intra_op_threads = "1,2,4,8";
+  string inter_op_threads = "1,2";
+  int32 max_p99_micros = 0;
+  string output;
+  syntaxnet::SessionBenchmarkOptions options;
+  const bool parsed_flags_ok = tensorflow::ParseFlags(
+      &argc, argv,
+      {tensorflow::Flag("export_path", &export_path),
+       tensorflow::Flag("corpus", &corpus),
+       tensorflow::Flag("input_format", &input_format),
+       tensorflow::Flag("max_sentences", &max_sentences),
+       tensorflow::Flag("batch_sizes", &batch_sizes),
+       tensorflow::Flag("intra_op_threads", &intra_op_threads),
+       tensorflow::Flag("inter_op_threads", &inter_op_threads),
+       tensorflow::Flag("max_p99_micros", &max_p99_micros),
+       tensorflow::Flag("warmup_batches", &options.warmup_batches),
+       tensorflow::Flag("num_passes", &options.num_passes),
+       tensorflow::Flag("output", &output)});
+  tensorflow::port::InitMain(argv[0], &argc, &argv);
+  std::vector<int> batch_size_list, intra_list, inter_list;
+  Status status;
+  if (parsed_flags_ok) {
+    status = ParseIntList("batch_sizes", batch_sizes, &batch_size_list);
+    if (status.ok()) {
+      status = ParseIntList("intra_op_threads", intra_op_threads, &intra_list);
+    }
+    if (status.ok()) {
+      status = ParseIntList("inter_op_threads", inter_op_threads, &inter_list);
+    }
+  }
+  if (!parsed_flags_ok || !status.ok() || export_path.empty() ||
+      corpus.empty() || options.num_passes < 1) {
+    if (!status.ok()) LOG(ERROR) << status;
+    LOG(ERROR) << "Usage: " << argv[0] << " --export_path=<dir> "
+               << "--corpus=<file> [--input_format=conll-sentence] "
+               << "[--max_sentences=1000] [--batch_sizes=1,8,32,128] "
+               << "[--intra_op_threads=1,2,4,8] [--inter_op_threads=1,2] "
+               << "[--max_p99_micros=0] [--warmup_batches=5] [--num_passes=1] "
+               << "[--output=<file>]";
+    return 1;
+  }
+
+  std::vector<syntaxnet::Sentence> sentences;
+  syntaxnet::ReadSentenceSample(corpus, input_format, max_sentences,
+                                &sentences);
+  if (sentences.empty()) {
+    LOG(ERROR) << "No sentences in " << corpus;
+    return 1;
+  }
+  status = Tune(export_path, batch_size_list, intra_list, inter_list,
+                max_p99_micros, sentences, options, output);
+  if (!status.ok()) {
+    LOG(ERROR) << "Tuning " << export_path << " failed with " << status;
+    return 1;
+  }
+  return 0;
+}
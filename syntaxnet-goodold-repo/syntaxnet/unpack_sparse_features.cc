@@ -15,6 +15,7 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <limits>
 #include <memory>
 #include <string>
 #include <utility>
@@ -23,10 +24,12 @@ limitations under the License.
 #include "syntaxnet/sparse.pb.h"
 #include "syntaxnet/utils.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
 
+using tensorflow::AllocatorAttributes;
 using tensorflow::DEVICE_CPU;
 using tensorflow::DT_FLOAT;
 using tensorflow::DT_INT32;
@@ -41,13 +44,17 @@ using tensorflow::errors::InvalidArgument;
 
 namespace syntaxnet {
 
-// Operator to unpack ids and weights stored in SparseFeatures proto.
+// Operator to unpack ids and weights stored in SparseFeatures proto. The ids
+// are emitted as out_type. Without with_weights, the weights of the protos are
+// not decoded and the weights output is empty.
 class UnpackSparseFeatures : public OpKernel {
  public:
   explicit UnpackSparseFeatures(OpKernelConstruction *context)
       : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("out_type", &out_type_));
+    OP_REQUIRES_OK(context, context->GetAttr("with_weights", &with_weights_));
     OP_REQUIRES_OK(context, context->MatchSignature(
-                                {DT_STRING}, {DT_INT32, DT_INT64, DT_FLOAT}));
+                                {DT_STRING}, {DT_INT32, out_type_, DT_FLOAT}));
   }
 
   void Compute(OpKernelContext *context) override {
@@ -58,11 +65,12 @@ class UnpackSparseFeatures : public OpKernel {
     const int64 n = input.NumElements();
     const auto input_vec = input.flat<string>();
     SparseFeatures sf;
-    int output_size = 0;
-    std::vector<std::pair<int64, float> > id_and_weight;
+    std::vector<uint64> all_ids;
+    std::vector<float> all_weights;
 
     // Guess that we'll be averaging a handful of ids per SparseFeatures record.
-    id_and_weight.reserve(n * 4);
+    all_ids.reserve(n * 4);
+    if (with_weights_) all_weights.reserve(n * 4);
     std::vector<int> num_ids(n);
     for (int64 i = 0; i < n; ++i) {
       OP_REQUIRES(context, sf.ParseFromString(input_vec(i)),
@@ -71,38 +79,65 @@ class UnpackSparseFeatures : public OpKernel {
                   sf.weight_size() == 0 || sf.weight_size() == sf.id_size(),
                   InvalidArgument(tensorflow::strings::StrCat(
                       "Incorrect number of weights", sf.DebugString())));
-      int n_ids = sf.id_size();
+      const int n_ids = sf.id_size();
       num_ids[i] = n_ids;
-      output_size += n_ids;
-      for (int j = 0; j < n_ids; j++) {
-        float w = (sf.weight_size() > 0) ? sf.weight(j) : 1.0f;
-        id_and_weight.push_back(std::make_pair(sf.id(j), w));
+      all_ids.insert(all_ids.end(), sf.id().begin(), sf.id().end());
+      if (!with_weights_) continue;
+      if (sf.weight_size() > 0) {
+        all_weights.insert(all_weights.end(), sf.weight().begin(),
+                           sf.weight().end());
+      } else {
+        all_weights.insert(all_weights.end(), n_ids, 1.0f);
       }
     }
 
+    // The outputs feed the network, which may run on a GPU, so they are
+    // allocated from pinned host memory when the process has GPUs.
+    const int64 output_size = all_ids.size();
+    AllocatorAttributes pinned;
+    pinned.set_gpu_compatible(true);
     Tensor *indices_t;
-    OP_REQUIRES_OK(context, context->allocate_output(
-                                0, TensorShape({output_size}), &indices_t));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(0, TensorShape({output_size}),
+                                            &indices_t, pinned));
     Tensor *ids_t;
-    OP_REQUIRES_OK(context, context->allocate_output(
-                                1, TensorShape({output_size}), &ids_t));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(1, TensorShape({output_size}),
+                                            &ids_t, pinned));
     Tensor *weights_t;
-    OP_REQUIRES_OK(context, context->allocate_output(
-                                2, TensorShape({output_size}), &weights_t));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       2, TensorShape({static_cast<int64>(all_weights.size())}),
+                       &weights_t, pinned));
 
     auto indices = indices_t->vec<int32>();
-    auto ids = ids_t->vec<int64>();
-    auto weights = weights_t->vec<float>();
     int c = 0;
     for (int64 i = 0; i < n; ++i) {
-      for (int j = 0; j < num_ids[i]; ++j) {
-        indices(c) = i;
-        ids(c) = id_and_weight[c].first;
-        weights(c) = id_and_weight[c].second;
-        ++c;
+      for (int j = 0; j < num_ids[i]; ++j) indices(c++) = i;
+    }
+    if (out_type_ == DT_INT32) {
+      auto ids = ids_t->vec<int32>();
+      for (int64 k = 0; k < output_size; ++k) {
+        OP_REQUIRES(context,
+                    all_ids[k] <= std::numeric_limits<int32>::max(),
+                    InvalidArgument("Feature id ", all_ids[k],
+                                    " does not fit in int32"));
+        ids(k) = all_ids[k];
       }
+    } else {
+      auto ids = ids_t->vec<int64>();
+      for (int64 k = 0; k < output_size; ++k) ids(k) = all_ids[k];
     }
+    auto weights = weights_t->vec<float>();
+    for (size_t k = 0; k < all_weights.size(); ++k) weights(k) = all_weights[k];
   }
+
+ private:
+  // Type of the ids output.
+  tensorflow::DataType out_type_;
+
+  // Whether the weights are decoded.
+  bool with_weights_;
 };
 
 REGISTER_KERNEL_BUILDER(Name("UnpackSparseFeatures").Device(DEVICE_CPU),
@@ -14,6 +14,11 @@ limitations under the License.
 ==============================================================================*/
 
 #include "syntaxnet/utils.h"
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
 #include "tensorflow/core/platform/macros.h"
 
 namespace syntaxnet {
@@ -225,14 +230,64 @@ uint32 Hash32(const char *data, size_t n, uint32 seed) {
   return h;
 }
 
-string Lowercase(tensorflow::StringPiece s) {
-  string result(s.data(), s.size());
-  for (char &c : result) {
-    c = tolower(c);
+namespace {
+
+// Lookup tables for the ASCII fast paths of the helpers below.
+struct AsciiTables {
+  AsciiTables() {
+    for (int c = 0; c < 256; ++c) {
+      lowercase[c] = c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+      digits_to_nines[c] = c >= '0' && c <= '9' ? '9' : c;
+    }
+    for (int c = 0; c < 128; ++c) {
+      punctuation[c] = PunctuationUtil::IsPunctuation(c);
+    }
   }
+
+  char lowercase[256];
+  char digits_to_nines[256];
+  bool punctuation[128];
+};
+
+const AsciiTables &GetAsciiTables() {
+  static const AsciiTables *tables = new AsciiTables();
+  return *tables;
+}
+
+// Stores in *output the bytes of input mapped through a table.
+void MapBytes(tensorflow::StringPiece input, const char *table,
+              string *output) {
+  output->resize(input.size());
+  for (size_t i = 0; i < input.size(); ++i) {
+    (*output)[i] = table[static_cast<unsigned char>(input[i])];
+  }
+}
+
+}  // namespace
+
+int64 HeapBytesInUse() {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+  const struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;
+#elif defined(__GLIBC__)
+  // The fields of mallinfo() are ints, which wrap around at 4 GB.
+  const struct mallinfo info = mallinfo();
+  return static_cast<uint32>(info.uordblks) + static_cast<uint32>(info.hblkhd);
+#else
+  return 0;
+#endif
+}
+
+string Lowercase(tensorflow::StringPiece s) {
+  string result;
+  Lowercase(s, &result);
   return result;
 }
 
+void Lowercase(tensorflow::StringPiece s, string *output) {
+  MapBytes(s, GetAsciiTables().lowercase, output);
+}
+
 PunctuationUtil::CharacterRange PunctuationUtil::kPunctuation[] = {
     {33, 35},       {37, 42},       {44, 47},       {58, 59},
     {63, 64},       {91, 93},       {95, 95},       {123, 123},
@@ -260,11 +315,34 @@ PunctuationUtil::CharacterRange PunctuationUtil::kPunctuation[] = {
     {65375, 65381}, {65792, 65793}, {66463, 66463}, {68176, 68184},
     {-1, -1}};
 
+bool PunctuationUtil::IsPunctuationToken(tensorflow::StringPiece word) {
+  const AsciiTables &tables = GetAsciiTables();
+  for (size_t i = 0; i < word.size(); ++i) {
+    const unsigned char c = word[i];
+    if (c >= 0x80) {
+      // Decodes the rest of the word.
+      UnicodeText text;
+      text.PointToUTF8(word.data() + i, word.size() - i);
+      for (UnicodeText::const_iterator it = text.begin(); it != text.end();
+           ++it) {
+        if (!IsPunctuation(*it)) return false;
+      }
+      return true;
+    }
+    if (!tables.punctuation[c]) return false;
+  }
+  return true;
+}
+
 void NormalizeDigits(string *form) {
   for (size_t i = 0; i < form->size(); ++i) {
     if ((*form)[i] >= '0' && (*form)[i] <= '9') (*form)[i] = '9';
   }
 }
 
+void NormalizeDigits(tensorflow::StringPiece form, string *output) {
+  MapBytes(form, GetAsciiTables().digits_to_nines, output);
+}
+
 }  // namespace utils
 }  // namespace syntaxnet
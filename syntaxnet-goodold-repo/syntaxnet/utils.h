@@ -77,6 +77,11 @@ size_t RemoveWhitespaceContext(tensorflow::StringPiece *text);
 
 uint32 Hash32(const char *data, size_t n, uint32 seed);
 
+// Returns the bytes of heap memory the process has allocated and not freed,
+// or 0 where the allocator does not tell, e.g. with heap allocators other
+// than the one of glibc.
+int64 HeapBytesInUse();
+
 // Deletes all the elements in an STL container and clears the container. This
 // function is suitable for use with a vector, set, hash_set, or any other STL
 // container which defines sensible begin(), end(), and clear() methods.
@@ -96,6 +101,10 @@ void STLDeleteElements(T *container) {
 // Returns lower-cased version of s.
 string Lowercase(tensorflow::StringPiece s);
 
+// Stores the lower-cased version of s in *output, reusing its buffer. Like
+// tolower() in the C locale, only ASCII letters are lower-cased.
+void Lowercase(tensorflow::StringPiece s, string *output);
+
 class PunctuationUtil {
  public:
   // Unicode character ranges for punctuation characters according to CoNLL.
@@ -117,8 +126,8 @@ class PunctuationUtil {
   }
 
   // Determine if tag is a punctuation tag.
-  static bool IsPunctuationTag(const string &tag) {
-    for (size_t i = 0; i < tag.length(); ++i) {
+  static bool IsPunctuationTag(tensorflow::StringPiece tag) {
+    for (size_t i = 0; i < tag.size(); ++i) {
       int c = tag[i];
       if (c != ',' && c != ':' && c != '.' && c != '\'' && c != '`') {
         return false;
@@ -127,22 +136,15 @@ class PunctuationUtil {
     return true;
   }
 
-  // Returns true if word consists of punctuation characters.
-  static bool IsPunctuationToken(const string &word) {
-    UnicodeText text;
-    text.PointToUTF8(word.c_str(), word.length());
-    UnicodeText::const_iterator it;
-    for (it = text.begin(); it != text.end(); ++it) {
-      if (!IsPunctuation(*it)) return false;
-    }
-    return true;
-  }
+  // Returns true if word consists of punctuation characters. ASCII is looked
+  // up in a table without decoding.
+  static bool IsPunctuationToken(tensorflow::StringPiece word);
 
   // Returns true if tag is non-empty and has only punctuation or parens
   // symbols.
-  static bool IsPunctuationTagOrParens(const string &tag) {
+  static bool IsPunctuationTagOrParens(tensorflow::StringPiece tag) {
     if (tag.empty()) return false;
-    for (size_t i = 0; i < tag.length(); ++i) {
+    for (size_t i = 0; i < tag.size(); ++i) {
       int c = tag[i];
       if (c != '(' && c != ')' && c != ',' && c != ':' && c != '.' &&
           c != '\'' && c != '`') {
@@ -154,7 +156,8 @@ class PunctuationUtil {
 
   // Decides whether to score a token, given the word, the POS tag and
   // and the scoring type.
-  static bool ScoreToken(const string &word, const string &tag,
+  static bool ScoreToken(tensorflow::StringPiece word,
+                         tensorflow::StringPiece tag,
                          const string &scoring_type) {
     if (scoring_type == "default") {
       return tag.empty() || !IsPunctuationTag(tag);
@@ -168,8 +171,12 @@ class PunctuationUtil {
   }
 };
 
+// Replaces the digits of form with 9.
 void NormalizeDigits(string *form);
 
+// Stores form with its digits replaced by 9 in *output, reusing its buffer.
+void NormalizeDigits(tensorflow::StringPiece form, string *output);
+
 // Helper type to mark missing c-tor argument types
 // for Type's c-tor in LazyStaticPtr<Type, ...>.
 struct NoArg {};
@@ -0,0 +1,64 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/utils.h"
+
+#include <string>
+
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+namespace utils {
+namespace {
+
+TEST(UtilsTest, LowercaseReusesOutput) {
+  string output = "previous contents";
+  Lowercase("Hello, World \xC3\x89", &output);
+  EXPECT_EQ("hello, world \xC3\x89", output);
+  Lowercase("", &output);
+  EXPECT_EQ("", output);
+  EXPECT_EQ("abc", Lowercase("AbC"));
+}
+
+TEST(UtilsTest, NormalizeDigitsReusesOutput) {
+  string output = "previous contents";
+  NormalizeDigits("A380 in 2005", &output);
+  EXPECT_EQ("A999 in 9999", output);
+  string form = "0123";
+  NormalizeDigits(&form);
+  EXPECT_EQ("9999", form);
+}
+
+TEST(UtilsTest, PunctuationTokens) {
+  EXPECT_TRUE(PunctuationUtil::IsPunctuationToken("..."));
+  EXPECT_TRUE(PunctuationUtil::IsPunctuationToken("\"?!"));
+  EXPECT_FALSE(PunctuationUtil::IsPunctuationToken("a."));
+  EXPECT_FALSE(PunctuationUtil::IsPunctuationToken("$"));
+
+  // Non-ASCII characters are decoded: U+00BF and U+2014 are punctuation,
+  // U+00E9 is not.
+  EXPECT_TRUE(PunctuationUtil::IsPunctuationToken("\xC2\xBF\xE2\x80\x94."));
+  EXPECT_FALSE(PunctuationUtil::IsPunctuationToken(".\xC3\xA9"));
+
+  EXPECT_FALSE(PunctuationUtil::ScoreToken(",", "", "conllx"));
+  EXPECT_TRUE(PunctuationUtil::ScoreToken("word", ",", "conllx"));
+  EXPECT_FALSE(PunctuationUtil::ScoreToken("word", ",", "default"));
+}
+
+}  // namespace
+}  // namespace utils
+}  // namespace syntaxnet
@@ -15,10 +15,17 @@ limitations under the License.
 
 #include "syntaxnet/workspace.h"
 
+#include <atomic>
+
 #include "tensorflow/core/lib/strings/strcat.h"
 
 namespace syntaxnet {
 
+int NewWorkspaceTypeId() {
+  static std::atomic<int> next_id(0);
+  return next_id++;
+}
+
 string WorkspaceRegistry::DebugString() const {
   string str;
   for (auto &it : workspace_names_) {
@@ -42,9 +49,45 @@ VectorIntWorkspace::VectorIntWorkspace(const vector<int> &elements)
 
 string VectorIntWorkspace::TypeName() { return "Vector"; }
 
+VectorIntWorkspace *VectorIntWorkspace::Reclaim(WorkspaceSet *workspaces,
+                                                int index, int size) {
+  VectorIntWorkspace *workspace =
+      workspaces->Reclaim<VectorIntWorkspace>(index);
+  if (workspace == nullptr) return new VectorIntWorkspace(size);
+  workspace->Reinitialize(size);
+  return workspace;
+}
+
 VectorVectorIntWorkspace::VectorVectorIntWorkspace(int size)
     : elements_(size) {}
 
 string VectorVectorIntWorkspace::TypeName() { return "VectorVector"; }
 
+void VectorVectorIntWorkspace::Reinitialize(int size) {
+  elements_.resize(size);
+  for (vector<int> &elements : elements_) elements.clear();
+}
+
+VectorVectorIntWorkspace *VectorVectorIntWorkspace::Reclaim(
+    WorkspaceSet *workspaces, int index, int size) {
+  VectorVectorIntWorkspace *workspace =
+      workspaces->Reclaim<VectorVectorIntWorkspace>(index);
+  if (workspace == nullptr) return new VectorVectorIntWorkspace(size);
+  workspace->Reinitialize(size);
+  return workspace;
+}
+
+string CompactVectorVectorIntWorkspace::TypeName() {
+  return "CompactVectorVector";
+}
+
+CompactVectorVectorIntWorkspace *CompactVectorVectorIntWorkspace::Reclaim(
+    WorkspaceSet *workspaces, int index) {
+  CompactVectorVectorIntWorkspace *workspace =
+      workspaces->Reclaim<CompactVectorVectorIntWorkspace>(index);
+  if (workspace == nullptr) return new CompactVectorVectorIntWorkspace();
+  workspace->Reinitialize();
+  return workspace;
+}
+
 }  // namespace syntaxnet
@@ -45,6 +45,18 @@ class Workspace {
   TF_DISALLOW_COPY_AND_ASSIGN(Workspace);
 };
 
+// Returns a new dense id for a workspace type.
+int NewWorkspaceTypeId();
+
+// Returns the dense id of the workspace type W, assigned on first use. Ids
+// index the workspace types in WorkspaceRegistry and WorkspaceSet, so that
+// workspaces are found without hashing types.
+template <class W>
+int WorkspaceTypeId() {
+  static const int id = NewWorkspaceTypeId();
+  return id;
+}
+
 // A registry that keeps track of workspaces.
 class WorkspaceRegistry {
  public:
@@ -62,6 +74,11 @@ class WorkspaceRegistry {
       if (names[i] == name) return i;
     }
     names.push_back(name);
+    const int type_id = WorkspaceTypeId<W>();
+    if (type_id >= workspace_counts_.size()) {
+      workspace_counts_.resize(type_id + 1, 0);
+    }
+    workspace_counts_[type_id] = names.size();
     return names.size() - 1;
   }
 
@@ -70,6 +87,9 @@ class WorkspaceRegistry {
     return workspace_names_;
   }
 
+  // Returns the number of workspaces of each type, indexed by type id.
+  const vector<int> &WorkspaceCounts() const { return workspace_counts_; }
+
   // Returns a string describing the registered workspaces.
   string DebugString() const;
 
@@ -80,64 +100,103 @@ class WorkspaceRegistry {
   // Workspace names, indexed as workspace_names_[typeid][workspace].
   std::unordered_map<std::type_index, vector<string> > workspace_names_;
 
+  // Number of workspaces, indexed as workspace_counts_[type id].
+  vector<int> workspace_counts_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(WorkspaceRegistry);
 };
 
 // A typed collected of workspaces. The workspaces are indexed according to an
 // external WorkspaceRegistry. If the WorkspaceSet is const, the contents are
 // also immutable.
+//
+// Workspaces are stored in arrays indexed by type id and workspace index. On
+// Reset(), the workspaces of the previous object are kept until the next
+// Reset(), so that features can reclaim their storage with Reclaim().
 class WorkspaceSet {
  public:
-  ~WorkspaceSet() { Reset(WorkspaceRegistry()); }
+  WorkspaceSet() {}
+  WorkspaceSet(WorkspaceSet &&other) = default;
+  ~WorkspaceSet() {
+    Clear(&workspaces_);
+    Clear(&released_);
+  }
 
   // Returns true if a workspace has been set.
   template <class W>
   bool Has(int index) const {
-    const std::type_index id = std::type_index(typeid(W));
-    DCHECK(workspaces_.find(id) != workspaces_.end());
-    DCHECK_LT(index, workspaces_.find(id)->second.size());
-    return workspaces_.find(id)->second[index] != nullptr;
+    const int id = WorkspaceTypeId<W>();
+    DCHECK_LT(id, workspaces_.size());
+    DCHECK_LT(index, workspaces_[id].size());
+    return workspaces_[id][index] != nullptr;
   }
 
   // Returns an indexed workspace; the workspace must have been set.
   template <class W>
   const W &Get(int index) const {
     DCHECK(Has<W>(index));
-    const Workspace *w =
-        workspaces_.find(std::type_index(typeid(W)))->second[index];
-    return reinterpret_cast<const W &>(*w);
+    return static_cast<const W &>(*workspaces_[WorkspaceTypeId<W>()][index]);
   }
 
   // Sets an indexed workspace; this takes ownership of the workspace, which
   // must have been new-allocated.  It is an error to set a workspace twice.
   template <class W>
   void Set(int index, W *workspace) {
-    const std::type_index id = std::type_index(typeid(W));
-    DCHECK(workspaces_.find(id) != workspaces_.end());
+    const int id = WorkspaceTypeId<W>();
+    DCHECK_LT(id, workspaces_.size());
     DCHECK_LT(index, workspaces_[id].size());
     DCHECK(workspaces_[id][index] == nullptr);
     DCHECK(workspace != nullptr);
     workspaces_[id][index] = workspace;
   }
 
-  void Reset(const WorkspaceRegistry &registry) {
-    // Deallocate current workspaces.
-    for (auto &it : workspaces_) {
-      for (size_t index = 0; index < it.second.size(); ++index) {
-        delete it.second[index];
-      }
+  // Returns the workspace that was set at the index before the last Reset(),
+  // or null if there is none. The caller takes ownership, and typically
+  // reinitializes the workspace and sets it again.
+  template <class W>
+  W *Reclaim(int index) {
+    const int id = WorkspaceTypeId<W>();
+    if (id >= released_.size() || index >= released_[id].size()) {
+      return nullptr;
     }
-    workspaces_.clear();
+    Workspace *workspace = released_[id][index];
+    released_[id][index] = nullptr;
+    return static_cast<W *>(workspace);
+  }
+
+  void Reset(const WorkspaceRegistry &registry) {
+    // Keep the current workspaces for reclaiming, and deallocate the ones kept
+    // before.
+    workspaces_.swap(released_);
+    Clear(&workspaces_);
 
     // Allocate space for new workspaces.
-    for (auto &it : registry.WorkspaceNames()) {
-      workspaces_[it.first].resize(it.second.size());
+    const vector<int> &counts = registry.WorkspaceCounts();
+    workspaces_.resize(counts.size());
+    for (size_t id = 0; id < counts.size(); ++id) {
+      workspaces_[id].resize(counts[id], nullptr);
     }
   }
 
  private:
-  // The set of workspaces, indexed as workspaces_[typeid][index].
-  std::unordered_map<std::type_index, vector<Workspace *> > workspaces_;
+  // Deallocates the given workspaces, keeping the arrays for reuse.
+  static void Clear(vector<vector<Workspace *> > *workspaces) {
+    for (auto &typed : *workspaces) {
+      for (Workspace *&workspace : typed) {
+        delete workspace;
+        workspace = nullptr;
+      }
+      typed.clear();
+    }
+  }
+
+  // The set of workspaces, indexed as workspaces_[type id][index].
+  vector<vector<Workspace *> > workspaces_;
+
+  // The workspaces set before the last Reset(), indexed like workspaces_.
+  vector<vector<Workspace *> > released_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(WorkspaceSet);
 };
 
 // A workspace that wraps around a single int.
@@ -187,6 +246,16 @@ class VectorIntWorkspace : public Workspace {
 
   int size() const { return elements_.size(); }
 
+  // Resizes the vector to the given size, with all elements zero, keeping its
+  // storage when possible.
+  void Reinitialize(int size) { elements_.assign(size, 0); }
+
+  // Returns a vector workspace of the given size to set at the index of the
+  // workspace set, reclaiming the one set there before the last Reset() if
+  // any. To be used in place of new VectorIntWorkspace(size).
+  static VectorIntWorkspace *Reclaim(WorkspaceSet *workspaces, int index,
+                                     int size);
+
  private:
   // The enclosed vector.
   vector<int> elements_;
@@ -207,11 +276,64 @@ class VectorVectorIntWorkspace : public Workspace {
   // Mutable access to the i'th vector of elements.
   vector<int> *mutable_elements(int i) { return &(elements_[i]); }
 
+  // Resizes to the given number of empty vectors, keeping their storage when
+  // possible.
+  void Reinitialize(int size);
+
+  // Returns a workspace of the given size to set at the index of the workspace
+  // set, reclaiming the one set there before the last Reset() if any.
+  static VectorVectorIntWorkspace *Reclaim(WorkspaceSet *workspaces, int index,
+                                           int size);
+
  private:
   // The enclosed vector of vector of elements.
   vector<vector<int> > elements_;
 };
 
+// A workspace holding a vector of int for each of a number of items, like the
+// tokens of a sentence, in compressed sparse row layout: the elements of all
+// vectors back to back in one array, and the offset of the first element of
+// each vector in another. Filling it needs no allocation per item, and none
+// at all once a reclaimed workspace has grown to the size of its items.
+class CompactVectorVectorIntWorkspace : public Workspace {
+ public:
+  // Creates a workspace without any vector.
+  CompactVectorVectorIntWorkspace() : offsets_(1, 0) {}
+
+  // Returns the name of this type of workspace.
+  static string TypeName();
+
+  // Returns the number of vectors.
+  int size() const { return offsets_.size() - 1; }
+
+  // Returns the range of elements of the i'th vector.
+  const int *begin(int i) const { return elements_.data() + offsets_[i]; }
+  const int *end(int i) const { return elements_.data() + offsets_[i + 1]; }
+
+  // Appends a vector with the given elements.
+  void Append(const vector<int> &elements) {
+    elements_.insert(elements_.end(), elements.begin(), elements.end());
+    offsets_.push_back(elements_.size());
+  }
+
+  // Removes all vectors, keeping the storage.
+  void Reinitialize() {
+    elements_.clear();
+    offsets_.resize(1);
+  }
+
+  // Returns an empty workspace to set at the index of the workspace set,
+  // reclaiming the one set there before the last Reset() if any.
+  static CompactVectorVectorIntWorkspace *Reclaim(WorkspaceSet *workspaces,
+                                                  int index);
+
+ private:
+  // Elements of all vectors, and the offset of each vector in them, followed
+  // by the total number of elements.
+  vector<int> elements_;
+  vector<int> offsets_;
+};
+
 }  // namespace syntaxnet
 
 #endif  // SYNTAXNET_WORKSPACE_H_
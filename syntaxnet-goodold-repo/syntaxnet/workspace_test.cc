@@ -0,0 +1,102 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "syntaxnet/workspace.h"
+
+#include <vector>
+
+#include <gmock/gmock.h>
+
+#include "tensorflow/core/platform/test.h"
+
+namespace syntaxnet {
+
+TEST(WorkspaceTest, WorkspacesAreIndexedByTypeAndName) {
+  WorkspaceRegistry registry;
+  const int a = registry.Request<VectorIntWorkspace>("a");
+  const int b = registry.Request<VectorIntWorkspace>("b");
+  const int c = registry.Request<SingletonIntWorkspace>("c");
+  EXPECT_EQ(a, registry.Request<VectorIntWorkspace>("a"));
+  EXPECT_NE(a, b);
+  EXPECT_NE(WorkspaceTypeId<VectorIntWorkspace>(),
+            WorkspaceTypeId<SingletonIntWorkspace>());
+
+  WorkspaceSet workspaces;
+  workspaces.Reset(registry);
+  EXPECT_FALSE(workspaces.Has<VectorIntWorkspace>(a));
+  workspaces.Set(a, new VectorIntWorkspace(2, 1));
+  workspaces.Set(b, new VectorIntWorkspace(3, 2));
+  workspaces.Set(c, new SingletonIntWorkspace(7));
+  EXPECT_TRUE(workspaces.Has<VectorIntWorkspace>(a));
+  EXPECT_EQ(2, workspaces.Get<VectorIntWorkspace>(a).size());
+  EXPECT_EQ(2, workspaces.Get<VectorIntWorkspace>(b).element(2));
+  EXPECT_EQ(7, workspaces.Get<SingletonIntWorkspace>(c).get());
+}
+
+TEST(WorkspaceTest, ResetKeepsWorkspacesForReclaiming) {
+  WorkspaceRegistry registry;
+  const int index = registry.Request<VectorIntWorkspace>("vector");
+  WorkspaceSet workspaces;
+  workspaces.Reset(registry);
+  VectorIntWorkspace *first = new VectorIntWorkspace(4, 1);
+  workspaces.Set(index, first);
+
+  // The workspace of the previous object is reclaimed and reinitialized.
+  workspaces.Reset(registry);
+  EXPECT_FALSE(workspaces.Has<VectorIntWorkspace>(index));
+  VectorIntWorkspace *second =
+      VectorIntWorkspace::Reclaim(&workspaces, index, 2);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(2, second->size());
+  EXPECT_EQ(0, second->element(1));
+  workspaces.Set(index, second);
+
+  // Workspaces can only be reclaimed once.
+  EXPECT_EQ(nullptr, workspaces.Reclaim<VectorIntWorkspace>(index));
+  workspaces.Reset(registry);
+  workspaces.Reset(registry);
+  EXPECT_EQ(nullptr, workspaces.Reclaim<VectorIntWorkspace>(index));
+}
+
+TEST(WorkspaceTest, CompactVectorVectorsKeepStorageWhenReclaimed) {
+  WorkspaceRegistry registry;
+  const int index =
+      registry.Request<CompactVectorVectorIntWorkspace>("vectors");
+  WorkspaceSet workspaces;
+  workspaces.Reset(registry);
+  CompactVectorVectorIntWorkspace *first =
+      CompactVectorVectorIntWorkspace::Reclaim(&workspaces, index);
+  first->Append({1, 2});
+  first->Append({});
+  first->Append({3});
+  EXPECT_EQ(3, first->size());
+  EXPECT_THAT(std::vector<int>(first->begin(0), first->end(0)),
+              ::testing::ElementsAre(1, 2));
+  EXPECT_EQ(first->begin(1), first->end(1));
+  EXPECT_THAT(std::vector<int>(first->begin(2), first->end(2)),
+              ::testing::ElementsAre(3));
+  workspaces.Set(index, first);
+
+  workspaces.Reset(registry);
+  CompactVectorVectorIntWorkspace *second =
+      CompactVectorVectorIntWorkspace::Reclaim(&workspaces, index);
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(0, second->size());
+  second->Append({4});
+  EXPECT_EQ(4, *second->begin(0));
+  workspaces.Set(index, second);
+}
+
+}  // namespace syntaxnet
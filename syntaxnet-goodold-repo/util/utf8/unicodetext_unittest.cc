@@ -18,6 +18,8 @@
 
 #include <iterator>
 #include <set>
+#include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 #include "third_party/utf/utf.h"
@@ -305,6 +307,43 @@ TEST(UnicodeTextTest, InterchangeValidity) {
   EXPECT_EQ(*a.begin(), 0x20);
 }
 
+TEST(UnicodeTextTest, SpanInterchangeValidSkipsAsciiRuns) {
+  const string ascii = "The quick brown fox jumps over the lazy dog.\t\n";
+  EXPECT_EQ(ascii.size(), UniLib::SpanInterchangeValid(ascii));
+
+  // Invalid characters are found at any position within or after a run.
+  for (int i = 0; i <= 40; ++i) {
+    for (const string invalid : {string(1, '\x01'), string("\x7F"),
+                                 string("\xEF\xB7\x90"), string("\xC3")}) {
+      const string text = string(i, 'a') + invalid + string(20, 'b');
+      EXPECT_EQ(i, UniLib::SpanInterchangeValid(text));
+    }
+    const string text = string(i, 'a') + "\xC3\xA9" + string(20, 'b');
+    EXPECT_EQ(text.size(), UniLib::SpanInterchangeValid(text));
+  }
+}
+
+TEST(UnicodeTextTest, SplitIntoChars) {
+  const string text =
+      "caf\xC3\xA9 au lait, s'il vous pla\xC3\xAEt \xE2\x82\xAC";
+  std::vector<StringPiece> chars;
+  UniLib::SplitIntoChars(text, &chars);
+  UnicodeText unicode;
+  unicode.PointToUTF8(text.data(), text.size());
+  std::vector<StringPiece> expected;
+  for (UnicodeText::const_iterator it = unicode.begin(); it != unicode.end();
+       ++it) {
+    expected.emplace_back(it.utf8_data(), it.utf8_length());
+  }
+  EXPECT_EQ(expected, chars);
+
+  // A codepoint cut off by the end of the text is truncated.
+  chars.clear();
+  UniLib::SplitIntoChars(text.data(), text.size() - 1, &chars);
+  ASSERT_EQ(expected.size(), chars.size());
+  EXPECT_EQ("\xE2\x82", chars.back());
+}
+
 class SubstringSearchTest : public UnicodeTextTest {};
 
 // TEST_F(SubstringSearchTest, FindEmpty) {
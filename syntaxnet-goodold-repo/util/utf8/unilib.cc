@@ -18,10 +18,71 @@
 
 #include "util/utf8/unilib.h"
 
+#include <string.h>
+#include <algorithm>
+
 #include "syntaxnet/base.h"
 #include "third_party/utf/utf.h"
+#include "util/utf8/unilib_utf8_utils.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace UniLib {
+namespace {
+
+// Number of bytes checked at once for runs of ASCII.
+const int kBlockSize = 16;
+
+#if !defined(__SSE2__)
+// Masks of the low and the high bit of each byte of a word.
+const uint64 kLowBits = 0x0101010101010101ULL;
+const uint64 kHighBits = 0x8080808080808080ULL;
+
+// Returns true if a byte of the word, whose high bits must be clear, is less
+// than n, for n <= 0x80.
+inline bool HasByteLessThan(uint64 word, int n) {
+  return ((word - kLowBits * n) & ~word & kHighBits) != 0;
+}
+#endif
+
+// Returns true if the kBlockSize bytes at p are all ASCII.
+inline bool IsAsciiBlock(const char* p) {
+#if defined(__SSE2__)
+  const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  return _mm_movemask_epi8(bytes) == 0;
+#else
+  uint64 words[2];
+  memcpy(words, p, sizeof(words));
+  return ((words[0] | words[1]) & kHighBits) == 0;
+#endif
+}
+
+// Returns true if the kBlockSize bytes at p are all printable ASCII, i.e. in
+// [0x20, 0x7E], which are all interchange valid.
+inline bool IsPrintableAsciiBlock(const char* p) {
+#if defined(__SSE2__)
+  // Bytes of 0x80 and above are negative as signed chars.
+  const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  const __m128i printable =
+      _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(0x1F)),
+                    _mm_cmplt_epi8(bytes, _mm_set1_epi8(0x7F)));
+  return _mm_movemask_epi8(printable) == 0xFFFF;
+#else
+  uint64 words[2];
+  memcpy(words, p, sizeof(words));
+  for (const uint64 word : words) {
+    if ((word & kHighBits) != 0 || HasByteLessThan(word, 0x20) ||
+        HasByteLessThan(word ^ (kLowBits * 0x7F), 1)) {
+      return false;
+    }
+  }
+  return true;
+#endif
+}
+
+}  // namespace
 
 // Codepoints not allowed for interchange are:
 //   C0 (ASCII) controls: U+0000 to U+001F excluding Space (SP, U+0020),
@@ -42,6 +103,15 @@ int SpanInterchangeValid(const char* begin, int byte_length) {
   const char* p = begin;
   const char* end = begin + byte_length;
   while (p < end) {
+    if (end - p >= kBlockSize && IsPrintableAsciiBlock(p)) {
+      p += kBlockSize;
+      continue;
+    }
+    if (static_cast<unsigned char>(*p) < 0x80) {
+      if (!IsInterchangeValid(static_cast<unsigned char>(*p))) break;
+      ++p;
+      continue;
+    }
     int bytes_consumed = charntorune(&rune, p, end - p);
     // We want to accept Runeerror == U+FFFD as a valid char, but it is used
     // by chartorune to indicate error. Luckily, the real codepoint is size 3
@@ -55,4 +125,21 @@ int SpanInterchangeValid(const char* begin, int byte_length) {
   return p - begin;
 }
 
+void SplitIntoChars(const char* src, int byte_length,
+                    std::vector<StringPiece>* chars) {
+  const char* p = src;
+  const char* end = src + byte_length;
+  while (p < end) {
+    if (end - p >= kBlockSize && IsAsciiBlock(p)) {
+      for (int i = 0; i < kBlockSize; ++i) chars->emplace_back(p + i, 1);
+      p += kBlockSize;
+      continue;
+    }
+    const int length =
+        std::min(OneCharLen(p), static_cast<int>(end - p));
+    chars->emplace_back(p, length);
+    p += length;
+  }
+}
+
 }  // namespace UniLib
@@ -32,6 +32,7 @@
 #define UTIL_UTF8_UNILIB_H__
 
 #include <string>
+#include <vector>
 #include "syntaxnet/base.h"
 
 // We export OneCharLen, IsValidCodepoint, and IsTrailByte from here,
@@ -41,7 +42,8 @@
 namespace UniLib {
 
 // Returns the length in bytes of the prefix of src that is all
-//  interchange valid UTF-8
+//  interchange valid UTF-8. Runs of printable ASCII are checked a block of
+//  bytes at a time.
 int SpanInterchangeValid(const char* src, int byte_length);
 inline int SpanInterchangeValid(const std::string& src) {
   return SpanInterchangeValid(src.data(), src.size());
@@ -58,6 +60,17 @@ inline bool IsInterchangeValid(const std::string& src) {
   return IsInterchangeValid(src.data(), src.size());
 }
 
+// Appends the codepoints of src to chars, as pieces of src. Each codepoint
+// is OneCharLen() bytes long, truncated at the end of src, so src should be
+// structurally valid UTF-8. Runs of ASCII are split a block of bytes at a
+// time, without looking at the lengths of their codepoints.
+void SplitIntoChars(const char* src, int byte_length,
+                    std::vector<StringPiece>* chars);
+inline void SplitIntoChars(const std::string& src,
+                           std::vector<StringPiece>* chars) {
+  SplitIntoChars(src.data(), src.size(), chars);
+}
+
 }  // namespace UniLib
 
 #endif  // UTIL_UTF8_PUBLIC_UNILIB_H_
@@ -52,10 +52,26 @@ flags.DEFINE_bool('slim_model', False,
                   'Whether to expect only averaged variables.')
 
 
-def Eval(feature_sizes, domain_sizes, embedding_dims, num_actions):
-  """Builds network."""
-
-  hidden_layer_sizes = map(int, FLAGS.hidden_layer_sizes.split(','))
+flags.DEFINE_string('tagger_model_path', '',
+                    'If set, also runs a tagger with these parameters in the '
+                    'same session, and feeds its output to the parser.')
+flags.DEFINE_string('tagger_arg_prefix', 'brain_tagger',
+                    'Prefix for context parameters of the pipelined tagger.')
+flags.DEFINE_string('tagger_hidden_layer_sizes', '64',
+                    'Comma separated list of hidden layer sizes of the '
+                    'pipelined tagger.')
+flags.DEFINE_string('pipeline_corpus', 'tagged-queue',
+                    'Name of the sentence-queue context input connecting the '
+                    'pipelined tagger to the parser.')
+
+
+def Eval(sess, arg_prefix, hidden_layer_sizes, model_path, input_corpus,
+         output_corpus):
+  """Builds network, restores its parameters and sinks its output in-graph."""
+  feature_sizes, domain_sizes, embedding_dims, num_actions = sess.run(
+      gen_parser_ops.feature_size(task_context=FLAGS.task_context,
+                                  arg_prefix=arg_prefix))
+  hidden_layer_sizes = map(int, hidden_layer_sizes.split(','))
   if FLAGS.graph_builder == 'greedy':
     parser = graph_builder.GreedyParser(num_actions,
                                         feature_sizes,
@@ -64,7 +80,7 @@ def Eval(feature_sizes, domain_sizes, embedding_dims, num_actions):
                                         hidden_layer_sizes,
                                         nndev=FLAGS.nndev,
                                         gate_gradients=True,
-                                        arg_prefix=FLAGS.arg_prefix)
+                                        arg_prefix=arg_prefix)
   else:
     parser = structured_graph_builder.StructuredGraphBuilder(
         num_actions,
@@ -74,21 +90,22 @@ def Eval(feature_sizes, domain_sizes, embedding_dims, num_actions):
         hidden_layer_sizes,
         nndev=FLAGS.nndev,
         gate_gradients=True,
-        arg_prefix=FLAGS.arg_prefix,
+        arg_prefix=arg_prefix,
         beam_size=FLAGS.beam_size,
         max_steps=FLAGS.max_steps)
   parser.AddEvaluation(FLAGS.task_context,
                        FLAGS.batch_size,
-                       corpus_name=FLAGS.input,
+                       corpus_name=input_corpus,
                        evaluation_max_steps=FLAGS.max_steps)
 
   parser.AddSaver(FLAGS.slim_model)
+  sess.run(parser.inits.values())
+  parser.saver.restore(sess, model_path)
 
-  sink_documents = tf.placeholder(tf.string)
-  sink = gen_parser_ops.document_sink(sink_documents,
+  sink = gen_parser_ops.document_sink(parser.evaluation['documents'],
                                       task_context=FLAGS.task_context,
-                                      corpus_name=FLAGS.output)
-  return parser, sink, sink_documents
+                                      corpus_name=output_corpus)
+  return parser, sink
 
 
 def main(unused_argv):
@@ -96,24 +113,47 @@ def main(unused_argv):
   with tf.Session(config=tf.ConfigProto(intra_op_parallelism_threads=2,
                                         inter_op_parallelism_threads=2,
                                         gpu_options=gpu_options)) as sess:
-    feature_sizes, domain_sizes, embedding_dims, num_actions = sess.run(
-      gen_parser_ops.feature_size(task_context=FLAGS.task_context,
-                                  arg_prefix=FLAGS.arg_prefix))
-    parser, sink, sink_documents = Eval(feature_sizes, domain_sizes, embedding_dims, num_actions)
-    sess.run(parser.inits.values())
-    parser.saver.restore(sess, FLAGS.model_path)
-
-    num_epochs = None
+    if not FLAGS.tagger_model_path:
+      parser, sink = Eval(sess, FLAGS.arg_prefix, FLAGS.hidden_layer_sizes,
+                          FLAGS.model_path, FLAGS.input, FLAGS.output)
+      num_epochs = None
+      while True:
+        tf_eval_epochs, _ = sess.run([parser.evaluation['epochs'], sink])
+        if num_epochs is None:
+          num_epochs = tf_eval_epochs
+        elif num_epochs < tf_eval_epochs:
+          break
+      return
+
+    # Pipeline mode: the tagger hands its documents to the parser through an
+    # in-memory queue instead of a CoNLL text pipe between two processes.
+    with tf.variable_scope('tagger'):
+      tagger, tagger_sink = Eval(sess, FLAGS.tagger_arg_prefix,
+                                 FLAGS.tagger_hidden_layer_sizes,
+                                 FLAGS.tagger_model_path, FLAGS.input,
+                                 FLAGS.pipeline_corpus)
+    with tf.variable_scope('parser'):
+      parser, parser_sink = Eval(sess, FLAGS.arg_prefix,
+                                 FLAGS.hidden_layer_sizes, FLAGS.model_path,
+                                 FLAGS.pipeline_corpus, FLAGS.output)
+    tagger_epochs = None
+    tagger_done = False
+    parser_epochs = None
     while True:
-      tf_eval_epochs, tf_documents = sess.run([
-          parser.evaluation['epochs'],
-          parser.evaluation['documents'],
-      ])
-      if len(tf_documents):
-        sess.run(sink, feed_dict={sink_documents: tf_documents})
-      if num_epochs is None:
-        num_epochs = tf_eval_epochs
-      elif num_epochs < tf_eval_epochs:
+      if not tagger_done:
+        tf_tagger_epochs, _ = sess.run([tagger.evaluation['epochs'],
+                                        tagger_sink])
+        if tagger_epochs is None:
+          tagger_epochs = tf_tagger_epochs
+        elif tagger_epochs < tf_tagger_epochs:
+          tagger_done = True
+      # The parser starts a new epoch whenever the queue runs dry, so only
+      # the first epoch change after the tagger is done marks the end.
+      tf_parser_epochs, _ = sess.run([parser.evaluation['epochs'],
+                                      parser_sink])
+      if not tagger_done or parser_epochs is None:
+        parser_epochs = tf_parser_epochs
+      elif parser_epochs < tf_parser_epochs:
         break
 
 if __name__ == '__main__':
@@ -433,6 +433,22 @@ static bool TF_Run_Inputs(
   return ok;
 }
 
+// Returns a new TF_Tensor holding the output 'src' of a step.
+static TF_Tensor* TF_Run_Output(const Tensor& src) {
+  if (!src.IsInitialized() || src.NumElements() == 0) {
+    return tensorflow::EmptyTensor(static_cast<TF_DataType>(src.dtype()),
+                                   src.shape());
+  }
+  if (src.dtype() != tensorflow::DT_STRING) {
+    // Share the underlying buffer.
+    TensorBuffer* buf = tensorflow::TensorCApi::Buffer(src);
+    buf->Ref();
+    return new TF_Tensor{static_cast<TF_DataType>(src.dtype()), src.shape(),
+                         buf};
+  }
+  return tensorflow::TF_Tensor_EncodeStrings(src);
+}
+
 static void TF_Run_Helper(
     Session* session, const char* handle, const TF_Buffer* run_options,
     // Input tensors
@@ -488,21 +504,7 @@ static void TF_Run_Helper(
 
   // Store results in c_outputs[]
   for (int i = 0; i < noutputs; ++i) {
-    const Tensor& src = outputs[i];
-    if (!src.IsInitialized() || src.NumElements() == 0) {
-      c_outputs[i] = tensorflow::EmptyTensor(
-          static_cast<TF_DataType>(src.dtype()), src.shape());
-      continue;
-    }
-    if (src.dtype() != tensorflow::DT_STRING) {
-      // Share the underlying buffer.
-      TensorBuffer* buf = tensorflow::TensorCApi::Buffer(src);
-      buf->Ref();
-      c_outputs[i] = new TF_Tensor{static_cast<TF_DataType>(src.dtype()),
-                                   src.shape(), buf};
-    } else {
-      c_outputs[i] = tensorflow::TF_Tensor_EncodeStrings(src);
-    }
+    c_outputs[i] = TF_Run_Output(outputs[i]);
   }
 }
 
@@ -662,6 +664,14 @@ struct TF_SessionWithGraph {
   int last_num_graph_nodes;
 };
 
+struct TF_PreparedRun {
+  TF_SessionWithGraph* session;
+  RunOptions run_options;
+  std::vector<tensorflow::string> input_names;
+  std::vector<tensorflow::string> output_names;
+  std::vector<tensorflow::string> target_names;
+};
+
 }  // end extern "C"
 
 // Helper functions -----------------------------------------------------------
@@ -1381,4 +1391,102 @@ void TF_SessionPRun(TF_SessionWithGraph* session, const char* handle,
                 output_values, target_names, nullptr, status);
 }
 
+TF_PreparedRun* TF_NewPreparedRun(TF_SessionWithGraph* session,
+                                  const TF_Buffer* run_options,
+                                  const TF_Port* inputs, int ninputs,
+                                  const TF_Port* outputs, int noutputs,
+                                  const TF_Operation* const* target_opers,
+                                  int ntargets, TF_Status* status) {
+  if (!ExtendSessionGraphHelper(session, status)) {
+    return nullptr;
+  }
+
+  std::unique_ptr<TF_PreparedRun> prepared(new TF_PreparedRun);
+  prepared->session = session;
+  if (run_options != nullptr &&
+      !prepared->run_options.ParseFromArray(run_options->data,
+                                            run_options->length)) {
+    status->status =
+        tensorflow::errors::InvalidArgument("Unparseable RunOptions proto");
+    return nullptr;
+  }
+
+  prepared->input_names.resize(ninputs);
+  for (int i = 0; i < ninputs; ++i) {
+    prepared->input_names[i] = PortName(inputs[i]);
+  }
+  prepared->output_names.resize(noutputs);
+  for (int i = 0; i < noutputs; ++i) {
+    prepared->output_names[i] = PortName(outputs[i]);
+  }
+  prepared->target_names.resize(ntargets);
+  for (int i = 0; i < ntargets; ++i) {
+    prepared->target_names[i] = target_opers[i]->node.name();
+  }
+  status->status = Status::OK();
+  return prepared.release();
+}
+
+void TF_DeletePreparedRun(TF_PreparedRun* prepared) { delete prepared; }
+
+void TF_PreparedRunExecute(TF_PreparedRun* prepared,
+                           TF_Tensor* const* input_values,
+                           TF_Tensor** output_values, TF_Status* status) {
+  status->status = Status::OK();
+
+  // Feed the caller's tensors without taking them over: the Tensors share
+  // their buffers, and the caller's references keep the buffers alive.
+  const int ninputs = prepared->input_names.size();
+  std::vector<std::pair<tensorflow::string, Tensor>> input_pairs(ninputs);
+  for (int i = 0; i < ninputs; ++i) {
+    TF_Tensor* src = input_values[i];
+    input_pairs[i].first = prepared->input_names[i];
+    if (src->dtype != TF_STRING) {
+      input_pairs[i].second = tensorflow::TensorCApi::MakeTensor(
+          src->dtype, src->shape, src->buffer);
+    } else if (!tensorflow::TF_Tensor_DecodeStrings(
+                   src, &input_pairs[i].second, status)) {
+      return;
+    }
+  }
+
+  const int noutputs = prepared->output_names.size();
+  std::vector<Tensor> outputs(noutputs);
+  RunMetadata run_metadata;
+  status->status = prepared->session->session->Run(
+      prepared->run_options, input_pairs, prepared->output_names,
+      prepared->target_names, &outputs, &run_metadata);
+  if (!status->status.ok()) return;
+
+  // Check all the buffers of the caller before storing any output, so that
+  // no new tensor is handed out on failure.
+  for (int i = 0; i < noutputs; ++i) {
+    const TF_Tensor* dst = output_values[i];
+    if (dst == nullptr) continue;
+    const Tensor& src = outputs[i];
+    if (dst->dtype != static_cast<TF_DataType>(src.dtype()) ||
+        src.dtype() == tensorflow::DT_STRING ||
+        TF_TensorByteSize(dst) != src.TotalBytes()) {
+      status->status = InvalidArgument(
+          "Output buffer ", i, " does not match output ",
+          prepared->output_names[i], " of type ",
+          tensorflow::DataTypeString(src.dtype()), " and shape ",
+          src.shape().DebugString());
+      return;
+    }
+  }
+
+  for (int i = 0; i < noutputs; ++i) {
+    const Tensor& src = outputs[i];
+    TF_Tensor* dst = output_values[i];
+    if (dst == nullptr) {
+      output_values[i] = TF_Run_Output(src);
+    } else {
+      dst->shape = src.shape();
+      const tensorflow::StringPiece data = src.tensor_data();
+      if (!data.empty()) memcpy(TF_TensorData(dst), data.data(), data.size());
+    }
+  }
+}
+
 }  // end extern "C"
@@ -585,6 +585,57 @@ extern void TF_SessionPRun(TF_SessionWithGraph*, const char* handle,
                            // Output status
                            TF_Status*);
 
+// A prepared run fixes the inputs, outputs and targets of the steps a
+// TF_SessionWithGraph runs, so that each step only passes the tensors.
+//
+// Preparing a run extends the session with the operations added to its
+// graph so far and converts the ports to tensor names once, instead of on
+// every step as TF_SessionRun() does.  A TF_PreparedRun is immutable, so
+// TF_PreparedRunExecute() may be called on the same one from many threads
+// at once, e.g. by the request handlers of a server.
+typedef struct TF_PreparedRun TF_PreparedRun;
+
+// Return a new prepared run of `session`, or NULL on error.  `run_options`
+// may be NULL, or point to a serialized `RunOptions` protocol buffer that
+// is parsed once and used for every step.  The prepared run must be deleted
+// before the session.
+extern TF_PreparedRun* TF_NewPreparedRun(
+    TF_SessionWithGraph* session,
+    // RunOptions
+    const TF_Buffer* run_options,
+    // Input names
+    const TF_Port* inputs, int ninputs,
+    // Output names
+    const TF_Port* outputs, int noutputs,
+    // Target operations
+    const TF_Operation* const* target_opers, int ntargets,
+    // Output status
+    TF_Status*);
+
+// Destroy a prepared run.
+extern void TF_DeletePreparedRun(TF_PreparedRun*);
+
+// Run one step of `prepared` on input_values[0,ninputs-1], which are in the
+// order of the inputs it was prepared with.
+//
+// Unlike TF_SessionRun(), the caller keeps the ownership of input_values[],
+// so that the same input tensors can be refilled and fed to later steps.
+// They must not be written to until the call returns.
+//
+// If output_values[i] is NULL, it is set to a new tensor that becomes the
+// property of the caller, as for TF_SessionRun().  Otherwise it must be a
+// tensor of the type and number of bytes of the i-th output (other than
+// TF_STRING), and the output is copied into it, so that a caller can reuse
+// the same output buffers for every step.  On failure, the NULL entries of
+// output_values[] stay NULL.
+extern void TF_PreparedRunExecute(TF_PreparedRun* prepared,
+                                  // Input tensors
+                                  TF_Tensor* const* input_values,
+                                  // Output tensors
+                                  TF_Tensor** output_values,
+                                  // Output status
+                                  TF_Status*);
+
 // --------------------------------------------------------------------------
 // The deprecated session API.  Please switch to the above instead of
 // TF_ExtendGraph().  TF_Session manages a single graph and execution.
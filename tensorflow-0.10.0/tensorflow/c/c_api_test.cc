@@ -20,6 +20,8 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/lib/core/error_codes.pb.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 
 using tensorflow::int32;
@@ -597,6 +599,7 @@ class CSessionWithGraph {
   }
 
   TF_Tensor* output_tensor(int i) { return output_values_[i]; }
+  TF_SessionWithGraph* session() { return session_; }
 
  private:
   void DeleteInputValues() {
@@ -679,6 +682,84 @@ TEST(CAPI, SessionWithGraph) {
   TF_DeleteStatus(s);
 }
 
+TEST(CAPI, PreparedRun) {
+  TF_Status* s = TF_NewStatus();
+  TF_Graph* graph = TF_NewGraph();
+  TF_Operation* feed = Placeholder(graph, s);
+  ASSERT_EQ(TF_OK, TF_GetCode(s)) << TF_Message(s);
+  TF_Operation* two = ScalarConst(2, graph, s);
+  ASSERT_EQ(TF_OK, TF_GetCode(s)) << TF_Message(s);
+  TF_Operation* add = Add(feed, two, graph, s);
+  ASSERT_EQ(TF_OK, TF_GetCode(s)) << TF_Message(s);
+  TF_Operation* neg = Neg(add, graph, s);
+  ASSERT_EQ(TF_OK, TF_GetCode(s)) << TF_Message(s);
+  CSessionWithGraph csession(graph, s);
+  ASSERT_EQ(TF_OK, TF_GetCode(s)) << TF_Message(s);
+
+  // The graph is extended with all four operations when preparing the run.
+  TF_Port input = {feed, 0};
+  TF_Port outputs[2] = {{add, 0}, {neg, 0}};
+  TF_PreparedRun* prepared = TF_NewPreparedRun(
+      csession.session(), nullptr, &input, 1, outputs, 2, nullptr, 0, s);
+  ASSERT_EQ(TF_OK, TF_GetCode(s)) << TF_Message(s);
+
+  // Each thread reuses one input and one output tensor for all its steps,
+  // and lets the run allocate the other output.
+  const int kNumThreads = 4;
+  const int kNumSteps = 50;
+  std::vector<int> num_errors(kNumThreads, 0);
+  {
+    tensorflow::thread::ThreadPool pool(tensorflow::Env::Default(),
+                                        "prepared_run", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([prepared, t, &num_errors]() {
+        TF_Status* status = TF_NewStatus();
+        TF_Tensor* input_value = Int32Tensor(0);
+        TF_Tensor* sum = Int32Tensor(0);
+        int32* input_data = static_cast<int32*>(TF_TensorData(input_value));
+        for (int step = 0; step < kNumSteps; ++step) {
+          const int32 value = t * kNumSteps + step;
+          *input_data = value;
+          TF_Tensor* output_values[2] = {sum, nullptr};
+          TF_PreparedRunExecute(prepared, &input_value, output_values, status);
+          if (TF_GetCode(status) != TF_OK ||
+              *static_cast<int32*>(TF_TensorData(sum)) != value + 2 ||
+              output_values[1] == nullptr ||
+              *static_cast<int32*>(TF_TensorData(output_values[1])) !=
+                  -(value + 2)) {
+            ++num_errors[t];
+          }
+          EXPECT_EQ(sum, output_values[0]);
+          if (output_values[1] != nullptr) TF_DeleteTensor(output_values[1]);
+        }
+        TF_DeleteTensor(sum);
+        TF_DeleteTensor(input_value);
+        TF_DeleteStatus(status);
+      });
+    }
+  }
+  EXPECT_EQ(std::vector<int>(kNumThreads, 0), num_errors);
+
+  // Output buffers of the wrong size are rejected.
+  TF_Tensor* input_value = Int32Tensor(1);
+  const int64_t dims[1] = {2};
+  TF_Tensor* wrong_size = TF_NewTensor(TF_INT32, dims, 1, new int32[2],
+                                       2 * sizeof(int32), &Int32Deallocator,
+                                       nullptr);
+  TF_Tensor* output_values[2] = {wrong_size, nullptr};
+  TF_PreparedRunExecute(prepared, &input_value, output_values, s);
+  EXPECT_EQ(TF_INVALID_ARGUMENT, TF_GetCode(s));
+  EXPECT_EQ(nullptr, output_values[1]);
+  TF_DeleteTensor(wrong_size);
+  TF_DeleteTensor(input_value);
+
+  TF_DeletePreparedRun(prepared);
+  csession.CloseAndDelete(s);
+  ASSERT_EQ(TF_OK, TF_GetCode(s)) << TF_Message(s);
+  TF_DeleteGraph(graph);
+  TF_DeleteStatus(s);
+}
+
 // TODO(josh11b): Test:
 // * TF_SetDevice(desc, "/job:worker");
 // * control inputs / outputs
@@ -13,24 +13,24 @@
 // the License.
 // ==============================================================================
 
-// TensorFlow kernels and Ops for constructing WALS normal equations.
+// TensorFlow kernels and Ops for constructing and solving WALS normal
+// equations.
 // TODO(agarwal,rmlarsen): Add security checks to the code.
 
 #include <algorithm>
+#include <numeric>
 #include <vector>
 
-// This is only used for std::this_thread::get_id()
-#include <thread>  // NOLINT
-
+#include "third_party/eigen3/Eigen/Cholesky"
+#include "third_party/eigen3/Eigen/Core"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
-#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
-#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 using tensorflow::DEVICE_CPU;
 using tensorflow::DT_BOOL;
@@ -140,132 +140,165 @@ class WALSComputePartialLhsAndRhsOp : public OpKernel {
     std::vector<int64> perm(num_nonzero_elements);
     std::iota(perm.begin(), perm.end(), 0);
 
-    typedef std::pair<int64, int64> Shard;
-    std::vector<Shard> shards;
-    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
-    const int num_threads = worker_threads.num_threads;
-    int64 shard_total = 0;
-    if (num_threads == 1) {
-      shards.emplace_back(0, num_nonzero_elements);
-      shard_total += num_nonzero_elements;
-    } else {
-      // Compute a permutation such that get_input_index(perm[i]) is sorted, use
-      // stable_sort to preserve spatial locality.
-      std::stable_sort(perm.begin(), perm.end(),
-                       [&get_input_index](int64 i, int64 j) {
-                         return get_input_index(i) < get_input_index(j);
-                       });
+    // Compute a permutation such that get_input_index(perm[i]) is sorted, use
+    // stable_sort to preserve spatial locality.
+    std::stable_sort(perm.begin(), perm.end(),
+                     [&get_input_index](int64 i, int64 j) {
+                       return get_input_index(i) < get_input_index(j);
+                     });
 
-      // Compute the start and end of runs with identical input_index.
-      // These are the shards of work that can be processed in parallel
-      // without locking.
-      int64 start = 0;
-      int64 end = 0;
-      while (end < num_nonzero_elements) {
-        start = end;
-        while (end < num_nonzero_elements &&
-               get_input_index(perm[start]) == get_input_index(perm[end])) {
-          ++end;
-        }
-        shards.emplace_back(start, end);
-        shard_total += end - start;
+    // Compute the start and end of runs with identical input_index.
+    // These are the units of work that can be processed in parallel
+    // without locking.
+    typedef std::pair<int64, int64> Run;
+    std::vector<Run> runs;
+    int64 end = 0;
+    while (end < num_nonzero_elements) {
+      const int64 start = end;
+      while (end < num_nonzero_elements &&
+             get_input_index(perm[start]) == get_input_index(perm[end])) {
+        ++end;
       }
+      runs.emplace_back(start, end);
     }
-    CHECK_EQ(shard_total, num_nonzero_elements);
-    CHECK_LE(shards.size(), num_nonzero_elements);
-    CHECK_GT(shards.size(), 0);
+    if (runs.empty()) return;
 
     // Batch the rank-one updates into a rank-k update to lower memory traffic
     const int kMaxBatchSize = 128;
 
-    // Since we do not have an easy way of generating thread id's within the
-    // range [0,num_threads), we can instead call out to an std::unordered_map
-    // of matrices and initialize the matrix on the first call.
-    // However, this might have a performance penalty, as memory allocation can
-    // cause the OS kernel to enter a critical section and temporarily disable
-    // parallelism, and the unordered_map must be protected with a read/write
-    // mutex.
-    //
-    // TODO(jpoulson): Simplify after the thread rank can be queried
-    std::unordered_map<size_t, Eigen::MatrixXf> factor_batch_map;
-    mutex map_mutex;
-
-    BlockingCounter counter(shards.size());
-    // Lambda encapsulating the per-shard computation.
-    auto work = [&](const Shard& shard) {
-      const std::thread::id thread_id = std::this_thread::get_id();
-      const size_t id_hash = std::hash<std::thread::id>()(thread_id);
-      // If this thread's unique factors_mat.rows() x kMaxBatchSize
-      // batching matrix has not yet been created, then emplace it into the
-      // map using the hash of the thread id as the key.
-      //
-      // TODO(jpoulson): Switch to try_emplace once C++17 is supported
-      map_mutex.lock();
-      const auto key_count = factor_batch_map.count(id_hash);
-      map_mutex.unlock();
-      if (!key_count) {
-        map_mutex.lock();
-        factor_batch_map.emplace(
-            std::piecewise_construct, std::forward_as_tuple(id_hash),
-            std::forward_as_tuple(factors_mat.rows(), kMaxBatchSize));
-        map_mutex.unlock();
-      }
-      map_mutex.lock();
-      auto& factor_batch = factor_batch_map[id_hash];
-      map_mutex.unlock();
+    // Each call of the lambda handles a block of consecutive runs, which
+    // write disjoint, consecutive slices of the outputs, with one batching
+    // matrix for the whole block.
+    auto work = [&](int64 begin_run, int64 end_run) {
+      Eigen::MatrixXf factor_batch(factor_dim, kMaxBatchSize);
+      for (int64 r = begin_run; r < end_run; ++r) {
+        const Run& run = runs[r];
+        const int64 input_index = get_input_index(perm[run.first]);
+        // Acccumulate the rhs and lhs terms in the normal equations
+        // for the non-zero elements in the row or column of the sparse matrix
+        // corresponding to input_index.
+        int num_batched = 0;
+        EigenMatrixFloatMap lhs_mat(output_lhs_tensor->flat<float>().data() +
+                                        input_index * factor_dim * factor_dim,
+                                    factor_dim, factor_dim);
+        auto lhs_symm = lhs_mat.selfadjointView<Eigen::Lower>();
+        for (int64 p = run.first; p < run.second; ++p) {
+          const int64 i = perm[p];
+          const int64 factor_index = get_factor_index(i);
+          const float input_value = input_values_vec(i);
+          const float weight = input_weights_vec(input_index) *
+                               factor_weights_vec(factor_index);
+          CHECK_GE(weight, 0);
+          factor_batch.col(num_batched) =
+              factors_mat.col(factor_index) * std::sqrt(weight);
+          ++num_batched;
+          if (num_batched == kMaxBatchSize) {
+            lhs_symm.rankUpdate(factor_batch);
+            num_batched = 0;
+          }
 
-      CHECK_GE(shard.first, 0);
-      CHECK_LE(shard.second, perm.size());
-      CHECK_LE(shard.first, shard.second);
-      const int64 input_index = get_input_index(perm[shard.first]);
-      // Acccumulate the rhs and lhs terms in the normal equations
-      // for the non-zero elements in the row or column of the sparse matrix
-      // corresponding to input_index.
-      int num_batched = 0;
-      EigenMatrixFloatMap lhs_mat(output_lhs_tensor->flat<float>().data() +
-                                      input_index * factor_dim * factor_dim,
-                                  factor_dim, factor_dim);
-      auto lhs_symm = lhs_mat.selfadjointView<Eigen::Lower>();
-      for (int64 p = shard.first; p < shard.second; ++p) {
-        const int64 i = perm[p];
-        // Check that all entries in the shard have the same input index.
-        CHECK_EQ(input_index, get_input_index(i));
-        const int64 factor_index = get_factor_index(i);
-        const float input_value = input_values_vec(i);
-        const float weight =
-            input_weights_vec(input_index) * factor_weights_vec(factor_index);
-        CHECK_GE(weight, 0);
-        factor_batch.col(num_batched) =
-            factors_mat.col(factor_index) * std::sqrt(weight);
-        ++num_batched;
-        if (num_batched == kMaxBatchSize) {
-          lhs_symm.rankUpdate(factor_batch);
-          num_batched = 0;
+          rhs_mat.col(input_index) +=
+              input_value * (w_0 + weight) * factors_mat.col(factor_index);
         }
-
-        rhs_mat.col(input_index) +=
-            input_value * (w_0 + weight) * factors_mat.col(factor_index);
-      }
-      if (num_batched != 0) {
-        auto factor_block =
-            factor_batch.block(0, 0, factors_mat.rows(), num_batched);
-        lhs_symm.rankUpdate(factor_block);
+        if (num_batched != 0) {
+          auto factor_block =
+              factor_batch.block(0, 0, factors_mat.rows(), num_batched);
+          lhs_symm.rankUpdate(factor_block);
+        }
+        // Copy lower triangular to upper triangular part of normal equation
+        // matrix.
+        lhs_mat = lhs_symm;
       }
-      // Copy lower triangular to upper triangular part of normal equation
-      // matrix.
-      lhs_mat = lhs_symm;
-      counter.DecrementCount();
     };
-    for (int i = 1; i < shards.size(); ++i) {
-      worker_threads.workers->Schedule(std::bind(work, shards[i]));
-    }
-    // Inline execute the 1st shard.
-    work(shards[0]);
-    counter.Wait();
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 cost_per_run =
+        (num_nonzero_elements / runs.size() + 1) * factor_dim * factor_dim;
+    Shard(worker_threads.num_threads, worker_threads.workers, runs.size(),
+          cost_per_run, work);
   }
 };
 
 REGISTER_KERNEL_BUILDER(Name("WALSComputePartialLhsAndRhs").Device(DEVICE_CPU),
                         WALSComputePartialLhsAndRhsOp);
 
+// Solves the normal equations (gramian + partial_lhs[i]) x = partial_rhs[i]
+// of the rows of a WALS block by Cholesky decomposition, sharding the rows
+// across the worker threads. Each shard decomposes its rows in the same
+// scratch matrices, so the solves allocate nothing per row.
+class WALSSolveNormalEquationsOp : public OpKernel {
+ public:
+  explicit WALSSolveNormalEquationsOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context,
+                   context->MatchSignature({DT_FLOAT, DT_FLOAT, DT_FLOAT},
+                                           {DT_FLOAT}));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& gramian = context->input(0);
+    const Tensor& partial_lhs = context->input(1);
+    const Tensor& partial_rhs = context->input(2);
+
+    OP_REQUIRES(context, TensorShapeUtils::IsSquareMatrix(gramian.shape()),
+                InvalidArgument("Input gramian should be a square matrix."));
+    const int64 factor_dim = gramian.dim_size(0);
+    OP_REQUIRES(context, TensorShapeUtils::IsMatrix(partial_rhs.shape()) &&
+                             partial_rhs.dim_size(1) == factor_dim,
+                InvalidArgument("Input partial_rhs should be a matrix with ",
+                                factor_dim, " columns."));
+    const int64 num_rows = partial_rhs.dim_size(0);
+    OP_REQUIRES(context, partial_lhs.shape() == TensorShape({num_rows,
+                                                             factor_dim,
+                                                             factor_dim}),
+                InvalidArgument("Input partial_lhs should have shape [",
+                                num_rows, ", ", factor_dim, ", ", factor_dim,
+                                "]."));
+
+    Tensor* output_tensor;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({num_rows, factor_dim}), &output_tensor));
+    if (num_rows == 0) return;
+
+    // All the matrices are symmetric, so their row-major storage maps
+    // to the same column-major matrices.
+    ConstEigenMatrixFloatMap gramian_mat(gramian.flat<float>().data(),
+                                         factor_dim, factor_dim);
+    ConstEigenMatrixFloatMap rhs_mat(partial_rhs.flat<float>().data(),
+                                     factor_dim, num_rows);
+    EigenMatrixFloatMap output_mat(output_tensor->flat<float>().data(),
+                                   factor_dim, num_rows);
+
+    mutex mu;
+    int64 failed_row = num_rows;
+    auto work = [&](int64 begin_row, int64 end_row) {
+      Eigen::MatrixXf lhs(factor_dim, factor_dim);
+      Eigen::LLT<Eigen::MatrixXf> llt(factor_dim);
+      for (int64 i = begin_row; i < end_row; ++i) {
+        lhs = gramian_mat +
+              ConstEigenMatrixFloatMap(partial_lhs.flat<float>().data() +
+                                           i * factor_dim * factor_dim,
+                                       factor_dim, factor_dim);
+        llt.compute(lhs);
+        if (llt.info() != Eigen::Success) {
+          mutex_lock l(mu);
+          failed_row = std::min(failed_row, i);
+          return;
+        }
+        output_mat.col(i) = llt.solve(rhs_mat.col(i));
+      }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    const int64 cost_per_row = factor_dim * factor_dim * factor_dim;
+    Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+          cost_per_row, work);
+    OP_REQUIRES(context, failed_row == num_rows,
+                InvalidArgument("Normal equations of row ", failed_row,
+                                " are not positive definite."));
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("WALSSolveNormalEquations").Device(DEVICE_CPU),
+                        WALSSolveNormalEquationsOp);
+
 }  // namespace tensorflow
@@ -43,4 +43,24 @@ partial_lhs: 3-D tensor with size input_block_size x k x k.
 partial_rhs: Matrix with size input_block_size x k.
 )");
 
+REGISTER_OP("WALSSolveNormalEquations")
+    .Input("gramian: float32")
+    .Input("partial_lhs: float32")
+    .Input("partial_rhs: float32")
+    .Output("solution: float32")
+    .Doc(R"(
+Solves the normal equations of a WALS update by Cholesky decomposition.
+
+Row i of solution solves (gramian + partial_lhs[i]) x = partial_rhs[i], whose
+matrix must be positive definite.
+
+gramian: Matrix of size k * k shared by all rows, e.g. the weighted gramian
+  of the factors plus the regularization.
+partial_lhs: 3-D tensor with size n x k x k, as computed by
+  WALSComputePartialLhsAndRhs.
+partial_rhs: Matrix with size n x k, as computed by
+  WALSComputePartialLhsAndRhs.
+solution: Matrix with size n x k.
+)");
+
 }  // namespace tensorflow
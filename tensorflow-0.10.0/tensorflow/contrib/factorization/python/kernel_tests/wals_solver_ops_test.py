@@ -23,6 +23,7 @@ import numpy as np
 
 import tensorflow as tf
 from tensorflow.contrib.factorization.python.ops.factorization_ops import wals_compute_partial_lhs_and_rhs
+from tensorflow.contrib.factorization.python.ops.factorization_ops import wals_solve_normal_equations
 
 
 def SparseBlock3x3():
@@ -79,6 +80,31 @@ class WalsSolverOpsTest(tf.test.TestCase):
           [[0.019300, 0.023000, 0.026700], [0.061600, 0.077000, 0.092400],
            [0.160400, 0.220000, 0.279600], [0.492800, 0.563200, 0.633600]])
 
+  def testWalsSolveNormalEquations(self):
+    sparse_block = SparseBlock3x3()
+    gramian = (self._unobserved_weights *
+               np.dot(self._column_factors.T, self._column_factors) +
+               np.eye(3, dtype=np.float32))
+    with self.test_session():
+      [lhs_tensor, rhs_matrix] = wals_compute_partial_lhs_and_rhs(
+          self._column_factors, self._column_weights, self._unobserved_weights,
+          self._row_weights, sparse_block.indices, sparse_block.values,
+          sparse_block.shape[0], False)
+      solution = wals_solve_normal_equations(gramian, lhs_tensor, rhs_matrix)
+      lhs, rhs, solution = lhs_tensor.eval(), rhs_matrix.eval(), solution.eval()
+      for i in range(4):
+        self.assertAllClose(solution[i],
+                            np.linalg.solve(gramian + lhs[i], rhs[i]))
+
+  def testWalsSolveNormalEquationsNotPositiveDefinite(self):
+    with self.test_session():
+      solution = wals_solve_normal_equations(
+          np.eye(2, dtype=np.float32),
+          np.array([[[0, 0], [0, 0]], [[-2, 0], [0, 0]]], dtype=np.float32),
+          np.ones([2, 2], dtype=np.float32))
+      with self.assertRaisesOpError("Normal equations of row 1"):
+        solution.eval()
+
 
 if __name__ == '__main__':
   tf.test.main()
@@ -454,10 +454,9 @@ class WALSModel(object):
           num_rows,
           transpose_input,
           name="wals_compute_partial_lhs_rhs")
-      total_lhs = tf.expand_dims(total_lhs, 0) + partial_lhs
-      total_rhs = tf.expand_dims(total_rhs, -1)
-      new_left_values = tf.squeeze(tf.batch_matrix_solve(total_lhs, total_rhs),
-                                   [2])
+      new_left_values = wals_solve_normal_equations(
+          total_lhs, partial_lhs, total_rhs,
+          name="wals_solve_normal_equations")
 
     return (new_left_values,
             self.scatter_update(left,
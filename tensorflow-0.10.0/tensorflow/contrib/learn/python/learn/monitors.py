@@ -793,7 +793,7 @@ class GraphDump(BaseMonitor):
   """
 
   IGNORE_OPS = ["Const", "Assign", "Identity", "Placeholder",
-                "RandomUniform", "Cast", "RestoreSlice"]
+                "RandomUniform", "Cast", "RestoreSlice", "RestoreSlices"]
 
   def __init__(self, ignore_ops=None):
     """Initializes GraphDump monitor.
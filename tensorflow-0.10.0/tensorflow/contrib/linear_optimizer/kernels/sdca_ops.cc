@@ -56,8 +56,19 @@ namespace tensorflow {
 
 namespace {
 
-using UnalignedFloatVector = TTypes<const float>::UnalignedConstVec;
-using UnalignedInt64Vector = TTypes<const int64>::UnalignedConstVec;
+// Adds 'value' to '*target' with a compare-and-swap loop, so that the shards
+// of a mini-batch can update the same delta weights Hogwild-style, without a
+// lock and without losing each other's updates.
+inline void AtomicAdd(float* const target, const float value) {
+  static_assert(sizeof(std::atomic<float>) == sizeof(float),
+                "std::atomic<float> must have the layout of a float");
+  std::atomic<float>* const atomic_target =
+      reinterpret_cast<std::atomic<float>*>(target);
+  float current = atomic_target->load(std::memory_order_relaxed);
+  while (!atomic_target->compare_exchange_weak(current, current + value,
+                                               std::memory_order_relaxed)) {
+  }
+}
 
 // Statistics computed with input (ModelWeights, Example).
 struct ExampleStatistics {
@@ -129,30 +140,29 @@ class Example {
 
  private:
   // Sparse features associated with the example.
-  // Indices and Values are the associated feature index, and values. Values
-  // can be optionally absent, in which we case we implicitly assume a value of
-  // 1.0f.
+  // Indices and Values are the associated feature index, and values, which
+  // point into the input tensors. Values can be optionally absent, in which we
+  // case we implicitly assume a value of 1.0f.
+  //
+  // The features are held by value, so that the inner loop walks over the
+  // contiguous features of an example instead of chasing a pointer per group.
   struct SparseFeatures {
-    std::unique_ptr<UnalignedInt64Vector> indices;
-    std::unique_ptr<UnalignedFloatVector> values;  // nullptr encodes optional.
+    float value(const int64 k) const {
+      return values == nullptr ? 1.0f : values[k];
+    }
+
+    const int64* indices = nullptr;
+    const float* values = nullptr;  // nullptr encodes optional.
+    int64 size = 0;
   };
   std::vector<SparseFeatures> sparse_features_;
 
   // A dense vector which is a row-slice of the underlying matrix.
   struct DenseVector {
-    // Returns a row slice from the matrix.
-    Eigen::TensorMap<Eigen::Tensor<const float, 1, Eigen::RowMajor>> row()
-        const {
-      // TensorMap to a row slice of the matrix.
-      return Eigen::TensorMap<Eigen::Tensor<const float, 1, Eigen::RowMajor>>(
-          data_matrix.data() + row_index * data_matrix.dimension(1),
-          data_matrix.dimension(1));
-    }
-
-    const TTypes<float>::ConstMatrix data_matrix;
-    const int64 row_index;
+    const float* data = nullptr;
+    int64 size = 0;
   };
-  std::vector<std::unique_ptr<DenseVector>> dense_vectors_;
+  std::vector<DenseVector> dense_vectors_;
 
   float example_label_ = 0;
   float example_weight_ = 0;
@@ -172,31 +182,30 @@ class ModelWeights {
   ModelWeights() {}
 
   // Go through all the features present in the example, and update the
-  // weights based on the dual delta.
-  void UpdateDeltaWeights(const Eigen::ThreadPoolDevice& device,
-                          const Example& example,
+  // weights based on the dual delta. May be called concurrently for
+  // different examples.
+  void UpdateDeltaWeights(const Example& example,
                           const double normalized_bounded_dual_delta) {
     // Sparse weights.
     for (size_t j = 0; j < sparse_weights_.size(); ++j) {
       const Example::SparseFeatures& sparse_features =
           example.sparse_features_[j];
-      FeatureWeights* const feature_weights = &sparse_weights_[j];
-      for (int64 k = 0; k < sparse_features.indices->size(); ++k) {
-        const double feature_value = sparse_features.values == nullptr
-                                         ? 1.0
-                                         : (*sparse_features.values)(k);
-        feature_weights->deltas((*sparse_features.indices)(k)) +=
-            feature_value * normalized_bounded_dual_delta;
+      float* const deltas = sparse_weights_[j].deltas.data();
+      for (int64 k = 0; k < sparse_features.size; ++k) {
+        AtomicAdd(&deltas[sparse_features.indices[k]],
+                  sparse_features.value(k) * normalized_bounded_dual_delta);
       }
     }
 
-    // Dense weights.
+    // Dense weights. The update is already run by a shard of the examples,
+    // so it does not go through the Eigen thread pool.
     for (size_t j = 0; j < dense_weights_.size(); ++j) {
-      const Example::DenseVector& dense_vector = *example.dense_vectors_[j];
-      TTypes<float>::Vec deltas = dense_weights_[j].deltas;
-      deltas.device(device) =
-          deltas +
-          dense_vector.row() * deltas.constant(normalized_bounded_dual_delta);
+      const Example::DenseVector& dense_vector = example.dense_vectors_[j];
+      float* const deltas = dense_weights_[j].deltas.data();
+      for (int64 k = 0; k < dense_vector.size; ++k) {
+        AtomicAdd(&deltas[k],
+                  dense_vector.data[k] * normalized_bounded_dual_delta);
+      }
     }
   }
 
@@ -277,31 +286,27 @@ const ExampleStatistics Example::ComputeWxAndWeightedExampleNorm(
     const ModelWeights::FeatureWeights& sparse_weights =
         model_weights.sparse_weights_[j];
 
-    for (int64 k = 0; k < sparse_features.indices->size(); ++k) {
-      const int64 feature_index = (*sparse_features.indices)(k);
-      const double feature_value = sparse_features.values == nullptr
-                                       ? 1.0
-                                       : (*sparse_features.values)(k);
+    for (int64 k = 0; k < sparse_features.size; ++k) {
+      const int64 feature_index = sparse_features.indices[k];
       const double feature_weight =
           sparse_weights.nominals(feature_index) +
           sparse_weights.deltas(feature_index) * num_partitions;
-      result.wx += feature_value * regularization.Shrink(feature_weight);
+      result.wx +=
+          sparse_features.value(k) * regularization.Shrink(feature_weight);
     }
   }
 
-  // Dense features contribution.
+  // Dense features contribution. A plain loop, rather than Eigen expressions
+  // that would allocate temporaries for every example.
   for (size_t j = 0; j < dense_vectors_.size(); ++j) {
-    const Example::DenseVector& dense_vector = *dense_vectors_[j];
+    const Example::DenseVector& dense_vector = dense_vectors_[j];
     const ModelWeights::FeatureWeights& dense_weights =
         model_weights.dense_weights_[j];
-
-    const Eigen::Tensor<float, 1, Eigen::RowMajor> feature_weights =
-        dense_weights.nominals +
-        dense_weights.deltas * dense_weights.deltas.constant(num_partitions);
-    const Eigen::Tensor<float, 0, Eigen::RowMajor> prediction =
-        (dense_vector.row() * regularization.EigenShrink(feature_weights))
-            .sum();
-    result.wx += prediction();
+    for (int64 k = 0; k < dense_vector.size; ++k) {
+      const double feature_weight =
+          dense_weights.nominals(k) + dense_weights.deltas(k) * num_partitions;
+      result.wx += dense_vector.data[k] * regularization.Shrink(feature_weight);
+    }
   }
 
   return result;
@@ -321,6 +326,9 @@ class Examples {
 
   int num_features() const { return num_features_; }
 
+  // Returns the number of sparse and dense feature values in all examples.
+  int64 num_feature_values() const { return num_feature_values_; }
+
   // Initialize() must be called immediately after construction.
   // TODO(sibyl-Aix6ihai): Refactor/shorten this function.
   Status Initialize(OpKernelContext* const context,
@@ -354,6 +362,14 @@ class Examples {
     TF_RETURN_IF_ERROR(
         context->input_list("dense_features", &dense_features_inputs));
 
+    num_feature_values_ = 0;
+    for (int i = 0; i < num_sparse_features; ++i) {
+      num_feature_values_ += sparse_feature_indices_inputs[i].NumElements();
+    }
+    for (int i = 0; i < num_dense_features; ++i) {
+      num_feature_values_ += dense_features_inputs[i].NumElements();
+    }
+
     examples_.clear();
     examples_.resize(num_examples);
     for (int example_id = 0; example_id < num_examples; ++example_id) {
@@ -385,30 +401,17 @@ class Examples {
                    example_indices(end_id) == example_id) {
               ++end_id;
             }
+            // Examples without features in this group keep no features.
             if (start_id < example_indices.size() &&
                 example_indices(start_id) == example_id) {
               Example::SparseFeatures* const sparse_features =
                   &examples_[example_id].sparse_features_[i];
-              sparse_features->indices.reset(new UnalignedInt64Vector(
-                  &(feature_indices(start_id)), end_id - start_id));
-              if (sparse_feature_values_inputs.size() > i) {
-                auto feature_weights =
-                    sparse_feature_values_inputs[i].flat<float>();
-                sparse_features->values.reset(new UnalignedFloatVector(
-                    &(feature_weights(start_id)), end_id - start_id));
-              }
-            } else {
-              Example::SparseFeatures* const sparse_features =
-                  &examples_[example_id].sparse_features_[i];
-              // Add a Tensor that has size 0.
-              sparse_features->indices.reset(
-                  new UnalignedInt64Vector(&(feature_indices(0)), 0));
-              // If values exist for this feature group.
+              sparse_features->indices = &(feature_indices(start_id));
+              sparse_features->size = end_id - start_id;
               if (sparse_feature_values_inputs.size() > i) {
                 auto feature_weights =
                     sparse_feature_values_inputs[i].flat<float>();
-                sparse_features->values.reset(
-                    new UnalignedFloatVector(&(feature_weights(0)), 0));
+                sparse_features->values = &(feature_weights(start_id));
               }
             }
           }
@@ -432,9 +435,12 @@ class Examples {
         for (int i = static_cast<int>(begin); i < end; ++i) {
           auto dense_features =
               dense_features_inputs[i].template matrix<float>();
+          const int64 row_size = dense_features.dimension(1);
           for (int example_id = 0; example_id < num_examples; ++example_id) {
-            examples_[example_id].dense_vectors_[i].reset(
-                new Example::DenseVector{dense_features, example_id});
+            Example::DenseVector* const dense_vector =
+                &examples_[example_id].dense_vectors_[i];
+            dense_vector->data = dense_features.data() + example_id * row_size;
+            dense_vector->size = row_size;
           }
         }
       };
@@ -456,17 +462,21 @@ class Examples {
             const Example::SparseFeatures& sparse_features =
                 examples_[example_id].sparse_features_[j];
             if (sparse_features.values) {
-              const Eigen::Tensor<float, 0, Eigen::RowMajor> sn =
-                  sparse_features.values->square().sum();
-              squared_norm += sn();
+              for (int64 k = 0; k < sparse_features.size; ++k) {
+                squared_norm += sparse_features.values[k] *
+                                static_cast<double>(sparse_features.values[k]);
+              }
             } else {
-              squared_norm += sparse_features.indices->size();
+              squared_norm += sparse_features.size;
             }
           }
           for (int j = 0; j < num_dense_features; ++j) {
-            const Eigen::Tensor<float, 0, Eigen::RowMajor> sn =
-                examples_[example_id].dense_vectors_[j]->row().square().sum();
-            squared_norm += sn();
+            const Example::DenseVector& dense_vector =
+                examples_[example_id].dense_vectors_[j];
+            for (int64 k = 0; k < dense_vector.size; ++k) {
+              squared_norm += dense_vector.data[k] *
+                              static_cast<double>(dense_vector.data[k]);
+            }
           }
           examples_[example_id].squared_norm_ = squared_norm;
         }
@@ -487,6 +497,8 @@ class Examples {
 
   int num_features_ = 0;
 
+  int64 num_feature_values_ = 0;
+
   TF_DISALLOW_COPY_AND_ASSIGN(Examples);
 };
 
@@ -590,7 +602,7 @@ class DistributedSdcaLargeBatchSolver : public OpKernel {
         const double normalized_bounded_dual_delta =
             (new_dual - dual) * example_weight /
             regularizations_.symmetric_l2();
-        model_weights.UpdateDeltaWeights(context->eigen_cpu_device(), example,
+        model_weights.UpdateDeltaWeights(example,
                                          normalized_bounded_dual_delta);
 
         // Update example data.
@@ -600,10 +612,15 @@ class DistributedSdcaLargeBatchSolver : public OpKernel {
         example_state_data(example_index, 3) = example_weight;
       }
     };
-    // TODO(sibyl-Aix6ihai): Tune this properly based on sparsity of the data,
-    // number of cpus, and cost per example.
+    // The shards update the shared delta weights concurrently (Hogwild), with
+    // atomic additions. Each example reads and updates each of its feature
+    // values once, at the cost of a shrink and a compare-and-swap, so the
+    // cost of an example is proportional to its average number of values.
+    const int64 kCostPerFeatureValue = 50;
     const int64 kCostPerUnit =
-        examples.num_examples() * examples.num_features();
+        kCostPerFeatureValue *
+        std::max<int64>(1, examples.num_feature_values() /
+                               std::max(1, examples.num_examples()));
     const DeviceBase::CpuWorkerThreads& worker_threads =
         *context->device()->tensorflow_cpu_worker_threads();
     Shard(worker_threads.num_threads, worker_threads.workers,
@@ -26,8 +26,11 @@ limitations under the License.
 
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "public/gemmlowp.h"
+#include "tensorflow/core/framework/device_base.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -543,6 +546,33 @@ class TensorflowGemmContext : public gemmlowp::MultiThreadGemmContextBase {
   TF_DISALLOW_COPY_AND_ASSIGN(TensorflowGemmContext);
 };
 
+// Finds the lowest and highest quantized values of a tensor, scanning parts of
+// it on the worker threads in parallel. An empty tensor yields the highest
+// value of T as the minimum and the lowest one as the maximum.
+template <class T>
+void FindMinAndMax(const DeviceBase::CpuWorkerThreads& worker_threads,
+                   const Tensor& input, T* min_value, T* max_value) {
+  const auto input_array = input.flat<T>();
+  const T highest = static_cast<int32>(Eigen::NumTraits<T>::highest());
+  const T lowest = static_cast<int32>(Eigen::NumTraits<T>::lowest());
+  *min_value = highest;
+  *max_value = lowest;
+  mutex mu;
+  Shard(worker_threads.num_threads, worker_threads.workers, input_array.size(),
+        /*cost_per_unit=*/1, [&](int64 start, int64 limit) {
+          T shard_min = highest;
+          T shard_max = lowest;
+          for (int64 i = start; i < limit; ++i) {
+            const T value = input_array(i);
+            shard_min = std::min(shard_min, value);
+            shard_max = std::max(shard_max, value);
+          }
+          mutex_lock lock(mu);
+          *min_value = std::min(*min_value, shard_min);
+          *max_value = std::max(*max_value, shard_max);
+        });
+}
+
 }  // namespace tensorflow
 
 #endif  // THIRD_PARTY_TENSORFLOW_CONTRIB_QUANTIZATION_KERNELS_QUANTIZATION_UTILS_H_
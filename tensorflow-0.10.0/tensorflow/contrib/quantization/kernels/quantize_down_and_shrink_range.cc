@@ -49,17 +49,10 @@ class QuantizeDownAndShrinkRangeOp : public OpKernel {
     OP_REQUIRES_OK(ctx, ctx->allocate_output(2, TensorShape({}), &output_max));
 
     auto input_array = input.flat<T1>();
-    const int32 input_lowest_quantized =
-        static_cast<int32>(Eigen::NumTraits<T1>::lowest());
-    const int32 input_highest_quantized =
-        static_cast<int32>(Eigen::NumTraits<T1>::highest());
-    T1 actual_min_quantized = input_highest_quantized;
-    T1 actual_max_quantized = input_lowest_quantized;
-    for (int i = 0; i < input_array.size(); ++i) {
-      const T1 value = input_array(i);
-      actual_min_quantized = std::min(actual_min_quantized, value);
-      actual_max_quantized = std::max(actual_max_quantized, value);
-    }
+    T1 actual_min_quantized;
+    T1 actual_max_quantized;
+    FindMinAndMax<T1>(*ctx->device()->tensorflow_cpu_worker_threads(), input,
+                      &actual_min_quantized, &actual_max_quantized);
     // We want to make sure that the minimum is no larger than zero, so that the
     // convolution operation can run efficiently.
     const float actual_min_float =
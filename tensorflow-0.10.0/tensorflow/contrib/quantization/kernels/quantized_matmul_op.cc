@@ -13,7 +13,13 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
-// Implements a quantized eight-bit version of the matmul operation.
+// Implements a quantized eight-bit version of the matmul operation, and one
+// fused with the bias addition, ReLU and requantization that follow it in
+// quantized fully connected layers.
+
+#include <algorithm>
+#include <limits>
+#include <vector>
 
 #include "public/gemmlowp.h"
 #include "tensorflow/contrib/quantization/kernels/quantization_utils.h"
@@ -27,10 +33,17 @@ namespace tensorflow {
 // We have to break this out as a separate function because there are multiple
 // combinations of transpose attributes we need to support, and they have to be
 // compile-time constants to work with the templates used internally.
-template <bool TransposeA, bool TransposeB, bool TransposeC>
-void GemmlowpMultiply(OpKernelContext* op_context, const quint8* a_data,
-                      const quint8* b_data, qint32* c_data, int m, int n, int k,
-                      int offset_a, int offset_b, int lda, int ldb, int ldc) {
+//
+// The output pipeline runs gemmlowp output stages on each block of the result
+// while it is still in cache.
+template <bool TransposeA, bool TransposeB, bool TransposeC,
+          typename OutputPipeline>
+void GemmlowpMultiplyWithPipeline(OpKernelContext* op_context,
+                                  const quint8* a_data, const quint8* b_data,
+                                  qint32* c_data, int m, int n, int k,
+                                  int offset_a, int offset_b, int lda, int ldb,
+                                  int ldc,
+                                  const OutputPipeline& output_pipeline) {
   const uint8* a_data_as_uint8 = &(a_data->value);
   const uint8* b_data_as_uint8 = &(b_data->value);
   int32* c_data_as_int32 = &(c_data->value);
@@ -46,14 +59,23 @@ void GemmlowpMultiply(OpKernelContext* op_context, const quint8* a_data,
                                                         ldb);
   gemmlowp::MatrixMap<std::int32_t, ResultOrder> result(c_data_as_int32, m, n,
                                                         ldc);
-  const std::tuple<> empty_pipeline = {};
   auto& worker_threads =
       *(op_context->device()->tensorflow_cpu_worker_threads());
   TensorflowGemmContext context(worker_threads.num_threads,
                                 worker_threads.workers);
   gemmlowp::GemmWithOutputPipeline<std::uint8_t, std::int32_t,
                                    gemmlowp::DefaultL8R8BitDepthParams>(
-      &context, lhs, rhs, &result, -offset_a, -offset_b, empty_pipeline);
+      &context, lhs, rhs, &result, -offset_a, -offset_b, output_pipeline);
+}
+
+template <bool TransposeA, bool TransposeB, bool TransposeC>
+void GemmlowpMultiply(OpKernelContext* op_context, const quint8* a_data,
+                      const quint8* b_data, qint32* c_data, int m, int n, int k,
+                      int offset_a, int offset_b, int lda, int ldb, int ldc) {
+  const std::tuple<> empty_pipeline = {};
+  GemmlowpMultiplyWithPipeline<TransposeA, TransposeB, TransposeC>(
+      op_context, a_data, b_data, c_data, m, n, k, offset_a, offset_b, lda, ldb,
+      ldc, empty_pipeline);
 }
 
 template <class T1, class T2, class Toutput>
@@ -183,4 +205,124 @@ REGISTER_KERNEL_BUILDER(Name("QuantizedMatMul")
                             .TypeConstraint<qint32>("Toutput"),
                         QuantizedMatMulOp<quint8, quint8, qint32>);
 
+// Computes relu(a * b + bias) in one op, with eight bit output. The bias is
+// added and the ReLU applied by the gemmlowp output pipeline on the 32 bit
+// accumulators, whose range is then found on the worker threads and which are
+// requantized into eight bits of that range. This replaces a QuantizedMatMul,
+// two QuantizeDownAndShrinkRange ops, a QuantizedBiasAdd and a QuantizedRelu,
+// which each make a pass over the layer, and keeps the full resolution of the
+// products until the final requantization.
+class QuantizedMatMulWithBiasAndReluOp : public OpKernel {
+ public:
+  explicit QuantizedMatMulWithBiasAndReluOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& a = context->input(0);
+    const Tensor& b = context->input(1);
+    const Tensor& bias = context->input(2);
+    const float min_a = context->input(3).flat<float>()(0);
+    const float max_a = context->input(4).flat<float>()(0);
+    const float min_b = context->input(5).flat<float>()(0);
+    const float max_b = context->input(6).flat<float>()(0);
+    const float min_bias = context->input(7).flat<float>()(0);
+    const float max_bias = context->input(8).flat<float>()(0);
+    OP_REQUIRES(context, (max_a > min_a),
+                errors::InvalidArgument("max_a must be larger than min_a."));
+    OP_REQUIRES(context, (max_b > min_b),
+                errors::InvalidArgument("max_b must be larger than min_b."));
+    OP_REQUIRES(context, TensorShapeUtils::IsMatrix(a.shape()),
+                errors::InvalidArgument("In[0] is not a matrix"));
+    OP_REQUIRES(context, TensorShapeUtils::IsMatrix(b.shape()),
+                errors::InvalidArgument("In[1] is not a matrix"));
+    OP_REQUIRES(context, a.dim_size(1) == b.dim_size(0),
+                errors::InvalidArgument("Matrix size-compatible: In[0]: ",
+                                        a.shape().DebugString(), ", In[1]: ",
+                                        b.shape().DebugString()));
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(bias.shape()) &&
+                             bias.dim_size(0) == b.dim_size(1),
+                errors::InvalidArgument("Bias must be a vector of size ",
+                                        b.dim_size(1), ", got ",
+                                        bias.shape().DebugString()));
+    const int m = a.dim_size(0);
+    const int n = b.dim_size(1);
+    const int k = a.dim_size(1);
+
+    // The bias and the zero of the ReLU in the units of the accumulators.
+    float min_c;
+    float max_c;
+    QuantizationRangeForMultiplication<quint8, quint8, qint32>(
+        min_a, max_a, min_b, max_b, &min_c, &max_c);
+    const auto bias_values = bias.flat<quint8>();
+    std::vector<std::int32_t> bias_accumulators(n);
+    for (int j = 0; j < n; ++j) {
+      bias_accumulators[j] = ClampToInt32(FloatToQuantizedUnclamped<qint32>(
+          QuantizedToFloat(bias_values(j), min_bias, max_bias), min_c, max_c));
+    }
+    typedef gemmlowp::VectorMap<const std::int32_t, gemmlowp::VectorShape::Row>
+        BiasVector;
+    gemmlowp::OutputStageBiasAddition<BiasVector> bias_stage;
+    bias_stage.bias_vector = BiasVector(bias_accumulators.data(), n);
+    gemmlowp::OutputStageClamp relu_stage;
+    relu_stage.min =
+        ClampToInt32(FloatToQuantizedUnclamped<qint32>(0.0f, min_c, max_c));
+    relu_stage.max = std::numeric_limits<std::int32_t>::max();
+
+    Tensor accumulators;
+    OP_REQUIRES_OK(context, context->allocate_temp(DT_QINT32,
+                                                   TensorShape({m, n}),
+                                                   &accumulators));
+    GemmlowpMultiplyWithPipeline<false, false, false>(
+        context, a.flat<quint8>().data(), b.flat<quint8>().data(),
+        accumulators.flat<qint32>().data(), m, n, k,
+        FloatToQuantizedUnclamped<quint8>(0.0f, min_a, max_a),
+        FloatToQuantizedUnclamped<quint8>(0.0f, min_b, max_b), k, n, n,
+        std::make_tuple(bias_stage, relu_stage));
+
+    // Like QuantizeDownAndShrinkRange, the output range starts at zero. An
+    // all zero output gets a unit range, so that the next layer can take it.
+    qint32 min_quantized;
+    qint32 max_quantized;
+    FindMinAndMax<qint32>(*context->device()->tensorflow_cpu_worker_threads(),
+                          accumulators, &min_quantized, &max_quantized);
+    const float min_output = 0.0f;
+    float max_output = 0.0f;
+    if (accumulators.NumElements() > 0) {
+      max_output = std::max(
+          min_output, QuantizedToFloat(max_quantized, min_c, max_c));
+    }
+    if (max_output <= min_output) max_output = min_output + 1.0f;
+
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, TensorShape({m, n}),
+                                                     &output));
+    if (output->NumElements() > 0) {
+      RequantizeManyInNewRangeUsingEigen<qint32, quint8>(
+          context->eigen_device<Eigen::ThreadPoolDevice>(), accumulators,
+          min_c, max_c, min_output, max_output, output);
+    }
+    Tensor* output_min = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(1, {}, &output_min));
+    output_min->flat<float>()(0) = min_output;
+    Tensor* output_max = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(2, {}, &output_max));
+    output_max->flat<float>()(0) = max_output;
+  }
+
+ private:
+  static std::int32_t ClampToInt32(int64 value) {
+    return std::min<int64>(std::max<int64>(value,
+                                           std::numeric_limits<int32>::min()),
+                           std::numeric_limits<int32>::max());
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("QuantizedMatMulWithBiasAndRelu")
+                            .Device(DEVICE_CPU)
+                            .TypeConstraint<quint8>("T1")
+                            .TypeConstraint<quint8>("T2")
+                            .TypeConstraint<quint8>("Tbias")
+                            .TypeConstraint<quint8>("out_type"),
+                        QuantizedMatMulWithBiasAndReluOp);
+
 }  // namespace tensorflow
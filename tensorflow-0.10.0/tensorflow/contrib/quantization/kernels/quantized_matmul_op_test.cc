@@ -333,4 +333,47 @@ TEST_F(QuantizedMatMulTest, Medium_WithParams) {
   test::ExpectTensorNear<float>(expected_float, output_float, 15.0);
 }
 
+// Runs the matrices of Small_NoParams through the fused op, with a bias that
+// makes some of the sums negative, so that the ReLU zeroes them.
+TEST_F(QuantizedMatMulTest, WithBiasAndRelu) {
+  TF_ASSERT_OK(NodeDefBuilder("quantized_mat_mul_op",
+                              "QuantizedMatMulWithBiasAndRelu")
+                   .Input(FakeInput(DT_QUINT8))
+                   .Input(FakeInput(DT_QUINT8))
+                   .Input(FakeInput(DT_QUINT8))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<quint8>(TensorShape({2, 3}), {1, 2, 3, 4, 5, 6});
+  AddInputFromArray<quint8>(TensorShape({3, 4}),
+                            {7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18});
+  // With a range of [-255, 255], the bias is |  -101 | -199 |  1 | -255 |.
+  AddInputFromArray<quint8>(TensorShape({4}), {77, 28, 128, 0});
+  AddInputFromArray<float>(TensorShape({1}), {0});
+  AddInputFromArray<float>(TensorShape({1}), {255.0f});
+  AddInputFromArray<float>(TensorShape({1}), {0});
+  AddInputFromArray<float>(TensorShape({1}), {255.0f});
+  AddInputFromArray<float>(TensorShape({1}), {-255.0f});
+  AddInputFromArray<float>(TensorShape({1}), {255.0f});
+
+  TF_ASSERT_OK(RunOpKernel());
+  // The sums of Small_NoParams plus the bias are:
+  // |  -27 | -119 |  87 | -163 |
+  // |   72 |  -11 | 204 |  -37 |
+  const float output_min = GetOutput(1)->flat<float>()(0);
+  const float output_max = GetOutput(2)->flat<float>()(0);
+  EXPECT_EQ(0.0f, output_min);
+  EXPECT_NEAR(204.0f, output_max, 1.0f);
+  Tensor expected_float(DT_FLOAT, TensorShape({2, 4}));
+  test::FillValues<float>(&expected_float, {0, 0, 87, 0, 72, 0, 204, 0});
+  Tensor output_float =
+      QuantizedTensorToFloat<quint8>(*GetOutput(0), output_min, output_max);
+  test::ExpectTensorNear<float>(expected_float, output_float, 1.0);
+}
+
 }  // namespace tensorflow
@@ -20,6 +20,7 @@ limitations under the License.
 
 namespace tensorflow {
 
+using shape_inference::Dimension;
 using shape_inference::InferenceContext;
 using shape_inference::Shape;
 
@@ -71,6 +72,67 @@ max_out: The float value that the highest quantized output value represents.
 
 )doc");
 
+REGISTER_OP("QuantizedMatMulWithBiasAndRelu")
+    .Input("a: T1")
+    .Input("b: T2")
+    .Input("bias: Tbias")
+    .Input("min_a: float")
+    .Input("max_a: float")
+    .Input("min_b: float")
+    .Input("max_b: float")
+    .Input("min_bias: float")
+    .Input("max_bias: float")
+    .Output("out: out_type")
+    .Output("min_out: float")
+    .Output("max_out: float")
+    .Attr("T1: quantizedtype")
+    .Attr("T2: quantizedtype")
+    .Attr("Tbias: quantizedtype")
+    .Attr("out_type: quantizedtype = DT_QUINT8")
+    .SetShapeFn([](InferenceContext* c) {
+      const Shape* a;
+      const Shape* b;
+      const Shape* bias;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 2, &a));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 2, &b));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(2), 1, &bias));
+      const Dimension* unused_dim;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(a, 1), c->Dim(b, 0), &unused_dim));
+      const Dimension* n;
+      TF_RETURN_IF_ERROR(c->Merge(c->Dim(b, 1), c->Dim(bias, 0), &n));
+      const Shape* unused;
+      for (int i = 3; i < 9; ++i) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 0, &unused));
+      }
+      c->set_output(0, c->Matrix(c->Dim(a, 0), n));
+      c->set_output(1, c->Scalar());
+      c->set_output(2, c->Scalar());
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Computes `relu(a * b + bias)` for quantized matrices `a` and `b`.
+
+This is the QuantizedMatMul, QuantizedBiasAdd and QuantizedRelu of a quantized
+fully connected layer in one op. The bias is added and the ReLU applied to the
+32 bit products before they are requantized, and the output is requantized into
+the range its values actually use, like QuantizeDownAndShrinkRange does. The
+output range always starts at zero.
+
+a: Must be a two-dimensional tensor.
+b: Must be a two-dimensional tensor whose outer dimension matches the inner
+  dimension of `a`.
+bias: A 1D bias Tensor with size matching the inner dimension of `b`.
+min_a: The float value that the lowest quantized `a` value represents.
+max_a: The float value that the highest quantized `a` value represents.
+min_b: The float value that the lowest quantized `b` value represents.
+max_b: The float value that the highest quantized `b` value represents.
+min_bias: The float value that the lowest quantized bias value represents.
+max_bias: The float value that the highest quantized bias value represents.
+min_out: The float value that the lowest quantized output value represents.
+max_out: The float value that the highest quantized output value represents.
+
+)doc");
+
 REGISTER_OP("QuantizeDownAndShrinkRange")
     .Input("input: Tinput")
     .Input("input_min: float")
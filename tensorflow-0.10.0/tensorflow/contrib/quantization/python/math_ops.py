@@ -36,3 +36,17 @@ def _QuantizedMatMulShape(op):
   result = common_shapes.matmul_shape(op)
   result.extend([tensor_shape.scalar(), tensor_shape.scalar()])
   return result
+
+
+@ops.RegisterShape("QuantizedMatMulWithBiasAndRelu")
+def _QuantizedMatMulWithBiasAndReluShape(op):
+  """Shape function for QuantizedMatMulWithBiasAndRelu op."""
+  a_shape = op.inputs[0].get_shape().with_rank(2)
+  b_shape = op.inputs[1].get_shape().with_rank(2)
+  bias_shape = op.inputs[2].get_shape().with_rank(1)
+  a_shape[1].assert_is_compatible_with(b_shape[0])
+  output_depth = b_shape[1].merge_with(bias_shape[0])
+  for unused_range in op.inputs[3:]:
+    unused_range.get_shape().merge_with(tensor_shape.scalar())
+  return [tensor_shape.TensorShape([a_shape[0], output_depth]),
+          tensor_shape.scalar(), tensor_shape.scalar()]
@@ -15,20 +15,28 @@ limitations under the License.
 
 #include "tensorflow/contrib/session_bundle/session_bundle.h"
 
+#include <algorithm>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "google/protobuf/any.pb.h"
 #include "tensorflow/contrib/session_bundle/manifest.pb.h"
+#include "tensorflow/contrib/session_bundle/shared_variables.h"
 #include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/tensor_id.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/types.h"
@@ -48,6 +56,80 @@ Status CreateSessionFromGraphDef(
   return (*session)->Create(graph);
 }
 
+// Replaces the CPU variables of graph_def by variables shared with the other
+// bundles of export_dir, held by holder during the load, and drops the restore
+// assignments of those already restored. Appends the names of the shared
+// variables to shared_variables.
+void ShareVariables(const StringPiece export_dir, const SaverDef& saver_def,
+                    GraphDef* graph_def, SharedVariableHolder* holder,
+                    std::vector<string>* shared_variables) {
+  std::unordered_set<string> restored;
+  for (NodeDef& node : *graph_def->mutable_node()) {
+    if (node.op() != "Variable" ||
+        StringPiece(str_util::Lowercase(node.device())).contains("gpu")) {
+      continue;
+    }
+    const string key = SharedVariableKey(export_dir, node.name());
+    node.set_op(kSharedVariableOp);
+    AddNodeAttr("key", key, &node);
+    shared_variables->push_back(node.name());
+    if (holder->Hold(key)) restored.insert(node.name());
+  }
+  if (restored.empty()) return;
+
+  // The assignments of the saver restoring the restored variables.
+  const string& restore_op = saver_def.restore_op_name();
+  const string saver_scope = restore_op.substr(0, restore_op.rfind('/') + 1);
+  std::unordered_set<string> dropped;
+  for (const NodeDef& node : graph_def->node()) {
+    if (node.op() == "Assign" && node.input_size() == 2 &&
+        StringPiece(node.name()).starts_with(saver_scope) &&
+        restored.count(ParseTensorName(node.input(0)).first.ToString()) > 0) {
+      dropped.insert(strings::StrCat("^", node.name()));
+    }
+  }
+  for (NodeDef& node : *graph_def->mutable_node()) {
+    auto* inputs = node.mutable_input();
+    inputs->erase(std::remove_if(inputs->begin(), inputs->end(),
+                                 [&dropped](const string& input) {
+                                   return dropped.count(input) > 0;
+                                 }),
+                  inputs->end());
+  }
+  LOG(INFO) << "Sharing " << shared_variables->size() << " variables, "
+            << restored.size() << " of them already restored";
+}
+
+// Returns the variable files of the export.
+std::vector<string> GetVariablesFiles(const StringPiece export_dir) {
+  std::vector<string> children;
+  std::vector<string> files;
+  if (!Env::Default()->GetChildren(export_dir.ToString(), &children).ok()) {
+    return files;
+  }
+  for (const string& child : children) {
+    if (child == "export" || (StringPiece(child).starts_with("export-") &&
+                              StringPiece(child).contains("-of-"))) {
+      files.push_back(io::JoinPath(export_dir, child));
+    }
+  }
+  return files;
+}
+
+// Reads the file and drops its content, so that it is in the file system
+// cache.
+void PrefetchFile(const string& filename) {
+  std::unique_ptr<RandomAccessFile> file;
+  if (!Env::Default()->NewRandomAccessFile(filename, &file).ok()) return;
+  const size_t kChunkSize = 4 << 20;
+  std::unique_ptr<char[]> scratch(new char[kChunkSize]);
+  uint64 offset = 0;
+  StringPiece chunk;
+  while (file->Read(offset, kChunkSize, &chunk, scratch.get()).ok()) {
+    offset += chunk.size();
+  }
+}
+
 Status GetMetaGraphDefFromExport(const StringPiece export_dir,
                                  tensorflow::MetaGraphDef* meta_graph_def) {
   const string meta_graph_def_path =
@@ -126,11 +208,42 @@ Status RunInitOp(const StringPiece export_dir,
 tensorflow::Status LoadSessionBundleFromPath(
     const tensorflow::SessionOptions& options, const StringPiece export_dir,
     SessionBundle* const bundle) {
+  return LoadSessionBundleFromPath(options, SessionBundleLoadOptions(),
+                                   export_dir, bundle);
+}
+
+void LoadSessionBundleFromPathAsync(
+    const SessionOptions& options, const SessionBundleLoadOptions& load_options,
+    const StringPiece export_dir, SessionBundle* bundle,
+    std::function<void(const Status&)> done) {
+  const string dir = export_dir.ToString();
+  Env::Default()->SchedClosure([options, load_options, dir, bundle, done]() {
+    done(LoadSessionBundleFromPath(options, load_options, dir, bundle));
+  });
+}
+
+tensorflow::Status LoadSessionBundleFromPath(
+    const tensorflow::SessionOptions& options,
+    const SessionBundleLoadOptions& load_options, const StringPiece export_dir,
+    SessionBundle* const bundle) {
   LOG(INFO) << "Attempting to load a SessionBundle from: " << export_dir;
   const int64 start_seconds = Env::Default()->NowSeconds();
   TF_RETURN_IF_ERROR(
       GetMetaGraphDefFromExport(export_dir, &(bundle->meta_graph_def)));
 
+  // Reads the variable files while the graph is set up.
+  std::unique_ptr<thread::ThreadPool> prefetch_pool;
+  if (load_options.num_prefetch_threads > 0) {
+    prefetch_pool.reset(new thread::ThreadPool(
+        Env::Default(), "session_bundle_prefetch",
+        load_options.num_prefetch_threads));
+    for (const string& filename : GetVariablesFiles(export_dir)) {
+      prefetch_pool->Schedule([filename]() { PrefetchFile(filename); });
+    }
+  }
+  SharedVariableHolder shared_variable_holder;
+  std::vector<string> shared_variables;
+
   const auto& collection_def_map = bundle->meta_graph_def.collection_def();
   const auto graph_it = bundle->meta_graph_def.collection_def().find(kGraphKey);
   if (graph_it != collection_def_map.end()) {
@@ -153,6 +266,16 @@ tensorflow::Status LoadSessionBundleFromPath(
       return errors::FailedPrecondition("Failed to unpack: ",
                                         any.DebugString());
     }
+    if (load_options.share_variables) {
+      ShareVariables(export_dir, bundle->meta_graph_def.saver_def(),
+                     &graph_def, &shared_variable_holder, &shared_variables);
+    }
+    TF_RETURN_IF_ERROR(
+        CreateSessionFromGraphDef(options, graph_def, &bundle->session));
+  } else if (load_options.share_variables) {
+    tensorflow::GraphDef graph_def = bundle->meta_graph_def.graph_def();
+    ShareVariables(export_dir, bundle->meta_graph_def.saver_def(), &graph_def,
+                   &shared_variable_holder, &shared_variables);
     TF_RETURN_IF_ERROR(
         CreateSessionFromGraphDef(options, graph_def, &bundle->session));
   } else {
@@ -183,11 +306,18 @@ tensorflow::Status LoadSessionBundleFromPath(
     }
   }
 
+  prefetch_pool.reset();
   TF_RETURN_IF_ERROR(
       RunRestoreOp(export_dir, asset_files,
                    bundle->meta_graph_def.saver_def().restore_op_name(),
                    bundle->meta_graph_def.saver_def().filename_tensor_name(),
                    bundle->session.get()));
+  if (!shared_variables.empty()) {
+    // Creates the kernels of all the shared variables, which then keep them
+    // alive after the holder releases them.
+    TF_RETURN_IF_ERROR(
+        bundle->session->Run({}, {}, shared_variables, nullptr));
+  }
 
   const auto init_op_it = collection_def_map.find(kInitOpKey);
   if (init_op_it != collection_def_map.end()) {
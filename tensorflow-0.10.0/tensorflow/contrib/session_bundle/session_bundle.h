@@ -18,6 +18,7 @@ limitations under the License.
 #ifndef THIRD_PARTY_TENSORFLOW_CONTRIB_SESSION_BUNDLE_SESSION_BUNDLE_H_
 #define THIRD_PARTY_TENSORFLOW_CONTRIB_SESSION_BUNDLE_SESSION_BUNDLE_H_
 
+#include <functional>
 #include <memory>
 
 #include "tensorflow/contrib/session_bundle/manifest.pb.h"
@@ -47,11 +48,38 @@ struct SessionBundle {
   MetaGraphDef meta_graph_def;
 };
 
+// Options for loading a SessionBundle, beyond those of its session.
+struct SessionBundleLoadOptions {
+  // If true, the CPU variables of the bundle are shared with all the bundles
+  // loaded with this option from the same export directory, and only those
+  // not restored yet by one of them are restored. This keeps a single copy of
+  // the variables when a model is reloaded, e.g. to swap its sessions without
+  // downtime, so the variables must not be updated after the restore.
+  bool share_variables = false;
+
+  // The number of threads reading the variable files while the session is
+  // created, so that the restore op then reads them from the file system
+  // cache. 0 disables the prefetch.
+  int num_prefetch_threads = 0;
+};
+
 // Loads a manifest and initialized session using the output of an Exporter
 // using the format defined at go/tf-exporter.
 Status LoadSessionBundleFromPath(const SessionOptions& options,
                                  const StringPiece export_dir,
                                  SessionBundle* bundle);
+Status LoadSessionBundleFromPath(const SessionOptions& options,
+                                 const SessionBundleLoadOptions& load_options,
+                                 const StringPiece export_dir,
+                                 SessionBundle* bundle);
+
+// Loads the bundle like LoadSessionBundleFromPath() on another thread, and
+// calls 'done' with the status when it is loaded. The bundle must stay alive
+// until then.
+void LoadSessionBundleFromPathAsync(
+    const SessionOptions& options, const SessionBundleLoadOptions& load_options,
+    const StringPiece export_dir, SessionBundle* bundle,
+    std::function<void(const Status&)> done);
 
 // Sanity checks whether the directory looks like an export directory. Note that
 // we don't try to load any data in this method.
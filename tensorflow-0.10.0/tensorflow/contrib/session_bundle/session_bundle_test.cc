@@ -20,12 +20,14 @@ limitations under the License.
 #include <vector>
 
 #include "google/protobuf/any.pb.h"
+#include "tensorflow/contrib/session_bundle/shared_variables.h"
 #include "tensorflow/contrib/session_bundle/signature.h"
 #include "tensorflow/contrib/session_bundle/test_util.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/platform/test.h"
@@ -78,6 +80,28 @@ Status CopyExport(const string& export_path, const string& variables_filename,
   return Status::OK();
 }
 
+// Checks that the bundle computes half plus two.
+void ExpectHalfPlusTwo(const SessionBundle& bundle) {
+  Tensor input = test::AsTensor<float>({0, 1, 2, 3}, TensorShape({4, 1}));
+
+  // Recover the Tensor names of our inputs and outputs.
+  Signatures signatures;
+  TF_ASSERT_OK(GetSignatures(bundle.meta_graph_def, &signatures));
+  ASSERT_TRUE(signatures.default_signature().has_regression_signature());
+  const tensorflow::serving::RegressionSignature regression_signature =
+      signatures.default_signature().regression_signature();
+
+  const string input_name = regression_signature.input().tensor_name();
+  const string output_name = regression_signature.output().tensor_name();
+
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(
+      bundle.session->Run({{input_name, input}}, {output_name}, {}, &outputs));
+  ASSERT_EQ(outputs.size(), 1);
+  test::ExpectTensorEqual<float>(
+      outputs[0], test::AsTensor<float>({2, 2.5, 3, 3.5}, TensorShape({4, 1})));
+}
+
 void BasicTest(const string& export_path) {
   tensorflow::SessionOptions options;
   SessionBundle bundle;
@@ -103,25 +127,7 @@ void BasicTest(const string& export_path) {
           TensorShape({})),
       path_outputs[1]);
 
-  // Validate the half plus two behavior.
-  Tensor input = test::AsTensor<float>({0, 1, 2, 3}, TensorShape({4, 1}));
-
-  // Recover the Tensor names of our inputs and outputs.
-  Signatures signatures;
-  TF_ASSERT_OK(GetSignatures(bundle.meta_graph_def, &signatures));
-  ASSERT_TRUE(signatures.default_signature().has_regression_signature());
-  const tensorflow::serving::RegressionSignature regression_signature =
-      signatures.default_signature().regression_signature();
-
-  const string input_name = regression_signature.input().tensor_name();
-  const string output_name = regression_signature.output().tensor_name();
-
-  std::vector<Tensor> outputs;
-  TF_ASSERT_OK(
-      bundle.session->Run({{input_name, input}}, {output_name}, {}, &outputs));
-  ASSERT_EQ(outputs.size(), 1);
-  test::ExpectTensorEqual<float>(
-      outputs[0], test::AsTensor<float>({2, 2.5, 3, 3.5}, TensorShape({4, 1})));
+  ExpectHalfPlusTwo(bundle);
 }
 
 TEST(LoadSessionBundleFromPath, BasicTensorFlowContrib) {
@@ -277,6 +283,46 @@ TEST_F(SessionBundleTest, InitOp_TooManyValues) {
       << status_.error_message();
 }
 
+TEST_F(SessionBundleTest, LoadAsync) {
+  const string export_path = SetupExport([](MetaGraphDef*) {});
+  SessionBundleLoadOptions load_options;
+  load_options.num_prefetch_threads = 2;
+  Notification loaded;
+  LoadSessionBundleFromPathAsync(options_, load_options, export_path, &bundle_,
+                                 [this, &loaded](const Status& status) {
+                                   status_ = status;
+                                   loaded.Notify();
+                                 });
+  loaded.WaitForNotification();
+  TF_ASSERT_OK(status_);
+  ExpectHalfPlusTwo(bundle_);
+}
+
+TEST_F(SessionBundleTest, SharedVariables) {
+  const string export_path = SetupExport([](MetaGraphDef*) {});
+  SessionBundleLoadOptions load_options;
+  load_options.share_variables = true;
+  TF_ASSERT_OK(
+      LoadSessionBundleFromPath(options_, load_options, export_path, &bundle_));
+  ExpectHalfPlusTwo(bundle_);
+  const int num_shared_variables = NumSharedVariables();
+  EXPECT_GT(num_shared_variables, 0);
+
+  // The second bundle does not restore the shared variables at all.
+  TF_ASSERT_OK(Env::Default()->DeleteFile(
+      io::JoinPath(export_path, kVariablesFilename)));
+  SessionBundle second_bundle;
+  TF_ASSERT_OK(LoadSessionBundleFromPath(options_, load_options, export_path,
+                                         &second_bundle));
+  EXPECT_EQ(num_shared_variables, NumSharedVariables());
+
+  // The variables outlive the first bundle.
+  bundle_.session.reset();
+  ExpectHalfPlusTwo(second_bundle);
+  second_bundle.session.reset();
+  EXPECT_EQ(0, NumSharedVariables());
+}
+
 TEST_F(SessionBundleTest, PossibleExportDirectory) {
   const string export_path = SetupExport([](MetaGraphDef*) {});
   EXPECT_TRUE(IsPossibleExportDirectory(export_path));
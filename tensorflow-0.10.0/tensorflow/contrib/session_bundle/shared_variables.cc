@@ -0,0 +1,161 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/contrib/session_bundle/shared_variables.h"
+
+#include <unordered_map>
+
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+namespace serving {
+namespace {
+
+// A shared variable, counting the kernels and holders using it.
+struct SharedVariable {
+  mutex mu;
+  Tensor tensor GUARDED_BY(mu);
+  int users = 0;  // Guarded by the mutex of the registry.
+};
+
+// The shared variables of the process by key.
+class SharedVariableRegistry {
+ public:
+  static SharedVariableRegistry* Global() {
+    static SharedVariableRegistry* registry = new SharedVariableRegistry;
+    return registry;
+  }
+
+  // Returns the variable with the given key, created if needed, for one more
+  // user.
+  SharedVariable* Acquire(const string& key) {
+    mutex_lock l(mu_);
+    SharedVariable*& variable = variables_[key];
+    if (variable == nullptr) variable = new SharedVariable;
+    ++variable->users;
+    return variable;
+  }
+
+  // Releases the variable with the given key for one user, deleting it after
+  // its last user.
+  void Release(const string& key) {
+    mutex_lock l(mu_);
+    auto it = variables_.find(key);
+    CHECK(it != variables_.end()) << "Unknown shared variable " << key;
+    if (--it->second->users == 0) {
+      delete it->second;
+      variables_.erase(it);
+    }
+  }
+
+  int size() {
+    mutex_lock l(mu_);
+    return variables_.size();
+  }
+
+ private:
+  mutex mu_;
+  std::unordered_map<string, SharedVariable*> variables_ GUARDED_BY(mu_);
+};
+
+// The kernel of the _SharedVariable op, like the one of the Variable op except
+// that its tensor lives in the registry.
+class SharedVariableOp : public OpKernel {
+ public:
+  explicit SharedVariableOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("key", &key_));
+    dtype_ = RemoveRefType(context->output_type(0));
+    variable_ = SharedVariableRegistry::Global()->Acquire(key_);
+    mutex_lock l(variable_->mu);
+    if (!variable_->tensor.IsInitialized()) variable_->tensor = Tensor(dtype_);
+  }
+
+  ~SharedVariableOp() override {
+    SharedVariableRegistry::Global()->Release(key_);
+  }
+
+  void Compute(OpKernelContext* context) override {
+    {
+      mutex_lock l(variable_->mu);
+      OP_REQUIRES(context, variable_->tensor.dtype() == dtype_,
+                  errors::InvalidArgument("Shared variable ", key_, " holds ",
+                                          DataTypeString(
+                                              variable_->tensor.dtype()),
+                                          ", not ", DataTypeString(dtype_)));
+    }
+    // The reference is valid as long as *this is alive, since it is a user of
+    // the variable.
+    context->set_output_ref(0, &variable_->mu, &variable_->tensor);
+  }
+
+ private:
+  DataType dtype_;
+  string key_;
+  SharedVariable* variable_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedVariableOp);
+};
+
+}  // namespace
+
+REGISTER_OP("_SharedVariable")
+    .Output("ref: Ref(dtype)")
+    .Attr("shape: shape")
+    .Attr("dtype: type")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .Attr("key: string")
+    .SetIsStateful()
+    .Doc(R"doc(
+Holds a variable shared with the sessions of other bundles of the same export.
+
+ref: A reference to the variable tensor.
+shape: The shape of the variable tensor.
+dtype: The type of elements in the variable tensor.
+container: Unused, kept from the replaced Variable op.
+shared_name: Unused, kept from the replaced Variable op.
+key: The key of the variable in the process.
+)doc");
+
+REGISTER_KERNEL_BUILDER(Name("_SharedVariable").Device(DEVICE_CPU),
+                        SharedVariableOp);
+
+string SharedVariableKey(StringPiece export_dir, StringPiece name) {
+  return strings::StrCat(export_dir, ":", name);
+}
+
+SharedVariableHolder::~SharedVariableHolder() {
+  for (const string& key : keys_) {
+    SharedVariableRegistry::Global()->Release(key);
+  }
+}
+
+bool SharedVariableHolder::Hold(const string& key) {
+  SharedVariable* variable = SharedVariableRegistry::Global()->Acquire(key);
+  keys_.push_back(key);
+  mutex_lock l(variable->mu);
+  return variable->tensor.IsInitialized();
+}
+
+int NumSharedVariables() { return SharedVariableRegistry::Global()->size(); }
+
+}  // namespace serving
+}  // namespace tensorflow
@@ -0,0 +1,65 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Variables shared by the sessions of the bundles loaded from one export.
+
+#ifndef THIRD_PARTY_TENSORFLOW_CONTRIB_SESSION_BUNDLE_SHARED_VARIABLES_H_
+#define THIRD_PARTY_TENSORFLOW_CONTRIB_SESSION_BUNDLE_SHARED_VARIABLES_H_
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/macros.h"
+
+namespace tensorflow {
+namespace serving {
+
+// The op replacing the variables of graphs whose variables are shared. It
+// takes the attrs of the Variable op, plus the "key" of the shared variable,
+// and outputs a reference to the tensor of the shared variable, which lives in
+// the process as long as some kernel or SharedVariableHolder uses it.
+const char kSharedVariableOp[] = "_SharedVariable";
+
+// Returns the key under which the variable 'name' of the export in
+// 'export_dir' is shared.
+string SharedVariableKey(StringPiece export_dir, StringPiece name);
+
+// Keeps shared variables alive, e.g. while a session whose kernels will use
+// them is set up.
+class SharedVariableHolder {
+ public:
+  SharedVariableHolder() {}
+
+  // Releases the held variables.
+  ~SharedVariableHolder();
+
+  // Holds the shared variable with the given key, creating it if needed, and
+  // returns whether it holds a value.
+  bool Hold(const string& key);
+
+ private:
+  std::vector<string> keys_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SharedVariableHolder);
+};
+
+// Returns the number of shared variables in the process.
+int NumSharedVariables();
+
+}  // namespace serving
+}  // namespace tensorflow
+
+#endif  // THIRD_PARTY_TENSORFLOW_CONTRIB_SESSION_BUNDLE_SHARED_VARIABLES_H_
@@ -21,18 +21,12 @@
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
-using tensorforest::CHILDREN_INDEX;
-using tensorforest::FEATURE_INDEX;
-using tensorforest::LEAF_NODE;
-using tensorforest::FREE_NODE;
-
 using tensorforest::CheckTensorBounds;
-using tensorforest::DataColumnTypes;
-using tensorforest::FeatureSpec;
-using tensorforest::Sum;
+using tensorforest::FlatTree;
 
 REGISTER_OP("TreePredictions")
   .Attr("valid_leaf_threshold: float")
@@ -147,97 +141,77 @@ class TreePredictions : public OpKernel {
     if (!CheckTensorBounds(context, tree_thresholds)) return;
     if (!CheckTensorBounds(context, node_per_class_weights)) return;
 
-    const int32 num_classes = static_cast<int32>(
-        node_per_class_weights.shape().dim_size(1));
-    const int32 num_nodes = static_cast<int32>(
-        tree_tensor.shape().dim_size(0));
-    int32 num_data;
-    std::function<bool(int, int, float,
-                       tensorforest::DataColumnTypes)> decide_function;
+    // The tree is packed for inference, which takes one sequential pass over
+    // its nodes, and the inputs then descend it in batches.
+    FlatTree tree;
+    OP_REQUIRES_OK(context, tree.Init(tree_tensor, tree_thresholds,
+                                      node_per_class_weights, input_spec,
+                                      valid_leaf_threshold_));
 
+    int32 num_data;
     if (sparse_input) {
       num_data = sparse_input_shape.unaligned_flat<int64>()(0);
-      decide_function = [&sparse_input_indices, &sparse_input_values](
-          int32 i, int32 feature, float bias, DataColumnTypes type) {
-        const auto sparse_indices = sparse_input_indices.matrix<int64>();
-        const auto sparse_values = sparse_input_values.vec<float>();
-        return tensorforest::DecideSparseNode(
-            sparse_indices, sparse_values, i, feature, bias, type);
-      };
     } else {
       num_data = static_cast<int32>(input_data.shape().dim_size(0));
       int32 num_features = 0;
       if (num_data > 0) {
         num_features = input_data.NumElements() / num_data;
       }
-      decide_function = [&input_data](
-          int32 i, int32 feature, float bias, DataColumnTypes type) {
-        const auto input_matrix = input_data.matrix<float>();
-        return tensorforest::DecideDenseNode(
-            input_matrix, i, feature, bias, type);
-      };
+      OP_REQUIRES(context, num_data == 0 || tree.max_feature() < num_features,
+                  errors::InvalidArgument(
+                      "Tree splits on feature ", tree.max_feature(),
+                      " of inputs with ", num_features, " features"));
     }
 
     Tensor* output_predictions = nullptr;
     TensorShape output_shape;
     output_shape.AddDim(num_data);
-    output_shape.AddDim(num_classes - 1);
+    output_shape.AddDim(tree.num_outputs());
     OP_REQUIRES_OK(context,
                    context->allocate_output(0, output_shape,
                                             &output_predictions));
     auto out = output_predictions->tensor<float, 2>();
 
-    const auto node_pcw = node_per_class_weights.tensor<float, 2>();
-    const auto tree = tree_tensor.tensor<int32, 2>();
-    const auto thresholds = tree_thresholds.unaligned_flat<float>();
-
-    for (int i = 0; i < num_data; i++) {
-      int node_index = 0;
-      int parent = -1;
-      while (true) {
-        OP_REQUIRES(context, FastBoundsCheck(node_index, num_nodes),
-                    errors::InvalidArgument("node_index not in valid range."))
-        const int32 left_child = tree(node_index, CHILDREN_INDEX);
-        if (left_child == LEAF_NODE) {
-          float sum = node_pcw(node_index, 0);
-          float parent_weight = 0.0;
-          if (sum < valid_leaf_threshold_ && parent >= 0) {
-            VLOG(1) << "not enough samples at leaf, including parent counts."
-                    << "child sum = " << sum;
-            float parent_sum = node_pcw(parent, 0);
-            // Weight the parent's counts just enough so that the new sum is
-            // valid_leaf_threshold_, but never give any counts a weight of
-            // more than 1.
-            parent_weight = std::min(1.0f,
-                                (valid_leaf_threshold_ - sum) / parent_sum);
-            sum += parent_weight * parent_sum;
-            VLOG(1) << "Sum w/ parent included = " << sum;
-          }
-          for (int c = 1; c < num_classes; c++) {
-            float w = node_pcw(node_index, c);
-            if (parent_weight > 0.0) {
-              w += parent_weight * node_pcw(parent, c);
-            }
-            out(i, c - 1) = w / sum;
-          }
-          break;
-        } else if (left_child == FREE_NODE) {
-          LOG(ERROR) << "Reached a free node, not good.";
-          return;
-        }
-        parent = node_index;
-        const int32 feature = tree(node_index, FEATURE_INDEX);
-        node_index =
-            left_child + decide_function(i, feature, thresholds(node_index),
-                                         FeatureSpec(feature, input_spec));
-      }
+    if (sparse_input) {
+      const auto sparse_indices = sparse_input_indices.matrix<int64>();
+      const auto sparse_values = sparse_input_values.vec<float>();
+      Predict(context, tree, num_data,
+              [&sparse_indices, &sparse_values](int32 i, int32 feature) {
+                return tensorforest::FindSparseValue(
+                    sparse_indices, sparse_values, i, feature);
+              },
+              output_predictions);
+    } else if (num_data > 0) {
+      const auto input_matrix = input_data.matrix<float>();
+      Predict(context, tree, num_data,
+              [&input_matrix](int32 i, int32 feature) {
+                return input_matrix(i, feature);
+              },
+              output_predictions);
     }
 
-    VLOG(1) << "tree: " << tree;
+    VLOG(1) << "tree: " << tree_tensor.tensor<int32, 2>();
     VLOG(1) << "output: " << out;
   }
 
  private:
+  // Computes the predictions of the inputs on the worker threads, where
+  // value(i, feature) returns the feature of input i.
+  template <typename ValueFunction>
+  static void Predict(OpKernelContext* context, const FlatTree& tree,
+                      int32 num_data, const ValueFunction& value,
+                      Tensor* predictions) {
+    float* output = predictions->flat<float>().data();
+    const int64 num_outputs = tree.num_outputs();
+    auto work = [&tree, &value, output, num_outputs](int64 start, int64 end) {
+      tree.Predict(static_cast<int32>(start), static_cast<int32>(end), value,
+                   output + start * num_outputs);
+    };
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_data, 100,
+          work);
+  }
+
   float valid_leaf_threshold_;
 };
 
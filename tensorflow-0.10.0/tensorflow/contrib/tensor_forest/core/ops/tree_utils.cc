@@ -14,6 +14,7 @@
 // =============================================================================
 #include "tensorflow/contrib/tensor_forest/core/ops/tree_utils.h"
 #include <cfloat>
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/platform/logging.h"
 
 namespace tensorflow {
@@ -266,5 +267,86 @@ bool IsAllInitialized(const Tensor& features) {
 }
 
 
+Status FlatTree::Init(const Tensor& tree, const Tensor& tree_thresholds,
+                      const Tensor& node_per_class_weights,
+                      const Tensor& input_spec, float valid_leaf_threshold) {
+  const auto tree_matrix = tree.tensor<int32, 2>();
+  const auto thresholds = tree_thresholds.unaligned_flat<float>();
+  const auto node_pcw = node_per_class_weights.tensor<float, 2>();
+  const int32 num_nodes = static_cast<int32>(tree.shape().dim_size(0));
+  const int32 num_classes =
+      static_cast<int32>(node_per_class_weights.shape().dim_size(1));
+  num_outputs_ = num_classes - 1;
+  max_feature_ = -1;
+  left_child_.clear();
+  feature_.clear();
+  threshold_.clear();
+  type_.clear();
+  leaf_probabilities_.clear();
+  if (num_nodes == 0) {
+    return errors::InvalidArgument("node_index not in valid range.");
+  }
+
+  // The original indices of the packed nodes in breadth-first order, and
+  // those of their parents.
+  std::vector<int32> nodes = {0};
+  std::vector<int32> parents = {-1};
+  std::vector<bool> reached(num_nodes, false);
+  reached[0] = true;
+  int32 num_leaves = 0;
+  for (size_t n = 0; n < nodes.size(); ++n) {
+    const int32 node = nodes[n];
+    const int32 left_child = tree_matrix(node, CHILDREN_INDEX);
+    if (left_child == LEAF_NODE) {
+      left_child_.push_back(-1 - num_leaves);
+      ++num_leaves;
+      feature_.push_back(0);
+      threshold_.push_back(0.0f);
+      type_.push_back(kDataFloat);
+
+      // Leaves with too few samples are backed off to their parent, see
+      // TreePredictions.
+      const int32 parent = parents[n];
+      float sum = node_pcw(node, 0);
+      float parent_weight = 0.0;
+      if (sum < valid_leaf_threshold && parent >= 0) {
+        const float parent_sum = node_pcw(parent, 0);
+        parent_weight =
+            std::min(1.0f, (valid_leaf_threshold - sum) / parent_sum);
+        sum += parent_weight * parent_sum;
+      }
+      for (int c = 1; c < num_classes; c++) {
+        float w = node_pcw(node, c);
+        if (parent_weight > 0.0) {
+          w += parent_weight * node_pcw(parent, c);
+        }
+        leaf_probabilities_.push_back(w / sum);
+      }
+      continue;
+    }
+    if (left_child == FREE_NODE) {
+      return errors::InvalidArgument("Reached a free node.");
+    }
+    for (const int32 child : {left_child, left_child + 1}) {
+      if (!FastBoundsCheck(child, num_nodes) || reached[child]) {
+        return errors::InvalidArgument("node_index not in valid range.");
+      }
+      reached[child] = true;
+      nodes.push_back(child);
+      parents.push_back(node);
+    }
+    const int32 feature = tree_matrix(node, FEATURE_INDEX);
+    if (feature < 0) {
+      return errors::InvalidArgument("Split on negative feature ", feature);
+    }
+    left_child_.push_back(nodes.size() - 2);
+    feature_.push_back(feature);
+    threshold_.push_back(thresholds(node));
+    type_.push_back(FeatureSpec(feature, input_spec));
+    max_feature_ = std::max(max_feature_, feature);
+  }
+  return Status::OK();
+}
+
 }  // namespace tensorforest
 }  // namespace tensorflow
@@ -15,7 +15,9 @@
 #ifndef THIRD_PARTY_TENSORFLOW_CONTRIB_TENSOR_FOREST_CORE_OPS_TREE_UTILS_H_
 #define THIRD_PARTY_TENSORFLOW_CONTRIB_TENSOR_FOREST_CORE_OPS_TREE_UTILS_H_
 
+#include <algorithm>
 #include <limits>
+#include <vector>
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -206,6 +208,92 @@ inline bool CheckTensorBounds(OpKernelContext* context, const Tensor& tensor) {
   return true;
 }
 
+// A tree packed for inference. The nodes reachable from the root are
+// renumbered breadth-first, so that the top levels, which every input visits,
+// are contiguous and the two children of a node stay adjacent, and each node
+// field is stored in its own array. The per-class probabilities of the leaves,
+// backed off to their parents as in TreePredictions, are computed once when
+// the tree is packed.
+class FlatTree {
+ public:
+  FlatTree() {}
+
+  // Packs the tree given by the tree, tree_thresholds and
+  // node_per_class_weights inputs of TreePredictions. Fails if a free node or
+  // a node out of range is reachable from the root.
+  Status Init(const Tensor& tree, const Tensor& tree_thresholds,
+              const Tensor& node_per_class_weights, const Tensor& input_spec,
+              float valid_leaf_threshold);
+
+  // Number of probabilities predicted for each input.
+  int32 num_outputs() const { return num_outputs_; }
+
+  // Largest feature split on, or -1 if the tree is a single leaf.
+  int32 max_feature() const { return max_feature_; }
+
+  // Writes the probabilities of inputs [begin, end) to consecutive rows of
+  // num_outputs() floats at output, where value(i, feature) returns the
+  // feature of input i. The inputs descend the tree in batches, one level at
+  // a time, so that the loads of the nodes of a batch overlap.
+  template <typename ValueFunction>
+  void Predict(int32 begin, int32 end, const ValueFunction& value,
+               float* output) const;
+
+ private:
+  static const int32 kBatchSize = 64;
+
+  // Index of the left child of each internal node, and -1 - the leaf index of
+  // each leaf.
+  std::vector<int32> left_child_;
+
+  // Split feature, threshold and feature type of each node.
+  std::vector<int32> feature_;
+  std::vector<float> threshold_;
+  std::vector<DataColumnTypes> type_;
+
+  // Probabilities of each leaf, num_outputs_ per leaf.
+  std::vector<float> leaf_probabilities_;
+
+  int32 num_outputs_ = 0;
+  int32 max_feature_ = -1;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FlatTree);
+};
+
+template <typename ValueFunction>
+void FlatTree::Predict(int32 begin, int32 end, const ValueFunction& value,
+                       float* output) const {
+  int32 nodes[kBatchSize];
+  for (int32 start = begin; start < end; start += kBatchSize) {
+    const int32 size =
+        std::min(static_cast<int32>(kBatchSize), end - start);
+    std::fill(nodes, nodes + size, 0);
+    bool descending = true;
+    while (descending) {
+      descending = false;
+      for (int32 j = 0; j < size; ++j) {
+        const int32 node = nodes[j];
+        const int32 left_child = left_child_[node];
+        if (left_child < 0) continue;
+        const float feature_value = value(start + j, feature_[node]);
+        const bool right =
+            type_[node] == kDataFloat
+                ? feature_value > threshold_[node]
+                : Decide(feature_value, threshold_[node], type_[node]);
+        nodes[j] = left_child + right;
+        descending = true;
+      }
+    }
+    for (int32 j = 0; j < size; ++j) {
+      const float* probabilities =
+          leaf_probabilities_.data() +
+          static_cast<int64>(-1 - left_child_[nodes[j]]) * num_outputs_;
+      std::copy(probabilities, probabilities + num_outputs_,
+                output + static_cast<int64>(start - begin + j) * num_outputs_);
+    }
+  }
+}
+
 }  // namespace tensorforest
 }  // namespace tensorflow
 
@@ -15,6 +15,7 @@
 #include "tensorflow/contrib/tensor_forest/core/ops/tree_utils.h"
 #include "testing/base/public/gunit.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 
 namespace tensorflow {
 namespace tensorforest {
@@ -201,6 +202,73 @@ TEST(BestFeatureRegression, NoWinner) {
                                   split_squares, 2), 0);
 }
 
+TEST(TestFlatTree, PredictsLikeTheTree) {
+  // Node 0 splits on feature 1 into nodes 3 and 4, node 4 on feature 0 into
+  // nodes 1 and 2, and the node_pcw rows of the leaves 1, 2 and 3 sum to 4.
+  Tensor tree = test::AsTensor<int32>({3, 1, -1, 0, -1, 0, -1, 0, 1, 0},
+                                      {5, 2});
+  Tensor thresholds = test::AsTensor<float>({0, 0, 0, 0, 5});
+  Tensor node_pcw = test::AsTensor<float>(
+      {12, 6, 6, 4, 3, 1, 4, 1, 3, 4, 2, 2, 8, 4, 4}, {5, 3});
+  Tensor input_spec = test::AsTensor<int32>({kDataFloat});
+  FlatTree flat_tree;
+  TF_EXPECT_OK(flat_tree.Init(tree, thresholds, node_pcw, input_spec, 0));
+  EXPECT_EQ(flat_tree.num_outputs(), 2);
+  EXPECT_EQ(flat_tree.max_feature(), 1);
+
+  // More inputs than fit in one batch.
+  const int32 num_data = 100;
+  std::vector<float> output(num_data * 2);
+  flat_tree.Predict(0, num_data, [](int32 i, int32 feature) {
+    return feature == 0 ? i % 10 : i % 3 - 1.0f;
+  }, output.data());
+  for (int32 i = 0; i < num_data; ++i) {
+    if (i % 3 - 1.0f <= 0) {
+      EXPECT_FLOAT_EQ(output[2 * i], 0.5);
+    } else if (i % 10 <= 5) {
+      EXPECT_FLOAT_EQ(output[2 * i], 0.75);
+    } else {
+      EXPECT_FLOAT_EQ(output[2 * i], 0.25);
+    }
+    EXPECT_FLOAT_EQ(output[2 * i] + output[2 * i + 1], 1);
+  }
+}
+
+TEST(TestFlatTree, BacksOffToParent) {
+  Tensor tree = test::AsTensor<int32>({1, 0, -1, 0, -1, 0}, {3, 2});
+  Tensor thresholds = test::AsTensor<float>({0, 0, 0});
+  Tensor node_pcw = test::AsTensor<float>(
+      {15, 3, 9, 3, 5, 1, 1, 3, 25, 5, 20, 0}, {3, 4});
+  Tensor input_spec = test::AsTensor<int32>({kDataFloat});
+  FlatTree flat_tree;
+  TF_EXPECT_OK(flat_tree.Init(tree, thresholds, node_pcw, input_spec, 10));
+  std::vector<float> output(6);
+  flat_tree.Predict(0, 2, [](int32 i, int32 feature) { return i; },
+                    output.data());
+  EXPECT_FLOAT_EQ(output[0], 0.2);
+  EXPECT_FLOAT_EQ(output[1], 0.4);
+  EXPECT_FLOAT_EQ(output[2], 0.4);
+  EXPECT_FLOAT_EQ(output[3], 0.2);
+  EXPECT_FLOAT_EQ(output[4], 0.8);
+  EXPECT_FLOAT_EQ(output[5], 0.0);
+}
+
+TEST(TestFlatTree, RejectsBadTrees) {
+  Tensor thresholds = test::AsTensor<float>({0, 0, 0});
+  Tensor node_pcw = test::AsTensor<float>({1, 1, 1, 1, 1, 1}, {3, 2});
+  Tensor input_spec = test::AsTensor<int32>({kDataFloat});
+  FlatTree flat_tree;
+  EXPECT_FALSE(flat_tree.Init(test::AsTensor<int32>({1, 0, -2, 0, -1, 0},
+                                                    {3, 2}),
+                              thresholds, node_pcw, input_spec, 0).ok());
+  EXPECT_FALSE(flat_tree.Init(test::AsTensor<int32>({2, 0, -1, 0, -1, 0},
+                                                    {3, 2}),
+                              thresholds, node_pcw, input_spec, 0).ok());
+  EXPECT_FALSE(flat_tree.Init(test::AsTensor<int32>({0, 0, -1, 0, -1, 0},
+                                                    {3, 2}),
+                              thresholds, node_pcw, input_spec, 0).ok());
+}
+
 }  // namespace tensorforest
 }  // namespace tensorflow
 
@@ -0,0 +1,59 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/cpu_affinity.h"
+
+#include <algorithm>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+Status ParseCpuList(StringPiece list, std::vector<int>* cpus) {
+  cpus->clear();
+  for (const string& item : str_util::Split(list, ',', str_util::SkipEmpty())) {
+    const std::vector<string> bounds = str_util::Split(item, '-');
+    int32 first;
+    int32 last;
+    if (bounds.size() > 2 || !strings::safe_strto32(bounds[0], &first) ||
+        !strings::safe_strto32(bounds.back(), &last) || first < 0 ||
+        last < first) {
+      return errors::InvalidArgument("Invalid CPU list entry '", item,
+                                     "' in '", list, "'");
+    }
+    for (int cpu = first; cpu <= last; ++cpu) cpus->push_back(cpu);
+  }
+  std::sort(cpus->begin(), cpus->end());
+  cpus->erase(std::unique(cpus->begin(), cpus->end()), cpus->end());
+  return Status::OK();
+}
+
+ThreadOptions ThreadOptionsFromSessionOptions(const SessionOptions& options) {
+  ThreadOptions thread_options;
+  const Status s =
+      ParseCpuList(options.config.cpu_affinity(), &thread_options.cpu_affinity);
+  if (!s.ok()) {
+    LOG(ERROR) << "Ignoring cpu_affinity: " << s;
+    thread_options.cpu_affinity.clear();
+  }
+  thread_options.spin_wait_micros =
+      std::max<int64>(0, options.config.thread_pool_spin_wait_micros());
+  return thread_options;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,42 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMMON_RUNTIME_CPU_AFFINITY_H_
+#define TENSORFLOW_COMMON_RUNTIME_CPU_AFFINITY_H_
+
+#include <vector>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+
+// Parses a comma separated list of CPUs and ranges of CPUs, like
+// "0-7,16-23", into the sorted CPU numbers it names. An empty list is
+// parsed into no CPUs.
+Status ParseCpuList(StringPiece list, std::vector<int>* cpus);
+
+// Returns the options of the threads of a session with the given options,
+// which run on the CPUs of ConfigProto.cpu_affinity and spin for
+// ConfigProto.thread_pool_spin_wait_micros when idle. An invalid list is
+// logged and ignored; DirectSession rejects such options when the session
+// is created.
+ThreadOptions ThreadOptionsFromSessionOptions(const SessionOptions& options);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_COMMON_RUNTIME_CPU_AFFINITY_H_
@@ -0,0 +1,60 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/cpu_affinity.h"
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(CpuAffinityTest, ParsesCpusAndRanges) {
+  std::vector<int> cpus;
+  TF_EXPECT_OK(ParseCpuList("4,0-2,16-17,1", &cpus));
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 4, 16, 17}), cpus);
+  TF_EXPECT_OK(ParseCpuList("", &cpus));
+  EXPECT_TRUE(cpus.empty());
+}
+
+TEST(CpuAffinityTest, RejectsInvalidLists) {
+  std::vector<int> cpus;
+  for (const char* list : {"a", "1-", "3-1", "-1", "1-2-3", "0,x"}) {
+    EXPECT_TRUE(errors::IsInvalidArgument(ParseCpuList(list, &cpus))) << list;
+  }
+}
+
+TEST(CpuAffinityTest, ThreadOptionsFromSessionOptions) {
+  SessionOptions options;
+  EXPECT_TRUE(ThreadOptionsFromSessionOptions(options).cpu_affinity.empty());
+  options.config.set_cpu_affinity("0-1");
+  EXPECT_EQ(std::vector<int>({0, 1}),
+            ThreadOptionsFromSessionOptions(options).cpu_affinity);
+  options.config.set_cpu_affinity("1-0");
+  EXPECT_TRUE(ThreadOptionsFromSessionOptions(options).cpu_affinity.empty());
+}
+
+TEST(CpuAffinityTest, SpinWaitFromSessionOptions) {
+  SessionOptions options;
+  EXPECT_EQ(0, ThreadOptionsFromSessionOptions(options).spin_wait_micros);
+  options.config.set_thread_pool_spin_wait_micros(50);
+  EXPECT_EQ(50, ThreadOptionsFromSessionOptions(options).spin_wait_micros);
+  options.config.set_thread_pool_spin_wait_micros(-1);
+  EXPECT_EQ(0, ThreadOptionsFromSessionOptions(options).spin_wait_micros);
+}
+
+}  // namespace
+}  // namespace tensorflow
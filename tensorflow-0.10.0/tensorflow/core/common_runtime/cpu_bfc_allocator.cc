@@ -0,0 +1,41 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/cpu_bfc_allocator.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Limit of the pool when ConfigProto.cpu_pool_memory_limit_bytes is 0.
+const int64 kDefaultMemoryLimit = 32LL << 30;
+
+}  // namespace
+
+CPUBFCAllocator::CPUBFCAllocator(size_t total_memory)
+    : BFCAllocator(new CPUMemAllocator, total_memory, true /*allow_growth*/,
+                   "cpu_bfc") {}
+
+Allocator* ProcessCPUBFCAllocator(const ConfigProto& config) {
+  static Allocator* allocator = [&config]() {
+    const int64 limit = config.cpu_pool_memory_limit_bytes() > 0
+                            ? config.cpu_pool_memory_limit_bytes()
+                            : kDefaultMemoryLimit;
+    return new CPUBFCAllocator(limit);
+  }();
+  return allocator;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,61 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMMON_RUNTIME_CPU_BFC_ALLOCATOR_H_
+#define TENSORFLOW_COMMON_RUNTIME_CPU_BFC_ALLOCATOR_H_
+
+#include "tensorflow/core/common_runtime/bfc_allocator.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+
+namespace tensorflow {
+
+// A CPU memory allocator that implements a 'best-fit with coalescing'
+// algorithm, like GPUBFCAllocator, over regions of host memory obtained as
+// needed. Freed tensors are kept in its bins for later allocations instead of
+// going back to malloc.
+class CPUBFCAllocator : public BFCAllocator {
+ public:
+  explicit CPUBFCAllocator(size_t total_memory);
+  ~CPUBFCAllocator() override {}
+
+  TF_DISALLOW_COPY_AND_ASSIGN(CPUBFCAllocator);
+};
+
+// Suballocator for CPU memory.
+class CPUMemAllocator : public SubAllocator {
+ public:
+  CPUMemAllocator() {}
+  ~CPUMemAllocator() override {}
+
+  void* Alloc(size_t alignment, size_t num_bytes) override {
+    return port::aligned_malloc(num_bytes, alignment);
+  }
+
+  void Free(void* ptr, size_t num_bytes) override { port::aligned_free(ptr); }
+
+  TF_DISALLOW_COPY_AND_ASSIGN(CPUMemAllocator);
+};
+
+// Returns the process-wide CPUBFCAllocator of the CPU devices of sessions
+// with use_cpu_memory_pool set. The first call creates it, with the memory
+// limit of the given config.
+Allocator* ProcessCPUBFCAllocator(const ConfigProto& config);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_COMMON_RUNTIME_CPU_BFC_ALLOCATOR_H_
@@ -0,0 +1,87 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/cpu_bfc_allocator.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(CPUBFCAllocatorTest, AllocatesAlignedDistinctBuffers) {
+  CPUBFCAllocator a(1 << 24);
+  std::vector<void*> ptrs;
+  for (int s = 1; s < 1024; s += 7) {
+    void* raw = a.AllocateRaw(Allocator::kAllocatorAlignment, s);
+    ASSERT_NE(nullptr, raw);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(raw) %
+                     Allocator::kAllocatorAlignment);
+    memset(raw, 1, s);
+    ptrs.push_back(raw);
+  }
+  std::sort(ptrs.begin(), ptrs.end());
+  for (size_t i = 1; i < ptrs.size(); ++i) {
+    EXPECT_NE(ptrs[i - 1], ptrs[i]);
+  }
+  for (void* ptr : ptrs) a.DeallocateRaw(ptr);
+
+  AllocatorStats stats;
+  a.GetStats(&stats);
+  EXPECT_EQ(0, stats.bytes_in_use);
+  EXPECT_EQ(static_cast<int64>(ptrs.size()), stats.num_allocs);
+}
+
+TEST(CPUBFCAllocatorTest, RespectsMemoryLimit) {
+  CPUBFCAllocator a(1 << 20);
+  void* raw = a.AllocateRaw(Allocator::kAllocatorAlignment, 1 << 19);
+  EXPECT_NE(nullptr, raw);
+  AllocationAttributes no_retry;
+  no_retry.no_retry_on_failure = true;
+  EXPECT_EQ(nullptr,
+            a.AllocateRaw(Allocator::kAllocatorAlignment, 1 << 20, no_retry));
+  a.DeallocateRaw(raw);
+}
+
+TEST(CPUBFCAllocatorTest, SessionOptionSelectsPoolForCPUDevices) {
+  SessionOptions options;
+  options.config.set_use_cpu_memory_pool(true);
+  std::vector<Device*> devices;
+  DeviceFactory::GetFactory("CPU")->CreateDevices(
+      options, "/job:localhost/replica:0/task:0", &devices);
+  ASSERT_FALSE(devices.empty());
+  for (Device* device : devices) {
+    EXPECT_EQ("cpu_bfc", device->GetAllocator(AllocatorAttributes())->Name());
+    delete device;
+  }
+
+  SessionOptions default_options;
+  devices.clear();
+  DeviceFactory::GetFactory("CPU")->CreateDevices(
+      default_options, "/job:localhost/replica:0/task:0", &devices);
+  ASSERT_FALSE(devices.empty());
+  EXPECT_EQ(cpu_allocator(),
+            devices[0]->GetAllocator(AllocatorAttributes()));
+  for (Device* device : devices) delete device;
+}
+
+}  // namespace
+}  // namespace tensorflow
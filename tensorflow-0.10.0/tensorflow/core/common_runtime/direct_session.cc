@@ -20,6 +20,7 @@ limitations under the License.
 #include <vector>
 
 #include "tensorflow/core/common_runtime/constant_folding.h"
+#include "tensorflow/core/common_runtime/cpu_affinity.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/common_runtime/executor.h"
 #include "tensorflow/core/common_runtime/function.h"
@@ -41,6 +42,7 @@ limitations under the License.
 #include "tensorflow/core/graph/graph_partition.h"
 #include "tensorflow/core/graph/subgraph.h"
 #include "tensorflow/core/graph/tensor_id.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/core/refcount.h"
@@ -56,6 +58,7 @@ limitations under the License.
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/core/util/sampling_tracer.h"
 
 namespace tensorflow {
 
@@ -72,7 +75,9 @@ thread::ThreadPool* NewThreadPoolFromSessionOptions(
     const SessionOptions& options) {
   const int32 num_threads = NumInterOpThreadsFromSessionOptions(options);
   VLOG(1) << "Direct session inter op parallelism threads: " << num_threads;
-  return new thread::ThreadPool(options.env, "Compute", num_threads);
+  return new thread::ThreadPool(
+      options.env, ThreadOptionsFromSessionOptions(options), "Compute",
+      num_threads, options.config.use_work_stealing_thread_pools());
 }
 
 thread::ThreadPool* NewThreadPoolFromThreadPoolOptions(
@@ -85,7 +90,9 @@ thread::ThreadPool* NewThreadPoolFromThreadPoolOptions(
   VLOG(1) << "Direct session inter op parallelism threads for pool "
           << pool_number << ": " << num_threads;
   return new thread::ThreadPool(
-      options.env, strings::StrCat("Compute", pool_number), num_threads);
+      options.env, ThreadOptionsFromSessionOptions(options),
+      strings::StrCat("Compute", pool_number), num_threads,
+      options.config.use_work_stealing_thread_pools());
 }
 
 thread::ThreadPool* GlobalThreadPool(const SessionOptions& options) {
@@ -153,13 +160,18 @@ DirectSession::DirectSession(const SessionOptions& options,
           options_, options_.config.session_inter_op_thread_pool(i), i));
     }
     owns_thread_pools_ = true;
-  } else if (options_.config.use_per_session_threads()) {
+  } else if (options_.config.use_per_session_threads() ||
+             !options_.config.cpu_affinity().empty()) {
     thread_pools_.push_back(NewThreadPoolFromSessionOptions(options_));
     owns_thread_pools_ = true;
   } else {
     thread_pools_.push_back(GlobalThreadPool(options));
     owns_thread_pools_ = false;
   }
+  if (!options_.config.graph_options().partition_graph_cache_dir().empty()) {
+    partition_graph_cache_.reset(new PartitionGraphCache(
+        options_.config.graph_options().partition_graph_cache_dir()));
+  }
   // NOTE(mrry): We do not need to use a unique string for the session
   // handle, because DirectSession owns its devices. This may change
   // in future versions.
@@ -241,6 +253,7 @@ Status DirectSession::ExtendLocked(const GraphDef& graph) {
   std::unique_ptr<SimpleGraphExecutionState> state;
   TF_RETURN_IF_ERROR(execution_state_->Extend(graph, &state));
   execution_state_.swap(state);
+  graph_cache_key_.clear();
 
   graph_created_ = true;  // In case this is first call
   return Status::OK();
@@ -305,26 +318,50 @@ Status DirectSession::Run(const RunOptions& run_options,
   // Send inputs.
   TF_RETURN_IF_ERROR(SendInputs(inputs, executors_and_keys, run_state.rendez));
 
+  TF_RETURN_IF_ERROR(RunExecutors(run_options, pool, run_state_args,
+                                  executors_and_keys, &run_state,
+                                  run_metadata));
+
+  // Receive outputs.
+  TF_RETURN_IF_ERROR(
+      RecvOutputs(output_names, executors_and_keys, &run_state, outputs));
+
+  // Save the output tensors of this run we choose to keep.
+  TF_RETURN_IF_ERROR(
+      run_state.tensor_store.SaveTensors(output_names, &session_state_));
+  return Status::OK();
+}
+
+Status DirectSession::RunExecutors(const RunOptions& run_options,
+                                   thread::ThreadPool* pool,
+                                   const RunStateArgs& run_state_args,
+                                   ExecutorsAndKeys* executors_and_keys,
+                                   RunState* run_state,
+                                   RunMetadata* run_metadata) {
   // Start parallel Executors.
   const int num_executors = executors_and_keys->items.size();
   ExecutorBarrier* barrier = new ExecutorBarrier(
-      num_executors, run_state.rendez, [&run_state](const Status& ret) {
+      num_executors, run_state->rendez, [run_state](const Status& ret) {
         {
-          mutex_lock l(run_state.mu_);
-          run_state.status.Update(ret);
+          mutex_lock l(run_state->mu_);
+          run_state->status.Update(ret);
         }
-        run_state.executors_done.Notify();
+        run_state->executors_done.Notify();
       });
 
   Executor::Args args;
   args.step_id = step_id_counter_.fetch_add(1);
-  args.rendezvous = run_state.rendez;
+  args.rendezvous = run_state->rendez;
   args.cancellation_manager = cancellation_manager_;
-  args.runner = [this, pool](Executor::Args::Closure c) {
-    SchedClosure(pool, c);
-  };
+  if (executors_and_keys->run_inline) {
+    args.runner = [](Executor::Args::Closure c) { c(); };
+  } else {
+    args.runner = [this, pool](Executor::Args::Closure c) {
+      SchedClosure(pool, c);
+    };
+  }
   args.session_state = &session_state_;
-  args.tensor_store = &run_state.tensor_store;
+  args.tensor_store = &run_state->tensor_store;
   if (LogMemory::IsEnabled()) {
     LogMemory::RecordStep(args.step_id, run_state_args.handle);
   }
@@ -333,10 +370,16 @@ Status DirectSession::Run(const RunOptions& run_options,
   const int64 build_cost_model =
       options_.config.graph_options().build_cost_model();
   if (do_trace || build_cost_model > 0) {
-    run_state.collector.reset(new StepStatsCollector(
+    run_state->collector.reset(new StepStatsCollector(
         run_metadata->mutable_step_stats(),
         (build_cost_model > 0) ? &cost_model_manager_ : nullptr));
-    args.stats_collector = run_state.collector.get();
+    args.stats_collector = run_state->collector.get();
+  } else if (SamplingTracer::ShouldSample(
+                 args.step_id,
+                 options_.config.graph_options().trace_sampling_interval())) {
+    run_state->collector.reset(
+        new StepStatsCollector(SamplingTracer::Global()));
+    args.stats_collector = run_state->collector.get();
   }
 
   // TODO(pbar) CostModel still gets very confused when presented
@@ -354,28 +397,25 @@ Status DirectSession::Run(const RunOptions& run_options,
     item.executor->RunAsync(args, barrier->Get());
   }
 
-  WaitForNotification(&run_state, run_options.timeout_in_ms() > 0
-                                      ? run_options.timeout_in_ms()
-                                      : operation_timeout_in_ms_);
+  WaitForNotification(run_state, run_options.timeout_in_ms() > 0
+                                     ? run_options.timeout_in_ms()
+                                     : operation_timeout_in_ms_);
 
   if (tracer) {
     tracer->Stop();
     tracer->Collect(args.stats_collector);
   }
+  if (args.stats_collector) {
+    // All the nodes are done, so what they allocated and is still in use is
+    // live at the end of the step.
+    args.stats_collector->Finalize();
+  }
 
   {
-    mutex_lock l(run_state.mu_);
-    TF_RETURN_IF_ERROR(run_state.status);
+    mutex_lock l(run_state->mu_);
+    TF_RETURN_IF_ERROR(run_state->status);
   }
 
-  // Receive outputs.
-  TF_RETURN_IF_ERROR(
-      RecvOutputs(output_names, executors_and_keys, &run_state, outputs));
-
-  // Save the output tensors of this run we choose to keep.
-  TF_RETURN_IF_ERROR(
-      run_state.tensor_store.SaveTensors(output_names, &session_state_));
-
   // Build and return the cost model as instructed.
   mutex_lock l(executor_lock_);
   ++executors_and_keys->step_count;
@@ -389,6 +429,153 @@ Status DirectSession::Run(const RunOptions& run_options,
   return Status::OK();
 }
 
+Status DirectSession::MakeCallable(const std::vector<string>& input_names,
+                                   const std::vector<string>& output_names,
+                                   const std::vector<string>& target_nodes,
+                                   int64* handle) {
+  {
+    mutex_lock l(graph_def_lock_);
+    if (!graph_created_) {
+      return errors::InvalidArgument(
+          "Session was not created with a graph before MakeCallable()!");
+    }
+  }
+
+  // Callables run on thread pool 0, like partial runs.
+  Callable callable;
+  RunStateArgs run_state_args;
+  TF_RETURN_IF_ERROR(GetOrCreateExecutors(
+      thread_pools_[0], input_names, output_names, target_nodes,
+      &callable.executors_and_keys, &run_state_args));
+
+  // Parses the rendezvous keys once, instead of at every run.
+  const ExecutorsAndKeys* executors_and_keys = callable.executors_and_keys;
+  callable.output_names = output_names;
+  callable.input_keys.resize(input_names.size());
+  for (size_t i = 0; i < input_names.size(); ++i) {
+    auto it = executors_and_keys->input_keys.find(input_names[i]);
+    if (it == executors_and_keys->input_keys.end()) {
+      return errors::InvalidArgument("'", input_names[i],
+                                     "' is not a pre-defined feed!");
+    }
+    TF_RETURN_IF_ERROR(Rendezvous::ParseKey(it->second,
+                                            &callable.input_keys[i]));
+  }
+  callable.output_keys.resize(output_names.size());
+  for (size_t i = 0; i < output_names.size(); ++i) {
+    auto it = executors_and_keys->output_keys.find(output_names[i]);
+    if (it == executors_and_keys->output_keys.end()) {
+      return errors::InvalidArgument("'", output_names[i],
+                                     "' is not a pre-defined fetch!");
+    }
+    TF_RETURN_IF_ERROR(Rendezvous::ParseKey(it->second,
+                                            &callable.output_keys[i]));
+  }
+
+  mutex_lock l(executor_lock_);
+  *handle = next_callable_handle_++;
+  callables_[*handle] = std::move(callable);
+  return Status::OK();
+}
+
+Status DirectSession::Warmup(const std::vector<RunSignature>& signatures) {
+  {
+    mutex_lock l(graph_def_lock_);
+    if (!graph_created_) {
+      return errors::InvalidArgument(
+          "Session was not created with a graph before Warmup()!");
+    }
+  }
+
+  // Each signature is built on a thread of its own, so the placement of one
+  // overlaps the kernel construction of another.
+  std::vector<Status> statuses(signatures.size());
+  BlockingCounter counter(signatures.size());
+  for (size_t i = 0; i < signatures.size(); ++i) {
+    SchedClosure(thread_pools_[0], [this, &signatures, &statuses, &counter,
+                                    i]() {
+      const RunSignature& signature = signatures[i];
+      ExecutorsAndKeys* executors_and_keys;
+      RunStateArgs run_state_args;
+      statuses[i] = GetOrCreateExecutors(
+          thread_pools_[0], signature.input_names, signature.output_names,
+          signature.target_nodes, &executors_and_keys, &run_state_args);
+      counter.DecrementCount();
+    });
+  }
+  counter.Wait();
+  for (const Status& s : statuses) {
+    TF_RETURN_IF_ERROR(s);
+  }
+  return Status::OK();
+}
+
+Status DirectSession::RunCallable(int64 handle,
+                                  const std::vector<Tensor>& inputs,
+                                  std::vector<Tensor>* outputs) {
+  // Callables are never modified, and only erased by ReleaseCallable, which
+  // must not be called while the callable runs.
+  const Callable* callable;
+  {
+    mutex_lock l(executor_lock_);
+    auto it = callables_.find(handle);
+    if (it == callables_.end()) {
+      return errors::InvalidArgument("No callable with handle ", handle);
+    }
+    callable = &it->second;
+  }
+  if (inputs.size() != callable->input_keys.size()) {
+    return errors::InvalidArgument("Expected ", callable->input_keys.size(),
+                                   " inputs for callable ", handle, ", got ",
+                                   inputs.size());
+  }
+
+  RunState run_state({}, {});
+  run_state.rendez = new IntraProcessRendezvous(device_mgr_.get());
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    const Status s = run_state.rendez->Send(
+        callable->input_keys[i], Rendezvous::Args(), inputs[i], false);
+    if (!s.ok()) {
+      run_state.rendez->StartAbort(s);
+      return s;
+    }
+  }
+
+  RunMetadata run_metadata;
+  TF_RETURN_IF_ERROR(RunExecutors(RunOptions::default_instance(),
+                                  thread_pools_[0], RunStateArgs(),
+                                  callable->executors_and_keys, &run_state,
+                                  &run_metadata));
+
+  outputs->resize(callable->output_keys.size());
+  for (size_t i = 0; i < callable->output_keys.size(); ++i) {
+    bool is_dead;
+    Status s = run_state.rendez->Recv(callable->output_keys[i],
+                                      Rendezvous::Args(), &(*outputs)[i],
+                                      &is_dead);
+    if (is_dead && s.ok()) {
+      s = errors::InvalidArgument("The tensor returned for ",
+                                  callable->output_names[i],
+                                  " was not valid.");
+    }
+    if (!s.ok()) {
+      run_state.rendez->StartAbort(s);
+      outputs->clear();
+      return s;
+    }
+  }
+  return run_state.tensor_store.SaveTensors(callable->output_names,
+                                            &session_state_);
+}
+
+Status DirectSession::ReleaseCallable(int64 handle) {
+  mutex_lock l(executor_lock_);
+  if (callables_.erase(handle) == 0) {
+    return errors::InvalidArgument("No callable with handle ", handle);
+  }
+  return Status::OK();
+}
+
 Status DirectSession::PRunSetup(const std::vector<string>& input_names,
                                 const std::vector<string>& output_names,
                                 const std::vector<string>& target_nodes,
@@ -735,8 +922,22 @@ Status DirectSession::GetOrCreateExecutors(
   // The executor_lock_ is intentionally released while executor is
   // being created.
   std::unordered_map<string, std::unique_ptr<Graph>> graphs;
-  TF_RETURN_IF_ERROR(
-      CreateGraphs(options, &graphs, &ek->flib_def, run_state_args));
+  // Partial runs keep the full graph, and debug nodes are added after
+  // optimization, so neither goes through the cache.
+  const bool use_cache = partition_graph_cache_ != nullptr &&
+                         !run_state_args->is_partial_run &&
+                         run_state_args->debug_tensor_watches.empty();
+  string cache_key;
+  bool cache_hit = false;
+  if (use_cache) {
+    cache_key = strings::StrCat(GraphCacheKey(), "/", key);
+    cache_hit = LookupCachedGraphs(cache_key, &graphs, &ek->flib_def);
+  }
+  if (!cache_hit) {
+    TF_RETURN_IF_ERROR(
+        CreateGraphs(options, &graphs, &ek->flib_def, run_state_args));
+  }
+  PartitionGraphs cache_entry;
 
   if (run_state_args->is_partial_run) {
     ek->graph = std::move(run_state_args->graph);
@@ -802,7 +1003,13 @@ Status DirectSession::GetOrCreateExecutors(
     params.node_outputs_cb = node_outputs_callback_;
 
     partition_graph = iter->second.release();
-    optimizer.Optimize(lib, device, &partition_graph);
+    if (!cache_hit) {
+      optimizer.Optimize(lib, device, &partition_graph);
+      if (use_cache) {
+        partition_graph->ToGraphDef(
+            &(*cache_entry.mutable_partitions())[partition_name]);
+      }
+    }
 
     // EXPERIMENTAL: tfdb inserts debug nodes (i.e., probes) to the graph
     if (!run_state_args->debug_tensor_watches.empty()) {
@@ -823,6 +1030,27 @@ Status DirectSession::GetOrCreateExecutors(
     item->executor.reset(executor);
   }
 
+  if (use_cache && !cache_hit) {
+    *cache_entry.mutable_library() = ek->flib_def->ToProto();
+    {
+      mutex_lock l(mu_);
+      for (const auto& placement : stateful_placements_) {
+        (*cache_entry.mutable_stateful_placements())[placement.first] =
+            placement.second;
+      }
+    }
+    const Status s = partition_graph_cache_->Insert(cache_key, &cache_entry);
+    if (!s.ok()) {
+      LOG(WARNING) << "Could not cache the partition graphs: " << s;
+    }
+  }
+
+  // Small graphs on a single device spend more time handing their kernels to
+  // the thread pool than running them, so their steps can run inline.
+  const int max_inline_nodes = options_.config.inline_graph_max_nodes();
+  ek->run_inline = max_inline_nodes > 0 && ek->items.size() == 1 &&
+                   ek->items[0].graph->num_nodes() <= max_inline_nodes;
+
   // Compute the rendezvous keys to avoid recomputing them every time.
   //
   // We always use the first device as the device name portion of the
@@ -847,6 +1075,69 @@ Status DirectSession::GetOrCreateExecutors(
   return Status::OK();
 }
 
+string DirectSession::GraphCacheKey() {
+  mutex_lock l(graph_def_lock_);
+  if (graph_cache_key_.empty()) {
+    graph_cache_key_ = PartitionGraphCache::GraphKey(
+        execution_state_->original_graph_def(), device_set_, options_.config);
+  }
+  return graph_cache_key_;
+}
+
+bool DirectSession::LookupCachedGraphs(
+    const string& cache_key,
+    std::unordered_map<string, std::unique_ptr<Graph>>* outputs,
+    std::unique_ptr<FunctionLibraryDefinition>* flib_def) {
+  PartitionGraphs entry;
+  Status s = partition_graph_cache_->Lookup(cache_key, &entry);
+  if (!s.ok()) {
+    if (!errors::IsNotFound(s)) {
+      LOG(WARNING) << "Could not read cached partition graphs: " << s;
+    }
+    return false;
+  }
+  std::unique_ptr<FunctionLibraryDefinition> cached_flib_def(
+      new FunctionLibraryDefinition(OpRegistry::Global(), entry.library()));
+  std::unordered_map<string, std::unique_ptr<Graph>> graphs;
+  for (const auto& partition : entry.partitions()) {
+    Device* device;
+    s = device_mgr_->LookupDevice(partition.first, &device);
+    std::unique_ptr<Graph> device_graph(new Graph(cached_flib_def.get()));
+    if (s.ok()) {
+      GraphConstructorOptions device_opts;
+      device_opts.allow_internal_ops = true;
+      device_opts.expect_device_spec = true;
+      s = ConvertGraphDefToGraph(device_opts, partition.second,
+                                 device_graph.get());
+    }
+    if (!s.ok()) {
+      LOG(WARNING) << "Could not use cached partition graphs: " << s;
+      return false;
+    }
+    graphs.emplace(partition.first, std::move(device_graph));
+  }
+
+  {
+    // The stateful nodes must stay where this session already put them.
+    mutex_lock l(mu_);
+    for (const auto& placement : entry.stateful_placements()) {
+      auto iter = stateful_placements_.find(placement.first);
+      if (iter != stateful_placements_.end() &&
+          iter->second != placement.second) {
+        return false;
+      }
+    }
+    for (const auto& placement : entry.stateful_placements()) {
+      stateful_placements_.insert(
+          std::make_pair(placement.first, placement.second));
+    }
+  }
+  VLOG(1) << "Using cached partition graphs for " << cache_key;
+  *outputs = std::move(graphs);
+  *flib_def = std::move(cached_flib_def);
+  return true;
+}
+
 Status DirectSession::CreateGraphs(
     const BuildGraphOptions& options,
     std::unordered_map<string, std::unique_ptr<Graph>>* outputs,
@@ -1044,6 +1335,12 @@ class DirectSessionFactory : public SessionFactory {
     if (options.config.graph_options().build_cost_model() > 0) {
       EnableCPUAllocatorFullStats(true);
     }
+    std::vector<int> cpus;
+    const Status s = ParseCpuList(options.config.cpu_affinity(), &cpus);
+    if (!s.ok()) {
+      LOG(ERROR) << s;
+      return nullptr;
+    }
     std::vector<Device*> devices;
     DeviceFactory::AddDevices(options, "/job:localhost/replica:0/task:0",
                               &devices);
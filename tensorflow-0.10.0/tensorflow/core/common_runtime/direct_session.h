@@ -27,11 +27,13 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/device_mgr.h"
 #include "tensorflow/core/common_runtime/device_set.h"
 #include "tensorflow/core/common_runtime/executor.h"
+#include "tensorflow/core/common_runtime/partition_graph_cache.h"
 #include "tensorflow/core/common_runtime/rendezvous_mgr.h"
 #include "tensorflow/core/common_runtime/simple_graph_execution_state.h"
 #include "tensorflow/core/debug/debug_graph_utils.h"
 #include "tensorflow/core/framework/cancellation.h"
 #include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/rendezvous.h"
 #include "tensorflow/core/framework/session_state.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -83,6 +85,20 @@ class DirectSession : public Session {
                             const std::vector<string>& output_names,
                             std::vector<Tensor>* outputs) override;
 
+  // NOTE: Experimental and subject to change.
+  ::tensorflow::Status MakeCallable(const std::vector<string>& input_names,
+                                    const std::vector<string>& output_names,
+                                    const std::vector<string>& target_nodes,
+                                    int64* handle) override;
+  ::tensorflow::Status RunCallable(int64 handle,
+                                   const std::vector<Tensor>& inputs,
+                                   std::vector<Tensor>* outputs) override;
+  ::tensorflow::Status ReleaseCallable(int64 handle) override;
+
+  // NOTE: Experimental and subject to change.
+  ::tensorflow::Status Warmup(
+      const std::vector<RunSignature>& signatures) override;
+
   ::tensorflow::Status Close() override;
 
   void ExportCostModels(CostModelManager::CostModelMap* cost_models) {
@@ -120,6 +136,10 @@ class DirectSession : public Session {
     std::vector<PerPartitionExecutorsAndLib> items;
     std::unordered_map<string, string> input_keys;
     std::unordered_map<string, string> output_keys;
+
+    // Whether steps run all kernels on the calling thread. See
+    // ConfigProto.inline_graph_max_nodes.
+    bool run_inline = false;
   };
 
   // For each live partial execution, the session maintains a RunState.
@@ -142,6 +162,17 @@ class DirectSession : public Session {
     ~RunState();
   };
 
+  // A Callable is created by MakeCallable for a given set of feeds, fetches
+  // and targets. 'executors_and_keys' are the cached executors for them,
+  // and 'input_keys' and 'output_keys' the parsed rendezvous keys of the
+  // feeds and fetches, in order.
+  struct Callable {
+    ExecutorsAndKeys* executors_and_keys = nullptr;  // not owned
+    std::vector<string> output_names;
+    std::vector<Rendezvous::ParsedKey> input_keys;
+    std::vector<Rendezvous::ParsedKey> output_keys;
+  };
+
   struct RunStateArgs {
     bool is_partial_run = false;
     string handle;
@@ -173,6 +204,18 @@ class DirectSession : public Session {
   ::tensorflow::Status ExtendLocked(const GraphDef& graph)
       EXCLUSIVE_LOCKS_REQUIRED(graph_def_lock_);
 
+  // Returns the part of the partition_graph_cache_ keys that identifies the
+  // current graph.
+  string GraphCacheKey();
+
+  // Reads the partition graphs of 'cache_key' from partition_graph_cache_
+  // into 'outputs' and their function library into 'flib_def'.  Returns
+  // false on a miss.
+  bool LookupCachedGraphs(
+      const string& cache_key,
+      std::unordered_map<string, std::unique_ptr<Graph>>* outputs,
+      std::unique_ptr<FunctionLibraryDefinition>* flib_def);
+
   // Feeds more inputs to the executors, triggering further execution.
   ::tensorflow::Status SendInputs(
       const std::vector<std::pair<string, Tensor>>& inputs,
@@ -193,6 +236,15 @@ class DirectSession : public Session {
       const std::vector<string>& fetches,
       const ExecutorsAndKeys* executors_and_keys, const RunState* run_state);
 
+  // Runs the executors of 'executors_and_keys' for one step, once the inputs
+  // of 'run_state' have been sent, and waits until they are done.
+  ::tensorflow::Status RunExecutors(const RunOptions& run_options,
+                                    thread::ThreadPool* pool,
+                                    const RunStateArgs& run_state_args,
+                                    ExecutorsAndKeys* executors_and_keys,
+                                    RunState* run_state,
+                                    RunMetadata* run_metadata);
+
   // Use the appropriate WaitForNotification function based on whether
   // operation_timeout_in_ms is greater than 0.
   void WaitForNotification(RunState* run_state, int64 timeout_in_ms);
@@ -228,6 +280,11 @@ class DirectSession : public Session {
   std::unordered_map<string, std::unique_ptr<RunState>> partial_runs_
       GUARDED_BY(executor_lock_);
 
+  // Holds mappings from handle to callable, and the next handle returned by
+  // MakeCallable.
+  std::unordered_map<int64, Callable> callables_ GUARDED_BY(executor_lock_);
+  int64 next_callable_handle_ GUARDED_BY(executor_lock_) = 0;
+
   // This holds all the tensors that are currently alive in the session.
   SessionState session_state_;
 
@@ -245,6 +302,12 @@ class DirectSession : public Session {
   std::unique_ptr<SimpleGraphExecutionState> execution_state_
       GUARDED_BY(graph_def_lock_);
 
+  // Keeps the optimized partition graphs across processes, if
+  // graph_options.partition_graph_cache_dir is set, and the fingerprint of
+  // the current graph in its keys, computed at the first lookup.
+  std::unique_ptr<PartitionGraphCache> partition_graph_cache_;
+  string graph_cache_key_ GUARDED_BY(graph_def_lock_);
+
   // The function library, before any rewrites or optimizations have been
   // performed. In particular, CreateGraphs() may need to modify the function
   // library; it copies and modifies the function library.
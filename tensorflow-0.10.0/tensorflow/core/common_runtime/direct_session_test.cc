@@ -17,6 +17,7 @@ limitations under the License.
 
 #include <map>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -24,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/graph.pb.h"
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/summary.pb.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.pb.h"
@@ -35,10 +37,13 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/public/session.h"
 #include "tensorflow/core/public/session_options.h"
 #include "tensorflow/core/util/device_name_utils.h"
+#include "tensorflow/core/util/sampling_tracer.h"
 
 namespace tensorflow {
 namespace {
@@ -134,6 +139,143 @@ TEST_F(DirectSessionMinusAXTest, TestFeed) {
   EXPECT_FLOAT_EQ(39.0, mat(1, 0));
 }
 
+TEST_F(DirectSessionMinusAXTest, RunCallable) {
+  Initialize({1, 2, 3, 4});
+  std::unique_ptr<Session> session(CreateSession());
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+
+  int64 handle;
+  TF_ASSERT_OK(session->MakeCallable({x_}, {y_ + ":0"}, {y_neg_}, &handle));
+  for (int i = 0; i < 3; ++i) {
+    Tensor t(DT_FLOAT, TensorShape({2, 1}));
+    test::FillValues<float>(&t, {5, static_cast<float>(i)});
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->RunCallable(handle, {t}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    std::vector<Tensor> expected;
+    TF_ASSERT_OK(session->Run({{x_, t}}, {y_ + ":0"}, {y_neg_}, &expected));
+    test::ExpectTensorEqual<float>(expected[0], outputs[0]);
+  }
+
+  // The callable takes exactly its feeds, and is gone once released.
+  std::vector<Tensor> outputs;
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      session->RunCallable(handle, {}, &outputs)));
+  TF_ASSERT_OK(session->ReleaseCallable(handle));
+  Tensor t(DT_FLOAT, TensorShape({2, 1}));
+  test::FillValues<float>(&t, {1, 1});
+  EXPECT_TRUE(errors::IsInvalidArgument(
+      session->RunCallable(handle, {t}, &outputs)));
+  EXPECT_TRUE(errors::IsInvalidArgument(session->ReleaseCallable(handle)));
+
+  // Unknown fetches are rejected when the callable is made.
+  EXPECT_FALSE(session->MakeCallable({}, {"missing:0"}, {}, &handle).ok());
+}
+
+TEST_F(DirectSessionMinusAXTest, WarmupWithPartitionGraphCache) {
+  Initialize({1, 2, 3, 4});
+  const string cache_dir =
+      io::JoinPath(testing::TmpDir(), "direct_session_partition_graphs");
+  SessionOptions options;
+  (*options.config.mutable_device_count())["CPU"] = 2;
+  options.config.mutable_graph_options()->set_partition_graph_cache_dir(
+      cache_dir);
+  std::vector<Session::RunSignature> signatures(2);
+  signatures[0].input_names = {x_};
+  signatures[0].output_names = {y_ + ":0"};
+  signatures[1].output_names = {y_neg_ + ":0"};
+
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  EXPECT_TRUE(errors::IsInvalidArgument(session->Warmup(signatures)));
+  TF_ASSERT_OK(session->Create(def_));
+  TF_ASSERT_OK(session->Warmup(signatures));
+  std::vector<string> files;
+  TF_ASSERT_OK(Env::Default()->GetChildren(cache_dir, &files));
+  EXPECT_EQ(2, files.size());
+
+  // A session of another process would read the same graphs.
+  Tensor t(DT_FLOAT, TensorShape({2, 1}));
+  test::FillValues<float>(&t, {5, 6});
+  for (int i = 0; i < 2; ++i) {
+    std::unique_ptr<Session> cached_session(NewSession(options));
+    TF_ASSERT_OK(cached_session->Create(def_));
+    if (i == 0) TF_ASSERT_OK(cached_session->Warmup(signatures));
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(cached_session->Run({{x_, t}}, {y_ + ":0"}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    test::ExpectTensorEqual<float>(test::AsTensor<float>({17, 39}, {2, 1}),
+                                   outputs[0]);
+    TF_ASSERT_OK(cached_session->Run({}, {y_neg_ + ":0"}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    test::ExpectTensorEqual<float>(test::AsTensor<float>({-3, -7}, {2, 1}),
+                                   outputs[0]);
+  }
+  TF_ASSERT_OK(Env::Default()->GetChildren(cache_dir, &files));
+  EXPECT_EQ(2, files.size());
+}
+
+TEST_F(DirectSessionMinusAXTest, SamplesNodeTimings) {
+  Initialize({1, 2, 3, 4});
+  SessionOptions options;
+  (*options.config.mutable_device_count())["CPU"] = 2;
+  options.config.mutable_graph_options()->set_trace_sampling_interval(1);
+  std::unique_ptr<Session> session(NewSession(options));
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+
+  // Every step is sampled, and the MatMul is timed on its device.
+  std::vector<Tensor> outputs;
+  for (int i = 0; i < 3; ++i) {
+    TF_ASSERT_OK(session->Run({}, {y_ + ":0"}, {}, &outputs));
+  }
+  SamplingTracer::Global()->Flush();
+  HistogramProto samples;
+  SamplingTracer::Global()
+      ->GetCell("/job:localhost/replica:0/task:0/cpu:0", y_,
+                SamplingTracer::kOpStage)
+      ->EncodeToProto(&samples);
+  EXPECT_EQ(3, samples.num());
+
+  // Steps traced with RunOptions still get their full stats.
+  RunOptions run_options;
+  run_options.set_trace_level(RunOptions::FULL_TRACE);
+  RunMetadata run_metadata;
+  TF_ASSERT_OK(session->Run(run_options, {}, {y_ + ":0"}, {}, &outputs,
+                            &run_metadata));
+  EXPECT_LT(0, run_metadata.step_stats().dev_stats_size());
+}
+
+TEST_F(DirectSessionMinusAXTest, TracesLiveBytes) {
+  Initialize({1, 2, 3, 4});
+  std::unique_ptr<Session> session(CreateSession());
+  ASSERT_TRUE(session != nullptr);
+  TF_ASSERT_OK(session->Create(def_));
+
+  RunOptions run_options;
+  run_options.set_trace_level(RunOptions::FULL_TRACE);
+  RunMetadata run_metadata;
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run(run_options, {}, {y_ + ":0"}, {}, &outputs,
+                            &run_metadata));
+
+  // The fetched MatMul output is still in use at the end of the step.
+  int64 peak_bytes = 0;
+  int64 live_bytes = 0;
+  for (const auto& dev_stats : run_metadata.step_stats().dev_stats()) {
+    for (const auto& node_stats : dev_stats.node_stats()) {
+      if (node_stats.node_name() != y_) continue;
+      for (const auto& memory : node_stats.memory()) {
+        peak_bytes += memory.peak_bytes();
+        live_bytes += memory.live_bytes();
+      }
+    }
+  }
+  EXPECT_LE(2 * sizeof(float), peak_bytes);
+  EXPECT_LE(2 * sizeof(float), live_bytes);
+}
+
 TEST_F(DirectSessionMinusAXTest, TestConcurrency) {
   Initialize({1, 2, 3, 4});
   std::unique_ptr<Session> session(CreateSession());
@@ -399,6 +541,59 @@ TEST(DirectSessionTest, MultipleFeedTest) {
   ASSERT_EQ(22.0, outputs[1].flat<float>()(0));
 }
 
+// Records the thread that runs its kernel, and forwards its input.
+REGISTER_OP("RecordThread").Input("x: float").Output("y: float").Doc("");
+
+std::thread::id kernel_thread;
+
+class RecordThreadOp : public OpKernel {
+ public:
+  explicit RecordThreadOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
+  void Compute(OpKernelContext* ctx) override {
+    kernel_thread = std::this_thread::get_id();
+    ctx->set_output(0, ctx->input(0));
+  }
+};
+REGISTER_KERNEL_BUILDER(Name("RecordThread").Device(DEVICE_CPU),
+                        RecordThreadOp);
+
+TEST(DirectSessionTest, RunsSmallGraphsInline) {
+  Graph g(OpRegistry::Global());
+  Tensor vx(DT_FLOAT, TensorShape({}));
+  vx.scalar<float>()() = 2.0;
+  Node* x = test::graph::Constant(&g, vx);
+  Node* y = test::graph::Unary(&g, "RecordThread", x);
+  Node* z = test::graph::Unary(&g, "Neg", y);
+  GraphDef def;
+  test::graph::ToGraphDef(&g, &def);
+
+  SessionOptions options;
+  options.config.set_inline_graph_max_nodes(100);
+  std::unique_ptr<Session> session(NewSession(options));
+  TF_ASSERT_OK(session->Create(def));
+  // Feeds x so that constant folding does not run the kernel.
+  for (int i = 0; i < 3; ++i) {
+    kernel_thread = std::thread::id();
+    std::vector<Tensor> outputs;
+    TF_ASSERT_OK(session->Run({{x->name(), test::AsScalar<float>(i)}},
+                              {z->name() + ":0"}, {}, &outputs));
+    ASSERT_EQ(1, outputs.size());
+    EXPECT_EQ(-i, outputs[0].scalar<float>()());
+    EXPECT_EQ(std::this_thread::get_id(), kernel_thread);
+  }
+
+  // Graphs with more nodes than the limit use the inter-op thread pool.
+  options.config.set_inline_graph_max_nodes(2);
+  session.reset(NewSession(options));
+  TF_ASSERT_OK(session->Create(def));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(session->Run({{x->name(), test::AsScalar<float>(2)}},
+                            {z->name() + ":0"}, {}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  EXPECT_EQ(-2.0, outputs[0].scalar<float>()());
+  EXPECT_NE(std::this_thread::get_id(), kernel_thread);
+}
+
 REGISTER_OP("Darth")
     .Input("x: float")
     .Output("y: float")
@@ -56,6 +56,7 @@ limitations under the License.
 #include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/sampling_tracer.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
 
 namespace tensorflow {
@@ -150,13 +151,26 @@ void SetOutput(NodeExecStats* nt, int slot, const Tensor* v) {
   v->FillDescription(no->mutable_tensor_description());
 }
 
-void SetMemory(NodeExecStats* nt, OpKernelContext* ctx) {
+// Records the memory the node allocated through each allocator. If
+// 'collector' is given, it also records how much of it is still live at the
+// end of the step.
+void SetMemory(NodeExecStats* nt, OpKernelContext* ctx,
+               StepStatsCollector* collector) {
   for (const auto& allocator_pair : ctx->wrapped_allocators()) {
     AllocatorMemoryUsed* memory = nt->add_memory();
-    // retrieving the sizes from the wrapped allocator removes the
-    // executor's reference to it, so allocator_pair.second must not
-    // be dereferenced again after this statement
-    auto sizes = allocator_pair.second->GetSizesAndUnRef();
+    std::pair<size_t, size_t> sizes;
+    if (collector != nullptr) {
+      // the collector takes over the executor's reference to the
+      // wrapped allocator
+      sizes = allocator_pair.second->GetSizes();
+      collector->TrackLiveBytes(nt, nt->memory_size() - 1,
+                                allocator_pair.second);
+    } else {
+      // retrieving the sizes from the wrapped allocator removes the
+      // executor's reference to it, so allocator_pair.second must not
+      // be dereferenced again after this statement
+      sizes = allocator_pair.second->GetSizesAndUnRef();
+    }
     memory->set_allocator_name(allocator_pair.first->Name());
     int tb = sizes.first;
     memory->set_total_bytes(tb);
@@ -576,6 +590,17 @@ class ExecutorState {
 
     ~IterationState() { delete[] input_tensors; }
 
+    // Returns the state to that of a new iteration, releasing the tensors
+    // it still holds, so that it can be reused for another iteration.
+    void Reset(const ExecutorImpl* impl) {
+      for (int i = 0; i < impl->total_input_tensors_; ++i) {
+        input_tensors[i] = Entry();
+      }
+      outstanding_ops = 0;
+      outstanding_frame_count = 0;
+      counts_.InitializeFrom(impl->initial_pending_counts_);
+    }
+
    private:
     PendingCounts counts_;
   };
@@ -743,6 +768,9 @@ class ExecutorState {
   SessionState* session_state_;
   TensorStore* tensor_store_;
   StepStatsCollector* stats_collector_;
+  // True if stats_collector_ collects the full stats of the nodes, rather
+  // than only their compute time for a sampled step.
+  const bool detailed_stats_;
   // QUESTION: Make it a checkpoint::TensorSliceReaderCacheWrapper
   // instead of a pointer?  (avoids having to delete).
   checkpoint::TensorSliceReaderCacheWrapper* slice_reader_cache_;
@@ -778,6 +806,19 @@ class ExecutorState {
   // name of the new frame from nodedef.
   std::unordered_map<string, FrameState*> outstanding_frames_ GUARDED_BY(mu_);
 
+  // The states of deleted iterations, kept for new iterations of any
+  // frame.  A loop runs many iterations with little work each, and a new
+  // IterationState allocates the inputs and pending counts of the whole
+  // graph.
+  std::vector<IterationState*> free_iterations_ GUARDED_BY(mu_);
+
+  // Returns the state for a new iteration, reusing a deleted one if any.
+  IterationState* NewIteration() EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Keeps the state of a deleted iteration for reuse.
+  void DeleteIteration(IterationState* iter_state)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   // The unique name of a frame.
   inline string MakeFrameName(FrameState* frame, int64 iter_id, string name) {
     return strings::StrCat(frame->frame_name, ";", iter_id, ";", name);
@@ -893,6 +934,8 @@ ExecutorState::ExecutorState(const Executor::Args& args, ExecutorImpl* impl)
       session_state_(args.session_state),
       tensor_store_(args.tensor_store),
       stats_collector_(args.stats_collector),
+      detailed_stats_(args.stats_collector != nullptr &&
+                      !args.stats_collector->sampled()),
       slice_reader_cache_(new checkpoint::TensorSliceReaderCacheWrapper),
       call_frame_(args.call_frame),
       impl_(impl),
@@ -924,6 +967,9 @@ ExecutorState::~ExecutorState() {
   for (auto name_frame : outstanding_frames_) {
     delete name_frame.second;
   }
+  for (IterationState* iter_state : free_iterations_) {
+    delete iter_state;
+  }
 
   for (auto it : device_context_map_) {
     it->Unref();
@@ -1046,8 +1092,8 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
   params.step_id = step_id_;
   Device* device = impl_->params_.device;
   params.device = device;
-  // track allocations if and only if we are collecting statistics
-  params.track_allocations = (stats_collector_ != nullptr);
+  // track allocations if and only if we are collecting detailed statistics
+  params.track_allocations = detailed_stats_;
   params.log_memory = log_memory_;
   params.record_tensor_accesses = impl_->device_record_tensor_accesses_;
   params.rendezvous = rendezvous_;
@@ -1168,7 +1214,13 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
           if (stats_collector_) nodestats::SetOpEnd(stats);
           EntryVector outputs;
           Status s = ProcessOutputs(state->item, &state->ctx, &outputs, stats);
-          if (stats_collector_) nodestats::SetMemory(stats, &state->ctx);
+          if (detailed_stats_) {
+            // Transfer nodes are not saved, so they have no live bytes.
+            nodestats::SetMemory(stats, &state->ctx,
+                                 IsTransferNode(state->item.node)
+                                     ? nullptr
+                                     : stats_collector_);
+          }
           // Clears inputs.
           const int num_inputs = state->item.num_inputs;
           for (int i = 0; i < num_inputs; ++i) {
@@ -1191,7 +1243,7 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
             // Get the list of all tensors accessed during the execution
             TensorReferenceVector accessed;
             state->ctx.retrieve_accessed_tensors(&accessed);
-            if (stats_collector_)
+            if (detailed_stats_)
               nodestats::SetReferencedTensors(stats, accessed);
             // callee takes ownership of the vector
             device->ConsumeListOfAccessedTensors(state->ctx.op_device_context(),
@@ -1202,12 +1254,22 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
           if (completed) Finish();
         };
         if (stats_collector_) nodestats::SetOpStart(stats);
-        device->ComputeAsync(async, &state->ctx, done);
+        if (stats_collector_ && !detailed_stats_) {
+          SamplingTracer::ScopedNode scoped_node(device->name(), node->name());
+          device->ComputeAsync(async, &state->ctx, done);
+        } else {
+          device->ComputeAsync(async, &state->ctx, done);
+        }
       } else {
         // Synchronous computes.
         OpKernelContext ctx(&params, item.num_outputs);
         if (stats_collector_) nodestats::SetOpStart(stats);
-        device->Compute(CHECK_NOTNULL(op_kernel), &ctx);
+        if (stats_collector_ && !detailed_stats_) {
+          SamplingTracer::ScopedNode scoped_node(device->name(), node->name());
+          device->Compute(CHECK_NOTNULL(op_kernel), &ctx);
+        } else {
+          device->Compute(CHECK_NOTNULL(op_kernel), &ctx);
+        }
         // The final node in the step is always a Sink node. Block
         // this Op from completing until the device has finished all
         // queued operations. For devices like GPUs that continue to
@@ -1225,7 +1287,11 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
           ctx.retrieve_accessed_tensors(&accessed_tensors);
           device_context = ctx.op_device_context();
         }
-        if (stats_collector_) nodestats::SetMemory(stats, &ctx);
+        if (detailed_stats_) {
+          // Transfer nodes are not saved, so they have no live bytes.
+          nodestats::SetMemory(
+              stats, &ctx, IsTransferNode(node) ? nullptr : stats_collector_);
+        }
       }
     }
 
@@ -1248,7 +1314,7 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
       }
       outputs.clear();
       if (!accessed_tensors.empty()) {
-        if (stats_collector_)
+        if (detailed_stats_)
           nodestats::SetReferencedTensors(stats, accessed_tensors);
         // device_context is set above in synchronous computes
         device->ConsumeListOfAccessedTensors(device_context, accessed_tensors);
@@ -1395,7 +1461,7 @@ Status ExecutorState::ProcessOutputs(const NodeItem& item, OpKernelContext* ctx,
       DataType dtype = val->dtype();
       if (val.is_ref()) dtype = MakeRefType(dtype);
       if (dtype == item.output_type(i)) {
-        if (stats_collector_ && val.tensor->IsInitialized()) {
+        if (detailed_stats_ && val.tensor->IsInitialized()) {
           nodestats::SetOutput(stats, i, val.tensor);
         }
         if (val.is_ref()) {
@@ -1607,7 +1673,14 @@ void ExecutorState::AddLoopInv(FrameState* frame, const Node* node,
 bool ExecutorState::NodeDone(const Status& s, const Node* node,
                              const TaggedNodeSeq& ready, NodeExecStats* stats,
                              TaggedNodeReadyQueue* inline_ready) {
-  if (stats_collector_) {
+  if (stats_collector_ && !detailed_stats_) {
+    nodestats::SetAllEnd(stats);
+    if (!IsTransferNode(node)) {
+      stats_collector_->Save(impl_->params_.device->name(), stats);
+    } else {
+      delete stats;
+    }
+  } else if (stats_collector_) {
     nodestats::SetAllEnd(stats);
     stats_collector_->UpdateCostModelNode(stats, impl_->graph_, node);
     if (!SetTimelineLabel(node, stats)) {
@@ -1880,8 +1953,7 @@ void ExecutorState::FindOrCreateChildFrame(FrameState* frame, int64 iter,
     CHECK(s.ok()) << s;
     // 'iterations' is a fixed-length circular buffer.
     temp->iterations.resize(temp->max_parallel_iterations + 1);
-    IterationState* iter_state = new IterationState(impl_);
-    temp->iterations[0] = iter_state;
+    temp->iterations[0] = NewIteration();
 
     auto frame_pending = impl_->frame_input_count_.find(enter_name);
     DCHECK(frame_pending != impl_->frame_input_count_.end());
@@ -1894,6 +1966,18 @@ void ExecutorState::FindOrCreateChildFrame(FrameState* frame, int64 iter,
   }
 }
 
+ExecutorState::IterationState* ExecutorState::NewIteration() {
+  if (free_iterations_.empty()) return new IterationState(impl_);
+  IterationState* iter_state = free_iterations_.back();
+  free_iterations_.pop_back();
+  return iter_state;
+}
+
+void ExecutorState::DeleteIteration(IterationState* iter_state) {
+  iter_state->Reset(impl_);
+  free_iterations_.push_back(iter_state);
+}
+
 void ExecutorState::IncrementIteration(FrameState* frame,
                                        TaggedNodeSeq* ready) {
   frame->iteration_count++;
@@ -1904,8 +1988,7 @@ void ExecutorState::IncrementIteration(FrameState* frame,
             << "]";
   }
 
-  IterationState* iter_state = new IterationState(impl_);
-  frame->SetIteration(next_iter, iter_state);
+  frame->SetIteration(next_iter, NewIteration());
   frame->num_outstanding_iterations++;
   frame->dead_exits.clear();
 
@@ -1983,7 +2066,7 @@ void ExecutorState::CleanupFramesIterations(FrameState* frame, int64 iter,
               << "].";
     }
 
-    delete frame->GetIteration(curr_iter);
+    DeleteIteration(frame->GetIteration(curr_iter));
     frame->SetIteration(curr_iter, nullptr);
     --frame->num_outstanding_iterations;
     ++curr_iter;
@@ -324,11 +324,23 @@ Status BaseGPUDevice::FillContextMap(const Graph* graph,
   int64 elapsed = Env::Default()->NowMicros() - before;
   VLOG(3) << "AssignStreams took " << elapsed << "us";
 
+  // AssignStreams numbers the streams of every graph from 0, so successive
+  // graphs start at successive streams. Graphs run concurrently, like the
+  // partitions of different Session::Run signatures, then mostly use
+  // different streams rather than all serializing on stream 0.
+  int first_stream;
+  {
+    mutex_lock l(stream_mu_);
+    first_stream = next_first_stream_;
+    next_first_stream_ = (next_first_stream_ + 1) % num_streams;
+  }
+
   // Fill in the context map.  It is OK for this map to contain
   // duplicate DeviceContexts so long as we increment the refcount.
   device_context_map->resize(graph->num_node_ids());
   for (Node* n : graph->nodes()) {
-    auto mapped_stream = node_to_stream_id[n->id()];
+    auto mapped_stream =
+        (node_to_stream_id[n->id()] + first_stream) % num_streams;
     CHECK_LE(mapped_stream, num_streams);
     auto ctx = device_contexts_[mapped_stream];
     VLOG(3) << "Assigned stream " << node_to_stream_id[n->id()]
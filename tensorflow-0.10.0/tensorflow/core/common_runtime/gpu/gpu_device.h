@@ -95,6 +95,9 @@ class BaseGPUDevice : public LocalDevice {
   std::vector<GPUDeviceContext*> device_contexts_;
   GpuDeviceInfo* gpu_device_info_ = nullptr;
   mutex trace_mu_;
+  mutex stream_mu_;
+  // Stream that FillContextMap maps the first stream of the next graph to.
+  int next_first_stream_ GUARDED_BY(stream_mu_) = 0;
   int gpu_id_ = -1;
   const bool sync_every_op_ = false;
   std::unique_ptr<EventMgr> em_;
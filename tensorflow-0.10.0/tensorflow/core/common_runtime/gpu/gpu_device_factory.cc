@@ -17,12 +17,23 @@ limitations under the License.
 
 #define EIGEN_USE_GPU
 
+#include <algorithm>
+
 #include "tensorflow/core/common_runtime/gpu/gpu_device.h"
 #include "tensorflow/core/common_runtime/gpu/process_state.h"
 #include "tensorflow/core/common_runtime/threadpool_device.h"
 
 namespace tensorflow {
 
+namespace {
+
+// Returns the number of compute streams to create for each GPU.
+int32 NumComputeStreams(const SessionOptions& options) {
+  return std::max(1, options.config.gpu_options().num_compute_streams());
+}
+
+}  // namespace
+
 class GPUDevice : public BaseGPUDevice {
  public:
   GPUDevice(const SessionOptions& options, const string& name,
@@ -31,7 +42,8 @@ class GPUDevice : public BaseGPUDevice {
             Allocator* cpu_allocator)
       : BaseGPUDevice(options, name, memory_limit, bus_adjacency, gpu_id,
                       physical_device_desc, gpu_allocator, cpu_allocator,
-                      false /* sync every op */, 1 /* max_streams */) {}
+                      false /* sync every op */,
+                      NumComputeStreams(options) /* max_streams */) {}
 
   Allocator* GetAllocator(AllocatorAttributes attr) override {
     if (attr.on_host()) {
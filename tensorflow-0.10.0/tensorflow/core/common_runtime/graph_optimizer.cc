@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/function.h"
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/optimizer_cse.h"
+#include "tensorflow/core/platform/env.h"
 
 namespace tensorflow {
 
@@ -41,9 +42,13 @@ void GraphOptimizer::Optimize(FunctionLibraryRuntime* runtime, Device* device,
   }
 
   DumpGraph("Initial", g);
+  const int64 start = Env::Default()->NowMicros();
+  const int num_nodes = g->num_nodes();
   bool changed = true;
   const int kMaxRounds = 10;
-  for (int rounds = 0; rounds < kMaxRounds; ++rounds) {
+  int rounds = 0;
+  while (rounds < kMaxRounds) {
+    ++rounds;
     changed = false;
     if (opts_.do_function_inlining() && RemoveListArrayConverter(g)) {
       DumpGraph("RemoveListArrayConverter", g);
@@ -88,6 +93,9 @@ void GraphOptimizer::Optimize(FunctionLibraryRuntime* runtime, Device* device,
   delete g;
   *graph = copy;
   DumpGraph("ReCopy", *graph);
+  VLOG(1) << "GraphOptimizer took " << rounds << " rounds and "
+          << Env::Default()->NowMicros() - start << "us to optimize "
+          << num_nodes << " nodes into " << (*graph)->num_nodes();
 }
 
 }  // end namespace tensorflow
@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/local_device.h"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/common_runtime/cpu_affinity.h"
 #include "tensorflow/core/common_runtime/eigen_thread_pool.h"
 #include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/host_info.h"
@@ -26,29 +27,37 @@ limitations under the License.
 
 namespace tensorflow {
 
-namespace {
-
-DeviceBase::CpuWorkerThreads eigen_worker_threads;
-Eigen::ThreadPoolInterface* eigen_thread_pool = nullptr;
-Eigen::ThreadPoolDevice* eigen_device = nullptr;
+// The intra-op thread pool and the Eigen compute device using it.
+struct LocalDevice::EigenThreadPoolInfo {
+  EigenThreadPoolInfo(const SessionOptions& options,
+                      const ThreadOptions& thread_options) {
+    int32 intra_op_parallelism_threads =
+        options.config.intra_op_parallelism_threads();
+    if (intra_op_parallelism_threads == 0) {
+      intra_op_parallelism_threads = port::NumSchedulableCPUs();
+    }
+    VLOG(1) << "Local device intra op parallelism threads: "
+            << intra_op_parallelism_threads;
+    eigen_worker_threads.num_threads = intra_op_parallelism_threads;
+    eigen_worker_threads.workers = new thread::ThreadPool(
+        options.env, thread_options, "Eigen", intra_op_parallelism_threads,
+        options.config.use_work_stealing_thread_pools());
+    eigen_thread_pool.reset(
+        new EigenThreadPoolWrapper(eigen_worker_threads.workers));
+    eigen_device.reset(new Eigen::ThreadPoolDevice(
+        eigen_thread_pool.get(), eigen_worker_threads.num_threads));
+  }
 
-static bool InitModule(const SessionOptions& options) {
-  int32 intra_op_parallelism_threads =
-      options.config.intra_op_parallelism_threads();
-  if (intra_op_parallelism_threads == 0) {
-    intra_op_parallelism_threads = port::NumSchedulableCPUs();
+  ~EigenThreadPoolInfo() {
+    eigen_device.reset();
+    eigen_thread_pool.reset();
+    delete eigen_worker_threads.workers;
   }
-  VLOG(1) << "Local device intra op parallelism threads: "
-          << intra_op_parallelism_threads;
-  eigen_worker_threads.num_threads = intra_op_parallelism_threads;
-  eigen_worker_threads.workers = new thread::ThreadPool(
-      options.env, "Eigen", intra_op_parallelism_threads);
-  eigen_thread_pool = new EigenThreadPoolWrapper(eigen_worker_threads.workers);
-  eigen_device = new Eigen::ThreadPoolDevice(eigen_thread_pool,
-                                             eigen_worker_threads.num_threads);
-  return true;
-}
-}  // end namespace
+
+  DeviceBase::CpuWorkerThreads eigen_worker_threads;
+  std::unique_ptr<Eigen::ThreadPoolInterface> eigen_thread_pool;
+  std::unique_ptr<Eigen::ThreadPoolDevice> eigen_device;
+};
 
 // LocalDevice ----------------------------------------------------------------
 
@@ -56,12 +65,22 @@ LocalDevice::LocalDevice(const SessionOptions& options,
                          const DeviceAttributes& attributes,
                          Allocator* device_allocator)
     : Device(options.env, attributes, device_allocator) {
-  // All ThreadPoolDevices in the process will use this single fixed
-  // sized threadpool for numerical computations.
-  static bool init = InitModule(options);
-  CHECK(init);  // Avoids compiler warning that init is unused.
-  set_tensorflow_cpu_worker_threads(&eigen_worker_threads);
-  set_eigen_cpu_device(eigen_device);
+  EigenThreadPoolInfo* tp_info;
+  const ThreadOptions thread_options = ThreadOptionsFromSessionOptions(options);
+  if (thread_options.cpu_affinity.empty()) {
+    // All other ThreadPoolDevices in the process will use this single fixed
+    // sized threadpool for numerical computations.
+    static EigenThreadPoolInfo* global_tp_info =
+        new EigenThreadPoolInfo(options, thread_options);
+    tp_info = global_tp_info;
+  } else {
+    owned_tp_info_.reset(new EigenThreadPoolInfo(options, thread_options));
+    tp_info = owned_tp_info_.get();
+  }
+  set_tensorflow_cpu_worker_threads(&tp_info->eigen_worker_threads);
+  set_eigen_cpu_device(tp_info->eigen_device.get());
 }
 
+LocalDevice::~LocalDevice() {}
+
 }  // namespace tensorflow
@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_COMMON_RUNTIME_LOCAL_DEVICE_H_
 #define TENSORFLOW_COMMON_RUNTIME_LOCAL_DEVICE_H_
 
+#include <memory>
+
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/framework/device_attributes.pb.h"
 #include "tensorflow/core/platform/macros.h"
@@ -28,13 +30,21 @@ struct SessionOptions;
 // initializes a shared Eigen compute device used by both.  This
 // should eventually be removed once we refactor ThreadPoolDevice and
 // GPUDevice into more 'process-wide' abstractions.
+//
+// Devices of sessions with a ConfigProto.cpu_affinity have their own Eigen
+// compute device instead, whose threads run on those CPUs.
 class LocalDevice : public Device {
  public:
   LocalDevice(const SessionOptions& options, const DeviceAttributes& attributes,
               Allocator* device_allocator);
-  ~LocalDevice() override {}
+  ~LocalDevice() override;
 
  private:
+  struct EigenThreadPoolInfo;
+
+  // The Eigen compute device owned by this device, if any.
+  std::unique_ptr<EigenThreadPoolInfo> owned_tp_info_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(LocalDevice);
 };
 
@@ -0,0 +1,178 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/matmul_fusion.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/public/session_options.h"
+#include "tensorflow/core/util/device_name_utils.h"
+
+namespace tensorflow {
+
+namespace {
+
+bool OnCpu(const Node* n) {
+  DeviceNameUtils::ParsedName parsed;
+  return DeviceNameUtils::ParseFullName(n->assigned_device_name(), &parsed) &&
+         parsed.has_type && parsed.type == DEVICE_CPU;
+}
+
+// Returns the node that consumes the output 0 of 'n' at its input 0, if it
+// is the only one using 'n', and nullptr otherwise.
+Node* SoleConsumer(const Node* n) {
+  if (n->out_edges().size() != 1) return nullptr;
+  const Edge* e = *n->out_edges().begin();
+  if (e->IsControlEdge() || e->src_output() != 0 || e->dst_input() != 0) {
+    return nullptr;
+  }
+  return e->dst();
+}
+
+// Returns the data inputs of 'n' ordered by input index, and appends the
+// sources of its control inputs to 'control_inputs'.
+std::vector<const Edge*> InputEdges(const Node* n,
+                                    std::vector<Node*>* control_inputs) {
+  std::vector<const Edge*> inputs(n->num_inputs(), nullptr);
+  for (const Edge* e : n->in_edges()) {
+    if (e->IsControlEdge()) {
+      control_inputs->push_back(e->src());
+    } else {
+      inputs[e->dst_input()] = e;
+    }
+  }
+  return inputs;
+}
+
+bool FuseChain(Graph* g, Node* matmul) {
+  DataType dtype;
+  if (!GetNodeAttr(matmul->def(), "T", &dtype).ok() ||
+      (dtype != DT_FLOAT && dtype != DT_DOUBLE) || !OnCpu(matmul)) {
+    return false;
+  }
+  Node* bias_add = SoleConsumer(matmul);
+  if (bias_add == nullptr ||
+      (bias_add->type_string() != "BiasAdd" &&
+       bias_add->type_string() != "BiasAddV1") ||
+      bias_add->assigned_device_name() != matmul->assigned_device_name()) {
+    return false;
+  }
+  string data_format;
+  if (GetNodeAttr(bias_add->def(), "data_format", &data_format).ok() &&
+      data_format != "NHWC") {
+    return false;
+  }
+  Node* relu = SoleConsumer(bias_add);
+  if (relu != nullptr &&
+      (relu->type_string() != "Relu" ||
+       relu->assigned_device_name() != matmul->assigned_device_name())) {
+    relu = nullptr;
+  }
+  Node* last = relu != nullptr ? relu : bias_add;
+
+  std::vector<Node*> control_inputs;
+  const std::vector<const Edge*> matmul_inputs =
+      InputEdges(matmul, &control_inputs);
+  const std::vector<const Edge*> bias_add_inputs =
+      InputEdges(bias_add, &control_inputs);
+  if (relu != nullptr) InputEdges(relu, &control_inputs);
+  bool transpose_a;
+  bool transpose_b;
+  if (!GetNodeAttr(matmul->def(), "transpose_a", &transpose_a).ok() ||
+      !GetNodeAttr(matmul->def(), "transpose_b", &transpose_b).ok()) {
+    return false;
+  }
+
+  Node* fused;
+  const Status s =
+      NodeBuilder(last->name(), "_FusedMatMul")
+          .Input(matmul_inputs[0]->src(), matmul_inputs[0]->src_output())
+          .Input(matmul_inputs[1]->src(), matmul_inputs[1]->src_output())
+          .Input(bias_add_inputs[1]->src(), bias_add_inputs[1]->src_output())
+          .ControlInputs(control_inputs)
+          .Attr("T", dtype)
+          .Attr("transpose_a", transpose_a)
+          .Attr("transpose_b", transpose_b)
+          .Attr("fused_relu", relu != nullptr)
+          .Device(last->def().device())
+          .Finalize(g, &fused);
+  if (!s.ok()) {
+    LOG(WARNING) << "Could not fuse " << matmul->name() << ": " << s;
+    return false;
+  }
+  fused->set_assigned_device_name(last->assigned_device_name());
+
+  std::vector<const Edge*> out_edges(last->out_edges().begin(),
+                                     last->out_edges().end());
+  for (const Edge* e : out_edges) {
+    g->AddEdge(fused, e->src_output(), e->dst(), e->dst_input());
+  }
+  g->RemoveNode(last);
+  if (relu != nullptr) g->RemoveNode(bias_add);
+  g->RemoveNode(matmul);
+  return true;
+}
+
+// Binaries may link the MatMul kernels without the fused one.
+bool HasFusedKernel() {
+  NodeDef def;
+  def.set_op("_FusedMatMul");
+  AddNodeAttr("T", DT_FLOAT, &def);
+  return FindKernelDef(DeviceType(DEVICE_CPU), def, nullptr, nullptr).ok();
+}
+
+}  // namespace
+
+bool FuseMatMulBiasAdd(Graph* g) {
+  std::vector<Node*> matmuls;
+  for (Node* n : g->nodes()) {
+    if (n->type_string() == "MatMul") matmuls.push_back(n);
+  }
+  bool changed = false;
+  for (Node* matmul : matmuls) {
+    if (FuseChain(g, matmul)) changed = true;
+  }
+  return changed;
+}
+
+Status MatMulFusionPass::Run(const GraphOptimizationPassOptions& options) {
+  if (options.session_options != nullptr) {
+    const OptimizerOptions& opts =
+        options.session_options->config.graph_options().optimizer_options();
+    if (!opts.do_op_fusion() && opts.opt_level() < OptimizerOptions::L1) {
+      return Status::OK();
+    }
+  }
+  if (options.graph == nullptr || *options.graph == nullptr ||
+      !HasFusedKernel()) {
+    return Status::OK();
+  }
+  if (FuseMatMulBiasAdd(options.graph->get())) {
+    VLOG(1) << "Fused MatMul and BiasAdd chains";
+  }
+  return Status::OK();
+}
+
+// After the rewrite for the feeds and fetches, so that chains whose
+// intermediate tensors are fetched are left alone.
+REGISTER_OPTIMIZATION(OptimizationPassRegistry::POST_REWRITE_FOR_EXEC, 0,
+                      MatMulFusionPass);
+
+}  // namespace tensorflow
@@ -0,0 +1,45 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// An optimization pass that fuses MatMul -> BiasAdd (-> Relu) chains, as
+// built by tf.nn.xw_plus_b and tf.nn.relu_layer, into _FusedMatMul nodes.
+
+#ifndef TENSORFLOW_COMMON_RUNTIME_MATMUL_FUSION_H_
+#define TENSORFLOW_COMMON_RUNTIME_MATMUL_FUSION_H_
+
+#include "tensorflow/core/common_runtime/optimization_registry.h"
+#include "tensorflow/core/graph/graph.h"
+
+namespace tensorflow {
+
+// Replaces each float or double MatMul placed on a CPU device whose only
+// consumer is a BiasAdd on the same device, along with that BiasAdd and
+// its Relu if the Relu is the BiasAdd's only consumer, by one _FusedMatMul
+// that takes the name of the last node of the chain.
+//
+// Returns true if and only if 'g' is mutated.
+bool FuseMatMulBiasAdd(Graph* g);
+
+// Runs FuseMatMulBiasAdd on the placed graph of each step, unless the
+// optimizer options of the session disable op fusion or the binary has no
+// _FusedMatMul kernel.
+class MatMulFusionPass : public GraphOptimizationPass {
+ public:
+  Status Run(const GraphOptimizationPassOptions& options) override;
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_COMMON_RUNTIME_MATMUL_FUSION_H_
@@ -0,0 +1,140 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/matmul_fusion.h"
+
+#include <map>
+#include <vector>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/graph/graph_constructor.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+const char* kCpu = "/job:localhost/replica:0/task:0/cpu:0";
+
+// x and w feed a MatMul, then a BiasAdd with b, then 'last_op'.
+const char* kLayer = R"proto(
+  node { name: 'x' op: 'Placeholder'
+         attr { key: 'dtype' value { type: DT_FLOAT } } }
+  node { name: 'w' op: 'Placeholder'
+         attr { key: 'dtype' value { type: DT_FLOAT } } }
+  node { name: 'b' op: 'Placeholder'
+         attr { key: 'dtype' value { type: DT_FLOAT } } }
+  node { name: 'mm' op: 'MatMul' input: 'x' input: 'w'
+         attr { key: 'T' value { type: DT_FLOAT } }
+         attr { key: 'transpose_a' value { b: false } }
+         attr { key: 'transpose_b' value { b: true } } }
+  node { name: 'bias' op: 'BiasAdd' input: 'mm' input: 'b'
+         attr { key: 'T' value { type: DT_FLOAT } } }
+  node { name: 'layer' op: '%s' input: 'bias'
+         attr { key: 'T' value { type: DT_FLOAT } } }
+  node { name: 'out' op: 'Identity' input: 'layer'
+         attr { key: 'T' value { type: DT_FLOAT } } }
+)proto";
+
+class MatMulFusionTest : public ::testing::Test {
+ protected:
+  MatMulFusionTest() : graph_(OpRegistry::Global()) {}
+
+  void Build(const string& text, const string& device = kCpu) {
+    GraphDef def;
+    ASSERT_TRUE(protobuf::TextFormat::ParseFromString(text, &def));
+    TF_ASSERT_OK(ConvertGraphDefToGraph(GraphConstructorOptions(), def,
+                                        &graph_));
+    for (Node* n : graph_.nodes()) {
+      if (n->IsOp()) n->set_assigned_device_name(device);
+    }
+  }
+
+  static string Layer(const string& last_op) {
+    return strings::Printf(kLayer, last_op.c_str());
+  }
+
+  // Maps the names of the op nodes to their types.
+  std::map<string, string> Ops() {
+    std::map<string, string> ops;
+    for (const Node* n : graph_.nodes()) {
+      if (n->IsOp()) ops[n->name()] = n->type_string();
+    }
+    return ops;
+  }
+
+  Node* Find(const string& name) {
+    for (Node* n : graph_.nodes()) {
+      if (n->name() == name) return n;
+    }
+    return nullptr;
+  }
+
+  Graph graph_;
+};
+
+TEST_F(MatMulFusionTest, FusesReluLayer) {
+  Build(Layer("Relu"));
+  EXPECT_TRUE(FuseMatMulBiasAdd(&graph_));
+  EXPECT_EQ((std::map<string, string>{{"x", "Placeholder"},
+                                       {"w", "Placeholder"},
+                                       {"b", "Placeholder"},
+                                       {"layer", "_FusedMatMul"},
+                                       {"out", "Identity"}}),
+            Ops());
+  Node* fused = Find("layer");
+  EXPECT_EQ(kCpu, fused->assigned_device_name());
+  bool value;
+  TF_ASSERT_OK(GetNodeAttr(fused->def(), "fused_relu", &value));
+  EXPECT_TRUE(value);
+  TF_ASSERT_OK(GetNodeAttr(fused->def(), "transpose_b", &value));
+  EXPECT_TRUE(value);
+  for (const Edge* e : fused->in_edges()) {
+    if (e->IsControlEdge()) continue;
+    EXPECT_EQ(std::vector<string>({"x", "w", "b"})[e->dst_input()],
+              e->src()->name());
+  }
+  EXPECT_FALSE(FuseMatMulBiasAdd(&graph_));
+}
+
+TEST_F(MatMulFusionTest, FusesBiasAddWithOtherConsumer) {
+  Build(Layer("Tanh"));
+  EXPECT_TRUE(FuseMatMulBiasAdd(&graph_));
+  EXPECT_EQ("_FusedMatMul", Ops()["bias"]);
+  EXPECT_EQ("Tanh", Ops()["layer"]);
+  bool fused_relu;
+  TF_ASSERT_OK(GetNodeAttr(Find("bias")->def(), "fused_relu", &fused_relu));
+  EXPECT_FALSE(fused_relu);
+}
+
+TEST_F(MatMulFusionTest, KeepsMatMulWithOtherUses) {
+  Build(strings::StrCat(Layer("Relu"),
+                        "node { name: 'mm_out' op: 'Identity' input: 'mm' "
+                        "       attr { key: 'T' value { type: DT_FLOAT } } }"));
+  EXPECT_FALSE(FuseMatMulBiasAdd(&graph_));
+  EXPECT_EQ("MatMul", Ops()["mm"]);
+}
+
+TEST_F(MatMulFusionTest, KeepsGpuNodes) {
+  Build(Layer("Relu"), "/job:localhost/replica:0/task:0/gpu:0");
+  EXPECT_FALSE(FuseMatMulBiasAdd(&graph_));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,132 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/partition_graph_cache.h"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/framework/attr_value.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/lib/random/random.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/fingerprint.h"
+#include "tensorflow/core/public/version.h"
+
+namespace tensorflow {
+
+namespace {
+
+uint64 Mix(uint64 fingerprint, const string& s) {
+  return Hash64(s.data(), s.size(), fingerprint);
+}
+
+}  // namespace
+
+PartitionGraphCache::PartitionGraphCache(const string& dir) : dir_(dir) {}
+
+string PartitionGraphCache::GraphKey(const GraphDef& graph,
+                                     const DeviceSet& devices,
+                                     const ConfigProto& config) {
+  // The kernels and passes of another binary may build other graphs.
+  uint64 fingerprint = Mix(0, TF_VERSION_STRING);
+  fingerprint = Mix(fingerprint, strings::StrCat(TF_GRAPH_DEF_VERSION));
+
+  for (const NodeDef& node : graph.node()) {
+    fingerprint = Mix(fingerprint, node.name());
+    fingerprint = Mix(fingerprint, node.op());
+    for (const string& input : node.input()) {
+      fingerprint = Mix(fingerprint, input);
+    }
+    fingerprint = Mix(fingerprint, node.device());
+    std::vector<std::pair<string, const AttrValue*>> attrs;
+    for (const auto& attr : node.attr()) {
+      attrs.emplace_back(attr.first, &attr.second);
+    }
+    std::sort(attrs.begin(), attrs.end());
+    for (const auto& attr : attrs) {
+      fingerprint = Mix(fingerprint, attr.first);
+      fingerprint = Mix(fingerprint, attr.second->SerializeAsString());
+    }
+  }
+  fingerprint = Mix(fingerprint, graph.versions().SerializeAsString());
+  fingerprint = Mix(fingerprint, graph.library().SerializeAsString());
+
+  for (const Device* device : devices.devices()) {
+    fingerprint = Mix(fingerprint, device->name());
+    fingerprint = Mix(fingerprint, device->device_type());
+    fingerprint = Mix(fingerprint, device->attributes().physical_device_desc());
+  }
+  fingerprint = Mix(fingerprint, devices.client_device()->name());
+
+  // The options that placement and optimization depend on.
+  GraphOptions graph_options = config.graph_options();
+  graph_options.clear_partition_graph_cache_dir();
+  fingerprint = Mix(fingerprint, graph_options.SerializeAsString());
+  fingerprint =
+      Mix(fingerprint, strings::StrCat(config.allow_soft_placement()));
+  for (const string& filter : config.device_filters()) {
+    fingerprint = Mix(fingerprint, filter);
+  }
+  return strings::StrCat(strings::Hex(fingerprint, strings::ZERO_PAD_16));
+}
+
+string PartitionGraphCache::FileName(const string& key) const {
+  return io::JoinPath(
+      dir_, strings::StrCat(strings::Hex(Fingerprint64(key),
+                                         strings::ZERO_PAD_16),
+                            ".partitions"));
+}
+
+Status PartitionGraphCache::Lookup(const string& key,
+                                   PartitionGraphs* entry) const {
+  Env* env = Env::Default();
+  const string fname = FileName(key);
+  if (!env->FileExists(fname)) {
+    return errors::NotFound("No cached partition graphs in ", fname);
+  }
+  TF_RETURN_IF_ERROR(ReadBinaryProto(env, fname, entry));
+  if (entry->key() != key) {
+    // Another key with the same fingerprint.
+    return errors::NotFound("Cached partition graphs in ", fname,
+                            " are for another key");
+  }
+  return Status::OK();
+}
+
+Status PartitionGraphCache::Insert(const string& key,
+                                   PartitionGraphs* entry) const {
+  Env* env = Env::Default();
+  if (!env->FileExists(dir_)) {
+    // Another process may create it meanwhile, so the error is ignored.
+    env->CreateDir(dir_);
+  }
+  entry->set_key(key);
+  const string fname = FileName(key);
+  const string tmp_name =
+      strings::StrCat(fname, ".tmp", strings::Hex(random::New64()));
+  TF_RETURN_IF_ERROR(
+      WriteStringToFile(env, tmp_name, entry->SerializeAsString()));
+  const Status s = env->RenameFile(tmp_name, fname);
+  if (!s.ok()) env->DeleteFile(tmp_name);
+  return s;
+}
+
+}  // namespace tensorflow
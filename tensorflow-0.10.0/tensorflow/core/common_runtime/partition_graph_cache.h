@@ -0,0 +1,63 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMMON_RUNTIME_PARTITION_GRAPH_CACHE_H_
+#define TENSORFLOW_COMMON_RUNTIME_PARTITION_GRAPH_CACHE_H_
+
+#include <string>
+
+#include "tensorflow/core/common_runtime/device_set.h"
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/protobuf/config.pb.h"
+#include "tensorflow/core/protobuf/partition_graph_cache.pb.h"
+
+namespace tensorflow {
+
+// Keeps the partition graphs that a session builds for a set of feeds,
+// fetches and targets in files of a directory, one per key, so that other
+// processes running the same graph can skip placing and optimizing it.
+// Thread-safe, and safe for several processes sharing the directory.
+class PartitionGraphCache {
+ public:
+  explicit PartitionGraphCache(const string& dir);
+
+  // Returns the part of the keys that identifies "graph" placed on
+  // "devices" with "config", and this binary.  Independent of the order of
+  // the attrs of the nodes, unlike the serialized GraphDef.
+  static string GraphKey(const GraphDef& graph, const DeviceSet& devices,
+                         const ConfigProto& config);
+
+  // Reads the entry of "key" into "entry".  Returns NotFound if there is
+  // none.
+  Status Lookup(const string& key, PartitionGraphs* entry) const;
+
+  // Writes "entry" for "key", replacing any previous one.  Readers see
+  // either the previous entry or the whole new one.
+  Status Insert(const string& key, PartitionGraphs* entry) const;
+
+ private:
+  string FileName(const string& key) const;
+
+  const string dir_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PartitionGraphCache);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_COMMON_RUNTIME_PARTITION_GRAPH_CACHE_H_
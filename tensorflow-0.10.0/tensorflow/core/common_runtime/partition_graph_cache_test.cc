@@ -0,0 +1,118 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/partition_graph_cache.h"
+
+#include <memory>
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/path.h"
+#include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class FakeDevice : public Device {
+ public:
+  explicit FakeDevice(const DeviceAttributes& attr)
+      : Device(nullptr, attr, nullptr) {}
+  Status Sync() override { return Status::OK(); }
+  Allocator* GetAllocator(AllocatorAttributes) override { return nullptr; }
+};
+
+class PartitionGraphCacheTest : public ::testing::Test {
+ protected:
+  PartitionGraphCacheTest() {
+    DeviceAttributes attr;
+    attr.set_name("/job:localhost/replica:0/task:0/cpu:0");
+    attr.set_device_type("CPU");
+    device_.reset(new FakeDevice(attr));
+    devices_.AddDevice(device_.get());
+    devices_.set_client_device(device_.get());
+  }
+
+  static GraphDef Parse(const char* text) {
+    GraphDef graph;
+    CHECK(protobuf::TextFormat::ParseFromString(text, &graph));
+    return graph;
+  }
+
+  string Key(const GraphDef& graph) {
+    return PartitionGraphCache::GraphKey(graph, devices_, ConfigProto());
+  }
+
+  std::unique_ptr<Device> device_;
+  DeviceSet devices_;
+};
+
+TEST_F(PartitionGraphCacheTest, GraphKey) {
+  const GraphDef graph = Parse(
+      "node { name: 'a' op: 'Const' "
+      "       attr { key: 'dtype' value { type: DT_FLOAT } } "
+      "       attr { key: 'value' value { tensor { dtype: DT_FLOAT "
+      "                                            float_val: 1 } } } }");
+  const GraphDef reordered = Parse(
+      "node { name: 'a' op: 'Const' "
+      "       attr { key: 'value' value { tensor { dtype: DT_FLOAT "
+      "                                            float_val: 1 } } } "
+      "       attr { key: 'dtype' value { type: DT_FLOAT } } }");
+  const GraphDef other = Parse(
+      "node { name: 'a' op: 'Const' "
+      "       attr { key: 'dtype' value { type: DT_FLOAT } } "
+      "       attr { key: 'value' value { tensor { dtype: DT_FLOAT "
+      "                                            float_val: 2 } } } }");
+  EXPECT_EQ(Key(graph), Key(reordered));
+  EXPECT_NE(Key(graph), Key(other));
+
+  ConfigProto config;
+  config.set_allow_soft_placement(true);
+  EXPECT_NE(Key(graph),
+            PartitionGraphCache::GraphKey(graph, devices_, config));
+  // The cache directory does not change the graphs.
+  config.set_allow_soft_placement(false);
+  config.mutable_graph_options()->set_partition_graph_cache_dir("/tmp/x");
+  EXPECT_EQ(Key(graph),
+            PartitionGraphCache::GraphKey(graph, devices_, config));
+}
+
+TEST_F(PartitionGraphCacheTest, InsertAndLookup) {
+  PartitionGraphCache cache(
+      io::JoinPath(testing::TmpDir(), "partition_graph_cache_test"));
+  PartitionGraphs entry;
+  EXPECT_TRUE(errors::IsNotFound(cache.Lookup("key", &entry)));
+
+  (*entry.mutable_partitions())["/job:localhost/replica:0/task:0/cpu:0"] =
+      Parse("node { name: 'a' op: 'NoOp' }");
+  (*entry.mutable_stateful_placements())["v"] =
+      "/job:localhost/replica:0/task:0/cpu:0";
+  TF_ASSERT_OK(cache.Insert("key", &entry));
+
+  PartitionGraphs read;
+  TF_ASSERT_OK(cache.Lookup("key", &read));
+  EXPECT_EQ(entry.SerializeAsString(), read.SerializeAsString());
+  EXPECT_TRUE(errors::IsNotFound(cache.Lookup("other key", &read)));
+
+  // Inserting again replaces the entry.
+  entry.mutable_partitions()->clear();
+  TF_ASSERT_OK(cache.Insert("key", &entry));
+  TF_ASSERT_OK(cache.Lookup("key", &read));
+  EXPECT_EQ(0, read.partitions_size());
+}
+
+}  // namespace
+}  // namespace tensorflow
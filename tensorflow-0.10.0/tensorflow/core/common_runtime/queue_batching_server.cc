@@ -0,0 +1,224 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/queue_batching_server.h"
+
+#include <utility>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+QueueBatchingServer::QueueBatchingServer(Session* session,
+                                         const Options& options)
+    : session_(session), options_(options) {}
+
+Status QueueBatchingServer::Create(
+    Session* session, const Options& options,
+    std::unique_ptr<QueueBatchingServer>* server) {
+  if (options.num_batch_threads < 1) {
+    return errors::InvalidArgument("num_batch_threads must be positive, got ",
+                                   options.num_batch_threads);
+  }
+  std::unique_ptr<QueueBatchingServer> result(
+      new QueueBatchingServer(session, options));
+
+  result->enqueue_step_.feeds.push_back(options.id_feed);
+  result->enqueue_step_.feeds.insert(result->enqueue_step_.feeds.end(),
+                                     options.request_feeds.begin(),
+                                     options.request_feeds.end());
+  result->enqueue_step_.targets.push_back(options.enqueue_op);
+  TF_RETURN_IF_ERROR(result->PrepareStep(&result->enqueue_step_));
+
+  result->batch_step_.fetches.push_back(options.batch_ids_fetch);
+  result->batch_step_.fetches.insert(result->batch_step_.fetches.end(),
+                                     options.batch_fetches.begin(),
+                                     options.batch_fetches.end());
+  TF_RETURN_IF_ERROR(result->PrepareStep(&result->batch_step_));
+
+  result->num_running_ = options.num_batch_threads;
+  for (int i = 0; i < options.num_batch_threads; ++i) {
+    QueueBatchingServer* server_ptr = result.get();
+    result->threads_.emplace_back(Env::Default()->StartThread(
+        ThreadOptions(), strings::StrCat("queue_batching_server_", i),
+        [server_ptr]() { server_ptr->BatchLoop(); }));
+  }
+  *server = std::move(result);
+  return Status::OK();
+}
+
+QueueBatchingServer::~QueueBatchingServer() {
+  const Status status = session_->Run({}, {}, {options_.close_op}, nullptr);
+  if (!status.ok()) {
+    LOG(ERROR) << "Could not close the batching queue: " << status;
+  }
+  // Joins the batch threads, which stop once the queue is empty.
+  threads_.clear();
+  FailPending(errors::Cancelled("The batching server was shut down"));
+  for (Step* step : {&enqueue_step_, &batch_step_}) {
+    if (step->callable) {
+      const Status release_status = session_->ReleaseCallable(step->handle);
+      if (!release_status.ok()) LOG(WARNING) << release_status;
+    }
+  }
+}
+
+Status QueueBatchingServer::PrepareStep(Step* step) {
+  const Status status = session_->MakeCallable(step->feeds, step->fetches,
+                                               step->targets, &step->handle);
+  if (errors::IsUnimplemented(status)) {
+    // Sessions without callables run the step by name.
+    return Status::OK();
+  }
+  TF_RETURN_IF_ERROR(status);
+  step->callable = true;
+  return Status::OK();
+}
+
+Status QueueBatchingServer::RunStep(const Step& step,
+                                    const std::vector<Tensor>& inputs,
+                                    std::vector<Tensor>* outputs) {
+  if (step.callable) {
+    return session_->RunCallable(step.handle, inputs, outputs);
+  }
+  std::vector<std::pair<string, Tensor>> feeds;
+  feeds.reserve(inputs.size());
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    feeds.emplace_back(step.feeds[i], inputs[i]);
+  }
+  return session_->Run(feeds, step.fetches, step.targets, outputs);
+}
+
+Status QueueBatchingServer::Run(const std::vector<Tensor>& inputs,
+                                std::vector<Tensor>* outputs) {
+  if (inputs.size() != options_.request_feeds.size()) {
+    return errors::InvalidArgument("Expected ", options_.request_feeds.size(),
+                                   " request inputs, got ", inputs.size());
+  }
+  Pending pending;
+  Tensor id(DT_INT64, TensorShape({}));
+  {
+    mutex_lock l(mu_);
+    if (num_running_ == 0) return stop_status_;
+    id.scalar<int64>()() = next_id_++;
+    pending_[id.scalar<int64>()()] = &pending;
+  }
+
+  std::vector<Tensor> step_inputs;
+  step_inputs.reserve(inputs.size() + 1);
+  step_inputs.push_back(id);
+  step_inputs.insert(step_inputs.end(), inputs.begin(), inputs.end());
+  std::vector<Tensor> unused;
+  const Status status = RunStep(enqueue_step_, step_inputs, &unused);
+  if (!status.ok()) {
+    mutex_lock l(mu_);
+    if (pending_.erase(id.scalar<int64>()()) == 1) return status;
+    // FailPending() has already claimed the request, and will notify it.
+  }
+
+  pending.done.WaitForNotification();
+  TF_RETURN_IF_ERROR(pending.status);
+  *outputs = std::move(pending.outputs);
+  return Status::OK();
+}
+
+void QueueBatchingServer::BatchLoop() {
+  Status status;
+  for (;;) {
+    std::vector<Tensor> fetched;
+    status = RunStep(batch_step_, {}, &fetched);
+    // The queue is closed and empty, or the session is going away.
+    if (errors::IsOutOfRange(status) || errors::IsCancelled(status)) break;
+    if (!status.ok()) {
+      LOG(ERROR) << "Batch step failed: " << status;
+      FailPending(status);
+      continue;
+    }
+    FinishBatch(fetched);
+  }
+  bool last = false;
+  {
+    mutex_lock l(mu_);
+    last = --num_running_ == 0;
+    if (last) stop_status_ = status;
+  }
+  // Nothing would serve the requests that are still waiting.
+  if (last) FailPending(status);
+}
+
+void QueueBatchingServer::FinishBatch(const std::vector<Tensor>& fetched) {
+  const Tensor& ids = fetched[0];
+  Status status;
+  if (ids.dtype() != DT_INT64 || ids.dims() != 1) {
+    status = errors::InvalidArgument("Batch ids ", options_.batch_ids_fetch,
+                                     " must be an int64 vector, got ",
+                                     ids.DebugString());
+  }
+  const int64 batch_size = status.ok() ? ids.dim_size(0) : 0;
+  for (size_t i = 1; i < fetched.size() && status.ok(); ++i) {
+    if (fetched[i].dims() < 1 || fetched[i].dim_size(0) != batch_size) {
+      status = errors::InvalidArgument(
+          "Batch output ", options_.batch_fetches[i - 1], " of shape ",
+          fetched[i].shape().DebugString(), " does not have ", batch_size,
+          " rows");
+    }
+  }
+  if (!status.ok()) {
+    LOG(ERROR) << status;
+    FailPending(status);
+    return;
+  }
+
+  auto ids_vec = ids.vec<int64>();
+  for (int64 row = 0; row < batch_size; ++row) {
+    Pending* pending = nullptr;
+    {
+      mutex_lock l(mu_);
+      auto it = pending_.find(ids_vec(row));
+      if (it == pending_.end()) {
+        // Failed along with an earlier batch step.
+        continue;
+      }
+      pending = it->second;
+      pending_.erase(it);
+    }
+    pending->outputs.reserve(fetched.size() - 1);
+    for (size_t i = 1; i < fetched.size(); ++i) {
+      // Shares the buffer of the batch output.
+      TensorShape row_shape = fetched[i].shape();
+      row_shape.RemoveDim(0);
+      Tensor output;
+      CHECK(output.CopyFrom(fetched[i].Slice(row, row + 1), row_shape));
+      pending->outputs.push_back(output);
+    }
+    pending->done.Notify();
+  }
+}
+
+void QueueBatchingServer::FailPending(const Status& status) {
+  std::unordered_map<int64, Pending*> failed;
+  {
+    mutex_lock l(mu_);
+    failed.swap(pending_);
+  }
+  for (const auto& entry : failed) {
+    entry.second->status = status;
+    entry.second->done.Notify();
+  }
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,149 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMMON_RUNTIME_QUEUE_BATCHING_SERVER_H_
+#define TENSORFLOW_COMMON_RUNTIME_QUEUE_BATCHING_SERVER_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/public/session.h"
+
+namespace tensorflow {
+
+// Serves single requests in dynamically sized batches with a graph built
+// around a queue, typically a BatchingFIFOQueue so that batches wait for
+// at most its batch_timeout_micros.  The graph must have
+//  - an enqueue op that enqueues one request, made of a scalar int64 id
+//    fed to `id_feed` and the tensors fed to `request_feeds`;
+//  - a batch step that dequeues up to n requests with QueueDequeueUpTo,
+//    runs the model on them, and produces `batch_ids_fetch`, the ids of
+//    the dequeued requests, and `batch_fetches`, each with the batch as its
+//    0th dimension;
+//  - a close op that closes the queue, cancelling pending enqueues.
+//
+// Run() enqueues a request and waits until a batch thread has run the
+// batch step on it.  Each batch thread runs the batch step in a loop and
+// hands every request its row of the batch outputs.
+//
+// Example:
+//   QueueBatchingServer::Options options;
+//   options.id_feed = "request_id";
+//   options.request_feeds = {"request_input"};
+//   options.enqueue_op = "enqueue";
+//   options.batch_ids_fetch = "dequeue:0";
+//   options.batch_fetches = {"scores"};
+//   options.close_op = "close";
+//   std::unique_ptr<QueueBatchingServer> server;
+//   TF_CHECK_OK(QueueBatchingServer::Create(session, options, &server));
+//   std::vector<Tensor> scores;
+//   TF_CHECK_OK(server->Run({input}, &scores));
+class QueueBatchingServer {
+ public:
+  struct Options {
+    string id_feed;
+    std::vector<string> request_feeds;
+    string enqueue_op;
+    string batch_ids_fetch;
+    std::vector<string> batch_fetches;
+    string close_op;
+
+    // More than one thread lets the dequeue of a batch overlap the model
+    // step of the previous one.
+    int num_batch_threads = 1;
+  };
+
+  // Starts the batch threads.  Does not take ownership of `session`, which
+  // must outlive the server and already have the graph.
+  static Status Create(Session* session, const Options& options,
+                       std::unique_ptr<QueueBatchingServer>* server);
+
+  // Closes the queue and waits for the batch threads, which first serve
+  // the requests left in the queue.  Calls of Run() that are still
+  // enqueueing fail with the error of their enqueue op.
+  ~QueueBatchingServer();
+
+  // Runs one request with `inputs` fed to options.request_feeds and returns
+  // its rows of options.batch_fetches, without the batch dimension, in
+  // `outputs`.  Thread-safe; blocks until the request's batch has run.
+  //
+  // If a batch step fails, the batch's ids are unknown, so every request
+  // waiting at that time fails with its error.  A batch thread stops when
+  // the batch step reports the queue closed (OutOfRange) or is cancelled;
+  // once all have stopped, Run() fails with that error.
+  Status Run(const std::vector<Tensor>& inputs, std::vector<Tensor>* outputs);
+
+ private:
+  // A request waiting for its batch.
+  struct Pending {
+    Notification done;
+    Status status;
+    std::vector<Tensor> outputs;
+  };
+
+  // A step run through a callable when the session supports them.
+  struct Step {
+    std::vector<string> feeds;
+    std::vector<string> fetches;
+    std::vector<string> targets;
+    bool callable = false;
+    int64 handle = 0;
+  };
+
+  QueueBatchingServer(Session* session, const Options& options);
+
+  Status PrepareStep(Step* step);
+  Status RunStep(const Step& step, const std::vector<Tensor>& inputs,
+                 std::vector<Tensor>* outputs);
+
+  void BatchLoop();
+
+  // Hands each request of a batch its outputs.
+  void FinishBatch(const std::vector<Tensor>& fetched);
+
+  // Fails every pending request with `status`.
+  void FailPending(const Status& status);
+
+  Session* const session_;  // Not owned.
+  const Options options_;
+  Step enqueue_step_;
+  Step batch_step_;
+
+  mutex mu_;
+  int64 next_id_ GUARDED_BY(mu_) = 0;
+  std::unordered_map<int64, Pending*> pending_ GUARDED_BY(mu_);
+  // Batch threads that have not stopped, and the error that stopped the
+  // last one.
+  int num_running_ GUARDED_BY(mu_) = 0;
+  Status stop_status_ GUARDED_BY(mu_);
+
+  std::vector<std::unique_ptr<Thread>> threads_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(QueueBatchingServer);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_COMMON_RUNTIME_QUEUE_BATCHING_SERVER_H_
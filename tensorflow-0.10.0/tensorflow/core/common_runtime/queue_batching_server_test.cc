@@ -0,0 +1,160 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/queue_batching_server.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+// Requests are (id, x) pairs in a BatchingFIFOQueue, and each batch of up
+// to four of them computes x * 2.
+const char* kGraph = R"proto(
+  node {
+    name: 'queue' op: 'BatchingFIFOQueue'
+    attr { key: 'component_types' value { list { type: DT_INT64
+                                                 type: DT_FLOAT } } }
+    attr { key: 'shapes' value { list { shape {} shape {} } } }
+    attr { key: 'capacity' value { i: 100 } }
+    attr { key: 'batch_timeout_micros' value { i: 1000 } }
+  }
+  node {
+    name: 'id' op: 'Placeholder'
+    attr { key: 'dtype' value { type: DT_INT64 } }
+  }
+  node {
+    name: 'x' op: 'Placeholder'
+    attr { key: 'dtype' value { type: DT_FLOAT } }
+  }
+  node {
+    name: 'enqueue' op: 'QueueEnqueue' input: 'queue' input: 'id' input: 'x'
+    attr { key: 'Tcomponents' value { list { type: DT_INT64
+                                             type: DT_FLOAT } } }
+  }
+  node {
+    name: 'batch_size' op: 'Const'
+    attr { key: 'dtype' value { type: DT_INT32 } }
+    attr { key: 'value' value { tensor { dtype: DT_INT32
+                                         tensor_shape {} int_val: 4 } } }
+  }
+  node {
+    name: 'dequeue' op: 'QueueDequeueUpTo' input: 'queue'
+    input: 'batch_size'
+    attr { key: 'component_types' value { list { type: DT_INT64
+                                                 type: DT_FLOAT } } }
+  }
+  node {
+    name: 'two' op: 'Const'
+    attr { key: 'dtype' value { type: DT_FLOAT } }
+    attr { key: 'value' value { tensor { dtype: DT_FLOAT
+                                         tensor_shape {} float_val: 2 } } }
+  }
+  node {
+    name: 'y' op: 'Mul' input: 'dequeue:1' input: 'two'
+    attr { key: 'T' value { type: DT_FLOAT } }
+  }
+  node {
+    name: 'close' op: 'QueueClose' input: 'queue'
+    attr { key: 'cancel_pending_enqueues' value { b: true } }
+  }
+)proto";
+
+class QueueBatchingServerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    GraphDef graph;
+    ASSERT_TRUE(protobuf::TextFormat::ParseFromString(kGraph, &graph));
+    session_.reset(NewSession(SessionOptions()));
+    TF_ASSERT_OK(session_->Create(graph));
+  }
+
+  QueueBatchingServer::Options ServerOptions(int num_batch_threads) {
+    QueueBatchingServer::Options options;
+    options.id_feed = "id";
+    options.request_feeds = {"x"};
+    options.enqueue_op = "enqueue";
+    options.batch_ids_fetch = "dequeue:0";
+    options.batch_fetches = {"y"};
+    options.close_op = "close";
+    options.num_batch_threads = num_batch_threads;
+    return options;
+  }
+
+  static Tensor Scalar(float value) {
+    Tensor tensor(DT_FLOAT, TensorShape({}));
+    tensor.scalar<float>()() = value;
+    return tensor;
+  }
+
+  std::unique_ptr<Session> session_;
+};
+
+TEST_F(QueueBatchingServerTest, SingleRequestDoesNotWaitForFullBatch) {
+  std::unique_ptr<QueueBatchingServer> server;
+  TF_ASSERT_OK(
+      QueueBatchingServer::Create(session_.get(), ServerOptions(1), &server));
+  std::vector<Tensor> outputs;
+  TF_ASSERT_OK(server->Run({Scalar(3)}, &outputs));
+  ASSERT_EQ(1, outputs.size());
+  test::ExpectTensorEqual<float>(Scalar(6), outputs[0]);
+}
+
+TEST_F(QueueBatchingServerTest, ConcurrentRequestsGetTheirOwnRows) {
+  std::unique_ptr<QueueBatchingServer> server;
+  TF_ASSERT_OK(
+      QueueBatchingServer::Create(session_.get(), ServerOptions(2), &server));
+  const int kNumRequests = 50;
+  std::vector<Status> statuses(kNumRequests);
+  std::vector<std::vector<Tensor>> outputs(kNumRequests);
+  {
+    thread::ThreadPool pool(Env::Default(), "requests", 8);
+    for (int i = 0; i < kNumRequests; ++i) {
+      pool.Schedule([&server, &statuses, &outputs, i]() {
+        statuses[i] = server->Run({Scalar(i)}, &outputs[i]);
+      });
+    }
+  }
+  for (int i = 0; i < kNumRequests; ++i) {
+    TF_ASSERT_OK(statuses[i]);
+    ASSERT_EQ(1, outputs[i].size());
+    test::ExpectTensorEqual<float>(Scalar(2 * i), outputs[i][0]);
+  }
+}
+
+TEST_F(QueueBatchingServerTest, FailsAfterQueueIsClosed) {
+  std::unique_ptr<QueueBatchingServer> server;
+  TF_ASSERT_OK(
+      QueueBatchingServer::Create(session_.get(), ServerOptions(1), &server));
+  std::vector<Tensor> outputs;
+  EXPECT_TRUE(errors::IsInvalidArgument(server->Run({}, &outputs)));
+  TF_ASSERT_OK(session_->Run({}, {}, {"close"}, nullptr));
+  EXPECT_FALSE(server->Run({Scalar(1)}, &outputs).ok());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -51,6 +51,26 @@ Status Session::PRun(const string& handle,
       "Partial run is not supported for this session.");
 }
 
+Status Session::MakeCallable(const std::vector<string>& input_names,
+                             const std::vector<string>& output_names,
+                             const std::vector<string>& target_nodes,
+                             int64* handle) {
+  return errors::Unimplemented("Callables are not supported for this session.");
+}
+
+Status Session::RunCallable(int64 handle, const std::vector<Tensor>& inputs,
+                            std::vector<Tensor>* outputs) {
+  return errors::Unimplemented("Callables are not supported for this session.");
+}
+
+Status Session::ReleaseCallable(int64 handle) {
+  return errors::Unimplemented("Callables are not supported for this session.");
+}
+
+Status Session::Warmup(const std::vector<RunSignature>& signatures) {
+  return errors::Unimplemented("Warmup is not supported for this session.");
+}
+
 Session* NewSession(const SessionOptions& options) {
   SessionFactory* factory;
   Status s = SessionFactory::GetFactory(options, &factory);
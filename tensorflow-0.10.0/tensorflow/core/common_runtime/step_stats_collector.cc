@@ -15,14 +15,23 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/step_stats_collector.h"
 
 #include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/framework/tracking_allocator.h"
 #include "tensorflow/core/graph/costmodel.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/sampling_tracer.h"
 
 namespace tensorflow {
 
 StepStatsCollector::StepStatsCollector(StepStats* ss,
                                        CostModelManager* cost_model_manager)
-    : step_stats_(ss), cost_model_manager_(cost_model_manager) {}
+    : step_stats_(ss),
+      cost_model_manager_(cost_model_manager),
+      tracer_(nullptr) {}
+
+StepStatsCollector::StepStatsCollector(SamplingTracer* tracer)
+    : step_stats_(nullptr), cost_model_manager_(nullptr), tracer_(tracer) {}
+
+StepStatsCollector::~StepStatsCollector() { Finalize(); }
 
 void StepStatsCollector::UpdateCostModelNode(const NodeExecStats* nt,
                                              const Graph* graph,
@@ -45,11 +54,35 @@ void StepStatsCollector::UpdateCostModelNode(const NodeExecStats* nt,
   }
 }
 
+void StepStatsCollector::TrackLiveBytes(const NodeExecStats* nt, int index,
+                                        TrackingAllocator* allocator) {
+  mutex_lock l(mu_);
+  unsaved_[nt].emplace_back(index, allocator);
+}
+
 void StepStatsCollector::Save(const string& device, NodeExecStats* nt) {
   VLOG(1) << "Save dev " << device << " nt " << nt;
+  TrackedAllocators tracked;
+  {
+    mutex_lock l(mu_);
+    auto it = unsaved_.find(nt);
+    if (it != unsaved_.end()) {
+      tracked.swap(it->second);
+      unsaved_.erase(it);
+    }
+  }
+  if (tracer_ != nullptr) {
+    tracer_->Record(device, nt->node_name(), SamplingTracer::kOpStage,
+                    nt->op_end_rel_micros() - nt->op_start_rel_micros());
+    delete nt;
+    return;
+  }
   {
     mutex_lock l(mu_);
     if (!step_stats_) {
+      for (const auto& index_and_allocator : tracked) {
+        index_and_allocator.second->GetLiveBytesAndUnRef();
+      }
       delete nt;
       return;
     }
@@ -67,12 +100,35 @@ void StepStatsCollector::Save(const string& device, NodeExecStats* nt) {
       dss = step_stats_->add_dev_stats();
       dss->set_device(device);
     }
-    nt->Swap(dss->add_node_stats());
+    NodeExecStats* saved = dss->add_node_stats();
+    nt->Swap(saved);
+    if (!tracked.empty()) saved_.emplace_back(saved, std::move(tracked));
   }
   delete nt;
 }
 
+void StepStatsCollector::Finalize() {
+  mutex_lock l(mu_);
+  for (const auto& nt_and_tracked : saved_) {
+    for (const auto& index_and_allocator : nt_and_tracked.second) {
+      AllocatorMemoryUsed* memory =
+          nt_and_tracked.first->mutable_memory(index_and_allocator.first);
+      memory->set_live_bytes(
+          index_and_allocator.second->GetLiveBytesAndUnRef());
+    }
+  }
+  saved_.clear();
+  // Node stats that were never saved, e.g. of an aborted step.
+  for (const auto& nt_and_tracked : unsaved_) {
+    for (const auto& index_and_allocator : nt_and_tracked.second) {
+      index_and_allocator.second->GetLiveBytesAndUnRef();
+    }
+  }
+  unsaved_.clear();
+}
+
 void StepStatsCollector::Swap(StepStats* ss) {
+  Finalize();
   mutex_lock l(mu_);
   CHECK(step_stats_);
   ss->Swap(step_stats_);
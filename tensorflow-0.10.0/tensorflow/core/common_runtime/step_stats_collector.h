@@ -16,6 +16,9 @@ limitations under the License.
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_STEP_STATS_COLLECTOR_H_
 
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
 #include "tensorflow/core/common_runtime/costmodel_manager.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
@@ -27,24 +30,60 @@ class CostModel;
 class Graph;
 class Node;
 class NodeExecStats;
+class SamplingTracer;
 class StepStats;
+class TrackingAllocator;
 
 class StepStatsCollector {
  public:
   explicit StepStatsCollector(StepStats* ss,
                               CostModelManager* cost_model_manager = nullptr);
 
+  // Creates a collector for a step sampled by 'tracer', which only needs the
+  // compute time of each node: Save() records it in 'tracer' instead of
+  // keeping the stats.
+  explicit StepStatsCollector(SamplingTracer* tracer);
+
+  // Calls Finalize().
+  ~StepStatsCollector();
+
+  // Returns true if the collector is for a sampled step, in which case the
+  // executor skips the memory, tensor and timeline details of the node stats.
+  bool sampled() const { return tracer_ != nullptr; }
+
   void UpdateCostModelNode(const NodeExecStats* nt, const Graph* graph,
                            const Node* node);
 
+  // Takes over the reference of the caller of allocator->GetSizes() to the
+  // tracking allocator of the memory(index) entry of 'nt'. Once 'nt' is saved,
+  // Finalize() records the bytes that are still allocated through it in the
+  // live_bytes of the saved entry.
+  void TrackLiveBytes(const NodeExecStats* nt, int index,
+                      TrackingAllocator* allocator);
+
   void Save(const string& device, NodeExecStats* nt);
 
+  // Records the live bytes of the node stats saved so far, and releases the
+  // tracking allocators. Called at the end of the step, once all the nodes
+  // are done.
+  void Finalize();
+
   void Swap(StepStats* ss);
 
  private:
+  // The tracking allocators of memory entries, by their index.
+  using TrackedAllocators = std::vector<std::pair<int, TrackingAllocator*>>;
+
   mutex mu_;
+  // Tracking allocators of node stats that are not saved yet.
+  std::unordered_map<const NodeExecStats*, TrackedAllocators> unsaved_
+      GUARDED_BY(mu_);
+  // Tracking allocators of saved node stats in step_stats_.
+  std::vector<std::pair<NodeExecStats*, TrackedAllocators>> saved_
+      GUARDED_BY(mu_);
   StepStats* step_stats_ GUARDED_BY(mu_);
   CostModelManager* cost_model_manager_ GUARDED_BY(mu_);
+  SamplingTracer* const tracer_;
 };
 
 }  // namespace tensorflow
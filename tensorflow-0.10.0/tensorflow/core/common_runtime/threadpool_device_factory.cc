@@ -17,6 +17,7 @@ limitations under the License.
 #include "tensorflow/core/common_runtime/threadpool_device.h"
 
 #include <vector>
+#include "tensorflow/core/common_runtime/cpu_bfc_allocator.h"
 #include "tensorflow/core/common_runtime/device_factory.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/public/session_options.h"
@@ -35,10 +36,13 @@ class ThreadPoolDeviceFactory : public DeviceFactory {
     if (iter != options.config.device_count().end()) {
       n = iter->second;
     }
+    Allocator* allocator = options.config.use_cpu_memory_pool()
+                               ? ProcessCPUBFCAllocator(options.config)
+                               : cpu_allocator();
     for (int i = 0; i < n; i++) {
       string name = strings::StrCat(name_prefix, "/cpu:", i);
       devices->push_back(new ThreadPoolDevice(options, name, Bytes(256 << 20),
-                                              BUS_ANY, cpu_allocator()));
+                                              BUS_ANY, allocator));
     }
   }
 };
@@ -16,7 +16,10 @@ limitations under the License.
 #ifndef THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_CALL_H_
 #define THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_CALL_H_
 
+#include <deque>
+
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
 
 #include "grpc++/grpc++.h"
 #include "grpc++/server_builder.h"
@@ -160,6 +163,12 @@ class Call : public UntypedCall<Service> {
     }
   }
 
+  // Compresses the response on the wire with "algorithm".  Must be called
+  // before SendResponse().
+  void SetCompressionAlgorithm(grpc_compression_algorithm algorithm) {
+    ctx_.set_compression_algorithm(algorithm);
+  }
+
   void SendResponse(::grpc::Status status) {
     responder_.Finish(response, status,
                       new typename UntypedCall<Service>::Tag(
@@ -241,6 +250,197 @@ class Call : public UntypedCall<Service> {
   std::unique_ptr<typename UntypedCall<Service>::Tag> cancel_tag_;
 };
 
+// Represents a pending call to a server-streaming method, which writes a
+// stream of responses before it finishes.  Follows the same lifecycle as
+// `Call`, except that the handler may `Write()` any number of responses,
+// from any thread, before it calls `Finish()` instead of `SendResponse()`.
+template <class Service, class GrpcService, class RequestMessage,
+          class ResponseMessage>
+class ServerStreamingCall : public UntypedCall<Service> {
+ public:
+  // Represents the generic signature of a generated
+  // `GrpcService::RequestFoo()` method for a server-streaming method `Foo`.
+  using EnqueueFunction = void (GrpcService::*)(
+      ::grpc::ServerContext*, RequestMessage*,
+      ::grpc::ServerAsyncWriter<ResponseMessage>*, ::grpc::CompletionQueue*,
+      ::grpc::ServerCompletionQueue*, void*);
+
+  // Represents the generic signature of a `Service::HandleFoo()`
+  // method, where `Foo` is the name of an RPC method.
+  using HandleRequestFunction = void (Service::*)(
+      ServerStreamingCall<Service, GrpcService, RequestMessage,
+                          ResponseMessage>*);
+
+  ServerStreamingCall(HandleRequestFunction handle_request_function)
+      : handle_request_function_(handle_request_function), writer_(&ctx_) {}
+
+  virtual ~ServerStreamingCall() {}
+
+  void RequestReceived(Service* service, bool ok) override {
+    if (ok) {
+      this->Ref();
+      (service->*handle_request_function_)(this);
+    }
+  }
+
+  // Queues "response" to be written to the stream.  gRPC allows only one
+  // write in flight at a time, so the responses are written one after the
+  // other as the previous ones complete.
+  void Write(ResponseMessage response) {
+    mutex_lock l(mu_);
+    if (finish_requested_ || write_failed_) return;
+    if (write_in_flight_) {
+      pending_.push_back(std::move(response));
+    } else {
+      StartWrite(std::move(response));
+    }
+  }
+
+  // Compresses the responses on the wire with "algorithm", unless one has
+  // already been written: the encoding of a stream is fixed by its initial
+  // metadata, which goes out with the first response.
+  void MaybeSetCompressionAlgorithm(grpc_compression_algorithm algorithm) {
+    mutex_lock l(mu_);
+    if (!write_started_) ctx_.set_compression_algorithm(algorithm);
+  }
+
+  // Finishes the call with "status" once the queued responses are written.
+  void Finish(::grpc::Status status) {
+    {
+      mutex_lock l(mu_);
+      finish_requested_ = true;
+      finish_status_ = status;
+      if (write_in_flight_) return;  // WriteDone() finishes the call.
+      StartFinish();
+    }
+    this->Unref();
+  }
+
+  void RequestCancelled(Service* service, bool ok) override {
+    if (ctx_.IsCancelled()) {
+      mutex_lock l(mu_);
+      if (cancel_callback_) {
+        cancel_callback_();
+      }
+    }
+    // NOTE(mrry): This can be called before or after RequestReceived, so we
+    // release `cancel_tag_` (in order to allow the event loop to free it).
+    cancel_tag_.release();
+  }
+
+  // Registers `callback` as the function that should be called if and when this
+  // call is cancelled by the client.
+  void SetCancelCallback(std::function<void()> callback) {
+    mutex_lock l(mu_);
+    cancel_callback_ = callback;
+  }
+
+  // Clears any cancellation callback that has been registered for this call.
+  void ClearCancelCallback() {
+    mutex_lock l(mu_);
+    cancel_callback_ = nullptr;
+  }
+
+  // Enqueues a new request for the given service on the given
+  // completion queue, using the given `enqueue_function`.
+  //
+  // The request will be handled with the given
+  // `handle_request_function`.
+  static void EnqueueRequest(GrpcService* grpc_service,
+                             ::grpc::ServerCompletionQueue* cq,
+                             EnqueueFunction enqueue_function,
+                             HandleRequestFunction handle_request_function,
+                             bool supports_cancel) {
+    auto call = new ServerStreamingCall<Service, GrpcService, RequestMessage,
+                                        ResponseMessage>(
+        handle_request_function);
+    if (supports_cancel) {
+      call->RegisterCancellationHandler();
+    }
+
+    (grpc_service->*enqueue_function)(
+        &call->ctx_, &call->request, &call->writer_, cq, cq,
+        new typename UntypedCall<Service>::Tag(
+            call, &UntypedCall<Service>::RequestReceived));
+    call->Unref();
+  }
+
+  RequestMessage request;
+
+ private:
+  // Called when the write of `in_flight_` completes.
+  void WriteDone(Service* service, bool ok) {
+    bool finish = false;
+    {
+      mutex_lock l(mu_);
+      write_in_flight_ = false;
+      if (!ok) {
+        // The stream is broken, so there is no point in further writes.
+        write_failed_ = true;
+        pending_.clear();
+      }
+      if (!pending_.empty()) {
+        ResponseMessage response = std::move(pending_.front());
+        pending_.pop_front();
+        StartWrite(std::move(response));
+      } else if (finish_requested_) {
+        StartFinish();
+        finish = true;
+      }
+    }
+    if (finish) {
+      // Releases the reference that Finish() did not.
+      this->Unref();
+    }
+  }
+
+  void StartWrite(ResponseMessage response) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    write_in_flight_ = true;
+    write_started_ = true;
+    in_flight_ = std::move(response);
+    writer_.Write(in_flight_,
+                  new typename UntypedCall<Service>::Tag(
+                      this, static_cast<typename UntypedCall<Service>::Tag::
+                                            Callback>(
+                                &ServerStreamingCall::WriteDone)));
+  }
+
+  void StartFinish() EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    writer_.Finish(finish_status_,
+                   new typename UntypedCall<Service>::Tag(
+                       this, &UntypedCall<Service>::ResponseSent));
+  }
+
+  // Creates a completion queue tag for handling cancellation by the client.
+  // NOTE: This method must be called before this call is enqueued on a
+  // completion queue.
+  void RegisterCancellationHandler() {
+    cancel_tag_.reset(new typename UntypedCall<Service>::Tag(
+        this, &UntypedCall<Service>::RequestCancelled));
+    ctx_.AsyncNotifyWhenDone(cancel_tag_.get());
+  }
+
+  HandleRequestFunction handle_request_function_;
+  ::grpc::ServerContext ctx_;
+  ::grpc::ServerAsyncWriter<ResponseMessage> writer_;
+  mutex mu_;
+  std::function<void()> cancel_callback_ GUARDED_BY(mu_);
+
+  ResponseMessage in_flight_ GUARDED_BY(mu_);  // Being written.
+  std::deque<ResponseMessage> pending_ GUARDED_BY(mu_);
+  bool write_in_flight_ GUARDED_BY(mu_) = false;
+  bool write_started_ GUARDED_BY(mu_) = false;
+  bool write_failed_ GUARDED_BY(mu_) = false;
+  bool finish_requested_ GUARDED_BY(mu_) = false;
+  ::grpc::Status finish_status_ GUARDED_BY(mu_);
+
+  // This tag is initially owned by `*this` and borrowed by
+  // `ctx_->AsyncNotifyWhenDone()`. Ownership is transferred to the
+  // appropriate service's completion queue after
+  // `this->RequestReceived(..., true)` is called.
+  std::unique_ptr<typename UntypedCall<Service>::Tag> cancel_tag_;
+};
+
 }  // namespace tensorflow
 
 #endif  // THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_CALL_H_
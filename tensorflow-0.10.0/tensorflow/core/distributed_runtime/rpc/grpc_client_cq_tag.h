@@ -30,9 +30,9 @@ class GrpcClientCQTag {
  public:
   GrpcClientCQTag(::grpc::ClientContext* context, StatusCallback cb)
       : context_(context), cb_(cb) {}
-  ~GrpcClientCQTag() { delete context_; }
+  virtual ~GrpcClientCQTag() { delete context_; }
 
-  void OnCompleted(bool ok) {
+  virtual void OnCompleted(bool ok) {
     if (!ok) {
       VLOG(2) << "Call returned with non-ok status: "
               << status_.error_message();
@@ -51,6 +51,23 @@ class GrpcClientCQTag {
   TF_DISALLOW_COPY_AND_ASSIGN(GrpcClientCQTag);
 };
 
+// Represents one operation of a pending asynchronous streaming call, such as
+// reading a message, as a tag that can be stored in a `grpc::CompletionQueue`
+// alongside `GrpcClientCQTag`s.  The callback is told whether the operation
+// succeeded.
+class GrpcClientStreamCQTag : public GrpcClientCQTag {
+ public:
+  explicit GrpcClientStreamCQTag(std::function<void(bool ok)> cb)
+      : GrpcClientCQTag(nullptr, nullptr), stream_cb_(std::move(cb)) {}
+
+  void OnCompleted(bool ok) override { stream_cb_(ok); }
+
+ private:
+  std::function<void(bool ok)> stream_cb_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(GrpcClientStreamCQTag);
+};
+
 }  // namespace tensorflow
 
 #endif  // THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_CLIENT_CQ_TAG_H_
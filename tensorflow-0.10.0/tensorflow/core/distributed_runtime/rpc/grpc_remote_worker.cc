@@ -35,10 +35,14 @@ class GrpcRemoteWorker : public WorkerInterface {
  public:
   explicit GrpcRemoteWorker(SharedGrpcChannelPtr channel,
                             ::grpc::CompletionQueue* completion_queue,
-                            WorkerCacheLogger* logger)
+                            WorkerCacheLogger* logger,
+                            const TensorCompressionOptions& compression)
       : stub_(grpc::WorkerService::NewStub(channel)),
         cq_(completion_queue),
-        logger_(logger) {}
+        logger_(logger),
+        compression_(compression),
+        request_compression_(compression.min_string_tensor_bytes() > 0 ||
+                             compression.min_numeric_tensor_bytes() > 0) {}
 
   ~GrpcRemoteWorker() override {}
 
@@ -89,12 +93,18 @@ class GrpcRemoteWorker : public WorkerInterface {
                        StatusCallback done) override {
     VLOG(1) << "RecvTensorAsync req: " << request->DebugString();
     int64 start_usec = Env::Default()->NowMicros();
-    // Don't propagate dma_ok over gRPC.
+    // Don't propagate dma_ok over gRPC, and ask for this channel's
+    // compression unless the caller chose one.
     RecvTensorRequest* req_copy = nullptr;
-    if (request->dma_ok()) {
+    const bool add_compression =
+        request_compression_ && !request->has_compression();
+    if (request->dma_ok() || add_compression) {
       req_copy = new RecvTensorRequest;
       *req_copy = *request;
       req_copy->set_dma_ok(false);
+      if (add_compression) {
+        *req_copy->mutable_compression() = compression_;
+      }
     }
     // Type-specialized logging for this method.
     bool logging_active = logger_->LoggingActive() || VLOG_IS_ON(2);
@@ -159,6 +169,41 @@ class GrpcRemoteWorker : public WorkerInterface {
                  std::move(*cb_to_use), call_opts);
   }
 
+  void RecvTensorBatchAsync(CallOptions* call_opts,
+                            const RecvTensorBatchRequest* request,
+                            RecvTensorBatchCallback recv_one,
+                            StatusCallback done) override {
+    VLOG(1) << "RecvTensorBatchAsync req: " << request->DebugString();
+    RecvTensorBatchCall* call = new RecvTensorBatchCall;
+    call->call_opts = call_opts;
+    call->recv_one = std::move(recv_one);
+    call->done = std::move(done);
+    // The initialization and recovery protocols rely on blocking
+    // until we get a response.
+    call->context.set_fail_fast(false);
+    if (call_opts) {
+      ::grpc::ClientContext* context = &call->context;
+      call_opts->SetCancelCallback([context]() { context->TryCancel(); });
+    }
+    // The request is serialized when the call starts, so a copy with this
+    // channel's compression only has to live until then.
+    RecvTensorBatchRequest req_copy;
+    if (request_compression_ && !request->has_compression()) {
+      req_copy = *request;
+      *req_copy.mutable_compression() = compression_;
+      request = &req_copy;
+    }
+    call->reader = stub_->AsyncRecvTensorBatch(
+        &call->context, *request, cq_,
+        new GrpcClientStreamCQTag([call](bool ok) {
+          if (ok) {
+            ReadNextTensor(call);
+          } else {
+            FinishRecvTensorBatch(call);
+          }
+        }));
+  }
+
   void LoggingAsync(const LoggingRequest* request, LoggingResponse* response,
                     StatusCallback done) override {
     IssueRequest(request, response, &grpc::WorkerService::Stub::AsyncLogging,
@@ -172,6 +217,45 @@ class GrpcRemoteWorker : public WorkerInterface {
   }
 
  private:
+  // The state of a RecvTensorBatch call, which reads the tensors from the
+  // stream one at a time, and then finishes the call.
+  struct RecvTensorBatchCall {
+    ::grpc::ClientContext context;
+    std::unique_ptr<::grpc::ClientAsyncReader<RecvTensorBatchResponse>> reader;
+    RecvTensorBatchResponse response;
+    ::grpc::Status status;
+    CallOptions* call_opts;
+    RecvTensorBatchCallback recv_one;
+    StatusCallback done;
+  };
+
+  static void ReadNextTensor(RecvTensorBatchCall* call) {
+    call->reader->Read(&call->response,
+                       new GrpcClientStreamCQTag([call](bool ok) {
+                         if (!ok) {
+                           // The stream has ended.
+                           FinishRecvTensorBatch(call);
+                           return;
+                         }
+                         call->recv_one(call->response.index(),
+                                        call->response.mutable_response());
+                         ReadNextTensor(call);
+                       }));
+  }
+
+  static void FinishRecvTensorBatch(RecvTensorBatchCall* call) {
+    call->reader->Finish(&call->status,
+                         new GrpcClientStreamCQTag([call](bool ok) {
+                           if (call->call_opts) {
+                             call->call_opts->ClearCancelCallback();
+                           }
+                           Status s = FromGrpcStatus(call->status);
+                           StatusCallback done = std::move(call->done);
+                           delete call;
+                           done(s);
+                         }));
+  }
+
   template <class RequestMessage, class ResponseMessage>
   using AsyncMethod =
       std::unique_ptr<::grpc::ClientAsyncResponseReader<ResponseMessage>> (
@@ -211,13 +295,18 @@ class GrpcRemoteWorker : public WorkerInterface {
   WorkerCacheLogger* logger_;
   bool retry_unavailable_;
 
+  // The compression that RecvTensor requests on this channel ask for, and
+  // whether it compresses anything at all.
+  const TensorCompressionOptions compression_;
+  const bool request_compression_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(GrpcRemoteWorker);
 };
 
-WorkerInterface* NewGrpcRemoteWorker(SharedGrpcChannelPtr channel,
-                                     ::grpc::CompletionQueue* completion_queue,
-                                     WorkerCacheLogger* logger) {
-  return new GrpcRemoteWorker(channel, completion_queue, logger);
+WorkerInterface* NewGrpcRemoteWorker(
+    SharedGrpcChannelPtr channel, ::grpc::CompletionQueue* completion_queue,
+    WorkerCacheLogger* logger, const TensorCompressionOptions& compression) {
+  return new GrpcRemoteWorker(channel, completion_queue, logger, compression);
 }
 
 }  // namespace tensorflow
@@ -19,6 +19,7 @@ limitations under the License.
 #include <memory>
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_util.h"
+#include "tensorflow/core/protobuf/config.pb.h"
 
 namespace grpc {
 class CompletionQueue;
@@ -29,9 +30,11 @@ namespace tensorflow {
 class WorkerCacheLogger;
 class WorkerInterface;
 
-WorkerInterface* NewGrpcRemoteWorker(SharedGrpcChannelPtr channel,
-                                     ::grpc::CompletionQueue* completion_queue,
-                                     WorkerCacheLogger* logger);
+// RecvTensor requests sent on "channel" ask the remote worker to compress
+// the tensors as "compression" says, unless they set their own compression.
+WorkerInterface* NewGrpcRemoteWorker(
+    SharedGrpcChannelPtr channel, ::grpc::CompletionQueue* completion_queue,
+    WorkerCacheLogger* logger, const TensorCompressionOptions& compression);
 
 }  // namespace tensorflow
 
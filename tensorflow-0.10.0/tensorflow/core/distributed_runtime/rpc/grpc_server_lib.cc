@@ -173,7 +173,9 @@ Status GrpcServer::Init() {
     return errors::Internal("Could not parse port for local server from \"",
                             channel_cache->TranslateTask(name_prefix), "\".");
   }
-  worker_env_.worker_cache = NewGrpcWorkerCache(channel_cache.release());
+  worker_env_.worker_cache =
+      NewGrpcWorkerCache(channel_cache.release(),
+                         sess_opts.config.tensor_compression());
 
   // Finish setting up master environment.
   master_env_.ops = OpRegistry::Global();
@@ -14,6 +14,9 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_tensor_coding.h"
+
+#include <vector>
+
 #include "grpc++/support/byte_buffer.h"
 #include "grpc++/support/slice.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -74,19 +77,108 @@ void EncodeRecvTensorResponseToByteBuffer(const RecvTensorResponse& proto,
 // copying the tensor data (and the gpr_slice setup will be arrange so as
 // to dereference the underlying tensor data buffer when it is no longer
 // needed in the "*result" ByteBuffer).
-static int VarLengthEncodingSize(uint32 tag, size_t bytes) {
+static size_t VarLengthEncodingSize(uint32 tag, size_t bytes) {
   return core::VarintLength(tag << 3) + core::VarintLength(bytes) + bytes;
 }
 
+// Tensor data, or DT_STRING elements, larger than this are shared rather
+// than copied.
+static const size_t kLargeTensorBytes = 1024;
+
+// Encodes "response" with the DT_STRING tensor "val" as R.tensor().  The
+// elements are written straight from "val" as TensorProto::string_val
+// entries, i.e. a tag and varint32 length followed by the bytes of each,
+// rather than being copied into a TensorProto that is then serialized.
+//
+// The tags, lengths and small elements are copied into a single gpr_slice,
+// split by sub-slices around the elements larger than "kLargeTensorBytes",
+// which point into the strings of "val".  As for large numeric tensors, a
+// trailing zero-length slice keeps "val" alive while they are in use.
+static void EncodeStringTensorToByteBuffer(const RecvTensorResponse& response,
+                                           const Tensor& val,
+                                           ::grpc::ByteBuffer* result) {
+  TensorProto skeleton;
+  skeleton.set_dtype(val.dtype());
+  val.shape().AsProto(skeleton.mutable_tensor_shape());
+  string tensor_except_contents;  // tensor() field except string_val
+  skeleton.AppendToString(&tensor_except_contents);
+
+  const auto elements = val.flat<string>();
+  size_t contents_bytes = 0;
+  size_t large_bytes = 0;  // Total size of the shared elements
+  for (int64 i = 0; i < elements.size(); ++i) {
+    const size_t size = elements(i).size();
+    contents_bytes +=
+        VarLengthEncodingSize(TensorProto::kStringValFieldNumber, size);
+    if (size > kLargeTensorBytes) large_bytes += size;
+  }
+  const uint32 overall_tensor_proto_bytesize =
+      tensor_except_contents.size() + contents_bytes;
+
+  string header;  // All of RecvTensorResponse except the tensor() field
+  response.AppendToString(&header);
+
+  const size_t expected_size =
+      (header.size() +
+       VarLengthEncodingSize(RecvTensorResponse::kTensorFieldNumber,
+                             overall_tensor_proto_bytesize));
+  const size_t copied_size = expected_size - large_bytes;
+  gpr_slice copied = gpr_slice_malloc(copied_size);
+  io::ProtoEncodeHelper e(reinterpret_cast<char*>(GPR_SLICE_START_PTR(copied)),
+                          copied_size);
+  e.WriteRawBytes(header);
+  e.WriteVarlengthBeginning(RecvTensorResponse::kTensorFieldNumber,
+                            overall_tensor_proto_bytesize);
+  e.WriteRawBytes(tensor_except_contents);
+
+  std::vector<::grpc::Slice> slices;
+  size_t slice_begin = 0;  // Start of the copied bytes not yet in "slices"
+  for (int64 i = 0; i < elements.size(); ++i) {
+    const string& str = elements(i);
+    e.WriteVarlengthBeginning(TensorProto::kStringValFieldNumber, str.size());
+    if (str.size() <= kLargeTensorBytes) {
+      e.WriteRawBytes(str);
+      continue;
+    }
+    slices.emplace_back(gpr_slice_sub(copied, slice_begin, e.size()),
+                        ::grpc::Slice::STEAL_REF);
+    slice_begin = e.size();
+    gpr_slice shared =
+        gpr_slice_new(const_cast<char*>(str.data()), str.size(), do_nothing);
+    slices.emplace_back(shared, ::grpc::Slice::STEAL_REF);
+  }
+  if (slice_begin < e.size()) {
+    slices.emplace_back(gpr_slice_sub(copied, slice_begin, e.size()),
+                        ::grpc::Slice::STEAL_REF);
+  }
+  gpr_slice_unref(copied);
+
+  if (large_bytes > 0) {
+    // See the comments on the numeric path below about relying on the
+    // order in which slices are destroyed.
+    TensorReference* ref = new TensorReference(val);
+    gpr_slice s = gpr_slice_new(ref, 0, unref_tensorreference);
+    slices.emplace_back(s, ::grpc::Slice::STEAL_REF);
+  }
+  size_t total_bytes = 0;
+  for (const auto& slice : slices) {
+    total_bytes += slice.size();
+  }
+  CHECK_EQ(total_bytes, expected_size);
+
+  *result = ::grpc::ByteBuffer(slices.data(), slices.size());
+}
+
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
                               ::grpc::ByteBuffer* result) {
-  const int kLargeTensorBytes = 1024;
   RecvTensorResponse response;
   if (is_dead) {
     response.set_is_dead(is_dead);
   }
   response.set_send_start_micros(Env::Default()->NowMicros());
-  if (!DataTypeCanUseMemcpy(val.dtype())) {
+  if (val.dtype() == DT_STRING) {
+    EncodeStringTensorToByteBuffer(response, val, result);
+  } else if (!DataTypeCanUseMemcpy(val.dtype())) {
     // Straightforward but slow path for complicated kinds of tensor data
     // TODO(jeff,sanjay): If this becomes an issue, we could
     // go directly from val -> ByteBuffer, with some effort.
@@ -209,5 +301,35 @@ void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
   }
 }
 
+void WrapInRecvTensorBatchResponse(int32 index, ::grpc::ByteBuffer* buffer) {
+  std::vector<::grpc::Slice> slices;
+  (void)buffer->Dump(&slices);
+  size_t response_bytes = 0;
+  for (const auto& slice : slices) {
+    response_bytes += slice.size();
+  }
+
+  // The index and the tag and length of the response go in front of the
+  // response's slices.
+  char header_space[32];
+  io::ProtoEncodeHelper e(header_space, sizeof(header_space));
+  e.WriteUint64(RecvTensorBatchResponse::kIndexFieldNumber, index);
+  e.WriteVarlengthBeginning(RecvTensorBatchResponse::kResponseFieldNumber,
+                            response_bytes);
+  gpr_slice header = gpr_slice_malloc(e.size());
+  memcpy(GPR_SLICE_START_PTR(header), e.data(), e.size());
+  slices.insert(slices.begin(),
+                ::grpc::Slice(header, ::grpc::Slice::STEAL_REF));
+  *buffer = ::grpc::ByteBuffer(slices.data(), slices.size());
+}
+
+bool ShouldCompressTensor(const TensorCompressionOptions& options,
+                          DataType dtype, int64 encoded_bytes) {
+  const int64 min_bytes = dtype == DT_STRING
+                              ? options.min_string_tensor_bytes()
+                              : options.min_numeric_tensor_bytes();
+  return min_bytes > 0 && encoded_bytes >= min_bytes;
+}
+
 }  // namespace grpc
 }  // namespace tensorflow
@@ -16,6 +16,9 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_TENSOR_CODING_H_
 #define TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_TENSOR_CODING_H_
 
+#include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/platform/types.h"
+
 namespace grpc {
 class ByteBuffer;
 }  // namespace grpc
@@ -23,6 +26,7 @@ class ByteBuffer;
 namespace tensorflow {
 class Tensor;
 class RecvTensorResponse;
+class TensorCompressionOptions;
 
 namespace grpc {
 
@@ -48,6 +52,17 @@ void EncodeRecvTensorResponseToByteBuffer(const RecvTensorResponse& proto,
 void EncodeTensorToByteBuffer(bool is_dead, const Tensor& val,
                               ::grpc::ByteBuffer* result);
 
+// Turns "*buffer", which holds an encoded RecvTensorResponse, into the
+// encoding of a RecvTensorBatchResponse holding it with the given "index".
+// The encoded response is not copied.
+void WrapInRecvTensorBatchResponse(int32 index, ::grpc::ByteBuffer* buffer);
+
+// Returns whether a response whose encoding of a tensor of type "dtype"
+// takes "encoded_bytes" bytes should be compressed on the wire, as
+// "options" ask.
+bool ShouldCompressTensor(const TensorCompressionOptions& options,
+                          DataType dtype, int64 encoded_bytes);
+
 }  // namespace grpc
 }  // namespace tensorflow
 
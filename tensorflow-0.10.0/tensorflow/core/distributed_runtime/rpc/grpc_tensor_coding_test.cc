@@ -50,6 +50,10 @@ class GrpcTensorCodingTest : public ::testing::Test {
     EXPECT_EQ(t.dtype(), result_tensor.dtype());
     EXPECT_EQ(t.shape().DebugString(), result_tensor.shape().DebugString());
     EXPECT_EQ(t.DebugString(), result_tensor.DebugString());
+    if (t.dtype() == DT_STRING) {
+      // DebugString() only shows the first few elements.
+      test::ExpectTensorEqual<string>(t, result_tensor);
+    }
   }
 
   template <typename T>
@@ -100,4 +104,63 @@ TEST_F(GrpcTensorCodingTest, Simple) {
 
 TEST_F(GrpcTensorCodingTest, StringTensor) { DoTestForStrings(DT_STRING); }
 
+TEST_F(GrpcTensorCodingTest, LargeStringTensor) {
+  // Elements over 1024 bytes are shared with the tensor, the others copied.
+  Tensor a(DT_STRING, TensorShape({2, 4}));
+  test::FillValues<string>(
+      &a, {string(5000, 'a'), "", string(1025, 'b'), string(1024, 'c'),
+           "small", string(3000, 'd'), string(2000, 'e'), ""});
+  Validate(a, false);
+
+  Tensor b(DT_STRING, TensorShape({2}));
+  test::FillValues<string>(&b, {string(100000, 'x'), string(2000, 'y')});
+  Validate(b, true);
+}
+
+TEST_F(GrpcTensorCodingTest, WrapInRecvTensorBatchResponse) {
+  Tensor small(DT_FLOAT, TensorShape({2}));
+  test::FillValues<float>(&small, {1, 2});
+  Tensor large(DT_INT32, TensorShape({1000}));
+  test::FillIota<int32>(&large, 0);
+  int32 index = 0;
+  for (const Tensor& t : {small, large}) {
+    for (bool is_dead : {false, true}) {
+      ::grpc::ByteBuffer buf;
+      grpc::EncodeTensorToByteBuffer(is_dead, t, &buf);
+      grpc::WrapInRecvTensorBatchResponse(index, &buf);
+
+      std::vector<::grpc::Slice> slices;
+      (void)buf.Dump(&slices);
+      string tmp;
+      for (const auto& s : slices) {
+        tmp.append(reinterpret_cast<const char*>(s.begin()), s.size());
+      }
+      RecvTensorBatchResponse batch_response;
+      EXPECT_TRUE(batch_response.ParseFromString(tmp));
+      EXPECT_EQ(index, batch_response.index());
+      EXPECT_EQ(is_dead, batch_response.response().is_dead());
+      Tensor result_tensor;
+      EXPECT_TRUE(result_tensor.FromProto(batch_response.response().tensor()));
+      EXPECT_EQ(t.DebugString(), result_tensor.DebugString());
+      index += 1000;
+    }
+  }
+}
+
+TEST_F(GrpcTensorCodingTest, ShouldCompressTensor) {
+  TensorCompressionOptions options;
+  EXPECT_FALSE(grpc::ShouldCompressTensor(options, DT_STRING, 1 << 20));
+  EXPECT_FALSE(grpc::ShouldCompressTensor(options, DT_FLOAT, 1 << 20));
+
+  options.set_min_string_tensor_bytes(1000);
+  EXPECT_FALSE(grpc::ShouldCompressTensor(options, DT_STRING, 999));
+  EXPECT_TRUE(grpc::ShouldCompressTensor(options, DT_STRING, 1000));
+  EXPECT_FALSE(grpc::ShouldCompressTensor(options, DT_FLOAT, 1 << 20));
+
+  options.set_min_numeric_tensor_bytes(100000);
+  EXPECT_FALSE(grpc::ShouldCompressTensor(options, DT_INT32, 99999));
+  EXPECT_TRUE(grpc::ShouldCompressTensor(options, DT_INT32, 100000));
+  EXPECT_TRUE(grpc::ShouldCompressTensor(options, DT_STRING, 1000));
+}
+
 }  // namespace tensorflow
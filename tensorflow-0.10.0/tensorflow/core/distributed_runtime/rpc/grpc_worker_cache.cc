@@ -27,8 +27,9 @@ namespace tensorflow {
 
 class GrpcWorkerCache : public WorkerCachePartial {
  public:
-  explicit GrpcWorkerCache(GrpcChannelCache* channel_cache)
-      : channel_cache_(channel_cache) {
+  GrpcWorkerCache(GrpcChannelCache* channel_cache,
+                  const TensorCompressionOptions& compression)
+      : channel_cache_(channel_cache), compression_(compression) {
     // TODO(mrry): Investigate possible performance improvements by
     // replacing this thread with a threadpool.
     polling_thread_ = Env::Default()->StartThread(
@@ -58,7 +59,8 @@ class GrpcWorkerCache : public WorkerCachePartial {
     SharedGrpcChannelPtr channel = channel_cache_->FindWorkerChannel(target);
     if (!channel) return nullptr;
     WorkerInterface* ret =
-        NewGrpcRemoteWorker(channel, &completion_queue_, &logger_);
+        NewGrpcRemoteWorker(channel, &completion_queue_, &logger_,
+                            compression_);
     return ret;
   }
 
@@ -72,13 +74,19 @@ class GrpcWorkerCache : public WorkerCachePartial {
 
  private:
   GrpcChannelCache* channel_cache_;  // Owned.
+  const TensorCompressionOptions compression_;
   ::grpc::CompletionQueue completion_queue_;
   Thread* polling_thread_;  // Owned.
   WorkerCacheLogger logger_;
 };
 
 WorkerCacheInterface* NewGrpcWorkerCache(GrpcChannelCache* cc) {
-  return new GrpcWorkerCache(cc);
+  return new GrpcWorkerCache(cc, TensorCompressionOptions());
+}
+
+WorkerCacheInterface* NewGrpcWorkerCache(
+    GrpcChannelCache* cc, const TensorCompressionOptions& compression) {
+  return new GrpcWorkerCache(cc, compression);
 }
 
 }  // namespace tensorflow
@@ -18,11 +18,17 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/grpc_channel.h"
 #include "tensorflow/core/distributed_runtime/worker_cache.h"
+#include "tensorflow/core/protobuf/config.pb.h"
 
 namespace tensorflow {
 
 // The returned WorkerCacheInterface object takes the ownership of "cc".
 WorkerCacheInterface* NewGrpcWorkerCache(GrpcChannelCache* cc);
 
+// As above, with the workers asking for their tensors to be compressed as
+// "compression" says.
+WorkerCacheInterface* NewGrpcWorkerCache(
+    GrpcChannelCache* cc, const TensorCompressionOptions& compression);
+
 }  // namespace tensorflow
 #endif  // THIRD_PARTY_TENSORFLOW_CORE_DISTRIBUTED_RUNTIME_RPC_GRPC_WORKER_CACHE_H_
@@ -16,6 +16,7 @@ limitations under the License.
 #include "tensorflow/core/distributed_runtime/rpc/grpc_worker_service.h"
 
 #include <deque>
+#include <vector>
 
 #include "grpc++/alarm.h"
 #include "grpc++/server_builder.h"
@@ -130,6 +131,9 @@ class GrpcWorkerService : public AsyncServiceInterface {
     for (int i = 0; i < 100; ++i) {
       ENQUEUE_REQUEST(RunGraph, true);
     }
+    for (int i = 0; i < 100; ++i) {
+      EnqueueRecvTensorBatchRequest();
+    }
 
     ENQUEUE_REQUEST(CleanupGraph, false);
     ENQUEUE_REQUEST(Logging, false);
@@ -176,6 +180,12 @@ class GrpcWorkerService : public AsyncServiceInterface {
   using WorkerCall = Call<GrpcWorkerService, grpc::WorkerService::AsyncService,
                           RequestMessage, ResponseMessage>;
 
+  template <class RequestMessage, class ResponseMessage>
+  using WorkerStreamingCall =
+      ServerStreamingCall<GrpcWorkerService,
+                          grpc::WorkerService::AsyncService, RequestMessage,
+                          ResponseMessage>;
+
   void GetStatusHandler(WorkerCall<GetStatusRequest, GetStatusResponse>* call) {
     env_->compute_pool->Schedule([this, call]() {
       DeviceMgr* dm = env_->device_mgr;
@@ -232,6 +242,12 @@ class GrpcWorkerService : public AsyncServiceInterface {
     EnqueueRecvTensorRequestRaw();
   }
 
+  void RecvTensorBatchHandler(
+      WorkerStreamingCall<RecvTensorBatchRequest, ::grpc::ByteBuffer>* call) {
+    env_->compute_pool->Schedule([this, call]() { DoRecvTensorBatch(call); });
+    EnqueueRecvTensorBatchRequest();
+  }
+
   void CleanupGraphHandler(
       WorkerCall<CleanupGraphRequest, CleanupGraphResponse>* call) {
     env_->compute_pool->Schedule([this, call]() {
@@ -273,6 +289,18 @@ class GrpcWorkerService : public AsyncServiceInterface {
     }
   }
 
+  void EnqueueRecvTensorBatchRequest() {
+    mutex_lock l(shutdown_mu_);
+    if (!is_shutdown_) {
+      WorkerStreamingCall<RecvTensorBatchRequest, ::grpc::ByteBuffer>::
+          EnqueueRequest(
+              &worker_service_, cq_,
+              &grpc::WorkerService::AsyncService::RequestRecvTensorBatchRaw,
+              &GrpcWorkerService::RecvTensorBatchHandler,
+              true /* supports cancel*/);
+    }
+  }
+
   // The following section contains the implementation of RunGraph()
   // RecvTensor(), Logging(), and Tracing(), which are the four
   // non-trivial and potentially long-running RPCs performed by a
@@ -439,6 +467,11 @@ class GrpcWorkerService : public AsyncServiceInterface {
 
                   grpc::EncodeRecvTensorResponseToByteBuffer(*tmp,
                                                              &call->response);
+                  if (grpc::ShouldCompressTensor(
+                          call->request.compression(), tmp->tensor().dtype(),
+                          call->response.Length())) {
+                    call->SetCompressionAlgorithm(GRPC_COMPRESS_DEFLATE);
+                  }
 
                   call->SendResponse(ToGrpcStatus(s));
                   delete tmp;
@@ -456,6 +489,11 @@ class GrpcWorkerService : public AsyncServiceInterface {
                                          response_ready);
               } else {
                 grpc::EncodeTensorToByteBuffer(is_dead, val, &call->response);
+                if (grpc::ShouldCompressTensor(call->request.compression(),
+                                               val.dtype(),
+                                               call->response.Length())) {
+                  call->SetCompressionAlgorithm(GRPC_COMPRESS_DEFLATE);
+                }
                 call->SendResponse(ToGrpcStatus(Status::OK()));
               }
             }
@@ -466,6 +504,120 @@ class GrpcWorkerService : public AsyncServiceInterface {
         });
   }
 
+  // RecvTensorBatch: receives each of the requested tensors like
+  // RecvTensorRaw, and streams it back as soon as it is produced, so
+  // that a tensor which is produced late does not hold up the others.
+  void DoRecvTensorBatch(
+      WorkerStreamingCall<RecvTensorBatchRequest, ::grpc::ByteBuffer>* call) {
+    const int64 step_id = call->request.step_id();
+    const int num_keys = call->request.rendezvous_key_size();
+    TRACEPRINTF("RecvTensorBatch: %lld %d", step_id, num_keys);
+    std::vector<Rendezvous::ParsedKey> parsed(num_keys);
+    std::vector<Device*> src_devs(num_keys, nullptr);
+    for (int i = 0; i < num_keys; ++i) {
+      Status s = Rendezvous::ParseKey(call->request.rendezvous_key(i),
+                                      &parsed[i]);
+      if (s.ok()) {
+        s = PrepareRecvTensor(parsed[i], &src_devs[i]);
+      }
+      if (!s.ok()) {
+        call->Finish(ToGrpcStatus(s));
+        return;
+      }
+    }
+    if (num_keys == 0) {
+      call->Finish(::grpc::Status::OK);
+      return;
+    }
+
+    // Shared by the callbacks of all the keys; the last one to run
+    // finishes the call and deletes it.
+    struct BatchState {
+      mutex mu;
+      int remaining GUARDED_BY(mu);
+      Status status GUARDED_BY(mu);
+    };
+    BatchState* state = new BatchState;
+    state->remaining = num_keys;
+    StatusCallback key_done = [call, state](const Status& s) {
+      bool last;
+      Status status;
+      {
+        mutex_lock l(state->mu);
+        state->status.Update(s);
+        last = --state->remaining == 0;
+        status = state->status;
+      }
+      if (last) {
+        delete state;
+        call->ClearCancelCallback();
+        call->Finish(ToGrpcStatus(status));
+      }
+    };
+
+    // As in DoRecvTensorRaw(), an RPC cancellation aborts the step while
+    // any of the tensors are still pending.
+    call->SetCancelCallback([this, step_id]() { AbortStep(step_id); });
+    for (int i = 0; i < num_keys; ++i) {
+      Device* src_dev = src_devs[i];
+      env_->rendezvous_mgr->RecvLocalAsync(
+          step_id, parsed[i],
+          [call, i, src_dev, key_done](const Status& status,
+                                       const Rendezvous::Args& send_args,
+                                       const Rendezvous::Args& recv_args,
+                                       const Tensor& val, const bool is_dead) {
+            if (!status.ok()) {
+              key_done(status);
+              return;
+            }
+            const bool on_host = send_args.alloc_attrs.on_host();
+            const DeviceContext* send_dev_context = send_args.device_context;
+            if (src_dev->tensorflow_gpu_device_info() && (!on_host)) {
+              RecvTensorResponse* tmp = new RecvTensorResponse;
+              tmp->set_is_dead(is_dead);
+              CHECK(send_dev_context)
+                  << "send dev name: " << src_dev->name()
+                  << " gpu_info: " << src_dev->tensorflow_gpu_device_info();
+              StatusCallback response_ready = [call, i, tmp,
+                                               key_done](const Status& s) {
+                if (s.ok()) {
+                  tmp->set_send_start_micros(Env::Default()->NowMicros());
+                  ::grpc::ByteBuffer buffer;
+                  grpc::EncodeRecvTensorResponseToByteBuffer(*tmp, &buffer);
+                  MaybeCompressBatch(call, tmp->tensor().dtype(), buffer);
+                  grpc::WrapInRecvTensorBatchResponse(i, &buffer);
+                  call->Write(std::move(buffer));
+                }
+                delete tmp;
+                key_done(s);
+              };
+              GPUUtil::SetProtoFromGPU(val, src_dev, send_dev_context,
+                                       tmp->mutable_tensor(), is_dead,
+                                       response_ready);
+            } else {
+              ::grpc::ByteBuffer buffer;
+              grpc::EncodeTensorToByteBuffer(is_dead, val, &buffer);
+              MaybeCompressBatch(call, val.dtype(), buffer);
+              grpc::WrapInRecvTensorBatchResponse(i, &buffer);
+              call->Write(std::move(buffer));
+              key_done(Status::OK());
+            }
+          });
+    }
+  }
+
+  // Compresses the stream of "call" if the request asks for "buffer", the
+  // encoded response of a tensor of type "dtype", to be compressed.  Only
+  // has an effect before the first response of the stream is written.
+  static void MaybeCompressBatch(
+      WorkerStreamingCall<RecvTensorBatchRequest, ::grpc::ByteBuffer>* call,
+      DataType dtype, const ::grpc::ByteBuffer& buffer) {
+    if (grpc::ShouldCompressTensor(call->request.compression(), dtype,
+                                   buffer.Length())) {
+      call->MaybeSetCompressionAlgorithm(GRPC_COMPRESS_DEFLATE);
+    }
+  }
+
   Status DoLogging(WorkerCall<LoggingRequest, LoggingResponse>* call) {
     // TODO(mrry): Platform-specific tracing support.
     return errors::Unimplemented("Logging");
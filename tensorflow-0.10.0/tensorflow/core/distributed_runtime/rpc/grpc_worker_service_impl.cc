@@ -38,6 +38,7 @@ static const char* grpcWorkerService_method_names[] = {
     "/tensorflow.WorkerService/RecvTensor",
     "/tensorflow.WorkerService/Logging",
     "/tensorflow.WorkerService/Tracing",
+    "/tensorflow.WorkerService/RecvTensorBatch",
 };
 
 std::unique_ptr<WorkerService::Stub> WorkerService::NewStub(
@@ -67,7 +68,10 @@ WorkerService::Stub::Stub(
       rpcmethod_Logging_(grpcWorkerService_method_names[7],
                          ::grpc::RpcMethod::NORMAL_RPC, channel),
       rpcmethod_Tracing_(grpcWorkerService_method_names[8],
-                         ::grpc::RpcMethod::NORMAL_RPC, channel) {}
+                         ::grpc::RpcMethod::NORMAL_RPC, channel),
+      rpcmethod_RecvTensorBatch_(grpcWorkerService_method_names[9],
+                                 ::grpc::RpcMethod::SERVER_STREAMING, channel) {
+}
 
 ::grpc::ClientAsyncResponseReader<GetStatusResponse>*
 WorkerService::Stub::AsyncGetStatusRaw(::grpc::ClientContext* context,
@@ -141,6 +145,14 @@ WorkerService::Stub::AsyncTracingRaw(::grpc::ClientContext* context,
       channel_.get(), cq, rpcmethod_Tracing_, context, request);
 }
 
+::grpc::ClientAsyncReader<RecvTensorBatchResponse>*
+WorkerService::Stub::AsyncRecvTensorBatchRaw(
+    ::grpc::ClientContext* context, const RecvTensorBatchRequest& request,
+    ::grpc::CompletionQueue* cq, void* tag) {
+  return new ::grpc::ClientAsyncReader<RecvTensorBatchResponse>(
+      channel_.get(), cq, rpcmethod_RecvTensorBatch_, context, request, tag);
+}
+
 WorkerService::AsyncService::AsyncService() {
   (void)grpcWorkerService_method_names;
   for (int i = 0; i < 9; ++i) {
@@ -149,6 +161,10 @@ WorkerService::AsyncService::AsyncService() {
                                            nullptr));
     ::grpc::Service::MarkMethodAsync(i);
   }
+  AddMethod(new ::grpc::RpcServiceMethod(grpcWorkerService_method_names[9],
+                                         ::grpc::RpcMethod::SERVER_STREAMING,
+                                         nullptr));
+  ::grpc::Service::MarkMethodAsync(9);
 }
 
 WorkerService::AsyncService::~AsyncService() {}
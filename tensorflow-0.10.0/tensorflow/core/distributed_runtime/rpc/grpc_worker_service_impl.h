@@ -37,6 +37,8 @@ TF_GRPC_ALLOW_UNLIMITED_MESSAGE_SIZE(tensorflow::RunGraphRequest);
 TF_GRPC_ALLOW_UNLIMITED_MESSAGE_SIZE(tensorflow::RunGraphResponse);
 // Contains potentially large TensorProto.
 TF_GRPC_ALLOW_UNLIMITED_MESSAGE_SIZE(tensorflow::RecvTensorResponse);
+// Contains potentially large TensorProto.
+TF_GRPC_ALLOW_UNLIMITED_MESSAGE_SIZE(tensorflow::RecvTensorBatchResponse);
 
 namespace grpc {
 class CompletionQueue;
@@ -140,6 +142,15 @@ class WorkerService GRPC_FINAL {
           ::tensorflow::TracingResponse>>(
           AsyncTracingRaw(context, request, cq));
     }
+    std::unique_ptr<::grpc::ClientAsyncReaderInterface<
+        ::tensorflow::RecvTensorBatchResponse>>
+    AsyncRecvTensorBatch(::grpc::ClientContext* context,
+                         const ::tensorflow::RecvTensorBatchRequest& request,
+                         ::grpc::CompletionQueue* cq, void* tag) {
+      return std::unique_ptr<::grpc::ClientAsyncReaderInterface<
+          ::tensorflow::RecvTensorBatchResponse>>(
+          AsyncRecvTensorBatchRaw(context, request, cq, tag));
+    }
 
    private:
     virtual ::grpc::ClientAsyncResponseReaderInterface<
@@ -187,6 +198,11 @@ class WorkerService GRPC_FINAL {
     AsyncTracingRaw(::grpc::ClientContext* context,
                     const ::tensorflow::TracingRequest& request,
                     ::grpc::CompletionQueue* cq) = 0;
+    virtual ::grpc::ClientAsyncReaderInterface<
+        ::tensorflow::RecvTensorBatchResponse>*
+    AsyncRecvTensorBatchRaw(::grpc::ClientContext* context,
+                            const ::tensorflow::RecvTensorBatchRequest& request,
+                            ::grpc::CompletionQueue* cq, void* tag) = 0;
   };
   class Stub GRPC_FINAL : public StubInterface {
    public:
@@ -272,6 +288,15 @@ class WorkerService GRPC_FINAL {
           ::grpc::ClientAsyncResponseReader<::tensorflow::TracingResponse>>(
           AsyncTracingRaw(context, request, cq));
     }
+    std::unique_ptr<
+        ::grpc::ClientAsyncReader<::tensorflow::RecvTensorBatchResponse>>
+    AsyncRecvTensorBatch(::grpc::ClientContext* context,
+                         const ::tensorflow::RecvTensorBatchRequest& request,
+                         ::grpc::CompletionQueue* cq, void* tag) {
+      return std::unique_ptr<
+          ::grpc::ClientAsyncReader<::tensorflow::RecvTensorBatchResponse>>(
+          AsyncRecvTensorBatchRaw(context, request, cq, tag));
+    }
 
    private:
     std::shared_ptr<::grpc::ChannelInterface> channel_;
@@ -311,6 +336,11 @@ class WorkerService GRPC_FINAL {
     AsyncTracingRaw(::grpc::ClientContext* context,
                     const ::tensorflow::TracingRequest& request,
                     ::grpc::CompletionQueue* cq) GRPC_OVERRIDE;
+    ::grpc::ClientAsyncReader<::tensorflow::RecvTensorBatchResponse>*
+    AsyncRecvTensorBatchRaw(::grpc::ClientContext* context,
+                            const ::tensorflow::RecvTensorBatchRequest& request,
+                            ::grpc::CompletionQueue* cq,
+                            void* tag) GRPC_OVERRIDE;
     const ::grpc::RpcMethod rpcmethod_GetStatus_;
     const ::grpc::RpcMethod rpcmethod_RegisterGraph_;
     const ::grpc::RpcMethod rpcmethod_DeregisterGraph_;
@@ -320,6 +350,7 @@ class WorkerService GRPC_FINAL {
     const ::grpc::RpcMethod rpcmethod_RecvTensor_;
     const ::grpc::RpcMethod rpcmethod_Logging_;
     const ::grpc::RpcMethod rpcmethod_Tracing_;
+    const ::grpc::RpcMethod rpcmethod_RecvTensorBatch_;
   };
   static std::unique_ptr<Stub> NewStub(
       const std::shared_ptr<::grpc::ChannelInterface>& channel,
@@ -414,6 +445,15 @@ class WorkerService GRPC_FINAL {
       ::grpc::Service::RequestAsyncUnary(8, context, request, response,
                                          new_call_cq, notification_cq, tag);
     }
+    void RequestRecvTensorBatchRaw(
+        ::grpc::ServerContext* context,
+        ::tensorflow::RecvTensorBatchRequest* request,
+        ::grpc::ServerAsyncWriter<::grpc::ByteBuffer>* writer,
+        ::grpc::CompletionQueue* new_call_cq,
+        ::grpc::ServerCompletionQueue* notification_cq, void* tag) {
+      ::grpc::Service::RequestAsyncServerStreaming(
+          9, context, request, writer, new_call_cq, notification_cq, tag);
+    }
   };
 };
 
@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/distributed_runtime/rpc/rpc_rendezvous_mgr.h"
 
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/device.h"
 #include "tensorflow/core/common_runtime/device_mgr.h"
@@ -49,7 +51,32 @@ class RpcRemoteRendezvous : public BaseRemoteRendezvous {
  private:
   ~RpcRemoteRendezvous() override {}
 
+  // A validated RecvFromRemoteAsync() that waits to be sent.
+  struct PendingRecv {
+    string key;
+    Device* dst_device;
+    Rendezvous::Args recv_args;
+    DoneCallback done;
+  };
+
+  // Sends all the recvs pending for "src_worker", as a single RecvTensor
+  // call if there is only one of them, and as one RecvTensorBatch call
+  // otherwise.
+  void FlushPendingRecvs(const string& src_worker);
+
+  // Sends "recv" to "rwi" in a RecvTensor call.
+  void StartRecvTensorCall(const string& src_worker, WorkerInterface* rwi,
+                           PendingRecv recv);
+
   WorkerCacheInterface* cache_;  // Not owned.
+
+  // Recvs that are waiting to be sent, by source worker. The recvs issued
+  // before the flush for a source worker runs on the compute pool are sent
+  // together.
+  mutex pending_mu_;
+  std::unordered_map<string, std::vector<PendingRecv>> pending_
+      GUARDED_BY(pending_mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRemoteRendezvous);
 };
 
@@ -140,7 +167,6 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
   }
 
   string src_worker_;
-  string src_rel_device_;
   WorkerInterface* wi_;
   Allocator* allocator_;
   Device* dst_device_;
@@ -156,6 +182,108 @@ class RpcRecvTensorCall : public BaseRecvTensorCall {
   TF_DISALLOW_COPY_AND_ASSIGN(RpcRecvTensorCall);
 };
 
+// Used to retrieve several tensors from the same remote process in a
+// single call. Each tensor is handed to its recv as soon as it arrives.
+class RpcRecvTensorBatchCall : public BaseRecvTensorCall {
+ public:
+  // Each entry of "dst_devices", "recv_args" and "dones" belongs to the
+  // key with the same index.
+  RpcRecvTensorBatchCall(WorkerInterface* wi, const string& src_worker,
+                         int64 step_id, const std::vector<string>& keys,
+                         std::vector<Device*> dst_devices,
+                         std::vector<Rendezvous::Args> recv_args,
+                         std::vector<Rendezvous::DoneCallback> dones)
+      : wi_(wi),
+        src_worker_(src_worker),
+        dst_devices_(std::move(dst_devices)),
+        recv_args_(std::move(recv_args)),
+        dones_(std::move(dones)),
+        received_(keys.size(), false) {
+    req_.set_step_id(step_id);
+    for (const string& key : keys) {
+      req_.add_rendezvous_key(key);
+    }
+  }
+
+  // Calls "recv_done" once the call is complete, after the recvs of all
+  // the tensors that arrived are done. Call FinishRecvs() then to fail the
+  // rest.
+  void Start(std::function<void()> recv_done) override {
+    wi_->RecvTensorBatchAsync(
+        &opts_, &req_,
+        [this](int index, RecvTensorResponse* response) {
+          RecvOne(index, response);
+        },
+        [this, recv_done](const Status& s) {
+          if (!s.ok()) {
+            mutex_lock l(mu_);
+            status_.Update(s);
+          }
+          recv_done();
+        });
+  }
+
+  void StartAbort(const Status& s) override {
+    {
+      mutex_lock l(mu_);
+      status_.Update(s);
+    }
+    opts_.StartCancel();
+  }
+
+  Status status() const override {
+    mutex_lock l(mu_);
+    return status_;
+  }
+
+  // Fails the recvs of the tensors that did not arrive.
+  void FinishRecvs() {
+    Status s = status();
+    for (int i = 0; i < dones_.size(); ++i) {
+      if (received_[i]) continue;
+      if (s.ok()) {
+        s = errors::Internal("RecvTensorBatch from ", src_worker_,
+                             " finished without sending all the tensors");
+      }
+      dones_[i](s, Rendezvous::Args(), recv_args_[i], Tensor{}, false);
+    }
+  }
+
+  const string& src_worker() const { return src_worker_; }
+  WorkerInterface* worker() const { return wi_; }
+
+ private:
+  // Called for each tensor as it arrives. The stream delivers the tensors
+  // one at a time, so this needs no locking.
+  void RecvOne(int index, RecvTensorResponse* response) {
+    if (index < 0 || index >= dones_.size() || received_[index]) {
+      StartAbort(errors::Internal("RecvTensorBatch from ", src_worker_,
+                                  " sent an unexpected tensor ", index));
+      return;
+    }
+    received_[index] = true;
+    Tensor val;
+    Status s = dst_devices_[index]->MakeTensorFromProto(
+        response->tensor(), recv_args_[index].alloc_attrs, &val);
+    dones_[index](s, Rendezvous::Args(), recv_args_[index], val,
+                  response->is_dead());
+  }
+
+  WorkerInterface* const wi_;  // Not owned.
+  const string src_worker_;
+  const std::vector<Device*> dst_devices_;
+  const std::vector<Rendezvous::Args> recv_args_;
+  const std::vector<Rendezvous::DoneCallback> dones_;
+  std::vector<bool> received_;
+  CallOptions opts_;
+  RecvTensorBatchRequest req_;
+
+  mutable mutex mu_;
+  Status status_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RpcRecvTensorBatchCall);
+};
+
 class RpcRecvTensorFreeList {
  public:
   RpcRecvTensorFreeList() {}
@@ -278,33 +406,111 @@ void RpcRemoteRendezvous::RecvFromRemoteAsync(
     return;
   }
 
-  // Prepare a RecvTensor call that can handle being aborted.
-  RpcRecvTensorCall* call = call_freelist_.New();
-
   // key.src_device identifies a remote device.
-  if (!DeviceNameUtils::SplitDeviceName(parsed.src_device, &call->src_worker_,
-                                        &call->src_rel_device_)) {
+  string src_worker;
+  string src_rel_device;
+  if (!DeviceNameUtils::SplitDeviceName(parsed.src_device, &src_worker,
+                                        &src_rel_device)) {
     s = errors::Internal(parsed.src_device,
                          " is invalid remote source device.");
   }
-  WorkerInterface* rwi = cache_->CreateWorker(call->src_worker_);
+  WorkerInterface* rwi = cache_->CreateWorker(src_worker);
   if (s.ok() && rwi == nullptr) {
-    s = errors::Internal("No worker known as ", call->src_worker_);
+    s = errors::Internal("No worker known as ", src_worker);
   }
+  cache_->ReleaseWorker(src_worker, rwi);
 
   Device* dst_device;
   if (s.ok()) {
     s = env_->device_mgr->LookupDevice(parsed.dst_device, &dst_device);
   }
   if (!s.ok()) {
-    call_freelist_.Release(call);
     done(s, Args(), recv_args, Tensor{}, false);
     return;
   }
-  Allocator* allocator = dst_device->GetAllocator(recv_args.alloc_attrs);
 
-  call->Init(rwi, step_id_, parsed.FullKey(), allocator, dst_device, recv_args,
-             std::move(done));
+  // Queue the recv, and have the compute pool flush the queue of its source
+  // worker, so that the recvs that a step issues together go out together.
+  bool first;
+  {
+    mutex_lock l(pending_mu_);
+    std::vector<PendingRecv>* pending = &pending_[src_worker];
+    first = pending->empty();
+    pending->push_back(
+        {parsed.FullKey().ToString(), dst_device, recv_args, std::move(done)});
+  }
+  if (!first) return;
+  if (env_->compute_pool == nullptr) {
+    FlushPendingRecvs(src_worker);
+    return;
+  }
+  Ref();
+  env_->compute_pool->Schedule([this, src_worker]() {
+    FlushPendingRecvs(src_worker);
+    Unref();
+  });
+}
+
+void RpcRemoteRendezvous::FlushPendingRecvs(const string& src_worker) {
+  std::vector<PendingRecv> recvs;
+  {
+    mutex_lock l(pending_mu_);
+    auto it = pending_.find(src_worker);
+    recvs.swap(it->second);
+    pending_.erase(it);
+  }
+  WorkerInterface* rwi = cache_->CreateWorker(src_worker);
+  if (rwi == nullptr) {
+    Status s = errors::Internal("No worker known as ", src_worker);
+    for (PendingRecv& recv : recvs) {
+      recv.done(s, Args(), recv.recv_args, Tensor{}, false);
+    }
+    return;
+  }
+  if (recvs.size() == 1) {
+    StartRecvTensorCall(src_worker, rwi, std::move(recvs[0]));
+    return;
+  }
+
+  std::vector<string> keys;
+  std::vector<Device*> dst_devices;
+  std::vector<Args> recv_args;
+  std::vector<DoneCallback> dones;
+  for (PendingRecv& recv : recvs) {
+    keys.push_back(std::move(recv.key));
+    dst_devices.push_back(recv.dst_device);
+    recv_args.push_back(recv.recv_args);
+    dones.push_back(std::move(recv.done));
+  }
+  RpcRecvTensorBatchCall* call = new RpcRecvTensorBatchCall(
+      rwi, src_worker, step_id_, keys, std::move(dst_devices),
+      std::move(recv_args), std::move(dones));
+
+  // Record "call" in active_ so that it can be aborted cleanly.
+  RegisterCall(call);
+
+  // Start "call".
+  Ref();
+  call->Start([this, call]() {
+    // Removes "call" from active_. Prevent StartAbort().
+    DeregisterCall(call);
+    call->FinishRecvs();
+    cache_->ReleaseWorker(call->src_worker(), call->worker());
+    delete call;
+    Unref();
+  });
+}
+
+void RpcRemoteRendezvous::StartRecvTensorCall(const string& src_worker,
+                                              WorkerInterface* rwi,
+                                              PendingRecv recv) {
+  // Prepare a RecvTensor call that can handle being aborted.
+  RpcRecvTensorCall* call = call_freelist_.New();
+  call->src_worker_ = src_worker;
+  Allocator* allocator =
+      recv.dst_device->GetAllocator(recv.recv_args.alloc_attrs);
+  call->Init(rwi, step_id_, recv.key, allocator, recv.dst_device,
+             recv.recv_args, std::move(recv.done));
 
   // Record "call" in active_ so that it can be aborted cleanly.
   RegisterCall(call);
@@ -34,6 +34,12 @@ class TensorShape;
 typedef std::function<void*(size_t, const DataType&, const TensorShape&)>
     TensorBufAllocator;
 
+// Callback for each tensor received by RecvTensorBatchAsync(), with the
+// position of its key in the request.  The callee may take the contents of
+// "response".
+typedef std::function<void(int index, RecvTensorResponse* response)>
+    RecvTensorBatchCallback;
+
 // Interface for talking with the TensorFlow Worker service.
 class WorkerInterface {
  public:
@@ -69,6 +75,15 @@ class WorkerInterface {
                                TensorBufAllocator allocator,
                                StatusCallback done) = 0;
 
+  // Receives all the tensors in "request" with a single call.  "recv_one" is
+  // called for each tensor as soon as it arrives, in any order, and "done"
+  // after all calls to "recv_one".  If "done" gets an error, "recv_one" may
+  // not have been called for some of the tensors.
+  virtual void RecvTensorBatchAsync(CallOptions* opts,
+                                    const RecvTensorBatchRequest* request,
+                                    RecvTensorBatchCallback recv_one,
+                                    StatusCallback done) = 0;
+
   virtual void LoggingAsync(const LoggingRequest* request,
                             LoggingResponse* response, StatusCallback done) = 0;
 
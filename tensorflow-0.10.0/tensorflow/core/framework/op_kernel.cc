@@ -230,8 +230,10 @@ Allocator* OpKernelContext::get_allocator(AllocatorAttributes attr) {
         return wrapped.second;
       }
     }
+    // Sizes are always tracked, so that the peak and live bytes of the node
+    // are known even when the allocator itself does not track them.
     TrackingAllocator* wrapped_allocator =
-        new TrackingAllocator(allocator, attr.track_sizes());
+        new TrackingAllocator(allocator, true /* track_sizes */);
     wrapped_allocators_.push_back(std::make_pair(allocator, wrapped_allocator));
     return wrapped_allocator;
   } else {
@@ -167,6 +167,25 @@ std::pair<size_t, size_t> TrackingAllocator::GetSizesAndUnRef() {
   return std::make_pair(total_bytes, high_watermark);
 }
 
+std::pair<size_t, size_t> TrackingAllocator::GetSizes() {
+  mutex_lock lock(mu_);
+  return std::make_pair(total_bytes_, high_watermark_);
+}
+
+size_t TrackingAllocator::GetLiveBytesAndUnRef() {
+  size_t allocated;
+  bool should_delete;
+  {
+    mutex_lock lock(mu_);
+    allocated = allocated_;
+    should_delete = UnRef();
+  }
+  if (should_delete) {
+    delete this;
+  }
+  return allocated;
+}
+
 bool TrackingAllocator::UnRef() {
   CHECK_GE(ref_, 1);
   --ref_;
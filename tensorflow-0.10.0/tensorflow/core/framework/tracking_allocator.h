@@ -73,6 +73,17 @@ class TrackingAllocator : public Allocator {
   // have been deallocated the wrapper will delete itself.
   std::pair<size_t, size_t> GetSizesAndUnRef();
 
+  // Returns the same sizes as GetSizesAndUnRef(), but keeps the reference.
+  // The caller then owns the reference, and must release it with
+  // GetLiveBytesAndUnRef().
+  std::pair<size_t, size_t> GetSizes();
+
+  // Returns the number of bytes allocated through this wrapper that have not
+  // been deallocated yet, or 0 if sizes are not tracked, and releases the
+  // reference of a caller of GetSizes(). The same calls are allowed after it
+  // as after GetSizesAndUnRef().
+  size_t GetLiveBytesAndUnRef();
+
  private:
   ~TrackingAllocator() override {}
   bool UnRef() EXCLUSIVE_LOCKS_REQUIRED(mu_);
@@ -121,6 +121,27 @@ TEST(TrackingAllocatorTest, SimpleTracking) {
   ta->DeallocateRaw(p2);
 }
 
+TEST(TrackingAllocatorTest, LiveBytes) {
+  TestableSizeTrackingAllocator a = TestableSizeTrackingAllocator();
+
+  TrackingAllocator* ta = new TrackingAllocator(&a, false);
+
+  void* p1 = ta->AllocateRaw(4, 12);
+  void* p2 = ta->AllocateRaw(4, 4);
+  ta->DeallocateRaw(p1);
+
+  // GetSizes() keeps the reference, so deallocating all the memory does not
+  // delete the wrapper.
+  std::pair<size_t, size_t> sizes = ta->GetSizes();
+  EXPECT_EQ(16, sizes.first);
+  EXPECT_EQ(16, sizes.second);
+  void* p3 = ta->AllocateRaw(4, 8);
+  ta->DeallocateRaw(p2);
+  EXPECT_EQ(8, ta->GetLiveBytesAndUnRef());
+
+  ta->DeallocateRaw(p3);
+}
+
 TEST(TrackingAllocatorTest, OutOfMemory) {
   NoMemoryAllocator a;
 
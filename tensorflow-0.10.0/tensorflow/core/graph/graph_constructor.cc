@@ -138,6 +138,7 @@ bool IsValidNodeName(StringPiece s, bool allow_internal_ops) {
 
 void GraphConstructor::BuildNodeIndex() {
   // Validate the node names and add them to name_index_.
+  name_index_.reserve(gdef_->node_size());
   for (int n = 0; n < gdef_->node_size(); ++n) {
     const NodeDef& node_def(gdef_->node(n));
     if (!IsValidNodeName(node_def.name(), opts_.allow_internal_ops)) {
@@ -423,20 +424,20 @@ void CopyGraph(const Graph& src, Graph* dest) {
   dest->set_versions(src.versions());
 
   // Copy the nodes
-  std::unordered_map<Node*, Node*>
-      node_map;  // "Node in src" -> "Node in *dest"
-  node_map[src.source_node()] = dest->source_node();
-  node_map[src.sink_node()] = dest->sink_node();
+  std::vector<Node*> node_map(
+      src.num_node_ids());  // "Node id in src" -> "Node in *dest"
+  node_map[src.source_node()->id()] = dest->source_node();
+  node_map[src.sink_node()->id()] = dest->sink_node();
   for (Node* n : src.nodes()) {
     if (n->IsSource() || n->IsSink()) continue;
     CHECK(n->IsOp());
-    node_map[n] = dest->CopyNode(n);
+    node_map[n->id()] = dest->CopyNode(n);
   }
 
   // Copy the edges
   for (const Edge* e : src.edges()) {
-    Node* src_copy = node_map[e->src()];
-    Node* dst_copy = node_map[e->dst()];
+    Node* src_copy = node_map[e->src()->id()];
+    Node* dst_copy = node_map[e->dst()->id()];
     dest->AddEdge(src_copy, e->src_output(), dst_copy, e->dst_input());
   }
 }
@@ -0,0 +1,128 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/data_flow_ops.cc.
+
+#include "tensorflow/core/kernels/batching_fifo_queue.h"
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Runs closures at their deadlines from a single thread shared by all
+// batching queues, so that a DequeueUpTo does not cost a sleeping thread.
+class DeadlineTimer {
+ public:
+  static DeadlineTimer* Global() {
+    static DeadlineTimer* timer = new DeadlineTimer;
+    return timer;
+  }
+
+  void Schedule(uint64 deadline_micros, std::function<void()> closure) {
+    mutex_lock l(mu_);
+    const bool earliest =
+        closures_.empty() || deadline_micros < closures_.begin()->first;
+    closures_.emplace(deadline_micros, std::move(closure));
+    if (earliest) cv_.notify_one();
+  }
+
+ private:
+  DeadlineTimer() {
+    thread_.reset(Env::Default()->StartThread(ThreadOptions(),
+                                              "batching_queue_timer",
+                                              [this]() { Run(); }));
+  }
+
+  void Run() {
+    for (;;) {
+      std::vector<std::function<void()>> due;
+      {
+        mutex_lock l(mu_);
+        while (due.empty()) {
+          if (closures_.empty()) {
+            cv_.wait(l);
+            continue;
+          }
+          const uint64 now = Env::Default()->NowMicros();
+          const uint64 next = closures_.begin()->first;
+          if (next > now) {
+            cv_.wait_for(l, std::chrono::microseconds(next - now));
+            continue;
+          }
+          while (!closures_.empty() && closures_.begin()->first <= now) {
+            due.push_back(std::move(closures_.begin()->second));
+            closures_.erase(closures_.begin());
+          }
+        }
+      }
+      for (const auto& closure : due) closure();
+    }
+  }
+
+  mutex mu_;
+  condition_variable cv_;
+  std::multimap<uint64, std::function<void()>> closures_ GUARDED_BY(mu_);
+  std::unique_ptr<Thread> thread_;
+};
+
+}  // namespace
+
+BatchingFIFOQueue::BatchingFIFOQueue(
+    int32 capacity, const DataTypeVector& component_dtypes,
+    const std::vector<TensorShape>& component_shapes,
+    int64 batch_timeout_micros, const string& name)
+    : FIFOQueue(capacity, component_dtypes, component_shapes, name) {
+  batch_timeout_micros_ = batch_timeout_micros;
+}
+
+void BatchingFIFOQueue::ScheduleFlush(uint64 deadline_micros) {
+  // The reference keeps the queue alive until the timer has run.
+  Ref();
+  DeadlineTimer::Global()->Schedule(deadline_micros, [this]() {
+    FlushUnlocked();
+    Unref();
+  });
+}
+
+Status BatchingFIFOQueue::MatchesNodeDef(const NodeDef& node_def) {
+  TF_RETURN_IF_ERROR(MatchesNodeDefOp(node_def, "BatchingFIFOQueue"));
+  TF_RETURN_IF_ERROR(MatchesNodeDefCapacity(node_def, capacity_));
+  TF_RETURN_IF_ERROR(MatchesNodeDefTypes(node_def));
+  TF_RETURN_IF_ERROR(MatchesNodeDefShapes(node_def));
+  int64 batch_timeout_micros = -1;
+  TF_RETURN_IF_ERROR(
+      GetNodeAttr(node_def, "batch_timeout_micros", &batch_timeout_micros));
+  if (batch_timeout_micros != batch_timeout_micros_) {
+    return errors::InvalidArgument(
+        "Shared queue '", name_, "' has batch_timeout_micros ",
+        batch_timeout_micros_, " but requested batch_timeout_micros was ",
+        batch_timeout_micros);
+  }
+  return Status::OK();
+}
+
+}  // namespace tensorflow
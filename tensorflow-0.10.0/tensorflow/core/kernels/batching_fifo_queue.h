@@ -0,0 +1,54 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_BATCHING_FIFO_QUEUE_H_
+#define TENSORFLOW_KERNELS_BATCHING_FIFO_QUEUE_H_
+
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/fifo_queue.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A FIFOQueue whose DequeueUpTo(n) returns up to n elements, or the
+// elements available once batch_timeout_micros have passed, whichever
+// comes first.  A batch that times out on an empty queue is returned as
+// soon as its first element arrives.  DequeueMany still waits for a full
+// batch.
+class BatchingFIFOQueue : public FIFOQueue {
+ public:
+  BatchingFIFOQueue(int32 capacity, const DataTypeVector& component_dtypes,
+                    const std::vector<TensorShape>& component_shapes,
+                    int64 batch_timeout_micros, const string& name);
+
+  Status MatchesNodeDef(const NodeDef& node_def) override;
+
+ protected:
+  ~BatchingFIFOQueue() override {}
+
+  void ScheduleFlush(uint64 deadline_micros) override;
+
+ private:
+  TF_DISALLOW_COPY_AND_ASSIGN(BatchingFIFOQueue);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_BATCHING_FIFO_QUEUE_H_
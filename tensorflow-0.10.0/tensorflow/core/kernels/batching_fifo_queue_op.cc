@@ -0,0 +1,63 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/data_flow_ops.cc.
+
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/batching_fifo_queue.h"
+#include "tensorflow/core/kernels/queue_op.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Defines a BatchingFIFOQueueOp, which produces a Queue (specifically, one
+// backed by BatchingFIFOQueue) that persists across different graph
+// executions, and sessions. Running this op produces a single-element
+// tensor of handles to Queues in the corresponding device.
+class BatchingFIFOQueueOp : public QueueOp {
+ public:
+  explicit BatchingFIFOQueueOp(OpKernelConstruction* context)
+      : QueueOp(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("shapes", &component_shapes_));
+    OP_REQUIRES_OK(context, context->GetAttr("batch_timeout_micros",
+                                             &batch_timeout_micros_));
+  }
+
+ protected:
+  CreatorCallback GetCreator() const override {
+    return [this](QueueInterface** ret) {
+      BatchingFIFOQueue* queue = new BatchingFIFOQueue(
+          capacity_, component_types_, component_shapes_,
+          batch_timeout_micros_, cinfo_.name());
+      *ret = queue;
+      return queue->Initialize();
+    };
+  }
+
+ private:
+  std::vector<TensorShape> component_shapes_;
+  int64 batch_timeout_micros_;
+  TF_DISALLOW_COPY_AND_ASSIGN(BatchingFIFOQueueOp);
+};
+
+REGISTER_KERNEL_BUILDER(Name("BatchingFIFOQueue").Device(DEVICE_CPU),
+                        BatchingFIFOQueueOp);
+
+}  // namespace tensorflow
@@ -17,6 +17,7 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <limits>
 
 #include "tensorflow/core/util/ctc/ctc_beam_search.h"
@@ -27,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -280,40 +282,60 @@ class CTCBeamSearchDecoderOp : public OpKernel {
 
     log_prob_t.setZero();
 
-    std::vector<TTypes<float>::UnalignedConstMatrix> input_list_t;
-
-    for (std::size_t t = 0; t < max_time; ++t) {
-      input_list_t.emplace_back(inputs_t.data() + t * batch_size * num_classes,
-                                batch_size, num_classes);
-    }
-
-    ctc::CTCBeamSearchDecoder<> beam_search(num_classes, beam_width_,
-                                            &beam_scorer_, 1 /* batch_size */,
-                                            merge_repeated_);
-    Tensor input_chip(DT_FLOAT, TensorShape({num_classes}));
-    auto input_chip_t = input_chip.flat<float>();
-
     std::vector<std::vector<std::vector<int> > > best_paths(batch_size);
-    std::vector<float> log_probs;
-
-    // Assumption: the blank index is num_classes - 1
-    for (int b = 0; b < batch_size; ++b) {
-      auto& best_paths_b = best_paths[b];
-      best_paths_b.resize(decode_helper_.GetTopPaths());
-      for (int t = 0; t < seq_len_t(b); ++t) {
-        input_chip_t = input_list_t[t].chip(b, 0);
-        auto input_bi =
-            Eigen::Map<const Eigen::ArrayXf>(input_chip_t.data(), num_classes);
-        beam_search.Step(input_bi);
-      }
-      beam_search.TopPaths(decode_helper_.GetTopPaths(), &best_paths_b,
-                           &log_probs, merge_repeated_);
-      beam_search.Reset();
+    const int top_paths = decode_helper_.GetTopPaths();
+
+    // The batch elements are decoded independently, so each shard of the
+    // batch runs its own decoder.  The default scorer is stateless and can
+    // be shared.
+    auto decode = [this, &inputs_t, &seq_len_t, &log_prob_t, &best_paths,
+                   batch_size, num_classes, top_paths](int64 start,
+                                                       int64 limit) {
+      ctc::CTCBeamSearchDecoder<> beam_search(num_classes, beam_width_,
+                                              &beam_scorer_,
+                                              1 /* batch_size */,
+                                              merge_repeated_);
+      std::vector<float> log_probs;
+
+      // Assumption: the blank index is num_classes - 1
+      for (int64 b = start; b < limit; ++b) {
+        auto& best_paths_b = best_paths[b];
+        best_paths_b.resize(top_paths);
+        for (int t = 0; t < seq_len_t(b); ++t) {
+          // The scores of (t, b) are contiguous in the [max_time, batch_size,
+          // num_classes] inputs, so they are passed without a copy.
+          auto input_bi = Eigen::Map<const Eigen::ArrayXf>(
+              inputs_t.data() + (t * batch_size + b) * num_classes,
+              num_classes);
+          beam_search.Step(input_bi);
+        }
+        beam_search.TopPaths(top_paths, &best_paths_b, &log_probs,
+                             merge_repeated_);
+        beam_search.Reset();
 
-      for (int bp = 0; bp < decode_helper_.GetTopPaths(); ++bp) {
-        log_prob_t(b, bp) = log_probs[bp];
+        for (int bp = 0; bp < top_paths; ++bp) {
+          log_prob_t(b, bp) = log_probs[bp];
+        }
       }
+    };
+
+    // *Rough* estimate of the cost of decoding one batch element: at each
+    // step, each of the beam_width leaves is extended by up to num_classes
+    // labels, at the cost of a LogSumExp and a push into the beam.
+    int64 max_seq_len = 0;
+    for (int64 b = 0; b < batch_size; ++b) {
+      max_seq_len = std::max<int64>(max_seq_len, seq_len_t(b));
     }
+    const int64 cost_exp = Eigen::internal::functor_traits<
+        Eigen::internal::scalar_exp_op<float>>::Cost;
+    const int64 cost_log = Eigen::internal::functor_traits<
+        Eigen::internal::scalar_log_op<float>>::Cost;
+    const int64 cost =
+        max_seq_len * beam_width_ * num_classes *
+        (cost_exp + cost_log + 4 * Eigen::TensorOpCost::AddCost<float>());
+    const DeviceBase::CpuWorkerThreads& workers =
+        *ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(workers.num_threads, workers.workers, batch_size, cost, decode);
 
     OP_REQUIRES_OK(ctx, decode_helper_.StoreAllDecodedSequences(
                             best_paths, &decoded_indices, &decoded_values,
@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/util/example_proto_fast_parsing.h"
 #include "tensorflow/core/util/example_proto_helper.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
 #include "tensorflow/core/util/work_sharder.h"
@@ -209,13 +210,22 @@ class ExampleParserOp : public OpKernel {
     }
 
     mutex mu;
+    const FastExampleParser fast_parser(fixed_len_features, var_len_features);
 
     auto DoWork = [&ctx, &mu, &serialized_t, has_names, &names_t,
-                   &fixed_len_features, &var_len_features, &output_dense_values,
+                   &fixed_len_features, &var_len_features, &fast_parser,
+                   &output_dense_values,
                    &sparse_values_tmp](int64 start, int64 limit) {
       // Processing each Example in the batch starts here.
       for (std::size_t b = static_cast<size_t>(start);
            b < static_cast<size_t>(limit); ++b) {
+        // Most Examples decode without materializing the proto; the rest,
+        // including all invalid ones, are parsed in full below.
+        if (TF_PREDICT_TRUE(fast_parser.Parse(serialized_t(b), b,
+                                              &output_dense_values,
+                                              &sparse_values_tmp))) {
+          continue;
+        }
         // Benchmarks indicate that a tight Arena+Example is most performant.
         protobuf::Arena arena;
         // ex is owned by the arena.
@@ -34,7 +34,8 @@ namespace tensorflow {
 FIFOQueue::FIFOQueue(int capacity, const DataTypeVector& component_dtypes,
                      const std::vector<TensorShape>& component_shapes,
                      const string& name)
-    : TypedQueue(capacity, component_dtypes, component_shapes, name) {}
+    : TypedQueue(capacity, component_dtypes, component_shapes, name),
+      batch_timeout_micros_(-1) {}
 
 void FIFOQueue::DequeueLocked(OpKernelContext* ctx, Tuple* tuple) {
   DCHECK_GT(queues_[0].size(), size_t{0});
@@ -236,6 +237,10 @@ void FIFOQueue::TryDequeueMany(int num_elements, OpKernelContext* ctx,
     return;
   }
 
+  const bool has_deadline = allow_small_batch && batch_timeout_micros_ >= 0;
+  const uint64 deadline_micros =
+      has_deadline ? ctx->env()->NowMicros() + batch_timeout_micros_ : 0;
+
   CancellationManager* cm = ctx->cancellation_manager();
   CancellationToken token = cm->get_cancellation_token();
   bool already_cancelled;
@@ -247,11 +252,15 @@ void FIFOQueue::TryDequeueMany(int num_elements, OpKernelContext* ctx,
       // TODO(josh11b): This makes two copies of callback, avoid this if possible.
       dequeue_attempts_.emplace_back(
           num_elements, [callback]() { callback(Tuple()); }, ctx, cm, token,
-          [callback, allow_small_batch, this](Attempt* attempt)
-              EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+          [callback, allow_small_batch, has_deadline, deadline_micros,
+           this](Attempt* attempt) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
                 int64 queue_size = queues_[0].size();
+                const bool timed_out =
+                    has_deadline &&
+                    attempt->context->env()->NowMicros() >= deadline_micros;
 
-                if (closed_ && queue_size < attempt->elements_requested) {
+                if ((closed_ || timed_out) &&
+                    queue_size < attempt->elements_requested) {
                   // If we don't have enough for a full dequeue, we have
                   // to reset the attempt tuple.
                   if (!attempt->tuple.empty()) {
@@ -281,6 +290,8 @@ void FIFOQueue::TryDequeueMany(int num_elements, OpKernelContext* ctx,
                     attempt->tuple.clear();
                     attempt->elements_requested = queue_size;
                   } else {
+                    // A timed out batch waits for its first element.
+                    if (!closed_) return kNoProgress;
                     if (allow_small_batch) {
                       // There may be some other attempts containing
                       // values.  If so, we'll yield and wait for them
@@ -339,6 +350,7 @@ void FIFOQueue::TryDequeueMany(int num_elements, OpKernelContext* ctx,
     }
   }
   if (!already_cancelled) {
+    if (has_deadline) ScheduleFlush(deadline_micros);
     FlushUnlocked();
   } else {
     ctx->SetStatus(errors::Cancelled("Dequeue operation was cancelled"));
@@ -65,6 +65,16 @@ class FIFOQueue : public TypedQueue<std::deque<PersistentTensor> > {
                                              OpKernelContext* ctx,
                                              PersistentTensor* out_element);
 
+  // Called with the deadline of each DequeueUpTo when
+  // batch_timeout_micros_ is set.  Implementations must call
+  // FlushUnlocked() once NowMicros() reaches deadline_micros.
+  virtual void ScheduleFlush(uint64 deadline_micros) {}
+
+  // If non-negative, a DequeueUpTo that has waited this long returns the
+  // elements available as soon as there is at least one, instead of
+  // waiting for all num_elements.  Set by BatchingFIFOQueue.
+  int64 batch_timeout_micros_;
+
  private:
   TF_DISALLOW_COPY_AND_ASSIGN(FIFOQueue);
 };
@@ -0,0 +1,112 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/kernels/matmul_op.h"
+
+namespace tensorflow {
+
+typedef Eigen::ThreadPoolDevice CPUDevice;
+
+// The kernel of the MatMul + BiasAdd (+ Relu) chains that
+// common_runtime/matmul_fusion.cc rewrites graphs to.  The contraction
+// writes the product straight into the output, and the bias and the relu
+// are then applied to it in place, so no intermediate tensor is allocated.
+template <typename T>
+class FusedMatMulOp : public OpKernel {
+ public:
+  explicit FusedMatMulOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("transpose_a", &transpose_a_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("transpose_b", &transpose_b_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("fused_relu", &fused_relu_));
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& a = ctx->input(0);
+    const Tensor& b = ctx->input(1);
+    const Tensor& bias = ctx->input(2);
+
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(a.shape()),
+                errors::InvalidArgument("In[0] is not a matrix"));
+    OP_REQUIRES(ctx, TensorShapeUtils::IsMatrix(b.shape()),
+                errors::InvalidArgument("In[1] is not a matrix"));
+    OP_REQUIRES(ctx, TensorShapeUtils::IsVector(bias.shape()),
+                errors::InvalidArgument("Biases must be 1D: ",
+                                        bias.shape().DebugString()));
+    Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1> dim_pair;
+    dim_pair[0].first = transpose_a_ ? 0 : 1;
+    dim_pair[0].second = transpose_b_ ? 1 : 0;
+
+    OP_REQUIRES(ctx,
+                a.dim_size(dim_pair[0].first) == b.dim_size(dim_pair[0].second),
+                errors::InvalidArgument("Matrix size-compatible: In[0]: ",
+                                        a.shape().DebugString(), ", In[1]: ",
+                                        b.shape().DebugString()));
+    const int a_dim_remaining = 1 - dim_pair[0].first;
+    const int b_dim_remaining = 1 - dim_pair[0].second;
+    const int64 rows = a.dim_size(a_dim_remaining);
+    const int64 cols = b.dim_size(b_dim_remaining);
+    OP_REQUIRES(
+        ctx, bias.dim_size(0) == cols,
+        errors::InvalidArgument(
+            "Must provide as many biases as the product has columns: ",
+            bias.shape().DebugString(), " vs. [", rows, ",", cols, "]"));
+    Tensor* out = nullptr;
+    OP_REQUIRES_OK(ctx, ctx->allocate_output(0, TensorShape({rows, cols}),
+                                             &out));
+    if (out->NumElements() == 0) return;
+
+    const CPUDevice& d = ctx->eigen_device<CPUDevice>();
+    auto out_m = out->matrix<T>();
+    if (a.NumElements() == 0 || b.NumElements() == 0) {
+      out_m.device(d) = out_m.constant(T(0));
+    } else {
+      functor::MatMul<CPUDevice>(d, out_m, a.matrix<T>(), b.matrix<T>(),
+                                 dim_pair);
+    }
+
+    Eigen::DSizes<Eigen::DenseIndex, 2> bias_shape(1, cols);
+    Eigen::DSizes<Eigen::DenseIndex, 2> bcast(rows, 1);
+    auto biased = out_m + bias.vec<T>().reshape(bias_shape).broadcast(bcast);
+    if (fused_relu_) {
+      out_m.device(d) = biased.cwiseMax(T(0));
+    } else {
+      out_m.device(d) = biased;
+    }
+  }
+
+ private:
+  bool transpose_a_;
+  bool transpose_b_;
+  bool fused_relu_;
+};
+
+#define REGISTER_CPU(T)                                                    \
+  REGISTER_KERNEL_BUILDER(                                                 \
+      Name("_FusedMatMul").Device(DEVICE_CPU).TypeConstraint<T>("T"),      \
+      FusedMatMulOp<T>);
+
+TF_CALL_float(REGISTER_CPU);
+TF_CALL_double(REGISTER_CPU);
+#undef REGISTER_CPU
+
+}  // namespace tensorflow
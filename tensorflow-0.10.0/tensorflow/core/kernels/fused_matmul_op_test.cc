@@ -0,0 +1,84 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class FusedMatMulOpTest : public OpsTestBase {
+ protected:
+  Status Init(bool transpose_b, bool fused_relu) {
+    TF_CHECK_OK(NodeDefBuilder("op", "_FusedMatMul")
+                    .Input(FakeInput(DT_FLOAT))
+                    .Input(FakeInput(DT_FLOAT))
+                    .Input(FakeInput(DT_FLOAT))
+                    .Attr("transpose_b", transpose_b)
+                    .Attr("fused_relu", fused_relu)
+                    .Finalize(node_def()));
+    return InitOp();
+  }
+};
+
+TEST_F(FusedMatMulOpTest, BiasAdd) {
+  TF_ASSERT_OK(Init(false, false));
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({2, 3}), {1, 0, -1, 0, 1, -1});
+  AddInputFromArray<float>(TensorShape({3}), {10, 20, 1});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 3}));
+  test::FillValues<float>(&expected, {11, 22, -2, 13, 24, -6});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedMatMulOpTest, BiasAddRelu) {
+  TF_ASSERT_OK(Init(true, true));
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({3, 2}), {1, 0, 0, 1, -1, -1});
+  AddInputFromArray<float>(TensorShape({3}), {10, -20, 1});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 3}));
+  test::FillValues<float>(&expected, {11, 0, 0, 13, 0, 0});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedMatMulOpTest, EmptyInnerDimension) {
+  TF_ASSERT_OK(Init(false, false));
+  AddInputFromArray<float>(TensorShape({2, 0}), {});
+  AddInputFromArray<float>(TensorShape({0, 2}), {});
+  AddInputFromArray<float>(TensorShape({2}), {1, 2});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {1, 2, 1, 2});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedMatMulOpTest, WrongBiasSize) {
+  TF_ASSERT_OK(Init(false, false));
+  AddInputFromArray<float>(TensorShape({1, 2}), {1, 2});
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  EXPECT_TRUE(errors::IsInvalidArgument(RunOpKernel()));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -22,8 +22,10 @@ limitations under the License.
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -78,7 +80,7 @@ class GatherOp : public OpKernel {
       auto out_flat = out->shaped<T, 2>({N, out->NumElements() / N});
 
       functor::Gather<Device, T, Index> functor;
-      int64 bad_i = functor(c->eigen_device<Device>(), params_flat,
+      int64 bad_i = functor(c, c->eigen_device<Device>(), params_flat,
                             indices_flat, out_flat);
 
       OP_REQUIRES(
@@ -92,10 +94,21 @@ class GatherOp : public OpKernel {
 
 namespace functor {
 
-// Helper method to copy using memcpy.
+// Number of rows ahead of the copied one whose params are prefetched. Rows
+// of large tables are usually neither cached nor next to each other, so
+// each copy waits on memory unless its row was requested well before.
+static const int kPrefetchRows = 8;
+// Bytes at the start of each prefetched row that are requested explicitly.
+// The hardware prefetcher picks up the rest of longer rows.
+static const size_t kPrefetchBytes = 256;
+static const size_t kCacheLineBytes = 64;
+
+// Helper method to copy using memcpy. The rows are copied in shards by the
+// worker threads of the device.
 template <typename T, typename Index, typename SliceIndex,
           SliceIndex static_slice_elems>
-SliceIndex HandleCopies(typename TTypes<T>::ConstMatrix params,
+SliceIndex HandleCopies(OpKernelContext* ctx,
+                        typename TTypes<T>::ConstMatrix params,
                         typename TTypes<Index>::ConstFlat indices,
                         SliceIndex slice_elems,
                         typename TTypes<T>::Matrix out) {
@@ -111,32 +124,60 @@ SliceIndex HandleCopies(typename TTypes<T>::ConstMatrix params,
   }
   // Compute slice_bytes here so that static knowledge is available
   const size_t slice_bytes = slice_elems * sizeof(T);
-  for (SliceIndex i = 0; i < first_dim_size; i++) {
-    const SliceIndex j = i + 1;
-    if (j < first_dim_size) {
-      port::prefetch<port::PREFETCH_HINT_T0>(&params(indices(j), 0));
-      port::prefetch<port::PREFETCH_HINT_T0>(&out(j, 0));
+  const size_t prefetch_bytes = std::min(slice_bytes, kPrefetchBytes);
+  auto prefetch_row = [&](SliceIndex j) {
+    const Index index = internal::SubtleMustCopy(indices(j));
+    if (!FastBoundsCheck(index, limit)) return;
+    const char* row =
+        reinterpret_cast<const char*>(params_base + index * slice_elems);
+    for (size_t offset = 0; offset < prefetch_bytes;
+         offset += kCacheLineBytes) {
+      port::prefetch<port::PREFETCH_HINT_T0>(row + offset);
     }
-    // Grab the index and check its validity.  An earlier version of the
-    // code checked it and then grabbed it from memory a second time, which
-    // was a security risk since it could have changed in between.
-    const Index index = internal::SubtleMustCopy(indices(i));
-    if (!FastBoundsCheck(index, limit)) return i;
-    // Copy using memcpy if possible, otherwise an Eigen loop
-    if (Allocator::is_simple<T>::value) {
-      memcpy(out_base + i * slice_elems, params_base + index * slice_elems,
-             slice_bytes);
-    } else {
-      out.template chip<0>(i) = params.template chip<0>(index);
+  };
+
+  mutex mu;
+  // The first out of range index found, or -1.
+  SliceIndex result = -1;
+  auto work = [&](int64 start, int64 end) {
+    const SliceIndex first = static_cast<SliceIndex>(start);
+    const SliceIndex last = static_cast<SliceIndex>(end);
+    for (SliceIndex j = first; j < last && j < first + kPrefetchRows; j++) {
+      prefetch_row(j);
     }
-  }
-  return -1;
+    for (SliceIndex i = first; i < last; i++) {
+      if (i + kPrefetchRows < last) {
+        prefetch_row(i + kPrefetchRows);
+      }
+      // Grab the index and check its validity.  An earlier version of the
+      // code checked it and then grabbed it from memory a second time, which
+      // was a security risk since it could have changed in between.
+      const Index index = internal::SubtleMustCopy(indices(i));
+      if (!FastBoundsCheck(index, limit)) {
+        mutex_lock l(mu);
+        if (result < 0 || i < result) result = i;
+        return;
+      }
+      // Copy using memcpy if possible, otherwise an Eigen loop
+      if (Allocator::is_simple<T>::value) {
+        memcpy(out_base + i * slice_elems, params_base + index * slice_elems,
+               slice_bytes);
+      } else {
+        out.template chip<0>(i) = params.template chip<0>(index);
+      }
+    }
+  };
+  auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers, first_dim_size,
+        slice_bytes, work);
+  return result;
 }
 
 // Specialization gather functor for CPU.
 template <typename T, typename Index>
 struct Gather<CPUDevice, T, Index> {
-  int64 operator()(const CPUDevice& d, typename TTypes<T>::ConstMatrix params,
+  int64 operator()(OpKernelContext* ctx, const CPUDevice& d,
+                   typename TTypes<T>::ConstMatrix params,
                    typename TTypes<Index>::ConstFlat indices,
                    typename TTypes<T>::Matrix out) {
     const int64 N = indices.size();
@@ -146,16 +187,16 @@ struct Gather<CPUDevice, T, Index> {
     bool use_large = (slice_size > std::numeric_limits<int32>::max() ||
                       params.size() > std::numeric_limits<int32>::max() ||
                       N > std::numeric_limits<int32>::max());
-#define CALL(elems)                                                   \
-  do {                                                                \
-    if (use_large) {                                                  \
-      bad_i = HandleCopies<T, Index, int64, elems>(params, indices,   \
-                                                   slice_size, out);  \
-    } else {                                                          \
-      const int32 small_slice = static_cast<int32>(slice_size);       \
-      bad_i = HandleCopies<T, Index, int32, elems>(params, indices,   \
-                                                   small_slice, out); \
-    }                                                                 \
+#define CALL(elems)                                                      \
+  do {                                                                   \
+    if (use_large) {                                                     \
+      bad_i = HandleCopies<T, Index, int64, elems>(ctx, params, indices, \
+                                                   slice_size, out);     \
+    } else {                                                             \
+      const int32 small_slice = static_cast<int32>(slice_size);          \
+      bad_i = HandleCopies<T, Index, int32, elems>(ctx, params, indices, \
+                                                   small_slice, out);    \
+    }                                                                    \
   } while (0)
 
     if (slice_size == 10)
@@ -195,7 +236,8 @@ namespace functor {
 #define DECLARE_GPU_SPECS_INDEX(T, Index)                          \
   template <>                                                      \
   Index Gather<GPUDevice, T, Index>::operator()(                   \
-      const GPUDevice& d, typename TTypes<T>::ConstMatrix Tparams, \
+      OpKernelContext* ctx, const GPUDevice& d,                    \
+      typename TTypes<T>::ConstMatrix Tparams,                     \
       typename TTypes<Index>::ConstFlat Tindices,                  \
       typename TTypes<T>::Matrix Tout);                            \
   extern template struct Gather<GPUDevice, T, Index>;
@@ -30,7 +30,8 @@ struct Gather {
   // Performs gather op on (Tparams, Tindices), writing to Tout.
   // Returns an index to Tindices if the value at that index is out of range.
   // Returns -1 if all values of Tindices are in range.
-  Index operator()(const Device& d, typename TTypes<T>::ConstMatrix Tparams,
+  Index operator()(OpKernelContext* ctx, const Device& d,
+                   typename TTypes<T>::ConstMatrix Tparams,
                    typename TTypes<Index>::ConstFlat Tindices,
                    typename TTypes<T>::Matrix Tout);
 };
@@ -133,6 +133,48 @@ TEST_F(GatherOpTest, Error_IndexOutOfRange) {
       << s;
 }
 
+TEST_F(GatherOpTest, ManyRows) {
+  MakeOp(DT_INT32);
+
+  // Enough rows for the copies to be sharded across threads.
+  const int kRows = 1000;
+  const int kDim = 64;
+  const int kNumIndices = 10000;
+  std::vector<float> params(kRows * kDim);
+  for (int i = 0; i < params.size(); ++i) params[i] = i;
+  std::vector<int32> indices(kNumIndices);
+  std::vector<float> values;
+  for (int i = 0; i < kNumIndices; ++i) {
+    indices[i] = (i * 7919) % kRows;
+    values.insert(values.end(), params.begin() + indices[i] * kDim,
+                  params.begin() + (indices[i] + 1) * kDim);
+  }
+  AddInputFromArray<float>(TensorShape({kRows, kDim}), params);
+  AddInputFromArray<int32>(TensorShape({kNumIndices}), indices);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({kNumIndices, kDim}));
+  test::FillValues<float>(&expected, values);
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(GatherOpTest, Error_FirstIndexOutOfRangeOfManyRows) {
+  MakeOp(DT_INT32);
+
+  const int kDim = 64;
+  const int kNumIndices = 10000;
+  std::vector<int32> indices(kNumIndices, 1);
+  indices[kNumIndices - 10] = -1;
+  indices[5000] = 7;
+  AddInputFromArray<float>(TensorShape({5, kDim}),
+                           std::vector<float>(5 * kDim));
+  AddInputFromArray<int32>(TensorShape({kNumIndices}), indices);
+  Status s = RunOpKernel();
+  EXPECT_TRUE(
+      StringPiece(s.ToString()).contains("indices[5000] = 7 is not in [0, 5)"))
+      << s;
+}
+
 constexpr int kLookups = 2000;
 
 template <typename Index>
@@ -15,6 +15,7 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <string.h>
 #include <algorithm>
 #include <memory>
 #include <string>
@@ -29,16 +30,17 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_util.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
-#include "tensorflow/core/lib/io/inputbuffer.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 namespace lookup {
 namespace {
 
-static const int kInputBufferSize = 1 * 1024 * 1024; /* bytes */
 static const int kLineNumber = -1;
 static const int kWholeLine = -2;
 
@@ -93,167 +95,92 @@ class KeyValueTensorIterator
   Status status_;
 };
 
-Status GetNumLinesInTextFile(Env* env, const string& vocab_file,
-                             int64* num_lines) {
-  std::unique_ptr<RandomAccessFile> file;
-  TF_RETURN_IF_ERROR(env->NewRandomAccessFile(vocab_file, &file));
-
-  io::InputBuffer input_buffer(file.get(), kInputBufferSize);
-  string line;
-  Status s = input_buffer.ReadLine(&line);
-  int64 next_id = 0;
-  while (s.ok()) {
-    next_id++;
-    s = input_buffer.ReadLine(&line);
+// Rough cost in cycles of parsing a line of a vocabulary file.
+static const int64 kParseLineCost = 1000;
+
+// Splits "contents" into its first "max_lines" lines, or into all of them if
+// "max_lines" is -1, like InputBuffer::ReadLine() does: lines end at '\n', and
+// a last line without one counts. Sets "*truncated" if lines remain.
+void SplitLines(StringPiece contents, int64 max_lines,
+                std::vector<StringPiece>* lines, bool* truncated) {
+  const char* data = contents.data();
+  size_t offset = 0;
+  while (offset < contents.size() &&
+         (max_lines < 0 || static_cast<int64>(lines->size()) < max_lines)) {
+    const void* newline = memchr(data + offset, '\n', contents.size() - offset);
+    const size_t end = newline == nullptr
+                           ? contents.size()
+                           : static_cast<const char*>(newline) - data;
+    lines->push_back(StringPiece(data + offset, end - offset));
+    offset = end + 1;
   }
-  if (!errors::IsOutOfRange(s)) {
-    return s;
-  }
-  *num_lines = next_id;
-  return Status::OK();
+  *truncated = offset < contents.size();
 }
 
-// Iterator that reads a text file. Each iteration process one line, it parses
-// the line and populates the keys and values tensors used for initialization
-// with a single key and corresponding value.
+// Parses the lines of a vocabulary file into the keys or the values of a
+// table. What information of the line to populate the element with is
+// specified by an index given a delimiter:
 //
-// What information of the line to populate the key or values is specified by
-// providing key_index and value_index.
-class TextFileLineIterator
-    : public InitializableLookupTable::InitTableIterator {
+// - Index -2 means the entire line as string.
+// - Index -1 means the line number stored in int64.
+// - Index >= 0 represent index (starting at zero) of the split line based on
+//   delimiter.
+class TextFileLineParser {
  public:
-  TextFileLineIterator()
-      : valid_(false),
-        vocab_size_(-1),
-        status_(errors::FailedPrecondition("Not initialized")) {}
-
-  // Initialize iterator.
-  //
-  // Prepares the file 'filename' and sets the data types to return the keys and
-  // values tensors. It requires the indices of the tokens in the line given a
-  // delimiter to specify where to pick the data from.
-  //
-  // - Index -2 means the entire line as string.
-  // - Index -1 means the line number stored in int64.
-  // - Index >= 0 represent index (starting at zero) of the split line based on
-  //   delimiter.
-  Status Init(const string& filename, int64 vocab_size, char delimiter,
-              DataType key_dtype, int64 key_index, DataType value_dtype,
-              int64 value_index, Env* env) {
-    if (vocab_size == -1) {
-      TF_RETURN_IF_ERROR(GetNumLinesInTextFile(env, filename, &vocab_size));
-    }
-    filename_ = filename;
-    vocab_size_ = vocab_size;
-    delimiter_ = delimiter;
-    key_ = Tensor(key_dtype, TensorShape({}));
-    value_ = Tensor(value_dtype, TensorShape({}));
-    key_index_ = key_index;
-    value_index_ = value_index;
-
-    status_ = env->NewRandomAccessFile(filename_, &file_);
-    if (!status_.ok()) return status_;
-
-    input_buffer_.reset(new io::InputBuffer(file_.get(), kInputBufferSize));
-    valid_ = true;
-    next_id_ = 0;
-    ignore_split_ = std::max(key_index_, value_index_) < 0;
-    Next();
-    return status_;
-  }
-
-  void Next() override {
-    if (!valid_) return;
-
-    string line;
-    status_ = input_buffer_->ReadLine(&line);
-    if (!status_.ok()) {
-      if (errors::IsOutOfRange(status_) && next_id_ != vocab_size_) {
-        status_ = errors::InvalidArgument("Invalid vocab_size in ", filename_,
-                                          ": expected ", vocab_size_,
-                                          " but got ", next_id_);
+  TextFileLineParser(const string& filename, char delimiter, int64 key_index,
+                     int64 value_index, Tensor* keys, Tensor* values)
+      : filename_(filename),
+        delimiter_(delimiter),
+        key_index_(key_index),
+        value_index_(value_index),
+        ignore_split_(std::max(key_index, value_index) < 0),
+        keys_(keys),
+        values_(values) {}
+
+  // Parses "line", the line with number "line_number", into element
+  // "line_number" of the keys and values.
+  Status Parse(int64 line_number, StringPiece line) const {
+    string stripped;
+    if (line.find('\r') != StringPiece::npos) {
+      // InputBuffer::ReadLine() drops '\r' characters.
+      for (char c : line) {
+        if (c != '\r') stripped.push_back(c);
       }
-      valid_ = false;
-      return;
-    }
-    if (next_id_ >= vocab_size_) {
-      LOG(WARNING) << "Truncated " << filename_ << " before it's end at "
-                   << vocab_size_ << " records.";
-      LOG(WARNING) << "next_id_  : " << next_id_;
-      status_ = errors::OutOfRange("Finished reading ", vocab_size_,
-                                   " of lines from ", filename_);
-      valid_ = false;
-      return;
+      line = stripped;
     }
     if (line.empty()) {
-      status_ = errors::InvalidArgument("Invalid content in ", filename_,
-                                        ": empty line found at position ",
-                                        input_buffer_->Tell(), ".");
-      valid_ = false;
-      return;
+      return errors::InvalidArgument("Invalid content in ", filename_,
+                                     ": empty line found at position ",
+                                     line_number, ".");
     }
 
     std::vector<string> tokens;
     if (!ignore_split_) {
       tokens = str_util::Split(line, delimiter_);
       if (std::max(key_index_, value_index_) >= tokens.size()) {
-        status_ = errors::InvalidArgument(
-            "Invalid number of columns in ", filename_, " line ", next_id_,
+        return errors::InvalidArgument(
+            "Invalid number of columns in ", filename_, " line ", line_number,
             " (", line, ") : expected ", std::max(key_index_, value_index_),
             " got ", tokens.size());
-        valid_ = false;
-        return;
       }
     }
-    status_ = SetValue(line, tokens, key_index_, key_.dtype(), &key_);
-    if (!status_.ok()) {
-      valid_ = false;
-      return;
-    }
-    status_ = SetValue(line, tokens, value_index_, value_.dtype(), &value_);
-    if (!status_.ok()) {
-      valid_ = false;
-      return;
-    }
-
-    next_id_++;
+    TF_RETURN_IF_ERROR(
+        SetValue(line_number, line, tokens, key_index_, keys_));
+    return SetValue(line_number, line, tokens, value_index_, values_);
   }
 
-  bool Valid() const override { return valid_; }
-
-  const Tensor& keys() const override { return key_; }
-
-  const Tensor& values() const override { return value_; }
-
-  Status status() const override { return status_; }
-
-  int64 total_size() const override { return vocab_size_; }
-
  private:
-  Tensor key_;
-  Tensor value_;
-  bool valid_;  // true if the iterator points to an existing range.
-  int64 key_index_;
-  int64 value_index_;
-  int64 next_id_;
-  int64 vocab_size_;
-  string filename_;
-  char delimiter_;
-  Status status_;
-  bool ignore_split_;
-  std::unique_ptr<RandomAccessFile> file_;  // must outlive input_buffer_
-  std::unique_ptr<io::InputBuffer> input_buffer_;
-
-  // Set the corresponding value from line or tokens based on 'index' into the
-  // tensor 't'. The value is transformed to the given data type 'dtype'.
-  Status SetValue(const string& line, const std::vector<string>& tokens,
-                  int64 index, DataType dtype, Tensor* tensor) {
+  // Set element "line_number" of the tensor 't' from line or tokens based on
+  // 'index'. The value is transformed to the data type of the tensor.
+  Status SetValue(int64 line_number, StringPiece line,
+                  const std::vector<string>& tokens, int64 index,
+                  Tensor* tensor) const {
     if (index == kLineNumber) {
-      tensor->flat<int64>()(0) = next_id_;
+      tensor->flat<int64>()(line_number) = line_number;
       return Status::OK();
     }
     if (index == kWholeLine) {
-      tensor->flat<string>()(0) = line;
+      tensor->flat<string>()(line_number) = line.ToString();
       return Status::OK();
     }
     const string& token = tokens[index];
@@ -261,48 +188,58 @@ class TextFileLineIterator
       case DT_INT32: {
         int32 value;
         if (!strings::safe_strto32(token.c_str(), &value)) {
-          valid_ = false;
-          return errors::InvalidArgument("Field ", token, " in line ", next_id_,
-                                         " is not a valid int32.");
+          return errors::InvalidArgument("Field ", token, " in line ",
+                                         line_number, " is not a valid int32.");
         }
-        tensor->flat<int32>()(0) = value;
+        tensor->flat<int32>()(line_number) = value;
       } break;
       case DT_INT64: {
         int64 value;
         if (!strings::safe_strto64(token.c_str(), &value)) {
-          valid_ = false;
-          return errors::InvalidArgument("Field ", token, " in line ", next_id_,
-                                         " is not a valid int64.");
+          return errors::InvalidArgument("Field ", token, " in line ",
+                                         line_number, " is not a valid int64.");
         }
-        tensor->flat<int64>()(0) = value;
+        tensor->flat<int64>()(line_number) = value;
       } break;
       case DT_FLOAT: {
         float value;
         if (!strings::safe_strtof(token.c_str(), &value)) {
-          valid_ = false;
-          return errors::InvalidArgument("Field ", token, " in line ", next_id_,
-                                         " is not a valid float.");
+          return errors::InvalidArgument("Field ", token, " in line ",
+                                         line_number, " is not a valid float.");
         }
-        tensor->flat<float>()(0) = value;
+        tensor->flat<float>()(line_number) = value;
       } break;
       case DT_STRING:
-        tensor->flat<string>()(0) = token;
+        tensor->flat<string>()(line_number) = token;
         break;
       default:
-        valid_ = false;
-        return errors::InvalidArgument("Data type ", dtype, " not supported.");
+        return errors::InvalidArgument("Data type ", tensor->dtype(),
+                                       " not supported.");
     }
     return Status::OK();
   }
 
-  TF_DISALLOW_COPY_AND_ASSIGN(TextFileLineIterator);
+  const string filename_;
+  const char delimiter_;
+  const int64 key_index_;
+  const int64 value_index_;
+  const bool ignore_split_;
+  Tensor* const keys_;    // Not owned.
+  Tensor* const values_;  // Not owned.
+
+  TF_DISALLOW_COPY_AND_ASSIGN(TextFileLineParser);
 };
 
 // Helper function to initialize an InitializableLookupTable from a text file.
-Status InitializeTableFromTextFile(const string& filename, int64 vocab_size,
-                                   char delimiter, int32 key_index,
-                                   int32 value_index, Env* env,
-                                   InitializableLookupTable* table) {
+//
+// The file is mapped into memory if the file system supports it, split into
+// lines, and the lines are parsed in parallel on the worker threads into a
+// tensor of keys and one of values, which are inserted into the table at once.
+Status InitializeTableFromTextFile(
+    const string& filename, int64 vocab_size, char delimiter, int32 key_index,
+    int32 value_index, Env* env,
+    const DeviceBase::CpuWorkerThreads& worker_threads,
+    InitializableLookupTable* table) {
   if (key_index == kLineNumber && table->key_dtype() != DT_INT64) {
     return errors::InvalidArgument(
         "Key index for line number requires table key dtype of int64, got ",
@@ -324,14 +261,63 @@ Status InitializeTableFromTextFile(const string& filename, int64 vocab_size,
         table->value_dtype());
   }
 
-  TextFileLineIterator iter;
-  TF_RETURN_IF_ERROR(iter.Init(filename, vocab_size, delimiter,
-                               table->key_dtype(), key_index,
-                               table->value_dtype(), value_index, env));
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  string buffer;
+  StringPiece contents;
+  if (env->NewReadOnlyMemoryRegionFromFile(filename, &region).ok()) {
+    contents.set(region->data(), region->length());
+  } else {
+    TF_RETURN_IF_ERROR(ReadFileToString(env, filename, &buffer));
+    contents = buffer;
+  }
+  std::vector<StringPiece> lines;
+  bool truncated = false;
+  SplitLines(contents, vocab_size, &lines, &truncated);
+  if (truncated) {
+    LOG(WARNING) << "Truncated " << filename << " before it's end at "
+                 << vocab_size << " records.";
+  }
+  const int64 num_lines = lines.size();
+  if (num_lines == 0) {
+    return errors::InvalidArgument("Invalid content in ", filename,
+                                   ": no lines found.");
+  }
+
+  // Each shard records its first error. Shards cover consecutive lines, so
+  // the error of the first line that failed is the one of the earliest shard.
+  Tensor keys(table->key_dtype(), TensorShape({num_lines}));
+  Tensor values(table->value_dtype(), TensorShape({num_lines}));
+  const TextFileLineParser parser(filename, delimiter, key_index, value_index,
+                                  &keys, &values);
+  mutex mu;
+  int64 error_line = num_lines;
+  Status error;
+  Shard(worker_threads.num_threads, worker_threads.workers, num_lines,
+        kParseLineCost, [&](int64 start, int64 limit) {
+          for (int64 i = start; i < limit; ++i) {
+            Status s = parser.Parse(i, lines[i]);
+            if (!s.ok()) {
+              mutex_lock l(mu);
+              if (i < error_line) {
+                error_line = i;
+                error = s;
+              }
+              return;
+            }
+          }
+        });
+  TF_RETURN_IF_ERROR(error);
+  if (vocab_size != -1 && num_lines != vocab_size) {
+    return errors::InvalidArgument("Invalid vocab_size in ", filename,
+                                   ": expected ", vocab_size, " but got ",
+                                   num_lines);
+  }
+
   // For initialization from files, ignore if the table is already
   // initialized. The table shared name should contain the filename to
   // avoid trying to initialize the same table from the same file at the same
   // time.
+  KeyValueTensorIterator iter(&keys, &values);
   Status s = table->Initialize(iter);
   if (errors::IsFailedPrecondition(s) && table->is_initialized()) {
     LOG(WARNING) << "Table trying to initialize from file " << filename
@@ -430,7 +416,9 @@ class InitializeTableFromTextFileOp : public OpKernel {
 
     OP_REQUIRES_OK(ctx, lookup::InitializeTableFromTextFile(
                             vocab_filename, vocab_size_, delimiter_, key_index_,
-                            value_index_, ctx->env(), table));
+                            value_index_, ctx->env(),
+                            *ctx->device()->tensorflow_cpu_worker_threads(),
+                            table));
   }
 
  private:
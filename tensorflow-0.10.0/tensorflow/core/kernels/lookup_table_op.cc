@@ -24,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/kernels/initializable_lookup_table.h"
+#include "tensorflow/core/lib/gtl/flat_hash_map.h"
 #include "tensorflow/core/lib/gtl/inlined_vector.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/lib/hash/hash.h"
@@ -51,7 +52,7 @@ const float SubtleMustCopyUnlessStringOrFloat(const float value) {
 
 }  // namespace
 
-// Lookup table that wraps an unordered_map, where the key and value data type
+// Lookup table that wraps a flat hash map, where the key and value data type
 // is specified.
 //
 // This table is recommended for any variations to key values.
@@ -90,14 +91,17 @@ class HashTable : public InitializableLookupTable {
   DataType value_dtype() const override { return DataTypeToEnum<V>::v(); }
 
  protected:
-  Status DoPrepare(size_t unused) override {
+  Status DoPrepare(size_t expected_num_elements) override {
     if (is_initialized_) {
       return errors::Aborted("HashTable already initialized.");
     }
     if (!table_) {
-      table_ = std::unique_ptr<std::unordered_map<K, V>>(
-          new std::unordered_map<K, V>());
+      table_ = std::unique_ptr<gtl::FlatHashMap<K, V>>(
+          new gtl::FlatHashMap<K, V>());
     }
+    // Sizes the table once, rather than rehashing it as large vocabularies
+    // are inserted.
+    table_->reserve(expected_num_elements);
     return Status::OK();
   };
 
@@ -136,10 +140,10 @@ class HashTable : public InitializableLookupTable {
   }
 
  private:
-  std::unique_ptr<std::unordered_map<K, V>> table_;
+  std::unique_ptr<gtl::FlatHashMap<K, V>> table_;
 };
 
-// Lookup table that wraps an unordered_map, where the key and value data type
+// Lookup table that wraps a flat hash map, where the key and value data type
 // is specified. Each individual value must be a scalar. If vector values are
 // required, use MutableHashTableOfTensors.
 //
@@ -222,10 +226,10 @@ class MutableHashTableOfScalars : public LookupInterface {
  private:
   // TODO(andreasst): consider using a read/write lock or a concurrent map
   mutable mutex mu_;
-  std::unordered_map<K, V> table_ GUARDED_BY(mu_);
+  gtl::FlatHashMap<K, V> table_ GUARDED_BY(mu_);
 };
 
-// Lookup table that wraps an unordered_map. Behaves identical to
+// Lookup table that wraps a flat hash map. Behaves identical to
 // MutableHashTableOfScalars except that each value must be a vector.
 template <class K, class V>
 class MutableHashTableOfTensors : public LookupInterface {
@@ -324,7 +328,7 @@ class MutableHashTableOfTensors : public LookupInterface {
   // TODO(andreasst): consider using a read/write lock or a concurrent map
   mutable mutex mu_;
   typedef gtl::InlinedVector<V, 4> ValueArray;
-  std::unordered_map<K, ValueArray> table_ GUARDED_BY(mu_);
+  gtl::FlatHashMap<K, ValueArray> table_ GUARDED_BY(mu_);
 };
 
 }  // namespace lookup
@@ -0,0 +1,66 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/string_ops.cc.
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/util/packed_strings.h"
+
+namespace tensorflow {
+
+class PackStringsOp : public OpKernel {
+ public:
+  explicit PackStringsOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& strings = context->input(0);
+    Tensor* bytes = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({PackedStrings::NumBytes(strings)}),
+                       &bytes));
+    Tensor* offsets = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                1, TensorShape({strings.NumElements() + 1}),
+                                &offsets));
+    PackedStrings::Pack(strings, bytes, offsets);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("PackStrings").Device(DEVICE_CPU), PackStringsOp);
+
+class UnpackStringsOp : public OpKernel {
+ public:
+  explicit UnpackStringsOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    PackedStrings packed;
+    OP_REQUIRES_OK(context, PackedStrings::FromTensors(
+                                context->input(0), context->input(1), &packed));
+    Tensor* strings = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(
+                                0, TensorShape({packed.size()}), &strings));
+    packed.ToStrings(strings);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("UnpackStrings").Device(DEVICE_CPU),
+                        UnpackStringsOp);
+
+}  // namespace tensorflow
@@ -77,4 +77,32 @@ class RestoreSliceOp : public OpKernel {
 REGISTER_KERNEL_BUILDER(Name("RestoreSlice").Device(DEVICE_CPU),
                         RestoreSliceOp);
 
+class RestoreSlicesOp : public OpKernel {
+ public:
+  explicit RestoreSlicesOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    int preferred_shard;
+    OP_REQUIRES_OK(context,
+                   context->GetAttr("preferred_shard", &preferred_shard));
+    if (preferred_shard == -1) {
+      preferred_shard_ = checkpoint::TensorSliceReader::kLoadAllShards;
+    } else {
+      OP_REQUIRES(context, preferred_shard >= 0,
+                  errors::InvalidArgument("Attribute 'preferred_shard' must be "
+                                          "greater or equal to -1"));
+      preferred_shard_ = preferred_shard;
+    }
+  }
+  void Compute(OpKernelContext* context) override {
+    RestoreTensors(context, &checkpoint::OpenTableTensorSliceReader,
+                   preferred_shard_);
+  }
+
+ private:
+  int preferred_shard_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("RestoreSlices").Device(DEVICE_CPU),
+                        RestoreSlicesOp);
+
 }  // namespace tensorflow
@@ -25,14 +25,21 @@ limitations under the License.
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/util/tensor_slice_reader.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
+#include "tensorflow/core/util/tensor_slice_writer.h"
 
 namespace tensorflow {
 namespace {
@@ -440,5 +447,265 @@ TEST_F(RestoreSliceOpTest, RestoreInt) {
   }
 }
 
+class RestoreSlicesOpTest : public OpsTestBase {
+ protected:
+  void MakeRestoreSlicesOp(const DataTypeVector& dts) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "RestoreSlices")
+                     .Input(FakeInput())
+                     .Input(FakeInput())
+                     .Input(FakeInput())
+                     .Attr("dt", dts)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Writes "weights", an 8x2 float tensor, as one slice of 4 rows per shard,
+  // and "bias", an int32 vector, to the second shard.
+  void WriteShards() {
+    const TensorShape weights_shape({8, 2});
+    for (int shard = 0; shard < 2; ++shard) {
+      checkpoint::TensorSliceWriter writer(
+          strings::StrCat(prefix_, "-0000", shard, "-of-00002"),
+          checkpoint::CreateTableTensorSliceBuilder);
+      TensorSlice slice;
+      TF_ASSERT_OK(
+          TensorSlice::Parse(shard == 0 ? "0,4:-" : "4,4:-", &slice));
+      TF_ASSERT_OK(writer.Add(
+          "weights", weights_shape, slice,
+          weights_.flat<float>().data() + shard * 8));
+      if (shard == 1) {
+        TF_ASSERT_OK(writer.Add("bias", bias_.shape(), TensorSlice(1),
+                                bias_.flat<int32>().data()));
+      }
+      TF_ASSERT_OK(writer.Finish());
+    }
+  }
+
+  void AddRestoreInputs(const std::vector<string>& names,
+                        const std::vector<string>& shapes_and_slices) {
+    const string pattern = strings::StrCat(prefix_, "-?????-of-00002");
+    AddInput<string>(TensorShape({}),
+                     [&pattern](int x) -> string { return pattern; });
+    AddInput<string>(TensorShape({static_cast<int64>(names.size())}),
+                     [&names](int x) -> string { return names[x]; });
+    AddInput<string>(
+        TensorShape({static_cast<int64>(shapes_and_slices.size())}),
+        [&shapes_and_slices](int x) -> string {
+          return shapes_and_slices[x];
+        });
+  }
+
+  const string prefix_ = io::JoinPath(testing::TmpDir(), "restore_slices");
+  const Tensor weights_ = test::AsTensor<float>(
+      {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15},
+      TensorShape({8, 2}));
+  const Tensor bias_ = test::AsTensor<int32>({7, 8, 9});
+};
+
+TEST_F(RestoreSlicesOpTest, RestoresFromAllShards) {
+  WriteShards();
+  MakeRestoreSlicesOp({DT_FLOAT, DT_INT32, DT_FLOAT});
+  AddRestoreInputs({"weights", "bias", "weights"}, {"", "", "8 2 2,4:-"});
+  TF_ASSERT_OK(RunOpKernel());
+
+  test::ExpectTensorEqual<float>(weights_, *GetOutput(0));
+  test::ExpectTensorEqual<int32>(bias_, *GetOutput(1));
+  // Rows 2 to 5 span both shards.
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({4, 5, 6, 7, 8, 9, 10, 11}, TensorShape({4, 2})),
+      *GetOutput(2));
+}
+
+TEST_F(RestoreSlicesOpTest, Errors) {
+  WriteShards();
+  MakeRestoreSlicesOp({DT_FLOAT, DT_FLOAT});
+  AddRestoreInputs({"weights", "bias"}, {"", ""});
+  Status status = RunOpKernel();
+  EXPECT_TRUE(errors::IsInvalidArgument(status)) << status;
+
+  inputs_.clear();
+  MakeRestoreSlicesOp({DT_FLOAT});
+  AddRestoreInputs({"missing"}, {""});
+  status = RunOpKernel();
+  EXPECT_TRUE(errors::IsNotFound(status)) << status;
+}
+
+// Runs a SaveSlices kernel with async_write and max_incremental_saves, and
+// waits for its writes with WaitForPendingSave.
+class IncrementalSaveTest : public RestoreSliceOpTest {
+ protected:
+  void MakeSaveOp(bool async_write, int max_incremental_saves) {
+    NodeDef save;
+    TF_ASSERT_OK(NodeDefBuilder("save", "SaveSlices")
+                     .Input(FakeInput(DT_STRING))
+                     .Input(FakeInput(DT_STRING))
+                     .Input(FakeInput(DT_STRING))
+                     .Input(FakeInput({DT_FLOAT}))
+                     .Attr("async_write", async_write)
+                     .Attr("max_incremental_saves", max_incremental_saves)
+                     .Finalize(&save));
+    device_.reset(
+        DeviceFactory::NewDevice("CPU", {}, "/job:a/replica:0/task:0"));
+    Status status;
+    save_ = CreateOpKernel(DEVICE_CPU, device_.get(), cpu_allocator(), save,
+                           TF_GRAPH_DEF_VERSION, &status);
+    TF_ASSERT_OK(status);
+
+    NodeDef wait;
+    TF_ASSERT_OK(NodeDefBuilder("wait", "WaitForPendingSave")
+                     .Input(FakeInput(DT_STRING))
+                     .Finalize(&wait));
+    wait_ = CreateOpKernel(DEVICE_CPU, device_.get(), cpu_allocator(), wait,
+                           TF_GRAPH_DEF_VERSION, &status);
+    TF_ASSERT_OK(status);
+  }
+
+  // Saves "embedding", a 4x3 float tensor, to "filename".
+  Status Save(const string& filename, const Tensor& embedding) {
+    Tensor filename_t(DT_STRING, TensorShape({}));
+    filename_t.scalar<string>()() = filename;
+    Tensor names(DT_STRING, TensorShape({1}));
+    names.flat<string>()(0) = "embedding";
+    Tensor shapes_and_slices(DT_STRING, TensorShape({1}));
+    gtl::InlinedVector<TensorValue, 4> inputs = {
+        {nullptr, &filename_t},
+        {nullptr, &names},
+        {nullptr, &shapes_and_slices},
+        {nullptr, const_cast<Tensor*>(&embedding)}};
+    Status status = Run(save_.get(), &inputs);
+    if (!status.ok()) return status;
+
+    // Does nothing for a synchronous save.
+    inputs.resize(1);
+    return Run(wait_.get(), &inputs);
+  }
+
+  // Restores "embedding" from "filename".
+  Status Restore(const string& filename, Tensor* embedding) {
+    inputs_.clear();
+    MakeRestoreSliceOp(DT_FLOAT);
+    AddInput<string>(TensorShape({}),
+                     [&filename](int x) -> string { return filename; });
+    AddInput<string>(TensorShape({}),
+                     [](int x) -> string { return "embedding"; });
+    AddInput<string>(TensorShape({}), [](int x) -> string { return ""; });
+    Status status = RunOpKernel();
+    if (status.ok()) *embedding = *GetOutput(0);
+    return status;
+  }
+
+  // Returns the number of rows of "embedding" written to "filename".
+  int64 SavedRows(const string& filename) {
+    checkpoint::TensorSliceReader reader(filename);
+    int64 rows = 0;
+    for (const TensorSlice& slice : reader.LoadedSlices("embedding")) {
+      rows += slice.IsFullAt(0) ? 4 : slice.length(0);
+    }
+    return rows;
+  }
+
+  // Saves five versions of "embedding" with max_incremental_saves 2, and
+  // restores each.
+  void SaveAndRestore(const string& prefix) {
+    std::vector<string> filenames;
+    std::vector<Tensor> saved;
+    Tensor embedding = test::AsTensor<float>(
+        {0, 1, 2, 10, 11, 12, 20, 21, 22, 30, 31, 32}, TensorShape({4, 3}));
+    for (int i = 0; i < 5; ++i) {
+      // Changes row 1 after the first save, and rows 2 and 3 after the second.
+      if (i == 1) embedding.matrix<float>()(1, 0) = 100;
+      if (i == 2) {
+        embedding.matrix<float>()(2, 2) = 200;
+        embedding.matrix<float>()(3, 1) = 300;
+      }
+      filenames.push_back(
+          io::JoinPath(testing::TmpDir(), strings::StrCat(prefix, "_", i)));
+      TF_ASSERT_OK(Save(filenames.back(), embedding));
+      saved.push_back(tensor::DeepCopy(embedding));
+    }
+
+    // The 4th save is full again.  The 5th, with no changes, keeps one row to
+    // record the tensor's shape.
+    EXPECT_EQ(4, SavedRows(filenames[0]));
+    EXPECT_EQ(1, SavedRows(filenames[1]));
+    EXPECT_EQ(2, SavedRows(filenames[2]));
+    EXPECT_EQ(4, SavedRows(filenames[3]));
+    EXPECT_EQ(1, SavedRows(filenames[4]));
+
+    for (int i = 0; i < 5; ++i) {
+      Tensor restored;
+      TF_ASSERT_OK(Restore(filenames[i], &restored));
+      test::ExpectTensorEqual<float>(saved[i], restored);
+    }
+  }
+
+ private:
+  Status Run(OpKernel* op, gtl::InlinedVector<TensorValue, 4>* inputs) {
+    OpKernelContext::Params params;
+    params.device = device_.get();
+    params.frame_iter = FrameAndIter(0, 0);
+    params.inputs = inputs;
+    params.op_kernel = op;
+    std::vector<AllocatorAttributes> attrs;
+    test::SetOutputAttrs(&params, &attrs);
+    checkpoint::TensorSliceReaderCacheWrapper slice_reader_cache_wrapper;
+    params.slice_reader_cache = &slice_reader_cache_wrapper;
+    OpKernelContext ctx(&params);
+    AsyncOpKernel* async = op->AsAsync();
+    if (async) {
+      Notification done;
+      async->ComputeAsync(&ctx, [&done]() { done.Notify(); });
+      done.WaitForNotification();
+    } else {
+      op->Compute(&ctx);
+    }
+    return ctx.status();
+  }
+
+  std::unique_ptr<Device> device_;
+  std::unique_ptr<OpKernel> save_;
+  std::unique_ptr<OpKernel> wait_;
+};
+
+TEST_F(IncrementalSaveTest, SyncSaves) {
+  MakeSaveOp(false, 2);
+  SaveAndRestore("incremental_sync");
+}
+
+TEST_F(IncrementalSaveTest, AsyncSaves) {
+  MakeSaveOp(true, 2);
+  SaveAndRestore("incremental_async");
+}
+
+TEST_F(IncrementalSaveTest, AsyncSaveCopiesInputs) {
+  MakeSaveOp(true, 0);
+  const string filename = io::JoinPath(testing::TmpDir(), "async_copy");
+  Tensor embedding(DT_FLOAT, TensorShape({4, 3}));
+  embedding.flat<float>().setConstant(1);
+  const Tensor expected = tensor::DeepCopy(embedding);
+  TF_ASSERT_OK(Save(filename, embedding));
+  embedding.flat<float>().setConstant(2);
+
+  Tensor restored;
+  TF_ASSERT_OK(Restore(filename, &restored));
+  test::ExpectTensorEqual<float>(expected, restored);
+  EXPECT_EQ(4, SavedRows(filename));
+}
+
+TEST_F(IncrementalSaveTest, MissingBase) {
+  MakeSaveOp(false, 2);
+  const string base = io::JoinPath(testing::TmpDir(), "missing_base_0");
+  const string filename = io::JoinPath(testing::TmpDir(), "missing_base_1");
+  Tensor embedding(DT_FLOAT, TensorShape({4, 3}));
+  embedding.flat<float>().setZero();
+  TF_ASSERT_OK(Save(base, embedding));
+  embedding.matrix<float>()(0, 0) = 1;
+  TF_ASSERT_OK(Save(filename, embedding));
+  TF_ASSERT_OK(Env::Default()->DeleteFile(base));
+
+  Tensor restored;
+  EXPECT_FALSE(Restore(filename, &restored).ok());
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -0,0 +1,420 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/data_flow_ops.cc.
+
+#include "tensorflow/core/kernels/ring_fifo_queue.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/queue_base.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+RingFIFOQueue::RingFIFOQueue(int capacity,
+                             const DataTypeVector& component_dtypes,
+                             const std::vector<TensorShape>& component_shapes,
+                             const string& name)
+    : QueueBase(capacity, component_dtypes, component_shapes, name),
+      enqueue_pos_(0),
+      dequeue_pos_(0),
+      waiters_(0),
+      closing_(false) {}
+
+Status RingFIFOQueue::Initialize() {
+  if (component_dtypes_.empty()) {
+    return errors::InvalidArgument("Empty component types for queue ", name_);
+  }
+  if (component_dtypes_.size() != component_shapes_.size()) {
+    return errors::InvalidArgument(
+        "RingFIFOQueue '", name_, "' requires a shape for each component.  ",
+        "Types: ", DataTypeSliceString(component_dtypes_), ", Shapes: ",
+        ShapeListString(component_shapes_));
+  }
+  if (capacity_ <= 0 || capacity_ == kUnbounded) {
+    return errors::InvalidArgument("RingFIFOQueue '", name_,
+                                   "' requires a positive, bounded capacity");
+  }
+  slots_.reset(new Slot[capacity_]);
+  for (int32 i = 0; i < capacity_; ++i) {
+    slots_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+  return Status::OK();
+}
+
+bool RingFIFOQueue::TryPush(const Tuple& tuple) {
+  uint64 pos = enqueue_pos_.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot* slot = &slots_[pos % capacity_];
+    const uint64 sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence == pos) {
+      if (enqueue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        slot->tuple = tuple;
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (sequence < pos) {
+      // The slot still holds the element pushed capacity_ positions ago.
+      return false;
+    } else {
+      pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+bool RingFIFOQueue::TryPop(Tuple* tuple) {
+  uint64 pos = dequeue_pos_.load(std::memory_order_relaxed);
+  for (;;) {
+    Slot* slot = &slots_[pos % capacity_];
+    const uint64 sequence = slot->sequence.load(std::memory_order_acquire);
+    if (sequence == pos + 1) {
+      if (dequeue_pos_.compare_exchange_weak(pos, pos + 1,
+                                             std::memory_order_relaxed)) {
+        *tuple = std::move(slot->tuple);
+        slot->tuple.clear();
+        slot->sequence.store(pos + capacity_, std::memory_order_release);
+        return true;
+      }
+    } else if (sequence < pos + 1) {
+      // Nothing has been pushed at this position yet.
+      return false;
+    } else {
+      pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+void RingFIFOQueue::AddWaiter() {
+  waiters_.fetch_add(1);
+  // Pairs with the fence in NotifyWaiters(): either the attempt sees the
+  // ring after a concurrent lock-free push or pop, or that operation sees
+  // the waiter and flushes the attempt.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+void RingFIFOQueue::NotifyWaiters() {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (waiters_.load(std::memory_order_relaxed) > 0) {
+    FlushUnlocked();
+  }
+}
+
+int32 RingFIFOQueue::size() {
+  const uint64 dequeued = dequeue_pos_.load(std::memory_order_acquire);
+  const uint64 enqueued = enqueue_pos_.load(std::memory_order_acquire);
+  if (enqueued <= dequeued) return 0;
+  return std::min<uint64>(enqueued - dequeued, capacity_);
+}
+
+void RingFIFOQueue::TryEnqueue(const Tuple& tuple, OpKernelContext* ctx,
+                               DoneCallback callback) {
+  if (waiters_.load() == 0 && !closing_.load() && TryPush(tuple)) {
+    NotifyWaiters();
+    callback();
+    return;
+  }
+
+  CancellationManager* cm = ctx->cancellation_manager();
+  CancellationToken token = cm->get_cancellation_token();
+  bool already_cancelled;
+  {
+    mutex_lock l(mu_);
+    already_cancelled = !cm->RegisterCallback(
+        token, [this, cm, token]() { Cancel(kEnqueue, cm, token); });
+    if (!already_cancelled) {
+      AddWaiter();
+      enqueue_attempts_.emplace_back(
+          1,
+          [this, callback]() {
+            RemoveWaiter();
+            callback();
+          },
+          ctx, cm, token,
+          [tuple, this](Attempt* attempt) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+            if (closed_) {
+              attempt->context->SetStatus(
+                  errors::Aborted("RingFIFOQueue '", name_, "' is closed."));
+              return kComplete;
+            }
+            return TryPush(tuple) ? kComplete : kNoProgress;
+          });
+    }
+  }
+  if (!already_cancelled) {
+    FlushUnlocked();
+  } else {
+    ctx->SetStatus(errors::Cancelled("Enqueue operation was cancelled"));
+    callback();
+  }
+}
+
+Status RingFIFOQueue::GetElementFromBatch(const Tuple& tuple, int64 index,
+                                          OpKernelContext* ctx,
+                                          Tuple* element) {
+  element->clear();
+  element->reserve(num_components());
+  for (int i = 0; i < num_components(); ++i) {
+    Tensor component;
+    TF_RETURN_IF_ERROR(ctx->allocate_temp(
+        component_dtypes_[i], component_shapes_[i], &component));
+    TF_RETURN_IF_ERROR(CopySliceToElement(tuple[i], &component, index));
+    element->push_back(component);
+  }
+  return Status::OK();
+}
+
+Status RingFIFOQueue::BatchElements(const std::vector<Tuple>& elements,
+                                    OpKernelContext* ctx, Tuple* batch) {
+  batch->clear();
+  batch->reserve(num_components());
+  for (int i = 0; i < num_components(); ++i) {
+    Tensor component;
+    TF_RETURN_IF_ERROR(ctx->allocate_temp(
+        component_dtypes_[i], ManyOutShape(i, elements.size()), &component));
+    for (size_t j = 0; j < elements.size(); ++j) {
+      TF_RETURN_IF_ERROR(CopyElementToSlice(elements[j][i], &component, j));
+    }
+    batch->push_back(component);
+  }
+  return Status::OK();
+}
+
+void RingFIFOQueue::TryEnqueueMany(const Tuple& tuple, OpKernelContext* ctx,
+                                   DoneCallback callback) {
+  const int64 batch_size = tuple[0].dim_size(0);
+  if (batch_size == 0) {
+    callback();
+    return;
+  }
+
+  CancellationManager* cm = ctx->cancellation_manager();
+  CancellationToken token = cm->get_cancellation_token();
+  bool already_cancelled;
+  {
+    mutex_lock l(mu_);
+    already_cancelled = !cm->RegisterCallback(
+        token, [this, cm, token]() { Cancel(kEnqueue, cm, token); });
+    if (!already_cancelled) {
+      AddWaiter();
+      enqueue_attempts_.emplace_back(
+          batch_size,
+          [this, callback]() {
+            RemoveWaiter();
+            callback();
+          },
+          ctx, cm, token,
+          [tuple, this](Attempt* attempt) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+            if (closed_) {
+              attempt->context->SetStatus(
+                  errors::Aborted("RingFIFOQueue '", name_, "' is closed."));
+              return kComplete;
+            }
+            RunResult result = kNoProgress;
+            while (attempt->elements_requested > 0) {
+              // attempt->tuple holds the next element while the ring is
+              // full, so that it is only sliced out of the batch once.
+              if (attempt->tuple.empty()) {
+                const int64 index =
+                    tuple[0].dim_size(0) - attempt->elements_requested;
+                attempt->context->SetStatus(GetElementFromBatch(
+                    tuple, index, attempt->context, &attempt->tuple));
+                if (!attempt->context->status().ok()) return kComplete;
+              }
+              if (!TryPush(attempt->tuple)) return result;
+              attempt->tuple.clear();
+              result = kProgress;
+              --attempt->elements_requested;
+            }
+            return kComplete;
+          });
+    }
+  }
+  if (!already_cancelled) {
+    FlushUnlocked();
+  } else {
+    ctx->SetStatus(errors::Cancelled("Enqueue operation was cancelled"));
+    callback();
+  }
+}
+
+void RingFIFOQueue::TryDequeue(OpKernelContext* ctx,
+                               CallbackWithTuple callback) {
+  if (waiters_.load() == 0) {
+    Tuple tuple;
+    if (TryPop(&tuple)) {
+      NotifyWaiters();
+      callback(tuple);
+      return;
+    }
+  }
+
+  CancellationManager* cm = ctx->cancellation_manager();
+  CancellationToken token = cm->get_cancellation_token();
+  bool already_cancelled;
+  {
+    mutex_lock l(mu_);
+    already_cancelled = !cm->RegisterCallback(
+        token, [this, cm, token]() { Cancel(kDequeue, cm, token); });
+    if (!already_cancelled) {
+      AddWaiter();
+      dequeue_attempts_.emplace_back(
+          1,
+          [this, callback]() {
+            RemoveWaiter();
+            callback(Tuple());
+          },
+          ctx, cm, token,
+          [callback, this](Attempt* attempt) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+            Tuple tuple;
+            if (TryPop(&tuple)) {
+              attempt->done_callback = [this, callback, tuple]() {
+                RemoveWaiter();
+                callback(tuple);
+              };
+              return kComplete;
+            }
+            if (closed_) {
+              attempt->context->SetStatus(errors::OutOfRange(
+                  "RingFIFOQueue '", name_, "' is closed and has ",
+                  "insufficient elements (requested ", 1,
+                  ", current size 0)"));
+              return kComplete;
+            }
+            return kNoProgress;
+          });
+    }
+  }
+  if (!already_cancelled) {
+    FlushUnlocked();
+  } else {
+    ctx->SetStatus(errors::Cancelled("Dequeue operation was cancelled"));
+    callback(Tuple());
+  }
+}
+
+void RingFIFOQueue::TryDequeueMany(int num_elements, OpKernelContext* ctx,
+                                   bool allow_small_batch,
+                                   CallbackWithTuple callback) {
+  if (num_elements == 0) {
+    Tuple tuple;
+    ctx->SetStatus(BatchElements({}, ctx, &tuple));
+    callback(tuple);
+    return;
+  }
+
+  CancellationManager* cm = ctx->cancellation_manager();
+  CancellationToken token = cm->get_cancellation_token();
+  bool already_cancelled;
+  {
+    mutex_lock l(mu_);
+    already_cancelled = !cm->RegisterCallback(
+        token, [this, cm, token]() { Cancel(kDequeue, cm, token); });
+    if (!already_cancelled) {
+      AddWaiter();
+      dequeue_attempts_.emplace_back(
+          num_elements,
+          [this, callback]() {
+            RemoveWaiter();
+            callback(Tuple());
+          },
+          ctx, cm, token,
+          [callback, allow_small_batch, this](Attempt* attempt)
+              EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+                // Dequeued elements accumulate in attempt->tuples until
+                // the batch is complete.
+                RunResult result = kNoProgress;
+                while (attempt->tuples.size() <
+                       static_cast<size_t>(attempt->elements_requested)) {
+                  Tuple tuple;
+                  if (!TryPop(&tuple)) break;
+                  attempt->tuples.push_back(std::move(tuple));
+                  result = kProgress;
+                }
+                if (attempt->tuples.size() <
+                    static_cast<size_t>(attempt->elements_requested)) {
+                  if (!closed_) return result;
+                  if (!allow_small_batch || attempt->tuples.empty()) {
+                    if (allow_small_batch && !enqueue_attempts_.empty()) {
+                      // Pending enqueues may still add elements.
+                      return kProgress;
+                    }
+                    const int64 dequeued = attempt->tuples.size();
+                    // Return the partial batch to the queue.  Its elements
+                    // move behind any that were enqueued concurrently.
+                    for (const Tuple& tuple : attempt->tuples) {
+                      if (!TryPush(tuple)) {
+                        attempt->context->SetStatus(errors::DataLoss(
+                            "Failed to restore element from "
+                            "partially-dequeued batch to RingFIFOQueue '",
+                            name_, "'"));
+                        break;
+                      }
+                    }
+                    attempt->tuples.clear();
+                    if (attempt->context->status().ok()) {
+                      attempt->context->SetStatus(errors::OutOfRange(
+                          "RingFIFOQueue '", name_, "' is closed and has ",
+                          "insufficient elements (requested ",
+                          attempt->elements_requested, ", current size ",
+                          dequeued, ")"));
+                    }
+                    return kComplete;
+                  }
+                }
+                Tuple batch;
+                attempt->context->SetStatus(
+                    BatchElements(attempt->tuples, attempt->context, &batch));
+                attempt->tuples.clear();
+                if (!attempt->context->status().ok()) return kComplete;
+                attempt->done_callback = [this, callback, batch]() {
+                  RemoveWaiter();
+                  callback(batch);
+                };
+                return kComplete;
+              });
+    }
+  }
+  if (!already_cancelled) {
+    FlushUnlocked();
+  } else {
+    ctx->SetStatus(errors::Cancelled("Dequeue operation was cancelled"));
+    callback(Tuple());
+  }
+}
+
+void RingFIFOQueue::Close(OpKernelContext* ctx, bool cancel_pending_enqueues,
+                          DoneCallback callback) {
+  closing_.store(true);
+  QueueBase::Close(ctx, cancel_pending_enqueues, callback);
+}
+
+Status RingFIFOQueue::MatchesNodeDef(const NodeDef& node_def) {
+  TF_RETURN_IF_ERROR(MatchesNodeDefOp(node_def, "RingFIFOQueue"));
+  TF_RETURN_IF_ERROR(MatchesNodeDefCapacity(node_def, capacity_));
+  TF_RETURN_IF_ERROR(MatchesNodeDefTypes(node_def));
+  TF_RETURN_IF_ERROR(MatchesNodeDefShapes(node_def));
+  return Status::OK();
+}
+
+}  // namespace tensorflow
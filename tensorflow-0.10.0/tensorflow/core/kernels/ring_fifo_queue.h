@@ -0,0 +1,117 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_RING_FIFO_QUEUE_H_
+#define TENSORFLOW_KERNELS_RING_FIFO_QUEUE_H_
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/queue_base.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A FIFO queue of fixed-shape elements backed by a bounded lock-free ring
+// buffer.  While no operation is blocked on the queue, Enqueue and Dequeue
+// claim a ring slot with a single compare-and-swap and never take mu_.
+// When the ring is full (or empty), the operation falls back to the
+// ordinary QueueBase attempt lists, and every operation goes through them
+// until the blocked attempts drain, which preserves the FIFO order between
+// waiters.  EnqueueMany and DequeueMany always use the attempt lists.
+class RingFIFOQueue : public QueueBase {
+ public:
+  RingFIFOQueue(int32 capacity, const DataTypeVector& component_dtypes,
+                const std::vector<TensorShape>& component_shapes,
+                const string& name);
+
+  Status Initialize();  // Must be called before any other method.
+
+  // Implementations of QueueInterface methods --------------------------------
+
+  void TryEnqueue(const Tuple& tuple, OpKernelContext* ctx,
+                  DoneCallback callback) override;
+  void TryEnqueueMany(const Tuple& tuple, OpKernelContext* ctx,
+                      DoneCallback callback) override;
+  void TryDequeue(OpKernelContext* ctx, CallbackWithTuple callback) override;
+  void TryDequeueMany(int num_elements, OpKernelContext* ctx,
+                      bool allow_small_batch,
+                      CallbackWithTuple callback) override;
+  void Close(OpKernelContext* ctx, bool cancel_pending_enqueues,
+             DoneCallback callback) override;
+  Status MatchesNodeDef(const NodeDef& node_def) override;
+
+  // May be stale by the time it returns if other threads are using the
+  // lock-free path.
+  int32 size() override;
+
+ protected:
+  ~RingFIFOQueue() override {}
+
+ private:
+  struct Slot {
+    // Equal to the position of the next push into this slot while it is
+    // free, and to that position plus one while it holds an element.
+    std::atomic<uint64> sequence;
+    Tuple tuple;
+  };
+
+  // Lock-free push and pop.  Return false if the ring is full or empty.
+  bool TryPush(const Tuple& tuple);
+  bool TryPop(Tuple* tuple);
+
+  // After a lock-free push or pop, runs any attempts that were queued
+  // concurrently and may now be able to make progress.
+  void NotifyWaiters();
+
+  // Registers (or unregisters) an attempt that is about to be appended to
+  // enqueue_attempts_ or dequeue_attempts_.  Lock-free operations are
+  // disabled while any attempt is registered.
+  void AddWaiter();
+  void RemoveWaiter() { waiters_.fetch_sub(1); }
+
+  // Builds the index^th element of a batch into *element.
+  Status GetElementFromBatch(const Tuple& tuple, int64 index,
+                             OpKernelContext* ctx, Tuple* element);
+
+  // Concatenates elements into a batch, one tensor per component.
+  Status BatchElements(const std::vector<Tuple>& elements,
+                       OpKernelContext* ctx, Tuple* batch);
+
+  // capacity_ slots, allocated by Initialize().
+  std::unique_ptr<Slot[]> slots_;
+  char pad0_[64];
+  std::atomic<uint64> enqueue_pos_;
+  char pad1_[64];
+  std::atomic<uint64> dequeue_pos_;
+  char pad2_[64];
+  std::atomic<int32> waiters_;
+  // Set before the close attempt is queued, so that no lock-free enqueue
+  // begins after Close() has been called.
+  std::atomic<bool> closing_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(RingFIFOQueue);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_RING_FIFO_QUEUE_H_
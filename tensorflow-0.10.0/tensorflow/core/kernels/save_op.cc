@@ -16,11 +16,18 @@ limitations under the License.
 // See docs in ../ops/io_ops.cc
 #include "tensorflow/core/kernels/save_restore_tensor.h"
 
+#include <memory>
+#include <vector>
+
 #include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/tensor_slice_writer.h"
 
@@ -39,15 +46,99 @@ REGISTER_KERNEL_BUILDER(Name("Save").Device(DEVICE_CPU), SaveOp);
 
 class SaveSlicesOp : public OpKernel {
  public:
-  explicit SaveSlicesOp(OpKernelConstruction* context) : OpKernel(context) {}
+  explicit SaveSlicesOp(OpKernelConstruction* context) : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("async_write", &async_write_));
+    int max_incremental_saves;
+    OP_REQUIRES_OK(context, context->GetAttr("max_incremental_saves",
+                                             &max_incremental_saves));
+    if (max_incremental_saves > 0) {
+      incremental_.reset(new IncrementalSaveState(max_incremental_saves));
+    }
+  }
 
   void Compute(OpKernelContext* context) override {
-    SaveTensors(context, &checkpoint::CreateTableTensorSliceBuilder, true);
+    if (!async_write_ && !incremental_) {
+      SaveTensors(context, &checkpoint::CreateTableTensorSliceBuilder, true);
+      return;
+    }
+    string filename;
+    std::vector<TensorSliceToSave> tensors;
+    OP_REQUIRES_OK(context,
+                   GetTensorsToSave(context, true, &filename, &tensors));
+
+    mutex_lock l(mu_);
+    // Holding at most one snapshot bounds the memory of async saves, and the
+    // incremental state is only updated once the previous save is written.
+    if (previous_write_) {
+      previous_write_->done.WaitForNotification();
+      // WaitForPendingSave reports the error.
+      if (!previous_write_->status.ok() && incremental_) incremental_->Reset();
+      previous_write_.reset();
+    }
+    if (incremental_) {
+      incremental_->Update(filename, &tensors);
+    } else {
+      for (TensorSliceToSave& tensor : tensors) {
+        tensor.data = tensor::DeepCopy(tensor.data);
+      }
+    }
+
+    if (!async_write_) {
+      const Status s = WriteTensorSlices(
+          filename, &checkpoint::CreateTableTensorSliceBuilder, tensors);
+      if (!s.ok()) incremental_->Reset();
+      OP_REQUIRES_OK(context, s);
+      return;
+    }
+    std::shared_ptr<Write> write = std::make_shared<Write>();
+    previous_write_ = write;
+    PendingSaves::Global()->Write(
+        filename, &checkpoint::CreateTableTensorSliceBuilder,
+        std::move(tensors), [write](const Status& s) {
+          write->status = s;
+          write->done.Notify();
+        });
   }
+
+ private:
+  // An async write, shared with its callback.
+  struct Write {
+    Notification done;
+    Status status;
+  };
+
+  bool async_write_;
+  std::unique_ptr<IncrementalSaveState> incremental_;
+
+  mutex mu_;
+  std::shared_ptr<Write> previous_write_ GUARDED_BY(mu_);
 };
 
 REGISTER_KERNEL_BUILDER(Name("SaveSlices").Device(DEVICE_CPU), SaveSlicesOp);
 
+class WaitForPendingSaveOp : public AsyncOpKernel {
+ public:
+  explicit WaitForPendingSaveOp(OpKernelConstruction* context)
+      : AsyncOpKernel(context) {}
+
+  void ComputeAsync(OpKernelContext* context, DoneCallback done) override {
+    const Tensor& filename = context->input(0);
+    OP_REQUIRES_ASYNC(
+        context, TensorShapeUtils::IsScalar(filename.shape()),
+        errors::InvalidArgument("filename must be a scalar, got shape ",
+                                filename.shape().DebugString()),
+        done);
+    PendingSaves::Global()->WhenWritten(filename.scalar<string>()(),
+                                        [context, done](const Status& s) {
+                                          context->SetStatus(s);
+                                          done();
+                                        });
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("WaitForPendingSave").Device(DEVICE_CPU),
+                        WaitForPendingSaveOp);
+
 class ShardedFilenameOp : public OpKernel {
  public:
   explicit ShardedFilenameOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
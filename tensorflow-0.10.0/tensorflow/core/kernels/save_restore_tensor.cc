@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <algorithm>
+#include <memory>
 #include <unordered_map>
 
 #include <vector>
@@ -20,16 +22,21 @@ limitations under the License.
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor_util.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/tensor_slice_reader.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
+#include "tensorflow/core/util/tensor_slice_util.h"
 #include "tensorflow/core/util/tensor_slice_writer.h"
 
 namespace tensorflow {
@@ -80,103 +87,470 @@ bool ParseShapeAndSlice(const string& shape_and_slice, TensorShape* shape,
   }
   return true;
 }
-}  // namespace
 
-void SaveTensors(
+bool IsFullSlice(const TensorSlice& slice) {
+  for (int d = 0; d < slice.dims(); ++d) {
+    if (!slice.IsFullAt(d)) return false;
+  }
+  return true;
+}
+
+// Keys the values that IncrementalSaveState keeps for a saved tensor.
+string IncrementalSaveKey(const string& name, const TensorSlice& slice) {
+  return strings::StrCat(name, ":", slice.DebugString());
+}
+
+// The name of the marker that an incremental save writes next to the rows of
+// tensor "name" to hold the name of its base file.  ':' does not appear in
+// op names, so it does not collide with the names of variables.
+string IncrementalBaseName(const string& name, const TensorSlice& slice) {
+  if (IsFullSlice(slice)) return strings::StrCat(name, ":incremental_base");
+  return strings::StrCat(name, ":incremental_base:", slice.DebugString());
+}
+
+// Returns rows [begin, end) of "values", the values of "tensor", to save as a
+// slice of their own.
+TensorSliceToSave RowsToSave(const TensorSliceToSave& tensor,
+                             const Tensor& values, int64 begin, int64 end) {
+  TensorSliceToSave rows;
+  rows.name = tensor.name;
+  rows.shape = tensor.shape;
+  rows.slice = tensor.slice;
+  const int64 start = tensor.slice.IsFullAt(0) ? 0 : tensor.slice.start(0);
+  rows.slice.set_start(0, start + begin);
+  rows.slice.set_length(0, end - begin);
+
+  TensorShape rows_shape(values.shape());
+  rows_shape.set_dim(0, end - begin);
+  rows.data = Tensor(values.dtype(), rows_shape);
+  const size_t row_bytes = values.tensor_data().size() / values.dim_size(0);
+  memcpy(const_cast<char*>(rows.data.tensor_data().data()),
+         values.tensor_data().data() + begin * row_bytes,
+         (end - begin) * row_bytes);
+  return rows;
+}
+
+// Bounds the chains of incremental checkpoints that restoring follows, in
+// case the files reference each other in a cycle.
+const int kMaxIncrementalChain = 1000;
+
+// Returns the reader of "file_pattern", from the cache of "context" if it
+// has one, or else in "allocated_reader".
+const checkpoint::TensorSliceReader* GetReader(
+    OpKernelContext* context, const string& file_pattern,
+    checkpoint::TensorSliceReader::OpenTableFunction open_func,
+    int preferred_shard,
+    std::unique_ptr<checkpoint::TensorSliceReader>* allocated_reader) {
+  const checkpoint::TensorSliceReader* reader =
+      context->slice_reader_cache()->GetReader(file_pattern, open_func,
+                                               preferred_shard);
+  if (!reader) {
+    allocated_reader->reset(new checkpoint::TensorSliceReader(
+        file_pattern, open_func, preferred_shard));
+    reader = allocated_reader->get();
+  }
+  return CHECK_NOTNULL(reader);
+}
+
+// Copies "slice" of the tensor "name" of shape "shape" from "reader" to "t".
+// If the tensor was saved incrementally, first copies the slice from the
+// base file, then the rows saved in "reader" over it.
+Status CopySavedSlice(
     OpKernelContext* context,
-    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
-    bool save_slices) {
+    checkpoint::TensorSliceReader::OpenTableFunction open_func,
+    int preferred_shard, const checkpoint::TensorSliceReader& reader,
+    const string& name, const TensorShape& shape, const TensorSlice& slice,
+    int depth, Tensor* t) {
+  string base;
+  const string marker = IncrementalBaseName(name, slice);
+  // The marker is in the same file as the rows, hence already loaded.
+  if (!reader.LoadedSlices(marker).empty() &&
+      !reader.CopySliceData(marker, TensorSlice(1), &base)) {
+    return errors::DataLoss("Could not read ", marker,
+                            " from checkpoint files ", reader.filepattern());
+  }
+
+  bool copied = false;
+  if (base.empty()) {
+#define READER_COPY(T)                                                  \
+  case DataTypeToEnum<T>::value:                                        \
+    copied = reader.CopySliceData(name, slice, t->flat<T>().data());    \
+    break;
+
+    switch (t->dtype()) {
+      TF_CALL_ALL_TYPES(READER_COPY)
+      TF_CALL_QUANTIZED_TYPES(READER_COPY)
+      default:
+        return errors::Unimplemented("Restoring data type ",
+                                     DataTypeString(t->dtype()),
+                                     " not yet supported");
+    }
+#undef READER_COPY
+    if (!copied) {
+      return errors::NotFound("Slice ", slice.DebugString(), " of tensor \"",
+                              name, "\" not found in checkpoint files ",
+                              reader.filepattern());
+    }
+    return Status::OK();
+  }
+
+  if (depth >= kMaxIncrementalChain) {
+    return errors::DataLoss("Checkpoint files ", reader.filepattern(),
+                            " have more than ", kMaxIncrementalChain,
+                            " incremental bases for tensor \"", name, "\"");
+  }
+  std::unique_ptr<checkpoint::TensorSliceReader> allocated_reader;
+  const checkpoint::TensorSliceReader* base_reader = GetReader(
+      context, base, open_func, preferred_shard, &allocated_reader);
+  TF_RETURN_IF_ERROR(base_reader->status());
+  DataType base_type;
+  TensorShape base_shape;
+  if (!base_reader->HasTensor(name, &base_shape, &base_type) ||
+      base_type != t->dtype() || !base_shape.IsSameSize(shape)) {
+    return errors::DataLoss("Checkpoint file ", base, ", the base of ",
+                            reader.filepattern(), ", does not have tensor \"",
+                            name, "\" of shape ", shape.DebugString());
+  }
+  TF_RETURN_IF_ERROR(CopySavedSlice(context, open_func, preferred_shard,
+                                    *base_reader, name, shape, slice,
+                                    depth + 1, t));
+
+  for (const TensorSlice& saved : reader.LoadedSlices(name)) {
+    TensorSlice overlap;
+    if (!saved.Intersect(slice, &overlap)) continue;
+    TensorShape saved_shape;
+    TF_RETURN_IF_ERROR(saved.SliceTensorShape(shape, &saved_shape));
+    Tensor rows(t->dtype(), saved_shape);
+
+#define READER_OVERLAY(T)                                                  \
+  case DataTypeToEnum<T>::value:                                           \
+    copied = reader.CopySliceData(name, saved, rows.flat<T>().data()) &&   \
+             CopyDataFromTensorSliceToTensorSlice(                         \
+                 shape, saved, slice, rows.flat<T>().data(),               \
+                 t->flat<T>().data());                                     \
+    break;
+
+    // Only the rows of POD tensors are saved incrementally.
+    switch (t->dtype()) {
+      TF_CALL_POD_TYPES(READER_OVERLAY)
+      TF_CALL_QUANTIZED_TYPES(READER_OVERLAY)
+      default:
+        copied = false;
+    }
+#undef READER_OVERLAY
+    if (!copied) {
+      return errors::DataLoss("Could not read slice ", saved.DebugString(),
+                              " of tensor \"", name,
+                              "\" from checkpoint files ",
+                              reader.filepattern());
+    }
+  }
+  return Status::OK();
+}
+
+// Checks that "reader" has a tensor "name" of type "type", and computes
+// from the "shape_and_slice" spec, empty for the whole tensor, the shape of
+// the output and the slice of the saved tensor to load.
+Status PrepareRestore(const checkpoint::TensorSliceReader& reader,
+                      const string& name, const string& shape_and_slice,
+                      DataType type, TensorShape* saved_shape,
+                      TensorSlice* slice_to_load, TensorShape* output_shape) {
+  DataType saved_type;
+  if (!reader.HasTensor(name, saved_shape, &saved_type)) {
+    return errors::NotFound("Tensor name \"", name,
+                            "\" not found in checkpoint files ",
+                            reader.filepattern());
+  }
+  if (saved_type != type) {
+    return errors::InvalidArgument(
+        "Expected to restore a tensor of type ", DataTypeString(type),
+        ", got a tensor of type ", DataTypeString(saved_type),
+        " instead: tensor_name = ", name);
+  }
+
+  *output_shape = *saved_shape;
+  *slice_to_load = TensorSlice(saved_shape->dims());
+  if (!shape_and_slice.empty()) {
+    TensorShape parsed_shape;
+    string error;
+    if (!ParseShapeAndSlice(shape_and_slice, &parsed_shape, slice_to_load,
+                            output_shape, &error)) {
+      return errors::InvalidArgument(error);
+    }
+    if (!parsed_shape.IsSameSize(*saved_shape)) {
+      return errors::InvalidArgument(
+          "Shape in shape_and_slice spec does not match the shape in the "
+          "save file: ",
+          parsed_shape.DebugString(), ", save file shape: ",
+          saved_shape->DebugString());
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace
+
+Status GetTensorsToSave(OpKernelContext* context, bool save_slices,
+                        string* filename,
+                        std::vector<TensorSliceToSave>* tensors) {
   const Tensor& filename_t = context->input(0);
   {
     const int64 size = filename_t.NumElements();
-    OP_REQUIRES(
-        context, size == 1,
-        errors::InvalidArgument(
-            "Input 0 (filename) must be a string scalar; got a tensor of ",
-            size, "elements"));
+    if (size != 1) {
+      return errors::InvalidArgument(
+          "Input 0 (filename) must be a string scalar; got a tensor of ", size,
+          "elements");
+    }
   }
 
   // Path, names, and slices if save_slices is true.
   const int kFixedInputs = save_slices ? 3 : 2;
   const Tensor& tensor_names_t = context->input(1);
-  OP_REQUIRES(context,
-              FastBoundsCheck(tensor_names_t.NumElements() + kFixedInputs,
-                              std::numeric_limits<int>::max()),
-              errors::InvalidArgument("Too many inputs to SaveTensors"));
+  if (!FastBoundsCheck(tensor_names_t.NumElements() + kFixedInputs,
+                       std::numeric_limits<int>::max())) {
+    return errors::InvalidArgument("Too many inputs to SaveTensors");
+  }
   const int N = static_cast<int>(tensor_names_t.NumElements());
   const string* tensor_shapes_and_slices_ptr = nullptr;
   if (save_slices) {
     const Tensor& tensor_shapes_and_slices_t = context->input(2);
-    OP_REQUIRES(
-        context,
-        tensor_shapes_and_slices_t.NumElements() == static_cast<int64>(N),
-        errors::InvalidArgument("Expected ", N,
-                                " elements for the tensor "
-                                "shapes and slices but got ",
-                                tensor_shapes_and_slices_t.NumElements()));
+    if (tensor_shapes_and_slices_t.NumElements() != static_cast<int64>(N)) {
+      return errors::InvalidArgument("Expected ", N,
+                                     " elements for the tensor "
+                                     "shapes and slices but got ",
+                                     tensor_shapes_and_slices_t.NumElements());
+    }
     tensor_shapes_and_slices_ptr =
         tensor_shapes_and_slices_t.flat<string>().data();
   }
-  OP_REQUIRES(context, context->num_inputs() == N + kFixedInputs,
-              errors::InvalidArgument("Expected totally ", N + kFixedInputs,
-                                      " inputs as input #1 (which is a string "
-                                      "tensor of saved names) contains ",
-                                      N, " names, but received ",
-                                      context->num_inputs(), " inputs"));
-
-  VLOG(1) << "About to save tensors to file " << filename_t.flat<string>()(0)
-          << "...";
-  checkpoint::TensorSliceWriter writer(filename_t.flat<string>()(0),
-                                       builder_func);
+  if (context->num_inputs() != N + kFixedInputs) {
+    return errors::InvalidArgument("Expected totally ", N + kFixedInputs,
+                                   " inputs as input #1 (which is a string "
+                                   "tensor of saved names) contains ",
+                                   N, " names, but received ",
+                                   context->num_inputs(), " inputs");
+  }
 
-  Status s;
+  *filename = filename_t.flat<string>()(0);
   auto tensor_names_flat = tensor_names_t.flat<string>();
-
+  tensors->clear();
+  tensors->reserve(N);
   string error;
   for (int i = 0; i < N; ++i) {
-    const string& name = tensor_names_flat(i);
     const Tensor& input = context->input(i + kFixedInputs);
-    TensorShape shape(input.shape());
-    TensorSlice slice(input.dims());
+    TensorSliceToSave tensor;
+    tensor.name = tensor_names_flat(i);
+    tensor.shape = input.shape();
+    tensor.slice = TensorSlice(input.dims());
+    tensor.data = input;
     if (save_slices && !tensor_shapes_and_slices_ptr[i].empty()) {
       const string& shape_spec = tensor_shapes_and_slices_ptr[i];
       TensorShape slice_shape;
-      OP_REQUIRES(context, ParseShapeAndSlice(shape_spec, &shape, &slice,
-                                              &slice_shape, &error),
-                  errors::InvalidArgument(error));
-      OP_REQUIRES(context, slice_shape.IsSameSize(input.shape()),
-                  errors::InvalidArgument("Slice in shape_and_slice "
-                                          "specification does not match the "
-                                          "shape of the tensor to  save: ",
-                                          shape_spec, ", tensor: ",
-                                          input.shape().DebugString()));
+      if (!ParseShapeAndSlice(shape_spec, &tensor.shape, &tensor.slice,
+                              &slice_shape, &error)) {
+        return errors::InvalidArgument(error);
+      }
+      if (!slice_shape.IsSameSize(input.shape())) {
+        return errors::InvalidArgument(
+            "Slice in shape_and_slice "
+            "specification does not match the "
+            "shape of the tensor to  save: ",
+            shape_spec, ", tensor: ", input.shape().DebugString());
+      }
     }
+    tensors->push_back(std::move(tensor));
+  }
+  return Status::OK();
+}
+
+Status WriteTensorSlices(
+    const string& filename,
+    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
+    const std::vector<TensorSliceToSave>& tensors) {
+  VLOG(1) << "About to save tensors to file " << filename << "...";
+  checkpoint::TensorSliceWriter writer(filename, builder_func);
 
-#define WRITER_ADD(T)                                           \
-  case DataTypeToEnum<T>::value:                                \
-    s = writer.Add(name, shape, slice, input.flat<T>().data()); \
+  Status s;
+  for (const TensorSliceToSave& tensor : tensors) {
+#define WRITER_ADD(T)                                        \
+  case DataTypeToEnum<T>::value:                             \
+    s = writer.Add(tensor.name, tensor.shape, tensor.slice,  \
+                   tensor.data.flat<T>().data());            \
     break;
 
-    switch (input.dtype()) {
+    switch (tensor.data.dtype()) {
       TF_CALL_ALL_TYPES(WRITER_ADD)
       TF_CALL_QUANTIZED_TYPES(WRITER_ADD)
       default:
-        context->SetStatus(errors::Unimplemented("Saving data type ",
-                                                 DataTypeString(input.dtype()),
-                                                 " not yet supported"));
-        return;
+        return errors::Unimplemented("Saving data type ",
+                                     DataTypeString(tensor.data.dtype()),
+                                     " not yet supported");
     }
 #undef WRITER_ADD
+    TF_RETURN_IF_ERROR(s);
+  }
+
+  return writer.Finish();
+}
+
+void SaveTensors(
+    OpKernelContext* context,
+    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
+    bool save_slices) {
+  string filename;
+  std::vector<TensorSliceToSave> tensors;
+  OP_REQUIRES_OK(context,
+                 GetTensorsToSave(context, save_slices, &filename, &tensors));
+  OP_REQUIRES_OK(context, WriteTensorSlices(filename, builder_func, tensors));
+}
+
+void IncrementalSaveState::Update(const string& filename,
+                                  std::vector<TensorSliceToSave>* tensors) {
+  const bool overwrites_chain =
+      std::find(chain_.begin(), chain_.end(), filename) != chain_.end();
+  const bool full = chain_.empty() || overwrites_chain ||
+                    chain_.size() > static_cast<size_t>(max_incremental_saves_);
+  if (full) {
+    chain_.clear();
+    saved_.clear();
+  }
+  const string base = chain_.empty() ? "" : chain_.back();
+  chain_.push_back(filename);
+
+  std::vector<TensorSliceToSave> result;
+  for (TensorSliceToSave& tensor : *tensors) {
+    const Tensor& input = tensor.data;
+    const bool by_rows = DataTypeCanUseMemcpy(input.dtype()) &&
+                         input.dims() >= 1 && input.dim_size(0) > 0;
+    if (!by_rows) {
+      // Written in full, from a copy.
+      tensor.data = tensor::DeepCopy(input);
+      result.push_back(std::move(tensor));
+      continue;
+    }
+    const string key = IncrementalSaveKey(tensor.name, tensor.slice);
+    auto it = saved_.find(key);
+    if (base.empty() || it == saved_.end() ||
+        it->second.dtype() != input.dtype() ||
+        !it->second.shape().IsSameSize(input.shape())) {
+      // Written in full, from the copy that the next save compares with.
+      Tensor& saved = saved_[key];
+      saved = tensor::DeepCopy(input);
+      tensor.data = saved;
+      result.push_back(std::move(tensor));
+      continue;
+    }
+
+    // Writes the runs of changed rows, and updates the saved values.
+    Tensor& saved = it->second;
+    const int64 rows = input.dim_size(0);
+    const size_t row_bytes = input.tensor_data().size() / rows;
+    const char* input_data = input.tensor_data().data();
+    char* saved_data = const_cast<char*>(saved.tensor_data().data());
+    int64 runs = 0;
+    for (int64 begin = 0; begin < rows;) {
+      const char* input_row = input_data + begin * row_bytes;
+      char* saved_row = saved_data + begin * row_bytes;
+      if (memcmp(input_row, saved_row, row_bytes) == 0) {
+        ++begin;
+        continue;
+      }
+      int64 end = begin + 1;
+      while (end < rows && memcmp(input_data + end * row_bytes,
+                                  saved_data + end * row_bytes,
+                                  row_bytes) != 0) {
+        ++end;
+      }
+      memcpy(saved_row, input_row, (end - begin) * row_bytes);
+      result.push_back(RowsToSave(tensor, saved, begin, end));
+      ++runs;
+      begin = end;
+    }
+    if (runs == 0) {
+      // Keeps the tensor in the file, so that restoring finds its shape.
+      result.push_back(RowsToSave(tensor, saved, 0, 1));
+    }
+
+    TensorSliceToSave marker;
+    marker.name = IncrementalBaseName(tensor.name, tensor.slice);
+    marker.shape = TensorShape({1});
+    marker.slice = TensorSlice(1);
+    marker.data = Tensor(DT_STRING, marker.shape);
+    marker.data.flat<string>()(0) = base;
+    result.push_back(std::move(marker));
+  }
+  tensors->swap(result);
+}
+
+void IncrementalSaveState::Reset() {
+  chain_.clear();
+  saved_.clear();
+}
+
+PendingSaves* PendingSaves::Global() {
+  static PendingSaves* pending_saves = new PendingSaves;
+  return pending_saves;
+}
+
+PendingSaves::PendingSaves() : thread_(Env::Default(), "async_save", 1) {}
+
+void PendingSaves::Write(
+    const string& filename,
+    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
+    std::vector<TensorSliceToSave> tensors, Callback done) {
+  {
+    mutex_lock l(mu_);
+    ++files_[filename].pending;
+  }
+  // The closure owns the tensors until they are written.
+  auto shared_tensors =
+      std::make_shared<std::vector<TensorSliceToSave>>(std::move(tensors));
+  thread_.Schedule([this, filename, builder_func, shared_tensors, done]() {
+    const Status s = WriteTensorSlices(filename, builder_func, *shared_tensors);
     if (!s.ok()) {
-      context->SetStatus(s);
+      LOG(ERROR) << "Could not write checkpoint " << filename << ": " << s;
+    }
+    done(s);
+    Finish(filename, s);
+  });
+}
+
+void PendingSaves::Finish(const string& filename, const Status& status) {
+  std::vector<Callback> waiters;
+  Status file_status;
+  {
+    mutex_lock l(mu_);
+    File& file = files_[filename];
+    file.status.Update(status);
+    if (--file.pending > 0) return;
+    if (file.waiters.empty() && !file.status.ok()) {
+      // Kept for the next WhenWritten().
       return;
     }
+    waiters.swap(file.waiters);
+    file_status = file.status;
+    files_.erase(filename);
+  }
+  for (const Callback& waiter : waiters) {
+    waiter(file_status);
   }
+}
 
-  s = writer.Finish();
-  if (!s.ok()) {
-    context->SetStatus(s);
+void PendingSaves::WhenWritten(const string& filename, Callback done) {
+  Status status;
+  {
+    mutex_lock l(mu_);
+    auto it = files_.find(filename);
+    if (it != files_.end()) {
+      if (it->second.pending > 0) {
+        it->second.waiters.push_back(std::move(done));
+        return;
+      }
+      status = it->second.status;
+      files_.erase(it);
+    }
   }
+  done(status);
 }
 
 void RestoreTensor(OpKernelContext* context,
@@ -204,7 +578,7 @@ void RestoreTensor(OpKernelContext* context,
   }
   const string& tensor_name = tensor_name_t.flat<string>()(0);
 
-  const string* tensor_shape_and_slice_ptr = nullptr;
+  string shape_and_slice;
   if (restore_slice) {
     const Tensor& tensor_shape_and_slice_t = context->input(2);
     OP_REQUIRES(
@@ -212,72 +586,106 @@ void RestoreTensor(OpKernelContext* context,
         errors::InvalidArgument("Expected 1 element for the tensor "
                                 "shape and slice but got ",
                                 tensor_shape_and_slice_t.NumElements()));
-    tensor_shape_and_slice_ptr = tensor_shape_and_slice_t.flat<string>().data();
+    shape_and_slice = tensor_shape_and_slice_t.flat<string>()(0);
   }
 
   // If we cannot find a cached reader we will allocate our own.
   std::unique_ptr<checkpoint::TensorSliceReader> allocated_reader;
+  const checkpoint::TensorSliceReader* reader = GetReader(
+      context, file_pattern, open_func, preferred_shard, &allocated_reader);
+  OP_REQUIRES_OK(context, reader->status());
 
-  const checkpoint::TensorSliceReader* reader =
-      context->slice_reader_cache()->GetReader(file_pattern, open_func,
-                                               preferred_shard);
-  if (!reader) {
-    allocated_reader.reset(new checkpoint::TensorSliceReader(
-        file_pattern, open_func, preferred_shard));
-    reader = allocated_reader.get();
-  }
-  OP_REQUIRES_OK(context, CHECK_NOTNULL(reader)->status());
-
-  // Get the shape and type from the save file.
-  DataType type;
   TensorShape saved_shape;
-  OP_REQUIRES(
-      context, reader->HasTensor(tensor_name, &saved_shape, &type),
-      errors::NotFound("Tensor name \"", tensor_name,
-                       "\" not found in checkpoint files ", file_pattern));
-  OP_REQUIRES(
-      context, type == context->expected_output_dtype(0),
-      errors::InvalidArgument("Expected to restore a tensor of type ",
-                              DataTypeString(context->expected_output_dtype(0)),
-                              ", got a tensor of type ", DataTypeString(type),
-                              " instead: tensor_name = ", tensor_name));
-
-  // Shape of the output and slice to load.
-  TensorShape output_shape(saved_shape);
-  TensorSlice slice_to_load(saved_shape.dims());
-  if (restore_slice && !tensor_shape_and_slice_ptr[0].empty()) {
-    const string& shape_spec = tensor_shape_and_slice_ptr[0];
-    TensorShape parsed_shape;
-    string error;
-    OP_REQUIRES(context,
-                ParseShapeAndSlice(shape_spec, &parsed_shape, &slice_to_load,
-                                   &output_shape, &error),
-                errors::InvalidArgument(error));
-    OP_REQUIRES(
-        context, parsed_shape.IsSameSize(saved_shape),
-        errors::InvalidArgument(
-            "Shape in shape_and_slice spec does not match the shape in the "
-            "save file: ",
-            parsed_shape.DebugString(), ", save file shape: ",
-            saved_shape.DebugString()));
-  }
+  TensorSlice slice_to_load;
+  TensorShape output_shape;
+  OP_REQUIRES_OK(context,
+                 PrepareRestore(*reader, tensor_name, shape_and_slice,
+                                context->expected_output_dtype(0),
+                                &saved_shape, &slice_to_load, &output_shape));
 
   Tensor* t = nullptr;
   OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &t));
 
-#define READER_COPY(T)                                                      \
-  case DataTypeToEnum<T>::value:                                            \
-    reader->CopySliceData(tensor_name, slice_to_load, t->flat<T>().data()); \
-    break;
+  OP_REQUIRES_OK(context, CopySavedSlice(context, open_func, preferred_shard,
+                                         *reader, tensor_name, saved_shape,
+                                         slice_to_load, 0, t));
+}
+
+void RestoreTensors(OpKernelContext* context,
+                    checkpoint::TensorSliceReader::OpenTableFunction open_func,
+                    int preferred_shard) {
+  const Tensor& file_pattern_t = context->input(0);
+  OP_REQUIRES(
+      context, file_pattern_t.NumElements() == 1,
+      errors::InvalidArgument(
+          "Input 0 (file_pattern) must be a string scalar; got a tensor of ",
+          file_pattern_t.NumElements(), " elements"));
+  const string& file_pattern = file_pattern_t.flat<string>()(0);
 
-  switch (type) {
-    TF_CALL_ALL_TYPES(READER_COPY)
-    TF_CALL_QUANTIZED_TYPES(READER_COPY)
-    default:
-      context->SetStatus(errors::Unimplemented(
-          "Restoring data type ", DataTypeString(type), " not yet supported"));
+  const int num_tensors = context->num_outputs();
+  const Tensor& tensor_names_t = context->input(1);
+  const Tensor& shapes_and_slices_t = context->input(2);
+  OP_REQUIRES(context, tensor_names_t.NumElements() == num_tensors,
+              errors::InvalidArgument("Expected ", num_tensors,
+                                      " tensor names, got ",
+                                      tensor_names_t.NumElements()));
+  OP_REQUIRES(context, shapes_and_slices_t.NumElements() == num_tensors,
+              errors::InvalidArgument("Expected ", num_tensors,
+                                      " shapes and slices, got ",
+                                      shapes_and_slices_t.NumElements()));
+  auto tensor_names = tensor_names_t.flat<string>();
+  auto shapes_and_slices = shapes_and_slices_t.flat<string>();
+
+  std::unique_ptr<checkpoint::TensorSliceReader> allocated_reader;
+  const checkpoint::TensorSliceReader* reader = GetReader(
+      context, file_pattern, open_func, preferred_shard, &allocated_reader);
+  OP_REQUIRES_OK(context, reader->status());
+
+  // The first lookup that misses the preferred shard opens the others, in
+  // parallel.  Allocates all the outputs before copying any data, as
+  // allocate_output() is not thread-safe.
+  std::vector<TensorShape> saved_shapes(num_tensors);
+  std::vector<TensorSlice> slices(num_tensors);
+  std::vector<Tensor*> outputs(num_tensors);
+  for (int i = 0; i < num_tensors; ++i) {
+    TensorShape output_shape;
+    OP_REQUIRES_OK(
+        context, PrepareRestore(*reader, tensor_names(i), shapes_and_slices(i),
+                                context->expected_output_dtype(i),
+                                &saved_shapes[i], &slices[i], &output_shape));
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(i, output_shape, &outputs[i]));
+  }
+
+  // Each tensor is read and decoded on its own worker thread, largest first
+  // so that a big one does not start last.
+  std::vector<int> order(num_tensors);
+  for (int i = 0; i < num_tensors; ++i) order[i] = i;
+  std::sort(order.begin(), order.end(), [&outputs](int a, int b) {
+    return outputs[a]->NumElements() > outputs[b]->NumElements();
+  });
+  std::vector<Status> statuses(num_tensors);
+  auto copy = [&](int i) {
+    statuses[i] =
+        CopySavedSlice(context, open_func, preferred_shard, *reader,
+                       tensor_names(i), saved_shapes[i], slices[i], 0,
+                       outputs[i]);
+  };
+  thread::ThreadPool* workers =
+      context->device()->tensorflow_cpu_worker_threads()->workers;
+  BlockingCounter counter(num_tensors - 1);
+  for (int k = 1; k < num_tensors; ++k) {
+    const int i = order[k];
+    workers->Schedule([&copy, &counter, i]() {
+      copy(i);
+      counter.DecrementCount();
+    });
+  }
+  copy(order[0]);
+  counter.Wait();
+  for (const Status& s : statuses) {
+    OP_REQUIRES_OK(context, s);
   }
-#undef READER_COPY
 }
 
 }  // namespace tensorflow
@@ -16,6 +16,19 @@ limitations under the License.
 #ifndef TENSORFLOW_KERNELS_SAVE_RESTORE_TENSOR_H_
 #define TENSORFLOW_KERNELS_SAVE_RESTORE_TENSOR_H_
 
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_slice.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/tensor_slice_reader.h"
 #include "tensorflow/core/util/tensor_slice_writer.h"
 
@@ -23,6 +36,14 @@ namespace tensorflow {
 
 class OpKernelContext;
 
+// A tensor, or a slice of a larger tensor, to write to a checkpoint.
+struct TensorSliceToSave {
+  string name;
+  TensorShape shape;  // The shape of the whole tensor.
+  TensorSlice slice;
+  Tensor data;  // The values of "slice".
+};
+
 // Save input tensors in *context to a writer built from builder_func().
 // context must have the following inputs:
 //  0: a single element string tensor that contains the file name.
@@ -35,9 +56,91 @@ void SaveTensors(
     checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
     bool save_slices);
 
+// The two halves of SaveTensors(): reads the file name and the tensors to
+// save from the inputs of *context, then writes them.  The "data" of the
+// tensors shares the buffers of the inputs.
+Status GetTensorsToSave(OpKernelContext* context, bool save_slices,
+                        string* filename,
+                        std::vector<TensorSliceToSave>* tensors);
+Status WriteTensorSlices(
+    const string& filename,
+    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
+    const std::vector<TensorSliceToSave>& tensors);
+
+// Makes the successive saves of a save op incremental.  A numeric tensor of
+// rank 1 or more that was in the previous save with the same shape is
+// written as the rows that changed since then, i.e. as slices along its
+// 0th dimension, plus a marker holding the name of the previous file.
+// RestoreTensor() reads the other rows from that file, recursively.
+//
+// After "max_incremental_saves" incremental saves, the next save is full,
+// which bounds the chain of files that restoring reads.  So is a save to a
+// file of the current chain, which would overwrite a base.
+//
+// Keeps a copy of every saved tensor.  Not thread-safe.
+class IncrementalSaveState {
+ public:
+  explicit IncrementalSaveState(int max_incremental_saves)
+      : max_incremental_saves_(max_incremental_saves) {}
+
+  // Replaces the "tensors" to write to "filename" with what this save
+  // writes.  The new "data" does not share the buffers of the inputs; it
+  // must not be used after the next call.
+  void Update(const string& filename, std::vector<TensorSliceToSave>* tensors);
+
+  // Makes the next save full, e.g. because this one failed to write.
+  void Reset();
+
+ private:
+  const int max_incremental_saves_;
+  // The files written since the last full save, starting with it.
+  std::vector<string> chain_;
+  // The saved values of each tensor, keyed by name and slice.
+  std::unordered_map<string, Tensor> saved_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(IncrementalSaveState);
+};
+
+// Writes the checkpoints of async save ops in the background, one at a time,
+// and lets others wait until a file is written.
+class PendingSaves {
+ public:
+  typedef std::function<void(const Status&)> Callback;
+
+  static PendingSaves* Global();
+
+  // Schedules writing "tensors" to "filename", and calls "done" with the
+  // status of the write.
+  void Write(const string& filename,
+             checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
+             std::vector<TensorSliceToSave> tensors, Callback done);
+
+  // Calls "done" once the scheduled writes of "filename" have finished, with
+  // the first error of those that failed since the previous call for it.
+  void WhenWritten(const string& filename, Callback done);
+
+ private:
+  struct File {
+    int pending = 0;
+    Status status;
+    std::vector<Callback> waiters;
+  };
+
+  PendingSaves();
+
+  void Finish(const string& filename, const Status& status);
+
+  mutex mu_;
+  std::unordered_map<string, File> files_ GUARDED_BY(mu_);
+  thread::ThreadPool thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PendingSaves);
+};
+
 // Reads a tensor from the reader built from open_func() and produces it as
 // context->output(0).  "preferred_shard" is the same the TensorSliceReader
-// preferred_shard parameter.
+// preferred_shard parameter.  Tensors saved incrementally are completed from
+// their base files.
 //
 // context must have the following inputs:
 //  0: a single element string tensor that contains the file name.
@@ -48,6 +151,19 @@ void RestoreTensor(OpKernelContext* context,
                    checkpoint::TensorSliceReader::OpenTableFunction open_func,
                    int preferred_shard, bool restore_slice);
 
+// Reads several tensors from files with the given pattern, like
+// RestoreTensor() for each of them, but opening the files once and reading
+// the tensors in parallel on the worker threads of the device.
+//
+// Reads from the inputs of "context":
+//  0: the file pattern;
+//  1: the names of the tensors, one per output;
+//  2: the shape and slice specification of each tensor, or an empty string
+//     for the whole tensor.
+void RestoreTensors(OpKernelContext* context,
+                    checkpoint::TensorSliceReader::OpenTableFunction open_func,
+                    int preferred_shard);
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_KERNELS_SAVE_RESTORE_TENSOR_H_
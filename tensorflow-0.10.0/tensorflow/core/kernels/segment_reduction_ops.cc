@@ -17,6 +17,7 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <vector>
 #include "third_party/eigen3/Eigen/Core"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
@@ -30,6 +31,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -217,6 +219,12 @@ REGISTER_COMPLEX_CPU_KERNELS_ALL(complex128);
 
 // Similar to SegmentReductionOp but can handle unsorted segment definitions and
 // specifying size of output.
+//
+// Large inputs are summed in parallel: the input rows are bucketed by segment
+// with a counting sort, and the output segments are sharded over the worker
+// threads, each summing the rows of its own segments, so that no two threads
+// write the same output row. The rows of a segment are added in input order
+// either way, so the result does not depend on the number of threads.
 template <typename Device, class T, class Index>
 class UnsortedSegmentSumOp : public OpKernel {
  public:
@@ -258,18 +266,56 @@ class UnsortedSegmentSumOp : public OpKernel {
     auto output_flat = output->flat_outer_dims<T>();
     output_flat.setZero();
 
-    if (data.NumElements() > 0) {
-      auto data_flat = data.shaped<T, 2>({N, data.NumElements() / N});
+    if (data.NumElements() == 0) return;
+    const int64 row_size = data.NumElements() / N;
+    auto data_flat = data.shaped<T, 2>({N, row_size});
+    std::vector<Index> segments(N);
+    for (int64 i = 0; i < N; ++i) {
+      segments[i] = internal::SubtleMustCopy(segment_flat(i));
+      OP_REQUIRES(context, FastBoundsCheck(segments[i], output_rows),
+                  errors::InvalidArgument(
+                      "segment_ids", SliceDebugString(segment_ids.shape(), i),
+                      " = ", segments[i], " is out of range [0, ", output_rows,
+                      ")"));
+    }
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    if (worker_threads.num_threads <= 1 ||
+        N * row_size < kMinParallelElements) {
       for (int64 i = 0; i < N; ++i) {
-        Index j = internal::SubtleMustCopy(segment_flat(i));
-        OP_REQUIRES(context, FastBoundsCheck(j, output_rows),
-                    errors::InvalidArgument(
-                        "segment_ids", SliceDebugString(segment_ids.shape(), i),
-                        " = ", j, " is out of range [0, ", output_rows, ")"));
-        output_flat.template chip<0>(j) += data_flat.template chip<0>(i);
+        output_flat.template chip<0>(segments[i]) +=
+            data_flat.template chip<0>(i);
       }
+      return;
     }
+
+    // Rows of segment j are order[begins[j]] to order[begins[j + 1] - 1].
+    std::vector<int64> begins(output_rows + 1, 0);
+    for (int64 i = 0; i < N; ++i) ++begins[segments[i] + 1];
+    for (Index j = 0; j < output_rows; ++j) begins[j + 1] += begins[j];
+    std::vector<int64> order(N);
+    std::vector<int64> next(begins.begin(), begins.end() - 1);
+    for (int64 i = 0; i < N; ++i) order[next[segments[i]]++] = i;
+
+    const int64 cost_per_segment =
+        std::max<int64>(1, N / std::max<Index>(output_rows, 1)) * row_size;
+    Shard(worker_threads.num_threads, worker_threads.workers, output_rows,
+          cost_per_segment,
+          [&begins, &order, &data_flat, &output_flat](int64 start,
+                                                      int64 limit) {
+            for (int64 j = start; j < limit; ++j) {
+              for (int64 k = begins[j]; k < begins[j + 1]; ++k) {
+                output_flat.template chip<0>(j) +=
+                    data_flat.template chip<0>(order[k]);
+              }
+            }
+          });
   }
+
+ private:
+  // Number of input elements below which rows are summed in the calling
+  // thread, since bucketing them would cost more than it saves.
+  static const int64 kMinParallelElements = 32768;
 };
 
 #define REGISTER_CPU_UNSORTED_KERNELS(type, index_type)                \
@@ -17,6 +17,8 @@ limitations under the License.
 #define TENSORFLOW_KERNELS_TENSOR_ARRAY_H_
 
 #include <limits.h>
+#include <algorithm>
+#include <type_traits>
 #include <vector>
 
 #include "tensorflow/core/framework/register_types.h"
@@ -108,6 +110,11 @@ TF_CALL_GPU_NUMBER_TYPES(TENSOR_ARRAY_SET_ZERO_GPU);
 //     All operations on a TensorArray are thread-safe.
 //   * A TensorArray may be preemptively closed, which releases all
 //     memory associated with it.
+//   * A TensorArray with a capacity copies the first 'capacity' elements
+//     written on the CPU into one buffer, allocated on the first write, so
+//     that packing or concatenating them returns the buffer without a copy.
+//     Elements whose shape differs from the first one written are kept
+//     apart as usual.
 //
 // These properties together allow the TensorArray to work as a
 // functional object and makes gradient computation easy.  For
@@ -130,9 +137,10 @@ class TensorArray : public ResourceBase {
   // 'N' elements.  While the underlying storage is a std::vector and
   // can hold more than MAX_INT entries, in practice we do not expect
   // users to construct this many Tensors for storage in a TensorArray.
+  // A positive 'capacity' preallocates a buffer for that many elements.
   TensorArray(const DataType& dtype, const Tensor& handle, int32 N,
               bool dynamic_size, bool multiple_writes_aggregate, bool is_grad,
-              int32 marked_size, bool clear_after_read)
+              int32 marked_size, bool clear_after_read, int32 capacity)
       : dtype_(dtype),
         handle_(handle),
         closed_(false),
@@ -142,7 +150,10 @@ class TensorArray : public ResourceBase {
         clear_after_read_(clear_after_read),
         is_grad_(is_grad),
         marked_size_(marked_size),
-        tensors_(N) {}
+        capacity_(capacity),
+        tensors_(N) {
+    if (dynamic_size_ && capacity_ > N) tensors_.reserve(capacity_);
+  }
 
   // Write PersistentTensor 'value' to index 'index'.
   //
@@ -226,6 +237,30 @@ class TensorArray : public ResourceBase {
     return Status::OK();
   }
 
+  // Like ReadMany, and if all the elements read are held by the buffer
+  // preallocated for the capacity, also sets '*buffered' to the part of the
+  // buffer holding them: a vector of their values one after another.
+  // Otherwise '*buffered' is left uninitialized.
+  template <typename Device, typename T>
+  Status ReadManyBuffered(OpKernelContext* ctx,
+                          std::vector<PersistentTensor>* values, int32 size,
+                          Tensor* buffered) {
+    mutex_lock l(mu_);
+    values->clear();
+    values->resize(size);
+    for (std::size_t i = 0; i < size; ++i) {
+      Status s = LockedRead<Device, T>(ctx, i, &(*values)[i]);
+      if (!s.ok()) return s;
+    }
+    if (!buffer_.IsInitialized() || size > capacity_) return Status::OK();
+    for (std::size_t i = 0; i < size; ++i) {
+      if (!tensors_[i].buffered) return Status::OK();
+    }
+    *buffered = buffer_.AccessTensor(ctx)->Slice(
+        0, size * buffer_element_shape_.num_elements());
+    return Status::OK();
+  }
+
   DataType ElemType() const { return dtype_; }
 
   string DebugString() override {
@@ -303,6 +338,7 @@ class TensorArray : public ResourceBase {
   void ClearAndMarkClosed() {
     mutex_lock l(mu_);
     tensors_.clear();
+    buffer_ = PersistentTensor();
     closed_ = true;
   }
 
@@ -322,6 +358,14 @@ class TensorArray : public ResourceBase {
   Status LockedRead(OpKernelContext* ctx, const int32 index,
                     PersistentTensor* value) EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  // Copies the first write of 'value' to 'index' into the buffer
+  // preallocated for the capacity and sets '*buffered' to the copy, if the
+  // buffer can hold it.  Otherwise leaves '*buffered' uninitialized.
+  template <typename Device, typename T>
+  Status LockedWriteToBuffer(OpKernelContext* ctx, const int32 index,
+                             const Tensor& value, PersistentTensor* buffered)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
   Status LockedReturnIfClosed() const EXCLUSIVE_LOCKS_REQUIRED(mu_) {
     if (closed_) {
       return errors::InvalidArgument("TensorArray ", handle_.vec<string>()(1),
@@ -360,12 +404,24 @@ class TensorArray : public ResourceBase {
   // -1 if there has been no unpack or split performed on the TensorArray.
   int32 marked_size_;
 
+  // The number of elements held by buffer_, or 0 for no buffer.
+  const int32 capacity_;
+
+  // A vector of capacity_ elements of buffer_element_shape_, allocated on
+  // the first write.
+  PersistentTensor buffer_ GUARDED_BY(mu_);
+  TensorShape buffer_element_shape_ GUARDED_BY(mu_);
+
   // TensorAndState is used to keep track of the PersistentTensors
   // stored in the TensorArray, along with their shapes, and a boolean
   // that determines whether they have already been read or not.
   struct TensorAndState {
     TensorAndState()
-        : written(false), read(false), cleared(false), local_copy(false) {}
+        : written(false),
+          read(false),
+          cleared(false),
+          local_copy(false),
+          buffered(false) {}
     PersistentTensor tensor;
     TensorShape shape;
     bool written;  // True if a Tensor has been written to the index.
@@ -380,6 +436,10 @@ class TensorArray : public ResourceBase {
     // aggregated value.  This flag marks that such a Tensor is being
     // used.  All future writes will aggregate to the existing local Tensor.
     bool local_copy;
+
+    // True if the Tensor is a view of the buffer preallocated for the
+    // capacity.
+    bool buffered;
   };
   // The list of underlying PersistentTensors and states.
   std::vector<TensorAndState> tensors_ GUARDED_BY(mu_);
@@ -471,13 +531,52 @@ Status TensorArray::LockedWriteOrAggregate(OpKernelContext* ctx,
     // TensorArray.
     gradients_disallowed_ = true;
   } else {
-    t.tensor = *value;
+    PersistentTensor buffered;
+    Status s =
+        LockedWriteToBuffer<Device, T>(ctx, index, *value_t, &buffered);
+    TF_RETURN_IF_ERROR(s);
+    t.buffered = buffered.IsInitialized();
+    t.tensor = t.buffered ? buffered : *value;
     t.shape = value_t->shape();
     t.written = true;
   }
   return Status::OK();
 }
 
+template <typename Device, typename T>
+Status TensorArray::LockedWriteToBuffer(OpKernelContext* ctx,
+                                        const int32 index, const Tensor& value,
+                                        PersistentTensor* buffered) {
+  // The buffer is filled by host memory copies, and aggregated writes
+  // replace their Tensors.
+  if (index >= capacity_ || multiple_writes_aggregate_ ||
+      !std::is_same<Device, CPUDevice>::value ||
+      !DataTypeCanUseMemcpy(dtype_) || value.NumElements() == 0) {
+    return Status::OK();
+  }
+  if (!buffer_.IsInitialized()) {
+    Tensor* buffer_t;
+    TF_RETURN_IF_ERROR(ctx->allocate_persistent(
+        dtype_, TensorShape({capacity_ * value.NumElements()}), &buffer_,
+        &buffer_t));
+    buffer_element_shape_ = value.shape();
+  } else if (value.shape() != buffer_element_shape_) {
+    return Status::OK();
+  }
+  const int64 num_elements = value.NumElements();
+  Tensor slot =
+      buffer_.AccessTensor(ctx)->Slice(index * num_elements,
+                                       (index + 1) * num_elements);
+  // Views that start at an unaligned offset could not be read as Eigen
+  // tensors.
+  if (!slot.IsAligned()) return Status::OK();
+  Tensor element;
+  CHECK(element.CopyFrom(slot, value.shape()));
+  std::copy_n(value.flat<T>().data(), num_elements, element.flat<T>().data());
+  *buffered = PersistentTensor(element);
+  return Status::OK();
+}
+
 template <typename Device, typename T>
 Status TensorArray::LockedRead(OpKernelContext* ctx, const int32 index,
                                PersistentTensor* value) {
@@ -131,6 +131,11 @@ class TensorArrayOp : public TensorArrayCreationOp {
     OP_REQUIRES_OK(context,
                    context->GetAttr("tensor_array_name", &tensor_array_name_));
     if (tensor_array_name_ == "") tensor_array_name_ = name();
+    OP_REQUIRES_OK(context, context->GetAttr("capacity", &capacity_));
+    OP_REQUIRES(context, capacity_ >= 0,
+                errors::InvalidArgument("TensorArray capacity must be >= 0, "
+                                        "but is ",
+                                        capacity_));
   }
 
   Status CreateTensorArray(OpKernelContext* ctx, ResourceMgr* rm,
@@ -156,7 +161,7 @@ class TensorArrayOp : public TensorArrayCreationOp {
     TensorArray* tensor_array = new TensorArray(
         dtype_, *tensor_array_output_handle, size, dynamic_size_,
         false /* multiple_writes_aggregate */, false /* is_grad */,
-        -1 /* marked_size */, clear_after_read_);
+        -1 /* marked_size */, clear_after_read_, capacity_);
 
     TF_RETURN_IF_ERROR(
         rm->Create(handle(0), unique_tensor_array_name, tensor_array));
@@ -171,6 +176,7 @@ class TensorArrayOp : public TensorArrayCreationOp {
   bool dynamic_size_;
   bool clear_after_read_;
   string tensor_array_name_;  // The name used to create the TensorArray.
+  int32 capacity_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(TensorArrayOp);
 };
@@ -247,7 +253,7 @@ class TensorArrayGradOp : public TensorArrayCreationOp {
           tensor_array->ElemType(), *tensor_array_output_handle, array_size,
           false /* dynamic_size */, true /* multiple_writes_aggregate */,
           true /* is_grad */, marked_size /* marked_size */,
-          true /* close_after_read */);
+          true /* close_after_read */, 0 /* capacity */);
       TF_RETURN_IF_ERROR((*ret)->CopyShapesFrom(tensor_array));
       return Status::OK();
     };
@@ -459,7 +465,9 @@ class TensorArrayPackOp : public OpKernel {
     // Read all the PersistentTensors into a vector to keep track of
     // their memory.
     std::vector<PersistentTensor> values;
-    Status s = tensor_array->ReadMany<Device, T>(ctx, &values, array_size);
+    Tensor buffered;
+    Status s = tensor_array->ReadManyBuffered<Device, T>(ctx, &values,
+                                                         array_size, &buffered);
     OP_REQUIRES_OK(ctx, s);
 
     const Tensor* value_0_t = values[0].AccessTensor(ctx);
@@ -474,6 +482,14 @@ class TensorArrayPackOp : public OpKernel {
     TensorShape output_shape(value_0_t->shape());
     output_shape.InsertDim(0, array_size);
 
+    // The values are already packed in the buffer of the TensorArray.
+    if (buffered.IsInitialized()) {
+      Tensor output;
+      CHECK(output.CopyFrom(buffered, output_shape));
+      ctx->set_output(0, output);
+      return;
+    }
+
     Tensor* output_tensor = nullptr;
     OP_REQUIRES_OK(ctx, ctx->allocate_output(0, output_shape, &output_tensor));
     ConstMatrixVector input_tensors_flat;
@@ -612,7 +628,9 @@ class TensorArrayConcatOp : public OpKernel {
     // Read all the PersistentTensors into a vector to keep track of
     // their memory.
     std::vector<PersistentTensor> values;
-    Status s = tensor_array->ReadMany<Device, T>(ctx, &values, array_size);
+    Tensor buffered;
+    Status s = tensor_array->ReadManyBuffered<Device, T>(ctx, &values,
+                                                         array_size, &buffered);
     OP_REQUIRES_OK(ctx, s);
 
     std::vector<const Tensor*> value_tensors;
@@ -664,6 +682,14 @@ class TensorArrayConcatOp : public OpKernel {
       }
     }
 
+    // The values are already concatenated in the buffer of the TensorArray.
+    if (buffered.IsInitialized()) {
+      Tensor output;
+      CHECK(output.CopyFrom(buffered, output_shape));
+      ctx->set_output(0, output);
+      return;
+    }
+
     Tensor* output_tensor = nullptr;
     OP_REQUIRES_OK(ctx, ctx->allocate_output(0, output_shape, &output_tensor));
     ConstMatrixVector input_tensors_flat;
@@ -24,6 +24,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/gtl/top_n.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -76,35 +77,94 @@ class TopK : public OpKernel {
 
     auto values = values_out->flat_inner_dims<T>();
     auto indices = indices_out->flat_inner_dims<int32>();
-    gtl::TopN<std::pair<T, int32>> filter(k);
-    for (int r = 0; r < num_rows; r++) {
-      for (int32 c = 0; c < num_cols; ++c) {
-        // The second element is the negated index, so that lower-index elements
-        // are considered larger than higher-index elements in case of ties.
-        filter.push(std::make_pair(input(r, c), -c));
-      }
 
-      int32 i = 0;
-      if (sorted_ && k > 1) {
-        std::unique_ptr<std::vector<std::pair<T, int32>>> top_k(
-            filter.Extract());
-        for (auto top_k_it = top_k->begin(); top_k_it != top_k->end();
-             ++top_k_it, ++i) {
-          values(r, i) = top_k_it->first;
-          indices(r, i) = -top_k_it->second;
-        }
-      } else {
-        for (auto top_k_it = filter.unsorted_begin();
-             top_k_it != filter.unsorted_end(); ++top_k_it, ++i) {
-          values(r, i) = top_k_it->first;
-          indices(r, i) = -top_k_it->second;
-        }
-      }
-      filter.Reset();
+    // Rows are independent, so they are sharded across the worker threads.
+    // The first of several equal values is the one with the lower index.
+    const auto& worker_threads =
+        *context->device()->tensorflow_cpu_worker_threads();
+    // SmallTopK() always sorts, so it also handles unsorted top-1 only, to
+    // keep the order of unsorted results unchanged.
+    const bool small_k = k <= kMaxSmallK && (sorted_ || k == 1);
+    const int64 cost_per_row = num_cols * (small_k ? 4 : 20);
+    if (small_k) {
+      Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+            cost_per_row, [&](int64 start, int64 limit) {
+              for (int64 r = start; r < limit; ++r) {
+                SmallTopK(input, r, k, &values, &indices);
+              }
+            });
+      return;
     }
+    Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+          cost_per_row, [&](int64 start, int64 limit) {
+            gtl::TopN<std::pair<T, int32>> filter(k);
+            for (int64 r = start; r < limit; ++r) {
+              for (int32 c = 0; c < num_cols; ++c) {
+                // The second element is the negated index, so that
+                // lower-index elements are considered larger than higher-index
+                // elements in case of ties.
+                filter.push(std::make_pair(input(r, c), -c));
+              }
+
+              int32 i = 0;
+              if (sorted_ && k > 1) {
+                std::unique_ptr<std::vector<std::pair<T, int32>>> top_k(
+                    filter.Extract());
+                for (auto top_k_it = top_k->begin(); top_k_it != top_k->end();
+                     ++top_k_it, ++i) {
+                  values(r, i) = top_k_it->first;
+                  indices(r, i) = -top_k_it->second;
+                }
+              } else {
+                for (auto top_k_it = filter.unsorted_begin();
+                     top_k_it != filter.unsorted_end(); ++top_k_it, ++i) {
+                  values(r, i) = top_k_it->first;
+                  indices(r, i) = -top_k_it->second;
+                }
+              }
+              filter.Reset();
+            }
+          });
   }
 
  private:
+  // Largest k handled by SmallTopK().
+  static const int kMaxSmallK = 32;
+
+  typedef typename TTypes<T, 2>::ConstTensor ConstMatrix;
+  typedef typename TTypes<T, 2>::Tensor Matrix;
+  typedef TTypes<int32, 2>::Tensor IndexMatrix;
+
+  // Writes the top k of row r of input, sorted, to row r of values and
+  // indices. The candidates are kept sorted in fixed-size arrays on the
+  // stack, so most columns cost a single comparison against the smallest of
+  // them, and the few that enter only shift at most k - 1 entries. This beats
+  // the heap of gtl::TopN for the small k of beam search over action scores.
+  static void SmallTopK(const ConstMatrix& input, int64 r, int k,
+                        Matrix* values, IndexMatrix* indices) {
+    T top_values[kMaxSmallK];
+    int32 top_indices[kMaxSmallK];
+    const int32 num_cols = input.dimension(1);
+    int size = 0;
+    for (int32 c = 0; c < num_cols; ++c) {
+      const T value = input(r, c);
+      // Columns come in increasing index order, so a value equal to the
+      // smallest candidate loses the tie and never enters a full array.
+      if (size == k && !(value > top_values[k - 1])) continue;
+      int i = size < k ? size++ : k - 1;
+      for (; i > 0 && value > top_values[i - 1]; --i) {
+        top_values[i] = top_values[i - 1];
+        top_indices[i] = top_indices[i - 1];
+      }
+      top_values[i] = value;
+      top_indices[i] = c;
+    }
+    for (int i = 0; i < k; ++i) {
+      (*values)(r, i) = top_values[i];
+      (*indices)(r, i) = top_indices[i];
+    }
+  }
+
   int k_;
   bool sorted_;
 };
@@ -17,8 +17,11 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/training_ops.h"
 #include <algorithm>
+#include <unordered_map>
+#include <vector>
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -251,6 +254,73 @@ std::vector<mutex_lock> MaybeLockMutexesInOrder(
   return locks;
 }
 
+// Calls update(index, grad_row) once for each distinct entry of indices, with
+// the sum of the rows of grad at that index, so that repeated indices are
+// applied as a single update, as if grad were dense. The distinct indices are
+// updated in shards on the worker threads, which is safe because each update
+// only touches the rows of its own index. Returns an error without updating
+// any row if an index is not in [0, first_dim_size).
+template <typename T, typename Tindex, typename Update>
+Status UpdateUniqueRows(OpKernelContext* ctx,
+                        typename TTypes<Tindex>::ConstVec indices,
+                        Tindex first_dim_size,
+                        typename TTypes<T>::ConstMatrix grad, Update update) {
+  const Tindex N = indices.dimension(0);
+  const int64 inner_dim = grad.dimension(1);
+
+  // The distinct indices in order of first occurrence, and the slot of the
+  // distinct index of each occurrence.
+  std::unordered_map<Tindex, Tindex> slots;
+  slots.reserve(N);
+  std::vector<Tindex> rows;
+  std::vector<Tindex> slot_of(N);
+  for (Tindex i = 0; i < N; i++) {
+    const Tindex index = internal::SubtleMustCopy(indices(i));
+    if (!FastBoundsCheck(index, first_dim_size)) {
+      return errors::InvalidArgument(strings::StrCat(
+          "Index ", index, " at offset ", i, " in indices is out of range"));
+    }
+    auto inserted = slots.emplace(index, static_cast<Tindex>(rows.size()));
+    if (inserted.second) rows.push_back(index);
+    slot_of[i] = inserted.first->second;
+  }
+  if (inner_dim == 0) return Status::OK();
+
+  // The occurrences of slot s are occurrences[starts[s]:starts[s + 1]].
+  const Tindex num_rows = rows.size();
+  std::vector<Tindex> starts(num_rows + 1, 0);
+  for (Tindex i = 0; i < N; i++) ++starts[slot_of[i] + 1];
+  for (Tindex s = 0; s < num_rows; s++) starts[s + 1] += starts[s];
+  std::vector<Tindex> occurrences(N);
+  std::vector<Tindex> next(starts.begin(), starts.end() - 1);
+  for (Tindex i = 0; i < N; i++) occurrences[next[slot_of[i]]++] = i;
+
+  auto work = [&](int64 start, int64 end) {
+    std::vector<T> sum;
+    for (int64 s = start; s < end; s++) {
+      const T* first = &grad(occurrences[starts[s]], 0);
+      if (starts[s + 1] - starts[s] == 1) {
+        update(rows[s], typename TTypes<T>::UnalignedConstFlat(first,
+                                                                inner_dim));
+        continue;
+      }
+      sum.assign(first, first + inner_dim);
+      for (Tindex k = starts[s] + 1; k < starts[s + 1]; k++) {
+        const T* row = &grad(occurrences[k], 0);
+        for (int64 j = 0; j < inner_dim; j++) sum[j] += row[j];
+      }
+      update(rows[s], typename TTypes<T>::UnalignedConstFlat(sum.data(),
+                                                              inner_dim));
+    }
+  };
+  // Each row is summed over its occurrences and then updated in a few passes.
+  const int64 cost_per_row = (N / num_rows + 5) * inner_dim;
+  auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+  Shard(worker_threads->num_threads, worker_threads->workers, num_rows,
+        cost_per_row, work);
+  return Status::OK();
+}
+
 template <typename Device, typename T>
 class ApplyGradientDescentOp : public OpKernel {
  public:
@@ -966,6 +1036,8 @@ class SparseApplyAdagradOp : public OpKernel {
  public:
   explicit SparseApplyAdagradOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("sum_duplicate_indices",
+                                     &sum_duplicate_indices_));
   }
 
   void Compute(OpKernelContext* ctx) override NO_THREAD_SAFETY_ANALYSIS {
@@ -1010,7 +1082,22 @@ class SparseApplyAdagradOp : public OpKernel {
         errors::InvalidArgument(
             "grad must be the same size as indices in the first dimension."));
 
-    if (N > 0) {
+    if (N > 0 && sum_duplicate_indices_) {
+      auto var_flat = var.flat_outer_dims<T>();
+      auto accum_flat = accum.flat_outer_dims<T>();
+      const T lr_scalar = lr.scalar<T>()();
+      auto update = [&](Tindex index,
+                        typename TTypes<T>::UnalignedConstFlat g) {
+        auto a = accum_flat.template chip<0>(index);
+        auto v = var_flat.template chip<0>(index);
+        a += g.square();
+        v -= g.constant(lr_scalar) * g * a.rsqrt();
+      };
+      const Status s = UpdateUniqueRows<T, Tindex>(
+          ctx, indices.vec<Tindex>(), var.dim_size(0),
+          grad.flat_outer_dims<T>(), update);
+      OP_REQUIRES_OK(ctx, s);
+    } else if (N > 0) {
       if (inner_dim > 1) {
         const Tindex first_dim_size = var.dim_size(0);
         auto indices_vec = indices.vec<Tindex>();
@@ -1061,6 +1148,7 @@ class SparseApplyAdagradOp : public OpKernel {
 
  private:
   bool use_exclusive_lock_;
+  bool sum_duplicate_indices_;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                \
@@ -1611,6 +1699,8 @@ class SparseApplyMomentumOp : public OpKernel {
   explicit SparseApplyMomentumOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_locking", &use_exclusive_lock_));
     OP_REQUIRES_OK(ctx, ctx->GetAttr("use_nesterov", &use_nesterov_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("sum_duplicate_indices",
+                                     &sum_duplicate_indices_));
   }
 
   void Compute(OpKernelContext* ctx) override NO_THREAD_SAFETY_ANALYSIS {
@@ -1659,7 +1749,28 @@ class SparseApplyMomentumOp : public OpKernel {
                 errors::InvalidArgument("momentum is not a scalar: ",
                                         momentum.shape().DebugString()));
 
-    if (N > 0) {
+    if (N > 0 && sum_duplicate_indices_) {
+      auto var_flat = var.flat_outer_dims<T>();
+      auto accum_flat = accum.flat_outer_dims<T>();
+      const T lr_scalar = lr.scalar<T>()();
+      const T momentum_scalar = momentum.scalar<T>()();
+      auto update = [&](Tindex index,
+                        typename TTypes<T>::UnalignedConstFlat g) {
+        auto a = accum_flat.template chip<0>(index);
+        auto v = var_flat.template chip<0>(index);
+        a = a * a.constant(momentum_scalar) + g;
+        if (use_nesterov_) {
+          v -= g.constant(lr_scalar) * g +
+               a.constant(lr_scalar) * a.constant(momentum_scalar) * a;
+        } else {
+          v -= a.constant(lr_scalar) * a;
+        }
+      };
+      const Status s = UpdateUniqueRows<T, Tindex>(
+          ctx, indices.vec<Tindex>(), var.dim_size(0),
+          grad.flat_outer_dims<T>(), update);
+      OP_REQUIRES_OK(ctx, s);
+    } else if (N > 0) {
       const Tindex first_dim_size = var.dim_size(0);
       auto indices_vec = indices.vec<Tindex>();
       auto var_flat = var.flat_outer_dims<T>();
@@ -1693,6 +1804,7 @@ class SparseApplyMomentumOp : public OpKernel {
  private:
   bool use_exclusive_lock_;
   bool use_nesterov_;
+  bool sum_duplicate_indices_;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                \
@@ -15,11 +15,17 @@ limitations under the License.
 
 #include "tensorflow/core/lib/core/threadpool.h"
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <vector>
+
 #define EIGEN_USE_THREADS
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/platform/context.h"
 #include "tensorflow/core/platform/denormal.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/tracing.h"
 #include "tensorflow/core/platform/types.h"
@@ -101,31 +107,235 @@ struct ThreadPool::Impl : Eigen::ThreadPoolTempl<EigenEnvironment> {
   }
 };
 
+// A pool in which every thread has its own deque of tasks. Tasks scheduled
+// from a thread of the pool go to the back of its deque, which it pops from,
+// and other tasks are spread round-robin over the deques. A thread whose
+// deque is empty steals from the front of the others, so each deque is
+// only shared when there is work to balance.
+struct ThreadPool::StealingImpl {
+  typedef EigenEnvironment::Task Task;
+
+  StealingImpl(Env* env, const ThreadOptions& thread_options,
+               const string& name, int num_threads)
+      : env_(env, thread_options, name),
+        spin_wait_micros_(thread_options.spin_wait_micros),
+        queues_(num_threads) {
+    threads_.reserve(num_threads);
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.emplace_back(env_.CreateThread([this, i]() { WorkerLoop(i); }));
+    }
+  }
+
+  ~StealingImpl() {
+    {
+      mutex_lock l(mu_);
+      done_ = true;
+      cond_var_.notify_all();
+    }
+    // Joins the threads once they have run all scheduled tasks.
+    threads_.clear();
+  }
+
+  void Schedule(std::function<void()> fn) {
+    Task task = env_.CreateTask(std::move(fn));
+    const int id = CurrentThreadId();
+    Queue* queue = &queues_[id >= 0 ? id : next_queue_++ % queues_.size()];
+    {
+      mutex_lock l(queue->mu);
+      queue->tasks.push_back(std::move(task));
+    }
+
+    // Both counters are updated before the other is read, so either this
+    // thread sees a sleeping worker and wakes it, or the worker sees the task.
+    ++num_pending_;
+    if (num_sleeping_ > 0) {
+      mutex_lock l(mu_);
+      cond_var_.notify_one();
+    }
+  }
+
+  // Splits [0, total) in halves, scheduling the upper half, until the rest
+  // is small enough to run. Idle threads steal the larger ranges scheduled
+  // first and split them in turn, so the split adapts to the load.
+  void ParallelFor(int64 total, int64 cost_per_unit,
+                   std::function<void(int64, int64)> fn) {
+    CHECK_GE(total, 0);
+    if (total == 0) return;
+    // As in Shard(), a cost unit is roughly 1ns and a task should do at
+    // least 10us of work, but ranges are not split below a few per thread.
+    static const int64 kMinCostPerTask = 10000;
+    const int64 min_size = std::max<int64>(
+        (kMinCostPerTask + std::max<int64>(1, cost_per_unit) - 1) /
+            std::max<int64>(1, cost_per_unit),
+        total / (4 * NumThreads()));
+    if (total <= min_size) {
+      fn(0, total);
+      return;
+    }
+
+    std::atomic<int64> remaining(total);
+    Notification done;
+    std::function<void(int64, int64)> handle_range;
+    handle_range = [&](int64 first, int64 last) {
+      while (last - first > min_size) {
+        const int64 middle = first + (last - first) / 2;
+        Schedule([&handle_range, middle, last]() {
+          handle_range(middle, last);
+        });
+        last = middle;
+      }
+      fn(first, last);
+      if (remaining.fetch_sub(last - first) == last - first) done.Notify();
+    };
+    handle_range(0, total);
+
+    // A thread of the pool runs tasks while it waits, since the ranges may
+    // still be in its own deque.
+    const int id = CurrentThreadId();
+    Task task;
+    while (id >= 0 && !done.HasBeenNotified() && Pop(id, &task)) {
+      env_.ExecuteTask(task);
+    }
+    done.WaitForNotification();
+  }
+
+  int NumThreads() const { return queues_.size(); }
+
+  int CurrentThreadId() const {
+    return current_pool == this ? current_thread_id : -1;
+  }
+
+ private:
+  struct Queue {
+    mutex mu;
+    std::deque<Task> tasks;
+  };
+
+  // Takes a task from the back of the thread's own deque, or else from the
+  // front of another one. Returns false if all deques are empty.
+  bool Pop(int id, Task* task) {
+    for (size_t i = 0; i < queues_.size(); ++i) {
+      Queue* queue = &queues_[(id + i) % queues_.size()];
+      mutex_lock l(queue->mu);
+      if (queue->tasks.empty()) continue;
+      if (i == 0) {
+        *task = std::move(queue->tasks.back());
+        queue->tasks.pop_back();
+      } else {
+        *task = std::move(queue->tasks.front());
+        queue->tasks.pop_front();
+      }
+      --num_pending_;
+      return true;
+    }
+    return false;
+  }
+
+  void WorkerLoop(int id) {
+    current_pool = this;
+    current_thread_id = id;
+    Task task;
+    while (true) {
+      if (Pop(id, &task)) {
+        env_.ExecuteTask(task);
+        task.f.reset();
+        continue;
+      }
+      if (SpinForTask()) continue;
+      mutex_lock l(mu_);
+      ++num_sleeping_;
+      while (num_pending_ == 0 && !done_) cond_var_.wait(l);
+      --num_sleeping_;
+      if (num_pending_ == 0 && done_) return;
+    }
+  }
+
+  // Spins for up to spin_wait_micros_ until a task is pending, without
+  // counting as sleeping, so Schedule() doesn't need to wake the thread.
+  // Returns whether a task is pending.
+  bool SpinForTask() {
+    if (spin_wait_micros_ <= 0) return false;
+    const uint64 deadline_micros = env_.env_->NowMicros() + spin_wait_micros_;
+    while (num_pending_ == 0) {
+      // Reads the clock only every so many checks, to keep checking fast.
+      for (int i = 0; i < 64 && num_pending_ == 0; ++i) {
+      }
+      if (env_.env_->NowMicros() >= deadline_micros) break;
+    }
+    return num_pending_ > 0;
+  }
+
+  // The pool and the id of the pool thread running on this thread, if any.
+  static thread_local const StealingImpl* current_pool;
+  static thread_local int current_thread_id;
+
+  EigenEnvironment env_;
+  const int64 spin_wait_micros_;
+  std::vector<Queue> queues_;
+  std::vector<std::unique_ptr<Thread>> threads_;
+  std::atomic<uint32> next_queue_{0};
+
+  // Number of tasks in the deques, and of threads waiting for one.
+  std::atomic<int> num_pending_{0};
+  std::atomic<int> num_sleeping_{0};
+
+  mutex mu_;
+  condition_variable cond_var_;
+  bool done_ = false;
+};
+
+thread_local const ThreadPool::StealingImpl*
+    ThreadPool::StealingImpl::current_pool = nullptr;
+thread_local int ThreadPool::StealingImpl::current_thread_id = -1;
+
 ThreadPool::ThreadPool(Env* env, const string& name, int num_threads)
     : ThreadPool(env, ThreadOptions(), name, num_threads) {}
 
 ThreadPool::ThreadPool(Env* env, const ThreadOptions& thread_options,
-                       const string& name, int num_threads) {
+                       const string& name, int num_threads)
+    : ThreadPool(env, thread_options, name, num_threads, false) {}
+
+ThreadPool::ThreadPool(Env* env, const ThreadOptions& thread_options,
+                       const string& name, int num_threads,
+                       bool work_stealing) {
   CHECK_GE(num_threads, 1);
-  impl_.reset(
-      new ThreadPool::Impl(env, thread_options, "tf_" + name, num_threads));
+  if (work_stealing) {
+    stealing_impl_.reset(new ThreadPool::StealingImpl(
+        env, thread_options, "tf_" + name, num_threads));
+  } else {
+    impl_.reset(
+        new ThreadPool::Impl(env, thread_options, "tf_" + name, num_threads));
+  }
 }
 
 ThreadPool::~ThreadPool() {}
 
 void ThreadPool::Schedule(std::function<void()> fn) {
   CHECK(fn != nullptr);
-  impl_->Schedule(std::move(fn));
+  if (stealing_impl_) {
+    stealing_impl_->Schedule(std::move(fn));
+  } else {
+    impl_->Schedule(std::move(fn));
+  }
 }
 
 void ThreadPool::ParallelFor(int64 total, int64 cost_per_unit,
                              std::function<void(int64, int64)> fn) {
-  impl_->ParallelFor(total, cost_per_unit, std::move(fn));
+  if (stealing_impl_) {
+    stealing_impl_->ParallelFor(total, cost_per_unit, std::move(fn));
+  } else {
+    impl_->ParallelFor(total, cost_per_unit, std::move(fn));
+  }
 }
 
-int ThreadPool::NumThreads() const { return impl_->NumThreads(); }
+int ThreadPool::NumThreads() const {
+  return stealing_impl_ ? stealing_impl_->NumThreads() : impl_->NumThreads();
+}
 
-int ThreadPool::CurrentThreadId() const { return impl_->CurrentThreadId(); }
+int ThreadPool::CurrentThreadId() const {
+  return stealing_impl_ ? stealing_impl_->CurrentThreadId()
+                        : impl_->CurrentThreadId();
+}
 
 }  // namespace thread
 }  // namespace tensorflow
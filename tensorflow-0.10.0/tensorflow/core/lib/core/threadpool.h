@@ -40,6 +40,16 @@ class ThreadPool {
   ThreadPool(Env* env, const ThreadOptions& thread_options, const string& name,
              int num_threads);
 
+  // Construct a pool that contains "num_threads" threads with specified "name".
+  // If "work_stealing" is true, every thread has its own queue of tasks and
+  // takes tasks from the queues of the other threads when it runs out, which
+  // contends less than a single shared queue when many small tasks are
+  // scheduled.
+  //
+  // REQUIRES: num_threads > 0
+  ThreadPool(Env* env, const ThreadOptions& thread_options, const string& name,
+             int num_threads, bool work_stealing);
+
   // Wait until all scheduled work has finished and then destroy the
   // set of threads.
   ~ThreadPool();
@@ -51,6 +61,9 @@ class ThreadPool {
   // having roughly "cost_per_unit" cost, in cycles. Each unit of work is
   // indexed 0, 1, ..., total - 1. Each shard contains 1 or more units of work
   // and the total cost of each shard is roughly the same.
+  //
+  // Only supported by work stealing pools, or when TensorFlow is built with
+  // EIGEN_USE_NONBLOCKING_THREAD_POOL.
   void ParallelFor(int64 total, int64 cost_per_unit,
                    std::function<void(int64, int64)> fn);
 
@@ -61,10 +74,15 @@ class ThreadPool {
   // thread in the pool. Returns -1 otherwise.
   int CurrentThreadId() const;
 
+  // Returns whether this is a work stealing pool.
+  bool work_stealing() const { return stealing_impl_ != nullptr; }
+
   struct Impl;
+  struct StealingImpl;
 
  private:
   std::unique_ptr<Impl> impl_;
+  std::unique_ptr<StealingImpl> stealing_impl_;
   TF_DISALLOW_COPY_AND_ASSIGN(ThreadPool);
 };
 
@@ -16,7 +16,9 @@ limitations under the License.
 #include "tensorflow/core/lib/core/threadpool.h"
 
 #include <atomic>
+#include <vector>
 
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/test.h"
@@ -82,6 +84,95 @@ TEST(ThreadPool, ParallelFor) {
 }
 #endif
 
+TEST(ThreadPool, WorkStealingDoWork) {
+  for (int num_threads = 1; num_threads < kNumThreads; num_threads++) {
+    fprintf(stderr, "Testing with %d threads\n", num_threads);
+    const int kWorkItems = 15;
+    std::atomic<int> work[kWorkItems];
+    for (int i = 0; i < kWorkItems; i++) {
+      work[i] = 0;
+    }
+    {
+      ThreadPool pool(Env::Default(), ThreadOptions(), "test", num_threads,
+                      true /* work_stealing */);
+      EXPECT_TRUE(pool.work_stealing());
+      EXPECT_EQ(-1, pool.CurrentThreadId());
+      // Tasks scheduled from the pool go to the deque of their thread.
+      for (int i = 0; i < kWorkItems; i++) {
+        pool.Schedule([&pool, &work, i, num_threads]() {
+          const int id = pool.CurrentThreadId();
+          EXPECT_GE(id, 0);
+          EXPECT_LT(id, num_threads);
+          pool.Schedule([&work, i]() { ++work[i]; });
+        });
+      }
+    }
+    for (int i = 0; i < kWorkItems; i++) {
+      EXPECT_EQ(1, work[i]);
+    }
+  }
+}
+
+TEST(ThreadPool, WorkStealingSpinWait) {
+  ThreadOptions thread_options;
+  thread_options.spin_wait_micros = 1000;
+  ThreadPool pool(Env::Default(), thread_options, "test", kNumThreads,
+                  true /* work_stealing */);
+  // Tasks run whether they arrive while the threads spin or after they
+  // sleep.
+  for (int round = 0; round < 2; ++round) {
+    const int kWorkItems = 100;
+    std::atomic<int> work(0);
+    BlockingCounter counter(kWorkItems);
+    for (int i = 0; i < kWorkItems; ++i) {
+      pool.Schedule([&work, &counter]() {
+        ++work;
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+    EXPECT_EQ(kWorkItems, work);
+    Env::Default()->SleepForMicroseconds(5000);
+  }
+}
+
+TEST(ThreadPool, WorkStealingParallelFor) {
+  for (int num_threads = 1; num_threads < kNumThreads; num_threads += 7) {
+    ThreadPool pool(Env::Default(), ThreadOptions(), "test", num_threads,
+                    true /* work_stealing */);
+    for (int64 total : {0, 1, 15, 1000}) {
+      for (int64 cost_per_unit : {1, 1000, 1 << 30}) {
+        std::vector<std::atomic<int>> work(total);
+        for (auto& w : work) w = 0;
+        pool.ParallelFor(total, cost_per_unit,
+                         [&work, total](int64 begin, int64 end) {
+                           ASSERT_LE(0, begin);
+                           ASSERT_LT(begin, end);
+                           ASSERT_LE(end, total);
+                           for (int64 i = begin; i < end; ++i) ++work[i];
+                         });
+        for (int64 i = 0; i < total; i++) {
+          ASSERT_EQ(1, work[i]) << total << " " << cost_per_unit;
+        }
+      }
+    }
+  }
+}
+
+TEST(ThreadPool, WorkStealingNestedParallelFor) {
+  ThreadPool pool(Env::Default(), ThreadOptions(), "test", 4,
+                  true /* work_stealing */);
+  std::atomic<int64> sum(0);
+  pool.ParallelFor(16, 1 << 30, [&pool, &sum](int64 begin, int64 end) {
+    for (int64 i = begin; i < end; ++i) {
+      pool.ParallelFor(100, 1 << 20, [&sum](int64 first, int64 last) {
+        sum += last - first;
+      });
+    }
+  });
+  EXPECT_EQ(1600, sum);
+}
+
 static void BM_Sequential(int iters) {
   ThreadPool pool(Env::Default(), "test", kNumThreads);
   // Decrement count sequentially until 0.
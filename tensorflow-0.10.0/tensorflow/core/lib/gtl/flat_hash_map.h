@@ -0,0 +1,366 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// FlatHashMap is a hash map with open addressing, a drop-in replacement for
+// std::unordered_map in lookup-heavy code. Entries are stored inline in one
+// array and probed linearly, next to an array of one control byte per slot
+// holding seven bits of the hash, so that a lookup typically touches one
+// cache line of control bytes and compares a single key.
+//
+// Unlike std::unordered_map, inserting or erasing an element invalidates all
+// iterators, pointers and references into the map.
+//
+// find(), count() and erase() accept any key type that the hash and equality
+// functors accept, e.g. a StringPiece for a map keyed by strings with
+// StringPieceHash and StringPieceEqual, which then never copies the key:
+//
+//   gtl::FlatHashMap<string, int, gtl::StringPieceHash,
+//                    gtl::StringPieceEqual> ids;
+//   ids["word"] = 1;
+//   auto it = ids.find(StringPiece(buffer, size));
+
+#ifndef TENSORFLOW_LIB_GTL_FLAT_HASH_MAP_H_
+#define TENSORFLOW_LIB_GTL_FLAT_HASH_MAP_H_
+
+#include <stddef.h>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace gtl {
+
+// Hash and equality of strings and string pieces alike.
+struct StringPieceHash {
+  size_t operator()(StringPiece s) const { return StringPiece::Hasher()(s); }
+};
+struct StringPieceEqual {
+  bool operator()(StringPiece a, StringPiece b) const { return a == b; }
+};
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename Eq = std::equal_to<Key>>
+class FlatHashMap {
+ public:
+  typedef Key key_type;
+  typedef Value mapped_type;
+  typedef std::pair<const Key, Value> value_type;
+  typedef size_t size_type;
+  typedef Hash hasher;
+  typedef Eq key_equal;
+
+ private:
+  template <typename Map, typename Reference>
+  class Iterator : public std::iterator<std::forward_iterator_tag,
+                                        typename std::remove_reference<
+                                            Reference>::type> {
+   public:
+    Iterator() : map_(nullptr), slot_(0) {}
+    Iterator(Map *map, size_t slot) : map_(map), slot_(slot) { SkipEmpty(); }
+
+    // Converts iterators to const iterators.
+    template <typename OtherMap, typename OtherReference>
+    Iterator(const Iterator<OtherMap, OtherReference> &other)  // NOLINT
+        : map_(other.map_), slot_(other.slot_) {}
+
+    Reference operator*() const { return *map_->value(slot_); }
+    typename std::remove_reference<Reference>::type *operator->() const {
+      return map_->value(slot_);
+    }
+    Iterator &operator++() {
+      ++slot_;
+      SkipEmpty();
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator previous = *this;
+      ++*this;
+      return previous;
+    }
+    bool operator==(const Iterator &other) const {
+      return slot_ == other.slot_;
+    }
+    bool operator!=(const Iterator &other) const {
+      return slot_ != other.slot_;
+    }
+
+   private:
+    template <typename OtherMap, typename OtherReference>
+    friend class Iterator;
+    friend class FlatHashMap;
+
+    void SkipEmpty() {
+      while (slot_ < map_->capacity_ && map_->control_[slot_] == kEmpty) {
+        ++slot_;
+      }
+    }
+
+    Map *map_;
+    size_t slot_;
+  };
+
+ public:
+  typedef Iterator<FlatHashMap, value_type &> iterator;
+  typedef Iterator<const FlatHashMap, const value_type &> const_iterator;
+
+  FlatHashMap() {}
+
+  // Creates a map holding up to expected_size elements without rehashing.
+  explicit FlatHashMap(size_t expected_size) { reserve(expected_size); }
+
+  FlatHashMap(const FlatHashMap &other)
+      : hash_(other.hash_), eq_(other.eq_) {
+    reserve(other.size());
+    for (const value_type &value : other) insert(value);
+  }
+
+  FlatHashMap(FlatHashMap &&other) { swap(other); }
+
+  FlatHashMap &operator=(FlatHashMap other) {
+    swap(other);
+    return *this;
+  }
+
+  ~FlatHashMap() { DestroyAll(); }
+
+  void swap(FlatHashMap &other) {
+    std::swap(hash_, other.hash_);
+    std::swap(eq_, other.eq_);
+    std::swap(slots_, other.slots_);
+    control_.swap(other.control_);
+    std::swap(capacity_, other.capacity_);
+    std::swap(size_, other.size_);
+  }
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, capacity_); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, capacity_); }
+
+  // Removes all elements, keeping the allocated slots.
+  void clear() {
+    for (size_t slot = 0; slot < capacity_; ++slot) {
+      if (control_[slot] != kEmpty) {
+        value(slot)->~value_type();
+        control_[slot] = kEmpty;
+      }
+    }
+    size_ = 0;
+  }
+
+  // Makes room for size elements without rehashing.
+  void reserve(size_t size) {
+    size_t capacity = kMinCapacity;
+    while (capacity * kMaxLoadNumerator < size * kMaxLoadDenominator) {
+      capacity *= 2;
+    }
+    if (capacity > capacity_) Rehash(capacity);
+  }
+
+  template <typename K>
+  iterator find(const K &key) {
+    return iterator(this, FindSlot(key));
+  }
+  template <typename K>
+  const_iterator find(const K &key) const {
+    return const_iterator(this, FindSlot(key));
+  }
+
+  template <typename K>
+  size_t count(const K &key) const {
+    return FindSlot(key) != capacity_ ? 1 : 0;
+  }
+
+  // Inserts the value unless its key is present. Returns the element with the
+  // key, and whether it was inserted.
+  std::pair<iterator, bool> insert(const value_type &value) {
+    return Emplace(value.first, value);
+  }
+  std::pair<iterator, bool> insert(value_type &&value) {
+    return Emplace(value.first, std::move(value));
+  }
+
+  // Returns the value of the key, inserting a default value if needed.
+  Value &operator[](const Key &key) {
+    return Emplace(key, std::piecewise_construct, std::forward_as_tuple(key),
+                   std::forward_as_tuple())
+        .first->second;
+  }
+  Value &operator[](Key &&key) {
+    return Emplace(key, std::piecewise_construct,
+                   std::forward_as_tuple(std::move(key)),
+                   std::forward_as_tuple())
+        .first->second;
+  }
+
+  // Removes the element of the key, if any, and returns the number of removed
+  // elements.
+  template <typename K>
+  size_t erase(const K &key) {
+    const size_t slot = FindSlot(key);
+    if (slot == capacity_) return 0;
+    EraseSlot(slot);
+    return 1;
+  }
+
+  // Removes the element at the iterator.
+  void erase(iterator it) { EraseSlot(it.slot_); }
+  void erase(const_iterator it) { EraseSlot(it.slot_); }
+
+ private:
+  // Control byte of empty slots. Full slots hold the low seven bits of the
+  // hash of their key.
+  static const uint8 kEmpty = 0x80;
+
+  // Slots are rehashed into twice as many when more than 3/4 are full.
+  static const size_t kMinCapacity = 8;
+  static const size_t kMaxLoadNumerator = 3;
+  static const size_t kMaxLoadDenominator = 4;
+
+  typedef typename std::aligned_storage<sizeof(value_type),
+                                        alignof(value_type)>::type Slot;
+
+  // Returns the mixed hash of a key. Mixing makes up for identity hashes of
+  // integers, whose low bits would otherwise pick the slot.
+  template <typename K>
+  uint64 HashOf(const K &key) const {
+    uint64 h = static_cast<uint64>(hash_(key));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  // The slot of a hash is picked by the high bits, the control byte holds
+  // the low bits.
+  size_t HomeSlot(uint64 h) const { return (h >> 7) & (capacity_ - 1); }
+  static uint8 ControlByte(uint64 h) { return h & 0x7f; }
+
+  value_type *value(size_t slot) {
+    return reinterpret_cast<value_type *>(&slots_[slot]);
+  }
+  const value_type *value(size_t slot) const {
+    return reinterpret_cast<const value_type *>(&slots_[slot]);
+  }
+
+  // Returns the slot of the key, or capacity_ if it is not present.
+  template <typename K>
+  size_t FindSlot(const K &key) const {
+    if (size_ == 0) return capacity_;
+    const uint64 h = HashOf(key);
+    const uint8 control = ControlByte(h);
+    for (size_t slot = HomeSlot(h);; slot = (slot + 1) & (capacity_ - 1)) {
+      const uint8 c = control_[slot];
+      if (c == kEmpty) return capacity_;
+      if (c == control && eq_(value(slot)->first, key)) return slot;
+    }
+  }
+
+  // Finds the key, or constructs a new element from args in its place.
+  template <typename... Args>
+  std::pair<iterator, bool> Emplace(const Key &key, Args &&... args) {
+    if ((size_ + 1) * kMaxLoadDenominator > capacity_ * kMaxLoadNumerator) {
+      Rehash(capacity_ == 0 ? kMinCapacity : 2 * capacity_);
+    }
+    const uint64 h = HashOf(key);
+    const uint8 control = ControlByte(h);
+    size_t slot = HomeSlot(h);
+    for (;; slot = (slot + 1) & (capacity_ - 1)) {
+      const uint8 c = control_[slot];
+      if (c == kEmpty) break;
+      if (c == control && eq_(value(slot)->first, key)) {
+        return std::make_pair(iterator(this, slot), false);
+      }
+    }
+    new (&slots_[slot]) value_type(std::forward<Args>(args)...);
+    control_[slot] = control;
+    ++size_;
+    return std::make_pair(iterator(this, slot), true);
+  }
+
+  // Empties a slot, and moves later elements of its probe sequence back into
+  // the hole, so that lookups never need tombstones.
+  void EraseSlot(size_t hole) {
+    value(hole)->~value_type();
+    control_[hole] = kEmpty;
+    --size_;
+    const size_t mask = capacity_ - 1;
+    for (size_t slot = (hole + 1) & mask; control_[slot] != kEmpty;
+         slot = (slot + 1) & mask) {
+      // The element may move back unless its home is in (hole, slot].
+      const size_t home = HomeSlot(HashOf(value(slot)->first));
+      if (((slot - home) & mask) < ((slot - hole) & mask)) continue;
+      new (&slots_[hole]) value_type(std::move(*value(slot)));
+      control_[hole] = control_[slot];
+      value(slot)->~value_type();
+      control_[slot] = kEmpty;
+      hole = slot;
+    }
+  }
+
+  // Moves all elements into a new array of capacity slots.
+  void Rehash(size_t capacity) {
+    DCHECK_EQ(capacity & (capacity - 1), 0);
+    std::unique_ptr<Slot[]> slots(std::move(slots_));
+    std::vector<uint8> control;
+    control.swap(control_);
+    const size_t old_capacity = capacity_;
+    slots_.reset(new Slot[capacity]);
+    control_.assign(capacity, static_cast<uint8>(kEmpty));
+    capacity_ = capacity;
+    for (size_t old = 0; old < old_capacity; ++old) {
+      if (control[old] == kEmpty) continue;
+      value_type *moved = reinterpret_cast<value_type *>(&slots[old]);
+      size_t slot = HomeSlot(HashOf(moved->first));
+      while (control_[slot] != kEmpty) slot = (slot + 1) & (capacity - 1);
+      new (&slots_[slot]) value_type(std::move(*moved));
+      control_[slot] = control[old];
+      moved->~value_type();
+    }
+  }
+
+  void DestroyAll() {
+    for (size_t slot = 0; slot < capacity_; ++slot) {
+      if (control_[slot] != kEmpty) value(slot)->~value_type();
+    }
+  }
+
+  Hash hash_;
+  Eq eq_;
+
+  // Storage of the elements, and the control byte of each slot. The capacity
+  // is zero or a power of two.
+  std::unique_ptr<Slot[]> slots_;
+  std::vector<uint8> control_;
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+};
+
+}  // namespace gtl
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_LIB_GTL_FLAT_HASH_MAP_H_
@@ -0,0 +1,126 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/gtl/flat_hash_map.h"
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace gtl {
+namespace {
+
+typedef FlatHashMap<string, int, StringPieceHash, StringPieceEqual> StringMap;
+
+TEST(FlatHashMapTest, InsertsAndFinds) {
+  StringMap map;
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.find("a") == map.end());
+  EXPECT_TRUE(map.insert({"a", 1}).second);
+  EXPECT_FALSE(map.insert({"a", 2}).second);
+  map["b"] = 3;
+  ++map["c"];
+  EXPECT_EQ(3, map.size());
+  EXPECT_EQ(1, map.find("a")->second);
+  EXPECT_EQ(3, map["b"]);
+  EXPECT_EQ(1, map.count(StringPiece("cc", 1)));
+  EXPECT_EQ(0, map.count("d"));
+
+  // Works with the map utilities.
+  EXPECT_EQ(3, FindWithDefault(map, "b", 0));
+  EXPECT_EQ(7, LookupOrInsert(&map, "e", 7));
+  EXPECT_EQ(7, LookupOrInsert(&map, "e", 8));
+}
+
+TEST(FlatHashMapTest, FindsStringPiecesWithoutCopies) {
+  const string text = "the quick brown fox";
+  FlatHashMap<StringPiece, int, StringPiece::Hasher> map;
+  map[StringPiece(text.data(), 3)] = 0;
+  map[StringPiece(text.data() + 4, 5)] = 1;
+  EXPECT_EQ(1, map.find(StringPiece("quick"))->second);
+  EXPECT_TRUE(map.find(StringPiece("fox")) == map.end());
+}
+
+TEST(FlatHashMapTest, MatchesStdMapUnderRandomOperations) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  FlatHashMap<int64, int64> map;
+  std::map<int64, int64> expected;
+  for (int i = 0; i < 20000; ++i) {
+    // Keys that are multiples of a power of two collide under identity hashes
+    // of the slot bits.
+    const int64 key = static_cast<int64>(rnd.Uniform(500)) * 1024;
+    switch (rnd.Uniform(3)) {
+      case 0:
+        map[key] = i;
+        expected[key] = i;
+        break;
+      case 1:
+        EXPECT_EQ(expected.erase(key), map.erase(key));
+        break;
+      default:
+        EXPECT_EQ(expected.count(key), map.count(key));
+    }
+    ASSERT_EQ(expected.size(), map.size());
+  }
+  std::map<int64, int64> iterated(map.begin(), map.end());
+  EXPECT_EQ(expected, iterated);
+
+  FlatHashMap<int64, int64> copy(map);
+  for (const auto &value : expected) {
+    EXPECT_EQ(value.second, copy.find(value.first)->second);
+  }
+  copy.clear();
+  EXPECT_TRUE(copy.empty());
+  EXPECT_TRUE(copy.begin() == copy.end());
+  EXPECT_EQ(expected.size(), map.size());
+}
+
+TEST(FlatHashMapTest, DestroysValues) {
+  std::shared_ptr<int> value(new int(1));
+  {
+    FlatHashMap<int, std::shared_ptr<int>> map;
+    for (int i = 0; i < 100; ++i) map[i] = value;
+    EXPECT_EQ(101, value.use_count());
+    for (int i = 0; i < 50; ++i) map.erase(i);
+    EXPECT_EQ(51, value.use_count());
+  }
+  EXPECT_EQ(1, value.use_count());
+}
+
+static void BM_FlatHashMapStringPieceLookup(int iters) {
+  std::vector<string> words;
+  for (int i = 0; i < 10000; ++i) words.push_back(strings::StrCat("word", i));
+  StringMap map;
+  for (size_t i = 0; i < words.size(); ++i) map[words[i]] = i;
+  int64 sum = 0;
+  for (int i = 0; i < iters; ++i) {
+    const string &word = words[i % words.size()];
+    sum += map.find(StringPiece(word))->second;
+  }
+  CHECK_GE(sum, 0);
+}
+BENCHMARK(BM_FlatHashMapStringPieceLookup);
+
+}  // namespace
+}  // namespace gtl
+}  // namespace tensorflow
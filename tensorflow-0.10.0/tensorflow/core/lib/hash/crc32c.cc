@@ -14,13 +14,26 @@ limitations under the License.
 ==============================================================================*/
 
 // A portable implementation of crc32c, optimized to handle
-// four bytes at a time.
+// four bytes at a time, and one using the crc32 instructions of SSE4.2 or
+// ARMv8 where the processor has them.
 
 #include "tensorflow/core/lib/hash/crc32c.h"
 
 #include <stdint.h>
+#include <string.h>
 #include "tensorflow/core/lib/core/coding.h"
 
+// x86-64 processors are checked for SSE4.2 at run time, so that binaries
+// built for any x86-64 use the instructions where available. ARM binaries
+// use them when built for a target with the CRC extension.
+#if defined(__x86_64__) && defined(__GNUC__)
+#define TF_CRC32C_SSE42 1
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define TF_CRC32C_ARM64 1
+#include <arm_acle.h>
+#endif
+
 namespace tensorflow {
 namespace crc32c {
 
@@ -206,7 +219,7 @@ static inline uint32_t LE_LOAD32(const uint8_t *p) {
   return core::DecodeFixed32(reinterpret_cast<const char *>(p));
 }
 
-uint32 Extend(uint32 crc, const char *buf, size_t size) {
+static uint32 ExtendPortable(uint32 crc, const char *buf, size_t size) {
   const uint8 *p = reinterpret_cast<const uint8 *>(buf);
   const uint8 *e = p + size;
   uint32 l = crc ^ 0xffffffffu;
@@ -255,5 +268,56 @@ uint32 Extend(uint32 crc, const char *buf, size_t size) {
   return l ^ 0xffffffffu;
 }
 
+#if defined(TF_CRC32C_SSE42)
+
+__attribute__((target("sse4.2"))) static uint32 ExtendSSE42(
+    uint32 crc, const char *buf, size_t size) {
+  const char *e = buf + size;
+  uint64 l = crc ^ 0xffffffffu;
+  for (; buf + 8 <= e; buf += 8) {
+    uint64 word;
+    memcpy(&word, buf, sizeof(word));
+    l = _mm_crc32_u64(l, word);
+  }
+  uint32 l32 = static_cast<uint32>(l);
+  for (; buf != e; ++buf) {
+    l32 = _mm_crc32_u8(l32, static_cast<uint8>(*buf));
+  }
+  return l32 ^ 0xffffffffu;
+}
+
+static bool HaveSSE42() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+}
+
+uint32 Extend(uint32 crc, const char *buf, size_t size) {
+  static const bool have_sse42 = HaveSSE42();
+  return have_sse42 ? ExtendSSE42(crc, buf, size)
+                    : ExtendPortable(crc, buf, size);
+}
+
+#elif defined(TF_CRC32C_ARM64)
+
+uint32 Extend(uint32 crc, const char *buf, size_t size) {
+  const char *e = buf + size;
+  uint32 l = crc ^ 0xffffffffu;
+  for (; buf + 8 <= e; buf += 8) {
+    uint64 word;
+    memcpy(&word, buf, sizeof(word));
+    l = __crc32cd(l, word);
+  }
+  for (; buf != e; ++buf) l = __crc32cb(l, static_cast<uint8>(*buf));
+  return l ^ 0xffffffffu;
+}
+
+#else
+
+uint32 Extend(uint32 crc, const char *buf, size_t size) {
+  return ExtendPortable(crc, buf, size);
+}
+
+#endif
+
 }  // namespace crc32c
 }  // namespace tensorflow
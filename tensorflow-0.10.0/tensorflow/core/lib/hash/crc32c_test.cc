@@ -54,6 +54,32 @@ TEST(CRC, Extend) {
   ASSERT_EQ(Value("hello world", 11), Extend(Value("hello ", 6), "world", 5));
 }
 
+// Bitwise crc32c, to check the table and instruction based implementations.
+uint32 SlowValue(const char* data, size_t n) {
+  uint32 crc = 0xffffffffu;
+  for (size_t i = 0; i < n; ++i) {
+    crc ^= static_cast<uint8>(data[i]);
+    for (int bit = 0; bit < 8; ++bit) {
+      crc = (crc >> 1) ^ (0x82f63b78u & (0u - (crc & 1)));
+    }
+  }
+  return crc ^ 0xffffffffu;
+}
+
+TEST(CRC, AllLengthsAndAlignments) {
+  char buf[300];
+  for (size_t i = 0; i < sizeof(buf); ++i) buf[i] = i * 37 + (i >> 3);
+  for (int offset = 0; offset < 8; ++offset) {
+    for (size_t n = 0; n + offset <= sizeof(buf); ++n) {
+      ASSERT_EQ(SlowValue(buf + offset, n), Value(buf + offset, n))
+          << "offset " << offset << " length " << n;
+    }
+  }
+  ASSERT_EQ(Value(buf, sizeof(buf)),
+            Extend(Extend(Value(buf, 13), buf + 13, 100), buf + 113,
+                   sizeof(buf) - 113));
+}
+
 TEST(CRC, Mask) {
   uint32 crc = Value("foo", 3);
   ASSERT_NE(crc, Mask(crc));
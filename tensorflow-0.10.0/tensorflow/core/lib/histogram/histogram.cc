@@ -45,12 +45,12 @@ static std::vector<double>* InitDefaultBucketsInner() {
   return result;
 }
 
-static gtl::ArraySlice<double> InitDefaultBuckets() {
+gtl::ArraySlice<double> Histogram::DefaultBucketLimits() {
   static std::vector<double>* default_bucket_limits = InitDefaultBucketsInner();
   return *default_bucket_limits;
 }
 
-Histogram::Histogram() : bucket_limits_(InitDefaultBuckets()) { Clear(); }
+Histogram::Histogram() : bucket_limits_(DefaultBucketLimits()) { Clear(); }
 
 // Create a histogram with a custom set of bucket limits,
 // specified in "custom_buckets[0..custom_buckets.size()-1]"
@@ -44,6 +44,10 @@ class Histogram {
   // REQUIRES: custom_bucket_limits is not empty()
   explicit Histogram(gtl::ArraySlice<double> custom_bucket_limits);
 
+  // Returns the bucket boundaries of histograms created with the default
+  // constructor.
+  static gtl::ArraySlice<double> DefaultBucketLimits();
+
   // Restore the state of a histogram that was previously encoded
   // via Histogram::EncodeToProto.  Note that only the bucket boundaries
   // generated by EncodeToProto will be restored.
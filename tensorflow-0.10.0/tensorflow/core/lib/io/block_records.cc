@@ -0,0 +1,384 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/block_records.h"
+
+#include <string.h>
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/snappy.h"
+
+namespace tensorflow {
+namespace io {
+
+namespace {
+
+// Magic numbers of the files with zlib and snappy compressed blocks.
+const uint64 kMagic = 0x6b6c625f63657274ull;
+const uint64 kSnappyMagic = 0x6b6c625f63657273ull;
+const size_t kIndexEntrySize = 8 + 4 + 4 + 4 + 4;
+const size_t kFooterSize = 8 + 8 + 4 + 8;
+
+// Blocks and their compressed sizes must fit in 32 bits.
+const int64 kMaxBlockSize = 1LL << 30;
+const size_t kMaxRecordSize = 1LL << 30;
+
+uint32 MaskedCrc(const char* data, size_t n) {
+  return crc32c::Mask(crc32c::Value(data, n));
+}
+
+}  // namespace
+
+BlockRecordWriter::BlockRecordWriter(WritableFile* dest,
+                                     const BlockRecordWriterOptions& options)
+    : dest_(dest), options_(options) {
+  CHECK_GT(options_.block_size, 0);
+  CHECK_LE(options_.block_size, kMaxBlockSize);
+}
+
+BlockRecordWriter::~BlockRecordWriter() {
+  if (!closed_) {
+    Status s = Close();
+    if (!s.ok()) {
+      LOG(ERROR) << "Could not finish writing file: " << s;
+    }
+  }
+}
+
+Status BlockRecordWriter::WriteRecord(StringPiece record) {
+  if (closed_) {
+    return errors::FailedPrecondition("Writing to a closed record file");
+  }
+  if (record.size() > kMaxRecordSize) {
+    return errors::InvalidArgument("Record of ", record.size(),
+                                   " bytes is too large");
+  }
+  core::PutVarint64(&block_, record.size());
+  block_.append(record.data(), record.size());
+  ++num_records_;
+  if (block_.size() >= static_cast<size_t>(options_.block_size)) {
+    return WriteBlock();
+  }
+  return Status::OK();
+}
+
+Status BlockRecordWriter::DeflateBlock(string* compressed) const {
+  const ZlibCompressionOptions& zlib_options = options_.zlib_options;
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  int status =
+      deflateInit2(&stream, zlib_options.compression_level,
+                   zlib_options.compression_method, zlib_options.window_bits,
+                   zlib_options.mem_level, zlib_options.compression_strategy);
+  if (status != Z_OK) {
+    return errors::Internal("deflateInit2 failed with status ", status);
+  }
+  compressed->resize(deflateBound(&stream, block_.size()));
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(block_.data()));
+  stream.avail_in = block_.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&(*compressed)[0]);
+  stream.avail_out = compressed->size();
+  status = deflate(&stream, Z_FINISH);
+  compressed->resize(stream.total_out);
+  deflateEnd(&stream);
+  if (status != Z_STREAM_END) {
+    return errors::Internal("deflate failed with status ", status);
+  }
+  return Status::OK();
+}
+
+Status BlockRecordWriter::SnappyCompressBlock(string* compressed) const {
+  if (!port::Snappy_Compress(block_.data(), block_.size(), compressed)) {
+    return errors::Unimplemented("Snappy compression is not available");
+  }
+  return Status::OK();
+}
+
+Status BlockRecordWriter::WriteBlock() {
+  if (num_records_ == 0) return Status::OK();
+
+  string compressed;
+  if (options_.compression_type ==
+      BlockRecordWriterOptions::SNAPPY_COMPRESSION) {
+    TF_RETURN_IF_ERROR(SnappyCompressBlock(&compressed));
+  } else {
+    TF_RETURN_IF_ERROR(DeflateBlock(&compressed));
+  }
+
+  TF_RETURN_IF_ERROR(dest_->Append(compressed));
+  core::PutFixed64(&index_, offset_);
+  core::PutFixed32(&index_, compressed.size());
+  core::PutFixed32(&index_, block_.size());
+  core::PutFixed32(&index_, num_records_);
+  core::PutFixed32(&index_, MaskedCrc(compressed.data(), compressed.size()));
+  offset_ += compressed.size();
+  ++num_blocks_;
+  block_.clear();
+  num_records_ = 0;
+  return Status::OK();
+}
+
+Status BlockRecordWriter::Close() {
+  if (closed_) return Status::OK();
+  closed_ = true;
+  TF_RETURN_IF_ERROR(WriteBlock());
+  string footer;
+  core::PutFixed64(&footer, offset_);
+  core::PutFixed64(&footer, num_blocks_);
+  core::PutFixed32(&footer, MaskedCrc(index_.data(), index_.size()));
+  const bool snappy = options_.compression_type ==
+                      BlockRecordWriterOptions::SNAPPY_COMPRESSION;
+  core::PutFixed64(&footer, snappy ? kSnappyMagic : kMagic);
+  TF_RETURN_IF_ERROR(dest_->Append(index_));
+  return dest_->Append(footer);
+}
+
+BlockRecordReader::BlockRecordReader(RandomAccessFile* file,
+                                     const BlockRecordReaderOptions& options)
+    : file_(file),
+      options_(options),
+      compression_type_(BlockRecordWriterOptions::ZLIB_COMPRESSION) {
+  CHECK(options_.pool == nullptr || options_.max_blocks_ahead > 0);
+}
+
+BlockRecordReader::~BlockRecordReader() { DiscardBlocks(); }
+
+Status BlockRecordReader::Open(RandomAccessFile* file, uint64 file_size,
+                               const BlockRecordReaderOptions& options,
+                               std::unique_ptr<BlockRecordReader>* reader) {
+  if (file_size < kFooterSize) {
+    return errors::DataLoss("Block record file of ", file_size,
+                            " bytes is too short");
+  }
+  const uint64 index_end = file_size - kFooterSize;
+  char footer_buf[kFooterSize];
+  StringPiece footer;
+  TF_RETURN_IF_ERROR(file->Read(index_end, kFooterSize, &footer, footer_buf));
+  if (footer.size() != kFooterSize) {
+    return errors::DataLoss("Not a block record file");
+  }
+  const uint64 magic = core::DecodeFixed64(footer.data() + 20);
+  if (magic != kMagic && magic != kSnappyMagic) {
+    return errors::DataLoss("Not a block record file");
+  }
+  string probe;
+  if (magic == kSnappyMagic && !port::Snappy_Compress("", 0, &probe)) {
+    return errors::Unimplemented(
+        "Snappy compressed block record file, but snappy is not available");
+  }
+  const uint64 index_offset = core::DecodeFixed64(footer.data());
+  const uint64 num_blocks = core::DecodeFixed64(footer.data() + 8);
+  const uint32 index_crc = core::DecodeFixed32(footer.data() + 16);
+  if (index_offset > index_end ||
+      num_blocks != (index_end - index_offset) / kIndexEntrySize ||
+      (index_end - index_offset) % kIndexEntrySize != 0) {
+    return errors::DataLoss("Corrupted block record index");
+  }
+
+  string index_buf;
+  index_buf.resize(index_end - index_offset);
+  StringPiece index;
+  if (!index_buf.empty()) {
+    TF_RETURN_IF_ERROR(
+        file->Read(index_offset, index_buf.size(), &index, &index_buf[0]));
+  }
+  if (index.size() != index_buf.size() ||
+      (options.verify_checksums &&
+       crc32c::Unmask(index_crc) !=
+           crc32c::Value(index.data(), index.size()))) {
+    return errors::DataLoss("Corrupted block record index");
+  }
+
+  std::unique_ptr<BlockRecordReader> result(
+      new BlockRecordReader(file, options));
+  result->compression_type_ = magic == kSnappyMagic
+                                  ? BlockRecordWriterOptions::SNAPPY_COMPRESSION
+                                  : BlockRecordWriterOptions::ZLIB_COMPRESSION;
+  result->blocks_.resize(num_blocks);
+  for (uint64 i = 0; i < num_blocks; ++i) {
+    const char* entry = index.data() + i * kIndexEntrySize;
+    BlockInfo* info = &result->blocks_[i];
+    info->offset = core::DecodeFixed64(entry);
+    info->compressed_size = core::DecodeFixed32(entry + 8);
+    info->uncompressed_size = core::DecodeFixed32(entry + 12);
+    info->num_records = core::DecodeFixed32(entry + 16);
+    info->masked_crc = core::DecodeFixed32(entry + 20);
+    if (info->offset > index_offset ||
+        info->compressed_size > index_offset - info->offset) {
+      return errors::DataLoss("Corrupted block record index");
+    }
+    result->num_records_ += info->num_records;
+  }
+  *reader = std::move(result);
+  return Status::OK();
+}
+
+Status BlockRecordReader::DecompressBlock(int64 index, string* data) const {
+  const BlockInfo& info = blocks_[index];
+  string compressed;
+  compressed.resize(info.compressed_size);
+  StringPiece input;
+  if (!compressed.empty()) {
+    TF_RETURN_IF_ERROR(file_->Read(info.offset, info.compressed_size, &input,
+                                   &compressed[0]));
+  }
+  if (input.size() != info.compressed_size) {
+    return errors::DataLoss("Truncated block ", index);
+  }
+  if (options_.verify_checksums &&
+      crc32c::Unmask(info.masked_crc) !=
+          crc32c::Value(input.data(), input.size())) {
+    return errors::DataLoss("Corrupted block ", index);
+  }
+
+  if (compression_type_ == BlockRecordWriterOptions::SNAPPY_COMPRESSION) {
+    return SnappyUncompressBlock(index, input, data);
+  }
+  return InflateBlock(index, input, data);
+}
+
+Status BlockRecordReader::InflateBlock(int64 index, StringPiece input,
+                                       string* data) const {
+  const BlockInfo& info = blocks_[index];
+  data->resize(info.uncompressed_size);
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  int status = inflateInit2(&stream, options_.zlib_options.window_bits);
+  if (status != Z_OK) {
+    return errors::Internal("inflateInit2 failed with status ", status);
+  }
+  stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  stream.avail_in = input.size();
+  stream.next_out = reinterpret_cast<Bytef*>(&(*data)[0]);
+  stream.avail_out = data->size();
+  status = inflate(&stream, Z_FINISH);
+  const uLong inflated = stream.total_out;
+  inflateEnd(&stream);
+  if (status != Z_STREAM_END || inflated != info.uncompressed_size) {
+    return errors::DataLoss("Corrupted block ", index);
+  }
+  return Status::OK();
+}
+
+Status BlockRecordReader::SnappyUncompressBlock(int64 index, StringPiece input,
+                                                string* data) const {
+  const BlockInfo& info = blocks_[index];
+  size_t uncompressed_size;
+  if (!port::Snappy_GetUncompressedLength(input.data(), input.size(),
+                                          &uncompressed_size) ||
+      uncompressed_size != info.uncompressed_size) {
+    return errors::DataLoss("Corrupted block ", index);
+  }
+  data->resize(uncompressed_size);
+  if (uncompressed_size > 0 &&
+      !port::Snappy_Uncompress(input.data(), input.size(), &(*data)[0])) {
+    return errors::DataLoss("Corrupted block ", index);
+  }
+  return Status::OK();
+}
+
+void BlockRecordReader::ScheduleBlocks() {
+  while (next_block_ < num_blocks() &&
+         ahead_.size() < static_cast<size_t>(options_.max_blocks_ahead)) {
+    ahead_.emplace_back(new Block);
+    Block* block = ahead_.back().get();
+    block->index = next_block_++;
+    options_.pool->Schedule([this, block]() {
+      string data;
+      Status s = DecompressBlock(block->index, &data);
+      // Notifies under the lock, since the reader may discard the block as
+      // soon as the lock is released.
+      mutex_lock l(mu_);
+      block->data.swap(data);
+      block->status = s;
+      block->done = true;
+      block_done_.notify_all();
+    });
+  }
+}
+
+Status BlockRecordReader::NextBlock() {
+  remaining_.clear();
+  if (options_.pool == nullptr) {
+    if (next_block_ == num_blocks()) {
+      return errors::OutOfRange("End of file reached");
+    }
+    if (current_ == nullptr) current_.reset(new Block);
+    current_->index = next_block_++;
+    TF_RETURN_IF_ERROR(DecompressBlock(current_->index, &current_->data));
+  } else {
+    ScheduleBlocks();
+    if (ahead_.empty()) {
+      return errors::OutOfRange("End of file reached");
+    }
+    {
+      mutex_lock l(mu_);
+      while (!ahead_.front()->done) {
+        block_done_.wait(l);
+      }
+    }
+    current_ = std::move(ahead_.front());
+    ahead_.pop_front();
+    ScheduleBlocks();
+    TF_RETURN_IF_ERROR(current_->status);
+  }
+  remaining_ = current_->data;
+  return Status::OK();
+}
+
+void BlockRecordReader::DiscardBlocks() {
+  mutex_lock l(mu_);
+  for (const auto& block : ahead_) {
+    while (!block->done) {
+      block_done_.wait(l);
+    }
+  }
+  ahead_.clear();
+}
+
+void BlockRecordReader::SeekToBlock(int64 block) {
+  CHECK_GE(block, 0);
+  CHECK_LE(block, num_blocks());
+  DiscardBlocks();
+  current_.reset();
+  remaining_.clear();
+  next_block_ = block;
+}
+
+Status BlockRecordReader::ReadRecord(StringPiece* record) {
+  while (remaining_.empty()) {
+    TF_RETURN_IF_ERROR(NextBlock());
+  }
+  uint64 length;
+  if (!core::GetVarint64(&remaining_, &length) || length > remaining_.size()) {
+    remaining_.clear();
+    return errors::DataLoss("Corrupted record in block ", current_->index);
+  }
+  *record = StringPiece(remaining_.data(), length);
+  remaining_.remove_prefix(length);
+  return Status::OK();
+}
+
+Status BlockRecordReader::ReadRecord(string* record) {
+  StringPiece piece;
+  TF_RETURN_IF_ERROR(ReadRecord(&piece));
+  record->assign(piece.data(), piece.size());
+  return Status::OK();
+}
+
+}  // namespace io
+}  // namespace tensorflow
@@ -0,0 +1,247 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Record files made of independently compressed blocks.
+//
+// Unlike a zlib-compressed RecordWriter stream, which must be inflated from
+// the start on a single thread, a block record file is a sequence of blocks
+// that are each compressed on their own, followed by an index of the blocks:
+//
+//   block*  index  footer
+//
+// An uncompressed block is a sequence of records, each a varint64 length
+// followed by the bytes of the record. The index holds for each block
+//
+//   fixed64  offset of the block in the file
+//   fixed32  compressed size
+//   fixed32  uncompressed size
+//   fixed32  number of records
+//   fixed32  masked crc32c of the compressed bytes
+//
+// and the footer is
+//
+//   fixed64  offset of the index
+//   fixed64  number of blocks
+//   fixed32  masked crc32c of the index
+//   fixed64  magic number
+//
+// Blocks are compressed with zlib or with snappy, which is several times
+// faster for a lower compression ratio, and the magic number tells which.
+// A reader can thus decompress several blocks in parallel ahead of the
+// records being consumed, and start at any block.
+
+#ifndef TENSORFLOW_LIB_IO_BLOCK_RECORDS_H_
+#define TENSORFLOW_LIB_IO_BLOCK_RECORDS_H_
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/io/zlib_compression_options.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace io {
+
+class BlockRecordWriterOptions {
+ public:
+  enum CompressionType { ZLIB_COMPRESSION = 1, SNAPPY_COMPRESSION = 2 };
+  CompressionType compression_type = ZLIB_COMPRESSION;
+
+  // Number of uncompressed bytes after which a block is compressed and
+  // written. Larger blocks compress better, smaller ones give more
+  // parallelism to readers.
+  int64 block_size = 1 << 20;
+
+  // With zlib compression, only the compression parameters are used.
+  ZlibCompressionOptions zlib_options;
+};
+
+// Writes records to a block record file. A given instance is NOT safe for
+// concurrent use by multiple threads.
+class BlockRecordWriter {
+ public:
+  // Create a writer that will append data to "*dest".
+  // "*dest" must be initially empty.
+  // "*dest" must remain live while this Writer is in use.
+  BlockRecordWriter(
+      WritableFile* dest,
+      const BlockRecordWriterOptions& options = BlockRecordWriterOptions());
+
+  // Closes the writer if Close() was not called, logging any error.
+  ~BlockRecordWriter();
+
+  // Appends a record. Writing a block returns UNIMPLEMENTED with snappy
+  // compression if snappy is not available in this build.
+  Status WriteRecord(StringPiece record);
+
+  // Writes the last block, the index and the footer. Does *not* close the
+  // WritableFile. No records can be written afterwards.
+  Status Close();
+
+ private:
+  // Compresses the records buffered in "block_" into "*compressed".
+  Status DeflateBlock(string* compressed) const;
+  Status SnappyCompressBlock(string* compressed) const;
+
+  // Compresses and writes the records buffered in "block_".
+  Status WriteBlock();
+
+  WritableFile* const dest_;
+  BlockRecordWriterOptions options_;
+
+  // Offset of the next block in "*dest_".
+  uint64 offset_ = 0;
+
+  // Uncompressed records of the current block, and their number.
+  string block_;
+  uint32 num_records_ = 0;
+
+  // Encoded index entries of the written blocks.
+  string index_;
+  uint64 num_blocks_ = 0;
+
+  bool closed_ = false;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BlockRecordWriter);
+};
+
+class BlockRecordReaderOptions {
+ public:
+  // For zlib compressed files, only the window bits are used, and must match
+  // the writer's.
+  ZlibCompressionOptions zlib_options;
+
+  // Pool in which blocks are read and decompressed ahead, or null to
+  // decompress them on the reading thread when they are reached. Not owned.
+  thread::ThreadPool* pool = nullptr;
+
+  // With a pool, the maximum number of blocks decompressed ahead of the block
+  // being read.
+  int max_blocks_ahead = 4;
+
+  // Whether the checksums of the blocks are verified.
+  bool verify_checksums = true;
+};
+
+// Reads the records of a block record file in order. A given instance is NOT
+// safe for concurrent use by multiple threads, but decompresses blocks in
+// parallel in the pool of its options.
+class BlockRecordReader {
+ public:
+  // Opens the block record file "*file" of "file_size" bytes, and reads its
+  // index. On success, stores the reader in "*reader" and returns OK, or
+  // returns DATA_LOSS if it is not a block record file, and UNIMPLEMENTED if
+  // its blocks are compressed with snappy which is not available.
+  // "*file" and the pool of the options must remain live while the reader is
+  // in use, and "*file" must be safe for concurrent reads.
+  static Status Open(RandomAccessFile* file, uint64 file_size,
+                     const BlockRecordReaderOptions& options,
+                     std::unique_ptr<BlockRecordReader>* reader);
+
+  // Waits for the blocks being decompressed.
+  ~BlockRecordReader();
+
+  // Returns the number of blocks and records in the file.
+  int64 num_blocks() const { return blocks_.size(); }
+  int64 num_records() const { return num_records_; }
+
+  // Returns the number of records in the given block, in [0, num_blocks()).
+  int64 num_block_records(int64 block) const {
+    return blocks_[block].num_records;
+  }
+
+  // Continues reading at the first record of the given block, in
+  // [0, num_blocks()].
+  void SeekToBlock(int64 block);
+
+  // Reads the next record into "*record", which points into a buffer of the
+  // reader and is valid until the next call. Returns OK on success,
+  // OUT_OF_RANGE at the end of the file, or something else for an error.
+  Status ReadRecord(StringPiece* record);
+
+  // Like above, but copies the record into "*record".
+  Status ReadRecord(string* record);
+
+ private:
+  struct BlockInfo {
+    uint64 offset;
+    uint32 compressed_size;
+    uint32 uncompressed_size;
+    uint32 num_records;
+    uint32 masked_crc;
+  };
+
+  // A block being decompressed, or decompressed once "done".
+  struct Block {
+    int64 index;
+    bool done = false;
+    Status status;
+    string data;
+  };
+
+  BlockRecordReader(RandomAccessFile* file,
+                    const BlockRecordReaderOptions& options);
+
+  // Decompresses a block read into "input" into "*data".
+  Status InflateBlock(int64 index, StringPiece input, string* data) const;
+  Status SnappyUncompressBlock(int64 index, StringPiece input,
+                               string* data) const;
+
+  // Reads and decompresses the block with the given index into "*data".
+  Status DecompressBlock(int64 index, string* data) const;
+
+  // Schedules blocks in the pool until "max_blocks_ahead" are pending.
+  void ScheduleBlocks();
+
+  // Makes the next block current, waiting for it if needed. Returns
+  // OUT_OF_RANGE after the last block.
+  Status NextBlock();
+
+  // Waits for all scheduled blocks, and discards them.
+  void DiscardBlocks();
+
+  RandomAccessFile* const file_;
+  const BlockRecordReaderOptions options_;
+  BlockRecordWriterOptions::CompressionType compression_type_;
+  std::vector<BlockInfo> blocks_;
+  int64 num_records_ = 0;
+
+  // Index of the next block to decompress or schedule.
+  int64 next_block_ = 0;
+
+  // The current block, and its records that were not read yet.
+  std::unique_ptr<Block> current_;
+  StringPiece remaining_;
+
+  // Blocks scheduled in the pool, in file order. Their fields other than
+  // "index" are guarded by "mu_" until they are done.
+  std::deque<std::unique_ptr<Block>> ahead_;
+  mutex mu_;
+  condition_variable block_done_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BlockRecordReader);
+};
+
+}  // namespace io
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_LIB_IO_BLOCK_RECORDS_H_
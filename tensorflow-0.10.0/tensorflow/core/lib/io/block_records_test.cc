@@ -0,0 +1,230 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/block_records.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/snappy.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace io {
+namespace {
+
+class StringDest : public WritableFile {
+ public:
+  string contents_;
+
+  Status Close() override { return Status::OK(); }
+  Status Flush() override { return Status::OK(); }
+  Status Sync() override { return Status::OK(); }
+  Status Append(const StringPiece& slice) override {
+    contents_.append(slice.data(), slice.size());
+    return Status::OK();
+  }
+};
+
+class StringSource : public RandomAccessFile {
+ public:
+  explicit StringSource(const string* contents) : contents_(contents) {}
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override {
+    if (offset >= contents_->size()) {
+      *result = StringPiece();
+      return errors::OutOfRange("end of file");
+    }
+    const size_t available = std::min<size_t>(n, contents_->size() - offset);
+    memcpy(scratch, contents_->data() + offset, available);
+    *result = StringPiece(scratch, available);
+    if (available < n) {
+      return errors::OutOfRange("end of file");
+    }
+    return Status::OK();
+  }
+
+ private:
+  const string* contents_;
+};
+
+// Records of varying sizes, with some empty and some larger than a block.
+std::vector<string> TestRecords() {
+  std::vector<string> records;
+  for (int i = 0; i < 500; ++i) {
+    records.push_back(string(i % 7 == 0 ? 0 : (i * 37) % 300, 'a' + i % 26));
+  }
+  return records;
+}
+
+string WriteRecords(const std::vector<string>& records, int block_size,
+                    BlockRecordWriterOptions::CompressionType compression_type =
+                        BlockRecordWriterOptions::ZLIB_COMPRESSION) {
+  StringDest dest;
+  BlockRecordWriterOptions options;
+  options.block_size = block_size;
+  options.compression_type = compression_type;
+  BlockRecordWriter writer(&dest, options);
+  for (const string& record : records) {
+    TF_CHECK_OK(writer.WriteRecord(record));
+  }
+  TF_CHECK_OK(writer.Close());
+  return dest.contents_;
+}
+
+std::vector<string> ReadAll(BlockRecordReader* reader) {
+  std::vector<string> records;
+  string record;
+  Status s = reader->ReadRecord(&record);
+  while (s.ok()) {
+    records.push_back(record);
+    s = reader->ReadRecord(&record);
+  }
+  EXPECT_TRUE(errors::IsOutOfRange(s)) << s;
+  return records;
+}
+
+TEST(BlockRecords, ReadsRecordsInOrder) {
+  const std::vector<string> records = TestRecords();
+  const string contents = WriteRecords(records, 1000);
+  StringSource source(&contents);
+  thread::ThreadPool pool(Env::Default(), "block_records", 4);
+
+  for (thread::ThreadPool* reader_pool : {
+           static_cast<thread::ThreadPool*>(nullptr), &pool}) {
+    for (int blocks_ahead : {1, 3, 100}) {
+      BlockRecordReaderOptions options;
+      options.pool = reader_pool;
+      options.max_blocks_ahead = blocks_ahead;
+      std::unique_ptr<BlockRecordReader> reader;
+      TF_ASSERT_OK(BlockRecordReader::Open(&source, contents.size(), options,
+                                           &reader));
+      EXPECT_GT(reader->num_blocks(), 10);
+      EXPECT_EQ(records.size(), reader->num_records());
+      EXPECT_EQ(records, ReadAll(reader.get()));
+      StringPiece record;
+      EXPECT_TRUE(errors::IsOutOfRange(reader->ReadRecord(&record)));
+    }
+  }
+}
+
+bool SnappyCompressionSupported() {
+  string out;
+  StringPiece in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+  return port::Snappy_Compress(in.data(), in.size(), &out);
+}
+
+TEST(BlockRecords, ReadsSnappyCompressedRecords) {
+  const std::vector<string> records = TestRecords();
+  if (!SnappyCompressionSupported()) {
+    StringDest dest;
+    BlockRecordWriterOptions options;
+    options.compression_type = BlockRecordWriterOptions::SNAPPY_COMPRESSION;
+    BlockRecordWriter writer(&dest, options);
+    TF_EXPECT_OK(writer.WriteRecord(records[1]));
+    EXPECT_TRUE(errors::IsUnimplemented(writer.Close()));
+    fprintf(stderr, "skipping compression tests\n");
+    return;
+  }
+
+  const string contents = WriteRecords(
+      records, 1000, BlockRecordWriterOptions::SNAPPY_COMPRESSION);
+  EXPECT_NE(WriteRecords(records, 1000), contents);
+  StringSource source(&contents);
+  thread::ThreadPool pool(Env::Default(), "block_records", 4);
+  BlockRecordReaderOptions options;
+  options.pool = &pool;
+  std::unique_ptr<BlockRecordReader> reader;
+  TF_ASSERT_OK(
+      BlockRecordReader::Open(&source, contents.size(), options, &reader));
+  EXPECT_GT(reader->num_blocks(), 10);
+  EXPECT_EQ(records.size(), reader->num_records());
+  EXPECT_EQ(records, ReadAll(reader.get()));
+}
+
+TEST(BlockRecords, SeeksToBlocks) {
+  std::vector<string> records;
+  for (int i = 100; i < 200; ++i) records.push_back(strings::StrCat(i));
+  // Blocks of 10 records of 4 bytes each, with their lengths.
+  const string contents = WriteRecords(records, 40);
+  StringSource source(&contents);
+  thread::ThreadPool pool(Env::Default(), "block_records", 2);
+  BlockRecordReaderOptions options;
+  options.pool = &pool;
+  std::unique_ptr<BlockRecordReader> reader;
+  TF_ASSERT_OK(
+      BlockRecordReader::Open(&source, contents.size(), options, &reader));
+  EXPECT_EQ(10, reader->num_blocks());
+  EXPECT_EQ(10, reader->num_block_records(3));
+
+  string record;
+  TF_ASSERT_OK(reader->ReadRecord(&record));
+  EXPECT_EQ("100", record);
+  reader->SeekToBlock(7);
+  TF_ASSERT_OK(reader->ReadRecord(&record));
+  EXPECT_EQ("170", record);
+  reader->SeekToBlock(9);
+  EXPECT_EQ(std::vector<string>(records.begin() + 90, records.end()),
+            ReadAll(reader.get()));
+  reader->SeekToBlock(10);
+  EXPECT_TRUE(errors::IsOutOfRange(reader->ReadRecord(&record)));
+  reader->SeekToBlock(0);
+  EXPECT_EQ(records, ReadAll(reader.get()));
+}
+
+TEST(BlockRecords, EmptyFile) {
+  const string contents = WriteRecords({}, 100);
+  StringSource source(&contents);
+  std::unique_ptr<BlockRecordReader> reader;
+  TF_ASSERT_OK(BlockRecordReader::Open(&source, contents.size(),
+                                       BlockRecordReaderOptions(), &reader));
+  EXPECT_EQ(0, reader->num_blocks());
+  EXPECT_EQ(0, reader->num_records());
+  string record;
+  EXPECT_TRUE(errors::IsOutOfRange(reader->ReadRecord(&record)));
+}
+
+TEST(BlockRecords, DetectsCorruption) {
+  const std::vector<string> records = TestRecords();
+  string contents = WriteRecords(records, 1000);
+  std::unique_ptr<BlockRecordReader> reader;
+
+  // A truncated file has no footer.
+  StringSource source(&contents);
+  EXPECT_TRUE(errors::IsDataLoss(BlockRecordReader::Open(
+      &source, contents.size() - 1, BlockRecordReaderOptions(), &reader)));
+
+  // A corrupted block is reported when it is reached, and the following
+  // blocks can still be read.
+  contents[10] ^= 0x55;
+  thread::ThreadPool pool(Env::Default(), "block_records", 2);
+  BlockRecordReaderOptions options;
+  options.pool = &pool;
+  TF_ASSERT_OK(
+      BlockRecordReader::Open(&source, contents.size(), options, &reader));
+  string record;
+  EXPECT_TRUE(errors::IsDataLoss(reader->ReadRecord(&record)));
+  TF_EXPECT_OK(reader->ReadRecord(&record));
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace tensorflow
@@ -0,0 +1,265 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/cache.h"
+
+#include <assert.h>
+#include <unordered_map>
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/mutex.h"
+
+namespace tensorflow {
+namespace table {
+
+Cache::~Cache() {}
+
+namespace {
+
+// An entry is a variable length heap-allocated structure.  Entries
+// are kept in a hash table keyed by their key, and, while only the
+// cache refers to them, in a circular doubly linked list ordered by
+// access time.  Entries in use by clients are not in the list, so
+// they are never evicted.
+struct LRUHandle {
+  void* value;
+  void (*deleter)(const StringPiece&, void* value);
+  LRUHandle* next;
+  LRUHandle* prev;
+  size_t charge;
+  bool in_cache;  // Whether the entry is in the cache's hash table.
+  uint32 refs;    // References, including the cache's one while in_cache.
+  string key;
+};
+
+// A single shard of sharded cache.
+class LRUCache {
+ public:
+  LRUCache();
+  ~LRUCache();
+
+  // Separate from constructor so caller can easily make an array of LRUCache
+  void SetCapacity(size_t capacity) { capacity_ = capacity; }
+
+  // Like Cache methods.
+  Cache::Handle* Insert(const StringPiece& key, void* value, size_t charge,
+                        void (*deleter)(const StringPiece& key, void* value));
+  Cache::Handle* Lookup(const StringPiece& key);
+  void Release(Cache::Handle* handle);
+  void Erase(const StringPiece& key);
+  size_t TotalCharge() const {
+    mutex_lock l(mutex_);
+    return usage_;
+  }
+
+ private:
+  void LRU_Remove(LRUHandle* e);
+  void LRU_Append(LRUHandle* e);
+  void Ref(LRUHandle* e);
+  void Unref(LRUHandle* e);
+
+  // Removes "*e" from the cache, which must contain it.
+  void FinishErase(LRUHandle* e) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Initialized before use.
+  size_t capacity_;
+
+  // mutex_ protects the following state.
+  mutable mutex mutex_;
+  size_t usage_ GUARDED_BY(mutex_);
+
+  // Dummy head of LRU list.
+  // lru.prev is newest entry, lru.next is oldest entry.
+  // Entries have refs==1 and in_cache==true.
+  LRUHandle lru_ GUARDED_BY(mutex_);
+
+  std::unordered_map<StringPiece, LRUHandle*, StringPiece::Hasher> table_
+      GUARDED_BY(mutex_);
+};
+
+LRUCache::LRUCache() : usage_(0) {
+  // Make empty circular linked list.
+  lru_.next = &lru_;
+  lru_.prev = &lru_;
+}
+
+LRUCache::~LRUCache() {
+  // Entries in use by clients must have been released.
+  for (LRUHandle* e = lru_.next; e != &lru_;) {
+    LRUHandle* next = e->next;
+    assert(e->in_cache);
+    assert(e->refs == 1);
+    e->in_cache = false;
+    Unref(e);
+    e = next;
+  }
+}
+
+void LRUCache::Ref(LRUHandle* e) {
+  if (e->refs == 1 && e->in_cache) {  // If on lru_ list, take it off.
+    LRU_Remove(e);
+  }
+  e->refs++;
+}
+
+void LRUCache::Unref(LRUHandle* e) {
+  assert(e->refs > 0);
+  e->refs--;
+  if (e->refs == 0) {  // Deallocate.
+    assert(!e->in_cache);
+    (*e->deleter)(e->key, e->value);
+    delete e;
+  } else if (e->in_cache && e->refs == 1) {
+    // No longer in use by clients; move to lru_ list.
+    LRU_Append(e);
+  }
+}
+
+void LRUCache::LRU_Remove(LRUHandle* e) {
+  e->next->prev = e->prev;
+  e->prev->next = e->next;
+}
+
+void LRUCache::LRU_Append(LRUHandle* e) {
+  // Make "e" newest entry by inserting just before lru_.
+  e->next = &lru_;
+  e->prev = lru_.prev;
+  e->prev->next = e;
+  e->next->prev = e;
+}
+
+Cache::Handle* LRUCache::Lookup(const StringPiece& key) {
+  mutex_lock l(mutex_);
+  auto it = table_.find(key);
+  if (it == table_.end()) return nullptr;
+  Ref(it->second);
+  return reinterpret_cast<Cache::Handle*>(it->second);
+}
+
+void LRUCache::Release(Cache::Handle* handle) {
+  mutex_lock l(mutex_);
+  Unref(reinterpret_cast<LRUHandle*>(handle));
+}
+
+Cache::Handle* LRUCache::Insert(const StringPiece& key, void* value,
+                                size_t charge,
+                                void (*deleter)(const StringPiece& key,
+                                                void* value)) {
+  mutex_lock l(mutex_);
+
+  LRUHandle* e = new LRUHandle;
+  e->value = value;
+  e->deleter = deleter;
+  e->charge = charge;
+  e->key.assign(key.data(), key.size());
+  e->refs = 1;  // for the returned handle.
+  e->in_cache = false;
+
+  if (capacity_ > 0) {
+    auto it = table_.find(key);
+    if (it != table_.end()) {
+      FinishErase(it->second);
+    }
+    e->refs++;  // for the cache's reference.
+    e->in_cache = true;
+    usage_ += charge;
+    table_[e->key] = e;
+  }  // else don't cache.  (Tests use capacity_==0 to turn off caching.)
+
+  while (usage_ > capacity_ && lru_.next != &lru_) {
+    LRUHandle* old = lru_.next;
+    assert(old->refs == 1);
+    FinishErase(old);
+  }
+
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+void LRUCache::FinishErase(LRUHandle* e) {
+  assert(e->in_cache);
+  table_.erase(e->key);
+  if (e->refs == 1) {
+    LRU_Remove(e);
+  }
+  e->in_cache = false;
+  usage_ -= e->charge;
+  Unref(e);
+}
+
+void LRUCache::Erase(const StringPiece& key) {
+  mutex_lock l(mutex_);
+  auto it = table_.find(key);
+  if (it != table_.end()) {
+    FinishErase(it->second);
+  }
+}
+
+static const int kNumShardBits = 4;
+static const int kNumShards = 1 << kNumShardBits;
+
+class ShardedLRUCache : public Cache {
+ private:
+  LRUCache shard_[kNumShards];
+  mutex id_mutex_;
+  uint64 last_id_ GUARDED_BY(id_mutex_);
+
+  static uint32 Shard(const StringPiece& key) {
+    return Hash32(key.data(), key.size(), 0) >> (32 - kNumShardBits);
+  }
+
+ public:
+  explicit ShardedLRUCache(size_t capacity) : last_id_(0) {
+    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].SetCapacity(per_shard);
+    }
+  }
+  ~ShardedLRUCache() override {}
+  Handle* Insert(const StringPiece& key, void* value, size_t charge,
+                 void (*deleter)(const StringPiece& key,
+                                 void* value)) override {
+    return shard_[Shard(key)].Insert(key, value, charge, deleter);
+  }
+  Handle* Lookup(const StringPiece& key) override {
+    return shard_[Shard(key)].Lookup(key);
+  }
+  void Release(Handle* handle) override {
+    LRUHandle* h = reinterpret_cast<LRUHandle*>(handle);
+    shard_[Shard(h->key)].Release(handle);
+  }
+  void Erase(const StringPiece& key) override {
+    shard_[Shard(key)].Erase(key);
+  }
+  void* Value(Handle* handle) override {
+    return reinterpret_cast<LRUHandle*>(handle)->value;
+  }
+  uint64 NewId() override {
+    mutex_lock l(id_mutex_);
+    return ++(last_id_);
+  }
+  size_t TotalCharge() const override {
+    size_t total = 0;
+    for (int s = 0; s < kNumShards; s++) {
+      total += shard_[s].TotalCharge();
+    }
+    return total;
+  }
+};
+
+}  // end anonymous namespace
+
+Cache* NewLRUCache(size_t capacity) { return new ShardedLRUCache(capacity); }
+
+}  // namespace table
+}  // namespace tensorflow
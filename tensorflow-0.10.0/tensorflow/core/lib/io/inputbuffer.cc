@@ -14,6 +14,8 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/lib/io/inputbuffer.h"
+
+#include <utility>
 #include "tensorflow/core/lib/core/errors.h"
 
 namespace tensorflow {
@@ -27,11 +29,78 @@ InputBuffer::InputBuffer(RandomAccessFile* file, size_t buffer_bytes)
       pos_(buf_),
       limit_(buf_) {}
 
+InputBuffer::InputBuffer(RandomAccessFile* file, size_t buffer_bytes,
+                         thread::ThreadPool* readahead_pool)
+    : InputBuffer(file, buffer_bytes) {
+  readahead_pool_ = readahead_pool;
+  if (readahead_pool_ != nullptr) {
+    next_buf_ = new char[size_];
+  }
+}
+
 InputBuffer::~InputBuffer() {
+  if (readahead_started_) {
+    mutex_lock l(mu_);
+    while (readahead_pending_) {
+      readahead_done_.wait(l);
+    }
+  }
   delete[] buf_;
+  delete[] next_buf_;
+}
+
+void InputBuffer::StartReadahead() {
+  {
+    mutex_lock l(mu_);
+    readahead_pending_ = true;
+  }
+  readahead_started_ = true;
+  const int64 offset = file_pos_;
+  char* buf = next_buf_;
+  readahead_pool_->Schedule([this, offset, buf]() {
+    StringPiece data;
+    Status s = file_->Read(offset, size_, &data, buf);
+    if (data.data() != buf) {
+      memmove(buf, data.data(), data.size());
+    }
+    // Notifies under the lock, since the destructor may run as soon as the
+    // lock is released.
+    mutex_lock l(mu_);
+    readahead_bytes_ = data.size();
+    readahead_status_ = s;
+    readahead_pending_ = false;
+    readahead_done_.notify_all();
+  });
 }
 
 Status InputBuffer::FillBuffer() {
+  if (readahead_pool_ != nullptr) {
+    if (!readahead_started_) {
+      StartReadahead();
+    }
+    size_t bytes;
+    Status s;
+    {
+      mutex_lock l(mu_);
+      while (readahead_pending_) {
+        readahead_done_.wait(l);
+      }
+      bytes = readahead_bytes_;
+      s = readahead_status_;
+    }
+    readahead_started_ = false;
+    std::swap(buf_, next_buf_);
+    pos_ = buf_;
+    limit_ = pos_ + bytes;
+    file_pos_ += bytes;
+    // A short or failed read ends the readahead; the next fill reads again
+    // from "file_pos_", as without readahead.
+    if (s.ok() && bytes == size_) {
+      StartReadahead();
+    }
+    return s;
+  }
+
   StringPiece data;
   Status s = file_->Read(file_pos_, size_, &data, buf_);
   if (data.data() != buf_) {
@@ -18,8 +18,10 @@ limitations under the License.
 
 #include <string>
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
@@ -33,6 +35,13 @@ class InputBuffer {
   // Create an InputBuffer for "file" with a buffer size of
   // "buffer_bytes" bytes.  'file' must outlive *this.
   InputBuffer(RandomAccessFile* file, size_t buffer_bytes);
+
+  // Create an InputBuffer for "file" that reads blocks of "buffer_bytes"
+  // bytes ahead, in "readahead_pool": the next block is read into a second
+  // buffer while the current one is consumed.  Reads from 'file' run on the
+  // pool, one at a time.  'file' and 'readahead_pool' must outlive *this.
+  InputBuffer(RandomAccessFile* file, size_t buffer_bytes,
+              thread::ThreadPool* readahead_pool);
   ~InputBuffer();
 
   // Read one text line of data into "*result" until end-of-file or a
@@ -60,6 +69,10 @@ class InputBuffer {
  private:
   Status FillBuffer();
 
+  // Starts reading the block at "file_pos_" into "next_buf_" in
+  // "readahead_pool_".
+  void StartReadahead();
+
   RandomAccessFile* file_;  // Not owned
   int64 file_pos_;          // Next position to read from in "file_"
   size_t size_;             // Size of "buf_"
@@ -68,6 +81,19 @@ class InputBuffer {
   char* pos_;    // Current position in "buf"
   char* limit_;  // Just past end of valid data in "buf"
 
+  // With readahead, the block just past "file_pos_" is being read into
+  // "next_buf_" while "readahead_started_", and once "!readahead_pending_"
+  // its size and the read status are in "readahead_bytes_" and
+  // "readahead_status_".
+  thread::ThreadPool* readahead_pool_ = nullptr;  // Not owned
+  char* next_buf_ = nullptr;
+  bool readahead_started_ = false;
+  mutex mu_;
+  condition_variable readahead_done_;
+  bool readahead_pending_ GUARDED_BY(mu_) = false;
+  size_t readahead_bytes_ GUARDED_BY(mu_) = 0;
+  Status readahead_status_ GUARDED_BY(mu_);
+
   TF_DISALLOW_COPY_AND_ASSIGN(InputBuffer);
 };
 
@@ -21,6 +21,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/test.h"
@@ -212,4 +213,43 @@ TEST(InputBuffer, SkipNBytes) {
   }
 }
 
+TEST(InputBuffer, Readahead) {
+  Env* env = Env::Default();
+  string fname = testing::TmpDir() + "/inputbuffer_test";
+  WriteStringToFile(env, fname, "line one\nline two\n0123456789");
+  thread::ThreadPool pool(env, "readahead", 2);
+
+  for (auto buf_size : BufferSizes()) {
+    std::unique_ptr<RandomAccessFile> file;
+    TF_CHECK_OK(env->NewRandomAccessFile(fname, &file));
+    string read;
+    io::InputBuffer in(file.get(), buf_size, &pool);
+    TF_CHECK_OK(in.ReadLine(&read));
+    EXPECT_EQ(read, "line one");
+    EXPECT_EQ(9, in.Tell());
+    TF_CHECK_OK(in.SkipNBytes(5));
+    TF_CHECK_OK(in.ReadLine(&read));
+    EXPECT_EQ(read, "two");
+    EXPECT_EQ(18, in.Tell());
+    TF_CHECK_OK(in.ReadNBytes(7, &read));
+    EXPECT_EQ(read, "0123456");
+    EXPECT_EQ(25, in.Tell());
+    EXPECT_TRUE(errors::IsOutOfRange(in.ReadNBytes(5, &read)));
+    EXPECT_EQ(read, "789");
+    EXPECT_EQ(28, in.Tell());
+    EXPECT_TRUE(errors::IsOutOfRange(in.ReadLine(&read)));
+    EXPECT_EQ(28, in.Tell());
+  }
+
+  // Destroying a buffer waits for the block being read ahead.
+  for (auto buf_size : BufferSizes()) {
+    std::unique_ptr<RandomAccessFile> file;
+    TF_CHECK_OK(env->NewRandomAccessFile(fname, &file));
+    string read;
+    io::InputBuffer in(file.get(), buf_size, &pool);
+    TF_CHECK_OK(in.ReadNBytes(1, &read));
+    EXPECT_EQ(read, "l");
+  }
+}
+
 }  // namespace tensorflow
@@ -44,6 +44,13 @@ RecordReader::RecordReader(RandomAccessFile* file,
   }
 }
 
+RecordReader::RecordReader(ReadOnlyMemoryRegion* region,
+                           const RecordReaderOptions& options)
+    : region_(region), options_(options) {
+  CHECK_EQ(options.compression_type, RecordReaderOptions::NONE)
+      << "Compression of mapped records is unsupported.";
+}
+
 RecordReader::~RecordReader() {}
 
 // Read n+4 bytes from file, verify that checksum of first n bytes is
@@ -56,6 +63,24 @@ Status RecordReader::ReadChecksummed(uint64 offset, size_t n,
   }
 
   const size_t expected = n + sizeof(uint32);
+  if (region_ != nullptr) {
+    // The record is checked in place in the mapped file.
+    if (offset >= region_->length()) {
+      return errors::OutOfRange("eof");
+    }
+    if (region_->length() - offset < expected) {
+      return errors::DataLoss("truncated record at ", offset);
+    }
+    const char* data = static_cast<const char*>(region_->data()) + offset;
+    if (options_.verify_checksums) {
+      uint32 masked_crc = core::DecodeFixed32(data + n);
+      if (crc32c::Unmask(masked_crc) != crc32c::Value(data, n)) {
+        return errors::DataLoss("corrupted record at ", offset);
+      }
+    }
+    *result = StringPiece(data, n);
+    return Status::OK();
+  }
   storage->resize(expected);
 
 #if !defined(IS_SLIM_BUILD)
@@ -78,7 +103,8 @@ Status RecordReader::ReadChecksummed(uint64 offset, size_t n,
     }
 
     uint32 masked_crc = core::DecodeFixed32(storage->data() + n);
-    if (crc32c::Unmask(masked_crc) != crc32c::Value(storage->data(), n)) {
+    if (options_.verify_checksums &&
+        crc32c::Unmask(masked_crc) != crc32c::Value(storage->data(), n)) {
       return errors::DataLoss("corrupted record at ", offset);
     }
     *result = StringPiece(storage->data(), n);
@@ -96,7 +122,8 @@ Status RecordReader::ReadChecksummed(uint64 offset, size_t n,
       }
     }
     uint32 masked_crc = core::DecodeFixed32(data.data() + n);
-    if (crc32c::Unmask(masked_crc) != crc32c::Value(data.data(), n)) {
+    if (options_.verify_checksums &&
+        crc32c::Unmask(masked_crc) != crc32c::Value(data.data(), n)) {
       return errors::DataLoss("corrupted record at ", offset);
     }
     *result = StringPiece(data.data(), n);
@@ -140,5 +167,33 @@ Status RecordReader::ReadRecord(uint64* offset, string* record) {
   return Status::OK();
 }
 
+Status RecordReader::ReadRecord(uint64* offset, StringPiece* record) {
+  if (region_ == nullptr) {
+    TF_RETURN_IF_ERROR(ReadRecord(offset, &storage_));
+    *record = storage_;
+    return Status::OK();
+  }
+  static const size_t kHeaderSize = sizeof(uint64) + sizeof(uint32);
+  static const size_t kFooterSize = sizeof(uint32);
+
+  // Read header data.
+  StringPiece lbuf;
+  TF_RETURN_IF_ERROR(
+      ReadChecksummed(*offset, sizeof(uint64), &lbuf, &storage_));
+  const uint64 length = core::DecodeFixed64(lbuf.data());
+
+  // Read data
+  Status s = ReadChecksummed(*offset + kHeaderSize, length, record, &storage_);
+  if (!s.ok()) {
+    if (errors::IsOutOfRange(s)) {
+      s = errors::DataLoss("truncated record at ", *offset);
+    }
+    return s;
+  }
+
+  *offset += kHeaderSize + length + kFooterSize;
+  return Status::OK();
+}
+
 }  // namespace io
 }  // namespace tensorflow
@@ -29,6 +29,7 @@ limitations under the License.
 namespace tensorflow {
 
 class RandomAccessFile;
+class ReadOnlyMemoryRegion;
 
 namespace io {
 
@@ -37,6 +38,11 @@ class RecordReaderOptions {
   enum CompressionType { NONE = 0, ZLIB_COMPRESSION = 1 };
   CompressionType compression_type = NONE;
 
+  // Whether the checksums of the records are verified. Turning this off
+  // saves reading every byte of the records that are skipped, but corrupted
+  // records are then returned instead of reported.
+  bool verify_checksums = true;
+
 #if !defined(IS_SLIM_BUILD)
   // Options specific to zlib compression.
   ZlibCompressionOptions zlib_options;
@@ -50,6 +56,13 @@ class RecordReader {
   RecordReader(RandomAccessFile* file,
                const RecordReaderOptions& options = RecordReaderOptions());
 
+  // Create a reader that will return log records from the file mapped by
+  // "*region", without copying them. "*region" must remain live while this
+  // Reader or the records it returned are in use. Compression is not
+  // supported.
+  RecordReader(ReadOnlyMemoryRegion* region,
+               const RecordReaderOptions& options = RecordReaderOptions());
+
   virtual ~RecordReader();
 
   // Read the record at "*offset" into *record and update *offset to
@@ -57,11 +70,21 @@ class RecordReader {
   // OUT_OF_RANGE for end of file, or something else for an error.
   Status ReadRecord(uint64* offset, string* record);
 
+  // Like above, but "*record" points to the record in the mapped region of
+  // the reader, or in a buffer of the reader if it reads from a file. The
+  // record is valid until the next read in the latter case.
+  Status ReadRecord(uint64* offset, StringPiece* record);
+
  private:
   Status ReadChecksummed(uint64 offset, size_t n, StringPiece* result,
                          string* storage);
 
-  RandomAccessFile* src_;
+  RandomAccessFile* src_ = nullptr;
+  ReadOnlyMemoryRegion* region_ = nullptr;
+
+  // Buffer of the records read from src_ as StringPieces.
+  string storage_;
+
   RecordReaderOptions options_;
 #if !defined(IS_SLIM_BUILD)
   std::unique_ptr<ZlibInputBuffer> zlib_input_buffer_;
@@ -13,6 +13,8 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include <vector>
+
 #include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -252,6 +254,85 @@ TEST_F(RecordioTest, CorruptDataCrc) {
   AssertHasSubstr(Read(), "Data loss");
 }
 
+// A region mapping the contents of a string.
+class StringRegion : public ReadOnlyMemoryRegion {
+ public:
+  explicit StringRegion(const string* contents) : contents_(contents) {}
+  const void* data() override { return contents_->data(); }
+  uint64 length() override { return contents_->size(); }
+
+ private:
+  const string* contents_;
+};
+
+// Writes the given records and returns the file contents.
+static string WriteRecords(const std::vector<string>& records) {
+  class StringDest : public WritableFile {
+   public:
+    string contents_;
+    Status Close() override { return Status::OK(); }
+    Status Flush() override { return Status::OK(); }
+    Status Sync() override { return Status::OK(); }
+    Status Append(const StringPiece& slice) override {
+      contents_.append(slice.data(), slice.size());
+      return Status::OK();
+    }
+  };
+  StringDest dest;
+  RecordWriter writer(&dest);
+  for (const string& record : records) {
+    TF_CHECK_OK(writer.WriteRecord(record));
+  }
+  return dest.contents_;
+}
+
+TEST(RecordReaderTest, ReadsMappedRecordsInPlace) {
+  const std::vector<string> records = {"foo", "", BigString("x", 10000), "bar"};
+  const string contents = WriteRecords(records);
+  StringRegion region(&contents);
+  RecordReader reader(&region);
+  uint64 offset = 0;
+  StringPiece record;
+  for (const string& expected : records) {
+    TF_ASSERT_OK(reader.ReadRecord(&offset, &record));
+    EXPECT_EQ(expected, record);
+    EXPECT_GE(record.data(), contents.data());
+    EXPECT_LE(record.data() + record.size(), contents.data() + contents.size());
+  }
+  EXPECT_EQ(contents.size(), offset);
+  EXPECT_TRUE(errors::IsOutOfRange(reader.ReadRecord(&offset, &record)));
+  offset += 5;
+  EXPECT_TRUE(errors::IsOutOfRange(reader.ReadRecord(&offset, &record)));
+
+  // The string version reads the same records.
+  offset = 0;
+  string copy;
+  TF_ASSERT_OK(reader.ReadRecord(&offset, &copy));
+  EXPECT_EQ("foo", copy);
+}
+
+TEST(RecordReaderTest, ChecksMappedRecords) {
+  string contents = WriteRecords({"foo"});
+  contents[14] += 10;
+  StringRegion region(&contents);
+  uint64 offset = 0;
+  StringPiece record;
+  RecordReader reader(&region);
+  EXPECT_TRUE(errors::IsDataLoss(reader.ReadRecord(&offset, &record)));
+
+  // Without checksums, the corrupted record is returned.
+  RecordReaderOptions options;
+  options.verify_checksums = false;
+  RecordReader unchecked(&region, options);
+  TF_ASSERT_OK(unchecked.ReadRecord(&offset, &record));
+  EXPECT_EQ("foy", record);
+
+  // Truncated records are reported either way.
+  contents.resize(contents.size() - 1);
+  offset = 0;
+  EXPECT_TRUE(errors::IsDataLoss(unchecked.ReadRecord(&offset, &record)));
+}
+
 TEST_F(RecordioTest, ReadEnd) { CheckOffsetPastEndReturnsNoRecords(0); }
 
 TEST_F(RecordioTest, ReadPastEnd) { CheckOffsetPastEndReturnsNoRecords(5); }
@@ -18,6 +18,9 @@ limitations under the License.
 #include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/io/block.h"
+#include "tensorflow/core/lib/io/cache.h"
+#include "tensorflow/core/lib/io/filter_block.h"
+#include "tensorflow/core/lib/io/filter_policy.h"
 #include "tensorflow/core/lib/io/format.h"
 #include "tensorflow/core/lib/io/table_options.h"
 #include "tensorflow/core/lib/io/two_level_iterator.h"
@@ -27,12 +30,18 @@ namespace tensorflow {
 namespace table {
 
 struct Table::Rep {
-  ~Rep() { delete index_block; }
+  ~Rep() {
+    delete filter;
+    delete[] filter_data;
+    delete index_block;
+  }
 
   Options options;
   Status status;
   RandomAccessFile* file;
-  // XXX  uint64 cache_id;
+  uint64 cache_id;
+  FilterBlockReader* filter = nullptr;
+  const char* filter_data = nullptr;
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
   Block* index_block;
@@ -73,9 +82,9 @@ Status Table::Open(const Options& options, RandomAccessFile* file, uint64 size,
     rep->file = file;
     rep->metaindex_handle = footer.metaindex_handle();
     rep->index_block = index_block;
-    // XXX    rep->cache_id = (options.block_cache ?
-    // options.block_cache->NewId() : 0);
+    rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
     *table = new Table(rep);
+    (*table)->ReadMeta(footer);
   } else {
     if (index_block) delete index_block;
   }
@@ -83,19 +92,70 @@ Status Table::Open(const Options& options, RandomAccessFile* file, uint64 size,
   return s;
 }
 
+void Table::ReadMeta(const Footer& footer) {
+  if (rep_->options.filter_policy == nullptr) {
+    return;  // Do not need any metadata
+  }
+
+  BlockContents contents;
+  if (!ReadBlock(rep_->file, footer.metaindex_handle(), &contents).ok()) {
+    // Do not propagate errors since meta info is not needed for operation
+    return;
+  }
+  Block* meta = new Block(contents);
+
+  Iterator* iter = meta->NewIterator();
+  string key = "filter.";
+  key.append(rep_->options.filter_policy->Name());
+  iter->Seek(key);
+  if (iter->Valid() && iter->key() == StringPiece(key)) {
+    ReadFilter(iter->value());
+  }
+  delete iter;
+  delete meta;
+}
+
+void Table::ReadFilter(const StringPiece& filter_handle_value) {
+  StringPiece v = filter_handle_value;
+  BlockHandle filter_handle;
+  if (!filter_handle.DecodeFrom(&v).ok()) {
+    return;
+  }
+
+  BlockContents block;
+  if (!ReadBlock(rep_->file, filter_handle, &block).ok()) {
+    return;
+  }
+  if (block.heap_allocated) {
+    rep_->filter_data = block.data.data();  // Will need to delete later
+  }
+  rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
+}
+
 Table::~Table() { delete rep_; }
 
 static void DeleteBlock(void* arg, void* ignored) {
   delete reinterpret_cast<Block*>(arg);
 }
 
+static void DeleteCachedBlock(const StringPiece& key, void* value) {
+  Block* block = reinterpret_cast<Block*>(value);
+  delete block;
+}
+
+static void ReleaseBlock(void* arg, void* h) {
+  Cache* cache = reinterpret_cast<Cache*>(arg);
+  Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
+  cache->Release(handle);
+}
+
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg, const StringPiece& index_value) {
   Table* table = reinterpret_cast<Table*>(arg);
-  //  Cache* block_cache = table->rep_->options.block_cache;
+  Cache* block_cache = table->rep_->options.block_cache;
   Block* block = NULL;
-  //  Cache::Handle* cache_handle = NULL;
+  Cache::Handle* cache_handle = NULL;
 
   BlockHandle handle;
   StringPiece input = index_value;
@@ -105,16 +165,40 @@ Iterator* Table::BlockReader(void* arg, const StringPiece& index_value) {
 
   if (s.ok()) {
     BlockContents contents;
-    s = ReadBlock(table->rep_->file, handle, &contents);
-    if (s.ok()) {
-      block = new Block(contents);
+    if (block_cache != NULL) {
+      char cache_key_buffer[16];
+      core::EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
+      core::EncodeFixed64(cache_key_buffer + 8, handle.offset());
+      StringPiece key(cache_key_buffer, sizeof(cache_key_buffer));
+      cache_handle = block_cache->Lookup(key);
+      if (cache_handle != NULL) {
+        block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
+      } else {
+        s = ReadBlock(table->rep_->file, handle, &contents);
+        if (s.ok()) {
+          block = new Block(contents);
+          if (contents.cachable) {
+            cache_handle = block_cache->Insert(key, block, block->size(),
+                                               &DeleteCachedBlock);
+          }
+        }
+      }
+    } else {
+      s = ReadBlock(table->rep_->file, handle, &contents);
+      if (s.ok()) {
+        block = new Block(contents);
+      }
     }
   }
 
   Iterator* iter;
   if (block != NULL) {
     iter = block->NewIterator();
-    iter->RegisterCleanup(&DeleteBlock, block, NULL);
+    if (cache_handle == NULL) {
+      iter->RegisterCleanup(&DeleteBlock, block, NULL);
+    } else {
+      iter->RegisterCleanup(&ReleaseBlock, block_cache, cache_handle);
+    }
   } else {
     iter = NewErrorIterator(s);
   }
@@ -128,19 +212,27 @@ Iterator* Table::NewIterator() const {
 
 Status Table::InternalGet(const StringPiece& k, void* arg,
                           void (*saver)(void*, const StringPiece&,
-                                        const StringPiece&)) {
+                                        const StringPiece&)) const {
   Status s;
   Iterator* iiter = rep_->index_block->NewIterator();
   iiter->Seek(k);
   if (iiter->Valid()) {
+    StringPiece handle_value = iiter->value();
+    FilterBlockReader* filter = rep_->filter;
     BlockHandle handle;
-    Iterator* block_iter = BlockReader(this, iiter->value());
-    block_iter->Seek(k);
-    if (block_iter->Valid()) {
-      (*saver)(arg, block_iter->key(), block_iter->value());
+    if (filter != NULL && handle.DecodeFrom(&handle_value).ok() &&
+        !filter->KeyMayMatch(handle.offset(), k)) {
+      // Not found
+    } else {
+      Iterator* block_iter =
+          BlockReader(const_cast<Table*>(this), iiter->value());
+      block_iter->Seek(k);
+      if (block_iter->Valid()) {
+        (*saver)(arg, block_iter->key(), block_iter->value());
+      }
+      s = block_iter->status();
+      delete block_iter;
     }
-    s = block_iter->status();
-    delete block_iter;
   }
   if (s.ok()) {
     s = iiter->status();
@@ -149,6 +241,33 @@ Status Table::InternalGet(const StringPiece& k, void* arg,
   return s;
 }
 
+namespace {
+
+struct GetResult {
+  StringPiece key;
+  string* value;
+  bool found;
+};
+
+void SaveValue(void* arg, const StringPiece& k, const StringPiece& v) {
+  GetResult* result = reinterpret_cast<GetResult*>(arg);
+  if (k == result->key) {
+    result->value->assign(v.data(), v.size());
+    result->found = true;
+  }
+}
+
+}  // namespace
+
+Status Table::Get(const StringPiece& key, string* value) const {
+  GetResult result = {key, value, false};
+  Status s = InternalGet(key, &result, &SaveValue);
+  if (s.ok() && !result.found) {
+    return errors::NotFound("Key not found in table");
+  }
+  return s;
+}
+
 uint64 Table::ApproximateOffsetOf(const StringPiece& key) const {
   Iterator* index_iter = rep_->index_block->NewIterator();
   index_iter->Seek(key);
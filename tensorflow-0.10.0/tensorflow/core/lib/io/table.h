@@ -62,6 +62,11 @@ class Table {
   // be close to the file length.
   uint64 ApproximateOffsetOf(const StringPiece& key) const;
 
+  // Looks up "key".  If the table holds it, stores its value in "*value"
+  // and returns ok.  Otherwise returns a NOT_FOUND error, without reading
+  // a data block if the filter of the table rules the key out.
+  Status Get(const StringPiece& key, string* value) const;
+
  private:
   struct Rep;
   Rep* rep_;
@@ -74,7 +79,13 @@ class Table {
   // that key is not present.
   Status InternalGet(const StringPiece& key, void* arg,
                      void (*handle_result)(void* arg, const StringPiece& k,
-                                           const StringPiece& v));
+                                           const StringPiece& v)) const;
+
+  // Reads the filter of the table named by the metaindex block, if the
+  // options have a filter policy.  Errors are ignored, since the filter
+  // is only an optimization.
+  void ReadMeta(const Footer& footer);
+  void ReadFilter(const StringPiece& filter_handle_value);
 
   // No copying allowed
   Table(const Table&);
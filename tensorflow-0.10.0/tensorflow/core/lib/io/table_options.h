@@ -21,6 +21,9 @@ limitations under the License.
 namespace tensorflow {
 namespace table {
 
+class Cache;
+class FilterPolicy;
+
 // DB contents are stored in a set of blocks, each of which holds a
 // sequence of key,value pairs.  Each block may be compressed before
 // being stored in a file.  The following enum describes which
@@ -60,6 +63,23 @@ struct Options {
   // incompressible, the kSnappyCompression implementation will
   // efficiently detect that and will switch to uncompressed mode.
   CompressionType compression = kSnappyCompression;
+
+  // If non-NULL, use the specified filter policy to reduce disk reads.
+  // A table built with a filter policy stores a filter for its data
+  // blocks, which Table::Get() consults to skip the blocks that cannot
+  // hold the key.  Tables must be opened with a policy of the same name
+  // for their filters to be used.  Many applications will benefit from
+  // passing the result of NewBloomFilterPolicy() here.
+  //
+  // Not owned.  Default: NULL
+  const FilterPolicy* filter_policy = nullptr;
+
+  // If non-NULL, use the specified cache for the data blocks read by
+  // tables opened with these options.  A cache may be shared by several
+  // tables, see NewLRUCache().
+  //
+  // Not owned.  Default: NULL
+  Cache* block_cache = nullptr;
 };
 
 }  // namespace table
@@ -17,16 +17,21 @@ limitations under the License.
 
 #include <algorithm>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/block.h"
 #include "tensorflow/core/lib/io/block_builder.h"
+#include "tensorflow/core/lib/io/cache.h"
+#include "tensorflow/core/lib/io/filter_policy.h"
 #include "tensorflow/core/lib/io/format.h"
 #include "tensorflow/core/lib/io/iterator.h"
 #include "tensorflow/core/lib/io/table_builder.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/snappy.h"
 #include "tensorflow/core/platform/test.h"
@@ -620,5 +625,88 @@ TEST(TableTest, SeekToFirstKeyDoesNotReadTooMuch) {
   EXPECT_LT(c.BytesRead(), 200);
 }
 
+// Builds a table of the keys k00000, k00002, ..., k01998.
+static string BuildEvenKeysTable(const Options& options) {
+  StringSink sink;
+  TableBuilder builder(options, &sink);
+  for (int i = 0; i < 1000; i++) {
+    builder.Add(strings::Printf("k%05d", 2 * i), string(100, 'a' + i % 26));
+  }
+  TF_CHECK_OK(builder.Finish());
+  return sink.contents();
+}
+
+TEST(TableTest, FilterSkipsMissingKeys) {
+  std::unique_ptr<const FilterPolicy> policy(NewBloomFilterPolicy(10));
+  Options options;
+  options.block_size = 256;
+  options.compression = kNoCompression;
+  options.filter_policy = policy.get();
+  StringSource source(BuildEvenKeysTable(options));
+  Table* table;
+  TF_ASSERT_OK(Table::Open(options, &source, source.Size(), &table));
+  std::unique_ptr<Table> table_deleter(table);
+
+  string value;
+  for (int i = 0; i < 1000; i++) {
+    TF_ASSERT_OK(table->Get(strings::Printf("k%05d", 2 * i), &value));
+    EXPECT_EQ(string(100, 'a' + i % 26), value);
+  }
+
+  // With ~1% false positives, few of the misses read a data block, while
+  // each of them would read one without the filter.
+  const uint64 bytes_read = source.BytesRead();
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_TRUE(
+        errors::IsNotFound(table->Get(strings::Printf("k%05d", 2 * i + 1),
+                                      &value)));
+  }
+  EXPECT_TRUE(errors::IsNotFound(table->Get("zzz", &value)));
+  EXPECT_LT(source.BytesRead() - bytes_read, 100 * 512);
+}
+
+TEST(TableTest, FilterIsOptionalWhenReading) {
+  std::unique_ptr<const FilterPolicy> policy(NewBloomFilterPolicy(10));
+  Options options;
+  options.compression = kNoCompression;
+  options.filter_policy = policy.get();
+  StringSource source(BuildEvenKeysTable(options));
+  Table* table;
+  TF_ASSERT_OK(Table::Open(Options(), &source, source.Size(), &table));
+  std::unique_ptr<Table> table_deleter(table);
+  string value;
+  TF_ASSERT_OK(table->Get("k00010", &value));
+  EXPECT_EQ(string(100, 'f'), value);
+  EXPECT_TRUE(errors::IsNotFound(table->Get("k00011", &value)));
+}
+
+TEST(TableTest, BlockCacheAvoidsRereads) {
+  std::unique_ptr<Cache> cache(NewLRUCache(1 << 20));
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  options.block_cache = cache.get();
+  StringSource source(BuildEvenKeysTable(options));
+  Table* table;
+  TF_ASSERT_OK(Table::Open(options, &source, source.Size(), &table));
+  std::unique_ptr<Table> table_deleter(table);
+
+  string value;
+  for (int i = 0; i < 1000; i++) {
+    TF_ASSERT_OK(table->Get(strings::Printf("k%05d", 2 * i), &value));
+  }
+  const uint64 bytes_read = source.BytesRead();
+  EXPECT_GT(cache->TotalCharge(), 100000);
+  for (int i = 0; i < 1000; i++) {
+    TF_ASSERT_OK(table->Get(strings::Printf("k%05d", 2 * i), &value));
+    EXPECT_EQ(string(100, 'a' + i % 26), value);
+  }
+  std::unique_ptr<Iterator> iter(table->NewIterator());
+  int count = 0;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) count++;
+  EXPECT_EQ(1000, count);
+  EXPECT_EQ(bytes_read, source.BytesRead());
+}
+
 }  // namespace table
 }  // namespace tensorflow
@@ -91,9 +91,14 @@ class Counter {
  private:
   explicit Counter(
       const MetricDef<MetricKind::CUMULATIVE, int64, NumLabels>& metric_def)
-      : metric_def_(metric_def),
-        registration_handle_(
-            ExportRegistry::Default()->Register(&metric_def_)) {}
+      : metric_def_(metric_def) {
+    // Registered once the cells exist, since exporting reads them.
+    registration_handle_ = ExportRegistry::Default()->Register(
+        &metric_def_, [this](MetricExporter* exporter) { Collect(exporter); });
+  }
+
+  // Passes the value of each cell to the exporter.
+  void Collect(MetricExporter* exporter) const LOCKS_EXCLUDED(mu_);
 
   mutable mutex mu_;
 
@@ -126,6 +131,16 @@ inline void CounterCell::IncrementBy(const int64 step) {
 
 inline int64 CounterCell::value() const { return value_; }
 
+template <int NumLabels>
+void Counter<NumLabels>::Collect(MetricExporter* const exporter) const {
+  mutex_lock l(mu_);
+  for (const auto& labels_and_cell : cells_) {
+    const LabelArray& labels = labels_and_cell.first;
+    exporter->Export(metric_def_, {labels.begin(), labels.end()},
+                     labels_and_cell.second.value());
+  }
+}
+
 template <int NumLabels>
 template <typename... Labels>
 CounterCell* Counter<NumLabels>::GetCell(const Labels&... labels)
@@ -26,24 +26,28 @@ ExportRegistry* ExportRegistry::Default() {
 }
 
 std::unique_ptr<ExportRegistry::RegistrationHandle> ExportRegistry::Register(
-    const AbstractMetricDef* const metric_def) {
+    const AbstractMetricDef* const metric_def,
+    const CollectFunction& collect) {
   mutex_lock l(mu_);
 
-  LOG(INFO) << "Here." << registry_.size();
   const auto found_it = registry_.find(metric_def->name());
   if (found_it != registry_.end()) {
-    LOG(INFO) << "Here2";
     LOG(FATAL) << "Cannot register 2 metrics with the same name: "
                << metric_def->name();
   }
-  LOG(INFO) << "Here3";
-  registry_.insert({metric_def->name(), metric_def});
-  LOG(INFO) << "Here4." << registry_.size();
+  registry_.insert({metric_def->name(), {metric_def, collect}});
 
   return std::unique_ptr<RegistrationHandle>(
       new RegistrationHandle(this, metric_def));
 }
 
+void ExportRegistry::Export(MetricExporter* const exporter) const {
+  mutex_lock l(mu_);
+  for (const auto& name_and_entry : registry_) {
+    if (name_and_entry.second.collect) name_and_entry.second.collect(exporter);
+  }
+}
+
 void ExportRegistry::Unregister(const AbstractMetricDef* const metric_def) {
   mutex_lock l(mu_);
   registry_.erase(metric_def->name());
@@ -16,18 +16,44 @@ limitations under the License.
 #ifndef THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_EXPORT_REGISTRY_H_
 #define THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_EXPORT_REGISTRY_H_
 
+#include <functional>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/monitoring/metric_def.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
 
 namespace tensorflow {
+
+class HistogramProto;
+
 namespace monitoring {
 
+// An exporter receives the values of the registered metrics, one call per
+// cell, when it is passed to ExportRegistry::Export(). Implementations decide
+// where the values go, e.g. to a log, a monitoring service or a test.
+//
+// The labels are the label values of the cell, in the order of the label
+// descriptions of the metric definition.
+class MetricExporter {
+ public:
+  virtual ~MetricExporter() {}
+
+  virtual void Export(const AbstractMetricDef& metric_def,
+                      const std::vector<string>& labels, int64 value) = 0;
+  virtual void Export(const AbstractMetricDef& metric_def,
+                      const std::vector<string>& labels,
+                      const string& value) = 0;
+  virtual void Export(const AbstractMetricDef& metric_def,
+                      const std::vector<string>& labels,
+                      const HistogramProto& value) = 0;
+};
+
 // An export registry for metrics.
 //
 // Metrics are registered here so that their state can be exported later using
@@ -43,16 +69,25 @@ class ExportRegistry {
   // This registry belongs to this library and should never be deleted.
   static ExportRegistry* Default();
 
+  // Passes the values of the metric to an exporter. Called under the lock of
+  // the registry, so it must not register or unregister metrics.
+  using CollectFunction = std::function<void(MetricExporter*)>;
+
   // Registers the metric and returns a Registration object. The destruction of
   // the registration object would cause the metric to be unregistered from this
-  // registry.
+  // registry. The values of the metric are exported through collect, if given.
   //
   // IMPORTANT: Delete the handle before the metric-def is deleted.
   class RegistrationHandle;
   std::unique_ptr<RegistrationHandle> Register(
-      const AbstractMetricDef* metric_def)
+      const AbstractMetricDef* metric_def,
+      const CollectFunction& collect = CollectFunction())
       LOCKS_EXCLUDED(mu_) TF_MUST_USE_RESULT;
 
+  // Passes the values of all the registered metrics to the exporter, in the
+  // order of their names.
+  void Export(MetricExporter* exporter) const LOCKS_EXCLUDED(mu_);
+
  private:
   ExportRegistry() = default;
 
@@ -61,8 +96,13 @@ class ExportRegistry {
   // this upon destruction.
   void Unregister(const AbstractMetricDef* metric_def) LOCKS_EXCLUDED(mu_);
 
+  struct Entry {
+    const AbstractMetricDef* metric_def;
+    CollectFunction collect;
+  };
+
   mutable mutex mu_;
-  std::map<StringPiece, const AbstractMetricDef*> registry_ GUARDED_BY(mu_);
+  std::map<StringPiece, Entry> registry_ GUARDED_BY(mu_);
 };
 
 ////
@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/lib/monitoring/export_registry.h"
 
+#include "tensorflow/core/framework/summary.pb.h"
 #include "tensorflow/core/platform/test.h"
 
 namespace tensorflow {
@@ -44,6 +45,58 @@ TEST(ExportRegistryTest, RegistrationUnregistration) {
   }
 }
 
+// Records the names and int64 values it is passed.
+class RecordingExporter : public MetricExporter {
+ public:
+  void Export(const AbstractMetricDef& metric_def,
+              const std::vector<string>& labels, const int64 value) override {
+    values.emplace_back(metric_def.name().ToString(), value);
+  }
+  void Export(const AbstractMetricDef& metric_def,
+              const std::vector<string>& labels,
+              const string& value) override {}
+  void Export(const AbstractMetricDef& metric_def,
+              const std::vector<string>& labels,
+              const HistogramProto& value) override {}
+
+  std::vector<std::pair<string, int64>> values;
+};
+
+TEST(ExportRegistryTest, Export) {
+  auto* export_registry = ExportRegistry::Default();
+  const MetricDef<MetricKind::GAUGE, int64, 0> metric_def0(
+      "/tensorflow/export/metric0", "An exported metric.");
+  const MetricDef<MetricKind::GAUGE, int64, 0> metric_def1(
+      "/tensorflow/export/metric1", "Another exported metric.");
+  const MetricDef<MetricKind::GAUGE, int64, 0> metric_def2(
+      "/tensorflow/export/metric2", "A metric without values to export.");
+  {
+    auto handle1 = export_registry->Register(
+        &metric_def1, [&metric_def1](MetricExporter* exporter) {
+          exporter->Export(metric_def1, {}, 1);
+        });
+    auto handle0 = export_registry->Register(
+        &metric_def0, [&metric_def0](MetricExporter* exporter) {
+          exporter->Export(metric_def0, {}, 0);
+        });
+    auto handle2 = export_registry->Register(&metric_def2);
+
+    RecordingExporter exporter;
+    export_registry->Export(&exporter);
+    std::vector<std::pair<string, int64>> exported;
+    for (const auto& name_and_value : exporter.values) {
+      const StringPiece name = name_and_value.first;
+      if (name.starts_with("/tensorflow/export/")) {
+        exported.push_back(name_and_value);
+      }
+    }
+    EXPECT_EQ((std::vector<std::pair<string, int64>>{
+                  {"/tensorflow/export/metric0", 0},
+                  {"/tensorflow/export/metric1", 1}}),
+              exported);
+  }
+}
+
 TEST(ExportRegistryDeathTest, DuplicateRegistration) {
   auto* export_registry = ExportRegistry::Default();
   const MetricDef<MetricKind::CUMULATIVE, int64, 0> metric_def(
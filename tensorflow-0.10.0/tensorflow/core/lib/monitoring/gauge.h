@@ -0,0 +1,205 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_GAUGE_H_
+#define THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_GAUGE_H_
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <type_traits>
+
+#include "tensorflow/core/lib/monitoring/export_registry.h"
+#include "tensorflow/core/lib/monitoring/metric_def.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+// WARNING: Not yet ready for usage.
+
+namespace tensorflow {
+namespace monitoring {
+
+// GaugeCell stores each value of a Gauge.
+//
+// Like a CounterCell, a cell can be retrieved once and then set repeatedly
+// without further map-indexing computations.
+//
+// This class is thread-safe.
+template <typename ValueType>
+class GaugeCell {
+ public:
+  explicit GaugeCell(const ValueType& value) : value_(value) {}
+  ~GaugeCell() {}
+
+  // Atomically sets the value.
+  void Set(const ValueType& value) LOCKS_EXCLUDED(mu_);
+
+  // Retrieves the current value.
+  ValueType value() const LOCKS_EXCLUDED(mu_);
+
+ private:
+  mutable mutex mu_;
+  ValueType value_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(GaugeCell);
+};
+
+// GaugeCell for int64 values, which are set without locking and can also be
+// moved up and down, e.g. by the producers and consumers of a queue.
+template <>
+class GaugeCell<int64> {
+ public:
+  explicit GaugeCell(const int64 value) : value_(value) {}
+  ~GaugeCell() {}
+
+  // Atomically sets the value.
+  void Set(int64 value);
+
+  // Atomically adds step, which may be negative, to the value.
+  void IncrementBy(int64 step);
+
+  // Retrieves the current value.
+  int64 value() const;
+
+ private:
+  std::atomic<int64> value_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(GaugeCell);
+};
+
+// A stateful class for updating an instantaneous metric, like the occupancy
+// of a queue or the bytes in use of an allocator.
+//
+// This class encapsulates a set of values (or a single value for a label-less
+// metric). Each value is identified by a tuple of labels, and starts out as
+// ValueType(). ValueType is int64 or string.
+//
+// This class is thread-safe.
+template <typename ValueType, int NumLabels>
+class Gauge {
+ public:
+  ~Gauge() {
+    // Deleted here, before the metric_def is destroyed.
+    registration_handle_.reset();
+  }
+
+  // Creates the metric based on the metric-definition.
+  static Gauge* New(
+      const MetricDef<MetricKind::GAUGE, ValueType, NumLabels>& metric_def);
+
+  // Retrieves the cell for the specified labels, creating it on demand if
+  // not already present.
+  template <typename... Labels>
+  GaugeCell<ValueType>* GetCell(const Labels&... labels) LOCKS_EXCLUDED(mu_);
+
+ private:
+  explicit Gauge(
+      const MetricDef<MetricKind::GAUGE, ValueType, NumLabels>& metric_def)
+      : metric_def_(metric_def) {
+    static_assert(std::is_same<ValueType, int64>::value ||
+                      std::is_same<ValueType, string>::value,
+                  "Gauge only supports int64 and string values.");
+    // Registered once the cells exist, since exporting reads them.
+    registration_handle_ = ExportRegistry::Default()->Register(
+        &metric_def_, [this](MetricExporter* exporter) { Collect(exporter); });
+  }
+
+  // Passes the value of each cell to the exporter.
+  void Collect(MetricExporter* exporter) const LOCKS_EXCLUDED(mu_);
+
+  mutable mutex mu_;
+
+  // The metric definition. This will be used to identify the metric when we
+  // register it for exporting.
+  const MetricDef<MetricKind::GAUGE, ValueType, NumLabels> metric_def_;
+
+  std::unique_ptr<ExportRegistry::RegistrationHandle> registration_handle_;
+
+  using LabelArray = std::array<string, NumLabels>;
+  std::map<LabelArray, GaugeCell<ValueType>> cells_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(Gauge);
+};
+
+////
+//  Implementation details follow. API readers may skip.
+////
+
+template <typename ValueType>
+void GaugeCell<ValueType>::Set(const ValueType& value) {
+  mutex_lock l(mu_);
+  value_ = value;
+}
+
+template <typename ValueType>
+ValueType GaugeCell<ValueType>::value() const {
+  mutex_lock l(mu_);
+  return value_;
+}
+
+inline void GaugeCell<int64>::Set(const int64 value) { value_ = value; }
+
+inline void GaugeCell<int64>::IncrementBy(const int64 step) {
+  value_ += step;
+}
+
+inline int64 GaugeCell<int64>::value() const { return value_; }
+
+template <typename ValueType, int NumLabels>
+Gauge<ValueType, NumLabels>* Gauge<ValueType, NumLabels>::New(
+    const MetricDef<MetricKind::GAUGE, ValueType, NumLabels>& metric_def) {
+  return new Gauge<ValueType, NumLabels>(metric_def);
+}
+
+template <typename ValueType, int NumLabels>
+void Gauge<ValueType, NumLabels>::Collect(
+    MetricExporter* const exporter) const {
+  mutex_lock l(mu_);
+  for (const auto& labels_and_cell : cells_) {
+    const LabelArray& labels = labels_and_cell.first;
+    exporter->Export(metric_def_, {labels.begin(), labels.end()},
+                     labels_and_cell.second.value());
+  }
+}
+
+template <typename ValueType, int NumLabels>
+template <typename... Labels>
+GaugeCell<ValueType>* Gauge<ValueType, NumLabels>::GetCell(
+    const Labels&... labels) LOCKS_EXCLUDED(mu_) {
+  // Provides a more informative error message than the one during array
+  // construction below.
+  static_assert(sizeof...(Labels) == NumLabels,
+                "Mismatch between Gauge<ValueType, NumLabels> and number of "
+                "labels provided in GetCell(...).");
+
+  const LabelArray& label_array = {labels...};
+  mutex_lock l(mu_);
+  const auto found_it = cells_.find(label_array);
+  if (found_it != cells_.end()) {
+    return &(found_it->second);
+  }
+  return &(cells_
+               .emplace(std::piecewise_construct,
+                        std::forward_as_tuple(label_array),
+                        std::forward_as_tuple(ValueType()))
+               .first->second);
+}
+
+}  // namespace monitoring
+}  // namespace tensorflow
+
+#endif  // THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_GAUGE_H_
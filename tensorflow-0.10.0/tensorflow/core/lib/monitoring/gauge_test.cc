@@ -0,0 +1,62 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/monitoring/gauge.h"
+
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace monitoring {
+namespace {
+
+auto* gauge_with_labels =
+    Gauge<int64, 1>::New({"/tensorflow/test/gauge_with_labels",
+                          "Gauge with one label.", "One label"});
+
+TEST(LabeledGaugeTest, InitializedWithZero) {
+  EXPECT_EQ(0, gauge_with_labels->GetCell("Empty")->value());
+}
+
+TEST(LabeledGaugeTest, GetCell) {
+  auto* cell = gauge_with_labels->GetCell("GetCellOp");
+  cell->Set(42);
+  EXPECT_EQ(42, cell->value());
+
+  auto* same_cell = gauge_with_labels->GetCell("GetCellOp");
+  EXPECT_EQ(42, same_cell->value());
+
+  same_cell->IncrementBy(-50);
+  EXPECT_EQ(-8, cell->value());
+  cell->Set(7);
+  EXPECT_EQ(7, same_cell->value());
+
+  EXPECT_EQ(0, gauge_with_labels->GetCell("OtherOp")->value());
+}
+
+auto* string_gauge_without_labels = Gauge<string, 0>::New(
+    {"/tensorflow/test/string_gauge_without_labels",
+     "String gauge without any labels."});
+
+TEST(UnlabeledGaugeTest, GetCell) {
+  auto* cell = string_gauge_without_labels->GetCell();
+  EXPECT_EQ("", cell->value());
+
+  cell->Set("running");
+  EXPECT_EQ("running", string_gauge_without_labels->GetCell()->value());
+}
+
+}  // namespace
+}  // namespace monitoring
+}  // namespace tensorflow
@@ -0,0 +1,169 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/monitoring/sampler.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <vector>
+
+#include "tensorflow/core/lib/histogram/histogram.h"
+
+namespace tensorflow {
+namespace monitoring {
+namespace {
+
+// Adds value to an atomic double.
+void AtomicAdd(std::atomic<double>* sum, const double value) {
+  double old_sum = sum->load(std::memory_order_relaxed);
+  while (!sum->compare_exchange_weak(old_sum, old_sum + value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+// Lowers an atomic double to value, if it is larger.
+void AtomicMin(std::atomic<double>* min, const double value) {
+  double old_min = min->load(std::memory_order_relaxed);
+  while (value < old_min &&
+         !min->compare_exchange_weak(old_min, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+// Raises an atomic double to value, if it is smaller.
+void AtomicMax(std::atomic<double>* max, const double value) {
+  double old_max = max->load(std::memory_order_relaxed);
+  while (value > old_max &&
+         !max->compare_exchange_weak(old_max, value,
+                                     std::memory_order_relaxed)) {
+  }
+}
+
+// Returns the shard index of the calling thread. Threads get consecutive
+// indices, so that up to kNumShards threads never share a shard.
+int ThreadShardIndex(const int num_shards) {
+  static std::atomic<int> next_index(0);
+  static thread_local int index = -1;
+  if (index < 0) index = next_index.fetch_add(1) % num_shards;
+  return index;
+}
+
+}  // namespace
+
+struct SamplerCell::Shard {
+  Shard() : buckets(histogram::Histogram::DefaultBucketLimits().size()) {
+    for (std::atomic<int64>& bucket : buckets) bucket.store(0);
+  }
+
+  std::vector<std::atomic<int64>> buckets;
+  std::atomic<int64> num{0};
+  std::atomic<double> min{DBL_MAX};
+  std::atomic<double> max{-DBL_MAX};
+  std::atomic<double> sum{0};
+  std::atomic<double> sum_squares{0};
+};
+
+SamplerCell::SamplerCell() {
+  for (std::atomic<Shard*>& shard : shards_) shard.store(nullptr);
+}
+
+SamplerCell::~SamplerCell() {
+  for (std::atomic<Shard*>& shard : shards_) delete shard.load();
+}
+
+SamplerCell::Shard* SamplerCell::GetShard() {
+  std::atomic<Shard*>& slot = shards_[ThreadShardIndex(kNumShards)];
+  Shard* shard = slot.load(std::memory_order_acquire);
+  if (shard != nullptr) return shard;
+  // Threads sharing the slot may race to create the shard; one of them wins.
+  std::unique_ptr<Shard> new_shard(new Shard);
+  if (slot.compare_exchange_strong(shard, new_shard.get(),
+                                   std::memory_order_acq_rel)) {
+    return new_shard.release();
+  }
+  return shard;
+}
+
+void SamplerCell::Add(const double sample) {
+  const gtl::ArraySlice<double> limits =
+      histogram::Histogram::DefaultBucketLimits();
+  // The same bucket as histogram::Histogram::Add() uses, with samples above
+  // the last limit, i.e. infinity, counted in the last bucket.
+  const size_t bucket = std::min<size_t>(
+      std::upper_bound(limits.begin(), limits.end(), sample) - limits.begin(),
+      limits.size() - 1);
+  Shard* const shard = GetShard();
+  shard->buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  shard->num.fetch_add(1, std::memory_order_relaxed);
+  AtomicMin(&shard->min, sample);
+  AtomicMax(&shard->max, sample);
+  AtomicAdd(&shard->sum, sample);
+  AtomicAdd(&shard->sum_squares, sample * sample);
+}
+
+void SamplerCell::EncodeAllBuckets(HistogramProto* const proto) const {
+  const gtl::ArraySlice<double> limits =
+      histogram::Histogram::DefaultBucketLimits();
+  std::vector<int64> buckets(limits.size(), 0);
+  double min = DBL_MAX;
+  double max = -DBL_MAX;
+  int64 num = 0;
+  double sum = 0;
+  double sum_squares = 0;
+  for (const std::atomic<Shard*>& slot : shards_) {
+    const Shard* const shard = slot.load(std::memory_order_acquire);
+    if (shard == nullptr) continue;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+      buckets[i] += shard->buckets[i].load(std::memory_order_relaxed);
+    }
+    min = std::min(min, shard->min.load(std::memory_order_relaxed));
+    max = std::max(max, shard->max.load(std::memory_order_relaxed));
+    num += shard->num.load(std::memory_order_relaxed);
+    sum += shard->sum.load(std::memory_order_relaxed);
+    sum_squares += shard->sum_squares.load(std::memory_order_relaxed);
+  }
+
+  proto->Clear();
+  proto->set_min(min);
+  proto->set_max(max);
+  proto->set_num(num);
+  proto->set_sum(sum);
+  proto->set_sum_squares(sum_squares);
+  for (size_t i = 0; i < buckets.size(); ++i) {
+    proto->add_bucket_limit(limits[i]);
+    proto->add_bucket(buckets[i]);
+  }
+}
+
+void SamplerCell::EncodeToProto(HistogramProto* const proto) const {
+  // Goes through a histogram::Histogram for the encoding of the non-empty
+  // buckets that summaries use.
+  HistogramProto all_buckets;
+  EncodeAllBuckets(&all_buckets);
+  histogram::Histogram histogram;
+  histogram.DecodeFromProto(all_buckets);
+  histogram.EncodeToProto(proto, false /* preserve_zero_buckets */);
+}
+
+double SamplerCell::Percentile(const double p) const {
+  HistogramProto all_buckets;
+  EncodeAllBuckets(&all_buckets);
+  histogram::Histogram histogram;
+  histogram.DecodeFromProto(all_buckets);
+  return histogram.Percentile(p);
+}
+
+}  // namespace monitoring
+}  // namespace tensorflow
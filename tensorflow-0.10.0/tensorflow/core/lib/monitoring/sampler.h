@@ -0,0 +1,176 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_SAMPLER_H_
+#define THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_SAMPLER_H_
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+
+#include "tensorflow/core/framework/summary.pb.h"
+#include "tensorflow/core/lib/monitoring/export_registry.h"
+#include "tensorflow/core/lib/monitoring/metric_def.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+
+// WARNING: Not yet ready for usage.
+
+namespace tensorflow {
+namespace monitoring {
+
+// SamplerCell stores the distribution of the samples of each value of a
+// Sampler, in the default buckets of a histogram::Histogram.
+//
+// Samples are added without locking. Each thread adds to one of kNumShards
+// shards of atomic bucket counts, picked when it first adds to any cell and
+// created on demand, so that threads rarely share the cache lines they write.
+// Reading the distribution sums up the shards; it sees a consistent count for
+// each bucket, but may miss samples added concurrently.
+//
+// This class is thread-safe.
+class SamplerCell {
+ public:
+  SamplerCell();
+  ~SamplerCell();
+
+  // Adds a sample.
+  void Add(double sample);
+
+  // Retrieves the distribution of the samples.
+  void EncodeToProto(HistogramProto* proto) const;
+
+  // Returns the sample at percentile 'p', in [0, 100], interpolated within
+  // its bucket.
+  double Percentile(double p) const;
+
+ private:
+  struct Shard;
+  static constexpr int kNumShards = 16;
+
+  // Returns the shard of the calling thread, creating it if needed.
+  Shard* GetShard();
+
+  // Retrieves the distribution of the samples, with all the buckets.
+  void EncodeAllBuckets(HistogramProto* proto) const;
+
+  std::array<std::atomic<Shard*>, kNumShards> shards_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SamplerCell);
+};
+
+// A stateful class for updating a cumulative distribution metric.
+//
+// This class encapsulates a set of distributions (or a single one for a
+// label-less metric). Each distribution is identified by a tuple of labels,
+// like the values of a Counter, and cells can be retrieved once and updated
+// separately in the same way.
+//
+// This class is thread-safe.
+template <int NumLabels>
+class Sampler {
+ public:
+  ~Sampler() {
+    // Deleted here, before the metric_def is destroyed.
+    registration_handle_.reset();
+  }
+
+  // Creates the metric based on the metric-definition.
+  static Sampler* New(const MetricDef<MetricKind::CUMULATIVE, HistogramProto,
+                                      NumLabels>& metric_def);
+
+  // Retrieves the cell for the specified labels, creating it on demand if
+  // not already present.
+  template <typename... Labels>
+  SamplerCell* GetCell(const Labels&... labels) LOCKS_EXCLUDED(mu_);
+
+ private:
+  explicit Sampler(const MetricDef<MetricKind::CUMULATIVE, HistogramProto,
+                                   NumLabels>& metric_def)
+      : metric_def_(metric_def) {
+    // Registered once the cells exist, since exporting reads them.
+    registration_handle_ = ExportRegistry::Default()->Register(
+        &metric_def_, [this](MetricExporter* exporter) { Collect(exporter); });
+  }
+
+  // Passes the distribution of each cell to the exporter.
+  void Collect(MetricExporter* exporter) const LOCKS_EXCLUDED(mu_);
+
+  mutable mutex mu_;
+
+  // The metric definition. This will be used to identify the metric when we
+  // register it for exporting.
+  const MetricDef<MetricKind::CUMULATIVE, HistogramProto, NumLabels>
+      metric_def_;
+
+  std::unique_ptr<ExportRegistry::RegistrationHandle> registration_handle_;
+
+  using LabelArray = std::array<string, NumLabels>;
+  std::map<LabelArray, SamplerCell> cells_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(Sampler);
+};
+
+////
+//  Implementation details follow. API readers may skip.
+////
+
+template <int NumLabels>
+Sampler<NumLabels>* Sampler<NumLabels>::New(
+    const MetricDef<MetricKind::CUMULATIVE, HistogramProto, NumLabels>&
+        metric_def) {
+  return new Sampler<NumLabels>(metric_def);
+}
+
+template <int NumLabels>
+void Sampler<NumLabels>::Collect(MetricExporter* const exporter) const {
+  mutex_lock l(mu_);
+  for (const auto& labels_and_cell : cells_) {
+    const LabelArray& labels = labels_and_cell.first;
+    HistogramProto proto;
+    labels_and_cell.second.EncodeToProto(&proto);
+    exporter->Export(metric_def_, {labels.begin(), labels.end()}, proto);
+  }
+}
+
+template <int NumLabels>
+template <typename... Labels>
+SamplerCell* Sampler<NumLabels>::GetCell(const Labels&... labels)
+    LOCKS_EXCLUDED(mu_) {
+  // Provides a more informative error message than the one during array
+  // construction below.
+  static_assert(sizeof...(Labels) == NumLabels,
+                "Mismatch between Sampler<NumLabels> and number of labels "
+                "provided in GetCell(...).");
+
+  const LabelArray& label_array = {labels...};
+  mutex_lock l(mu_);
+  const auto found_it = cells_.find(label_array);
+  if (found_it != cells_.end()) {
+    return &(found_it->second);
+  }
+  return &(cells_
+               .emplace(std::piecewise_construct,
+                        std::forward_as_tuple(label_array),
+                        std::forward_as_tuple())
+               .first->second);
+}
+
+}  // namespace monitoring
+}  // namespace tensorflow
+
+#endif  // THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_SAMPLER_H_
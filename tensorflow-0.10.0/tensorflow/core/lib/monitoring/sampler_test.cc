@@ -0,0 +1,97 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/monitoring/sampler.h"
+
+#include "tensorflow/core/framework/summary.pb.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace monitoring {
+namespace {
+
+auto* sampler_with_labels =
+    Sampler<1>::New({"/tensorflow/test/sampler_with_labels",
+                     "Sampler with one label.", "One label"});
+
+TEST(LabeledSamplerTest, InitializedEmpty) {
+  HistogramProto proto;
+  sampler_with_labels->GetCell("Empty")->EncodeToProto(&proto);
+  EXPECT_EQ(0, proto.num());
+}
+
+TEST(LabeledSamplerTest, GetCell) {
+  auto* cell = sampler_with_labels->GetCell("GetCellOp");
+  for (int i = 1; i <= 100; ++i) cell->Add(i);
+
+  auto* same_cell = sampler_with_labels->GetCell("GetCellOp");
+  HistogramProto proto;
+  same_cell->EncodeToProto(&proto);
+  EXPECT_EQ(100, proto.num());
+  EXPECT_EQ(1, proto.min());
+  EXPECT_EQ(100, proto.max());
+  EXPECT_EQ(5050, proto.sum());
+
+  // Percentiles are interpolated within the exponential buckets.
+  EXPECT_LT(cell->Percentile(50), cell->Percentile(99));
+  EXPECT_LE(cell->Percentile(99), 100);
+
+  HistogramProto other;
+  sampler_with_labels->GetCell("OtherOp")->EncodeToProto(&other);
+  EXPECT_EQ(0, other.num());
+}
+
+TEST(LabeledSamplerTest, ConcurrentAdds) {
+  auto* cell = sampler_with_labels->GetCell("ConcurrentOp");
+  const int kNumThreads = 20;
+  const int kSamplesPerThread = 1000;
+  {
+    // More threads than shards, so that some of them share a shard.
+    thread::ThreadPool pool(Env::Default(), "sampler_test", kNumThreads);
+    for (int t = 0; t < kNumThreads; ++t) {
+      pool.Schedule([cell]() {
+        for (int i = 1; i <= kSamplesPerThread; ++i) cell->Add(i);
+      });
+    }
+  }
+  HistogramProto proto;
+  cell->EncodeToProto(&proto);
+  EXPECT_EQ(kNumThreads * kSamplesPerThread, proto.num());
+  EXPECT_EQ(1, proto.min());
+  EXPECT_EQ(kSamplesPerThread, proto.max());
+  EXPECT_EQ(kNumThreads * kSamplesPerThread * (kSamplesPerThread + 1) / 2,
+            proto.sum());
+  double bucket_sum = 0;
+  for (const double bucket : proto.bucket()) bucket_sum += bucket;
+  EXPECT_EQ(proto.num(), bucket_sum);
+}
+
+auto* sampler_without_labels = Sampler<0>::New(
+    {"/tensorflow/test/sampler_without_labels", "Sampler without labels."});
+
+TEST(UnlabeledSamplerTest, GetCell) {
+  auto* cell = sampler_without_labels->GetCell();
+  cell->Add(42);
+  HistogramProto proto;
+  sampler_without_labels->GetCell()->EncodeToProto(&proto);
+  EXPECT_EQ(1, proto.num());
+  EXPECT_EQ(42, proto.sum());
+}
+
+}  // namespace
+}  // namespace monitoring
+}  // namespace tensorflow
@@ -0,0 +1,63 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/monitoring/text_exporter.h"
+
+#include "tensorflow/core/framework/summary.pb.h"
+#include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+
+namespace tensorflow {
+namespace monitoring {
+
+void TextExporter::AppendCell(const AbstractMetricDef& metric_def,
+                              const std::vector<string>& labels) {
+  strings::StrAppend(&text_, metric_def.name());
+  if (!labels.empty()) {
+    strings::StrAppend(&text_, "{", str_util::Join(labels, ","), "}");
+  }
+}
+
+void TextExporter::Export(const AbstractMetricDef& metric_def,
+                          const std::vector<string>& labels,
+                          const int64 value) {
+  AppendCell(metric_def, labels);
+  strings::StrAppend(&text_, " ", value, "\n");
+}
+
+void TextExporter::Export(const AbstractMetricDef& metric_def,
+                          const std::vector<string>& labels,
+                          const string& value) {
+  AppendCell(metric_def, labels);
+  strings::StrAppend(&text_, " \"", str_util::CEscape(value), "\"\n");
+}
+
+void TextExporter::Export(const AbstractMetricDef& metric_def,
+                          const std::vector<string>& labels,
+                          const HistogramProto& value) {
+  AppendCell(metric_def, labels);
+  strings::StrAppend(&text_, " count=", value.num());
+  histogram::Histogram histogram;
+  if (value.num() > 0 && histogram.DecodeFromProto(value)) {
+    strings::Appendf(&text_, " p50=%g p99=%g max=%g", histogram.Percentile(50),
+                     histogram.Percentile(99), value.max());
+  }
+  strings::StrAppend(&text_, "\n");
+}
+
+}  // namespace monitoring
+}  // namespace tensorflow
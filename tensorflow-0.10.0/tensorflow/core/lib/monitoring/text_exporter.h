@@ -0,0 +1,71 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_TEXT_EXPORTER_H_
+#define THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_TEXT_EXPORTER_H_
+
+#include <vector>
+
+#include "tensorflow/core/lib/monitoring/export_registry.h"
+#include "tensorflow/core/lib/monitoring/metric_def.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace monitoring {
+
+// A MetricExporter that formats each exported cell as a line of text, for
+// logs and debugging pages. Distributions are summarized by their count and
+// percentiles. For example:
+//
+//   /tensorflow/queue/size{input_queue} 12
+//   /tensorflow/op/micros{MatMul,cpu} count=100 p50=1.52 p99=20.3 max=31
+//
+// Usage:
+//   TextExporter exporter;
+//   ExportRegistry::Default()->Export(&exporter);
+//   LOG(INFO) << exporter.text();
+//
+// This class is not thread-safe.
+class TextExporter : public MetricExporter {
+ public:
+  TextExporter() {}
+  ~TextExporter() override {}
+
+  void Export(const AbstractMetricDef& metric_def,
+              const std::vector<string>& labels, int64 value) override;
+  void Export(const AbstractMetricDef& metric_def,
+              const std::vector<string>& labels, const string& value) override;
+  void Export(const AbstractMetricDef& metric_def,
+              const std::vector<string>& labels,
+              const HistogramProto& value) override;
+
+  // Returns the lines of the cells exported so far.
+  const string& text() const { return text_; }
+
+ private:
+  // Appends the name and labels that start the line of a cell.
+  void AppendCell(const AbstractMetricDef& metric_def,
+                  const std::vector<string>& labels);
+
+  string text_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(TextExporter);
+};
+
+}  // namespace monitoring
+}  // namespace tensorflow
+
+#endif  // THIRD_PARTY_TENSORFLOW_CORE_LIB_MONITORING_TEXT_EXPORTER_H_
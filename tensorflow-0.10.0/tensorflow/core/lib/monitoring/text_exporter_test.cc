@@ -0,0 +1,80 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/monitoring/text_exporter.h"
+
+#include <memory>
+
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/gauge.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace monitoring {
+namespace {
+
+// Returns the lines of the exported text that start with prefix.
+std::vector<string> LinesWithPrefix(const TextExporter& exporter,
+                                    const string& prefix) {
+  std::vector<string> lines;
+  for (const string& line : str_util::Split(exporter.text(), '\n')) {
+    if (StringPiece(line).starts_with(prefix)) lines.push_back(line);
+  }
+  return lines;
+}
+
+TEST(TextExporterTest, ExportsRegisteredMetrics) {
+  std::unique_ptr<Counter<1>> counter(
+      Counter<1>::New({"/tensorflow/test/text/counter",
+                       "Counter with one label.", "Label"}));
+  std::unique_ptr<Gauge<int64, 2>> gauge(Gauge<int64, 2>::New(
+      {"/tensorflow/test/text/gauge", "Gauge with two labels.", "First",
+       "Second"}));
+  std::unique_ptr<Gauge<string, 0>> string_gauge(Gauge<string, 0>::New(
+      {"/tensorflow/test/text/string_gauge", "Gauge of a string."}));
+  std::unique_ptr<Sampler<0>> sampler(
+      Sampler<0>::New({"/tensorflow/test/text/sampler", "Sampler."}));
+
+  counter->GetCell("a")->IncrementBy(3);
+  counter->GetCell("b")->IncrementBy(4);
+  gauge->GetCell("x", "y")->Set(-5);
+  string_gauge->GetCell()->Set("say \"hi\"");
+  for (int i = 1; i <= 100; ++i) sampler->GetCell()->Add(i);
+
+  TextExporter exporter;
+  ExportRegistry::Default()->Export(&exporter);
+  EXPECT_EQ(std::vector<string>({"/tensorflow/test/text/counter{a} 3",
+                                 "/tensorflow/test/text/counter{b} 4",
+                                 "/tensorflow/test/text/gauge{x,y} -5",
+                                 "/tensorflow/test/text/sampler count=100 "
+                                 "p50=50.2318 p99=99.2959 max=100",
+                                 "/tensorflow/test/text/string_gauge "
+                                 "\"say \\\"hi\\\"\""}),
+            LinesWithPrefix(exporter, "/tensorflow/test/text/"));
+
+  // Deleted metrics are no longer exported.
+  counter.reset();
+  TextExporter after_reset;
+  ExportRegistry::Default()->Export(&after_reset);
+  EXPECT_TRUE(
+      LinesWithPrefix(after_reset, "/tensorflow/test/text/counter").empty());
+}
+
+}  // namespace
+}  // namespace monitoring
+}  // namespace tensorflow
@@ -19,6 +19,7 @@ limitations under the License.
 #include <float.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <algorithm>
 #include <cmath>
 #include <unordered_map>
@@ -314,6 +315,16 @@ bool safe_strtof(const char* str, float* value) {
   return *str != '\0' && *endptr == '\0';
 }
 
+bool safe_strtof(StringPiece str, float* value) {
+  char buffer[kFastToBufferSize];
+  if (str.size() < sizeof(buffer)) {
+    memcpy(buffer, str.data(), str.size());
+    buffer[str.size()] = '\0';
+    return safe_strtof(buffer, value);
+  }
+  return safe_strtof(str.ToString().c_str(), value);
+}
+
 bool safe_strtod(const char* str, double* value) {
   const char* endptr;
   *value = locale_independent_strtonum<double>(str, &endptr);
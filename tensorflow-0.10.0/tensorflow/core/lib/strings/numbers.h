@@ -117,6 +117,10 @@ bool safe_strtou64(StringPiece str, uint64* value);
 // Values may be rounded on over- and underflow.
 bool safe_strtof(const char* str, float* value);
 
+// Same as above for strings that are not NUL-terminated, like fields of a
+// larger string. Short strings are copied to the stack.
+bool safe_strtof(StringPiece str, float* value);
+
 // Convert strings to double precision floating point values.
 // Leading and trailing spaces are allowed.
 // Values may be rounded on over- and underflow.
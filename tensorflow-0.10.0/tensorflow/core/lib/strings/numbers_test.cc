@@ -247,6 +247,17 @@ TEST(safe_strtof, Float) {
   EXPECT_EQ(-42.0f, result);
 
   EXPECT_FALSE(safe_strtof("-infinity is awesome", &result));
+
+  // String pieces need not be NUL-terminated.
+  const string fields = "1.5,-2e3";
+  EXPECT_TRUE(safe_strtof(StringPiece(fields.data(), 3), &result));
+  EXPECT_EQ(1.5f, result);
+  EXPECT_TRUE(safe_strtof(StringPiece(fields.data() + 4, 4), &result));
+  EXPECT_EQ(-2000.0f, result);
+  EXPECT_FALSE(safe_strtof(StringPiece(fields.data(), 4), &result));
+  EXPECT_FALSE(safe_strtof(StringPiece(), &result));
+  EXPECT_TRUE(safe_strtof(StringPiece(string(40, ' ') + "7"), &result));
+  EXPECT_EQ(7.0f, result);
 }
 
 TEST(safe_strtod, Double) {
@@ -247,6 +247,70 @@ shared_name: If non-empty, this queue will be shared under the given name
   across multiple sessions.
 )doc");
 
+REGISTER_OP("BatchingFIFOQueue")
+    .Output("handle: Ref(string)")
+    .Attr("component_types: list(type) >= 1")
+    .Attr("shapes: list(shape) >= 0 = []")
+    .Attr("capacity: int = -1")
+    .Attr("batch_timeout_micros: int >= 0")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::ScalarShape)
+    .Doc(R"doc(
+A FIFO queue whose DequeueUpTo returns partial batches after a timeout.
+
+QueueDequeueUpTo on this queue returns n elements, or the elements that are
+available once it has waited batch_timeout_micros, whichever comes first.
+If the queue is empty at that point, the batch is returned as soon as its
+first element arrives.  This bounds the latency that batching adds to each
+element, e.g. when serving requests in dynamically sized batches.
+QueueDequeueMany and the other queue operations behave as for FIFOQueue.
+
+handle: The handle to the queue.
+component_types: The type of each component in a value.
+shapes: The shape of each component in a value. The length of this attr must
+  be either 0 or the same as the length of component_types. If the length of
+  this attr is 0, the shapes of queue elements are not constrained, and
+  only one element may be dequeued at a time.
+capacity: The upper bound on the number of elements in this queue.
+  Negative numbers mean no limit.
+batch_timeout_micros: How long QueueDequeueUpTo waits for a full batch.
+container: If non-empty, this queue is placed in the given container.
+        Otherwise, a default container is used.
+shared_name: If non-empty, this queue will be shared under the given name
+  across multiple sessions.
+)doc");
+
+REGISTER_OP("RingFIFOQueue")
+    .Output("handle: Ref(string)")
+    .Attr("component_types: list(type) >= 1")
+    .Attr("shapes: list(shape) >= 1")
+    .Attr("capacity: int >= 1")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .SetIsStateful()
+    .SetShapeFn(shape_inference::ScalarShape)
+    .Doc(R"doc(
+A FIFO queue of fixed-shape elements backed by a lock-free ring buffer.
+
+While no enqueue or dequeue is blocked on the queue, single-element
+enqueues and dequeues do not take a lock, which suits pipelines with many
+producers and consumers moving small elements at a high rate.  Operations
+that block, and all EnqueueMany and DequeueMany operations, are served in
+first-in first-out order like FIFOQueue.
+
+handle: The handle to the queue.
+component_types: The type of each component in a value.
+shapes: The shape of each component in a value. The length of this attr must
+  be the same as the length of component_types.
+capacity: The number of elements in the ring buffer.
+container: If non-empty, this queue is placed in the given container.
+        Otherwise, a default container is used.
+shared_name: If non-empty, this queue will be shared under the given name
+  across multiple sessions.
+)doc");
+
 REGISTER_OP("PaddingFIFOQueue")
     .Output("handle: Ref(string)")
     .Attr("component_types: list(type) >= 1")
@@ -436,7 +500,9 @@ If the queue is closed and there are more than 0 but less than n elements
 remaining, then instead of returning an OutOfRange error like
 QueueDequeueMany, less than `n` elements are returned immediately.  If the queue
 is closed and there are 0 elements left in the queue, then an OutOfRange
-error is returned just like in QueueDequeueMany.  Otherwise the behavior
+error is returned just like in QueueDequeueMany.  A BatchingFIFOQueue also
+returns less than `n` elements once its batch timeout has passed.  Otherwise
+the behavior
 is identical to QueueDequeueMany:
 
 This operation concatenates queue-element component tensors along the
@@ -544,6 +610,7 @@ REGISTER_OP("TensorArray")
     .Attr("dynamic_size: bool = false")
     .Attr("clear_after_read: bool = true")
     .Attr("tensor_array_name: string = ''")
+    .Attr("capacity: int = 0")
     .Output("handle: Ref(string)")
     .SetIsStateful()
     .SetShapeFn([](InferenceContext* c) {
@@ -567,6 +634,12 @@ clear_after_read: If true (default), Tensors in the TensorArray are cleared
 tensor_array_name: Overrides the name used for the temporary tensor_array
   resource. Default value is the name of the 'TensorArray' op (which
   is guaranteed unique).
+capacity: If positive, the first write on the CPU allocates a buffer for
+  this many elements of its shape, and elements of that shape written to
+  indices below the capacity are copied into it.  Packing or concatenating
+  elements that are all in the buffer then returns the buffer without a copy,
+  e.g. for an array written once per step of a while_loop with a known bound
+  on its number of steps.
 )doc");
 
 REGISTER_OP("TensorArrayGrad")
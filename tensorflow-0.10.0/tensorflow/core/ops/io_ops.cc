@@ -78,6 +78,8 @@ REGISTER_OP("SaveSlices")
     .Input("shapes_and_slices: string")
     .Input("data: T")
     .Attr("T: list(type)")
+    .Attr("async_write: bool = false")
+    .Attr("max_incremental_saves: int >= 0 = 0")
     .SetShapeFn([](InferenceContext* c) {
       const Shape* unused;
       const Shape* s;
@@ -119,6 +121,18 @@ where each `sliceI` is either:
 *  `start,length` where `start` and `length` are integers.  In that
    case the slice covers `length` indices starting at `start`.
 
+With `async_write`, the op returns once it has copied `data`, and the file is
+written on a background thread.  `WaitForPendingSave` waits for it and reports
+its errors.  Each op waits for its previous write before starting the next.
+
+With `max_incremental_saves` > 0, numeric tensors of rank 1 or more are written
+incrementally: only the rows (slices along the 0th dimension) that changed since
+the previous save of this op are saved, along with the name of the previous
+save's file, which restoring reads the other rows from.  After
+`max_incremental_saves` incremental saves, or when a tensor's shape or the file
+changes, the next save is full.  The files of the previous
+`max_incremental_saves` saves must be kept for the latest one to be restored.
+
 See also `Save`.
 
 filename: Must have a single element. The name of the file to which we write the
@@ -127,6 +141,25 @@ tensor_names: Shape `[N]`. The names of the tensors to be saved.
 shapes_and_slices: Shape `[N]`.  The shapes and slice specifications to use when
   saving the tensors.
 data: `N` tensors to save.
+async_write: If true, write the file in the background.
+max_incremental_saves: How many incremental saves may follow a full save.
+)doc");
+
+REGISTER_OP("WaitForPendingSave")
+    .Input("filename: string")
+    .SetIsStateful()
+    .SetShapeFn([](InferenceContext* c) {
+      const Shape* unused;
+      return c->WithRank(c->input(0), 0, &unused);
+    })
+    .Doc(R"doc(
+Waits until the `SaveSlices` ops with `async_write` have written `filename`.
+
+Fails with the error of the writes of `filename` that failed since the previous
+`WaitForPendingSave` for it.  Returns immediately if nothing is being written to
+`filename`.
+
+filename: The name of the file written by the save ops.
 )doc");
 
 REGISTER_OP("Restore")
@@ -211,6 +244,50 @@ preferred_shard: Index of file to open first if multiple files match
   `file_pattern`. See the documentation for `Restore`.
 )doc");
 
+REGISTER_OP("RestoreSlices")
+    .Input("file_pattern: string")
+    .Input("tensor_names: string")
+    .Input("shapes_and_slices: string")
+    .Output("tensors: dt")
+    .Attr("dt: list(type) >= 1")
+    .Attr("preferred_shard: int = -1")
+    .SetShapeFn([](InferenceContext* c) {
+      const Shape* unused;
+      const Shape* s;
+      const Dimension* unused_dim;
+
+      // Validate file_pattern.
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 0, &unused));
+
+      // Validate tensor_names and shapes_and_slices.
+      for (int i = 1; i <= 2; ++i) {
+        TF_RETURN_IF_ERROR(c->WithRank(c->input(i), 1, &s));
+        TF_RETURN_IF_ERROR(
+            c->WithValue(c->Dim(s, 0), c->num_outputs(), &unused_dim));
+      }
+      for (int i = 0; i < c->num_outputs(); ++i) {
+        c->set_output(i, c->UnknownShape());
+      }
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Restores several tensors from checkpoint files.
+
+This is like running one `RestoreSlice` per tensor, except that the files are
+opened once and the tensors are read from them in parallel.
+
+file_pattern: Must have a single element. The pattern of the files from
+  which we read the tensors.
+tensor_names: Shape `[N]`. The names of the tensors to be restored.
+shapes_and_slices: Shape `[N]`. The shapes and slice specifications to use
+  when restoring the tensors, in the format of `RestoreSlice`.  An empty
+  string restores the whole tensor.
+tensors: The restored tensors.
+dt: The types of the tensors to be restored.
+preferred_shard: Index of file to open first if multiple files match
+  `file_pattern`. See the documentation for `Restore`.
+)doc");
+
 REGISTER_OP("ShardedFilename")
     .Input("basename: string")
     .Input("shard: int32")
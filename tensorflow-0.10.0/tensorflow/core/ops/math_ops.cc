@@ -943,6 +943,28 @@ transpose_a: If true, "a" is transposed before multiplication.
 transpose_b: If true, "b" is transposed before multiplication.
 )doc");
 
+REGISTER_OP("_FusedMatMul")
+    .Input("a: T")
+    .Input("b: T")
+    .Input("bias: T")
+    .Output("product: T")
+    .Attr("transpose_a: bool = false")
+    .Attr("transpose_b: bool = false")
+    .Attr("fused_relu: bool = false")
+    .Attr("T: {float, double}")
+    .SetShapeFn(shape_inference::MatMulShape)
+    .Doc(R"doc(
+Multiply the matrix "a" by the matrix "b" and add "bias" to each row.
+
+The fusion of MatMul, BiasAdd and optionally Relu that the graph is rewritten
+to on CPU devices.  The product is written once into the output.
+
+bias: 1-D with as many elements as the product has columns.
+transpose_a: If true, "a" is transposed before multiplication.
+transpose_b: If true, "b" is transposed before multiplication.
+fused_relu: If true, the product is max(a * b + bias, 0).
+)doc");
+
 REGISTER_OP("SparseMatMul")
     .Input("a: Ta")
     .Input("b: Tb")
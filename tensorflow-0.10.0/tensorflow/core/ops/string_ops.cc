@@ -199,4 +199,52 @@ inputs: A list of string tensors.  The tensors must all have the same shape,
 separator: string, an optional join separator.
 )doc");
 
+REGISTER_OP("PackStrings")
+    .Input("strings: string")
+    .Output("bytes: uint8")
+    .Output("offsets: int64")
+    .SetShapeFn([](InferenceContext* c) {
+      const Dimension* num_offsets;
+      TF_RETURN_IF_ERROR(c->Add(c->NumElements(c->input(0)), 1, &num_offsets));
+      c->set_output(0, c->Vector(InferenceContext::kUnknownDim));
+      c->set_output(1, c->Vector(num_offsets));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Packs the elements of a string tensor into one buffer of bytes.
+
+String i of `strings`, in row major order, is held by the bytes
+`bytes[offsets[i]:offsets[i + 1]]`. Unlike a string tensor, whose elements are
+allocated separately, packed strings are two flat buffers, which are cheap to
+copy, concatenate and send between devices or processes.
+
+strings: The strings to pack.
+bytes: The bytes of all strings, one after the other.
+offsets: The offsets of the strings in `bytes`, followed by the number of
+  bytes.
+)doc");
+
+REGISTER_OP("UnpackStrings")
+    .Input("bytes: uint8")
+    .Input("offsets: int64")
+    .Output("strings: string")
+    .SetShapeFn([](InferenceContext* c) {
+      const Shape* unused;
+      const Shape* offsets;
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(0), 1, &unused));
+      TF_RETURN_IF_ERROR(c->WithRank(c->input(1), 1, &offsets));
+      const Dimension* num_strings;
+      TF_RETURN_IF_ERROR(c->Subtract(c->Dim(offsets, 0), 1, &num_strings));
+      c->set_output(0, c->Vector(num_strings));
+      return Status::OK();
+    })
+    .Doc(R"doc(
+Unpacks strings packed by `PackStrings` into a vector of strings.
+
+bytes: The bytes of all strings, one after the other.
+offsets: The offsets of the strings in `bytes`, followed by the number of
+  bytes.
+strings: The unpacked strings.
+)doc");
+
 }  // namespace tensorflow
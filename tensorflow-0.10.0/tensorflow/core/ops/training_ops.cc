@@ -313,6 +313,7 @@ REGISTER_OP("SparseApplyAdagrad")
     .Attr("T: numbertype")
     .Attr("Tindices: {int32, int64}")
     .Attr("use_locking: bool = false")
+    .Attr("sum_duplicate_indices: bool = false")
     .SetShapeFn([](InferenceContext* c) {
       return ApplyAdagradShapeFn(c, true /* sparse */);
     })
@@ -332,6 +333,9 @@ out: Same as "var".
 use_locking: If `True`, updating of the var and accum tensors will be protected
   by a lock; otherwise the behavior is undefined, but may exhibit less
   contention.
+sum_duplicate_indices: If `True`, the gradients of repeated indices are summed
+  and each row is updated once, as if grad were dense, with the distinct rows
+  updated in parallel. Otherwise each index is applied in turn.
 )doc");
 
 REGISTER_OP("SparseApplyProximalAdagrad")
@@ -525,6 +529,7 @@ REGISTER_OP("SparseApplyMomentum")
     .Attr("Tindices: {int32, int64}")
     .Attr("use_locking: bool = false")
     .Attr("use_nesterov: bool = false")
+    .Attr("sum_duplicate_indices: bool = false")
     .SetShapeFn([](InferenceContext* c) {
       return ApplyMomentumShapeFn(c, true /* sparse */);
     })
@@ -550,6 +555,9 @@ use_locking: If `True`, updating of the var and accum tensors will be protected
 use_nesterov: If `True`, the tensor passed to compute grad will be 
 var - lr * momentum * accum, so in the end, the var you get is actually
 var - lr * momentum * accum.
+sum_duplicate_indices: If `True`, the gradients of repeated indices are summed
+  and each row is updated once, as if grad were dense, with the distinct rows
+  updated in parallel. Otherwise each index is applied in turn.
 )doc");
 
 static Status ApplyAdamShapeFn(InferenceContext* c, bool sparse) {
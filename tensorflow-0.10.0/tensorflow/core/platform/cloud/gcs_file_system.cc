@@ -21,11 +21,15 @@ limitations under the License.
 #include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <map>
+#include <set>
 #include <vector>
 #include "include/json/json.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/lib/gtl/stl_util.h"
+#include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/strings/numbers.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/cloud/google_auth_provider.h"
@@ -42,6 +46,42 @@ constexpr char kGcsUploadUriBase[] =
     "https://www.googleapis.com/upload/storage/v1/";
 constexpr char kStorageHost[] = "storage.googleapis.com";
 constexpr size_t kBufferSize = 1024 * 1024;  // In bytes.
+// The defaults of the block cache of the files opened for reading, which the
+// environment variables read by GetEnvMegabytes() and GetEnvInt() override.
+constexpr size_t kDefaultBlockSize = 8 * 1024 * 1024;
+constexpr size_t kDefaultBlockReadAheadBytes = 64 * 1024 * 1024;
+constexpr int kDefaultMaxCachedBlocks = 32;
+constexpr int kDefaultMaxParallelReads = 8;
+// The defaults of the uploads of the files opened for writing, which the
+// GCS_UPLOAD_* and GCS_MAX_PARALLEL_UPLOADS environment variables override.
+constexpr size_t kDefaultUploadPartSize = 32 * 1024 * 1024;
+constexpr size_t kDefaultUploadChunkSize = 8 * 1024 * 1024;
+constexpr int kDefaultMaxParallelUploads = 4;
+// The most objects a compose request can compose.
+constexpr size_t kMaxComposeSources = 32;
+// The response code of the requests of unfinished resumable uploads.
+constexpr uint64 kResumeIncompleteCode = 308;
+// The attempts at a chunk of a resumable upload before the upload fails.
+constexpr int kMaxChunkAttempts = 5;
+
+/// Returns the non-negative integer value of the environment variable 'name',
+/// or 'default_value' if it is not set or not a valid value.
+int64 GetEnvInt(const char* name, int64 default_value) {
+  const char* value = std::getenv(name);
+  int64 parsed;
+  if (value == nullptr || !strings::safe_strto64(value, &parsed) ||
+      parsed < 0) {
+    return default_value;
+  }
+  return parsed;
+}
+
+/// Returns the value in bytes of the environment variable 'name', given in
+/// megabytes, or 'default_value' if it is not set or not a valid value.
+size_t GetEnvMegabytes(const char* name, size_t default_value) {
+  const int64 megabytes = GetEnvInt(name, -1);
+  return megabytes < 0 ? default_value : megabytes * 1024 * 1024;
+}
 
 Status GetTmpFilename(string* filename) {
   if (!filename) {
@@ -81,22 +121,48 @@ Status ParseGcsPath(StringPiece fname, string* bucket, string* object) {
   return Status::OK();
 }
 
-/// A GCS-based implementation of a random access file with a read-ahead buffer.
+/// \brief A GCS-based implementation of a random access file.
+///
+/// Reads go through a read-ahead buffer, or, if block_size is positive,
+/// through a cache of the blocks of the file. The blocks missing for a read
+/// are fetched with one ranged request each, in parallel on the thread pool
+/// if there is one, and when the read starts where the previous one ended,
+/// the blocks covering the next read_ahead_bytes are prefetched with them.
 class GcsRandomAccessFile : public RandomAccessFile {
  public:
   GcsRandomAccessFile(const string& bucket, const string& object,
                       AuthProvider* auth_provider,
                       HttpRequest::Factory* http_request_factory,
-                      size_t read_ahead_bytes)
+                      size_t read_ahead_bytes, size_t block_size,
+                      size_t max_cached_blocks, thread::ThreadPool* pool)
       : bucket_(bucket),
         object_(object),
         auth_provider_(auth_provider),
         http_request_factory_(std::move(http_request_factory)),
-        read_ahead_bytes_(read_ahead_bytes) {}
+        read_ahead_bytes_(read_ahead_bytes),
+        block_size_(block_size),
+        max_cached_blocks_(max_cached_blocks),
+        pool_(pool) {}
 
-  /// The implementation of reads with a read-ahead buffer.
   Status Read(uint64 offset, size_t n, StringPiece* result,
               char* scratch) const override {
+    mutex_lock l(mu_);
+    if (block_size_ > 0) {
+      return ReadFromBlocks(offset, n, result, scratch);
+    }
+    return ReadFromBuffer(offset, n, result, scratch);
+  }
+
+ private:
+  /// A cached block, with the read counter at its last use.
+  struct Block {
+    string data;
+    uint64 last_use = 0;
+  };
+
+  /// The implementation of reads with a read-ahead buffer.
+  Status ReadFromBuffer(uint64 offset, size_t n, StringPiece* result,
+                        char* scratch) const EXCLUSIVE_LOCKS_REQUIRED(mu_) {
     if (offset >= buffer_start_offset_ &&
         offset + n <= buffer_start_offset_ + buffer_content_size_) {
       // If the requested range is fully in the buffer, just return it.
@@ -118,18 +184,112 @@ class GcsRandomAccessFile : public RandomAccessFile {
     // Set the results.
     *result = StringPiece(scratch, std::min(buffer_content_size_, n));
     std::memcpy(scratch, buffer_.get(), result->size());
+    return CheckReadSize(*result, n);
+  }
+
+  /// The implementation of reads with a block cache.
+  Status ReadFromBlocks(uint64 offset, size_t n, StringPiece* result,
+                        char* scratch) const EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    *result = StringPiece(scratch, 0);
+    if (n == 0) return Status::OK();
+    ++num_reads_;
+    const uint64 first = offset / block_size_;
+    uint64 last = (offset + n - 1) / block_size_;
+    uint64 prefetch_last = last;
+    if (offset == next_offset_) {
+      prefetch_last += (read_ahead_bytes_ + block_size_ - 1) / block_size_;
+    }
+    last = std::min(last, last_block_);
+    prefetch_last = std::min(prefetch_last, last_block_);
+
+    std::vector<uint64> missing;
+    for (uint64 index = first; index <= prefetch_last; ++index) {
+      if (blocks_.count(index) == 0) missing.push_back(index);
+    }
+    std::vector<Block> fetched(missing.size());
+    std::vector<Status> statuses(missing.size());
+    auto fetch = [this, &missing, &fetched, &statuses](size_t i) {
+      string& data = fetched[i].data;
+      data.resize(block_size_);
+      StringPiece content;
+      statuses[i] = ReadFromGCS(missing[i] * block_size_, block_size_,
+                                &content, &data[0]);
+      data.resize(content.size());
+    };
+    if (pool_ == nullptr || missing.size() < 2) {
+      for (size_t i = 0; i < missing.size(); ++i) fetch(i);
+    } else {
+      BlockingCounter counter(missing.size());
+      for (size_t i = 0; i < missing.size(); ++i) {
+        pool_->Schedule([&fetch, &counter, i]() {
+          fetch(i);
+          counter.DecrementCount();
+        });
+      }
+      counter.Wait();
+    }
+
+    // Failed prefetches are dropped, only the blocks of the read must be
+    // fetched. A short block is the last one of the file.
+    for (size_t i = 0; i < missing.size(); ++i) {
+      if (!statuses[i].ok()) {
+        if (missing[i] <= last) return statuses[i];
+        continue;
+      }
+      if (fetched[i].data.size() < block_size_) {
+        last_block_ = std::min(last_block_, missing[i]);
+      }
+      Block& block = blocks_[missing[i]];
+      block.data.swap(fetched[i].data);
+      block.last_use = num_reads_;
+    }
+
+    size_t copied = 0;
+    for (uint64 index = first; index <= last && copied < n; ++index) {
+      Block& block = blocks_[index];
+      block.last_use = num_reads_;
+      const size_t start = index == first ? offset - first * block_size_ : 0;
+      if (start >= block.data.size()) break;
+      const size_t size = std::min(block.data.size() - start, n - copied);
+      std::memcpy(scratch + copied, block.data.data() + start, size);
+      copied += size;
+      if (block.data.size() < block_size_) break;
+    }
+    *result = StringPiece(scratch, copied);
+    next_offset_ = offset + copied;
+    EvictBlocks();
+    return CheckReadSize(*result, n);
+  }
+
+  /// Evicts the least recently used blocks beyond max_cached_blocks_, but
+  /// none of those read or prefetched by the last read.
+  void EvictBlocks() const EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+    while (blocks_.size() > max_cached_blocks_) {
+      auto oldest = blocks_.end();
+      for (auto it = blocks_.begin(); it != blocks_.end(); ++it) {
+        if (it->second.last_use == num_reads_) continue;
+        if (oldest == blocks_.end() ||
+            it->second.last_use < oldest->second.last_use) {
+          oldest = it;
+        }
+      }
+      if (oldest == blocks_.end()) break;
+      blocks_.erase(oldest);
+    }
+  }
 
-    if (result->size() < n) {
+  /// Returns OutOfRange if fewer bytes were read than requested.
+  static Status CheckReadSize(const StringPiece& result, size_t n) {
+    if (result.size() < n) {
       // This is not an error per se. The RandomAccessFile interface expects
       // that Read returns OutOfRange if fewer bytes were read than requested.
-      return errors::OutOfRange(strings::StrCat("EOF reached, ", result->size(),
+      return errors::OutOfRange(strings::StrCat("EOF reached, ", result.size(),
                                                 " bytes were read out of ", n,
                                                 " bytes requested."));
     }
     return Status::OK();
   }
 
- private:
   /// A helper function to actually read the data from GCS.
   Status ReadFromGCS(uint64 offset, size_t n, StringPiece* result,
                      char* scratch) const {
@@ -153,13 +313,25 @@ class GcsRandomAccessFile : public RandomAccessFile {
   AuthProvider* auth_provider_;
   HttpRequest::Factory* http_request_factory_;
   const size_t read_ahead_bytes_;
+  const size_t block_size_;
+  const size_t max_cached_blocks_;
+  thread::ThreadPool* pool_;  // Not owned, may be null.
 
   // The buffer-related members need to be mutable, because they are modified
   // by the const Read() method.
-  mutable std::unique_ptr<char[]> buffer_;
+  mutable mutex mu_;
+  mutable std::unique_ptr<char[]> buffer_ GUARDED_BY(mu_);
   // The original file offset of the first byte in the buffer.
-  mutable size_t buffer_start_offset_ = 0;
-  mutable size_t buffer_content_size_ = 0;
+  mutable size_t buffer_start_offset_ GUARDED_BY(mu_) = 0;
+  mutable size_t buffer_content_size_ GUARDED_BY(mu_) = 0;
+
+  // The cached blocks by index, and the number of block reads so far.
+  mutable std::map<uint64, Block> blocks_ GUARDED_BY(mu_);
+  mutable uint64 num_reads_ GUARDED_BY(mu_) = 0;
+  // The offset following the last read, for sequential reads.
+  mutable uint64 next_offset_ GUARDED_BY(mu_) = 0;
+  // The index of the last block of the file, once a short block is read.
+  mutable uint64 last_block_ GUARDED_BY(mu_) = kuint64max;
 };
 
 /// \brief GCS-based implementation of a writeable file.
@@ -253,6 +425,394 @@ class GcsWritableFile : public WritableFile {
   HttpRequest::Factory* http_request_factory_;
 };
 
+/// \brief GCS-based implementation of a writable file uploaded while it is
+/// written.
+///
+/// The appended data is cut into parts of part_size bytes, each uploaded as a
+/// temporary object once it is complete, in parallel on the thread pool if
+/// there is one. Close() uploads the last part, composes the object from the
+/// parts and deletes them. A file that never grows past one part is uploaded
+/// to the object directly, and Sync() uploads its current version as
+/// GcsWritableFile does; once there are parts, Sync() only waits for them.
+/// Objects larger than chunk_size are sent in chunks of a resumable upload,
+/// so that a failed request only has the rest of its chunk sent again.
+///
+/// Parts that failed to upload are kept and uploaded again by Sync() and
+/// Close(), and Append() never fails once it changed the file, so that the
+/// calls can be retried.
+class GcsStreamingWritableFile : public WritableFile {
+ public:
+  GcsStreamingWritableFile(const string& bucket, const string& object,
+                           const string& part_prefix,
+                           AuthProvider* auth_provider,
+                           HttpRequest::Factory* http_request_factory,
+                           size_t part_size, size_t chunk_size,
+                           int max_parallel_uploads, thread::ThreadPool* pool)
+      : bucket_(bucket),
+        object_(object),
+        part_prefix_(part_prefix),
+        auth_provider_(auth_provider),
+        http_request_factory_(http_request_factory),
+        part_size_(part_size),
+        chunk_size_(chunk_size),
+        max_parallel_uploads_(max_parallel_uploads),
+        pool_(pool) {}
+
+  ~GcsStreamingWritableFile() override {
+    Close();
+    WaitForUploads();
+  }
+
+  Status Append(const StringPiece& data) override {
+    TF_RETURN_IF_ERROR(CheckWritable());
+    StringPiece rest = data;
+    while (buffer_.size() + rest.size() >= part_size_) {
+      const size_t size = part_size_ - buffer_.size();
+      buffer_.append(rest.data(), size);
+      rest.remove_prefix(size);
+      StartPart();
+    }
+    buffer_.append(rest.data(), rest.size());
+    return Status::OK();
+  }
+
+  Status Close() override {
+    if (closed_) return Status::OK();
+    if (parts_.empty()) {
+      TF_RETURN_IF_ERROR(UploadObject(object_, buffer_));
+    } else {
+      if (!buffer_.empty()) StartPart();
+      TF_RETURN_IF_ERROR(FinishUploads());
+      TF_RETURN_IF_ERROR(ComposeParts());
+      DeleteParts();
+    }
+    closed_ = true;
+    string().swap(buffer_);
+    return Status::OK();
+  }
+
+  Status Flush() override { return Sync(); }
+
+  /// Uploads the current version of a file of one part, or waits for the
+  /// uploads of the parts of a larger one.
+  Status Sync() override {
+    TF_RETURN_IF_ERROR(CheckWritable());
+    if (parts_.empty()) return UploadObject(object_, buffer_);
+    return FinishUploads();
+  }
+
+ private:
+  /// A part of the file, whose data is released once it is uploaded.
+  struct Part {
+    string name;
+    string data;
+    bool uploaded = false;  // Guarded by mu_ while the part is in flight.
+  };
+
+  Status CheckWritable() const {
+    if (closed_) {
+      return errors::FailedPrecondition("The file is closed.");
+    }
+    return Status::OK();
+  }
+
+  /// Moves the buffer to a new part and uploads it.
+  void StartPart() {
+    std::unique_ptr<Part> part(new Part);
+    part->name = strings::StrCat(part_prefix_, "-", parts_.size());
+    part->data.swap(buffer_);
+    Part* started = part.get();
+    parts_.push_back(std::move(part));
+    if (pool_ == nullptr) {
+      FinishPart(started, UploadObject(started->name, started->data));
+      return;
+    }
+    {
+      mutex_lock l(mu_);
+      while (num_uploading_ >= max_parallel_uploads_) uploads_done_.wait(l);
+      ++num_uploading_;
+    }
+    pool_->Schedule([this, started]() {
+      FinishPart(started, UploadObject(started->name, started->data));
+      mutex_lock l(mu_);
+      --num_uploading_;
+      uploads_done_.notify_all();
+    });
+  }
+
+  /// Records the outcome of the upload of a part.
+  void FinishPart(Part* part, const Status& status) {
+    if (!status.ok()) {
+      LOG(WARNING) << "Failed to upload " << part->name
+                   << ", it will be uploaded again: " << status;
+      return;
+    }
+    mutex_lock l(mu_);
+    part->uploaded = true;
+    string().swap(part->data);
+  }
+
+  void WaitForUploads() {
+    mutex_lock l(mu_);
+    while (num_uploading_ > 0) uploads_done_.wait(l);
+  }
+
+  /// Waits for the parts in flight and uploads again those that failed.
+  Status FinishUploads() {
+    WaitForUploads();
+    for (const auto& part : parts_) {
+      if (part->uploaded) continue;
+      const Status status = UploadObject(part->name, part->data);
+      FinishPart(part.get(), status);
+      TF_RETURN_IF_ERROR(status);
+    }
+    return Status::OK();
+  }
+
+  /// Composes the object from the parts, through intermediate composite
+  /// objects of the parts in groups of kMaxComposeSources if there are more.
+  /// Compositions only read parts and overwrite their target, so that they
+  /// can all be made again.
+  Status ComposeParts() {
+    std::vector<string> sources;
+    for (const auto& part : parts_) sources.push_back(part->name);
+    for (int level = 0; sources.size() > kMaxComposeSources; ++level) {
+      std::vector<string> composites;
+      for (size_t start = 0; start < sources.size();
+           start += kMaxComposeSources) {
+        const size_t end = std::min(sources.size(), start + kMaxComposeSources);
+        composites.push_back(strings::StrCat(part_prefix_, "-composite-", level,
+                                             "-", composites.size()));
+        composites_.insert(composites.back());
+        TF_RETURN_IF_ERROR(ComposeObject(
+            std::vector<string>(sources.begin() + start, sources.begin() + end),
+            composites.back()));
+      }
+      sources.swap(composites);
+    }
+    return ComposeObject(sources, object_);
+  }
+
+  /// Deletes the parts and the intermediate composite objects, in parallel
+  /// on the pool if there is one. A failed deletion only leaves a temporary
+  /// object behind, so it is logged rather than returned.
+  void DeleteParts() {
+    std::vector<string> names(composites_.begin(), composites_.end());
+    for (const auto& part : parts_) names.push_back(part->name);
+    auto remove = [this, &names](size_t i) {
+      const Status status = DeleteObject(names[i]);
+      if (!status.ok()) {
+        LOG(WARNING) << "Failed to delete the temporary object " << names[i]
+                     << ": " << status;
+      }
+    };
+    if (pool_ == nullptr) {
+      for (size_t i = 0; i < names.size(); ++i) remove(i);
+      return;
+    }
+    BlockingCounter counter(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+      pool_->Schedule([&remove, &counter, i]() {
+        remove(i);
+        counter.DecrementCount();
+      });
+    }
+    counter.Wait();
+  }
+
+  /// Uploads data as the object 'name', in one request if it fits in a chunk
+  /// and otherwise in chunks of a resumable upload, resuming after a failed
+  /// chunk from the bytes the upload session persisted.
+  Status UploadObject(const string& name, StringPiece data) const {
+    if (chunk_size_ == 0 || data.size() <= chunk_size_) {
+      return UploadMedia(name, data);
+    }
+    string session_uri;
+    TF_RETURN_IF_ERROR(CreateUploadSession(name, data.size(), &session_uri));
+    uint64 offset = 0;
+    int failures = 0;
+    while (offset < data.size()) {
+      const uint64 start = offset;
+      const size_t size = std::min<uint64>(chunk_size_, data.size() - start);
+      const Status status =
+          UploadChunk(session_uri, data, start, size, &offset);
+      if (status.ok() && offset > start) {
+        failures = 0;
+        continue;
+      }
+      if (++failures >= kMaxChunkAttempts) {
+        return status.ok() ? errors::Unavailable("No progress uploading ", name)
+                           : status;
+      }
+      if (!status.ok()) {
+        LOG(WARNING) << "Failed to upload a chunk of " << name
+                     << ", the upload will be resumed: " << status;
+        TF_RETURN_IF_ERROR(GetUploadOffset(session_uri, data.size(), &offset));
+      }
+    }
+    return Status::OK();
+  }
+
+  /// Uploads data as the object 'name' in one request.
+  Status UploadMedia(const string& name, StringPiece data) const {
+    string auth_token;
+    TF_RETURN_IF_ERROR(AuthProvider::GetToken(auth_provider_, &auth_token));
+
+    std::unique_ptr<HttpRequest> request(http_request_factory_->Create());
+    TF_RETURN_IF_ERROR(request->Init());
+    TF_RETURN_IF_ERROR(request->SetUri(strings::StrCat(
+        kGcsUploadUriBase, "b/", bucket_, "/o?uploadType=media&name=",
+        request->EscapeString(name))));
+    TF_RETURN_IF_ERROR(request->AddAuthBearerHeader(auth_token));
+    TF_RETURN_IF_ERROR(request->SetPostRequest(data.data(), data.size()));
+    TF_RETURN_IF_ERROR(request->Send());
+    return Status::OK();
+  }
+
+  /// Starts a resumable upload of 'size' bytes as the object 'name', and sets
+  /// *session_uri to the URI the chunks are sent to.
+  Status CreateUploadSession(const string& name, uint64 size,
+                             string* session_uri) const {
+    string auth_token;
+    TF_RETURN_IF_ERROR(AuthProvider::GetToken(auth_provider_, &auth_token));
+
+    std::unique_ptr<HttpRequest> request(http_request_factory_->Create());
+    TF_RETURN_IF_ERROR(request->Init());
+    TF_RETURN_IF_ERROR(request->SetUri(strings::StrCat(
+        kGcsUploadUriBase, "b/", bucket_, "/o?uploadType=resumable&name=",
+        request->EscapeString(name))));
+    TF_RETURN_IF_ERROR(request->AddAuthBearerHeader(auth_token));
+    TF_RETURN_IF_ERROR(
+        request->AddHeader("X-Upload-Content-Length", strings::StrCat(size)));
+    TF_RETURN_IF_ERROR(request->SetPostRequest());
+    TF_RETURN_IF_ERROR(request->Send());
+    *session_uri = request->GetResponseHeader("Location");
+    if (session_uri->empty()) {
+      return errors::Internal(
+          "Unexpected response from GCS when creating an upload session: no "
+          "Location header.");
+    }
+    return Status::OK();
+  }
+
+  /// Sends the 'size' bytes of data at 'offset' to the upload session, and
+  /// sets *next_offset to the number of bytes it persisted.
+  Status UploadChunk(const string& session_uri, StringPiece data,
+                     uint64 offset, size_t size, uint64* next_offset) const {
+    std::unique_ptr<HttpRequest> request(http_request_factory_->Create());
+    TF_RETURN_IF_ERROR(request->Init());
+    TF_RETURN_IF_ERROR(request->SetUri(session_uri));
+    TF_RETURN_IF_ERROR(request->AddHeader(
+        "Content-Range", strings::StrCat("bytes ", offset, "-",
+                                         offset + size - 1, "/", data.size())));
+    TF_RETURN_IF_ERROR(request->SetPutRequest(data.data() + offset, size));
+    return SendUploadRequest(request.get(), data.size(), next_offset);
+  }
+
+  /// Sets *offset to the number of bytes the upload session of an object of
+  /// 'size' bytes persisted.
+  Status GetUploadOffset(const string& session_uri, uint64 size,
+                         uint64* offset) const {
+    std::unique_ptr<HttpRequest> request(http_request_factory_->Create());
+    TF_RETURN_IF_ERROR(request->Init());
+    TF_RETURN_IF_ERROR(request->SetUri(session_uri));
+    TF_RETURN_IF_ERROR(
+        request->AddHeader("Content-Range", strings::StrCat("bytes */", size)));
+    TF_RETURN_IF_ERROR(request->SetPutRequest("", 0));
+    return SendUploadRequest(request.get(), size, offset);
+  }
+
+  /// Sends a request of an upload session of an object of 'size' bytes, and
+  /// sets *offset to the number of bytes persisted, all of them once the
+  /// upload completed.
+  static Status SendUploadRequest(HttpRequest* request, uint64 size,
+                                  uint64* offset) {
+    const Status status = request->Send();
+    if (status.ok()) {
+      *offset = size;
+      return Status::OK();
+    }
+    if (request->GetResponseCode() != kResumeIncompleteCode) return status;
+    // The Range header, such as "bytes=0-41", is missing when no bytes were
+    // persisted.
+    const string range = request->GetResponseHeader("Range");
+    StringPiece last_byte(range);
+    uint64 last;
+    *offset = 0;
+    if (range.empty()) return Status::OK();
+    if (!last_byte.Consume("bytes=0-") ||
+        !strings::safe_strtou64(last_byte, &last)) {
+      return errors::Internal("Unexpected Range header from GCS: ", range);
+    }
+    *offset = last + 1;
+    return Status::OK();
+  }
+
+  /// Composes the object 'target' from the objects 'sources', in order.
+  Status ComposeObject(const std::vector<string>& sources,
+                       const string& target) const {
+    Json::Value body;
+    Json::Value& source_objects = body["sourceObjects"];
+    for (const string& source : sources) {
+      Json::Value source_object;
+      source_object["name"] = source;
+      source_objects.append(source_object);
+    }
+    const string body_string = Json::FastWriter().write(body);
+
+    string auth_token;
+    TF_RETURN_IF_ERROR(AuthProvider::GetToken(auth_provider_, &auth_token));
+
+    std::unique_ptr<HttpRequest> request(http_request_factory_->Create());
+    TF_RETURN_IF_ERROR(request->Init());
+    TF_RETURN_IF_ERROR(request->SetUri(strings::StrCat(
+        kGcsUriBase, "b/", bucket_, "/o/", request->EscapeString(target),
+        "/compose")));
+    TF_RETURN_IF_ERROR(request->AddAuthBearerHeader(auth_token));
+    TF_RETURN_IF_ERROR(request->AddHeader("Content-Type", "application/json"));
+    TF_RETURN_IF_ERROR(
+        request->SetPostRequest(body_string.data(), body_string.size()));
+    TF_RETURN_IF_ERROR(request->Send());
+    return Status::OK();
+  }
+
+  Status DeleteObject(const string& name) const {
+    string auth_token;
+    TF_RETURN_IF_ERROR(AuthProvider::GetToken(auth_provider_, &auth_token));
+
+    std::unique_ptr<HttpRequest> request(http_request_factory_->Create());
+    TF_RETURN_IF_ERROR(request->Init());
+    TF_RETURN_IF_ERROR(request->SetUri(strings::StrCat(
+        kGcsUriBase, "b/", bucket_, "/o/", request->EscapeString(name))));
+    TF_RETURN_IF_ERROR(request->AddAuthBearerHeader(auth_token));
+    TF_RETURN_IF_ERROR(request->SetDeleteRequest());
+    TF_RETURN_IF_ERROR(request->Send());
+    return Status::OK();
+  }
+
+  const string bucket_;
+  const string object_;
+  // The prefix of the names of the temporary objects.
+  const string part_prefix_;
+  AuthProvider* auth_provider_;
+  HttpRequest::Factory* http_request_factory_;
+  const size_t part_size_;
+  const size_t chunk_size_;
+  const int max_parallel_uploads_;
+  thread::ThreadPool* pool_;  // Not owned, may be null.
+
+  // The data appended since the last part, the parts, and the intermediate
+  // composite objects, only used by the thread writing the file.
+  string buffer_;
+  std::vector<std::unique_ptr<Part>> parts_;
+  std::set<string> composites_;
+  bool closed_ = false;
+
+  mutex mu_;
+  condition_variable uploads_done_;
+  int num_uploading_ GUARDED_BY(mu_) = 0;
+};
+
 class GcsReadOnlyMemoryRegion : public ReadOnlyMemoryRegion {
  public:
   GcsReadOnlyMemoryRegion(std::unique_ptr<char[]> data, uint64 length)
@@ -268,15 +828,75 @@ class GcsReadOnlyMemoryRegion : public ReadOnlyMemoryRegion {
 
 GcsFileSystem::GcsFileSystem()
     : auth_provider_(new GoogleAuthProvider()),
-      http_request_factory_(new HttpRequest::Factory()) {}
+      http_request_factory_(new HttpRequest::Factory()),
+      read_ahead_bytes_(GetEnvMegabytes("GCS_READ_AHEAD_MB",
+                                        kDefaultBlockReadAheadBytes)),
+      block_size_(GetEnvMegabytes("GCS_READ_BLOCK_SIZE_MB",
+                                  kDefaultBlockSize)),
+      max_cached_blocks_(GetEnvInt("GCS_MAX_CACHED_BLOCKS",
+                                   kDefaultMaxCachedBlocks)),
+      max_parallel_reads_(GetEnvInt("GCS_MAX_PARALLEL_READS",
+                                    kDefaultMaxParallelReads)),
+      upload_part_size_(GetEnvMegabytes("GCS_UPLOAD_PART_SIZE_MB",
+                                        kDefaultUploadPartSize)),
+      upload_chunk_size_(GetEnvMegabytes("GCS_UPLOAD_CHUNK_SIZE_MB",
+                                         kDefaultUploadChunkSize)),
+      max_parallel_uploads_(GetEnvInt("GCS_MAX_PARALLEL_UPLOADS",
+                                      kDefaultMaxParallelUploads)) {}
 
 GcsFileSystem::GcsFileSystem(
     std::unique_ptr<AuthProvider> auth_provider,
     std::unique_ptr<HttpRequest::Factory> http_request_factory,
     size_t read_ahead_bytes)
+    : GcsFileSystem(std::move(auth_provider), std::move(http_request_factory),
+                    read_ahead_bytes, 0, 0, 1) {}
+
+GcsFileSystem::GcsFileSystem(
+    std::unique_ptr<AuthProvider> auth_provider,
+    std::unique_ptr<HttpRequest::Factory> http_request_factory,
+    size_t read_ahead_bytes, size_t block_size, size_t max_cached_blocks,
+    int max_parallel_reads)
+    : GcsFileSystem(std::move(auth_provider), std::move(http_request_factory),
+                    read_ahead_bytes, block_size, max_cached_blocks,
+                    max_parallel_reads, 0, 0, 1) {}
+
+GcsFileSystem::GcsFileSystem(
+    std::unique_ptr<AuthProvider> auth_provider,
+    std::unique_ptr<HttpRequest::Factory> http_request_factory,
+    size_t read_ahead_bytes, size_t block_size, size_t max_cached_blocks,
+    int max_parallel_reads, size_t upload_part_size, size_t upload_chunk_size,
+    int max_parallel_uploads)
     : auth_provider_(std::move(auth_provider)),
       http_request_factory_(std::move(http_request_factory)),
-      read_ahead_bytes_(read_ahead_bytes) {}
+      read_ahead_bytes_(read_ahead_bytes),
+      block_size_(block_size),
+      max_cached_blocks_(max_cached_blocks),
+      max_parallel_reads_(max_parallel_reads),
+      upload_part_size_(upload_part_size),
+      upload_chunk_size_(upload_chunk_size),
+      max_parallel_uploads_(max_parallel_uploads) {}
+
+thread::ThreadPool* GcsFileSystem::read_pool() {
+  if (block_size_ == 0 || max_parallel_reads_ < 2) return nullptr;
+  mutex_lock l(mu_);
+  if (read_pool_ == nullptr) {
+    read_pool_.reset(new thread::ThreadPool(Env::Default(), "gcs_read",
+                                            max_parallel_reads_));
+  }
+  return read_pool_.get();
+}
+
+thread::ThreadPool* GcsFileSystem::upload_pool() {
+  if (upload_part_size_ == 0 || max_parallel_uploads_ < 2) return nullptr;
+  mutex_lock l(mu_);
+  if (upload_pool_ == nullptr) {
+    upload_pool_.reset(new thread::ThreadPool(Env::Default(), "gcs_upload",
+                                              max_parallel_uploads_));
+  }
+  return upload_pool_.get();
+}
+
+uint64 GcsFileSystem::NewUploadId() { return random::New64(); }
 
 Status GcsFileSystem::NewRandomAccessFile(
     const string& fname, std::unique_ptr<RandomAccessFile>* result) {
@@ -284,7 +904,8 @@ Status GcsFileSystem::NewRandomAccessFile(
   TF_RETURN_IF_ERROR(ParseGcsPath(fname, &bucket, &object));
   result->reset(new GcsRandomAccessFile(bucket, object, auth_provider_.get(),
                                         http_request_factory_.get(),
-                                        read_ahead_bytes_));
+                                        read_ahead_bytes_, block_size_,
+                                        max_cached_blocks_, read_pool()));
   return Status::OK();
 }
 
@@ -292,6 +913,15 @@ Status GcsFileSystem::NewWritableFile(const string& fname,
                                       std::unique_ptr<WritableFile>* result) {
   string bucket, object;
   TF_RETURN_IF_ERROR(ParseGcsPath(fname, &bucket, &object));
+  if (upload_part_size_ > 0) {
+    const string part_prefix = strings::StrCat(
+        object, ".part-", strings::Hex(NewUploadId(), strings::ZERO_PAD_16));
+    result->reset(new GcsStreamingWritableFile(
+        bucket, object, part_prefix, auth_provider_.get(),
+        http_request_factory_.get(), upload_part_size_, upload_chunk_size_,
+        max_parallel_uploads_, upload_pool()));
+    return Status::OK();
+  }
   result->reset(new GcsWritableFile(bucket, object, auth_provider_.get(),
                                     http_request_factory_.get()));
   return Status::OK();
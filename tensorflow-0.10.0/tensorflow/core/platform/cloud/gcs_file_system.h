@@ -19,10 +19,13 @@ limitations under the License.
 #include <string>
 #include <vector>
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/platform/cloud/auth_provider.h"
 #include "tensorflow/core/platform/cloud/http_request.h"
 #include "tensorflow/core/platform/cloud/retrying_file_system.h"
 #include "tensorflow/core/platform/file_system.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 
 namespace tensorflow {
 
@@ -36,6 +39,24 @@ class GcsFileSystem : public FileSystem {
   GcsFileSystem(std::unique_ptr<AuthProvider> auth_provider,
                 std::unique_ptr<HttpRequest::Factory> http_request_factory,
                 size_t read_ahead_bytes);
+  /// Reads files through caches of max_cached_blocks blocks of block_size
+  /// bytes, fetching up to max_parallel_reads blocks at a time and prefetching
+  /// read_ahead_bytes for sequential reads.
+  GcsFileSystem(std::unique_ptr<AuthProvider> auth_provider,
+                std::unique_ptr<HttpRequest::Factory> http_request_factory,
+                size_t read_ahead_bytes, size_t block_size,
+                size_t max_cached_blocks, int max_parallel_reads);
+  /// Also uploads files while they are written, in parts of upload_part_size
+  /// bytes sent up to max_parallel_uploads at a time and composed into the
+  /// object on close, and sends objects larger than upload_chunk_size, which
+  /// must be a multiple of 256Kb, in chunks of resumable uploads. With an
+  /// upload_part_size of 0, files are uploaded whole when synced or closed.
+  GcsFileSystem(std::unique_ptr<AuthProvider> auth_provider,
+                std::unique_ptr<HttpRequest::Factory> http_request_factory,
+                size_t read_ahead_bytes, size_t block_size,
+                size_t max_cached_blocks, int max_parallel_reads,
+                size_t upload_part_size, size_t upload_chunk_size,
+                int max_parallel_uploads);
 
   Status NewRandomAccessFile(
       const string& filename,
@@ -67,13 +88,55 @@ class GcsFileSystem : public FileSystem {
 
   Status RenameFile(const string& src, const string& target) override;
 
+ protected:
+  /// Returns a random id naming the temporary objects of a written file.
+  virtual uint64 NewUploadId();
+
  private:
+  // Returns the pool fetching the blocks of the files in parallel, or null.
+  thread::ThreadPool* read_pool();
+
+  // Returns the pool uploading the parts of the files in parallel, or null.
+  thread::ThreadPool* upload_pool();
+
   std::unique_ptr<AuthProvider> auth_provider_;
   std::unique_ptr<HttpRequest::Factory> http_request_factory_;
 
   // The number of bytes to read ahead for buffering purposes in the
-  // RandomAccessFile implementation. Defaults to 256Mb.
-  const size_t read_ahead_bytes_ = 256 * 1024 * 1024;
+  // RandomAccessFile implementation. Defaults to 64Mb, or the value of the
+  // GCS_READ_AHEAD_MB environment variable.
+  const size_t read_ahead_bytes_;
+
+  // The size of the cached blocks of the RandomAccessFile implementation, or 0
+  // to read through a read-ahead buffer. Defaults to 8Mb, or the value of the
+  // GCS_READ_BLOCK_SIZE_MB environment variable.
+  const size_t block_size_;
+
+  // The number of blocks cached by each file. Defaults to 32, or the value of
+  // the GCS_MAX_CACHED_BLOCKS environment variable.
+  const size_t max_cached_blocks_;
+
+  // The number of blocks fetched in parallel. Defaults to 8, or the value of
+  // the GCS_MAX_PARALLEL_READS environment variable.
+  const int max_parallel_reads_;
+
+  // The size of the parts uploaded while a WritableFile is written, or 0 to
+  // upload the whole file when it is synced or closed. Defaults to 32Mb, or
+  // the value of the GCS_UPLOAD_PART_SIZE_MB environment variable.
+  const size_t upload_part_size_;
+
+  // The size of the chunks of resumable uploads, or 0 to upload every object
+  // in one request. Defaults to 8Mb, or the value of the
+  // GCS_UPLOAD_CHUNK_SIZE_MB environment variable.
+  const size_t upload_chunk_size_;
+
+  // The number of parts of a file uploaded in parallel. Defaults to 4, or the
+  // value of the GCS_MAX_PARALLEL_UPLOADS environment variable.
+  const int max_parallel_uploads_;
+
+  mutex mu_;
+  std::unique_ptr<thread::ThreadPool> read_pool_ GUARDED_BY(mu_);
+  std::unique_ptr<thread::ThreadPool> upload_pool_ GUARDED_BY(mu_);
 
   TF_DISALLOW_COPY_AND_ASSIGN(GcsFileSystem);
 };
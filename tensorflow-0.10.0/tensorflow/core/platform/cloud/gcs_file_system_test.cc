@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include "tensorflow/core/platform/cloud/gcs_file_system.h"
+#include <atomic>
 #include <fstream>
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/cloud/http_request_fake.h"
@@ -49,6 +50,69 @@ class FakeAuthProvider : public AuthProvider {
   }
 };
 
+// A file system uploading the files in parts, which names the temporary
+// objects of the files with a fixed id.
+class FixedUploadIdGcsFileSystem : public GcsFileSystem {
+ public:
+  FixedUploadIdGcsFileSystem(
+      std::unique_ptr<HttpRequest::Factory> http_request_factory,
+      size_t upload_part_size, size_t upload_chunk_size)
+      : GcsFileSystem(std::unique_ptr<AuthProvider>(new FakeAuthProvider),
+                      std::move(http_request_factory), 0, 0, 0, 1,
+                      upload_part_size, upload_chunk_size, 1) {}
+
+ protected:
+  uint64 NewUploadId() override { return 0xab; }
+};
+
+// The name of a temporary object of gs://bucket/path/writeable.txt.
+string WriteableTmpObject(const string& suffix) {
+  return strings::StrCat("path/writeable.txt.part-00000000000000ab-", suffix);
+}
+
+// A request uploading the temporary object in one request.
+HttpRequest* CreateUploadTmpObjectRequest(const string& suffix,
+                                          const string& content) {
+  return new FakeHttpRequest(
+      strings::StrCat("Uri: https://www.googleapis.com/upload/storage/v1/b/"
+                      "bucket/o?uploadType=media&name=path%2Fwriteable.txt."
+                      "part-00000000000000ab-",
+                      suffix, "\nAuth Token: fake_token\nPost body: ", content,
+                      "\n"),
+      "");
+}
+
+// A request composing the target from the temporary objects.
+HttpRequest* CreateComposeRequest(const string& target,
+                                  const std::vector<string>& suffixes) {
+  string sources;
+  for (const string& suffix : suffixes) {
+    strings::StrAppend(&sources, sources.empty() ? "" : ",", "{\"name\":\"",
+                       WriteableTmpObject(suffix), "\"}");
+  }
+  string escaped_target = target;
+  while (escaped_target.find('/') != string::npos) {
+    escaped_target.replace(escaped_target.find('/'), 1, "%2F");
+  }
+  return new FakeHttpRequest(
+      strings::StrCat("Uri: https://www.googleapis.com/storage/v1/b/bucket/o/",
+                      escaped_target,
+                      "/compose\nAuth Token: fake_token\n"
+                      "Header Content-Type: application/json\n"
+                      "Post body: {\"sourceObjects\":[",
+                      sources, "]}\n\n"),
+      "");
+}
+
+// A request deleting the temporary object.
+HttpRequest* CreateDeleteTmpObjectRequest(const string& suffix) {
+  return new FakeHttpRequest(
+      strings::StrCat("Uri: https://www.googleapis.com/storage/v1/b/bucket/o/"
+                      "path%2Fwriteable.txt.part-00000000000000ab-",
+                      suffix, "\nAuth Token: fake_token\nDelete: yes\n"),
+      "");
+}
+
 TEST(GcsFileSystemTest, NewRandomAccessFile_NoReadAhead) {
   std::vector<HttpRequest*> requests(
       {new FakeHttpRequest(
@@ -142,6 +206,144 @@ TEST(GcsFileSystemTest, NewRandomAccessFile_WithReadAhead) {
   EXPECT_TRUE(result.empty());
 }
 
+TEST(GcsFileSystemTest, NewRandomAccessFile_WithBlockCache) {
+  std::vector<HttpRequest*> requests(
+      {new FakeHttpRequest(
+           "Uri: https://bucket.storage.googleapis.com/random_access.txt\n"
+           "Auth Token: fake_token\n"
+           "Range: 0-3\n",
+           "0123"),
+       new FakeHttpRequest(
+           "Uri: https://bucket.storage.googleapis.com/random_access.txt\n"
+           "Auth Token: fake_token\n"
+           "Range: 4-7\n",
+           "4567"),
+       new FakeHttpRequest(
+           "Uri: https://bucket.storage.googleapis.com/random_access.txt\n"
+           "Auth Token: fake_token\n"
+           "Range: 8-11\n",
+           "89ab"),
+       new FakeHttpRequest(
+           "Uri: https://bucket.storage.googleapis.com/random_access.txt\n"
+           "Auth Token: fake_token\n"
+           "Range: 12-15\n",
+           "cd")});
+  GcsFileSystem fs(std::unique_ptr<AuthProvider>(new FakeAuthProvider),
+                   std::unique_ptr<HttpRequest::Factory>(
+                       new FakeHttpRequestFactory(&requests)),
+                   4 /* read ahead bytes */, 4 /* block size */,
+                   8 /* max cached blocks */, 1 /* max parallel reads */);
+
+  std::unique_ptr<RandomAccessFile> file;
+  TF_EXPECT_OK(fs.NewRandomAccessFile("gs://bucket/random_access.txt", &file));
+
+  char scratch[100];
+  StringPiece result;
+
+  // Fetches the two blocks of the read, and prefetches the third one.
+  TF_EXPECT_OK(file->Read(0, 6, &result, scratch));
+  EXPECT_EQ("012345", result);
+
+  // The read is sequential, so the fourth block is prefetched.
+  TF_EXPECT_OK(file->Read(6, 4, &result, scratch));
+  EXPECT_EQ("6789", result);
+
+  // The blocks are cached, no requests are made.
+  TF_EXPECT_OK(file->Read(2, 4, &result, scratch));
+  EXPECT_EQ("2345", result);
+
+  // The fourth block was short, so no blocks are requested past it.
+  EXPECT_EQ(errors::Code::OUT_OF_RANGE,
+            file->Read(10, 10, &result, scratch).code());
+  EXPECT_EQ("abcd", result);
+}
+
+// Serves ranges of an object from any number of threads.
+class FakeObjectHttpRequest : public HttpRequest {
+ public:
+  FakeObjectHttpRequest(const string& content, std::atomic<int>* num_requests)
+      : content_(content), num_requests_(num_requests) {}
+
+  Status Init() override { return Status::OK(); }
+  Status SetUri(const string& uri) override { return Status::OK(); }
+  Status AddAuthBearerHeader(const string& auth_token) override {
+    return Status::OK();
+  }
+  Status SetRange(uint64 start, uint64 end) override {
+    start_ = start;
+    end_ = end;
+    return Status::OK();
+  }
+  Status SetResultBuffer(char* scratch, size_t size,
+                         StringPiece* result) override {
+    scratch_ = scratch;
+    result_ = result;
+    return Status::OK();
+  }
+  Status Send() override {
+    ++*num_requests_;
+    const size_t start = std::min<size_t>(start_, content_.size());
+    const size_t size = std::min<size_t>(end_ + 1, content_.size()) - start;
+    memcpy(scratch_, content_.data() + start, size);
+    *result_ = StringPiece(scratch_, size);
+    return Status::OK();
+  }
+  string EscapeString(const string& str) override { return str; }
+
+ private:
+  const string content_;
+  std::atomic<int>* num_requests_;
+  uint64 start_ = 0;
+  uint64 end_ = 0;
+  char* scratch_ = nullptr;
+  StringPiece* result_ = nullptr;
+};
+
+class FakeObjectHttpRequestFactory : public HttpRequest::Factory {
+ public:
+  explicit FakeObjectHttpRequestFactory(const string& content)
+      : content_(content) {}
+
+  HttpRequest* Create() override {
+    return new FakeObjectHttpRequest(content_, &num_requests_);
+  }
+
+  int num_requests() const { return num_requests_; }
+
+ private:
+  const string content_;
+  std::atomic<int> num_requests_{0};
+};
+
+TEST(GcsFileSystemTest, NewRandomAccessFile_WithParallelBlockReads) {
+  auto* factory = new FakeObjectHttpRequestFactory("0123456789abcdefghij");
+  GcsFileSystem fs(std::unique_ptr<AuthProvider>(new FakeAuthProvider),
+                   std::unique_ptr<HttpRequest::Factory>(factory),
+                   8 /* read ahead bytes */, 4 /* block size */,
+                   16 /* max cached blocks */, 4 /* max parallel reads */);
+
+  std::unique_ptr<RandomAccessFile> file;
+  TF_EXPECT_OK(fs.NewRandomAccessFile("gs://bucket/random_access.txt", &file));
+
+  char scratch[100];
+  StringPiece result;
+
+  // Fetches the two blocks of the read and prefetches two more.
+  TF_EXPECT_OK(file->Read(0, 6, &result, scratch));
+  EXPECT_EQ("012345", result);
+  EXPECT_EQ(4, factory->num_requests());
+
+  // Prefetches the last block and the empty one past the end of the object.
+  TF_EXPECT_OK(file->Read(6, 10, &result, scratch));
+  EXPECT_EQ("6789abcdef", result);
+  EXPECT_EQ(6, factory->num_requests());
+
+  EXPECT_EQ(errors::Code::OUT_OF_RANGE,
+            file->Read(16, 10, &result, scratch).code());
+  EXPECT_EQ("ghij", result);
+  EXPECT_EQ(6, factory->num_requests());
+}
+
 TEST(GcsFileSystemTest, NewWritableFile) {
   std::vector<HttpRequest*> requests({new FakeHttpRequest(
       "Uri: https://www.googleapis.com/upload/storage/v1/b/bucket/o?"
@@ -162,6 +364,98 @@ TEST(GcsFileSystemTest, NewWritableFile) {
   TF_EXPECT_OK(file->Close());
 }
 
+TEST(GcsFileSystemTest, NewWritableFile_ParallelCompositeUpload) {
+  std::vector<HttpRequest*> requests(
+      {CreateUploadTmpObjectRequest("0", "content1"),
+       CreateUploadTmpObjectRequest("1", ",content"),
+       CreateUploadTmpObjectRequest("2", "2"),
+       CreateComposeRequest("path/writeable.txt", {"0", "1", "2"}),
+       CreateDeleteTmpObjectRequest("0"), CreateDeleteTmpObjectRequest("1"),
+       CreateDeleteTmpObjectRequest("2")});
+  FixedUploadIdGcsFileSystem fs(std::unique_ptr<HttpRequest::Factory>(
+                                    new FakeHttpRequestFactory(&requests)),
+                                8 /* part size */, 0 /* chunk size */);
+
+  std::unique_ptr<WritableFile> file;
+  TF_EXPECT_OK(fs.NewWritableFile("gs://bucket/path/writeable.txt", &file));
+
+  // The first part is uploaded once complete, and Flush() has nothing left
+  // to upload.
+  TF_EXPECT_OK(file->Append("content1,"));
+  TF_EXPECT_OK(file->Flush());
+  TF_EXPECT_OK(file->Append("content2"));
+  TF_EXPECT_OK(file->Close());
+}
+
+TEST(GcsFileSystemTest, NewWritableFile_ComposesManyParts) {
+  const string content = "abcdefghijklmnopqrstuvwxyz0123456";
+  std::vector<HttpRequest*> requests;
+  std::vector<string> first_parts;
+  for (size_t i = 0; i < content.size(); ++i) {
+    requests.push_back(
+        CreateUploadTmpObjectRequest(strings::StrCat(i), content.substr(i, 1)));
+    if (i < 32) first_parts.push_back(strings::StrCat(i));
+  }
+  requests.push_back(CreateComposeRequest(
+      WriteableTmpObject("composite-0-0"), first_parts));
+  requests.push_back(
+      CreateComposeRequest(WriteableTmpObject("composite-0-1"), {"32"}));
+  requests.push_back(CreateComposeRequest(
+      "path/writeable.txt", {"composite-0-0", "composite-0-1"}));
+  requests.push_back(CreateDeleteTmpObjectRequest("composite-0-0"));
+  requests.push_back(CreateDeleteTmpObjectRequest("composite-0-1"));
+  for (size_t i = 0; i < content.size(); ++i) {
+    requests.push_back(CreateDeleteTmpObjectRequest(strings::StrCat(i)));
+  }
+  FixedUploadIdGcsFileSystem fs(std::unique_ptr<HttpRequest::Factory>(
+                                    new FakeHttpRequestFactory(&requests)),
+                                1 /* part size */, 0 /* chunk size */);
+
+  std::unique_ptr<WritableFile> file;
+  TF_EXPECT_OK(fs.NewWritableFile("gs://bucket/path/writeable.txt", &file));
+  TF_EXPECT_OK(file->Append(content));
+  TF_EXPECT_OK(file->Close());
+}
+
+TEST(GcsFileSystemTest, NewWritableFile_ResumableUpload) {
+  std::vector<HttpRequest*> requests(
+      {new FakeHttpRequest(
+           "Uri: https://www.googleapis.com/upload/storage/v1/b/bucket/o?"
+           "uploadType=resumable&name=path%2Fwriteable.txt\n"
+           "Auth Token: fake_token\n"
+           "Header X-Upload-Content-Length: 10\n"
+           "Post: yes\n",
+           "", Status::OK(), 200,
+           {{"Location", "https://custom/upload/location"}}),
+       new FakeHttpRequest("Uri: https://custom/upload/location\n"
+                           "Header Content-Range: bytes 0-3/10\n"
+                           "Put body: 0123\n",
+                           "", errors::Unavailable("308"), 308,
+                           {{"Range", "bytes=0-3"}}),
+       new FakeHttpRequest("Uri: https://custom/upload/location\n"
+                           "Header Content-Range: bytes 4-7/10\n"
+                           "Put body: 4567\n",
+                           "", errors::Unavailable("503"), 503, {}),
+       // The failed chunk is resumed from the bytes the session persisted.
+       new FakeHttpRequest("Uri: https://custom/upload/location\n"
+                           "Header Content-Range: bytes */10\n"
+                           "Put body: \n",
+                           "", errors::Unavailable("308"), 308,
+                           {{"Range", "bytes=0-5"}}),
+       new FakeHttpRequest("Uri: https://custom/upload/location\n"
+                           "Header Content-Range: bytes 6-9/10\n"
+                           "Put body: 6789\n",
+                           "")});
+  FixedUploadIdGcsFileSystem fs(std::unique_ptr<HttpRequest::Factory>(
+                                    new FakeHttpRequestFactory(&requests)),
+                                100 /* part size */, 4 /* chunk size */);
+
+  std::unique_ptr<WritableFile> file;
+  TF_EXPECT_OK(fs.NewWritableFile("gs://bucket/path/writeable.txt", &file));
+  TF_EXPECT_OK(file->Append("0123456789"));
+  TF_EXPECT_OK(file->Close());
+}
+
 TEST(GcsFileSystemTest, NewAppendableFile) {
   std::vector<HttpRequest*> requests(
       {new FakeHttpRequest(
@@ -21,6 +21,7 @@ limitations under the License.
 #include <cstring>
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/scanner.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/platform/types.h"
@@ -231,6 +232,10 @@ Status HttpRequest::Init() {
   libcurl_->curl_easy_setopt(
       curl_, CURLOPT_USERAGENT,
       strings::StrCat("TensorFlow/", TF_VERSION_STRING).c_str());
+  libcurl_->curl_easy_setopt(curl_, CURLOPT_HEADERDATA,
+                             reinterpret_cast<void*>(this));
+  libcurl_->curl_easy_setopt(curl_, CURLOPT_HEADERFUNCTION,
+                             &HttpRequest::HeaderCallback);
 
   // If response buffer is not set, libcurl will print results to stdout,
   // so we always set it.
@@ -345,6 +350,23 @@ Status HttpRequest::SetPostRequest() {
   return Status::OK();
 }
 
+Status HttpRequest::SetPutRequest(const char* buffer, size_t size) {
+  TF_RETURN_IF_ERROR(CheckInitialized());
+  TF_RETURN_IF_ERROR(CheckNotSent());
+  TF_RETURN_IF_ERROR(CheckMethodNotSet());
+  is_method_set_ = true;
+  curl_headers_ = libcurl_->curl_slist_append(
+      curl_headers_, strings::StrCat("Content-Length: ", size).c_str());
+  libcurl_->curl_easy_setopt(curl_, CURLOPT_POST, 1);
+  libcurl_->curl_easy_setopt(curl_, CURLOPT_CUSTOMREQUEST, "PUT");
+  libcurl_->curl_easy_setopt(curl_, CURLOPT_READDATA,
+                             reinterpret_cast<void*>(this));
+  libcurl_->curl_easy_setopt(curl_, CURLOPT_READFUNCTION,
+                             &HttpRequest::ReadCallback);
+  post_body_buffer_ = StringPiece(buffer, size);
+  return Status::OK();
+}
+
 Status HttpRequest::SetResultBuffer(char* scratch, size_t size,
                                     StringPiece* result) {
   TF_RETURN_IF_ERROR(CheckInitialized());
@@ -399,6 +421,22 @@ size_t HttpRequest::ReadCallback(void* ptr, size_t size, size_t nmemb,
   return bytes_to_copy;
 }
 
+size_t HttpRequest::HeaderCallback(const void* ptr, size_t size, size_t nmemb,
+                                   void* this_object) {
+  CHECK(ptr);
+  auto that = reinterpret_cast<HttpRequest*>(this_object);
+  StringPiece header(reinterpret_cast<const char*>(ptr), size * nmemb);
+  const auto colon = header.find(':');
+  if (colon != StringPiece::npos) {
+    StringPiece name = header.substr(0, colon);
+    StringPiece value = header.substr(colon + 1);
+    str_util::RemoveWhitespaceContext(&name);
+    str_util::RemoveWhitespaceContext(&value);
+    that->response_headers_[str_util::Lowercase(name)] = value.ToString();
+  }
+  return size * nmemb;
+}
+
 Status HttpRequest::Send() {
   TF_RETURN_IF_ERROR(CheckInitialized());
   TF_RETURN_IF_ERROR(CheckNotSent());
@@ -418,11 +456,13 @@ Status HttpRequest::Send() {
   double written_size = 0;
   libcurl_->curl_easy_getinfo(curl_, CURLINFO_SIZE_DOWNLOAD, &written_size);
 
-  uint64 response_code;
+  uint64 response_code = 0;
   libcurl_->curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &response_code);
+  response_code_ = response_code;
 
   switch (response_code) {
     case 200:  // OK
+    case 201:  // Created
     case 204:  // No Content
     case 206:  // Partial Content
       if (curl_result != CURLE_OK) {
@@ -448,6 +488,13 @@ Status HttpRequest::Send() {
   }
 }
 
+uint64 HttpRequest::GetResponseCode() const { return response_code_; }
+
+string HttpRequest::GetResponseHeader(const string& name) const {
+  const auto it = response_headers_.find(str_util::Lowercase(name));
+  return it == response_headers_.end() ? string() : it->second;
+}
+
 Status HttpRequest::CheckInitialized() const {
   if (!is_initialized_) {
     return errors::FailedPrecondition("The object has not been initialized.");
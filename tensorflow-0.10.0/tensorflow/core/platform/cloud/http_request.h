@@ -16,6 +16,7 @@ limitations under the License.
 #ifndef TENSORFLOW_CORE_PLATFORM_HTTP_REQUEST_H_
 #define TENSORFLOW_CORE_PLATFORM_HTTP_REQUEST_H_
 
+#include <map>
 #include <string>
 #include <vector>
 #include <curl/curl.h>
@@ -85,6 +86,11 @@ class HttpRequest {
   /// Makes the request a POST request.
   virtual Status SetPostRequest();
 
+  /// \brief Makes the request a PUT request.
+  ///
+  /// The request body will be taken from the specified buffer.
+  virtual Status SetPutRequest(const char* buffer, size_t size);
+
   /// \brief Specifies the buffer for receiving the response body.
   ///
   /// The interface is made similar to RandomAccessFile::Read.
@@ -97,6 +103,17 @@ class HttpRequest {
   /// The object is not designed to be re-used after Send() is executed.
   virtual Status Send();
 
+  /// \brief Returns the HTTP response code of the sent request.
+  ///
+  /// Set by Send() whatever the returned status is, so that responses such as
+  /// 308 (Resume Incomplete) can be told apart from failures.
+  virtual uint64 GetResponseCode() const;
+
+  /// \brief Returns the value of a header of the response, or an empty string.
+  ///
+  /// Header names are case-insensitive.
+  virtual string GetResponseHeader(const string& name) const;
+
   // Url encodes str and returns a new string.
   virtual string EscapeString(const string& str);
 
@@ -107,6 +124,9 @@ class HttpRequest {
   /// A read callback in the form which can be accepted by libcurl.
   static size_t ReadCallback(void* ptr, size_t size, size_t nmemb,
                              FILE* userdata);
+  /// A header callback in the form which can be accepted by libcurl.
+  static size_t HeaderCallback(const void* ptr, size_t size, size_t nmemb,
+                               void* this_object);
   Status CheckInitialized() const;
   Status CheckMethodNotSet() const;
   Status CheckNotSent() const;
@@ -128,6 +148,10 @@ class HttpRequest {
   std::unique_ptr<char[]> default_response_buffer_;
   StringPiece default_response_string_piece_;
 
+  // The response code and the response headers by lowercase name.
+  uint64 response_code_ = 0;
+  std::map<string, string> response_headers_;
+
   // Members to enforce the usage flow.
   bool is_initialized_ = false;
   bool is_uri_set_ = false;
@@ -17,6 +17,7 @@ limitations under the License.
 #define TENSORFLOW_CORE_PLATFORM_HTTP_REQUEST_FAKE_H_
 
 #include <fstream>
+#include <map>
 #include <string>
 #include <vector>
 #include <curl/curl.h>
@@ -24,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/platform/cloud/http_request.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/protobuf.h"
@@ -62,6 +64,16 @@ class FakeHttpRequest : public HttpRequest {
         response_status_(response_status),
         captured_post_body_(captured_post_body) {}
 
+  /// \brief Return the response, the status, the response code and the
+  /// response headers for the given request.
+  FakeHttpRequest(const string& request, const string& response,
+                  Status response_status, uint64 response_code,
+                  const std::map<string, string>& response_headers)
+      : FakeHttpRequest(request, response, response_status, nullptr) {
+    response_code_ = response_code;
+    response_headers_ = response_headers;
+  }
+
   Status Init() override { return Status::OK(); }
   Status SetUri(const string& uri) override {
     actual_request_ += "Uri: " + uri + "\n";
@@ -111,6 +123,15 @@ class FakeHttpRequest : public HttpRequest {
     }
     return Status::OK();
   }
+  Status SetPutRequest(const char* buffer, size_t size) override {
+    if (captured_post_body_) {
+      *captured_post_body_ = string(buffer, size);
+    } else {
+      actual_request_ +=
+          strings::StrCat("Put body: ", StringPiece(buffer, size), "\n");
+    }
+    return Status::OK();
+  }
   Status SetResultBuffer(char* scratch, size_t size,
                          StringPiece* result) override {
     scratch_ = scratch;
@@ -128,6 +149,17 @@ class FakeHttpRequest : public HttpRequest {
     return response_status_;
   }
 
+  uint64 GetResponseCode() const override { return response_code_; }
+
+  string GetResponseHeader(const string& name) const override {
+    for (const auto& header : response_headers_) {
+      if (str_util::Lowercase(header.first) == str_util::Lowercase(name)) {
+        return header.second;
+      }
+    }
+    return string();
+  }
+
   // This function just does a simple replacing of "/" with "%2F" instead of
   // full url encoding.
   virtual string EscapeString(const string& str) override {
@@ -151,6 +183,8 @@ class FakeHttpRequest : public HttpRequest {
   string actual_request_;
   string response_;
   Status response_status_;
+  uint64 response_code_ = 200;
+  std::map<string, string> response_headers_;
   string* captured_post_body_ = nullptr;
 };
 
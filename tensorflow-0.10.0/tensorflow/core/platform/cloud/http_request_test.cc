@@ -73,6 +73,9 @@ class FakeLibCurl : public LibCurl {
       case CURLOPT_READDATA:
         read_data = reinterpret_cast<FILE*>(param);
         break;
+      case CURLOPT_HEADERDATA:
+        header_data = param;
+        break;
       default:
         break;
     }
@@ -91,6 +94,9 @@ class FakeLibCurl : public LibCurl {
       case CURLOPT_WRITEFUNCTION:
         write_callback = param;
         break;
+      case CURLOPT_HEADERFUNCTION:
+        header_callback = param;
+        break;
       default:
         break;
     }
@@ -107,6 +113,11 @@ class FakeLibCurl : public LibCurl {
             strings::StrCat(posted_content, StringPiece(buffer, bytes_read));
       } while (bytes_read > 0);
     }
+    if (header_data) {
+      for (const string& header : response_headers) {
+        header_callback(header.c_str(), 1, header.size(), header_data);
+      }
+    }
     if (write_data) {
       write_callback(response_content.c_str(), 1, response_content.size(),
                      write_data);
@@ -167,6 +178,7 @@ class FakeLibCurl : public LibCurl {
   // Variables defining the behavior of this fake.
   string response_content;
   uint64 response_code;
+  std::vector<string> response_headers;
 
   // Internal variables to store the libcurl state.
   string url;
@@ -183,6 +195,9 @@ class FakeLibCurl : public LibCurl {
   FILE* read_data = nullptr;
   size_t (*read_callback)(void* ptr, size_t size, size_t nmemb,
                           FILE* userdata) = &fread;
+  void* header_data = nullptr;
+  size_t (*header_callback)(const void* ptr, size_t size, size_t nmemb,
+                            void* userdata) = nullptr;
   // Outcome of performing the request.
   string posted_content;
   CURLcode curl_easy_perform_result = CURLE_OK;
@@ -320,6 +335,34 @@ TEST(HttpRequestTest, PostRequest_WithoutBody) {
   EXPECT_EQ("", libcurl->posted_content);
 }
 
+TEST(HttpRequestTest, PutRequest_WithBody_FromMemory) {
+  FakeLibCurl* libcurl = new FakeLibCurl("", 308);
+  libcurl->response_headers = {"HTTP/1.1 308 Resume Incomplete\r\n",
+                               "Range: bytes=0-16\r\n", "\r\n"};
+  HttpRequest http_request((std::unique_ptr<LibCurl>(libcurl)));
+  TF_EXPECT_OK(http_request.Init());
+
+  string content = "put body content";
+
+  TF_EXPECT_OK(http_request.SetUri("http://www.testuri.com"));
+  TF_EXPECT_OK(http_request.AddAuthBearerHeader("fake-bearer"));
+  TF_EXPECT_OK(http_request.SetPutRequest(content.c_str(), content.size()));
+  EXPECT_EQ(error::UNAVAILABLE, http_request.Send().code());
+
+  // Check interactions with libcurl.
+  EXPECT_EQ("http://www.testuri.com", libcurl->url);
+  EXPECT_EQ("PUT", libcurl->custom_request);
+  EXPECT_EQ(2, libcurl->headers->size());
+  EXPECT_EQ("Authorization: Bearer fake-bearer", (*libcurl->headers)[0]);
+  EXPECT_EQ("Content-Length: 16", (*libcurl->headers)[1]);
+  EXPECT_EQ("put body content", libcurl->posted_content);
+
+  // Check the response.
+  EXPECT_EQ(308, http_request.GetResponseCode());
+  EXPECT_EQ("bytes=0-16", http_request.GetResponseHeader("range"));
+  EXPECT_EQ("", http_request.GetResponseHeader("Location"));
+}
+
 TEST(HttpRequestTest, DeleteRequest) {
   FakeLibCurl* libcurl = new FakeLibCurl("", 200);
   HttpRequest http_request((std::unique_ptr<LibCurl>(libcurl)));
@@ -323,6 +323,11 @@ struct ThreadOptions {
   size_t stack_size = 0;  // 0: use system default value
   /// Guard area size to use near thread stacks to use (in bytes)
   size_t guard_size = 0;  // 0: use system default value
+  /// CPUs the thread may run on.
+  std::vector<int> cpu_affinity;  // empty: any CPU
+  /// Time an idle thread of a work stealing thread pool spins waiting for
+  /// tasks before it sleeps (in microseconds).
+  int64 spin_wait_micros = 0;  // 0: sleep at once
 };
 
 /// A utility routine: reads contents of named file into `*data`
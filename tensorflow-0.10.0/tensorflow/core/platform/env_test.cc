@@ -83,6 +83,66 @@ TEST(EnvTest, FileToReadonlyMemoryRegion) {
   }
 }
 
+TEST(EnvTest, ReadBatch) {
+  Env* env = Env::Default();
+  const string filename = io::JoinPath(testing::TmpDir(), "batch_file");
+  const string input = CreateTestFile(env, filename, 10000);
+  std::unique_ptr<RandomAccessFile> file;
+  TF_ASSERT_OK(env->NewRandomAccessFile(filename, &file));
+
+  // More requests than reads in flight at once, with one past EOF.
+  const int kNumRequests = 300;
+  std::vector<RandomAccessFile::ReadRequest> requests(kNumRequests);
+  std::vector<string> scratch(kNumRequests, string(100, 0));
+  for (int i = 0; i < kNumRequests; ++i) {
+    requests[i].offset = (i * 37) % 9900;
+    requests[i].n = 100;
+    requests[i].scratch = &scratch[i][0];
+  }
+  requests.back().offset = 9950;
+  EXPECT_TRUE(errors::IsOutOfRange(file->ReadBatch(&requests)));
+  for (int i = 0; i + 1 < kNumRequests; ++i) {
+    TF_EXPECT_OK(requests[i].status);
+    EXPECT_EQ(input.substr(requests[i].offset, 100),
+              requests[i].result.ToString());
+  }
+  EXPECT_TRUE(errors::IsOutOfRange(requests.back().status));
+  EXPECT_EQ(input.substr(9950), requests.back().result.ToString());
+}
+
+TEST(EnvTest, ReadBatchAsyncDefault) {
+  // A file reading from a string through the default ReadBatchAsync().
+  class StringFile : public RandomAccessFile {
+   public:
+    explicit StringFile(const string& data) : data_(data) {}
+    Status Read(uint64 offset, size_t n, StringPiece* result,
+                char* scratch) const override {
+      const size_t size = std::min<size_t>(n, data_.size() - offset);
+      memcpy(scratch, data_.data() + offset, size);
+      *result = StringPiece(scratch, size);
+      return size == n ? Status::OK() : errors::OutOfRange("EOF");
+    }
+
+   private:
+    const string data_;
+  };
+  StringFile file("0123456789");
+  std::vector<RandomAccessFile::ReadRequest> requests(3);
+  char scratch[3][4];
+  for (int i = 0; i < 3; ++i) {
+    requests[i].offset = 3 * i;
+    requests[i].n = 4;
+    requests[i].scratch = scratch[i];
+  }
+  TF_EXPECT_OK(file.ReadBatch(&requests));
+  EXPECT_EQ("0123", requests[0].result);
+  EXPECT_EQ("3456", requests[1].result);
+  EXPECT_EQ("6789", requests[2].result);
+
+  std::vector<RandomAccessFile::ReadRequest> empty;
+  TF_EXPECT_OK(file.ReadBatch(&empty));
+}
+
 TEST(EnvTest, DeleteRecursively) {
   Env* env = Env::Default();
   // Build a directory structure rooted at root_dir.
@@ -14,6 +14,9 @@ limitations under the License.
 ==============================================================================*/
 
 #include <sys/stat.h>
+#include <atomic>
+#include <deque>
+#include <memory>
 
 #include "tensorflow/core/platform/file_system.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -21,10 +24,62 @@ limitations under the License.
 #include "tensorflow/core/lib/gtl/stl_util.h"
 #include "tensorflow/core/lib/strings/scanner.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/protobuf.h"
 
 namespace tensorflow {
 
+namespace {
+
+// Number of threads running the blocking reads of ReadBatchAsync().
+const int kNumIoThreads = 16;
+
+// A fixed pool of threads for blocking I/O, shared by all files. It lives
+// in the platform layer, below lib/core/threadpool.h, and is never
+// destroyed, so reads may complete during static destruction.
+class IoThreadPool {
+ public:
+  static IoThreadPool* Get() {
+    static IoThreadPool* pool = new IoThreadPool(kNumIoThreads);
+    return pool;
+  }
+
+  void Schedule(std::function<void()> fn) {
+    mutex_lock l(mu_);
+    tasks_.push_back(std::move(fn));
+    cond_var_.notify_one();
+  }
+
+ private:
+  explicit IoThreadPool(int num_threads) {
+    for (int i = 0; i < num_threads; ++i) {
+      threads_.emplace_back(Env::Default()->StartThread(
+          ThreadOptions(), "tf_io", [this]() { WorkerLoop(); }));
+    }
+  }
+
+  void WorkerLoop() {
+    while (true) {
+      std::function<void()> fn;
+      {
+        mutex_lock l(mu_);
+        while (tasks_.empty()) cond_var_.wait(l);
+        fn = std::move(tasks_.front());
+        tasks_.pop_front();
+      }
+      fn();
+    }
+  }
+
+  mutex mu_;
+  condition_variable cond_var_;
+  std::deque<std::function<void()>> tasks_;
+  std::vector<std::unique_ptr<Thread>> threads_;
+};
+
+}  // namespace
+
 FileSystem::~FileSystem() {}
 
 string FileSystem::TranslateName(const string& name) const { return name; }
@@ -40,6 +95,46 @@ Status FileSystem::IsDirectory(const string& name) {
 
 RandomAccessFile::~RandomAccessFile() {}
 
+void RandomAccessFile::ReadBatchAsync(std::vector<ReadRequest>* requests,
+                                      std::function<void()> done) const {
+  if (requests->empty()) {
+    done();
+    return;
+  }
+  // The last read to complete calls done.
+  auto remaining = std::make_shared<std::atomic<size_t>>(requests->size());
+  for (ReadRequest& request : *requests) {
+    ScheduleIo([this, &request, remaining, done]() {
+      request.status =
+          Read(request.offset, request.n, &request.result, request.scratch);
+      if (--*remaining == 0) done();
+    });
+  }
+}
+
+Status RandomAccessFile::ReadBatch(std::vector<ReadRequest>* requests) const {
+  mutex mu;
+  condition_variable cond_var;
+  bool finished = false;
+  ReadBatchAsync(requests, [&mu, &cond_var, &finished]() {
+    mutex_lock l(mu);
+    finished = true;
+    cond_var.notify_all();
+  });
+  {
+    mutex_lock l(mu);
+    while (!finished) cond_var.wait(l);
+  }
+  for (const ReadRequest& request : *requests) {
+    TF_RETURN_IF_ERROR(request.status);
+  }
+  return Status::OK();
+}
+
+void RandomAccessFile::ScheduleIo(std::function<void()> fn) {
+  IoThreadPool::Get()->Schedule(std::move(fn));
+}
+
 WritableFile::~WritableFile() {}
 
 FileSystemRegistry::~FileSystemRegistry() {}
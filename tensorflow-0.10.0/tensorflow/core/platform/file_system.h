@@ -171,6 +171,37 @@ class RandomAccessFile {
   virtual Status Read(uint64 offset, size_t n, StringPiece* result,
                       char* scratch) const = 0;
 
+  /// \brief A range of the file to read with `ReadBatch()`.
+  struct ReadRequest {
+    uint64 offset = 0;
+    size_t n = 0;
+    /// Buffer of `n` bytes that `result` may point into.
+    char* scratch = nullptr;
+    /// Set as `Read()` sets them once the request completes.
+    StringPiece result;
+    Status status;
+  };
+
+  /// \brief Reads all of `requests`, keeping many reads in flight, and then
+  /// calls `done`, possibly on another thread.
+  ///
+  /// This file, `*requests` and their scratch buffers must stay live until
+  /// `done` is called. The default implementation runs the reads on a
+  /// process-wide pool of I/O threads.
+  ///
+  /// Safe for concurrent use by multiple threads.
+  virtual void ReadBatchAsync(std::vector<ReadRequest>* requests,
+                              std::function<void()> done) const;
+
+  /// \brief Reads all of `requests` like `ReadBatchAsync()` and waits for
+  /// them. Returns the status of the first request that failed, if any.
+  Status ReadBatch(std::vector<ReadRequest>* requests) const;
+
+ protected:
+  /// \brief Runs `fn` on the process-wide pool of I/O threads, for blocking
+  /// reads that should not hold up the calling thread.
+  static void ScheduleIo(std::function<void()> fn);
+
  private:
   /// No copying allowed
   RandomAccessFile(const RandomAccessFile&);
@@ -16,7 +16,9 @@ limitations under the License.
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <sched.h>
 #include <stdio.h>
+#include <string.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/time.h>
@@ -37,12 +39,32 @@ namespace tensorflow {
 
 namespace {
 
+// Restricts the calling thread to the given CPUs, if any.
+void SetCurrentThreadAffinity(const std::vector<int>& cpus) {
+#ifdef __linux__
+  if (cpus.empty()) return;
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (int cpu : cpus) {
+    if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &cpu_set);
+  }
+  if (sched_setaffinity(0, sizeof(cpu_set), &cpu_set) != 0) {
+    LOG(WARNING) << "Could not set the CPU affinity of a thread: "
+                 << strerror(errno);
+  }
+#endif  // __linux__
+}
+
 class StdThread : public Thread {
  public:
-  // name and thread_options are both ignored.
+  // name and the stack options of thread_options are ignored. The thread is
+  // pinned to the CPUs of thread_options before running fn.
   StdThread(const ThreadOptions& thread_options, const string& name,
             std::function<void()> fn)
-      : thread_(fn) {}
+      : thread_([thread_options, fn]() {
+          SetCurrentThreadAffinity(thread_options.cpu_affinity);
+          fn();
+        }) {}
   ~StdThread() { thread_.join(); }
 
  private:
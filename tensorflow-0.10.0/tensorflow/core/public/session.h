@@ -170,6 +170,42 @@ class Session {
                       const std::vector<string>& output_names,
                       std::vector<Tensor>* outputs);
 
+  /// \brief Prepares the graph to be run repeatedly with the feeds
+  /// `input_names`, the fetches `output_names` and the targets
+  /// `target_nodes`. Returns a `handle` for `RunCallable`, which skips the
+  /// work `Run` repeats on every call to find what to execute.
+  /// NOTE: This API is still experimental and may change.
+  virtual Status MakeCallable(const std::vector<string>& input_names,
+                              const std::vector<string>& output_names,
+                              const std::vector<string>& target_nodes,
+                              int64* handle);
+
+  /// \brief Runs the graph prepared by `MakeCallable` as `Run` would.
+  /// `inputs` are the values of the feeds, in the order of `input_names`,
+  /// and `outputs` are filled in the order of `output_names`.
+  /// NOTE: This API is still experimental and may change.
+  virtual Status RunCallable(int64 handle, const std::vector<Tensor>& inputs,
+                             std::vector<Tensor>* outputs);
+
+  /// \brief Releases the resources of a handle returned by `MakeCallable`.
+  /// NOTE: This API is still experimental and may change.
+  virtual Status ReleaseCallable(int64 handle);
+
+  /// \brief A set of feeds, fetches and targets to prepare with `Warmup`.
+  struct RunSignature {
+    std::vector<string> input_names;
+    std::vector<string> output_names;
+    std::vector<string> target_nodes;
+  };
+
+  /// \brief Builds, in parallel, what the first `Run` or `MakeCallable` with
+  /// each of `signatures` would: places and optimizes its subgraphs and
+  /// creates their kernels, including the expensive constructors of ops
+  /// like readers that load resources. Later steps with these signatures
+  /// start at full speed.
+  /// NOTE: This API is still experimental and may change.
+  virtual Status Warmup(const std::vector<RunSignature>& signatures);
+
   /// \brief Closes this session.
   ///
   /// Closing a session releases the resources used by this session
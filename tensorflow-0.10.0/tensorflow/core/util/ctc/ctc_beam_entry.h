@@ -17,9 +17,11 @@ limitations under the License.
 #define TENSORFLOW_CORE_UTIL_CTC_CTC_BEAM_ENTRY_H_
 
 #include <algorithm>
+#include <memory>
 #include <vector>
 
 #include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
@@ -50,38 +52,34 @@ struct BeamProbability {
   float label;
 };
 
+template <class CTCBeamState>
+class BeamEntryArena;
+
 template <class CTCBeamState = EmptyBeamState>
 struct BeamEntry {
-  // Default constructor does not create a vector of children.
+  // Default constructor does not create any children.
   BeamEntry() : parent(nullptr), label(-1) {}
-  // Constructor giving parent, label, and number of children does
-  // create a vector of children.  The object pointed to by p
-  // cannot be copied and should not be moved, otherwise parent will
-  // become invalid.
-  BeamEntry(BeamEntry* p, int l, int L, int t) : parent(p), label(l) {
-    PopulateChildren(L);
-  }
   inline bool Active() const { return newp.total != kLogZero; }
-  inline bool HasChildren() const { return !children.empty(); }
-  void PopulateChildren(int L) {
+  inline bool HasChildren() const { return num_children > 0; }
+  // Takes the L children of this entry from 'arena'.  The children keep a
+  // pointer to this entry, so it must stay where it is until the arena is
+  // reset.
+  void PopulateChildren(int L, BeamEntryArena<CTCBeamState>* arena) {
     CHECK(!HasChildren());
-    children = std::vector<BeamEntry>(L);
-    int ci = 0;
-    for (auto& c : children) {
-      // The current object cannot be copied, and should not be moved.
-      // Otherwise the child's parent will become invalid.
-      c.parent = this;
-      c.label = ci;
-      ++ci;
+    children = arena->Allocate(L);
+    num_children = L;
+    for (int ci = 0; ci < L; ++ci) {
+      children[ci].parent = this;
+      children[ci].label = ci;
     }
   }
-  inline std::vector<BeamEntry>* Children() {
+  inline gtl::MutableArraySlice<BeamEntry> Children() {
     CHECK(HasChildren());
-    return &children;
+    return gtl::MutableArraySlice<BeamEntry>(children, num_children);
   }
-  inline const std::vector<BeamEntry>* Children() const {
+  inline gtl::ArraySlice<BeamEntry> Children() const {
     CHECK(HasChildren());
-    return &children;
+    return gtl::ArraySlice<BeamEntry>(children, num_children);
   }
   std::vector<int> LabelSeq(bool merge_repeated) const {
     std::vector<int> labels;
@@ -97,10 +95,21 @@ struct BeamEntry {
     std::reverse(labels.begin(), labels.end());
     return labels;
   }
+  // Returns the entry to the state of a default constructed one.
+  void Clear() {
+    parent = nullptr;
+    label = -1;
+    children = nullptr;
+    num_children = 0;
+    oldp.Reset();
+    newp.Reset();
+    state = CTCBeamState();
+  }
 
   BeamEntry<CTCBeamState>* parent;
   int label;
-  std::vector<BeamEntry<CTCBeamState>> children;
+  BeamEntry<CTCBeamState>* children = nullptr;
+  int num_children = 0;
   BeamProbability oldp;
   BeamProbability newp;
   CTCBeamState state;
@@ -109,6 +118,56 @@ struct BeamEntry {
   TF_DISALLOW_COPY_AND_ASSIGN(BeamEntry);
 };
 
+// BeamEntryArena hands out the beam entries of a decoder in blocks that are
+// kept across beam searches, so that decoding a sequence allocates memory
+// only while the search grows larger than all the previous ones.
+template <class CTCBeamState = EmptyBeamState>
+class BeamEntryArena {
+ public:
+  typedef BeamEntry<CTCBeamState> Entry;
+
+  // Allocates the entries in blocks of at least 'entries_per_block'.
+  explicit BeamEntryArena(int entries_per_block)
+      : entries_per_block_(std::max(entries_per_block, 1)) {}
+
+  // Returns n contiguous default entries, valid until the next Reset().
+  Entry* Allocate(int n) {
+    while (block_ < blocks_.size() && used_ + n > blocks_[block_].size) {
+      ++block_;
+      used_ = 0;
+    }
+    if (block_ == blocks_.size()) {
+      const int size = std::max(n, entries_per_block_);
+      blocks_.push_back(Block{std::unique_ptr<Entry[]>(new Entry[size]), size});
+      used_ = 0;
+    }
+    Entry* entries = blocks_[block_].entries.get() + used_;
+    used_ += n;
+    for (int i = 0; i < n; ++i) entries[i].Clear();
+    return entries;
+  }
+
+  // Makes all the entries available again, keeping their memory.
+  void Reset() {
+    block_ = 0;
+    used_ = 0;
+  }
+
+ private:
+  struct Block {
+    std::unique_ptr<Entry[]> entries;
+    int size;
+  };
+
+  const int entries_per_block_;
+  std::vector<Block> blocks_;
+  // The block entries are allocated from, and its number of entries in use.
+  size_t block_ = 0;
+  int used_ = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BeamEntryArena);
+};
+
 // BeamComparer is the default beam comparer provided in CTCBeamSearch.
 template <class CTCBeamState = EmptyBeamState>
 class BeamComparer {
@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <cmath>
 #include <memory>
+#include <vector>
 
 #include "third_party/eigen3/Eigen/Core"
 #include "tensorflow/core/lib/gtl/top_n.h"
@@ -68,6 +69,7 @@ class CTCBeamSearchDecoder : public CTCDecoder {
   //   P(l=abc? @ t=3) = P(a @ 0)*P(b @ 1)*P(c @ 2)*P(? @ 3)
   // but we calculate it recursively for speed purposes.
   typedef ctc_beam_search::BeamEntry<CTCBeamState> BeamEntry;
+  typedef ctc_beam_search::BeamEntryArena<CTCBeamState> BeamEntryArena;
   typedef ctc_beam_search::BeamProbability BeamProbability;
 
  public:
@@ -85,6 +87,7 @@ class CTCBeamSearchDecoder : public CTCDecoder {
       : CTCDecoder(num_classes, batch_size, merge_repeated),
         beam_width_(beam_width),
         leaves_(beam_width),
+        arena_(beam_width * (num_classes - 1) + 1),
         beam_scorer_(CHECK_NOTNULL(scorer)) {
     Reset();
   }
@@ -136,9 +139,17 @@ class CTCBeamSearchDecoder : public CTCDecoder {
   float label_selection_margin_ = -1;  // -1 means unlimited.
 
   gtl::TopN<BeamEntry*, CTCBeamComparer> leaves_;
-  std::unique_ptr<BeamEntry> beam_root_;
+  // Holds the root and all the entries of the current search, which are
+  // reused by the next search after Reset().
+  BeamEntryArena arena_;
+  BeamEntry* beam_root_ = nullptr;
   BaseBeamScorer<CTCBeamState>* beam_scorer_;
 
+  // Scratch space of Step(), kept to avoid allocating it at every step.
+  Eigen::ArrayXf input_;
+  std::vector<float> label_selection_input_;
+  std::vector<BeamEntry*> branches_;
+
   TF_DISALLOW_COPY_AND_ASSIGN(CTCBeamSearchDecoder);
 };
 
@@ -162,10 +173,9 @@ void CTCBeamSearchDecoder<CTCBeamState, CTCBeamComparer>::Decode(
     }  // for (int t...
 
     // O(n * log(n))
-    std::unique_ptr<std::vector<BeamEntry*>> branches(leaves_.Extract());
+    leaves_.ExtractNondestructive(&branches_);
     leaves_.Reset();
-    for (int i = 0; i < branches->size(); ++i) {
-      BeamEntry* entry = (*branches)[i];
+    for (BeamEntry* entry : branches_) {
       beam_scorer_->ExpandStateEnd(&entry->state);
       entry->newp.total +=
           beam_scorer_->GetStateEndExpansionScore(entry->state);
@@ -189,14 +199,17 @@ template <typename CTCBeamState, typename CTCBeamComparer>
 template <typename Vector>
 void CTCBeamSearchDecoder<CTCBeamState, CTCBeamComparer>::Step(
     const Vector& raw_input) {
-  Eigen::ArrayXf input = raw_input;
+  // Assigning to input_ only allocates when the number of classes changes.
+  Eigen::ArrayXf& input = input_;
+  input = raw_input;
   // Remove the max for stability when performing log-prob calculations.
   input -= input.maxCoeff();
 
   // Minimum allowed input value for label selection:
   float label_selection_input_min = -std::numeric_limits<float>::infinity();
   if (label_selection_size_ > 0 && label_selection_size_ < input.size()) {
-    std::vector<float> input_copy(input.data(), input.data() + input.size());
+    std::vector<float>& input_copy = label_selection_input_;
+    input_copy.assign(input.data(), input.data() + input.size());
     std::nth_element(input_copy.begin(),
                      input_copy.begin() + label_selection_size_ - 1,
                      input_copy.end(), [](float a, float b) { return a > b; });
@@ -211,15 +224,15 @@ void CTCBeamSearchDecoder<CTCBeamState, CTCBeamComparer>::Step(
   // Extract the beams sorted in decreasing new probability
   CHECK_EQ(num_classes_, input.size());
 
-  std::unique_ptr<std::vector<BeamEntry*>> branches(leaves_.Extract());
+  leaves_.ExtractNondestructive(&branches_);
   leaves_.Reset();
 
-  for (BeamEntry* b : *branches) {
+  for (BeamEntry* b : branches_) {
     // P(.. @ t) becomes the new P(.. @ t-1)
     b->oldp = b->newp;
   }
 
-  for (BeamEntry* b : *branches) {
+  for (BeamEntry* b : branches_) {
     if (b->parent != nullptr) {  // if not the root
       if (b->parent->Active()) {
         // If last two sequence characters are identical:
@@ -253,7 +266,7 @@ void CTCBeamSearchDecoder<CTCBeamState, CTCBeamComparer>::Step(
   // originally in descending newp order and we copied newp to oldp.
 
   // Grow new leaves
-  for (BeamEntry* b : *branches) {
+  for (BeamEntry* b : branches_) {
     // A new leaf (represented by its BeamProbability) is a candidate
     // iff its total probability is nonzero and either the beam list
     // isn't full, or the lowest probability entry in the beam has a
@@ -269,10 +282,10 @@ void CTCBeamSearchDecoder<CTCBeamState, CTCBeamComparer>::Step(
     }
 
     if (!b->HasChildren()) {
-      b->PopulateChildren(num_classes_ - 1);
+      b->PopulateChildren(num_classes_ - 1, &arena_);
     }
 
-    for (BeamEntry& c : *b->Children()) {
+    for (BeamEntry& c : b->Children()) {
       if (!c.Active()) {
         // Perform label selection: if input for this label looks very
         // unpromising, never evaluate it with a scorer.
@@ -314,14 +327,16 @@ template <typename CTCBeamState, typename CTCBeamComparer>
 void CTCBeamSearchDecoder<CTCBeamState, CTCBeamComparer>::Reset() {
   leaves_.Reset();
 
-  // This beam root, and all of its children, will be in memory until
+  // This beam root, and all of its children, will be in the arena until
   // the next reset.
-  beam_root_.reset(new BeamEntry(nullptr, -1, num_classes_ - 1, -1));
+  arena_.Reset();
+  beam_root_ = arena_.Allocate(1);
+  beam_root_->PopulateChildren(num_classes_ - 1, &arena_);
   beam_root_->newp.total = 0.0;  // ln(1)
   beam_root_->newp.blank = 0.0;  // ln(1)
 
   // Add the root as the initial leaf.
-  leaves_.push(beam_root_.get());
+  leaves_.push(beam_root_);
 
   // Call initialize state on the root object.
   beam_scorer_->InitializeState(&beam_root_->state);
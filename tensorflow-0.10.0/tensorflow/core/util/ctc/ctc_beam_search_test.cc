@@ -299,4 +299,25 @@ TEST(CtcBeamSearch, LabelSelection) {
   }
 }
 
+TEST(CtcBeamSearch, ArenaReusesEntries) {
+  typedef tensorflow::ctc::ctc_beam_search::BeamEntryArena<LabelState> Arena;
+  Arena arena(4);
+  Arena::Entry* root = arena.Allocate(1);
+  root->PopulateChildren(3, &arena);
+  EXPECT_EQ(root + 1, &root->Children()[0]);
+  root->Children()[1].state = 7;
+  root->Children()[1].newp.total = 0;
+  Arena::Entry* large = arena.Allocate(5);  // Needs a block of its own.
+
+  // After a reset, the same entries are handed out again, cleared.
+  arena.Reset();
+  EXPECT_EQ(root, arena.Allocate(1));
+  Arena::Entry* children = arena.Allocate(3);
+  EXPECT_EQ(root + 1, children);
+  EXPECT_EQ(0, children[1].state);
+  EXPECT_EQ(nullptr, children[1].parent);
+  EXPECT_FALSE(children[1].Active());
+  EXPECT_EQ(large, arena.Allocate(5));
+}
+
 }  // namespace
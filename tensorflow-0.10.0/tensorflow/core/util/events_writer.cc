@@ -164,4 +164,118 @@ bool EventsWriter::FileHasDisappeared() {
   }
 }
 
+AsyncEventsWriter::AsyncEventsWriter(const string& file_prefix, int max_queue,
+                                     int64 flush_millis)
+    : file_prefix_(file_prefix),
+      max_queue_(max_queue),
+      flush_millis_(flush_millis),
+      writer_(file_prefix) {
+  CHECK_GT(max_queue, 0);
+  CHECK_GE(flush_millis, 0);
+  thread_.reset(Env::Default()->StartThread(ThreadOptions(), "events_writer",
+                                            [this]() { WriterLoop(); }));
+}
+
+AsyncEventsWriter::~AsyncEventsWriter() {
+  {
+    mutex_lock l(mu_);
+    closing_ = true;
+  }
+  cv_.notify_one();
+  thread_.reset();  // Waits for WriterLoop() to return.
+  Close();
+}
+
+string AsyncEventsWriter::FileName() {
+  mutex_lock l(writer_mu_);
+  return writer_.FileName();
+}
+
+bool AsyncEventsWriter::WriteEvent(const Event& event) {
+  string record;
+  event.AppendToString(&record);
+  return WriteSerializedEvent(record);
+}
+
+bool AsyncEventsWriter::WriteSerializedEvent(StringPiece event_str) {
+  {
+    mutex_lock l(mu_);
+    if (queue_.size() >= static_cast<size_t>(max_queue_)) {
+      // Only the first of a run of drops is logged.
+      if (!dropping_) {
+        LOG(WARNING) << "Events queue is full, dropping events for "
+                     << file_prefix_;
+        dropping_ = true;
+      }
+      ++num_dropped_events_;
+      return false;
+    }
+    dropping_ = false;
+    queue_.emplace_back(event_str.data(), event_str.size());
+  }
+  cv_.notify_one();
+  return true;
+}
+
+bool AsyncEventsWriter::Flush() {
+  mutex_lock l(writer_mu_);
+  return WriteQueued(true);
+}
+
+bool AsyncEventsWriter::Close() {
+  mutex_lock l(writer_mu_);
+  WriteQueued(false);
+  return writer_.Close();
+}
+
+int64 AsyncEventsWriter::num_dropped_events() {
+  mutex_lock l(mu_);
+  return num_dropped_events_;
+}
+
+bool AsyncEventsWriter::WriteQueued(bool flush) {
+  std::deque<string> events;
+  {
+    mutex_lock l(mu_);
+    events.swap(queue_);
+  }
+  for (const string& event : events) {
+    writer_.WriteSerializedEvent(event);
+  }
+  return flush ? writer_.Flush() : true;
+}
+
+void AsyncEventsWriter::WriterLoop() {
+  Env* env = Env::Default();
+  // The first events are flushed right away.
+  uint64 next_flush_micros = 0;
+  bool unflushed = false;
+  while (true) {
+    {
+      mutex_lock l(mu_);
+      while (!closing_ && queue_.empty()) {
+        if (!unflushed) {
+          cv_.wait(l);
+          continue;
+        }
+        const uint64 now_micros = env->NowMicros();
+        if (now_micros >= next_flush_micros) break;
+        WaitForMilliseconds(&l, &cv_,
+                            (next_flush_micros - now_micros + 999) / 1000);
+      }
+      if (closing_) return;
+    }
+    mutex_lock l(writer_mu_);
+    const uint64 now_micros = env->NowMicros();
+    const bool flush = now_micros >= next_flush_micros;
+    WriteQueued(flush);
+    if (flush) {
+      next_flush_micros = now_micros + flush_millis_ * 1000;
+      unflushed = false;
+    } else {
+      unflushed = true;
+    }
+  }
+}
+
 }  // namespace tensorflow
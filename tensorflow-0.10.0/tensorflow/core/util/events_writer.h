@@ -16,11 +16,14 @@ limitations under the License.
 #ifndef TENSORFLOW_UTIL_EVENTS_WRITER_H_
 #define TENSORFLOW_UTIL_EVENTS_WRITER_H_
 
+#include <deque>
 #include <memory>
 #include <string>
 #include "tensorflow/core/lib/io/record_writer.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/event.pb.h"
 
@@ -88,6 +91,70 @@ class EventsWriter {
   TF_DISALLOW_COPY_AND_ASSIGN(EventsWriter);
 };
 
+// An EventsWriter that writes from a background thread, so that writing
+// events never blocks the caller on the file system.
+//
+// Events are queued and written by the background thread, which flushes them
+// to disk every flush_millis milliseconds.  At most max_queue events are held
+// at a time; events written while the queue is full are dropped, so a stalled
+// file system loses events instead of stalling the writers.
+class AsyncEventsWriter {
+ public:
+  AsyncEventsWriter(const string& file_prefix, int max_queue,
+                    int64 flush_millis);
+  ~AsyncEventsWriter();  // Writes the queued events and closes the file.
+
+  // Returns the filename for the current events file, opening it if needed.
+  // May block on a write in progress.
+  string FileName();
+
+  // Queues "event" to be appended to the file.  Returns false if it was
+  // dropped because the queue is full.
+  bool WriteEvent(const tensorflow::Event& event);
+
+  // Queues "event_str", a serialized Event, to be appended to the file.
+  // Returns false if it was dropped because the queue is full.
+  bool WriteSerializedEvent(tensorflow::StringPiece event_str);
+
+  // Like EventsWriter::Flush() and Close(), but first write the queued
+  // events.  These block the caller on the file system.
+  bool Flush();
+  bool Close();
+
+  // Returns the number of events dropped so far.
+  int64 num_dropped_events();
+
+ private:
+  // Appends the queued events to writer_, then flushes them if flush is true.
+  // Returns whether the flush succeeded.
+  bool WriteQueued(bool flush) EXCLUSIVE_LOCKS_REQUIRED(writer_mu_);
+
+  // Writes events until the destructor runs.
+  void WriterLoop();
+
+  const string file_prefix_;
+  const int max_queue_;
+  const int64 flush_millis_;
+
+  // Taken before mu_ by whoever writes to writer_, so that queued events
+  // are appended in order.
+  mutex writer_mu_;
+  EventsWriter writer_ GUARDED_BY(writer_mu_);
+
+  mutex mu_;
+  condition_variable cv_;
+  std::deque<string> queue_ GUARDED_BY(mu_);
+  int64 num_dropped_events_ GUARDED_BY(mu_) = 0;
+  bool dropping_ GUARDED_BY(mu_) = false;  // Whether the last write dropped.
+  bool closing_ GUARDED_BY(mu_) = false;
+
+  // Runs WriterLoop().  Declared last, so that it starts after and stops
+  // before the members it uses.
+  std::unique_ptr<Thread> thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AsyncEventsWriter);
+};
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_UTIL_EVENTS_WRITER_H_
@@ -34,7 +34,8 @@ namespace {
 // shorthand
 Env* env() { return Env::Default(); }
 
-void WriteSimpleValue(EventsWriter* writer, double wall_time, int64 step,
+template <typename Writer>
+void WriteSimpleValue(Writer* writer, double wall_time, int64 step,
                       const string& tag, float simple_value) {
   Event event;
   event.set_wall_time(wall_time);
@@ -45,7 +46,8 @@ void WriteSimpleValue(EventsWriter* writer, double wall_time, int64 step,
   writer->WriteEvent(event);
 }
 
-void WriteFile(EventsWriter* writer) {
+template <typename Writer>
+void WriteFile(Writer* writer) {
   WriteSimpleValue(writer, 1234, 34, "foo", 3.14159);
   WriteSimpleValue(writer, 2345, 35, "bar", -42);
 }
@@ -103,6 +105,18 @@ void VerifyFile(const string& filename) {
   delete reader;
 }
 
+// Returns the number of events readable from filename.
+int CountEvents(const string& filename) {
+  std::unique_ptr<RandomAccessFile> event_file;
+  TF_CHECK_OK(env()->NewRandomAccessFile(filename, &event_file));
+  io::RecordReader reader(event_file.get());
+  uint64 offset = 0;
+  Event event;
+  int count = 0;
+  while (ReadEventProto(&reader, &offset, &event)) ++count;
+  return count;
+}
+
 string GetDirName(const string& suffix) {
   return io::JoinPath(testing::TmpDir(), suffix);
 }
@@ -206,5 +220,54 @@ TEST(EventWriter, FileDeletionBeforeWriting) {
   VerifyFile(filename1);
 }
 
+TEST(AsyncEventWriter, WriteClose) {
+  string file_prefix = GetDirName("/asyncwriteclose_test");
+  AsyncEventsWriter writer(file_prefix, 10, 1000000);
+  EXPECT_TRUE(writer.WriteEvent(Event()));  // Opens the file.
+  string filename = writer.FileName();
+  EXPECT_TRUE(writer.Close());
+  EXPECT_TRUE(env()->DeleteFile(filename).ok());
+  WriteFile(&writer);
+  EXPECT_TRUE(writer.Close());
+  VerifyFile(writer.FileName());
+}
+
+TEST(AsyncEventWriter, WriteDelete) {
+  string file_prefix = GetDirName("/asyncwritedelete_test");
+  AsyncEventsWriter* writer = new AsyncEventsWriter(file_prefix, 10, 1000000);
+  WriteFile(writer);
+  string filename = writer->FileName();
+  delete writer;
+  VerifyFile(filename);
+}
+
+TEST(AsyncEventWriter, FlushesPeriodically) {
+  string file_prefix = GetDirName("/asyncflush_test");
+  AsyncEventsWriter writer(file_prefix, 10, 10);
+  string filename = writer.FileName();
+  WriteFile(&writer);
+  // The version event and both written events show up without a Flush().
+  for (int i = 0; i < 1000 && CountEvents(filename) < 3; ++i) {
+    env()->SleepForMicroseconds(10000);
+  }
+  EXPECT_EQ(3, CountEvents(filename));
+  EXPECT_EQ(0, writer.num_dropped_events());
+}
+
+TEST(AsyncEventWriter, DropsEventsWhenQueueIsFull) {
+  string file_prefix = GetDirName("/asyncdrop_test");
+  AsyncEventsWriter writer(file_prefix, 1, 0);
+  const int kNumEvents = 1000;
+  int num_written = 0;
+  for (int i = 0; i < kNumEvents; ++i) {
+    Event event;
+    event.set_step(i);
+    if (writer.WriteEvent(event)) ++num_written;
+  }
+  EXPECT_TRUE(writer.Close());
+  EXPECT_EQ(kNumEvents - num_written, writer.num_dropped_events());
+  EXPECT_EQ(1 + num_written, CountEvents(writer.FileName()));
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -0,0 +1,398 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/example_proto_fast_parsing.h"
+
+#include <string.h>
+
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+
+namespace tensorflow {
+namespace {
+
+// Wire types of the protocol buffer encoding.
+enum WireType {
+  kVarint = 0,
+  kFixed64 = 1,
+  kLengthDelimited = 2,
+  kFixed32 = 5,
+};
+
+// Field numbers of the kinds of a Feature.
+enum FeatureKind {
+  kBytesList = 1,
+  kFloatList = 2,
+  kInt64List = 3,
+};
+
+// Reads the tag of the next field of a message.
+bool ReadTag(StringPiece* input, uint32* field, uint32* wire_type) {
+  uint32 tag;
+  if (!core::GetVarint32(input, &tag)) return false;
+  *field = tag >> 3;
+  *wire_type = tag & 7;
+  return *field != 0;
+}
+
+// Reads the value of a length-delimited field.
+bool ReadLengthDelimited(StringPiece* input, StringPiece* value) {
+  uint32 length;
+  if (!core::GetVarint32(input, &length) || length > input->size()) {
+    return false;
+  }
+  *value = StringPiece(input->data(), length);
+  input->remove_prefix(length);
+  return true;
+}
+
+// Skips the value of a field with the given wire type. Groups are not
+// supported, since Examples have none.
+bool SkipValue(StringPiece* input, uint32 wire_type) {
+  switch (wire_type) {
+    case kVarint: {
+      uint64 unused;
+      return core::GetVarint64(input, &unused);
+    }
+    case kFixed64:
+      if (input->size() < 8) return false;
+      input->remove_prefix(8);
+      return true;
+    case kLengthDelimited: {
+      StringPiece unused;
+      return ReadLengthDelimited(input, &unused);
+    }
+    case kFixed32:
+      if (input->size() < 4) return false;
+      input->remove_prefix(4);
+      return true;
+    default:
+      return false;
+  }
+}
+
+float DecodeFloat(const char* data) {
+  const uint32 bits = core::DecodeFixed32(data);
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+// Parse() calls emit on each value of the `repeated T value = 1` field of the
+// list message of a Feature, in order, and returns false if the list is
+// malformed or emit returns false. Numeric values may be packed or not, and
+// bytes values are passed as ValueType pieces of the list.
+template <typename T>
+struct ListParser;
+
+template <>
+struct ListParser<float> {
+  typedef float ValueType;
+  static const int kKind = kFloatList;
+
+  template <typename Emit>
+  static bool Parse(StringPiece list, const Emit& emit) {
+    while (!list.empty()) {
+      uint32 field;
+      uint32 wire_type;
+      if (!ReadTag(&list, &field, &wire_type)) return false;
+      if (field != 1) {
+        if (!SkipValue(&list, wire_type)) return false;
+      } else if (wire_type == kLengthDelimited) {
+        StringPiece packed;
+        if (!ReadLengthDelimited(&list, &packed) || packed.size() % 4 != 0) {
+          return false;
+        }
+        for (size_t i = 0; i < packed.size(); i += 4) {
+          if (!emit(DecodeFloat(packed.data() + i))) return false;
+        }
+      } else if (wire_type == kFixed32) {
+        if (list.size() < 4 || !emit(DecodeFloat(list.data()))) return false;
+        list.remove_prefix(4);
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+template <>
+struct ListParser<int64> {
+  typedef int64 ValueType;
+  static const int kKind = kInt64List;
+
+  template <typename Emit>
+  static bool Parse(StringPiece list, const Emit& emit) {
+    while (!list.empty()) {
+      uint32 field;
+      uint32 wire_type;
+      if (!ReadTag(&list, &field, &wire_type)) return false;
+      uint64 value;
+      if (field != 1) {
+        if (!SkipValue(&list, wire_type)) return false;
+      } else if (wire_type == kLengthDelimited) {
+        StringPiece packed;
+        if (!ReadLengthDelimited(&list, &packed)) return false;
+        while (!packed.empty()) {
+          if (!core::GetVarint64(&packed, &value) ||
+              !emit(static_cast<int64>(value))) {
+            return false;
+          }
+        }
+      } else if (wire_type == kVarint) {
+        if (!core::GetVarint64(&list, &value) ||
+            !emit(static_cast<int64>(value))) {
+          return false;
+        }
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+template <>
+struct ListParser<string> {
+  typedef StringPiece ValueType;
+  static const int kKind = kBytesList;
+
+  template <typename Emit>
+  static bool Parse(StringPiece list, const Emit& emit) {
+    while (!list.empty()) {
+      uint32 field;
+      uint32 wire_type;
+      if (!ReadTag(&list, &field, &wire_type)) return false;
+      if (field != 1) {
+        if (!SkipValue(&list, wire_type)) return false;
+      } else if (wire_type == kLengthDelimited) {
+        StringPiece value;
+        if (!ReadLengthDelimited(&list, &value) || !emit(value)) return false;
+      } else {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+template <typename T>
+void Assign(T value, T* out) {
+  *out = value;
+}
+
+void Assign(StringPiece value, string* out) {
+  out->assign(value.data(), value.size());
+}
+
+// Decodes a list of the given kind into row batch_index of a dense output
+// with num_elements values per row.
+template <typename T>
+bool DenseCopy(int kind, StringPiece list, int batch_index,
+               int64 num_elements, Tensor* out) {
+  if (kind != ListParser<T>::kKind) return false;
+  T* values = out->flat<T>().data() + batch_index * num_elements;
+  int64 num_values = 0;
+  const bool parsed = ListParser<T>::Parse(
+      list, [values, num_elements,
+             &num_values](typename ListParser<T>::ValueType value) {
+        if (num_values == num_elements) return false;
+        Assign(value, values + num_values++);
+        return true;
+      });
+  return parsed && num_values == num_elements;
+}
+
+// Decodes a list of the given kind into a new vector of values.
+template <typename T>
+bool SparseCopy(int kind, StringPiece list, Tensor* out) {
+  typedef typename ListParser<T>::ValueType ValueType;
+  if (kind != ListParser<T>::kKind) return false;
+  int64 num_values = 0;
+  if (!ListParser<T>::Parse(list, [&num_values](ValueType) {
+        ++num_values;
+        return true;
+      })) {
+    return false;
+  }
+  *out = Tensor(DataTypeToEnum<T>::value, TensorShape({num_values}));
+  T* values = out->flat<T>().data();
+  ListParser<T>::Parse(list, [&values](ValueType value) {
+    Assign(value, values++);
+    return true;
+  });
+  return true;
+}
+
+}  // namespace
+
+FastExampleParser::FastExampleParser(
+    const std::vector<FixedLenFeature>& fixed_len_features,
+    const std::vector<VarLenFeature>& var_len_features)
+    : fixed_len_features_(fixed_len_features),
+      var_len_features_(var_len_features) {
+  for (size_t d = 0; d < fixed_len_features_.size(); ++d) {
+    feature_index_.insert({fixed_len_features_[d].key, static_cast<int>(d)});
+  }
+  for (size_t d = 0; d < var_len_features_.size(); ++d) {
+    feature_index_.insert({var_len_features_[d].key,
+                           static_cast<int>(fixed_len_features_.size() + d)});
+  }
+  distinct_keys_ = feature_index_.size() ==
+                   fixed_len_features_.size() + var_len_features_.size();
+}
+
+bool FastExampleParser::ParseFeature(
+    StringPiece value, bool dense, int d, int batch_index,
+    std::vector<Tensor*>* dense_values,
+    std::vector<std::vector<Tensor>>* sparse_values, bool* has_data) const {
+  // A Feature sets one kind of list. Merging several, as proto parsing
+  // would, is left to the fallback.
+  int kind = 0;
+  StringPiece list;
+  while (!value.empty()) {
+    uint32 field;
+    uint32 wire_type;
+    if (!ReadTag(&value, &field, &wire_type)) return false;
+    if (field == kBytesList || field == kFloatList || field == kInt64List) {
+      if (kind != 0 || wire_type != kLengthDelimited ||
+          !ReadLengthDelimited(&value, &list)) {
+        return false;
+      }
+      kind = field;
+    } else if (!SkipValue(&value, wire_type)) {
+      return false;
+    }
+  }
+  *has_data = kind != 0;
+  if (!*has_data) return true;
+
+  if (dense) {
+    const FixedLenFeature& config = fixed_len_features_[d];
+    const int64 num_elements = config.shape.num_elements();
+    Tensor* out = (*dense_values)[d];
+    switch (config.dtype) {
+      case DT_INT64:
+        return DenseCopy<int64>(kind, list, batch_index, num_elements, out);
+      case DT_FLOAT:
+        return DenseCopy<float>(kind, list, batch_index, num_elements, out);
+      case DT_STRING:
+        return DenseCopy<string>(kind, list, batch_index, num_elements, out);
+      default:
+        return false;
+    }
+  }
+  Tensor* out = &(*sparse_values)[d][batch_index];
+  switch (var_len_features_[d].dtype) {
+    case DT_INT64:
+      return SparseCopy<int64>(kind, list, out);
+    case DT_FLOAT:
+      return SparseCopy<float>(kind, list, out);
+    case DT_STRING:
+      return SparseCopy<string>(kind, list, out);
+    default:
+      return false;
+  }
+}
+
+bool FastExampleParser::Parse(
+    StringPiece serialized, int batch_index,
+    std::vector<Tensor*>* dense_values,
+    std::vector<std::vector<Tensor>>* sparse_values_temporary_vector) const {
+  if (!distinct_keys_) return false;
+  const int num_dense = fixed_len_features_.size();
+  const int num_features = num_dense + var_len_features_.size();
+  gtl::InlinedVector<bool, 16> seen(num_features, false);
+  gtl::InlinedVector<bool, 16> has_data(num_features, false);
+
+  // Example.features is field 1, Features.feature field 1, and the key and
+  // value of a map entry fields 1 and 2.
+  StringPiece example = serialized;
+  while (!example.empty()) {
+    uint32 field;
+    uint32 wire_type;
+    if (!ReadTag(&example, &field, &wire_type)) return false;
+    if (field != 1) {
+      if (!SkipValue(&example, wire_type)) return false;
+      continue;
+    }
+    StringPiece features;
+    if (wire_type != kLengthDelimited ||
+        !ReadLengthDelimited(&example, &features)) {
+      return false;
+    }
+    while (!features.empty()) {
+      if (!ReadTag(&features, &field, &wire_type)) return false;
+      if (field != 1) {
+        if (!SkipValue(&features, wire_type)) return false;
+        continue;
+      }
+      StringPiece entry;
+      if (wire_type != kLengthDelimited ||
+          !ReadLengthDelimited(&features, &entry)) {
+        return false;
+      }
+      StringPiece key;
+      StringPiece value;
+      bool has_value = false;
+      while (!entry.empty()) {
+        if (!ReadTag(&entry, &field, &wire_type)) return false;
+        if (field == 1 || field == 2) {
+          if (wire_type != kLengthDelimited) return false;
+          if (field == 2 && has_value) return false;
+          if (!ReadLengthDelimited(&entry, field == 1 ? &key : &value)) {
+            return false;
+          }
+          has_value |= field == 2;
+        } else if (!SkipValue(&entry, wire_type)) {
+          return false;
+        }
+      }
+
+      auto it = feature_index_.find(key);
+      if (it == feature_index_.end()) continue;
+      const int index = it->second;
+      if (seen[index]) return false;
+      seen[index] = true;
+      bool feature_has_data;
+      if (!ParseFeature(value, index < num_dense,
+                        index < num_dense ? index : index - num_dense,
+                        batch_index, dense_values,
+                        sparse_values_temporary_vector, &feature_has_data)) {
+        return false;
+      }
+      has_data[index] = feature_has_data;
+    }
+  }
+
+  // Missing dense features take their default, and missing sparse features
+  // have no values.
+  for (int d = 0; d < num_dense; ++d) {
+    if (has_data[d]) continue;
+    const FixedLenFeature& config = fixed_len_features_[d];
+    if (config.default_value.NumElements() == 0) return false;
+    RowDenseCopy(batch_index, config.dtype, config.default_value,
+                 (*dense_values)[d]);
+  }
+  for (size_t d = 0; d < var_len_features_.size(); ++d) {
+    if (has_data[num_dense + d]) continue;
+    (*sparse_values_temporary_vector)[d][batch_index] =
+        Tensor(var_len_features_[d].dtype, TensorShape({0}));
+  }
+  return true;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,82 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef THIRD_PARTY_TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
+#define THIRD_PARTY_TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
+
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/gtl/flat_hash_map.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/example_proto_helper.h"
+
+namespace tensorflow {
+
+// Parses serialized tensorflow::Examples straight from their wire format into
+// the outputs of SingleExampleProtoToTensors. Only the features named in the
+// configurations are decoded; the rest of the Example is skipped over without
+// building any proto objects, and dense values are written straight into the
+// output tensors.
+//
+// The parser handles well-formed Examples that give each configured feature
+// at most once. For anything else, including Examples that
+// SingleExampleProtoToTensors would reject, Parse() returns false, and the
+// caller falls back to parsing the full proto, which also produces the error
+// messages. Unlike proto parsing, the parser does not check the encoding of
+// the features it skips.
+class FastExampleParser {
+ public:
+  // The configurations must outlive the parser. If a key is configured more
+  // than once, Parse() always falls back.
+  FastExampleParser(const std::vector<FixedLenFeature>& fixed_len_features,
+                    const std::vector<VarLenFeature>& var_len_features);
+
+  // Parses the Example serialized into row batch_index of dense_values and
+  // sparse_values_temporary_vector, like SingleExampleProtoToTensors. Returns
+  // false if the Example has to be parsed as a proto instead, in which case
+  // the row may have been partly written. Thread-safe.
+  bool Parse(StringPiece serialized, int batch_index,
+             std::vector<Tensor*>* dense_values,
+             std::vector<std::vector<Tensor>>* sparse_values_temporary_vector)
+      const;
+
+ private:
+  // Decodes the Feature value of a configured feature, with index d into the
+  // dense features if dense is true and otherwise the sparse features. Sets
+  // *has_data to false if the Feature has no kind set.
+  bool ParseFeature(StringPiece value, bool dense, int d, int batch_index,
+                    std::vector<Tensor*>* dense_values,
+                    std::vector<std::vector<Tensor>>* sparse_values,
+                    bool* has_data) const;
+
+  const std::vector<FixedLenFeature>& fixed_len_features_;
+  const std::vector<VarLenFeature>& var_len_features_;
+
+  // Index of each configured feature by key. Dense features come first, and
+  // sparse feature d has index fixed_len_features_.size() + d.
+  gtl::FlatHashMap<StringPiece, int, StringPiece::Hasher> feature_index_;
+
+  // Whether all configured keys are distinct.
+  bool distinct_keys_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(FastExampleParser);
+};
+
+}  // namespace tensorflow
+
+#endif  // THIRD_PARTY_TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
@@ -0,0 +1,221 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/example_proto_fast_parsing.h"
+
+#include "tensorflow/core/example/example.pb.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kDenseInt64Key[] = "dense_int64";
+constexpr char kDenseFloatKey[] = "dense_float";
+constexpr char kDenseStringKey[] = "dense_string";
+
+constexpr char kSparseInt64Key[] = "sparse_int64";
+constexpr char kSparseFloatKey[] = "sparse_float";
+constexpr char kSparseStringKey[] = "sparse_string";
+
+// Returns the encoding of a length-delimited field.
+string LengthDelimited(int field, const string& value) {
+  string encoded;
+  core::PutVarint32(&encoded, field << 3 | 2);
+  core::PutVarint32(&encoded, value.size());
+  return encoded + value;
+}
+
+// Returns the encoding of a fixed32 float field.
+string Fixed32(int field, float value) {
+  string encoded;
+  core::PutVarint32(&encoded, field << 3 | 5);
+  uint32 bits;
+  memcpy(&bits, &value, sizeof(bits));
+  core::PutFixed32(&encoded, bits);
+  return encoded;
+}
+
+// Returns the encoding of a varint field.
+string Varint(int field, uint64 value) {
+  string encoded;
+  core::PutVarint32(&encoded, field << 3);
+  core::PutVarint64(&encoded, value);
+  return encoded;
+}
+
+// Returns the encoding of an Example with the given Feature map entries.
+string EncodeExample(const std::vector<std::pair<string, string>>& features) {
+  string entries;
+  for (const auto& feature : features) {
+    entries += LengthDelimited(1, LengthDelimited(1, feature.first) +
+                                      LengthDelimited(2, feature.second));
+  }
+  return LengthDelimited(1, entries);
+}
+
+class FastExampleParserTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FixedLenFeature int64_dense_config;
+    int64_dense_config.key = kDenseInt64Key;
+    int64_dense_config.dtype = DT_INT64;
+    int64_dense_config.shape = TensorShape({1});
+    int64_dense_config.default_value = Tensor(DT_INT64, TensorShape({1}));
+    int64_dense_config.default_value.flat<int64>()(0) = 7;
+    dense_vec_.push_back(int64_dense_config);
+
+    // Required, with two values.
+    FixedLenFeature float_dense_config;
+    float_dense_config.key = kDenseFloatKey;
+    float_dense_config.dtype = DT_FLOAT;
+    float_dense_config.shape = TensorShape({2});
+    dense_vec_.push_back(float_dense_config);
+
+    FixedLenFeature string_dense_config;
+    string_dense_config.key = kDenseStringKey;
+    string_dense_config.dtype = DT_STRING;
+    string_dense_config.shape = TensorShape({1});
+    string_dense_config.default_value = Tensor(DT_STRING, TensorShape({1}));
+    string_dense_config.default_value.flat<string>()(0) = "default";
+    dense_vec_.push_back(string_dense_config);
+
+    VarLenFeature int64_sparse_config;
+    int64_sparse_config.key = kSparseInt64Key;
+    int64_sparse_config.dtype = DT_INT64;
+    sparse_vec_.push_back(int64_sparse_config);
+
+    VarLenFeature float_sparse_config;
+    float_sparse_config.key = kSparseFloatKey;
+    float_sparse_config.dtype = DT_FLOAT;
+    sparse_vec_.push_back(float_sparse_config);
+
+    VarLenFeature string_sparse_config;
+    string_sparse_config.key = kSparseStringKey;
+    string_sparse_config.dtype = DT_STRING;
+    sparse_vec_.push_back(string_sparse_config);
+  }
+
+  // Outputs of parsing a batch of two, of which the second Example is parsed.
+  struct Outputs {
+    explicit Outputs(const std::vector<FixedLenFeature>& dense_vec)
+        : sparse(3, std::vector<Tensor>(2)) {
+      for (const FixedLenFeature& config : dense_vec) {
+        TensorShape shape({2});
+        shape.AppendShape(config.shape);
+        dense.emplace_back(config.dtype, shape);
+      }
+      for (Tensor& tensor : dense) dense_pointers.push_back(&tensor);
+    }
+
+    std::vector<Tensor> dense;
+    std::vector<Tensor*> dense_pointers;
+    std::vector<std::vector<Tensor>> sparse;
+  };
+
+  // Returns whether the fast parser parses serialized, and expects the same
+  // outputs as from parsing it as a proto if it does.
+  bool ParsesLikeProto(const string& serialized) {
+    FastExampleParser parser(dense_vec_, sparse_vec_);
+    Outputs fast(dense_vec_);
+    if (!parser.Parse(serialized, 1, &fast.dense_pointers, &fast.sparse)) {
+      return false;
+    }
+    Example example;
+    EXPECT_TRUE(example.ParseFromString(serialized));
+    Outputs expected(dense_vec_);
+    TF_EXPECT_OK(SingleExampleProtoToTensors(
+        example, "", 1, dense_vec_, sparse_vec_, &expected.dense_pointers,
+        &expected.sparse));
+    test::ExpectTensorEqual<int64>(expected.dense[0].Slice(1, 2),
+                                   fast.dense[0].Slice(1, 2));
+    test::ExpectTensorEqual<float>(expected.dense[1].Slice(1, 2),
+                                   fast.dense[1].Slice(1, 2));
+    test::ExpectTensorEqual<string>(expected.dense[2].Slice(1, 2),
+                                    fast.dense[2].Slice(1, 2));
+    test::ExpectTensorEqual<int64>(expected.sparse[0][1], fast.sparse[0][1]);
+    test::ExpectTensorEqual<float>(expected.sparse[1][1], fast.sparse[1][1]);
+    test::ExpectTensorEqual<string>(expected.sparse[2][1], fast.sparse[2][1]);
+    return true;
+  }
+
+  std::vector<FixedLenFeature> dense_vec_;
+  std::vector<VarLenFeature> sparse_vec_;
+};
+
+TEST_F(FastExampleParserTest, ParsesAllFeatures) {
+  Example example;
+  auto& feature_dict = *example.mutable_features()->mutable_feature();
+  feature_dict[kDenseInt64Key].mutable_int64_list()->add_value(-42);
+  feature_dict[kDenseFloatKey].mutable_float_list()->add_value(1.5);
+  feature_dict[kDenseFloatKey].mutable_float_list()->add_value(-2.5);
+  feature_dict[kDenseStringKey].mutable_bytes_list()->add_value("dense");
+  feature_dict[kSparseInt64Key].mutable_int64_list()->add_value(1LL << 40);
+  feature_dict[kSparseInt64Key].mutable_int64_list()->add_value(3);
+  feature_dict[kSparseFloatKey].mutable_float_list()->add_value(0.25);
+  feature_dict[kSparseStringKey].mutable_bytes_list()->add_value("a");
+  feature_dict[kSparseStringKey].mutable_bytes_list()->add_value("");
+  feature_dict[kSparseStringKey].mutable_bytes_list()->add_value("bc");
+  feature_dict["unused"].mutable_bytes_list()->add_value("skipped");
+  EXPECT_TRUE(ParsesLikeProto(example.SerializeAsString()));
+}
+
+TEST_F(FastExampleParserTest, FillsInMissingFeatures) {
+  Example example;
+  auto& feature_dict = *example.mutable_features()->mutable_feature();
+  feature_dict[kDenseFloatKey].mutable_float_list()->add_value(1);
+  feature_dict[kDenseFloatKey].mutable_float_list()->add_value(2);
+  // Features without a kind are missing.
+  feature_dict[kDenseStringKey];
+  feature_dict[kSparseFloatKey];
+  EXPECT_TRUE(ParsesLikeProto(example.SerializeAsString()));
+}
+
+TEST_F(FastExampleParserTest, ParsesUnpackedValues) {
+  const string serialized = EncodeExample(
+      {{kDenseFloatKey,
+        LengthDelimited(2, Fixed32(1, 3.0) + Fixed32(1, 4.0))},
+       {kSparseInt64Key,
+        LengthDelimited(3, Varint(1, 5) + Varint(1, static_cast<uint64>(-6)))},
+       {kSparseFloatKey, LengthDelimited(2, Fixed32(1, 0.5))}});
+  EXPECT_TRUE(ParsesLikeProto(serialized));
+}
+
+TEST_F(FastExampleParserTest, FallsBack) {
+  Example example;
+  auto& feature_dict = *example.mutable_features()->mutable_feature();
+  feature_dict[kDenseFloatKey].mutable_float_list()->add_value(1);
+  feature_dict[kDenseFloatKey].mutable_float_list()->add_value(2);
+  const string serialized = example.SerializeAsString();
+  ASSERT_TRUE(ParsesLikeProto(serialized));
+
+  // Truncated.
+  EXPECT_FALSE(ParsesLikeProto(serialized.substr(0, serialized.size() - 1)));
+  // A feature given twice, which proto parsing merges.
+  EXPECT_FALSE(ParsesLikeProto(serialized + serialized));
+  // Errors of SingleExampleProtoToTensors.
+  feature_dict[kDenseFloatKey].mutable_float_list()->add_value(3);
+  EXPECT_FALSE(ParsesLikeProto(example.SerializeAsString()));
+  feature_dict.erase(kDenseFloatKey);
+  EXPECT_FALSE(ParsesLikeProto(example.SerializeAsString()));
+  feature_dict[kDenseFloatKey].mutable_int64_list()->add_value(1);
+  feature_dict[kDenseFloatKey].mutable_int64_list()->add_value(2);
+  EXPECT_FALSE(ParsesLikeProto(example.SerializeAsString()));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,119 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/packed_strings.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/errors.h"
+
+namespace tensorflow {
+
+Status PackedStrings::FromTensors(const Tensor& bytes, const Tensor& offsets,
+                                  PackedStrings* packed) {
+  if (bytes.dtype() != DT_UINT8 || !TensorShapeUtils::IsVector(bytes.shape())) {
+    return errors::InvalidArgument(
+        "Packed string bytes must be a uint8 vector");
+  }
+  if (offsets.dtype() != DT_INT64 ||
+      !TensorShapeUtils::IsVector(offsets.shape()) ||
+      offsets.NumElements() == 0) {
+    return errors::InvalidArgument(
+        "Packed string offsets must be a non-empty int64 vector");
+  }
+  const int64 size = offsets.NumElements() - 1;
+  const int64* data = offsets.vec<int64>().data();
+  if (data[0] != 0 || data[size] != bytes.NumElements()) {
+    return errors::InvalidArgument("Packed string offsets must start at 0 and "
+                                   "end at the number of bytes, ",
+                                   bytes.NumElements());
+  }
+  for (int64 i = 0; i < size; ++i) {
+    if (data[i + 1] < data[i]) {
+      return errors::InvalidArgument("Packed string offset ", i + 1,
+                                     " is less than the previous one");
+    }
+  }
+  packed->bytes_ = reinterpret_cast<const char*>(bytes.vec<uint8>().data());
+  packed->offsets_ = data;
+  packed->size_ = size;
+  return Status::OK();
+}
+
+void PackedStrings::ToStrings(Tensor* strings) const {
+  CHECK_EQ(strings->dtype(), DT_STRING);
+  CHECK_EQ(strings->NumElements(), size_);
+  auto values = strings->flat<string>();
+  for (int64 i = 0; i < size_; ++i) {
+    values(i).assign(bytes_ + offsets_[i], offsets_[i + 1] - offsets_[i]);
+  }
+}
+
+int64 PackedStrings::NumBytes(const Tensor& strings) {
+  int64 num_bytes = 0;
+  auto values = strings.flat<string>();
+  for (int64 i = 0; i < values.size(); ++i) num_bytes += values(i).size();
+  return num_bytes;
+}
+
+void PackedStrings::Pack(const Tensor& strings, Tensor* bytes,
+                         Tensor* offsets) {
+  auto values = strings.flat<string>();
+  CHECK_EQ(bytes->NumElements(), NumBytes(strings));
+  CHECK_EQ(offsets->NumElements(), values.size() + 1);
+  char* output = reinterpret_cast<char*>(bytes->flat<uint8>().data());
+  auto offset = offsets->flat<int64>();
+  offset(0) = 0;
+  for (int64 i = 0; i < values.size(); ++i) {
+    const string& value = values(i);
+    if (!value.empty()) memcpy(output + offset(i), value.data(), value.size());
+    offset(i + 1) = offset(i) + value.size();
+  }
+}
+
+void PackedStringsBuilder::Reserve(int64 num_strings, int64 num_bytes) {
+  offsets_.reserve(offsets_.size() + num_strings);
+  bytes_.reserve(bytes_.size() + num_bytes);
+}
+
+void PackedStringsBuilder::Append(StringPiece value) {
+  bytes_.append(value.data(), value.size());
+  offsets_.push_back(bytes_.size());
+}
+
+char* PackedStringsBuilder::AppendUninitialized(int64 size) {
+  const size_t start = bytes_.size();
+  bytes_.resize(start + size);
+  offsets_.push_back(bytes_.size());
+  return &bytes_[0] + start;
+}
+
+void PackedStringsBuilder::Finish(Allocator* allocator, Tensor* bytes,
+                                  Tensor* offsets) {
+  *bytes = Tensor(allocator, DT_UINT8,
+                  TensorShape({static_cast<int64>(bytes_.size())}));
+  if (!bytes_.empty()) {
+    memcpy(bytes->flat<uint8>().data(), bytes_.data(), bytes_.size());
+  }
+  *offsets = Tensor(allocator, DT_INT64,
+                    TensorShape({static_cast<int64>(offsets_.size())}));
+  std::copy(offsets_.begin(), offsets_.end(), offsets->flat<int64>().data());
+  bytes_.clear();
+  offsets_.assign(1, 0);
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,114 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef THIRD_PARTY_TENSORFLOW_CORE_UTIL_PACKED_STRINGS_H_
+#define THIRD_PARTY_TENSORFLOW_CORE_UTIL_PACKED_STRINGS_H_
+
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A vector of strings held by two tensors: a DT_UINT8 vector with the bytes of
+// all strings one after the other, and a DT_INT64 vector of n + 1 offsets,
+// string i being the bytes [offsets(i), offsets(i + 1)). A DT_STRING tensor
+// holds a separate string per element, so building one allocates for every
+// element, and so does copying it. Packed strings take two allocations however
+// many strings they hold, and copying, concatenating or sending them moves two
+// flat buffers. The PackStrings and UnpackStrings ops convert between both
+// forms.
+//
+// A PackedStrings object is a read-only view of packed strings, which
+// returns them as StringPieces into the byte tensor.
+class PackedStrings {
+ public:
+  PackedStrings() {}
+
+  // Makes packed a view of the packed strings of the given tensors, which
+  // must outlive it. Returns an error if the tensors do not hold packed
+  // strings.
+  static Status FromTensors(const Tensor& bytes, const Tensor& offsets,
+                            PackedStrings* packed);
+
+  // Number of strings.
+  int64 size() const { return size_; }
+
+  // Returns string i, which must be in [0, size()).
+  StringPiece operator[](int64 i) const {
+    return StringPiece(bytes_ + offsets_[i], offsets_[i + 1] - offsets_[i]);
+  }
+
+  // Number of bytes of all strings.
+  int64 num_bytes() const { return size_ == 0 ? 0 : offsets_[size_]; }
+
+  // Copies the strings into a DT_STRING tensor with size() elements, in row
+  // major order. This is the legacy form for ops which take DT_STRING inputs.
+  void ToStrings(Tensor* strings) const;
+
+  // Returns the number of bytes of the packed form of a DT_STRING tensor.
+  static int64 NumBytes(const Tensor& strings);
+
+  // Packs the elements of a DT_STRING tensor, in row major order, into a
+  // DT_UINT8 tensor of NumBytes(strings) elements and a DT_INT64 tensor of
+  // strings.NumElements() + 1 elements.
+  static void Pack(const Tensor& strings, Tensor* bytes, Tensor* offsets);
+
+ private:
+  const char* bytes_ = nullptr;
+  const int64* offsets_ = nullptr;
+  int64 size_ = 0;
+};
+
+// Builds packed strings from strings appended one at a time, e.g. protos
+// serialized straight into the buffer of the builder. The bytes are copied
+// once more into the byte tensor at the end.
+class PackedStringsBuilder {
+ public:
+  PackedStringsBuilder() : offsets_(1, 0) {}
+
+  // Reserves space for the given number of strings and bytes.
+  void Reserve(int64 num_strings, int64 num_bytes);
+
+  // Appends a string.
+  void Append(StringPiece value);
+
+  // Appends a string of the given size, and returns a pointer to its bytes,
+  // which the caller writes before appending anything else.
+  char* AppendUninitialized(int64 size);
+
+  // Number of strings appended so far.
+  int64 size() const { return offsets_.size() - 1; }
+
+  // Allocates the byte and offset tensors of the appended strings from the
+  // given allocator and copies the strings into them. Leaves the builder
+  // empty.
+  void Finish(Allocator* allocator, Tensor* bytes, Tensor* offsets);
+
+ private:
+  string bytes_;
+  std::vector<int64> offsets_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(PackedStringsBuilder);
+};
+
+}  // namespace tensorflow
+
+#endif  // THIRD_PARTY_TENSORFLOW_CORE_UTIL_PACKED_STRINGS_H_
@@ -0,0 +1,99 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/packed_strings.h"
+
+#include <string.h>
+
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(PackedStringsTest, PacksAndUnpacks) {
+  Tensor strings = test::AsTensor<string>({"ab", "", "cde", "f"}, {2, 2});
+  ASSERT_EQ(6, PackedStrings::NumBytes(strings));
+  Tensor bytes(DT_UINT8, TensorShape({6}));
+  Tensor offsets(DT_INT64, TensorShape({5}));
+  PackedStrings::Pack(strings, &bytes, &offsets);
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({0, 2, 2, 5, 6}),
+                                 offsets);
+
+  PackedStrings packed;
+  TF_ASSERT_OK(PackedStrings::FromTensors(bytes, offsets, &packed));
+  ASSERT_EQ(4, packed.size());
+  EXPECT_EQ(6, packed.num_bytes());
+  EXPECT_EQ("ab", packed[0]);
+  EXPECT_EQ("", packed[1]);
+  EXPECT_EQ("cde", packed[2]);
+  EXPECT_EQ("f", packed[3]);
+
+  Tensor unpacked(DT_STRING, TensorShape({2, 2}));
+  packed.ToStrings(&unpacked);
+  test::ExpectTensorEqual<string>(strings, unpacked);
+}
+
+TEST(PackedStringsTest, BuildsPackedStrings) {
+  PackedStringsBuilder builder;
+  builder.Reserve(3, 8);
+  builder.Append("one");
+  memcpy(builder.AppendUninitialized(3), "two", 3);
+  builder.Append("");
+  EXPECT_EQ(3, builder.size());
+  Tensor bytes, offsets;
+  builder.Finish(cpu_allocator(), &bytes, &offsets);
+  EXPECT_EQ(0, builder.size());
+
+  PackedStrings packed;
+  TF_ASSERT_OK(PackedStrings::FromTensors(bytes, offsets, &packed));
+  ASSERT_EQ(3, packed.size());
+  EXPECT_EQ("one", packed[0]);
+  EXPECT_EQ("two", packed[1]);
+  EXPECT_EQ("", packed[2]);
+
+  builder.Finish(cpu_allocator(), &bytes, &offsets);
+  TF_ASSERT_OK(PackedStrings::FromTensors(bytes, offsets, &packed));
+  EXPECT_EQ(0, packed.size());
+  EXPECT_EQ(0, packed.num_bytes());
+}
+
+TEST(PackedStringsTest, RejectsInvalidTensors) {
+  const Tensor bytes = test::AsTensor<uint8>({'a', 'b', 'c'});
+  PackedStrings packed;
+  EXPECT_FALSE(PackedStrings::FromTensors(test::AsTensor<int32>({1, 2, 3}),
+                                          test::AsTensor<int64>({0, 3}),
+                                          &packed)
+                   .ok());
+  EXPECT_FALSE(PackedStrings::FromTensors(bytes, Tensor(DT_INT64,
+                                                        TensorShape({0})),
+                                          &packed)
+                   .ok());
+  EXPECT_FALSE(PackedStrings::FromTensors(
+                   bytes, test::AsTensor<int64>({1, 3}), &packed)
+                   .ok());
+  EXPECT_FALSE(PackedStrings::FromTensors(
+                   bytes, test::AsTensor<int64>({0, 2}), &packed)
+                   .ok());
+  EXPECT_FALSE(PackedStrings::FromTensors(
+                   bytes, test::AsTensor<int64>({0, 2, 1, 3}), &packed)
+                   .ok());
+  TF_EXPECT_OK(PackedStrings::FromTensors(
+      bytes, test::AsTensor<int64>({0, 1, 3}), &packed));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,204 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/sampling_tracer.h"
+
+#include <algorithm>
+#include <string.h>
+
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Maximum number of characters kept of each name of a record.
+constexpr int kMaxDeviceLength = 47;
+constexpr int kMaxNodeLength = 63;
+constexpr int kMaxStageLength = 31;
+
+// Number of records a thread can hold between flushes.
+constexpr uint64 kBufferCapacity = 2048;
+
+constexpr int64 kFlushIntervalMicros = 1000000;
+
+// Copies up to max_length characters of 'name' to 'dst', returning the
+// number of characters copied.
+uint8 CopyName(StringPiece name, int max_length, char* dst) {
+  const size_t length = std::min<size_t>(name.size(), max_length);
+  memcpy(dst, name.data(), length);
+  return length;
+}
+
+// Node the calling thread is running for a sampled step, if any.
+struct CurrentNode {
+  const string* device = nullptr;
+  const string* node = nullptr;
+};
+thread_local CurrentNode current_node;
+
+}  // namespace
+
+// A ring of records, written by one thread and read by the flushes.
+struct SamplingTracer::Buffer {
+  struct Entry {
+    char device[kMaxDeviceLength];
+    char node[kMaxNodeLength];
+    char stage[kMaxStageLength];
+    uint8 device_length;
+    uint8 node_length;
+    uint8 stage_length;
+    int64 micros;
+  };
+
+  // Index of the next entry to write, advanced by the owning thread once the
+  // entry is complete, and of the next one to read, advanced by Flush().
+  std::atomic<uint64> head{0};
+  std::atomic<uint64> tail{0};
+  Entry entries[kBufferCapacity];
+};
+
+const char SamplingTracer::kOpStage[] = "op";
+
+SamplingTracer* SamplingTracer::Global() {
+  static SamplingTracer* tracer = new SamplingTracer();
+  return tracer;
+}
+
+SamplingTracer::SamplingTracer()
+    : node_micros_(monitoring::Sampler<3>::New(
+          {"/tensorflow/core/sampled_node_micros",
+           "Compute time of the nodes, and of stages inside them, in steps "
+           "sampled by the sampling tracer.",
+           "Device", "Node", "Stage"})),
+      dropped_records_(monitoring::Counter<0>::New(
+          {"/tensorflow/core/sampled_node_records_dropped",
+           "Number of node timings the sampling tracer dropped because the "
+           "buffer of their thread was full."})) {
+  flush_thread_.reset(Env::Default()->StartThread(
+      ThreadOptions(), "sampling_tracer_flush", [this]() {
+        for (;;) {
+          Env::Default()->SleepForMicroseconds(kFlushIntervalMicros);
+          Flush();
+        }
+      }));
+}
+
+SamplingTracer::Buffer* SamplingTracer::ThreadBuffer() {
+  static thread_local Buffer* buffer = nullptr;
+  if (buffer == nullptr) {
+    buffer = new Buffer;
+    mutex_lock l(mu_);
+    buffers_.push_back(buffer);
+  }
+  return buffer;
+}
+
+void SamplingTracer::Record(StringPiece device, StringPiece node,
+                            StringPiece stage, int64 micros) {
+  Buffer* buffer = ThreadBuffer();
+  const uint64 head = buffer->head.load(std::memory_order_relaxed);
+  if (head - buffer->tail.load(std::memory_order_acquire) >=
+      kBufferCapacity) {
+    dropped_records_->GetCell()->IncrementBy(1);
+    return;
+  }
+  Buffer::Entry* entry = &buffer->entries[head % kBufferCapacity];
+  entry->device_length = CopyName(device, kMaxDeviceLength, entry->device);
+  entry->node_length = CopyName(node, kMaxNodeLength, entry->node);
+  entry->stage_length = CopyName(stage, kMaxStageLength, entry->stage);
+  entry->micros = micros;
+  buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void SamplingTracer::RecordStage(StringPiece stage, int64 micros) {
+  if (current_node.node == nullptr) return;
+  Global()->Record(*current_node.device, *current_node.node, stage, micros);
+}
+
+SamplingTracer::ScopedNode::ScopedNode(const string& device,
+                                       const string& node) {
+  current_node.device = &device;
+  current_node.node = &node;
+}
+
+SamplingTracer::ScopedNode::~ScopedNode() {
+  current_node.device = nullptr;
+  current_node.node = nullptr;
+}
+
+void SamplingTracer::Flush() {
+  std::vector<Buffer*> buffers;
+  {
+    mutex_lock l(mu_);
+    buffers = buffers_;
+  }
+  mutex_lock l(flush_mu_);
+  std::array<string, 3> labels;
+  for (Buffer* buffer : buffers) {
+    const uint64 head = buffer->head.load(std::memory_order_acquire);
+    uint64 tail = buffer->tail.load(std::memory_order_relaxed);
+    for (; tail != head; ++tail) {
+      const Buffer::Entry& entry = buffer->entries[tail % kBufferCapacity];
+      labels[0].assign(entry.device, entry.device_length);
+      labels[1].assign(entry.node, entry.node_length);
+      labels[2].assign(entry.stage, entry.stage_length);
+      monitoring::SamplerCell*& cell = cells_[labels];
+      if (cell == nullptr) {
+        cell = node_micros_->GetCell(labels[0], labels[1], labels[2]);
+      }
+      cell->Add(entry.micros);
+    }
+    buffer->tail.store(head, std::memory_order_release);
+  }
+}
+
+monitoring::SamplerCell* SamplingTracer::GetCell(const string& device,
+                                                 const string& node,
+                                                 const string& stage) {
+  return node_micros_->GetCell(device, node, stage);
+}
+
+string SamplingTracer::Summary(int max_rows) {
+  Flush();
+  struct Row {
+    const std::array<string, 3>* labels;
+    double p50;
+    double p99;
+  };
+  std::vector<Row> rows;
+  {
+    mutex_lock l(flush_mu_);
+    for (const auto& it : cells_) {
+      rows.push_back(
+          {&it.first, it.second->Percentile(50), it.second->Percentile(99)});
+    }
+  }
+  std::sort(rows.begin(), rows.end(),
+            [](const Row& a, const Row& b) { return a.p99 > b.p99; });
+  if (rows.size() > static_cast<size_t>(max_rows)) rows.resize(max_rows);
+
+  string summary = "p50 us\tp99 us\tdevice\tnode\tstage\n";
+  for (const Row& row : rows) {
+    strings::StrAppend(&summary,
+                       strings::Printf("%.1f\t%.1f\t", row.p50, row.p99),
+                       (*row.labels)[0], "\t", (*row.labels)[1], "\t",
+                       (*row.labels)[2], "\n");
+  }
+  return summary;
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,129 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Always-on, low-overhead tracing of the node timings of a sample of steps.
+//
+// Tracing a step with RunOptions::FULL_TRACE collects allocation, tensor and
+// timeline details into a StepStats proto under a lock, which is too slow to
+// enable under production traffic. Sessions configured with
+// GraphOptions.trace_sampling_interval instead trace one in that many steps
+// with a StepStatsCollector that only measures the compute time of each node
+// and records it here, in a lock-free buffer of the calling thread. Kernels
+// can also record the time of stages inside them for sampled steps. A
+// thread of the tracer periodically moves the records into a distribution
+// per device, node and stage, exported through lib/monitoring, so that the
+// ops that drive tail latency can be told from the percentiles.
+
+#ifndef TENSORFLOW_UTIL_SAMPLING_TRACER_H_
+#define TENSORFLOW_UTIL_SAMPLING_TRACER_H_
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/monitoring/counter.h"
+#include "tensorflow/core/lib/monitoring/sampler.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+class SamplingTracer {
+ public:
+  // Stage name of the compute time of a whole node.
+  static const char kOpStage[];
+
+  // Returns the tracer of this process.
+  static SamplingTracer* Global();
+
+  // Returns true if the step with the given id is one of the 1 in 'interval'
+  // steps to trace, which is none if 'interval' is not positive.
+  static bool ShouldSample(int64 step_id, int64 interval) {
+    return interval > 0 && step_id % interval == 0;
+  }
+
+  // Records that 'stage' of the node 'node' on 'device' took 'micros'. Does
+  // not block: the record is dropped if the buffer of the calling thread is
+  // full, and the names are truncated to a few dozen characters.
+  void Record(StringPiece device, StringPiece node, StringPiece stage,
+              int64 micros);
+
+  // Records that 'stage' of the node the calling thread is running took
+  // 'micros', if the node belongs to a sampled step, and does nothing
+  // otherwise. For instrumentation inside kernels.
+  static void RecordStage(StringPiece stage, int64 micros);
+
+  // Marks the calling thread as running the node 'node' of a sampled step on
+  // 'device' for the lifetime of the object. The strings must outlive it.
+  class ScopedNode {
+   public:
+    ScopedNode(const string& device, const string& node);
+    ~ScopedNode();
+
+   private:
+    TF_DISALLOW_COPY_AND_ASSIGN(ScopedNode);
+  };
+
+  // Moves the records of all threads into the exported distributions.
+  void Flush() LOCKS_EXCLUDED(flush_mu_);
+
+  // Returns the distribution of the times recorded for a stage, in
+  // microseconds, as of the last Flush().
+  monitoring::SamplerCell* GetCell(const string& device, const string& node,
+                                   const string& stage);
+
+  // Flushes the records and returns a table of the median and 99th
+  // percentile times of the 'max_rows' stages with the highest 99th
+  // percentile.
+  string Summary(int max_rows) LOCKS_EXCLUDED(flush_mu_);
+
+ private:
+  struct Buffer;
+
+  SamplingTracer();
+
+  // Returns the buffer of the calling thread, registering it on first use.
+  Buffer* ThreadBuffer() LOCKS_EXCLUDED(mu_);
+
+  // Exported metrics.
+  std::unique_ptr<monitoring::Sampler<3>> node_micros_;
+  std::unique_ptr<monitoring::Counter<0>> dropped_records_;
+
+  // Buffers of all threads that recorded something. A buffer is never freed,
+  // since records may still be in it when its thread exits.
+  mutex mu_;
+  std::vector<Buffer*> buffers_ GUARDED_BY(mu_);
+
+  // Serializes the readers of the buffers, and holds the labels of the cells
+  // filled so far.
+  mutex flush_mu_;
+  std::map<std::array<string, 3>, monitoring::SamplerCell*> cells_
+      GUARDED_BY(flush_mu_);
+
+  std::unique_ptr<Thread> flush_thread_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(SamplingTracer);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_UTIL_SAMPLING_TRACER_H_
@@ -0,0 +1,94 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/sampling_tracer.h"
+
+#include "tensorflow/core/framework/summary.pb.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+const char kDevice[] = "/job:localhost/replica:0/task:0/cpu:0";
+
+int64 NumSamples(const string& node, const string& stage) {
+  HistogramProto proto;
+  SamplingTracer::Global()->GetCell(kDevice, node, stage)->EncodeToProto(
+      &proto);
+  return proto.num();
+}
+
+TEST(SamplingTracerTest, ShouldSample) {
+  EXPECT_FALSE(SamplingTracer::ShouldSample(10, 0));
+  EXPECT_TRUE(SamplingTracer::ShouldSample(10, 1));
+  EXPECT_TRUE(SamplingTracer::ShouldSample(10, 5));
+  EXPECT_FALSE(SamplingTracer::ShouldSample(11, 5));
+}
+
+TEST(SamplingTracerTest, RecordsFromManyThreads) {
+  SamplingTracer* tracer = SamplingTracer::Global();
+  {
+    thread::ThreadPool pool(Env::Default(), "test", 4);
+    for (int i = 0; i < 100; ++i) {
+      pool.Schedule([tracer, i]() {
+        tracer->Record(kDevice, "many_threads", SamplingTracer::kOpStage, i);
+      });
+    }
+  }
+  tracer->Flush();
+  EXPECT_EQ(100, NumSamples("many_threads", SamplingTracer::kOpStage));
+  EXPECT_LE(90, tracer->GetCell(kDevice, "many_threads",
+                                SamplingTracer::kOpStage)->Percentile(99));
+}
+
+TEST(SamplingTracerTest, RecordsStagesOfSampledNodesOnly) {
+  const string device = kDevice;
+  const string node = "stages";
+  SamplingTracer::RecordStage("read", 5);
+  {
+    SamplingTracer::ScopedNode scoped_node(device, node);
+    SamplingTracer::RecordStage("read", 7);
+    SamplingTracer::RecordStage("parse", 3);
+  }
+  SamplingTracer::RecordStage("parse", 5);
+  SamplingTracer::Global()->Flush();
+  EXPECT_EQ(1, NumSamples("stages", "read"));
+  EXPECT_EQ(1, NumSamples("stages", "parse"));
+}
+
+TEST(SamplingTracerTest, TruncatesNames) {
+  const string node(200, 'n');
+  SamplingTracer* tracer = SamplingTracer::Global();
+  tracer->Record(kDevice, node, SamplingTracer::kOpStage, 1);
+  tracer->Flush();
+  EXPECT_EQ(0, NumSamples(node, SamplingTracer::kOpStage));
+  EXPECT_EQ(1, NumSamples(node.substr(0, 63), SamplingTracer::kOpStage));
+}
+
+TEST(SamplingTracerTest, SummarySortsByTailLatency) {
+  SamplingTracer* tracer = SamplingTracer::Global();
+  tracer->Record(kDevice, "summary_fast", SamplingTracer::kOpStage, 10);
+  tracer->Record(kDevice, "summary_slow", SamplingTracer::kOpStage, 100000);
+  const string summary = tracer->Summary(1000);
+  const size_t slow = summary.find("summary_slow");
+  const size_t fast = summary.find("summary_fast");
+  ASSERT_NE(string::npos, slow);
+  ASSERT_NE(string::npos, fast);
+  EXPECT_LT(slow, fast);
+}
+
+}  // namespace
+}  // namespace tensorflow
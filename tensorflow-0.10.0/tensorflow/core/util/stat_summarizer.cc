@@ -40,6 +40,7 @@ StatSummarizer::StatSummarizer(const tensorflow::GraphDef& tensorflow_graph) {
 
 void StatSummarizer::ProcessStepStats(const StepStats& step_stats) {
   int64 curr_total = 0;
+  int64 curr_live_bytes = 0;
   if (timing_details_.empty() && !step_stats.dev_stats().empty() &&
       !step_stats.dev_stats(0).node_stats().empty()) {
     first_node_start_micros_ =
@@ -50,18 +51,32 @@ void StatSummarizer::ProcessStepStats(const StepStats& step_stats) {
     for (const auto& ns : ds.node_stats()) {
       const int64 curr_time = ns.all_end_rel_micros();
       curr_total += curr_time;
+      int64 peak_bytes = 0;
+      int64 live_bytes = 0;
+      for (const auto& memory : ns.memory()) {
+        peak_bytes += memory.peak_bytes();
+        live_bytes += memory.live_bytes();
+      }
+      if (ns.memory_size() > 0) memory_recorded_ = true;
+      curr_live_bytes += live_bytes;
       auto result = timing_details_.emplace(ns.node_name(), Detail());
+      Detail& detail = result.first->second;
       if (result.second) {
-        result.first->second.first_rel_end_micros = curr_time;
-        result.first->second.first_start_micros =
+        detail.first_rel_end_micros = curr_time;
+        detail.first_start_micros =
             ns.all_start_micros() - first_node_start_micros_;
-        result.first->second.total_micros = curr_time;
+        detail.total_micros = curr_time;
+        detail.max_peak_bytes = peak_bytes;
+        detail.total_live_bytes = live_bytes;
       } else {
-        result.first->second.total_micros += curr_time;
+        detail.total_micros += curr_time;
+        detail.max_peak_bytes = std::max(detail.max_peak_bytes, peak_bytes);
+        detail.total_live_bytes += live_bytes;
       }
     }
   }
   run_total_micros_.UpdateStat(curr_total);
+  run_live_bytes_.UpdateStat(curr_live_bytes);
 }
 
 std::string StatSummarizer::ShortSummary() const {
@@ -69,6 +84,10 @@ std::string StatSummarizer::ShortSummary() const {
   stream << run_total_micros_.count() << " runs, avg " << std::setprecision(4)
          << run_total_micros_.avg() / 1000.0 << " ms, " << node_types_.size()
          << " nodes defined " << timing_details_.size() << " nodes observed";
+  if (memory_recorded_) {
+    stream << ", avg " << std::setprecision(4)
+           << run_live_bytes_.avg() / 1024.0 << " KB live at the end";
+  }
   return stream.str();
 }
 
@@ -76,6 +95,9 @@ std::string StatSummarizer::HeaderString() const {
   std::stringstream stream;
   stream << std::setw(9) << "[start]" << std::setw(9) << "[first]"
          << std::setw(9) << "[avg]";
+  if (memory_recorded_) {
+    stream << std::setw(12) << "[peak KB]" << std::setw(12) << "[live KB]";
+  }
   stream << "\t" << std::setw(8) << "[%]"
          << " ";
   stream << "\t" << std::setw(8) << "[cdf%]"
@@ -98,6 +120,13 @@ std::string StatSummarizer::ColumnString(
   double avg_time_ms = detail.total_micros / 1000.0 / num_runs();
   stream << std::fixed << std::setprecision(3) << std::setw(9) << avg_time_ms;
 
+  if (memory_recorded_) {
+    stream << std::fixed << std::setprecision(1) << std::setw(12)
+           << detail.max_peak_bytes / 1024.0;
+    stream << std::fixed << std::setprecision(1) << std::setw(12)
+           << detail.total_live_bytes / 1024.0 / num_runs();
+  }
+
   double percentage = detail.total_micros * 100.0 / run_total_micros_.sum();
   stream << "\t" << std::fixed << std::setprecision(3) << std::setw(7)
          << percentage << "%";
@@ -130,6 +159,8 @@ std::string StatSummarizer::GetStatsBySorting(
   stream << ShortSummary() << std::endl;
   if (sorting_metric == SortingMetric::BY_TOTAL_DURATION) {
     stream << "============ Top by duration =================" << std::endl;
+  } else if (sorting_metric == SortingMetric::BY_LIVE_MEMORY) {
+    stream << "============ Top by live memory =================" << std::endl;
   } else {
     CHECK(sorting_metric == SortingMetric::BY_RUN_ORDER);
     stream << "============ By run order =================" << std::endl;
@@ -140,10 +171,13 @@ std::string StatSummarizer::GetStatsBySorting(
       std::pair<int64, const std::pair<const std::string, Detail>*> >
       timings;
   for (const auto& entry : timing_details_) {
-    timings.emplace(sorting_metric == SortingMetric::BY_TOTAL_DURATION
-                        ? entry.second.total_micros
-                        : -entry.second.first_start_micros,
-                    &entry);
+    int64 priority = -entry.second.first_start_micros;
+    if (sorting_metric == SortingMetric::BY_TOTAL_DURATION) {
+      priority = entry.second.total_micros;
+    } else if (sorting_metric == SortingMetric::BY_LIVE_MEMORY) {
+      priority = entry.second.total_live_bytes;
+    }
+    timings.emplace(priority, &entry);
   }
 
   const int64 cutoff_point = run_total_micros_.sum() * cdf_cutoff_ratio;
@@ -168,6 +202,12 @@ std::string StatSummarizer::GetStatsByTopDurations(
                            num_max_nodes_to_print);
 }
 
+std::string StatSummarizer::GetStatsByTopLiveMemory(
+    int num_max_nodes_to_print) const {
+  return GetStatsBySorting(SortingMetric::BY_LIVE_MEMORY, 1.0,
+                           num_max_nodes_to_print);
+}
+
 std::string StatSummarizer::GetStatsByRunOrder() const {
   return GetStatsBySorting(SortingMetric::BY_RUN_ORDER,
                            std::numeric_limits<int>::max(),
@@ -217,6 +257,10 @@ void StatSummarizer::PrintStepStats() const {
   LOG(INFO) << "Total time (us): " << run_total_micros_;
   LOG(INFO) << GetStatsByRunOrder();
   LOG(INFO) << GetStatsByTopDurations();
+  if (memory_recorded_) {
+    LOG(INFO) << "Live bytes at the end of the run: " << run_live_bytes_;
+    LOG(INFO) << GetStatsByTopLiveMemory();
+  }
   LOG(INFO);
 }
 
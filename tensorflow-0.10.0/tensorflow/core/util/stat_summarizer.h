@@ -104,6 +104,10 @@ class Stat {
 // A class intended to make performance analysis easier by collecting StepStats
 // and showing in an easily understandable format where CPU time is being spent.
 // See tensorflow/examples/android/jni/tensorflow_jni.cc for an example usage.
+//
+// When the StepStats record memory, as those of traced steps do, the peak
+// bytes each node allocated and the bytes still live at the end of the step
+// are shown as well, so that nodes which hold on to memory can be found.
 class StatSummarizer {
  public:
   explicit StatSummarizer(const tensorflow::GraphDef& tensorflow_graph);
@@ -128,9 +132,16 @@ class StatSummarizer {
       double cdf_cutoff_ratio = 1.0,
       int num_max_nodes_to_print = std::numeric_limits<int>::max()) const;
 
+  // Summarizes all nodes' stat in the order of the most bytes live at the end
+  // of a run, on average. Will stop printing if num_max_nodes_to_print is hit.
+  std::string GetStatsByTopLiveMemory(
+      int num_max_nodes_to_print = std::numeric_limits<int>::max()) const;
+
   void Reset() {
     run_total_micros_.Reset();
+    run_live_bytes_.Reset();
     timing_details_.clear();
+    memory_recorded_ = false;
   }
 
   // Returns number of runs.
@@ -139,16 +150,24 @@ class StatSummarizer {
   // Returns stats of total microseconds spent by all nodes in each run.
   const Stat<int64>& run_total_us() const { return run_total_micros_; }
 
+  // Returns stats of the bytes live at the end of each run.
+  const Stat<int64>& run_live_bytes() const { return run_live_bytes_; }
+
  private:
   struct Detail {
     int64 first_start_micros;
     int64 first_rel_end_micros;
     int64 total_micros;
+    // The most bytes a single execution of the node had allocated at once.
+    int64 max_peak_bytes;
+    // The bytes of all executions of the node live at the end of the runs.
+    int64 total_live_bytes;
   };
 
   enum struct SortingMetric {
     BY_TOTAL_DURATION,
     BY_RUN_ORDER,
+    BY_LIVE_MEMORY,
   };
 
   std::string GetStatsBySorting(SortingMetric sorting_metric,
@@ -162,6 +181,9 @@ class StatSummarizer {
 
   int64 first_node_start_micros_;
   Stat<int64> run_total_micros_;
+  Stat<int64> run_live_bytes_;
+  // True if any of the StepStats recorded memory.
+  bool memory_recorded_ = false;
   std::vector<string> nodes_in_def_order_;
   std::map<std::string, Detail> timing_details_;
   std::map<string, string> node_types_;
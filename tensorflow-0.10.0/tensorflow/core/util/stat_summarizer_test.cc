@@ -0,0 +1,94 @@
+/* Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/util/stat_summarizer.h"
+
+#include "tensorflow/core/framework/graph.pb.h"
+#include "tensorflow/core/framework/step_stats.pb.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Adds the stats of one execution of a node to 'device_stats'.
+void AddNodeStats(const string& name, int64 start_micros, int64 micros,
+                  int64 peak_bytes, int64 live_bytes,
+                  DeviceStepStats* device_stats) {
+  NodeExecStats* node_stats = device_stats->add_node_stats();
+  node_stats->set_node_name(name);
+  node_stats->set_all_start_micros(start_micros);
+  node_stats->set_all_end_rel_micros(micros);
+  AllocatorMemoryUsed* memory = node_stats->add_memory();
+  memory->set_allocator_name("cpu");
+  memory->set_peak_bytes(peak_bytes);
+  memory->set_live_bytes(live_bytes);
+}
+
+// Returns the lines of 'text' that end with a node name of the test graph.
+std::vector<string> NodeLines(const string& text) {
+  std::vector<string> lines;
+  for (const string& line : str_util::Split(text, '\n')) {
+    if (StringPiece(line).ends_with("\tslow") ||
+        StringPiece(line).ends_with("\tbeam")) {
+      lines.push_back(line);
+    }
+  }
+  return lines;
+}
+
+TEST(StatSummarizerTest, SummarizesLiveMemory) {
+  GraphDef graph;
+  NodeDef* slow = graph.add_node();
+  slow->set_name("slow");
+  slow->set_op("MatMul");
+  NodeDef* beam = graph.add_node();
+  beam->set_name("beam");
+  beam->set_op("BeamParseReader");
+  StatSummarizer summarizer(graph);
+
+  for (int run = 0; run < 2; ++run) {
+    StepStats step_stats;
+    DeviceStepStats* device_stats = step_stats.add_dev_stats();
+    AddNodeStats("slow", 100, 50, 4096, 0, device_stats);
+    // The beam node runs twice per step, e.g. in a loop, and keeps 2 KB
+    // alive each time.
+    AddNodeStats("beam", 110, 5, 1024, 2048, device_stats);
+    AddNodeStats("beam", 120, 5, 3072, 2048, device_stats);
+    summarizer.ProcessStepStats(step_stats);
+  }
+
+  EXPECT_EQ(2, summarizer.num_runs());
+  EXPECT_EQ(4096, summarizer.run_live_bytes().avg());
+
+  const std::vector<string> by_memory =
+      NodeLines(summarizer.GetStatsByTopLiveMemory());
+  ASSERT_EQ(2, by_memory.size());
+  // The most peak bytes of one execution, and the live bytes per run.
+  EXPECT_TRUE(StringPiece(by_memory[0]).contains("3.0         4.0"))
+      << by_memory[0];
+  EXPECT_TRUE(StringPiece(by_memory[0]).ends_with("\tbeam"));
+  EXPECT_TRUE(StringPiece(by_memory[1]).contains("4.0         0.0"))
+      << by_memory[1];
+
+  const std::vector<string> by_duration =
+      NodeLines(summarizer.GetStatsByTopDurations());
+  ASSERT_EQ(2, by_duration.size());
+  EXPECT_TRUE(StringPiece(by_duration[0]).ends_with("\tslow"));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,10 +15,14 @@ limitations under the License.
 
 #include "tensorflow/core/util/tensor_slice_reader.h"
 
+#include <algorithm>
+#include <memory>
+#include <utility>
 #include <vector>
 #include "tensorflow/core/framework/types.pb_text.h"
 #include "tensorflow/core/framework/versions.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/stl_util.h"
 #include "tensorflow/core/lib/io/iterator.h"
 #include "tensorflow/core/lib/io/match.h"
@@ -38,6 +42,38 @@ namespace checkpoint {
 TensorSliceReader::Table::~Table() {}
 
 namespace {
+
+// Opening a shard mostly waits for the file system, so more threads than
+// cores help on remote or cold storage.
+const int kMaxLoadShardThreads = 16;
+
+// Reads a checkpoint file in place from a read-only memory mapping. The table
+// then uses the blocks of the mapping directly instead of reading copies, and
+// processes restoring the same checkpoint share its pages in the page cache.
+class MappedRandomAccessFile : public RandomAccessFile {
+ public:
+  explicit MappedRandomAccessFile(std::unique_ptr<ReadOnlyMemoryRegion> region)
+      : region_(std::move(region)) {}
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override {
+    const uint64 length = region_->length();
+    if (offset >= length) {
+      *result = StringPiece();
+      return errors::OutOfRange("Read after file end");
+    }
+    const uint64 available = std::min(length - offset, static_cast<uint64>(n));
+    result->set(static_cast<const char*>(region_->data()) + offset, available);
+    if (available < n) {
+      return errors::OutOfRange("Read less bytes than requested");
+    }
+    return Status::OK();
+  }
+
+ private:
+  std::unique_ptr<ReadOnlyMemoryRegion> region_;
+};
+
 class TensorSliceReaderTable : public TensorSliceReader::Table {
  public:
   // Takes ownership of 'f'.
@@ -72,7 +108,13 @@ Status OpenTableTensorSliceReader(const string& fname,
   *result = nullptr;
   Env* env = Env::Default();
   std::unique_ptr<RandomAccessFile> f;
-  Status s = env->NewRandomAccessFile(fname, &f);
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  Status s;
+  if (env->NewReadOnlyMemoryRegionFromFile(fname, &region).ok()) {
+    f.reset(new MappedRandomAccessFile(std::move(region)));
+  } else {
+    s = env->NewRandomAccessFile(fname, &f);
+  }
   if (s.ok()) {
     uint64 file_size;
     s = env->GetFileSize(fname, &file_size);
@@ -137,48 +179,86 @@ TensorSliceReader::TensorSliceReader(const string& filepattern,
   }
 }
 
-void TensorSliceReader::LoadShard(int shard) const {
-  CHECK_LT(shard, sss_.size());
-  if (sss_[shard] || !status_.ok()) {
-    return;  // Already loaded, or invalid.
-  }
+Status TensorSliceReader::OpenShard(int shard, std::unique_ptr<Table>* table,
+                                    SavedTensorSlices* sts) const {
   string value;
-  SavedTensorSlices sts;
-  const string fname = fnames_[shard];
+  const string& fname = fnames_[shard];
   VLOG(1) << "Reading meta data from file " << fname << "...";
-  Table* table;
-  Status s = open_function_(fname, &table);
+  Table* t;
+  Status s = open_function_(fname, &t);
   if (!s.ok()) {
-    status_ = errors::DataLoss("Unable to open table file ", fname, ": ",
-                               s.ToString());
-    return;
+    return errors::DataLoss("Unable to open table file ", fname, ": ",
+                            s.ToString());
   }
-  sss_[shard].reset(table);
-  if (!(table->Get(kSavedTensorSlicesKey, &value) &&
-        ParseProtoUnlimited(&sts, value))) {
-    status_ = errors::Internal(
+  table->reset(t);
+  if (!(t->Get(kSavedTensorSlicesKey, &value) &&
+        ParseProtoUnlimited(sts, value))) {
+    return errors::Internal(
         "Failed to find the saved tensor slices at the beginning of the "
         "checkpoint file: ",
         fname);
-    return;
   }
-  status_ = CheckVersions(sts.meta().versions(), TF_CHECKPOINT_VERSION,
-                          TF_CHECKPOINT_VERSION_MIN_PRODUCER, "Checkpoint",
-                          "checkpoint");
-  if (!status_.ok()) return;
+  return CheckVersions(sts->meta().versions(), TF_CHECKPOINT_VERSION,
+                       TF_CHECKPOINT_VERSION_MIN_PRODUCER, "Checkpoint",
+                       "checkpoint");
+}
+
+void TensorSliceReader::RegisterShard(int shard,
+                                      const SavedTensorSlices& sts) const {
   for (const SavedSliceMeta& ssm : sts.meta().tensor()) {
     TensorShape ssm_shape(ssm.shape());
     for (const TensorSliceProto& tsp : ssm.slice()) {
       TensorSlice ss_slice(tsp);
-      RegisterTensorSlice(ssm.name(), ssm_shape, ssm.type(), fname, ss_slice);
+      RegisterTensorSlice(ssm.name(), ssm_shape, ssm.type(), fnames_[shard],
+                          ss_slice);
     }
   }
 }
 
+void TensorSliceReader::LoadShard(int shard) const {
+  CHECK_LT(shard, sss_.size());
+  if (sss_[shard] || !status_.ok()) {
+    return;  // Already loaded, or invalid.
+  }
+  SavedTensorSlices sts;
+  status_ = OpenShard(shard, &sss_[shard], &sts);
+  if (!status_.ok()) return;
+  RegisterShard(shard, sts);
+}
+
 void TensorSliceReader::LoadAllShards() const {
   VLOG(1) << "Loading all shards for " << filepattern_;
-  for (size_t i = 0; i < fnames_.size() && status_.ok(); ++i) {
-    LoadShard(i);
+  std::vector<int> to_load;
+  for (size_t i = 0; i < fnames_.size(); ++i) {
+    if (!sss_[i]) to_load.push_back(i);
+  }
+  if (to_load.size() <= 1 || !status_.ok()) {
+    for (int shard : to_load) LoadShard(shard);
+    all_shards_loaded_ = true;
+    return;
+  }
+
+  std::vector<std::unique_ptr<Table>> tables(fnames_.size());
+  std::vector<SavedTensorSlices> metas(fnames_.size());
+  std::vector<Status> statuses(fnames_.size());
+  {
+    thread::ThreadPool pool(
+        Env::Default(), "load_shards",
+        std::min<int>(kMaxLoadShardThreads, to_load.size()));
+    for (int shard : to_load) {
+      pool.Schedule([this, shard, &tables, &metas, &statuses]() {
+        statuses[shard] = OpenShard(shard, &tables[shard], &metas[shard]);
+      });
+    }
+    // The destructor waits for the shards to be opened.
+  }
+  // Registers the shards in order, stopping at the first error as loading
+  // them one by one would.
+  for (int shard : to_load) {
+    if (!status_.ok()) break;
+    sss_[shard] = std::move(tables[shard]);
+    status_ = statuses[shard];
+    if (status_.ok()) RegisterShard(shard, metas[shard]);
   }
   all_shards_loaded_ = true;
 }
@@ -252,6 +332,19 @@ bool TensorSliceReader::HasTensor(const string& name, TensorShape* shape,
   }
 }
 
+std::vector<TensorSlice> TensorSliceReader::LoadedSlices(
+    const string& name) const {
+  std::vector<TensorSlice> slices;
+  mutex_lock l(mu_);
+  const TensorSliceSet* tss = gtl::FindPtrOrNull(tensors_, name);
+  if (tss) {
+    for (const auto& x : tss->Slices()) {
+      slices.push_back(x.second.slice);
+    }
+  }
+  return slices;
+}
+
 Status TensorSliceReader::GetTensor(
     const string& name, std::unique_ptr<tensorflow::Tensor>* out_tensor) const {
   DataType type;
@@ -60,6 +60,7 @@ class TensorSliceReader {
     virtual ~Table();
     virtual bool Get(const string& key, string* value) = 0;
   };
+  // Called from several threads at once when the reader loads all shards.
   typedef std::function<Status(const string&, Table**)> OpenTableFunction;
 
   static const int kLoadAllShards = -1;
@@ -92,6 +93,10 @@ class TensorSliceReader {
   bool CopySliceData(const string& name, const TensorSlice& slice,
                      T* data) const;
 
+  // Returns the slices of tensor "name" saved in the shards loaded so far.
+  // Unlike HasTensor(), does not load the other shards.
+  std::vector<TensorSlice> LoadedSlices(const string& name) const;
+
   // Get the tensors.
   const std::unordered_map<string, TensorSliceSet*>& Tensors() const {
     return tensors_;
@@ -113,7 +118,14 @@ class TensorSliceReader {
   friend class TensorSliceWriteTestHelper;
 
   void LoadShard(int shard) const;
+  // Opens the shards not loaded yet in parallel.
   void LoadAllShards() const;
+  // Opens "shard" and reads its metadata.  Does not touch the attributes
+  // guarded by mu_, so that shards can be opened in parallel.
+  Status OpenShard(int shard, std::unique_ptr<Table>* table,
+                   SavedTensorSlices* sts) const;
+  // Registers the slices listed in the metadata of "shard".
+  void RegisterShard(int shard, const SavedTensorSlices& sts) const;
   void RegisterTensorSlice(const string& name, const TensorShape& shape,
                            DataType type, const string& tag,
                            const TensorSlice& slice) const;
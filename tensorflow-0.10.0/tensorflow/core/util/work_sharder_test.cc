@@ -62,6 +62,18 @@ TEST(Shard, Basic) {
   }
 }
 
+TEST(Shard, WorkStealing) {
+  thread::ThreadPool threads(Env::Default(), ThreadOptions(), "test", 16,
+                             true /* work_stealing */);
+  for (auto workers : {0, 1, 2, 15, 16, 100}) {
+    for (auto total : {0, 1, 7, 64, 1000, 9999}) {
+      for (auto cost_per_unit : {0, 1, 102, 10005, 1000007}) {
+        RunSharding(workers, total, cost_per_unit, &threads);
+      }
+    }
+  }
+}
+
 TEST(Shard, OverflowTest) {
   thread::ThreadPool threads(Env::Default(), "test", 3);
   for (auto workers : {1, 2, 3}) {
@@ -22,6 +22,11 @@ limitations under the License.
 %}
 
 %nodefaultctor EventsWriter;
+%nodefaultctor AsyncEventsWriter;
+
+// The thread-safety annotations in events_writer.h are C++ only.
+#define GUARDED_BY(x)
+#define EXCLUSIVE_LOCKS_REQUIRED(...)
 
 %ignoreall
 %unignore tensorflow;
@@ -32,10 +37,19 @@ limitations under the License.
 %rename("_WriteSerializedEvent") tensorflow::EventsWriter::WriteSerializedEvent;
 %unignore tensorflow::EventsWriter::Flush;
 %unignore tensorflow::EventsWriter::Close;
+%unignore tensorflow::AsyncEventsWriter;
+%unignore tensorflow::AsyncEventsWriter::AsyncEventsWriter;
+%unignore tensorflow::AsyncEventsWriter::~AsyncEventsWriter;
+%unignore tensorflow::AsyncEventsWriter::FileName;
+%rename("_WriteSerializedEvent") tensorflow::AsyncEventsWriter::WriteSerializedEvent;
+%unignore tensorflow::AsyncEventsWriter::Flush;
+%unignore tensorflow::AsyncEventsWriter::Close;
+%unignore tensorflow::AsyncEventsWriter::num_dropped_events;
 %include "tensorflow/core/util/events_writer.h"
 %unignoreall
 
 %newobject tensorflow::EventsWriter::EventsWriter;
+%newobject tensorflow::AsyncEventsWriter::AsyncEventsWriter;
 
 
 %extend tensorflow::EventsWriter {
@@ -48,3 +62,14 @@ limitations under the License.
     return self._WriteSerializedEvent(event.SerializeToString())
 %}
 }
+
+%extend tensorflow::AsyncEventsWriter {
+%insert("python") %{
+  def WriteEvent(self, event):
+    from tensorflow.core.util.event_pb2 import Event
+    if not isinstance(event, Event):
+      raise TypeError("Expected an event_pb2.Event proto, "
+                      " but got %s" % type(event))
+    return self._WriteSerializedEvent(event.SerializeToString())
+%}
+}
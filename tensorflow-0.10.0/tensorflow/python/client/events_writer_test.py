@@ -63,11 +63,32 @@ class PywrapeventsWriterTest(test_util.TensorFlowTestCase):
     with self.assertRaises(StopIteration):
       next(reader)
 
+  def testAsyncWriteEvents(self):
+    file_prefix = os.path.join(self.get_temp_dir(), "async_events")
+    writer = pywrap_tensorflow.AsyncEventsWriter(
+        compat.as_bytes(file_prefix), 10, 1000)
+    filename = compat.as_text(writer.FileName())
+    self.assertTrue(writer.WriteEvent(event_pb2.Event(step=1)))
+    self.assertTrue(writer.WriteEvent(event_pb2.Event(step=2)))
+    self.assertTrue(writer.Close())
+    self.assertEqual(0, writer.num_dropped_events())
+
+    steps = []
+    for r in tf_record.tf_record_iterator(filename):
+      event_read = event_pb2.Event()
+      event_read.ParseFromString(r)
+      steps.append(event_read.step)
+    # The first event holds the file version.
+    self.assertEqual([0, 1, 2], steps)
+
   def testWriteEventInvalidType(self):
     class _Invalid(object):
       def __str__(self): return "Invalid"
     with self.assertRaisesRegexp(TypeError, "Invalid"):
       pywrap_tensorflow.EventsWriter(b"foo").WriteEvent(_Invalid())
+    with self.assertRaisesRegexp(TypeError, "Invalid"):
+      pywrap_tensorflow.AsyncEventsWriter(b"foo", 10, 1000).WriteEvent(
+          _Invalid())
 
 
 if __name__ == "__main__":
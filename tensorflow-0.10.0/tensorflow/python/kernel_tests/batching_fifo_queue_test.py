@@ -0,0 +1,111 @@
+# Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+"""Tests for tensorflow.ops.data_flow_ops.BatchingFIFOQueue."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import time
+import tensorflow as tf
+
+
+class BatchingFIFOQueueTest(tf.test.TestCase):
+
+  def testConstructor(self):
+    with tf.Graph().as_default():
+      q = tf.BatchingFIFOQueue(10, tf.float32, batch_timeout_micros=500,
+                               shapes=((),), shared_name="foo", name="Q")
+    self.assertTrue(isinstance(q.queue_ref, tf.Tensor))
+    self.assertEquals(tf.string_ref, q.queue_ref.dtype)
+    self.assertProtoEquals("""
+      name:'Q' op:'BatchingFIFOQueue'
+      attr { key: 'component_types' value { list { type: DT_FLOAT } } }
+      attr { key: 'shapes' value { list { shape { } } } }
+      attr { key: 'capacity' value { i: 10 } }
+      attr { key: 'batch_timeout_micros' value { i: 500 } }
+      attr { key: 'container' value { s: '' } }
+      attr { key: 'shared_name' value { s: 'foo' } }
+      """, q.queue_ref.op.node_def)
+
+  def testDequeueUpToReturnsFullBatch(self):
+    with self.test_session():
+      q = tf.BatchingFIFOQueue(10, tf.float32, batch_timeout_micros=10000000,
+                               shapes=((),))
+      q.enqueue_many(([1., 2., 3., 4., 5., 6.],)).run()
+      self.assertAllEqual([1., 2., 3., 4.], q.dequeue_up_to(4).eval())
+      self.assertEqual(2, q.size().eval())
+
+  def testDequeueUpToReturnsPartialBatchAfterTimeout(self):
+    with self.test_session():
+      q = tf.BatchingFIFOQueue(10, tf.float32, batch_timeout_micros=1000,
+                               shapes=((),))
+      q.enqueue_many(([1., 2.],)).run()
+      self.assertAllEqual([1., 2.], q.dequeue_up_to(5).eval())
+      self.assertEqual(0, q.size().eval())
+
+  def testTimedOutBatchWaitsForFirstElement(self):
+    with self.test_session() as sess:
+      q = tf.BatchingFIFOQueue(10, tf.float32, batch_timeout_micros=1000,
+                               shapes=((),))
+      enqueue_op = q.enqueue((7.,))
+      dequeued_t = q.dequeue_up_to(5)
+      results = []
+
+      def dequeue():
+        results.append(sess.run(dequeued_t))
+
+      dequeue_thread = self.checkedThread(target=dequeue)
+      dequeue_thread.start()
+      # The timeout passes while the queue is empty.
+      time.sleep(0.1)
+      self.assertEqual([], results)
+      sess.run(enqueue_op)
+      dequeue_thread.join()
+      self.assertAllEqual([7.], results[0])
+
+  def testDequeueManyWaitsForFullBatch(self):
+    with self.test_session() as sess:
+      q = tf.BatchingFIFOQueue(10, tf.float32, batch_timeout_micros=1000,
+                               shapes=((),))
+      sess.run(q.enqueue_many(([1., 2.],)))
+      enqueue_op = q.enqueue_many(([3., 4.],))
+      dequeued_t = q.dequeue_many(4)
+      results = []
+
+      def dequeue():
+        results.append(sess.run(dequeued_t))
+
+      dequeue_thread = self.checkedThread(target=dequeue)
+      dequeue_thread.start()
+      time.sleep(0.1)
+      self.assertEqual([], results)
+      sess.run(enqueue_op)
+      dequeue_thread.join()
+      self.assertAllEqual([1., 2., 3., 4.], results[0])
+
+  def testDequeueUpToAfterClose(self):
+    with self.test_session():
+      q = tf.BatchingFIFOQueue(10, tf.float32, batch_timeout_micros=10000000,
+                               shapes=((),))
+      q.enqueue_many(([1., 2.],)).run()
+      q.close().run()
+      self.assertAllEqual([1., 2.], q.dequeue_up_to(5).eval())
+      with self.assertRaisesOpError("is closed and has insufficient"):
+        q.dequeue_up_to(5).eval()
+
+
+if __name__ == "__main__":
+  tf.test.main()
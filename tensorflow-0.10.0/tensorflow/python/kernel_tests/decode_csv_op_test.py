@@ -176,5 +176,27 @@ class DecodeCSVOpTest(tf.test.TestCase):
                expected_err_re="Quoted field has to end with quote followed.*")
 
 
+  def testManyRecords(self):
+    # Enough records to be parsed in parallel, with fields longer than the
+    # 16 bytes the delimiter scan looks at at once.
+    records = ['%d,%s,"x""%d"' % (i, "y" * (i % 40), i) for i in range(5000)]
+    args = {"records": records, "record_defaults": [[0], [""], [""]]}
+
+    expected_out = [list(range(5000)),
+                    [b"y" * (i % 40) for i in range(5000)],
+                    [('x"%d' % i).encode() for i in range(5000)]]
+
+    self._test(args, expected_out)
+
+  def testFirstBadRecordIsReported(self):
+    records = ["%d" % i for i in range(5000)]
+    records[4000] = "bad"
+    records[2000] = "1.5"
+    args = {"records": records, "record_defaults": [[0]]}
+
+    self._test(args,
+               expected_err_re="Field 0 in record 2000 is not a valid int32")
+
+
 if __name__ == "__main__":
   tf.test.main()
@@ -466,10 +466,11 @@ class TFRecordIteratorTest(tf.test.TestCase):
   def _Record(self, r):
     return tf.compat.as_bytes("Record %d" % r)
 
-  def _CreateFile(self):
+  def _CreateFile(self, options=None):
     fn = os.path.join(self.get_temp_dir(), "tf_record.txt")
-    options = tf.python_io.TFRecordOptions(
-        compression_type=tf.python_io.TFRecordCompressionType.ZLIB)
+    if options is None:
+      options = tf.python_io.TFRecordOptions(
+          compression_type=tf.python_io.TFRecordCompressionType.ZLIB)
     writer = tf.python_io.TFRecordWriter(fn, options=options)
     for i in range(self._num_records):
       writer.write(self._Record(i))
@@ -488,6 +489,23 @@ class TFRecordIteratorTest(tf.test.TestCase):
     with self.assertRaises(StopIteration):
       record = next(reader)
 
+  def testBatchIterator(self):
+    expected = [self._Record(i) for i in range(self._num_records)]
+    for compression_type in [tf.python_io.TFRecordCompressionType.NONE,
+                             tf.python_io.TFRecordCompressionType.ZLIB]:
+      options = tf.python_io.TFRecordOptions(compression_type=compression_type)
+      fn = self._CreateFile(options)
+      batches = list(tf.python_io.tf_record_batch_iterator(fn, 3, options))
+      self.assertEqual([3, 3, 1], [len(batch) for batch in batches])
+      self.assertAllEqual(expected, sum(batches, []))
+      self.assertAllEqual(expected,
+                          list(tf.python_io.tf_record_iterator(fn, options)))
+
+  def testBatchIteratorRejectsEmptyBatches(self):
+    fn = self._CreateFile()
+    with self.assertRaises(ValueError):
+      next(tf.python_io.tf_record_batch_iterator(fn, 0))
+
 
 class AsyncReaderTest(tf.test.TestCase):
 
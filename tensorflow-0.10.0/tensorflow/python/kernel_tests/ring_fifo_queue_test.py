@@ -0,0 +1,227 @@
+# Copyright 2016 The TensorFlow Authors. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+"""Tests for tensorflow.ops.data_flow_ops.RingFIFOQueue."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import time
+from six.moves import xrange  # pylint: disable=redefined-builtin
+import tensorflow as tf
+
+
+class RingFIFOQueueTest(tf.test.TestCase):
+
+  def testConstructor(self):
+    with tf.Graph().as_default():
+      q = tf.RingFIFOQueue(10, (tf.int32, tf.float32),
+                           shapes=((), (2,)), shared_name="foo", name="Q")
+    self.assertTrue(isinstance(q.queue_ref, tf.Tensor))
+    self.assertEquals(tf.string_ref, q.queue_ref.dtype)
+    self.assertProtoEquals("""
+      name:'Q' op:'RingFIFOQueue'
+      attr { key: 'component_types' value { list {
+        type: DT_INT32 type : DT_FLOAT
+      } } }
+      attr { key: 'shapes' value { list {
+        shape { }
+        shape { dim { size: 2 } }
+      } } }
+      attr { key: 'capacity' value { i: 10 } }
+      attr { key: 'container' value { s: '' } }
+      attr { key: 'shared_name' value { s: 'foo' } }
+      """, q.queue_ref.op.node_def)
+
+  def testConstructorRequiresShapes(self):
+    with tf.Graph().as_default():
+      with self.assertRaisesRegexp(ValueError, "Shapes must be provided"):
+        tf.RingFIFOQueue(10, (tf.int32, tf.float32), shapes=None)
+      with self.assertRaisesRegexp(ValueError, "must be fully defined"):
+        tf.RingFIFOQueue(10, tf.float32, shapes=[(None,)])
+
+  def testCapacityMustBePositive(self):
+    with tf.Graph().as_default():
+      with self.assertRaises(ValueError):
+        tf.RingFIFOQueue(0, tf.float32, shapes=())
+
+  def testEnqueueAndDequeueInOrder(self):
+    with self.test_session():
+      q = tf.RingFIFOQueue(3, (tf.int32, tf.float32), shapes=((), (2,)))
+      x = tf.placeholder(tf.int32, ())
+      enqueue_op = q.enqueue((x, tf.fill([2], tf.to_float(x))))
+      dequeued_t = q.dequeue()
+      # Wraps around the ring several times.
+      for i in xrange(10):
+        enqueue_op.run(feed_dict={x: i})
+        enqueue_op.run(feed_dict={x: i + 100})
+        self.assertEqual(2, q.size().eval())
+        for expected in (i, i + 100):
+          int_val, float_val = dequeued_t.eval()
+          self.assertEqual(expected, int_val)
+          self.assertAllEqual([expected, expected], float_val)
+      self.assertEqual(0, q.size().eval())
+
+  def testEnqueueManyAndDequeueMany(self):
+    with self.test_session() as sess:
+      q = tf.RingFIFOQueue(4, tf.float32, shapes=(2,))
+      elems = [[float(i), float(i + 1)] for i in xrange(6)]
+      enqueue_op = q.enqueue_many((elems,))
+      dequeued_t = q.dequeue_many(3)
+      empty_t = q.dequeue_many(0)
+
+      # The batch is larger than the ring, so it only completes as
+      # dequeue_many makes room.
+      thread = self.checkedThread(target=sess.run, args=(enqueue_op,))
+      thread.start()
+      self.assertAllEqual(elems[:3], dequeued_t.eval())
+      self.assertAllEqual(elems[3:], dequeued_t.eval())
+      thread.join()
+      self.assertEqual((0, 2), empty_t.eval().shape)
+
+  def testParallelEnqueueAndDequeue(self):
+    with self.test_session() as sess:
+      q = tf.RingFIFOQueue(8, tf.int32, shapes=())
+      x = tf.placeholder(tf.int32, ())
+      enqueue_op = q.enqueue((x,))
+      dequeued_t = q.dequeue()
+      num_producers = 4
+      num_elements = 250
+
+      def enqueue(producer):
+        for i in xrange(num_elements):
+          sess.run(enqueue_op, feed_dict={x: producer * num_elements + i})
+
+      results = [[] for _ in xrange(num_producers)]
+
+      def dequeue(consumer):
+        for _ in xrange(num_elements):
+          results[consumer].append(sess.run(dequeued_t))
+
+      threads = [self.checkedThread(target=enqueue, args=(i,))
+                 for i in xrange(num_producers)]
+      threads += [self.checkedThread(target=dequeue, args=(i,))
+                  for i in xrange(num_producers)]
+      for thread in threads:
+        thread.start()
+      for thread in threads:
+        thread.join()
+
+      # Every element is delivered exactly once, and each consumer sees the
+      # elements of any one producer in the order they were enqueued.
+      all_results = sum(results, [])
+      self.assertItemsEqual(xrange(num_producers * num_elements), all_results)
+      for consumer_results in results:
+        for producer in xrange(num_producers):
+          from_producer = [v for v in consumer_results
+                           if v // num_elements == producer]
+          self.assertEqual(sorted(from_producer), from_producer)
+      self.assertEqual(0, q.size().eval())
+
+  def testBlockingDequeue(self):
+    with self.test_session() as sess:
+      q = tf.RingFIFOQueue(10, tf.float32, shapes=())
+      enqueue_op = q.enqueue((10.0,))
+      dequeued_t = q.dequeue()
+
+      def enqueue():
+        # The enqueue_op should run after the dequeue op has blocked.
+        # TODO(mrry): Figure out how to do this without sleeping.
+        time.sleep(0.1)
+        sess.run(enqueue_op)
+
+      enqueue_thread = self.checkedThread(target=enqueue)
+      enqueue_thread.start()
+      self.assertEqual(10.0, dequeued_t.eval())
+      enqueue_thread.join()
+
+  def testBlockingEnqueueToFullQueue(self):
+    with self.test_session() as sess:
+      q = tf.RingFIFOQueue(4, tf.float32, shapes=())
+      elems = [10.0, 20.0, 30.0, 40.0]
+      enqueue_op = q.enqueue_many((elems,))
+      blocking_enqueue_op = q.enqueue((50.0,))
+      dequeued_t = q.dequeue()
+
+      enqueue_op.run()
+
+      def blocking_enqueue():
+        sess.run(blocking_enqueue_op)
+      thread = self.checkedThread(target=blocking_enqueue)
+      thread.start()
+      # The dequeue ops should run after the blocking_enqueue_op has blocked.
+      # TODO(mrry): Figure out how to do this without sleeping.
+      time.sleep(0.1)
+      for elem in elems:
+        self.assertEqual(elem, dequeued_t.eval())
+      self.assertEqual(50.0, dequeued_t.eval())
+      thread.join()
+
+  def testCloseDrainsRemainingElements(self):
+    with self.test_session():
+      q = tf.RingFIFOQueue(10, tf.float32, shapes=())
+      enqueue_op = q.enqueue_many(([10.0, 20.0, 30.0],))
+      close_op = q.close()
+      dequeued_t = q.dequeue()
+      dequeued_up_to_t = q.dequeue_up_to(5)
+
+      enqueue_op.run()
+      close_op.run()
+      with self.assertRaisesRegexp(tf.errors.AbortedError, "is closed"):
+        enqueue_op.run()
+      self.assertEqual(10.0, dequeued_t.eval())
+      self.assertAllEqual([20.0, 30.0], dequeued_up_to_t.eval())
+      with self.assertRaisesRegexp(tf.errors.OutOfRangeError,
+                                   "is closed and has insufficient"):
+        dequeued_t.eval()
+
+  def testClosedBlockingDequeueManyRestoresPartialBatch(self):
+    with self.test_session() as sess:
+      q = tf.RingFIFOQueue(4, tf.float32, shapes=())
+      elems = [1.0, 2.0, 3.0]
+      enqueue_op = q.enqueue_many((elems,))
+      dequeued_t = q.dequeue_many(4)
+      cleanup_dequeue_t = q.dequeue()
+      close_op = q.close()
+
+      enqueue_op.run()
+
+      def dequeue():
+        with self.assertRaises(tf.errors.OutOfRangeError):
+          sess.run(dequeued_t)
+
+      dequeue_thread = self.checkedThread(target=dequeue)
+      dequeue_thread.start()
+      # The close_op should run after the dequeue_thread has blocked.
+      # TODO(mrry): Figure out how to do this without sleeping.
+      time.sleep(0.1)
+
+      close_op.run()
+      dequeue_thread.join()
+      for elem in elems:
+        self.assertEqual(elem, cleanup_dequeue_t.eval())
+      self.assertEqual(0, q.size().eval())
+
+  def testSharedQueueIncompatibleCapacity(self):
+    with self.test_session():
+      q_a_1 = tf.RingFIFOQueue(10, tf.float32, shapes=(), shared_name="q_a")
+      q_a_2 = tf.RingFIFOQueue(15, tf.float32, shapes=(), shared_name="q_a")
+      q_a_1.queue_ref.eval()
+      with self.assertRaisesOpError("capacity"):
+        q_a_2.queue_ref.eval()
+
+
+if __name__ == "__main__":
+  tf.test.main()
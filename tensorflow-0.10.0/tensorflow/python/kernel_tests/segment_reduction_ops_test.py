@@ -246,6 +246,19 @@ class UnsortedSegmentSumTest(SegmentReductionHelper):
         self._assertAllClose(indices, np_ans, tf_ans)
         self.assertShapeEqual(np_ans, s)
 
+  def testLargeValues(self):
+    # Large enough for the segments to be summed in parallel.
+    rng = np.random.RandomState(3)
+    num_segments = 500
+    indices = rng.randint(0, num_segments, 20000)
+    np_x = rng.rand(20000, 4)
+    np_ans = np.zeros((num_segments, 4))
+    np.add.at(np_ans, indices, np_x)
+    with self.test_session(use_gpu=False):
+      s = tf.unsorted_segment_sum(data=np_x, segment_ids=indices,
+                                  num_segments=num_segments)
+      self.assertAllClose(np_ans, s.eval())
+
   def testGradient(self):
     num_cols = 2
     indices_flat = np.array([0, 4, 0, 8, 3, 8, 4, 7, 7, 3])
@@ -114,6 +114,30 @@ class TensorArrayCPUTest(tf.test.TestCase):
     self._testTensorArrayWriteConcat(tf.complex128)
     self._testTensorArrayWriteConcat(tf.string)
 
+  def testTensorArrayCapacityWritePackConcat(self):
+    with self.test_session(use_gpu=self._use_gpu):
+      ta = tensor_array_ops.TensorArray(
+          dtype=tf.float32, size=0, dynamic_size=True, capacity=2,
+          clear_after_read=False, infer_shape=False)
+      w0 = ta.write(0, [[4.0, 5.0]])
+      w1 = w0.write(1, [[6.0, 7.0]])
+      # Held by the buffer.
+      self.assertAllEqual([[[4.0, 5.0]], [[6.0, 7.0]]], w1.pack().eval())
+      self.assertAllEqual([[4.0, 5.0], [6.0, 7.0]], w1.concat().eval())
+      # Past the capacity.
+      w2 = w1.write(2, [[8.0, 9.0]])
+      self.assertAllEqual([[[4.0, 5.0]], [[6.0, 7.0]], [[8.0, 9.0]]],
+                          w2.pack().eval())
+      self.assertAllEqual([[8.0, 9.0]], w2.read(2).eval())
+
+      ta = tensor_array_ops.TensorArray(
+          dtype=tf.float32, size=2, capacity=2, infer_shape=False)
+      # A shape other than the first one written.
+      w0 = ta.write(0, [[4.0, 5.0]])
+      w1 = w0.write(1, [[6.0, 7.0], [8.0, 9.0]])
+      self.assertAllEqual([[4.0, 5.0], [6.0, 7.0], [8.0, 9.0]],
+                          w1.concat().eval())
+
   def testTensorArrayUnpackWrongMajorSizeFails(self):
     with self.test_session():
       ta = tensor_array_ops.TensorArray(
@@ -697,7 +721,7 @@ class TensorArrayCPUTest(tf.test.TestCase):
       w1 = w0.write(1, [3.0])
       w1.close().run()  # Expected to run without problems
 
-  def _testWhileLoopWritePackGradients(self, dynamic_size, dtype):
+  def _testWhileLoopWritePackGradients(self, dynamic_size, dtype, capacity=0):
     np_dtype = dtype.as_numpy_dtype
     with self.test_session(use_gpu=self._use_gpu) as session:
       v0 = tf.identity(np.arange(3*5, dtype=np_dtype).reshape(3, 5))
@@ -705,7 +729,8 @@ class TensorArrayCPUTest(tf.test.TestCase):
       state0 = tf.identity(np.array([1] * 5, dtype=np_dtype))
       ta = tensor_array_ops.TensorArray(
           dtype=dtype, tensor_array_name="foo",
-          size=0 if dynamic_size else 3, dynamic_size=dynamic_size)
+          size=0 if dynamic_size else 3, dynamic_size=dynamic_size,
+          capacity=capacity)
       time_0 = tf.identity(0)
 
       def body(time, ta_t, state):
@@ -777,6 +802,10 @@ class TensorArrayCPUTest(tf.test.TestCase):
     self._testWhileLoopWritePackGradients(
         dynamic_size=True, dtype=tf.float32)
 
+  def testWhileLoopCapacityWritePackGradients(self):
+    self._testWhileLoopWritePackGradients(
+        dynamic_size=True, dtype=tf.float32, capacity=3)
+
   def testSumOfTwoReadVariablesWithoutRepeatGrad(self):
     with self.test_session(use_gpu=self._use_gpu) as session:
       a = tf.identity(np.arange(3*5, dtype=np.float32).reshape(3, 5) + 1)
@@ -65,6 +65,16 @@ class TopKTest(tf.test.TestCase):
     inputs = [3, 6, 15, 18, 6, 12, 1, 17, 3, 0, 4, 19, 1, 6]
     self._validateTopK(inputs, 3, [19, 18, 17], [11, 3, 7])
 
+  def testTopKManyRows(self):
+    # Ties between the small integers check that lower indices come first,
+    # both for small k and for k above the small k path.
+    np.random.seed(5)
+    inputs = np.random.randint(0, 20, size=[300, 64]).astype(np.float32)
+    for k in [5, 32, 33]:
+      indices = np.argsort(-inputs, axis=1, kind='mergesort')[:, :k]
+      values = np.array([row[i] for row, i in zip(inputs, indices)])
+      self._validateTopK(inputs, k, values, indices)
+
   def testTensorK(self):
     inputs = [3, 6, 15, 18, 6, 12, 1, 17, 3, 0, 4, 19, 1, 6]
     k = tf.constant(3)
@@ -30,39 +30,83 @@ PyRecordReader::PyRecordReader() {}
 
 PyRecordReader* PyRecordReader::New(const string& filename, uint64 start_offset,
                                     const string& compression_type_string) {
+  RecordReaderOptions options;
+  if (compression_type_string == "ZLIB") {
+    options.compression_type = RecordReaderOptions::ZLIB_COMPRESSION;
+  }
+
+  // Compressed files are read sequentially through a buffer, so only
+  // uncompressed ones are mapped.
+  Env* env = Env::Default();
+  std::unique_ptr<ReadOnlyMemoryRegion> region;
+  if (options.compression_type == RecordReaderOptions::NONE &&
+      env->NewReadOnlyMemoryRegionFromFile(filename, &region).ok()) {
+    PyRecordReader* reader = new PyRecordReader;
+    reader->offset_ = start_offset;
+    reader->region_ = std::move(region);
+    reader->reader_ = new RecordReader(reader->region_.get(), options);
+    return reader;
+  }
+
   std::unique_ptr<RandomAccessFile> file;
-  Status s = Env::Default()->NewRandomAccessFile(filename, &file);
+  Status s = env->NewRandomAccessFile(filename, &file);
   if (!s.ok()) {
     return nullptr;
   }
   PyRecordReader* reader = new PyRecordReader;
   reader->offset_ = start_offset;
   reader->file_ = file.release();
-
-  RecordReaderOptions options;
-  if (compression_type_string == "ZLIB") {
-    options.compression_type = RecordReaderOptions::ZLIB_COMPRESSION;
-  }
   reader->reader_ = new RecordReader(reader->file_, options);
   return reader;
 }
 
-PyRecordReader::~PyRecordReader() {
-  delete reader_;
-  delete file_;
-}
+PyRecordReader::~PyRecordReader() { Close(); }
 
 bool PyRecordReader::GetNext() {
   if (reader_ == nullptr) return false;
+  if (region_ != nullptr) {
+    StringPiece record;
+    if (!reader_->ReadRecord(&offset_, &record).ok()) return false;
+    record_.assign(record.data(), record.size());
+    return true;
+  }
   Status s = reader_->ReadRecord(&offset_, &record_);
   return s.ok();
 }
 
+bool PyRecordReader::GetNextBatch(int max_records) {
+  batch_.clear();
+  if (reader_ == nullptr) return false;
+  if (region_ != nullptr) {
+    StringPiece record;
+    while (static_cast<int>(batch_.size()) < max_records &&
+           reader_->ReadRecord(&offset_, &record).ok()) {
+      batch_.push_back(record);
+    }
+  } else {
+    // The buffers are kept across batches, so that their capacity is reused.
+    if (static_cast<int>(batch_storage_.size()) < max_records) {
+      batch_storage_.resize(max_records);
+    }
+    int num_records = 0;
+    while (num_records < max_records &&
+           reader_->ReadRecord(&offset_, &batch_storage_[num_records]).ok()) {
+      ++num_records;
+    }
+    for (int i = 0; i < num_records; ++i) {
+      batch_.push_back(batch_storage_[i]);
+    }
+  }
+  return !batch_.empty();
+}
+
 void PyRecordReader::Close() {
+  batch_.clear();
   delete reader_;
   delete file_;
   file_ = nullptr;
   reader_ = nullptr;
+  region_.reset();
 }
 
 }  // namespace io
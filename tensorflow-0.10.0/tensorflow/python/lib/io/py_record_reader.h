@@ -16,6 +16,9 @@ limitations under the License.
 #ifndef TENSORFLOW_PYTHON_LIB_IO_PY_RECORD_READER_H_
 #define TENSORFLOW_PYTHON_LIB_IO_PY_RECORD_READER_H_
 
+#include <memory>
+#include <vector>
+
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
@@ -23,6 +26,7 @@ limitations under the License.
 namespace tensorflow {
 
 class RandomAccessFile;
+class ReadOnlyMemoryRegion;
 
 namespace io {
 
@@ -31,6 +35,9 @@ class RecordReader;
 // A wrapper around io::RecordReader that is more easily SWIG wrapped for
 // Python.  An instance of this class is not safe for concurrent access
 // by multiple threads.
+//
+// Uncompressed files are mapped into memory when the file system supports
+// it, and their records are then read in place.
 class PyRecordReader {
  public:
   // TODO(vrv): make this take a shared proto to configure
@@ -47,6 +54,16 @@ class PyRecordReader {
   // Return the current record contents.  Only valid after the preceding call
   // to GetNext() returned true
   string record() const { return record_; }
+
+  // Attempt to get up to "max_records" records starting at
+  // "current_offset()".  If at least one record was read, returns true, and
+  // the records can be retrieved with "this->batch()".  Otherwise, returns
+  // false.  Reading a batch crosses into Python once for all its records.
+  bool GetNextBatch(int max_records);
+  // Return the records of the current batch.  They point into the mapped
+  // file or into buffers of this reader, and are valid until the next call
+  // to GetNext(), GetNextBatch() or Close().
+  const std::vector<StringPiece>& batch() const { return batch_; }
   // Return the current offset in the file.
   uint64 offset() const { return offset_; }
 
@@ -57,9 +74,15 @@ class PyRecordReader {
   PyRecordReader();
 
   uint64 offset_;
-  RandomAccessFile* file_;    // Owned
-  io::RecordReader* reader_;  // Owned
+  RandomAccessFile* file_ = nullptr;  // Owned
+  std::unique_ptr<ReadOnlyMemoryRegion> region_;
+  io::RecordReader* reader_ = nullptr;  // Owned
   string record_;
+
+  // Records of the current batch, and the buffers holding them when the file
+  // is not mapped.
+  std::vector<StringPiece> batch_;
+  std::vector<string> batch_storage_;
   TF_DISALLOW_COPY_AND_ASSIGN(PyRecordReader);
 };
 
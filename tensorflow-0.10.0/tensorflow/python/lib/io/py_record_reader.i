@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 
 %nothread tensorflow::io::PyRecordReader::GetNext;
+%nothread tensorflow::io::PyRecordReader::GetNextBatch;
 
 %include "tensorflow/python/platform/base.i"
 
@@ -33,10 +34,34 @@ limitations under the License.
   Py_END_ALLOW_THREADS
 }
 
+%feature("except") tensorflow::io::PyRecordReader::GetNextBatch {
+  // Let other threads run while we read
+  Py_BEGIN_ALLOW_THREADS
+  $action
+  Py_END_ALLOW_THREADS
+}
+
 %{
 #include "tensorflow/python/lib/io/py_record_reader.h"
 %}
 
+// Returns the records of a batch as a list of Python strings, copied straight
+// from the mapped file or the buffers of the reader.
+%typemap(out) const std::vector<tensorflow::StringPiece>&,
+              const std::vector<StringPiece>& {
+  $result = PyList_New($1->size());
+  if ($result == NULL) SWIG_fail;
+  for (size_t i = 0; i < $1->size(); ++i) {
+    const tensorflow::StringPiece& record = (*$1)[i];
+    PyObject* bytes = PyBytes_FromStringAndSize(record.data(), record.size());
+    if (bytes == NULL) {
+      Py_DECREF($result);
+      SWIG_fail;
+    }
+    PyList_SET_ITEM($result, i, bytes);
+  }
+}
+
 %ignoreall
 
 %unignore tensorflow;
@@ -44,6 +69,8 @@ limitations under the License.
 %unignore tensorflow::io::PyRecordReader;
 %unignore tensorflow::io::PyRecordReader::~PyRecordReader;
 %unignore tensorflow::io::PyRecordReader::GetNext;
+%unignore tensorflow::io::PyRecordReader::GetNextBatch;
+%unignore tensorflow::io::PyRecordReader::batch;
 %unignore tensorflow::io::PyRecordReader::offset;
 %unignore tensorflow::io::PyRecordReader::record;
 %unignore tensorflow::io::PyRecordReader::Close;
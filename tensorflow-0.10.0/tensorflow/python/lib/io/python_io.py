@@ -21,6 +21,7 @@ suitable if fast sharding or other non-sequential access is desired.
 
 @@TFRecordWriter
 @@tf_record_iterator
+@@tf_record_batch_iterator
 
 - - -
 
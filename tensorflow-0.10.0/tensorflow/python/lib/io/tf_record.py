@@ -36,6 +36,10 @@ class TFRecordOptions(object):
     self.compression_type = compression_type
 
 
+# Number of records tf_record_iterator reads per call into the C++ reader.
+_ITERATOR_BATCH_SIZE = 256
+
+
 def tf_record_iterator(path, options=None):
   """An iterator that read the records from a TFRecords file.
 
@@ -49,6 +53,33 @@ def tf_record_iterator(path, options=None):
   Raises:
     IOError: If `path` cannot be opened for reading.
   """
+  for batch in tf_record_batch_iterator(path, _ITERATOR_BATCH_SIZE, options):
+    for record in batch:
+      yield record
+
+
+def tf_record_batch_iterator(path, batch_size, options=None):
+  """An iterator that reads the records from a TFRecords file in batches.
+
+  Each batch is read by a single call into the C++ reader, which does not
+  hold the Python global interpreter lock while it reads, so threads reading
+  different files run in parallel. Uncompressed files are read in place from
+  a memory mapping when the file system supports it.
+
+  Args:
+    path: The path to the TFRecords file.
+    batch_size: The maximum number of records per batch.
+    options: (optional) A TFRecordOptions object.
+
+  Yields:
+    Lists of up to `batch_size` strings. Only the last batch may be shorter.
+
+  Raises:
+    IOError: If `path` cannot be opened for reading.
+    ValueError: If `batch_size` is not positive.
+  """
+  if batch_size <= 0:
+    raise ValueError("batch_size must be positive, got %d." % batch_size)
   compression_type_string = ""
   if options:
     if options.compression_type == TFRecordCompressionType.ZLIB:
@@ -59,8 +90,8 @@ def tf_record_iterator(path, options=None):
 
   if reader is None:
     raise IOError("Could not open %s." % path)
-  while reader.GetNext():
-    yield reader.record()
+  while reader.GetNextBatch(batch_size):
+    yield reader.batch()
   reader.Close()
 
 
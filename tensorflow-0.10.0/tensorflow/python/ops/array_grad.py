@@ -195,6 +195,7 @@ def _SplitGrad(op, *grads):
 
 
 ops.NoGradient("Const")
+ops.NoGradient("ImmutableConst")
 
 
 @ops.RegisterGradient("Diag")
@@ -1421,6 +1421,11 @@ def _PlaceholderShape(op):
     return [tensor_shape.unknown_shape()]
 
 
+@ops.RegisterShape("ImmutableConst")
+def _ImmutableConstShape(op):
+  return [tensor_shape.TensorShape(op.get_attr("shape"))]
+
+
 @ops.RegisterShape("CheckNumerics")
 @ops.RegisterShape("Identity")
 @ops.RegisterShape("RefIdentity")
@@ -711,6 +711,113 @@ class PaddingFIFOQueue(QueueBase):
     super(PaddingFIFOQueue, self).__init__(dtypes, shapes, names, queue_ref)
 
 
+class BatchingFIFOQueue(QueueBase):
+  """A FIFOQueue whose `dequeue_up_to` returns partial batches after a timeout.
+
+  See [`tf.QueueBase`](#QueueBase) for a description of the methods on
+  this class.
+
+  @@__init__
+  """
+
+  def __init__(self, capacity, dtypes, batch_timeout_micros, shapes=None,
+               names=None, shared_name=None, name="batching_fifo_queue"):
+    """Creates a FIFO queue that bounds the latency of `dequeue_up_to`.
+
+    `dequeue_up_to(n)` on a `BatchingFIFOQueue` returns `n` elements, or the
+    elements that are available once it has waited `batch_timeout_micros`,
+    whichever comes first.  If the queue is empty at that point, the batch is
+    returned as soon as its first element arrives.  This lets a serving loop
+    run dynamically sized batches: large ones under load, and small ones
+    without waiting for a full batch when traffic is light.  All other
+    operations behave as in a `FIFOQueue`.
+
+    Args:
+      capacity: An integer. The upper bound on the number of elements
+        that may be stored in this queue.
+      dtypes:  A list of `DType` objects. The length of `dtypes` must equal
+        the number of tensors in each queue element.
+      batch_timeout_micros: A non-negative integer. How long `dequeue_up_to`
+        waits for a full batch.
+      shapes: (Optional.) A list of fully-defined `TensorShape` objects
+        with the same length as `dtypes`, or `None`.
+      names: (Optional.) A list of string naming the components in the queue
+        with the same length as `dtypes`, or `None`.  If specified the dequeue
+        methods return a dictionary with the names as keys.
+      shared_name: (Optional.) If non-empty, this queue will be shared under
+        the given name across multiple sessions.
+      name: Optional name for the queue operation.
+    """
+    dtypes = _as_type_list(dtypes)
+    shapes = _as_shape_list(shapes, dtypes)
+    names = _as_name_list(names, dtypes)
+    queue_ref = gen_data_flow_ops._batching_fifo_queue(
+        component_types=dtypes, shapes=shapes, capacity=capacity,
+        batch_timeout_micros=batch_timeout_micros, shared_name=shared_name,
+        name=name)
+
+    super(BatchingFIFOQueue, self).__init__(dtypes, shapes, names, queue_ref)
+
+
+class RingFIFOQueue(QueueBase):
+  """A FIFOQueue of fixed-shape elements backed by a lock-free ring buffer.
+
+  A `RingFIFOQueue` behaves like a `FIFOQueue` whose shapes are fully
+  defined, but single-element `enqueue` and `dequeue` operations do not take
+  a lock while no other operation is blocked on the queue.  It suits input
+  pipelines with many producer and consumer threads moving small elements.
+
+  See [`tf.QueueBase`](#QueueBase) for a description of the methods on
+  this class.
+
+  @@__init__
+  """
+
+  def __init__(self, capacity, dtypes, shapes, names=None, shared_name=None,
+               name="ring_fifo_queue"):
+    """Creates a queue that dequeues elements in a first-in first-out order.
+
+    A `RingFIFOQueue` preallocates a slot for each of its `capacity`
+    elements.  Each element is a fixed-length tuple of tensors whose dtypes
+    are described by `dtypes`, and whose shapes are described by the `shapes`
+    argument.  Operations that have to wait because the queue is full or
+    empty, and all `enqueue_many` and `dequeue_many` operations, are served
+    in first-in first-out order, as in a `FIFOQueue`.
+
+    Args:
+      capacity: A positive integer. The upper bound on the number of elements
+        that may be stored in this queue.
+      dtypes:  A list of `DType` objects. The length of `dtypes` must equal
+        the number of tensors in each queue element.
+      shapes: A list of fully-defined `TensorShape` objects with the same
+        length as `dtypes`.
+      names: (Optional.) A list of string naming the components in the queue
+        with the same length as `dtypes`, or `None`.  If specified the dequeue
+        methods return a dictionary with the names as keys.
+      shared_name: (Optional.) If non-empty, this queue will be shared under
+        the given name across multiple sessions.
+      name: Optional name for the queue operation.
+
+    Raises:
+      ValueError: If shapes is not a list of fully-defined shapes, or the
+        lengths of dtypes and shapes do not match, or if names is specified
+        and the lengths of dtypes and names do not match.
+    """
+    dtypes = _as_type_list(dtypes)
+    shapes = _as_shape_list(shapes, dtypes)
+    names = _as_name_list(names, dtypes)
+    if shapes is None or len(dtypes) != len(shapes):
+      raise ValueError("Shapes must be provided for all components, "
+                       "but received %d dtypes and %d shapes."
+                       % (len(dtypes), len(shapes or [])))
+
+    queue_ref = gen_data_flow_ops._ring_fifo_queue(
+        component_types=dtypes, shapes=shapes, capacity=capacity,
+        shared_name=shared_name, name=name)
+
+    super(RingFIFOQueue, self).__init__(dtypes, shapes, names, queue_ref)
+
+
 class PriorityQueue(QueueBase):
   """A queue implementation that dequeues elements in prioritized order.
 
@@ -1037,6 +1144,8 @@ ops.RegisterShape("QueueSize")(common_shapes.scalar_shape)
 ops.RegisterShape("Queue")(common_shapes.scalar_shape)
 ops.RegisterShape("FIFOQueue")(common_shapes.scalar_shape)
 ops.RegisterShape("PaddingFIFOQueue")(common_shapes.scalar_shape)
+ops.RegisterShape("RingFIFOQueue")(common_shapes.scalar_shape)
+ops.RegisterShape("BatchingFIFOQueue")(common_shapes.scalar_shape)
 ops.RegisterShape("RandomShuffleQueue")(common_shapes.scalar_shape)
 ops.RegisterShape("PriorityQueue")(common_shapes.scalar_shape)
 
@@ -78,6 +78,8 @@ Queues](../../how_tos/threading_and_queues/index.md).
 @@QueueBase
 @@FIFOQueue
 @@PaddingFIFOQueue
+@@BatchingFIFOQueue
+@@RingFIFOQueue
 @@RandomShuffleQueue
 
 ## Dealing with the filesystem
@@ -146,7 +148,8 @@ from tensorflow.python.ops.gen_io_ops import *
 
 
 # pylint: disable=protected-access
-def _save(filename, tensor_names, tensors, tensor_slices=None, name="save"):
+def _save(filename, tensor_names, tensors, tensor_slices=None, name="save",
+          async_write=False, max_incremental_saves=0):
   """Save a list of tensors to a file with given names.
 
   Example usage without slice info:
@@ -164,6 +167,12 @@ def _save(filename, tensor_names, tensors, tensor_slices=None, name="save"):
       a larger virtual tensor that each tensor is a part of.  If not specified
       each tensor is saved as a full slice.
     name: string.  Optional name for the op.
+    async_write: If True, the op only snapshots the tensors and returns, and
+      the file is written in the background.  Run `_wait_for_pending_save` on
+      the filename to wait for it.  Implies `tensor_slices`.
+    max_incremental_saves: If positive, up to this many saves after a full
+      one only write the rows that changed since the previous save.  Implies
+      `tensor_slices`.
 
   Requires:
     The length of tensors should match the size of tensor_names and of
@@ -172,6 +181,13 @@ def _save(filename, tensor_names, tensors, tensor_slices=None, name="save"):
   Returns:
     An Operation that saves the tensors.
   """
+  if async_write or max_incremental_saves:
+    if tensor_slices is None:
+      tensor_slices = [""] * len(tensors)
+    return gen_io_ops._save_slices(
+        filename, tensor_names, tensor_slices, tensors,
+        async_write=async_write, max_incremental_saves=max_incremental_saves,
+        name=name)
   if tensor_slices is None:
     return gen_io_ops._save(filename, tensor_names, tensors, name=name)
   else:
@@ -203,6 +219,34 @@ def _restore_slice(file_pattern, tensor_name, shape_and_slice, tensor_type,
       preferred_shard, name=name)
 
 
+def _restore_slices(file_pattern, tensor_names, shapes_and_slices,
+                    tensor_types, name="restore_slices", preferred_shard=-1):
+  """Restore several tensor slices from a set of files with a given pattern.
+
+  The files are opened once, and the tensors are read from them in parallel.
+
+  Example usage:
+    RestoreSlices("/foo/bar-?????-of-?????", ["w", "b"], ["10 10 0,2:-", ""],
+                  [DT_FLOAT, DT_FLOAT])
+
+  Args:
+    file_pattern: the file pattern used to match a set of checkpoint files.
+    tensor_names: a list of strings, the names of the tensors to restore.
+    shapes_and_slices: a list of strings, the shape-and-slice spec of each
+      tensor, or "" for a whole tensor.
+    tensor_types: the types of the tensors to restore.
+    name: string.  Optional name for the op.
+    preferred_shard: Int. Optional shard to open first in the checkpoint file.
+
+  Returns:
+    A list of tensors of types "tensor_types".
+  """
+  base_types = [dtypes.as_dtype(t).base_dtype for t in tensor_types]
+  return gen_io_ops._restore_slices(
+      file_pattern, tensor_names, shapes_and_slices, base_types,
+      preferred_shard, name=name)
+
+
 @ops.RegisterShape("Restore")
 def _RestoreShape(op):
   """Shape function for Restore op."""
@@ -229,6 +273,20 @@ def _RestoreSliceShape(op):
   return [tensor_shape.unknown_shape()]
 
 
+@ops.RegisterShape("RestoreSlices")
+def _RestoreSlicesShape(op):
+  """Shape function for RestoreSlices op."""
+  # Validate input shapes.
+  unused_file_pattern = op.inputs[0].get_shape().merge_with(
+      tensor_shape.scalar())
+  data_count = len(op.outputs)
+  unused_tensor_names_shape = op.inputs[1].get_shape().merge_with(
+      tensor_shape.vector(data_count))
+  unused_shapes_and_slices_shape = op.inputs[2].get_shape().merge_with(
+      tensor_shape.vector(data_count))
+  return [tensor_shape.unknown_shape()] * data_count
+
+
 @ops.RegisterShape("Save")
 def _SaveShape(op):
   """Shape function for Save op."""
@@ -279,6 +337,14 @@ def _ShardedFilespecShape(op):
   return [tensor_shape.scalar()]
 
 
+@ops.RegisterShape("WaitForPendingSave")
+def _WaitForPendingSaveShape(op):
+  """Shape function for WaitForPendingSave op."""
+  # Validate input shapes.
+  unused_filename = op.inputs[0].get_shape().merge_with(tensor_shape.scalar())
+  return []
+
+
 class ReaderBase(object):
   """Base class for different Reader types, that produce a record every step.
 
@@ -33,6 +33,14 @@ string tensor.
 ## Conversion
 
 @@as_string
+
+## Packing
+
+Packed strings hold the elements of a string vector as one `uint8` vector of
+their bytes and an `int64` vector of their offsets into it.
+
+@@pack_strings
+@@unpack_strings
 """
 
 from __future__ import absolute_import
@@ -59,6 +67,8 @@ ops.NoGradient("StringToHashBucketStrong")
 ops.NoGradient("ReduceJoin")
 ops.NoGradient("StringJoin")
 ops.NoGradient("AsString")
+ops.NoGradient("PackStrings")
+ops.NoGradient("UnpackStrings")
 
 ops.RegisterShape("StringToHashBucket")(common_shapes.unchanged_shape)
 ops.RegisterShape("StringToHashBucketFast")(common_shapes.unchanged_shape)
@@ -125,3 +135,21 @@ def _StringJoinShape(op):
     if shape.ndims != 0:
       base_shape = base_shape.merge_with(shape)
   return [base_shape]
+
+
+@ops.RegisterShape("PackStrings")
+def _PackStringsShape(op):
+  """Shape function for the PackStrings op."""
+  num_elements = op.inputs[0].get_shape().num_elements()
+  num_offsets = None if num_elements is None else num_elements + 1
+  return [tensor_shape.vector(None), tensor_shape.vector(num_offsets)]
+
+
+@ops.RegisterShape("UnpackStrings")
+def _UnpackStringsShape(op):
+  """Shape function for the UnpackStrings op."""
+  op.inputs[0].get_shape().assert_has_rank(1)
+  offsets_shape = op.inputs[1].get_shape().with_rank(1)
+  num_offsets = offsets_shape[0].value
+  return [tensor_shape.vector(None if num_offsets is None else
+                              max(num_offsets - 1, 0))]
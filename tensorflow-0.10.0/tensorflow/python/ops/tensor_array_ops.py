@@ -61,7 +61,7 @@ class TensorArray(object):
 
   def __init__(self, dtype, size=None, dynamic_size=None,
                clear_after_read=None, tensor_array_name=None, handle=None,
-               flow=None, infer_shape=True, name=None):
+               flow=None, infer_shape=True, capacity=None, name=None):
     """Construct a new TensorArray or wrap an existing TensorArray handle.
 
     A note about the parameter `name`:
@@ -89,6 +89,11 @@ class TensorArray(object):
         `TensorArray.flow`.
       infer_shape: (optional, default: True) If True, shape inference
         is enabled.  In this case, all elements must have the same shape.
+      capacity: (optional) Python int: if positive, elements written on the
+        CPU to indices below `capacity` are copied into one preallocated
+        buffer, and packing or concatenating them returns the buffer without
+        a copy.  Useful when a bound on the size is known, e.g. the maximum
+        number of steps of a `while_loop` writing to a dynamic size array.
       name: A name for the operation (optional).
 
     Raises:
@@ -111,10 +116,14 @@ class TensorArray(object):
     if handle is not None and clear_after_read is not None:
       raise ValueError("Cannot provide both a handle and clear_after_read "
                        "at the same time")
+    if handle is not None and capacity is not None:
+      raise ValueError("Cannot provide both a handle and capacity "
+                       "at the same time")
 
     if clear_after_read is None:
       clear_after_read = True
     dynamic_size = dynamic_size or False
+    capacity = capacity or 0
 
     self._dtype = dtype
     self._infer_shape = infer_shape
@@ -131,12 +140,14 @@ class TensorArray(object):
             self._handle = gen_data_flow_ops._tensor_array(
                 dtype=dtype, size=size, dynamic_size=dynamic_size,
                 clear_after_read=clear_after_read,
-                tensor_array_name=tensor_array_name, name=scope)
+                tensor_array_name=tensor_array_name, capacity=capacity,
+                name=scope)
         else:
           self._handle = gen_data_flow_ops._tensor_array(
               dtype=dtype, size=size, dynamic_size=dynamic_size,
               clear_after_read=clear_after_read,
-              tensor_array_name=tensor_array_name, name=scope)
+              tensor_array_name=tensor_array_name, capacity=capacity,
+              name=scope)
       if flow is not None:
         self._flow = flow
       else:
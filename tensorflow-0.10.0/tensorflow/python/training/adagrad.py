@@ -34,7 +34,7 @@ class AdagradOptimizer(optimizer.Optimizer):
   """
 
   def __init__(self, learning_rate, initial_accumulator_value=0.1,
-               use_locking=False, name="Adagrad"):
+               use_locking=False, name="Adagrad", sum_duplicate_indices=False):
     """Construct a new Adagrad optimizer.
 
     Args:
@@ -44,6 +44,9 @@ class AdagradOptimizer(optimizer.Optimizer):
       use_locking: If `True` use locks for update operations.
       name: Optional name prefix for the operations created when applying
         gradients.  Defaults to "Adagrad".
+      sum_duplicate_indices: If `True`, sparse gradients with repeated indices,
+        like those of embedding lookups, are summed and each row is updated
+        once, as if the gradient were dense, with the rows updated in parallel.
 
     Raises:
       ValueError: If the `initial_accumulator_value` is invalid.
@@ -54,6 +57,7 @@ class AdagradOptimizer(optimizer.Optimizer):
     super(AdagradOptimizer, self).__init__(use_locking, name)
     self._learning_rate = learning_rate
     self._initial_accumulator_value = initial_accumulator_value
+    self._sum_duplicate_indices = sum_duplicate_indices
     # Created in Initialize.
     self._learning_rate_tensor = None
 
@@ -86,4 +90,5 @@ class AdagradOptimizer(optimizer.Optimizer):
         math_ops.cast(self._learning_rate_tensor, var.dtype.base_dtype),
         grad.values,
         grad.indices,
-        use_locking=self._use_locking)
+        use_locking=self._use_locking,
+        sum_duplicate_indices=self._sum_duplicate_indices)
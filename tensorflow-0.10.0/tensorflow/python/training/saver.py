@@ -22,6 +22,7 @@ from __future__ import print_function
 import collections
 import os.path
 import re
+import threading
 import time
 import uuid
 
@@ -142,7 +143,8 @@ class BaseSaverBuilder(object):
       self.name = name
 
   def __init__(self):
-    pass
+    self._async_write = False
+    self._max_incremental_saves = 0
 
   def save_op(self, filename_tensor, vars_to_save):
     """Create an Op to save 'vars_to_save'.
@@ -162,7 +164,21 @@ class BaseSaverBuilder(object):
         filename=filename_tensor,
         tensor_names=[vs.name for vs in vars_to_save],
         tensors=[vs.var for vs in vars_to_save],
-        tensor_slices=[vs.slice_spec for vs in vars_to_save])
+        tensor_slices=[vs.slice_spec for vs in vars_to_save],
+        async_write=self._async_write,
+        max_incremental_saves=self._max_incremental_saves)
+
+  def wait_op(self, filename_tensor):
+    """Create an Op that waits for an asynchronous save to 'filename_tensor'.
+
+    Args:
+      filename_tensor: String Tensor.
+
+    Returns:
+      An Operation that completes once the file is written.
+    """
+    # pylint: disable=protected-access
+    return gen_io_ops._wait_for_pending_save(filename_tensor)
 
   def restore_op(self, filename_tensor, var_to_save, preferred_shard):
     """Create an Op to read the variable 'var_to_save'.
@@ -186,6 +202,30 @@ class BaseSaverBuilder(object):
         var_to_save.var.dtype,
         preferred_shard=preferred_shard)
 
+  def bulk_restore_op(self, filename_tensor, vars_to_save, preferred_shard):
+    """Create an Op to read all of 'vars_to_save' at once.
+
+    The variables are read in parallel.  This is used instead of
+    restore_op() for variables restored on the same device, unless
+    restore_op() is overridden or they are restored sequentially.
+
+    Args:
+      filename_tensor: String Tensor.
+      vars_to_save: A list of BaseSaverBuilder.VarToSave objects.
+      preferred_shard: Int.  Shard to open first when loading a sharded file.
+
+    Returns:
+      A list of Tensors resulting from reading 'vars_to_save' from
+      'filename'.
+    """
+    # pylint: disable=protected-access
+    return io_ops._restore_slices(
+        filename_tensor,
+        [vs.name for vs in vars_to_save],
+        [vs.slice_spec for vs in vars_to_save],
+        [vs.var.dtype for vs in vars_to_save],
+        preferred_shard=preferred_shard)
+
   def sharded_filename(self, filename_tensor, shard, num_shards):
     """Append sharding information to a filename.
 
@@ -200,26 +240,32 @@ class BaseSaverBuilder(object):
     # pylint: disable=protected-access
     return gen_io_ops._sharded_filename(filename_tensor, shard, num_shards)
 
-  def _AddSaveOps(self, filename_tensor, vars_to_save):
+  def _AddSaveOps(self, filename_tensor, vars_to_save, wait_ops=None):
     """Add ops to save variables that are on the same shard.
 
     Args:
       filename_tensor: String Tensor.
       vars_to_save: A list of _VarToSave objects.
+      wait_ops: If not None, the op that waits for an asynchronous save is
+        appended to this list.
 
     Returns:
       A tensor with the filename used to save.
     """
     save = self.save_op(filename_tensor, vars_to_save)
+    if wait_ops is not None:
+      wait_ops.append(self.wait_op(filename_tensor))
     return control_flow_ops.with_dependencies([save], filename_tensor)
 
-  def _AddShardedSaveOps(self, filename_tensor, per_device):
+  def _AddShardedSaveOps(self, filename_tensor, per_device, wait_ops=None):
     """Add ops to save the params per shard.
 
     Args:
       filename_tensor: String Tensor.
       per_device: A list of (device, BaseSaverBuilder.VarToSave) pairs, as
         returned by _GroupByDevices().
+      wait_ops: If not None, the ops that wait for asynchronous saves are
+        appended to this list.
 
     Returns:
       An op to save the variables.
@@ -231,7 +277,8 @@ class BaseSaverBuilder(object):
       with ops.device(device):
         sharded_filename = self.sharded_filename(
             filename_tensor, shard, num_shards_tensor)
-        sharded_saves.append(self._AddSaveOps(sharded_filename, vars_to_save))
+        sharded_saves.append(self._AddSaveOps(sharded_filename, vars_to_save,
+                                              wait_ops=wait_ops))
     # Return the sharded name for the save path.
     with ops.control_dependencies([x.op for x in sharded_saves]):
       # pylint: disable=protected-access
@@ -259,8 +306,14 @@ class BaseSaverBuilder(object):
     Returns:
       An Operation that restores the variables.
     """
+    bulk_restore = not restore_sequentially and (
+        six.get_method_function(self.restore_op) is
+        six.get_unbound_function(BaseSaverBuilder.restore_op))
+    if bulk_restore:
+      all_values = self._AddBulkRestoreOps(filename_tensor, vars_to_save,
+                                           preferred_shard)
     assign_ops = []
-    for vs in vars_to_save:
+    for i, vs in enumerate(vars_to_save):
       v = vs.var
       restore_control_inputs = assign_ops[-1:] if restore_sequentially else []
       # Load and optionally reshape on the CPU, as string tensors are not
@@ -268,8 +321,11 @@ class BaseSaverBuilder(object):
       # TODO(touts): Re-enable restore on GPU when we can support annotating
       # string tensors as "HostMemory" inputs.
       with ops.device(graph_util.set_cpu0(v.device) if v.device else None):
-        with ops.control_dependencies(restore_control_inputs):
-          values = self.restore_op(filename_tensor, vs, preferred_shard)
+        if bulk_restore:
+          values = all_values[i]
+        else:
+          with ops.control_dependencies(restore_control_inputs):
+            values = self.restore_op(filename_tensor, vs, preferred_shard)
         if reshape:
           shape = v.get_shape()
           if not shape.is_fully_defined():
@@ -284,6 +340,32 @@ class BaseSaverBuilder(object):
     # Create a Noop that has control dependencies from all the updates.
     return control_flow_ops.group(*assign_ops, name=name)
 
+  def _AddBulkRestoreOps(self, filename_tensor, vars_to_save, preferred_shard):
+    """Add one bulk_restore_op per device to restore vars_to_save.
+
+    Args:
+      filename_tensor: Tensor for the path of the file to load.
+      vars_to_save: A list of _VarToSave objects.
+      preferred_shard: Shard to open first when loading a sharded file.
+
+    Returns:
+      A list with the restored Tensor of each of vars_to_save.
+    """
+    per_device = collections.OrderedDict()
+    for i, vs in enumerate(vars_to_save):
+      v = vs.var
+      device = graph_util.set_cpu0(v.device) if v.device else None
+      per_device.setdefault(device, []).append(i)
+    all_values = [None] * len(vars_to_save)
+    for device, indices in per_device.items():
+      with ops.device(device):
+        values = self.bulk_restore_op(
+            filename_tensor, [vars_to_save[i] for i in indices],
+            preferred_shard)
+      for i, value in zip(indices, values):
+        all_values[i] = value
+    return all_values
+
   def _AddShardedRestoreOps(self, filename_tensor, per_device,
                             restore_sequentially, reshape):
     """Add Ops to restore variables from multiple devices.
@@ -463,7 +545,9 @@ class BaseSaverBuilder(object):
             keep_checkpoint_every_n_hours=10000.0,
             name=None,
             restore_sequentially=False,
-            filename="model"):
+            filename="model",
+            async_write=False,
+            max_incremental_saves=0):
     """Adds save/restore nodes to the graph and creates a SaverDef proto.
 
     Args:
@@ -489,6 +573,11 @@ class BaseSaverBuilder(object):
         variables to happen sequentially within each device.
       filename: If known at graph construction time, filename used for variable
         loading/saving.
+      async_write: If True, the save ops only snapshot the variables, and the
+        files are written in the background.  The SaverDef then names an op
+        that waits for them.
+      max_incremental_saves: Number of saves after a full one that only write
+        the rows that changed since the previous save.
 
     Returns:
       A SaverDef proto.
@@ -502,6 +591,12 @@ class BaseSaverBuilder(object):
     vars_to_save = self._ValidateAndSliceInputs(names_to_variables)
     if max_to_keep is None:
       max_to_keep = 0
+    if max_incremental_saves < 0:
+      raise ValueError("max_incremental_saves must be >= 0: %d" %
+                       max_incremental_saves)
+    self._async_write = async_write
+    self._max_incremental_saves = max_incremental_saves
+    wait_ops = [] if async_write else None
 
     with ops.op_scope([vs.var for vs in vars_to_save], name, "save") as name:
       # Add the Constant string tensor for the filename.
@@ -510,13 +605,17 @@ class BaseSaverBuilder(object):
       # Add the save ops.
       if sharded:
         per_device = self._GroupByDevices(vars_to_save)
-        save_tensor = self._AddShardedSaveOps(filename_tensor, per_device)
+        save_tensor = self._AddShardedSaveOps(filename_tensor, per_device,
+                                              wait_ops=wait_ops)
         restore_op = self._AddShardedRestoreOps(
             filename_tensor, per_device, restore_sequentially, reshape)
       else:
-        save_tensor = self._AddSaveOps(filename_tensor, vars_to_save)
+        save_tensor = self._AddSaveOps(filename_tensor, vars_to_save,
+                                       wait_ops=wait_ops)
         restore_op = self._AddRestoreOps(
             filename_tensor, vars_to_save, restore_sequentially, reshape)
+      if async_write:
+        wait_op = control_flow_ops.group(*wait_ops, name="wait_all")
 
     assert restore_op.name.endswith("restore_all"), restore_op.name
 
@@ -526,7 +625,9 @@ class BaseSaverBuilder(object):
         restore_op_name=restore_op.name,
         max_to_keep=max_to_keep,
         keep_checkpoint_every_n_hours=keep_checkpoint_every_n_hours,
-        sharded=sharded)
+        sharded=sharded,
+        wait_op_name=wait_op.name if async_write else "",
+        max_incremental_saves=max_incremental_saves)
 
 
 def _GetCheckpointFilename(save_dir, latest_filename):
@@ -733,6 +834,18 @@ class Saver(object):
     one checkpoint file for every 2 hours of training.  The default value of
     10,000 hours effectively disables the feature.
 
+  Two more arguments make saving cheaper for large models:
+
+  * `async_write`: `save()` returns once the variables are copied, and the
+    checkpoint is written in the background.  The `checkpoint` file is only
+    updated once it is complete.  Call `wait_for_pending_save()` before
+    closing the session.
+
+  * `max_incremental_saves`: After a full checkpoint, up to this many
+    checkpoints only store the rows of the variables that changed since the
+    previous save.  Restoring one of them reads the checkpoints it is based
+    on, so these are kept in addition to the `max_to_keep` recent ones.
+
   Note that you still have to call the `save()` method to save the model.
   Passing these arguments to the constructor will not save variables
   automatically for you.
@@ -764,6 +877,7 @@ class Saver(object):
   @@__init__
   @@save
   @@restore
+  @@wait_for_pending_save
 
   Other utility methods.
 
@@ -781,7 +895,9 @@ class Saver(object):
                name=None,
                restore_sequentially=False,
                saver_def=None,
-               builder=None):
+               builder=None,
+               async_write=False,
+               max_incremental_saves=0):
     """Creates a `Saver`.
 
     The constructor adds ops to save and restore variables.
@@ -839,6 +955,9 @@ class Saver(object):
         `as_saver_def()` call of the `Saver` that was created for that `Graph`.
       builder: Optional `SaverBuilder` to use if a `saver_def` was not provided.
         Defaults to `BaseSaverBuilder()`.
+      async_write: If `True`, `save()` writes the checkpoint in the background.
+      max_incremental_saves: Number of checkpoints after a full one that only
+        store the rows changed since the previous save.  Defaults to 0.
 
     Raises:
       TypeError: If `var_list` is invalid.
@@ -858,7 +977,9 @@ class Saver(object):
           max_to_keep=max_to_keep,
           keep_checkpoint_every_n_hours=keep_checkpoint_every_n_hours,
           name=name,
-          restore_sequentially=restore_sequentially)
+          restore_sequentially=restore_sequentially,
+          async_write=async_write,
+          max_incremental_saves=max_incremental_saves)
     if not isinstance(saver_def, saver_pb2.SaverDef):
       raise ValueError("saver_def must if a saver_pb2.SaverDef: %s" % saver_def)
     if not saver_def.save_tensor_name:
@@ -874,6 +995,11 @@ class Saver(object):
     self._next_checkpoint_time = (
         time.time() + self.saver_def.keep_checkpoint_every_n_hours * 3600)
     self._last_checkpoints = []
+    # Checkpoints out of max_to_keep that later ones may still be based on.
+    self._incremental_bases = []
+    # The thread finishing an asynchronous save, and the error it raised.
+    self._pending_save = None
+    self._pending_save_error = None
 
   def _CheckpointFilename(self, p):
     """Returns the checkpoint filename given a `(filename, time)` pair.
@@ -914,6 +1040,9 @@ class Saver(object):
     kept for every 0.5 hours of training; if `N` is 10, an additional
     checkpoint is kept for every 10 hours of training.
 
+    With `max_incremental_saves`, that many more checkpoints are kept before
+    deletion, as the checkpoints kept may be based on them.
+
     Args:
       latest_save_path: Name including path of checkpoint file to save.
       meta_graph_suffix: Suffix for `MetaGraphDef` file. Defaults to 'meta'.
@@ -935,8 +1064,15 @@ class Saver(object):
       if should_keep:
         self._next_checkpoint_time += (
             self.saver_def.keep_checkpoint_every_n_hours * 3600)
+        # The checkpoints p may be based on are kept with it.
+        self._incremental_bases = []
+        return
+      self._incremental_bases.append(p)
+      if (len(self._incremental_bases) <=
+          self.saver_def.max_incremental_saves):
         return
       # Otherwise delete the files.
+      p = self._incremental_bases.pop(0)
       for f in file_io.get_matching_files(
           self._CheckpointFilename(p)):
         try:
@@ -1037,6 +1173,10 @@ class Saver(object):
       write_meta_graph: `Boolean` indicating whether or not to write the meta
         graph file.
 
+    With `async_write`, this returns before the checkpoint is written, and
+    the `checkpoint` file lists it once it is.  A save first waits for the
+    previous one.
+
     Returns:
       A string: path at which the variables were saved.  If the saver is
         sharded, this string ends with: '-?????-of-nnnnn' where 'nnnnn'
@@ -1046,6 +1186,7 @@ class Saver(object):
       TypeError: If `sess` is not a `Session`.
       ValueError: If `latest_filename` contains path components, or if it
         collides with `save_path`.
+      Exception: The error of a previous asynchronous save that failed.
     """
     if latest_filename is None:
       latest_filename = "checkpoint"
@@ -1070,14 +1211,32 @@ class Saver(object):
     if not isinstance(sess, session.SessionInterface):
       raise TypeError("'sess' must be a Session; %s" % sess)
 
-    model_checkpoint_path = sess.run(
-        self.saver_def.save_tensor_name,
-        {self.saver_def.filename_tensor_name: checkpoint_file})
+    # Incremental saves are based on the previous one, so asynchronous saves
+    # are finished in order.
+    self.wait_for_pending_save()
+    feed_dict = {self.saver_def.filename_tensor_name: checkpoint_file}
+    model_checkpoint_path = sess.run(self.saver_def.save_tensor_name,
+                                     feed_dict)
     model_checkpoint_path = compat.as_str(model_checkpoint_path)
-    self._MaybeDeleteOldCheckpoints(model_checkpoint_path,
-                                    meta_graph_suffix=meta_graph_suffix)
-    update_checkpoint_state(save_path, model_checkpoint_path,
-                            self.last_checkpoints, latest_filename)
+
+    def _FinishSave():
+      self._MaybeDeleteOldCheckpoints(model_checkpoint_path,
+                                      meta_graph_suffix=meta_graph_suffix)
+      update_checkpoint_state(save_path, model_checkpoint_path,
+                              self.last_checkpoints, latest_filename)
+
+    if self.saver_def.wait_op_name:
+      def _WaitAndFinishSave():
+        try:
+          sess.run(self.saver_def.wait_op_name, feed_dict)
+          _FinishSave()
+        except Exception as e:  # pylint: disable=broad-except
+          self._pending_save_error = e
+      self._pending_save = threading.Thread(target=_WaitAndFinishSave)
+      self._pending_save.daemon = True
+      self._pending_save.start()
+    else:
+      _FinishSave()
     if write_meta_graph:
       meta_graph_filename = self._MetaGraphFilename(
           checkpoint_file, meta_graph_suffix=meta_graph_suffix)
@@ -1123,11 +1282,30 @@ class Saver(object):
     Raises:
       ValueError: If the given `save_path` does not point to a file.
     """
+    self.wait_for_pending_save()
     if not file_io.get_matching_files(save_path):
       raise ValueError("Restore called with invalid save path %s" % save_path)
     sess.run(self.saver_def.restore_op_name,
              {self.saver_def.filename_tensor_name: save_path})
 
+  def wait_for_pending_save(self):
+    """Waits for the checkpoint of an asynchronous `save()` to be written.
+
+    Does nothing if the saver does not use `async_write`, or if no save is
+    pending.
+
+    Raises:
+      Exception: The error that made the save fail.
+    """
+    if self._pending_save is None:
+      return
+    self._pending_save.join()
+    self._pending_save = None
+    if self._pending_save_error is not None:
+      error = self._pending_save_error
+      self._pending_save_error = None
+      raise error
+
   @staticmethod
   def _add_collection_def(meta_graph_def, key):
     """Adds a collection to MetaGraphDef protocol buffer.
@@ -657,6 +657,44 @@ class KeepCheckpointEveryNHoursTest(tf.test.TestCase):
       self.assertTrue(gfile.Exists(s4))
 
 
+class AsyncIncrementalSaveTest(tf.test.TestCase):
+
+  def testAsyncIncrementalSaves(self):
+    save_dir = _TestDir("async_incremental_saves")
+
+    with self.test_session() as sess:
+      v = tf.Variable([[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]], name="v")
+      update = tf.scatter_update(v, [1], [[30.0, 40.0]])
+      tf.initialize_all_variables().run()
+      save = tf.train.Saver({"v": v}, max_to_keep=1, async_write=True,
+                            max_incremental_saves=2)
+
+      s1 = save.save(sess, os.path.join(save_dir, "s1"))
+      update.eval()
+      s2 = save.save(sess, os.path.join(save_dir, "s2"))
+      s3 = save.save(sess, os.path.join(save_dir, "s3"))
+      save.wait_for_pending_save()
+      self.assertEqual([s3], save.last_checkpoints)
+      self.assertEqual(s3, tf.train.latest_checkpoint(save_dir))
+      # s3 only stores the changes since s2 and s1, so both are kept.
+      self.assertTrue(gfile.Exists(s1))
+      self.assertTrue(gfile.Exists(s2))
+
+      save.restore(sess, s3)
+      self.assertAllEqual([[1.0, 2.0], [30.0, 40.0], [5.0, 6.0]], v.eval())
+      save.restore(sess, s1)
+      self.assertAllEqual([[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]], v.eval())
+
+      # s4 is a full save again, and s1 is no longer needed.
+      s4 = save.save(sess, os.path.join(save_dir, "s4"))
+      save.wait_for_pending_save()
+      self.assertEqual([s4], save.last_checkpoints)
+      self.assertFalse(gfile.Exists(s1))
+      self.assertTrue(gfile.Exists(s2))
+      save.restore(sess, s4)
+      self.assertAllEqual([[1.0, 2.0], [3.0, 4.0], [5.0, 6.0]], v.eval())
+
+
 class SaveRestoreWithVariableNameMap(tf.test.TestCase):
 
   def testNonReshape(self):
@@ -1261,7 +1299,8 @@ class MetaGraphTest(tf.test.TestCase):
       meta_graph_def = save.export_meta_graph()
       ops = [o.name for o in meta_graph_def.meta_info_def.stripped_op_list.op]
       self.assertEqual(ops, ["Add", "Assign", "Const", "Identity", "NoOp",
-                             "RestoreSlice", "SaveSlices", "Sub", "Variable"])
+                             "RestoreSlices", "SaveSlices", "Sub",
+                             "Variable"])
 
       # Test calling stripped_op_list_for_graph directly
       op_list = tf.contrib.util.stripped_op_list_for_graph(
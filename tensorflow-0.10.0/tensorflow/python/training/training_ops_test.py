@@ -206,6 +206,57 @@ class TrainingOpsTest(TensorFlowTestCase):
       indices = np.array([0, 2]).astype(index_type)
       self._testTypesForSparseAdagrad(x, y, lr, grad, indices)
 
+  def testSparseApplyAdagradSumsDuplicateIndices(self):
+    for (dtype, index_type) in itertools.product(
+        [np.float32, np.float64], [np.int32, np.int64]):
+      x = np.arange(12).reshape(4, 3).astype(dtype)
+      y = np.ones((4, 3)).astype(dtype)
+      lr = np.array(0.5).astype(dtype)
+      grad = np.arange(15).reshape(5, 3).astype(dtype)
+      indices = np.array([2, 0, 2, 3, 2]).astype(index_type)
+      summed = np.zeros_like(x)
+      np.add.at(summed, indices, grad)
+      self.setUp()
+      with self.test_session(use_gpu=False):
+        var = variables.Variable(x)
+        accum = variables.Variable(y)
+        variables.initialize_all_variables().run()
+        training_ops.sparse_apply_adagrad(
+            var, accum, lr, grad,
+            constant_op.constant(indices, self._toType(indices.dtype)),
+            sum_duplicate_indices=True).op.run()
+        # Untouched rows have a zero summed gradient and keep their values.
+        self.assertAllClose(y + summed * summed, accum.eval())
+        self.assertAllClose(x - lr * summed / np.sqrt(y + summed * summed),
+                            var.eval())
+
+  def testSparseApplyMomentumSumsDuplicateIndices(self):
+    for (dtype, index_type) in itertools.product(
+        [np.float32, np.float64], [np.int32, np.int64]):
+      x = np.arange(12).reshape(4, 3).astype(dtype)
+      y = np.ones((4, 3)).astype(dtype)
+      lr = np.array(0.5).astype(dtype)
+      momentum = np.array(0.9).astype(dtype)
+      grad = np.arange(15).reshape(5, 3).astype(dtype)
+      indices = np.array([2, 0, 2, 3, 2]).astype(index_type)
+      summed = np.zeros_like(x)
+      np.add.at(summed, indices, grad)
+      touched = np.zeros((4, 1), dtype=bool)
+      touched[indices] = True
+      expected_accum = np.where(touched, y * momentum + summed, y)
+      expected_var = np.where(touched, x - lr * expected_accum, x)
+      self.setUp()
+      with self.test_session(use_gpu=False):
+        var = variables.Variable(x)
+        accum = variables.Variable(y)
+        variables.initialize_all_variables().run()
+        training_ops.sparse_apply_momentum(
+            var, accum, lr, grad,
+            constant_op.constant(indices, self._toType(indices.dtype)),
+            momentum, sum_duplicate_indices=True).op.run()
+        self.assertAllClose(expected_accum, accum.eval())
+        self.assertAllClose(expected_var, var.eval())
+
   def testSparseApplyFtrlDim1(self):
     for (dtype, index_type) in itertools.product(
         [np.float16, np.float32, np.float64], [np.int32, np.int64]):